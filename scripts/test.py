@@ -5,6 +5,9 @@ import sys
 import math
 import os.path
 import subprocess
+import shutil
+import time
+import re
 
 def ppm_compare( name1, name2, diffname, diff_threshold_in, allowed_percentage_in ):
 
@@ -91,54 +94,200 @@ def ppm_compare( name1, name2, diffname, diff_threshold_in, allowed_percentage_i
     return(0)
 
 
+def gpu_name():
+
+    # The first GPU reported by the driver. Used as key into the timing thresholds file.
+    try:
+        output = subprocess.check_output( ['nvidia-smi', '--query-gpu=name', '--format=csv,noheader'] )
+    except (OSError, subprocess.CalledProcessError):
+        return 'unknown'
+    lines = output.strip().splitlines()
+    if not lines:
+        return 'unknown'
+    return lines[0].strip()
+
+
+def read_thresholds( filename, gpu ):
+
+    # Lines of the form "<gpu name> | <sample> | <startup seconds> | <render seconds> | <total seconds>".
+    # '-' means no limit. Only the lines of the given GPU are returned, as dictionary sample -> [startup, render, total].
+    thresholds = {}
+    if not os.path.isfile( filename ):
+        return thresholds
+    for line in open( filename, "r" ):
+        line = line.strip()
+        if not line or line.startswith( '#' ):
+            continue
+        fields = [f.strip() for f in line.split( '|' )]
+        if len(fields) != 5:
+            print "Ignoring malformed threshold line: " + line
+            continue
+        if fields[0] != gpu:
+            continue
+        limits = []
+        for f in fields[2:]:
+            if f == '-':
+                limits.append( None )
+            else:
+                limits.append( float(f) )
+        thresholds[fields[1]] = limits
+    return thresholds
+
+
+def check_timings( name, output, total_seconds, limits ):
+
+    # The introduction samples print their own startup and render times, the others only have the overall runtime.
+    startup = None
+    render  = None
+    match = re.search( r'initScene\(\): ([0-9.eE+-]+) seconds overall', output )
+    if match:
+        startup = float(match.group(1))
+    match = re.search( r'renderBatch\(\): [0-9]+ samples per pixel in ([0-9.eE+-]+) seconds', output )
+    if match:
+        render = float(match.group(1))
+
+    print "Timings: startup = " + str(startup) + " s, render = " + str(render) + " s, total = " + str(total_seconds) + " s"
+
+    if limits is None:
+        return 0
+
+    result = 0
+    for label, value, limit in [( 'startup', startup, limits[0] ), ( 'render', render, limits[1] ), ( 'total', total_seconds, limits[2] )]:
+        if limit is None:
+            continue
+        if value is None:
+            print name + " has a " + label + " threshold but did not report that time."
+            result = 1
+        elif value > limit:
+            print name + " " + label + " time " + str(value) + " s exceeds the threshold of " + str(limit) + " s."
+            result = 1
+    return result
+
+
 # Constants
 diff_threshold = 1  # out of 255
 allowed_percentage = 3
 
-# Args
-bindir  = sys.argv[1] + '/'
-tmpdir  = sys.argv[2] + '/'
+# Args: <bindir> <tmpdir> [logfile] [--sample <name>] [--gpu <name>] [--update-gold]
+positional  = []
+only_sample = ''
+gpu         = ''
+update_gold = False
+i = 1
+while i < len(sys.argv):
+    if sys.argv[i] == '--sample' and i + 1 < len(sys.argv):
+        i += 1
+        only_sample = sys.argv[i]
+    elif sys.argv[i] == '--gpu' and i + 1 < len(sys.argv):
+        i += 1
+        gpu = sys.argv[i]
+    elif sys.argv[i] == '--update-gold':
+        update_gold = True
+    else:
+        positional.append( sys.argv[i] )
+    i += 1
+
+bindir  = positional[0] + '/'
+tmpdir  = positional[1] + '/'
 logfile = ''
-if len(sys.argv) > 3 :
-    logfile = sys.argv[3]
+if len(positional) > 2 :
+    logfile = positional[2]
 golddir = os.path.abspath( os.path.dirname( sys.argv[0] ) ) + '/'  # directory containing python script
 
-# Add new samples here and create a .gold.ppm image in the current directory.
-samples = [ 'optixGlass', 'optixOcean', 'optixVox', 'optixProgressivePhotonMap', 'optixParticleVolumes' ]
+if not gpu:
+    gpu = gpu_name()
+thresholds = read_thresholds( golddir + 'timing_thresholds.txt', gpu )
+print "GPU: " + gpu + ", " + str(len(thresholds)) + " timing thresholds."
+
+# Add new samples here and create a .gold.ppm image in the current directory (run once with --update-gold).
+# Each entry is the sample name and its arguments rendering a fixed number of samples per pixel into the result file.
+# The introduction samples accumulate 64 samples per pixel with --file, optixIntro_10 renders headless with --batch.
+intro_args = ['--width', '512', '--height', '512', '-f']
+samples = [ ( 'optixGlass',                [ '-f' ] ),
+            ( 'optixOcean',                [ '-f' ] ),
+            ( 'optixVox',                  [ '-f' ] ),
+            ( 'optixProgressivePhotonMap', [ '-f' ] ),
+            ( 'optixParticleVolumes',      [ '-f' ] ),
+            ( 'optixIntro_04',             intro_args ),
+            ( 'optixIntro_05',             intro_args ),
+            ( 'optixIntro_06',             intro_args ),
+            ( 'optixIntro_07',             intro_args ),
+            ( 'optixIntro_08',             intro_args ),
+            ( 'optixIntro_09',             intro_args ),
+            ( 'optixIntro_10',             ['--width', '512', '--height', '512', '--spp', '64', '--batch'] ) ]
+if only_sample:
+    samples = [s for s in samples if s[0] == only_sample]
 
 pass_count = 0;
 fail_count = 0;
 exception_count = 0;
+skip_count = 0;
+
+for s, args in samples:
+
+    executable = bindir + s
+    if not os.path.isfile( executable ) and not os.path.isfile( executable + '.exe' ):
+        print "Skipping " + s + ", not built."
+        skip_count += 1
+        continue
 
-for s in samples:
+    gold_file = golddir + s + '.gold.ppm' 
+    if not update_gold and not os.path.isfile( gold_file ):
+        print "Skipping " + s + ", no gold image " + gold_file
+        skip_count += 1
+        continue
 
     # Run sample
     result_file = tmpdir + s + '.ppm'
-    cmd_args = [bindir + s, '-f', result_file]
+    cmd_args = [executable] + args + [result_file]
     print( "\tRunning cmd <<<{0}>>>".format( ' '.join( cmd_args ) ) )
+    start = time.time()
     try:
-        subprocess.check_call( cmd_args )
-    except subprocess.CalledProcessError as err:
+        process = subprocess.Popen( cmd_args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT )
+        output = process.communicate()[0]
+    except OSError as err:
         print "Caught error: {0}".format(err)
         exception_count += 1
         continue
+    total_seconds = time.time() - start
+    print output
+    if process.returncode != 0:
+        print "Caught error: {0} returned {1}".format( s, process.returncode )
+        exception_count += 1
+        continue
+
+    if update_gold:
+        shutil.copyfile( result_file, gold_file )
+        print "Updated gold file: " + gold_file
+        pass_count += 1
+        continue
 
     # Diff result against gold image
-    gold_file = golddir + s + '.gold.ppm' 
     diff_file = tmpdir + s + '.diff.ppm'
-    if ppm_compare( result_file, gold_file, diff_file, diff_threshold, allowed_percentage ):
+    failed = ppm_compare( result_file, gold_file, diff_file, diff_threshold, allowed_percentage )
+    if failed:
         print "Rendered file: " + result_file
         print "    Gold file: " + gold_file
         print "    Diff file: " + diff_file
+
+    if check_timings( s, output, total_seconds, thresholds.get( s ) ):
+        failed = 1
+
+    if failed:
         fail_count += 1
     else:
         pass_count += 1
 
-print "\n{0} tests total, {1} passed, {2} failed".format( len(samples), pass_count, fail_count + exception_count )
+print "\n{0} tests total, {1} passed, {2} failed, {3} skipped".format( len(samples), pass_count, fail_count + exception_count, skip_count )
 if logfile :
-    open( logfile, 'w+' ).write("{0} tests total, {1} passed, {2} failed\n".format( len(samples), pass_count, fail_count + exception_count) )
+    open( logfile, 'w+' ).write("{0} tests total, {1} passed, {2} failed, {3} skipped\n".format( len(samples), pass_count, fail_count + exception_count, skip_count) )
     
-assert pass_count + fail_count + exception_count == len(samples)
+assert pass_count + fail_count + exception_count + skip_count == len(samples)
+
+if fail_count + exception_count:
+    sys.exit(1)
+if samples and skip_count == len(samples):
+    sys.exit(77) # Reported as skipped by CTest.
 
 
-# python test.py ../SDK/build/bin /tmp [logfile]
+# python test.py ../SDK/build/bin /tmp [logfile] [--sample optixGlass] [--gpu "Quadro RTX 6000"] [--update-gold]
@@ -299,16 +299,26 @@ endfunction()
 ################################################################################
 # Copy ptx scripts into a string in a cpp header file.
 #
-# Usage: ptx_to_cpp( ptx_cpp_headers my_directory FILE1 FILE2 ... FILEN )
+# Usage: ptx_to_cpp( ptx_cpp_headers my_directory [REGISTER] FILE1 FILE2 ... FILEN )
 #   ptx_cpp_files  : [out] List of cpp files created (Note: new files are appended to this list)
 #   directory      : [in]  Directory in which to place the resulting headers
+#   REGISTER       : [in]  Register each string with sutil::registerEmbeddedPTX() under the
+#                          ptx file name, so sutil::getPtxString() finds it without file I/O
 #   FILE1 .. FILEN : [in]  ptx files to be cpp stringified
 #
 # FILE1 -> filename: ${FILE1}_ptx.cpp
 #       -> string  : const char* nvrt::${FILE1}_ptx = "...";
 
 macro( ptx_to_cpp ptx_cpp_files directory )
-  foreach( file ${ARGN} )
+  set( ptx_to_cpp_files ${ARGN} )
+  set( ptx_to_cpp_register "" )
+  list( FIND ptx_to_cpp_files REGISTER ptx_to_cpp_register_index )
+  if( NOT ptx_to_cpp_register_index EQUAL -1 )
+    list( REMOVE_AT ptx_to_cpp_files ${ptx_to_cpp_register_index} )
+    set( ptx_to_cpp_register TRUE )
+  endif()
+
+  foreach( file ${ptx_to_cpp_files} )
     if( ${file} MATCHES ".*\\.ptx$" )
 
       #message( "file_name     : ${file}" )
@@ -318,6 +328,10 @@ macro( ptx_to_cpp ptx_cpp_files directory )
       set( cpp_filename ${directory}/${base_name}_ptx.cpp )
       set( variable_name ${base_name}_ptx )
       set( ptx2cpp ${CMAKE_SOURCE_DIR}/CMake/ptx2cpp.cmake )
+      set( register_name "" )
+      if( ptx_to_cpp_register )
+        get_filename_component( register_name ${file} NAME )
+      endif()
 
       #message( "base_name     : ${base_name}" )
       #message( "cpp_file_name : ${cpp_filename}" )
@@ -330,6 +344,7 @@ macro( ptx_to_cpp ptx_cpp_files directory )
           -DPTX_FILE:STRING="${file}"
           -DVARIABLE_NAME:STRING=${variable_name}
           -DNAMESPACE:STRING=optix
+          -DREGISTER_NAME:STRING=${register_name}
           -P ${ptx2cpp}
         DEPENDS ${file}
         DEPENDS ${ptx2cpp}
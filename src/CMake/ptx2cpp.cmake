@@ -30,6 +30,7 @@
 # VARIABLE_NAME
 # NAMESPACE
 # CUDA_BIN2C_EXECUTABLE
+# REGISTER_NAME (optional)
 
 # message("PTX_FILE      = ${PTX_FILE}")
 # message("CPP_FILE      = ${C_FILE}")
@@ -48,4 +49,7 @@ endif()
 set(BODY
   "${bindata}\n"
   "namespace ${NAMESPACE} {\n\nstatic const char* const ${VARIABLE_NAME} = reinterpret_cast<const char*>(&${VARIABLE_NAME}_static[0]);\n} // end namespace ${NAMESPACE}\n")
+if(REGISTER_NAME)
+  set(BODY "${BODY}\n#include <sutil.h>\n\nstatic const bool ${VARIABLE_NAME}_registered = sutil::registerEmbeddedPTX(\"${REGISTER_NAME}\", ${NAMESPACE}::${VARIABLE_NAME});\n")
+endif()
 file(WRITE ${CPP_FILE} "${BODY}")
@@ -0,0 +1,81 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixu_math_namespace.h>
+
+// Per pixel cost visualization: The ray generation programs measure their clock64() cycles per pixel
+// and show them as a false color heatmap instead of the image.
+
+#define COST_HEATMAP_OFF     0 // The image is shown.
+#define COST_HEATMAP_FRAME   1 // The cost of the last frame is shown.
+#define COST_HEATMAP_AVERAGE 2 // The mean cost over the accumulated frames is shown.
+
+// Dark blue over cyan, green and yellow to red for t in [0, 1]. Costs above the scale are white.
+static __host__ __device__ __inline__ optix::float3 heatmap_color( const float t )
+{
+  if( t >= 1.0f )
+    return optix::make_float3( 1.0f );
+
+  const float s = fmaxf( t, 0.0f ) * 4.0f;
+  if( s < 1.0f )
+    return optix::lerp( optix::make_float3( 0.0f, 0.0f, 0.5f ), optix::make_float3( 0.0f, 0.5f, 1.0f ), s );
+  if( s < 2.0f )
+    return optix::lerp( optix::make_float3( 0.0f, 0.5f, 1.0f ), optix::make_float3( 0.0f, 1.0f, 0.0f ), s - 1.0f );
+  if( s < 3.0f )
+    return optix::lerp( optix::make_float3( 0.0f, 1.0f, 0.0f ), optix::make_float3( 1.0f, 1.0f, 0.0f ), s - 2.0f );
+  return optix::lerp( optix::make_float3( 1.0f, 1.0f, 0.0f ), optix::make_float3( 1.0f, 0.0f, 0.0f ), s - 3.0f );
+}
+
+#ifdef __CUDACC__
+
+#include <optix.h>
+
+rtBuffer<float, 2>        cost_buffer;            // Cycles per pixel, the mean with COST_HEATMAP_AVERAGE.
+rtDeclareVariable(int,    use_cost_heatmap, , );  // COST_HEATMAP_*
+rtDeclareVariable(float,  cost_scale, , );        // Cycles shown in red.
+
+// Records the cycles of the pixel and returns its heatmap color. Frame 0 restarts the mean.
+static __device__ __inline__ optix::float3 record_cycles( const optix::uint2& pixel, const float cycles, const unsigned int frame )
+{
+  float cost = cycles;
+  if( use_cost_heatmap == COST_HEATMAP_AVERAGE && frame > 0 )
+    cost = optix::lerp( cost_buffer[pixel], cycles, 1.0f / static_cast<float>( frame + 1 ) );
+  cost_buffer[pixel] = cost;
+
+  return heatmap_color( cost / cost_scale );
+}
+
+// Records the cycles since start for the pixel and returns its heatmap color.
+static __device__ __inline__ optix::float3 record_cost( const optix::uint2& pixel, const long long start, const unsigned int frame )
+{
+  return record_cycles( pixel, static_cast<float>( clock64() - start ), frame );
+}
+
+#endif
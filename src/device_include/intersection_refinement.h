@@ -74,6 +74,32 @@ static __device__ __inline__ optix::float3 offset( const optix::float3& hit_poin
   return offset_point;
 }
 
+// Offset a hit point along the geometric normal n for the continuation ray on the side n points to.
+// The offset is a fixed number of float ULPs of each component, scaled by n, so it adapts to the
+// magnitude of the coordinates and needs no scene dependent epsilon. Near the origin, where the
+// ULPs get arbitrarily small, a small constant offset is used instead. The continuation rays can
+// use a tmin of 0.0f. Only needs the final hit point, so call it once in the closest hit program
+// instead of refining every candidate inside the intersection program.
+// See Waechter and Binder, "A Fast and Robust Method for Avoiding Self-Intersection", Ray Tracing Gems.
+static __device__ __inline__ optix::float3 offset_ray( const optix::float3& p, const optix::float3& n )
+{
+  using namespace optix;
+
+  const float origin      = 1.0f / 32.0f;
+  const float float_scale = 1.0f / 65536.0f;
+  const float int_scale   = 256.0f;
+
+  const int3 of_i = make_int3( int( int_scale * n.x ), int( int_scale * n.y ), int( int_scale * n.z ) );
+
+  const float3 p_i = make_float3( __int_as_float( __float_as_int( p.x ) + ( ( p.x < 0.0f ) ? -of_i.x : of_i.x ) ),
+                                  __int_as_float( __float_as_int( p.y ) + ( ( p.y < 0.0f ) ? -of_i.y : of_i.y ) ),
+                                  __int_as_float( __float_as_int( p.z ) + ( ( p.z < 0.0f ) ? -of_i.z : of_i.z ) ) );
+
+  return make_float3( ( fabsf( p.x ) < origin ) ? p.x + float_scale * n.x : p_i.x,
+                      ( fabsf( p.y ) < origin ) ? p.y + float_scale * n.y : p_i.y,
+                      ( fabsf( p.z ) < origin ) ? p.z + float_scale * n.z : p_i.z );
+}
+
 // Refine the hit point to be more accurate and offset it for reflection and
 // refraction ray starting points.
 static
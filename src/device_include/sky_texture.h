@@ -0,0 +1,133 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+//
+// Lat-long sky texture baked by sutil::PreethamSunSky::setSkyTexture(), together with the tables to
+// importance sample it.  u runs along the azimuth around sky_frame_w, v from sky_frame_w ( v = 0 ) to
+// -sky_frame_w ( v = 1 ).
+//
+
+rtDeclareVariable(int,           use_sky_texture, , );
+rtDeclareVariable(optix::float3, sky_frame_u, , );
+rtDeclareVariable(optix::float3, sky_frame_v, , );
+rtDeclareVariable(optix::float3, sky_frame_w, , );
+
+rtTextureSampler<float4, 2> sky_texture;
+rtBuffer<float, 1>          sky_marginal_cdf;      // height + 1 entries
+rtBuffer<float, 2>          sky_conditional_cdf;   // ( width + 1 ) x height
+
+
+static __device__ __inline__ optix::float2 skyTexcoord( const optix::float3& direction )
+{
+  using namespace optix;
+
+  const float x = dot( direction, sky_frame_u );
+  const float y = dot( direction, sky_frame_v );
+  const float z = dot( direction, sky_frame_w );
+  const float phi   = atan2f( y, x );
+  const float theta = acosf( fminf( fmaxf( z, -1.0f ), 1.0f ) );
+  return make_float2( phi * ( 0.5f * M_1_PIf ) + 0.5f, theta * M_1_PIf );
+}
+
+
+static __device__ __inline__ optix::float3 skyTextureLookup( const optix::float3& direction )
+{
+  const optix::float2 uv = skyTexcoord( direction );
+  return optix::make_float3( tex2D( sky_texture, uv.x, uv.y ) );
+}
+
+
+// Index i with cdf[i] <= x < cdf[i + 1] among the n intervals of a CDF
+template<typename CdfAccess>
+static __device__ __inline__ unsigned int skyFindInterval( CdfAccess cdf, unsigned int n, float x )
+{
+  unsigned int first = 0u;
+  unsigned int last  = n;
+  while( last - first > 1u ) {
+    const unsigned int middle = ( first + last ) / 2u;
+    if( cdf( middle ) <= x )
+      first = middle;
+    else
+      last = middle;
+  }
+  return first;
+}
+
+
+struct SkyMarginalCdf
+{
+  __device__ __inline__ float operator()( unsigned int i ) const { return sky_marginal_cdf[i]; }
+};
+
+struct SkyConditionalCdf
+{
+  unsigned int row;
+  __device__ __inline__ float operator()( unsigned int i ) const { return sky_conditional_cdf[optix::make_uint2( i, row )]; }
+};
+
+
+// Pick a direction proportional to the baked sky luminance from two uniform numbers in [0, 1).
+// Returns the direction and its solid angle density in pdf.
+static __device__ __inline__ optix::float3 sampleSkyTexture( const optix::float2& sample, float& pdf )
+{
+  using namespace optix;
+
+  const unsigned int height = static_cast<unsigned int>( sky_conditional_cdf.size().y );
+  const unsigned int width  = static_cast<unsigned int>( sky_conditional_cdf.size().x ) - 1u;
+
+  const unsigned int j = skyFindInterval( SkyMarginalCdf(), height, sample.y );
+  const float row_lo = sky_marginal_cdf[j];
+  const float row_p  = sky_marginal_cdf[j + 1] - row_lo;
+
+  SkyConditionalCdf conditional;
+  conditional.row = j;
+  const unsigned int i = skyFindInterval( conditional, width, sample.x );
+  const float col_lo = conditional( i );
+  const float col_p  = conditional( i + 1 ) - col_lo;
+
+  // Place the sample inside the texel by the remaining fraction of the numbers
+  const float du = col_p > 0.0f ? ( sample.x - col_lo ) / col_p : 0.5f;
+  const float dv = row_p > 0.0f ? ( sample.y - row_lo ) / row_p : 0.5f;
+  const float u = ( i + fminf( du, 1.0f ) ) / width;
+  const float v = ( j + fminf( dv, 1.0f ) ) / height;
+
+  const float phi   = 2.0f * M_PIf * ( u - 0.5f );
+  const float theta = M_PIf * v;
+  const float sin_theta = sinf( theta );
+
+  // Density over the unit square divided by the jacobian 2 pi^2 sin( theta ) of the lat-long map
+  const float pdf_uv = row_p * col_p * width * height;
+  pdf = sin_theta > 0.0f ? pdf_uv / ( 2.0f * M_PIf * M_PIf * sin_theta ) : 0.0f;
+
+  return ( cosf( phi ) * sky_frame_u + sinf( phi ) * sky_frame_v ) * sin_theta + cosf( theta ) * sky_frame_w;
+}
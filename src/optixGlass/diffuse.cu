@@ -31,15 +31,17 @@
 #include "helpers.h"
 #include "prd.h"
 #include "random.h"
+#include "intersection_refinement.h"
+#include "guiding.h"
 
 using namespace optix;
 
 rtDeclareVariable( float3, shading_normal, attribute shading_normal, ); 
 rtDeclareVariable( float3, geometric_normal, attribute geometric_normal, );
-rtDeclareVariable( float3, front_hit_point, attribute front_hit_point, );
 rtDeclareVariable( float3, texcoord, attribute texcoord, );
 
 rtDeclareVariable(optix::Ray, ray,   rtCurrentRay, );
+rtDeclareVariable( float, t_hit, rtIntersectionDistance, );
 rtDeclareVariable(PerRayData_radiance, prd_radiance, rtPayload, );
 
 rtTextureSampler<float4, 2> Kd_map;
@@ -52,20 +54,45 @@ RT_PROGRAM void closest_hit_radiance()
     const float3 world_geometric_normal = normalize( rtTransformNormal( RT_OBJECT_TO_WORLD, geometric_normal ) );
     const float3 ffnormal = faceforward( world_shading_normal, -ray.direction, world_geometric_normal );
 
+    const float3 hit_point = ray.origin + t_hit * ray.direction;
+    const float3 fhp = offset_ray( hit_point, faceforward( world_geometric_normal, -ray.direction, world_geometric_normal ) );
+
+    // Choose between the guide and the cosine lobe, the mixture of both pdfs is the balance heuristic
+    const unsigned int cell = guide_cell( hit_point );
+    const float guide_p = guide_valid( cell ) ? guide_probability : 0.0f;
+
     const float z1 = rnd( prd_radiance.seed );
     const float z2 = rnd( prd_radiance.seed );
     
     float3 w_in;
-    optix::cosine_sample_hemisphere( z1, z2, w_in );
-    const optix::Onb onb( ffnormal );
-    onb.inverse_transform( w_in );
-    const float3 fhp = rtTransformPoint( RT_OBJECT_TO_WORLD, front_hit_point );
+    if( rnd( prd_radiance.seed ) < guide_p ) {
+        w_in = guide_direction( guide_sample( cell, rnd( prd_radiance.seed ) ), z1, z2 );
+    } else {
+        optix::cosine_sample_hemisphere( z1, z2, w_in );
+        const optix::Onb onb( ffnormal );
+        onb.inverse_transform( w_in );
+    }
+
+    const float cos_in = dot( w_in, ffnormal );
+    if( cos_in <= 0.0f ) {
+        // Guided direction below the surface, which the diffuse BSDF doesn't scatter into
+        prd_radiance.reflectance = make_float3( 0.0f );
+        prd_radiance.done = true;
+        return;
+    }
 
-    prd_radiance.origin = front_hit_point;
+    const float bsdf_pdf = cos_in * M_1_PIf;
+    const float pdf = ( 1.0f - guide_p ) * bsdf_pdf + ( guide_p > 0.0f ? guide_p * guide_pdf( cell, w_in ) : 0.0f );
+
+    prd_radiance.origin = fhp;
     prd_radiance.direction = w_in;
+
+    prd_radiance.guide_cell = static_cast<int>( cell );
+    prd_radiance.guide_bin  = static_cast<int>( guide_bin( w_in ) );
+    prd_radiance.guide_pdf  = pdf;
     
     const float3 Kd = make_float3( tex2D( Kd_map, texcoord.x / Kd_map_scale.x, texcoord.y / Kd_map_scale.y ) );
-    prd_radiance.reflectance *= Kd;
+    prd_radiance.reflectance *= Kd * ( bsdf_pdf / pdf );
 
 }
 
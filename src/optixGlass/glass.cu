@@ -30,12 +30,12 @@
 #include <optixu/optixu_math_namespace.h>
 #include "prd.h"
 #include "random.h"
+#include "intersection_refinement.h"
 
 using namespace optix;
 
 rtDeclareVariable(float3, shading_normal, attribute shading_normal, ); 
-rtDeclareVariable(float3, front_hit_point, attribute front_hit_point, );
-rtDeclareVariable(float3, back_hit_point, attribute back_hit_point, );
+rtDeclareVariable(float3, geometric_normal, attribute geometric_normal, ); 
 
 rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
 rtDeclareVariable(float, t_hit, rtIntersectionDistance, );
@@ -71,6 +71,13 @@ RT_PROGRAM void closest_hit_radiance()
 {
     const float3 w_out = -ray.direction;
     float3 normal = normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, shading_normal));
+
+    // Continuation ray origins on the side of the incoming ray and behind the surface
+    const float3 hit_point = ray.origin + t_hit * ray.direction;
+    float3 world_geometric_normal = normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, geometric_normal));
+    world_geometric_normal = faceforward(world_geometric_normal, w_out, world_geometric_normal);
+    const float3 fhp = offset_ray(hit_point,  world_geometric_normal);
+    const float3 bhp = offset_ray(hit_point, -world_geometric_normal);
     float cos_theta_i = optix::dot( w_out, normal );
 
     float eta;
@@ -100,14 +107,12 @@ RT_PROGRAM void closest_hit_radiance()
     if( z <= R ) {
         // Reflect
         const float3 w_in = optix::reflect( -w_out, normal ); 
-        const float3 fhp = rtTransformPoint(RT_OBJECT_TO_WORLD, front_hit_point);
         prd_radiance.origin = fhp;
         prd_radiance.direction = w_in; 
         prd_radiance.reflectance *= reflection_color*transmittance;
     } else {
         // Refract
         const float3 w_in = w_t;
-        const float3 bhp = rtTransformPoint(RT_OBJECT_TO_WORLD, back_hit_point);
         prd_radiance.origin = bhp;
         prd_radiance.direction = w_in; 
         prd_radiance.reflectance *= refraction_color*transmittance;
@@ -0,0 +1,67 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include "guiding.h"
+
+rtDeclareVariable( unsigned int, cell, rtLaunchIndex, );
+
+// 1D launch over the cells at the end of a training pass.  Replaces the CDF of each cell with the
+// normalized training histogram and clears the training data for the next pass.
+RT_PROGRAM void guide_build()
+{
+    const unsigned int training = cell * GUIDE_RECORD;
+    const unsigned int base     = cell * GUIDE_BINS;
+
+    float sum = 0.0f;
+    for( unsigned int i = 0; i < GUIDE_BINS; ++i )
+        sum += guide_training[training + i];
+
+    if( guide_training[training + GUIDE_BINS] < GUIDE_MIN_SAMPLES || !( sum > 0.0f ) )
+    {
+        for( unsigned int i = 0; i < GUIDE_BINS; ++i )
+            guide_cdf[base + i] = 0.0f;
+    }
+    else
+    {
+        const float uniform = sum * ( GUIDE_UNIFORM / GUIDE_BINS );
+        const float scale   = 1.0f / ( sum * ( 1.0f + GUIDE_UNIFORM ) );
+
+        float cdf = 0.0f;
+        for( unsigned int i = 0; i < GUIDE_BINS; ++i )
+        {
+            cdf += ( guide_training[training + i] + uniform ) * scale;
+            guide_cdf[base + i] = cdf;
+        }
+        guide_cdf[base + GUIDE_BINS - 1] = 1.0f; // Exact, guide_sample() must never run past the last bin
+    }
+
+    for( unsigned int i = 0; i < GUIDE_RECORD; ++i )
+        guide_training[training + i] = 0.0f;
+}
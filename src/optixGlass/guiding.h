@@ -0,0 +1,139 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Path guiding for the diffuse ground: a uniform grid over the scene with a histogram of the incident
+// radiance over the sphere of directions per cell.  The ray generation program records the radiance
+// each completed path brought back to its diffuse vertices into guide_training, guide_build() turns
+// the training data into a CDF per cell after each training pass of doubling length, and the diffuse
+// closest hit program draws its continuation directions from that CDF or the cosine lobe, weighted by
+// the one-sample balance heuristic.  This finds the few directions through the glass which carry the
+// light of the caustics much sooner than the cosine lobe alone.
+
+// Cells along the largest extent of the guided bounds, the others get the same cell size
+#define GUIDE_GRID_RES 32
+
+// Directional bins of the cylindrical equal area mapping: cos(theta) rows times phi columns
+#define GUIDE_BINS_Z   8
+#define GUIDE_BINS_PHI 16
+#define GUIDE_BINS     ( GUIDE_BINS_Z * GUIDE_BINS_PHI )
+
+// Training floats per cell: the radiance per bin and the number of samples
+#define GUIDE_RECORD   ( GUIDE_BINS + 1 )
+
+// Cells with fewer training samples in a pass are not guided in the next one
+#define GUIDE_MIN_SAMPLES 64.0f
+
+// Fraction of the cell's radiance spread uniformly over all bins, so rarely sampled directions keep a pdf
+#define GUIDE_UNIFORM 0.1f
+
+// Diffuse vertices per path which are recorded for training
+#define GUIDE_MAX_VERTICES 12
+
+#if defined( __CUDACC__ )
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+rtDeclareVariable( int,    guide_train, , );         // 1 if the paths record training data
+rtDeclareVariable( int,    guide_enabled, , );       // 1 once guide_build() ran on training data
+rtDeclareVariable( float,  guide_probability, , );   // Probability to sample the guide instead of the cosine lobe
+rtDeclareVariable( float3, guide_min, , );
+rtDeclareVariable( float3, guide_inv_cell_size, , );
+rtDeclareVariable( int3,   guide_res, , );
+
+rtBuffer<float> guide_training;  // GUIDE_RECORD per cell, accumulated during a training pass
+rtBuffer<float> guide_cdf;       // GUIDE_BINS per cell, all zero for cells which are not guided
+
+static __device__ __inline__ unsigned int guide_cell( const optix::float3& p )
+{
+    using namespace optix;
+
+    const float3 c = ( p - guide_min ) * guide_inv_cell_size;
+    const int x = clamp( static_cast<int>( c.x ), 0, guide_res.x - 1 );
+    const int y = clamp( static_cast<int>( c.y ), 0, guide_res.y - 1 );
+    const int z = clamp( static_cast<int>( c.z ), 0, guide_res.z - 1 );
+    return static_cast<unsigned int>( ( z * guide_res.y + y ) * guide_res.x + x );
+}
+
+static __device__ __inline__ unsigned int guide_bin( const optix::float3& w )
+{
+    const int z   = min( static_cast<int>( ( w.z + 1.0f ) * 0.5f * GUIDE_BINS_Z ), GUIDE_BINS_Z - 1 );
+    const float u = ( atan2f( w.y, w.x ) + M_PIf ) * ( 0.5f * M_1_PIf );
+    const int phi = min( static_cast<int>( u * GUIDE_BINS_PHI ), GUIDE_BINS_PHI - 1 );
+    return static_cast<unsigned int>( max( z, 0 ) * GUIDE_BINS_PHI + max( phi, 0 ) );
+}
+
+// Uniformly distributed direction inside the bin for u1, u2 in [0, 1)
+static __device__ __inline__ optix::float3 guide_direction( unsigned int bin, float u1, float u2 )
+{
+    const float z   = -1.0f + 2.0f * ( static_cast<float>( bin / GUIDE_BINS_PHI ) + u1 ) / GUIDE_BINS_Z;
+    const float phi = 2.0f * M_PIf * ( static_cast<float>( bin % GUIDE_BINS_PHI ) + u2 ) / GUIDE_BINS_PHI - M_PIf;
+    const float r   = sqrtf( fmaxf( 0.0f, 1.0f - z * z ) );
+    return optix::make_float3( r * cosf( phi ), r * sinf( phi ), z );
+}
+
+static __device__ __inline__ bool guide_valid( unsigned int cell )
+{
+    return guide_enabled && guide_cdf[cell * GUIDE_BINS + GUIDE_BINS - 1] > 0.0f;
+}
+
+// Solid angle pdf of sampling w with guide_sample() and guide_direction(). All bins cover the same solid angle.
+static __device__ __inline__ float guide_pdf( unsigned int cell, const optix::float3& w )
+{
+    const unsigned int base = cell * GUIDE_BINS;
+    const unsigned int bin  = guide_bin( w );
+    const float p = guide_cdf[base + bin] - ( bin > 0 ? guide_cdf[base + bin - 1] : 0.0f );
+    return p * ( GUIDE_BINS * 0.25f * M_1_PIf );
+}
+
+static __device__ __inline__ unsigned int guide_sample( unsigned int cell, float u )
+{
+    const unsigned int base = cell * GUIDE_BINS;
+    unsigned int lo = 0;
+    unsigned int hi = GUIDE_BINS - 1;
+    while( lo < hi )
+    {
+        const unsigned int mid = ( lo + hi ) >> 1;
+        if( u < guide_cdf[base + mid] )
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+// Adds the radiance which arrived from a direction in bin, divided by the pdf that direction was sampled with
+static __device__ __inline__ void guide_record( unsigned int cell, unsigned int bin, float radiance )
+{
+    atomicAdd( &guide_training[cell * GUIDE_RECORD + bin], radiance );
+    atomicAdd( &guide_training[cell * GUIDE_RECORD + GUIDE_BINS], 1.0f );
+}
+
+#endif // __CUDACC__
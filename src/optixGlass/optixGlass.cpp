@@ -50,9 +50,12 @@
 #include <Camera.h>
 #include <OptiXMesh.h>
 
+#include "guiding.h"
+
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw_gl2.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -64,6 +67,10 @@ const char* const SAMPLE_NAME = "optixGlass";
 const unsigned int WIDTH  = 768u;
 const unsigned int HEIGHT = 576u;
 const float3 DEFAULT_TRANSMITTANCE = make_float3( 0.1f, 0.63f, 0.3f );
+const double DISPLAY_INTERVAL = 1.0 / 60.0;  // Seconds of accumulation per displayed frame with --display-tonemap
+const double IDLE_WAIT = 0.1;  // Seconds to block for input once converged
+const float GROUND_SCALE = 3.0f;  // Ground plane size relative to the meshes
+const unsigned int GUIDE_MAX_PASS = 256u;  // Frames of the longest guiding training pass
 
 //------------------------------------------------------------------------------
 //
@@ -73,6 +80,21 @@ const float3 DEFAULT_TRANSMITTANCE = make_float3( 0.1f, 0.63f, 0.3f );
 
 Context      context = 0;
 
+// Stop launching once this many samples per pixel have accumulated, 0 accumulates forever
+unsigned int max_spp = 0;
+
+// Stop launching after this many seconds of accumulation, 0 accumulates forever
+double       time_budget = 0.0;
+
+// Tonemap the accumulation buffer once per displayed frame instead of on every launch
+bool         display_tonemap = false;
+
+// Path guiding state, see guiding.h
+bool         guiding = true;
+unsigned int guide_cells = 0;
+unsigned int guide_pass_length = 1;  // Frames of the current training pass, doubles after each pass
+unsigned int guide_pass_frames = 0;
+
 
 //------------------------------------------------------------------------------
 //
@@ -116,16 +138,18 @@ void createContext( bool use_pbo )
     // Set up context
     context = Context::create();
     context->setRayTypeCount( 1 );
-    context->setEntryPointCount( 1 );
+    context->setEntryPointCount( 3 );
 
     // Note: this sample does not need a big stack size even with high ray depths, 
-    // because rays are not shot recursively.
-    context->setStackSize( 800 );
+    // because rays are not shot recursively. The guiding training vertices of the
+    // ray generation program live on the stack across the rtTrace calls.
+    context->setStackSize( 1400 );
 
     // Note: high max depth for reflection and refraction through glass
     context["max_depth"]->setInt( 10 );
     context["cutoff_color"]->setFloat( 0.2f, 0.2f, 0.2f );
     context["frame"]->setUint( 0u );
+    context["tonemap_output"]->setInt( display_tonemap ? 0 : 1 );
     context["scene_epsilon"]->setFloat( 1.e-3f );
 
     Buffer buffer = sutil::createOutputBuffer( context, RT_FORMAT_UNSIGNED_BYTE4, WIDTH, HEIGHT, use_pbo );
@@ -138,17 +162,24 @@ void createContext( bool use_pbo )
 
     // Ray generation program
     std::string ptx_path( ptxPath( "path_trace_camera.cu" ) );
-    Program ray_gen_program = context->createProgramFromPTXFile( ptx_path, "pinhole_camera" );
+    Program ray_gen_program = sutil::createProgramFromPTXFile( context, ptx_path, "pinhole_camera" );
     context->setRayGenerationProgram( 0, ray_gen_program );
 
+    // Tonemap pass, launched once per displayed frame with --display-tonemap
+    Program tonemap_program = sutil::createProgramFromPTXFile( context, ptx_path, "tonemap_accum" );
+    context->setRayGenerationProgram( 1, tonemap_program );
+
+    // Guiding distribution build, launched at the end of each training pass
+    context->setRayGenerationProgram( 2, sutil::createProgramFromPTXFile( context, ptxPath( "guiding.cu" ), "guide_build" ) );
+
     // Exception program
-    Program exception_program = context->createProgramFromPTXFile( ptx_path, "exception" );
+    Program exception_program = sutil::createProgramFromPTXFile( context, ptx_path, "exception" );
     context->setExceptionProgram( 0, exception_program );
     context["bad_color"]->setFloat( 1.0f, 0.0f, 1.0f );
 
     // Miss program
     ptx_path = ptxPath( "gradientbg.cu" );
-    context->setMissProgram( 0, context->createProgramFromPTXFile( ptx_path, "miss" ) );
+    context->setMissProgram( 0, sutil::createProgramFromPTXFile( context, ptx_path, "miss" ) );
     context["background_light"]->setFloat( 1.0f, 1.0f, 1.0f );
     context["background_dark"]->setFloat( 0.3f, 0.3f, 0.3f );
 
@@ -165,7 +196,7 @@ void createContext( bool use_pbo )
 Material createGlassMaterial( )
 {
     const std::string ptx_path = ptxPath( "glass.cu" );
-    Program ch_program = context->createProgramFromPTXFile( ptx_path, "closest_hit_radiance" );
+    Program ch_program = sutil::createProgramFromPTXFile( context, ptx_path, "closest_hit_radiance" );
 
     Material material = context->createMaterial();
     material->setClosestHitProgram( 0, ch_program );
@@ -188,7 +219,7 @@ Material createGlassMaterial( )
 Material createDiffuseMaterial()
 {
     const std::string ptx_path = ptxPath( "diffuse.cu" );
-    Program ch_program = context->createProgramFromPTXFile( ptx_path, "closest_hit_radiance" );
+    Program ch_program = sutil::createProgramFromPTXFile( context, ptx_path, "closest_hit_radiance" );
 
     Material material = context->createMaterial();
     material->setClosestHitProgram( 0, ch_program );
@@ -222,17 +253,20 @@ optix::Aabb createGeometry(
         GeometryGroup geometry_group = context->createGeometryGroup();
         geometry_group->setAcceleration( context->createAcceleration( "Trbvh" ) );
         top_group->addChild( geometry_group );
+        std::shared_ptr<OptiXMeshCache> mesh_cache;
         for (size_t i = 0; i < filenames.size(); ++i) {
 
             OptiXMesh mesh;
             mesh.context = context;
+            mesh.cache = mesh_cache;
             
             // override defaults
-            mesh.intersection = context->createProgramFromPTXFile( ptx_path, "mesh_intersect_refine" );
-            mesh.bounds = context->createProgramFromPTXFile( ptx_path, "mesh_bounds" );
+            mesh.intersection = sutil::createProgramFromPTXFile( context, ptx_path, "mesh_intersect" );
+            mesh.bounds = sutil::createProgramFromPTXFile( context, ptx_path, "mesh_bounds" );
             mesh.material = glass_material;
 
             loadMesh( filenames[i], mesh, xforms[i] ); 
+            mesh_cache = mesh.cache;
             geometry_group->addChild( mesh.geom_instance );
 
             aabb.include( mesh.bbox_min, mesh.bbox_max );
@@ -249,7 +283,7 @@ optix::Aabb createGeometry(
         geometry_group->setAcceleration( context->createAcceleration( "NoAccel" ) );
         top_group->addChild( geometry_group );
         const std::string floor_ptx = ptxPath( "parallelogram_iterative.cu" );
-        GeometryInstance instance = sutil::createOptiXGroundPlane( context, floor_ptx, aabb, ground_material, 3.0f );
+        GeometryInstance instance = sutil::createOptiXGroundPlane( context, floor_ptx, aabb, ground_material, GROUND_SCALE );
         geometry_group->addChild( instance );
     }
 
@@ -263,6 +297,109 @@ optix::Aabb createGeometry(
 
 
 
+//------------------------------------------------------------------------------
+//
+//  Path guiding
+//
+//------------------------------------------------------------------------------
+
+static void clearBuffer( Buffer buffer )
+{
+    RTsize size = 0;
+    buffer->getSize( size );
+    memset( buffer->map(), 0, size * buffer->getElementSize() );
+    buffer->unmap();
+}
+
+// Forgets the learned distributions, after changes of the materials or the scene
+void resetGuiding()
+{
+    clearBuffer( context["guide_training"]->getBuffer() );
+    clearBuffer( context["guide_cdf"]->getBuffer() );
+    context["guide_train"]->setInt( guiding ? 1 : 0 );
+    context["guide_enabled"]->setInt( 0 );
+    guide_pass_length = 1;
+    guide_pass_frames = 0;
+}
+
+// The grid covers the meshes and the ground plane in front of the camera, see createOptiXGroundPlane()
+void createGuiding( const optix::Aabb& aabb )
+{
+    const float ground = GROUND_SCALE * fmaxf( aabb.extent( 0 ), aabb.extent( 2 ) );
+    const float3 bounds_min = make_float3( aabb.center( 0 ) - 0.5f * ground, aabb.m_min.y - 0.01f * aabb.extent( 1 ), aabb.center( 2 ) - 0.5f * ground );
+    const float3 bounds_max = make_float3( aabb.center( 0 ) + 0.5f * ground, aabb.m_max.y, aabb.center( 2 ) + 0.5f * ground );
+    const float3 extent = bounds_max - bounds_min;
+
+    const float cell_size = fmaxf( fmaxf( extent.x, extent.y ), extent.z ) / GUIDE_GRID_RES;
+    const int3 res = make_int3( std::max( 1, static_cast<int>( ceilf( extent.x / cell_size ) ) ),
+                                std::max( 1, static_cast<int>( ceilf( extent.y / cell_size ) ) ),
+                                std::max( 1, static_cast<int>( ceilf( extent.z / cell_size ) ) ) );
+    guide_cells = static_cast<unsigned int>( res.x * res.y * res.z );
+
+    context["guide_min"]->setFloat( bounds_min );
+    context["guide_inv_cell_size"]->setFloat( make_float3( 1.0f / cell_size ) );
+    context["guide_res"]->setInt( res );
+    context["guide_probability"]->setFloat( 0.5f );
+    context["guide_training"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, guide_cells * GUIDE_RECORD ) );
+    context["guide_cdf"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, guide_cells * GUIDE_BINS ) );
+
+    resetGuiding();
+}
+
+// Called after each accumulation launch. The distribution built after a pass only changes the pdf
+// the next frames sample with, so the accumulation doesn't need to restart.
+void updateGuiding()
+{
+    if( !guiding || ++guide_pass_frames < guide_pass_length )
+        return;
+
+    context->launch( 2, guide_cells );
+    context["guide_enabled"]->setInt( 1 );
+    guide_pass_frames = 0;
+    guide_pass_length = std::min( guide_pass_length * 2u, GUIDE_MAX_PASS );
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  Progressive accumulation
+//
+//------------------------------------------------------------------------------
+
+bool accumulationConverged( unsigned int accumulation_frame, double accumulation_start )
+{
+    if( max_spp > 0 && accumulation_frame >= max_spp )
+        return true;
+    if( time_budget > 0.0 && accumulation_frame > 0 && sutil::currentTime() - accumulation_start >= time_budget )
+        return true;
+    return false;
+}
+
+
+void launchAccumulation( unsigned int width, unsigned int height, unsigned int& accumulation_frame, double accumulation_start )
+{
+    if( !display_tonemap )
+    {
+        context["frame"]->setUint( accumulation_frame++ );
+        context->launch( 0, width, height );
+        updateGuiding();
+        return;
+    }
+
+    // Fill the display interval with accumulation launches and tonemap only the last result
+    const double t0 = sutil::currentTime();
+    do
+    {
+        context["frame"]->setUint( accumulation_frame++ );
+        context->launch( 0, width, height );
+        updateGuiding();
+    }
+    while( sutil::currentTime() - t0 < DISPLAY_INTERVAL && !accumulationConverged( accumulation_frame, accumulation_start ) );
+
+    context->launch( 1, width, height );
+}
+
+
 //------------------------------------------------------------------------------
 //
 //  GLFW callbacks
@@ -371,6 +508,8 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
 
     unsigned int frame_count = 0;
     unsigned int accumulation_frame = 0;
+    double accumulation_start = 0.0;
+    bool converged = false;
     float3 glass_transmittance = DEFAULT_TRANSMITTANCE;
     float log_transmittance_depth = 0.0f;
     int max_depth = 10;
@@ -384,7 +523,11 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
     while( !glfwWindowShouldClose( window ) )
     {
 
-        glfwPollEvents();                                                        
+        // Once converged there is nothing left to launch, so block for input instead of spinning
+        if( converged )
+            glfwWaitEventsTimeout( IDLE_WAIT );
+        else
+            glfwPollEvents();
 
         ImGui_ImplGlfwGL2_NewFrame();
 
@@ -417,6 +560,7 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
 
             ImGui::SetNextWindowPos( ImVec2( 2.0f, 40.0f ) );
             ImGui::Begin("controls", 0, window_flags );
+            ImGui::Text( "%u spp%s", accumulation_frame, converged ? " (converged)" : "" );
             if ( ImGui::CollapsingHeader( "Controls", ImGuiTreeNodeFlags_DefaultOpen ) ) {
                 bool transmittance_changed = false;
                 if( ImGui::ColorEdit3("transmittance color", (float*)(&glass_transmittance.x)))
@@ -431,11 +575,13 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
                     const float t0 = expf(log_transmittance_depth);
                     const float3 extinction = -logf(glass_transmittance) / t0;
                     context["extinction"]->setFloat( extinction );
+                    resetGuiding();
                     accumulation_frame = 0;
                 }
                 
                 if (ImGui::SliderInt( "max depth", &max_depth, 1, 10 )) {
                     context["max_depth"]->setInt( max_depth );
+                    resetGuiding();
                     accumulation_frame = 0;
                 }
                 if (ImGui::Checkbox( "draw ground plane", &draw_ground ) ) {
@@ -446,6 +592,11 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
                         GeometryGroup geomgroup = top_group->getChild<GeometryGroup>( 0 );
                         context["top_object"]->set( geomgroup );
                     }
+                    resetGuiding();
+                    accumulation_frame = 0;
+                }
+                if (ImGui::Checkbox( "path guiding", &guiding ) ) {
+                    resetGuiding();
                     accumulation_frame = 0;
                 }
             }
@@ -456,8 +607,11 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
         ImGui::PopStyleVar( 3 );
 
         // Render main window
-        context["frame"]->setUint( accumulation_frame++ );
-        context->launch( 0, camera.width(), camera.height() );
+        if( accumulation_frame == 0 )
+            accumulation_start = sutil::currentTime();
+        if( !accumulationConverged( accumulation_frame, accumulation_start ) )
+            launchAccumulation( camera.width(), camera.height(), accumulation_frame, accumulation_start );
+        converged = accumulationConverged( accumulation_frame, accumulation_start );
         sutil::displayBufferGL( getOutputBuffer() );
 
         // Render gui over it
@@ -487,6 +641,10 @@ void printUsageAndExit( const std::string& argv0 )
         "  -h | --help                  Print this usage message and exit.\n"
         "  -f | --file <output_file>    Save image to file and exit.\n"
         "  -n | --nopbo                 Disable GL interop for display buffer.\n"
+        "  --max-spp <n>                Stop rendering after n samples per pixel.\n"
+        "  --time-budget <seconds>      Stop rendering after this many seconds of accumulation.\n"
+        "  --display-tonemap            Tonemap once per displayed frame instead of every launch.\n"
+        "  --no-guiding                 Sample the diffuse bounces from the cosine lobe only.\n"
         "App Keystrokes:\n"
         "  q  Quit\n"
         "  s  Save image to '" << SAMPLE_NAME << ".png'\n"
@@ -526,6 +684,32 @@ int main( int argc, char** argv )
         {
             use_pbo = false;
         }
+        else if( arg == "--max-spp" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            max_spp = static_cast<unsigned int>( std::max( atoi( argv[++i] ), 0 ) );
+        }
+        else if( arg == "--time-budget" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            time_budget = std::max( atof( argv[++i] ), 0.0 );
+        }
+        else if( arg == "--display-tonemap" )
+        {
+            display_tonemap = true;
+        }
+        else if( arg == "--no-guiding" )
+        {
+            guiding = false;
+        }
         else if( arg[0] == '-' )
         {
             std::cerr << "Unknown option '" << arg << "'\n";
@@ -568,6 +752,7 @@ int main( int argc, char** argv )
         Material ground_material = createDiffuseMaterial();
         optix::Group top_group;
         const optix::Aabb aabb = createGeometry( mesh_files, mesh_xforms, glass_material, ground_material, top_group );
+        createGuiding( aabb );
 
         // Note: lighting comes from miss program
 
@@ -592,7 +777,10 @@ int main( int argc, char** argv )
             for ( unsigned int frame = 0; frame < numframes; ++frame ) {
                 context["frame"]->setUint( frame );
                 context->launch( 0, WIDTH, HEIGHT );
+                updateGuiding();
             }
+            if( display_tonemap )
+                context->launch( 1, WIDTH, HEIGHT );
             sutil::writeBufferToFile( out_file.c_str(), getOutputBuffer() );
             std::cerr << "Wrote " << out_file << std::endl;
             destroyContext();
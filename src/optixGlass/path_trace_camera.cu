@@ -31,6 +31,7 @@
 #include "helpers.h"
 #include "prd.h"
 #include "random.h"
+#include "guiding.h"
 
 using namespace optix;
 
@@ -47,6 +48,7 @@ rtBuffer<uchar4, 2>              output_buffer;
 rtBuffer<float4, 2>              accum_buffer;
 rtDeclareVariable(rtObject,      top_object, , );
 rtDeclareVariable(unsigned int,  frame, , );
+rtDeclareVariable(int,           tonemap_output, , );
 rtDeclareVariable(uint2,         launch_index, rtLaunchIndex, );
 
 
@@ -83,15 +85,37 @@ RT_PROGRAM void pinhole_camera()
 
   float3 result = make_float3( 0.0f );
 
+  // Diffuse vertices for the guiding training: what the path gathered up to the vertex and the throughput after it
+  int    guide_cells[GUIDE_MAX_VERTICES];
+  int    guide_bins[GUIDE_MAX_VERTICES];
+  float  guide_pdfs[GUIDE_MAX_VERTICES];
+  float3 guide_results[GUIDE_MAX_VERTICES];
+  float3 guide_throughputs[GUIDE_MAX_VERTICES];
+  int    guide_vertices = 0;
+
+  // The closest hit programs offset the continuation ray origins with offset_ray(),
+  // so only the primary ray needs the scene_epsilon.
+  float tmin = scene_epsilon;
+
   // Main render loop. This is not recursive, and for high ray depths
   // will generally perform better than tracing radiance rays recursively
   // in closest hit programs.
   for(;;) {
-      optix::Ray ray(ray_origin, ray_direction, /*ray type*/ 0, scene_epsilon );
+      optix::Ray ray(ray_origin, ray_direction, /*ray type*/ 0, tmin );
+      prd.guide_cell = -1;
       rtTrace(top_object, ray, prd);
 
       result += prd.reflectance * prd.radiance;
 
+      if( guide_train && prd.guide_cell >= 0 && guide_vertices < GUIDE_MAX_VERTICES ) {
+          guide_cells[guide_vertices]       = prd.guide_cell;
+          guide_bins[guide_vertices]        = prd.guide_bin;
+          guide_pdfs[guide_vertices]        = prd.guide_pdf;
+          guide_results[guide_vertices]     = result;
+          guide_throughputs[guide_vertices] = prd.reflectance;
+          ++guide_vertices;
+      }
+
       if ( prd.done ) {
           break;
       } else if ( prd.depth >= max_depth ) {
@@ -104,6 +128,18 @@ RT_PROGRAM void pinhole_camera()
       // Update ray data for the next path segment
       ray_origin = prd.origin;
       ray_direction = prd.direction;
+      tmin = 0.0f;
+  }
+
+  // Everything gathered after a vertex, divided by the throughput up to it, arrived along its continuation direction
+  for( int i = 0; i < guide_vertices; ++i ) {
+      const float3 throughput = guide_throughputs[i];
+      const float3 gathered   = result - guide_results[i];
+      const float  radiance   = luminance( make_float3( throughput.x > 0.0f ? gathered.x / throughput.x : 0.0f,
+                                                        throughput.y > 0.0f ? gathered.y / throughput.y : 0.0f,
+                                                        throughput.z > 0.0f ? gathered.z / throughput.z : 0.0f ) );
+      if( radiance > 0.0f && isfinite( radiance ) )
+          guide_record( guide_cells[i], guide_bins[i], radiance / guide_pdfs[i] );
   }
 
   float4 acc_val = accum_buffer[launch_index];
@@ -112,10 +148,18 @@ RT_PROGRAM void pinhole_camera()
   } else {
     acc_val = make_float4( result, 0.f );
   }
-  output_buffer[launch_index] = make_color( make_float3( acc_val ) );
+  // Display rate tonemapping leaves the output buffer to the tonemap_accum pass
+  if( tonemap_output )
+    output_buffer[launch_index] = make_color( make_float3( acc_val ) );
   accum_buffer[launch_index] = acc_val;
 }
 
+RT_PROGRAM void tonemap_accum()
+{
+  const float4 acc_val = accum_buffer[launch_index];
+  output_buffer[launch_index] = make_color( make_float3( acc_val ) );
+}
+
 RT_PROGRAM void exception()
 {
   const unsigned int code = rtGetExceptionCode();
@@ -42,6 +42,11 @@ struct PerRayData_radiance
   float3 origin;
   float3 direction;
 
+  // Path guiding training record of the continuation direction, guide_cell < 0 if there is none
+  int   guide_cell;
+  int   guide_bin;
+  float guide_pdf;
+
 };
 
 
@@ -30,9 +30,23 @@
  * optixHello.cpp -- Renders a solid green image.
  *
  * A filename can be given on the command line to write the results to file. 
+ *
+ * With --benchmark the trivial kernel is used to measure the fixed OptiX overheads instead:
+ * launch latency over a range of launch sizes, map()/unmap() of a host and a GL interop
+ * output buffer, the resize sequence of the interactive samples and variable updates.
  */
 
+#ifndef __APPLE__
+#  include <GL/glew.h>
+#  if defined( _WIN32 )
+#    include <GL/wglew.h>
+#  endif
+#endif
+
+#include <GLFW/glfw3.h>
+
 #include <optix.h>
+#include <optix_gl_interop.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -40,6 +54,7 @@
 
 
 void printUsageAndExit( const char* argv0 );
+void runBenchmark( RTcontext context, RTbuffer buffer, RTvariable result_buffer, RTvariable draw_color, int iterations );
 
 
 int main(int argc, char* argv[])
@@ -61,6 +76,7 @@ int main(int argc, char* argv[])
 
         int width  = 512u;
         int height = 384u;
+        int benchmark_iterations = 0; /* 0 == display or write the image */
         int i;
 
         outfile[0] = '\0';
@@ -79,6 +95,13 @@ int main(int argc, char* argv[])
             } else if ( strncmp( argv[i], "--dim=", 6 ) == 0 ) {
                 const char *dims_arg = &argv[i][6];
                 sutil::parseDimensions( dims_arg, width, height );
+            } else if( strcmp( argv[i], "--benchmark" ) == 0 || strcmp( argv[i], "-b" ) == 0 ) {
+                if( benchmark_iterations == 0 )
+                    benchmark_iterations = 200;
+            } else if ( strncmp( argv[i], "--iterations=", 13 ) == 0 ) {
+                benchmark_iterations = atoi( &argv[i][13] );
+                if( benchmark_iterations <= 0 )
+                    printUsageAndExit( argv[0] );
             } else {
                 fprintf( stderr, "Unknown option '%s'\n", argv[i] );
                 printUsageAndExit( argv[0] );
@@ -107,7 +130,9 @@ int main(int argc, char* argv[])
         RT_CHECK_ERROR( rtContextLaunch2D( context, 0 /* entry point */, width, height ) );
 
         /* Display image */
-        if( strlen( outfile ) == 0 ) {
+        if( benchmark_iterations > 0 ) {
+            runBenchmark( context, buffer, result_buffer, draw_color, benchmark_iterations );
+        } else if( strlen( outfile ) == 0 ) {
             sutil::displayBufferGLFW( argv[0], buffer );
         } else {
             sutil::writeBufferToFile( outfile, buffer );
@@ -130,7 +155,181 @@ void printUsageAndExit( const char* argv0 )
   fprintf( stderr, "Options: --file | -f <filename>      Specify file for image output\n" );
   fprintf( stderr, "         --help | -h                 Print this usage message\n" );
   fprintf( stderr, "         --dim=<width>x<height>      Set image dimensions; defaults to 512x384\n" );
+  fprintf( stderr, "         --benchmark | -b            Measure the fixed launch, buffer and variable overheads and exit\n" );
+  fprintf( stderr, "         --iterations=<n>            Timed calls per benchmark measurement; defaults to 200\n" );
   exit(1);
 }
 
 
+
+
+/*
+ * Benchmark mode
+ *
+ * Every measurement prints one line
+ *   BENCHMARK optixHello <measurement> <width>x<height> iterations=<n> us_per_call=<microseconds>
+ * Launches are synchronous, so the launch timings include the kernel run time of the trivial kernel,
+ * which stays far below the fixed overheads at the small sizes.
+ */
+
+static void printResult( const char* measurement, int width, int height, int iterations, double seconds )
+{
+    printf( "BENCHMARK optixHello %s %dx%d iterations=%d us_per_call=%.3f\n",
+            measurement, width, height, iterations, seconds * 1.0e6 / iterations );
+    fflush( stdout );
+}
+
+static void benchmarkLaunch( RTcontext context, const char* measurement, int width, int height, int iterations )
+{
+    double t0;
+    int i;
+
+    RT_CHECK_ERROR( rtContextLaunch2D( context, 0, width, height ) ); /* Excludes the allocation after a resize */
+
+    t0 = sutil::currentTime();
+    for( i = 0; i < iterations; ++i )
+        RT_CHECK_ERROR( rtContextLaunch2D( context, 0, width, height ) );
+    printResult( measurement, width, height, iterations, sutil::currentTime() - t0 );
+}
+
+/* Only the map() and unmap() calls are timed, each after a launch which made the device copy dirty */
+static void benchmarkMap( RTcontext context, RTbuffer buffer, const char* measurement, int width, int height, int iterations )
+{
+    double seconds = 0.0;
+    double t0;
+    void* data;
+    int i;
+
+    for( i = 0; i < iterations; ++i ) {
+        RT_CHECK_ERROR( rtContextLaunch2D( context, 0, width, height ) );
+        t0 = sutil::currentTime();
+        RT_CHECK_ERROR( rtBufferMap( buffer, &data ) );
+        RT_CHECK_ERROR( rtBufferUnmap( buffer ) );
+        seconds += sutil::currentTime() - t0;
+    }
+    printResult( measurement, width, height, iterations, seconds );
+}
+
+/* Resizes between the two sizes like a window resize and launches, which allocates the new size */
+static void benchmarkResize( RTcontext context, RTbuffer buffer, int interop, int width, int height, int iterations )
+{
+    double t0;
+    int i;
+
+    t0 = sutil::currentTime();
+    for( i = 0; i < iterations; ++i ) {
+        const int w = ( i & 1 ) ? width  : width  / 2;
+        const int h = ( i & 1 ) ? height : height / 2;
+        if( interop ) {
+            /* Same sequence as Application::reshape() in the introduction samples */
+            unsigned int glbo = 0;
+            RT_CHECK_ERROR( rtBufferGLUnregister( buffer ) );
+            RT_CHECK_ERROR( rtBufferGetGLBOId( buffer, &glbo ) );
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, glbo );
+            glBufferData( GL_PIXEL_UNPACK_BUFFER, sizeof( float ) * 4 * w * h, 0, GL_STREAM_DRAW );
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+            RT_CHECK_ERROR( rtBufferGLRegister( buffer ) );
+        }
+        RT_CHECK_ERROR( rtBufferSetSize2D( buffer, w, h ) );
+        RT_CHECK_ERROR( rtContextLaunch2D( context, 0, w, h ) );
+    }
+    printResult( interop ? "resize_launch_interop" : "resize_launch_host", width, height, iterations, sutil::currentTime() - t0 );
+}
+
+static void benchmarkRegister( RTbuffer buffer, int width, int height, int iterations )
+{
+    double t0;
+    int i;
+
+    t0 = sutil::currentTime();
+    for( i = 0; i < iterations; ++i ) {
+        RT_CHECK_ERROR( rtBufferGLUnregister( buffer ) );
+        RT_CHECK_ERROR( rtBufferGLRegister( buffer ) );
+    }
+    printResult( "unregister_register_interop", width, height, iterations, sutil::currentTime() - t0 );
+}
+
+/* The launches after a changed variable also measure how much the update costs at launch time */
+static void benchmarkVariable( RTcontext context, RTvariable draw_color, int width, int height, int iterations )
+{
+    double t0;
+    int i;
+
+    t0 = sutil::currentTime();
+    for( i = 0; i < iterations; ++i )
+        RT_CHECK_ERROR( rtVariableSet3f( draw_color, 0.462f, 0.725f, ( i & 1 ) ? 1.0f : 0.0f ) );
+    printResult( "variable_set", width, height, iterations, sutil::currentTime() - t0 );
+
+    t0 = sutil::currentTime();
+    for( i = 0; i < iterations; ++i ) {
+        RT_CHECK_ERROR( rtVariableSet3f( draw_color, 0.462f, 0.725f, ( i & 1 ) ? 1.0f : 0.0f ) );
+        RT_CHECK_ERROR( rtContextLaunch2D( context, 0, width, height ) );
+    }
+    printResult( "variable_set_launch", width, height, iterations, sutil::currentTime() - t0 );
+
+    RT_CHECK_ERROR( rtVariableSet3f( draw_color, 0.462f, 0.725f, 0.0f ) );
+}
+
+void runBenchmark( RTcontext context, RTbuffer buffer, RTvariable result_buffer, RTvariable draw_color, int iterations )
+{
+    static const int sizes[][2] = { { 1, 1 }, { 64, 64 }, { 256, 256 }, { 512, 384 }, { 1024, 768 }, { 1920, 1080 }, { 3840, 2160 } };
+    static const int num_sizes  = sizeof( sizes ) / sizeof( sizes[0] );
+
+    RTbuffer interop_buffer = 0;
+    unsigned int glbo = 0;
+    int s;
+
+#ifndef __APPLE__
+    if( glewInit() != GLEW_OK ) {
+        fprintf( stderr, "GLEW init failed, skipping the interop measurements\n" );
+    } else
+#endif
+    {
+        glGenBuffers( 1, &glbo );
+        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, glbo );
+        glBufferData( GL_PIXEL_UNPACK_BUFFER, sizeof( float ) * 4, 0, GL_STREAM_DRAW );
+        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+        RT_CHECK_ERROR( rtBufferCreateFromGLBO( context, RT_BUFFER_OUTPUT, glbo, &interop_buffer ) );
+        RT_CHECK_ERROR( rtBufferSetFormat( interop_buffer, RT_FORMAT_FLOAT4 ) );
+        RT_CHECK_ERROR( rtBufferSetSize2D( interop_buffer, 1, 1 ) );
+    }
+
+    for( s = 0; s < num_sizes; ++s ) {
+        const int width  = sizes[s][0];
+        const int height = sizes[s][1];
+
+        RT_CHECK_ERROR( rtVariableSetObject( result_buffer, buffer ) );
+        RT_CHECK_ERROR( rtBufferSetSize2D( buffer, width, height ) );
+        benchmarkLaunch( context, "launch_host", width, height, iterations );
+        benchmarkMap( context, buffer, "map_unmap_host", width, height, iterations );
+
+        if( interop_buffer ) {
+            RT_CHECK_ERROR( rtVariableSetObject( result_buffer, interop_buffer ) );
+            RT_CHECK_ERROR( rtBufferGLUnregister( interop_buffer ) );
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, glbo );
+            glBufferData( GL_PIXEL_UNPACK_BUFFER, sizeof( float ) * 4 * width * height, 0, GL_STREAM_DRAW );
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+            RT_CHECK_ERROR( rtBufferGLRegister( interop_buffer ) );
+            RT_CHECK_ERROR( rtBufferSetSize2D( interop_buffer, width, height ) );
+            benchmarkLaunch( context, "launch_interop", width, height, iterations );
+            benchmarkMap( context, interop_buffer, "map_unmap_interop", width, height, iterations );
+        }
+    }
+
+    /* The per resize and per frame costs at the default window size of the samples */
+    RT_CHECK_ERROR( rtVariableSetObject( result_buffer, buffer ) );
+    benchmarkResize( context, buffer, 0, 1024, 768, iterations );
+    RT_CHECK_ERROR( rtBufferSetSize2D( buffer, 1024, 768 ) );
+    benchmarkVariable( context, draw_color, 1024, 768, iterations );
+
+    if( interop_buffer ) {
+        RT_CHECK_ERROR( rtVariableSetObject( result_buffer, interop_buffer ) );
+        benchmarkResize( context, interop_buffer, 1, 1024, 768, iterations );
+        benchmarkRegister( interop_buffer, 1024, 768, iterations );
+
+        RT_CHECK_ERROR( rtVariableSetObject( result_buffer, buffer ) );
+        RT_CHECK_ERROR( rtBufferDestroy( interop_buffer ) );
+        glDeleteBuffers( 1, &glbo );
+    }
+}
@@ -0,0 +1,75 @@
+#
+# Copyright (c) 2016-2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Script run by the benchmark_intro target with "cmake -P".
+# Inputs: EXECUTABLES ('|' separated), WIDTH, HEIGHT, ITERATIONS.
+# Each executable prints one line of the form
+# "BENCHMARK <name> <width>x<height> iterations=<n> positions=<n> initScene_ms=<f> ms_per_iteration=<f> Msamples_per_second=<f>"
+# optixIntro_10 built with USE_RAY_COUNTERS appends "Mrays_per_second=<f>" from its device ray counters (radiance plus shadow rays).
+# Without them, and for the other samples, the Mrays/s column stays "-".
+
+string(REPLACE "|" ";" EXECUTABLES "${EXECUTABLES}")
+
+set(table "")
+set(table "${table}| sample        | resolution | initScene [ms] | iteration [ms] | Msamples/s | Mrays/s |\n")
+set(table "${table}|---------------|------------|----------------|----------------|------------|---------|\n")
+
+foreach(executable ${EXECUTABLES})
+  get_filename_component(name "${executable}" NAME_WE)
+  message(STATUS "Running ${name}")
+
+  execute_process(
+    COMMAND "${executable}" --width ${WIDTH} --height ${HEIGHT} --benchmark ${ITERATIONS}
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE  errors
+    RESULT_VARIABLE result
+  )
+
+  string(REGEX MATCH "BENCHMARK [^\n]*" line "${output}")
+  if (line)
+    string(REGEX MATCH " ([0-9]+x[0-9]+) " match "${line}")
+    set(resolution "${CMAKE_MATCH_1}")
+    string(REGEX MATCH "initScene_ms=([0-9.]+)" match "${line}")
+    set(init "${CMAKE_MATCH_1}")
+    string(REGEX MATCH "ms_per_iteration=([0-9.]+)" match "${line}")
+    set(iteration "${CMAKE_MATCH_1}")
+    string(REGEX MATCH "Msamples_per_second=([0-9.]+)" match "${line}")
+    set(samples "${CMAKE_MATCH_1}")
+    set(rays "-")
+    string(REGEX MATCH "Mrays_per_second=([0-9.]+)" match "${line}")
+    if (match)
+      set(rays "${CMAKE_MATCH_1}")
+    endif()
+    set(table "${table}| ${name} | ${resolution} | ${init} | ${iteration} | ${samples} | ${rays} |\n")
+  else()
+    set(table "${table}| ${name} | failed (${result}) | | | | |\n")
+    message(WARNING "${name} did not report a result:\n${errors}")
+  endif()
+endforeach()
+
+message("\n${table}")
@@ -0,0 +1,135 @@
+#
+# Copyright (c) 2016-2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Script run by the devicescaling_intro target with "cmake -P".
+# Inputs: EXECUTABLES and DEVICES ('|' separated), WIDTH, HEIGHT, ITERATIONS.
+# Runs the --benchmark workload of each executable through its -d device encoding, first on each of the DEVICES
+# alone, then on the first 2..N of them together, and prints the scaling in one table.
+# The -d encoding takes its digits from the lowest one up, so the first device is the last digit.
+# OptiX distributes the pixels of a launch itself and reports no per-device timings. The efficiency of a set is
+# therefore its iterations per second divided by the sum of the standalone iterations per second of its devices,
+# with identical devices that is speedup / N. optixIntro_10 measures the same inside one context with --devicescaling.
+# CMake only has integer math, the rates are kept in thousandths.
+
+string(REPLACE "|" ";" EXECUTABLES "${EXECUTABLES}")
+string(REPLACE "|" ";" DEVICES "${DEVICES}")
+
+# Prints a value in thousandths with three decimals.
+function(format_milli value result)
+  math(EXPR whole "${value} / 1000")
+  math(EXPR fraction "${value} % 1000 + 1000")
+  string(SUBSTRING "${fraction}" 1 3 fraction)
+  set(${result} "${whole}.${fraction}" PARENT_SCOPE)
+endfunction()
+
+# Runs one executable on the given -d encoding, returns the microseconds per iteration or an empty string.
+function(run_benchmark executable encoding result)
+  execute_process(
+    COMMAND "${executable}" --width ${WIDTH} --height ${HEIGHT} --benchmark ${ITERATIONS} --devices ${encoding} --nopbo
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE  errors
+    RESULT_VARIABLE status
+  )
+  string(REGEX MATCH "BENCHMARK [^\n]* ms_per_iteration=([0-9]+)\\.?([0-9]*)" match "${output}")
+  if (NOT match)
+    message(WARNING "${executable} -d ${encoding} did not report a result (${status}):\n${errors}")
+    set(${result} "" PARENT_SCOPE)
+    return()
+  endif()
+  set(milliseconds "${CMAKE_MATCH_1}")
+  string(SUBSTRING "${CMAKE_MATCH_2}000" 0 3 fraction)
+  string(REGEX REPLACE "^0+([0-9])" "\\1" fraction "${fraction}")
+  math(EXPR microseconds "${milliseconds} * 1000 + ${fraction}")
+  if (microseconds EQUAL 0)
+    set(microseconds 1)
+  endif()
+  set(${result} "${microseconds}" PARENT_SCOPE)
+endfunction()
+
+set(table "")
+set(table "${table}| sample        | devices | iteration [ms] | iterations/s | speedup | efficiency |\n")
+set(table "${table}|---------------|---------|----------------|--------------|---------|------------|\n")
+
+foreach(executable ${EXECUTABLES})
+  get_filename_component(name "${executable}" NAME_WE)
+  message(STATUS "Running ${name}")
+
+  # Each device alone, the first one is the reference of the speedup.
+  set(standalone_us "")
+  set(standalone_ips "")
+  foreach(device ${DEVICES})
+    run_benchmark("${executable}" ${device} microseconds)
+    set(ips 0)
+    if (microseconds)
+      math(EXPR ips "1000000000 / ${microseconds}")
+    else()
+      set(microseconds 0)
+    endif()
+    list(APPEND standalone_us ${microseconds})
+    list(APPEND standalone_ips ${ips})
+  endforeach()
+  list(GET standalone_ips 0 reference)
+
+  # The sets of the first 1..N devices, the first one is the standalone run of the first device.
+  set(encoding "")
+  set(members "")
+  set(ideal 0)
+  set(index 0)
+  foreach(device ${DEVICES})
+    set(encoding "${device}${encoding}")
+    if (NOT members STREQUAL "")
+      set(members "${members},${device}")
+    else()
+      set(members "${device}")
+    endif()
+    list(GET standalone_ips ${index} ips)
+    math(EXPR ideal "${ideal} + ${ips}")
+
+    if (index EQUAL 0)
+      list(GET standalone_us 0 microseconds)
+    else()
+      run_benchmark("${executable}" ${encoding} microseconds)
+    endif()
+    math(EXPR index "${index} + 1")
+
+    if (microseconds GREATER 0 AND reference GREATER 0 AND ideal GREATER 0)
+      math(EXPR ips "1000000000 / ${microseconds}")
+      math(EXPR speedup "${ips} * 1000 / ${reference}")
+      math(EXPR efficiency "${ips} * 1000 / ${ideal}")
+      format_milli(${microseconds} iteration)
+      format_milli(${ips} rate)
+      format_milli(${speedup} speedup)
+      format_milli(${efficiency} efficiency)
+      set(table "${table}| ${name} | ${members} | ${iteration} | ${rate} | ${speedup} | ${efficiency} |\n")
+    else()
+      set(table "${table}| ${name} | ${members} | failed | | | |\n")
+    endif()
+  endforeach()
+endforeach()
+
+message("\n${table}")
@@ -638,8 +638,8 @@ void Application::initPrograms()
   try
   {
     // Renderer
-    m_mapOfPrograms["raygeneration"] = m_context->createProgramFromPTXFile(ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
-    m_mapOfPrograms["exception"]     = m_context->createProgramFromPTXFile(ptxPath("exception.cu"),     "exception");     // entry point 0
+    m_mapOfPrograms["raygeneration"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
+    m_mapOfPrograms["exception"]     = sutil::createProgramFromPTXFile(m_context, ptxPath("exception.cu"),     "exception");     // entry point 0
   }
   catch(optix::Exception& e)
   {
@@ -766,10 +766,10 @@ void Application::initPrograms()
     // (This renderer does not put variables on program scope!)
 
     // Renderer
-    m_mapOfPrograms["raygeneration"] = m_context->createProgramFromPTXFile(ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
-    m_mapOfPrograms["exception"]     = m_context->createProgramFromPTXFile(ptxPath("exception.cu"), "exception");         // entry point 0
+    m_mapOfPrograms["raygeneration"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
+    m_mapOfPrograms["exception"]     = sutil::createProgramFromPTXFile(m_context, ptxPath("exception.cu"), "exception");         // entry point 0
 
-    m_mapOfPrograms["miss"] = m_context->createProgramFromPTXFile(ptxPath("miss.cu"), "miss_gradient"); // ray type 0
+    m_mapOfPrograms["miss"] = sutil::createProgramFromPTXFile(m_context, ptxPath("miss.cu"), "miss_gradient"); // ray type 0
   }
   catch(optix::Exception& e)
   {
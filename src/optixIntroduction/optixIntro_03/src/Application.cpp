@@ -818,19 +818,19 @@ void Application::initPrograms()
     // (This renderer does not put variables on program scope!)
 
     // Renderer
-    m_mapOfPrograms["raygeneration"] = m_context->createProgramFromPTXFile(ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
-    m_mapOfPrograms["exception"]     = m_context->createProgramFromPTXFile(ptxPath("exception.cu"), "exception"); // entry point 0
+    m_mapOfPrograms["raygeneration"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
+    m_mapOfPrograms["exception"]     = sutil::createProgramFromPTXFile(m_context, ptxPath("exception.cu"), "exception"); // entry point 0
     
     // Constant white environment.
-    m_mapOfPrograms["miss"] = m_context->createProgramFromPTXFile(ptxPath("miss.cu"), "miss_environment_constant"); // raytype 0
+    m_mapOfPrograms["miss"] = sutil::createProgramFromPTXFile(m_context, ptxPath("miss.cu"), "miss_environment_constant"); // raytype 0
 
     // Geometry
-    m_mapOfPrograms["boundingbox_triangle_indexed"]  = m_context->createProgramFromPTXFile(ptxPath("boundingbox_triangle_indexed.cu"),  "boundingbox_triangle_indexed");
-    m_mapOfPrograms["intersection_triangle_indexed"] = m_context->createProgramFromPTXFile(ptxPath("intersection_triangle_indexed.cu"), "intersection_triangle_indexed");
+    m_mapOfPrograms["boundingbox_triangle_indexed"]  = sutil::createProgramFromPTXFile(m_context, ptxPath("boundingbox_triangle_indexed.cu"),  "boundingbox_triangle_indexed");
+    m_mapOfPrograms["intersection_triangle_indexed"] = sutil::createProgramFromPTXFile(m_context, ptxPath("intersection_triangle_indexed.cu"), "intersection_triangle_indexed");
 
     // Material programs.
     // For the radiance ray type 0:
-    m_mapOfPrograms["closesthit"] = m_context->createProgramFromPTXFile(ptxPath("closesthit.cu"), "closesthit");
+    m_mapOfPrograms["closesthit"] = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit.cu"), "closesthit");
   }
   catch(optix::Exception& e)
   {
@@ -111,6 +111,9 @@ public:
   
   void screenshot(std::string const& filename);
 
+  // Deterministic benchmark. Prints one "BENCHMARK" result line which the benchmark_intro target collects.
+  void benchmark(std::string const& name, const int iterations, const int positions);
+
   void guiNewFrame();
   void guiWindow();
   void guiEventHandler();
@@ -215,6 +218,8 @@ private:
 
   Timer m_timer;
 
+  double m_timeInitScene; // Seconds spent inside initScene(), reported by benchmark().
+
   optix::Material m_opaqueMaterial;
 
   // The root node of the OptiX scene graph (sysTopObject)
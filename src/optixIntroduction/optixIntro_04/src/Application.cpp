@@ -38,6 +38,7 @@
 #include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <iomanip>
 #include <sstream>
 
 #include "shaders/material_parameter.h"
@@ -148,6 +149,8 @@ Application::Application(GLFWwindow* window,
   
   m_frames = 0; // Samples per pixel. 0 == render forever.
 
+  m_timeInitScene = 0.0;
+
   // GLSL shaders objects and program. 
   m_glslVS      = 0;
   m_glslFS      = 0;
@@ -486,6 +489,8 @@ void Application::initScene()
     m_context->launch(0, 0, 0); // Dummy launch to build everything (entrypoint, width, height)
     const double timeLaunch = m_timer.getTime();
 
+    m_timeInitScene = timeLaunch - timeInit;
+
     std::cout << "initScene(): " << timeLaunch - timeInit << " seconds overall" << std::endl;
     std::cout << "{" << std::endl;
     std::cout << "  createScene() = " << timeScene    - timeInit     << " seconds" << std::endl;
@@ -617,6 +622,63 @@ void Application::display()
   glUseProgram(0);
 }
 
+// Renders a fixed number of iterations at each of the camera positions on a fixed orbit around the scene,
+// bypassing the OpenGL display so that only the OptiX launches are measured.
+// The random number seeds only depend on the launch index and iteration index, which makes every run render the same images.
+void Application::benchmark(std::string const& name, const int iterations, const int positions)
+{
+  try
+  {
+    double seconds = 0.0;
+
+    for (int position = 0; position < positions; ++position)
+    {
+      if (0 < position)
+      {
+        // Orbit 1/positions of a full circle around the center of interest.
+        m_pinholeCamera.setBaseCoordinates(0, 0);
+        m_pinholeCamera.orbit(m_width / positions, 0);
+      }
+
+      optix::float3 cameraPosition;
+      optix::float3 cameraU;
+      optix::float3 cameraV;
+      optix::float3 cameraW;
+
+      m_pinholeCamera.getFrustum(cameraPosition, cameraU, cameraV, cameraW);
+
+      m_context["sysCameraPosition"]->setFloat(cameraPosition);
+      m_context["sysCameraU"]->setFloat(cameraU);
+      m_context["sysCameraV"]->setFloat(cameraV);
+      m_context["sysCameraW"]->setFloat(cameraW);
+
+      Timer timer;
+      timer.start();
+      for (int i = 0; i < iterations; ++i)
+      {
+        m_context["sysIterationIndex"]->setInt(i);
+        m_context->launch(0, m_width, m_height);
+      }
+      seconds += timer.getTime();
+    }
+
+    const double launches = double(iterations) * double(positions);
+    const double samples  = launches * double(m_width) * double(m_height);
+
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(3) << "BENCHMARK " << name << " " << m_width << "x" << m_height
+           << " iterations=" << iterations << " positions=" << positions
+           << " initScene_ms=" << m_timeInitScene * 1000.0
+           << " ms_per_iteration=" << seconds * 1000.0 / launches
+           << " Msamples_per_second=" << samples / seconds * 1.0e-6;
+    std::cout << stream.str() << std::endl;
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
 void Application::screenshot(std::string const& filename)
 {
   sutil::writeBufferToFile(filename.c_str(), m_bufferOutput);
@@ -1024,18 +1086,18 @@ void Application::initPrograms()
     // (This renderer does not put variables on program scope!)
 
     // Renderer
-    m_mapOfPrograms["raygeneration"] = m_context->createProgramFromPTXFile(ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
-    m_mapOfPrograms["exception"]     = m_context->createProgramFromPTXFile(ptxPath("exception.cu"), "exception"); // entry point 0
+    m_mapOfPrograms["raygeneration"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
+    m_mapOfPrograms["exception"]     = sutil::createProgramFromPTXFile(m_context, ptxPath("exception.cu"), "exception"); // entry point 0
 
-    m_mapOfPrograms["miss"] = m_context->createProgramFromPTXFile(ptxPath("miss.cu"), "miss_environment_constant"); // raytype 0
+    m_mapOfPrograms["miss"] = sutil::createProgramFromPTXFile(m_context, ptxPath("miss.cu"), "miss_environment_constant"); // raytype 0
 
     // Geometry
-    m_mapOfPrograms["boundingbox_triangle_indexed"]  = m_context->createProgramFromPTXFile(ptxPath("boundingbox_triangle_indexed.cu"),  "boundingbox_triangle_indexed");
-    m_mapOfPrograms["intersection_triangle_indexed"] = m_context->createProgramFromPTXFile(ptxPath("intersection_triangle_indexed.cu"), "intersection_triangle_indexed");
+    m_mapOfPrograms["boundingbox_triangle_indexed"]  = sutil::createProgramFromPTXFile(m_context, ptxPath("boundingbox_triangle_indexed.cu"),  "boundingbox_triangle_indexed");
+    m_mapOfPrograms["intersection_triangle_indexed"] = sutil::createProgramFromPTXFile(m_context, ptxPath("intersection_triangle_indexed.cu"), "intersection_triangle_indexed");
 
     // Material programs. There are only three Material nodes, opaque, cutout opacity and rectangle lights.
     // For the radiance ray type 0:
-    m_mapOfPrograms["closesthit"] = m_context->createProgramFromPTXFile(ptxPath("closesthit.cu"), "closesthit");
+    m_mapOfPrograms["closesthit"] = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit.cu"), "closesthit");
   }
   catch(optix::Exception& e)
   {
@@ -78,6 +78,7 @@ void printUsage(const std::string& argv0)
     "  -n | --nopbo           Disable OpenGL interop for the image display.\n"
     "  -s | --stack <int>     Set the OptiX stack size (1024) (debug feature).\n"
     "  -f | --file <filename> Save image to file and exit.\n"
+    "  -B | --benchmark <int> Render this many iterations at each of 8 fixed camera positions, print the timings and exit.\n"
   "App Keystrokes:\n"
   "  SPACE  Toggles ImGui display.\n"
   "\n"
@@ -96,6 +97,8 @@ int main(int argc, char *argv[])
 
   std::string filenameScreenshot;
   bool hasGUI = true;
+
+  int benchmarkIterations = 0; // 0 == interactive.
   
   // Parse the command line parameters.
   for (int i = 1; i < argc; ++i)
@@ -162,6 +165,16 @@ int main(int argc, char *argv[])
       filenameScreenshot = argv[++i];
       hasGUI = false; // Do not render the GUI when just taking a screenshot. (Automated QA feature.)
     }
+    else if (arg == "-B" || arg == "--benchmark")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      benchmarkIterations = atoi(argv[++i]);
+    }
     else
     {
       std::cerr << "Unknown option '" << arg << "'\n";
@@ -205,6 +218,13 @@ int main(int argc, char *argv[])
     return 4;
   }
 
+  if (0 < benchmarkIterations)
+  {
+    g_app->benchmark("optixIntro_04", benchmarkIterations, 8);
+
+    glfwSetWindowShouldClose(window, 1); // Skip the main loop.
+  }
+
   // Main loop
   while (!glfwWindowShouldClose(window))
   {
@@ -114,6 +114,9 @@ public:
   
   void screenshot(std::string const& filename);
 
+  // Deterministic benchmark. Prints one "BENCHMARK" result line which the benchmark_intro target collects.
+  void benchmark(std::string const& name, const int iterations, const int positions);
+
   void guiNewFrame();
   void guiWindow();
   void guiEventHandler();
@@ -226,6 +229,8 @@ private:
 
   Timer m_timer;
 
+  double m_timeInitScene; // Seconds spent inside initScene(), reported by benchmark().
+
   std::vector<LightDefinition> m_lightDefinitions;
   optix::Buffer                m_bufferLightDefinitions;
   optix::Material m_opaqueMaterial;
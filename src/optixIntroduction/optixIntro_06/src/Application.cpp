@@ -38,6 +38,7 @@
 #include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <iomanip>
 #include <sstream>
 
 #include "shaders/material_parameter.h"
@@ -157,6 +158,8 @@ Application::Application(GLFWwindow* window,
 
   m_frames = 0; // Samples per pixel. 0 == render forever.
 
+  m_timeInitScene = 0.0;
+
   // GLSL shaders objects and program. 
   m_glslVS      = 0;
   m_glslFS      = 0;
@@ -496,6 +499,8 @@ void Application::initScene()
     m_context->launch(0, 0, 0); // Dummy launch to build everything (entrypoint, width, height)
     const double timeLaunch = m_timer.getTime();
 
+    m_timeInitScene = timeLaunch - timeInit;
+
     std::cout << "initScene(): " << timeLaunch - timeInit << " seconds overall" << std::endl;
     std::cout << "{" << std::endl;
     std::cout << "  createScene() = " << timeScene    - timeInit     << " seconds" << std::endl;
@@ -627,6 +632,63 @@ void Application::display()
   glUseProgram(0);
 }
 
+// Renders a fixed number of iterations at each of the camera positions on a fixed orbit around the scene,
+// bypassing the OpenGL display so that only the OptiX launches are measured.
+// The random number seeds only depend on the launch index and iteration index, which makes every run render the same images.
+void Application::benchmark(std::string const& name, const int iterations, const int positions)
+{
+  try
+  {
+    double seconds = 0.0;
+
+    for (int position = 0; position < positions; ++position)
+    {
+      if (0 < position)
+      {
+        // Orbit 1/positions of a full circle around the center of interest.
+        m_pinholeCamera.setBaseCoordinates(0, 0);
+        m_pinholeCamera.orbit(m_width / positions, 0);
+      }
+
+      optix::float3 cameraPosition;
+      optix::float3 cameraU;
+      optix::float3 cameraV;
+      optix::float3 cameraW;
+
+      m_pinholeCamera.getFrustum(cameraPosition, cameraU, cameraV, cameraW);
+
+      m_context["sysCameraPosition"]->setFloat(cameraPosition);
+      m_context["sysCameraU"]->setFloat(cameraU);
+      m_context["sysCameraV"]->setFloat(cameraV);
+      m_context["sysCameraW"]->setFloat(cameraW);
+
+      Timer timer;
+      timer.start();
+      for (int i = 0; i < iterations; ++i)
+      {
+        m_context["sysIterationIndex"]->setInt(i);
+        m_context->launch(0, m_width, m_height);
+      }
+      seconds += timer.getTime();
+    }
+
+    const double launches = double(iterations) * double(positions);
+    const double samples  = launches * double(m_width) * double(m_height);
+
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(3) << "BENCHMARK " << name << " " << m_width << "x" << m_height
+           << " iterations=" << iterations << " positions=" << positions
+           << " initScene_ms=" << m_timeInitScene * 1000.0
+           << " ms_per_iteration=" << seconds * 1000.0 / launches
+           << " Msamples_per_second=" << samples / seconds * 1.0e-6;
+    std::cout << stream.str() << std::endl;
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
 void Application::screenshot(std::string const& filename)
 {
   sutil::writeBufferToFile(filename.c_str(), m_bufferOutput);
@@ -1095,31 +1157,31 @@ void Application::initPrograms()
     // (This renderer does not put variables on program scope!)
 
     // Renderer
-    m_mapOfPrograms["raygeneration"] = m_context->createProgramFromPTXFile(ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
-    m_mapOfPrograms["exception"]     = m_context->createProgramFromPTXFile(ptxPath("exception.cu"), "exception"); // entry point 0
+    m_mapOfPrograms["raygeneration"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
+    m_mapOfPrograms["exception"]     = sutil::createProgramFromPTXFile(m_context, ptxPath("exception.cu"), "exception"); // entry point 0
 
     // There can be only one of the miss programs active.
     switch (m_missID)
     {
     case 0: // Default black environment. Does not appear in the light definitions, means it's not used in direct lighting.
-      m_mapOfPrograms["miss"] = m_context->createProgramFromPTXFile(ptxPath("miss.cu"), "miss_environment_null"); // ray type 0
+      m_mapOfPrograms["miss"] = sutil::createProgramFromPTXFile(m_context, ptxPath("miss.cu"), "miss_environment_null"); // ray type 0
       break;
     case 1:
     default:
-      m_mapOfPrograms["miss"] = m_context->createProgramFromPTXFile(ptxPath("miss.cu"), "miss_environment_constant"); // raytype 0
+      m_mapOfPrograms["miss"] = sutil::createProgramFromPTXFile(m_context, ptxPath("miss.cu"), "miss_environment_constant"); // raytype 0
       break;
     }
 
     // Geometry
-    m_mapOfPrograms["boundingbox_triangle_indexed"]  = m_context->createProgramFromPTXFile(ptxPath("boundingbox_triangle_indexed.cu"),  "boundingbox_triangle_indexed");
-    m_mapOfPrograms["intersection_triangle_indexed"] = m_context->createProgramFromPTXFile(ptxPath("intersection_triangle_indexed.cu"), "intersection_triangle_indexed");
+    m_mapOfPrograms["boundingbox_triangle_indexed"]  = sutil::createProgramFromPTXFile(m_context, ptxPath("boundingbox_triangle_indexed.cu"),  "boundingbox_triangle_indexed");
+    m_mapOfPrograms["intersection_triangle_indexed"] = sutil::createProgramFromPTXFile(m_context, ptxPath("intersection_triangle_indexed.cu"), "intersection_triangle_indexed");
 
     // Material programs. There are only two Material nodes, opaque and rectangle lights.
     // For the radiance ray type 0:
-    m_mapOfPrograms["closesthit"]       = m_context->createProgramFromPTXFile(ptxPath("closesthit.cu"), "closesthit");
-    m_mapOfPrograms["closesthit_light"] = m_context->createProgramFromPTXFile(ptxPath("closesthit_light.cu"), "closesthit_light");
+    m_mapOfPrograms["closesthit"]       = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit.cu"), "closesthit");
+    m_mapOfPrograms["closesthit_light"] = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit_light.cu"), "closesthit_light");
     // For the shadow ray type 1:
-    m_mapOfPrograms["anyhit_shadow"]    = m_context->createProgramFromPTXFile(ptxPath("anyhit.cu"), "anyhit_shadow");        // Opaque 
+    m_mapOfPrograms["anyhit_shadow"]    = sutil::createProgramFromPTXFile(m_context, ptxPath("anyhit.cu"), "anyhit_shadow");        // Opaque 
 
     // Now setup all buffers of bindless callable program IDs.
     // These are device side function tables which can be indexed at runtime without recompilation.
@@ -1129,15 +1191,15 @@ void Application::initPrograms()
     int* lensShader = (int*) m_bufferLensShader->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
 
     const std::string ptxPathLensShader = ptxPath("lens_shader.cu");
-    optix::Program prg = m_context->createProgramFromPTXFile(ptxPathLensShader, "lens_shader_pinhole");
+    optix::Program prg = sutil::createProgramFromPTXFile(m_context, ptxPathLensShader, "lens_shader_pinhole");
     m_mapOfPrograms["lens_shader_pinhole"] = prg;
     lensShader[LENS_SHADER_PINHOLE] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPathLensShader, "lens_shader_fisheye");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPathLensShader, "lens_shader_fisheye");
     m_mapOfPrograms["lens_shader_fisheye"] = prg;
     lensShader[LENS_SHADER_FISHEYE] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPathLensShader, "lens_shader_sphere");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPathLensShader, "lens_shader_sphere");
     m_mapOfPrograms["lens_shader_sphere"] = prg;
     lensShader[LENS_SHADER_SPHERE] = prg->getId();
     
@@ -1152,15 +1214,15 @@ void Application::initPrograms()
     m_bufferSampleBSDF = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_BSDF_INDICES);
     int* sampleBsdf = (int*) m_bufferSampleBSDF->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_diffuse_reflection.cu"), "sample_bsdf_diffuse_reflection");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_diffuse_reflection.cu"), "sample_bsdf_diffuse_reflection");
     m_mapOfPrograms["sample_bsdf_diffuse_reflection"] = prg;
     sampleBsdf[INDEX_BSDF_DIFFUSE_REFLECTION] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_specular_reflection.cu"), "sample_bsdf_specular_reflection");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_specular_reflection.cu"), "sample_bsdf_specular_reflection");
     m_mapOfPrograms["sample_bsdf_specular_reflection"] = prg;
     sampleBsdf[INDEX_BSDF_SPECULAR_REFLECTION] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_specular_reflection_transmission.cu"), "sample_bsdf_specular_reflection_transmission");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_specular_reflection_transmission.cu"), "sample_bsdf_specular_reflection_transmission");
     m_mapOfPrograms["sample_bsdf_specular_reflection_transmission"] = prg;
     sampleBsdf[INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION] = prg->getId();
 
@@ -1172,11 +1234,11 @@ void Application::initPrograms()
     m_bufferEvalBSDF = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_BSDF_INDICES);
     int* evalBsdf = (int*) m_bufferEvalBSDF->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_diffuse_reflection.cu"), "eval_bsdf_diffuse_reflection");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_diffuse_reflection.cu"), "eval_bsdf_diffuse_reflection");
     m_mapOfPrograms["eval_bsdf_diffuse_reflection"] = prg;
     evalBsdf[INDEX_BSDF_DIFFUSE_REFLECTION] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_specular_reflection.cu"), "eval_bsdf_specular_reflection");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_specular_reflection.cu"), "eval_bsdf_specular_reflection");
     m_mapOfPrograms["eval_bsdf_specular_reflection"] = prg;
     evalBsdf[INDEX_BSDF_SPECULAR_REFLECTION]              = prg->getId(); // All specular evaluation functions just returns float4(0.0f).
     evalBsdf[INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION] = prg->getId(); // Reuse the same program for all specular materials to keep the kernel small.
@@ -1199,14 +1261,14 @@ void Application::initPrograms()
     default:
       break;
     case 1:
-      prg = m_context->createProgramFromPTXFile(ptxPath("light_sample.cu"), "sample_light_constant");
+      prg = sutil::createProgramFromPTXFile(m_context, ptxPath("light_sample.cu"), "sample_light_constant");
       m_mapOfPrograms["sample_light_constant"] = prg;
       sampleLight[LIGHT_ENVIRONMENT] = prg->getId();
       break;
     }
     
     // PERF Again, to optimize the kernel size this program would only be needed if there are parallelogram lights in the scene.
-    prg = m_context->createProgramFromPTXFile(ptxPath("light_sample.cu"), "sample_light_parallelogram");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("light_sample.cu"), "sample_light_parallelogram");
     m_mapOfPrograms["sample_light_parallelogram"] = prg;
     sampleLight[LIGHT_PARALLELOGRAM] = prg->getId();
 
@@ -58,6 +58,7 @@
 #include "inc/PinholeCamera.h"
 #include "inc/Timer.h"
 #include "inc/Picture.h"
+#include "inc/PictureCache.h"
 #include "inc/Texture.h"
 
 #include "shaders/vertex_attributes.h"
@@ -123,6 +124,9 @@ public:
 
   void screenshot(std::string const& filename);
 
+  // Deterministic benchmark. Prints one "BENCHMARK" result line which the benchmark_intro target collects.
+  void benchmark(std::string const& name, const int iterations, const int positions);
+
   void guiNewFrame();
   void guiWindow();
   void guiEventHandler();
@@ -245,6 +249,8 @@ private:
 
   Timer m_timer;
 
+  double m_timeInitScene; // Seconds spent inside initScene(), reported by benchmark().
+
   std::vector<LightDefinition> m_lightDefinitions;
   optix::Buffer                m_bufferLightDefinitions;
 
@@ -0,0 +1,101 @@
+// Copyright NVIDIA Corporation 2002-2005
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// This code is part of the NVIDIA nvpro-pipeline https://github.com/nvpro-pipeline/pipeline
+
+
+#pragma once
+
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <cstddef>
+#include <vector>
+
+// Vose's stable construction of Walker's alias table for O(1) sampling of a discrete distribution.
+// Slot i is picked uniformly; it returns i when the fractional part of the scaled sample is below threshold[i], otherwise alias[i].
+// The weights need not be normalized. An all zero distribution results in uniform selection.
+inline void buildAliasTable(std::vector<float> const& weights, std::vector<float>& threshold, std::vector<unsigned int>& alias)
+{
+  const size_t size = weights.size();
+
+  threshold.resize(size);
+  alias.resize(size);
+
+  double sum = 0.0;
+  for (size_t i = 0; i < size; ++i)
+  {
+    sum += weights[i];
+  }
+
+  std::vector<double>       scaled(size);
+  std::vector<unsigned int> small;
+  std::vector<unsigned int> large;
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    // Scaled so that the average is 1.0.
+    scaled[i] = (0.0 < sum) ? double(weights[i]) * double(size) / sum : 1.0;
+    if (scaled[i] < 1.0)
+    {
+      small.push_back((unsigned int) i);
+    }
+    else
+    {
+      large.push_back((unsigned int) i);
+    }
+  }
+
+  while (!small.empty() && !large.empty())
+  {
+    const unsigned int s = small.back();
+    small.pop_back();
+    const unsigned int l = large.back();
+
+    threshold[s] = float(scaled[s]);
+    alias[s]     = l;
+
+    scaled[l] -= 1.0 - scaled[s];
+    if (scaled[l] < 1.0)
+    {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  // The remaining entries are 1.0 up to rounding errors.
+  for (size_t i = 0; i < large.size(); ++i)
+  {
+    threshold[large[i]] = 1.0f;
+    alias[large[i]]     = large[i];
+  }
+  for (size_t i = 0; i < small.size(); ++i)
+  {
+    threshold[small[i]] = 1.0f;
+    alias[small[i]]     = small[i];
+  }
+}
+
+#endif // ALIAS_TABLE_H
@@ -53,19 +53,58 @@
 
 #include <optix.h>
 #include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
 
-#include "inc/LensShader.h"
+#include "shaders/lens_shader_type.h"
 #include "inc/PinholeCamera.h"
 #include "inc/Timer.h"
+#include "inc/Profiler.h"
+#include "inc/MemoryTracker.h"
 #include "inc/Picture.h"
+#include "inc/PictureCache.h"
 #include "inc/Texture.h"
+#include "inc/VirtualTexture.h"
 
+#if USE_ASYNC_SCREENSHOTS
+#include <sutil/ImageWriter.h>
+#endif
+#include <sutil/BufferUploader.h>
+#include <sutil/UsageReportLogger.h>
+
+#if USE_RENDER_SERVER
+#include "inc/RenderServer.h"
+#endif
+
+#include "shaders/entry_points.h"
+#include "shaders/sampler_type.h"
+#include "shaders/roulette_type.h"
+#include "shaders/ray_counter_type.h"
+#include "shaders/cost_heatmap_type.h"
 #include "shaders/vertex_attributes.h"
+#include "shaders/compact_attributes.h"
 #include "shaders/light_definition.h"
 #include "shaders/material_parameter.h"
+#include "shaders/multi_view.h"
+#include "shaders/wedge.h"
+#include "shaders/medium.h"
 
 #include <string>
 #include <map>
+#include <memory>
+#include <set>
+#include <vector>
+#if USE_CHECKPOINTS || USE_RENDER_THREAD
+#include <thread>
+#endif
+#if USE_RENDER_THREAD
+#include <condition_variable>
+#include <mutex>
+
+#include "inc/RenderThread.h"
+#endif
+#if USE_DENOISER && USE_DENOISER_DEVICE
+#include "inc/DenoiserDevice.h"
+#endif
 
 
 // For rtDevice*() function error checking. No OptiX context present at that time.
@@ -77,6 +116,8 @@
   } while (0)
 
 
+class MeshArena; // sutil/Mesh.h
+
 enum GuiState
 {
   GUI_STATE_NONE,
@@ -86,6 +127,157 @@ enum GuiState
   GUI_STATE_FOCUS
 };
 
+// Camera and window changes from the GUI event handling. Applied directly, or by the render thread in the order they were posted.
+enum RenderCommandType
+{
+  RENDER_COMMAND_BASE,       // PinholeCamera::setBaseCoordinates(x, y)
+  RENDER_COMMAND_ORBIT,      // PinholeCamera::orbit(x, y)
+  RENDER_COMMAND_DOLLY,      // PinholeCamera::dolly(x, y)
+  RENDER_COMMAND_PAN,        // PinholeCamera::pan(x, y)
+  RENDER_COMMAND_ZOOM,       // PinholeCamera::zoom(value)
+  RENDER_COMMAND_TILE_FOCUS, // m_tileFocus = (x, y)
+  RENDER_COMMAND_RESHAPE     // reshape(x, y)
+};
+
+struct RenderCommand
+{
+  int   type; // RenderCommandType
+  int   x;
+  int   y;
+  float value;
+};
+
+// What an Acceleration is built for, which decides its builder, see src/AccelerationPolicy.cpp.
+enum AccelerationUsage
+{
+  ACCELERATION_STATIC,   // Bottom level, built once.
+  ACCELERATION_ANIMATED, // Bottom level, rebuilt or refitted per frame.
+  ACCELERATION_TOP_LEVEL // The root Group above all instances.
+};
+
+// One bottom level Acceleration and the cache file holding its data.
+struct AccelerationCacheEntry
+{
+  optix::Acceleration acceleration;
+  std::string         filename;
+  bool                restored; // True when the data came from the file or was written to it.
+};
+
+// OptiX disk cache lookups of compiled kernels, reported by the usage report callback at verbosity 2.
+struct KernelCacheStatistics
+{
+  unsigned int hits;
+  unsigned int misses;
+};
+
+#if USE_RASTER_PRIMARY
+// The OpenGL copy of the vertex positions and indices of one triangle Geometry.
+struct RasterMesh
+{
+  GLuint  vbo;
+  GLuint  ibo;
+  GLsizei stride;  // Bytes between the vertex positions inside the vbo.
+  GLsizei count;   // Number of indices.
+};
+
+// One GeometryInstance of the scene with its object to world matrix.
+struct RasterDraw
+{
+  size_t           mesh; // Index into m_rasterMeshes.
+  optix::Matrix4x4 matrix;
+};
+#endif
+
+#if USE_DYNAMIC_SCENE
+// A Transform directly under the root Group which the animation interface moves, see src/DynamicScene.cpp.
+struct DynamicInstance
+{
+  optix::Transform        transform;
+  optix::GeometryInstance instance;   // The first child of the GeometryGroup below the Transform. Its Geometry is deformed.
+  size_t                  mesh;       // Index into m_dynamicMeshes.
+  optix::Matrix4x4        matrixRest; // The object to world matrix from the scene creation.
+};
+
+#if USE_LIGHT_BAKE
+// One triangle of a baked mesh in world space and its position in the lightmap in texels.
+struct BakeTriangle
+{
+  optix::float3 position[3];
+  optix::float3 normal[3];
+  optix::float2 texel[3];
+};
+#endif
+
+// A bottom level Acceleration of the dynamic instances and the vertex positions of its last rebuild.
+struct DynamicMesh
+{
+  optix::Acceleration        acceleration;
+  std::vector<optix::float3> reference; // Empty until the first deformation, the scene creation built it from the original vertices.
+  float                      extent;    // Bounding box diagonal of the reference positions.
+  bool                       dirty;     // Deformed since the last updateDynamicScene().
+  bool                       rebuild;   // The deformation exceeded the refit threshold.
+};
+#endif
+
+#if USE_GEOMETRY_PAGING
+// One mesh file of the scene description whose device data is paged in and out under the geometry budget, see src/GeometryPaging.cpp.
+struct GeometryPage
+{
+  std::vector<VertexAttributes>     attributes; // Host copy, the source of every page in.
+  std::vector<unsigned int>         indices;
+  std::vector<optix::GeometryGroup> groups;     // One per material index. All share the current Acceleration of the page.
+  std::vector<int>                  materials;  // The material parameters index of each GeometryGroup.
+  optix::GeometryInstance           proxy;      // Bounding box with the request material. The child of all groups while not resident.
+  optix::Acceleration               proxyAcceleration;
+  optix::Geometry                   geometry;   // Only valid while resident.
+  optix::Acceleration               acceleration;
+  std::string                       builder;    // Forced by the scene description. Empty == selectBuilder().
+  size_t                            bytes;      // Estimated device memory of the resident page.
+  unsigned int                      requests;   // Proxy hits since the last read back.
+  unsigned int                      lastUsed;   // m_pagingEpoch of the last hit while resident.
+  bool                              resident;
+};
+#endif
+
+#if USE_MESH_LOD
+// One coarser level of a scene description mesh, see src/MeshLod.cpp.
+struct MeshLodLevel
+{
+  optix::Geometry     geometry;
+  optix::Acceleration acceleration;
+  float               cellSize; // Object space edge length of the clustering cells.
+};
+
+// All levels of one mesh. Empty when the mesh is too small.
+struct MeshLodChain
+{
+  std::vector<MeshLodLevel> levels; // Coarser levels only, the full resolution mesh stays in its own objects.
+  optix::float3             center; // Object space bounding sphere.
+  float                     radius;
+};
+
+// A scene description instance whose Transform child is switched between the GeometryGroups of its levels.
+struct LodInstance
+{
+  optix::Transform                  transform;
+  std::vector<optix::GeometryGroup> groups;    // Per level, [0] is the full resolution mesh.
+  std::vector<float>                cellSizes; // World space per level, [0] == 0.0f.
+  optix::float3                     center;    // World space bounding sphere.
+  float                             radius;
+  int                               level;     // Index of the attached groups entry.
+};
+#endif
+
+#if USE_WEDGE
+// One line of a wedge file. Replaces a GUI material parameter in one variant, see src/Wedge.cpp.
+struct WedgeOverride
+{
+  int           material;  // Index into m_guiMaterialParameters.
+  int           parameter; // WEDGE_PARAMETER_*
+  optix::float3 value;     // Scalars use x.
+};
+#endif
+
 // Host side GUI material parameters 
 struct MaterialParameterGUI
 {
@@ -97,7 +289,48 @@ struct MaterialParameterGUI
   optix::float3 absorptionColor; // absorption color and distance scale together build the absorption coefficient
   float         volumeDistanceScale;
   float         ior;        // index of refraction
+  float         abbe;       // Abbe number of the dispersion, 0.0f == none.
+#if USE_STRESS_SCENE
+  int           albedoTexture; // Index into m_stressTextures used by useAlbedoTexture, -1 == m_textureAlbedo.
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+  int           medium;        // Index into m_mediumDefinitions filling the volume of this material, -1 == homogeneous.
+#endif
+};
+
+#if USE_STRESS_SCENE
+// Sizes of the generated scene, see src/StressScene.cpp.
+struct StressConfig
+{
+  int          instances; // 0 == off.
+  int          lights;
+  int          materials;
+  int          textures;
+  unsigned int seed;
+};
+#endif
+
+#if USE_HETEROGENEOUS_MEDIA
+// One --medium argument, see src/Media.cpp.
+struct MediumConfig
+{
+  int           material;   // Index into m_guiMaterialParameters whose volume gets filled.
+  float         density;    // Extinction coefficient per world unit where the grid is 1.0f.
+  optix::float3 albedo;     // Single scattering albedo.
+  float         anisotropy; // Henyey-Greenstein g.
+  std::string   filename;   // Mitsuba .vol density grid. Empty == procedural smoke.
 };
+#endif
+
+#if USE_MESH_LIGHTS
+// One light statement of the scene description, already in world space. Turned into a LIGHT_MESH by createLights().
+struct MeshLight
+{
+  std::vector<VertexAttributes> attributes;
+  std::vector<unsigned int>     indices;
+  optix::float3                 emission; // Radiant exitance in Watt/m^2 on the front faces.
+};
+#endif
 
 
 class Application
@@ -111,7 +344,23 @@ public:
               const bool interop, 
               const bool light, 
               const unsigned int miss,
-              std::string const& environment);
+              std::string const& environment,
+              const bool wavefront,
+              const int tileSize,
+              const bool halfDisplay,
+              const int sampler,
+              std::string const& scene,
+              const bool geometryTriangles,
+              const bool flatten,
+              std::string const& accelerationCache,
+              const float geometryBudget,
+              const float buildBudget,
+              const float lodError,
+              std::string const& stress,
+              std::vector<std::string> const& shaderDefines,
+              std::string const& kernelCache,
+              const int kernelCacheSize,
+              std::string const& usageReport);
   ~Application();
 
   bool isValid() const;
@@ -123,6 +372,173 @@ public:
 
   void screenshot(std::string const& filename);
 
+  // Blocks until the asynchronously loaded material textures are at full resolution.
+  void finishTextures();
+
+  // Deterministic benchmark. Prints one "BENCHMARK" result line which the benchmark_intro target collects.
+  void benchmark(std::string const& name, const int iterations, const int positions);
+#if USE_DEVICE_SCALING
+  // Renders the benchmark workload on subsets of the -d devices and prints "DEVICESCALING" lines, see src/DeviceScaling.cpp.
+  void deviceScaling(std::string const& name, const int iterations);
+#endif
+
+  // Offline rendering without window and OpenGL. Construct the Application with window == nullptr to use this.
+  void renderBatch(const int spp, const double seconds, std::string const& filename);
+
+#if USE_RENDER_SERVER
+  // Headless render server. Accumulates while a client is connected and answers its commands until it sends "quit".
+  // Construct the Application with window == nullptr to use this. The protocol is described in src/ServerMode.cpp.
+  void serve(const int port);
+#endif
+
+#if USE_RENDER_SERVER && USE_TILED_LAUNCH
+  // Distributed offline rendering. The render servers in workers ("host:port") render the tiles of the image with the same
+  // sample indices as a local render. The result is merged, denoised and saved like in renderBatch().
+  void renderDistributed(std::vector<std::string> const& workers, const int spp, std::string const& filename);
+#endif
+
+#if USE_LIGHT_BAKE
+  // Offline irradiance baking into a lightmap of the Application's size. The triangles of the root children with these
+  // indices are placed by their texture coordinates, or one per cell of an automatic unwrap. See src/LightBake.cpp.
+  void renderBake(std::vector<unsigned int> const& roots, const bool unwrap, const int spp, const double seconds, std::string const& filename);
+#endif
+
+#if USE_POSTER_TILES
+  // Offline rendering of a width x height poster in tiles of the Application's size minus POSTER_TILE_OVERLAP on each side.
+  // Every tile is accumulated with spp samples or its share of seconds, denoised and written into the *.pfm filename.
+  void renderPoster(const int width, const int height, const int spp, const double seconds, std::string const& filename);
+#endif
+
+#if USE_DENOISER && USE_DENOISER_TILES
+  // Denoise frames larger than tileSize pixels in either direction tile by tile. 0 == always the full frame.
+  void setDenoiserTileSize(const int tileSize);
+#endif
+
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+  // Stop the accumulation when the mean relative change per tile between two denoised images stays below threshold.
+  void setStableThreshold(const float threshold);
+#endif
+
+#if USE_DEVICE_TONEMAP
+  // Tonemap on the device into RGBA8 for the non-interop display uploads and the *.png and *.ppm screenshots.
+  void setDeviceTonemap(const bool enable);
+#endif
+
+#if USE_RASTER_PRIMARY
+  // Rasterize the primary visibility with OpenGL each iteration and start the pinhole primary rays at that surface.
+  void setRasterPrimary(const bool enable);
+#endif
+
+#if USE_RESTIR
+  // Resample the direct lighting of the primary hits with spatiotemporal reuse of per pixel reservoirs.
+  void setRestir(const bool enable);
+#endif
+
+#if USE_VISIBILITY_CACHE
+  // Skip the primary hit shadow rays of the pixels which were fully lit or fully shadowed so far in this accumulation.
+  void setVisibilityCache(const bool enable);
+#endif
+
+#if USE_PERSISTENT_THREADS
+  // Launch the megakernel with this many persistent threads per streaming multiprocessor, which pull the pixels from
+  // a global counter instead of one thread per pixel (0 == off). Single device only.
+  void setPersistentThreads(const int threadsPerMultiprocessor);
+#endif
+
+#if USE_MORTON_LAUNCH
+  // Launch the megakernel in 1D over the pixels in Morton order per tile instead of in 2D.
+  void setMortonLaunch(const bool enable);
+#endif
+
+#if USE_DENOISER && USE_DENOISER_DEVICE
+  // Denoise asynchronously on this device ordinal, which should not be one of the render devices (-1 == off).
+  void setDenoiserDevice(const int device);
+#endif
+
+#if USE_WAVEFRONT && USE_WAVEFRONT_SORT
+  // Sort the live wavefront paths between the extend launches by material, origin cells of cellSize and direction (0 == off).
+  void setWavefrontSort(const float cellSize);
+#endif
+
+#if USE_SPECTRAL
+  // Trace a hero wavelength per path, which lets materials with an Abbe number disperse the light.
+  void setSpectral(const bool enable);
+#endif
+
+#if USE_RADIANCE_CACHE
+  // Terminate the megakernel paths into a world space radiance cache with voxels of cellSize after this many diffuse bounces (0 == off).
+  void setRadianceCache(const int bounces, const float cellSize);
+#endif
+
+#if USE_MULTI_VIEW
+  // Render the MULTI_VIEW_STEREO eyes with this separation in world units, or the MULTI_VIEW_CUBEMAP faces, in one launch.
+  void setMultiView(const int mode, const float separation);
+#endif
+
+#if USE_DYNAMIC_SCENE
+  // Animate the demo scene, and rebuild instead of refit the deformed Accelerations when a vertex moved further than
+  // refitThreshold times the mesh size since the last rebuild.
+  void setAnimation(const bool enable, const float refitThreshold);
+
+  // Animation interface over the Transforms without motion keys directly under the root Group. Takes effect with the next render().
+  unsigned int getInstanceCount() const;
+  bool setInstanceMatrix(const unsigned int index, optix::Matrix4x4 const& matrix);
+  bool getInstanceAttributes(const unsigned int index, std::vector<VertexAttributes>& attributes);
+  bool setInstanceAttributes(const unsigned int index, std::vector<VertexAttributes> const& attributes);
+#endif
+
+#if USE_FILTER_IMPORTANCE_SAMPLING
+  // Draw the primary ray sub-pixel offsets from the "box|tent|gaussian|blackmanharris[,radius]" pixel filter. See src/PixelFilter.cpp.
+  bool setPixelFilter(std::string const& config);
+#endif
+
+#if USE_HETEROGENEOUS_MEDIA
+  // Fill the volumes of materials with density grids, each "material,density,albedo,anisotropy[,file.vol]", see src/Media.cpp.
+  // The albedo is one gray or three comma separated RGB values. Takes effect immediately and survives scene reloads.
+  bool setMedia(std::vector<std::string> const& configs);
+#endif
+
+#if USE_SCENE_RELOAD
+  // Replace the scene with the scene description in sceneFilename (empty == demo scene) and, with the HDR environment miss
+  // program, the environment with environmentFilename (empty == keep). The programs and the denoiser stage are reused.
+  // Returns false and keeps the current scene when the scene description can't be opened.
+  bool reloadScene(std::string const& sceneFilename, std::string const& environmentFilename);
+#endif
+
+#if USE_WEDGE
+  // Render all material variants of the wedge file together in one launch per iteration. See src/Wedge.cpp for the format.
+  bool setWedge(std::string const& filename);
+#endif
+
+#if USE_AOVS
+  // Fill the comma separated AOVs (depth, position, normal, material, direct, indirect, light<n>, lights) in the same pass
+  // and save them as <name>_<aov>.exr next to every image. An empty list disables them.
+  bool setAovs(std::string const& names);
+#endif
+
+#if USE_STACK_CALIBRATION
+  // Find the smallest stack size without overflows for the current programs and scene, store it for this configuration
+  // and apply it with a safety margin. Later runs without --stack start with the stored size.
+  bool calibrateStackSize();
+#endif
+
+#if USE_CHECKPOINTS
+  // renderBatch() stores the accumulation into filename every interval seconds and when it ends.
+  // With resume the accumulation continues from that file when it matches the current image settings.
+  void setCheckpoint(std::string const& filename, const double interval, const bool resume);
+#endif
+
+  // Record per frame stage timings and write them as CSV or JSON (by extension) when the Application is destroyed.
+  void setProfileFilename(std::string const& filename);
+
+#if USE_SAMPLES_PER_LAUNCH
+  // Number of samples per pixel each megakernel launch renders.
+  void setSamplesPerLaunch(const int samples);
+#endif
+
+  // Write the device memory use per MemoryCategory and object now and again when the Application is destroyed.
+  void setMemoryReportFilename(std::string const& filename);
+
   void guiNewFrame();
   void guiWindow();
   void guiEventHandler();
@@ -130,6 +546,12 @@ public:
 
   void guiReferenceManual(); // DAR HACK DEBUG The IMGUI "programming manual" in form of a live window.
 
+#if USE_RENDER_THREAD
+  // Interactive main loop until the window is closed. A render thread owns the OptiX context and renders continuously,
+  // while this thread only handles the window events and the GUI and displays the newest completed frame. See src/RenderThread.cpp.
+  void runRenderThread();
+#endif
+
 private:
   void getSystemInformation();
   
@@ -153,40 +575,557 @@ private:
   optix::Geometry createParallelogram(optix::float3 const& position, optix::float3 const& vecU, optix::float3 const& vecV, optix::float3 const& normal);
 
   optix::Geometry createGeometry(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices);
+
+  // Scene description loader in src/SceneLoader.cpp. Each mesh file is loaded once, all its instances share the GeometryGroup's Acceleration.
+  bool loadSceneDescription(std::string const& filename);
+  void convertMesh(std::string const& filename, MeshArena& arena, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices);
+#if USE_CHUNKED_BUILD
+  // Memory capped Acceleration builds of huge meshes in src/ChunkedBuild.cpp.
+  size_t       estimateBuildBytes(const size_t numVertices, const size_t numTriangles) const;
+  void         splitMeshChunks(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices, std::vector<optix::Geometry>& chunks);
+  optix::Group createChunkGroup(std::vector<optix::Geometry> const& chunks, std::vector<optix::Acceleration> const& accelerations, const int materialIndex);
+#endif
+#if USE_MESH_LOD
+  // Distance based levels of detail of the scene description instances in src/MeshLod.cpp.
+  void createMeshLods(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices, std::string const& builder, MeshLodChain& chain);
+  void addLodInstance(optix::Transform transform, optix::Matrix4x4 const& matrix, MeshLodChain const& chain, std::vector<optix::GeometryGroup> const& groups);
+  void updateMeshLod(optix::float3 const& cameraPosition, optix::float3 const& cameraV);
+#endif
+
+  // Static scene graph flattening in src/Flatten.cpp.
+  void            flattenStaticInstances();
+  void            readInstanceAttributes(optix::GeometryInstance instance, std::vector<VertexAttributes>& attributes);
+  optix::Geometry createBakedGeometry(optix::GeometryInstance instance, optix::Matrix4x4 const& matrix);
+
+  // Shader PTX selection and NVRTC compilation with the --define switches in src/ShaderCompilation.cpp.
+  void        setShaderDefines(std::vector<std::string> const& shaderDefines);
+  int         getShaderDefine(std::string const& name, const int compiledValue) const;
+  std::string ptxPath(std::string const& cudaFile);
+#if USE_RUNTIME_COMPILATION
+  std::string compileShader(std::string const& cudaFile);
+#endif
+
+  void initKernelCache();
+  void initUsageReport();
+
+  // Device memory accounting in src/MemoryReport.cpp.
+  void updateMemoryTracker();
+
+  // On-disk Acceleration cache in src/AccelerationCache.cpp.
+  optix::Buffer getInstanceBuffer(optix::GeometryInstance instance, const char* name);
+  static void   gatherGeometryGroups(optix::Group group, std::vector<optix::GeometryGroup>& geometryGroups);
+  void          restoreAccelerations();
+  void          storeAccelerations();
+
+#if USE_CUTOUT_CLASSIFICATION
+  // Per triangle cutout opacity classification in src/CutoutClassification.cpp.
+  void classifyCutoutOpacity();
+#endif
+
+  // Thin lens bokeh shape sampling table in src/Aperture.cpp.
+  void updateApertureTable();
+#if USE_FILTER_IMPORTANCE_SAMPLING
+  // Pixel filter sampling table in src/PixelFilter.cpp.
+  void updateFilterTable();
+  optix::float2 filterPixelSample(const optix::float2 sample) const;
+#endif
   
+  optix::Acceleration createAcceleration(const unsigned int numPrimitives, const AccelerationUsage usage, std::string const& builder = std::string());
   void setAccelerationProperties(optix::Acceleration acceleration);
 
+#if USE_ACCELERATION_POLICY
+  // Builder selection by primitive count and usage in src/AccelerationPolicy.cpp.
+  static bool isBuilderSupported(std::string const& builder);
+  std::string selectBuilder(const unsigned int numPrimitives, const AccelerationUsage usage) const;
+  void        selectTopLevelBuilder();
+  bool        selectAnimatedBuilder(optix::Acceleration acceleration);
+#endif
+
+  // Attaches the triangle geometry to the GeometryInstance, either as is or as GeometryTriangles sharing its buffers.
+  void setInstanceGeometry(optix::GeometryInstance instance, optix::Geometry geometry);
+
   void createLights();
+  void createLightGeometry(LightDefinition const& light, const int lightIndex); // Two world space triangles of a parallelogram light.
+  void buildLightAliasTable();
+#if USE_STRESS_SCENE
+  // Generated scaling benchmark scenes in src/StressScene.cpp.
+  bool parseStressConfig(std::string const& config);
+  void createStressMaterials();
+  void createStressScene();
+  void createStressLights();
+#endif
+#if USE_MESH_LIGHTS
+  // Emissive triangle meshes of the scene description in src/MeshLights.cpp.
+  void createMeshLights();
+#endif
+#if USE_SCENE_RELOAD
+  // Destroys everything createScene() and initScene() created, see src/SceneReload.cpp.
+  void unloadScene();
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+  // Density grids and majorant grids of the m_mediumConfigs in src/Media.cpp.
+  void initMedia();
+  void destroyMedia();
+  void updateMedia(); // Uploads m_mediumDefinitions into sysMedia.
+#endif
+  void updateEnvironmentMatrix(); // Rotation around the up-axis from m_environmentRotation.
+#if USE_GPU_ENVIRONMENT_CDF
+  void initEnvironmentDistribution();
+#endif
   
   void updateMaterialParameters();
+  void convertMaterialParameter(MaterialParameterGUI const& src, MaterialParameter& dst) const;
+#if USE_INCREMENTAL_MATERIALS
+  void markMaterialDirty(const int index);
+  void flushMaterialParameters();
+#endif
+
+  optix::Material getMaterial(const int index) const;
+#if USE_SPECIALIZED_MATERIALS
+  void updateMaterialBSDF(const int index);
+#endif
 
   void restartAccumulation();
 
+  void launchBenchmarkIteration(); // The launches of one benchmark iteration, sysIterationIndex is set by the caller.
+
+#if USE_WAVEFRONT
+  void renderWavefront();
+#if USE_WAVEFRONT_SORT
+  void initWavefrontSort();
+  void sortWavefront(const unsigned int count);
+#endif
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+  void updateConvergence();
+#endif
+
+#if USE_PATH_STATISTICS
+  void updatePathStatistics();
+#endif
+
+#if USE_RAY_COUNTERS
+  void clearRayCounters();
+  void updateRayCounters();
+#endif
+
+#if USE_PREVIEW_RESOLUTION
+  void renderPreview();
+  void setPreviewUpsampling(const bool enable);
+#endif
+
+#if USE_REPROJECTION
+  void initReprojection();
+  bool isReprojectionSupported() const;
+  bool reproject();
+  void setHistoryCamera(optix::float3 const& position, optix::float3 const& u, optix::float3 const& v, optix::float3 const& w);
+#endif
+
+#if USE_RASTER_PRIMARY
+  void initRasterPrimary();
+  bool isRasterPrimarySupported() const;
+  void rasterizePrimary();
+  void resizeRasterPrimary(const int width, const int height);
+  void initRasterMeshes();
+  void destroyRasterMeshes();
+#endif
+
+#if USE_RESTIR
+  void initRestir();
+  bool isRestirSupported() const;
+  bool updateRestir();
+  void advanceRestir(const bool restir);
+#endif
+
+#if USE_VISIBILITY_CACHE
+  // Per pixel shadow ray visibility of the primary hits in src/VisibilityCache.cpp.
+  void initVisibilityCache();
+  bool isVisibilityCacheSupported() const;
+  void updateVisibilityCache();
+#endif
+
+#if USE_RADIANCE_CACHE
+  void initRadianceCache();
+  bool isRadianceCacheSupported() const;
+  bool updateRadianceCache();
+  void resolveRadianceCache();
+#endif
+
+#if USE_GEOMETRY_PAGING
+  void                 initGeometryPaging();
+  void                 updateGeometryPaging();
+  size_t               createGeometryPage(std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices);
+  optix::GeometryGroup createPageGroup(const size_t index, const int materialIndex);
+  optix::Material      getPageProxyMaterial();
+  void                 pageIn(const size_t index);
+  void                 pageOut(const size_t index);
+#endif
+
+#if USE_STACK_CALIBRATION
+  void         initStackCalibration();
+  std::string  getStackConfigurationKey() const;
+  unsigned int loadStackSize() const;
+  void         storeStackSize(const unsigned int stackSize) const;
+  bool         probeStackSize(const unsigned int stackSize);
+#endif
+
+#if USE_AOVS
+  void               initAovs();
+  bool               isAovSupported() const;
+  void               resizeAovs(const int width, const int height);
+  void               writeAovs(std::string const& filename);
+  static std::string getAovName(const int aov);
+#endif
+
+#if USE_DYNAMIC_SCENE
+  void initDynamicScene();
+  void animateDemoScene(const float seconds);
+  bool updateDynamicScene();
+#endif
+
+#if USE_MULTI_VIEW
+  void initMultiView();
+  bool isMultiViewSupported() const;
+  bool updateViews();
+  void renderViews();
+#endif
+
+#if USE_WEDGE
+  void initWedge();
+  bool isWedgeSupported() const;
+  bool updateWedge();
+  void renderWedge();
+  void selectWedgeVariant(const int variant);
+  bool writeWedgeImages(std::string const& filename);
+#endif
+
+  void resolveAccumulation();
+  void uploadMapped(optix::Buffer buffer);
+  void uploadImage(const GLint internalFormat, const GLenum format, const GLenum type, const int bytesPerPixel, const void* data);
+  void drawImage();
+
+  void guiCamera(const bool captured, const bool down[3], const int x, const int y, const float wheel, const int width, const int height);
+  void cameraCommand(const int type, const int x, const int y, const float value);
+  void applyCommand(RenderCommand const& command);
+
+#if USE_RENDER_THREAD
+  void renderLoop();
+  void stopRenderThread();
+  bool guiFrameBegin();
+  void guiFrameEnd();
+  void pollCamera(const bool captured, const float wheel);
+  void publishFrame(const GLint internalFormat, const GLenum format, const GLenum type, const int bytesPerPixel, const void* data);
+  void presentFrame();
+#endif
+
+#if USE_DENOISER && USE_DENOISER_ALBEDO && USE_DENOISER_GBUFFER
+  void renderGuideBuffers(const int iteration, const int count);
+#endif
+
+#if USE_RENDER_SERVER || USE_DEVICE_TONEMAP
+  void setTonemapVariables();
+#endif
+#if USE_DEVICE_TONEMAP
+  void tonemapDevice(optix::Buffer source);
+  void setDisplayTonemapped(const bool tonemapped);
+#endif
+
+  void resizeBuffers(const int width, const int height);
+
+  bool isAccumulating() const;
+
+#if USE_SAMPLES_PER_LAUNCH
+  int getSamplesPerLaunch() const;
+#endif
+
+#if USE_DENOISER
+  optix::PostprocessingStage createDenoiserStage(optix::Buffer input, optix::Buffer albedo, optix::Buffer normals, optix::Buffer output);
+  void denoise();
+#endif
+#if USE_DENOISER && USE_DENOISER_TILES
+  bool isDenoiserTiled() const;
+  void initDenoiserTiles();
+  void denoiseTiles();
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+  void resetDenoiserConvergence();
+  void checkDenoiserConvergence();
+  void updateDenoiserConvergence();
+#endif
+#if USE_RESIZE_CAPACITY
+  bool isCapacityExact() const;
+  void fitCapacity();
+#endif
+
+#if USE_TILED_LAUNCH
+  void scheduleTiles();
+  bool renderTiles();
+#endif
+
+#if USE_MORTON_LAUNCH
+  RTsize getMortonLaunchSize() const;
+#endif
+
+#if USE_LIGHT_BAKE
+  void initLightBake();
+  void getBakeTriangles(const unsigned int root, std::vector<BakeTriangle>& triangles);
+#endif
+
+#if USE_PERSISTENT_THREADS
+  void initPersistentThreads();
+  bool isPersistentSupported() const;
+  void renderPersistent();
+#endif
+
+#if USE_RENDER_SERVER
+  bool serverCommand(RenderServer& server, std::string const& command); // Returns false when the server should stop.
+  bool serverParameter(std::string const& name, const float value);
+  void serverFrame(RenderServer& server);
+#if USE_TILED_LAUNCH
+  void serverTile(RenderServer& server, const int x, const int y, const int width, const int height, const int spp);
+  void getTileLayers(std::vector<optix::Buffer>& layers) const;
+#endif
+#endif
+
+#if USE_CHECKPOINTS
+  void getCheckpointLayers(std::vector<optix::Buffer>& layers) const;
+  unsigned long long getCheckpointHash() const;
+  void writeCheckpoint();
+  bool loadCheckpoint();
+#endif
+
+  // The part of screenshot() after the accumulation has been resolved into the shared output buffers.
+  void writeImage(std::string const& filename);
+
 private:
   GLFWwindow* m_window;
+  bool        m_headless; // No window, no OpenGL, no GUI. Only renderBatch() and serve() are usable.
 
   int         m_width;
   int         m_height;
+#if USE_RESIZE_CAPACITY
+  int         m_capacityWidth;  // Size of the per pixel buffers. The launches render into the lower left m_width * m_height.
+  int         m_capacityHeight;
+  Timer       m_resizeTimer;    // Restarted by each reshape(). render() shrinks the buffers when it passed RESIZE_SETTLE_SECONDS.
+#endif
   
   bool        m_isValid;
 
   // Application command line parameters.
   unsigned int m_devicesEncoding;
-  unsigned int m_stackSize;
+  unsigned int m_stackSize;       // 0 == the calibrated size of this configuration, see USE_STACK_CALIBRATION.
+#if USE_STACK_CALIBRATION
+  optix::Buffer m_bufferStackOverflows;
+#endif
   bool         m_interop;
   bool         m_light;
   unsigned int m_missID;
   std::string m_environmentFilename;
+  bool         m_wavefront; // Use the wavefront path tracer with one launch per path segment instead of the megakernel.
 
   // Applicatoin GUI parameters.
   int   m_minPathLength;       // Minimum path length after which Russian Roulette path termination starts.
   int   m_maxPathLength;       // Maximum path length.
+  int   m_lightSamples;        // Light samples and shadow rays per diffuse hit with next event estimation.
+  int   m_rouletteType;        // RouletteType, see shaders/roulette_type.h.
+  float m_rouletteWindow;      // Ratio between the upper and lower bound of the ROULETTE_WEIGHT_WINDOW.
   float m_sceneEpsilonFactor;  // Factor on 1e-7 used to offset ray origins along the path to reduce self intersections. 
   float m_environmentRotation;
   
   int   m_iterationIndex;
+
+  int  m_sampler;     // SAMPLER_LCG or SAMPLER_SOBOL, see shaders/sampler.h.
+  std::string m_sceneFilename; // Scene description with OBJ/PLY mesh instances. Empty == hard-coded demo scene.
+  bool m_geometryTriangles;    // Build GeometryTriangles from the triangle Geometry buffers to use the hardware intersection.
+  bool m_flatten;              // Bake static Transforms into the vertex data and merge these objects under one GeometryGroup.
+  std::string m_accelerationCache; // Directory with the serialized bottom level Accelerations. Empty == always build.
+  float       m_geometryBudget;    // MiB of device memory for the scene description meshes. 0 == all meshes stay resident.
+  float       m_buildBudget;       // MiB of estimated Acceleration build memory per scene description mesh. 0 == no chunking.
+  float       m_lodError;          // Pixels the clustering cells of a mesh level of detail may cover. 0 == full resolution only.
+  std::string m_stressScene;       // instances,lights,materials,textures,seed of the generated scene. Empty == --scene or the demo scene.
+  std::string m_kernelCache;       // Directory of the OptiX disk cache for compiled kernels. Empty == OptiX default location.
+  int         m_kernelCacheSize;   // MiB. High water mark of the OptiX disk cache. 0 == OptiX default limits.
+  KernelCacheStatistics m_kernelCacheStatistics; // Disk cache lookups counted from the usage report.
+  std::string             m_usageReportFilename; // Not empty == log all OptiX usage reports into this CSV or JSON file.
+  sutil::UsageReportLogger m_usageReport;        // Writes the log file on destruction, after the context is destroyed.
+  bool m_halfDisplay; // Non-interop uploads transfer an RGBA16F copy of the image.
+
+  std::unique_ptr<sutil::BufferUploader> m_uploader; // Pinned staging uploads of the geometry and material buffers. Flushed before launches.
+
+  bool m_localAccumulation; // Multi-GPU with RT_BUFFER_GPU_LOCAL accumulation buffers and a resolve launch before presenting.
+
+  std::map<std::string, int>         m_shaderDefines; // app_config.h switches which differ from the compiled values. Empty == use the built PTX.
+  std::set<std::string>              m_shaderPtx;     // PTX file names compiled at runtime, registered with sutil::registerEmbeddedPTX().
+
+#if USE_PREVIEW_RESOLUTION
+  int  m_previewFactor; // Resolution divisor per axis during camera interaction. 1 == preview off.
+  bool m_previewActive; // The last render() call rendered the preview. Its end restarts the full resolution accumulation.
+#endif
+
+#if USE_REPROJECTION
+  bool          m_reprojection;          // Camera changes warp the accumulation into the new view instead of restarting it.
+  bool          m_reprojected;           // The current accumulation continues a reprojected history (sysReprojection 2).
+  int           m_reprojectionHistory;   // Maximum number of samples a pixel keeps across a camera change.
+  float         m_reprojectionTolerance; // Primary hit position difference relative to the hit distance which counts as disocclusion.
+  optix::float3 m_historyCameraPosition; // The camera of the current accumulation.
+  optix::float3 m_historyCameraU;
+  optix::float3 m_historyCameraV;
+  optix::float3 m_historyCameraW;
+#endif
+
+#if USE_RASTER_PRIMARY
+  bool   m_rasterPrimary;     // Rasterize the distance to the primary hits with OpenGL before each launch.
+  bool   m_rasterInitialized; // The OpenGL objects and meshes exist. Created by the first rasterizePrimary().
+  bool   m_rasterStatic;      // No Transform in the scene has motion keys. One rasterization is only valid for static scenes.
+  GLuint m_rasterVS;
+  GLuint m_rasterFS;
+  GLuint m_rasterProgram;
+  GLuint m_rasterFramebuffer;
+  GLuint m_rasterTexture;     // GL_R32F color attachment receiving the minimum distance per pixel.
+  GLuint m_pboRasterDistance; // Pixel pack buffer behind m_bufferRasterDistance.
+  std::vector<RasterMesh> m_rasterMeshes;
+  std::vector<RasterDraw> m_rasterDraws;
+#endif
+
+#if USE_RESTIR
+  bool m_restir;           // Resample the direct lighting of the diffuse primary hits.
+  int  m_restirCandidates; // Light samples streamed through the reservoir of each primary hit.
+  int  m_restirCurrent;    // Index of the m_bufferReservoirs the current iteration writes.
+  bool m_restirValid;      // The previous reservoirs were written by the last iteration at the current resolution.
+#endif
+
+#if USE_VISIBILITY_CACHE
+  bool         m_visibilityCache; // Skip the primary hit shadow rays of pixels whose visibility is known.
+  unsigned int m_visibilityEpoch; // Tags the counts of the current accumulation, incremented by restartAccumulation().
+#endif
+
+#if USE_RADIANCE_CACHE
+  int   m_cacheBounces;  // Diffuse bounces before the paths terminate into the radiance cache. 0 == off.
+  float m_cacheCellSize; // Voxel edge length in world space.
+  int   m_cacheHistory;  // Maximum number of iterations averaged per cell.
+  bool  m_cacheReset;    // Clear the table before its next use.
+#endif
+
+#if USE_DYNAMIC_SCENE
+  bool  m_animation;      // Animate the demo scene in the interactive mode.
+  float m_refitThreshold; // Deformation relative to the mesh size which still refits the Acceleration.
+  bool  m_dynamicChanged; // A matrix or vertex buffer changed since the last updateDynamicScene().
+  int   m_dynamicRefits;
+  int   m_dynamicRebuilds;
+  Timer m_animationTimer;
+  std::vector<DynamicInstance>  m_dynamicInstances;
+  std::vector<DynamicMesh>      m_dynamicMeshes;
+  std::vector<VertexAttributes> m_animationRest; // The original vertices of the waving demo sphere.
+#endif
+
+#if USE_GEOMETRY_PAGING
+  std::vector<GeometryPage> m_geometryPages;
+  optix::Buffer             m_bufferPageCounters; // One uint2 per page, see shaders/geometry_paging.h.
+  optix::Material           m_pageProxyMaterial;
+  unsigned int              m_pagingEpoch;        // Counts the read backs of m_bufferPageCounters.
+  size_t                    m_pagedBytes;         // Sum of the resident pages.
+#endif
+
+#if USE_SPECTRAL
+  bool m_spectral; // Paths carry a hero wavelength for dispersion.
+#endif
+
+#if USE_AOVS
+  unsigned int               m_aovMask;      // AOV_BIT() of the enabled AOVs.
+  optix::Buffer              m_bufferAovIds; // Bindless IDs of m_bufferAovs, see shaders/aov.h.
+  std::vector<optix::Buffer> m_bufferAovs;   // NUMBER_OF_AOVS, null when disabled.
+#endif
+
+#if USE_MULTI_VIEW
+  int           m_multiView;        // MULTI_VIEW_OFF, MULTI_VIEW_STEREO or MULTI_VIEW_CUBEMAP.
+  float         m_stereoSeparation; // Distance between the eyes in world units.
+  bool          m_viewsDirty;       // Camera, resolution or mode changed since the last updateViews().
+  optix::uint2  m_viewSize;         // Launch width and height, the same for all views.
+  unsigned int  m_viewCount;        // Number of valid entries in m_bufferViews.
+#endif
+
+#if USE_WEDGE
+  std::string m_wedgeFilename;
+  std::vector< std::vector<WedgeOverride> > m_wedgeVariants; // The overrides of each variant, applied on top of the GUI materials.
+  int  m_wedgeDisplay;  // The variant copied into the output buffer for display, denoiser and screenshots.
+  bool m_wedgeDirty;    // Base materials or variants changed since the last updateWedge().
+  bool m_wedgeActive;   // sysMaterialParameters is bound to m_bufferWedgeMaterials.
+#endif
+
+#if USE_PERSISTENT_THREADS
+  int           m_persistentThreads;         // Per streaming multiprocessor. 0 == one thread per pixel.
+  int           m_persistentMultiprocessors; // Of the single enabled device.
+  unsigned int  m_persistentBase;            // Value of the never reset m_bufferPersistentCounter at the start of the next launch.
+  optix::Buffer m_bufferPersistentCounter;
+#endif
+
+#if USE_MESH_LOD
+  std::vector<LodInstance> m_lodInstances;
+#endif
+
+#if USE_STRESS_SCENE
+  StressConfig                        m_stress;
+  std::vector<optix::TextureSampler>  m_stressTextures;
+#endif
+
+#if USE_SCENE_RELOAD
+  char m_guiSceneFilename[1024]; // Contents of the "Reload Scene" GUI field.
+#endif
+
+#if USE_HETEROGENEOUS_MEDIA
+  std::vector<MediumConfig>           m_mediumConfigs;
+  std::vector<MediumDefinition>       m_mediumDefinitions; // The configs whose material is used, density, albedo and anisotropy are edited in the GUI.
+  std::vector<optix::TextureSampler>  m_mediumDensities;
+  std::vector<optix::Buffer>          m_mediumMajorants;
+  optix::Buffer                       m_bufferMedia;       // sysMedia, at least one element.
+#endif
+
+#if USE_MESH_LIGHTS
+  std::vector<MeshLight>     m_meshLights;       // Filled by loadSceneDescription(), consumed by createMeshLights().
+  std::vector<optix::Buffer> m_meshLightBuffers; // The world space triangles and the triangle alias table per mesh light.
+#endif
+
+#if USE_MORTON_LAUNCH
+  bool m_mortonLaunch; // The megakernel launch maps the linear launch index to Morton ordered pixels.
+#endif
+
+#if USE_DENOISER && USE_DENOISER_DEVICE
+  std::unique_ptr<DenoiserDevice> m_denoiserDevice; // nullptr == denoise in m_context.
+#endif
+
+#if USE_LIGHT_BAKE
+  optix::Buffer m_bufferBakePositions; // RGBA32F world space surface point per lightmap texel, w == covered.
+  optix::Buffer m_bufferBakeNormals;   // RGBA32F world space shading normal per texel, w == world size of the texel.
+#endif
+
+#if USE_TILED_LAUNCH
+  int   m_tileSize;     // Edge length of the tile launches in pixels. 0 == one launch over the full resolution.
+  float m_frameBudget;  // Milliseconds of tile launches per render() call before returning to the GUI event loop.
+  optix::float2 m_tileFocus; // Tiles nearest to this pixel coordinate are rendered first. Cursor position or screen center.
+  std::vector<optix::uint2> m_tileQueue; // The tile offsets of the current iteration in priority order.
+  size_t m_tileNext;    // Index of the next tile to render inside m_tileQueue.
+#endif
+
+#if USE_SAMPLES_PER_LAUNCH
+  int m_samplesPerLaunch; // Requested samples per pixel of one megakernel launch, see getSamplesPerLaunch().
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+  float m_targetError;        // Relative standard error at which a tile stops receiving samples. 0.0f == adaptive sampling off.
+  int   m_adaptiveMinSamples; // Number of iterations before the first convergence check.
+  int   m_adaptiveInterval;   // Number of iterations between convergence checks.
+  int   m_tilesX;
+  int   m_tilesY;
+  int   m_numActiveTiles;     // Number of entries in m_bufferActiveTiles. -1 == render all pixels.
+  bool  m_converged;          // All tiles reached the target error. Accumulation stops like when reaching m_frames.
+  std::vector<unsigned char> m_tileConverged; // Converged tiles stay converged until the accumulation restarts.
+#endif
   
-  std::string m_builder;
+  std::string m_builder; // The builder of all Accelerations without USE_ACCELERATION_POLICY, else the default of the policy.
+#if USE_ACCELERATION_POLICY
+  std::set<RTacceleration> m_fixedBuilders; // Accelerations whose builder the scene description forced.
+#endif
   
   // OpenGL variables:
   GLuint m_pboOutputBuffer;
@@ -197,20 +1136,167 @@ private:
 
   optix::Buffer m_bufferOutput;
 
+#if USE_HALF_DISPLAY
+  optix::Buffer m_bufferDisplayHalf;  // RT_FORMAT_HALF4 copy of the displayed image for the non-interop upload.
+  optix::Buffer m_displayHalfSource;  // The buffer currently bound to sysDisplaySource.
+#endif
+
+#if USE_RENDER_SERVER
+  optix::Buffer m_bufferEncode;     // RT_FORMAT_UNSIGNED_BYTE4 tonemapped image for the render server clients.
+  bool          m_serverAccumulate; // False while the server is used as distributed rendering worker.
+#endif
+
+#if USE_DEVICE_TONEMAP
+  optix::Buffer m_bufferTonemap;      // RT_FORMAT_UNSIGNED_BYTE4 tonemapped image, bottom row first.
+  bool          m_deviceTonemap;      // Tonemap on the device for the non-interop uploads and the LDR screenshots.
+  bool          m_displayTonemapped;  // The m_hdrTexture currently holds the RGBA8 tonemapped image. The GLSL shader passes it through.
+#endif
+
+#if USE_CHECKPOINTS
+  std::string m_checkpointFilename; // Not empty == renderBatch() writes checkpoints.
+  double      m_checkpointInterval; // Seconds between the checkpoints. 0 == only at the end.
+  bool        m_checkpointResume;   // Load the checkpoint with the next render() call.
+  std::thread m_checkpointWriter;   // Writes the last copied checkpoint to disk.
+#endif
+
+#if USE_GPU_LOCAL_ACCUMULATION
+  optix::Buffer m_bufferLocalOutput; // RT_BUFFER_GPU_LOCAL accumulation, resolved into m_bufferOutput.
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  optix::Buffer m_bufferLocalAlbedo;
+#if USE_DENOISER_NORMAL
+  optix::Buffer m_bufferLocalNormal;
+#endif
+#endif
+#endif
+#endif
+
+#if USE_PREVIEW_RESOLUTION
+  optix::Buffer m_bufferPreview; // RGBA32F at the reduced resolution, never an interop buffer.
+#endif
+
+#if USE_REPROJECTION
+  optix::Buffer m_bufferPosition;        // Primary hit per pixel for the disocclusion test.
+  optix::Buffer m_bufferSampleCount;     // Samples per pixel.
+  optix::Buffer m_bufferHistoryOutput;   // Copies of the accumulation before the camera change.
+  optix::Buffer m_bufferHistoryPosition;
+  optix::Buffer m_bufferHistoryCount;
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+  optix::Buffer m_bufferHistoryAlbedo;
+#endif
+#endif
+
+#if USE_RASTER_PRIMARY
+  optix::Buffer m_bufferRasterDistance; // RT_FORMAT_FLOAT interop buffer of m_pboRasterDistance, a 1x1 placeholder before initRasterPrimary().
+#endif
+
+#if USE_RESTIR
+  optix::Buffer m_bufferReservoirs[2]; // Reservoir per pixel of the current and the previous iteration.
+#endif
+
+#if USE_VISIBILITY_CACHE
+  optix::Buffer m_bufferVisibilityCounts; // Epoch and shadow ray counts of the primary hits per pixel.
+#endif
+
+#if USE_RADIANCE_CACHE
+  optix::Buffer m_bufferCacheKeys;  // RADIANCE_CACHE_CELLS voxel fingerprints.
+  optix::Buffer m_bufferCacheAccum; // Radiance samples of the current iteration per cell.
+  optix::Buffer m_bufferCacheValue; // Cached outgoing radiance per cell.
+#endif
+
+#if USE_MULTI_VIEW
+  optix::Buffer m_bufferViews; // MULTI_VIEW_MAX_VIEWS ViewDefinition.
+#endif
+
+#if USE_WEDGE
+  optix::Buffer m_bufferWedgeMaterials; // Variant count times the number of materials MaterialParameter.
+  optix::Buffer m_bufferWedge;          // RGBA32F width * height * variant count accumulation.
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+  optix::Buffer m_bufferMoment;      // Second moment of the radiance intensity per pixel.
+  optix::Buffer m_bufferTileError;   // Error estimate per tile.
+  optix::Buffer m_bufferActiveTiles; // List of tile coordinates which are still rendered.
+#endif
+
+#if USE_PATH_STATISTICS
+  optix::Buffer       m_bufferPathStatistics; // Per launch counters, see PATH_STATISTICS_SLOTS.
+  std::vector<double> m_pathStatistics;       // Accumulated since the last restart.
+  float               m_rouletteMean;         // Mean radiance intensity per primary path for the weight window.
+#endif
+
+#if USE_RAY_COUNTERS
+  optix::Buffer      m_bufferRayCounters;              // Device counters since the last read back, see RAY_COUNTER_SLOTS.
+  unsigned long long m_rayCounters[RAY_COUNTER_SLOTS]; // Accumulated since the last restart.
+  double             m_rayCountersSeconds;             // m_timer time of the last read back.
+#endif
+
+#if USE_COST_HEATMAP
+  optix::Buffer m_bufferCost;  // clock64() cycles per pixel, see shaders/cost_heatmap.h.
+  int           m_costHeatmap; // COST_HEATMAP_OFF, COST_HEATMAP_FRAME or COST_HEATMAP_AVERAGE.
+  float         m_costScale;   // Cycles shown in red.
+#endif
+
+#if USE_WAVEFRONT
+  optix::Buffer m_bufferWavefrontPaths;    // Two queues of WavefrontPath with one element per pixel each.
+  optix::Buffer m_bufferWavefrontCounter;  // Number of live paths written by the last extend launch.
+  optix::Buffer m_bufferWavefrontRadiance; // Per iteration radiance, resolved into m_bufferOutput.
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  optix::Buffer m_bufferWavefrontAlbedo;
+#if USE_DENOISER_NORMAL
+  optix::Buffer m_bufferWavefrontNormal;
+#endif
+#endif
+#endif
+#if USE_WAVEFRONT_SORT
+  optix::Buffer m_bufferWavefrontKeys; // Sort key per output queue slot.
+  optix::Buffer m_bufferWavefrontBins; // Paths per key and the scatter offsets, updated by the host before each sort launch.
+  bool          m_wavefrontSort;       // Sort the live paths between the extend launches.
+  float         m_wavefrontSortCell;   // Edge length of the origin cells in world units.
+#endif
+#endif
+
   std::map<std::string, optix::Program> m_mapOfPrograms;
 
+  std::vector<AccelerationCacheEntry> m_accelerationCacheEntries;
+
+#if OPTIX_VERSION >= 60000
+  std::map<RTgeometry, optix::GeometryTriangles> m_mapOfGeometryTriangles; // One GeometryTriangles per Geometry, so instances can share accelerations.
+#endif
+
   // The material parameters exposed inside the GUI are slightly different than the resulting values for the device.
   // The GUI exposes an absorption color and a distance scale, and the thin-walled property as bool.
   // These are converted on the fly into the device side sysMaterialParameters buffer.
   std::vector<MaterialParameterGUI> m_guiMaterialParameters;
   optix::Buffer                     m_bufferMaterialParameters; // Array of MaterialParameters.
+#if USE_INCREMENTAL_MATERIALS
+  std::vector<MaterialParameter> m_materialParameters;       // Host copy of the converted m_bufferMaterialParameters contents.
+  std::vector<int>               m_materialsDirty;           // Indices of the GUI materials changed since the last flush.
+  std::vector<unsigned char>     m_materialDirtyFlags;       // Non-zero when the material index is inside m_materialsDirty.
+  optix::Buffer                  m_bufferMaterialUpdates;    // Staging buffer with the MaterialUpdates of one flush.
+  bool                           m_materialUpdateKernel;     // Single device, m_bufferMaterialParameters is RT_BUFFER_INPUT_OUTPUT.
+#endif
 
   LensShader m_cameraType;
+  float      m_lensRadius;       // Thin lens aperture radius in world units.
+  int        m_apertureBlades;   // Number of aperture blades of the bokeh shape. Less than 3 is a circular aperture.
+  float      m_apertureRotation; // Rotation of the polygonal bokeh shape in degrees.
   
   int        m_shutterType;
+  int        m_timeSlices;  // Launches sharing the shutter interval with the stochastic shutter.
+#if USE_FILTER_IMPORTANCE_SAMPLING
+  int                m_pixelFilter;  // PixelFilter, see shaders/lens_shader_type.h.
+  float              m_filterRadius; // Filter support in pixels around the pixel center.
+  std::vector<float> m_filterTable;  // Host copy of m_bufferFilterTable.
+#endif
   
 
   optix::Buffer m_bufferLensShader;
+  optix::Buffer m_bufferApertureTable;
+#if USE_FILTER_IMPORTANCE_SAMPLING
+  optix::Buffer m_bufferFilterTable;
+#endif
   optix::Buffer m_bufferSampleBSDF;
   optix::Buffer m_bufferEvalBSDF;
   optix::Buffer m_bufferSampleLight;
@@ -245,24 +1331,46 @@ private:
 
   Timer m_timer;
 
+  double m_timeInitScene; // Seconds spent inside initScene(), reported by benchmark().
+
+  Profiler m_profiler;
+
+  MemoryTracker m_memoryTracker;
+  std::string   m_memoryReportFilename; // Not empty == write the MemoryTracker report on exit.
+
   std::vector<LightDefinition> m_lightDefinitions;
   optix::Buffer                m_bufferLightDefinitions;
+  optix::Buffer                m_bufferLightAliasTable;
 
   Texture m_environmentTexture;
 
   Texture m_textureAlbedo;
   Texture m_textureCutout;
+#if USE_VIRTUAL_TEXTURES
+  VirtualTexture m_virtualAlbedo;          // Replaces m_textureAlbedo.
+  optix::Buffer  m_bufferVirtualTextures;  // Array of VirtualTextureDescription.
+#endif
+#if USE_CUTOUT_CLASSIFICATION
+  std::string m_textureCutoutFilename; // classifyCutoutOpacity() loads the image again on the host.
+#endif
 
   // There are only three types of materials in this demo.
   // The material parameters for these are determined by the parMaterialIndex variable on the GeometryInstance.
   optix::Material m_opaqueMaterial; // Used for all materials without cutout opacity.
   optix::Material m_cutoutMaterial; // Used for all materials with cutout opacity.
   optix::Material m_lightMaterial;  // Used for all geometric lights. (Special cased diffuse emission distribution function to simplify the material system.)
+#if USE_SPECIALIZED_MATERIALS
+  std::vector<optix::Material> m_materials; // One per material parameter index with the closest hit program specialized for its BSDF.
+#endif
 
   // The root node of the OptiX scene graph (sysTopObject)
   optix::Group        m_rootGroup;
   optix::Acceleration m_rootAcceleration;
 
+#if USE_ASYNC_SCREENSHOTS
+  sutil::ImageWriter m_imageWriter; // Destroyed after the context, it only holds copies of the output.
+#endif
+
 #if USE_DENOISER
   optix::CommandList         m_commandListDenoiser;
   optix::PostprocessingStage m_stageDenoiser;
@@ -273,7 +1381,54 @@ private:
   optix::Buffer              m_bufferNormals; // Normals can only be used when albedo is also used.
 #endif
 #endif
+  bool                       m_useDenoiser;       // False when the shaders were compiled with USE_DENOISER 0 at runtime.
+  bool                       m_useDenoiserAlbedo;
+  bool                       m_useDenoiserNormal;
   float                      m_denoiseBlend;
+  float                      m_denoiseBudget;     // Milliseconds. While navigating the noisy image is shown when the denoiser takes longer. 0.0f == no limit.
+  int                        m_denoiseCadence;    // Minimum number of new iterations before the denoiser runs again when not navigating.
+  float                      m_denoiseMaxMem;     // Megabytes. Maximum memory the denoiser may use. 0.0f == no limit.
+  float                      m_denoiseTime;       // Milliseconds of the last denoiser execution.
+#if USE_DENOISER_TILES
+  int                        m_denoiseTileSize;   // Pixels. Edge length of the denoiser tiles without the overlap. 0 == full frame.
+  int                        m_denoiseTileExtent; // Edge length of the current tile buffers. 0 == the tile stage doesn't exist yet.
+  optix::Buffer              m_bufferDenoiserTileInput;
+#if USE_DENOISER_ALBEDO
+  optix::Buffer              m_bufferDenoiserTileAlbedo;
+#if USE_DENOISER_NORMAL
+  optix::Buffer              m_bufferDenoiserTileNormal;
+#endif
+#endif
+  optix::Buffer              m_bufferDenoiserTileOutput;
+  optix::PostprocessingStage m_stageDenoiserTile;
+  optix::CommandList         m_commandListDenoiserTile;
+#endif
+  int                        m_denoisedIteration; // m_iterationIndex at the last denoiser execution. -1 == The current accumulation has not been denoised.
+#if USE_DENOISER_CONVERGENCE
+  optix::Buffer              m_bufferDenoisedPrevious; // The denoised image of the last comparison.
+  optix::Buffer              m_bufferDenoisedChange;   // Mean relative change per DENOISER_CHANGE_TILE_SIZE tile.
+  float                      m_stableThreshold;   // Change below which the denoised image counts as stable. 0.0f == off.
+  float                      m_denoisedChange;    // Largest tile change of the last comparison. -1.0f == none since the restart.
+  int                        m_stableChecks;      // Number of consecutive comparisons below m_stableThreshold.
+  int                        m_stableIteration;   // m_iterationIndex at the last headless comparison.
+  bool                       m_denoisedStable;    // Accumulation stops like when reaching m_frames.
+  bool                       m_denoisedReference; // m_bufferDenoisedPrevious holds a denoised image of the current accumulation.
+#endif
+#endif
+
+#if USE_RENDER_THREAD
+  std::thread                          m_renderThread;
+  bool                                 m_renderThreadActive; // render() runs on m_renderThread, which has no OpenGL context.
+  std::mutex                           m_renderMutex;
+  std::condition_variable              m_renderCondition;
+  bool                                 m_guiRequest;         // The GUI thread wants to access the Application. Guarded by m_renderMutex.
+  bool                                 m_renderParked;       // The render thread waits between two iterations. Guarded by m_renderMutex.
+  bool                                 m_renderExit;         // Guarded by m_renderMutex.
+  CommandQueue<RenderCommand, 1024>    m_renderCommands;
+  FrameExchange                        m_renderFrames;
+  int                                  m_uiWidth;            // Framebuffer size on the GUI thread. The render thread owns m_width and m_height.
+  int                                  m_uiHeight;
+  bool                                 m_presentTonemapped;  // The m_hdrTexture holds a device tonemapped frame.
 #endif
 };
 
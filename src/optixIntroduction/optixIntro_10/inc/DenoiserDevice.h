@@ -0,0 +1,104 @@
+// Copyright NVIDIA Corporation 2002-2005
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// This code is part of the NVIDIA nvpro-pipeline https://github.com/nvpro-pipeline/pipeline
+
+#pragma once
+
+#ifndef DENOISER_DEVICE_H
+#define DENOISER_DEVICE_H
+
+#include <optix.h>
+#include <optixu/optixpp_namespace.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "inc/RenderThread.h"
+
+// The DL Denoiser in its own OptiX context on a GPU which doesn't render. The render thread submits snapshots of the
+// accumulation and continues tracing, a worker thread denoises the newest snapshot and publishes the result, which the
+// display acquires whenever one is ready. Snapshots arriving while the worker is busy replace the pending one.
+// The snapshots are staged in host memory, two OptiX contexts can't share device buffers.
+class DenoiserDevice
+{
+public:
+  DenoiserDevice();
+  ~DenoiserDevice();
+
+  // Creates the context on the device ordinal and starts the worker. Returns false when the device can't be used.
+  bool init(const int device, const bool albedo, const bool normal, const float blend, const float maxMem);
+
+  // Copies the RGBA32F images of width x height pixels with rows of pitch pixels. albedo and normal may be nullptr
+  // when init() didn't enable them. Returns without waiting for the denoiser.
+  void submit(const float* beauty, const float* albedo, const float* normal, const int width, const int height, const int pitch, const int iteration);
+
+  // The newest denoised RGBA32F image, or nullptr when nothing new was published since the last call.
+  RenderFrame const* acquire();
+
+  // Iteration index of the newest denoised snapshot. -1 == none yet.
+  int getDenoisedIteration() const;
+
+private:
+  struct Snapshot
+  {
+    std::vector<float> beauty;
+    std::vector<float> albedo;
+    std::vector<float> normal;
+    int                width;
+    int                height;
+    int                iteration;
+  };
+
+  void worker();
+  void resize(const int width, const int height);
+
+private:
+  optix::Context             m_context;
+  optix::Buffer              m_bufferInput;
+  optix::Buffer              m_bufferAlbedo;
+  optix::Buffer              m_bufferNormal;
+  optix::Buffer              m_bufferOutput;
+  optix::PostprocessingStage m_stage;
+  optix::CommandList         m_commandList;
+  int                        m_width;  // Of the command list. 0 == not created yet.
+  int                        m_height;
+  bool                       m_albedo;
+  bool                       m_normal;
+
+  std::thread             m_thread;
+  std::mutex              m_mutex;     // Guards m_pending, m_quit and m_snapshot.
+  std::condition_variable m_wake;
+  Snapshot                m_snapshot;  // The newest submitted snapshot.
+  Snapshot                m_working;   // The one the worker denoises.
+  bool                    m_pending;   // m_snapshot hasn't been picked up by the worker yet.
+  bool                    m_quit;
+  FrameExchange           m_frames;    // The published results.
+  int                     m_denoisedIteration;
+};
+
+#endif // DENOISER_DEVICE_H
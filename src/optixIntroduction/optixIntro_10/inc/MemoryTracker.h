@@ -0,0 +1,135 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <optix.h>
+#include <optixu/optixpp_namespace.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+
+// The groups in which the MemoryTracker reports the allocations.
+enum MemoryCategory
+{
+  MEMORY_GEOMETRY,     // Vertex attributes and indices of all Geometry and GeometryTriangles.
+  MEMORY_ACCELERATION, // Serialized size of all built Accelerations. The device side data is about the same size.
+  MEMORY_TEXTURE,      // Texture buffers including mipmaps and the environment importance sampling data.
+  MEMORY_FRAMEBUFFER,  // Per pixel output, accumulation and integrator state buffers.
+  MEMORY_DENOISER,     // Denoiser input and output buffers. Its internal scratch memory is not visible.
+  MEMORY_OTHER,        // Materials, lights, camera and BSDF tables.
+  NUMBER_OF_MEMORY_CATEGORIES
+};
+
+
+/*! \brief Sums the sizes of OptiX buffers and Accelerations per MemoryCategory and queries the free device memory.
+  * Objects are added by handle, adding the same object twice counts it once. The sizes are logical,
+  * OptiX keeps a copy of input buffers on each device and RT_BUFFER_GPU_LOCAL buffers exist once per device. */
+class MemoryTracker
+{
+public:
+  MemoryTracker();
+
+  //! Forgets all objects and device information.
+  void clear();
+
+  //! Null handles are ignored.
+  void addBuffer(const MemoryCategory category, optix::Buffer buffer, std::string const& name);
+  void addTextureSampler(const MemoryCategory category, optix::TextureSampler sampler, std::string const& name);
+  void addAcceleration(optix::Acceleration acceleration, std::string const& name);
+
+  //! Adds all buffer variables of the Geometry, GeometryTriangles or GeometryInstance.
+  template <typename T>
+  void addVariables(const MemoryCategory category, T object, std::string const& name);
+
+  //! Queries the total and available memory of the enabled devices.
+  void queryDevices(optix::Context context);
+
+  size_t getBytes(const MemoryCategory category) const;
+  size_t getTotalBytes() const;
+
+  unsigned int getNumberOfDevices() const;
+  std::string const& getDeviceName(const unsigned int index) const;
+  size_t getDeviceTotalBytes(const unsigned int index) const;
+  size_t getDeviceAvailableBytes(const unsigned int index) const;
+
+  static const char* getCategoryName(const MemoryCategory category);
+
+  //! Writes the devices, the category totals and all objects sorted by size. Returns false when the file could not be written.
+  bool write(std::string const& filename) const;
+
+  static size_t getBufferBytes(optix::Buffer buffer);
+
+private:
+  struct Entry
+  {
+    MemoryCategory category;
+    std::string    name;
+    size_t         bytes;
+  };
+
+  struct Device
+  {
+    std::string name;
+    size_t      total;
+    size_t      available;
+  };
+
+  void add(const MemoryCategory category, const void* handle, std::string const& name, const size_t bytes);
+
+private:
+  std::set<const void*> m_handles; // Already counted objects.
+  std::vector<Entry>    m_entries;
+  size_t                m_bytes[NUMBER_OF_MEMORY_CATEGORIES];
+  std::vector<Device>   m_devices;
+};
+
+
+template <typename T>
+void MemoryTracker::addVariables(const MemoryCategory category, T object, std::string const& name)
+{
+  if (!object)
+  {
+    return;
+  }
+  for (unsigned int i = 0; i < object->getVariableCount(); ++i)
+  {
+    optix::Variable variable = object->getVariable(i);
+    if (variable->getType() == RT_OBJECTTYPE_BUFFER)
+    {
+      addBuffer(category, variable->getBuffer(), name + std::string(".") + variable->getName());
+    }
+  }
+}
+
+#endif // MEMORY_TRACKER_H
@@ -0,0 +1,110 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "inc/Timer.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// The per frame stages measured by the Profiler.
+enum ProfilerStage
+{
+  PROFILER_LAUNCH,   // All OptiX launches of one render() call. Launches are synchronous, so this is the GPU time.
+  PROFILER_DENOISER, // The DLDenoiser command list execution.
+  PROFILER_UPLOAD,   // Resolve, buffer map and OpenGL texture upload.
+  PROFILER_DISPLAY,  // OpenGL display of the texture. Submission time only, OpenGL is not synchronized here.
+  NUMBER_OF_PROFILER_STAGES
+};
+
+
+/*! \brief Records the time spent in each ProfilerStage per frame.
+  * Frames are only recorded when a filename has been set. The records are written as
+  * JSON when the filename ends with ".json", otherwise as CSV, when the Profiler is destroyed. */
+class Profiler
+{
+public:
+  Profiler();
+  ~Profiler();
+
+  //! Enables the recording. An empty filename disables it.
+  void setFilename(std::string const& filename);
+
+  bool isEnabled() const { return !m_filename.empty(); }
+
+  //! Additional key value pairs written into the file header, like OptiX version and device names.
+  void setInfo(std::string const& key, std::string const& value);
+
+  //! Finishes the current frame record and starts a new one.
+  void nextFrame(const int iteration);
+
+  //! Finishes the current frame record without starting a new one. Called before writing the file.
+  void finish();
+
+  void begin(const ProfilerStage stage);
+  void end(const ProfilerStage stage);
+
+  //! Radiance and shadow rays read back from the device counters during the current frame.
+  //! The counters are read once per second, so a frame holds the rays of all frames since the previous read back.
+  void addRays(const unsigned long long rays);
+
+  //! Writes all frame records. Returns false when the file could not be written.
+  bool write() const;
+
+private:
+  struct Frame
+  {
+    int    iteration; // m_iterationIndex at the start of the frame.
+    double time;      // Seconds since the Profiler construction.
+    double seconds[NUMBER_OF_PROFILER_STAGES];
+    unsigned long long rays;
+  };
+
+  void writeCSV(std::ostream& stream) const;
+  void writeJSON(std::ostream& stream) const;
+
+private:
+  std::string m_filename;
+
+  Timer m_clock;
+  Timer m_timers[NUMBER_OF_PROFILER_STAGES];
+
+  bool  m_hasFrame;
+  Frame m_frame;
+
+  std::vector<Frame> m_frames;
+  std::vector< std::pair<std::string, std::string> > m_info;
+};
+
+#endif // PROFILER_H
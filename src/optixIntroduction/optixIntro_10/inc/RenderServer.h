@@ -0,0 +1,108 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <cstdint>
+typedef std::uintptr_t ServerSocket; // SOCKET
+#else
+typedef int ServerSocket;
+#endif
+
+
+/*! \brief TCP transport of the render server mode. Serves one client at a time with a line based text protocol.
+  * The server does not interpret the commands, the Application does. Replies and frames are sent blocking. */
+class RenderServer
+{
+public:
+  RenderServer();
+  ~RenderServer();
+
+  //! Listens on all interfaces. Returns false when the port could not be bound.
+  bool listen(const int port);
+
+  //! Accepts a waiting client and reads its input. Waits up to timeoutMilliseconds when nothing arrived.
+  //! Appends the complete lines received since the last call, without the line endings.
+  void poll(std::vector<std::string>& commands, const int timeoutMilliseconds);
+
+  bool isConnected() const;
+
+  //! Sends the header line followed by size bytes of data. Disconnects the client on failure.
+  bool send(std::string const& header, const void* data = nullptr, const size_t size = 0);
+
+  void disconnect();
+
+private:
+  bool sendAll(const char* data, size_t size);
+
+private:
+  ServerSocket m_listenSocket;
+  ServerSocket m_clientSocket;
+  std::string  m_input; // Received bytes of the incomplete last line.
+  bool         m_initialized;
+};
+
+
+/*! \brief Blocking client side of the render server protocol, used by the coordinator of the distributed rendering. */
+class RenderClient
+{
+public:
+  RenderClient();
+  ~RenderClient();
+
+  //! Host name or address. Returns false when the connection could not be established.
+  bool connect(std::string const& host, const int port);
+
+  bool isConnected() const;
+
+  //! Sends one command line. The line ending is appended.
+  bool send(std::string const& line);
+
+  //! Receives the next reply line without the line ending.
+  bool receiveLine(std::string& line);
+
+  //! Receives exactly size bytes of binary data following a reply line.
+  bool receive(void* data, size_t size);
+
+  void disconnect();
+
+private:
+  ServerSocket m_socket;
+  std::string  m_input; // Received bytes after the last returned line.
+  bool         m_initialized;
+};
+
+#endif // RENDER_SERVER_H
@@ -0,0 +1,141 @@
+// Copyright NVIDIA Corporation 2002-2005
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// This code is part of the NVIDIA nvpro-pipeline https://github.com/nvpro-pipeline/pipeline
+
+
+#pragma once
+
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <atomic>
+#include <vector>
+
+// Lock-free single producer, single consumer ring of Capacity - 1 commands.
+// The UI thread pushes, the render thread pops. Neither side ever blocks the other.
+template <typename T, unsigned int Capacity>
+class CommandQueue
+{
+public:
+  CommandQueue()
+    : m_head(0)
+    , m_tail(0)
+  {
+  }
+
+  // Producer side. Returns false when the queue is full.
+  bool push(T const& command)
+  {
+    const unsigned int tail = m_tail.load(std::memory_order_relaxed);
+    const unsigned int next = (tail + 1) % Capacity;
+    if (next == m_head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    m_commands[tail] = command;
+    m_tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when the queue is empty.
+  bool pop(T& command)
+  {
+    const unsigned int head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    command = m_commands[head];
+    m_head.store((head + 1) % Capacity, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T                         m_commands[Capacity];
+  std::atomic<unsigned int> m_head; // Next command to pop, written by the consumer.
+  std::atomic<unsigned int> m_tail; // Next free slot, written by the producer.
+};
+
+
+// One image handed from the render thread to the display, in the format glTexImage2D() expects.
+struct RenderFrame
+{
+  std::vector<unsigned char> data;
+  int          width;
+  int          height;
+  int          internalFormat;
+  unsigned int format;
+  unsigned int type;
+  bool         tonemapped; // The device tonemapped the image, the display shader must not do it again.
+};
+
+
+// Triple buffered frames: The writer always has a back frame to fill and the reader a front frame to display.
+// The third frame in the middle is exchanged atomically, so the newest completed frame is displayed without any waits
+// and the writer never waits for the display.
+class FrameExchange
+{
+public:
+  FrameExchange()
+    : m_back(0)
+    , m_middle(1)
+    , m_front(2)
+  {
+  }
+
+  // Writer side.
+  RenderFrame& back()
+  {
+    return m_frames[m_back];
+  }
+
+  void publish()
+  {
+    m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Reader side. Returns the newest published frame, or nullptr when nothing new arrived since the last call.
+  RenderFrame const* acquire()
+  {
+    if (!(m_middle.load(std::memory_order_acquire) & FRESH))
+    {
+      return nullptr;
+    }
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+    return &m_frames[m_front];
+  }
+
+private:
+  static const int INDEX = 3;
+  static const int FRESH = 4; // The middle frame was published and not yet acquired.
+
+  RenderFrame      m_frames[3];
+  int              m_back;   // Only used by the writer.
+  std::atomic<int> m_middle;
+  int              m_front;  // Only used by the reader.
+};
+
+#endif // RENDER_THREAD_H
@@ -36,9 +36,17 @@
 #include <optixu/optixpp_namespace.h>
 
 #include "inc/Picture.h"
+#include "inc/PictureCache.h"
+
+#include "shaders/app_config.h"
 
 #include <string>
 #include <vector>
+#if USE_ASYNC_TEXTURES
+#include <atomic>
+#include <memory>
+#include <thread>
+#endif
 
 
 // Bitfield encoding of the texture channels.
@@ -108,6 +116,24 @@
 #define ENC_FIXED_POINT (1 << ENC_MISC_SHIFT)
 #define ENC_ALPHA_ONE   (2 << ENC_MISC_SHIFT)
 
+#if USE_ASYNC_TEXTURES
+// State of a Texture::createSamplerAsync() call. The worker thread only decodes the Picture,
+// the conversion and upload happen inside Texture::update() on the thread owning the OptiX context.
+struct TextureLoader
+{
+  TextureLoader();
+  ~TextureLoader(); // Joins the worker thread.
+
+  std::thread       thread;
+  std::atomic<bool> ready;   // Set by the worker thread after PictureCache::acquire() returned.
+  bool              success; // True when the image could be loaded, valid when ready.
+  std::shared_ptr<const Picture> picture; // Shared with all other users of the same image file.
+  bool              useSrgb;
+  bool              useMipmaps;
+  unsigned int      level;   // The finest resident mipmap level. ~0u == only the placeholder is resident.
+};
+#endif
+
 class Texture
 {
 public:
@@ -118,12 +144,26 @@ public:
   Texture(const Texture &rhs);
   Texture& operator=(const Texture& rhs);
 
+  void destroy(); // Destroys the OptiX objects. The Texture can be created again afterwards.
+
   bool createSampler(optix::Context context,
                      const Picture* picture,
                      bool useSrgb         = false,  // Affects the read mode. Only applied to unsigned byte formats!
                      bool useMipmaps      = false,  // Affects the download of mipmaps. Default is to not download mipmaps.
                      bool useUnnormalized = false); // Affects the texture indexing. Default is normalized 2D coordinates.
 
+#if USE_ASYNC_TEXTURES
+  // Creates the TextureSampler immediately with a white 1x1 placeholder and loads the image file on a background thread.
+  void createSamplerAsync(optix::Context context,
+                          std::string const& filename,
+                          bool useSrgb        = false,
+                          bool useMipmaps     = false,
+                          bool useCompression = false); // Keeps the blocks of DDS and KTX files and encodes 8-bit images to BC1 or BC3 with Picture::compress().
+  bool update(optix::Context context); // Uploads the next finer mipmap levels once the image is decoded. Returns true when the texture changed.
+  bool isLoading() const;
+  void finish(optix::Context context); // Blocks until the full resolution image is resident.
+#endif
+
   void setWrapMode(RTwrapmode s, RTwrapmode t, RTwrapmode r);
 
   unsigned int determineHostEncoding(int format, int type) const;
@@ -144,8 +184,26 @@ public:
   float getIntegral() const;
   optix::Buffer getBufferCDF_U() const;
   optix::Buffer getBufferCDF_V() const;
+  optix::Buffer getBufferAlias() const;
+#if USE_GPU_ENVIRONMENT_CDF
+  bool calculateCDFDevice(optix::Context context); // Fills the distribution allocated by calculateCDF() with launches on the device.
+#endif
+#if USE_GPU_MIPMAPS
+  bool generateMipmaps(optix::Context context); // Fills the mipmap levels allocated by createSampler() with launches. Returns true when levels were generated.
+#endif
   
 private:
+  bool fillSampler(optix::Context context, const Picture* picture, bool useSrgb, bool useMipmaps, bool useUnnormalized, unsigned int firstLevel);
+#if USE_COMPRESSED_TEXTURES
+  bool fillSamplerBlocks(optix::Context context, const Picture* picture, bool useSrgb, bool useMipmaps, unsigned int firstLevel);
+#endif
+  void createEnvironmentSampler(optix::Context context);
+  void createAliasTable(optix::Context context, const float* function);
+#if USE_CUBEMAP_ENVIRONMENT
+  void resampleToCubemap(); // Replaces the lat-long RGBA32F m_texels with six cubemap faces.
+  bool calculateCubemapDistribution(optix::Context context);
+#endif
+
   unsigned int m_width;
   unsigned int m_height;
   unsigned int m_depth;
@@ -160,10 +218,18 @@ private:
   optix::TextureSampler m_sampler;
 
   // These fields are only used for spherical environment maps.
-  std::vector<float> m_texels;      // Contains HDR RGBA32F texture data, input to CDF generation.
+  std::vector<float> m_texels;      // Contains HDR RGBA32F texture data, input to CDF generation. Cubemaps store the six faces one after the other.
   float              m_integral;
   optix::Buffer      m_bufferCDF_U;
   optix::Buffer      m_bufferCDF_V;
+  optix::Buffer      m_bufferAlias; // EnvironmentAlias entries for O(1) sampling.
+
+#if USE_ASYNC_TEXTURES
+  std::shared_ptr<TextureLoader> m_loader; // Shared with copies of this Texture. Not null while loading.
+#endif
+#if USE_GPU_MIPMAPS
+  bool m_mipmapsPending; // The buffer has mipmap levels above LOD 0 which still need to be generated.
+#endif
 };
 
 #endif // TEXTURE_H
@@ -0,0 +1,101 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <optix.h>
+#include <optixu/optixpp_namespace.h>
+
+#include "shaders/app_config.h"
+#include "shaders/virtual_texture.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Tiled texture of which only the tiles requested by the closest hit programs are resident on the device.
+// The tiles of all mipmap levels are read on demand from a .vtex tile file which is built from an image file on first use.
+// Tile file layout: VirtualTextureHeader followed by numTiles tiles of VT_SLOT_SIZE * VT_SLOT_SIZE RGBA8 texels, borders included,
+// level by level, rows of tiles bottom to top.
+struct VirtualTextureHeader
+{
+  char         magic[4]; // "VTEX"
+  unsigned int version;
+  unsigned int width;
+  unsigned int height;
+  unsigned int tileSize;
+  unsigned int tileBorder;
+  unsigned int numLevels;
+  unsigned int numTiles;
+};
+
+class VirtualTexture
+{
+public:
+  VirtualTexture();
+  ~VirtualTexture();
+
+  // filename is either a .vtex tile file or an 8-bit image file which gets converted to filename + ".vtex" once.
+  // The physical texture holds slotsPerSide * slotsPerSide tiles.
+  bool create(optix::Context context, std::string const& filename, unsigned int slotsPerSide = 16);
+
+  // Reads the tile requests of the previous launches and uploads at most maxTiles missing tiles,
+  // evicting the least recently requested ones when the physical texture is full. Returns true when the texture changed.
+  bool update(unsigned int maxTiles = 32);
+
+  bool isValid() const;
+  VirtualTextureDescription const& getDescription() const;
+  void getBuffers(std::vector<optix::Buffer>& buffers) const; // Appends the physical, indirection and feedback buffers for the MemoryTracker.
+
+private:
+  bool buildTileFile(std::string const& source, std::string const& destination) const;
+  bool readTile(unsigned int index, unsigned char* dst);
+  bool uploadTile(unsigned int index, unsigned int slot, unsigned char* physical);
+
+private:
+  VirtualTextureDescription m_description;
+
+  std::ifstream m_file;
+  unsigned int  m_numTiles;
+
+  optix::Buffer         m_bufferPhysical;
+  optix::TextureSampler m_samplerPhysical;
+  optix::Buffer         m_bufferIndirection;
+  optix::Buffer         m_bufferFeedback;
+
+  std::vector<unsigned int> m_indirection; // Host copy of m_bufferIndirection.
+  std::vector<unsigned int> m_slotTile;    // Resident tile per slot, ~0u for free slots. Slot 0 holds the pinned last level.
+  std::vector<unsigned int> m_slotFrame;   // Last update() call which saw a request for the slot's tile.
+  std::vector<unsigned char> m_texels;     // Staging memory for one tile.
+  unsigned int              m_frame;
+};
+
+#endif // VIRTUAL_TEXTURE_H
@@ -36,35 +36,93 @@
 #include "material_parameter.h"
 #include "per_ray_data.h"
 #include "shader_common.h"
+#include "wedge.h"
+#include "ray_counters.h"
+#include "geometry_paging.h"
 
 rtDeclareVariable(optix::Ray, theRay,                  rtCurrentRay, );
 rtDeclareVariable(float,      theIntersectionDistance, rtIntersectionDistance, );
 
+rtDeclareVariable(PerRayData,        thePrd,       rtPayload, );
 rtDeclareVariable(PerRayData_shadow, thePrdShadow, rtPayload, );
 
 // Attributes.
+#if USE_RAY_CONES
+rtDeclareVariable(optix::float3, varGeoNormal, attribute GEO_NORMAL, );
+#else
 //rtDeclareVariable(optix::float3, varGeoNormal, attribute GEO_NORMAL, );
+#endif
 //rtDeclareVariable(optix::float3, varTangent,   attribute TANGENT, );
 //rtDeclareVariable(optix::float3, varNormal,    attribute NORMAL, ); 
 rtDeclareVariable(optix::float3, varTexCoord,  attribute TEXCOORD, ); 
+#if USE_CUTOUT_CLASSIFICATION
+rtDeclareVariable(unsigned int,  varPrimitiveIndex, attribute PRIMITIVE_INDEX, );
+#endif
 
 // Material parameter definition.
 rtBuffer<MaterialParameter> sysMaterialParameters; // Context global buffer with an array of structures of MaterialParameter.
 rtDeclareVariable(int,      parMaterialIndex, , ); // Per Material index into the above sysMaterialParameters array.
 
+#if USE_CUTOUT_CLASSIFICATION
+// Bindless buffer ID of the per triangle cutout states on the GeometryInstance. The Material default is RT_BUFFER_ID_NULL.
+rtDeclareVariable(int, parCutoutStates, , );
+
+// Returns CUTOUT_PARTIAL when the triangle needs the texture lookup.
+RT_FUNCTION unsigned int getCutoutState()
+{
+  if (parCutoutStates == RT_BUFFER_ID_NULL)
+  {
+    return CUTOUT_PARTIAL;
+  }
+  const rtBufferId<unsigned int, 1> states(parCutoutStates);
+  return (states[varPrimitiveIndex >> 4] >> ((varPrimitiveIndex & 15) << 1)) & 3;
+}
+#endif
+
+#if USE_RAY_CONES
+// Cutout texture level of detail for the given ray cone at the current candidate hit. Same footprint as in the closest hit program.
+RT_FUNCTION float getCutoutLod(const float2 cone)
+{
+  const float3 geoNormal = rtTransformNormal(RT_OBJECT_TO_WORLD, varGeoNormal);
+  const float  scale     = optix::length(geoNormal);
+
+  return getConeLod(cone.x + cone.y * theIntersectionDistance, optix::dot(theRay.direction, geoNormal) / scale,
+                    varTexCoord.z + log2f(scale / optix::length(varGeoNormal))) + sysMaterialParameters[materialParameterIndex(parMaterialIndex)].cutoutLod;
+}
+#endif
+
 
 // One anyhit program for the radiance ray for all materials with cutout opacity!
 RT_PROGRAM void anyhit_cutout() // For the radiance ray type.
 {
+#if USE_RAY_COUNTERS
+  countRay(RAY_COUNTER_ANYHIT);
+#endif
+#if USE_CUTOUT_CLASSIFICATION
+  const unsigned int state = getCutoutState();
+  if (state == CUTOUT_OPAQUE)
+  {
+    return; // Accept the hit.
+  }
+  if (state == CUTOUT_TRANSPARENT)
+  {
+    rtIgnoreIntersection();
+  }
+#endif
+
   float opacity = 1.0f;
-  const int id = sysMaterialParameters[parMaterialIndex].cutoutID; // Fetch the bindless texture ID for cutout opacity.
+  const int id = sysMaterialParameters[materialParameterIndex(parMaterialIndex)].cutoutID; // Fetch the bindless texture ID for cutout opacity.
   if (id != RT_TEXTURE_ID_NULL)
   {
+#if USE_RAY_CONES
+    opacity = intensity(make_float3(optix::rtTex2DLod<float4>(id, varTexCoord.x, varTexCoord.y, getCutoutLod(getCone(thePrd)))));
+#else
     opacity = intensity(make_float3(optix::rtTex2D<float4>(id, varTexCoord.x, varTexCoord.y))); // RGB intensity defines the opacity. White is opaque.
+#endif
   }
 
   // Stochastic alpha test to get an alpha blend effect.
-  if (opacity < 1.0f && opacity <= rng(thePrdShadow.seed)) // No need to calculate an expensive random number if the test is going to fail anyway.
+  if (opacity < 1.0f && opacity <= rng(thePrd.seed)) // No need to calculate an expensive random number if the test is going to fail anyway.
   {
     rtIgnoreIntersection();
   }
@@ -74,17 +132,40 @@ RT_PROGRAM void anyhit_cutout() // For the radiance ray type.
 // The shadow ray program for all materials with no cutout opacity.
 RT_PROGRAM void anyhit_shadow()
 {
+#if USE_RAY_COUNTERS
+  countRay(RAY_COUNTER_ANYHIT);
+#endif
   thePrdShadow.visible = false;
   rtTerminateRay();
 }
 
 RT_PROGRAM void anyhit_shadow_cutout() // For the shadow ray type.
 {
+#if USE_RAY_COUNTERS
+  countRay(RAY_COUNTER_ANYHIT);
+#endif
+#if USE_CUTOUT_CLASSIFICATION
+  const unsigned int state = getCutoutState();
+  if (state == CUTOUT_OPAQUE)
+  {
+    thePrdShadow.visible = false;
+    rtTerminateRay();
+  }
+  if (state == CUTOUT_TRANSPARENT)
+  {
+    rtIgnoreIntersection();
+  }
+#endif
+
   float opacity = 1.0f;
-  const int id = sysMaterialParameters[parMaterialIndex].cutoutID; // Fetch the bindless texture ID for cutout opacity.
+  const int id = sysMaterialParameters[materialParameterIndex(parMaterialIndex)].cutoutID; // Fetch the bindless texture ID for cutout opacity.
   if (id != RT_TEXTURE_ID_NULL)
   {
+#if USE_RAY_CONES
+    opacity = intensity(make_float3(optix::rtTex2DLod<float4>(id, varTexCoord.x, varTexCoord.y, getCutoutLod(thePrdShadow.cone))));
+#else
     opacity = intensity(make_float3(optix::rtTex2D<float4>(id, varTexCoord.x, varTexCoord.y))); // RGB intensity defines the opacity. White is opaque.
+#endif
   }
 
   // Stochastic alpha test to get an alpha blend effect.
@@ -99,3 +180,13 @@ RT_PROGRAM void anyhit_shadow_cutout() // For the shadow ray type.
   }
 }
 
+
+#if USE_GEOMETRY_PAGING
+// Radiance and shadow rays pass through the bounding box of a mesh page which is not on the device.
+// The hits only request the page. The real geometry is visible once updateGeometryPaging() loaded it.
+RT_PROGRAM void anyhit_page_proxy()
+{
+  recordPageRequest();
+  rtIgnoreIntersection();
+}
+#endif
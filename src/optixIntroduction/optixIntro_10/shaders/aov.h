@@ -0,0 +1,223 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#ifndef AOV_H
+#define AOV_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+#include "shader_common.h"
+#include "aov_type.h"
+
+#if USE_AOVS
+rtBuffer<int> sysAovBuffers;                     // NUMBER_OF_AOVS bindless RGBA32F 2D buffer IDs. RT_BUFFER_ID_NULL for the disabled AOVs.
+rtDeclareVariable(unsigned int, sysAovMask, , ); // AOV_BIT() of the enabled AOVs. 0 == none, the preview never writes them.
+rtDeclareVariable(int, sysAovIteration, , );     // The sysIterationIndex at which the AOV accumulation started. Non-zero after resuming a checkpoint.
+
+// The AOVs of one or more primary rays of a pixel, before they are blended into the AOV buffers.
+struct AovSample
+{
+  float  depth;
+  float4 position;
+  float3 normal;
+  float  material;
+  float3 direct;
+  float3 indirect;
+  float3 lights[AOV_LIGHT_GROUPS];
+};
+
+RT_FUNCTION void initAovSample(AovSample& aov)
+{
+  aov.depth    = RT_DEFAULT_MAX;
+  aov.position = make_float4(0.0f); // Counts as a miss in the direction null when no path segment was traced.
+  aov.normal   = make_float3(0.0f);
+  aov.material = -1.0f;
+  aov.direct   = make_float3(0.0f);
+  aov.indirect = make_float3(0.0f);
+  for (int i = 0; i < AOV_LIGHT_GROUPS; ++i)
+  {
+    aov.lights[i] = make_float3(0.0f);
+  }
+}
+
+// Called by the integrator before tracing the path segment at depth.
+RT_FUNCTION void initAovSegment(PerRayData& prd, const int depth)
+{
+  prd.aovMaterial = -1; // Misses don't touch it.
+  if (depth == 0 && (sysAovMask & AOV_LIGHT_GROUP_MASK))
+  {
+    prd.flags |= FLAG_AOV_LIGHTS; // Only the primary hit splits its direct lighting. Cleared with the other flags on the next segment.
+    for (int i = 0; i < AOV_LIGHT_GROUPS; ++i)
+    {
+      prd.aovLights[i] = make_float3(0.0f);
+    }
+  }
+}
+
+// Called by the integrator after the radiance of the path segment at depth was added with the given throughput.
+// Direct is the emission which reached the camera with at most one bounce plus the light samples of the primary hit.
+// Everything else is indirect. Note that the resampled direct lighting of USE_RESTIR is direct but not split into light groups.
+RT_FUNCTION void recordAovSegment(AovSample& aov, PerRayData const& prd, const int depth, const float3 throughput)
+{
+  const bool hit     = (prd.flags & FLAG_HIT) != 0;
+  const bool emitter = !hit || (prd.flags & FLAG_LIGHT); // The segment returned only emission.
+
+  const float3 contribution = throughput * prd.radiance;
+
+  if (depth == 0) // The miss programs leave prd.pos and the direction untouched.
+  {
+    aov.depth    = (hit) ? prd.distance : RT_DEFAULT_MAX;
+    aov.position = (hit) ? make_float4(prd.pos, 1.0f) : make_float4(getWi(prd), 0.0f);
+    aov.normal   = (hit) ? getNormal(prd) : make_float3(0.0f);
+    aov.material = (0 <= prd.aovMaterial) ? float(prd.aovMaterial) : -1.0f;
+  }
+
+  if (depth == 0 || (depth == 1 && emitter))
+  {
+    aov.direct += contribution;
+
+    if (emitter)
+    {
+      // Misses keep aovMaterial -1 and return the environment light, which is always light 0 when it exists.
+      const int light = max(-2 - prd.aovMaterial, 0);
+
+      aov.lights[min(light, AOV_LIGHT_GROUPS - 1)] += contribution;
+    }
+    else if (prd.flags & FLAG_AOV_LIGHTS)
+    {
+      for (int i = 0; i < AOV_LIGHT_GROUPS; ++i)
+      {
+        aov.lights[i] += throughput * prd.aovLights[i];
+      }
+    }
+  }
+  else
+  {
+    aov.indirect += contribution;
+  }
+}
+
+// Sums the AOVs of the samples of one launch. The first sample which was integrated provides the first-sample AOVs.
+RT_FUNCTION void sumAovSample(AovSample& sum, AovSample const& sample, const bool first)
+{
+  sum.depth = fminf(sum.depth, sample.depth);
+  if (first)
+  {
+    sum.position = sample.position;
+    sum.material = sample.material;
+  }
+  sum.normal   += sample.normal;
+  sum.direct   += sample.direct;
+  sum.indirect += sample.indirect;
+  for (int i = 0; i < AOV_LIGHT_GROUPS; ++i)
+  {
+    sum.lights[i] += sample.lights[i];
+  }
+}
+
+RT_FUNCTION void scaleAovSample(AovSample& sum, const float scale)
+{
+  sum.normal   *= scale;
+  sum.direct   *= scale;
+  sum.indirect *= scale;
+  for (int i = 0; i < AOV_LIGHT_GROUPS; ++i)
+  {
+    sum.lights[i] *= scale;
+  }
+}
+
+// Blends the mean of count samples into the enabled AOV buffers.
+RT_FUNCTION void accumulateAovs(const uint2 pixel, AovSample const& aov, const float count)
+{
+  const float samples = float(max(sysIterationIndex - sysAovIteration, 0)); // Number of samples already accumulated in the AOV buffers.
+  const float t       = count / (samples + count);
+
+#pragma unroll
+  for (int i = 0; i < NUMBER_OF_AOVS; ++i)
+  {
+    if (!(sysAovMask & AOV_BIT(i)))
+    {
+      continue;
+    }
+
+    const rtBufferId<float4, 2> buffer(sysAovBuffers[i]);
+
+    float4 value;
+    switch (i)
+    {
+      case AOV_DEPTH:
+        value = make_float4(aov.depth, aov.depth, aov.depth, 1.0f);
+        break;
+      case AOV_POSITION:
+        value = aov.position;
+        break;
+      case AOV_NORMAL:
+        value = make_float4(aov.normal, 0.0f);
+        break;
+      case AOV_MATERIAL_ID:
+        value = make_float4(aov.material, aov.material, aov.material, 1.0f);
+        break;
+      case AOV_DIRECT:
+        value = make_float4(aov.direct, 1.0f);
+        break;
+      case AOV_INDIRECT:
+        value = make_float4(aov.indirect, 1.0f);
+        break;
+      default:
+        value = make_float4(aov.lights[i - AOV_LIGHT_GROUP], 1.0f);
+        break;
+    }
+
+    if (samples == 0.0f) // The first sample fills the buffer.
+    {
+      buffer[pixel] = value;
+    }
+    else if (i == AOV_DEPTH)
+    {
+      buffer[pixel] = fminf(buffer[pixel], value);
+    }
+    else if (i != AOV_POSITION && i != AOV_MATERIAL_ID)
+    {
+      float3 dst = optix::lerp(make_float3(buffer[pixel]), make_float3(value), t);
+      if (i == AOV_NORMAL && isNotNull(dst))
+      {
+        dst = optix::normalize(dst);
+      }
+      buffer[pixel] = make_float4(dst, value.w);
+    }
+  }
+}
+#endif // USE_AOVS
+
+#endif // AOV_H
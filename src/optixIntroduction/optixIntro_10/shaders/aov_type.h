@@ -0,0 +1,49 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#ifndef AOV_TYPE_H
+#define AOV_TYPE_H
+
+#include "app_config.h"
+
+// Indices of the AOV output buffers in sysAovBuffers and their bits in sysAovMask. Shared between host and device code.
+// The depth keeps the minimum over the samples, the position and material ID the first sample, all others the average.
+#define AOV_DEPTH        0 // Distance from the camera to the primary hit. RT_DEFAULT_MAX for misses.
+#define AOV_POSITION     1 // World space primary hit, w == 1.0f. Misses store the direction, w == 0.0f.
+#define AOV_NORMAL       2 // World space shading normal of the primary hit, renormalized. Null vector for misses.
+#define AOV_MATERIAL_ID  3 // Material index of the primary hit. -1.0f for misses and lights.
+#define AOV_DIRECT       4 // Emission seen directly or after one bounce, plus the direct lighting of the primary hit.
+#define AOV_INDIRECT     5 // All other radiance. AOV_DIRECT + AOV_INDIRECT is the beauty image.
+#define AOV_LIGHT_GROUP  6 // First of AOV_LIGHT_GROUPS buffers which split AOV_DIRECT by the light index.
+#define NUMBER_OF_AOVS   (AOV_LIGHT_GROUP + AOV_LIGHT_GROUPS)
+
+#define AOV_BIT(aov)        (1u << (aov))
+#define AOV_LIGHT_GROUP_MASK (((1u << AOV_LIGHT_GROUPS) - 1u) << AOV_LIGHT_GROUP)
+
+#endif // AOV_TYPE_H
@@ -42,25 +42,441 @@
 
 // 0 == Brute force path tracing without next event estimation (direct lighting). // Debug setting to compare lighting results.
 // 1 == Next event estimation per path vertex (direct lighting) and using MIS with power heuristic. // Default.
+#ifndef USE_NEXT_EVENT_ESTIMATION
 #define USE_NEXT_EVENT_ESTIMATION 1
+#endif
 
 // 0 == Do not compile in anything which is related to the built-in OptiX 5.1.0 DL Denoiser.
 // 1 == Compile in all code which is needed to run the DL Denoiser. 
 //      This needs a lot of additional graphics memory by default. Search for "maxmem" to find how to limit that.
+#ifndef USE_DENOISER
 #define USE_DENOISER 1
+#endif
 
 // 0 == Disable all code which creates and fills the albedo and the normal buffers.
 // 1 == Enable all code which creates, fills, and uses the albedo buffer.
+#ifndef USE_DENOISER_ALBEDO
 #define USE_DENOISER_ALBEDO 1
+#endif
 
 // 0 == Disable all code which creates and fills the normal buffer. (Only possible when also using the albedo buffer.)
 //      NOTE: 0 is the default because the normal buffer in OptiX 5.1.0 is ignored!
 // 1 == Enable all code which creates, fills, and uses the normal buffer. 
 //      Don't use! Just for demonstration how to generate the normals in camera space.
+#ifndef USE_DENOISER_NORMAL
 #define USE_DENOISER_NORMAL 0
+#endif
+
+// 0 == The path tracer accumulates the albedo (and normal) guide buffers with every sample.
+// 1 == The guide buffers are accumulated by the separate gbuffer() launch during the first DENOISER_GBUFFER_ITERATIONS
+//      iterations after each restart and stay frozen afterwards. That launch only follows the primary ray through specular
+//      events to the first diffuse or light hit. The path tracer launches don't read or write the guide buffers at all.
+#define USE_DENOISER_GBUFFER 1
+
+// Number of jittered samples the guide buffers accumulate. Enough to antialias the edges.
+#define DENOISER_GBUFFER_ITERATIONS 8
+
+// 0 == The accumulation only ends at m_frames (or when adaptive sampling converged), independent of the denoised result.
+// 1 == Compile in the --stable <threshold> option and the GUI "Stable Threshold" (0.0 == off). Each denoiser execution
+//      at the present cadence is compared against the previous one on the device. When the largest mean relative change
+//      of any tile stays below the threshold for DENOISER_STABLE_CHECKS comparisons in a row, the accumulation stops
+//      like when reaching m_frames. Only has an effect with USE_DENOISER. See src/DenoiserConvergence.cpp.
+#define USE_DENOISER_CONVERGENCE 1
+
+// Edge length in pixels of the square tiles over which the denoised change is averaged.
+#define DENOISER_CHANGE_TILE_SIZE 16
+
+// 0 == The DL Denoiser always processes the whole frame in one post-processing stage.
+// 1 == Compile in the --denoisetile <int> option and the GUI "Denoise Tile" (0 == full frame). Larger frames are denoised
+//      tile by tile with DENOISER_TILE_OVERLAP pixels of context around each tile, so the denoiser memory only depends
+//      on the tile size. The tiles are cross-faded over the overlap into the denoised buffer. See src/DenoiserTiles.cpp.
+#define USE_DENOISER_TILES 1
+
+// Pixels each denoiser tile reads beyond its edges. Tiles are at least twice this size.
+#define DENOISER_TILE_OVERLAP 32
+
+// 0 == The DL Denoiser runs in the render context, the accumulation waits for it at every denoise cadence.
+// 1 == Compile in the --denoisedevice <int> option. The snapshots at the denoise cadence are denoised by a worker
+//      thread in a separate OptiX context on that device while the render devices continue accumulating, and the
+//      display shows the newest finished result. Only has an effect with USE_DENOISER. See src/DenoiserDevice.cpp.
+#define USE_DENOISER_DEVICE 1
+
+// 0 == The --batch image is rendered in one piece, so its resolution is limited by the device memory of the full frame buffers.
+// 1 == Compile in the --poster <int> option. The --batch image of --width x --height is rendered, accumulated and denoised
+//      one tile with POSTER_TILE_OVERLAP pixels of context at a time into buffers of the tile size, and each finished tile
+//      is written straight into the rows of a *.pfm file on disk. The device memory stays the same for any poster size.
+//      See src/PosterTiles.cpp.
+#define USE_POSTER_TILES 1
+
+// Pixels each poster tile renders and denoises beyond its edges. Only the inner tile is written.
+#define POSTER_TILE_OVERLAP 32
+
+// 0 == All launches go over screen pixels.
+// 1 == Compile in the --bake <index,...> and --bakeunwrap options. The --batch image becomes a --width x --height lightmap
+//      of the selected root children's meshes, in their texture coordinates or an automatic per triangle unwrap. Each
+//      texel launches cosine distributed rays from its surface point through the integrator(), and the accumulated
+//      irradiance is dilated into the empty texels before it's written. See src/LightBake.cpp.
+#define USE_LIGHT_BAKE 1
+
+// Texels the lightmap charts are grown into the empty space around them.
+#define LIGHT_BAKE_DILATION 4
+
+// 0 == Only compile the megakernel path tracer in raygeneration().
+// 1 == Additionally compile the wavefront path tracer in wavefront.cu, which issues one launch per path segment
+//      over a compacted queue of live paths. Selected at runtime with the --wavefront command line option or the GUI.
+#define USE_WAVEFRONT 1
+
+// 0 == The wavefront extend launches process the surviving paths in the order they were compacted.
+// 1 == Compile in the --sortpaths <cellSize> option and the GUI "Sort Paths". Between two extend launches a counting sort
+//      groups the live paths by the material they leave, their origin cell and their direction, so that the warps of the
+//      next launch trace similar rays and tend to hit the same materials. See src/WavefrontSort.cpp.
+#define USE_WAVEFRONT_SORT 1
+
+// 0 == The megakernel launch has one thread per pixel.
+// 1 == Compile in the --persistent <int> option and the GUI "Persistent Threads" (0 == off). The megakernel launches only
+//      this many threads per streaming multiprocessor, and each thread pulls the next pixel from a global atomic counter
+//      as soon as its path terminated. Single device only. See src/PersistentThreads.cpp.
+#define USE_PERSISTENT_THREADS 1
+
+// 0 == The megakernel launch is 2D with the launch index as the pixel.
+// 1 == Compile in the --morton option and the GUI "Morton Order". The megakernel launch is 1D instead, and the linear
+//      launch index is mapped to the pixels in Morton order inside square tiles of 2^MORTON_TILE_BITS pixels, so the
+//      threads of a warp trace a compact block of pixels instead of a row. Same pixels and random sequences as ENTRY_RENDER.
+#define USE_MORTON_LAUNCH 1
+
+// Edge length of the Morton ordered tiles as power of two. 3 == 8x8 pixels, two warps per tile.
+#define MORTON_TILE_BITS 3
+
+// 0 == Every iteration renders all pixels.
+// 1 == Compile in adaptive sampling. A per-pixel second moment buffer provides a variance estimate and
+//      tiles which are below the target error (GUI "Target Error", 0.0 == off) are not rendered anymore.
+#define USE_ADAPTIVE_SAMPLING 1
+
+// Edge length in pixels of the square tiles used for the adaptive sampling convergence mask.
+#define ADAPTIVE_TILE_SIZE 16
+
+// 0 == Every iteration is rendered with a single launch over the full resolution.
+// 1 == Compile in the tile scheduler. With a tile size > 0 (--tile or GUI) each iteration is split into tile launches
+//      which are spread over multiple frames under a frame time budget, nearest to the cursor first.
+#define USE_TILED_LAUNCH 1
+
+// 0 == Each megakernel launch renders one sample per pixel.
+// 1 == Compile in the --launchsamples <int> option. The full resolution, adaptive and tile launches loop over that many samples
+//      per pixel and blend their mean into the output buffers once. Fewer launches and less output buffer traffic per sample.
+#define USE_SAMPLES_PER_LAUNCH 1
+
+// 0 == All devices accumulate into the shared sysOutputBuffer every iteration.
+// 1 == With more than one device each device accumulates into RT_BUFFER_GPU_LOCAL buffers and a resolve launch
+//      copies the results into the shared buffers only when presenting. Adaptive sampling and tiled launches are
+//      disabled then, because their launches would distribute the pixels differently among the devices.
+#define USE_GPU_LOCAL_ACCUMULATION 1
+
+// 0 == Multi-GPU scaling can only be compared between separate runs with different -d arguments.
+// 1 == Compile in the --devicescaling <int> option. It renders the --benchmark workload on each device of the -d encoding
+//      alone and on its first 1..N devices in the same context, and prints the iterations per second, the scaling
+//      efficiency and the resolve and transfer times apart from the launches. See src/DeviceScaling.cpp.
+#define USE_DEVICE_SCALING 1
+
+// 0 == Without OpenGL interop the RGBA32F image is mapped and uploaded directly.
+// 1 == Compile in the --half option which converts the image to RGBA16F on the device before mapping it,
+//      which halves the device to host transfer and the texture upload when not using OpenGL interop.
+#define USE_HALF_DISPLAY 1
+
+// 0 == The GLSL display shader tonemaps the HDR texture. LDR screenshots contain the clamped linear image.
+// 1 == Compile in the --tonemap option which runs the same tonemapper on the device into an RGBA8 buffer.
+//      Non-interop uploads transfer a quarter of the RGBA32F data then, and *.png and *.ppm screenshots are tonemapped,
+//      also when rendering headless.
+#define USE_DEVICE_TONEMAP 1
+
+// 0 == Triangle geometry uses the interleaved 48 byte VertexAttributes.
+// 1 == Triangle geometry is stored as a tightly packed float3 position stream for the BVH builder and a separate
+//      12 byte VertexAttributesCompact stream with octahedral encoded normal and tangent and half float texcoords.
+#define USE_COMPACT_ATTRIBUTES 1
+
+// 0 == The spherical environment light is sampled with two binary searches over the CDFs.
+// 1 == The spherical environment light is sampled in O(1) with an alias table over the texels, built next to the CDFs,
+//      and the explicit and implicit light pdfs are both taken from that table.
+#define USE_ENVIRONMENT_ALIAS_TABLE 1
+
+// 0 == The environment light is a spherical lat-long texture.
+// 1 == The environment light is a cubemap texture. Cubemap Pictures are used as is, lat-long images are resampled to faces of width / 4 texels.
+//      It is always sampled with an alias table over the texels of all six faces, built on the host with their exact solid angles.
+//      The miss program and the light sample don't need any trigonometric functions.
+#define USE_CUBEMAP_ENVIRONMENT 1
+
+// 0 == Only the parallelogram area lights and the environment are sampled explicitly.
+// 1 == Compile in the "light <name> <r g b> <12 floats>" scene description statement. It places a mesh as an emissive
+//      triangle mesh light, whose triangles are selected for the next event estimation by their power with an alias table.
+//      See src/MeshLights.cpp.
+#define USE_MESH_LIGHTS 1
+
+// 0 == The spherical environment light sampling distribution is built on the host inside Texture::calculateCDF().
+// 1 == The filtering, the row and marginal CDFs and the integral are calculated by launches of the environment_cdf.cu
+//      entry points directly into the device buffers. Only the alias table is built on the host from the result.
+#define USE_GPU_ENVIRONMENT_CDF 1
+
+// 0 == Textures created with mipmaps only get the levels stored inside the Picture. Images with only LOD 0 have a single level.
+// 1 == Textures created with mipmaps from a 2D Picture with only LOD 0 allocate the full mipmap chain
+//      and Texture::generateMipmaps() fills it with box filter launches of the mipmap.cu entry points.
+#define USE_GPU_MIPMAPS 1
+
+// 0 == The material textures are loaded, converted and uploaded before rendering starts.
+// 1 == The material textures are decoded on background threads. Rendering starts with a white 1x1 placeholder behind the
+//      final bindless texture ID, then files with mipmaps get their coarse levels first and finer levels on the following frames.
+#define USE_ASYNC_TEXTURES 1
+
+// 0 == All materials use the generic closest hit program which calls the BSDFs through the sysSampleBSDF and sysEvalBSDF bindless callable programs.
+// 1 == Each material parameter index gets its own Material with a closest hit program specialized for its BSDF,
+//      which inlines the BSDF sampling and evaluation. Costs more compile time per BSDF type.
+#define USE_SPECIALIZED_MATERIALS 1
+
+// 0 == The PerRayData holds all directions as float3 and the denoiser albedo and normal in their own fields.
+// 1 == Compact PerRayData: Octahedral 32-bit incoming direction and denoiser normal, no outgoing direction,
+//      the sampler dimension inside the flags and the denoiser albedo returned in f_over_pdf. See per_ray_data.h.
+#define USE_COMPACT_PAYLOAD 1
+
+// 0 == The megakernel integrator keeps the absorption coefficient and IOR of each entered volume in a float4 array (local memory).
+// 1 == It keeps 16-bit material indices packed into 64-bit integers, which stay in registers, and reads the absorption and IOR
+//      from sysMaterialParameters when needed. Up to 8 nesting levels. Larger MATERIAL_STACK_SIZE values use the array.
+//      See shaders/material_stack.h.
+#define USE_COMPACT_MATERIAL_STACK 1
+
+// 0 == The cutout opacity anyhit programs sample the cutout texture for every candidate hit.
+// 1 == Triangles are classified on the host as fully opaque, fully transparent or partial against the cutout texture.
+//      Only partial triangles sample the texture inside the anyhit programs. See src/CutoutClassification.cpp.
+#define USE_CUTOUT_CLASSIFICATION 1
+
+// 0 == DDS files are decompressed by DevIL, all textures are uploaded with 8, 16 or 32 bits per component.
+// 1 == BC1, BC3, BC5 and BC6H blocks of DDS and KTX files are uploaded as block-compressed textures
+//      and the albedo texture is compressed to BC1 or BC3 when loading it. See Picture::compress().
+#define USE_COMPRESSED_TEXTURES 1
+
+// 0 == The albedo texture is a regular Texture with all its data resident on the device.
+// 1 == The albedo texture is a VirtualTexture. The closest hit programs record the tiles they need
+//      and Application::render() streams them from a tile file between launches. See inc/VirtualTexture.h.
+#define USE_VIRTUAL_TEXTURES 1
+
+// 0 == Textures are sampled at their finest mipmap level. Virtual textures use VT_INDIRECT_LEVEL_BIAS after diffuse bounces.
+// 1 == Each radiance path carries a ray cone (width and spread angle) starting at the pixel footprint of the camera.
+//      The hit programs sample the mipmap level matching the cone footprint on the triangle. Diffuse bounces widen the cone.
+#define USE_RAY_CONES 1
+
+// 0 == The shutter time of a path is the sampler's SAMPLE_TIME dimension.
+// 1 == The shutter time is a van der Corput sequence over the iterations with a per pixel Cranley-Patterson rotation.
+//      With sysTimeSlices > 1 each launch only covers one slice of the shutter interval. See sampleShutterTime().
+#define USE_STRATIFIED_SHUTTER 1
+
+// 0 == The primary ray is always generated by the bindless lens shader callable program selected by sysCameraType.
+// 1 == The ray generation programs calculate the pinhole camera ray inline and only call the lens shader for the other cameras.
+#define USE_PINHOLE_FAST_PATH 1
+
+// 0 == No path statistics. The weight window Russian Roulette strategy is not available.
+// 1 == The path tracers count paths, radiance and Russian Roulette decisions per path segment into sysPathStatistics.
+//      The host accumulates them for the GUI and derives the image mean for the weight window strategy. Costs atomics per segment.
+#define USE_PATH_STATISTICS 0
+
+// 0 == No ray counters. The fps output only counts iterations.
+// 1 == The path tracers count radiance rays, shadow rays, anyhit invocations and path terminations by cause into sysRayCounters
+//      with one 64-bit atomic per event. The host reads them back when presenting and shows the ray rates in the GUI and
+//      the fps output, and the Profiler records the rays per frame. The counting costs some of the throughput it measures.
+#define USE_RAY_COUNTERS 0
+
+// 0 == No cost visualization.
+// 1 == The megakernel ray generation programs measure the clock64() cycles per pixel into sysCostBuffer. With sysCostHeatmap set
+//      they replace the accumulated radiance with a false color heatmap of the last launch or of the mean over the iterations.
+//      The wavefront path tracer spreads a pixel over many launches and is not measured.
+#define USE_COST_HEATMAP 1
+
+// 0 == Camera interaction restarts the accumulation at full resolution.
+// 1 == While orbiting, panning or dollying, the image is rendered into a buffer reduced by m_previewFactor per axis,
+//      which the display shader upsamples bilinearly. Full resolution accumulation restarts when the interaction ends.
+#define USE_PREVIEW_RESOLUTION 1
+
+// 0 == Every camera change restarts the accumulation.
+// 1 == Compile in the temporal reprojection (GUI "Reproject"). The megakernel path tracer stores the primary hit position and
+//      the sample count per pixel. A camera change traces one ray per pixel center, warps the previous accumulation into the
+//      new view where the primary hit positions agree, and the accumulation continues from these per pixel sample counts.
+//      Pinhole camera, single device and megakernel only, otherwise the accumulation restarts. See src/Reprojection.cpp.
+#define USE_REPROJECTION 1
+
+// 0 == Primary rays always traverse the scene from the camera.
+// 1 == Compile in the --raster option. Each iteration OpenGL first rasterizes the distance to the nearest surface per pixel,
+//      at one sub-pixel jitter for all pixels, into an interop buffer. The megakernel primary rays use the same jitter and start
+//      right in front of that surface, which leaves almost nothing to traverse. The closest hit programs shade as usual.
+//      Pinhole camera, OpenGL interop and scenes without motion blur only. See src/RasterPrimary.cpp.
+#define USE_RASTER_PRIMARY 1
+
+// 0 == The direct lighting of all diffuse hits takes sysLightSamples independent light samples.
+// 1 == Compile in the resampled direct lighting of the primary hits (GUI "ReSTIR", --restir). Each primary hit streams
+//      m_restirCandidates light samples through a reservoir, combines it with the previous iteration's reservoirs at its
+//      reprojected pixel and a few spatial neighbours, and traces a single shadow ray for the selected sample.
+//      Needs USE_NEXT_EVENT_ESTIMATION. Pinhole camera, single device and megakernel only. See src/Restir.cpp.
+#define USE_RESTIR 1
+
+// 0 == Every iteration traces the shadow rays of the primary hits.
+// 1 == Compile in the per pixel visibility cache (GUI "Visibility Cache", --visibilitycache). The megakernel counts the visible
+//      and the traced shadow rays of the diffuse primary hit of each pixel. After VISIBILITY_CACHE_WARMUP shadow rays a pixel
+//      whose rays were all visible or all occluded stops tracing them and uses that result, only the penumbra pixels keep tracing.
+//      Every restart of the accumulation (camera, scene, material or light changes) starts counting again.
+//      Approximate, fine shadow details below the warmup count can vanish. Not combined with ReSTIR. See src/VisibilityCache.cpp.
+#define USE_VISIBILITY_CACHE 1
+// Shadow rays a pixel traces before its visibility is trusted.
+#define VISIBILITY_CACHE_WARMUP 16
+
+// 0 == Diffuse paths continue until Russian Roulette or the maximum path length.
+// 1 == Compile in the world space radiance cache (GUI "Cache Bounces", --cache). Diffuse hits of the megakernel paths are binned
+//      into a hashed voxel grid of m_cacheCellSize. The first diffuse vertices of each path add their outgoing radiance estimate
+//      to their voxel, and a launch after each iteration blends these into a moving average. After m_cacheBounces diffuse bounces
+//      a path terminates at the next diffuse hit with a populated voxel, which trades bounded bias for much shorter paths.
+//      See src/RadianceCache.cpp.
+#define USE_RADIANCE_CACHE 1
+
+// 0 == Each launch renders one view through the lens shader of the camera.
+// 1 == Compile in the multi-view launch (GUI "Views", --views). A 3D launch over (width, height, view) renders the left and right
+//      eye side by side, or the six faces of a 3x2 cubemap, each with the pinhole camera of its entry in sysViews, into one shared
+//      output image. The views accumulate like a single image. Disables tiles, adaptive sampling, reprojection, ReSTIR,
+//      the raster primary rays and the preview resolution while active. See src/MultiView.cpp.
+#define USE_MULTI_VIEW 1
+
+// 0 == The scene is static after createScene(). Only the Transform motion keys animate it inside the shutter interval.
+// 1 == Compile in the animation interface (GUI "Animate", --animate). The matrices of the Transforms directly under the root
+//      Group and the vertex data of their Geometries can change per frame. Only the changed Accelerations are marked dirty,
+//      deformed meshes refit their BVH unless they moved further than --refit times their size since the last rebuild.
+//      --flatten bakes the static instances, which leaves them out of the animation. See src/DynamicScene.cpp.
+#define USE_DYNAMIC_SCENE 1
+
+// 0 == Each material setting is a separate render.
+// 1 == Compile in the --wedge <file> option. All material variants of the file render together in one 3D launch per iteration,
+//      sharing the scene, the BVH and the random numbers. Screenshots write one image per variant. See src/Wedge.cpp.
+#define USE_WEDGE 1
+
+// 0 == Application::screenshot() converts and encodes the image on the render thread.
+// 1 == Application::screenshot() copies the output buffer into a staging allocation of a sutil::ImageWriter and returns.
+//      Worker threads convert and encode the image; the Application destructor waits for pending images.
+#define USE_ASYNC_SCREENSHOTS 1
+
+// 0 == The Application renders into its window, or headless with --batch.
+// 1 == Compile in the --listen <port> option. The headless Application takes camera and parameter commands from one TCP client
+//      at a time and sends back the frames tonemapped to RGBA8 on the device and compressed to PNG. See src/ServerMode.cpp.
+#define USE_RENDER_SERVER 1
+
+// 0 == The main loop polls the window events, builds the GUI and launches OptiX one after the other on one thread.
+// 1 == Compile in the --renderthread option. A render thread owns the OptiX context and launches continuously. The camera,
+//      window size and tile focus changes reach it through a lock-free command queue, the GUI edits while it is parked between
+//      two iterations, and the completed frames come back triple buffered. Without OpenGL interop. See src/RenderThread.cpp.
+#define USE_RENDER_THREAD 1
+
+// 0 == Every window size change reallocates all per pixel buffers, the OpenGL interop PBOs and the denoiser command list.
+// 1 == Window resizes render into a sub-rectangle of the existing buffers, which only grow (with headroom) when too small.
+//      The launches use sysResolution. The buffers are shrunk to the exact size once the window size was stable for a moment.
+#define USE_RESIZE_CAPACITY 1
+
+// 0 == Every material change in the GUI converts and uploads the whole sysMaterialParameters buffer.
+// 1 == Changed materials are collected and converted once per frame. On a single device only the changed entries are
+//      sent in a small staging buffer which the material_update entry point scatters into sysMaterialParameters.
+#define USE_INCREMENTAL_MATERIALS 1
+
+// 0 == A --batch render which gets interrupted loses all its samples.
+// 1 == Compile in the --checkpoint <filename>, --interval <seconds> and --resume options. renderBatch() periodically stores
+//      the accumulation buffers, the iteration index and a hash of the image settings, and continues from such a file.
+//      The files are written on a background thread. See src/Checkpoint.cpp.
+#define USE_CHECKPOINTS 1
+
+// 0 == All meshes of a --scene description stay on the device for the whole run.
+// 1 == Compile in the --geometrybudget <MiB> option. The meshes keep a host copy and only the ones which rays reached recently
+//      have their Geometry and bottom level Acceleration on the device. The others are bounding box proxies whose hits request
+//      the mesh. The least recently hit meshes are evicted when the budget is exceeded. See src/GeometryPaging.cpp.
+#define USE_GEOMETRY_PAGING 1
+
+// 0 == All Accelerations use the Trbvh builder.
+// 1 == The builder is selected per Acceleration: NoAccel for tiny groups, Sbvh for large static meshes, Trbvh for the rest
+//      and for meshes once they deform. The scene description statement "builder <name> <builder>" forces it per mesh.
+//      See src/AccelerationPolicy.cpp.
+#define USE_ACCELERATION_POLICY 1
+
+// 0 == Each scene description mesh is one Geometry with one bottom level Acceleration, however large.
+// 1 == Compile in the --buildbudget <MiB> option. Meshes whose estimated build memory exceeds it are split into spatially
+//      coherent chunks with their own Geometry and Acceleration under a Group, which caps the build peak. See src/ChunkedBuild.cpp.
+#define USE_CHUNKED_BUILD 1
+
+// 0 == Every instance of a scene description mesh traverses its full resolution Acceleration.
+// 1 == Compile in the --lod <pixels> option. Each resident, unchunked mesh gets up to MESH_LOD_LEVELS - 1 coarser levels by
+//      vertex clustering at load time. On camera changes every instance is switched to the coarsest level whose clustering
+//      cells project to at most that many pixels at its distance (0 == off, full resolution). See src/MeshLod.cpp.
+#define USE_MESH_LOD 1
+
+// Number of levels including the full resolution mesh.
+#define MESH_LOD_LEVELS 4
+
+// Meshes with fewer triangles get no coarser levels, and no level gets below this.
+#define MESH_LOD_MIN_TRIANGLES 256
+
+// 0 == Without --scene the hard-coded demo scene is rendered.
+// 1 == Compile in the --stress <instances,lights,materials,textures,seed> option. createScene() generates that many
+//      randomly placed box, sphere and torus instances, parallelogram lights, materials and procedural checker textures
+//      from the seed instead, for reproducible scaling measurements with --benchmark and --memoryreport. See src/StressScene.cpp.
+#define USE_STRESS_SCENE 1
+
+// Edge length in texels of the generated RGBA8 textures.
+#define STRESS_TEXTURE_SIZE 512
+
+// 0 == A different scene or environment needs a new process, which compiles all programs again.
+// 1 == Compile in Application::reloadScene(), the "Reload Scene" GUI field and the render server "scene" command.
+//      It destroys the geometry, materials, scene textures and accelerations and creates the new scene in the same
+//      OptiX context, so the programs, the compiled kernels and the denoiser stage are reused. See src/SceneReload.cpp.
+#define USE_SCENE_RELOAD 1
+
+// 0 == Only the beauty image (and the denoiser guide buffers) come out of the renderer.
+// 1 == Compile in the --aov <name,...> option. The megakernel integrator fills the selected AOV buffers in the same pass:
+//      depth, position, normal, material, direct, indirect and lights (AOV_LIGHT_GROUPS direct lighting buffers by light index).
+//      Disabled AOVs cost no memory and no stores. They are saved as extra EXR files next to the image. See src/Aov.cpp.
+#define USE_AOVS 1
+
+// 0 == Refractions use the single index of refraction of the material for all colors.
+// 1 == Compile in the --spectral option. The megakernel paths sample a hero wavelength, and materials with an Abbe number > 0
+//      disperse the light: the path continues with the hero wavelength alone after the first dispersive interface.
+//      Non-dispersive paths keep the RGB transport and cost. See shaders/spectral.h.
+#define USE_SPECTRAL 1
+// Lights with an index of AOV_LIGHT_GROUPS - 1 and higher share the last light group. At least 1.
+#define AOV_LIGHT_GROUPS 4
+
+// 0 == The primary rays sample the pixel area uniformly, which reconstructs the image with a box filter.
+// 1 == Compile in the --filter <box|tent|gaussian|blackmanharris>[,radius] option. The sub-pixel offsets of the primary rays
+//      are drawn from the pixel filter, so the plain average of the samples is the filtered image without any splatting.
+//      See shaders/pixel_filter.h and src/PixelFilter.cpp.
+#define USE_FILTER_IMPORTANCE_SAMPLING 1
+
+// 0 == Volumes only absorb homogeneously with the absorption coefficient of their material.
+// 1 == Compile in the --medium <material,density,albedo,anisotropy[,file.vol]> option. The megakernel integrator samples
+//      the free flights through the 3D density grid of a heterogeneous medium inside the closed geometry of the material
+//      with delta tracking, or estimates the transmittance of purely absorbing media with ratio tracking.
+//      A coarse grid of the maximum densities bounds the tracking steps per region. See shaders/medium.h and src/Media.cpp.
+#define USE_HETEROGENEOUS_MEDIA 1
+// Cells per axis of the majorant grid.
+#define MEDIUM_MAJORANT_GRID 16
+// Voxels per axis of the procedural density grid used without a file.
+#define MEDIUM_DENSITY_SIZE 64
+// Limits the tentative collisions per path segment.
+#define MEDIUM_MAX_STEPS 1024
+
+// 0 == The OptiX stack size is the --stack value, 1024 bytes by default.
+// 1 == Compile in the --calibratestack option. It renders a few iterations with stack overflow exceptions enabled at decreasing
+//      stack sizes, finds the smallest one without overflows and stores it per configuration (devices, OptiX version, shader
+//      defines, scene and programs) next to the PTX files. Runs without an explicit --stack apply the stored size with a safety
+//      margin. See src/StackCalibration.cpp.
+#define USE_STACK_CALIBRATION 1
+
+// 0 == The shaders are only available as the PTX compiled by the build.
+// 1 == Compile in the --define NAME=VALUE option. When it changes any of the switches which are wrapped in #ifndef here
+//      (or MATERIAL_STACK_SIZE in per_ray_data.h), the shaders are compiled with NVRTC at startup with these values
+//      and the PTX is cached inside the PTX directory. See src/ShaderCompilation.cpp. Needs the NVRTC library.
+//      The host code is compiled with the values below, so the denoiser switches can only be disabled at runtime.
+#define USE_RUNTIME_COMPILATION 1
 
 // 0 == Disable all OptiX exceptions, rtPrintfs and rtAssert functionality. (Benchmark only in this mode!)
 // 1 == Enable  all OptiX exceptions, rtPrintfs and rtAssert functionality. (Really only for debugging, big performance hit!)
+#ifndef USE_DEBUG_EXCEPTIONS
 #define USE_DEBUG_EXCEPTIONS 0
+#endif
 
 #endif // APP_CONFIG_H
@@ -0,0 +1,109 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+// GeometryTriangles and attribute programs exist since OptiX 6.0.0. Older versions compile this to an empty module.
+#if OPTIX_VERSION >= 60000
+
+#include "vertex_attributes.h"
+#include "compact_attributes.h"
+
+#if USE_COMPACT_ATTRIBUTES
+rtBuffer<float3>                  positionsBuffer;
+rtBuffer<VertexAttributesCompact> attributesBuffer;
+#else
+rtBuffer<VertexAttributes> attributesBuffer;
+#endif
+rtBuffer<uint3>            indicesBuffer;
+
+// Attributes.
+rtDeclareVariable(optix::float3, varGeoNormal, attribute GEO_NORMAL, );
+rtDeclareVariable(optix::float3, varTangent,   attribute TANGENT, );
+rtDeclareVariable(optix::float3, varNormal,    attribute NORMAL, ); 
+rtDeclareVariable(optix::float3, varTexCoord,  attribute TEXCOORD, ); 
+#if USE_CUTOUT_CLASSIFICATION
+rtDeclareVariable(unsigned int,  varPrimitiveIndex, attribute PRIMITIVE_INDEX, ); // The anyhit programs look up the cutout state with it.
+#endif
+
+// Attribute program for the built-in triangle intersection of GeometryTriangles.
+// Calculates the same attributes as intersection_triangle_indexed() from the hardware barycentrics.
+RT_PROGRAM void attribute_triangle_indexed()
+{
+  const uint3 indices = indicesBuffer[rtGetPrimitiveIndex()];
+
+  const float2 barycentrics = rtGetTriangleBarycentrics();
+
+  const float alpha = 1.0f - barycentrics.x - barycentrics.y;
+  const float beta  = barycentrics.x;
+  const float gamma = barycentrics.y;
+
+#if USE_COMPACT_ATTRIBUTES
+  const float3 v0 = positionsBuffer[indices.x];
+  const float3 v1 = positionsBuffer[indices.y];
+  const float3 v2 = positionsBuffer[indices.z];
+
+  VertexAttributesCompact const& a0 = attributesBuffer[indices.x];
+  VertexAttributesCompact const& a1 = attributesBuffer[indices.y];
+  VertexAttributesCompact const& a2 = attributesBuffer[indices.z];
+
+  varGeoNormal = optix::cross(v1 - v0, v2 - v0);
+  varTangent   = decodeOctahedral(a0.tangent) * alpha + decodeOctahedral(a1.tangent) * beta + decodeOctahedral(a2.tangent) * gamma;
+  varNormal    = decodeOctahedral(a0.normal)  * alpha + decodeOctahedral(a1.normal)  * beta + decodeOctahedral(a2.normal)  * gamma;
+#if USE_RAY_CONES
+  const float3 t0 = decodeTexcoord(a0.texcoord);
+  const float3 t1 = decodeTexcoord(a1.texcoord);
+  const float3 t2 = decodeTexcoord(a2.texcoord);
+
+  varTexCoord   = t0 * alpha + t1 * beta + t2 * gamma;
+  varTexCoord.z = getTriangleLod(t0, t1, t2, varGeoNormal);
+#else
+  varTexCoord  = decodeTexcoord(a0.texcoord)  * alpha + decodeTexcoord(a1.texcoord)  * beta + decodeTexcoord(a2.texcoord)  * gamma;
+#endif
+#else
+  VertexAttributes const& a0 = attributesBuffer[indices.x];
+  VertexAttributes const& a1 = attributesBuffer[indices.y];
+  VertexAttributes const& a2 = attributesBuffer[indices.z];
+
+  varGeoNormal = optix::cross(a1.vertex - a0.vertex, a2.vertex - a0.vertex);
+  varTangent   = a0.tangent  * alpha + a1.tangent  * beta + a2.tangent  * gamma;
+  varNormal    = a0.normal   * alpha + a1.normal   * beta + a2.normal   * gamma;
+  varTexCoord  = a0.texcoord * alpha + a1.texcoord * beta + a2.texcoord * gamma;
+#if USE_RAY_CONES
+  varTexCoord.z = getTriangleLod(a0.texcoord, a1.texcoord, a2.texcoord, varGeoNormal);
+#endif
+#endif
+#if USE_CUTOUT_CLASSIFICATION
+  varPrimitiveIndex = rtGetPrimitiveIndex();
+#endif
+}
+
+#endif // OPTIX_VERSION >= 60000
@@ -34,7 +34,11 @@
 
 #include "vertex_attributes.h"
 
+#if USE_COMPACT_ATTRIBUTES
+rtBuffer<float3>           positionsBuffer;
+#else
 rtBuffer<VertexAttributes> attributesBuffer;
+#endif
 rtBuffer<uint3>            indicesBuffer;
 
 // Axis Aligned Bounding Box routine for indexed interleaved triangle data.
@@ -42,9 +46,15 @@ RT_PROGRAM void boundingbox_triangle_indexed(int primitiveIndex, float result[6]
 {
   const uint3 indices = indicesBuffer[primitiveIndex];
 
+#if USE_COMPACT_ATTRIBUTES
+  const float3 v0 = positionsBuffer[indices.x];
+  const float3 v1 = positionsBuffer[indices.y];
+  const float3 v2 = positionsBuffer[indices.z];
+#else
   const float3 v0 = attributesBuffer[indices.x].vertex;
   const float3 v1 = attributesBuffer[indices.y].vertex;
   const float3 v2 = attributesBuffer[indices.z].vertex;
+#endif
 
   const float area = optix::length(optix::cross(v1 - v0, v2 - v0));
 
@@ -36,6 +36,20 @@
 #include "material_parameter.h"
 #include "light_definition.h"
 #include "shader_common.h"
+#include "sampler.h"
+#include "bsdf.h"
+#if USE_VIRTUAL_TEXTURES
+#include "virtual_texture.h"
+#endif
+#if USE_RESTIR
+#include "reservoir.h"
+#endif
+#if USE_RADIANCE_CACHE
+#include "radiance_cache.h"
+#endif
+#include "wedge.h"
+#include "ray_counters.h"
+#include "geometry_paging.h"
 
 // Context global variables provided by the renderer system.
 rtDeclareVariable(rtObject, sysTopObject, , );
@@ -60,19 +74,290 @@ rtDeclareVariable(int,      parMaterialIndex, , ); // Per Material index into th
 
 rtBuffer<LightDefinition> sysLightDefinitions;
 rtDeclareVariable(int,    sysNumLights, , );     // PERF Used many times and faster to read than sysLightDefinitions.size().
+rtDeclareVariable(int,    sysLightSamples, , );  // Number of light samples and shadow rays per diffuse hit, at least 1.
+rtBuffer<LightAlias>      sysLightAliasTable;      // Power-weighted light selection, one entry per light.
 
 rtBuffer< rtCallableProgramId<void(MaterialParameter const& parameters, State const& state, PerRayData& prd)> > sysSampleBSDF;
 rtBuffer< rtCallableProgramId<float4(MaterialParameter const& parameters, State const& state, PerRayData const& prd, float3 const& wiL)> > sysEvalBSDF;
 
 rtBuffer< rtCallableProgramId<void(float3 const& point, const float2 sample, LightSample& lightSample)> > sysSampleLight;
 
-RT_PROGRAM void closesthit()
+#if USE_VIRTUAL_TEXTURES
+rtBuffer<VirtualTextureDescription> sysVirtualTextures;
+#endif
+
+#if USE_RESTIR
+rtBuffer<Reservoir, 2> sysReservoirs;         // Written for the primary hits of the current iteration.
+rtBuffer<Reservoir, 2> sysReservoirsPrevious; // The reservoirs of the previous iteration. Swapped by the host after each iteration.
+rtDeclareVariable(int, sysRestirCandidates, , ); // Number of light samples resampled per primary hit.
+rtDeclareVariable(int, sysRestirReuse, , );      // 0 == sysReservoirsPrevious is not valid, 1 == reuse the previous reservoirs.
+
+rtDeclareVariable(float3, sysCameraPosition, , );
+rtDeclareVariable(float3, sysCameraU, , );
+rtDeclareVariable(float3, sysCameraV, , );
+rtDeclareVariable(float3, sysCameraW, , );
+
+rtDeclareVariable(float3, sysRestirCameraPosition, , ); // The camera of the previous iteration, to find the temporal reservoir.
+rtDeclareVariable(float3, sysRestirCameraU, , );
+rtDeclareVariable(float3, sysRestirCameraV, , );
+rtDeclareVariable(float3, sysRestirCameraW, , );
+
+rtDeclareVariable(uint2, sysResolution, , );
+#endif
+
+// Calls the BSDF sampling function. NUMBER_OF_BSDF_INDICES selects the bindless callable program at runtime,
+// any other BSDF value is a compile time constant and the function is inlined.
+template <int BSDF>
+RT_FUNCTION void sampleBSDF(MaterialParameter const& parameters, State const& state, PerRayData& prd)
+{
+  switch (BSDF)
+  {
+  case INDEX_BSDF_DIFFUSE_REFLECTION:
+    sampleDiffuseReflection(parameters, state, prd);
+    break;
+  case INDEX_BSDF_SPECULAR_REFLECTION:
+    sampleSpecularReflection(parameters, state, prd);
+    break;
+  case INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION:
+    sampleSpecularReflectionTransmission(parameters, state, prd);
+    break;
+  default:
+    sysSampleBSDF[parameters.indexBSDF](parameters, state, prd);
+    break;
+  }
+}
+
+template <int BSDF>
+RT_FUNCTION float4 evalBSDF(MaterialParameter const& parameters, State const& state, PerRayData const& prd, float3 const& wiL)
+{
+  switch (BSDF)
+  {
+  case INDEX_BSDF_DIFFUSE_REFLECTION:
+    return evalDiffuseReflection(parameters, state, prd, wiL);
+  case INDEX_BSDF_SPECULAR_REFLECTION:
+  case INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION:
+    return evalSpecular(parameters, state, prd, wiL);
+  default:
+    return sysEvalBSDF[parameters.indexBSDF](parameters, state, prd, wiL);
+  }
+}
+
+#if USE_RESTIR
+// Unshadowed contribution of the reservoir's light sample at the current hit. Its intensity is the target function of the resampling.
+// Area lights include the geometry term, so the weights of all pixels are with respect to the same area measure on the lights.
+template <int BSDF>
+RT_FUNCTION float3 evalReservoirSample(MaterialParameter const& parameters, State const& state, Reservoir const& reservoir, float3& direction, float& distance)
+{
+  float geometry = 1.0f; // The environment light is sampled in solid angle.
+
+  if (sysLightDefinitions[reservoir.light].type == LIGHT_ENVIRONMENT)
+  {
+    direction = reservoir.point;
+    distance  = RT_DEFAULT_MAX;
+  }
+  else
+  {
+    direction = reservoir.point - thePrd.pos;
+    distance  = optix::length(direction);
+    if (distance <= DENOMINATOR_EPSILON)
+    {
+      return make_float3(0.0f);
+    }
+    direction /= distance;
+
+    const float cosLight = optix::dot(-direction, decodeOctahedral(reservoir.lightNormal));
+    if (cosLight <= DENOMINATOR_EPSILON) // Only emit light on the front side.
+    {
+      return make_float3(0.0f);
+    }
+    geometry = cosLight / (distance * distance);
+  }
+
+  const float cosSurface = optix::dot(direction, state.normal);
+  if (cosSurface <= 0.0f)
+  {
+    return make_float3(0.0f);
+  }
+
+  const float4 bsdf_pdf = evalBSDF<BSDF>(parameters, state, thePrd, direction);
+  if (bsdf_pdf.w <= 0.0f)
+  {
+    return make_float3(0.0f);
+  }
+
+  return make_float3(bsdf_pdf) * reservoir.emission * (cosSurface * geometry);
+}
+
+// Direct lighting of a primary hit with resampled importance sampling.
+// The sysRestirCandidates light samples of this hit are streamed through a reservoir, which is then combined with the previous
+// iteration's reservoir at the reprojected pixel and RESTIR_SPATIAL_SAMPLES previous reservoirs around it.
+// Only the selected sample gets a shadow ray. Combining the previous reservoirs without their visibility is biased in shadow boundaries,
+// the similarity tests and the history limit keep that small. The final reservoir is stored for the next iteration.
+template <int BSDF>
+RT_FUNCTION float3 resampleDirectLighting(MaterialParameter const& parameters, State const& state)
+{
+  const float2 sampleBase  = sample2D(thePrd, SAMPLE_LIGHT);
+  const float  sampleIndex = sample1D(thePrd, SAMPLE_LIGHT_INDEX);
+
+  const float weight = 1.0f / float(sysRestirCandidates);
+
+  Reservoir reservoir;
+
+  reservoir.light = -1;
+
+  float wSum      = 0.0f;
+  float targetPdf = 0.0f;
+  float M         = float(sysRestirCandidates);
+
+  float3 direction;
+  float  distance;
+
+  for (int i = 0; i < sysRestirCandidates; ++i)
+  {
+    // The same stratification as the sysLightSamples loop of the regular direct lighting.
+    float2 sample = sampleBase + float(i) * make_float2(0.7548776662f, 0.5698402910f);
+    sample -= make_float2(floorf(sample.x), floorf(sample.y));
+
+    LightSample lightSample;
+
+    const float selection = (sampleIndex + float(i)) * weight * sysNumLights;
+    const int   slot      = optix::clamp(static_cast<int>(selection), 0, sysNumLights - 1);
+    const LightAlias entry = sysLightAliasTable[slot];
+    lightSample.index = (selection - float(slot) < entry.threshold) ? slot : entry.alias;
+
+    const LightType lightType = sysLightDefinitions[lightSample.index].type;
+
+    sysSampleLight[lightType](thePrd.pos, sample, lightSample);
+
+    if (0.0f < lightSample.pdf)
+    {
+      Reservoir candidate;
+
+      candidate.point       = (lightType == LIGHT_ENVIRONMENT) ? lightSample.direction : lightSample.position;
+      candidate.light       = lightSample.index;
+      candidate.emission    = lightSample.emission;
+      candidate.lightNormal = (lightType == LIGHT_ENVIRONMENT) ? 0 : encodeOctahedral(lightSample.normal);
+
+      const float pHat = intensity(evalReservoirSample<BSDF>(parameters, state, candidate, direction, distance));
+      if (0.0f < pHat)
+      {
+        // The solid angle pdf of the light sample converted to the measure of the target function.
+        const float pdf = (lightType == LIGHT_ENVIRONMENT) ? lightSample.pdf : lightSample.pdf * optix::dot(-direction, lightSample.normal) / (distance * distance);
+
+        if (updateReservoir(wSum, pHat / pdf, rng(thePrd.seed)))
+        {
+          reservoir = candidate;
+          targetPdf = pHat;
+        }
+      }
+    }
+  }
+
+  // Temporal and spatial reuse of the previous iteration's reservoirs. Their weights are reevaluated at this hit.
+  uint2 center;
+  if (sysRestirReuse && projectPinhole(thePrd.pos, sysRestirCameraPosition, sysRestirCameraU, sysRestirCameraV, sysRestirCameraW, sysResolution, center))
+  {
+    const float limit = RESTIR_HISTORY_LIMIT * float(sysRestirCandidates);
+
+    for (int i = 0; i <= RESTIR_SPATIAL_SAMPLES; ++i)
+    {
+      uint2 source = center; // The temporal reservoir first.
+      if (0 < i)
+      {
+        const float2 disk = rng2(thePrd.seed);
+        const float  r    = sqrtf(disk.x) * RESTIR_SPATIAL_RADIUS;
+        const float  phi  = disk.y * 2.0f * M_PIf;
+
+        source.x = static_cast<unsigned int>(optix::clamp(float(center.x) + r * cosf(phi), 0.0f, float(sysResolution.x - 1)));
+        source.y = static_cast<unsigned int>(optix::clamp(float(center.y) + r * sinf(phi), 0.0f, float(sysResolution.y - 1)));
+      }
+
+      const Reservoir previous = sysReservoirsPrevious[source];
+
+      if (isReusable(previous, thePrd.pos, state.normal, theIntersectionDistance, sysNumLights))
+      {
+        const float previousM = fminf(previous.M, limit);
+        const float pHat      = intensity(evalReservoirSample<BSDF>(parameters, state, previous, direction, distance));
+
+        if (updateReservoir(wSum, pHat * previous.W * previousM, rng(thePrd.seed)))
+        {
+          reservoir = previous;
+          targetPdf = pHat;
+        }
+        M += previousM;
+      }
+    }
+  }
+
+  float3 radiance = make_float3(0.0f);
+
+  reservoir.M        = M;
+  reservoir.W        = (0.0f < targetPdf) ? wSum / (M * targetPdf) : 0.0f;
+  reservoir.position = thePrd.pos;
+  reservoir.normal   = state.normal;
+
+  if (0.0f < reservoir.W)
+  {
+    const float3 contribution = evalReservoirSample<BSDF>(parameters, state, reservoir, direction, distance);
+
+    PerRayData_shadow prdShadow;
+
+    prdShadow.seed    = thePrd.seed;
+    prdShadow.visible = true;
+#if USE_RAY_CONES
+    prdShadow.cone    = getCone(thePrd);
+#endif
+
+    optix::Ray ray = optix::make_Ray(thePrd.pos, direction, 1, sysSceneEpsilon, distance - sysSceneEpsilon); // Shadow ray.
+#if USE_RAY_COUNTERS
+    countRay(RAY_COUNTER_SHADOW);
+#endif
+    rtTrace(sysTopObject, ray, theCurrentTime, prdShadow);
+
+    thePrd.seed = prdShadow.seed;
+
+    if (prdShadow.visible)
+    {
+      radiance = contribution * reservoir.W;
+      if (thePrd.flags & FLAG_VOLUME)
+      {
+        radiance *= expf(-distance * thePrd.extinction);
+      }
+    }
+    else
+    {
+      reservoir.W = 0.0f; // Occluded samples are not reused.
+    }
+  }
+
+  uint2 pixel;
+  if (projectPinhole(thePrd.pos, sysCameraPosition, sysCameraU, sysCameraV, sysCameraW, sysResolution, pixel))
+  {
+    sysReservoirs[pixel] = reservoir;
+  }
+
+  return radiance;
+}
+#endif // USE_RESTIR
+
+template <int BSDF>
+RT_FUNCTION void shade()
 {
   State state; // All in world space coordinates!
 
+#if USE_RAY_CONES
+  const float3 geoNormal = rtTransformNormal(RT_OBJECT_TO_WORLD, varGeoNormal); // Unnormalized, its length is needed for the texture level of detail.
+  state.geoNormal = optix::normalize(geoNormal);
+#else
   state.geoNormal = optix::normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, varGeoNormal));
+#endif
   state.normal    = optix::normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, varNormal));
   state.texcoord  = varTexCoord;
+#if USE_COMPACT_PAYLOAD
+  state.wo        = -theRay.direction; // Not stored in the compact payload.
+#else
+  state.wo        = thePrd.wo;
+#endif
 
   thePrd.pos      = theRay.origin + theRay.direction * theIntersectionDistance; // Advance the path to the hit position in world coordinates.
   thePrd.distance = theIntersectionDistance; // Return the current path segment distance, needed for absorption calculations in the integrator.
@@ -81,7 +366,11 @@ RT_PROGRAM void closesthit()
   // Keeps the material stack from overflowing at silhouttes.
   // Prevents that silhouettes of thin-walled materials use the backface material.
   // Using the true geometry normal attribute as originally defined on the frontface!
-  thePrd.flags |= (0.0f <= optix::dot(thePrd.wo, state.geoNormal)) ? (FLAG_FRONTFACE | FLAG_HIT) : FLAG_HIT;
+  thePrd.flags |= (0.0f <= optix::dot(state.wo, state.geoNormal)) ? (FLAG_FRONTFACE | FLAG_HIT) : FLAG_HIT;
+
+#if USE_GEOMETRY_PAGING
+  recordPageHit(); // Keeps the pages which are reached by any path segment resident.
+#endif
 
   if ((thePrd.flags & FLAG_FRONTFACE) == 0) // Looking at the backface?
   {
@@ -96,86 +385,256 @@ RT_PROGRAM void closesthit()
   // But since only parallelogram area lights are supported, those get a dedicated closest hit program to simplify this demo.
   thePrd.radiance  = make_float3(0.0f);
 
-  MaterialParameter parameters = sysMaterialParameters[parMaterialIndex]; // Copy the material parameters locally to be able to fetch texture data once.
+  MaterialParameter parameters = sysMaterialParameters[materialParameterIndex(parMaterialIndex)]; // Copy the material parameters locally to be able to fetch texture data once.
+
+#if USE_RAY_CONES
+  // The cone arriving at the hit point. Its footprint on the triangle selects the texture level of detail.
+  // The object space triangle lod is corrected by the instance scale, which is exact for uniformly scaled transforms.
+  float2 cone = getCone(thePrd);
+  cone.x += cone.y * theIntersectionDistance;
 
+  const float lod = getConeLod(cone.x, optix::dot(state.wo, state.geoNormal), state.texcoord.z + log2f(optix::length(geoNormal) / optix::length(varGeoNormal)));
+#endif
+
+#if USE_VIRTUAL_TEXTURES
+  if (0 <= parameters.albedoVirtualID)
+  {
+    VirtualTextureDescription const& vt = sysVirtualTextures[parameters.albedoVirtualID];
+#if USE_RAY_CONES
+    const float        lodVirtual = lod + 0.5f * log2f(float(vt.width) * float(vt.height));
+    const unsigned int level      = (0.0f < lodVirtual) ? static_cast<unsigned int>(lodVirtual) : 0; // Round to the finer level.
+#else
+    // Without ray differentials the finest level is requested for primary and specular paths, a coarser one after diffuse bounces.
+    const unsigned int level = (thePrd.flags & FLAG_DIFFUSE) ? VT_INDIRECT_LEVEL_BIAS : 0;
+#endif
+    parameters.albedo *= make_float3(sampleVirtualTexture(vt, make_float2(state.texcoord), level));
+  }
+  else
+#endif
   if (parameters.albedoID != RT_TEXTURE_ID_NULL)
   {
+#if USE_RAY_CONES
+    const float3 texColor = make_float3(optix::rtTex2DLod<float4>(parameters.albedoID, state.texcoord.x, state.texcoord.y, lod + parameters.albedoLod));
+#else
     const float3 texColor = make_float3(optix::rtTex2D<float4>(parameters.albedoID, state.texcoord.x, state.texcoord.y));
+#endif
     
     // Modulate the incoming color with the texture.
     parameters.albedo *= texColor;               // linear color, resp. if the texture has been uint8 and readmode set to use sRGB, then sRGB.
     //parameters.albedo *= powf(texColor, 2.2f); // sRGB gamma correction done manually.
   }
 
+  // Start fresh with the next BSDF sample.  (Either of these values remaining zero is an end-of-path condition.)
+  thePrd.f_over_pdf = make_float3(0.0f);
+  thePrd.pdf        = 0.0f;
+
 #if USE_DENOISER
 #if USE_DENOISER_ALBEDO
-  thePrd.albedo = parameters.albedo;
-#if USE_DENOISER_NORMAL
-    thePrd.normal = state.normal;
+  setAlbedo(thePrd, parameters.albedo); // After the f_over_pdf reset, the compact payload returns the albedo in there.
 #endif
 #endif
+#if PAYLOAD_NORMAL
+  setNormal(thePrd, state.normal);
+#endif
+#if USE_AOVS
+  thePrd.aovMaterial = parMaterialIndex;
+#endif
+#if PAYLOAD_MATERIAL_INDEX
+  thePrd.materialIndex = materialParameterIndex(parMaterialIndex); // The wedge variant's parameters.
 #endif
-
-  // Start fresh with the next BSDF sample.  (Either of these values remaining zero is an end-of-path condition.)
-  thePrd.f_over_pdf = make_float3(0.0f);
-  thePrd.pdf        = 0.0f;
 
   // Only the last diffuse hit is tracked for multiple importance sampling of implicit light hits.
-  thePrd.flags = (thePrd.flags & ~FLAG_DIFFUSE) | parameters.flags; // FLAG_THINWALLED can be set directly from the material parameters.
+  thePrd.flags = (thePrd.flags & ~(FLAG_DIFFUSE | FLAG_RESAMPLED)) | parameters.flags; // FLAG_THINWALLED can be set directly from the material parameters.
 
-  sysSampleBSDF[parameters.indexBSDF](parameters, state, thePrd);
+  sampleBSDF<BSDF>(parameters, state, thePrd);
+
+#if USE_RAY_CONES
+  // Specular events keep the spread angle, surface curvature is ignored. Diffuse lobes blur the footprint of the continuation.
+  if (thePrd.flags & FLAG_DIFFUSE)
+  {
+    cone.y = fmaxf(cone.y, RAY_CONE_DIFFUSE_SPREAD);
+  }
+  setCone(thePrd, cone);
+#endif
+
+#if USE_RADIANCE_CACHE
+  // Diffuse hits of the megakernel paths return their cache cell. After enough diffuse bounces a populated cell ends the path.
+  if ((thePrd.flags & (FLAG_CACHE | FLAG_DIFFUSE)) == (FLAG_CACHE | FLAG_DIFFUSE))
+  {
+    thePrd.cacheCell = findCacheCell(thePrd.pos, state.normal);
+
+    if ((thePrd.flags & FLAG_CACHE_QUERY) && thePrd.cacheCell != RADIANCE_CACHE_NONE)
+    {
+      const float4 value = sysCacheValue[thePrd.cacheCell];
+      if (RADIANCE_CACHE_MIN_ITERATIONS <= value.w)
+      {
+        thePrd.radiance = make_float3(value); // The outgoing radiance including the direct lighting.
+        thePrd.flags   |= FLAG_CACHED | FLAG_TERMINATE;
+        return;
+      }
+    }
+  }
+#endif
 
 #if USE_NEXT_EVENT_ESTIMATION
   // Direct lighting if the sampled BSDF was diffuse and any light is in the scene.
-  if ((thePrd.flags & FLAG_DIFFUSE) && 0 < sysNumLights)
+  // Only the diffuse BSDF sets FLAG_DIFFUSE, the specialized specular programs do not contain this code at all.
+#if USE_RESTIR
+  // The primary hits of the megakernel resample their direct lighting instead.
+  if ((BSDF == NUMBER_OF_BSDF_INDICES || BSDF == INDEX_BSDF_DIFFUSE_REFLECTION) && (thePrd.flags & (FLAG_DIFFUSE | FLAG_PRIMARY)) == (FLAG_DIFFUSE | FLAG_PRIMARY) && 0 < sysNumLights)
+  {
+    thePrd.radiance += resampleDirectLighting<BSDF>(parameters, state);
+    thePrd.flags    |= FLAG_RESAMPLED;
+  }
+  else
+#endif
+  if ((BSDF == NUMBER_OF_BSDF_INDICES || BSDF == INDEX_BSDF_DIFFUSE_REFLECTION) && (thePrd.flags & FLAG_DIFFUSE) && 0 < sysNumLights)
   {
-    const float2 sample = rng2(thePrd.seed); // Use lower dimension samples for the position. (Irrelevant for the LCG).
+    // One sampler sample drives all sysLightSamples light samples of this hit:
+    // The light selection is stratified, the positions on the lights are the R2 sequence rotated by the sampler's 2D sample.
+    const float2 sampleBase  = sample2D(thePrd, SAMPLE_LIGHT); // Use lower dimension samples for the position. (Irrelevant for the LCG).
+    const float  sampleIndex = sample1D(thePrd, SAMPLE_LIGHT_INDEX);
 
-    LightSample lightSample; // Sample one of many lights. 
-  
-    // The caller picks the light to sample. Make sure the index stays in the bounds of the sysLightDefinitions array.
-    lightSample.index = optix::clamp(static_cast<int>(floorf(rng(thePrd.seed) * sysNumLights)), 0, sysNumLights - 1); 
+    const float weight = 1.0f / float(sysLightSamples);
 
-    const LightType lightType = sysLightDefinitions[lightSample.index].type;
+    float3 radiance = make_float3(0.0f);
 
-    sysSampleLight[lightType](thePrd.pos, sample, lightSample);
-  
-    if (0.0f < lightSample.pdf) // Useful light sample?
+#if USE_VISIBILITY_CACHE
+    // The counts of the pixel's primary hits decide if this hit needs shadow rays at all.
+    // 1 == all traced shadow rays were visible, -1 == all were occluded, 0 == penumbra or still warming up.
+    unsigned int visible = thePrd.visibility >> 16;
+    unsigned int traced  = thePrd.visibility & 0xFFFF;
+
+    int cached = 0;
+    if ((thePrd.flags & FLAG_VISIBILITY) && VISIBILITY_CACHE_WARMUP <= traced)
     {
-      // Evaluate the BSDF in the light sample direction. Normally cheaper than shooting rays.
-      // Returns BSDF f in .xyz and the BSDF pdf in .w
-      const float4 bsdf_pdf = sysEvalBSDF[parameters.indexBSDF](parameters, state, thePrd, lightSample.direction);
+      cached = (visible == traced) ? 1 : ((visible == 0) ? -1 : 0);
+    }
 
-      if (0.0f < bsdf_pdf.w && isNotNull(make_float3(bsdf_pdf)))
-      {
-        // Do the visibility check of the light sample.
-        PerRayData_shadow prdShadow;
-      
-        prdShadow.seed    = thePrd.seed; // For potential stochastic cutout opacity sampling.
-        prdShadow.visible = true;        // Initialize for miss.
+    for (int i = 0; i < sysLightSamples && 0 <= cached; ++i) // Occluded pixels have no direct lighting.
+#else
+    for (int i = 0; i < sysLightSamples; ++i)
+#endif
+    {
+      float2 sample = sampleBase + float(i) * make_float2(0.7548776662f, 0.5698402910f);
+      sample -= make_float2(floorf(sample.x), floorf(sample.y));
 
-        // Note that the sysSceneEpsilon is applied on both sides of the shadow ray [t_min, t_max] interval 
-        // to prevent self intersections with the actual light geometry in the scene!
-        optix::Ray ray = optix::make_Ray(thePrd.pos, lightSample.direction, 1, sysSceneEpsilon, lightSample.distance - sysSceneEpsilon); // Shadow ray.
-        rtTrace(sysTopObject, ray, theCurrentTime, prdShadow);
+      LightSample lightSample; // Sample one of many lights. 
+  
+      // The caller picks the light to sample with the alias table. Make sure the index stays in the bounds of the sysLightDefinitions array.
+      // The selection probability is part of the returned lightSample.pdf.
+      const float selection = (sampleIndex + float(i)) * weight * sysNumLights;
+      const int   slot      = optix::clamp(static_cast<int>(selection), 0, sysNumLights - 1);
+      const LightAlias entry = sysLightAliasTable[slot];
+      lightSample.index = (selection - float(slot) < entry.threshold) ? slot : entry.alias;
 
-        thePrd.seed = prdShadow.seed; // Continue the RNG state!
+      const LightType lightType = sysLightDefinitions[lightSample.index].type;
 
-        if (prdShadow.visible)
+      sysSampleLight[lightType](thePrd.pos, sample, lightSample);
+  
+      if (0.0f < lightSample.pdf) // Useful light sample?
+      {
+        // Evaluate the BSDF in the light sample direction. Normally cheaper than shooting rays.
+        // Returns BSDF f in .xyz and the BSDF pdf in .w
+        const float4 bsdf_pdf = evalBSDF<BSDF>(parameters, state, thePrd, lightSample.direction);
+
+        if (0.0f < bsdf_pdf.w && isNotNull(make_float3(bsdf_pdf)))
         {
-          if (thePrd.flags & FLAG_VOLUME) // Supporting nested materials includes having lights inside a volume.
+          // Do the visibility check of the light sample.
+          PerRayData_shadow prdShadow;
+      
+          prdShadow.seed    = thePrd.seed; // For potential stochastic cutout opacity sampling.
+          prdShadow.visible = true;        // Initialize for miss.
+#if USE_RAY_CONES
+          prdShadow.cone    = cone;
+#endif
+
+#if USE_VISIBILITY_CACHE
+          if (cached == 0)
+#endif
           {
-            // Calculate the transmittance along the light sample's distance in case it's inside a volume.
-            // The light must be in the same volume or it would have been shadowed!
-            lightSample.emission *= expf(-lightSample.distance * thePrd.extinction);
+            // Note that the sysSceneEpsilon is applied on both sides of the shadow ray [t_min, t_max] interval 
+            // to prevent self intersections with the actual light geometry in the scene!
+            optix::Ray ray = optix::make_Ray(thePrd.pos, lightSample.direction, 1, sysSceneEpsilon, lightSample.distance - sysSceneEpsilon); // Shadow ray.
+#if USE_RAY_COUNTERS
+            countRay(RAY_COUNTER_SHADOW);
+#endif
+            rtTrace(sysTopObject, ray, theCurrentTime, prdShadow);
+
+            thePrd.seed = prdShadow.seed; // Continue the RNG state!
+
+#if USE_VISIBILITY_CACHE
+            if (thePrd.flags & FLAG_VISIBILITY)
+            {
+              if (traced == 0xFFFF) // Keep the ratio when the counters saturate.
+              {
+                visible >>= 1;
+                traced  >>= 1;
+              }
+              visible += (prdShadow.visible) ? 1 : 0;
+              traced  += 1;
+            }
+#endif
           }
 
-          const float misWeight = powerHeuristic(lightSample.pdf, bsdf_pdf.w);
-
-          thePrd.radiance += make_float3(bsdf_pdf) * lightSample.emission * (misWeight * optix::dot(lightSample.direction, state.normal) / lightSample.pdf);
+          if (prdShadow.visible)
+          {
+            if (thePrd.flags & FLAG_VOLUME) // Supporting nested materials includes having lights inside a volume.
+            {
+              // Calculate the transmittance along the light sample's distance in case it's inside a volume.
+              // The light must be in the same volume or it would have been shadowed!
+              lightSample.emission *= expf(-lightSample.distance * thePrd.extinction);
+            }
+
+            // Multi-sample MIS: The light strategy takes sysLightSamples samples, the BSDF strategy one.
+            // The implicit light hits in closesthit_light.cu and miss.cu use the same sample count weighting.
+            const float misWeight = powerHeuristic(float(sysLightSamples) * lightSample.pdf, bsdf_pdf.w);
+
+            const float3 contribution = make_float3(bsdf_pdf) * lightSample.emission * (misWeight * optix::dot(lightSample.direction, state.normal) / lightSample.pdf);
+
+            radiance += contribution;
+#if USE_AOVS
+            if (thePrd.flags & FLAG_AOV_LIGHTS)
+            {
+              thePrd.aovLights[min(lightSample.index, AOV_LIGHT_GROUPS - 1)] += contribution * weight;
+            }
+#endif
+          }
         }
       }
     }
+    thePrd.radiance += radiance * weight;
+#if USE_VISIBILITY_CACHE
+    if (thePrd.flags & FLAG_VISIBILITY)
+    {
+      thePrd.visibility = (visible << 16) | traced;
+    }
+#endif
   }
 #endif // USE_NEXT_EVENT_ESTIMATION
 }
+
+// Generic closest hit program, the BSDF is selected per hit with parameters.indexBSDF.
+RT_PROGRAM void closesthit()
+{
+  shade<NUMBER_OF_BSDF_INDICES>();
+}
+
+#if USE_SPECIALIZED_MATERIALS
+// One closest hit program per BSDF with the sampling and evaluation inlined.
+// The Material using it must only be assigned to material parameters with that indexBSDF.
+RT_PROGRAM void closesthit_diffuse_reflection()
+{
+  shade<INDEX_BSDF_DIFFUSE_REFLECTION>();
+}
+
+RT_PROGRAM void closesthit_specular_reflection()
+{
+  shade<INDEX_BSDF_SPECULAR_REFLECTION>();
+}
+
+RT_PROGRAM void closesthit_specular_reflection_transmission()
+{
+  shade<INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION>();
+}
+#endif
@@ -55,8 +55,9 @@ rtDeclareVariable(optix::float3, varGeoNormal, attribute GEO_NORMAL, );
 
 rtBuffer<LightDefinition> sysLightDefinitions;
 rtDeclareVariable(int,    parLightIndex, , );  // Index into the sysLightDefinitions array.
+rtDeclareVariable(int,    sysLightSamples, , ); // The light sample pdfs count this many times in the MIS weights.
 
-// Very simple closest hit program just for rectangle area lights.
+// Very simple closest hit program just for rectangle area lights and the triangles of mesh lights.
 RT_PROGRAM void closesthit_light()
 {
   thePrd.pos      = theRay.origin + theRay.direction * theIntersectionDistance; // Advance the path to the hit position in world coordinates.
@@ -64,20 +65,33 @@ RT_PROGRAM void closesthit_light()
 
   const float3 geoNormal = optix::normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, varGeoNormal)); // PERF Not really needed when it's know that light geometry is not under Transforms.
 
+#if USE_COMPACT_PAYLOAD
+  const float cosTheta = -optix::dot(theRay.direction, geoNormal); // The compact payload has no outgoing direction.
+#else
   const float cosTheta = optix::dot(thePrd.wo, geoNormal);
+#endif
   thePrd.flags |= (0.0f <= cosTheta) ? (FLAG_FRONTFACE | FLAG_HIT) : FLAG_HIT;
 
   const LightDefinition light = sysLightDefinitions[parLightIndex];
 
+#if USE_MESH_LIGHTS
+  const float3 lightNormal = (light.type == LIGHT_MESH) ? geoNormal : light.normal; // Mesh lights emit along the triangle windings.
+#else
+  const float3 lightNormal = light.normal;
+#endif
+
   thePrd.radiance = make_float3(0.0f); // Backside is black.
 
 #if USE_DENOISER
 #if USE_DENOISER_ALBEDO
-  thePrd.albedo   = make_float3(0.0f); // Backside is black.
-#if USE_DENOISER_NORMAL
-  thePrd.normal   = -light.normal;
+  setAlbedo(thePrd, make_float3(0.0f)); // Backside is black.
+#endif
 #endif
+#if PAYLOAD_NORMAL
+  setNormal(thePrd, -lightNormal);
 #endif
+#if USE_AOVS
+  thePrd.aovMaterial = -2 - parLightIndex; // The integrator attributes the emission to the light group of this light.
 #endif
 
   if (thePrd.flags & FLAG_FRONTFACE) // Looking at the front face?
@@ -86,21 +100,28 @@ RT_PROGRAM void closesthit_light()
 
 #if USE_DENOISER
 #if USE_DENOISER_ALBEDO
-    thePrd.albedo   = light.emission;
-#if USE_DENOISER_NORMAL
-    thePrd.normal   = light.normal;
+    setAlbedo(thePrd, light.emission);
 #endif
 #endif
+#if PAYLOAD_NORMAL
+    setNormal(thePrd, lightNormal);
 #endif
 
 #if USE_NEXT_EVENT_ESTIMATION
-    const float pdfLight = (thePrd.distance * thePrd.distance) / (light.area * cosTheta); // Solid angle pdf. Assumes light.area != 0.0f.
+    // Solid angle pdf times the light selection probability, matching the explicit light sample. Assumes light.area != 0.0f.
+    const float pdfLight = (thePrd.distance * thePrd.distance) / (light.area * cosTheta) * light.pdfSelection;
     // If it's an implicit light hit from a diffuse scattering event and the light emission was not returning a zero pdf.
     if ((thePrd.flags & FLAG_DIFFUSE) && DENOMINATOR_EPSILON < pdfLight)
     {
       // Scale the emission with the power heuristic between the previous BSDF sample pdf and this implicit light sample pdf.
-      thePrd.radiance *= powerHeuristic(thePrd.pdf, pdfLight);
+      thePrd.radiance *= powerHeuristic(thePrd.pdf, float(sysLightSamples) * pdfLight);
     }
+#if USE_RESTIR
+    if (thePrd.flags & FLAG_RESAMPLED)
+    {
+      thePrd.radiance = make_float3(0.0f); // The resampled direct lighting of the last hit contains this light already.
+    }
+#endif
 #endif // USE_NEXT_EVENT_ESTIMATION
   }
 
@@ -0,0 +1,175 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef COMPACT_ATTRIBUTES_H
+#define COMPACT_ATTRIBUTES_H
+
+#include "app_config.h"
+
+#include <optixu/optixu_math_namespace.h>
+
+#if defined(__CUDACC__)
+#include <cuda_fp16.h>
+#else
+#include <cstring>
+#endif
+
+// Non-position vertex attributes in 12 instead of 36 bytes. The positions are held in their own float3 buffer.
+struct VertexAttributesCompact
+{
+  unsigned int normal;   // Octahedral encoding, two snorm16 values.
+  unsigned int tangent;  // Octahedral encoding, two snorm16 values.
+  unsigned int texcoord; // Two half floats, u in the low bits.
+};
+
+// The octahedral encoding is also used on the device for the directions inside the compact PerRayData.
+inline RT_HOSTDEVICE unsigned int floatToSnorm16(const float f)
+{
+  const float c = optix::clamp(f, -1.0f, 1.0f);
+  return (unsigned int) (unsigned short) (short) floorf(c * 32767.0f + ((c < 0.0f) ? -0.5f : 0.5f));
+}
+
+// The vector must be normalized.
+inline RT_HOSTDEVICE unsigned int encodeOctahedral(optix::float3 const& v)
+{
+  const float invL1 = 1.0f / (fabsf(v.x) + fabsf(v.y) + fabsf(v.z));
+
+  float x = v.x * invL1;
+  float y = v.y * invL1;
+  if (v.z < 0.0f)
+  {
+    const float ox = x;
+    x = (1.0f - fabsf(y))  * ((0.0f <= ox) ? 1.0f : -1.0f);
+    y = (1.0f - fabsf(ox)) * ((0.0f <= y)  ? 1.0f : -1.0f);
+  }
+  return floatToSnorm16(x) | (floatToSnorm16(y) << 16);
+}
+
+// The octahedral decoding is also used on the host when baking transforms into the vertex data.
+inline RT_HOSTDEVICE float snorm16ToFloat(const unsigned int bits)
+{
+  return fmaxf(float(short(bits & 0xFFFF)) / 32767.0f, -1.0f);
+}
+
+inline RT_HOSTDEVICE optix::float3 decodeOctahedral(const unsigned int bits)
+{
+  const float x = snorm16ToFloat(bits);
+  const float y = snorm16ToFloat(bits >> 16);
+
+  optix::float3 v = optix::make_float3(x, y, 1.0f - fabsf(x) - fabsf(y));
+  if (v.z < 0.0f)
+  {
+    v.x = (1.0f - fabsf(y)) * copysignf(1.0f, x);
+    v.y = (1.0f - fabsf(x)) * copysignf(1.0f, y);
+  }
+  return optix::normalize(v);
+}
+
+#if defined(__CUDACC__)
+
+RT_FUNCTION optix::float3 decodeTexcoord(const unsigned int bits)
+{
+  return optix::make_float3(__half2float(__ushort_as_half((unsigned short) (bits & 0xFFFF))),
+                            __half2float(__ushort_as_half((unsigned short) (bits >> 16))),
+                            0.0f);
+}
+
+#else // Host side encoding used inside Application::createGeometry().
+
+// IEEE 754 binary16 with round to nearest. Values beyond the half range turn into infinity.
+inline unsigned int floatToHalf(const float f)
+{
+  unsigned int x;
+  memcpy(&x, &f, sizeof(unsigned int));
+
+  const unsigned int sign     = (x >> 16) & 0x8000;
+  const unsigned int absolute = x & 0x7FFFFFFF;
+
+  if (0x7F800000 < absolute) // NaN
+  {
+    return sign | 0x7E00;
+  }
+  if (0x477FEFFF < absolute) // Rounds to a value beyond 65504.0f, or infinity.
+  {
+    return sign | 0x7C00;
+  }
+  if (absolute < 0x38800000) // Denormalized half, or zero.
+  {
+    if (absolute < 0x33000000)
+    {
+      return sign;
+    }
+    const unsigned int mantissa = (absolute & 0x007FFFFF) | 0x00800000;
+    const unsigned int shift    = 126 - (absolute >> 23);
+    return sign | ((mantissa + (1u << (shift - 1))) >> shift);
+  }
+  return sign | ((absolute - 0x38000000 + 0x00001000) >> 13); // Rounding may carry into the exponent, which is correct.
+}
+
+inline float halfToFloat(const unsigned int bits)
+{
+  const unsigned int sign     = (bits & 0x8000) << 16;
+  const unsigned int exponent = (bits >> 10) & 0x1F;
+  const unsigned int mantissa = bits & 0x03FF;
+
+  if (exponent == 0) // Denormalized half, or zero.
+  {
+    const float f = ldexpf(float(mantissa), -24);
+    return (sign) ? -f : f;
+  }
+
+  const unsigned int x = (exponent == 31) ? (sign | 0x7F800000 | (mantissa << 13)) // Infinity or NaN.
+                                          : (sign | ((exponent + 112) << 23) | (mantissa << 13));
+  float f;
+  memcpy(&f, &x, sizeof(float));
+  return f;
+}
+
+inline VertexAttributesCompact encodeVertexAttributes(optix::float3 const& tangent, optix::float3 const& normal, optix::float3 const& texcoord)
+{
+  VertexAttributesCompact compact;
+
+  compact.normal   = encodeOctahedral(normal);
+  compact.tangent  = encodeOctahedral(tangent);
+  compact.texcoord = floatToHalf(texcoord.x) | (floatToHalf(texcoord.y) << 16);
+
+  return compact;
+}
+
+inline void decodeVertexAttributes(VertexAttributesCompact const& compact, optix::float3& tangent, optix::float3& normal, optix::float3& texcoord)
+{
+  tangent  = decodeOctahedral(compact.tangent);
+  normal   = decodeOctahedral(compact.normal);
+  texcoord = optix::make_float3(halfToFloat(compact.texcoord & 0xFFFF), halfToFloat(compact.texcoord >> 16), 0.0f);
+}
+
+#endif
+
+#endif // COMPACT_ATTRIBUTES_H
@@ -0,0 +1,78 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "shader_common.h"
+
+rtBuffer<float4, 2> sysOutputBuffer; // RGBA32F, the mean radiance per pixel.
+rtBuffer<float, 2>  sysMomentBuffer; // The mean squared radiance intensity per pixel.
+rtBuffer<float, 2>  sysTileError;    // One error estimate per ADAPTIVE_TILE_SIZE * ADAPTIVE_TILE_SIZE tile.
+
+rtDeclareVariable(int, sysIterationIndex, , ); // The index of the last rendered iteration. Number of samples is one more.
+
+rtDeclareVariable(uint2, sysResolution, , ); // The rendered sub-rectangle of the buffers.
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+// 2D launch over the tiles. Calculates the maximum error estimate over all pixels inside a tile.
+// The host compares that against the target error and only renders the tiles which are above it.
+RT_PROGRAM void convergence()
+{
+  const uint2 screen = sysResolution;
+  const uint2 origin = theLaunchIndex * ADAPTIVE_TILE_SIZE;
+  const uint2 end    = make_uint2(min(origin.x + ADAPTIVE_TILE_SIZE, screen.x),
+                                  min(origin.y + ADAPTIVE_TILE_SIZE, screen.y));
+
+  const float samples = float(sysIterationIndex + 1);
+
+  float maxError = 0.0f;
+
+  for (unsigned int y = origin.y; y < end.y; ++y)
+  {
+    for (unsigned int x = origin.x; x < end.x; ++x)
+    {
+      const uint2 pixel = make_uint2(x, y);
+
+      const float mean     = intensity(make_float3(sysOutputBuffer[pixel]));
+      const float variance = fmaxf(0.0f, sysMomentBuffer[pixel] - mean * mean);
+
+      // Relative standard error of the pixel estimate.
+      // The offset keeps very dark pixels from never converging due to the division.
+      const float error = sqrtf(variance / samples) / (mean + 0.01f);
+
+      maxError = fmaxf(maxError, error);
+    }
+  }
+
+  sysTileError[theLaunchIndex] = maxError;
+}
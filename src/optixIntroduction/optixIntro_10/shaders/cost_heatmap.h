@@ -28,60 +28,60 @@
 
 #pragma once
 
-#ifndef PINHOLE_CAMERA_H
-#define PINHOLE_CAMERA_H
+#ifndef COST_HEATMAP_H
+#define COST_HEATMAP_H
+
+#include "app_config.h"
 
 #include <optix.h>
-#include <optixu/optixpp_namespace.h>
 #include <optixu/optixu_math_namespace.h>
 
+#include "rt_function.h"
+#include "cost_heatmap_type.h"
+
+#if USE_COST_HEATMAP
+rtBuffer<float, 2>       sysCostBuffer;     // clock64() cycles per pixel of the last launch, or their mean over the iterations.
+rtDeclareVariable(int,   sysCostHeatmap, , ); // COST_HEATMAP_OFF, COST_HEATMAP_FRAME or COST_HEATMAP_AVERAGE.
+rtDeclareVariable(float, sysCostScale, , );   // Cycles mapped to red. Higher costs are shown white.
 
-class PinholeCamera
+// Dark blue over cyan, green and yellow to red for t in [0, 1].
+RT_FUNCTION float3 heatmapColor(const float t)
 {
-public:
-  PinholeCamera();
-  ~PinholeCamera();
+  if (1.0f <= t)
+  {
+    return make_float3(1.0f);
+  }
 
-  void setViewport(int w, int h);
-  void setBaseCoordinates(int x, int y);
-  void setSpeedRatio(float f);
-  void setFocusDistance(float f);
+  const float s = fmaxf(t, 0.0f) * 4.0f;
+  if (s < 1.0f)
+  {
+    return optix::lerp(make_float3(0.0f, 0.0f, 0.5f), make_float3(0.0f, 0.5f, 1.0f), s);
+  }
+  if (s < 2.0f)
+  {
+    return optix::lerp(make_float3(0.0f, 0.5f, 1.0f), make_float3(0.0f, 1.0f, 0.0f), s - 1.0f);
+  }
+  if (s < 3.0f)
+  {
+    return optix::lerp(make_float3(0.0f, 1.0f, 0.0f), make_float3(1.0f, 1.0f, 0.0f), s - 2.0f);
+  }
+  return optix::lerp(make_float3(1.0f, 1.0f, 0.0f), make_float3(1.0f, 0.0f, 0.0f), s - 3.0f);
+}
 
-  void orbit(int x, int y);
-  void pan(int x, int y);
-  void dolly(int x, int y);
-  void focus(int x, int y);
-  void zoom(float x);
+// Records the cycles since start for the pixel and returns its heatmap color.
+RT_FUNCTION float3 recordCost(const uint2 pixel, const long long start, const int iteration)
+{
+  const float cycles = float(clock64() - start);
 
-  bool  getFrustum(optix::float3& pos, optix::float3& u, optix::float3& v, optix::float3& w);
-  float getAspectRatio() const;
-  
-public: // Just to be able to load and save them easily.
-  optix::float3 m_center;   // Center of interest point, around which is orbited (and the sharp plane of a depth of field camera).
-  float         m_distance; // Distance of the camera from the center of intest.
-  float         m_phi;      // Range [0.0f, 1.0f] from positive x-axis 360 degrees around the latitudes.
-  float         m_theta;    // Range [0.0f, 1.0f] from negative to positive y-axis.
-  float         m_fov;      // In degrees. Default is 60.0f
+  float cost = cycles;
+  if (sysCostHeatmap == COST_HEATMAP_AVERAGE && 0 < iteration)
+  {
+    cost = optix::lerp(sysCostBuffer[pixel], cycles, 1.0f / float(iteration + 1));
+  }
+  sysCostBuffer[pixel] = cost;
 
-private:
-  bool setDelta(int x, int y);
-  
-private:
-  int   m_width;    // Viewport width.
-  int   m_height;   // Viewport height.
-  float m_aspect;   // m_width / m_height
-  int   m_baseX;
-  int   m_baseY;
-  float m_speedRatio;
-  
-  // Derived values:
-  int           m_dx;
-  int           m_dy;
-  bool          m_changed;
-  optix::float3 m_cameraPosition;
-  optix::float3 m_cameraU;
-  optix::float3 m_cameraV;
-  optix::float3 m_cameraW;
-};
+  return heatmapColor(cost / sysCostScale);
+}
+#endif
 
-#endif // PINHOLE_CAMERA_H
+#endif // COST_HEATMAP_H
@@ -28,21 +28,12 @@
 
 #pragma once
 
-#ifndef MY_ASSERT_H
-#define MY_ASSERT_H
+#ifndef COST_HEATMAP_TYPE_H
+#define COST_HEATMAP_TYPE_H
 
-#undef MY_ASSERT
+// Values of sysCostHeatmap. Shared between host and device code.
+#define COST_HEATMAP_OFF     0 // The output buffer holds the rendered image.
+#define COST_HEATMAP_FRAME   1 // The output buffer holds the false color cost of the last launch per pixel.
+#define COST_HEATMAP_AVERAGE 2 // The output buffer holds the false color mean cost over the accumulated iterations.
 
-#if !defined(NDEBUG)
-  #if defined(_WIN32) // Windows 32/64-bit
-    #include <windows.h>
-    #define DBGBREAK() DebugBreak();
-  #else
-    #define DBGBREAK() __builtin_trap();
-  #endif
-  #define MY_ASSERT(expr) if (!(expr)) DBGBREAK()
-#else
-  #define MY_ASSERT(expr)
-#endif
-
-#endif // MY_ASSERT_H
+#endif // COST_HEATMAP_TYPE_H
@@ -0,0 +1,88 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#ifndef CUBEMAP_ENVIRONMENT_H
+#define CUBEMAP_ENVIRONMENT_H
+
+#include "app_config.h"
+
+#include <optixu/optixu_math_namespace.h>
+
+// The face order and orientation of the CUDA cubemap lookup: +x, -x, +y, -y, +z, -z.
+// (a, b) are the face coordinates in the range [-1, 1], a increases with the texel column, b with the texel row.
+// Used on the host to resample lat-long images and build the distribution and on the device to sample it,
+// so that all of them agree with what rtTexCubemap() returns.
+
+// Point on the face plane at distance 1.0f from the origin. Not normalized, its length is needed for the solid angle pdf.
+inline RT_HOSTDEVICE optix::float3 cubemapDirection(const unsigned int face, const float a, const float b)
+{
+  switch (face)
+  {
+    case 0:
+      return optix::make_float3( 1.0f, -b, -a);
+    case 1:
+      return optix::make_float3(-1.0f, -b,  a);
+    case 2:
+      return optix::make_float3( a,  1.0f,  b);
+    case 3:
+      return optix::make_float3( a, -1.0f, -b);
+    case 4:
+      return optix::make_float3( a, -b,  1.0f);
+    default:
+      return optix::make_float3(-a, -b, -1.0f);
+  }
+}
+
+// Inverse of cubemapDirection(). The direction doesn't need to be normalized.
+inline RT_HOSTDEVICE unsigned int cubemapFace(optix::float3 const& d, float& a, float& b)
+{
+  const float x = fabsf(d.x);
+  const float y = fabsf(d.y);
+  const float z = fabsf(d.z);
+
+  if (y <= x && z <= x)
+  {
+    a = ((0.0f <= d.x) ? -d.z : d.z) / x;
+    b = -d.y / x;
+    return (0.0f <= d.x) ? 0 : 1;
+  }
+  if (z <= y)
+  {
+    a = d.x / y;
+    b = ((0.0f <= d.y) ? d.z : -d.z) / y;
+    return (0.0f <= d.y) ? 2 : 3;
+  }
+  a = ((0.0f <= d.z) ? d.x : -d.x) / z;
+  b = -d.y / z;
+  return (0.0f <= d.z) ? 4 : 5;
+}
+
+#endif // CUBEMAP_ENVIRONMENT_H
@@ -0,0 +1,75 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "shader_common.h"
+
+rtBuffer<float4, 2> sysDenoisedBuffer;   // RGBA32F, the current denoiser output.
+rtBuffer<float4, 2> sysDenoisedPrevious; // RGBA32F, the denoiser output of the last comparison. Replaced by the current one.
+rtBuffer<float, 2>  sysDenoisedChange;   // One mean relative change per DENOISER_CHANGE_TILE_SIZE * DENOISER_CHANGE_TILE_SIZE tile.
+
+rtDeclareVariable(uint2, sysResolution, , ); // The rendered sub-rectangle of the buffers.
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+// 2D launch over the tiles. The host only reads back the small per tile result and stops the accumulation
+// when the largest change is below the threshold. Averaging over the tile ignores single flickering pixels.
+RT_PROGRAM void denoiser_change()
+{
+  const uint2 screen = sysResolution;
+  const uint2 origin = theLaunchIndex * DENOISER_CHANGE_TILE_SIZE;
+  const uint2 end    = make_uint2(min(origin.x + DENOISER_CHANGE_TILE_SIZE, screen.x),
+                                  min(origin.y + DENOISER_CHANGE_TILE_SIZE, screen.y));
+
+  float sum = 0.0f;
+
+  for (unsigned int y = origin.y; y < end.y; ++y)
+  {
+    for (unsigned int x = origin.x; x < end.x; ++x)
+    {
+      const uint2 pixel = make_uint2(x, y);
+
+      const float4 current  = sysDenoisedBuffer[pixel];
+      const float  previous = intensity(make_float3(sysDenoisedPrevious[pixel]));
+
+      // Relative change of the pixel intensity. The offset keeps noise in very dark pixels from dominating.
+      sum += fabsf(intensity(make_float3(current)) - previous) / (previous + 0.01f);
+
+      sysDenoisedPrevious[pixel] = current;
+    }
+  }
+
+  const float pixels = float((end.x - origin.x) * (end.y - origin.y));
+
+  sysDenoisedChange[theLaunchIndex] = sum / pixels;
+}
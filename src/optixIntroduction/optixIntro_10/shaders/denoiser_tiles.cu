@@ -0,0 +1,135 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+
+rtBuffer<float4, 2> sysOutputBuffer;   // RGBA32F, the noisy denoiser input.
+#if USE_DENOISER_ALBEDO
+rtBuffer<float4, 2> sysAlbedoBuffer;   // RGBA32F
+#if USE_DENOISER_NORMAL
+rtBuffer<float4, 2> sysNormalBuffer;   // xyz0
+#endif
+#endif
+rtBuffer<float4, 2> sysDenoisedBuffer; // RGBA32F, the assembled denoiser output.
+
+// The tile sized inputs and output of the tile denoiser stage. Their size is sysDenoiserTileSize + 2 * DENOISER_TILE_OVERLAP.
+rtBuffer<float4, 2> sysDenoiserTileInput;
+#if USE_DENOISER_ALBEDO
+rtBuffer<float4, 2> sysDenoiserTileAlbedo;
+#if USE_DENOISER_NORMAL
+rtBuffer<float4, 2> sysDenoiserTileNormal;
+#endif
+#endif
+rtBuffer<float4, 2> sysDenoiserTileOutput;
+
+rtDeclareVariable(int,   sysDenoiserTileSize, , );  // Edge length of the tiles without the overlap.
+rtDeclareVariable(int2,  sysDenoiserTileIndex, , ); // Column and row of the current tile.
+rtDeclareVariable(uint2, sysResolution, , );        // The rendered sub-rectangle of the buffers.
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+// Image coordinates of the tile buffer pixel. Negative or beyond the resolution inside the overlap of border tiles.
+RT_FUNCTION int2 getTilePixel()
+{
+  return make_int2(sysDenoiserTileIndex.x * sysDenoiserTileSize - DENOISER_TILE_OVERLAP + int(theLaunchIndex.x),
+                   sysDenoiserTileIndex.y * sysDenoiserTileSize - DENOISER_TILE_OVERLAP + int(theLaunchIndex.y));
+}
+
+// Linear ramps over the 2 * DENOISER_TILE_OVERLAP pixels around each inner tile edge along one axis.
+// The ramps of the two tiles at an edge sum to one, so the weighted tiles add up to the full image.
+RT_FUNCTION float getTileWeight(const int x, const int tile, const int extent)
+{
+  const float center = float(x) + 0.5f;
+  const float width  = float(2 * DENOISER_TILE_OVERLAP);
+
+  const int begin = tile * sysDenoiserTileSize;
+  const int end   = begin + sysDenoiserTileSize;
+
+  float weight = 1.0f;
+  if (0 < tile)
+  {
+    weight = fminf(weight, optix::clamp((center - float(begin - DENOISER_TILE_OVERLAP)) / width, 0.0f, 1.0f));
+  }
+  if (end < extent)
+  {
+    weight = fminf(weight, optix::clamp((float(end + DENOISER_TILE_OVERLAP) - center) / width, 0.0f, 1.0f));
+  }
+  return weight;
+}
+
+// The overlap of the border tiles repeats the edge pixels of the image.
+RT_PROGRAM void denoiser_tile_gather()
+{
+  const int2 p = getTilePixel();
+
+  const uint2 pixel = make_uint2(optix::clamp(p.x, 0, int(sysResolution.x) - 1),
+                                 optix::clamp(p.y, 0, int(sysResolution.y) - 1));
+
+  sysDenoiserTileInput[theLaunchIndex] = sysOutputBuffer[pixel];
+#if USE_DENOISER_ALBEDO
+  sysDenoiserTileAlbedo[theLaunchIndex] = sysAlbedoBuffer[pixel];
+#if USE_DENOISER_NORMAL
+  sysDenoiserTileNormal[theLaunchIndex] = sysNormalBuffer[pixel];
+#endif
+#endif
+}
+
+// The tiles are processed in rows from the first to the last. The first tile which covers a pixel
+// overwrites its previous content, the following ones add their share.
+RT_PROGRAM void denoiser_tile_scatter()
+{
+  const int2 p = getTilePixel();
+  if (p.x < 0 || p.y < 0 || int(sysResolution.x) <= p.x || int(sysResolution.y) <= p.y)
+  {
+    return;
+  }
+
+  const float weight = getTileWeight(p.x, sysDenoiserTileIndex.x, int(sysResolution.x)) *
+                       getTileWeight(p.y, sysDenoiserTileIndex.y, int(sysResolution.y));
+
+  const float4 value = sysDenoiserTileOutput[theLaunchIndex] * weight;
+
+  const uint2 pixel = make_uint2(p.x, p.y);
+
+  const int2 first = make_int2(max(0, (p.x - DENOISER_TILE_OVERLAP) / sysDenoiserTileSize),
+                               max(0, (p.y - DENOISER_TILE_OVERLAP) / sysDenoiserTileSize));
+
+  if (first.x == sysDenoiserTileIndex.x && first.y == sysDenoiserTileIndex.y)
+  {
+    sysDenoisedBuffer[pixel] = value;
+  }
+  else
+  {
+    sysDenoisedBuffer[pixel] += value;
+  }
+}
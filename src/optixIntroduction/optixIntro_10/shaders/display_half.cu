@@ -0,0 +1,58 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include <cuda_fp16.h>
+
+#include "rt_function.h"
+
+rtBuffer<float4, 2>  sysDisplaySource;     // RGBA32F, either the denoised or the noisy accumulated image.
+rtBuffer<ushort4, 2> sysDisplayHalfBuffer; // RT_FORMAT_HALF4, half the size of the RGBA32F image for the host transfer.
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+// Largest finite half value. Bigger values would turn into infinity.
+#define HALF_MAX 65504.0f
+
+RT_FUNCTION unsigned short floatToHalf(const float f)
+{
+  return __half_as_ushort(__float2half_rn(fminf(f, HALF_MAX)));
+}
+
+// 2D launch over the full resolution. Converts the HDR image to RGBA16F right before it gets mapped and uploaded.
+// The accumulation itself stays in full precision. The GLSL tonemapper works on the half texture the same way.
+RT_PROGRAM void display_half()
+{
+  const float4 color = sysDisplaySource[theLaunchIndex];
+
+  sysDisplayHalfBuffer[theLaunchIndex] = make_ushort4(floatToHalf(color.x), floatToHalf(color.y), floatToHalf(color.z), floatToHalf(1.0f));
+}
@@ -0,0 +1,92 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+
+rtBuffer<float4, 2> sysEncodeSource; // RGBA32F, either the denoised or the noisy accumulated image.
+rtBuffer<uchar4, 2> sysEncodeBuffer; // RGBA8 image which is read back and compressed for the render server clients.
+rtBuffer<uchar4, 2> sysTonemapBuffer; // BGRA8 image for the display upload and the LDR screenshots, the sutil RT_FORMAT_UNSIGNED_BYTE4 layout.
+
+// The same tonemapper parameters as the uniforms of the GLSL display shader.
+rtDeclareVariable(float3, sysColorBalance, , );
+rtDeclareVariable(float,  sysInvWhitePoint, , );
+rtDeclareVariable(float,  sysBurnHighlights, , );
+rtDeclareVariable(float,  sysSaturation, , );
+rtDeclareVariable(float,  sysCrushBlacks, , );
+rtDeclareVariable(float,  sysInvGamma, , );
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+rtDeclareVariable(uint2, theLaunchDim,   rtLaunchDim, );
+
+RT_FUNCTION unsigned char floatToUnorm8(const float f)
+{
+  return (unsigned char) (optix::clamp(f, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Exactly the tonemapper of the GLSL display shader.
+RT_FUNCTION float3 tonemap(const float3 hdrColor)
+{
+  float3 ldrColor = sysInvWhitePoint * sysColorBalance * hdrColor;
+  ldrColor *= (ldrColor * sysBurnHighlights + 1.0f) / (ldrColor + 1.0f);
+  
+  float luminance = optix::dot(ldrColor, make_float3(0.3f, 0.59f, 0.11f));
+  ldrColor = optix::fmaxf(optix::lerp(make_float3(luminance), ldrColor, sysSaturation), make_float3(0.0f));
+  
+  luminance = optix::dot(ldrColor, make_float3(0.3f, 0.59f, 0.11f));
+  if (luminance < 1.0f)
+  {
+    const float3 crushed = make_float3(powf(ldrColor.x, sysCrushBlacks), powf(ldrColor.y, sysCrushBlacks), powf(ldrColor.z, sysCrushBlacks));
+    ldrColor = optix::fmaxf(optix::lerp(crushed, ldrColor, sqrtf(luminance)), make_float3(0.0f));
+  }
+  return make_float3(powf(ldrColor.x, sysInvGamma), powf(ldrColor.y, sysInvGamma), powf(ldrColor.z, sysInvGamma));
+}
+
+// 2D launch over the full resolution. Tonemaps the HDR image and flips it vertically,
+// because image files and video streams store the top row first.
+// Only a quarter of the RGBA32F data needs to be read back then.
+RT_PROGRAM void encode_rgba8()
+{
+  const float3 ldrColor = tonemap(make_float3(sysEncodeSource[theLaunchIndex]));
+
+  const uint2 index = make_uint2(theLaunchIndex.x, theLaunchDim.y - 1 - theLaunchIndex.y);
+
+  sysEncodeBuffer[index] = make_uchar4(floatToUnorm8(ldrColor.x), floatToUnorm8(ldrColor.y), floatToUnorm8(ldrColor.z), 255);
+}
+
+// 2D launch over the full resolution. Same tonemapper without the flip, the rows stay in OpenGL texture order.
+RT_PROGRAM void tonemap_bgra8()
+{
+  const float3 ldrColor = tonemap(make_float3(sysEncodeSource[theLaunchIndex]));
+
+  sysTonemapBuffer[theLaunchIndex] = make_uchar4(floatToUnorm8(ldrColor.z), floatToUnorm8(ldrColor.y), floatToUnorm8(ldrColor.x), 255);
+}
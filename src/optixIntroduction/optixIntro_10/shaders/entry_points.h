@@ -0,0 +1,118 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef ENTRY_POINTS_H
+#define ENTRY_POINTS_H
+
+#include "app_config.h"
+
+// Indices of the OptiX entry points used by the renderer.
+// Optional features append their entry points only when they are compiled in.
+enum EntryPoint
+{
+  ENTRY_RENDER = 0, // The megakernel path tracer raygeneration().
+#if USE_WAVEFRONT
+  ENTRY_WAVEFRONT_GENERATE, // Primary rays for all pixels into the path queue.
+  ENTRY_WAVEFRONT_EXTEND,   // One path segment for all live paths in the current queue.
+  ENTRY_WAVEFRONT_RESOLVE,  // Accumulate the per-iteration radiance into sysOutputBuffer.
+#if USE_WAVEFRONT_SORT
+  ENTRY_WAVEFRONT_SORT,     // Scatter the output queue sorted by key into the input queue.
+#endif
+#endif
+#if USE_ADAPTIVE_SAMPLING
+  ENTRY_RENDER_ADAPTIVE, // The megakernel path tracer over the unconverged tiles only.
+  ENTRY_CONVERGENCE,     // Error estimate per tile.
+#endif
+#if USE_TILED_LAUNCH
+  ENTRY_RENDER_TILE, // The megakernel path tracer over one sub-rectangle at sysTileOffset.
+#endif
+#if USE_PERSISTENT_THREADS
+  ENTRY_RENDER_PERSISTENT, // The megakernel path tracer with persistent threads pulling pixels from sysPersistentCounter.
+#endif
+#if USE_MORTON_LAUNCH
+  ENTRY_RENDER_MORTON, // The megakernel path tracer in a 1D launch over the pixels in Morton order per tile.
+#endif
+#if USE_LIGHT_BAKE
+  ENTRY_RENDER_BAKE, // The megakernel path tracer over the lightmap texels in sysBakePositions.
+#endif
+#if USE_MULTI_VIEW
+  ENTRY_RENDER_VIEWS, // The megakernel path tracer over all sysViews in one 3D launch.
+  ENTRY_RENDER_WEDGE, // The megakernel path tracer over all material variants in one 3D launch into sysWedgeBuffer.
+  ENTRY_WEDGE_SELECT, // Copy the displayed variant of sysWedgeBuffer into sysOutputBuffer.
+#endif
+#if USE_PREVIEW_RESOLUTION
+  ENTRY_RENDER_PREVIEW, // The megakernel path tracer into the reduced resolution sysOutputBuffer on its program scope.
+#endif
+#if USE_REPROJECTION
+  ENTRY_REPROJECT_STORE, // Copy the accumulation into the history buffers.
+  ENTRY_REPROJECT,       // Warp the history buffers into the current camera view.
+#endif
+#if USE_GPU_LOCAL_ACCUMULATION
+  ENTRY_RESOLVE, // Copy the per-device accumulation buffers into the shared output buffers.
+  ENTRY_RESTORE, // Copy the shared output buffers back into the per-device accumulation buffers after loading a checkpoint.
+#endif
+#if USE_DENOISER && USE_DENOISER_ALBEDO && USE_DENOISER_GBUFFER
+  ENTRY_DENOISER_GBUFFER, // Accumulate the denoiser guide buffers during the first DENOISER_GBUFFER_ITERATIONS iterations.
+#endif
+#if USE_DENOISER && USE_DENOISER_TILES
+  ENTRY_DENOISER_TILE_GATHER,  // Copy one tile and its overlap of the denoiser inputs into the tile buffers.
+  ENTRY_DENOISER_TILE_SCATTER, // Cross-fade the denoised tile into sysDenoisedBuffer.
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+  ENTRY_DENOISER_CHANGE, // Mean relative change per tile between two denoiser results.
+#endif
+#if USE_INCREMENTAL_MATERIALS
+  ENTRY_MATERIAL_UPDATE, // Scatter the staged MaterialUpdates into sysMaterialParameters.
+#endif
+#if USE_HALF_DISPLAY
+  ENTRY_DISPLAY_HALF, // Convert the displayed RGBA32F image into the RGBA16F sysDisplayHalfBuffer.
+#endif
+#if USE_RENDER_SERVER
+  ENTRY_ENCODE_RGBA8, // Tonemap the RGBA32F image into the RGBA8 sysEncodeBuffer, top row first.
+#endif
+#if USE_DEVICE_TONEMAP
+  ENTRY_TONEMAP, // Tonemap the RGBA32F image into the BGRA8 sysTonemapBuffer, bottom row first like the OpenGL texture.
+#endif
+#if USE_GPU_ENVIRONMENT_CDF
+  ENTRY_ENVIRONMENT_FUNCTION, // Filtered and sin(theta) weighted texel function of the spherical environment light.
+  ENTRY_ENVIRONMENT_ROWS,     // Normalized row CDFs.
+  ENTRY_ENVIRONMENT_MARGINAL, // Normalized marginal CDF and the environment integral.
+#endif
+#if USE_GPU_MIPMAPS
+  ENTRY_MIPMAP_LEVEL,  // Box filter the previous mipmap level into the next one inside sysMipmapTexels.
+  ENTRY_MIPMAP_ENCODE, // Convert the linear sysMipmapTexels to sRGB for textures with sRGB read mode.
+#endif
+#if USE_RADIANCE_CACHE
+  ENTRY_RADIANCE_CACHE, // Blend the radiance samples of the iteration into the cache cells, or clear them.
+#endif
+  NUMBER_OF_ENTRY_POINTS
+};
+
+#endif // ENTRY_POINTS_H
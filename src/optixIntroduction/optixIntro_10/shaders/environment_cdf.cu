@@ -0,0 +1,138 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+
+// Device side construction of the spherical environment light sampling distribution.
+// The same textbook CDFs as the host implementation in Texture::calculateCDF(), in three launches.
+rtBuffer<float4, 2> sysEnvironmentTexels;   // width x height RGBA32F, the buffer behind the environment texture sampler.
+rtBuffer<float, 2>  sysEnvironmentFunction; // width x height, filtered intensity scaled by sin(theta).
+rtBuffer<float, 2>  sysEnvironmentCDF_U;    // (width + 1) x height, normalized rows.
+rtBuffer<float, 1>  sysEnvironmentCDF_V;    // height + 1, normalized marginal.
+rtBuffer<float, 1>  sysEnvironmentSums;     // height + 1, unfiltered row integrals, the last element receives the overall integral.
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+RT_FUNCTION float texelIntensity(const unsigned int x, const unsigned int y)
+{
+  const float4 p = sysEnvironmentTexels[make_uint2(x, y)];
+  return p.x + p.y + p.z;
+}
+
+// 2D launch over all texels. Same 3x3 Gaussian filter with sigma = 0.5 as gaussianFilter() on the host.
+RT_PROGRAM void environment_function()
+{
+  const unsigned int width  = static_cast<unsigned int>(sysEnvironmentTexels.size().x);
+  const unsigned int height = static_cast<unsigned int>(sysEnvironmentTexels.size().y);
+
+  const unsigned int x = theLaunchIndex.x;
+  const unsigned int y = theLaunchIndex.y;
+
+  // Lookup is repeated in x and clamped to edge in y.
+  const unsigned int left   = (0 < x)          ? x - 1 : width - 1; // repeat
+  const unsigned int right  = (x < width - 1)  ? x + 1 : 0;         // repeat
+  const unsigned int bottom = (0 < y)          ? y - 1 : y;         // clamp
+  const unsigned int top    = (y < height - 1) ? y + 1 : y;         // clamp
+
+  float intensity = texelIntensity(x, y) * 0.619347f;
+
+  intensity += (texelIntensity(x, bottom) + texelIntensity(left, y) + texelIntensity(right, y) + texelIntensity(x, top)) * 0.0838195f;
+
+  intensity += (texelIntensity(left, bottom) + texelIntensity(right, bottom) + texelIntensity(left, top) + texelIntensity(right, top)) * 0.0113437f;
+
+  // Scale distibution by the sine to get the sampling uniform. (Avoid sampling more values near the poles.)
+  const float sinTheta = sinf(M_PIf * (float(y) + 0.5f) / float(height));
+
+  sysEnvironmentFunction[theLaunchIndex] = intensity / 3.0f * sinTheta;
+}
+
+// 1 x height launch. One thread per row builds the normalized row CDF
+// and stores the row integral as function value of the marginal CDF.
+RT_PROGRAM void environment_rows()
+{
+  const unsigned int width  = static_cast<unsigned int>(sysEnvironmentFunction.size().x);
+  const unsigned int height = static_cast<unsigned int>(sysEnvironmentFunction.size().y);
+
+  const unsigned int y = theLaunchIndex.y;
+
+  const float sinTheta = sinf(M_PIf * (float(y) + 0.5f) / float(height));
+
+  float cdf = 0.0f;
+  float sum = 0.0f;
+
+  sysEnvironmentCDF_U[make_uint2(0, y)] = 0.0f; // CDF starts at 0.0f.
+  for (unsigned int x = 0; x < width; ++x)
+  {
+    cdf += sysEnvironmentFunction[make_uint2(x, y)];
+    sysEnvironmentCDF_U[make_uint2(x + 1, y)] = cdf;
+
+    sum += texelIntensity(x, y) / 3.0f * sinTheta; // The integral over the actual function.
+  }
+
+  // Normalize, or generate an equal distribution when all texels were black in this row.
+  for (unsigned int x = 1; x <= width; ++x)
+  {
+    const uint2 index = make_uint2(x, y);
+    sysEnvironmentCDF_U[index] = (cdf != 0.0f) ? sysEnvironmentCDF_U[index] / cdf : float(x) / float(width);
+  }
+
+  sysEnvironmentCDF_V[y + 1] = cdf; // Function value of the marginal CDF, integrated in environment_marginal().
+  sysEnvironmentSums[y]      = sum;
+}
+
+// 1 x 1 launch. Integrates the marginal CDF and the overall environment integral.
+RT_PROGRAM void environment_marginal()
+{
+  const unsigned int width  = static_cast<unsigned int>(sysEnvironmentFunction.size().x);
+  const unsigned int height = static_cast<unsigned int>(sysEnvironmentFunction.size().y);
+
+  float cdf = 0.0f;
+  float sum = 0.0f;
+
+  sysEnvironmentCDF_V[0] = 0.0f; // CDF starts at 0.0f.
+  for (unsigned int y = 1; y <= height; ++y)
+  {
+    cdf += sysEnvironmentCDF_V[y];
+    sysEnvironmentCDF_V[y] = cdf;
+
+    sum += sysEnvironmentSums[y - 1];
+  }
+
+  for (unsigned int y = 1; y <= height; ++y)
+  {
+    sysEnvironmentCDF_V[y] = (cdf != 0.0f) ? sysEnvironmentCDF_V[y] / cdf : float(y) / float(height);
+  }
+
+  // This integral is used inside the light sampling function (see LightDefinition::environmentIntegral).
+  sysEnvironmentSums[height] = sum * 2.0f * M_PIf * M_PIf / float(width * height);
+}
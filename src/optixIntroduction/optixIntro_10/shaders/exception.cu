@@ -35,8 +35,19 @@ rtBuffer<float4,  2> sysOutputBuffer; // RGBA32F
 
 rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
 
+#if USE_STACK_CALIBRATION
+rtBuffer<unsigned int> sysStackOverflows; // One counter, read back by the stack size probes. Only reached while RT_EXCEPTION_STACK_OVERFLOW is enabled.
+#endif
+
 RT_PROGRAM void exception()
 {
+#if USE_STACK_CALIBRATION
+  if (rtGetExceptionCode() == RT_EXCEPTION_STACK_OVERFLOW)
+  {
+    atomicAdd(&sysStackOverflows[0], 1u);
+  }
+#endif
+
 #if USE_DEBUG_EXCEPTIONS
   const unsigned int code = rtGetExceptionCode();
   if (RT_EXCEPTION_USER <= code)
@@ -0,0 +1,197 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+#include "shader_common.h"
+#include "lens_shader.h"
+#include "lens_shader_type.h"
+#include "sampler.h"
+
+rtBuffer<float4, 2> sysAlbedoBuffer; // RGBA32F
+#if USE_DENOISER_NORMAL
+rtBuffer<float4, 2> sysNormalBuffer; // xyz0
+#endif
+
+rtDeclareVariable(float3, sysCameraPosition, , );
+rtDeclareVariable(float3, sysCameraU, , );
+rtDeclareVariable(float3, sysCameraV, , );
+rtDeclareVariable(float3, sysCameraW, , );
+
+rtDeclareVariable(rtObject, sysTopObject, , );
+rtDeclareVariable(float,    sysSceneEpsilon, , );
+rtDeclareVariable(int2,     sysPathLengths, , );
+rtDeclareVariable(int,      sysIterationIndex, , );
+rtDeclareVariable(int,      sysCameraType, , );
+
+// Bindless callable programs implementing different lens shaders.
+rtBuffer< rtCallableProgramId<void(const float2 pixel, const float2 screen, const float2 sample, const float2 aperture, float3& origin, float3& direction)> > sysLensShader;
+
+rtDeclareVariable(uint2, sysResolution, , );
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+// 2D launch over the full resolution. Only runs during the first DENOISER_GBUFFER_ITERATIONS iterations after a restart.
+// Follows the primary ray through the specular events to the first diffuse or light hit, which is where integrator() would
+// have written the albedo, and accumulates the same albedo and camera space normal. No radiance, no Russian Roulette.
+// The path tracer doesn't touch the guide buffers then, they stay frozen for the rest of the accumulation.
+RT_PROGRAM void gbuffer()
+{
+  const uint2 pixel  = theLaunchIndex;
+  const uint2 screen = sysResolution;
+
+  PerRayData prd;
+
+  // The same lens samples as the path tracer, so that the guide buffers are antialiased like the beauty image.
+  initSampler(prd, pixel.y * screen.x + pixel.x, sysIterationIndex);
+
+  float3 direction;
+#if USE_PINHOLE_FAST_PATH
+  if (sysCameraType == LENS_SHADER_PINHOLE)
+  {
+    prd.pos   = sysCameraPosition;
+    direction = optix::normalize(pinholeDirection(make_float2(pixel), make_float2(screen), sample2D(prd, SAMPLE_LENS), sysCameraU, sysCameraV, sysCameraW));
+  }
+  else
+#endif
+  {
+    sysLensShader[sysCameraType](make_float2(pixel), make_float2(screen), sample2D(prd, SAMPLE_LENS), sample2D(prd, SAMPLE_APERTURE), prd.pos, direction);
+  }
+  setWi(prd, direction);
+#if USE_RAY_CONES
+  setCone(prd, make_float2(0.0f, pixelSpreadAngle(sysCameraType, make_float2(screen), sysCameraV, sysCameraW)));
+#endif
+
+  // The IORs of the nested volumes are needed to refract correctly. Absorption is ignored, the albedo is clamped anyway.
+  float iorStack[MATERIAL_STACK_SIZE];
+  int   stackIdx = MATERIAL_STACK_EMPTY;
+
+  float3 throughput = make_float3(1.0f);
+  float3 albedo     = make_float3(0.0f);
+#if USE_DENOISER_NORMAL
+  float3 normal     = make_float3(0.0f);
+#if !USE_COMPACT_PAYLOAD
+  prd.normal = make_float3(0.0f);
+#endif
+#endif
+
+  prd.absorption_ior = make_float4(0.0f, 0.0f, 0.0f, 1.0f);
+  prd.flags          = 0;
+
+  int depth = 0;
+  while (depth < sysPathLengths.y)
+  {
+    setSamplerBounce(prd, depth);
+
+#if !USE_COMPACT_PAYLOAD
+    prd.wo        = -prd.wi;
+#endif
+    prd.ior       = make_float2(1.0f);
+    prd.distance  = RT_DEFAULT_MAX;
+    prd.flags    &= FLAG_CLEAR_MASK;
+
+    if (MATERIAL_STACK_FIRST <= stackIdx)
+    {
+      prd.ior.x = iorStack[stackIdx];
+      if (MATERIAL_STACK_FIRST <= stackIdx - 1)
+      {
+        prd.ior.y = iorStack[stackIdx - 1];
+      }
+    }
+
+    optix::Ray ray = optix::make_Ray(prd.pos, getWi(prd), 0, sysSceneEpsilon, prd.distance);
+    rtTrace(sysTopObject, ray, 0.5f, prd); // Middle of the shutter interval.
+
+#if USE_DENOISER_NORMAL
+    if (depth == 0 && (prd.flags & FLAG_HIT))
+    {
+      const float3 normalWorld = getNormal(prd);
+
+      normal = make_float3( optix::dot(normalWorld, optix::normalize(sysCameraU)),
+                            optix::dot(normalWorld, optix::normalize(sysCameraV)),
+                           -optix::dot(normalWorld, optix::normalize(sysCameraW))); // Negative W to make it right-handed.
+    }
+#endif
+
+    if (prd.flags & (FLAG_DIFFUSE | FLAG_LIGHT))
+    {
+      albedo = optix::clamp(throughput * getAlbedo(prd), 0.0f, 1.0f);
+      break;
+    }
+
+    if ((prd.flags & FLAG_TERMINATE) || prd.pdf <= 0.0f || isNull(prd.f_over_pdf))
+    {
+      break;
+    }
+
+    throughput *= prd.f_over_pdf;
+
+    if ((prd.flags & (FLAG_THINWALLED | FLAG_TRANSMISSION)) == FLAG_TRANSMISSION)
+    {
+      if (prd.flags & FLAG_FRONTFACE)
+      {
+        stackIdx = min(stackIdx + 1, MATERIAL_STACK_LAST);
+        iorStack[stackIdx] = prd.absorption_ior.w;
+      }
+      else
+      {
+        stackIdx = max(stackIdx - 1, MATERIAL_STACK_EMPTY);
+      }
+    }
+
+    ++depth;
+  }
+
+  if (0 < sysIterationIndex)
+  {
+    const float t = 1.0f / float(sysIterationIndex + 1);
+
+    float3 dst = make_float3(sysAlbedoBuffer[pixel]);
+    sysAlbedoBuffer[pixel] = make_float4(optix::lerp(dst, albedo, t), 1.0f);
+#if USE_DENOISER_NORMAL
+    dst = optix::lerp(make_float3(sysNormalBuffer[pixel]), normal, t);
+    if (isNotNull(dst))
+    {
+      dst = optix::normalize(dst);
+    }
+    sysNormalBuffer[pixel] = make_float4(dst, 0.0f);
+#endif
+  }
+  else
+  {
+    sysAlbedoBuffer[pixel] = make_float4(albedo, 1.0f);
+#if USE_DENOISER_NORMAL
+    sysNormalBuffer[pixel] = make_float4(normal, 0.0f);
+#endif
+  }
+}
@@ -0,0 +1,63 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#ifndef GEOMETRY_PAGING_H
+#define GEOMETRY_PAGING_H
+
+#include "app_config.h"
+
+#include <optix.h>
+
+#include "rt_function.h"
+
+#if USE_GEOMETRY_PAGING
+// One element per mesh page, read back and cleared by the host in updateGeometryPaging().
+// .x = Number of rays which hit the bounding box proxy of the non-resident page.
+// .y = Not zero when a radiance ray hit the resident page since the last read back.
+rtBuffer<uint2> sysPageCounters;
+
+// Index into sysPageCounters on the GeometryInstances of paged meshes. The context default is -1 for all other geometry.
+rtDeclareVariable(int, parPageIndex, , );
+
+// A plain store is enough, the host only needs to know that the page has been used.
+RT_FUNCTION void recordPageHit()
+{
+  if (0 <= parPageIndex)
+  {
+    sysPageCounters[parPageIndex].y = 1;
+  }
+}
+
+RT_FUNCTION void recordPageRequest()
+{
+  atomicAdd(&sysPageCounters[parPageIndex].x, 1u);
+}
+#endif
+
+#endif // GEOMETRY_PAGING_H
@@ -32,8 +32,14 @@
 #include <optixu/optixu_math_namespace.h>
 
 #include "vertex_attributes.h"
+#include "compact_attributes.h"
 
+#if USE_COMPACT_ATTRIBUTES
+rtBuffer<float3>                  positionsBuffer;
+rtBuffer<VertexAttributesCompact> attributesBuffer;
+#else
 rtBuffer<VertexAttributes> attributesBuffer;
+#endif
 rtBuffer<uint3>            indicesBuffer;
 
 // Attributes.
@@ -41,6 +47,9 @@ rtDeclareVariable(optix::float3, varGeoNormal, attribute GEO_NORMAL, );
 rtDeclareVariable(optix::float3, varTangent,   attribute TANGENT, );
 rtDeclareVariable(optix::float3, varNormal,    attribute NORMAL, ); 
 rtDeclareVariable(optix::float3, varTexCoord,  attribute TEXCOORD, ); 
+#if USE_CUTOUT_CLASSIFICATION
+rtDeclareVariable(unsigned int,  varPrimitiveIndex, attribute PRIMITIVE_INDEX, ); // The anyhit programs look up the cutout state with it.
+#endif
 
 rtDeclareVariable(optix::Ray, theRay, rtCurrentRay, );
 
@@ -49,6 +58,11 @@ RT_PROGRAM void intersection_triangle_indexed(int primitiveIndex)
 {
   const uint3 indices = indicesBuffer[primitiveIndex];
 
+#if USE_COMPACT_ATTRIBUTES
+  const float3 v0 = positionsBuffer[indices.x];
+  const float3 v1 = positionsBuffer[indices.y];
+  const float3 v2 = positionsBuffer[indices.z];
+#else
   VertexAttributes const& a0 = attributesBuffer[indices.x];
   VertexAttributes const& a1 = attributesBuffer[indices.y];
   VertexAttributes const& a2 = attributesBuffer[indices.z];
@@ -56,6 +70,7 @@ RT_PROGRAM void intersection_triangle_indexed(int primitiveIndex)
   const float3 v0 = a0.vertex;
   const float3 v1 = a1.vertex;
   const float3 v2 = a2.vertex;
+#endif
 
   float3 n;
   float  t;
@@ -72,9 +87,35 @@ RT_PROGRAM void intersection_triangle_indexed(int primitiveIndex)
       // Note: No normalization on the TBN attributes here for performance reasons.
       //       It's done after the transformation into world space anyway.
       varGeoNormal      = n;
+#if USE_COMPACT_ATTRIBUTES
+      // Only fetch and decode the attributes of potential hits.
+      VertexAttributesCompact const& a0 = attributesBuffer[indices.x];
+      VertexAttributesCompact const& a1 = attributesBuffer[indices.y];
+      VertexAttributesCompact const& a2 = attributesBuffer[indices.z];
+
+      varTangent        = decodeOctahedral(a0.tangent) * alpha + decodeOctahedral(a1.tangent) * beta + decodeOctahedral(a2.tangent) * gamma;
+      varNormal         = decodeOctahedral(a0.normal)  * alpha + decodeOctahedral(a1.normal)  * beta + decodeOctahedral(a2.normal)  * gamma;
+#if USE_RAY_CONES
+      const float3 t0 = decodeTexcoord(a0.texcoord);
+      const float3 t1 = decodeTexcoord(a1.texcoord);
+      const float3 t2 = decodeTexcoord(a2.texcoord);
+
+      varTexCoord       = t0 * alpha + t1 * beta + t2 * gamma;
+      varTexCoord.z     = getTriangleLod(t0, t1, t2, n);
+#else
+      varTexCoord       = decodeTexcoord(a0.texcoord)  * alpha + decodeTexcoord(a1.texcoord)  * beta + decodeTexcoord(a2.texcoord)  * gamma;
+#endif
+#else
       varTangent        = a0.tangent  * alpha + a1.tangent  * beta + a2.tangent  * gamma;
       varNormal         = a0.normal   * alpha + a1.normal   * beta + a2.normal   * gamma;
       varTexCoord       = a0.texcoord * alpha + a1.texcoord * beta + a2.texcoord * gamma;
+#if USE_RAY_CONES
+      varTexCoord.z     = getTriangleLod(a0.texcoord, a1.texcoord, a2.texcoord, n);
+#endif
+#endif
+#if USE_CUTOUT_CLASSIFICATION
+      varPrimitiveIndex = primitiveIndex;
+#endif
       
       rtReportIntersection(0);
     }
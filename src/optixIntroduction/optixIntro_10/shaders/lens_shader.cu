@@ -33,6 +33,8 @@
 
 #include "rt_function.h"
 #include "per_ray_data.h"
+#include "lens_shader.h"
+#include "lens_shader_type.h"
 #include "rt_assert.h"
 
 rtDeclareVariable(float3, sysCameraPosition, , );
@@ -40,23 +42,28 @@ rtDeclareVariable(float3, sysCameraU, , );
 rtDeclareVariable(float3, sysCameraV, , );
 rtDeclareVariable(float3, sysCameraW, , );
 
+// Thin lens parameters. The focus plane is the plane through the camera's center of interest.
+rtDeclareVariable(float, sysLensRadius, , );     // Aperture radius in world units. 0.0f is a pinhole.
+rtDeclareVariable(float, sysFocusDistance, , );  // Distance of the focus plane along the unit length sysCameraW.
+
+// Precomputed aperture points in the range [-1, 1]^2 for the current bokeh shape.
+rtBuffer<float2, 2> sysApertureTable; // (APERTURE_TABLE_SIZE + 1)^2 grid vertices.
+
 rtDeclareVariable(uint2, theLaunchDim,   rtLaunchDim, );
 rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
 
 // Note that all these lens shaders return the primary ray in origin and direction in world space!
+// The aperture sample is only used by the thin lens.
 
-RT_CALLABLE_PROGRAM void lens_shader_pinhole(const float2 pixel, const float2 screen, const float2 sample,
+RT_CALLABLE_PROGRAM void lens_shader_pinhole(const float2 pixel, const float2 screen, const float2 sample, const float2 aperture,
                                              float3& origin, float3& direction)
 {
-  const float2 fragment = pixel + sample;                    // Jitter the sub-pixel location
-  const float2 ndc      = (fragment / screen) * 2.0f - 1.0f; // Normalized device coordinates in range [-1, 1].
-
   origin    = sysCameraPosition;
-  direction = optix::normalize(ndc.x * sysCameraU + ndc.y * sysCameraV + sysCameraW);
+  direction = optix::normalize(pinholeDirection(pixel, screen, sample, sysCameraU, sysCameraV, sysCameraW));
 }
 
 
-RT_CALLABLE_PROGRAM void lens_shader_fisheye(const float2 pixel, const float2 screen, const float2 sample,
+RT_CALLABLE_PROGRAM void lens_shader_fisheye(const float2 pixel, const float2 screen, const float2 sample, const float2 aperture,
                                              float3& origin, float3& direction)
 {
   const float2 fragment = pixel + sample; // x, y
@@ -74,7 +81,7 @@ RT_CALLABLE_PROGRAM void lens_shader_fisheye(const float2 pixel, const float2 sc
   direction = optix::normalize(uv.x * U + uv.y * V + z * W);
 }
 
-RT_CALLABLE_PROGRAM void lens_shader_sphere(const float2 pixel, const float2 screen, const float2 sample,
+RT_CALLABLE_PROGRAM void lens_shader_sphere(const float2 pixel, const float2 screen, const float2 sample, const float2 aperture,
                                             float3& origin, float3& direction)
 {
   const float2 uv = (pixel + sample) / screen; // "texture coordinates"
@@ -96,3 +103,66 @@ RT_CALLABLE_PROGRAM void lens_shader_sphere(const float2 pixel, const float2 scr
   origin    = sysCameraPosition;
   direction = optix::normalize(v.x * U + v.y * V + v.z * W);
 }
+
+// Renders the six faces of a cube around the camera into the CUBEMAP_FACE_COLUMNS x CUBEMAP_FACE_ROWS grid of the screen.
+// Each face is a 90 degree pinhole projection, which is stretched when the screen aspect ratio isn't 3:2.
+RT_CALLABLE_PROGRAM void lens_shader_cubemap(const float2 pixel, const float2 screen, const float2 sample, const float2 aperture,
+                                             float3& origin, float3& direction)
+{
+  const float2 grid = (pixel + sample) / screen * make_float2(CUBEMAP_FACE_COLUMNS, CUBEMAP_FACE_ROWS);
+
+  const int column = optix::min(static_cast<int>(grid.x), CUBEMAP_FACE_COLUMNS - 1);
+  const int row    = optix::min(static_cast<int>(grid.y), CUBEMAP_FACE_ROWS - 1); // 0 is the bottom row.
+
+  // Position inside the face in the range [-1, 1].
+  const float s = (grid.x - float(column)) * 2.0f - 1.0f;
+  const float t = (grid.y - float(row))    * 2.0f - 1.0f;
+
+  const float3 U = optix::normalize(sysCameraU);
+  const float3 V = optix::normalize(sysCameraV);
+  const float3 W = optix::normalize(sysCameraW);
+
+  float3 d;
+  switch (column + (CUBEMAP_FACE_ROWS - 1 - row) * CUBEMAP_FACE_COLUMNS) // Face index in reading order.
+  {
+    case 0: d =  U + s * -W + t *  V; break; // right
+    case 1: d = -U + s *  W + t *  V; break; // left
+    case 2: d =  V + s *  U + t * -W; break; // up
+    case 3: d = -V + s *  U + t *  W; break; // down
+    case 4: d =  W + s *  U + t *  V; break; // front
+    default: d = -W + s * -U + t * V; break; // back
+  }
+
+  origin    = sysCameraPosition;
+  direction = optix::normalize(d);
+}
+
+// Bilinear interpolation between the four aperture table vertices around the 2D sample.
+// The table maps the stratified unit square continuously onto the bokeh shape, so the sampler's stratification carries over to the aperture.
+RT_FUNCTION float2 sampleAperture(const float2 sample)
+{
+  const float2 st = sample * float(APERTURE_TABLE_SIZE);
+
+  const unsigned int x = optix::min(static_cast<unsigned int>(st.x), APERTURE_TABLE_SIZE - 1u);
+  const unsigned int y = optix::min(static_cast<unsigned int>(st.y), APERTURE_TABLE_SIZE - 1u);
+
+  const float fx = st.x - float(x);
+  const float fy = st.y - float(y);
+
+  const float2 p0 = optix::lerp(sysApertureTable[make_uint2(x, y    )], sysApertureTable[make_uint2(x + 1, y    )], fx);
+  const float2 p1 = optix::lerp(sysApertureTable[make_uint2(x, y + 1)], sysApertureTable[make_uint2(x + 1, y + 1)], fx);
+
+  return optix::lerp(p0, p1, fy);
+}
+
+RT_CALLABLE_PROGRAM void lens_shader_thin_lens(const float2 pixel, const float2 screen, const float2 sample, const float2 aperture,
+                                               float3& origin, float3& direction)
+{
+  // The pinhole direction ends on the plane at distance 1.0f, scaling it by the focus distance lands on the focus plane.
+  const float3 focus = sysCameraPosition + sysFocusDistance * pinholeDirection(pixel, screen, sample, sysCameraU, sysCameraV, sysCameraW);
+
+  const float2 lens = sysLensRadius * sampleAperture(aperture);
+
+  origin    = sysCameraPosition + lens.x * optix::normalize(sysCameraU) + lens.y * optix::normalize(sysCameraV);
+  direction = optix::normalize(focus - origin);
+}
@@ -0,0 +1,70 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef LENS_SHADER_DEVICE_H
+#define LENS_SHADER_DEVICE_H
+
+#include "app_config.h"
+
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "lens_shader_type.h"
+
+// The pinhole projection shared by the lens_shader_pinhole callable and the USE_PINHOLE_FAST_PATH inside the ray generation programs.
+// Returns the unnormalized direction through the jittered sub-pixel location, which ends on the plane at distance 1 along the unit W vector.
+RT_FUNCTION float3 pinholeDirection(const float2 pixel, const float2 screen, const float2 sample,
+                                    const float3& U, const float3& V, const float3& W)
+{
+  const float2 fragment = pixel + sample;                    // Jitter the sub-pixel location
+  const float2 ndc      = (fragment / screen) * 2.0f - 1.0f; // Normalized device coordinates in range [-1, 1].
+
+  return ndc.x * U + ndc.y * V + W;
+}
+
+#if USE_RAY_CONES
+// The initial spread angle of the ray cones, the angle covered by one pixel in the image center.
+// The thin lens starts its cones at the pinhole footprint as well, the aperture width is ignored.
+RT_FUNCTION float pixelSpreadAngle(const int cameraType, const float2 screen, const float3& V, const float3& W)
+{
+  switch (cameraType)
+  {
+    case LENS_SHADER_FISHEYE: // 90 degrees from the center to the corners.
+      return 0.5f * M_PIf / optix::length(screen * 0.5f);
+    case LENS_SHADER_SPHERE:  // 180 degrees along the height.
+    case LENS_SHADER_CUBEMAP: // Two faces of 90 degrees along the height.
+      return M_PIf / screen.y;
+    default: // Pinhole and thin lens.
+      return atanf(2.0f * optix::length(V) / (optix::length(W) * screen.y));
+  }
+}
+#endif
+
+#endif // LENS_SHADER_DEVICE_H
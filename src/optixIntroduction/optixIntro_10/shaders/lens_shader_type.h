@@ -0,0 +1,68 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef LENS_SHADER_TYPE_H
+#define LENS_SHADER_TYPE_H
+
+// Lens shader selection in sysCameraType, the index into the sysLensShader callable program buffer.
+// Shared between host and device code.
+enum LensShader
+{
+  LENS_SHADER_PINHOLE   = 0,
+  LENS_SHADER_FISHEYE   = 1,
+  LENS_SHADER_SPHERE    = 2,
+  LENS_SHADER_THIN_LENS = 3,
+  LENS_SHADER_CUBEMAP   = 4
+};
+
+// The cubemap lens shader and the MULTI_VIEW_CUBEMAP views share this layout of the six 90 degree faces in a 3x2 grid.
+// Top row from left to right: right, left, up. Bottom row: down, front, back. Relative to the camera's U, V, W axes.
+#define CUBEMAP_FACE_COLUMNS 3
+#define CUBEMAP_FACE_ROWS    2
+
+// The thin lens samples its aperture shape through a (APERTURE_TABLE_SIZE + 1)^2 grid of points in sysApertureTable.
+// Grid vertex (i, j) is the aperture point of the 2D sample (i, j) / APERTURE_TABLE_SIZE. See src/Aperture.cpp.
+#define APERTURE_TABLE_SIZE 32
+
+// Pixel reconstruction filters of the primary ray sub-pixel offsets with USE_FILTER_IMPORTANCE_SAMPLING.
+// The separable filter is importance sampled through FILTER_TABLE_SIZE + 1 offsets in sysFilterTable.
+// Offset i is the inverse CDF of the 1D filter at i / FILTER_TABLE_SIZE. See src/PixelFilter.cpp.
+enum PixelFilter
+{
+  PIXEL_FILTER_BOX             = 0,
+  PIXEL_FILTER_TENT            = 1,
+  PIXEL_FILTER_GAUSSIAN        = 2,
+  PIXEL_FILTER_BLACKMAN_HARRIS = 3,
+  NUMBER_OF_PIXEL_FILTERS      = 4
+};
+
+#define FILTER_TABLE_SIZE 64
+
+#endif // LENS_SHADER_TYPE_H
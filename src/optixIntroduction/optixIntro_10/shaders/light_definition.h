@@ -40,7 +40,27 @@
 enum LightType
 {
   LIGHT_ENVIRONMENT   = 0, // constant color or spherical environment map.
-  LIGHT_PARALLELOGRAM = 1  // Parallelogram area light.
+  LIGHT_PARALLELOGRAM = 1, // Parallelogram area light.
+  LIGHT_MESH          = 2  // Emissive triangle mesh in world space. Only with USE_MESH_LIGHTS.
+};
+
+// Alias table entry per texel of the spherical environment map.
+// Stores the pdf with respect to the texture coordinates of this texel and its alias, to need only one load per sample.
+struct EnvironmentAlias
+{
+  float        threshold;
+  unsigned int alias;
+  float        pdf;      // pdf of this texel in uv-space. Divide by 2 * pi^2 * sin(theta) for the solid angle pdf.
+                         // Cubemaps: pdf on the face plane at distance 1. Multiply by the cubed distance of the sample point for the solid angle pdf.
+  float        pdfAlias; // pdf of the alias texel in uv-space.
+};
+
+// Walker's alias method. Entry i picks light i when the fractional part of the scaled sample is below threshold, otherwise alias.
+// Mesh lights use the same table over their triangles.
+struct LightAlias
+{
+  float threshold;
+  int   alias;
 };
 
 struct LightDefinition
@@ -60,11 +80,24 @@ struct LightDefinition
   rtBufferId<float, 2> idEnvironmentCDF_U;   // rtBufferId fields are integers.
   rtBufferId<float, 1> idEnvironmentCDF_V;
   float                environmentIntegral;
+  rtBufferId<EnvironmentAlias, 1> idEnvironmentAlias; // Width * height entries.
 
+  float         pdfSelection; // Probability to pick this light for next event estimation. Set by Application::buildLightAliasTable().
+
+#if USE_CUBEMAP_ENVIRONMENT
+  unsigned int  environmentSize; // Texels per face edge of the cubemap environment. The CDF buffer IDs are unused.
+#else
   // Manual padding to float4 alignment goes here.
-  float         unused0;
-  float         unused1;
   float         unused2;
+#endif
+
+#if USE_MESH_LIGHTS
+  // Mesh lights: Three world space vertices per triangle and the area weighted triangle selection.
+  // The position is the centroid, the area is the sum of the triangle areas, the normal is unused.
+  rtBufferId<optix::float3, 1> idMeshTriangles;
+  rtBufferId<LightAlias, 1>    idMeshAlias;
+  int                          unused3[2];
+#endif
 };
 
 struct LightSample
@@ -75,6 +108,7 @@ struct LightSample
   float         distance;
   optix::float3 emission;
   float         pdf;
+  optix::float3 normal;   // Light surface normal at the position. Unused for environment lights.
 };
 
 #endif // LIGHT_DEFINITION_H
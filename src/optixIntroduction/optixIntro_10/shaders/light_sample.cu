@@ -35,13 +35,15 @@
 #include "per_ray_data.h"
 #include "light_definition.h"
 #include "shader_common.h"
+#if USE_CUBEMAP_ENVIRONMENT
+#include "cubemap_environment.h"
+#endif
 
 #include "rt_assert.h"
 
 rtBuffer<LightDefinition> sysLightDefinitions;
-rtDeclareVariable(int,    sysNumLights, , ); // PERF Used many times and faster to read than sysLightDefinitions.size().
 
-rtDeclareVariable(float,  sysEnvironmentRotation, , );
+rtDeclareVariable(optix::Matrix3x3, sysEnvironmentMatrix, , ); // Rotation from world into environment space.
 
 
 RT_FUNCTION void unitSquareToSphere(const float u, const float v, float3& p, float& pdf)
@@ -66,14 +68,96 @@ RT_CALLABLE_PROGRAM void sample_light_constant(float3 const& point, const float2
   // Environment lights do not set the light sample position!
   lightSample.distance = RT_DEFAULT_MAX; // Environment light.
 
-  // Explicit light sample. White scaled by inverse probabilty to hit this light.
-  lightSample.emission = make_float3(sysNumLights);
+  // Explicit light sample. The pdf includes the probability to select this light.
+  lightSample.emission = make_float3(1.0f);
+  lightSample.pdf     *= sysLightDefinitions[0].pdfSelection; // The environment light is always placed into the first entry.
 }
 
 RT_CALLABLE_PROGRAM void sample_light_environment(float3 const& point, const float2 sample, LightSample& lightSample)
 {
   const LightDefinition light = sysLightDefinitions[0]; // The environment light is always placed into the first entry.
 
+#if USE_CUBEMAP_ENVIRONMENT
+  // O(1) importance sampling of the texels of all six faces with the alias table.
+  const unsigned int size   = light.environmentSize;
+  const unsigned int texels = static_cast<unsigned int>(light.idEnvironmentAlias.size());
+
+  const float        scaled = sample.x * float(texels);
+  const unsigned int slot   = min(static_cast<unsigned int>(scaled), texels - 1);
+
+  const EnvironmentAlias entry = light.idEnvironmentAlias[slot];
+
+  float du = scaled - float(slot);
+
+  unsigned int texel;
+  float        pdfFace;
+  if (du < entry.threshold)
+  {
+    texel   = slot;
+    pdfFace = entry.pdf;
+    du     /= entry.threshold;
+  }
+  else
+  {
+    texel   = entry.alias;
+    pdfFace = entry.pdfAlias;
+    du      = (du - entry.threshold) / (1.0f - entry.threshold);
+  }
+  du = fminf(du, 0.99999994f); // Stay inside the texel.
+
+  const unsigned int face  = texel / (size * size);
+  const unsigned int index = texel - face * size * size;
+
+  // Uniform inside the texel on the face plane.
+  const float a = 2.0f * (float(index % size) + du)       / float(size) - 1.0f;
+  const float b = 2.0f * (float(index / size) + sample.y) / float(size) - 1.0f;
+
+  const float3 p = cubemapDirection(face, a, b);
+  const float  r = optix::length(p);
+  const float3 direction = p / r; // In environment space.
+
+  // The transposed rotation takes the direction from environment into world space.
+  lightSample.direction = sysEnvironmentMatrix.transpose() * direction;
+
+  // Note that environment lights do not set the light sample position!
+  lightSample.distance = RT_DEFAULT_MAX; // Environment light.
+
+  lightSample.emission = make_float3(optix::rtTexCubemap<float4>(light.idEnvironmentTexture, direction.x, direction.y, direction.z));
+  // The face plane pdf times the cubed distance is the exact solid angle pdf. The pdf includes the probability to select this light.
+  lightSample.pdf = pdfFace * r * r * r * light.pdfSelection;
+#else
+#if USE_ENVIRONMENT_ALIAS_TABLE
+  // O(1) importance sampling of the texels with the alias table.
+  const unsigned int width  = static_cast<unsigned int>(light.idEnvironmentCDF_U.size().x) - 1; // The CDF rows have width + 1 entries.
+  const unsigned int texels = static_cast<unsigned int>(light.idEnvironmentAlias.size());
+
+  const float        scaled = sample.x * float(texels);
+  const unsigned int slot   = min(static_cast<unsigned int>(scaled), texels - 1);
+
+  const EnvironmentAlias entry = light.idEnvironmentAlias[slot];
+
+  // Reuse the fractional part of the scaled sample for the position inside the texel.
+  float du = scaled - float(slot);
+
+  unsigned int texel;
+  float        pdfUV;
+  if (du < entry.threshold)
+  {
+    texel = slot;
+    pdfUV = entry.pdf;
+    du   /= entry.threshold;
+  }
+  else
+  {
+    texel = entry.alias;
+    pdfUV = entry.pdfAlias;
+    du    = (du - entry.threshold) / (1.0f - entry.threshold);
+  }
+  du = fminf(du, 0.99999994f); // Stay inside the texel.
+
+  const float u = (float(texel % width) + du)       / float(width);
+  const float v = (float(texel / width) + sample.y) / float(texels / width);
+#else
   // Importance-sample the spherical environment light direction.
   const unsigned int sizeU = static_cast<unsigned int>(light.idEnvironmentCDF_U.size().x);
   const unsigned int sizeV = static_cast<unsigned int>(light.idEnvironmentCDF_V.size());
@@ -130,27 +214,36 @@ RT_CALLABLE_PROGRAM void sample_light_environment(float3 const& point, const flo
   // Texture lookup coordinates.
   const float u = (float(index.x) + du) / float(sizeU - 1);
   const float v = (float(index.y) + dv) / float(sizeV - 1);
+#endif
 
-  // Light sample direction vector polar coordinates. This is where the environment rotation happens!
-  // DAR FIXME Use a light.matrix to rotate the resulting vector instead.
-  const float phi   = (u - sysEnvironmentRotation) * 2.0f * M_PIf;
+  // Light sample direction vector polar coordinates in environment space.
+  const float phi   = u * 2.0f * M_PIf;
   const float theta = v * M_PIf; // theta == 0.0f is south pole, theta == M_PIf is north pole.
 
   const float sinTheta = sinf(theta);
   // The miss program places the 1->0 seam at the positive z-axis and looks from the inside.
-  lightSample.direction = make_float3(-sinf(phi) * sinTheta,  // Starting on positive z-axis going around clockwise (to negative x-axis).
-                                      -cosf(theta),           // From south pole to north pole.
-                                       cosf(phi) * sinTheta); // Starting on positive z-axis.
+  const float3 direction = make_float3(-sinf(phi) * sinTheta,  // Starting on positive z-axis going around clockwise (to negative x-axis).
+                                       -cosf(theta),           // From south pole to north pole.
+                                        cosf(phi) * sinTheta); // Starting on positive z-axis.
+
+  // This is where the environment rotation happens. The transposed rotation takes the direction into world space.
+  lightSample.direction = sysEnvironmentMatrix.transpose() * direction;
 
   // Note that environment lights do not set the light sample position!
   lightSample.distance = RT_DEFAULT_MAX; // Environment light.
 
   const float3 emission = make_float3(optix::rtTex2D<float4>(light.idEnvironmentTexture, u, v));
-  // Explicit light sample. The returned emission must be scaled by the inverse probability to select this light.
-  lightSample.emission = emission * sysNumLights;
+  // Explicit light sample. The pdf includes the probability to select this light.
+  lightSample.emission = emission;
+#if USE_ENVIRONMENT_ALIAS_TABLE
+  // The exact solid angle pdf of the piecewise constant distribution. The poles have zero solid angle and are never useful.
+  lightSample.pdf = (0.0f < sinTheta) ? pdfUV / (2.0f * M_PIf * M_PIf * sinTheta) * light.pdfSelection : 0.0f;
+#else
   // For simplicity we pretend that we perfectly importance-sampled the actual texture-filtered environment map
   // and not the Gaussian-smoothed one used to actually generate the CDFs and uniform sampling in the texel.
-  lightSample.pdf = intensity(emission) / light.environmentIntegral;
+  lightSample.pdf = intensity(emission) / light.environmentIntegral * light.pdfSelection;
+#endif
+#endif // USE_CUBEMAP_ENVIRONMENT
 }
 
 
@@ -170,9 +263,71 @@ RT_CALLABLE_PROGRAM void sample_light_parallelogram(float3 const& point, const f
     const float cosTheta = optix::dot(-lightSample.direction, light.normal);
     if (DENOMINATOR_EPSILON < cosTheta) // Only emit light on the front side.
     {
-      // Explicit light sample, must scale the emission by inverse probabilty to hit this light.
-      lightSample.emission = light.emission * float(sysNumLights); 
-      lightSample.pdf      = (lightSample.distance * lightSample.distance) / (light.area * cosTheta); // Solid angle pdf. Assumes light.area != 0.0f.
+      // Explicit light sample. The pdf includes the probability to select this light.
+      lightSample.emission = light.emission;
+      lightSample.pdf      = (lightSample.distance * lightSample.distance) / (light.area * cosTheta) * light.pdfSelection; // Solid angle pdf. Assumes light.area != 0.0f.
+      lightSample.normal   = light.normal;
+    }
+  }
+}
+
+#if USE_MESH_LIGHTS
+RT_CALLABLE_PROGRAM void sample_light_mesh(float3 const& point, const float2 sample, LightSample& lightSample)
+{
+  lightSample.pdf = 0.0f; // Default return, invalid light sample (backface, edge on, or too near to the surface)
+
+  const LightDefinition light = sysLightDefinitions[lightSample.index]; // The light index is picked by the caller!
+
+  // O(1) triangle selection with the alias table. The triangles have the same emission, so their power is their area.
+  const unsigned int triangles = static_cast<unsigned int>(light.idMeshAlias.size());
+
+  const float        scaled = sample.x * float(triangles);
+  const unsigned int slot   = min(static_cast<unsigned int>(scaled), triangles - 1);
+
+  const LightAlias entry = light.idMeshAlias[slot];
+
+  // Reuse the fractional part of the scaled sample for the position inside the triangle.
+  float du = scaled - float(slot);
+
+  unsigned int triangle;
+  if (du < entry.threshold)
+  {
+    triangle = slot;
+    du      /= entry.threshold;
+  }
+  else
+  {
+    triangle = entry.alias;
+    du       = (du - entry.threshold) / (1.0f - entry.threshold);
+  }
+  du = fminf(du, 0.99999994f);
+
+  const float3 v0 = light.idMeshTriangles[triangle * 3];
+  const float3 v1 = light.idMeshTriangles[triangle * 3 + 1];
+  const float3 v2 = light.idMeshTriangles[triangle * 3 + 2];
+
+  // Uniform barycentrics.
+  const float s = sqrtf(du);
+  const float a = 1.0f - s;
+  const float b = sample.y * s;
+
+  lightSample.position  = v0 + a * (v1 - v0) + b * (v2 - v0);
+  lightSample.direction = lightSample.position - point;
+  lightSample.distance  = optix::length(lightSample.direction);
+  if (DENOMINATOR_EPSILON < lightSample.distance)
+  {
+    lightSample.direction /= lightSample.distance;
+
+    // The winding defines the emitting side, like the geometric normal of the attribute program.
+    const float3 normal   = optix::normalize(optix::cross(v1 - v0, v2 - v0));
+    const float  cosTheta = optix::dot(-lightSample.direction, normal);
+    if (DENOMINATOR_EPSILON < cosTheta)
+    {
+      // Picking the triangles by area and then uniformly on them is uniform over the whole mesh area.
+      lightSample.emission = light.emission;
+      lightSample.pdf      = (lightSample.distance * lightSample.distance) / (light.area * cosTheta) * light.pdfSelection;
+      lightSample.normal   = normal;
     }
   }
 }
+#endif
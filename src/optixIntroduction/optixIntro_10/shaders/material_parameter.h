@@ -33,6 +33,11 @@
 
 #include "function_indices.h"
 
+// 2-bit per triangle cutout opacity states inside the parCutoutStates buffer.
+#define CUTOUT_PARTIAL     0
+#define CUTOUT_OPAQUE      1
+#define CUTOUT_TRANSPARENT 2
+
 // Just some hardcoded material parameter system which allows to show a few fundamental BSDFs.
 // Alignment of all data types used here is 4 bytes.
 struct MaterialParameter
@@ -44,9 +49,19 @@ struct MaterialParameter
   optix::float3 absorption; // Absorption coefficient
   float         ior;        // Index of refraction
   unsigned int  flags;      // Thin-walled on/off
+  int           albedoVirtualID; // Index into sysVirtualTextures modulating the albedo color when >= 0. Takes precedence over albedoID.
+  float         albedoLod;  // 0.5f * log2(width * height) of the albedo texture. Added to the ray cone level of detail, see USE_RAY_CONES.
+  float         cutoutLod;  // 0.5f * log2(width * height) of the cutout texture.
+  float         abbe;       // Abbe number of the dispersion, 0.0f == none. Only used with USE_SPECTRAL.
+  int           medium;     // Index into sysMedia of the heterogeneous medium inside, -1 == none. Only used with USE_HETEROGENEOUS_MEDIA.
+};
 
-  // Manual padding to 16-byte alignment goes here.
-  float unused0;
+// One changed material for the incremental upload.
+struct MaterialUpdate
+{
+  MaterialParameter parameter;
+  int               index;  // Destination element inside sysMaterialParameters.
+  int               pad[3]; // Keeps the float4 alignment of the array elements.
 };
 
 #endif // MATERIAL_PARAMETER_H
@@ -0,0 +1,94 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#ifndef MATERIAL_STACK_H
+#define MATERIAL_STACK_H
+
+#include "app_config.h"
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+
+#if MATERIAL_STACK_COMPACT
+// The nested volumes of a path as 16-bit indices into sysMaterialParameters.
+// Entry 0 is the innermost volume. Pushing shifts the words up by one entry, so there are no dynamically indexed arrays
+// and the stack stays in registers. The caller tracks the depth with the stack index like for the float4 array.
+struct MaterialStack
+{
+  unsigned long long lo; // Entries 0 to 3.
+#if 4 < MATERIAL_STACK_SIZE
+  unsigned long long hi; // Entries 4 to 7.
+#endif
+};
+
+RT_FUNCTION void initMaterialStack(MaterialStack& stack)
+{
+  stack.lo = 0ull;
+#if 4 < MATERIAL_STACK_SIZE
+  stack.hi = 0ull;
+#endif
+}
+
+// A full stack replaces the innermost entry, like the float4 array clamps its index to MATERIAL_STACK_LAST.
+RT_FUNCTION void pushMaterial(MaterialStack& stack, const int materialIndex, const bool full)
+{
+  if (!full)
+  {
+#if 4 < MATERIAL_STACK_SIZE
+    stack.hi = (stack.hi << 16) | (stack.lo >> 48);
+#endif
+    stack.lo <<= 16;
+  }
+  stack.lo = (stack.lo & ~0xFFFFull) | (unsigned long long) (materialIndex & 0xFFFF);
+}
+
+RT_FUNCTION void popMaterial(MaterialStack& stack)
+{
+#if 4 < MATERIAL_STACK_SIZE
+  stack.lo = (stack.lo >> 16) | (stack.hi << 48);
+  stack.hi >>= 16;
+#else
+  stack.lo >>= 16;
+#endif
+}
+
+// The volume the path is inside.
+RT_FUNCTION int innerMaterial(MaterialStack const& stack)
+{
+  return int(stack.lo & 0xFFFFull);
+}
+
+// The volume surrounding it.
+RT_FUNCTION int outerMaterial(MaterialStack const& stack)
+{
+  return int((stack.lo >> 16) & 0xFFFFull);
+}
+#endif // MATERIAL_STACK_COMPACT
+
+#endif // MATERIAL_STACK_H
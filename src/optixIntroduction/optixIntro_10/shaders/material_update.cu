@@ -26,23 +26,20 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#pragma once
+#include "app_config.h"
 
-#ifndef MY_ASSERT_H
-#define MY_ASSERT_H
+#include <optix.h>
 
-#undef MY_ASSERT
+#include "material_parameter.h"
 
-#if !defined(NDEBUG)
-  #if defined(_WIN32) // Windows 32/64-bit
-    #include <windows.h>
-    #define DBGBREAK() DebugBreak();
-  #else
-    #define DBGBREAK() __builtin_trap();
-  #endif
-  #define MY_ASSERT(expr) if (!(expr)) DBGBREAK()
-#else
-  #define MY_ASSERT(expr)
-#endif
+rtBuffer<MaterialParameter> sysMaterialParameters; // RT_BUFFER_INPUT_OUTPUT when incremental updates are used.
+rtBuffer<MaterialUpdate>    sysMaterialUpdates;    // The materials changed since the last frame.
 
-#endif // MY_ASSERT_H
+rtDeclareVariable(unsigned int, theLaunchIndex, rtLaunchIndex, );
+
+// 1D launch over the staged updates. Only these entries change on the device, the rest of sysMaterialParameters is never uploaded again.
+RT_PROGRAM void material_update()
+{
+  const MaterialUpdate& update = sysMaterialUpdates[theLaunchIndex];
+  sysMaterialParameters[update.index] = update.parameter;
+}
@@ -0,0 +1,275 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#ifndef MEDIUM_H
+#define MEDIUM_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+
+// A heterogeneous participating medium inside the closed geometry of a material, see src/Media.cpp.
+// The density grid is stretched over the world space bounding box of all GeometryInstances with that material.
+// The extinction coefficient is sigma_t(x) = density * grid(x), gray, the scattering albedo colors the collisions.
+// The majorant grid stores the maximum grid value of each of its MEDIUM_MAJORANT_GRID^3 cells including the trilinear
+// filter footprint, so the free-flight sampling can take the large steps of a small majorant in the thin regions.
+struct MediumDefinition
+{
+  optix::float3 boundsMin;  // World space box of the density grid.
+  int           densityID;  // Bindless 3D texture ID of the grid values in [0, 1].
+  optix::float3 boundsMax;
+  int           majorantID; // Bindless buffer ID of the MEDIUM_MAJORANT_GRID^3 floats, x fastest.
+  optix::float3 albedo;     // Single scattering albedo sigma_s / sigma_t. Black == purely absorbing.
+  float         density;    // Extinction coefficient where the grid is 1.0f, per world unit.
+  float         anisotropy; // Henyey-Greenstein g in (-1, 1). 0.0f == isotropic.
+  int           pad[3];     // Keeps the float4 alignment of the sysMedia elements.
+};
+
+#if defined(__CUDACC__)
+
+#include "random_number_generators.h"
+#include "shader_common.h"
+
+// Clips the ray interval [tMin, tMax] to the medium bounds.
+RT_FUNCTION bool clipMediumBounds(MediumDefinition const& medium, const optix::float3 origin, const optix::float3 direction, float& tMin, float& tMax)
+{
+  const optix::float3 inverse = optix::make_float3(1.0f) / direction; // Infinity for zero components works with the min/max below.
+  const optix::float3 t0 = (medium.boundsMin - origin) * inverse;
+  const optix::float3 t1 = (medium.boundsMax - origin) * inverse;
+  const optix::float3 tNear = optix::fminf(t0, t1);
+  const optix::float3 tFar  = optix::fmaxf(t0, t1);
+
+  tMin = fmaxf(tMin, fmaxf(fmaxf(tNear.x, tNear.y), tNear.z));
+  tMax = fminf(tMax, fminf(fminf(tFar.x, tFar.y), tFar.z));
+
+  return tMin < tMax;
+}
+
+RT_FUNCTION float mediumDensity(MediumDefinition const& medium, const optix::float3 position)
+{
+  const optix::float3 uvw = (position - medium.boundsMin) / (medium.boundsMax - medium.boundsMin);
+  return medium.density * optix::rtTex3D<float>(medium.densityID, uvw.x, uvw.y, uvw.z);
+}
+
+// 3D DDA over the majorant grid cells along the clipped ray.
+struct MajorantWalker
+{
+  RT_FUNCTION MajorantWalker(MediumDefinition const& medium, const optix::float3 origin, const optix::float3 direction, const float tMin)
+  {
+    const optix::float3 cellSize = (medium.boundsMax - medium.boundsMin) * (1.0f / float(MEDIUM_MAJORANT_GRID));
+    const optix::float3 start    = (origin + tMin * direction - medium.boundsMin) / cellSize;
+
+    cell.x = min(max(int(floorf(start.x)), 0), MEDIUM_MAJORANT_GRID - 1); // The clipped start can be a rounding error outside.
+    cell.y = min(max(int(floorf(start.y)), 0), MEDIUM_MAJORANT_GRID - 1);
+    cell.z = min(max(int(floorf(start.z)), 0), MEDIUM_MAJORANT_GRID - 1);
+
+    step.x = (0.0f <= direction.x) ? 1 : -1;
+    step.y = (0.0f <= direction.y) ? 1 : -1;
+    step.z = (0.0f <= direction.z) ? 1 : -1;
+
+    // The ray parameter where the next cell boundary in each axis is crossed.
+    const optix::float3 boundary = medium.boundsMin + optix::make_float3(float(cell.x + max(step.x, 0)),
+                                                                         float(cell.y + max(step.y, 0)),
+                                                                         float(cell.z + max(step.z, 0))) * cellSize;
+    tNext.x = (direction.x != 0.0f) ? (boundary.x - origin.x) / direction.x : RT_DEFAULT_MAX;
+    tNext.y = (direction.y != 0.0f) ? (boundary.y - origin.y) / direction.y : RT_DEFAULT_MAX;
+    tNext.z = (direction.z != 0.0f) ? (boundary.z - origin.z) / direction.z : RT_DEFAULT_MAX;
+
+    tDelta.x = (direction.x != 0.0f) ? cellSize.x / fabsf(direction.x) : RT_DEFAULT_MAX;
+    tDelta.y = (direction.y != 0.0f) ? cellSize.y / fabsf(direction.y) : RT_DEFAULT_MAX;
+    tDelta.z = (direction.z != 0.0f) ? cellSize.z / fabsf(direction.z) : RT_DEFAULT_MAX;
+  }
+
+  RT_FUNCTION int index() const
+  {
+    return (cell.z * MEDIUM_MAJORANT_GRID + cell.y) * MEDIUM_MAJORANT_GRID + cell.x;
+  }
+
+  // The ray parameter where the current cell is left.
+  RT_FUNCTION float exit() const
+  {
+    return fminf(fminf(tNext.x, tNext.y), tNext.z);
+  }
+
+  // Returns false when the ray left the grid.
+  RT_FUNCTION bool advance()
+  {
+    if (tNext.x <= tNext.y && tNext.x <= tNext.z)
+    {
+      cell.x  += step.x;
+      tNext.x += tDelta.x;
+      return 0 <= cell.x && cell.x < MEDIUM_MAJORANT_GRID;
+    }
+    if (tNext.y <= tNext.z)
+    {
+      cell.y  += step.y;
+      tNext.y += tDelta.y;
+      return 0 <= cell.y && cell.y < MEDIUM_MAJORANT_GRID;
+    }
+    cell.z  += step.z;
+    tNext.z += tDelta.z;
+    return 0 <= cell.z && cell.z < MEDIUM_MAJORANT_GRID;
+  }
+
+  optix::int3   cell;
+  optix::int3   step;
+  optix::float3 tNext;
+  optix::float3 tDelta;
+};
+
+// Delta tracking: Samples the distance t to the next real collision inside [tMin, tMax] against the piecewise constant
+// majorant of the cells along the ray. Tentative collisions are rejected as null collisions with probability
+// 1 - sigma_t(x) / majorant, the memoryless exponential restarts at each cell boundary.
+// Returns false when the ray passed the interval without a collision, which happens with the probability of the transmittance.
+RT_FUNCTION bool sampleFreeFlight(MediumDefinition const& medium, const optix::float3 origin, const optix::float3 direction,
+                                  float tMin, float tMax, unsigned int& seed, float& t)
+{
+  if (!clipMediumBounds(medium, origin, direction, tMin, tMax))
+  {
+    return false;
+  }
+
+  const rtBufferId<float, 1> majorants(medium.majorantID);
+
+  MajorantWalker walker(medium, origin, direction, tMin);
+
+  t = tMin;
+
+  int steps = 0;
+  do
+  {
+    const float tCell    = fminf(walker.exit(), tMax);
+    const float majorant = medium.density * majorants[walker.index()];
+
+    if (0.0f < majorant) // Empty cells are skipped.
+    {
+      while (steps++ < MEDIUM_MAX_STEPS)
+      {
+        t -= logf(1.0f - rng(seed)) / majorant;
+        if (tCell <= t)
+        {
+          break;
+        }
+        if (rng(seed) * majorant < mediumDensity(medium, origin + t * direction))
+        {
+          return true; // Real collision.
+        }
+      }
+    }
+    t = tCell;
+  }
+  while (t < tMax && steps < MEDIUM_MAX_STEPS && walker.advance());
+
+  return false;
+}
+
+// Ratio tracking: Estimates the transmittance over [tMin, tMax] as the product of the null collision probabilities
+// of the tentative collisions. Unbiased like delta tracking, but without its binary zero or one result.
+// Russian roulette ends the walk when the estimate got small.
+RT_FUNCTION float ratioTrackTransmittance(MediumDefinition const& medium, const optix::float3 origin, const optix::float3 direction,
+                                          float tMin, float tMax, unsigned int& seed)
+{
+  if (!clipMediumBounds(medium, origin, direction, tMin, tMax))
+  {
+    return 1.0f;
+  }
+
+  const rtBufferId<float, 1> majorants(medium.majorantID);
+
+  MajorantWalker walker(medium, origin, direction, tMin);
+
+  float transmittance = 1.0f;
+  float t             = tMin;
+
+  int steps = 0;
+  do
+  {
+    const float tCell    = fminf(walker.exit(), tMax);
+    const float majorant = medium.density * majorants[walker.index()];
+
+    if (0.0f < majorant)
+    {
+      while (steps++ < MEDIUM_MAX_STEPS)
+      {
+        t -= logf(1.0f - rng(seed)) / majorant;
+        if (tCell <= t)
+        {
+          break;
+        }
+        transmittance *= 1.0f - fminf(mediumDensity(medium, origin + t * direction) / majorant, 1.0f);
+
+        if (transmittance < 0.1f)
+        {
+          if (0.5f <= rng(seed))
+          {
+            return 0.0f;
+          }
+          transmittance *= 2.0f;
+        }
+      }
+    }
+    t = tCell;
+  }
+  while (t < tMax && steps < MEDIUM_MAX_STEPS && walker.advance());
+
+  return transmittance;
+}
+
+// Henyey-Greenstein phase function sampling around the propagation direction. The pdf equals the phase function,
+// so the sample weight is one.
+RT_FUNCTION optix::float3 sampleHenyeyGreenstein(const optix::float3 direction, const float g, const optix::float2 sample)
+{
+  float cosTheta;
+  if (fabsf(g) < 1e-3f)
+  {
+    cosTheta = 1.0f - 2.0f * sample.x;
+  }
+  else
+  {
+    const float s = (1.0f - g * g) / (1.0f - g + 2.0f * g * sample.x);
+    cosTheta = (1.0f + g * g - s * s) / (2.0f * g);
+  }
+  cosTheta = optix::clamp(cosTheta, -1.0f, 1.0f);
+
+  const float sinTheta = sqrtf(fmaxf(0.0f, 1.0f - cosTheta * cosTheta));
+  const float phi      = 2.0f * M_PIf * sample.y;
+
+  const TBN tbn(direction);
+
+  return tbn.inverse_transform(optix::make_float3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta));
+}
+
+#endif // __CUDACC__
+
+#endif // MEDIUM_H
@@ -0,0 +1,130 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+
+// Device side mipmap generation for Textures created from a Picture with only LOD 0. See Texture::generateMipmaps().
+// Mipmap levels of a texture buffer cannot be written by launches, so all generated levels are stored
+// back to back in sysMipmapTexels and the host copies them into the texture's mipmap levels afterwards.
+rtBuffer<float4, 1> sysMipmapTexels; // Levels 1 to n-1, linear RGBA32F, ends up sRGB encoded after mipmap_encode().
+
+rtDeclareVariable(int,          sysMipmapTexture, , );      // Bindless texture ID, the source of level 1.
+rtDeclareVariable(int,          sysMipmapFromTexture, , );  // 1 == read the source level from LOD 0 of sysMipmapTexture, 0 == from sysMipmapTexels.
+rtDeclareVariable(uint2,        sysMipmapSourceSize, , );   // Extents of the source level.
+rtDeclareVariable(unsigned int, sysMipmapSourceOffset, , ); // First texel of the source level inside sysMipmapTexels.
+rtDeclareVariable(unsigned int, sysMipmapTargetOffset, , ); // First texel of the target level inside sysMipmapTexels.
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+rtDeclareVariable(uint2, theLaunchDim,   rtLaunchDim, );
+
+RT_FUNCTION float4 fetchSource(const unsigned int x, const unsigned int y)
+{
+  if (sysMipmapFromTexture)
+  {
+    // Lookups at the texel centers return the unfiltered texels. The sRGB read modes already return linear values.
+    return optix::rtTex2DLod<float4>(sysMipmapTexture,
+                                     (float(x) + 0.5f) / float(sysMipmapSourceSize.x),
+                                     (float(y) + 0.5f) / float(sysMipmapSourceSize.y), 0.0f);
+  }
+  return sysMipmapTexels[sysMipmapSourceOffset + y * sysMipmapSourceSize.x + x];
+}
+
+// Box filter footprint of the target texel i along one axis. Returns the number of taps starting at source texel first.
+// Even extents average two texels. Odd extents use three taps with the weights of the exact box
+// to not shift the image, see "Non-Power-of-Two Mipmapping" (NVIDIA whitepaper).
+RT_FUNCTION unsigned int boxTaps(const unsigned int source, const unsigned int target, const unsigned int i, unsigned int& first, float* weights)
+{
+  if (source == 1) // The other axis is still reduced.
+  {
+    first      = 0;
+    weights[0] = 1.0f;
+    return 1;
+  }
+
+  first = 2 * i;
+
+  if ((source & 1) == 0)
+  {
+    weights[0] = 0.5f;
+    weights[1] = 0.5f;
+    return 2;
+  }
+
+  const float scale = 1.0f / float(2 * target + 1);
+
+  weights[0] = float(target - i) * scale;
+  weights[1] = float(target)     * scale;
+  weights[2] = float(i + 1)      * scale;
+  return 3;
+}
+
+// 2D launch over the target level.
+RT_PROGRAM void mipmap_level()
+{
+  unsigned int firstX;
+  unsigned int firstY;
+  float weightsX[3];
+  float weightsY[3];
+
+  const unsigned int tapsX = boxTaps(sysMipmapSourceSize.x, theLaunchDim.x, theLaunchIndex.x, firstX, weightsX);
+  const unsigned int tapsY = boxTaps(sysMipmapSourceSize.y, theLaunchDim.y, theLaunchIndex.y, firstY, weightsY);
+
+  float4 sum = make_float4(0.0f);
+
+  for (unsigned int y = 0; y < tapsY; ++y)
+  {
+    for (unsigned int x = 0; x < tapsX; ++x)
+    {
+      sum += fetchSource(firstX + x, firstY + y) * (weightsX[x] * weightsY[y]);
+    }
+  }
+
+  sysMipmapTexels[sysMipmapTargetOffset + theLaunchIndex.y * theLaunchDim.x + theLaunchIndex.x] = sum;
+}
+
+RT_FUNCTION float linearToSrgb(const float c)
+{
+  return (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// 1D launch over all texels in sysMipmapTexels after all levels have been filtered. Alpha stays linear.
+RT_PROGRAM void mipmap_encode()
+{
+  const float4 texel = sysMipmapTexels[theLaunchIndex.x];
+
+  sysMipmapTexels[theLaunchIndex.x] = make_float4(linearToSrgb(fmaxf(0.0f, texel.x)),
+                                                  linearToSrgb(fmaxf(0.0f, texel.y)),
+                                                  linearToSrgb(fmaxf(0.0f, texel.z)),
+                                                  texel.w);
+}
@@ -35,6 +35,9 @@
 #include "per_ray_data.h"
 #include "light_definition.h"
 #include "shader_common.h"
+#if USE_CUBEMAP_ENVIRONMENT
+#include "cubemap_environment.h"
+#endif
 
 rtDeclareVariable(optix::Ray, theRay, rtCurrentRay, );
 
@@ -42,7 +45,8 @@ rtDeclareVariable(PerRayData, thePrd, rtPayload, );
 
 rtBuffer<LightDefinition> sysLightDefinitions;
 
-rtDeclareVariable(float, sysEnvironmentRotation, , );
+rtDeclareVariable(optix::Matrix3x3, sysEnvironmentMatrix, , ); // Rotation from world into environment space.
+rtDeclareVariable(int,              sysLightSamples, , );     // The light sample pdfs count this many times in the MIS weights.
 
 
 // Not actually a light. Never appears inside the sysLightDefinitions.
@@ -52,7 +56,7 @@ RT_PROGRAM void miss_environment_null()
 
 #if USE_DENOISER
 #if USE_DENOISER_ALBEDO
-  thePrd.albedo   = make_float3(0.0f);
+  setAlbedo(thePrd, make_float3(0.0f));
 #endif
 #endif
 
@@ -64,7 +68,14 @@ RT_PROGRAM void miss_environment_constant()
 #if USE_NEXT_EVENT_ESTIMATION
   // If the last surface intersection was a diffuse which was directly lit with multiple importance sampling,
   // then calculate light emission with multiple importance sampling as well.
-  const float weightMIS = (thePrd.flags & FLAG_DIFFUSE) ? powerHeuristic(thePrd.pdf, 0.25f * M_1_PIf) : 1.0f;
+  // The constant environment light is sysLightDefinitions[0], its explicit sample pdf includes the light selection probability.
+  float weightMIS = (thePrd.flags & FLAG_DIFFUSE) ? powerHeuristic(thePrd.pdf, float(sysLightSamples) * 0.25f * M_1_PIf * sysLightDefinitions[0].pdfSelection) : 1.0f;
+#if USE_RESTIR
+  if (thePrd.flags & FLAG_RESAMPLED)
+  {
+    weightMIS = 0.0f; // The resampled direct lighting of the last hit contains the environment already.
+  }
+#endif
   thePrd.radiance = make_float3(weightMIS); // Constant white emission multiplied by MIS weight.
 #else
   thePrd.radiance = make_float3(1.0f); // Constant white emission.
@@ -72,7 +83,7 @@ RT_PROGRAM void miss_environment_constant()
 
 #if USE_DENOISER
 #if USE_DENOISER_ALBEDO
-  thePrd.albedo = make_float3(1.0f); // Constant white emission.
+  setAlbedo(thePrd, make_float3(1.0f)); // Constant white emission.
 #endif
 #endif
 
@@ -83,14 +94,17 @@ RT_PROGRAM void miss_environment_mapping()
 {
   const LightDefinition light = sysLightDefinitions[0];
   
-  const float3 R = theRay.direction;
+  const float3 R = sysEnvironmentMatrix * theRay.direction; // The direction in environment space.
+#if USE_CUBEMAP_ENVIRONMENT
+  const float3 emission = make_float3(optix::rtTexCubemap<float4>(light.idEnvironmentTexture, R.x, R.y, R.z));
+#else
   // The seam u == 0.0 == 1.0 is in positive z-axis direction.
-  // Compensate for the environment rotation done inside the direct lighting.
-  const float u     = (atan2f(R.x, -R.z) + M_PIf) * 0.5f * M_1_PIf + sysEnvironmentRotation; // DAR FIXME Use a light.matrix to rotate the environment.
+  const float u     = (atan2f(R.x, -R.z) + M_PIf) * 0.5f * M_1_PIf;
   const float theta = acosf(-R.y);     // theta == 0.0f is south pole, theta == M_PIf is north pole.
   const float v     = theta * M_1_PIf; // Texture is with origin at lower left, v == 0.0f is south pole.
   
   const float3 emission = make_float3(optix::rtTex2D<float4>(light.idEnvironmentTexture, u, v));
+#endif
 
 #if USE_NEXT_EVENT_ESTIMATION
   float weightMIS = 1.0f;
@@ -98,11 +112,42 @@ RT_PROGRAM void miss_environment_mapping()
   // then calculate light emission with multiple importance sampling for this implicit light hit as well.
   if (thePrd.flags & FLAG_DIFFUSE)
   {
+#if USE_CUBEMAP_ENVIRONMENT
+    // The same pdf as the explicit light sample, looked up at the texel of the face which contains the direction.
+    const unsigned int size = light.environmentSize;
+
+    float a;
+    float b;
+    const unsigned int face = cubemapFace(R, a, b);
+
+    const unsigned int x = min(static_cast<unsigned int>((a + 1.0f) * 0.5f * float(size)), size - 1);
+    const unsigned int y = min(static_cast<unsigned int>((b + 1.0f) * 0.5f * float(size)), size - 1);
+
+    const float r = sqrtf(1.0f + a * a + b * b); // Distance of the point on the face plane.
+    const float pdfLight = light.idEnvironmentAlias[(face * size + y) * size + x].pdf * r * r * r * light.pdfSelection;
+#elif USE_ENVIRONMENT_ALIAS_TABLE
+    // The same pdf as the explicit light sample, looked up at the texel which contains the direction.
+    const unsigned int width  = static_cast<unsigned int>(light.idEnvironmentCDF_U.size().x) - 1;
+    const unsigned int height = static_cast<unsigned int>(light.idEnvironmentAlias.size()) / width;
+
+    const unsigned int x = min(static_cast<unsigned int>(u * float(width)), width - 1);
+    const unsigned int y = min(static_cast<unsigned int>(v * float(height)), height - 1);
+
+    const float sinTheta = sinf(theta);
+    const float pdfLight = (0.0f < sinTheta) ? light.idEnvironmentAlias[y * width + x].pdf / (2.0f * M_PIf * M_PIf * sinTheta) * light.pdfSelection : 0.0f;
+#else
     // For simplicity we pretend that we perfectly importance-sampled the actual texture-filtered environment map
     // and not the Gaussian smoothed one used to actually generate the CDFs.
-    const float pdfLight = intensity(emission) / light.environmentIntegral;
-    weightMIS = powerHeuristic(thePrd.pdf, pdfLight);
+    const float pdfLight = intensity(emission) / light.environmentIntegral * light.pdfSelection;
+#endif
+    weightMIS = powerHeuristic(thePrd.pdf, float(sysLightSamples) * pdfLight);
+  }
+#if USE_RESTIR
+  if (thePrd.flags & FLAG_RESAMPLED)
+  {
+    weightMIS = 0.0f; // The resampled direct lighting of the last hit contains the environment already.
   }
+#endif
   thePrd.radiance = emission * weightMIS;
 #else
   thePrd.radiance = emission;
@@ -110,7 +155,7 @@ RT_PROGRAM void miss_environment_mapping()
 
 #if USE_DENOISER
 #if USE_DENOISER_ALBEDO
-  thePrd.albedo = emission;
+  setAlbedo(thePrd, emission);
 #endif
 #endif
 
@@ -0,0 +1,59 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#ifndef MULTI_VIEW_H
+#define MULTI_VIEW_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+// Layouts of the multi-view launch in m_multiView.
+#define MULTI_VIEW_OFF     0 // One view through the lens shader of sysCameraType.
+#define MULTI_VIEW_STEREO  1 // Left and right eye side by side.
+#define MULTI_VIEW_CUBEMAP 2 // Six 90 degree faces in a 3x2 grid, see Application::updateViews().
+
+#define MULTI_VIEW_MAX_VIEWS 6
+
+// One pinhole camera of the ENTRY_RENDER_VIEWS launch and the lower left corner of the sub-rectangle it renders into.
+// U, V and W follow the same convention as sysCameraU, sysCameraV and sysCameraW.
+// Note that the fields are ordered by CUDA alignment restrictions. Size is 56 bytes.
+struct ViewDefinition
+{
+  optix::uint2  origin;   // Pixel coordinate of the view's lower left corner inside the output buffers.
+  optix::float3 position;
+  optix::float3 U;
+  optix::float3 V;
+  optix::float3 W;
+};
+
+#endif // MULTI_VIEW_H
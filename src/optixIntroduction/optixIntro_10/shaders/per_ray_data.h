@@ -33,12 +33,30 @@
 
 #include "app_config.h"
 
+#include "rt_function.h"
 #include "random_number_generators.h"
+#if USE_COMPACT_PAYLOAD
+#include "compact_attributes.h"
+#endif
+#if USE_RAY_CONES
+#include <cuda_fp16.h>
+#endif
 
+// Can be changed by the runtime shader compilation, see USE_RUNTIME_COMPILATION.
+#ifndef MATERIAL_STACK_SIZE
+#define MATERIAL_STACK_SIZE   4
+#endif
 #define MATERIAL_STACK_EMPTY -1
 #define MATERIAL_STACK_FIRST  0
-#define MATERIAL_STACK_LAST   3
-#define MATERIAL_STACK_SIZE   4
+#define MATERIAL_STACK_LAST   (MATERIAL_STACK_SIZE - 1)
+
+// The packed material index stack of USE_COMPACT_MATERIAL_STACK holds at most this many entries.
+#define MATERIAL_STACK_COMPACT_MAX 8
+#if USE_COMPACT_MATERIAL_STACK && MATERIAL_STACK_SIZE <= MATERIAL_STACK_COMPACT_MAX
+#define MATERIAL_STACK_COMPACT 1
+#else
+#define MATERIAL_STACK_COMPACT 0
+#endif
 
 // Set when reaching a closesthit program. Unused in this demo
 #define FLAG_HIT            0x00000001
@@ -47,16 +65,39 @@
 #define FLAG_DIFFUSE        0x00000002
 // Set when a light was hit.
 #define FLAG_LIGHT          0x00000004
+// Set by the megakernel integrator on the primary ray when the direct lighting of its hit is resampled. See USE_RESTIR.
+#define FLAG_PRIMARY        0x00000008
 
 // Set if (0.0f <= wo_dot_ng), means looking onto the front face. (Edge-on is explicitly handled as frontface for the material stack.)
 #define FLAG_FRONTFACE      0x00000010
 // Pass down material.flags through to the BSDFs.
 #define FLAG_THINWALLED     0x00000020
+// Set when the direct lighting of the last diffuse hit was resampled from the reservoirs, which replaces the implicit light hits.
+#define FLAG_RESAMPLED      0x00000040
+// Set by the megakernel integrator on path segments whose diffuse hits return their radiance cache cell. See USE_RADIANCE_CACHE.
+#define FLAG_CACHE          0x00000080
 
 // FLAG_TRANSMISSION is set if there is a transmission. (Can't happen when FLAG_THINWALLED is set.)
 #define FLAG_TRANSMISSION   0x00000100
+// Set by the integrator after enough diffuse bounces. A diffuse hit with a cached radiance returns that and terminates the path.
+#define FLAG_CACHE_QUERY    0x00000200
+// Set by the closest hit when it returned the cached radiance.
+#define FLAG_CACHED         0x00000400
+// Set by the megakernel integrator on the primary ray when light group AOVs are written. The direct lighting is split into aovLights.
+#define FLAG_AOV_LIGHTS     0x00002000
 // Set if the material stack is not empty.
 #define FLAG_VOLUME         0x00001000
+#if USE_SPECTRAL
+// Set by the megakernel integrator when the path carries a hero wavelength in the wavelength field. Persistent along the path.
+#define FLAG_SPECTRAL       0x00000800
+// Set by the first dispersive BSDF sample. From there on the path only carries the hero wavelength. Persistent along the path.
+#define FLAG_MONOCHROMATIC  0x00004000
+#define FLAG_SPECTRAL_MASK  (FLAG_SPECTRAL | FLAG_MONOCHROMATIC)
+#else
+#define FLAG_SPECTRAL_MASK  0
+#endif
+// Set by the megakernel integrator on the primary ray when the visibility field holds the pixel's shadow ray counts. See USE_VISIBILITY_CACHE.
+#define FLAG_VISIBILITY     0x00008000
 
 // When using the AI denoiser the renderer builds an albedo buffer to improve the denoised result.
 // This should only be written once and this flag can track if that happened. This flag is persistent along the path.
@@ -65,11 +106,44 @@
 // Highest bit set means terminate path.
 #define FLAG_TERMINATE      0x80000000
 
+#if USE_COMPACT_PAYLOAD
+// The compact PerRayData keeps the first sampler dimension of the current path segment in these bits of the flags.
+#define FLAG_DIMENSION_SHIFT 17
+#define FLAG_DIMENSION_MASK  0x7FFE0000
+#endif
+
 // Keep flags active in a path segment which need to be tracked along the path.
 // In this case only the last surface interaction is kept.
 // It's needed to track the last bounce's diffuse state in case a ray hits a light implicitly for multiple importance sampling.
 // FLAG_DIFFUSE is reset in the closesthit program. 
-#define FLAG_CLEAR_MASK     (FLAG_DIFFUSE | FLAG_ALBEDO)
+#if USE_COMPACT_PAYLOAD
+#define FLAG_CLEAR_MASK     (FLAG_DIFFUSE | FLAG_RESAMPLED | FLAG_ALBEDO | FLAG_SPECTRAL_MASK | FLAG_DIMENSION_MASK)
+#else
+#define FLAG_CLEAR_MASK     (FLAG_DIFFUSE | FLAG_RESAMPLED | FLAG_ALBEDO | FLAG_SPECTRAL_MASK)
+#endif
+
+#if USE_RAY_CONES
+// Minimum spread angle of the ray cone after a diffuse bounce, in radians.
+// The diffuse lobe is integrated over many paths, so its texture lookups can be much blurrier than the pixel footprint.
+#define RAY_CONE_DIFFUSE_SPREAD 0.05f
+// Limits the footprint stretching at grazing angles.
+#define RAY_CONE_COSINE_MIN     0.01f
+#endif
+
+// The shading normal of the hit comes back in the payload for the denoiser normal buffer and for the normal AOV.
+#if (USE_DENOISER && USE_DENOISER_ALBEDO && USE_DENOISER_NORMAL) || USE_AOVS
+#define PAYLOAD_NORMAL 1
+#else
+#define PAYLOAD_NORMAL 0
+#endif
+
+// The material index of the hit comes back in the payload for the compact material stack, the wavefront path sorting
+// and the lookup of the heterogeneous medium inside a volume.
+#if MATERIAL_STACK_COMPACT || (USE_WAVEFRONT && USE_WAVEFRONT_SORT) || USE_HETEROGENEOUS_MEDIA
+#define PAYLOAD_MATERIAL_INDEX 1
+#else
+#define PAYLOAD_MATERIAL_INDEX 0
+#endif
 
 // Currently only containing some vertex attributes in world coordinates.
 struct State
@@ -77,13 +151,79 @@ struct State
   optix::float3 geoNormal;
   optix::float3 normal;
   optix::float3 texcoord;
+  optix::float3 wo;       // Outgoing direction, to observer.
 };
 
+#if USE_COMPACT_PAYLOAD
+// 112 instead of 160 bytes with all denoiser fields (sizes padded to the float4 alignment), 112 instead of 176 with the ray cone.
+// - The outgoing direction is not stored. The hit programs use the negated ray direction.
+// - The incoming direction is encoded octahedral in 32 bits.
+// - The sampler dimension is part of the flags.
+// - The denoiser albedo is returned in f_over_pdf, which gets the material albedo before the BSDF sampling overwrites it.
+//   The integrator reads it before the next segment. Light hits and misses terminate the path, so they can store theirs there as well.
+// - The denoiser normal is encoded octahedral in 32 bits.
+// - The unused opacity field is removed.
+// Note that the fields are ordered by CUDA alignment restrictions.
+struct PerRayData
+{
+  optix::float4 absorption_ior; // The absorption coefficient and IOR of the currently hit material.
+  optix::float2 ior;            // .x = IOR the ray currently is inside, .y = the IOR of the surrounding volume. The IOR of the current material is in absorption_ior.w!
+
+  optix::float3 pos;            // Current surface hit point or volume sample point, in world space
+  float         distance;       // Distance from the ray origin to the current position, in world space. Needed for absorption of nested materials.
+
+  optix::float3 radiance;       // Radiance along the current path segment.
+  unsigned int  wi;             // Octahedral incoming direction, to light, in world space. Use getWi() and setWi().
+
+  optix::float3 f_over_pdf;     // BSDF sample throughput, pre-multiplied f_over_pdf = bsdf.f * fabsf(dot(wi, ns) / bsdf.pdf; 
+  float         pdf;            // The last BSDF sample's pdf, tracked for multiple importance sampling.
+
+  optix::float3 extinction;     // The current volume's extinction coefficient. (Only absorption in this implementation.)
+  int           flags;          // Bitfield with flags and the sampler dimension. See FLAG_* defines for its contents.
+
+#if USE_RAY_CONES
+  unsigned int  cone;           // Ray cone width and spread angle at the ray origin as two half floats. Use getCone() and setCone().
+#endif
+
+#if USE_RADIANCE_CACHE
+  unsigned int  cacheCell;      // Radiance cache cell of a diffuse hit when FLAG_CACHE is set, RADIANCE_CACHE_NONE otherwise.
+#endif
+
+#if USE_VISIBILITY_CACHE
+  unsigned int  visibility;     // Visible shadow rays in the upper, traced shadow rays in the lower 16 bits when FLAG_VISIBILITY is set.
+#endif
+
+#if PAYLOAD_NORMAL
+  unsigned int  normal;         // Octahedral shading normal for the denoiser's normal buffer. Use getNormal() and setNormal().
+#endif
+
+#if USE_AOVS
+  int           aovMaterial;    // Material index of the hit, -2 - light index for lights, -1 for misses.
+  optix::float3 aovLights[AOV_LIGHT_GROUPS]; // Direct lighting of the hit per light group when FLAG_AOV_LIGHTS is set.
+#endif
+
+#if PAYLOAD_MATERIAL_INDEX
+  int           materialIndex;  // Index into sysMaterialParameters of the hit material. Pushed onto the material stack on volume entries.
+#endif
+
+#if USE_SPECTRAL
+  float         wavelength;     // Hero wavelength in nm when FLAG_SPECTRAL is set.
+#endif
+
+  unsigned int  seed;           // Random number generator input.
+
+  unsigned int  sampleScramble; // Per pixel scramble of the low-discrepancy sampler.
+  unsigned int  sampleIndex;    // Sample index of the low-discrepancy sampler. The iteration index.
+};
+#else
 // Note that the fields are ordered by CUDA alignment restrictions.
 struct PerRayData
 {
   optix::float4 absorption_ior; // The absorption coefficient and IOR of the currently hit material.
   optix::float2 ior;            // .x = IOR the ray currently is inside, .y = the IOR of the surrounding volume. The IOR of the current material is in absorption_ior.w!
+#if USE_RAY_CONES
+  optix::float2 cone;           // .x = ray cone width at the ray origin, in world space, .y = spread angle in radians.
+#endif
   
   optix::float3 pos;            // Current surface hit point or volume sample point, in world space
   float         distance;       // Distance from the ray origin to the current position, in world space. Needed for absorption of nested materials.
@@ -100,20 +240,155 @@ struct PerRayData
   optix::float3 extinction;     // The current volume's extinction coefficient. (Only absorption in this implementation.)
   float         opacity;        // Cutout opacity result.
 
+#if USE_RADIANCE_CACHE
+  unsigned int  cacheCell;      // Radiance cache cell of a diffuse hit when FLAG_CACHE is set, RADIANCE_CACHE_NONE otherwise.
+#endif
+
+#if USE_VISIBILITY_CACHE
+  unsigned int  visibility;     // Visible shadow rays in the upper, traced shadow rays in the lower 16 bits when FLAG_VISIBILITY is set.
+#endif
+
 #if USE_DENOISER
 #if USE_DENOISER_ALBEDO
   optix::float3 albedo;         // Albedo value to help the denoiser finding the correct result better.
-#if USE_DENOISER_NORMAL
-  optix::float3 normal;         // Shading normal for the denoiser's normal buffer. Only possible to use when albedo is used as well.
 #endif
 #endif
+#if PAYLOAD_NORMAL
+  optix::float3 normal;         // Shading normal for the denoiser's normal buffer and the normal AOV.
+#endif
+
+#if USE_AOVS
+  int           aovMaterial;    // Material index of the hit, -2 - light index for lights, -1 for misses.
+  optix::float3 aovLights[AOV_LIGHT_GROUPS]; // Direct lighting of the hit per light group when FLAG_AOV_LIGHTS is set.
+#endif
+
+#if PAYLOAD_MATERIAL_INDEX
+  int           materialIndex;  // Index into sysMaterialParameters of the hit material. Pushed onto the material stack on volume entries.
+#endif
+
+#if USE_SPECTRAL
+  float         wavelength;     // Hero wavelength in nm when FLAG_SPECTRAL is set.
 #endif
 
   unsigned int  seed;           // Random number generator input.
+
+  unsigned int  sampleScramble;  // Per pixel scramble of the low-discrepancy sampler.
+  unsigned int  sampleIndex;     // Sample index of the low-discrepancy sampler. The iteration index.
+  unsigned int  sampleDimension; // First sampler dimension of the current path segment. See sampler.h.
 };
+#endif
+
+#if defined(__CUDACC__)
+// Accessors for the PerRayData fields which are encoded in the compact payload.
+
+RT_FUNCTION optix::float3 getWi(PerRayData const& prd)
+{
+#if USE_COMPACT_PAYLOAD
+  return decodeOctahedral(prd.wi);
+#else
+  return prd.wi;
+#endif
+}
+
+RT_FUNCTION void setWi(PerRayData& prd, optix::float3 const& wi)
+{
+#if USE_COMPACT_PAYLOAD
+  prd.wi = encodeOctahedral(wi);
+#else
+  prd.wi = wi;
+#endif
+}
+
+#if USE_RAY_CONES
+// Both halves stay positive, the cone only widens along the path.
+RT_FUNCTION unsigned int encodeCone(optix::float2 const& cone)
+{
+  return (unsigned int) __half_as_ushort(__float2half_rn(cone.x)) | ((unsigned int) __half_as_ushort(__float2half_rn(cone.y)) << 16);
+}
+
+RT_FUNCTION optix::float2 decodeCone(const unsigned int bits)
+{
+  return optix::make_float2(__half2float(__ushort_as_half((unsigned short) (bits & 0xFFFF))),
+                            __half2float(__ushort_as_half((unsigned short) (bits >> 16))));
+}
+
+RT_FUNCTION optix::float2 getCone(PerRayData const& prd)
+{
+#if USE_COMPACT_PAYLOAD
+  return decodeCone(prd.cone);
+#else
+  return prd.cone;
+#endif
+}
+
+RT_FUNCTION void setCone(PerRayData& prd, optix::float2 const& cone)
+{
+#if USE_COMPACT_PAYLOAD
+  prd.cone = encodeCone(cone);
+#else
+  prd.cone = cone;
+#endif
+}
+
+// Texture level of detail of a ray cone with the given width hitting a triangle, without the log2 of the texture size.
+// uvLod is 0.5f * log2(texture coordinate area / world space area) of the triangle.
+RT_FUNCTION float getConeLod(const float width, const float cosTheta, const float uvLod)
+{
+  return uvLod + log2f(width / fmaxf(fabsf(cosTheta), RAY_CONE_COSINE_MIN));
+}
+#endif
+
+#if USE_DENOISER
+#if USE_DENOISER_ALBEDO
+// Must be called after the closest hit programs reset the f_over_pdf.
+RT_FUNCTION void setAlbedo(PerRayData& prd, optix::float3 const& albedo)
+{
+#if USE_COMPACT_PAYLOAD
+  prd.f_over_pdf = albedo;
+#else
+  prd.albedo = albedo;
+#endif
+}
+
+RT_FUNCTION optix::float3 getAlbedo(PerRayData const& prd)
+{
+#if USE_COMPACT_PAYLOAD
+  return prd.f_over_pdf;
+#else
+  return prd.albedo;
+#endif
+}
+
+#endif
+#endif
+
+#if PAYLOAD_NORMAL
+RT_FUNCTION void setNormal(PerRayData& prd, optix::float3 const& normal)
+{
+#if USE_COMPACT_PAYLOAD
+  prd.normal = encodeOctahedral(normal);
+#else
+  prd.normal = normal;
+#endif
+}
+
+RT_FUNCTION optix::float3 getNormal(PerRayData const& prd)
+{
+#if USE_COMPACT_PAYLOAD
+  return decodeOctahedral(prd.normal);
+#else
+  return prd.normal;
+#endif
+}
+#endif
+
+#endif // __CUDACC__
 
 struct PerRayData_shadow
 {
+#if USE_RAY_CONES
+  optix::float2 cone; // The ray cone of the path at the shadow ray origin, for the cutout opacity lookups.
+#endif
   unsigned int seed;
   bool         visible;
 };
@@ -0,0 +1,66 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#ifndef PIXEL_FILTER_H
+#define PIXEL_FILTER_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "lens_shader_type.h"
+
+#if USE_FILTER_IMPORTANCE_SAMPLING
+rtBuffer<float, 1> sysFilterTable; // FILTER_TABLE_SIZE + 1 offsets from the pixel center, see lens_shader_type.h.
+
+// Maps the uniform lens sample in [0, 1)^2 to the sub-pixel location of the primary ray, distributed like the
+// separable pixel filter. The location is relative to the lower left pixel corner like the uniform sample,
+// but reaches into the neighbours by the filter radius. The interpolation keeps the sampler's strata intact.
+RT_FUNCTION float2 filterPixelSample(const float2 sample)
+{
+  const float2 st = sample * float(FILTER_TABLE_SIZE);
+
+  const unsigned int x = optix::min(static_cast<unsigned int>(st.x), FILTER_TABLE_SIZE - 1u);
+  const unsigned int y = optix::min(static_cast<unsigned int>(st.y), FILTER_TABLE_SIZE - 1u);
+
+  return make_float2(0.5f + optix::lerp(sysFilterTable[x], sysFilterTable[x + 1], st.x - float(x)),
+                     0.5f + optix::lerp(sysFilterTable[y], sysFilterTable[y + 1], st.y - float(y)));
+}
+#else
+RT_FUNCTION float2 filterPixelSample(const float2 sample)
+{
+  return sample; // Box filter.
+}
+#endif
+
+#endif // PIXEL_FILTER_H
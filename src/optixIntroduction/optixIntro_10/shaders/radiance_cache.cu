@@ -0,0 +1,64 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "radiance_cache.h"
+
+rtDeclareVariable(int,   sysCacheReset, , );   // 1 == clear all cells instead.
+rtDeclareVariable(float, sysCacheHistory, , ); // Maximum number of iterations a cell averages. Adapts to scene changes.
+
+rtDeclareVariable(unsigned int, theLaunchIndex, rtLaunchIndex, );
+
+// 1D launch over all RADIANCE_CACHE_CELLS after each iteration.
+// Blends the samples of the iteration into the mean with an exponential moving average which starts as the exact mean.
+RT_PROGRAM void radiance_cache_update()
+{
+  if (sysCacheReset)
+  {
+    sysCacheKeys[theLaunchIndex]  = 0;
+    sysCacheAccum[theLaunchIndex] = make_float4(0.0f);
+    sysCacheValue[theLaunchIndex] = make_float4(0.0f);
+    return;
+  }
+
+  const float4 accum = sysCacheAccum[theLaunchIndex];
+  if (0.0f < accum.w)
+  {
+    const float4 value = sysCacheValue[theLaunchIndex];
+    const float  n     = fminf(value.w + 1.0f, sysCacheHistory);
+
+    sysCacheValue[theLaunchIndex] = make_float4(optix::lerp(make_float3(value), make_float3(accum) / accum.w, 1.0f / n), n);
+    sysCacheAccum[theLaunchIndex] = make_float4(0.0f);
+  }
+}
@@ -0,0 +1,99 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#ifndef RADIANCE_CACHE_H
+#define RADIANCE_CACHE_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+
+// Number of cells of the hash table. Must be a power of two. 36 MiB of device memory.
+#define RADIANCE_CACHE_CELLS (1 << 20)
+// Linear probing steps before a voxel without a free cell is not cached.
+#define RADIANCE_CACHE_PROBES 8
+// The first diffuse vertices of each path which feed their outgoing radiance into the cache.
+#define RADIANCE_CACHE_VERTICES 4
+// Iterations with samples a cell needs before paths terminate into it.
+#define RADIANCE_CACHE_MIN_ITERATIONS 2.0f
+
+#define RADIANCE_CACHE_NONE 0xFFFFFFFF
+
+#if defined(__CUDACC__)
+rtBuffer<unsigned int> sysCacheKeys;  // Fingerprint of the voxel occupying a cell. 0 == free.
+rtBuffer<float4>       sysCacheAccum; // Sum of the outgoing radiance samples of the current iteration in .xyz, their count in .w.
+rtBuffer<float4>       sysCacheValue; // Mean outgoing radiance in .xyz, number of iterations it averages in .w.
+
+rtDeclareVariable(float, sysCacheCellSize, , ); // Voxel edge length in world space.
+
+RT_FUNCTION unsigned int hashCache(unsigned int x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352d;
+  x ^= x >> 15;
+  x *= 0x846ca68b;
+  x ^= x >> 16;
+  return x;
+}
+
+// The cell of the voxel containing the point, separately for the six principal directions of the shading normal,
+// so that both sides of thin geometry don't share their radiance. Inserts the voxel when it's not in the table yet.
+RT_FUNCTION unsigned int findCacheCell(optix::float3 const& point, optix::float3 const& normal)
+{
+  const optix::float3 cell = point / sysCacheCellSize;
+  const optix::float3 a    = optix::make_float3(fabsf(normal.x), fabsf(normal.y), fabsf(normal.z));
+
+  unsigned int direction = (a.y <= a.x && a.z <= a.x) ? 0 : (a.z <= a.y) ? 2 : 4;
+  direction += (((direction == 0) ? normal.x : (direction == 2) ? normal.y : normal.z) < 0.0f) ? 1 : 0;
+
+  const unsigned int hash = hashCache((unsigned int) (int) floorf(cell.x) +
+                            hashCache((unsigned int) (int) floorf(cell.y) +
+                            hashCache((unsigned int) (int) floorf(cell.z) +
+                            hashCache(direction))));
+  const unsigned int key  = hashCache(hash ^ 0x9e3779b9) | 1; // Never 0.
+
+  for (unsigned int i = 0; i < RADIANCE_CACHE_PROBES; ++i)
+  {
+    const unsigned int index    = (hash + i) & (RADIANCE_CACHE_CELLS - 1);
+    const unsigned int previous = atomicCAS(&sysCacheKeys[index], 0, key);
+    if (previous == 0 || previous == key)
+    {
+      return index;
+    }
+  }
+  return RADIANCE_CACHE_NONE;
+}
+#endif // __CUDACC__
+
+#endif // RADIANCE_CACHE_H
@@ -0,0 +1,46 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef RAY_COUNTER_TYPE_H
+#define RAY_COUNTER_TYPE_H
+
+// Layout of the sysRayCounters buffer: One 64-bit counter per slot. Shared between host and device code.
+#define RAY_COUNTER_RADIANCE     0 // Radiance rays traced by the path tracers, including the primary rays.
+#define RAY_COUNTER_SHADOW       1 // Shadow rays of the direct lighting.
+#define RAY_COUNTER_ANYHIT       2 // Anyhit program invocations of both ray types.
+#define RAY_COUNTER_END_MISS     3 // Paths which left the scene without hitting the environment light.
+#define RAY_COUNTER_END_LIGHT    4 // Paths which hit a light or the environment light.
+#define RAY_COUNTER_END_CACHE    5 // Paths which ended in a populated radiance cache voxel.
+#define RAY_COUNTER_END_ABSORBED 6 // Paths whose BSDF sample returned no throughput.
+#define RAY_COUNTER_END_ROULETTE 7 // Paths terminated by Russian Roulette.
+#define RAY_COUNTER_END_LENGTH   8 // Paths which reached the maximum path length.
+#define RAY_COUNTER_SLOTS        9
+
+#endif // RAY_COUNTER_TYPE_H
@@ -0,0 +1,67 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef RAY_COUNTERS_H
+#define RAY_COUNTERS_H
+
+#include "app_config.h"
+
+#include <optix.h>
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+#include "ray_counter_type.h"
+
+#if USE_RAY_COUNTERS
+rtBuffer<unsigned long long> sysRayCounters; // RAY_COUNTER_SLOTS, read back and cleared by the host when presenting.
+
+// Adds one for the calling thread to the counter of its slot.
+// OptiX doesn't guarantee the warp layout of its programs, so no warp intrinsics are used here.
+RT_FUNCTION void countRay(const unsigned int slot)
+{
+  atomicAdd(&sysRayCounters[slot], 1ull);
+}
+
+// The termination cause of a path whose last segment returned these flags.
+RT_FUNCTION unsigned int terminationCounter(const int flags)
+{
+  if (!(flags & FLAG_TERMINATE))
+  {
+    return RAY_COUNTER_END_ABSORBED;
+  }
+  if (flags & FLAG_CACHED)
+  {
+    return RAY_COUNTER_END_CACHE;
+  }
+  return (flags & FLAG_LIGHT) ? RAY_COUNTER_END_LIGHT : RAY_COUNTER_END_MISS;
+}
+#endif
+
+#endif // RAY_COUNTERS_H
@@ -34,39 +34,137 @@
 #include "rt_function.h"
 #include "per_ray_data.h"
 #include "shader_common.h"
+#include "lens_shader.h"
+#include "lens_shader_type.h"
+#include "pixel_filter.h"
+#include "sampler.h"
+#include "spectral.h"
+#include "russian_roulette.h"
+#include "ray_counters.h"
+#include "cost_heatmap.h"
+#if USE_RESTIR
+#include "reservoir.h"
+#endif
+#if USE_RADIANCE_CACHE
+#include "radiance_cache.h"
+#endif
+#if USE_MULTI_VIEW
+#include "multi_view.h"
+#endif
+#include "aov.h"
+#include "material_stack.h"
+#if MATERIAL_STACK_COMPACT || USE_HETEROGENEOUS_MEDIA
+#include "material_parameter.h"
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+#include "medium.h"
+#endif
 
 #include "rt_assert.h"
 
 rtBuffer<float4, 2> sysOutputBuffer; // RGBA32F
 
-#if USE_DENOISER
+#if MATERIAL_STACK_COMPACT || USE_HETEROGENEOUS_MEDIA
+rtBuffer<MaterialParameter> sysMaterialParameters; // The absorption and IOR of the volumes on the material stack.
+#endif
+
+#if USE_HETEROGENEOUS_MEDIA
+rtBuffer<MediumDefinition> sysMedia; // The density grids of the media referenced by MaterialParameter::medium.
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+rtBuffer<float, 2>  sysMomentBuffer;  // Running mean of the squared radiance intensity per pixel. Used for the variance estimate.
+rtBuffer<uint2, 1>  sysActiveTiles;   // Tile coordinates of the unconverged tiles. The adaptive launch is 1D over these tiles' pixels.
+#endif
+
+#if USE_TILED_LAUNCH
+rtDeclareVariable(uint2, sysTileOffset, , ); // Pixel coordinate of the lower left corner of the current tile launch.
+#endif
+
+#if USE_REPROJECTION
+rtBuffer<float4, 2> sysPositionBuffer;    // Primary hit of the first sample per pixel, w == 1.0f. Misses store the direction, w == 0.0f.
+rtBuffer<float, 2>  sysSampleCountBuffer; // Number of samples accumulated per pixel, including the reprojected history.
+rtDeclareVariable(int, sysReprojection, , ); // 0 == off, 1 == track the per pixel data, 2 == continue the reprojected history.
+#endif
+
+#if USE_RASTER_PRIMARY
+// The primary rays may start this much closer than the rasterized distance. Covers the interpolation differences.
+#define RASTER_DISTANCE_TOLERANCE 0.001f
+
+rtBuffer<float, 2> sysRasterDistance; // Distance from the camera to the nearest rasterized surface per pixel. RT_DEFAULT_MAX where nothing was rasterized.
+rtDeclareVariable(int,    sysRasterPrimary, , ); // 0 == off, 1 == the pinhole primary rays start at sysRasterDistance.
+rtDeclareVariable(float2, sysRasterJitter, , );  // The sub-pixel location the current iteration was rasterized at.
+#endif
+
+#if USE_RESTIR
+rtBuffer<Reservoir, 2> sysReservoirs; // The closest hit programs write the reservoirs of the resampled primary hits.
+rtDeclareVariable(int, sysRestir, , ); // 0 == off, 1 == resample the direct lighting of the diffuse primary hits.
+#endif
+
+#if USE_VISIBILITY_CACHE
+rtBuffer<uint2, 2> sysVisibilityCounts; // .x = epoch the counts belong to, .y = the visibility field of the primary hit.
+rtDeclareVariable(int,          sysVisibilityCache, , ); // 0 == off, 1 == count and reuse the primary hit shadow ray visibility.
+rtDeclareVariable(unsigned int, sysVisibilityEpoch, , ); // Incremented by each restart of the accumulation.
+#endif
+
+#if USE_RADIANCE_CACHE
+rtDeclareVariable(int, sysRadianceCache, , ); // 0 == off, otherwise the number of diffuse bounces before paths terminate into the cache.
+#endif
+
+#if USE_MULTI_VIEW || USE_WEDGE
+// The 3D launches. (x, y) is the pixel inside the view or the screen, z is the index into sysViews or the wedge variant.
+rtDeclareVariable(uint3, theLaunchIndex3D, rtLaunchIndex, );
+rtDeclareVariable(uint3, theLaunchDim3D,   rtLaunchDim, );
+#endif
+
+#if USE_MULTI_VIEW
+rtBuffer<ViewDefinition, 1> sysViews; // The cameras and output sub-rectangles of the views in the ENTRY_RENDER_VIEWS launch.
+#endif
+
+#if USE_WEDGE
+rtBuffer<float4, 3> sysWedgeBuffer; // RGBA32F accumulation per pixel and material variant.
+rtDeclareVariable(int, sysWedgeVariant, , ); // The displayed variant, which also fills the denoiser guide buffers.
+#endif
+
+// With USE_DENOISER_GBUFFER the guide buffers are filled by the gbuffer() launch instead.
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
 rtBuffer<float4, 2> sysAlbedoBuffer; // RGBA32F
 #if USE_DENOISER_NORMAL
 rtBuffer<float4, 2> sysNormalBuffer; // xyz0
-// For the denoiser normal transformation into camera space.
-rtDeclareVariable(float3, sysCameraU, , );
-rtDeclareVariable(float3, sysCameraV, , );
-rtDeclareVariable(float3, sysCameraW, , );
 #endif
 #endif
 #endif
 
+// For the pinhole fast path and the denoiser normal transformation into camera space.
+rtDeclareVariable(float3, sysCameraPosition, , );
+rtDeclareVariable(float3, sysCameraU, , );
+rtDeclareVariable(float3, sysCameraV, , );
+rtDeclareVariable(float3, sysCameraW, , );
+
 rtDeclareVariable(rtObject, sysTopObject, , );
 rtDeclareVariable(float,    sysSceneEpsilon, , );
 rtDeclareVariable(int2,     sysPathLengths, , );
 rtDeclareVariable(int,      sysIterationIndex, , );
+#if USE_SAMPLES_PER_LAUNCH
+rtDeclareVariable(int,      sysSamplesPerLaunch, , ); // Samples per pixel of one ENTRY_RENDER, adaptive or tile launch. sysIterationIndex is the first one.
+#endif
 rtDeclareVariable(int,      sysCameraType, , );
 rtDeclareVariable(int,      sysShutterType, , );
+#if USE_STRATIFIED_SHUTTER
+rtDeclareVariable(int,      sysTimeSlices, , ); // Number of launches sharing the shutter interval, see sampleShutterTime().
+#endif
 
 // Bindless callable programs implementing different lens shaders.
-rtBuffer< rtCallableProgramId<void(const float2 pixel, const float2 screen, const float2 sample, float3& origin, float3& direction)> > sysLensShader;
+rtBuffer< rtCallableProgramId<void(const float2 pixel, const float2 screen, const float2 sample, const float2 aperture, float3& origin, float3& direction)> > sysLensShader;
+
+rtDeclareVariable(uint2, sysResolution, , ); // The rendered sub-rectangle of the output buffers. Smaller than their size while resizing.
 
 rtDeclareVariable(uint2, theLaunchDim,   rtLaunchDim, );
 rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
 
-RT_FUNCTION void integrator(PerRayData& prd, float3& radiance
-#if USE_DENOISER
+RT_FUNCTION void integrator(const uint2 pixel, const uint2 screen, PerRayData& prd, float3& radiance
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
                            , float3& albedo
 #if USE_DENOISER_NORMAL
@@ -74,42 +172,64 @@ RT_FUNCTION void integrator(PerRayData& prd, float3& radiance
 #endif
 #endif
 #endif
+#if USE_REPROJECTION
+                           , float4& position
+#endif
+#if USE_AOVS
+                           , AovSample& aov
+#endif
 )
 {
   // This renderer supports nested volumes. Four levels is plenty enough for most cases.
+#if MATERIAL_STACK_COMPACT
+  // The material indices of the volumes, innermost first.
+  MaterialStack materialStack;
+  initMaterialStack(materialStack);
+#else
   // The absorption coefficient and IOR of the volume the ray is currently inside.
   float4 absorptionStack[MATERIAL_STACK_SIZE]; // .xyz == absorptionCoefficient (sigma_a), .w == index of refraction
+#if USE_HETEROGENEOUS_MEDIA
+  int    mediumStack[MATERIAL_STACK_SIZE];     // MaterialParameter::medium of the volumes, -1 == homogeneous.
+#endif
+#endif
 
   radiance = make_float3(0.0f); // Start with black.
 
-#if USE_DENOISER
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
   albedo   = make_float3(0.0f); // Start with black.
 #if USE_DENOISER_NORMAL
   normal     = make_float3(0.0f); // Start with null vector.
+#if !USE_COMPACT_PAYLOAD
   prd.normal = make_float3(0.0f); // Start with null vector. Important if nothing is hit!
 #endif
 #endif
+#endif
 #endif
 
   // case 0: Standard stochastic motion blur.
-  float time = rng(prd.seed); // Set the time of this path to a random value in the range [0, 1).
+#if USE_STRATIFIED_SHUTTER
+  // The rolling shutters only use the value for antialiasing inside a row or column. Time slices don't apply there.
+  float time = sampleShutterTime(prd, (sysShutterType == 0) ? sysTimeSlices : 1);
+#else
+  float time = sample1D(prd, SAMPLE_TIME); // Set the time of this path to a random value in the range [0, 1).
+#endif
   
   switch (sysShutterType) // In case another camera shutter is active reuse that random value.
   {
     case 1: // Rolling shutter from top to bottom. 
-      // Note that launchIndex (0, 0) is as the bottom left corner, which matches what OpenGL expects as texture orientation.
+      // Note that pixel (0, 0) is as the bottom left corner, which matches what OpenGL expects as texture orientation.
       // Each row gets a different time plus some stochastic antialiasing on that line.
-      time = (float(theLaunchDim.y - 1 - theLaunchIndex.y) + time) / float(theLaunchDim.y);
+      time = (float(screen.y - 1 - pixel.y) + time) / float(screen.y);
       break;
     case 2: // Rolling shutter from bottom to top. 
-      time = (float(theLaunchIndex.y) + time) / float(theLaunchDim.y);
+      time = (float(pixel.y) + time) / float(screen.y);
       break;
     case 3: // Rolling shutter from left to right.
-      time = (float(theLaunchIndex.x) + time) / float(theLaunchDim.x);
+      time = (float(pixel.x) + time) / float(screen.x);
       break;
     case 4: // Rolling shutter from right to left.
-      time = (float(theLaunchDim.x - 1 - theLaunchIndex.x) + time) / float(theLaunchDim.x);
+      time = (float(screen.x - 1 - pixel.x) + time) / float(screen.x);
       break;
   }
         
@@ -122,43 +242,253 @@ RT_FUNCTION void integrator(PerRayData& prd, float3& radiance
  
   prd.flags = 0;
 
+#if USE_SPECTRAL
+  bool monochromatic = false; // Set once the throughput only carries the hero wavelength.
+  if (sysSpectral)
+  {
+    prd.flags     |= FLAG_SPECTRAL;
+    prd.wavelength = sampleWavelength(prd);
+  }
+#endif
+
+#if USE_RADIANCE_CACHE
+  // The outgoing radiance of the first diffuse vertices is the path radiance gathered after them divided by their throughput.
+  unsigned int cacheCells[RADIANCE_CACHE_VERTICES];
+  float3       cacheThroughput[RADIANCE_CACHE_VERTICES];
+  float3       cacheRadiance[RADIANCE_CACHE_VERTICES]; // The path radiance before the vertex.
+  int          cacheVertices  = 0;
+  int          diffuseBounces = 0;
+#endif
+
+  // The weight window compares the path throughput against the current estimate of this pixel.
+  const float pixelMean = (sysRouletteType == ROULETTE_WEIGHT_WINDOW && 0 < sysIterationIndex) ? intensity3(sysOutputBuffer[pixel]) : 0.0f;
+
   // Russian Roulette path termination after a specified number of bounces needs the current depth.
   while (depth < sysPathLengths.y)
   {
+    setSamplerBounce(prd, depth); // All samples of this path segment use the dimensions of this depth.
+
+#if USE_PATH_STATISTICS
+    recordPathStatistic(depth, PATH_STATISTICS_PATHS, 1.0f);
+#endif
+
+#if !USE_COMPACT_PAYLOAD
     prd.wo        = -prd.wi;           // Direction to observer.
+#endif
     prd.ior       = make_float2(1.0f); // Reset the volume IORs.
     prd.distance  = RT_DEFAULT_MAX;    // Shoot the next ray with maximum length.
     prd.flags    &= FLAG_CLEAR_MASK;   // Clear all non-persistent flags. In this demo only the last diffuse surface interaction stays.
+#if USE_RESTIR
+    if (depth == 0 && sysRestir)
+    {
+      prd.flags |= FLAG_PRIMARY;
+    }
+#endif
+#if USE_VISIBILITY_CACHE
+    if (depth == 0 && sysVisibilityCache)
+    {
+      const uint2 entry = sysVisibilityCounts[pixel];
+
+      prd.flags     |= FLAG_VISIBILITY;
+      prd.visibility = (entry.x == sysVisibilityEpoch) ? entry.y : 0; // Counts of an earlier accumulation start over.
+    }
+#endif
+#if USE_RADIANCE_CACHE
+    if (sysRadianceCache)
+    {
+      prd.flags    |= (sysRadianceCache <= diffuseBounces) ? (FLAG_CACHE | FLAG_CACHE_QUERY) : FLAG_CACHE;
+      prd.cacheCell = RADIANCE_CACHE_NONE; // Misses, lights and specular hits don't set it.
+    }
+#endif
+#if USE_AOVS
+    if (sysAovMask)
+    {
+      initAovSegment(prd, depth);
+    }
+#endif
+
+#if USE_HETEROGENEOUS_MEDIA
+    int medium = -1; // The heterogeneous medium of the volume the ray is inside.
+#endif
 
     // Handle volume absorption of nested materials.
     if (MATERIAL_STACK_FIRST <= stackIdx) // Inside a volume?
     {
       prd.flags     |= FLAG_VOLUME;                            // Indicate that we're inside a volume. => At least absorption calculation needs to happen.
+#if MATERIAL_STACK_COMPACT
+      const int inner = innerMaterial(materialStack);
+      prd.extinction = sysMaterialParameters[inner].absorption; // There is only volume absorption in this demo, no volume scattering.
+      prd.ior.x      = sysMaterialParameters[inner].ior;        // The IOR of the volume we're inside. Needed for eta calculations in transparent materials.
+      if (MATERIAL_STACK_FIRST <= stackIdx - 1)
+      {
+        prd.ior.y = sysMaterialParameters[outerMaterial(materialStack)].ior; // The IOR of the surrounding volume. Needed when potentially leaving a volume to calculate eta in transparent materials.
+      }
+#if USE_HETEROGENEOUS_MEDIA
+      medium = sysMaterialParameters[inner].medium;
+#endif
+#if USE_SPECTRAL
+      if (prd.flags & FLAG_MONOCHROMATIC) // The stack only holds material indices, disperse their IORs at the hero wavelength.
+      {
+        prd.ior.x = dispersedIor(prd.ior.x, sysMaterialParameters[inner].abbe, prd.wavelength);
+        if (MATERIAL_STACK_FIRST <= stackIdx - 1)
+        {
+          const int outer = outerMaterial(materialStack);
+          prd.ior.y = dispersedIor(prd.ior.y, sysMaterialParameters[outer].abbe, prd.wavelength);
+        }
+      }
+#endif
+#else
       prd.extinction = make_float3(absorptionStack[stackIdx]); // There is only volume absorption in this demo, no volume scattering.
       prd.ior.x      = absorptionStack[stackIdx].w;            // The IOR of the volume we're inside. Needed for eta calculations in transparent materials.
       if (MATERIAL_STACK_FIRST <= stackIdx - 1)
       {
         prd.ior.y = absorptionStack[stackIdx - 1].w; // The IOR of the surrounding volume. Needed when potentially leaving a volume to calculate eta in transparent materials.
       }
+#if USE_HETEROGENEOUS_MEDIA
+      medium = mediumStack[stackIdx];
+#endif
+#endif
     }
 
     // Note that the primary rays (or volume scattering miss cases) wouldn't normally offset the ray t_min by sysSceneEpsilon. Keep it simple here.
-    optix::Ray ray = optix::make_Ray(prd.pos, prd.wi, 0, sysSceneEpsilon, prd.distance);
+    float tMin = sysSceneEpsilon;
+#if USE_RASTER_PRIMARY
+    if (depth == 0 && sysRasterPrimary)
+    {
+      // The rasterizer found nothing closer along this ray, so only the surface near the rasterized distance is left to intersect.
+      tMin = fmaxf(sysSceneEpsilon, sysRasterDistance[pixel] * (1.0f - RASTER_DISTANCE_TOLERANCE));
+    }
+#endif
+    optix::Ray ray = optix::make_Ray(prd.pos, getWi(prd), 0, tMin, prd.distance);
     // Note that this time defines the semantic variable rtCurrentTime in the other program domains.
+#if USE_RAY_COUNTERS
+    countRay(RAY_COUNTER_RADIANCE);
+#endif
     rtTrace(sysTopObject, ray, time, prd); 
 
+#if USE_VISIBILITY_CACHE
+    if (depth == 0 && sysVisibilityCache)
+    {
+      sysVisibilityCounts[pixel] = make_uint2(sysVisibilityEpoch, prd.visibility); // Unchanged unless the hit traced shadow rays.
+    }
+#endif
+
+#if USE_RESTIR
+    if (depth == 0 && sysRestir && !(prd.flags & FLAG_RESAMPLED))
+    {
+      // Misses, lights and specular primary hits leave an empty reservoir, which the neighbours never reuse.
+      Reservoir reservoir;
+
+      reservoir.light = -1;
+      reservoir.M     = 0.0f;
+      reservoir.W     = 0.0f;
+
+      sysReservoirs[pixel] = reservoir;
+    }
+#endif
+
+#if USE_HETEROGENEOUS_MEDIA
+    if (0 <= medium)
+    {
+      MediumDefinition const& definition = sysMedia[medium];
+
+      if (isNull(definition.albedo)) // Purely absorbing, only the transmittance to the hit is needed.
+      {
+        throughput *= ratioTrackTransmittance(definition, ray.origin, ray.direction, tMin, prd.distance, prd.seed);
+      }
+      else
+      {
+        float t;
+        if (sampleFreeFlight(definition, ray.origin, ray.direction, tMin, prd.distance, prd.seed, t))
+        {
+          // Real collision before the surface: Replace the hit by a scattering event inside the volume.
+          // The free-flight pdf cancels sigma_t, what remains is the scattering albedo, the phase function sample has weight one.
+          // The collision is neither diffuse nor a transmission, so the next light hit gets no MIS and the stack stays unchanged.
+          prd.distance   = t;
+          prd.pos        = ray.origin + t * ray.direction;
+          prd.radiance   = make_float3(0.0f);
+          setWi(prd, sampleHenyeyGreenstein(ray.direction, definition.anisotropy, sample2D(prd, SAMPLE_BSDF)));
+          prd.f_over_pdf = definition.albedo;
+          prd.pdf        = 1.0f;
+          prd.flags      = (prd.flags & (FLAG_CLEAR_MASK & ~(FLAG_DIFFUSE | FLAG_RESAMPLED))) | FLAG_VOLUME;
+#if USE_SPECTRAL
+          if (!monochromatic) // A dispersive surface behind the collision didn't happen.
+          {
+            prd.flags &= ~FLAG_MONOCHROMATIC;
+          }
+#endif
+#if USE_RADIANCE_CACHE
+          prd.cacheCell  = RADIANCE_CACHE_NONE;
+#endif
+#if USE_AOVS
+          prd.aovMaterial = -1;
+#endif
+        }
+      }
+    }
+#endif
+
     // This renderer supports nested volumes.
     if (prd.flags & FLAG_VOLUME)
     {
       // We're inside a volume. Calculate the extinction along the current path segment in any case.
       // The transmittance along the current path segment inside a volume needs to attenuate the ray throughput with the extinction
       // before it modulates the radiance of the hitpoint.
+#if USE_SPECTRAL
+      if (monochromatic)
+      {
+        throughput *= spectralScale(expf(-prd.distance * prd.extinction), prd.wavelength);
+      }
+      else
+#endif
       throughput *= expf(-prd.distance * prd.extinction);
     }
 
+#if USE_RADIANCE_CACHE
+    if (sysRadianceCache && prd.cacheCell != RADIANCE_CACHE_NONE && !(prd.flags & FLAG_CACHED))
+    {
+      if (cacheVertices < RADIANCE_CACHE_VERTICES)
+      {
+        cacheCells[cacheVertices]      = prd.cacheCell;
+        cacheThroughput[cacheVertices] = throughput;
+        cacheRadiance[cacheVertices]   = radiance;
+        ++cacheVertices;
+      }
+      ++diffuseBounces;
+    }
+#endif
+
+#if USE_SPECTRAL
+    if (monochromatic)
+    {
+      radiance += throughput * spectralScale(prd.radiance, prd.wavelength);
+    }
+    else
+#endif
     radiance += throughput * prd.radiance;
 
-#if USE_DENOISER
+#if USE_AOVS
+    if (sysAovMask)
+    {
+      recordAovSegment(aov, prd, depth, throughput);
+    }
+#endif
+
+#if USE_REPROJECTION
+    if (depth == 0) // The miss programs leave prd.pos and the direction untouched.
+    {
+      position = (prd.flags & FLAG_HIT) ? make_float4(prd.pos, 1.0f) : make_float4(getWi(prd), 0.0f);
+    }
+#endif
+
+#if USE_PATH_STATISTICS
+    if (isNotNull(prd.radiance))
+    {
+      recordPathStatistic(depth, PATH_STATISTICS_RADIANCE, intensity(throughput * prd.radiance));
+    }
+#endif
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
     // In physical terms, the albedo is a single color value approximating the ratio of radiant exitance to the irradiance under uniform lighting.
     // The albedo value can be approximated for simple materials by using the diffuse color of the first hit,
@@ -172,7 +502,7 @@ RT_FUNCTION void integrator(PerRayData& prd, float3& radiance
     {
       // The albedo buffer should contain the surface appearance under uniform lighting in linear color space in the range [0.0f, 1.0f].
       // Clamp the final albedo result to that range here, because it captured the radiance when hitting lights either directly or via specular events.
-      albedo = optix::clamp(throughput * prd.albedo, 0.0f, 1.0f);
+      albedo = optix::clamp(throughput * getAlbedo(prd), 0.0f, 1.0f);
 
       prd.flags |= FLAG_ALBEDO; // This flag is persistent along the path and prevents that the albedo is written more than once.
     }
@@ -192,9 +522,11 @@ RT_FUNCTION void integrator(PerRayData& prd, float3& radiance
       // independently of the UVW vector lengths.
       // The end result looks like a normal map without scale and bias.
       // Normals pointing at the camera position will be blue.
-      normal = make_float3( optix::dot(prd.normal, optix::normalize(sysCameraU)), 
-                            optix::dot(prd.normal, optix::normalize(sysCameraV)), 
-                           -optix::dot(prd.normal, optix::normalize(sysCameraW))); // Negative W to make it right-handed.
+      const float3 normalWorld = getNormal(prd);
+
+      normal = make_float3( optix::dot(normalWorld, optix::normalize(sysCameraU)), 
+                            optix::dot(normalWorld, optix::normalize(sysCameraV)), 
+                           -optix::dot(normalWorld, optix::normalize(sysCameraW))); // Negative W to make it right-handed.
     }
 #endif
 #endif
@@ -204,18 +536,43 @@ RT_FUNCTION void integrator(PerRayData& prd, float3& radiance
     // If terminate is true, f_over_pdf and pdf might be undefined.
     if ((prd.flags & FLAG_TERMINATE) || prd.pdf <= 0.0f || isNull(prd.f_over_pdf))
     {
+#if USE_RAY_COUNTERS
+      countRay(terminationCounter(prd.flags));
+#endif
       break;
     }
 
     // PERF f_over_pdf already contains the proper throughput adjustment for diffuse materials: f * (fabsf(optix::dot(prd.wi, state.normal)) / prd.pdf);
+#if USE_SPECTRAL
+    if (monochromatic)
+    {
+      throughput *= spectralScale(prd.f_over_pdf, prd.wavelength);
+    }
+    else if (prd.flags & FLAG_MONOCHROMATIC) // First dispersive interface. Only the hero wavelength continues.
+    {
+      throughput *= spectralWeight(prd.wavelength) * spectralValue(prd.f_over_pdf, prd.wavelength);
+      monochromatic = true;
+    }
+    else
+#endif
     throughput *= prd.f_over_pdf;
 
     // Unbiased Russian Roulette path termination.
     if (sysPathLengths.x <= depth) // Start termination after a minimum number of bounces.
     {
-      const float probability = fmaxf(throughput); // DAR Other options: // intensity(throughput); // fminf(0.5f, intensity(throughput));
-      if (probability < rng(prd.seed)) // Paths with lower probability to continue are terminated earlier.
+      const float probability = continuationProbability(throughput, pixelMean); // Strategy selected by sysRouletteType.
+#if USE_PATH_STATISTICS
+      recordPathStatistic(depth, PATH_STATISTICS_TESTS, 1.0f);
+      recordPathStatistic(depth, PATH_STATISTICS_PROBABILITY, probability);
+#endif
+      if (probability < sample1D(prd, SAMPLE_RR)) // Paths with lower probability to continue are terminated earlier.
       {
+#if USE_PATH_STATISTICS
+        recordPathStatistic(depth, PATH_STATISTICS_TERMINATED, 1.0f);
+#endif
+#if USE_RAY_COUNTERS
+        countRay(RAY_COUNTER_END_ROULETTE);
+#endif
         break;
       }
       throughput /= probability; // Path isn't terminated. Adjust the throughput so that the average is right again.
@@ -230,56 +587,116 @@ RT_FUNCTION void integrator(PerRayData& prd, float3& radiance
       {
         // Push the entered material's volume properties onto the volume stack.
         //rtAssert((stackIdx < MATERIAL_STACK_LAST), 1); // Overflow?
+#if MATERIAL_STACK_COMPACT
+        pushMaterial(materialStack, prd.materialIndex, stackIdx == MATERIAL_STACK_LAST);
+        stackIdx = min(stackIdx + 1, MATERIAL_STACK_LAST);
+#else
         stackIdx = min(stackIdx + 1, MATERIAL_STACK_LAST);
         absorptionStack[stackIdx] = prd.absorption_ior;
+#if USE_HETEROGENEOUS_MEDIA
+        mediumStack[stackIdx] = sysMaterialParameters[prd.materialIndex].medium;
+#endif
+#endif
       }
       else // Exited the current volume?
       {
         // Pop the top of stack material volume.
         // This assert fires and is intended because I tuned the frontface checks so that there are more exits than enters at silhouettes.
         //rtAssert((MATERIAL_STACK_EMPTY < stackIdx), 0); // Underflow?
+#if MATERIAL_STACK_COMPACT
+        if (MATERIAL_STACK_FIRST <= stackIdx)
+        {
+          popMaterial(materialStack);
+        }
+#endif
         stackIdx = max(stackIdx - 1, MATERIAL_STACK_EMPTY);
       }
     }
 
     ++depth; // Next path segment.
   }
-}
-
-RT_PROGRAM void raygeneration()
-{
-  PerRayData prd;
 
-  // Initialize the random number generator seed from the linear pixel index and the iteration index.
-  prd.seed = tea<8>(theLaunchIndex.y * theLaunchDim.x + theLaunchIndex.x, sysIterationIndex);
+#if USE_RAY_COUNTERS
+  if (sysPathLengths.y <= depth) // Only the loop condition ends the path there, all other terminations break out before.
+  {
+    countRay(RAY_COUNTER_END_LENGTH);
+  }
+#endif
 
-  // DAR Decoupling the pixel coordinates from the screen size will allow for partial rendering algorithms.
-  // In this case theLaunchIndex is the pixel coordinate and theLaunchDim is sysOutputBuffer.size().
-  sysLensShader[sysCameraType](make_float2(theLaunchIndex), make_float2(theLaunchDim), rng2(prd.seed), prd.pos, prd.wi); // Calculate the primary ray with a lens shader program.
+#if USE_RADIANCE_CACHE
+  for (int i = 0; i < cacheVertices; ++i)
+  {
+    const float3 t = cacheThroughput[i];
+    if (0.0f < t.x && 0.0f < t.y && 0.0f < t.z)
+    {
+      const float3 outgoing = (radiance - cacheRadiance[i]) / t;
+      if (!(isnan(outgoing.x) || isnan(outgoing.y) || isnan(outgoing.z) || isinf(outgoing.x) || isinf(outgoing.y) || isinf(outgoing.z)))
+      {
+        float4* cell = &sysCacheAccum[cacheCells[i]];
+        atomicAdd(&cell->x, outgoing.x);
+        atomicAdd(&cell->y, outgoing.y);
+        atomicAdd(&cell->z, outgoing.z);
+        atomicAdd(&cell->w, 1.0f);
+      }
+    }
+  }
+#endif
+}
 
+// The results of one or more primary rays of a pixel, before they are blended into the output buffers.
+struct PixelSample
+{
   float3 radiance;
-
-#if USE_DENOISER
+#if USE_ADAPTIVE_SAMPLING
+  float  moment; // Mean squared radiance intensity of the samples.
+#endif
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
   float3 albedo;
 #if USE_DENOISER_NORMAL
   float3 normal;
 #endif
 #endif
+#endif
+#if USE_REPROJECTION
+  float4 position; // Of the first sample.
+#endif
+#if USE_AOVS
+  AovSample aov;
+#endif
+};
+
+// Integrates the primary ray which was set up inside the prd.
+// Returns false when the result must not be accumulated.
+RT_FUNCTION bool integrateSample(const uint2 pixel, const uint2 screen, PerRayData& prd, PixelSample& sample)
+{
+#if USE_REPROJECTION
+  sample.position = make_float4(0.0f); // Counts as a miss in the direction null when no path segment was traced.
+#endif
+#if USE_AOVS
+  initAovSample(sample.aov);
 #endif
 
   // In this case a unidirectional path tracer.
-  integrator(prd, radiance
-#if USE_DENOISER
+  integrator(pixel, screen, prd, sample.radiance
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
-            , albedo
+            , sample.albedo
 #if USE_DENOISER_NORMAL
-            , normal
+            , sample.normal
 #endif
 #endif
+#endif
+#if USE_REPROJECTION
+            , sample.position
+#endif
+#if USE_AOVS
+            , sample.aov
 #endif
   );
 
+  float3& radiance = sample.radiance;
+
 #if USE_DEBUG_EXCEPTIONS
   // DAR DEBUG Highlight numerical errors.
   if (isnan(radiance.x) || isnan(radiance.y) || isnan(radiance.z))
@@ -297,46 +714,503 @@ RT_PROGRAM void raygeneration()
 #else
   // NaN values will never go away. Filter them out before they can arrive in the output buffer.
   // This only has an effect if the debug coloring above is off!
-  if (!(isnan(radiance.x) || isnan(radiance.y) || isnan(radiance.z)))
+  if (isnan(radiance.x) || isnan(radiance.y) || isnan(radiance.z))
+  {
+    return false;
+  }
 #endif
+
+#if USE_ADAPTIVE_SAMPLING
+  const float m = intensity(radiance);
+  sample.moment = m * m;
+#endif
+  return true;
+}
+
+// Blends the mean of count samples into the output buffers at the given pixel of the full screen resolution.
+RT_FUNCTION void accumulatePixel(const uint2 pixel, const PixelSample& sample, const float count)
+{
+  const float3 radiance = sample.radiance;
+
+  float samples = (float) sysIterationIndex; // Number of samples already accumulated in this pixel.
+
+#if USE_REPROJECTION
+  if (sysReprojection == 2) // After a camera change the pixels continue with different numbers of reprojected samples.
   {
-    if (0 < sysIterationIndex)
+    samples = sysSampleCountBuffer[pixel];
+  }
+  if (sysReprojection != 0)
+  {
+    sysSampleCountBuffer[pixel] = samples + count;
+    if (samples == 0.0f) // The disocclusion test of the next reprojection compares against this.
     {
-      const float t = 1.0f / (float) (sysIterationIndex + 1);
+      sysPositionBuffer[pixel] = sample.position;
+    }
+  }
+#endif
+
+#if USE_AOVS
+  if (sysAovMask) // The AOVs keep their own sample count. They are neither reprojected nor stored in checkpoints.
+  {
+    accumulateAovs(pixel, sample.aov, count);
+  }
+#endif
+
+  if (0.0f < samples)
+  {
+    const float t = count / (samples + count);
 
-      float3 dst = make_float3(sysOutputBuffer[theLaunchIndex]);  // RGBA32F
-      sysOutputBuffer[theLaunchIndex] = make_float4(optix::lerp(dst, radiance, t), 1.0f);
+    float3 dst = make_float3(sysOutputBuffer[pixel]);  // RGBA32F
+    sysOutputBuffer[pixel] = make_float4(optix::lerp(dst, radiance, t), 1.0f);
 
-#if USE_DENOISER
+#if USE_ADAPTIVE_SAMPLING
+    sysMomentBuffer[pixel] = optix::lerp(sysMomentBuffer[pixel], sample.moment, t);
+#endif
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
-      dst = make_float3(sysAlbedoBuffer[theLaunchIndex]);  // RGBA32F
-      sysAlbedoBuffer[theLaunchIndex] = make_float4(optix::lerp(dst, albedo, t), 1.0f);
+    dst = make_float3(sysAlbedoBuffer[pixel]);  // RGBA32F
+    sysAlbedoBuffer[pixel] = make_float4(optix::lerp(dst, sample.albedo, t), 1.0f);
 #if USE_DENOISER_NORMAL
-      dst = make_float3(sysNormalBuffer[theLaunchIndex]); // xyz0
-      dst = optix::lerp(dst, normal, t);
-      if (isNotNull(dst))
+    dst = make_float3(sysNormalBuffer[pixel]); // xyz0
+    dst = optix::lerp(dst, sample.normal, t);
+    if (isNotNull(dst))
+    {
+      dst = optix::normalize(dst);
+    }
+    sysNormalBuffer[pixel] = make_float4(dst, 0.0f);
+#endif
+#endif
+#endif
+  }
+  else
+  {
+    // The first sample will fill the buffer.
+    // If this isn't done separately, the result of the lerp() above is undefined, e.g. dst could be NaN.
+    sysOutputBuffer[pixel] = make_float4(radiance, 1.0f);
+
+#if USE_ADAPTIVE_SAMPLING
+    sysMomentBuffer[pixel] = sample.moment;
+#endif
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+    sysAlbedoBuffer[pixel] = make_float4(sample.albedo, 1.0f);
+#if USE_DENOISER_NORMAL
+    sysNormalBuffer[pixel] = make_float4(sample.normal, 0.0f);
+#endif
+#endif
+#endif
+  }
+}
+
+// Integrates the primary ray which was set up inside the prd and accumulates the sample into the output buffers
+// at the given pixel of the full screen resolution.
+RT_FUNCTION void accumulateSample(const uint2 pixel, const uint2 screen, PerRayData& prd)
+{
+  PixelSample sample;
+
+  if (integrateSample(pixel, screen, prd, sample))
+  {
+    accumulatePixel(pixel, sample, 1.0f);
+  }
+}
+
+#if USE_POSTER_TILES
+rtDeclareVariable(uint2, sysPosterOffset, , );     // Pixel of the poster at the lower left corner of the rendered tile.
+rtDeclareVariable(uint2, sysPosterResolution, , ); // The full poster the camera projects onto. (0, 0) == off.
+
+// Poster tiles are sub-rectangles of sysPosterResolution. The camera and the sampler see the poster pixel,
+// so the tiles get the same primary rays and random sequences as one launch over the whole poster would.
+RT_FUNCTION void getPosterPixel(uint2& pixel, uint2& screen)
+{
+  if (sysPosterResolution.x != 0)
+  {
+    pixel += sysPosterOffset;
+    screen = sysPosterResolution;
+  }
+}
+#endif
+
+// Sets up the primary ray of the camera through the given pixel of the full screen resolution inside the prd.
+RT_FUNCTION void generatePrimaryRay(const uint2 pixel, const uint2 screen, PerRayData& prd)
+{
+  float3 direction;
+#if USE_RASTER_PRIMARY
+  if (sysRasterPrimary) // Only set for the pinhole camera. The ray must go through the rasterized sub-pixel location.
+  {
+    prd.pos   = sysCameraPosition;
+    direction = optix::normalize(pinholeDirection(make_float2(pixel), make_float2(screen), sysRasterJitter, sysCameraU, sysCameraV, sysCameraW));
+    sample2D(prd, SAMPLE_LENS); // Keeps the LCG sequence of the following samples the same.
+  }
+  else
+#endif
+#if USE_PINHOLE_FAST_PATH
+  if (sysCameraType == LENS_SHADER_PINHOLE) // Uniform over the launch, no divergence. Saves the callable program invocation.
+  {
+    prd.pos   = sysCameraPosition;
+    direction = optix::normalize(pinholeDirection(make_float2(pixel), make_float2(screen), filterPixelSample(sample2D(prd, SAMPLE_LENS)), sysCameraU, sysCameraV, sysCameraW));
+  }
+  else
+#endif
+  {
+    sysLensShader[sysCameraType](make_float2(pixel), make_float2(screen), filterPixelSample(sample2D(prd, SAMPLE_LENS)), sample2D(prd, SAMPLE_APERTURE), prd.pos, direction); // Calculate the primary ray with a lens shader program.
+  }
+  setWi(prd, direction);
+#if USE_RAY_CONES
+  setCone(prd, make_float2(0.0f, pixelSpreadAngle(sysCameraType, make_float2(screen), sysCameraV, sysCameraW)));
+#endif
+}
+
+// Renders one sample, or sysSamplesPerLaunch samples, for the given pixel of the full screen resolution and accumulates them into the output buffers.
+// The pixel coordinate is decoupled from the launch index to allow partial rendering algorithms.
+RT_FUNCTION void renderPixel(const uint2 pixel, const uint2 screen)
+{
+#if USE_COST_HEATMAP
+  const long long start = clock64();
+#endif
+
+  uint2 cameraPixel  = pixel;
+  uint2 cameraScreen = screen;
+#if USE_POSTER_TILES
+  getPosterPixel(cameraPixel, cameraScreen);
+#endif
+
+#if USE_SAMPLES_PER_LAUNCH
+  // The samples are summed locally and blended into the output buffers with a single read-modify-write.
+  // Sample s uses the random sequence of iteration sysIterationIndex + s, so the result matches one sample per launch.
+  PixelSample sum;
+
+  sum.radiance = make_float3(0.0f);
+#if USE_ADAPTIVE_SAMPLING
+  sum.moment = 0.0f;
+#endif
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  sum.albedo = make_float3(0.0f);
+#if USE_DENOISER_NORMAL
+  sum.normal = make_float3(0.0f);
+#endif
+#endif
+#endif
+#if USE_AOVS
+  initAovSample(sum.aov);
+#endif
+
+  float count = 0.0f;
+
+  for (int s = 0; s < sysSamplesPerLaunch; ++s)
+  {
+    PerRayData prd;
+
+    initSampler(prd, cameraPixel.y * cameraScreen.x + cameraPixel.x, sysIterationIndex + s);
+
+    generatePrimaryRay(cameraPixel, cameraScreen, prd);
+
+    PixelSample sample;
+    if (integrateSample(pixel, screen, prd, sample))
+    {
+      sum.radiance += sample.radiance;
+#if USE_ADAPTIVE_SAMPLING
+      sum.moment += sample.moment;
+#endif
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+      sum.albedo += sample.albedo;
+#if USE_DENOISER_NORMAL
+      sum.normal += sample.normal;
+#endif
+#endif
+#endif
+#if USE_REPROJECTION
+      if (count == 0.0f)
       {
-        dst = optix::normalize(dst);
+        sum.position = sample.position;
       }
-      sysNormalBuffer[theLaunchIndex] = make_float4(dst, 0.0f);
-#endif
 #endif
+#if USE_AOVS
+      if (sysAovMask)
+      {
+        sumAovSample(sum.aov, sample.aov, count == 0.0f);
+      }
 #endif
+      count += 1.0f;
     }
-    else
-    {
-      // sysIterationIndex 0 will fill the buffer.
-      // If this isn't done separately, the result of the lerp() above is undefined, e.g. dst could be NaN.
-      sysOutputBuffer[theLaunchIndex] = make_float4(radiance, 1.0f);
+  }
 
-#if USE_DENOISER
+  if (0.0f < count)
+  {
+    const float scale = 1.0f / count;
+
+    sum.radiance *= scale;
+#if USE_ADAPTIVE_SAMPLING
+    sum.moment *= scale;
+#endif
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
-      sysAlbedoBuffer[theLaunchIndex] = make_float4(albedo, 1.0f);
+    sum.albedo *= scale;
 #if USE_DENOISER_NORMAL
-      sysNormalBuffer[theLaunchIndex] = make_float4(normal, 0.0f);
+    sum.normal *= scale;
 #endif
 #endif
 #endif
+#if USE_AOVS
+    scaleAovSample(sum.aov, scale);
+#endif
+    accumulatePixel(pixel, sum, count);
+  }
+#else
+  PerRayData prd;
+
+  // Initialize the sampler from the linear pixel index and the iteration index.
+  initSampler(prd, cameraPixel.y * cameraScreen.x + cameraPixel.x, sysIterationIndex);
+
+  generatePrimaryRay(cameraPixel, cameraScreen, prd);
+
+  accumulateSample(pixel, screen, prd);
+#endif
+
+#if USE_COST_HEATMAP
+  // Replaces the accumulated radiance. The host restarts the accumulation when the heatmap is switched.
+  if (sysCostHeatmap != COST_HEATMAP_OFF)
+  {
+    sysOutputBuffer[pixel] = make_float4(recordCost(pixel, start, sysIterationIndex), 1.0f);
+  }
+#endif
+}
+
+RT_PROGRAM void raygeneration()
+{
+  // In this case theLaunchIndex is the pixel coordinate and theLaunchDim is sysResolution.
+  renderPixel(theLaunchIndex, theLaunchDim);
+}
+
+#if USE_ADAPTIVE_SAMPLING
+// 1D launch over ADAPTIVE_TILE_SIZE * ADAPTIVE_TILE_SIZE pixels per entry in sysActiveTiles.
+// Only the tiles which have not converged yet are rendered.
+RT_PROGRAM void raygeneration_adaptive()
+{
+  const uint2 screen = sysResolution;
+
+  const unsigned int tileIndex = theLaunchIndex.x / (ADAPTIVE_TILE_SIZE * ADAPTIVE_TILE_SIZE);
+  const unsigned int local     = theLaunchIndex.x % (ADAPTIVE_TILE_SIZE * ADAPTIVE_TILE_SIZE);
+
+  const uint2 pixel = sysActiveTiles[tileIndex] * ADAPTIVE_TILE_SIZE + make_uint2(local % ADAPTIVE_TILE_SIZE, local / ADAPTIVE_TILE_SIZE);
+
+  if (pixel.x < screen.x && pixel.y < screen.y) // Tiles on the right and top border can be partially outside the screen.
+  {
+    renderPixel(pixel, screen);
+  }
+}
+#endif
+
+#if USE_TILED_LAUNCH
+// 2D launch over one tile of the screen. theLaunchDim is the tile size, which is smaller at the right and top borders.
+RT_PROGRAM void raygeneration_tile()
+{
+  const uint2 screen = sysResolution;
+  const uint2 pixel  = sysTileOffset + theLaunchIndex;
+
+  if (pixel.x < screen.x && pixel.y < screen.y)
+  {
+    renderPixel(pixel, screen);
+  }
+}
+#endif
+
+#if USE_MORTON_LAUNCH
+// The pixel of the linear launch index. The square tiles of 2^MORTON_TILE_BITS pixels are in row order over the screen,
+// the pixels inside a tile in Morton order, so any aligned run of 4^n launch indices covers a 2^n x 2^n block.
+RT_FUNCTION uint2 mortonPixel(const unsigned int index, const uint2 screen)
+{
+  const unsigned int tilesX = (screen.x + (1u << MORTON_TILE_BITS) - 1u) >> MORTON_TILE_BITS;
+  const unsigned int tile   = index >> (2 * MORTON_TILE_BITS);
+  const unsigned int local  = index & ((1u << (2 * MORTON_TILE_BITS)) - 1u);
+
+  unsigned int x = 0;
+  unsigned int y = 0;
+  for (int bit = 0; bit < MORTON_TILE_BITS; ++bit) // De-interleave the even and odd bits.
+  {
+    x |= ((local >> (2 * bit    )) & 1u) << bit;
+    y |= ((local >> (2 * bit + 1)) & 1u) << bit;
+  }
+  return make_uint2(((tile % tilesX) << MORTON_TILE_BITS) + x, ((tile / tilesX) << MORTON_TILE_BITS) + y);
+}
+
+// 1D launch over all tiles of the screen, see Application::getMortonLaunchSize().
+RT_PROGRAM void raygeneration_morton()
+{
+  const uint2 screen = sysResolution;
+  const uint2 pixel  = mortonPixel(theLaunchIndex.x, screen);
+
+  if (pixel.x < screen.x && pixel.y < screen.y) // Tiles on the right and top border can be partially outside the screen.
+  {
+    renderPixel(pixel, screen);
+  }
+}
+#endif
+
+#if USE_PERSISTENT_THREADS
+rtBuffer<unsigned int> sysPersistentCounter; // [0] == work items handed out since the buffer was created.
+rtDeclareVariable(unsigned int, sysPersistentBase, , ); // Value of sysPersistentCounter[0] at the start of this launch.
+
+// 1D launch over the persistent threads. Each thread renders pixels until all pixels of the screen were handed out.
+// A thread whose path ended early takes the next pixel instead of idling until the longest path of its warp finished.
+// Every thread increments the counter once more than it renders pixels, the host advances sysPersistentBase accordingly.
+RT_PROGRAM void raygeneration_persistent()
+{
+  const uint2        screen = sysResolution;
+  const unsigned int pixels = screen.x * screen.y;
+
+  for (;;)
+  {
+    const unsigned int item = atomicAdd(&sysPersistentCounter[0], 1u) - sysPersistentBase; // Unsigned wrap around is intended.
+    if (pixels <= item)
+    {
+      break;
     }
+    renderPixel(make_uint2(item % screen.x, item / screen.x), screen);
   }
 }
+#endif
+
+#if USE_MULTI_VIEW
+// 3D launch over the view size and the number of views. Each view renders through its own pinhole camera
+// into its sub-rectangle of the output buffers, so all views accumulate in one launch.
+RT_PROGRAM void raygeneration_views()
+{
+  const uint2 screen = sysResolution;
+
+  const ViewDefinition& view = sysViews[theLaunchIndex3D.z];
+
+  const uint2 local = make_uint2(theLaunchIndex3D.x, theLaunchIndex3D.y);
+  const uint2 size  = make_uint2(theLaunchDim3D.x, theLaunchDim3D.y);
+  const uint2 pixel = view.origin + local;
+
+  if (pixel.x < screen.x && pixel.y < screen.y) // The views on the right and top border can be partially outside the screen.
+  {
+    PerRayData prd;
+
+    // The linear pixel index of the full screen keeps the random sequences of all views independent.
+    initSampler(prd, pixel.y * screen.x + pixel.x, sysIterationIndex);
+
+    prd.pos = view.position;
+    setWi(prd, optix::normalize(pinholeDirection(make_float2(local), make_float2(size), filterPixelSample(sample2D(prd, SAMPLE_LENS)), view.U, view.V, view.W)));
+#if USE_RAY_CONES
+    setCone(prd, make_float2(0.0f, pixelSpreadAngle(LENS_SHADER_PINHOLE, make_float2(size), view.V, view.W)));
+#endif
+
+    accumulateSample(pixel, screen, prd);
+  }
+}
+#endif
+
+#if USE_WEDGE
+// 3D launch over the screen and the material variants. The closest hit and any hit programs pick the variant's
+// materials with the launch index z. All variants of a pixel use the same random numbers, so their differences
+// only come from the materials and not from the sampling noise.
+RT_PROGRAM void raygeneration_wedge()
+{
+  const uint2 screen = sysResolution;
+  const uint2 pixel  = make_uint2(theLaunchIndex3D.x, theLaunchIndex3D.y);
+
+  PerRayData prd;
+
+  initSampler(prd, pixel.y * screen.x + pixel.x, sysIterationIndex);
+
+  generatePrimaryRay(pixel, screen, prd);
+
+  PixelSample sample;
+  if (!integrateSample(pixel, screen, prd, sample))
+  {
+    return;
+  }
+
+  const uint3 index = make_uint3(pixel.x, pixel.y, theLaunchIndex3D.z);
+
+  if (0 < sysIterationIndex)
+  {
+    const float3 dst = make_float3(sysWedgeBuffer[index]);
+    sysWedgeBuffer[index] = make_float4(optix::lerp(dst, sample.radiance, 1.0f / float(sysIterationIndex + 1)), 1.0f);
+  }
+  else
+  {
+    sysWedgeBuffer[index] = make_float4(sample.radiance, 1.0f);
+  }
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  // The geometry is the same in all variants, only the displayed one writes the denoiser guide buffers.
+  if (theLaunchIndex3D.z == sysWedgeVariant)
+  {
+    if (0 < sysIterationIndex)
+    {
+      const float t = 1.0f / float(sysIterationIndex + 1);
+
+      float3 dst = make_float3(sysAlbedoBuffer[pixel]);
+      sysAlbedoBuffer[pixel] = make_float4(optix::lerp(dst, sample.albedo, t), 1.0f);
+#if USE_DENOISER_NORMAL
+      dst = optix::lerp(make_float3(sysNormalBuffer[pixel]), sample.normal, t);
+      if (isNotNull(dst))
+      {
+        dst = optix::normalize(dst);
+      }
+      sysNormalBuffer[pixel] = make_float4(dst, 0.0f);
+#endif
+    }
+    else
+    {
+      sysAlbedoBuffer[pixel] = make_float4(sample.albedo, 1.0f);
+#if USE_DENOISER_NORMAL
+      sysNormalBuffer[pixel] = make_float4(sample.normal, 0.0f);
+#endif
+    }
+  }
+#endif
+#endif
+}
+#endif
+
+#if USE_LIGHT_BAKE
+rtBuffer<float4, 2> sysBakePositions; // World space surface point per lightmap texel. w == 1.0f when a triangle covers the texel.
+rtBuffer<float4, 2> sysBakeNormals;   // World space shading normal per texel. w == the world size of the texel for the ray cone.
+
+// 2D launch over the lightmap texels. The primary rays start at the texel's surface point into the cosine weighted
+// hemisphere around its normal, so pi times the mean incoming radiance accumulates to the irradiance.
+RT_PROGRAM void raygeneration_bake()
+{
+  const uint2  texel    = theLaunchIndex;
+  const float4 position = sysBakePositions[texel];
+
+  if (position.w == 0.0f) // Filled by the dilation on the host.
+  {
+    sysOutputBuffer[texel] = make_float4(0.0f);
+    return;
+  }
+
+  const float4 normal = sysBakeNormals[texel];
+
+  PerRayData prd;
+
+  initSampler(prd, texel.y * theLaunchDim.x + texel.x, sysIterationIndex);
+
+  const float2 sample = sample2D(prd, SAMPLE_LENS);
+  const float  phi    = 2.0f * M_PIf * sample.x;
+  const float  r      = sqrtf(sample.y);
+
+  const TBN tbn(make_float3(normal));
+
+  prd.pos = make_float3(position) + sysSceneEpsilon * tbn.normal; // Off the surface the texel lies on.
+  setWi(prd, tbn.inverse_transform(make_float3(r * cosf(phi), r * sinf(phi), sqrtf(fmaxf(0.0f, 1.0f - sample.y)))));
+#if USE_RAY_CONES
+  setCone(prd, make_float2(normal.w, 0.0f));
+#endif
+
+  PixelSample result;
+  if (integrateSample(texel, theLaunchDim, prd, result))
+  {
+    result.radiance *= M_PIf;
+    accumulatePixel(texel, result, 1.0f);
+  }
+}
+#endif
@@ -0,0 +1,196 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+#include "shader_common.h"
+#include "lens_shader.h"
+#include "sampler.h"
+
+// The accumulation of the current view.
+rtBuffer<float4, 2> sysOutputBuffer;      // RGBA32F
+rtBuffer<float4, 2> sysPositionBuffer;    // Primary hit position, w == 1.0f, or the primary ray direction of a miss, w == 0.0f.
+rtBuffer<float, 2>  sysSampleCountBuffer; // Number of samples accumulated per pixel.
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+rtBuffer<float4, 2> sysAlbedoBuffer;      // RGBA32F
+#if USE_DENOISER_NORMAL
+rtBuffer<float4, 2> sysNormalBuffer;      // xyz0
+#endif
+#endif
+#endif
+
+// The accumulation of the previous view. Filled by reproject_store() before the camera variables change.
+rtBuffer<float4, 2> sysHistoryOutput;
+rtBuffer<float4, 2> sysHistoryPosition;
+rtBuffer<float, 2>  sysHistoryCount;
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+rtBuffer<float4, 2> sysHistoryAlbedo;
+#endif
+
+rtDeclareVariable(float3, sysCameraPosition, , );
+rtDeclareVariable(float3, sysCameraU, , );
+rtDeclareVariable(float3, sysCameraV, , );
+rtDeclareVariable(float3, sysCameraW, , );
+
+rtDeclareVariable(float3, sysHistoryCameraPosition, , );
+rtDeclareVariable(float3, sysHistoryCameraU, , );
+rtDeclareVariable(float3, sysHistoryCameraV, , );
+rtDeclareVariable(float3, sysHistoryCameraW, , );
+
+rtDeclareVariable(float, sysReprojectionTolerance, , ); // Position difference relative to the hit distance which counts as disocclusion.
+rtDeclareVariable(float, sysReprojectionHistory, , );   // Maximum number of samples a reprojected pixel keeps.
+
+rtDeclareVariable(rtObject, sysTopObject, , );
+rtDeclareVariable(float,    sysSceneEpsilon, , );
+
+rtDeclareVariable(uint2, sysResolution, , );
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+// Inverse of pinholeDirection() for the history camera. Solves d = s * (ndc.x * U + ndc.y * V + W) for ndc.
+// Returns false when the point is behind the camera.
+RT_FUNCTION bool projectHistory(const float3 d, float2& ndc)
+{
+  const float3 UxV = optix::cross(sysHistoryCameraU, sysHistoryCameraV);
+  const float3 VxW = optix::cross(sysHistoryCameraV, sysHistoryCameraW);
+  const float3 WxU = optix::cross(sysHistoryCameraW, sysHistoryCameraU);
+
+  const float s = optix::dot(d, UxV) / optix::dot(sysHistoryCameraW, UxV);
+  if (s <= 0.0f)
+  {
+    return false;
+  }
+
+  ndc.x = optix::dot(d, VxW) / (optix::dot(sysHistoryCameraU, VxW) * s);
+  ndc.y = optix::dot(d, WxU) / (optix::dot(sysHistoryCameraV, WxU) * s);
+  return true;
+}
+
+// 2D launch over the current resolution. The reprojection reads arbitrary history pixels, so the accumulation is copied first.
+RT_PROGRAM void reproject_store()
+{
+  sysHistoryOutput[theLaunchIndex]   = sysOutputBuffer[theLaunchIndex];
+  sysHistoryPosition[theLaunchIndex] = sysPositionBuffer[theLaunchIndex];
+  sysHistoryCount[theLaunchIndex]    = sysSampleCountBuffer[theLaunchIndex];
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+  sysHistoryAlbedo[theLaunchIndex]   = sysAlbedoBuffer[theLaunchIndex];
+#endif
+}
+
+// 2D launch over the current resolution with the new camera.
+// Traces the pixel center, projects its primary hit into the history view and takes that pixel's accumulation
+// when the history primary hit is at the same position. Pixels without matching history start with zero samples.
+RT_PROGRAM void reproject()
+{
+  const uint2 pixel  = theLaunchIndex;
+  const uint2 screen = sysResolution;
+
+  PerRayData prd;
+
+  initSampler(prd, pixel.y * screen.x + pixel.x, 0);
+
+  prd.flags = 0;
+  setSamplerBounce(prd, 0);
+
+  const float3 direction = optix::normalize(pinholeDirection(make_float2(pixel), make_float2(screen), make_float2(0.5f), sysCameraU, sysCameraV, sysCameraW));
+
+  prd.pos = sysCameraPosition;
+  setWi(prd, direction);
+#if USE_RAY_CONES
+  setCone(prd, make_float2(0.0f, pixelSpreadAngle(LENS_SHADER_PINHOLE, make_float2(screen), sysCameraV, sysCameraW)));
+#endif
+#if !USE_COMPACT_PAYLOAD
+  prd.wo     = -direction;
+#if USE_DENOISER_NORMAL
+  prd.normal = make_float3(0.0f);
+#endif
+#endif
+  prd.ior            = make_float2(1.0f);
+  prd.distance       = RT_DEFAULT_MAX;
+  prd.absorption_ior = make_float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+  optix::Ray ray = optix::make_Ray(sysCameraPosition, direction, 0, sysSceneEpsilon, RT_DEFAULT_MAX);
+  rtTrace(sysTopObject, ray, 0.5f, prd); // Middle of the shutter interval.
+
+  const bool   hit      = ((prd.flags & FLAG_HIT) != 0);
+  const float4 position = (hit) ? make_float4(prd.pos, 1.0f) : make_float4(direction, 0.0f);
+
+  float samples = 0.0f;
+  uint2 source  = pixel;
+
+  float2 ndc;
+  if (projectHistory((hit) ? prd.pos - sysHistoryCameraPosition : direction, ndc))
+  {
+    const float2 fragment = (ndc * 0.5f + 0.5f) * make_float2(screen);
+
+    if (0.0f <= fragment.x && fragment.x < float(screen.x) && 0.0f <= fragment.y && fragment.y < float(screen.y))
+    {
+      source = make_uint2((unsigned int) fragment.x, (unsigned int) fragment.y);
+
+      const float4 history = sysHistoryPosition[source];
+
+      float confidence = 0.0f;
+      if (hit && history.w == 1.0f)
+      {
+        // Disocclusion when the history pixel saw a different surface. Fades out over the tolerance.
+        const float tolerance = sysReprojectionTolerance * optix::length(prd.pos - sysCameraPosition);
+        confidence = optix::clamp(1.0f - optix::length(make_float3(history) - prd.pos) / tolerance, 0.0f, 1.0f);
+      }
+      else if (!hit && history.w == 0.0f)
+      {
+        confidence = 1.0f; // Both saw the environment in the same direction.
+      }
+
+      samples = floorf(fminf(sysHistoryCount[source], sysReprojectionHistory) * confidence);
+    }
+  }
+
+  if (0.0f < samples)
+  {
+    sysOutputBuffer[pixel] = sysHistoryOutput[source];
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+    sysAlbedoBuffer[pixel] = sysHistoryAlbedo[source];
+#endif
+  }
+  sysSampleCountBuffer[pixel] = samples; // The first new sample overwrites the pixel when this is zero.
+  sysPositionBuffer[pixel]    = position;
+
+#if USE_DENOISER && USE_DENOISER_ALBEDO && USE_DENOISER_NORMAL && !USE_DENOISER_GBUFFER
+  // The normals are in camera space. Take the ones of the new view from the traced primary hit.
+  const float3 normalWorld = (hit) ? getNormal(prd) : make_float3(0.0f);
+  sysNormalBuffer[pixel] = make_float4( optix::dot(normalWorld, optix::normalize(sysCameraU)),
+                                        optix::dot(normalWorld, optix::normalize(sysCameraV)),
+                                       -optix::dot(normalWorld, optix::normalize(sysCameraW)), 0.0f);
+#endif
+}
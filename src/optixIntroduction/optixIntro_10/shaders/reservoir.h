@@ -0,0 +1,115 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#ifndef RESERVOIR_H
+#define RESERVOIR_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "compact_attributes.h"
+
+// The candidates and reused reservoirs of a pixel only count up to this many times its candidates.
+// Limits how long a stale sample survives and how strongly neighbouring pixels correlate.
+#define RESTIR_HISTORY_LIMIT    20.0f
+// Previous reservoirs of other pixels combined with the current one, and the pixel radius they are picked from.
+#define RESTIR_SPATIAL_SAMPLES  3
+#define RESTIR_SPATIAL_RADIUS   16.0f
+// Reservoirs are only reused between shading points which agree in position, relative to the camera distance, and in normal.
+#define RESTIR_DISTANCE_TOLERANCE 0.05f
+#define RESTIR_NORMAL_THRESHOLD   0.9f
+
+// The direct lighting reservoir of the primary hit of one pixel, written each iteration by the closest hit program.
+// Holds the selected light sample, the number of candidates it represents and its unbiased contribution weight W.
+// The shading point is stored to reject reuse across geometric discontinuities.
+// Note that the fields are ordered by CUDA alignment restrictions. Size is 64 bytes.
+struct Reservoir
+{
+  optix::float3 point;    // Position on the area or mesh light, or the direction to the environment light, in world space.
+  int           light;    // Index into sysLightDefinitions. -1 == empty reservoir.
+  optix::float3 emission; // Emission of the light sample. Constant per sample for both light types.
+  float         M;        // Number of candidates this reservoir represents.
+  optix::float3 position; // Shading point of the pixel, in world space.
+  float         W;        // Contribution weight, wSum / (M * targetPdf). 0.0f when the sample was occluded.
+  optix::float3 normal;   // Shading normal of the pixel, in world space.
+  unsigned int  lightNormal; // Octahedral encoded light surface normal at the point. Mesh lights vary it per triangle.
+};
+
+#if defined(__CUDACC__)
+// Inverse of pinholeDirection(). Returns false when the point is behind the camera or outside the screen.
+RT_FUNCTION bool projectPinhole(optix::float3 const& point, optix::float3 const& P, optix::float3 const& U, optix::float3 const& V, optix::float3 const& W,
+                                optix::uint2 const& screen, optix::uint2& pixel)
+{
+  const optix::float3 d   = point - P;
+  const optix::float3 UxV = optix::cross(U, V);
+
+  const float s = optix::dot(d, UxV) / optix::dot(W, UxV);
+  if (s <= 0.0f)
+  {
+    return false;
+  }
+
+  const optix::float3 VxW = optix::cross(V, W);
+  const optix::float3 WxU = optix::cross(W, U);
+
+  const optix::float2 ndc = optix::make_float2(optix::dot(d, VxW) / (optix::dot(U, VxW) * s),
+                                               optix::dot(d, WxU) / (optix::dot(V, WxU) * s));
+
+  const optix::float2 fragment = (ndc * 0.5f + 0.5f) * optix::make_float2(screen);
+  if (fragment.x < 0.0f || float(screen.x) <= fragment.x || fragment.y < 0.0f || float(screen.y) <= fragment.y)
+  {
+    return false;
+  }
+
+  pixel = optix::make_uint2(min(static_cast<unsigned int>(fragment.x), screen.x - 1),
+                            min(static_cast<unsigned int>(fragment.y), screen.y - 1));
+  return true;
+}
+
+// Weighted reservoir sampling: Keeps the new sample with probability weight / wSum.
+RT_FUNCTION bool updateReservoir(float& wSum, const float weight, const float sample)
+{
+  wSum += weight;
+  return (0.0f < weight && sample * wSum < weight);
+}
+
+RT_FUNCTION bool isReusable(Reservoir const& reservoir, optix::float3 const& position, optix::float3 const& normal, const float distance, const int numLights)
+{
+  return 0 <= reservoir.light && reservoir.light < numLights &&
+         optix::length(reservoir.position - position) < RESTIR_DISTANCE_TOLERANCE * distance &&
+         RESTIR_NORMAL_THRESHOLD < optix::dot(reservoir.normal, normal);
+}
+#endif // __CUDACC__
+
+#endif // RESERVOIR_H
@@ -0,0 +1,88 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+// The per-device accumulation buffers. Each device only holds valid data for the pixels it rendered,
+// which are the same pixels it gets assigned in this launch with identical launch dimensions.
+// With USE_DENOISER_GBUFFER the guide buffers are written into the shared buffers directly.
+rtBuffer<float4, 2> sysLocalOutputBuffer; // RGBA32F, RT_BUFFER_GPU_LOCAL
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+rtBuffer<float4, 2> sysLocalAlbedoBuffer; // RGBA32F, RT_BUFFER_GPU_LOCAL
+#if USE_DENOISER_NORMAL
+rtBuffer<float4, 2> sysLocalNormalBuffer; // xyz0, RT_BUFFER_GPU_LOCAL
+#endif
+#endif
+#endif
+
+// The buffers the denoiser and the display read.
+rtBuffer<float4, 2> sysOutputBuffer; // RGBA32F
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+rtBuffer<float4, 2> sysAlbedoBuffer; // RGBA32F
+#if USE_DENOISER_NORMAL
+rtBuffer<float4, 2> sysNormalBuffer; // xyz0
+#endif
+#endif
+#endif
+
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+// 2D launch over the full resolution. Copies the accumulated results of all devices into the shared buffers.
+// Only called when presenting, so the shared buffers aren't touched by every iteration.
+RT_PROGRAM void resolve()
+{
+  sysOutputBuffer[theLaunchIndex] = sysLocalOutputBuffer[theLaunchIndex];
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  sysAlbedoBuffer[theLaunchIndex] = sysLocalAlbedoBuffer[theLaunchIndex];
+#if USE_DENOISER_NORMAL
+  sysNormalBuffer[theLaunchIndex] = sysLocalNormalBuffer[theLaunchIndex];
+#endif
+#endif
+#endif
+}
+
+// The inverse of resolve(). Each device reloads the pixels it will continue to accumulate from the shared buffers,
+// which Application::loadCheckpoint() filled with the accumulation of an interrupted render.
+RT_PROGRAM void restore()
+{
+  sysLocalOutputBuffer[theLaunchIndex] = sysOutputBuffer[theLaunchIndex];
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  sysLocalAlbedoBuffer[theLaunchIndex] = sysAlbedoBuffer[theLaunchIndex];
+#if USE_DENOISER_NORMAL
+  sysLocalNormalBuffer[theLaunchIndex] = sysNormalBuffer[theLaunchIndex];
+#endif
+#endif
+#endif
+}
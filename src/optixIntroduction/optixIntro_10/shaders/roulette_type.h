@@ -0,0 +1,53 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef ROULETTE_TYPE_H
+#define ROULETTE_TYPE_H
+
+// Russian Roulette strategy selection in sysRouletteType. Shared between host and device code.
+enum RouletteType
+{
+  ROULETTE_MAX_THROUGHPUT = 0, // Continuation probability is the maximum throughput component.
+  ROULETTE_INTENSITY      = 1, // Continuation probability is the throughput intensity. Terminates colored paths more aggressively.
+  ROULETTE_WEIGHT_WINDOW  = 2  // Weight window centered at the pixel's share of the image mean. Needs USE_PATH_STATISTICS for that mean.
+};
+
+// Layout of the sysPathStatistics buffer: PATH_STATISTICS_SLOTS floats per path segment index.
+// Deeper segments are all counted in the last entry.
+#define PATH_STATISTICS_DEPTHS 32
+
+#define PATH_STATISTICS_PATHS       0 // Number of paths which traced this segment.
+#define PATH_STATISTICS_RADIANCE    1 // Sum of the radiance intensity added to the pixels at this segment.
+#define PATH_STATISTICS_TESTS       2 // Number of Russian Roulette decisions after this segment.
+#define PATH_STATISTICS_PROBABILITY 3 // Sum of the continuation probabilities of these decisions.
+#define PATH_STATISTICS_TERMINATED  4 // Number of paths terminated by Russian Roulette after this segment.
+#define PATH_STATISTICS_SLOTS       5
+
+#endif // ROULETTE_TYPE_H
@@ -0,0 +1,77 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef RUSSIAN_ROULETTE_H
+#define RUSSIAN_ROULETTE_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "shader_common.h"
+#include "roulette_type.h"
+
+rtDeclareVariable(int,   sysRouletteType, , );
+rtDeclareVariable(float, sysRouletteWindow, , ); // Ratio between the upper and lower weight window bound.
+rtDeclareVariable(float, sysRouletteMean, , );   // Mean radiance intensity over all pixels. 0.0f when not known yet.
+
+#if USE_PATH_STATISTICS
+rtBuffer<float> sysPathStatistics; // PATH_STATISTICS_DEPTHS * PATH_STATISTICS_SLOTS, cleared by the host after each launch.
+
+RT_FUNCTION void recordPathStatistic(const int depth, const int slot, const float value)
+{
+  atomicAdd(&sysPathStatistics[min(depth, PATH_STATISTICS_DEPTHS - 1) * PATH_STATISTICS_SLOTS + slot], value);
+}
+#endif
+
+// Returns the probability in the range (0, 1] to continue a path with the given throughput.
+// pixelMean is the current intensity estimate of the pixel the path belongs to, 0.0f when there is none.
+RT_FUNCTION float continuationProbability(const float3 throughput, const float pixelMean)
+{
+  if (sysRouletteType == ROULETTE_WEIGHT_WINDOW && 0.0f < pixelMean && 0.0f < sysRouletteMean)
+  {
+    // Expected throughput of a path carrying the pixel's value when the incident radiance at its vertices is the image mean.
+    // Paths below the lower window bound contribute little compared to the pixel and survive with a probability
+    // which brings their weight to the window center. Without splitting the paths above the window simply continue.
+    const float center = pixelMean / sysRouletteMean;
+    const float weight = intensity(throughput);
+
+    return (weight < 2.0f * center / (1.0f + sysRouletteWindow)) ? weight / center : 1.0f;
+  }
+  if (sysRouletteType == ROULETTE_INTENSITY)
+  {
+    return fminf(1.0f, intensity(throughput));
+  }
+  return fminf(1.0f, fmaxf(throughput)); // Never scale up the throughput when it grew above 1.0f.
+}
+
+#endif // RUSSIAN_ROULETTE_H
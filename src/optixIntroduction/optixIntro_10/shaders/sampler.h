@@ -0,0 +1,199 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+#include "random_number_generators.h"
+#include "sampler_type.h"
+
+// Dimension layout of one path.
+// Each dimension identifies a 2D sample, 1D samples use its first component.
+// This way each decision gets the same dimension in every iteration which is what makes the low-discrepancy sequence effective.
+#define SAMPLE_LENS     0 // 2D lens shader sample.
+#define SAMPLE_TIME     1 // 1D shutter time.
+#define SAMPLE_APERTURE 2 // 2D thin lens aperture sample.
+#define SAMPLE_BOUNCE   3 // First dimension of path segment 0. Each segment uses SAMPLE_DIMENSIONS_PER_BOUNCE dimensions from here.
+
+// Dimension offsets inside one path segment.
+#define SAMPLE_BSDF        0 // 2D BSDF direction.
+#define SAMPLE_BSDF_LOBE   1 // 1D BSDF lobe selection, like Fresnel reflection vs. transmission.
+#define SAMPLE_LIGHT       2 // 2D position on the light.
+#define SAMPLE_LIGHT_INDEX 3 // 1D light selection.
+#define SAMPLE_RR          4 // 1D Russian Roulette.
+#define SAMPLE_DIMENSIONS_PER_BOUNCE 5
+
+rtDeclareVariable(int, sysSampler, , );
+
+// Hash based Owen scrambling. Burley 2020, "Practical Hash-based Owen Scrambling".
+RT_FUNCTION unsigned int laineKarrasPermutation(unsigned int x, const unsigned int seed)
+{
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+RT_FUNCTION unsigned int nestedUniformScramble(unsigned int x, const unsigned int seed)
+{
+  x = __brev(x);
+  x = laineKarrasPermutation(x, seed);
+  return __brev(x);
+}
+
+// Second Sobol dimension. The first is the bit reversed index. Both together form a (0,2)-sequence.
+RT_FUNCTION unsigned int sobolSecondDimension(unsigned int index)
+{
+  unsigned int v = 1u << 31;
+  unsigned int r = 0;
+
+  for (; index; index >>= 1, v ^= v >> 1)
+  {
+    if (index & 1u)
+    {
+      r ^= v;
+    }
+  }
+  return r;
+}
+
+// Map the upper 24 bits to [0, 1).
+RT_FUNCTION float toUnitFloat(const unsigned int x)
+{
+  return float(x >> 8) / float(0x01000000u);
+}
+
+// Each dimension gets its own shuffle of the sample index and its own scramble of the point,
+// so different dimensions are not correlated while each 2D projection stays well stratified.
+RT_FUNCTION float2 sobol2D(const unsigned int index, const unsigned int scramble, const unsigned int dimension)
+{
+  const unsigned int seed     = tea<4>(scramble, dimension);
+  const unsigned int shuffled = nestedUniformScramble(index, seed);
+
+  const unsigned int x = nestedUniformScramble(__brev(shuffled), seed ^ 0xa511e9b3u);
+  const unsigned int y = nestedUniformScramble(sobolSecondDimension(shuffled), seed ^ 0x63d83595u);
+
+  return make_float2(toUnitFloat(x), toUnitFloat(y));
+}
+
+RT_FUNCTION float sobol1D(const unsigned int index, const unsigned int scramble, const unsigned int dimension)
+{
+  const unsigned int seed     = tea<4>(scramble, dimension);
+  const unsigned int shuffled = nestedUniformScramble(index, seed);
+
+  return toUnitFloat(nestedUniformScramble(__brev(shuffled), seed ^ 0xa511e9b3u));
+}
+
+RT_FUNCTION unsigned int getSampleDimension(PerRayData const& prd)
+{
+#if USE_COMPACT_PAYLOAD
+  return (static_cast<unsigned int>(prd.flags) & FLAG_DIMENSION_MASK) >> FLAG_DIMENSION_SHIFT;
+#else
+  return prd.sampleDimension;
+#endif
+}
+
+RT_FUNCTION void setSampleDimension(PerRayData& prd, const unsigned int dimension)
+{
+#if USE_COMPACT_PAYLOAD
+  prd.flags = (prd.flags & ~FLAG_DIMENSION_MASK) | static_cast<int>(dimension << FLAG_DIMENSION_SHIFT);
+#else
+  prd.sampleDimension = dimension;
+#endif
+}
+
+// Initialize the sampler state of a new path.
+// The LCG seed depends on the pixel and the iteration, the Sobol scramble only on the pixel, the iteration is the Sobol index.
+RT_FUNCTION void initSampler(PerRayData& prd, const unsigned int pixelIndex, const unsigned int iteration)
+{
+  prd.seed            = tea<8>(pixelIndex, iteration);
+  prd.sampleScramble  = tea<4>(pixelIndex, 0x2f0a1d3bu);
+  prd.sampleIndex     = iteration;
+#if USE_COMPACT_PAYLOAD
+  prd.flags           = 0; // Holds the dimension.
+#else
+  prd.sampleDimension = 0;
+#endif
+}
+
+// Select the dimensions of the given path segment.
+RT_FUNCTION void setSamplerBounce(PerRayData& prd, const int depth)
+{
+  setSampleDimension(prd, SAMPLE_BOUNCE + depth * SAMPLE_DIMENSIONS_PER_BOUNCE);
+}
+
+// Dimension is one of the SAMPLE_* defines. Per path segment offsets are relative to the current bounce.
+RT_FUNCTION float sample1D(PerRayData& prd, const unsigned int dimension)
+{
+  if (sysSampler == SAMPLER_SOBOL)
+  {
+    return sobol1D(prd.sampleIndex, prd.sampleScramble, getSampleDimension(prd) + dimension);
+  }
+  return rng(prd.seed);
+}
+
+RT_FUNCTION float2 sample2D(PerRayData& prd, const unsigned int dimension)
+{
+  if (sysSampler == SAMPLER_SOBOL)
+  {
+    return sobol2D(prd.sampleIndex, prd.sampleScramble, getSampleDimension(prd) + dimension);
+  }
+  return rng2(prd.seed);
+}
+
+#if USE_STRATIFIED_SHUTTER
+// Stratified time in [0, 1) for the stochastic shutter, independent of the selected sampler.
+// Iteration i renders time slice i % timeSlices, so all paths of one launch share the same narrow time window
+// and the motion transforms are evaluated coherently. Inside the slice the iterations i / timeSlices follow
+// the van der Corput sequence, rotated per pixel to decorrelate neighbouring pixels.
+RT_FUNCTION float sampleShutterTime(PerRayData const& prd, const int timeSlices)
+{
+  const unsigned int slices = static_cast<unsigned int>(optix::max(1, timeSlices));
+  const unsigned int slice  = prd.sampleIndex % slices;
+
+  const float rotation = toUnitFloat(tea<4>(prd.sampleScramble, SAMPLE_TIME));
+
+  float t = toUnitFloat(__brev(prd.sampleIndex / slices)) + rotation;
+  t -= floorf(t);
+
+  return (float(slice) + t) / float(slices);
+}
+#endif
+
+#endif // SAMPLER_H
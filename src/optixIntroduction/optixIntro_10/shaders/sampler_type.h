@@ -28,14 +28,14 @@
 
 #pragma once
 
-#ifndef LENS_SHADER_H
-#define LENS_SHADER_H
+#ifndef SAMPLER_TYPE_H
+#define SAMPLER_TYPE_H
 
-enum LensShader
+// Sampler selection in sysSampler. Set once at context creation. Shared between host and device code.
+enum SamplerType
 {
-  LENS_SHADER_PINHOLE  = 0,
-  LENS_SHADER_FISHEYE  = 1,
-  LENS_SHADER_SPHERE   = 2
+  SAMPLER_LCG   = 0, // Linear Congruential Generator from random_number_generators.h. Dimensions are ignored.
+  SAMPLER_SOBOL = 1  // Owen scrambled and shuffled 2D Sobol points per dimension, decorrelated per pixel.
 };
 
-#endif // LENS_SHADER_H
+#endif // SAMPLER_TYPE_H
@@ -0,0 +1,111 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#ifndef SPECTRAL_H
+#define SPECTRAL_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+#include "sampler.h"
+
+#if USE_SPECTRAL
+// Hero wavelength rendering of dispersive materials on top of the RGB transport.
+//
+// Each path samples one wavelength in [SPECTRAL_LAMBDA_MIN, SPECTRAL_LAMBDA_MAX] nm. As long as it only meets non-dispersive
+// interfaces, all wavelengths share the path and the RGB throughput stands for all of them together, which is the plain RGB renderer.
+// The first dispersive refraction can only follow one wavelength's direction. With delta BSDFs the other wavelengths have zero
+// probability there, so the path continues with the hero wavelength alone: the throughput is multiplied by the RGB response of that
+// wavelength once and every RGB quantity after that (BSDF weights, transmittance, radiance) by its value at the hero wavelength.
+
+#define SPECTRAL_LAMBDA_MIN 380.0f
+#define SPECTRAL_LAMBDA_MAX 720.0f
+
+rtDeclareVariable(int, sysSpectral, , ); // 0 == RGB only, 1 == paths carry a hero wavelength.
+
+// The wavelength uses the second component of the shutter time dimension, which the time sample leaves unused.
+RT_FUNCTION float sampleWavelength(PerRayData& prd)
+{
+  const float u = (sysSampler == SAMPLER_SOBOL) ? sobol2D(prd.sampleIndex, prd.sampleScramble, getSampleDimension(prd) + SAMPLE_TIME).y
+                                                : rng(prd.seed);
+  return SPECTRAL_LAMBDA_MIN + u * (SPECTRAL_LAMBDA_MAX - SPECTRAL_LAMBDA_MIN);
+}
+
+// Smooth red, green and blue responses. Gaussian lobes.
+RT_FUNCTION float3 spectralBasis(const float lambda)
+{
+  const float r = (lambda - 610.0f) * (1.0f / 40.0f);
+  const float g = (lambda - 545.0f) * (1.0f / 35.0f);
+  const float b = (lambda - 455.0f) * (1.0f / 35.0f);
+  return make_float3(expf(-0.5f * r * r), expf(-0.5f * g * g), expf(-0.5f * b * b));
+}
+
+// RGB contribution of unit spectral radiance at lambda. Normalized so that its mean over the uniformly sampled range is white.
+RT_FUNCTION float3 spectralWeight(const float lambda)
+{
+  return spectralBasis(lambda) * make_float3(3.401144f, 3.875445f, 3.938704f);
+}
+
+// Spectral upsampling of a non-negative RGB value: its value at lambda, weighted by the sharpened basis responses.
+// Exact for grey values, saturated colors lose some saturation.
+RT_FUNCTION float spectralValue(const float3 rgb, const float lambda)
+{
+  float3 b = spectralBasis(lambda);
+  b *= b;
+  b *= b;
+  const float sum = b.x + b.y + b.z;
+  return (0.0f < sum) ? optix::dot(rgb, b) / sum : (rgb.x + rgb.y + rgb.z) * (1.0f / 3.0f);
+}
+
+// RGB values after the path turned monochromatic: the hero wavelength's value replicated.
+RT_FUNCTION float3 spectralScale(const float3 rgb, const float lambda)
+{
+  return make_float3(spectralValue(rgb, lambda));
+}
+
+// Cauchy's equation n(lambda) = A + B / lambda^2 from the IOR at the Fraunhofer d-line (587.6 nm) and the Abbe number,
+// V = (n_d - 1) / (n_F - n_C) with the F (486.1 nm) and C (656.3 nm) lines.
+RT_FUNCTION float dispersedIor(const float ior, const float abbe, const float lambda)
+{
+  if (abbe <= 0.0f)
+  {
+    return ior;
+  }
+  const float B = (ior - 1.0f) / (abbe * (1.0f / (0.4861f * 0.4861f) - 1.0f / (0.6563f * 0.6563f)));
+  const float A = ior - B / (0.5876f * 0.5876f);
+  const float micrometers = lambda * 0.001f;
+  return A + B / (micrometers * micrometers);
+}
+#endif // USE_SPECTRAL
+
+#endif // SPECTRAL_H
@@ -39,4 +39,17 @@ struct VertexAttributes
   optix::float3 texcoord;
 };
 
+#if defined(__CUDACC__)
+#include "rt_function.h"
+
+// 0.5f * log2 of the ratio between the texture coordinate area and the object space area of a triangle, the ray cone
+// texture level of detail of a unit footprint. Stored in the unused texture coordinate z-component. The triangle area factors cancel out.
+RT_FUNCTION float getTriangleLod(const optix::float3& t0, const optix::float3& t1, const optix::float3& t2, const optix::float3& geoNormal)
+{
+  const float uvArea = fabsf((t1.x - t0.x) * (t2.y - t0.y) - (t2.x - t0.x) * (t1.y - t0.y));
+
+  return 0.5f * log2f(uvArea / optix::length(geoNormal));
+}
+#endif
+
 #endif // VERTEX_ATTRIBUTES_H
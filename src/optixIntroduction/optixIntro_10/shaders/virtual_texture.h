@@ -0,0 +1,118 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef VIRTUAL_TEXTURE_DEVICE_H
+#define VIRTUAL_TEXTURE_DEVICE_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+
+// Texels per tile side without the border.
+#define VT_TILE_SIZE   64
+// Texels replicated around each tile inside the physical texture to allow bilinear filtering without seams.
+#define VT_TILE_BORDER 1
+#define VT_SLOT_SIZE   (VT_TILE_SIZE + 2 * VT_TILE_BORDER)
+// Enough levels for 2^23 texels per side at 64 texels per tile.
+#define VT_MAX_LEVELS  18
+
+// Without USE_RAY_CONES indirect hits request tiles this many levels coarser.
+#define VT_INDIRECT_LEVEL_BIAS 2
+
+// Everything the device needs to resolve a virtual texture lookup. Element of the sysVirtualTextures buffer.
+struct VirtualTextureDescription
+{
+  int          physicalID;    // Bindless RGBA8 texture with slotsX * slotsY tiles including their borders.
+  int          indirectionID; // Bindless buffer of unsigned int per tile of all levels. 0 == not resident, otherwise slot index + 1.
+  int          feedbackID;    // Bindless buffer of unsigned char per tile of all levels. Set to 1 by the closest hit programs for requested tiles.
+  unsigned int width;         // Level 0 extents in texels.
+  unsigned int height;
+  unsigned int numLevels;     // The last level is a single tile which is always resident.
+  unsigned int slotsX;        // Tiles per row inside the physical texture.
+  unsigned int slotsY;
+  unsigned int levelOffset[VT_MAX_LEVELS]; // Index of the first tile of each level in the indirection and feedback buffers.
+  unsigned int unused0;       // Pad to 16 bytes.
+  unsigned int unused1;
+};
+
+#if defined(__CUDACC__)
+// Repeat wrap mode. Starts at the desired level, records it as requested and falls back to the next coarser resident tile.
+RT_FUNCTION optix::float4 sampleVirtualTexture(VirtualTextureDescription const& vt, const optix::float2 uv, const unsigned int desiredLevel)
+{
+  const float u = uv.x - floorf(uv.x);
+  const float v = uv.y - floorf(uv.y);
+
+  const rtBufferId<unsigned int, 1>  indirection(vt.indirectionID);
+  const rtBufferId<unsigned char, 1> feedback(vt.feedbackID);
+
+  const unsigned int first = optix::min(desiredLevel, vt.numLevels - 1);
+
+  for (unsigned int level = first; level < vt.numLevels; ++level)
+  {
+    const unsigned int w = optix::max(1u, vt.width  >> level);
+    const unsigned int h = optix::max(1u, vt.height >> level);
+
+    const unsigned int tilesX = (w + VT_TILE_SIZE - 1) / VT_TILE_SIZE;
+    const unsigned int tilesY = (h + VT_TILE_SIZE - 1) / VT_TILE_SIZE;
+
+    // Continuous texel coordinates of this level.
+    const float x = u * float(w);
+    const float y = v * float(h);
+
+    const unsigned int tx = optix::min((unsigned int) x / VT_TILE_SIZE, tilesX - 1);
+    const unsigned int ty = optix::min((unsigned int) y / VT_TILE_SIZE, tilesY - 1);
+
+    const unsigned int index = vt.levelOffset[level] + ty * tilesX + tx;
+
+    if (level == first)
+    {
+      feedback[index] = 1;
+    }
+
+    const unsigned int slot = indirection[index];
+    if (slot != 0)
+    {
+      const unsigned int sx = (slot - 1) % vt.slotsX;
+      const unsigned int sy = (slot - 1) / vt.slotsX;
+
+      const float px = float(sx * VT_SLOT_SIZE + VT_TILE_BORDER) + x - float(tx * VT_TILE_SIZE);
+      const float py = float(sy * VT_SLOT_SIZE + VT_TILE_BORDER) + y - float(ty * VT_TILE_SIZE);
+
+      return optix::rtTex2D<optix::float4>(vt.physicalID, px / float(vt.slotsX * VT_SLOT_SIZE), py / float(vt.slotsY * VT_SLOT_SIZE));
+    }
+  }
+  return optix::make_float4(1.0f); // Not reached, the last level is pinned.
+}
+#endif
+
+#endif // VIRTUAL_TEXTURE_DEVICE_H
@@ -0,0 +1,486 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+#include "shader_common.h"
+#include "lens_shader.h"
+#include "lens_shader_type.h"
+#include "pixel_filter.h"
+#include "wavefront_path.h"
+#if USE_WAVEFRONT_SORT
+#include "compact_attributes.h"
+#endif
+#include "sampler.h"
+#include "russian_roulette.h"
+#include "ray_counters.h"
+
+#include "rt_assert.h"
+
+// Wavefront version of the unidirectional path tracer in raygeneration.cu.
+// Instead of running the whole path inside one megakernel loop, the host issues one launch per path segment
+// over a compacted queue of live paths. Terminated paths are simply not written into the next queue,
+// so warps stay fully occupied even when only a few long specular paths are left after some bounces.
+
+rtBuffer<float4, 2> sysOutputBuffer; // RGBA32F
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+rtBuffer<float4, 2> sysAlbedoBuffer; // RGBA32F
+#if USE_DENOISER_NORMAL
+rtBuffer<float4, 2> sysNormalBuffer; // xyz0
+#endif
+#endif
+#endif
+
+// For the pinhole fast path and the denoiser normal transformation into camera space.
+rtDeclareVariable(float3, sysCameraPosition, , );
+rtDeclareVariable(float3, sysCameraU, , );
+rtDeclareVariable(float3, sysCameraV, , );
+rtDeclareVariable(float3, sysCameraW, , );
+
+rtDeclareVariable(rtObject, sysTopObject, , );
+rtDeclareVariable(float,    sysSceneEpsilon, , );
+rtDeclareVariable(int2,     sysPathLengths, , );
+rtDeclareVariable(int,      sysIterationIndex, , );
+rtDeclareVariable(int,      sysCameraType, , );
+rtDeclareVariable(int,      sysShutterType, , );
+#if USE_STRATIFIED_SHUTTER
+rtDeclareVariable(int,      sysTimeSlices, , ); // Number of launches sharing the shutter interval, see sampleShutterTime().
+#endif
+
+// Two halves of sysWavefrontPaths, each with one element per pixel, are used as ping-pong queues.
+rtBuffer<WavefrontPath>  sysWavefrontPaths;
+rtBuffer<unsigned int>   sysWavefrontCounter;  // [0] == number of paths written into the output queue.
+rtDeclareVariable(int,   sysWavefrontParity, , ); // Index of the half which holds the input queue.
+rtDeclareVariable(int,   sysWavefrontDepth, , );  // Path segment index of the current extend launch. Primary ray is 0.
+
+#if USE_WAVEFRONT_SORT
+rtDeclareVariable(int,   sysWavefrontSort, , );     // 0 == off, 1 == the extend launch writes the sort key of each queued path.
+rtDeclareVariable(float, sysWavefrontSortCell, , ); // Edge length of the origin cells in world space.
+rtBuffer<unsigned int>   sysWavefrontKeys;          // Sort key per output queue slot.
+rtBuffer<unsigned int>   sysWavefrontBins;          // [0, WAVEFRONT_SORT_BINS) == paths per key, then the scatter offset per key.
+#endif
+
+// The radiance (and denoiser data) of the current iteration per pixel. Resolved into the output buffers at the end.
+rtBuffer<float4, 2> sysWavefrontRadiance;
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+rtBuffer<float4, 2> sysWavefrontAlbedo;
+#if USE_DENOISER_NORMAL
+rtBuffer<float4, 2> sysWavefrontNormal;
+#endif
+#endif
+#endif
+
+// Bindless callable programs implementing different lens shaders.
+rtBuffer< rtCallableProgramId<void(const float2 pixel, const float2 screen, const float2 sample, const float2 aperture, float3& origin, float3& direction)> > sysLensShader;
+
+// Declared as uint2 for all three programs. The 1D extend launch only uses the .x component.
+rtDeclareVariable(uint2, sysResolution, , ); // The rendered sub-rectangle of the buffers. The generate launch has this size.
+
+rtDeclareVariable(uint2, theLaunchDim,   rtLaunchDim, );
+rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
+
+#if USE_POSTER_TILES
+rtDeclareVariable(uint2, sysPosterOffset, , );     // Pixel of the poster at the lower left corner of the rendered tile.
+rtDeclareVariable(uint2, sysPosterResolution, , ); // The full poster the camera projects onto. (0, 0) == off.
+#endif
+
+
+#if USE_WAVEFRONT_SORT
+// Paths leaving the same material from nearby origins into similar directions get the same key.
+RT_FUNCTION unsigned int wavefrontSortKey(const int materialIndex, const float3 pos, const float3 wi)
+{
+  const float3 cell = pos / sysWavefrontSortCell;
+
+  unsigned int origin = ((unsigned int) (int) floorf(cell.x) * 73856093u) ^
+                        ((unsigned int) (int) floorf(cell.y) * 19349663u) ^
+                        ((unsigned int) (int) floorf(cell.z) * 83492791u);
+  origin = (origin ^ (origin >> 16)) & ((1u << WAVEFRONT_SORT_ORIGIN_BITS) - 1u);
+
+  // The two snorm16 octahedral coordinates to offset binary, the top two bits of each select one of 4x4 direction cells.
+  const unsigned int octahedral = encodeOctahedral(wi);
+  const unsigned int direction  = ((((octahedral & 0xFFFF) ^ 0x8000) >> 14) << 2) | (((octahedral >> 16) ^ 0x8000) >> 14);
+
+  const unsigned int material = (unsigned int) materialIndex & ((1u << WAVEFRONT_SORT_MATERIAL_BITS) - 1u);
+
+  return (((material << WAVEFRONT_SORT_ORIGIN_BITS) | origin) << WAVEFRONT_SORT_DIRECTION_BITS) | direction;
+}
+#endif
+
+
+// 2D launch over all pixels. Generates the primary rays and fills the first input queue densely.
+RT_PROGRAM void wavefront_generate()
+{
+  const unsigned int pixel = theLaunchIndex.y * theLaunchDim.x + theLaunchIndex.x;
+
+  WavefrontPath path;
+
+  // Same random number sequence as raygeneration() to get identical results from both integrators.
+  PerRayData prd;
+  initSampler(prd, pixel, sysIterationIndex);
+
+  // Poster tiles project through their sub-rectangle of the poster. The random sequences stay per tile pixel,
+  // because the extend launches reinitialize the sampler from path.pixel.
+  float2 cameraPixel  = make_float2(theLaunchIndex);
+  float2 cameraScreen = make_float2(theLaunchDim);
+#if USE_POSTER_TILES
+  if (sysPosterResolution.x != 0)
+  {
+    cameraPixel += make_float2(sysPosterOffset);
+    cameraScreen = make_float2(sysPosterResolution);
+  }
+#endif
+
+#if USE_PINHOLE_FAST_PATH
+  if (sysCameraType == LENS_SHADER_PINHOLE)
+  {
+    path.pos = sysCameraPosition;
+    path.wi  = optix::normalize(pinholeDirection(cameraPixel, cameraScreen, filterPixelSample(sample2D(prd, SAMPLE_LENS)), sysCameraU, sysCameraV, sysCameraW));
+  }
+  else
+#endif
+  {
+    sysLensShader[sysCameraType](cameraPixel, cameraScreen, filterPixelSample(sample2D(prd, SAMPLE_LENS)), sample2D(prd, SAMPLE_APERTURE), path.pos, path.wi);
+  }
+
+  // case 0: Standard stochastic motion blur.
+#if USE_STRATIFIED_SHUTTER
+  float time = sampleShutterTime(prd, (sysShutterType == 0) ? sysTimeSlices : 1);
+#else
+  float time = sample1D(prd, SAMPLE_TIME);
+#endif
+
+  switch (sysShutterType)
+  {
+    case 1: // Rolling shutter from top to bottom. 
+      time = (float(theLaunchDim.y - 1 - theLaunchIndex.y) + time) / float(theLaunchDim.y);
+      break;
+    case 2: // Rolling shutter from bottom to top. 
+      time = (float(theLaunchIndex.y) + time) / float(theLaunchDim.y);
+      break;
+    case 3: // Rolling shutter from left to right.
+      time = (float(theLaunchIndex.x) + time) / float(theLaunchDim.x);
+      break;
+    case 4: // Rolling shutter from right to left.
+      time = (float(theLaunchDim.x - 1 - theLaunchIndex.x) + time) / float(theLaunchDim.x);
+      break;
+  }
+
+  path.seed       = prd.seed;
+  path.pixel      = pixel;
+  path.throughput = make_float3(1.0f);
+  path.stackIdx   = MATERIAL_STACK_EMPTY;
+  path.flags      = 0;
+  path.pdf        = 0.0f;
+  path.time       = time;
+#if USE_RAY_CONES
+  path.cone       = encodeCone(make_float2(0.0f, pixelSpreadAngle(sysCameraType, cameraScreen, sysCameraV, sysCameraW)));
+#endif
+
+  sysWavefrontPaths[pixel] = path; // Input queue 0 holds all paths. The host sets sysWavefrontParity to 0.
+
+  sysWavefrontRadiance[theLaunchIndex] = make_float4(0.0f);
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  sysWavefrontAlbedo[theLaunchIndex] = make_float4(0.0f);
+#if USE_DENOISER_NORMAL
+  sysWavefrontNormal[theLaunchIndex] = make_float4(0.0f);
+#endif
+#endif
+#endif
+}
+
+
+// 1D launch over the live paths in the input queue. Traces one path segment per path and
+// appends each path which is not terminated to the output queue.
+// This is the body of the while-loop inside integrator() in raygeneration.cu.
+RT_PROGRAM void wavefront_extend()
+{
+  const uint2        size     = make_uint2(sysWavefrontRadiance.size());
+  const unsigned int capacity = size.x * size.y;
+
+  WavefrontPath path = sysWavefrontPaths[sysWavefrontParity * capacity + theLaunchIndex.x];
+
+  const uint2 index = make_uint2(path.pixel % sysResolution.x, path.pixel / sysResolution.x);
+
+  PerRayData prd;
+
+  prd.pos            = path.pos;
+  setWi(prd, path.wi);
+  initSampler(prd, path.pixel, sysIterationIndex); // The low-discrepancy sampler state is implicit in pixel, iteration and depth.
+  prd.flags          = path.flags;                 // Before the bounce, the compact payload stores the sampler dimension in the flags.
+  setSamplerBounce(prd, sysWavefrontDepth);
+  prd.seed           = path.seed;                  // Continue the LCG state.
+  prd.pdf            = path.pdf;
+  prd.absorption_ior = make_float4(0.0f, 0.0f, 0.0f, 1.0f);
+#if USE_RAY_CONES
+  setCone(prd, decodeCone(path.cone));
+#endif
+#if USE_WAVEFRONT_SORT
+  prd.materialIndex  = 0;
+#endif
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+#if USE_DENOISER_NORMAL
+#if !USE_COMPACT_PAYLOAD
+  prd.normal = make_float3(0.0f); // Important if nothing is hit!
+#endif
+#endif
+#endif
+#endif
+
+#if !USE_COMPACT_PAYLOAD
+  prd.wo        = -prd.wi;           // Direction to observer.
+#endif
+  prd.ior       = make_float2(1.0f); // Reset the volume IORs.
+  prd.distance  = RT_DEFAULT_MAX;    // Shoot the next ray with maximum length.
+  prd.flags    &= FLAG_CLEAR_MASK;   // Clear all non-persistent flags.
+
+  // Handle volume absorption of nested materials.
+  if (MATERIAL_STACK_FIRST <= path.stackIdx) // Inside a volume?
+  {
+    prd.flags     |= FLAG_VOLUME;
+    prd.extinction = make_float3(path.absorptionStack[path.stackIdx]);
+    prd.ior.x      = path.absorptionStack[path.stackIdx].w;
+    if (MATERIAL_STACK_FIRST <= path.stackIdx - 1)
+    {
+      prd.ior.y = path.absorptionStack[path.stackIdx - 1].w;
+    }
+  }
+
+#if USE_PATH_STATISTICS
+  recordPathStatistic(sysWavefrontDepth, PATH_STATISTICS_PATHS, 1.0f);
+#endif
+
+  optix::Ray ray = optix::make_Ray(prd.pos, getWi(prd), 0, sysSceneEpsilon, prd.distance);
+#if USE_RAY_COUNTERS
+  countRay(RAY_COUNTER_RADIANCE);
+#endif
+  rtTrace(sysTopObject, ray, path.time, prd); 
+
+  if (prd.flags & FLAG_VOLUME)
+  {
+    path.throughput *= expf(-prd.distance * prd.extinction);
+  }
+
+  // Each path owns its pixel. No atomics needed for the accumulation.
+  sysWavefrontRadiance[index] += make_float4(path.throughput * prd.radiance, 0.0f);
+
+#if USE_PATH_STATISTICS
+  if (isNotNull(prd.radiance))
+  {
+    recordPathStatistic(sysWavefrontDepth, PATH_STATISTICS_RADIANCE, intensity(path.throughput * prd.radiance));
+  }
+#endif
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  // Same albedo rule as integrator(): Write once at the first diffuse or light hit.
+  if (!(prd.flags & FLAG_ALBEDO) && (prd.flags & (FLAG_DIFFUSE | FLAG_LIGHT)))
+  {
+    sysWavefrontAlbedo[index] = make_float4(optix::clamp(path.throughput * getAlbedo(prd), 0.0f, 1.0f), 1.0f);
+
+    prd.flags |= FLAG_ALBEDO;
+  }
+#if USE_DENOISER_NORMAL
+  if (sysWavefrontDepth == 0 && (prd.flags & FLAG_HIT))
+  {
+    const float3 normal = getNormal(prd);
+
+    sysWavefrontNormal[index] = make_float4( optix::dot(normal, optix::normalize(sysCameraU)), 
+                                             optix::dot(normal, optix::normalize(sysCameraV)), 
+                                            -optix::dot(normal, optix::normalize(sysCameraW)), 0.0f);
+  }
+#endif
+#endif
+#endif
+
+  // Path termination by miss shader or sample() routines.
+  if ((prd.flags & FLAG_TERMINATE) || prd.pdf <= 0.0f || isNull(prd.f_over_pdf))
+  {
+#if USE_RAY_COUNTERS
+    countRay(terminationCounter(prd.flags));
+#endif
+    return;
+  }
+
+  path.throughput *= prd.f_over_pdf;
+
+  // Unbiased Russian Roulette path termination.
+  if (sysPathLengths.x <= sysWavefrontDepth)
+  {
+    // sysOutputBuffer still holds the estimate of the previous iterations. The resolve launch runs after the last segment.
+    const float pixelMean   = (sysRouletteType == ROULETTE_WEIGHT_WINDOW && 0 < sysIterationIndex) ? intensity3(sysOutputBuffer[index]) : 0.0f;
+    const float probability = continuationProbability(path.throughput, pixelMean);
+#if USE_PATH_STATISTICS
+    recordPathStatistic(sysWavefrontDepth, PATH_STATISTICS_TESTS, 1.0f);
+    recordPathStatistic(sysWavefrontDepth, PATH_STATISTICS_PROBABILITY, probability);
+#endif
+    if (probability < sample1D(prd, SAMPLE_RR))
+    {
+#if USE_PATH_STATISTICS
+      recordPathStatistic(sysWavefrontDepth, PATH_STATISTICS_TERMINATED, 1.0f);
+#endif
+#if USE_RAY_COUNTERS
+      countRay(RAY_COUNTER_END_ROULETTE);
+#endif
+      return;
+    }
+    path.throughput /= probability;
+  }
+
+  // Adjust the material volume stack if the geometry is not thin-walled but a border between two volumes 
+  // and the outgoing ray direction was a transmission.
+  if ((prd.flags & (FLAG_THINWALLED | FLAG_TRANSMISSION)) == FLAG_TRANSMISSION) 
+  {
+    if (prd.flags & FLAG_FRONTFACE) // Entered a new volume?
+    {
+      path.stackIdx = min(path.stackIdx + 1, MATERIAL_STACK_LAST);
+      path.absorptionStack[path.stackIdx] = prd.absorption_ior;
+    }
+    else // Exited the current volume?
+    {
+      path.stackIdx = max(path.stackIdx - 1, MATERIAL_STACK_EMPTY);
+    }
+  }
+
+  // The last segment doesn't need to be queued. The host stops after sysPathLengths.y extend launches.
+  if (sysPathLengths.y <= sysWavefrontDepth + 1)
+  {
+#if USE_RAY_COUNTERS
+    countRay(RAY_COUNTER_END_LENGTH);
+#endif
+    return;
+  }
+
+  path.pos   = prd.pos;
+  path.wi    = getWi(prd);
+  path.seed  = prd.seed;
+  path.flags = prd.flags & FLAG_CLEAR_MASK;
+  path.pdf   = prd.pdf;
+#if USE_RAY_CONES
+  path.cone  = encodeCone(getCone(prd));
+#endif
+
+  // Compaction: Only live paths are appended to the output queue.
+  const unsigned int slot = atomicAdd(&sysWavefrontCounter[0], 1u);
+
+  sysWavefrontPaths[(1 - sysWavefrontParity) * capacity + slot] = path;
+
+#if USE_WAVEFRONT_SORT
+  if (sysWavefrontSort)
+  {
+    const unsigned int key = wavefrontSortKey(prd.materialIndex, path.pos, path.wi);
+
+    sysWavefrontKeys[slot] = key;
+    atomicAdd(&sysWavefrontBins[key], 1u);
+  }
+#endif
+}
+
+
+#if USE_WAVEFRONT_SORT
+// 1D launch over the output queue of the last extend launch. The host turned the bin counts into the first slot of each key.
+// Scatters the paths into the input queue, which the extend launch doesn't need anymore, so the next extend launch
+// reads the same queue half again. The order inside a key is arbitrary.
+RT_PROGRAM void wavefront_sort()
+{
+  const uint2        size     = make_uint2(sysWavefrontRadiance.size());
+  const unsigned int capacity = size.x * size.y;
+
+  const unsigned int key  = sysWavefrontKeys[theLaunchIndex.x];
+  const unsigned int slot = atomicAdd(&sysWavefrontBins[WAVEFRONT_SORT_BINS + key], 1u);
+
+  sysWavefrontPaths[sysWavefrontParity * capacity + slot] = sysWavefrontPaths[(1 - sysWavefrontParity) * capacity + theLaunchIndex.x];
+}
+#endif
+
+
+// 2D launch over all pixels. Same accumulation as at the end of raygeneration().
+RT_PROGRAM void wavefront_resolve()
+{
+  const float3 radiance = make_float3(sysWavefrontRadiance[theLaunchIndex]);
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+  const float3 albedo = make_float3(sysWavefrontAlbedo[theLaunchIndex]);
+#if USE_DENOISER_NORMAL
+  const float3 normal = make_float3(sysWavefrontNormal[theLaunchIndex]);
+#endif
+#endif
+#endif
+
+  // NaN values will never go away. Filter them out before they can arrive in the output buffer.
+  if (!(isnan(radiance.x) || isnan(radiance.y) || isnan(radiance.z)))
+  {
+    if (0 < sysIterationIndex)
+    {
+      const float t = 1.0f / (float) (sysIterationIndex + 1);
+
+      float3 dst = make_float3(sysOutputBuffer[theLaunchIndex]);  // RGBA32F
+      sysOutputBuffer[theLaunchIndex] = make_float4(optix::lerp(dst, radiance, t), 1.0f);
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+      dst = make_float3(sysAlbedoBuffer[theLaunchIndex]);  // RGBA32F
+      sysAlbedoBuffer[theLaunchIndex] = make_float4(optix::lerp(dst, albedo, t), 1.0f);
+#if USE_DENOISER_NORMAL
+      dst = make_float3(sysNormalBuffer[theLaunchIndex]); // xyz0
+      dst = optix::lerp(dst, normal, t);
+      if (isNotNull(dst))
+      {
+        dst = optix::normalize(dst);
+      }
+      sysNormalBuffer[theLaunchIndex] = make_float4(dst, 0.0f);
+#endif
+#endif
+#endif
+    }
+    else
+    {
+      sysOutputBuffer[theLaunchIndex] = make_float4(radiance, 1.0f);
+
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+      sysAlbedoBuffer[theLaunchIndex] = make_float4(albedo, 1.0f);
+#if USE_DENOISER_NORMAL
+      sysNormalBuffer[theLaunchIndex] = make_float4(normal, 0.0f);
+#endif
+#endif
+#endif
+    }
+  }
+}
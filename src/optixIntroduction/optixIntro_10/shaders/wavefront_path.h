@@ -0,0 +1,72 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef WAVEFRONT_PATH_H
+#define WAVEFRONT_PATH_H
+
+#include "app_config.h"
+
+#include "per_ray_data.h"
+
+// The state of one live path between two launches of the wavefront path tracer.
+// Everything integrator() keeps in registers across its loop iterations needs to be stored here.
+// Note that the fields are ordered by CUDA alignment restrictions. Size is 128 bytes.
+struct WavefrontPath
+{
+  optix::float4 absorptionStack[MATERIAL_STACK_SIZE]; // .xyz == absorptionCoefficient (sigma_a), .w == index of refraction
+
+  optix::float3 pos;        // Origin of the next path segment, in world space.
+  unsigned int  seed;       // Random number generator state.
+
+  optix::float3 wi;         // Direction of the next path segment, in world space.
+  unsigned int  pixel;      // Linear index of the pixel this path belongs to.
+
+  optix::float3 throughput; // The throughput for the next radiance.
+  int           stackIdx;   // Top of the nested materials stack.
+
+  int           flags;      // Persistent PerRayData flags (FLAG_DIFFUSE, FLAG_ALBEDO).
+  float         pdf;        // The last BSDF sample's pdf, needed for multiple importance sampling of implicit light hits.
+  float         time;       // The time of this path inside the camera shutter interval.
+#if USE_RAY_CONES
+  unsigned int  cone;       // Ray cone width and spread angle at pos as two half floats. See encodeCone().
+#else
+  float         unused0;    // Manual padding to float4 alignment.
+#endif
+};
+
+#if USE_WAVEFRONT_SORT
+// The sort key of a live path, most significant first: material index, origin cell hash, octahedral direction cell.
+#define WAVEFRONT_SORT_MATERIAL_BITS  5
+#define WAVEFRONT_SORT_ORIGIN_BITS    3
+#define WAVEFRONT_SORT_DIRECTION_BITS 4 // 4x4 cells of the octahedral direction mapping.
+#define WAVEFRONT_SORT_BINS (1 << (WAVEFRONT_SORT_MATERIAL_BITS + WAVEFRONT_SORT_ORIGIN_BITS + WAVEFRONT_SORT_DIRECTION_BITS))
+#endif
+
+#endif // WAVEFRONT_PATH_H
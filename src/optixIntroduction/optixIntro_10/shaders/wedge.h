@@ -0,0 +1,68 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#ifndef WEDGE_H
+#define WEDGE_H
+
+#include "app_config.h"
+
+#include <optix.h>
+
+#include "rt_function.h"
+
+// Upper limit of the material variants rendered together by one ENTRY_RENDER_WEDGE launch.
+#define WEDGE_MAX_VARIANTS 64
+
+// The MaterialParameterGUI fields a wedge file can vary.
+#define WEDGE_PARAMETER_ALBEDO       0
+#define WEDGE_PARAMETER_ABSORPTION   1
+#define WEDGE_PARAMETER_IOR          2
+#define WEDGE_PARAMETER_VOLUME_SCALE 3
+
+#if defined(__CUDACC__)
+#if USE_WEDGE
+// The wedge launch is 3D over (width, height, variant). All other launches have z == 0 or run with sysMaterialStride == 0.
+rtDeclareVariable(uint3, theLaunchIndexWedge, rtLaunchIndex, );
+rtDeclareVariable(int,   sysMaterialStride, , ); // Number of materials per variant inside sysMaterialParameters, 0 outside the wedge launch.
+#endif
+
+// Index into sysMaterialParameters of the material in the variant of the current launch index.
+RT_FUNCTION int materialParameterIndex(const int index)
+{
+#if USE_WEDGE
+  return index + int(theLaunchIndexWedge.z) * sysMaterialStride;
+#else
+  return index;
+#endif
+}
+#endif
+
+#endif // WEDGE_H
@@ -0,0 +1,246 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Application.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "inc/MyAssert.h"
+
+// 64-bit FNV-1a.
+static unsigned long long hashBytes(unsigned long long hash, const void* data, const size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static unsigned long long hashString(unsigned long long hash, std::string const& s)
+{
+  return hashBytes(hash, s.c_str(), s.size() + 1); // Including the terminator to separate consecutive strings.
+}
+
+static unsigned long long hashBuffer(unsigned long long hash, optix::Buffer buffer)
+{
+  RTsize size = 0;
+  buffer->getSize(size);
+  const size_t numBytes = buffer->getElementSize() * size;
+
+  hash = hashBytes(hash, &numBytes, sizeof(size_t));
+  hash = hashBytes(hash, buffer->map(0, RT_BUFFER_MAP_READ), numBytes);
+  buffer->unmap();
+
+  return hash;
+}
+
+// Collects all GeometryGroups below the Group, looking through Transforms and nested Groups.
+void Application::gatherGeometryGroups(optix::Group group, std::vector<optix::GeometryGroup>& geometryGroups)
+{
+  for (unsigned int i = 0; i < group->getChildCount(); ++i)
+  {
+    RTobjecttype type = group->getChildType(i);
+
+    if (type == RT_OBJECTTYPE_TRANSFORM)
+    {
+      optix::Transform tr = group->getChild<optix::Transform>(i);
+      while (tr->getChildType() == RT_OBJECTTYPE_TRANSFORM)
+      {
+        tr = tr->getChild<optix::Transform>();
+      }
+      type = tr->getChildType();
+      if (type == RT_OBJECTTYPE_GEOMETRY_GROUP)
+      {
+        geometryGroups.push_back(tr->getChild<optix::GeometryGroup>());
+      }
+      else if (type == RT_OBJECTTYPE_GROUP)
+      {
+        gatherGeometryGroups(tr->getChild<optix::Group>(), geometryGroups);
+      }
+    }
+    else if (type == RT_OBJECTTYPE_GEOMETRY_GROUP)
+    {
+      geometryGroups.push_back(group->getChild<optix::GeometryGroup>(i));
+    }
+    else if (type == RT_OBJECTTYPE_GROUP)
+    {
+      gatherGeometryGroups(group->getChild<optix::Group>(i), geometryGroups);
+    }
+  }
+}
+
+
+// Returns the named buffer of the geometry attached to the GeometryInstance, which is either a Geometry or GeometryTriangles.
+optix::Buffer Application::getInstanceBuffer(optix::GeometryInstance instance, const char* name)
+{
+#if OPTIX_VERSION >= 60000
+  if (m_geometryTriangles)
+  {
+    return instance->getGeometryTriangles()[name]->getBuffer();
+  }
+#endif
+  return instance->getGeometry()[name]->getBuffer();
+}
+
+
+// Restores the bottom level Accelerations from the cache directory before the first launch builds them.
+// The cache key is a hash over the builder, its properties, the geometry type, and the vertex and index data of all GeometryInstances.
+// Any change to these results in a different file, stale files are simply never read again.
+// The top level Acceleration is always built, it only holds the few instance bounding boxes.
+void Application::restoreAccelerations()
+{
+  m_accelerationCacheEntries.clear();
+
+  try
+  {
+    std::vector<optix::GeometryGroup> geometryGroups;
+    gatherGeometryGroups(m_rootGroup, geometryGroups);
+
+    std::map<RTacceleration, size_t> mapOfEntries; // Instanced meshes share one Acceleration among many GeometryGroups.
+
+    unsigned int numRestored = 0;
+
+    for (size_t i = 0; i < geometryGroups.size(); ++i)
+    {
+      optix::GeometryGroup gg = geometryGroups[i];
+      optix::Acceleration acceleration = gg->getAcceleration();
+
+      if (mapOfEntries.find(acceleration->get()) != mapOfEntries.end())
+      {
+        continue;
+      }
+
+      unsigned long long hash = 14695981039346656037ull;
+
+      hash = hashString(hash, acceleration->getBuilder());
+      hash = hashString(hash, acceleration->getProperty("vertex_buffer_name"));
+      hash = hashString(hash, acceleration->getProperty("vertex_buffer_stride"));
+      hash = hashString(hash, acceleration->getProperty("index_buffer_name"));
+      hash = hashString(hash, acceleration->getProperty("index_buffer_stride"));
+
+      const int version = OPTIX_VERSION;
+      hash = hashBytes(hash, &version, sizeof(int));
+      hash = hashBytes(hash, &m_geometryTriangles, sizeof(bool));
+
+      const unsigned int count = gg->getChildCount();
+      hash = hashBytes(hash, &count, sizeof(unsigned int));
+
+      for (unsigned int j = 0; j < count; ++j)
+      {
+        optix::GeometryInstance gi = gg->getChild(j);
+#if USE_COMPACT_ATTRIBUTES
+        hash = hashBuffer(hash, getInstanceBuffer(gi, "positionsBuffer"));
+#else
+        hash = hashBuffer(hash, getInstanceBuffer(gi, "attributesBuffer"));
+#endif
+        hash = hashBuffer(hash, getInstanceBuffer(gi, "indicesBuffer"));
+      }
+
+      char name[32];
+      sprintf(name, "%016llx.accel", hash);
+
+      AccelerationCacheEntry entry;
+
+      entry.acceleration = acceleration;
+      entry.filename     = m_accelerationCache + std::string("/") + std::string(name);
+      entry.restored     = false;
+
+      std::ifstream input(entry.filename, std::ios::binary);
+      if (input)
+      {
+        std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        if (!data.empty())
+        {
+          try
+          {
+            acceleration->setData(data.data(), data.size());
+            entry.restored = true;
+            ++numRestored;
+          }
+          catch(optix::Exception& e)
+          {
+            std::cerr << "WARNING: restoreAccelerations() " << entry.filename << ": " << e.getErrorString() << std::endl;
+            acceleration->markDirty(); // Rebuild and overwrite the file.
+          }
+        }
+      }
+
+      mapOfEntries[acceleration->get()] = m_accelerationCacheEntries.size();
+      m_accelerationCacheEntries.push_back(entry);
+    }
+
+    std::cout << "restoreAccelerations(): Restored " << numRestored << " of " << m_accelerationCacheEntries.size() << " Accelerations" << std::endl;
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+
+// Writes all Accelerations which were built by the first launch into the cache directory.
+void Application::storeAccelerations()
+{
+  try
+  {
+    for (size_t i = 0; i < m_accelerationCacheEntries.size(); ++i)
+    {
+      AccelerationCacheEntry& entry = m_accelerationCacheEntries[i];
+
+      if (entry.restored)
+      {
+        continue;
+      }
+
+      const RTsize size = entry.acceleration->getDataSize();
+
+      std::vector<char> data(size);
+      entry.acceleration->getData(data.data());
+
+      std::ofstream output(entry.filename, std::ios::binary);
+      if (!output)
+      {
+        std::cerr << "WARNING: storeAccelerations() cannot write " << entry.filename << std::endl;
+        continue;
+      }
+      output.write(data.data(), data.size());
+
+      entry.restored = true; // Written once.
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
@@ -0,0 +1,110 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_ACCELERATION_POLICY
+
+#include <iostream>
+
+// Acceleration builder selection per OptiX node.
+//
+// One builder for every Acceleration is either too slow to build or too slow to trace for some of them.
+// Groups with only a handful of primitives are fastest without any hierarchy, the ray tests them all (NoAccel).
+// Large static meshes are built once and traced millions of times per second, the spatial splits of Sbvh pay off there.
+// Everything in between and every mesh which deforms uses Trbvh, which builds fast and supports refits.
+// The top level Acceleration is rebuilt whenever an instance moves, it only gets a hierarchy when it has enough children.
+// The scene description can force the builder of a mesh with the "builder" statement, which also survives the animation.
+// With GeometryTriangles the RTX execution strategy builds the bottom levels in hardware and ignores the builder name,
+// so those keep m_builder.
+
+#define ACCELERATION_NOACCEL_PRIMITIVES 16     // Up to this many primitives (or children) are intersected without a hierarchy.
+#define ACCELERATION_SBVH_PRIMITIVES    100000 // From this many triangles on static meshes use the splitting builder.
+
+bool Application::isBuilderSupported(std::string const& builder)
+{
+  return builder == "NoAccel" || builder == "Bvh" || builder == "Sbvh" || builder == "Trbvh";
+}
+
+
+std::string Application::selectBuilder(const unsigned int numPrimitives, const AccelerationUsage usage) const
+{
+  if (usage == ACCELERATION_TOP_LEVEL)
+  {
+    return (numPrimitives <= ACCELERATION_NOACCEL_PRIMITIVES) ? std::string("NoAccel") : m_builder;
+  }
+  if (m_geometryTriangles)
+  {
+    return m_builder;
+  }
+  if (numPrimitives <= ACCELERATION_NOACCEL_PRIMITIVES)
+  {
+    return std::string("NoAccel");
+  }
+  if (usage == ACCELERATION_STATIC && ACCELERATION_SBVH_PRIMITIVES <= numPrimitives)
+  {
+    return std::string("Sbvh");
+  }
+  return m_builder;
+}
+
+
+// Called after createScene() when the number of root children is known.
+void Application::selectTopLevelBuilder()
+{
+  const std::string builder = selectBuilder(m_rootGroup->getChildCount(), ACCELERATION_TOP_LEVEL);
+  if (builder != m_rootAcceleration->getBuilder())
+  {
+    m_rootAcceleration->setBuilder(builder);
+    m_rootAcceleration->markDirty();
+  }
+}
+
+
+// Called on the first deformation of a mesh. Returns true when the builder changed, which needs a rebuild instead of a refit.
+bool Application::selectAnimatedBuilder(optix::Acceleration acceleration)
+{
+  if (m_fixedBuilders.find(acceleration->get()) != m_fixedBuilders.end())
+  {
+    return false; // Forced by the scene description.
+  }
+
+  const std::string builder = (acceleration->getBuilder() == std::string("NoAccel")) ? acceleration->getBuilder() : m_builder;
+  if (builder == acceleration->getBuilder())
+  {
+    return false;
+  }
+
+  std::cout << "selectAnimatedBuilder(): " << acceleration->getBuilder() << " -> " << builder << std::endl;
+  acceleration->setBuilder(builder);
+  setAccelerationProperties(acceleration);
+  return true;
+}
+
+#endif // USE_ACCELERATION_POLICY
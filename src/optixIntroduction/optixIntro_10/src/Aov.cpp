@@ -0,0 +1,215 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_AOVS
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+#include <sutil.h>
+
+#include "shaders/aov_type.h"
+
+// Arbitrary output variables for compositing.
+//
+// The megakernel integrator splits each path into the AOVs while it traces it, see shaders/aov.h, so they cost no
+// additional rays. Every enabled AOV is an RGBA32F buffer which accumulation blends like the output buffer.
+// sysAovBuffers holds their bindless IDs. The disabled ones are neither allocated nor written.
+// The preview, the wedge and the wavefront renderer don't fill them.
+//
+// writeImage() stores each enabled AOV as <name>_<aov>.exr next to the image.
+
+std::string Application::getAovName(const int aov)
+{
+  static const char* const names[AOV_LIGHT_GROUP] = { "depth", "position", "normal", "material", "direct", "indirect" };
+
+  if (aov < AOV_LIGHT_GROUP)
+  {
+    return std::string(names[aov]);
+  }
+  std::ostringstream name;
+  name << "light" << (aov - AOV_LIGHT_GROUP);
+  return name.str();
+}
+
+void Application::initAovs()
+{
+  m_bufferAovs.resize(NUMBER_OF_AOVS);
+
+  m_bufferAovIds = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_INT, NUMBER_OF_AOVS);
+
+  int* ids = static_cast<int*>(m_bufferAovIds->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  for (int i = 0; i < NUMBER_OF_AOVS; ++i)
+  {
+    ids[i] = RT_BUFFER_ID_NULL;
+  }
+  m_bufferAovIds->unmap();
+
+  m_context["sysAovBuffers"]->setBuffer(m_bufferAovIds);
+  m_context["sysAovMask"]->setUint(0);
+  m_context["sysAovIteration"]->setInt(0);
+
+#if USE_PREVIEW_RESOLUTION
+  // The preview resolution doesn't match the AOV buffers.
+  m_mapOfPrograms["raygeneration_preview"]["sysAovMask"]->setUint(0);
+#endif
+#if USE_WEDGE
+  m_mapOfPrograms["raygeneration_wedge"]["sysAovMask"]->setUint(0); // Writes its own buffers and not accumulatePixel().
+#endif
+}
+
+// names is a comma separated list of getAovName() values. "lights" selects all light groups.
+bool Application::setAovs(std::string const& names)
+{
+  unsigned int mask = 0;
+
+  std::istringstream tokens(names);
+  std::string name;
+  while (std::getline(tokens, name, ','))
+  {
+    if (name.empty())
+    {
+      continue;
+    }
+    if (name == "lights")
+    {
+      mask |= AOV_LIGHT_GROUP_MASK;
+      continue;
+    }
+
+    int aov = 0;
+    while (aov < NUMBER_OF_AOVS && getAovName(aov) != name)
+    {
+      ++aov;
+    }
+    if (aov == NUMBER_OF_AOVS)
+    {
+      std::cerr << "ERROR: setAovs() unknown AOV '" << name << "'" << std::endl;
+      return false;
+    }
+    mask |= AOV_BIT(aov);
+  }
+
+  // Same size as the output buffer, which has the resize headroom when USE_RESIZE_CAPACITY is active.
+  RTsize width;
+  RTsize height;
+  m_bufferOutput->getSize(width, height);
+
+  int* ids = static_cast<int*>(m_bufferAovIds->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  for (int i = 0; i < NUMBER_OF_AOVS; ++i)
+  {
+    if (mask & AOV_BIT(i))
+    {
+      if (!m_bufferAovs[i])
+      {
+        m_bufferAovs[i] = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, width, height);
+      }
+      ids[i] = m_bufferAovs[i]->getId();
+    }
+    else
+    {
+      if (m_bufferAovs[i])
+      {
+        m_bufferAovs[i]->destroy();
+        m_bufferAovs[i] = nullptr;
+      }
+      ids[i] = RT_BUFFER_ID_NULL;
+    }
+  }
+  m_bufferAovIds->unmap();
+
+  m_aovMask = mask;
+
+  m_context["sysAovMask"]->setUint(m_aovMask);
+  m_context["sysAovIteration"]->setInt(m_iterationIndex); // The AOVs start empty.
+  return true;
+}
+
+bool Application::isAovSupported() const
+{
+  bool supported = (m_aovMask != 0);
+#if USE_WAVEFRONT
+  supported = supported && !m_wavefront;
+#endif
+#if USE_WEDGE
+  supported = supported && !m_wedgeActive;
+#endif
+  return supported;
+}
+
+void Application::resizeAovs(const int width, const int height)
+{
+  for (size_t i = 0; i < m_bufferAovs.size(); ++i)
+  {
+    if (m_bufferAovs[i])
+    {
+      m_bufferAovs[i]->setSize(width, height);
+    }
+  }
+}
+
+// Writes <name>_<aov>.exr per enabled AOV. They are float data, the extension of the image doesn't apply.
+void Application::writeAovs(std::string const& filename)
+{
+  if (!isAovSupported())
+  {
+    return;
+  }
+
+  std::string name = filename;
+
+  const std::string::size_type dot   = filename.find_last_of('.');
+  const std::string::size_type slash = filename.find_last_of("/\\");
+  if (dot != std::string::npos && (slash == std::string::npos || slash < dot))
+  {
+    name = filename.substr(0, dot);
+  }
+
+  for (int i = 0; i < NUMBER_OF_AOVS; ++i)
+  {
+    if (!(m_aovMask & AOV_BIT(i)))
+    {
+      continue;
+    }
+
+    const std::string aovFilename = name + std::string("_") + getAovName(i) + std::string(".exr");
+#if USE_ASYNC_SCREENSHOTS
+    m_imageWriter.write(aovFilename, m_bufferAovs[i], optix::Buffer(), optix::Buffer());
+    std::cerr << "Writing " << aovFilename << std::endl;
+#else
+    sutil::writeBuffersToFile(aovFilename.c_str(), m_bufferAovs[i], optix::Buffer(), optix::Buffer());
+    std::cerr << "Wrote " << aovFilename << std::endl;
+#endif
+  }
+}
+
+#endif // USE_AOVS
@@ -0,0 +1,172 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Application.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "inc/MyAssert.h"
+
+// Resolution of the coverage mask from which the aperture table is derived.
+#define APERTURE_MASK_SIZE (4 * APERTURE_TABLE_SIZE)
+
+// Inside test of the bokeh shape in the range [-1, 1]^2.
+// blades < 3 is the circular aperture, otherwise a regular polygon inscribed in the unit circle rotated by the given angle in radians.
+static bool insideAperture(const float x, const float y, const int blades, const float rotation)
+{
+  const float r = sqrtf(x * x + y * y);
+  if (blades < 3)
+  {
+    return r <= 1.0f;
+  }
+
+  const float sector = 2.0f * M_PIf / float(blades);
+
+  float phi = atan2f(y, x) - rotation;
+  phi -= floorf(phi / sector) * sector; // [0, sector)
+
+  // Distance of the polygon edge from the center in the direction phi.
+  return r * cosf(phi - 0.5f * sector) <= cosf(0.5f * sector);
+}
+
+// Continuous inverse of the piecewise linear CDF with cdf.size() - 1 cells, cdf.front() == 0.0f, cdf.back() == 1.0f and u in [0, 1].
+// Returns the position in the range [0, cdf.size() - 1] and the non-empty cell containing it.
+// Empty cells are never returned, so u == 0.0f and u == 1.0f land on the boundary of the shape and not on the mask border.
+static float invertCDF(const std::vector<float>& cdf, const float u, size_t& cell)
+{
+  if (1.0f <= u)
+  {
+    cell = std::lower_bound(cdf.begin(), cdf.end(), 1.0f) - cdf.begin() - 1; // Last non-empty cell.
+    return float(cell + 1);
+  }
+
+  cell = std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin() - 1; // cdf[cell] <= u < cdf[cell + 1]
+
+  return float(cell) + (u - cdf[cell]) / (cdf[cell + 1] - cdf[cell]);
+}
+
+// Builds the CDF over the cells of values. Returns false when all values are zero, then the CDF is uniform.
+static bool buildCDF(const float* values, const size_t count, std::vector<float>& cdf)
+{
+  cdf.resize(count + 1);
+  cdf[0] = 0.0f;
+  for (size_t i = 0; i < count; ++i)
+  {
+    cdf[i + 1] = cdf[i] + values[i];
+  }
+
+  const float sum = cdf[count];
+  for (size_t i = 1; i <= count; ++i)
+  {
+    cdf[i] = (0.0f < sum) ? cdf[i] / sum : float(i) / float(count);
+  }
+  cdf[count] = 1.0f; // Exact end for the inversion.
+
+  return (0.0f < sum);
+}
+
+// The thin lens gets its aperture points from a small grid instead of evaluating the bokeh shape per primary ray.
+// The coverage mask of the shape is inverted with a marginal CDF over the rows and a conditional CDF per row,
+// the same construction as the environment importance sampling. Evaluating that monotonic mapping at the grid vertices
+// and interpolating bilinearly on the device maps the sampler's strata onto equal area regions of the aperture.
+// Any other shape (e.g. from an image) only needs to provide a different coverage mask here.
+void Application::updateApertureTable()
+{
+  try
+  {
+    const float rotation = m_apertureRotation * M_PIf / 180.0f;
+
+    // 4x4 supersampled coverage per mask cell to get smoothly varying CDFs for the polygon edges.
+    std::vector<float> mask(APERTURE_MASK_SIZE * APERTURE_MASK_SIZE);
+    for (int y = 0; y < APERTURE_MASK_SIZE; ++y)
+    {
+      for (int x = 0; x < APERTURE_MASK_SIZE; ++x)
+      {
+        float coverage = 0.0f;
+        for (int sy = 0; sy < 4; ++sy)
+        {
+          for (int sx = 0; sx < 4; ++sx)
+          {
+            const float px = (float(x) + (float(sx) + 0.5f) * 0.25f) / float(APERTURE_MASK_SIZE) * 2.0f - 1.0f;
+            const float py = (float(y) + (float(sy) + 0.5f) * 0.25f) / float(APERTURE_MASK_SIZE) * 2.0f - 1.0f;
+            if (insideAperture(px, py, m_apertureBlades, rotation))
+            {
+              coverage += 1.0f / 16.0f;
+            }
+          }
+        }
+        mask[y * APERTURE_MASK_SIZE + x] = coverage;
+      }
+    }
+
+    std::vector<float> rowSums(APERTURE_MASK_SIZE);
+    std::vector< std::vector<float> > conditional(APERTURE_MASK_SIZE);
+    for (int y = 0; y < APERTURE_MASK_SIZE; ++y)
+    {
+      const float* row = &mask[y * APERTURE_MASK_SIZE];
+      rowSums[y] = 0.0f;
+      for (int x = 0; x < APERTURE_MASK_SIZE; ++x)
+      {
+        rowSums[y] += row[x];
+      }
+      buildCDF(row, APERTURE_MASK_SIZE, conditional[y]);
+    }
+
+    std::vector<float> marginal;
+    const bool covered = buildCDF(rowSums.data(), APERTURE_MASK_SIZE, marginal);
+    MY_ASSERT(covered); // Every shape covers the center.
+
+    optix::float2* table = (optix::float2*) m_bufferApertureTable->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+
+    for (int j = 0; j <= APERTURE_TABLE_SIZE; ++j)
+    {
+      const float v = float(j) / float(APERTURE_TABLE_SIZE);
+      size_t row;
+      const float y = invertCDF(marginal, v, row);
+
+      for (int i = 0; i <= APERTURE_TABLE_SIZE; ++i)
+      {
+        const float u = float(i) / float(APERTURE_TABLE_SIZE);
+        size_t column;
+        const float x = invertCDF(conditional[row], u, column);
+
+        table[j * (APERTURE_TABLE_SIZE + 1) + i] = optix::make_float2(x / float(APERTURE_MASK_SIZE) * 2.0f - 1.0f,
+                                                                      y / float(APERTURE_MASK_SIZE) * 2.0f - 1.0f);
+      }
+    }
+
+    m_bufferApertureTable->unmap();
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
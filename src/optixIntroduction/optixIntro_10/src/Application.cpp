@@ -43,27 +43,28 @@
 #include <sstream>
 
 #include "shaders/material_parameter.h"
+#if USE_WAVEFRONT
+#include "shaders/wavefront_path.h"
+#endif
 
 // DAR Only for sutil::samplesPTXDir() and sutil::writeBufferToFile()
 #include <sutil.h>
+#include <NvtxRange.h>
 
+#include "inc/AliasTable.h"
 #include "inc/MyAssert.h"
+#include "inc/ParallelFor.h"
 
 // DAR HACK Taken from per_ray_data.h. I don't need any of the rest of it in this source.
 #define FLAG_THINWALLED 0x00000020
 
-const char* const SAMPLE_NAME = "optixIntro_10";
-
-// This only runs inside the OptiX Advanced Samples location,
-// unless the environment variable OPTIX_SAMPLES_SDK_PTX_DIR is set.
-// A standalone application which should run anywhere would place the *.ptx files 
-// into a subdirectory next to the executable and use a relative file path here!
-static std::string ptxPath(std::string const& cuda_file)
-{
-  return std::string(sutil::samplesPTXDir()) + std::string("/") + 
-         std::string(SAMPLE_NAME) + std::string("_generated_") + cuda_file + std::string(".ptx");
-}
+#if USE_RESIZE_CAPACITY
+#define RESIZE_SETTLE_SECONDS 0.25
+#endif
 
+// Share of the next event estimation light selection which stays uniform. Keeps lights which are estimated
+// to contribute little, e.g. an environment behind the walls of an interior, from never being sampled.
+#define LIGHT_SELECTION_UNIFORM 0.1f
 
 Application::Application(GLFWwindow* window,
                          const int width,
@@ -73,8 +74,25 @@ Application::Application(GLFWwindow* window,
                          const bool interop, 
                          const bool light, 
                          const unsigned int miss,
-                         std::string const& environment)
+                         std::string const& environment,
+                         const bool wavefront,
+                         const int tileSize,
+                         const bool halfDisplay,
+                         const int sampler,
+                         std::string const& scene,
+                         const bool geometryTriangles,
+                         const bool flatten,
+                         std::string const& accelerationCache,
+                         const float geometryBudget,
+                         const float buildBudget,
+                         const float lodError,
+                         std::string const& stress,
+                         std::vector<std::string> const& shaderDefines,
+                         std::string const& kernelCache,
+                         const int kernelCacheSize,
+                         std::string const& usageReport)
 : m_window(window)
+, m_headless(window == nullptr)
 , m_width(width)
 , m_height(height)
 , m_devicesEncoding(devices)
@@ -83,14 +101,38 @@ Application::Application(GLFWwindow* window,
 , m_light(light)
 , m_missID(miss)
 , m_environmentFilename(environment)
+, m_wavefront(wavefront)
+, m_sampler(sampler)
+, m_sceneFilename(scene)
+, m_geometryTriangles(geometryTriangles)
+, m_flatten(flatten)
+, m_accelerationCache(accelerationCache)
+, m_geometryBudget(geometryBudget)
+, m_buildBudget(buildBudget)
+, m_lodError(lodError)
+, m_stressScene(stress)
+, m_kernelCache(kernelCache)
+, m_kernelCacheSize(kernelCacheSize)
+, m_usageReportFilename(usageReport)
+, m_halfDisplay(halfDisplay)
+, m_localAccumulation(false)
 {
+  // There is no OpenGL context to share buffers with in headless mode.
+  if (m_headless)
+  {
+    m_interop = false;
+  }
+
   // Setup ImGui binding.
   ImGui::CreateContext();
-  ImGui_ImplGlfwGL2_Init(window, true);
+  if (!m_headless)
+  {
+    ImGui_ImplGlfwGL2_Init(window, true);
 
-  // This initializes the GLFW part including the font texture.
-  ImGui_ImplGlfwGL2_NewFrame();
-  ImGui::EndFrame();
+    // This initializes the GLFW part including the font texture.
+    ImGui_ImplGlfwGL2_NewFrame();
+    ImGui::EndFrame();
+  }
 
   ImGuiStyle& style = ImGui::GetStyle();
   
@@ -150,6 +192,13 @@ Application::Application(GLFWwindow* window,
   m_minPathLength       = 2;    // Minimum path length after which Russian Roulette path termination starts.
   m_maxPathLength       = 6;    // Maximum path length. Need at least 6 segments to see a diffuse surface through a sphere.
   m_sceneEpsilonFactor  = 500;  // Factor on 1e-7 used to offset ray origins along the path to reduce self intersections. 
+  m_lightSamples        = 1;    // Light samples and shadow rays per diffuse hit.
+  m_rouletteType        = ROULETTE_MAX_THROUGHPUT;
+  m_rouletteWindow      = 5.0f; // Window size of the weight window strategy.
+#if USE_COST_HEATMAP
+  m_costHeatmap         = COST_HEATMAP_OFF;
+  m_costScale           = 1.0e6f; // Cycles shown in red.
+#endif
   m_environmentRotation = 0.0f; // Not rotated, default camera setup looks down the negative z-axis which is the center of this image.
 
   m_present         = false;  // Update once per second. (The first half second shows all frames to get some initial accumulation).
@@ -158,12 +207,170 @@ Application::Application(GLFWwindow* window,
 
   m_builder = std::string("Trbvh");
   
-  m_cameraType = LENS_SHADER_PINHOLE;
+  m_cameraType       = LENS_SHADER_PINHOLE;
+  m_lensRadius       = 0.05f; // Scene units are meters [m].
+  m_apertureBlades   = 0;     // Circular aperture.
+  m_apertureRotation = 0.0f;
+#if USE_FILTER_IMPORTANCE_SAMPLING
+  m_pixelFilter      = PIXEL_FILTER_BOX; // The uniform pixel sampling as before.
+  m_filterRadius     = 0.5f;
+#endif
 
   m_shutterType = 0; // Stochastic.
+  m_timeSlices  = 1; // Each launch covers the whole shutter interval.
 
   m_frames = 0; // Samples per pixel. 0 == render forever.
 
+  m_timeInitScene = 0.0;
+
+  m_kernelCacheStatistics.hits   = 0;
+  m_kernelCacheStatistics.misses = 0;
+
+#if OPTIX_VERSION < 60000
+  if (m_geometryTriangles)
+  {
+    std::cerr << "WARNING: GeometryTriangles need OptiX 6.0.0 or newer. Using the custom triangle intersection programs." << std::endl;
+    m_geometryTriangles = false;
+  }
+#endif
+
+#if USE_TILED_LAUNCH
+  m_tileSize    = std::max(0, tileSize);
+  m_frameBudget = 16.0f; // Milliseconds. Keeps the camera interaction at about 60 Hz.
+  m_tileFocus   = optix::make_float2(float(m_width) * 0.5f, float(m_height) * 0.5f);
+  m_tileNext    = 0;
+#endif
+
+#if USE_SAMPLES_PER_LAUNCH
+  m_samplesPerLaunch = 1;
+#endif
+
+#if USE_RENDER_SERVER
+  m_serverAccumulate = true;
+#endif
+
+#if USE_CHECKPOINTS
+  m_checkpointInterval = 600.0; // Seconds.
+  m_checkpointResume   = false;
+#endif
+
+#if USE_INCREMENTAL_MATERIALS
+  m_materialUpdateKernel = false;
+#endif
+
+#if USE_RESIZE_CAPACITY
+  m_capacityWidth  = m_width; // The buffers are created at the initial window size.
+  m_capacityHeight = m_height;
+#endif
+
+#if USE_PREVIEW_RESOLUTION
+  m_previewFactor = 4;
+  m_previewActive = false;
+#endif
+
+#if USE_RASTER_PRIMARY
+  m_rasterPrimary     = false;
+  m_rasterInitialized = false; // The OpenGL objects are created by the first rasterizePrimary().
+  m_rasterStatic      = true;
+  m_rasterVS          = 0;
+  m_rasterFS          = 0;
+  m_rasterProgram     = 0;
+  m_rasterFramebuffer = 0;
+  m_rasterTexture     = 0;
+  m_pboRasterDistance = 0;
+#endif
+
+#if USE_GEOMETRY_PAGING
+  m_pagingEpoch = 0;
+  m_pagedBytes  = 0;
+#endif
+
+#if USE_AOVS
+  m_aovMask = 0;
+#endif
+#if USE_SPECTRAL
+  m_spectral = false;
+#endif
+#if USE_PERSISTENT_THREADS
+  m_persistentThreads         = 0;
+  m_persistentMultiprocessors = 0;
+  m_persistentBase            = 0;
+#endif
+#if USE_MORTON_LAUNCH
+  m_mortonLaunch = false;
+#endif
+#if USE_SCENE_RELOAD
+  strncpy(m_guiSceneFilename, m_sceneFilename.c_str(), sizeof(m_guiSceneFilename) - 1);
+  m_guiSceneFilename[sizeof(m_guiSceneFilename) - 1] = '\0';
+#endif
+#if USE_WAVEFRONT && USE_WAVEFRONT_SORT
+  m_wavefrontSort     = false;
+  m_wavefrontSortCell = 1.0f;
+#endif
+
+#if USE_RESTIR
+  m_restir           = false;
+  m_restirCandidates = 8;
+  m_restirCurrent    = 0;
+  m_restirValid      = false;
+#endif
+
+#if USE_VISIBILITY_CACHE
+  m_visibilityCache = false;
+  m_visibilityEpoch = 1; // Counts of epoch 0 (a cleared buffer) are never valid.
+#endif
+
+#if USE_RADIANCE_CACHE
+  m_cacheBounces  = 0;    // Off by default.
+  m_cacheCellSize = 0.1f; // Scene units are meters [m].
+  m_cacheHistory  = 32;
+  m_cacheReset    = true;
+#endif
+
+#if USE_DYNAMIC_SCENE
+  m_animation       = false;
+  m_refitThreshold  = 0.1f;
+  m_dynamicChanged  = false;
+  m_dynamicRefits   = 0;
+  m_dynamicRebuilds = 0;
+#endif
+
+#if USE_MULTI_VIEW
+  m_multiView        = MULTI_VIEW_OFF;
+  m_stereoSeparation = 0.065f; // Average human interpupillary distance in meters.
+  m_viewsDirty       = true;
+  m_viewSize         = optix::make_uint2(0, 0);
+  m_viewCount        = 0;
+#endif
+
+#if USE_WEDGE
+  m_wedgeDisplay = 0;
+  m_wedgeDirty   = true;
+  m_wedgeActive  = false;
+#endif
+
+#if USE_REPROJECTION
+  m_reprojection          = true;
+  m_reprojected           = false;
+  m_reprojectionHistory   = 64;
+  m_reprojectionTolerance = 0.02f;
+  m_historyCameraPosition = optix::make_float3(0.0f);
+  m_historyCameraU        = optix::make_float3(0.0f);
+  m_historyCameraV        = optix::make_float3(0.0f);
+  m_historyCameraW        = optix::make_float3(0.0f);
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+  m_targetError        = 0.0f; // Off by default. Rendering continues until m_frames.
+  m_adaptiveMinSamples = 32;
+  m_adaptiveInterval   = 8;
+  m_tilesX             = (m_width  + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+  m_tilesY             = (m_height + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+  m_numActiveTiles     = -1;
+  m_converged          = false;
+  m_tileConverged.resize(m_tilesX * m_tilesY, 0);
+#endif
+
   // GLSL shaders objects and program. 
   // In OptiX 5.1.0 the denoiser supports HDR beauty buffers which this example demonstrates.
   // Means the previous raygeneration entry point doing the tonemapping inside the CommandList can go away again
@@ -190,31 +397,89 @@ Application::Application(GLFWwindow* window,
   m_brightness     = 1.0f;
 #endif
 
+#if USE_DEVICE_TONEMAP
+  m_deviceTonemap     = false;
+  m_displayTonemapped = false;
+#endif
+
   m_guiState = GUI_STATE_NONE;
 
+#if USE_RENDER_THREAD
+  m_renderThreadActive = false;
+  m_guiRequest         = false;
+  m_renderParked       = false;
+  m_renderExit         = false;
+  m_uiWidth            = m_width;
+  m_uiHeight           = m_height;
+  m_presentTonemapped  = false;
+#endif
+
   m_isWindowVisible = true;
 
   m_mouseSpeedRatio = 10.0f;
 
 #if USE_DENOISER
-  m_denoiseBlend = 0.0f; // 0.0f == denoised image, 1.0f == original image.
+  m_denoiseBlend      = 0.0f; // 0.0f == denoised image, 1.0f == original image.
+  m_denoiseBudget     = 0.0f; // No limit. Always denoise while navigating.
+  m_denoiseCadence    = 16;
+  m_denoiseMaxMem     = 0.0f; // No limit.
+#if USE_DENOISER_TILES
+  m_denoiseTileSize   = 0;    // Full frame.
+  m_denoiseTileExtent = 0;
+#endif
+  m_denoiseTime       = 0.0f; // Unknown until the first execution.
+  m_denoisedIteration = -1;
+
+  m_useDenoiser       = true; // Set from the shader defines before the programs are created.
+  m_useDenoiserAlbedo = true;
+  m_useDenoiserNormal = true;
+
+#if USE_DENOISER_CONVERGENCE
+  m_stableThreshold = 0.0f; // Off by default. Rendering continues until m_frames.
+  resetDenoiserConvergence();
+#endif
 #endif
 
   m_pinholeCamera.setViewport(m_width, m_height);
 
-  initOpenGL();
+  if (!m_headless)
+  {
+    initOpenGL();
+  }
   initOptiX(); // Sets m_isValid when OptiX initialization was successful.
 }
 
 Application::~Application()
 {
   // DAR FIXME Do any other destruction here.
+#if USE_RENDER_THREAD
+  stopRenderThread(); // Normally already done when runRenderThread() returned.
+#endif
+#if USE_CHECKPOINTS
+  if (m_checkpointWriter.joinable())
+  {
+    m_checkpointWriter.join(); // The last checkpoint must be complete before the process ends.
+  }
+#endif
+
   if (m_isValid)
   {
+    if (!m_memoryReportFilename.empty())
+    {
+      updateMemoryTracker(); // With the asynchronously loaded textures at their final size.
+      m_memoryTracker.write(m_memoryReportFilename);
+    }
+    m_uploader.reset(); // Before the buffers it copies into are gone.
+#if USE_DENOISER && USE_DENOISER_DEVICE
+    m_denoiserDevice.reset(); // Joins the worker thread.
+#endif
     m_context->destroy();
   }
 
-  ImGui_ImplGlfwGL2_Shutdown();
+  if (!m_headless)
+  {
+    ImGui_ImplGlfwGL2_Shutdown();
+  }
   ImGui::DestroyContext();
 }
 
@@ -231,61 +496,230 @@ void Application::reshape(int width, int height)
     m_width  = width;
     m_height = height;
 
-    glViewport(0, 0, m_width, m_height);
+#if USE_RESTIR
+    m_restirValid = false; // The previous reservoirs are found with the previous resolution.
+#endif
+#if USE_MULTI_VIEW
+    m_viewsDirty = true;
+#endif
+
+#if USE_RENDER_THREAD
+    if (!m_headless && !m_renderThreadActive) // The GUI thread sets its own viewport.
+#else
+    if (!m_headless) // Render server clients can resize the headless Application.
+#endif
+    {
+      glViewport(0, 0, m_width, m_height);
+    }
     try
     {
-      m_bufferOutput->setSize(m_width, m_height); // RGBA32F buffer.
-
-#if USE_DENOISER
-      m_bufferDenoised->setSize(m_width, m_height); // RGBA32F buffer.
-      if (m_interop)
+#if USE_RESIZE_CAPACITY
+      if (m_headless) // Everything reading the buffers back expects them at the exact resolution.
       {
-        m_bufferDenoised->unregisterGLBuffer(); // Must unregister or CUDA won't notice the size change and crash.
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferDenoised->getGLBOId());
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, m_bufferDenoised->getElementSize() * m_width * m_height, nullptr, GL_STREAM_DRAW);
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-        m_bufferDenoised->registerGLBuffer();
+        resizeBuffers(m_width, m_height);
+      }
+      else
+      {
+        // Render into the lower left sub-rectangle of the existing buffers. Only grow them with some headroom,
+        // so that dragging the window border doesn't reallocate on every event. render() shrinks them to the exact size
+        // when the window hasn't been resized for a moment.
+        if (m_capacityWidth < m_width || m_capacityHeight < m_height)
+        {
+          resizeBuffers(std::max(m_capacityWidth,  m_width  + m_width  / 4),
+                        std::max(m_capacityHeight, m_height + m_height / 4));
+        }
+        m_resizeTimer.restart();
       }
+#else
+      resizeBuffers(m_width, m_height);
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+      m_tilesX = (m_width  + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+      m_tilesY = (m_height + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+      m_bufferTileError->setSize(m_tilesX, m_tilesY);
+      m_tileConverged.resize(m_tilesX * m_tilesY); // Contents reset inside restartAccumulation().
+#endif
+
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+      m_bufferDenoisedChange->setSize((m_width  + DENOISER_CHANGE_TILE_SIZE - 1) / DENOISER_CHANGE_TILE_SIZE,
+                                      (m_height + DENOISER_CHANGE_TILE_SIZE - 1) / DENOISER_CHANGE_TILE_SIZE);
+#endif
+
+      m_context["sysResolution"]->setUint(m_width, m_height);
+    }
+    catch(optix::Exception& e)
+    {
+      std::cerr << e.getErrorString() << std::endl;
+    }
+
+#if USE_DENOISER
+    m_denoiseTime = 0.0f; // The denoiser cost depends on the resolution. Measure again.
+#endif
+
+    m_pinholeCamera.setViewport(m_width, m_height);
 
+    restartAccumulation();
+  }
+}
+
+// Sets the size of all buffers which hold one element per pixel. The launches only cover m_width * m_height of them.
+void Application::resizeBuffers(const int width, const int height)
+{
+  m_bufferOutput->setSize(width, height); // RGBA32F buffer.
+
+#if USE_ADAPTIVE_SAMPLING
+  m_bufferMoment->setSize(width, height);
+#endif
+
+#if USE_REPROJECTION
+  m_bufferPosition->setSize(width, height);
+  m_bufferSampleCount->setSize(width, height);
+  m_bufferHistoryOutput->setSize(width, height);
+  m_bufferHistoryPosition->setSize(width, height);
+  m_bufferHistoryCount->setSize(width, height);
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+  m_bufferHistoryAlbedo->setSize(width, height);
+#endif
+#endif
+
+#if USE_WAVEFRONT
+  m_bufferWavefrontPaths->setSize(2 * width * height); // Two queues with one path per pixel.
+  m_bufferWavefrontRadiance->setSize(width, height);
+#if USE_WAVEFRONT_SORT
+  m_bufferWavefrontKeys->setSize(width * height);
+#endif
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
 #if USE_DENOISER_ALBEDO
-      m_bufferAlbedo->setSize(m_width, m_height);     // RGBA32F buffer.
+  m_bufferWavefrontAlbedo->setSize(width, height);
 #if USE_DENOISER_NORMAL
-      m_bufferNormals->setSize(m_width, m_height);    // RGBA32F buffer.
+  m_bufferWavefrontNormal->setSize(width, height);
+#endif
+#endif
 #endif
 #endif
 
-      // Because the CommandList has no interface to set launch dimensions per stage, build a new one with the new size.
-      if (m_commandListDenoiser && m_stageDenoiser)
-      {
-        m_commandListDenoiser->destroy(); 
+#if USE_COST_HEATMAP
+  m_bufferCost->setSize(width, height);
+#endif
 
-        m_commandListDenoiser = m_context->createCommandList();
-        
-        m_commandListDenoiser->appendPostprocessingStage(m_stageDenoiser, m_width, m_height);
-        m_commandListDenoiser->finalize();
-      }
+#if USE_HALF_DISPLAY
+  m_bufferDisplayHalf->setSize(width, height);
+#endif
+
+#if USE_RENDER_SERVER
+  m_bufferEncode->setSize(width, height);
+#endif
+
+#if USE_DEVICE_TONEMAP
+  m_bufferTonemap->setSize(width, height);
+#endif
+
+#if USE_GPU_LOCAL_ACCUMULATION
+  if (m_localAccumulation)
+  {
+    m_bufferLocalOutput->setSize(width, height);
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+    m_bufferLocalAlbedo->setSize(width, height);
+#if USE_DENOISER_NORMAL
+    m_bufferLocalNormal->setSize(width, height);
+#endif
+#endif
+#endif
+  }
+#endif
+
+#if USE_DENOISER
+  m_bufferDenoised->setSize(width, height); // RGBA32F buffer.
+#if USE_DENOISER_CONVERGENCE
+  m_bufferDenoisedPrevious->setSize(width, height);
+#endif
+  if (m_interop)
+  {
+    m_bufferDenoised->unregisterGLBuffer(); // Must unregister or CUDA won't notice the size change and crash.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferDenoised->getGLBOId());
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, m_bufferDenoised->getElementSize() * width * height, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_bufferDenoised->registerGLBuffer();
+  }
+
+#if USE_DENOISER_ALBEDO
+  m_bufferAlbedo->setSize(width, height);     // RGBA32F buffer.
+#if USE_DENOISER_NORMAL
+  m_bufferNormals->setSize(width, height);    // RGBA32F buffer.
+#endif
+#endif
+
+  // Because the CommandList has no interface to set launch dimensions per stage, build a new one with the new size.
+  if (m_commandListDenoiser && m_stageDenoiser)
+  {
+    m_commandListDenoiser->destroy(); 
+
+    m_commandListDenoiser = m_context->createCommandList();
+    
+    m_commandListDenoiser->appendPostprocessingStage(m_stageDenoiser, width, height);
+    m_commandListDenoiser->finalize();
+  }
 #else
-      // When not using the denoiser this is the buffer which is displayed.
-      if (m_interop)
-      {
-        m_bufferOutput->unregisterGLBuffer(); // Must unregister or CUDA won't notice the size change and crash.
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferOutput->getGLBOId());
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, m_bufferOutput->getElementSize() * m_width * m_height, nullptr, GL_STREAM_DRAW);
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-        m_bufferOutput->registerGLBuffer();
-      }
+  // When not using the denoiser this is the buffer which is displayed.
+  if (m_interop)
+  {
+    m_bufferOutput->unregisterGLBuffer(); // Must unregister or CUDA won't notice the size change and crash.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferOutput->getGLBOId());
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, m_bufferOutput->getElementSize() * width * height, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_bufferOutput->registerGLBuffer();
+  }
+#endif
+
+#if USE_RASTER_PRIMARY
+  resizeRasterPrimary(width, height);
+#endif
+
+#if USE_RESTIR
+  m_bufferReservoirs[0]->setSize(width, height);
+  m_bufferReservoirs[1]->setSize(width, height);
+#endif
+
+#if USE_VISIBILITY_CACHE
+  m_bufferVisibilityCounts->setSize(width, height);
+  ++m_visibilityEpoch; // The counts moved to other pixels.
 #endif
+
+#if USE_AOVS
+  resizeAovs(width, height);
+#endif
+
+#if USE_RESIZE_CAPACITY
+  m_capacityWidth  = width;
+  m_capacityHeight = height;
+#endif
+}
+
+#if USE_RESIZE_CAPACITY
+bool Application::isCapacityExact() const
+{
+  return (m_capacityWidth == m_width && m_capacityHeight == m_height);
+}
+
+// The denoiser and the image readbacks work on whole buffers. Drops the headroom again.
+void Application::fitCapacity()
+{
+  if (!isCapacityExact())
+  {
+    try
+    {
+      resizeBuffers(m_width, m_height);
     }
     catch(optix::Exception& e)
     {
       std::cerr << e.getErrorString() << std::endl;
     }
-
-    m_pinholeCamera.setViewport(m_width, m_height);
-
-    restartAccumulation();
+    restartAccumulation(); // The new buffers have undefined contents.
   }
 }
+#endif
 
 void Application::guiNewFrame()
 {
@@ -323,6 +757,10 @@ void Application::getSystemInformation()
     micro =  optixVersion % 10;
   }
   std::cout << "OptiX " << major << "." << minor << "." << micro << std::endl;
+
+  std::ostringstream version;
+  version << major << "." << minor << "." << micro;
+  m_profiler.setInfo("optix", version.str());
   
   unsigned int numberOfDevices = 0;
   RT_CHECK_ERROR_NO_CONTEXT(rtDeviceGetDeviceCount(&numberOfDevices));
@@ -442,15 +880,66 @@ void Application::initOptiX()
     } while (i < numberOfDevices && devicesEncoding);
 
     m_context->setDevices(devices.begin(), devices.end());
+
+    m_uploader.reset(new sutil::BufferUploader(m_context)); // Needs the final device selection.
     
     // Print out the current configuration to make sure what's currently running.
     devices = m_context->getEnabledDevices();
     for (size_t i = 0; i < devices.size(); ++i) 
     {
       std::cout << "m_context is using local device " << devices[i] << ": " << m_context->getDeviceName(devices[i]) << std::endl;
+
+      std::ostringstream key;
+      key << "device" << i;
+      m_profiler.setInfo(key.str(), m_context->getDeviceName(devices[i]));
     }
     std::cout << "OpenGL interop is " << ((m_interop) ? "enabled" : "disabled") << std::endl;
 
+    initKernelCache();
+    initUsageReport();
+
+#if USE_WAVEFRONT
+    // The path queue compaction uses an atomic counter which only works inside a single device's memory.
+    if (m_wavefront && devices.size() != 1)
+    {
+      std::cerr << "WARNING: The wavefront path tracer requires a single device. Using the megakernel instead." << std::endl;
+      m_wavefront = false;
+    }
+    std::cout << "Wavefront path tracer is " << ((m_wavefront) ? "enabled" : "disabled") << std::endl;
+#else
+    m_wavefront = false;
+#endif
+
+#if USE_HALF_DISPLAY
+    std::cout << "Half display upload is " << ((m_halfDisplay) ? "enabled" : "disabled") << std::endl;
+#else
+    m_halfDisplay = false;
+#endif
+
+#if USE_GPU_LOCAL_ACCUMULATION
+    // Only worth it when there is more than one device. A single device accumulates in its own memory anyway.
+    m_localAccumulation = (1 < devices.size());
+    if (m_localAccumulation)
+    {
+      // These features launch with other dimensions than ENTRY_RENDER which would assign other pixels to the devices.
+#if USE_TILED_LAUNCH
+      m_tileSize = 0;
+#endif
+#if USE_ADAPTIVE_SAMPLING
+      m_targetError = 0.0f;
+#endif
+    }
+    std::cout << "GPU local accumulation is " << ((m_localAccumulation) ? "enabled" : "disabled") << std::endl;
+#endif
+
+    setShaderDefines(shaderDefines); // Before any program is created.
+#if USE_DENOISER
+    m_useDenoiser       = (getShaderDefine("USE_DENOISER", USE_DENOISER) != 0);
+    m_useDenoiserAlbedo = m_useDenoiser       && (getShaderDefine("USE_DENOISER_ALBEDO", USE_DENOISER_ALBEDO) != 0);
+    m_useDenoiserNormal = m_useDenoiserAlbedo && (getShaderDefine("USE_DENOISER_NORMAL", USE_DENOISER_NORMAL) != 0);
+    std::cout << "Denoiser is " << ((m_useDenoiser) ? "enabled" : "disabled") << std::endl;
+#endif
+
     initPrograms();
     initRenderer(); 
     initScene();
@@ -463,9 +952,74 @@ void Application::initOptiX()
   }
 }
 
-static void callbackUsageReport(int level, const char* tag, const char* msg, void* cbdata)
+#if OPTIX_VERSION >= 60000
+// Counts the disk cache lookups of the compiled kernels in the usage report.
+static void countKernelCache(sutil::UsageReportRecord const& record, void* data)
+{
+  if (record.tag != std::string("DISK CACHE"))
+  {
+    return;
+  }
+  KernelCacheStatistics* statistics = static_cast<KernelCacheStatistics*>(data);
+  if (record.message.find("Cache hit") != std::string::npos)
+  {
+    ++statistics->hits;
+  }
+  else if (record.message.find("Cache miss") != std::string::npos)
+  {
+    ++statistics->misses;
+  }
+}
+#endif
+
+// OptiX Usage Reports.
+// verbosity = 0: usage reports off
+// verbosity = 1: enables error messages and important warnings.
+// verbosity = 2: additionally enables minor warnings, performance recommendations, and scene statistics at startup or recompilation granularity.
+// verbosity = 3: additionally enables informational messages and per-launch statistics and messages.
+// The kernel disk cache statistics need verbosity 2, the --usage log file records everything.
+void Application::initUsageReport()
+{
+  int verbosity = 0;
+#if OPTIX_VERSION >= 60000
+  m_usageReport.setListener(countKernelCache, &m_kernelCacheStatistics);
+  verbosity = 2;
+#endif
+  if (!m_usageReportFilename.empty())
+  {
+    m_usageReport.setFilename(m_usageReportFilename);
+    verbosity = 3;
+  }
+  //m_usageReport.setEcho(true); // Print the reports to the console as well.
+  m_usageReport.attach(m_context, verbosity);
+}
+
+// The OptiX disk cache keeps the compiled kernels between runs so that the first launch in initScene() only pays the compilation once.
+void Application::initKernelCache()
 {
-  std::cout << "[" << level << "][" << std::left << std::setw(12) << tag << "] " << msg;
+#if OPTIX_VERSION >= 60000
+  if (!m_kernelCache.empty())
+  {
+    m_context->setDiskCacheLocation(m_kernelCache);
+  }
+  if (0 < m_kernelCacheSize)
+  {
+    // Garbage collection shrinks the cache to the low water mark when it exceeds the high water mark.
+    const RTsize highWaterMark = RTsize(m_kernelCacheSize) << 20;
+    m_context->setDiskCacheMemoryLimits(highWaterMark / 2, highWaterMark);
+  }
+
+  RTsize lowWaterMark  = 0;
+  RTsize highWaterMark = 0;
+  m_context->getDiskCacheMemoryLimits(lowWaterMark, highWaterMark);
+  std::cout << "Kernel disk cache is at " << m_context->getDiskCacheLocation() << " (" << (highWaterMark >> 20) << " MiB limit)" << std::endl;
+  m_profiler.setInfo("kernelCache", m_context->getDiskCacheLocation());
+#else
+  if (!m_kernelCache.empty() || 0 < m_kernelCacheSize)
+  {
+    std::cerr << "WARNING: The kernel disk cache settings need OptiX 6.0.0 or newer. Ignored." << std::endl;
+  }
+#endif
 }
 
 
@@ -473,30 +1027,43 @@ void Application::initRenderer()
 {
   try
   {
-    m_context->setEntryPointCount(1); // 0 = render // Tonemapper is a GLSL shader in this case.
+    m_context->setEntryPointCount(NUMBER_OF_ENTRY_POINTS); // 0 = render // Tonemapper is a GLSL shader in this case.
     m_context->setRayTypeCount(2);    // 0 = radiance, 1 = shadow
 
+#if USE_STACK_CALIBRATION
+    if (m_stackSize == 0) // No --stack given.
+    {
+      m_stackSize = loadStackSize();
+    }
+#endif
     m_context->setStackSize(m_stackSize);
     std::cout << "stackSize = " << m_stackSize << std::endl;
 
-#if USE_DEBUG_EXCEPTIONS
-    // Disable this by default for performance, otherwise the stitched PTX code will have lots of exception handling inside. 
-    m_context->setPrintEnabled(true);
-    //m_context->setPrintLaunchIndex(256, 256);
-    m_context->setExceptionEnabled(RT_EXCEPTION_ALL, true);
-#endif 
-
-    // OptiX Usage Reports.
-    // verbosity = 0: usage reports off
-    // verbosity = 1: enables error messages and important warnings.
-    // verbosity = 2: additionally enables minor warnings, performance recommendations, and scene statistics at startup or recompilation granularity.
-    // verbosity = 3: additionally enables informational messages and per-launch statistics and messages.
-    //m_context->setUsageReportCallback(callbackUsageReport, 3, NULL);
+    if (getShaderDefine("USE_DEBUG_EXCEPTIONS", USE_DEBUG_EXCEPTIONS))
+    {
+      // Disable this by default for performance, otherwise the stitched PTX code will have lots of exception handling inside. 
+      m_context->setPrintEnabled(true);
+      //m_context->setPrintLaunchIndex(256, 256);
+      m_context->setExceptionEnabled(RT_EXCEPTION_ALL, true);
+    }
 
     // Add context-global variables here.
     m_context["sysSceneEpsilon"]->setFloat(m_sceneEpsilonFactor * 1e-7f);
     m_context["sysPathLengths"]->setInt(m_minPathLength, m_maxPathLength);
-    m_context["sysEnvironmentRotation"]->setFloat(m_environmentRotation);
+    m_context["sysLightSamples"]->setInt(m_lightSamples);
+    m_context["sysRouletteType"]->setInt(m_rouletteType);
+    m_context["sysRouletteWindow"]->setFloat(m_rouletteWindow);
+    m_context["sysRouletteMean"]->setFloat(0.0f); // Unknown until the first path statistics arrived.
+    updateEnvironmentMatrix();
+    m_context["sysSampler"]->setInt(m_sampler);
+#if USE_SPECTRAL
+    m_context["sysSpectral"]->setInt(0);
+#endif
+#if USE_POSTER_TILES
+    m_context["sysPosterOffset"]->setUint(0, 0);
+    m_context["sysPosterResolution"]->setUint(0, 0); // Only renderPoster() projects onto a larger image.
+#endif
+    std::cout << "Sampler is " << ((m_sampler == SAMPLER_SOBOL) ? "Sobol" : "LCG") << std::endl;
     m_context["sysIterationIndex"]->setInt(0); // With manual accumulation, 0 fills the buffer, accumulation starts at 1. On the VCA this variable is unused!
   
     // RT_BUFFER_INPUT_OUTPUT to support accumulation.
@@ -513,30 +1080,288 @@ void Application::initRenderer()
     m_bufferOutput->setSize(m_width, m_height);
 #endif
     m_context["sysOutputBuffer"]->set(m_bufferOutput);
+    m_context["sysResolution"]->setUint(m_width, m_height);
 
     std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("raygeneration");
     MY_ASSERT(it != m_mapOfPrograms.end()); 
-    m_context->setRayGenerationProgram(0, it->second); // entrypoint
+    m_context->setRayGenerationProgram(ENTRY_RENDER, it->second); // entrypoint
 
     it = m_mapOfPrograms.find("exception");
     MY_ASSERT(it != m_mapOfPrograms.end()); 
-    m_context->setExceptionProgram(0, it->second); // entrypoint
+    for (unsigned int entry = 0; entry < NUMBER_OF_ENTRY_POINTS; ++entry)
+    {
+      m_context->setExceptionProgram(entry, it->second); // entrypoint
+    }
+#if USE_STACK_CALIBRATION
+    initStackCalibration();
+#endif
 
-    it = m_mapOfPrograms.find("miss");
+#if USE_ADAPTIVE_SAMPLING
+    it = m_mapOfPrograms.find("raygeneration_adaptive");
     MY_ASSERT(it != m_mapOfPrograms.end()); 
-    m_context->setMissProgram(0, it->second); // raytype
+    m_context->setRayGenerationProgram(ENTRY_RENDER_ADAPTIVE, it->second);
 
-    // Default initialization. Will be overwritten on the first frame.
-    m_context["sysCameraPosition"]->setFloat(0.0f, 0.0f, 1.0f);
+    it = m_mapOfPrograms.find("convergence");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_CONVERGENCE, it->second);
+
+    m_bufferMoment = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, m_width, m_height);
+    m_context["sysMomentBuffer"]->setBuffer(m_bufferMoment);
+
+    m_bufferTileError = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT, m_tilesX, m_tilesY);
+    m_context["sysTileError"]->setBuffer(m_bufferTileError);
+
+    // Resized to the number of active tiles on each convergence check. Must not be zero sized.
+    m_bufferActiveTiles = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT2, 1);
+    m_context["sysActiveTiles"]->setBuffer(m_bufferActiveTiles);
+#endif
+
+#if USE_PATH_STATISTICS
+    m_bufferPathStatistics = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, PATH_STATISTICS_DEPTHS * PATH_STATISTICS_SLOTS);
+    memset(m_bufferPathStatistics->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 0, sizeof(float) * PATH_STATISTICS_DEPTHS * PATH_STATISTICS_SLOTS);
+    m_bufferPathStatistics->unmap();
+    m_context["sysPathStatistics"]->setBuffer(m_bufferPathStatistics);
+
+    m_pathStatistics.resize(PATH_STATISTICS_DEPTHS * PATH_STATISTICS_SLOTS, 0.0);
+    m_rouletteMean = 0.0f;
+#endif
+
+#if USE_RAY_COUNTERS
+    // OptiX has no 64-bit unsigned integer format, the counters are a user format of that size.
+    m_bufferRayCounters = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_USER, RAY_COUNTER_SLOTS);
+    m_bufferRayCounters->setElementSize(sizeof(unsigned long long));
+    m_context["sysRayCounters"]->setBuffer(m_bufferRayCounters);
+
+    clearRayCounters();
+#endif
+
+#if USE_COST_HEATMAP
+    m_bufferCost = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT, m_width, m_height);
+    m_context["sysCostBuffer"]->setBuffer(m_bufferCost);
+    m_context["sysCostHeatmap"]->setInt(m_costHeatmap);
+    m_context["sysCostScale"]->setFloat(m_costScale);
+#endif
+
+#if USE_GPU_ENVIRONMENT_CDF
+    it = m_mapOfPrograms.find("environment_function");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_ENVIRONMENT_FUNCTION, it->second);
+
+    it = m_mapOfPrograms.find("environment_rows");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_ENVIRONMENT_ROWS, it->second);
+
+    it = m_mapOfPrograms.find("environment_marginal");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_ENVIRONMENT_MARGINAL, it->second);
+
+    // Placeholders to keep the context valid. Texture::calculateCDFDevice() binds the actual buffers when there is an environment map.
+    m_context["sysEnvironmentTexels"]->setBuffer(m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, 1, 1));
+    m_context["sysEnvironmentFunction"]->setBuffer(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, 1, 1));
+    m_context["sysEnvironmentCDF_U"]->setBuffer(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, 2, 1));
+    m_context["sysEnvironmentCDF_V"]->setBuffer(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, 2));
+    m_context["sysEnvironmentSums"]->setBuffer(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, 1));
+#endif
+
+#if USE_GPU_MIPMAPS
+    it = m_mapOfPrograms.find("mipmap_level");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_MIPMAP_LEVEL, it->second);
+
+    it = m_mapOfPrograms.find("mipmap_encode");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_MIPMAP_ENCODE, it->second);
+
+    // Placeholders to keep the context valid. Texture::generateMipmaps() binds the actual values per texture.
+    m_context["sysMipmapTexels"]->setBuffer(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1));
+    m_context["sysMipmapTexture"]->setInt(RT_TEXTURE_ID_NULL);
+    m_context["sysMipmapFromTexture"]->setInt(0);
+    m_context["sysMipmapSourceSize"]->setUint(1, 1);
+    m_context["sysMipmapSourceOffset"]->setUint(0);
+    m_context["sysMipmapTargetOffset"]->setUint(0);
+#endif
+
+#if USE_HALF_DISPLAY
+    it = m_mapOfPrograms.find("display_half");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_DISPLAY_HALF, it->second);
+
+    m_bufferDisplayHalf = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_HALF4, m_width, m_height);
+    m_context["sysDisplayHalfBuffer"]->setBuffer(m_bufferDisplayHalf);
+
+    m_displayHalfSource = m_bufferOutput;
+    m_context["sysDisplaySource"]->setBuffer(m_displayHalfSource);
+#endif
+
+#if USE_RENDER_SERVER
+    it = m_mapOfPrograms.find("encode_rgba8");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_ENCODE_RGBA8, it->second);
+
+    m_bufferEncode = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_BYTE4, m_width, m_height);
+    m_context["sysEncodeBuffer"]->setBuffer(m_bufferEncode);
+    m_context["sysEncodeSource"]->setBuffer(m_bufferOutput);
+#endif
+
+#if USE_DEVICE_TONEMAP
+    it = m_mapOfPrograms.find("tonemap_bgra8");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_TONEMAP, it->second);
+
+    m_bufferTonemap = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_BYTE4, m_width, m_height);
+    m_context["sysTonemapBuffer"]->setBuffer(m_bufferTonemap);
+    m_context["sysEncodeSource"]->setBuffer(m_bufferOutput);
+    setTonemapVariables();
+#endif
+
+#if USE_TILED_LAUNCH
+    it = m_mapOfPrograms.find("raygeneration_tile");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_RENDER_TILE, it->second);
+
+    m_context["sysTileOffset"]->setUint(0, 0);
+#endif
+
+#if USE_MORTON_LAUNCH
+    it = m_mapOfPrograms.find("raygeneration_morton");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_RENDER_MORTON, it->second);
+#endif
+
+#if USE_PREVIEW_RESOLUTION
+    it = m_mapOfPrograms.find("raygeneration_preview");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_RENDER_PREVIEW, it->second);
+
+    // Resized to the preview resolution by renderPreview().
+    m_bufferPreview = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+    it->second["sysOutputBuffer"]->setBuffer(m_bufferPreview);
+#if USE_SAMPLES_PER_LAUNCH
+    it->second["sysSamplesPerLaunch"]->setInt(1); // The preview shows the camera interaction as fast as possible.
+#endif
+#endif
+
+#if USE_SAMPLES_PER_LAUNCH
+    m_context["sysSamplesPerLaunch"]->setInt(1);
+#endif
+
+#if USE_REPROJECTION
+    initReprojection();
+#endif
+
+#if USE_RESTIR
+    initRestir();
+#endif
+
+#if USE_VISIBILITY_CACHE
+    initVisibilityCache();
+#endif
+
+#if USE_PERSISTENT_THREADS
+    initPersistentThreads();
+#endif
+
+#if USE_LIGHT_BAKE
+    initLightBake();
+#endif
+
+#if USE_RADIANCE_CACHE
+    initRadianceCache();
+#endif
+
+#if USE_MULTI_VIEW
+    initMultiView();
+#endif
+
+#if USE_WEDGE
+    initWedge();
+#endif
+
+#if USE_AOVS
+    initAovs();
+#endif
+
+#if USE_RASTER_PRIMARY
+    // Replaced by the interop buffer of the rasterized distances in initRasterPrimary().
+    m_bufferRasterDistance = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, 1, 1);
+    m_context["sysRasterDistance"]->setBuffer(m_bufferRasterDistance);
+    m_context["sysRasterPrimary"]->setInt(0);
+    m_context["sysRasterJitter"]->setFloat(0.5f, 0.5f);
+#if USE_PREVIEW_RESOLUTION
+    m_mapOfPrograms["raygeneration_preview"]["sysRasterPrimary"]->setInt(0); // The distances have the full resolution.
+#endif
+#endif
+
+#if USE_WAVEFRONT
+    it = m_mapOfPrograms.find("wavefront_generate");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_WAVEFRONT_GENERATE, it->second);
+
+    it = m_mapOfPrograms.find("wavefront_extend");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_WAVEFRONT_EXTEND, it->second);
+
+    it = m_mapOfPrograms.find("wavefront_resolve");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_WAVEFRONT_RESOLVE, it->second);
+
+    // The path queues are only ever touched by the device. Two halves with one path per pixel each.
+    // Note that this is 256 bytes per pixel. The wavefront mode trades memory for warp occupancy.
+    MY_ASSERT(sizeof(WavefrontPath) == 128);
+    // The absorption stack at the start of the WavefrontPath has the MATERIAL_STACK_SIZE the shaders were compiled with.
+    const int materialStackSize = getShaderDefine("MATERIAL_STACK_SIZE", MATERIAL_STACK_SIZE);
+    m_bufferWavefrontPaths = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_USER);
+    m_bufferWavefrontPaths->setElementSize(sizeof(WavefrontPath) + (materialStackSize - MATERIAL_STACK_SIZE) * sizeof(optix::float4));
+    m_bufferWavefrontPaths->setSize(2 * m_width * m_height);
+    m_context["sysWavefrontPaths"]->setBuffer(m_bufferWavefrontPaths);
+
+    m_bufferWavefrontCounter = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+    unsigned int* counter = static_cast<unsigned int*>(m_bufferWavefrontCounter->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    counter[0] = 0;
+    m_bufferWavefrontCounter->unmap();
+    m_context["sysWavefrontCounter"]->setBuffer(m_bufferWavefrontCounter);
+
+    m_bufferWavefrontRadiance = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+    m_context["sysWavefrontRadiance"]->setBuffer(m_bufferWavefrontRadiance);
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+    m_bufferWavefrontAlbedo = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+    m_context["sysWavefrontAlbedo"]->setBuffer(m_bufferWavefrontAlbedo);
+#if USE_DENOISER_NORMAL
+    m_bufferWavefrontNormal = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+    m_context["sysWavefrontNormal"]->setBuffer(m_bufferWavefrontNormal);
+#endif
+#endif
+#endif
+
+    m_context["sysWavefrontParity"]->setInt(0);
+    m_context["sysWavefrontDepth"]->setInt(0);
+
+#if USE_WAVEFRONT_SORT
+    initWavefrontSort();
+#endif
+#endif // USE_WAVEFRONT
+
+    it = m_mapOfPrograms.find("miss");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setMissProgram(0, it->second); // raytype
+
+    // Default initialization. Will be overwritten on the first frame.
+    m_context["sysCameraPosition"]->setFloat(0.0f, 0.0f, 1.0f);
     m_context["sysCameraU"]->setFloat(1.0f, 0.0f, 0.0f);
     m_context["sysCameraV"]->setFloat(0.0f, 1.0f, 0.0f);
     m_context["sysCameraW"]->setFloat(0.0f, 0.0f, -1.0f);
+    m_context["sysFocusDistance"]->setFloat(1.0f);
     
     // Lens shader selection.
     m_context["sysCameraType"]->setInt(m_cameraType);
+    m_context["sysLensRadius"]->setFloat(m_lensRadius);
 
     // Camera shutter selection
     m_context["sysShutterType"]->setInt(m_shutterType);
+#if USE_STRATIFIED_SHUTTER
+    m_context["sysTimeSlices"]->setInt(m_timeSlices);
+#endif
 
 #if USE_DENOISER
     // Initialize the HDR denoiser.
@@ -558,43 +1383,112 @@ void Application::initRenderer()
 #endif
 #endif
 
-    m_stageDenoiser = m_context->createBuiltinPostProcessingStage("DLDenoiser");
-    m_stageDenoiser->declareVariable("input_buffer");
-    m_stageDenoiser->declareVariable("output_buffer");
+    optix::Buffer albedo;
+    optix::Buffer normals;
 #if USE_DENOISER_ALBEDO
-    m_stageDenoiser->declareVariable("input_albedo_buffer");
+    albedo = m_bufferAlbedo;
 #if USE_DENOISER_NORMAL
-    m_stageDenoiser->declareVariable("input_normal_buffer");
+    normals = m_bufferNormals;
+#endif
 #endif
+    m_stageDenoiser = createDenoiserStage(m_bufferOutput, albedo, normals, m_bufferDenoised);
+
+    m_commandListDenoiser = m_context->createCommandList();
+
+    m_commandListDenoiser->appendPostprocessingStage(m_stageDenoiser, m_width, m_height);
+    m_commandListDenoiser->finalize();
+
+#if USE_DENOISER_CONVERGENCE
+    // Not RT_BUFFER_GPU_LOCAL, the denoiser_change launches don't assign the same tiles to the same device each time.
+    m_bufferDenoisedPrevious = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, m_width, m_height);
+    m_context["sysDenoisedPrevious"]->setBuffer(m_bufferDenoisedPrevious);
+
+    m_bufferDenoisedChange = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT,
+                                                     (m_width  + DENOISER_CHANGE_TILE_SIZE - 1) / DENOISER_CHANGE_TILE_SIZE,
+                                                     (m_height + DENOISER_CHANGE_TILE_SIZE - 1) / DENOISER_CHANGE_TILE_SIZE);
+    m_context["sysDenoisedChange"]->setBuffer(m_bufferDenoisedChange);
+    m_context["sysDenoisedBuffer"]->setBuffer(m_bufferDenoised);
+
+    it = m_mapOfPrograms.find("denoiser_change");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_DENOISER_CHANGE, it->second);
 #endif
-    m_stageDenoiser->declareVariable("blend");  // The denoised image can be blended with the original input image with this variable.
-    m_stageDenoiser->declareVariable("hdr");    // OptiX 5.1.0 supports HDR denoising which is shown in this example.
-    //m_stageDenoiser->declareVariable("maxmem"); // OptiX 5.1.0 allows to limit the maximum amount of memory the DL Denoiser should use (in bytes).
 
-    optix::Variable v = m_stageDenoiser->queryVariable("input_buffer");
-    v->setBuffer(m_bufferOutput);
-    v = m_stageDenoiser->queryVariable("output_buffer");
-    v->setBuffer(m_bufferDenoised);
+#if USE_DENOISER_TILES
+    // Resized and connected to their own denoiser stage by the first tiled denoiser execution.
+    m_bufferDenoiserTileInput = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+    m_context["sysDenoiserTileInput"]->setBuffer(m_bufferDenoiserTileInput);
 #if USE_DENOISER_ALBEDO
-    v = m_stageDenoiser->queryVariable("input_albedo_buffer");
-    v->setBuffer(m_bufferAlbedo);
+    m_bufferDenoiserTileAlbedo = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+    m_context["sysDenoiserTileAlbedo"]->setBuffer(m_bufferDenoiserTileAlbedo);
 #if USE_DENOISER_NORMAL
-    v = m_stageDenoiser->queryVariable("input_normal_buffer");
-    v->setBuffer(m_bufferNormals);
+    m_bufferDenoiserTileNormal = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+    m_context["sysDenoiserTileNormal"]->setBuffer(m_bufferDenoiserTileNormal);
 #endif
 #endif
-    v = m_stageDenoiser->queryVariable("blend");
-    v->setFloat(m_denoiseBlend); // 0.0f means full denoised buffer, 1.0f means original input image.
-    v = m_stageDenoiser->queryVariable("hdr");
-    v->setUint(1); // Enable the HDR denoiser inside OptiX 5.1.0. "hdr" is an unsigned int variable. Non-zero means enabled.
-    //v = m_stageDenoiser->queryVariable("maxmem");
-    //v->setFloat(1024.0f * 1024.0f * 512.0f); // "maxmem" is a float variable [bytes]! Limit the maximum memory the denoiser should use.
+    m_bufferDenoiserTileOutput = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+    m_context["sysDenoiserTileOutput"]->setBuffer(m_bufferDenoiserTileOutput);
 
-    m_commandListDenoiser = m_context->createCommandList();
+    m_context["sysDenoisedBuffer"]->setBuffer(m_bufferDenoised);
+    m_context["sysDenoiserTileSize"]->setInt(m_denoiseTileSize);
+    m_context["sysDenoiserTileIndex"]->setInt(0, 0);
 
-    m_commandListDenoiser->appendPostprocessingStage(m_stageDenoiser, m_width, m_height);
-    m_commandListDenoiser->finalize();
+    it = m_mapOfPrograms.find("denoiser_tile_gather");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_DENOISER_TILE_GATHER, it->second);
+
+    it = m_mapOfPrograms.find("denoiser_tile_scatter");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_DENOISER_TILE_SCATTER, it->second);
+#endif
+
+#if USE_DENOISER_ALBEDO && USE_DENOISER_GBUFFER
+    it = m_mapOfPrograms.find("gbuffer");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_DENOISER_GBUFFER, it->second);
+#endif
 #endif // USE_DENOISER
+
+#if USE_GPU_LOCAL_ACCUMULATION
+    if (m_localAccumulation)
+    {
+      // Each device accumulates the pixels it renders inside its own memory.
+      // The variables declared at the raygeneration program scope override the context global output buffers,
+      // so only ENTRY_RENDER writes into the GPU local buffers and the resolve program copies them into the shared ones.
+      it = m_mapOfPrograms.find("raygeneration");
+      MY_ASSERT(it != m_mapOfPrograms.end()); 
+      optix::Program programRender = it->second;
+
+      it = m_mapOfPrograms.find("resolve");
+      MY_ASSERT(it != m_mapOfPrograms.end()); 
+      m_context->setRayGenerationProgram(ENTRY_RESOLVE, it->second);
+      optix::Program programResolve = it->second;
+
+      it = m_mapOfPrograms.find("restore");
+      MY_ASSERT(it != m_mapOfPrograms.end()); 
+      m_context->setRayGenerationProgram(ENTRY_RESTORE, it->second);
+      optix::Program programRestore = it->second;
+
+      m_bufferLocalOutput = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+      programRender["sysOutputBuffer"]->setBuffer(m_bufferLocalOutput);
+      programResolve["sysLocalOutputBuffer"]->setBuffer(m_bufferLocalOutput);
+      programRestore["sysLocalOutputBuffer"]->setBuffer(m_bufferLocalOutput);
+#if USE_DENOISER && !USE_DENOISER_GBUFFER // The gbuffer() launch writes the shared guide buffers directly.
+#if USE_DENOISER_ALBEDO
+      m_bufferLocalAlbedo = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+      programRender["sysAlbedoBuffer"]->setBuffer(m_bufferLocalAlbedo);
+      programResolve["sysLocalAlbedoBuffer"]->setBuffer(m_bufferLocalAlbedo);
+      programRestore["sysLocalAlbedoBuffer"]->setBuffer(m_bufferLocalAlbedo);
+#if USE_DENOISER_NORMAL
+      m_bufferLocalNormal = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+      programRender["sysNormalBuffer"]->setBuffer(m_bufferLocalNormal);
+      programResolve["sysLocalNormalBuffer"]->setBuffer(m_bufferLocalNormal);
+      programRestore["sysLocalNormalBuffer"]->setBuffer(m_bufferLocalNormal);
+#endif
+#endif
+#endif
+    }
+#endif // USE_GPU_LOCAL_ACCUMULATION
   }
   catch(optix::Exception& e)
   {
@@ -612,6 +1506,27 @@ void Application::initScene()
 
     std::cout << "createScene()" << std::endl;
     createScene();
+    m_uploader->flush(); // All geometry is in device memory before anything maps or builds it.
+#if USE_HETEROGENEOUS_MEDIA
+    initMedia(); // Needs the world space bounds of the materials' geometry.
+#endif
+#if USE_ACCELERATION_POLICY
+    selectTopLevelBuilder();
+#endif
+#if USE_GEOMETRY_PAGING
+    initGeometryPaging();
+    m_uploader->flush(); // The proxy boxes.
+#endif
+#if USE_DYNAMIC_SCENE
+    initDynamicScene();
+#endif
+#if USE_CUTOUT_CLASSIFICATION
+    classifyCutoutOpacity(); // Before the Accelerations are restored, the states don't change the geometry.
+#endif
+    if (!m_accelerationCache.empty())
+    {
+      restoreAccelerations(); // Accelerations with cached data are not built by the dummy launch.
+    }
     const double timeScene = m_timer.getTime();
 
     std::cout << "m_context->validate()" << std::endl;
@@ -619,182 +1534,1433 @@ void Application::initScene()
     const double timeValidate = m_timer.getTime();
 
     std::cout << "m_context->launch()" << std::endl;
+    m_kernelCacheStatistics.hits   = 0;
+    m_kernelCacheStatistics.misses = 0;
+    SUTIL_NVTX_PUSH("compile");
     m_context->launch(0, 0, 0); // Dummy launch to build everything (entrypoint, width, height)
+    SUTIL_NVTX_POP();
     const double timeLaunch = m_timer.getTime();
 
+    if (!m_accelerationCache.empty())
+    {
+      storeAccelerations();
+    }
+
+#if USE_GPU_ENVIRONMENT_CDF
+    if (m_missID == 2)
+    {
+      initEnvironmentDistribution();
+      std::cout << "  initEnvironmentDistribution() = " << m_timer.getTime() - timeLaunch << " seconds" << std::endl;
+    }
+#endif
+
+#if USE_GPU_MIPMAPS
+    // Textures created before the scene was complete. Asynchronously loaded textures generate theirs inside Texture::update().
+    const double timeMipmaps = m_timer.getTime();
+    const bool albedoMipmaps = m_textureAlbedo.generateMipmaps(m_context);
+    const bool cutoutMipmaps = m_textureCutout.generateMipmaps(m_context);
+    if (albedoMipmaps || cutoutMipmaps)
+    {
+      std::cout << "  generateMipmaps() = " << m_timer.getTime() - timeMipmaps << " seconds" << std::endl;
+    }
+#endif
+
+    m_timeInitScene = timeLaunch - timeInit;
+
     std::cout << "initScene(): " << timeLaunch - timeInit << " seconds overall" << std::endl;
     std::cout << "{" << std::endl;
     std::cout << "  createScene() = " << timeScene    - timeInit     << " seconds" << std::endl;
     std::cout << "  validate()    = " << timeValidate - timeScene    << " seconds" << std::endl;
     std::cout << "  launch()      = " << timeLaunch   - timeValidate << " seconds" << std::endl;
+#if OPTIX_VERSION >= 60000
+    std::cout << "  kernel disk cache: " << m_kernelCacheStatistics.hits << " hits, " << m_kernelCacheStatistics.misses << " misses" << std::endl;
+#endif
     std::cout << "}" << std::endl;
   }
-  catch(optix::Exception& e)
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+void Application::restartAccumulation()
+{
+  m_iterationIndex  = 0;
+  m_presentNext     = true;
+  m_presentAtSecond = 1.0;
+
+#if USE_REPROJECTION
+  m_reprojected = false; // render() sets it again after a successful reproject().
+#endif
+
+#if USE_TILED_LAUNCH
+  m_tileQueue.clear(); // Abandon a partially rendered iteration.
+  m_tileNext = 0;
+#endif
+
+#if USE_DENOISER
+  m_denoisedIteration = -1;
+#endif
+
+#if USE_PATH_STATISTICS
+  std::fill(m_pathStatistics.begin(), m_pathStatistics.end(), 0.0); // The weight window keeps the last image mean until new data arrived.
+#endif
+
+#if USE_VISIBILITY_CACHE
+  ++m_visibilityEpoch; // The cached visibility belongs to the previous camera and scene.
+#endif
+
+#if USE_RAY_COUNTERS
+  clearRayCounters(); // The rates are per accumulation like the fps.
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+  m_numActiveTiles = -1; // Render all pixels again.
+  m_converged      = false;
+  std::fill(m_tileConverged.begin(), m_tileConverged.end(), 0);
+#endif
+
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+  resetDenoiserConvergence();
+#endif
+
+#if USE_AOVS
+  if (m_aovMask)
+  {
+    m_context["sysAovIteration"]->setInt(0);
+  }
+#endif
+
+  m_timer.restart();
+}
+
+// Continue manual accumulation rendering if there is no limit (m_frames == 0) or the number of frames has not been reached.
+// With adaptive sampling rendering also stops when all tiles reached the target error,
+// with the denoiser convergence when the denoised image doesn't change anymore.
+bool Application::isAccumulating() const
+{
+  bool accumulating = (0 == m_frames || m_iterationIndex < m_frames);
+#if USE_ADAPTIVE_SAMPLING
+  accumulating = accumulating && !m_converged;
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+  accumulating = accumulating && !m_denoisedStable;
+#endif
+  return accumulating;
+}
+
+#if USE_SAMPLES_PER_LAUNCH
+void Application::setSamplesPerLaunch(const int samples)
+{
+  m_samplesPerLaunch = std::max(1, samples);
+}
+
+// The samples per pixel of the next iteration. Only the megakernel launches over the full resolution, the adaptive tiles
+// or the screen tiles loop. ReSTIR reuses the reservoirs between iterations and the rasterized primary hits hold one
+// sub-pixel position per iteration, so these render one sample per launch as well. Never renders past m_frames.
+int Application::getSamplesPerLaunch() const
+{
+  bool looping = (1 < m_samplesPerLaunch);
+#if USE_MULTI_VIEW
+  looping = looping && !isMultiViewSupported();
+#endif
+#if USE_WEDGE
+  looping = looping && !m_wedgeActive;
+#endif
+#if USE_WAVEFRONT
+  looping = looping && !m_wavefront;
+#endif
+#if USE_RESTIR
+  looping = looping && !isRestirSupported();
+#endif
+#if USE_RASTER_PRIMARY
+  looping = looping && !isRasterPrimarySupported();
+#endif
+
+  int samples = (looping) ? m_samplesPerLaunch : 1;
+  if (0 < m_frames)
+  {
+    samples = std::max(1, std::min(samples, m_frames - m_iterationIndex));
+  }
+  return samples;
+}
+#endif
+
+
+#if USE_DENOISER
+// The albedo and normals buffers are only connected when the shaders fill them.
+optix::PostprocessingStage Application::createDenoiserStage(optix::Buffer input, optix::Buffer albedo, optix::Buffer normals, optix::Buffer output)
+{
+  optix::PostprocessingStage stage = m_context->createBuiltinPostProcessingStage("DLDenoiser");
+  stage->declareVariable("input_buffer");
+  stage->declareVariable("output_buffer");
+#if USE_DENOISER_ALBEDO
+  if (m_useDenoiserAlbedo) // The albedo and normal buffers are only filled when the shaders were compiled with them.
+  {
+    stage->declareVariable("input_albedo_buffer");
+#if USE_DENOISER_NORMAL
+    if (m_useDenoiserNormal)
+    {
+      stage->declareVariable("input_normal_buffer");
+    }
+#endif
+  }
+#endif
+  stage->declareVariable("blend");  // The denoised image can be blended with the original input image with this variable.
+  stage->declareVariable("hdr");    // OptiX 5.1.0 supports HDR denoising which is shown in this example.
+  stage->declareVariable("maxmem"); // OptiX 5.1.0 allows to limit the maximum amount of memory the DL Denoiser should use (in bytes).
+
+  optix::Variable v = stage->queryVariable("input_buffer");
+  v->setBuffer(input);
+  v = stage->queryVariable("output_buffer");
+  v->setBuffer(output);
+#if USE_DENOISER_ALBEDO
+  if (m_useDenoiserAlbedo)
+  {
+    v = stage->queryVariable("input_albedo_buffer");
+    v->setBuffer(albedo);
+#if USE_DENOISER_NORMAL
+    if (m_useDenoiserNormal)
+    {
+      v = stage->queryVariable("input_normal_buffer");
+      v->setBuffer(normals);
+    }
+#endif
+  }
+#endif
+  v = stage->queryVariable("blend");
+  v->setFloat(m_denoiseBlend); // 0.0f means full denoised buffer, 1.0f means original input image.
+  v = stage->queryVariable("hdr");
+  v->setUint(1); // Enable the HDR denoiser inside OptiX 5.1.0. "hdr" is an unsigned int variable. Non-zero means enabled.
+  v = stage->queryVariable("maxmem");
+  v->setFloat(1024.0f * 1024.0f * m_denoiseMaxMem); // "maxmem" is a float variable [bytes]! Limit the maximum memory the denoiser should use. 0.0f == no limit.
+
+  return stage;
+}
+
+// Denoises m_bufferOutput into m_bufferDenoised.
+void Application::denoise()
+{
+#if USE_DENOISER_TILES
+  if (isDenoiserTiled())
+  {
+    denoiseTiles();
+    return;
+  }
+#endif
+  m_commandListDenoiser->execute();
+}
+#endif // USE_DENOISER
+
+
+bool Application::render()
+{
+  bool repaint = false;
+
+  m_profiler.nextFrame(m_iterationIndex);
+
+  try
+  {
+#if USE_RESIZE_CAPACITY
+    // The resizing stopped. One reallocation here instead of one per reshape() while dragging the window border.
+    if (!isCapacityExact() && RESIZE_SETTLE_SECONDS <= m_resizeTimer.getTime())
+    {
+      fitCapacity();
+    }
+#endif
+
+#if USE_GEOMETRY_PAGING
+    updateGeometryPaging(); // Restarts the accumulation when meshes were paged in or out.
+#endif
+
+    optix::float3 cameraPosition;
+    optix::float3 cameraU;
+    optix::float3 cameraV;
+    optix::float3 cameraW;
+
+    bool cameraChanged = m_pinholeCamera.getFrustum(cameraPosition, cameraU, cameraV, cameraW);
+    if (cameraChanged)
+    {
+      m_context["sysCameraPosition"]->setFloat(cameraPosition);
+      m_context["sysCameraU"]->setFloat(cameraU);
+      m_context["sysCameraV"]->setFloat(cameraV);
+      m_context["sysCameraW"]->setFloat(cameraW);
+      m_context["sysFocusDistance"]->setFloat(m_pinholeCamera.m_distance);
+#if USE_MULTI_VIEW
+      m_viewsDirty = true;
+#endif
+#if USE_MESH_LOD
+      updateMeshLod(cameraPosition, cameraV); // Only on camera changes, the accumulation restarts anyway.
+#endif
+
+#if USE_REPROJECTION
+      const bool reprojected = reproject();
+      restartAccumulation();
+      m_reprojected = reprojected;
+      setHistoryCamera(cameraPosition, cameraU, cameraV, cameraW);
+#else
+      restartAccumulation();
+#endif
+    }
+
+#if USE_ASYNC_TEXTURES
+    // Finer texture levels becoming resident change the image.
+    const bool albedoChanged = m_textureAlbedo.update(m_context);
+    const bool cutoutChanged = m_textureCutout.update(m_context);
+    if (albedoChanged || cutoutChanged)
+    {
+#if USE_RAY_CONES
+      updateMaterialParameters(); // The texture sizes inside the level of detail calculation changed with the placeholders.
+#endif
+      restartAccumulation();
+    }
+#endif
+
+#if USE_INCREMENTAL_MATERIALS
+    flushMaterialParameters(); // The GUI only marks the edited materials, upload them before the first launch of the frame.
+#endif
+
+#if USE_VIRTUAL_TEXTURES
+    // Streams the tiles the previous launches requested. Accumulating over changing texels would blend levels.
+    if (m_virtualAlbedo.update())
+    {
+      restartAccumulation();
+    }
+#endif
+
+#if USE_DYNAMIC_SCENE
+    // Moved instances and deformed meshes. The next launch builds the Accelerations marked dirty.
+    if (updateDynamicScene())
+    {
+      restartAccumulation();
+    }
+#endif
+
+#if USE_WEDGE
+    // After the material uploads above, the variants are built from the current GUI materials.
+    if (updateWedge())
+    {
+      restartAccumulation();
+    }
+#endif
+
+#if USE_CHECKPOINTS
+    // After all restarts above, so that the initial camera setup doesn't discard the loaded accumulation.
+    if (m_checkpointResume)
+    {
+      m_checkpointResume = false;
+      loadCheckpoint();
+    }
+#endif
+  
+#if USE_PREVIEW_RESOLUTION
+    // Camera interaction renders the preview. Its end starts the full resolution accumulation from scratch.
+#if USE_RENDER_THREAD
+    // m_guiState belongs to the GUI thread while the render thread runs, and renderPreview() uploads with OpenGL.
+    bool preview = (!m_renderThreadActive && 1 < m_previewFactor && m_guiState != GUI_STATE_NONE && !m_headless);
+#else
+    bool preview = (1 < m_previewFactor && m_guiState != GUI_STATE_NONE && !m_headless);
+#endif
+#if USE_REPROJECTION
+    preview = preview && !isReprojectionSupported(); // The reprojected full resolution image is better than the preview.
+#endif
+#if USE_MULTI_VIEW
+    preview = preview && !isMultiViewSupported(); // The preview renders the single view.
+#endif
+#if USE_WEDGE
+    preview = preview && !m_wedgeActive; // The preview renders the GUI materials only.
+#endif
+    if (preview != m_previewActive)
+    {
+      m_previewActive = preview;
+      setPreviewUpsampling(preview);
+      restartAccumulation();
+    }
+
+    if (m_previewActive)
+    {
+      renderPreview();
+      repaint = true;
+    }
+    else
+#endif
+    if (isAccumulating())
+    {
+      bool iterationDone = true; // Tiled launches can spread one iteration over multiple render() calls.
+
+      m_profiler.begin(PROFILER_LAUNCH);
+
+      m_context["sysIterationIndex"]->setInt(m_iterationIndex); // Iteration index is zero-based!
+#if USE_REPROJECTION
+      m_context["sysReprojection"]->setInt((!isReprojectionSupported()) ? 0 : (m_reprojected) ? 2 : 1);
+#endif
+#if USE_RASTER_PRIMARY
+      if (isRasterPrimarySupported())
+      {
+        rasterizePrimary(); // Can find motion blur during its initialization, so query the support again.
+      }
+      m_context["sysRasterPrimary"]->setInt((isRasterPrimarySupported()) ? 1 : 0);
+#endif
+#if USE_RESTIR
+      const bool restir = updateRestir();
+#endif
+#if USE_VISIBILITY_CACHE
+      updateVisibilityCache();
+#endif
+#if USE_RADIANCE_CACHE
+      const bool cache = updateRadianceCache();
+#endif
+      int samples = 1; // Per pixel in this iteration.
+#if USE_SAMPLES_PER_LAUNCH
+      samples = getSamplesPerLaunch();
+      m_context["sysSamplesPerLaunch"]->setInt(samples);
+#endif
+#if USE_MULTI_VIEW
+      if (updateViews())
+      {
+        renderViews();
+      }
+      else
+#endif
+#if USE_WEDGE
+      if (m_wedgeActive)
+      {
+        renderWedge();
+        m_context->launch(ENTRY_WEDGE_SELECT, m_width, m_height); // The displayed variant into sysOutputBuffer.
+      }
+      else
+#endif
+#if USE_WAVEFRONT
+      if (m_wavefront)
+      {
+        renderWavefront();
+      }
+      else
+#endif
+#if USE_ADAPTIVE_SAMPLING
+      if (0 <= m_numActiveTiles)
+      {
+        m_context->launch(ENTRY_RENDER_ADAPTIVE, m_numActiveTiles * ADAPTIVE_TILE_SIZE * ADAPTIVE_TILE_SIZE);
+      }
+      else
+#endif
+#if USE_TILED_LAUNCH
+      if (0 < m_tileSize)
+      {
+        iterationDone = renderTiles();
+      }
+      else
+#endif
+#if USE_PERSISTENT_THREADS
+      if (isPersistentSupported())
+      {
+        renderPersistent();
+      }
+      else
+#endif
+#if USE_MORTON_LAUNCH
+      if (m_mortonLaunch)
+      {
+        m_context->launch(ENTRY_RENDER_MORTON, getMortonLaunchSize());
+      }
+      else
+#endif
+      {
+        m_context->launch(ENTRY_RENDER, m_width, m_height);
+      }
+
+#if USE_DENOISER && USE_DENOISER_ALBEDO && USE_DENOISER_GBUFFER
+      if (iterationDone)
+      {
+        renderGuideBuffers(m_iterationIndex, samples);
+      }
+#endif
+
+      m_profiler.end(PROFILER_LAUNCH);
+
+#if USE_PATH_STATISTICS
+      updatePathStatistics();
+#endif
+
+      if (iterationDone)
+      {
+        m_iterationIndex += samples;
+
+#if USE_RESTIR
+        advanceRestir(restir);
+#endif
+#if USE_RADIANCE_CACHE
+        if (cache)
+        {
+          resolveRadianceCache();
+        }
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+        // The wavefront path tracer always renders all pixels. Adaptive sampling only works with the megakernel.
+        bool adaptive = !m_wavefront && 0.0f < m_targetError;
+#if USE_WEDGE
+        adaptive = adaptive && !m_wedgeActive;
+#endif
+        // Every m_adaptiveInterval samples. Launches with multiple samples per pixel can step over the exact multiple.
+        const int previousIndex = m_iterationIndex - samples;
+        if (adaptive && m_adaptiveMinSamples <= m_iterationIndex &&
+            previousIndex / m_adaptiveInterval != m_iterationIndex / m_adaptiveInterval)
+        {
+          updateConvergence();
+        }
+#endif
+
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+        if (m_headless) // Otherwise compared when presenting.
+        {
+          checkDenoiserConvergence();
+        }
+#endif
+      }
+    }
+
+    // Only update the texture when a restart happened or one second passed to reduce required bandwidth.
+    // Headless rendering has no texture. renderBatch() denoises and saves the image once at the end.
+#if USE_PREVIEW_RESOLUTION
+    if (m_presentNext && !m_headless && !m_previewActive) // The preview uploaded its own image.
+#else
+    if (m_presentNext && !m_headless)
+#endif
+    {
+      m_profiler.begin(PROFILER_UPLOAD);
+      resolveAccumulation();
+      m_profiler.end(PROFILER_UPLOAD);
+
+#if USE_DENOISER
+      // Right after a restart every iteration is presented. Show the noisy image then if the denoiser is slower than the budget.
+      // Otherwise only denoise again when enough new samples changed the accumulated image.
+      const bool interactive = (m_timer.getTime() < 0.5);
+      const bool overBudget  = (0.0f < m_denoiseBudget && m_denoiseBudget < m_denoiseTime);
+      bool       finalImage  = (0 < m_frames && m_frames <= m_iterationIndex);
+#if USE_ADAPTIVE_SAMPLING
+      finalImage = finalImage || m_converged;
+#endif
+#if USE_DENOISER_CONVERGENCE
+      finalImage = finalImage || m_denoisedStable;
+#endif
+
+      bool denoise = false;
+      bool noisy   = false;
+      if (interactive)
+      {
+        denoise = !overBudget;
+        noisy   =  overBudget;
+      }
+      else
+      {
+        denoise = (m_denoisedIteration < 0 ||
+                   m_denoiseCadence <= m_iterationIndex - m_denoisedIteration ||
+                   (finalImage && m_denoisedIteration != m_iterationIndex));
+      }
+
+      if (!m_useDenoiser) // The shaders were compiled without the denoiser.
+      {
+        denoise = false;
+        noisy   = true;
+      }
+#if USE_RESIZE_CAPACITY
+      if (!isCapacityExact()) // The denoiser works on the whole buffers. Show the noisy image until the resize settled.
+      {
+        denoise = false;
+        noisy   = true;
+      }
+#endif
+
+#if USE_DENOISER_DEVICE
+      if (denoise && m_denoiserDevice)
+      {
+        // Hand a snapshot to the denoiser device and keep accumulating. The display picks up the result when it's done.
+        const RTsize pitch = m_bufferOutput->getWidth();
+
+        const float* beauty = static_cast<const float*>(m_bufferOutput->map(0, RT_BUFFER_MAP_READ));
+        const float* albedo = (m_useDenoiserAlbedo) ? static_cast<const float*>(m_bufferAlbedo->map(0, RT_BUFFER_MAP_READ)) : nullptr;
+        const float* normal = (m_useDenoiserAlbedo && m_useDenoiserNormal) ? static_cast<const float*>(m_bufferNormals->map(0, RT_BUFFER_MAP_READ)) : nullptr;
+
+        m_denoiserDevice->submit(beauty, albedo, normal, m_width, m_height, int(pitch), m_iterationIndex);
+
+        m_bufferOutput->unmap();
+        if (albedo)
+        {
+          m_bufferAlbedo->unmap();
+        }
+        if (normal)
+        {
+          m_bufferNormals->unmap();
+        }
+
+        m_denoisedIteration = m_iterationIndex;
+        denoise = false;
+      }
+#endif
+
+      if (denoise)
+      {
+        Timer timerDenoiser;
+        timerDenoiser.start();
+
+        m_profiler.begin(PROFILER_DENOISER);
+        denoise(); // Now the result is inside the m_denoisedBuffer.
+        m_profiler.end(PROFILER_DENOISER);
+
+        m_denoiseTime       = float(timerDenoiser.getTime() * 1000.0);
+        m_denoisedIteration = m_iterationIndex;
+
+#if USE_DENOISER_CONVERGENCE
+        if (!interactive) // Only the presents at the denoise cadence are compared.
+        {
+          updateDenoiserConvergence();
+        }
+#endif
+      }
+#endif
+
+      m_profiler.begin(PROFILER_UPLOAD);
+
+#if USE_RENDER_THREAD
+      if (!m_renderThreadActive) // The render thread has no OpenGL context. uploadImage() publishes its frames instead.
+#endif
+      {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_hdrTexture); // Manual accumulation always renders into the m_hdrTexture.
+
+#if USE_RESIZE_CAPACITY
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_capacityWidth); // The image is the lower left sub-rectangle of the buffers.
+#endif
+      }
+
+#if USE_DENOISER
+#if USE_DENOISER_ALBEDO
+      // DAR DEBUG Show the albedo buffer.
+      //const void* data = m_bufferAlbedo->map(0, RT_BUFFER_MAP_READ);
+      //glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, data); // RGBA32F
+      //m_bufferAlbedo->unmap();
+
+#if USE_DENOISER_NORMAL
+      // DAR DEBUG Show the normal buffer.
+      //const void* data = m_bufferNormals->map(0, RT_BUFFER_MAP_READ);
+      //glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, data); // RGBA32F
+      //m_bufferNormals->unmap();
+#endif
+#endif
+
+      if (denoise)
+      {
+        if (m_interop) 
+        {
+          glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferDenoised->getGLBOId());
+          glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, (void*) 0); // RGBA32F from byte offset 0 in the pixel unpack buffer.
+          glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        else
+        {
+          uploadMapped(m_bufferDenoised);
+        }
+      }
+      else if (noisy)
+      {
+        // The noisy m_bufferOutput is never an OpenGL interop buffer when the denoiser is used.
+        uploadMapped(m_bufferOutput);
+      }
+#if USE_DENOISER_DEVICE
+      else if (m_denoiserDevice)
+      {
+        RenderFrame const* frame = m_denoiserDevice->acquire();
+        // Results of snapshots from before a resize are dropped.
+        if (frame && frame->width == int(m_width) && frame->height == int(m_height)
+#if USE_RESIZE_CAPACITY
+            && isCapacityExact()
+#endif
+           )
+        {
+#if USE_DEVICE_TONEMAP
+          setDisplayTonemapped(false);
+#endif
+          uploadImage(frame->internalFormat, frame->format, frame->type, 16, frame->data.data());
+        }
+      }
+#endif
+      // Else the texture keeps the last denoised image.
+#else
+      if (m_interop) 
+      {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferOutput->getGLBOId());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, (void*) 0); // RGBA32F from byte offset 0 in the pixel unpack buffer.
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      }
+      else
+      {
+        uploadMapped(m_bufferOutput);
+      }
+#endif // USE_DENOISER
+
+#if USE_RESIZE_CAPACITY
+#if USE_RENDER_THREAD
+      if (!m_renderThreadActive)
+#endif
+      {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+      }
+#endif
+
+      m_profiler.end(PROFILER_UPLOAD);
+
+      repaint = true; // Indicate that there is a new image.
+
+      m_presentNext = m_present;
+    }
+
+    double seconds = m_timer.getTime();
+#if 1
+    // Show the accumulation of the first half second to remain interactive with "present 0" on the VCA.
+    // Not done when benchmarking to get more accurate results.
+    if (seconds < 0.5)
+    {
+      m_presentAtSecond = 1.0;
+      m_presentNext     = true;
+    }
+    else 
+#endif
+    if (m_presentAtSecond < seconds)
+    {
+      m_presentAtSecond = ceil(seconds);
+      
+      const double fps = double(m_iterationIndex) / seconds;
+
+      std::ostringstream stream; 
+      stream.precision(3); // Precision is # digits in fraction part.
+      // m_iterationIndex has already been incremented for the last rendered frame, so it is the actual framecount here.
+      stream << std::fixed << m_iterationIndex << " / " << seconds << " = " << fps << " fps";
+#if USE_RAY_COUNTERS
+      updateRayCounters();
+      stream << ", " << double(m_rayCounters[RAY_COUNTER_RADIANCE] + m_rayCounters[RAY_COUNTER_SHADOW]) * 1.0e-6 / seconds << " Mrays/s";
+#endif
+      std::cout << stream.str() << std::endl;
+
+      m_presentNext = true; // Present at least every second.
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+  return repaint;
+}
+
+#if USE_WAVEFRONT
+// One iteration of the wavefront path tracer. Each extend launch only covers the paths which are still alive.
+#if USE_MORTON_LAUNCH
+void Application::setMortonLaunch(const bool enable)
+{
+  m_mortonLaunch = enable; // Only the order of the pixels changes, not the image.
+}
+#endif
+
+#if USE_DENOISER && USE_DENOISER_DEVICE
+void Application::setDenoiserDevice(const int device)
+{
+  m_denoiserDevice.reset();
+
+  if (device < 0 || !m_useDenoiser)
+  {
+    return;
+  }
+
+  const std::vector<int> devices = m_context->getEnabledDevices();
+  if (std::find(devices.begin(), devices.end(), device) != devices.end())
+  {
+    std::cerr << "WARNING: setDenoiserDevice() device " << device << " also renders. Exclude it with -d to not compete for it." << std::endl;
+  }
+
+  m_denoiserDevice.reset(new DenoiserDevice());
+  if (!m_denoiserDevice->init(device, m_useDenoiserAlbedo, m_useDenoiserNormal, m_denoiseBlend, m_denoiseMaxMem))
+  {
+    std::cerr << "WARNING: setDenoiserDevice() failed, denoising in the render context." << std::endl;
+    m_denoiserDevice.reset();
+  }
+}
+
+// All tiles covering the screen, the threads of the partial tiles outside the screen return immediately.
+RTsize Application::getMortonLaunchSize() const
+{
+  const RTsize tile   = RTsize(1) << MORTON_TILE_BITS;
+  const RTsize tilesX = (m_width  + tile - 1) / tile;
+  const RTsize tilesY = (m_height + tile - 1) / tile;
+
+  return tilesX * tilesY * tile * tile;
+}
+#endif
+
+void Application::renderWavefront()
+{
+  m_context["sysWavefrontParity"]->setInt(0);
+  m_context->launch(ENTRY_WAVEFRONT_GENERATE, m_width, m_height); // Fills input queue 0 with all primary rays.
+
+  int          parity = 0;
+  unsigned int count  = m_width * m_height;
+
+  for (int depth = 0; depth < m_maxPathLength && 0 < count; ++depth)
+  {
+    m_context["sysWavefrontParity"]->setInt(parity);
+    m_context["sysWavefrontDepth"]->setInt(depth);
+    m_context->launch(ENTRY_WAVEFRONT_EXTEND, count);
+
+    // Read back the number of paths which survived this segment and reset the counter for the next launch.
+    unsigned int* counter = static_cast<unsigned int*>(m_bufferWavefrontCounter->map(0, RT_BUFFER_MAP_READ_WRITE));
+    count = counter[0];
+    counter[0] = 0;
+    m_bufferWavefrontCounter->unmap();
+
+#if USE_WAVEFRONT_SORT
+    if (m_wavefrontSort && 0 < count)
+    {
+      sortWavefront(count); // Scatters the output queue back into the input queue.
+      continue;
+    }
+#endif
+    parity = 1 - parity; // The output queue becomes the input queue of the next segment.
+  }
+
+  m_context->launch(ENTRY_WAVEFRONT_RESOLVE, m_width, m_height);
+}
+#endif
+
+#if USE_PREVIEW_RESOLUTION
+// One iteration at the reduced resolution, uploaded directly into the m_hdrTexture.
+// The preview skips the denoiser, tiles and adaptive sampling. It only needs to follow the camera.
+// The denoiser guide buffers are indexed with the preview launch size, the restart at the end of the preview refills them.
+void Application::renderPreview()
+{
+  const RTsize width  = (m_width  + m_previewFactor - 1) / m_previewFactor;
+  const RTsize height = (m_height + m_previewFactor - 1) / m_previewFactor;
+
+  RTsize w;
+  RTsize h;
+  m_bufferPreview->getSize(w, h);
+  if (w != width || h != height)
+  {
+    m_bufferPreview->setSize(width, height);
+  }
+
+  m_profiler.begin(PROFILER_LAUNCH);
+  m_context["sysIterationIndex"]->setInt(m_iterationIndex);
+  m_context->launch(ENTRY_RENDER_PREVIEW, width, height);
+  m_profiler.end(PROFILER_LAUNCH);
+
+#if USE_PATH_STATISTICS
+  updatePathStatistics();
+#endif
+
+  m_iterationIndex++; // Holding a mouse button without moving the camera accumulates the preview.
+
+  m_profiler.begin(PROFILER_UPLOAD);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, m_hdrTexture);
+
+  const void* data = m_bufferPreview->map(0, RT_BUFFER_MAP_READ);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) width, (GLsizei) height, 0, GL_RGBA, GL_FLOAT, data); // RGBA32F
+  m_bufferPreview->unmap();
+#if USE_DEVICE_TONEMAP
+  setDisplayTonemapped(false);
+#endif
+  m_profiler.end(PROFILER_UPLOAD);
+}
+
+// The m_hdrTexture uses nearest filtering. The display shader interpolates the smaller preview image itself.
+void Application::setPreviewUpsampling(const bool enable)
+{
+  glUseProgram(m_glslProgram);
+  glUniform1i(glGetUniformLocation(m_glslProgram, "upsample"), (enable) ? 1 : 0);
+  glUseProgram(0);
+}
+#endif
+
+#if USE_PATH_STATISTICS
+// Accumulates the counters of the last launches on the host, where double precision doesn't saturate, and clears them.
+// The radiance per primary path is the image mean the ROULETTE_WEIGHT_WINDOW is centered on.
+void Application::updatePathStatistics()
+{
+  float* counters = static_cast<float*>(m_bufferPathStatistics->map(0, RT_BUFFER_MAP_READ_WRITE));
+  for (size_t i = 0; i < m_pathStatistics.size(); ++i)
+  {
+    m_pathStatistics[i] += counters[i];
+    counters[i] = 0.0f;
+  }
+  m_bufferPathStatistics->unmap();
+
+  const double paths = m_pathStatistics[PATH_STATISTICS_PATHS]; // Segment 0 is traced once per primary path.
+  if (0.0 < paths)
+  {
+    double radiance = 0.0;
+    for (int depth = 0; depth < PATH_STATISTICS_DEPTHS; ++depth)
+    {
+      radiance += m_pathStatistics[depth * PATH_STATISTICS_SLOTS + PATH_STATISTICS_RADIANCE];
+    }
+    m_rouletteMean = float(radiance / paths);
+    m_context["sysRouletteMean"]->setFloat(m_rouletteMean);
+  }
+}
+#endif
+
+#if USE_RAY_COUNTERS
+void Application::clearRayCounters()
+{
+  memset(m_rayCounters, 0, sizeof(m_rayCounters));
+  m_rayCountersSeconds = 0.0;
+
+  if (m_bufferRayCounters) // A restart can happen before initRenderer() created it.
+  {
+    memset(m_bufferRayCounters->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 0, sizeof(unsigned long long) * RAY_COUNTER_SLOTS);
+    m_bufferRayCounters->unmap();
+  }
+}
+
+// Adds the device counters to the totals since the last restart and clears them.
+// Only called at the present cadence, each read back waits for the device.
+void Application::updateRayCounters()
+{
+  unsigned long long* counters = static_cast<unsigned long long*>(m_bufferRayCounters->map(0, RT_BUFFER_MAP_READ_WRITE));
+  m_profiler.addRays(counters[RAY_COUNTER_RADIANCE] + counters[RAY_COUNTER_SHADOW]);
+  for (int i = 0; i < RAY_COUNTER_SLOTS; ++i)
+  {
+    m_rayCounters[i] += counters[i];
+    counters[i] = 0;
+  }
+  m_bufferRayCounters->unmap();
+
+  m_rayCountersSeconds = m_timer.getTime();
+}
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+// Estimate the error per tile and rebuild the list of tiles which still need samples.
+void Application::updateConvergence()
+{
+  m_context["sysIterationIndex"]->setInt(m_iterationIndex - 1); // The last rendered sample, it can be past the first sample of the launch.
+  m_context->launch(ENTRY_CONVERGENCE, m_tilesX, m_tilesY);
+
+  std::vector<optix::uint2> activeTiles;
+
+  const float* error = static_cast<const float*>(m_bufferTileError->map(0, RT_BUFFER_MAP_READ));
+  for (int y = 0; y < m_tilesY; ++y)
+  {
+    for (int x = 0; x < m_tilesX; ++x)
+    {
+      const int i = y * m_tilesX + x;
+      if (!m_tileConverged[i] && m_targetError < error[i])
+      {
+        activeTiles.push_back(optix::make_uint2(x, y));
+      }
+      else
+      {
+        m_tileConverged[i] = 1;
+      }
+    }
+  }
+  m_bufferTileError->unmap();
+
+  if (activeTiles.empty())
+  {
+    m_converged   = true;
+    m_presentNext = true; // Make sure the final result gets displayed.
+    std::cout << "Converged to target error " << m_targetError << " after " << m_iterationIndex << " iterations" << std::endl;
+  }
+  else if (int(activeTiles.size()) < m_tilesX * m_tilesY)
+  {
+    m_bufferActiveTiles->setSize(activeTiles.size());
+    void* dst = m_bufferActiveTiles->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    memcpy(dst, activeTiles.data(), sizeof(optix::uint2) * activeTiles.size());
+    m_bufferActiveTiles->unmap();
+
+    m_numActiveTiles = int(activeTiles.size());
+  }
+}
+#endif
+
+#if USE_TILED_LAUNCH
+// Build the list of tile offsets for the next iteration, sorted by distance of the tile center to m_tileFocus.
+void Application::scheduleTiles()
+{
+  m_tileQueue.clear();
+  m_tileNext = 0;
+
+  for (int y = 0; y < m_height; y += m_tileSize)
+  {
+    for (int x = 0; x < m_width; x += m_tileSize)
+    {
+      m_tileQueue.push_back(optix::make_uint2(x, y));
+    }
+  }
+
+  const float         half  = float(m_tileSize) * 0.5f;
+  const optix::float2 focus = m_tileFocus;
+
+  std::stable_sort(m_tileQueue.begin(), m_tileQueue.end(), [half, focus](optix::uint2 const& a, optix::uint2 const& b)
+  {
+    const optix::float2 da = optix::make_float2(float(a.x) + half, float(a.y) + half) - focus;
+    const optix::float2 db = optix::make_float2(float(b.x) + half, float(b.y) + half) - focus;
+    return optix::dot(da, da) < optix::dot(db, db);
+  });
+}
+
+// Launch tiles of the current iteration until the frame time budget is used up.
+// Returns true when the last tile of the iteration has been rendered.
+bool Application::renderTiles()
+{
+  if (m_tileQueue.empty())
+  {
+    scheduleTiles();
+  }
+
+  Timer timer;
+  timer.start();
+
+  // Always render at least one tile per call or nothing would ever finish with a tiny budget.
+  do
+  {
+    const optix::uint2 offset = m_tileQueue[m_tileNext++];
+
+    m_context["sysTileOffset"]->setUint(offset.x, offset.y);
+    m_context->launch(ENTRY_RENDER_TILE, std::min(m_tileSize, m_width - int(offset.x)), std::min(m_tileSize, m_height - int(offset.y)));
+  }
+  while (m_tileNext < m_tileQueue.size() && timer.getTime() * 1000.0 < double(m_frameBudget));
+
+  if (m_tileNext < m_tileQueue.size())
+  {
+    return false;
+  }
+
+  m_tileQueue.clear();
+  return true;
+}
+#endif
+
+void Application::display()
+{
+  m_profiler.begin(PROFILER_DISPLAY);
+  drawImage();
+  m_profiler.end(PROFILER_DISPLAY);
+}
+
+// Draws the m_hdrTexture into the whole viewport with the tonemapper shader.
+void Application::drawImage()
+{
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, m_hdrTexture);
+
+  glUseProgram(m_glslProgram);
+
+  glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(-1.0f, -1.0f);
+    glTexCoord2f(1.0f, 0.0f);
+    glVertex2f(1.0f, -1.0f);
+    glTexCoord2f(1.0f, 1.0f);
+    glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, 1.0f);
+    glVertex2f(-1.0f, 1.0f);
+  glEnd();
+
+  glUseProgram(0);
+}
+
+// Upload an RGBA32F buffer into the currently bound m_hdrTexture via map.
+// With the half display option the device converts it to RGBA16F first, so only half the data is read back.
+// With the device tonemap option only the final RGBA8 image is read back, a quarter of the data.
+void Application::uploadMapped(optix::Buffer buffer)
+{
+#if USE_DEVICE_TONEMAP
+  if (m_deviceTonemap && !m_interop) // The interop uploads of the denoised image are tonemapped by the GLSL shader, so are the noisy ones then.
+  {
+    tonemapDevice(buffer);
+
+    setDisplayTonemapped(true);
+
+    const void* data = m_bufferTonemap->map(0, RT_BUFFER_MAP_READ);
+    uploadImage(GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, data); // RGBA8
+    m_bufferTonemap->unmap();
+    return;
+  }
+  setDisplayTonemapped(false);
+#endif
+
+#if USE_HALF_DISPLAY
+  if (m_halfDisplay)
+  {
+    if (m_displayHalfSource != buffer)
+    {
+      m_displayHalfSource = buffer;
+      m_context["sysDisplaySource"]->setBuffer(m_displayHalfSource);
+    }
+    m_context->launch(ENTRY_DISPLAY_HALF, m_width, m_height);
+
+    const void* data = m_bufferDisplayHalf->map(0, RT_BUFFER_MAP_READ);
+    uploadImage(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, data); // RGBA16F
+    m_bufferDisplayHalf->unmap();
+    return;
+  }
+#endif
+
+  const void* data = buffer->map(0, RT_BUFFER_MAP_READ);
+  uploadImage(GL_RGBA32F, GL_RGBA, GL_FLOAT, 16, data); // RGBA32F
+  buffer->unmap();
+}
+
+// The m_width * m_height image of the mapped data goes into the currently bound m_hdrTexture.
+void Application::uploadImage(const GLint internalFormat, const GLenum format, const GLenum type, const int bytesPerPixel, const void* data)
+{
+#if USE_RENDER_THREAD
+  if (m_renderThreadActive)
+  {
+    publishFrame(internalFormat, format, type, bytesPerPixel, data);
+    return;
+  }
+#else
+  (void) bytesPerPixel; // The GL_UNPACK_ROW_LENGTH covers the pitch.
+#endif
+  glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, (GLsizei) m_width, (GLsizei) m_height, 0, format, type, data);
+}
+
+#if USE_RENDER_SERVER || USE_DEVICE_TONEMAP
+// The device side tonemapper uses the same parameters as the uniforms of the GLSL display shader.
+void Application::setTonemapVariables()
+{
+  m_context["sysColorBalance"]->setFloat(m_colorBalance);
+  m_context["sysInvWhitePoint"]->setFloat(m_brightness / m_whitePoint);
+  m_context["sysBurnHighlights"]->setFloat(m_burnHighlights);
+  m_context["sysSaturation"]->setFloat(m_saturation);
+  m_context["sysCrushBlacks"]->setFloat(m_crushBlacks + m_crushBlacks + 1.0f);
+  m_context["sysInvGamma"]->setFloat(1.0f / m_gamma);
+}
+#endif
+
+#if USE_DEVICE_TONEMAP
+void Application::setDeviceTonemap(const bool enable)
+{
+  m_deviceTonemap = enable;
+  std::cout << "Device tonemap is " << ((m_deviceTonemap) ? "enabled" : "disabled") << std::endl;
+}
+
+// Tonemaps the RGBA32F source into the m_bufferTonemap. The GUI only changes the GLSL uniforms, so the variables are set each time.
+void Application::tonemapDevice(optix::Buffer source)
+{
+  m_context["sysEncodeSource"]->setBuffer(source);
+  setTonemapVariables();
+
+  m_context->launch(ENTRY_TONEMAP, m_width, m_height);
+}
+
+// The GLSL shader skips its tonemapper when the m_hdrTexture already contains the RGBA8 result.
+void Application::setDisplayTonemapped(const bool tonemapped)
+{
+  if (m_displayTonemapped != tonemapped)
+  {
+    m_displayTonemapped = tonemapped;
+
+#if USE_RENDER_THREAD
+    if (m_renderThreadActive) // The flag travels with the published frame. presentFrame() sets the uniform.
+    {
+      return;
+    }
+#endif
+    glUseProgram(m_glslProgram);
+    glUniform1i(glGetUniformLocation(m_glslProgram, "tonemapped"), (m_displayTonemapped) ? 1 : 0);
+    glUseProgram(0);
+  }
+}
+#endif
+
+void Application::setProfileFilename(std::string const& filename)
+{
+  m_profiler.setFilename(filename);
+
+  std::ostringstream resolution;
+  resolution << m_width << "x" << m_height;
+  m_profiler.setInfo("resolution", resolution.str());
+}
+
+#if USE_DENOISER && USE_DENOISER_ALBEDO && USE_DENOISER_GBUFFER
+// The denoiser guide buffers converge after a few samples, other than the radiance.
+// Only the first iterations after a restart accumulate them, with sysIterationIndex == iteration.
+// A launch with multiple samples per pixel covers count iterations. Each of them gets its own guide sample
+// with its own index, the running mean weights depend on it.
+void Application::renderGuideBuffers(const int iteration, const int count)
+{
+  if (!m_useDenoiserAlbedo)
+  {
+    return;
+  }
+  for (int i = iteration; i < iteration + count && i < DENOISER_GBUFFER_ITERATIONS; ++i)
+  {
+    if (1 < count)
+    {
+      m_context["sysIterationIndex"]->setInt(i);
+    }
+    m_context->launch(ENTRY_DENOISER_GBUFFER, m_width, m_height);
+  }
+  if (1 < count)
   {
-    std::cerr << e.getErrorString() << std::endl;
+    m_context["sysIterationIndex"]->setInt(iteration);
   }
 }
+#endif
 
-void Application::restartAccumulation()
+// Bring the per-device accumulation results into the buffers the denoiser and the display read.
+void Application::resolveAccumulation()
 {
-  m_iterationIndex  = 0;
-  m_presentNext     = true;
-  m_presentAtSecond = 1.0;
-
-  m_timer.restart();
+#if USE_GPU_LOCAL_ACCUMULATION
+  if (m_localAccumulation)
+  {
+    m_context->launch(ENTRY_RESOLVE, m_width, m_height);
+  }
+#endif
 }
 
-
-bool Application::render()
+// Renders a fixed number of iterations at each of the camera positions on a fixed orbit around the scene,
+// bypassing the OpenGL display so that only the OptiX launches are measured.
+// The random number seeds only depend on the launch index and iteration index, which makes every run render the same images.
+void Application::benchmark(std::string const& name, const int iterations, const int positions)
 {
-  bool repaint = false;
-
   try
   {
-    optix::float3 cameraPosition;
-    optix::float3 cameraU;
-    optix::float3 cameraV;
-    optix::float3 cameraW;
+    finishTextures(); // Measure and render with the final textures only.
 
-    bool cameraChanged = m_pinholeCamera.getFrustum(cameraPosition, cameraU, cameraV, cameraW);
-    if (cameraChanged)
+    int samplesPerLaunch = 1;
+#if USE_SAMPLES_PER_LAUNCH
+    samplesPerLaunch = (m_wavefront) ? 1 : m_samplesPerLaunch;
+    m_context["sysSamplesPerLaunch"]->setInt(samplesPerLaunch);
+#endif
+
+#if USE_RAY_COUNTERS
+    clearRayCounters(); // Only count the rays of the timed launches.
+#endif
+
+    double seconds = 0.0;
+
+    for (int position = 0; position < positions; ++position)
     {
+      if (0 < position)
+      {
+        // Orbit 1/positions of a full circle around the center of interest.
+        m_pinholeCamera.setBaseCoordinates(0, 0);
+        m_pinholeCamera.orbit(m_width / positions, 0);
+      }
+
+      optix::float3 cameraPosition;
+      optix::float3 cameraU;
+      optix::float3 cameraV;
+      optix::float3 cameraW;
+
+      m_pinholeCamera.getFrustum(cameraPosition, cameraU, cameraV, cameraW);
+
       m_context["sysCameraPosition"]->setFloat(cameraPosition);
       m_context["sysCameraU"]->setFloat(cameraU);
       m_context["sysCameraV"]->setFloat(cameraV);
       m_context["sysCameraW"]->setFloat(cameraW);
+      m_context["sysFocusDistance"]->setFloat(m_pinholeCamera.m_distance);
 
-      restartAccumulation();
-    }
-  
-    // Continue manual accumulation rendering if there is no limit (m_frames == 0) or the number of frames has not been reached.
-    if (0 == m_frames || m_iterationIndex < m_frames)
-    {
-      m_context["sysIterationIndex"]->setInt(m_iterationIndex); // Iteration index is zero-based!
-      m_context->launch(0, m_width, m_height);
-      m_iterationIndex++;
+      Timer timer;
+      timer.start();
+      for (int i = 0; i < iterations; ++i)
+      {
+        m_context["sysIterationIndex"]->setInt(i * samplesPerLaunch);
+        launchBenchmarkIteration();
+      }
+      seconds += timer.getTime();
     }
 
-    // Only update the texture when a restart happened or one second passed to reduce required bandwidth.
-    if (m_presentNext)
-    {
-#if USE_DENOISER
-      m_commandListDenoiser->execute(); // Now the result is inside the m_denoisedBuffer.
+    const double launches = double(iterations) * double(positions);
+    const double samples  = launches * double(m_width) * double(m_height) * double(samplesPerLaunch);
+
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(3) << "BENCHMARK " << name << " " << m_width << "x" << m_height
+           << " iterations=" << iterations << " positions=" << positions << " samples_per_launch=" << samplesPerLaunch
+           << " initScene_ms=" << m_timeInitScene * 1000.0
+           << " ms_per_iteration=" << seconds * 1000.0 / launches
+           << " Msamples_per_second=" << samples / seconds * 1.0e-6;
+#if USE_RAY_COUNTERS
+    // Radiance plus shadow rays counted on the device, read back after the timing.
+    updateRayCounters();
+    const double rays = double(m_rayCounters[RAY_COUNTER_RADIANCE] + m_rayCounters[RAY_COUNTER_SHADOW]);
+    stream << " Mrays_per_second=" << rays / seconds * 1.0e-6;
+#endif
+    std::cout << stream.str() << std::endl;
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+// One iteration of the integrator selected at startup, without the display and denoiser work of render().
+void Application::launchBenchmarkIteration()
+{
+#if USE_WAVEFRONT
+  if (m_wavefront)
+  {
+    renderWavefront();
+  }
+  else
+#endif
+#if USE_PERSISTENT_THREADS
+  if (isPersistentSupported())
+  {
+    renderPersistent();
+  }
+  else
+#endif
+#if USE_MORTON_LAUNCH
+  if (m_mortonLaunch)
+  {
+    m_context->launch(ENTRY_RENDER_MORTON, getMortonLaunchSize());
+  }
+  else
+#endif
+  {
+    m_context->launch(ENTRY_RENDER, m_width, m_height);
+  }
+}
+
+// Blocks until all asynchronously loaded textures are fully resident.
+void Application::finishTextures()
+{
+#if USE_ASYNC_TEXTURES
+  m_textureAlbedo.finish(m_context);
+  m_textureCutout.finish(m_context);
 #endif
+}
 
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, m_hdrTexture); // Manual accumulation always renders into the m_hdrTexture.
+void Application::screenshot(std::string const& filename)
+{
+#if USE_RESIZE_CAPACITY
+  if (!isCapacityExact()) // Right after a resize. The image writer needs the buffers at the exact size.
+  {
+    fitCapacity();
+    render();
+  }
+#endif
+  resolveAccumulation();
+#if USE_WEDGE
+  if (writeWedgeImages(filename)) // One image per variant.
+  {
+    return;
+  }
+#endif
+  writeImage(filename);
+}
 
+void Application::writeImage(std::string const& filename)
+{
+  optix::Buffer buffer = m_bufferOutput;
 #if USE_DENOISER
-#if USE_DENOISER_ALBEDO
-      // DAR DEBUG Show the albedo buffer.
-      //const void* data = m_bufferAlbedo->map(0, RT_BUFFER_MAP_READ);
-      //glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, data); // RGBA32F
-      //m_bufferAlbedo->unmap();
+  if (m_useDenoiser)
+  {
+    SUTIL_NVTX_RANGE("denoiser");
+    denoise(); // Must call the post-processing command list at least once to get the data into the denoised buffer.
+    buffer = m_bufferDenoised; // Store the denoised buffer!
+  }
+#endif
 
+  // The denoiser guide buffers are stored as additional layers when writing *.exr files.
+  optix::Buffer albedo;
+  optix::Buffer normal;
+#if USE_DENOISER && USE_DENOISER_ALBEDO
+  if (m_useDenoiserAlbedo)
+  {
+    albedo = m_bufferAlbedo;
+  }
 #if USE_DENOISER_NORMAL
-      // DAR DEBUG Show the normal buffer.
-      //const void* data = m_bufferNormals->map(0, RT_BUFFER_MAP_READ);
-      //glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, data); // RGBA32F
-      //m_bufferNormals->unmap();
+  if (m_useDenoiserNormal)
+  {
+    normal = m_bufferNormals;
+  }
 #endif
 #endif
 
-      if (m_interop) 
-      {
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferDenoised->getGLBOId());
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, (void*) 0); // RGBA32F from byte offset 0 in the pixel unpack buffer.
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-      }
-      else
-      {
-        const void* data = m_bufferDenoised->map(0, RT_BUFFER_MAP_READ);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, data); // RGBA32F
-        m_bufferDenoised->unmap();
-      }
+#if USE_DEVICE_TONEMAP
+  if (m_deviceTonemap && !sutil::isFloatImageFile(filename.c_str()))
+  {
+    tonemapDevice(buffer);
+    buffer = m_bufferTonemap; // Same image as displayed, without the guide layers which only *.exr files store.
+  }
+#endif
+
+#if USE_ASYNC_SCREENSHOTS
+  m_imageWriter.write(filename, buffer, albedo, normal); // Only copies the buffers, the image is written in the background.
+  std::cerr << "Writing " << filename << std::endl;
 #else
-      if (m_interop) 
-      {
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferOutput->getGLBOId());
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, (void*) 0); // RGBA32F from byte offset 0 in the pixel unpack buffer.
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-      }
-      else
-      {
-        const void* data = m_bufferOutput->map(0, RT_BUFFER_MAP_READ);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei) m_width, (GLsizei) m_height, 0, GL_RGBA, GL_FLOAT, data); // RGBA32F
-        m_bufferOutput->unmap();
-      }
-#endif // USE_DENOISER
+  sutil::writeBuffersToFile(filename.c_str(), buffer, albedo, normal);
+  std::cerr << "Wrote " << filename << std::endl;
+#endif
 
-      repaint = true; // Indicate that there is a new image.
+#if USE_AOVS
+  writeAovs(filename);
+#endif
+}
 
-      m_presentNext = m_present;
-    }
+void Application::renderBatch(const int spp, const double seconds, std::string const& filename)
+{
+  m_frames = spp; // 0 == Only the time budget ends the rendering.
 
-    double seconds = m_timer.getTime();
-#if 1
-    // Show the accumulation of the first half second to remain interactive with "present 0" on the VCA.
-    // Not done when benchmarking to get more accurate results.
-    if (seconds < 0.5)
-    {
-      m_presentAtSecond = 1.0;
-      m_presentNext     = true;
-    }
-    else 
-#endif
-    if (m_presentAtSecond < seconds)
-    {
-      m_presentAtSecond = ceil(seconds);
-      
-      const double fps = double(m_iterationIndex) / seconds;
+  finishTextures(); // Offline results must not contain placeholder texels.
 
-      std::ostringstream stream; 
-      stream.precision(3); // Precision is # digits in fraction part.
-      // m_iterationIndex has already been incremented for the last rendered frame, so it is the actual framecount here.
-      stream << std::fixed << m_iterationIndex << " / " << seconds << " = " << fps << " fps";
-      std::cout << stream.str() << std::endl;
+  Timer timer;
+  timer.start();
 
-      m_presentNext = true; // Present at least every second.
-    }
-  }
-  catch(optix::Exception& e)
+#if USE_CHECKPOINTS
+  double checkpointAtSecond = m_checkpointInterval;
+#endif
+
+  bool finished = false;
+  while (!finished)
   {
-    std::cerr << e.getErrorString() << std::endl;
-  }
-  return repaint;
-}
+#if USE_CHECKPOINTS
+    const int iterationIndex = m_iterationIndex;
+#endif
 
-void Application::display()
-{
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, m_hdrTexture);
+    render();
 
-  glUseProgram(m_glslProgram);
+    finished = (0 < m_frames && m_frames <= m_iterationIndex) || (0.0 < seconds && seconds <= timer.getTime());
+#if USE_ADAPTIVE_SAMPLING
+    finished = finished || m_converged;
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+    finished = finished || m_denoisedStable;
+#endif
 
-  glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f);
-    glVertex2f(-1.0f, -1.0f);
-    glTexCoord2f(1.0f, 0.0f);
-    glVertex2f(1.0f, -1.0f);
-    glTexCoord2f(1.0f, 1.0f);
-    glVertex2f(1.0f, 1.0f);
-    glTexCoord2f(0.0f, 1.0f);
-    glVertex2f(-1.0f, 1.0f);
-  glEnd();
+#if USE_CHECKPOINTS
+    // Only between iterations. Tiled launches leave the buffers with a partially rendered iteration in between.
+    if (!m_checkpointFilename.empty() && 0.0 < m_checkpointInterval && !finished &&
+        iterationIndex != m_iterationIndex && checkpointAtSecond <= timer.getTime())
+    {
+      writeCheckpoint();
+      checkpointAtSecond = timer.getTime() + m_checkpointInterval;
+    }
+#endif
+  }
 
-  glUseProgram(0);
-}
+  const double renderSeconds = timer.getTime();
+  std::cout << "renderBatch(): " << m_iterationIndex << " samples per pixel in " << renderSeconds << " seconds" << std::endl;
+#if USE_RAY_COUNTERS
+  updateRayCounters();
+  std::cout << "renderBatch(): " << m_rayCounters[RAY_COUNTER_RADIANCE] << " radiance and " << m_rayCounters[RAY_COUNTER_SHADOW] << " shadow rays = "
+            << double(m_rayCounters[RAY_COUNTER_RADIANCE] + m_rayCounters[RAY_COUNTER_SHADOW]) * 1.0e-6 / renderSeconds << " Mrays/s" << std::endl;
+#endif
 
-void Application::screenshot(std::string const& filename)
-{
-#if USE_DENOISER
-  m_commandListDenoiser->execute(); // Must call the post-processing command list at least once to get the data into the denoised buffer.
-  sutil::writeBufferToFile(filename.c_str(), m_bufferDenoised); // Store the denoised buffer!
-#else
-  sutil::writeBufferToFile(filename.c_str(), m_bufferOutput);
+#if USE_CHECKPOINTS
+  // The final state allows to continue with more samples per pixel or a new time budget later.
+  if (!m_checkpointFilename.empty())
+  {
+    writeCheckpoint();
+  }
 #endif
-  std::cerr << "Wrote " << filename << std::endl;
+
+  screenshot(filename); // Runs the denoiser once.
 }
 
 // Helper functions:
@@ -859,11 +3025,32 @@ void Application::initGLSL()
     "uniform float saturation;\n"
     "uniform float crushBlacks;\n"
     "uniform float invGamma;\n"
+    "uniform int   upsample;\n"
+    "uniform int   tonemapped;\n"
     "in vec2 varTexCoord0;\n"
     "layout(location = 0, index = 0) out vec4 outColor;\n"
     "void main()\n"
     "{\n"
-    "  vec3 hdrColor = texture(samplerHDR, varTexCoord0).rgb;\n"
+    "  vec3 hdrColor;\n"
+    "  if (upsample != 0)\n"
+    "  {\n"
+    "    ivec2 size = textureSize(samplerHDR, 0);\n"
+    "    vec2  st   = varTexCoord0 * vec2(size) - 0.5;\n"
+    "    vec2  f    = st - floor(st);\n"
+    "    ivec2 i0   = clamp(ivec2(floor(st)), ivec2(0), size - 1);\n"
+    "    ivec2 i1   = clamp(i0 + 1, ivec2(0), size - 1);\n"
+    "    hdrColor = mix(mix(texelFetch(samplerHDR, i0, 0).rgb,             texelFetch(samplerHDR, ivec2(i1.x, i0.y), 0).rgb, f.x),\n"
+    "                   mix(texelFetch(samplerHDR, ivec2(i0.x, i1.y), 0).rgb, texelFetch(samplerHDR, i1, 0).rgb,             f.x), f.y);\n"
+    "  }\n"
+    "  else\n"
+    "  {\n"
+    "    hdrColor = texture(samplerHDR, varTexCoord0).rgb;\n"
+    "  }\n"
+    "  if (tonemapped != 0)\n"
+    "  {\n"
+    "    outColor = vec4(hdrColor, 1.0);\n"
+    "    return;\n"
+    "  }\n"
     "  vec3 ldrColor = invWhitePoint * colorBalance * hdrColor;\n"
     "  ldrColor *= (ldrColor * burnHighlights + 1.0) / (ldrColor + 1.0);\n"
     "  float luminance = dot(ldrColor, vec3(0.3, 0.59, 0.11));\n"
@@ -938,6 +3125,8 @@ void Application::initGLSL()
       glUniform1f(glGetUniformLocation(m_glslProgram, "burnHighlights"), m_burnHighlights);
       glUniform1f(glGetUniformLocation(m_glslProgram, "crushBlacks"), m_crushBlacks + m_crushBlacks + 1.0f);
       glUniform1f(glGetUniformLocation(m_glslProgram, "saturation"), m_saturation);
+      glUniform1i(glGetUniformLocation(m_glslProgram, "upsample"), 0);
+      glUniform1i(glGetUniformLocation(m_glslProgram, "tonemapped"), 0);
 
       glUseProgram(0);
     }
@@ -970,24 +3159,127 @@ void Application::guiWindow()
     {
       // No action needed, happens automatically.
     }
-    if (ImGui::Combo("Camera", (int*) &m_cameraType, "Pinhole\0Fisheye\0Spherical\0\0"))
+#if USE_WAVEFRONT
+    if (m_context->getEnabledDeviceCount() == 1 && ImGui::Checkbox("Wavefront", &m_wavefront))
+    {
+      restartAccumulation();
+    }
+#if USE_PERSISTENT_THREADS
+    if (!m_wavefront && m_context->getEnabledDeviceCount() == 1)
+    {
+      // Changes only the order of the pixels, not the image. No restart needed.
+      if (ImGui::DragInt("Persistent Threads", &m_persistentThreads, 32.0f, 0, 2048)) // Per multiprocessor, 0 == off.
+      {
+        m_persistentThreads = std::max(0, m_persistentThreads);
+      }
+    }
+#endif
+#if USE_MORTON_LAUNCH
+    if (!m_wavefront)
+    {
+      ImGui::Checkbox("Morton Order", &m_mortonLaunch); // Same image, no restart needed.
+    }
+#endif
+#if USE_WAVEFRONT_SORT
+    if (m_wavefront)
+    {
+      // The path order doesn't change the image, no restart needed.
+      bool sort = m_wavefrontSort;
+      if (ImGui::Checkbox("Sort Paths", &sort))
+      {
+        setWavefrontSort((sort) ? m_wavefrontSortCell : 0.0f);
+      }
+      if (ImGui::DragFloat("Sort Cell", &m_wavefrontSortCell, 0.01f, 0.01f, 100.0f, "%.2f"))
+      {
+        m_wavefrontSortCell = std::max(0.01f, m_wavefrontSortCell);
+        m_context["sysWavefrontSortCell"]->setFloat(m_wavefrontSortCell);
+      }
+    }
+#endif
+#endif
+    if (ImGui::Combo("Camera", (int*) &m_cameraType, "Pinhole\0Fisheye\0Spherical\0Thin Lens\0Cubemap\0\0"))
+    {
+      m_context["sysCameraType"]->setInt(m_cameraType);
+      restartAccumulation();
+    }
+    if (m_cameraType == LENS_SHADER_THIN_LENS)
+    {
+      if (ImGui::DragFloat("Lens Radius", &m_lensRadius, 0.001f, 0.0f, 1.0f))
+      {
+        m_lensRadius = std::max(0.0f, m_lensRadius);
+        m_context["sysLensRadius"]->setFloat(m_lensRadius);
+        restartAccumulation();
+      }
+      float focusDistance = m_pinholeCamera.m_distance;
+      if (ImGui::DragFloat("Focus Distance", &focusDistance, 0.01f, 0.001f, 10000.0f))
+      {
+        m_pinholeCamera.setFocusDistance(focusDistance); // Picked up with the next getFrustum() in render().
+      }
+      if (ImGui::DragInt("Aperture Blades", &m_apertureBlades, 1.0f, 0, 16)) // 0 == circular.
+      {
+        updateApertureTable();
+        restartAccumulation();
+      }
+      if (ImGui::DragFloat("Aperture Rotation", &m_apertureRotation, 1.0f, 0.0f, 360.0f))
+      {
+        updateApertureTable();
+        restartAccumulation();
+      }
+    }
+#if USE_FILTER_IMPORTANCE_SAMPLING
+    if (ImGui::Combo("Pixel Filter", &m_pixelFilter, "Box\0Tent\0Gaussian\0Blackman-Harris\0\0"))
+    {
+      updateFilterTable();
+      restartAccumulation();
+    }
+    if (ImGui::DragFloat("Filter Radius", &m_filterRadius, 0.01f, 0.05f, 4.0f, "%.2f")) // In pixels.
+    {
+      updateFilterTable();
+      restartAccumulation();
+    }
+#endif
+    if (ImGui::Combo("Shutter", &m_shutterType, "Stochastic\0Top to Bottom\0Bottom To Top\0Left To Right\0Right To Left\0\0"))
+    {
+      m_context["sysShutterType"]->setInt(m_shutterType);
+      restartAccumulation();
+    }
+#if USE_STRATIFIED_SHUTTER
+    if (ImGui::DragInt("Time Slices", &m_timeSlices, 1.0f, 1, 64)) // Stochastic shutter only.
+    {
+      m_timeSlices = std::max(1, m_timeSlices);
+      m_context["sysTimeSlices"]->setInt(m_timeSlices);
+      restartAccumulation();
+    }
+#endif
+    if (ImGui::DragInt("Min Paths", &m_minPathLength, 1.0f, 0, 100))
+    {
+      m_context["sysPathLengths"]->setInt(m_minPathLength, m_maxPathLength);
+      restartAccumulation();
+    }
+    if (ImGui::DragInt("Max Paths", &m_maxPathLength, 1.0f, 0, 100))
     {
-      m_context["sysCameraType"]->setInt(m_cameraType);
+      m_context["sysPathLengths"]->setInt(m_minPathLength, m_maxPathLength);
       restartAccumulation();
     }
-    if (ImGui::Combo("Shutter", &m_shutterType, "Stochastic\0Top to Bottom\0Bottom To Top\0Left To Right\0Right To Left\0\0"))
+#if USE_PATH_STATISTICS
+    if (ImGui::Combo("Roulette", &m_rouletteType, "Max Throughput\0Intensity\0Weight Window\0\0"))
+#else
+    if (ImGui::Combo("Roulette", &m_rouletteType, "Max Throughput\0Intensity\0\0"))
+#endif
     {
-      m_context["sysShutterType"]->setInt(m_shutterType);
+      m_context["sysRouletteType"]->setInt(m_rouletteType);
       restartAccumulation();
     }
-    if (ImGui::DragInt("Min Paths", &m_minPathLength, 1.0f, 0, 100))
+    if (m_rouletteType == ROULETTE_WEIGHT_WINDOW && ImGui::DragFloat("Window Size", &m_rouletteWindow, 0.1f, 1.0f, 100.0f, "%.1f"))
     {
-      m_context["sysPathLengths"]->setInt(m_minPathLength, m_maxPathLength);
+      m_rouletteWindow = std::max(1.0f, m_rouletteWindow);
+      m_context["sysRouletteWindow"]->setFloat(m_rouletteWindow);
       restartAccumulation();
     }
-    if (ImGui::DragInt("Max Paths", &m_maxPathLength, 1.0f, 0, 100))
+    if (ImGui::DragInt("Light Samples", &m_lightSamples, 1.0f, 1, 16))
     {
-      m_context["sysPathLengths"]->setInt(m_minPathLength, m_maxPathLength);
+      m_lightSamples = std::max(1, m_lightSamples); // Typed in values are not clamped by ImGui.
+      m_context["sysLightSamples"]->setInt(m_lightSamples);
       restartAccumulation();
     }
     if (ImGui::DragFloat("Scene Epsilon", &m_sceneEpsilonFactor, 1.0f, 0.0f, 10000.0f))
@@ -997,7 +3289,7 @@ void Application::guiWindow()
     }
     if (ImGui::DragFloat("Env Rotation", &m_environmentRotation, 0.001f, 0.0f, 1.0f))
     {
-      m_context["sysEnvironmentRotation"]->setFloat(m_environmentRotation);
+      updateEnvironmentMatrix();
       restartAccumulation();
     }
 #if USE_DENOISER
@@ -1005,7 +3297,53 @@ void Application::guiWindow()
     {
       optix::Variable v = m_stageDenoiser->queryVariable("blend");
       v->setFloat(m_denoiseBlend);
+#if USE_DENOISER_TILES
+      if (m_stageDenoiserTile)
+      {
+        m_stageDenoiserTile->queryVariable("blend")->setFloat(m_denoiseBlend);
+      }
+#endif
+      m_denoisedIteration = -1; // Show the new blend on the next present.
+      m_presentNext       = true;
+    }
+    if (ImGui::DragFloat("Denoise Budget", &m_denoiseBudget, 0.1f, 0.0f, 1000.0f, "%.1f ms")) // 0.0f == no limit
+    {
+      // No action needed, happens automatically.
+    }
+    if (ImGui::DragInt("Denoise Cadence", &m_denoiseCadence, 1.0f, 1, 1000))
+    {
+      // No action needed, happens automatically.
+    }
+#if USE_DENOISER_CONVERGENCE
+    if (ImGui::DragFloat("Stable Threshold", &m_stableThreshold, 0.0001f, 0.0f, 1.0f, "%.4f")) // 0.0f == off
+    {
+      m_denoisedStable = false; // Continue when the threshold got lowered after the image was stable.
+      m_stableChecks   = 0;
+    }
+    if (0.0f < m_stableThreshold)
+    {
+      ImGui::Text((m_denoisedStable) ? "Stable after %d iterations, change %.4f" : "Iteration %d, change %.4f", m_iterationIndex, m_denoisedChange);
+    }
+#endif
+    if (ImGui::DragFloat("Denoise MaxMem", &m_denoiseMaxMem, 1.0f, 0.0f, 65536.0f, "%.0f MB")) // 0.0f == no limit
+    {
+      optix::Variable v = m_stageDenoiser->queryVariable("maxmem");
+      v->setFloat(1024.0f * 1024.0f * m_denoiseMaxMem);
+#if USE_DENOISER_TILES
+      if (m_stageDenoiserTile)
+      {
+        m_stageDenoiserTile->queryVariable("maxmem")->setFloat(1024.0f * 1024.0f * m_denoiseMaxMem);
+      }
+#endif
+    }
+#if USE_DENOISER_TILES
+    if (ImGui::DragInt("Denoise Tile", &m_denoiseTileSize, 8.0f, 0, 8192)) // 0 == full frame
+    {
+      m_denoiseTileSize   = (0 < m_denoiseTileSize) ? std::max(m_denoiseTileSize, 2 * DENOISER_TILE_OVERLAP) : 0;
+      m_denoisedIteration = -1; // Show the result on the next present.
+      m_presentNext       = true;
     }
+#endif
 #endif
     if (ImGui::DragInt("Frames", &m_frames, 1.0f, 0, 10000))
     {
@@ -1014,11 +3352,235 @@ void Application::guiWindow()
         restartAccumulation();
       }
     }
+#if USE_TILED_LAUNCH
+    if (!m_localAccumulation && ImGui::DragInt("Tile Size", &m_tileSize, 1.0f, 0, 4096)) // 0 == off
+    {
+      restartAccumulation();
+    }
+    if (ImGui::DragFloat("Frame Budget", &m_frameBudget, 0.1f, 1.0f, 1000.0f, "%.1f ms"))
+    {
+      // No action needed, happens automatically.
+    }
+#endif
+#if USE_SAMPLES_PER_LAUNCH
+    if (ImGui::DragInt("Samples/Launch", &m_samplesPerLaunch, 1.0f, 1, 256))
+    {
+      m_samplesPerLaunch = std::max(1, m_samplesPerLaunch);
+      restartAccumulation(); // A tiled iteration must not change its sample count halfway.
+    }
+#endif
+#if USE_ADAPTIVE_SAMPLING
+    if (!m_localAccumulation && ImGui::DragFloat("Target Error", &m_targetError, 0.001f, 0.0f, 1.0f, "%.3f")) // 0.0f == off
+    {
+      restartAccumulation();
+    }
+#endif
+#if USE_PREVIEW_RESOLUTION
+    if (ImGui::DragInt("Preview Factor", &m_previewFactor, 1.0f, 1, 16)) // 1 == off
+    {
+      m_previewFactor = std::max(1, m_previewFactor);
+    }
+#endif
+#if USE_REPROJECTION
+    if (ImGui::Checkbox("Reproject", &m_reprojection))
+    {
+      restartAccumulation(); // The per pixel data is only written while reprojection is on.
+    }
+    if (ImGui::DragInt("Reproject History", &m_reprojectionHistory, 1.0f, 1, 4096))
+    {
+      m_reprojectionHistory = std::max(1, m_reprojectionHistory);
+      m_context["sysReprojectionHistory"]->setFloat(float(m_reprojectionHistory));
+    }
+    if (ImGui::DragFloat("Reproject Tolerance", &m_reprojectionTolerance, 0.001f, 0.001f, 1.0f, "%.3f"))
+    {
+      m_context["sysReprojectionTolerance"]->setFloat(m_reprojectionTolerance);
+    }
+#endif
+#if USE_RESTIR
+    if (ImGui::Checkbox("ReSTIR", &m_restir))
+    {
+      restartAccumulation();
+    }
+    if (ImGui::DragInt("ReSTIR Candidates", &m_restirCandidates, 1.0f, 1, 64))
+    {
+      m_restirCandidates = std::max(1, m_restirCandidates);
+      m_context["sysRestirCandidates"]->setInt(m_restirCandidates);
+      restartAccumulation();
+    }
+#endif
+#if USE_VISIBILITY_CACHE
+    if (ImGui::Checkbox("Visibility Cache", &m_visibilityCache))
+    {
+      restartAccumulation();
+    }
+#endif
+#if USE_SPECTRAL
+    bool spectral = m_spectral;
+    if (ImGui::Checkbox("Spectral", &spectral))
+    {
+      setSpectral(spectral);
+      restartAccumulation();
+    }
+#endif
+#if USE_RADIANCE_CACHE
+    if (ImGui::DragInt("Cache Bounces", &m_cacheBounces, 1.0f, 0, 16)) // 0 == off
+    {
+      m_cacheBounces = std::max(0, m_cacheBounces);
+      restartAccumulation();
+    }
+    if (ImGui::DragFloat("Cache Cell Size", &m_cacheCellSize, 0.001f, 0.001f, 10.0f, "%.3f"))
+    {
+      m_cacheCellSize = std::max(0.001f, m_cacheCellSize);
+      m_cacheReset    = true; // The voxels of the old size are meaningless.
+      restartAccumulation();
+    }
+    if (ImGui::DragInt("Cache History", &m_cacheHistory, 1.0f, 1, 1024))
+    {
+      m_cacheHistory = std::max(1, m_cacheHistory);
+      m_context["sysCacheHistory"]->setFloat(float(m_cacheHistory));
+    }
+#endif
+#if USE_DYNAMIC_SCENE
+    ImGui::Checkbox("Animate", &m_animation);
+    ImGui::DragFloat("Refit Threshold", &m_refitThreshold, 0.001f, 0.0f, 1.0f, "%.3f"); // 0.0f == always rebuild
+    ImGui::Text("BVH refits %d, rebuilds %d", m_dynamicRefits, m_dynamicRebuilds);
+#endif
+#if USE_MULTI_VIEW
+    if (ImGui::Combo("Views", &m_multiView, "Single\0Stereo\0Cubemap\0\0"))
+    {
+      m_viewsDirty = true;
+      restartAccumulation();
+    }
+    if (m_multiView == MULTI_VIEW_STEREO && ImGui::DragFloat("Eye Separation", &m_stereoSeparation, 0.001f, 0.0f, 10.0f, "%.3f"))
+    {
+      m_stereoSeparation = std::max(0.0f, m_stereoSeparation);
+      m_viewsDirty       = true;
+      restartAccumulation();
+    }
+#endif
+#if USE_WEDGE
+    if (m_wedgeActive)
+    {
+      int variant = m_wedgeDisplay;
+      if (ImGui::SliderInt("Wedge Variant", &variant, 0, int(m_wedgeVariants.size()) - 1))
+      {
+        selectWedgeVariant(variant); // All variants accumulate together, no restart.
+      }
+    }
+#endif
+#if USE_SCENE_RELOAD
+    ImGui::InputText("Scene", m_guiSceneFilename, sizeof(m_guiSceneFilename)); // Empty == demo scene.
+    if (ImGui::Button("Reload Scene"))
+    {
+      reloadScene(std::string(m_guiSceneFilename), std::string()); // Also picks up changes of the current files.
+    }
+#endif
     if (ImGui::DragFloat("Mouse Ratio", &m_mouseSpeedRatio, 0.1f, 0.1f, 1000.0f, "%.1f"))
     {
       m_pinholeCamera.setSpeedRatio(m_mouseSpeedRatio);
     }
   }
+#if USE_PATH_STATISTICS
+  if (ImGui::CollapsingHeader("Path Statistics"))
+  {
+    // Per path segment since the last restart: Share of the primary paths reaching it, share of the image radiance it added,
+    // share of its paths terminated by Russian Roulette and the mean continuation probability of those decisions.
+    const double primary = m_pathStatistics[PATH_STATISTICS_PATHS];
+
+    double radiance = 0.0;
+    for (int depth = 0; depth < PATH_STATISTICS_DEPTHS; ++depth)
+    {
+      radiance += m_pathStatistics[depth * PATH_STATISTICS_SLOTS + PATH_STATISTICS_RADIANCE];
+    }
+
+    ImGui::Text("Image mean %.4f", m_rouletteMean);
+    ImGui::Text("Depth  Paths  Radiance  Killed  Continue");
+    for (int depth = 0; depth < PATH_STATISTICS_DEPTHS && 0.0 < primary; ++depth)
+    {
+      const double* s = &m_pathStatistics[depth * PATH_STATISTICS_SLOTS];
+      if (s[PATH_STATISTICS_PATHS] <= 0.0)
+      {
+        break;
+      }
+      const double tests = std::max(1.0, s[PATH_STATISTICS_TESTS]);
+      ImGui::Text("%s%2d  %5.1f%%  %6.2f%%  %5.1f%%  %.3f", (depth == PATH_STATISTICS_DEPTHS - 1) ? ">" : " ", depth,
+                  100.0 * s[PATH_STATISTICS_PATHS] / primary,
+                  (0.0 < radiance) ? 100.0 * s[PATH_STATISTICS_RADIANCE] / radiance : 0.0,
+                  100.0 * s[PATH_STATISTICS_TERMINATED] / s[PATH_STATISTICS_PATHS],
+                  s[PATH_STATISTICS_PROBABILITY] / tests);
+    }
+  }
+#endif
+#if USE_RAY_COUNTERS
+  if (ImGui::CollapsingHeader("Ray Counters"))
+  {
+    // Rates since the last restart at the last read back, which happens once per second with the fps output.
+    // Fewer rays per path at the same rays per second means the speedup came from tracing less, not faster.
+    const unsigned long long* c = m_rayCounters;
+    const double scale = (0.0 < m_rayCountersSeconds) ? 1.0e-6 / m_rayCountersSeconds : 0.0;
+    const double paths = double(c[RAY_COUNTER_END_MISS] + c[RAY_COUNTER_END_LIGHT] + c[RAY_COUNTER_END_CACHE] +
+                                c[RAY_COUNTER_END_ABSORBED] + c[RAY_COUNTER_END_ROULETTE] + c[RAY_COUNTER_END_LENGTH]);
+    const double share = (0.0 < paths) ? 100.0 / paths : 0.0;
+
+    ImGui::Text("Radiance  %8.2f Mrays/s", double(c[RAY_COUNTER_RADIANCE]) * scale);
+    ImGui::Text("Shadow    %8.2f Mrays/s", double(c[RAY_COUNTER_SHADOW]) * scale);
+    ImGui::Text("Anyhit    %8.2f M/s", double(c[RAY_COUNTER_ANYHIT]) * scale);
+    ImGui::Text("Rays per path %.2f", (0.0 < paths) ? double(c[RAY_COUNTER_RADIANCE] + c[RAY_COUNTER_SHADOW]) / paths : 0.0);
+    ImGui::Text("Paths ended by");
+    ImGui::Text("  Miss      %5.1f%%", double(c[RAY_COUNTER_END_MISS]) * share);
+    ImGui::Text("  Light     %5.1f%%", double(c[RAY_COUNTER_END_LIGHT]) * share);
+    ImGui::Text("  Cache     %5.1f%%", double(c[RAY_COUNTER_END_CACHE]) * share);
+    ImGui::Text("  Absorbed  %5.1f%%", double(c[RAY_COUNTER_END_ABSORBED]) * share);
+    ImGui::Text("  Roulette  %5.1f%%", double(c[RAY_COUNTER_END_ROULETTE]) * share);
+    ImGui::Text("  Length    %5.1f%%", double(c[RAY_COUNTER_END_LENGTH]) * share);
+  }
+#endif
+#if USE_COST_HEATMAP
+  if (ImGui::CollapsingHeader("Cost Heatmap"))
+  {
+    // Shows where the megakernel spends its cycles. The display tonemapper and denoiser still run over the colors.
+    if (ImGui::Combo("Heatmap", &m_costHeatmap, "Off\0Frame\0Average\0\0"))
+    {
+      m_context["sysCostHeatmap"]->setInt(m_costHeatmap);
+      restartAccumulation();
+    }
+    if (ImGui::DragFloat("Cycles", &m_costScale, 1.0e4f, 1.0e4f, 1.0e9f, "%.0f"))
+    {
+      m_costScale = std::max(1.0e4f, m_costScale);
+      m_context["sysCostScale"]->setFloat(m_costScale);
+      restartAccumulation();
+    }
+  }
+#endif
+  if (ImGui::CollapsingHeader("Memory"))
+  {
+    // Sizes of the buffers and Accelerations by category. The free device memory also covers OptiX internal allocations.
+    if (ImGui::Button("Refresh") || m_memoryTracker.getNumberOfDevices() == 0)
+    {
+      updateMemoryTracker();
+    }
+    if (!m_memoryReportFilename.empty())
+    {
+      ImGui::SameLine();
+      if (ImGui::Button("Write"))
+      {
+        m_memoryTracker.write(m_memoryReportFilename);
+      }
+    }
+    const double mebibyte = 1.0 / (1024.0 * 1024.0);
+    for (unsigned int i = 0; i < m_memoryTracker.getNumberOfDevices(); ++i)
+    {
+      ImGui::Text("Device %u: %.1f of %.1f MiB free", i,
+                  double(m_memoryTracker.getDeviceAvailableBytes(i)) * mebibyte,
+                  double(m_memoryTracker.getDeviceTotalBytes(i)) * mebibyte);
+    }
+    for (int i = 0; i < NUMBER_OF_MEMORY_CATEGORIES; ++i)
+    {
+      const MemoryCategory category = MemoryCategory(i);
+      ImGui::Text("%-12s %9.1f MiB", MemoryTracker::getCategoryName(category), double(m_memoryTracker.getBytes(category)) * mebibyte);
+    }
+    ImGui::Text("%-12s %9.1f MiB", "total", double(m_memoryTracker.getTotalBytes()) * mebibyte);
+  }
   if (ImGui::CollapsingHeader("Tonemapper"))
   {
     if (ImGui::ColorEdit3("Balance", (float*) &m_colorBalance))
@@ -1067,16 +3629,26 @@ void Application::guiWindow()
   if (ImGui::CollapsingHeader("Materials"))
   {
     bool changed = false;
+#if USE_HETEROGENEOUS_MEDIA
+    bool mediaChanged = false; // Only sysMedia needs the upload.
+#endif
 
     for (int i = 0; i < int(m_guiMaterialParameters.size()); ++i)
     {
       if (ImGui::TreeNode((void*)(intptr_t) i, "Material %d", i))
       {
         MaterialParameterGUI& parameters = m_guiMaterialParameters[i];
+#if USE_INCREMENTAL_MATERIALS
+        const bool changedBefore = changed;
+        changed = false;
+#endif
 
         if (ImGui::Combo("BSDF Type", (int*) &parameters.indexBSDF,
                          "Diffuse Reflection\0Specular Reflection\0Specular Reflection Transmission\0\0"))
         {
+#if USE_SPECIALIZED_MATERIALS
+          updateMaterialBSDF(i);
+#endif
           changed = true;
         }
         if (ImGui::ColorEdit3("Albedo", (float*) &parameters.albedo))
@@ -1106,16 +3678,57 @@ void Application::guiWindow()
           {
             changed = true;
           }
+#if USE_SPECTRAL
+          if (ImGui::DragFloat("Abbe Number", &parameters.abbe, 0.1f, 0.0f, 100.0f, "%.1f")) // 0 == no dispersion.
+          {
+            changed = true;
+          }
+#endif
+        }
+#if USE_HETEROGENEOUS_MEDIA
+        if (0 <= parameters.medium)
+        {
+          MediumDefinition& medium = m_mediumDefinitions[parameters.medium];
+
+          if (ImGui::DragFloat("Medium Density", &medium.density, 0.1f, 0.0f, 1000.0f, "%.1f"))
+          {
+            mediaChanged = true;
+          }
+          if (ImGui::ColorEdit3("Scattering Albedo", (float*) &medium.albedo))
+          {
+            mediaChanged = true;
+          }
+          if (ImGui::DragFloat("Anisotropy", &medium.anisotropy, 0.01f, -0.99f, 0.99f, "%.2f")) // Henyey-Greenstein g.
+          {
+            mediaChanged = true;
+          }
+        }
+#endif
+#if USE_INCREMENTAL_MATERIALS
+        if (changed)
+        {
+          markMaterialDirty(i); // Uploaded with the next render() call.
         }
+        changed = changed || changedBefore;
+#endif
         ImGui::TreePop();
       }
     }
     
     if (changed) // If any of the material parameters changed, simply upload them to the sysMaterialParameters again.
     {
+#if !USE_INCREMENTAL_MATERIALS
       updateMaterialParameters();
+#endif
+      restartAccumulation();
+    }
+#if USE_HETEROGENEOUS_MEDIA
+    if (mediaChanged)
+    {
+      updateMedia();
       restartAccumulation();
     }
+#endif
   }
   if (ImGui::CollapsingHeader("Lights"))
   {
@@ -1125,8 +3738,8 @@ void Application::guiWindow()
     {
       LightDefinition& light = m_lightDefinitions[i];
 
-      // Allow to change the emission (radiant exitance in Watt/m^2 of the rectangle lights in the scene.
-      if (light.type == LIGHT_PARALLELOGRAM)
+      // Allow to change the emission (radiant exitance in Watt/m^2 of the rectangle and mesh lights in the scene.
+      if (light.type != LIGHT_ENVIRONMENT)
       {
         if (ImGui::TreeNode((void*)(intptr_t) i, "Light %d", i))
         {
@@ -1140,6 +3753,8 @@ void Application::guiWindow()
     }
     if (changed) // If any of the light parameters changed, simply upload them to the sysMaterialParameters again.
     {
+      buildLightAliasTable(); // The selection probabilities follow the emission.
+
       // Upload the light definitions into the sysLightDefinitions buffer.
       void* dst = static_cast<LightDefinition*>(m_bufferLightDefinitions->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
       memcpy(dst, m_lightDefinitions.data(), sizeof(LightDefinition) * m_lightDefinitions.size());
@@ -1163,72 +3778,150 @@ void Application::guiEventHandler()
     m_isWindowVisible = !m_isWindowVisible;
   }
 
+#if USE_RENDER_THREAD
+  if (m_renderThreadActive) // pollCamera() handles the mouse on every GUI thread frame, not only when the render thread is parked.
+  {
+    return;
+  }
+#endif
+
   const ImVec2 mousePosition = ImGui::GetMousePos(); // Mouse coordinate window client rect.
-  const int x = int(mousePosition.x);
-  const int y = int(mousePosition.y);
+
+  const bool down[3] = { ImGui::IsMouseDown(0), ImGui::IsMouseDown(1), ImGui::IsMouseDown(2) };
+
+  guiCamera(io.WantCaptureMouse, down, int(mousePosition.x), int(mousePosition.y), io.MouseWheel, m_width, m_height);
+}
+
+// The camera interaction state machine. captured == the GUI wants the mouse, down == left, right, middle mouse button state.
+void Application::guiCamera(const bool captured, const bool down[3], const int x, const int y, const float wheel, const int width, const int height)
+{
+#if USE_TILED_LAUNCH
+  // Prioritize the tiles under the cursor. The launch index origin is at the lower left, the mouse origin at the upper left.
+  if (0 <= x && x < width && 0 <= y && y < height)
+  {
+    cameraCommand(RENDER_COMMAND_TILE_FOCUS, x, height - 1 - y, 0.0f);
+  }
+  else
+  {
+    cameraCommand(RENDER_COMMAND_TILE_FOCUS, width / 2, height / 2, 0.0f);
+  }
+#else
+  (void) width;
+  (void) height;
+#endif
 
   switch (m_guiState)
   {
     case GUI_STATE_NONE:
-      if (!io.WantCaptureMouse) // Only allow camera interactions to begin when interacting with the GUI.
+      if (!captured) // Only allow camera interactions to begin when interacting with the GUI.
       {
-        if (ImGui::IsMouseDown(0)) // LMB down event?
+        if (down[0]) // LMB down event?
         {
-          m_pinholeCamera.setBaseCoordinates(x, y);
+          cameraCommand(RENDER_COMMAND_BASE, x, y, 0.0f);
           m_guiState = GUI_STATE_ORBIT;
         }
-        else if (ImGui::IsMouseDown(1)) // RMB down event?
+        else if (down[1]) // RMB down event?
         {
-          m_pinholeCamera.setBaseCoordinates(x, y);
+          cameraCommand(RENDER_COMMAND_BASE, x, y, 0.0f);
           m_guiState = GUI_STATE_DOLLY;
         }
-        else if (ImGui::IsMouseDown(2)) // MMB down event?
+        else if (down[2]) // MMB down event?
         {
-          m_pinholeCamera.setBaseCoordinates(x, y);
+          cameraCommand(RENDER_COMMAND_BASE, x, y, 0.0f);
           m_guiState = GUI_STATE_PAN;
         }
-        else if (io.MouseWheel != 0.0f) // Mouse wheel zoom.
+        else if (wheel != 0.0f) // Mouse wheel zoom.
         {
-          m_pinholeCamera.zoom(io.MouseWheel);
+          cameraCommand(RENDER_COMMAND_ZOOM, 0, 0, wheel);
         }
       }
       break;
 
     case GUI_STATE_ORBIT:
-      if (ImGui::IsMouseReleased(0)) // LMB released? End of orbit mode.
+      if (!down[0]) // LMB released? End of orbit mode.
       {
         m_guiState = GUI_STATE_NONE;
       }
       else
       {
-        m_pinholeCamera.orbit(x, y);
+        cameraCommand(RENDER_COMMAND_ORBIT, x, y, 0.0f);
       }
       break;
 
     case GUI_STATE_DOLLY:
-      if (ImGui::IsMouseReleased(1)) // RMB released? End of dolly mode.
+      if (!down[1]) // RMB released? End of dolly mode.
       {
         m_guiState = GUI_STATE_NONE;
       }
       else
       {
-        m_pinholeCamera.dolly(x, y);
+        cameraCommand(RENDER_COMMAND_DOLLY, x, y, 0.0f);
       }
       break;
 
     case GUI_STATE_PAN:
-      if (ImGui::IsMouseReleased(2)) // MMB released? End of pan mode.
+      if (!down[2]) // MMB released? End of pan mode.
       {
         m_guiState = GUI_STATE_NONE;
       }
       else
       {
-        m_pinholeCamera.pan(x, y);
+        cameraCommand(RENDER_COMMAND_PAN, x, y, 0.0f);
       }
       break;
   }
 }
 
+// Applied immediately, or, while the render thread owns the Application, in order between two of its iterations.
+void Application::cameraCommand(const int type, const int x, const int y, const float value)
+{
+  RenderCommand command;
+
+  command.type  = type;
+  command.x     = x;
+  command.y     = y;
+  command.value = value;
+
+#if USE_RENDER_THREAD
+  if (m_renderThreadActive)
+  {
+    m_renderCommands.push(command); // A full queue drops the command. The next mouse move continues from the dropped position.
+    return;
+  }
+#endif
+  applyCommand(command);
+}
+
+void Application::applyCommand(RenderCommand const& command)
+{
+  switch (command.type)
+  {
+    case RENDER_COMMAND_BASE:
+      m_pinholeCamera.setBaseCoordinates(command.x, command.y);
+      break;
+    case RENDER_COMMAND_ORBIT:
+      m_pinholeCamera.orbit(command.x, command.y);
+      break;
+    case RENDER_COMMAND_DOLLY:
+      m_pinholeCamera.dolly(command.x, command.y);
+      break;
+    case RENDER_COMMAND_PAN:
+      m_pinholeCamera.pan(command.x, command.y);
+      break;
+    case RENDER_COMMAND_ZOOM:
+      m_pinholeCamera.zoom(command.value);
+      break;
+    case RENDER_COMMAND_TILE_FOCUS:
+#if USE_TILED_LAUNCH
+      m_tileFocus = optix::make_float2(float(command.x), float(command.y));
+#endif
+      break;
+    case RENDER_COMMAND_RESHAPE:
+      reshape(command.x, command.y);
+      break;
+  }
+}
+
 
 // This part is always identical in the generated geometry creation routines.
 optix::Geometry Application::createGeometry(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices)
@@ -1239,18 +3932,39 @@ optix::Geometry Application::createGeometry(std::vector<VertexAttributes> const&
   {
     geometry = m_context->createGeometry();
 
+#if USE_COMPACT_ATTRIBUTES
+    // Split the VertexAttributes into the float3 positions for the BVH builder and the encoded shading attributes.
+    optix::Buffer positionsBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, attributes.size());
+
+    optix::Buffer attributesBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+    attributesBuffer->setElementSize(sizeof(VertexAttributesCompact));
+    attributesBuffer->setSize(attributes.size());
+
+    // Encode straight into the staging memory. One stream at a time, the staged memory is only valid until the next upload.
+    optix::float3* positions = static_cast<optix::float3*>(m_uploader->stage(positionsBuffer, sizeof(optix::float3) * attributes.size()));
+    parallelFor(0, int(attributes.size()), [&](const int i)
+    {
+      positions[i] = attributes[i].vertex;
+    }, 16384);
+
+    VertexAttributesCompact* compact = static_cast<VertexAttributesCompact*>(m_uploader->stage(attributesBuffer, sizeof(VertexAttributesCompact) * attributes.size()));
+    parallelFor(0, int(attributes.size()), [&](const int i)
+    {
+      compact[i] = encodeVertexAttributes(attributes[i].tangent, attributes[i].normal, attributes[i].texcoord);
+    }, 16384);
+
+    geometry["positionsBuffer"]->setBuffer(positionsBuffer);
+#else
     optix::Buffer attributesBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
     attributesBuffer->setElementSize(sizeof(VertexAttributes));
     attributesBuffer->setSize(attributes.size());
 
-    void *dst = attributesBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-    memcpy(dst, attributes.data(), sizeof(VertexAttributes) * attributes.size());
-    attributesBuffer->unmap();
+    m_uploader->upload(attributesBuffer, attributes.data(), sizeof(VertexAttributes) * attributes.size());
+#endif
 
+    // Asynchronous with the pinned staging ring. The callers flush m_uploader before the next launch.
     optix::Buffer indicesBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT3, indices.size() / 3);
-    dst = indicesBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-    memcpy(dst, indices.data(), sizeof(optix::uint3) * indices.size() / 3);
-    indicesBuffer->unmap();
+    m_uploader->upload(indicesBuffer, indices.data(), sizeof(optix::uint3) * (indices.size() / 3));
 
     std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("boundingbox_triangle_indexed");
     MY_ASSERT(it != m_mapOfPrograms.end()); 
@@ -1274,6 +3988,8 @@ optix::Geometry Application::createGeometry(std::vector<VertexAttributes> const&
 
 void Application::initPrograms()
 {
+  SUTIL_NVTX_RANGE("initPrograms");
+
   try
   {
     // First load all programs and put them into a map.
@@ -1281,61 +3997,192 @@ void Application::initPrograms()
     // (This renderer does not put variables on program scope!)
 
     // Renderer
-    m_mapOfPrograms["raygeneration"] = m_context->createProgramFromPTXFile(ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
-    m_mapOfPrograms["exception"]     = m_context->createProgramFromPTXFile(ptxPath("exception.cu"), "exception"); // entry point 0
+    m_mapOfPrograms["raygeneration"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration"); // entry point 0
+    m_mapOfPrograms["exception"]     = sutil::createProgramFromPTXFile(m_context, ptxPath("exception.cu"), "exception"); // all entry points
+
+#if USE_PREVIEW_RESOLUTION
+    // A separate Program object of the same function. Its program scope sysOutputBuffer only redirects the preview entry point.
+    m_mapOfPrograms["raygeneration_preview"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration");
+#endif
+
+#if USE_RADIANCE_CACHE
+    m_mapOfPrograms["radiance_cache_update"] = sutil::createProgramFromPTXFile(m_context, ptxPath("radiance_cache.cu"), "radiance_cache_update");
+#endif
+
+#if USE_REPROJECTION
+    m_mapOfPrograms["reproject_store"] = sutil::createProgramFromPTXFile(m_context, ptxPath("reprojection.cu"), "reproject_store");
+    m_mapOfPrograms["reproject"]       = sutil::createProgramFromPTXFile(m_context, ptxPath("reprojection.cu"), "reproject");
+#endif
+
+#if USE_TILED_LAUNCH
+    m_mapOfPrograms["raygeneration_tile"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration_tile");
+#endif
+
+#if USE_MORTON_LAUNCH
+    m_mapOfPrograms["raygeneration_morton"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration_morton");
+#endif
+
+#if USE_LIGHT_BAKE
+    m_mapOfPrograms["raygeneration_bake"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration_bake");
+#endif
+
+#if USE_PERSISTENT_THREADS
+    m_mapOfPrograms["raygeneration_persistent"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration_persistent");
+#endif
+
+#if USE_MULTI_VIEW
+    m_mapOfPrograms["raygeneration_views"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration_views");
+#endif
+
+#if USE_WEDGE
+    m_mapOfPrograms["raygeneration_wedge"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration_wedge");
+    m_mapOfPrograms["wedge_select"]        = sutil::createProgramFromPTXFile(m_context, ptxPath("wedge.cu"), "wedge_select");
+#endif
+
+#if USE_GPU_ENVIRONMENT_CDF
+    m_mapOfPrograms["environment_function"] = sutil::createProgramFromPTXFile(m_context, ptxPath("environment_cdf.cu"), "environment_function");
+    m_mapOfPrograms["environment_rows"]     = sutil::createProgramFromPTXFile(m_context, ptxPath("environment_cdf.cu"), "environment_rows");
+    m_mapOfPrograms["environment_marginal"] = sutil::createProgramFromPTXFile(m_context, ptxPath("environment_cdf.cu"), "environment_marginal");
+#endif
+
+#if USE_GPU_MIPMAPS
+    m_mapOfPrograms["mipmap_level"]  = sutil::createProgramFromPTXFile(m_context, ptxPath("mipmap.cu"), "mipmap_level");
+    m_mapOfPrograms["mipmap_encode"] = sutil::createProgramFromPTXFile(m_context, ptxPath("mipmap.cu"), "mipmap_encode");
+#endif
+
+#if USE_DENOISER && USE_DENOISER_ALBEDO && USE_DENOISER_GBUFFER
+    m_mapOfPrograms["gbuffer"] = sutil::createProgramFromPTXFile(m_context, ptxPath("gbuffer.cu"), "gbuffer");
+#endif
+
+#if USE_DENOISER && USE_DENOISER_TILES
+    m_mapOfPrograms["denoiser_tile_gather"]  = sutil::createProgramFromPTXFile(m_context, ptxPath("denoiser_tiles.cu"), "denoiser_tile_gather");
+    m_mapOfPrograms["denoiser_tile_scatter"] = sutil::createProgramFromPTXFile(m_context, ptxPath("denoiser_tiles.cu"), "denoiser_tile_scatter");
+#endif
+
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+    m_mapOfPrograms["denoiser_change"] = sutil::createProgramFromPTXFile(m_context, ptxPath("denoiser_change.cu"), "denoiser_change");
+#endif
+
+#if USE_HALF_DISPLAY
+    m_mapOfPrograms["display_half"] = sutil::createProgramFromPTXFile(m_context, ptxPath("display_half.cu"), "display_half");
+#endif
+
+#if USE_RENDER_SERVER
+    m_mapOfPrograms["encode_rgba8"] = sutil::createProgramFromPTXFile(m_context, ptxPath("encode_rgba8.cu"), "encode_rgba8");
+#endif
+#if USE_DEVICE_TONEMAP
+    m_mapOfPrograms["tonemap_bgra8"] = sutil::createProgramFromPTXFile(m_context, ptxPath("encode_rgba8.cu"), "tonemap_bgra8");
+#endif
+
+#if USE_INCREMENTAL_MATERIALS
+    m_mapOfPrograms["material_update"] = sutil::createProgramFromPTXFile(m_context, ptxPath("material_update.cu"), "material_update");
+#endif
+
+#if USE_GPU_LOCAL_ACCUMULATION
+    m_mapOfPrograms["resolve"] = sutil::createProgramFromPTXFile(m_context, ptxPath("resolve.cu"), "resolve");
+    m_mapOfPrograms["restore"] = sutil::createProgramFromPTXFile(m_context, ptxPath("resolve.cu"), "restore");
+#endif
+
+#if USE_ADAPTIVE_SAMPLING
+    m_mapOfPrograms["raygeneration_adaptive"] = sutil::createProgramFromPTXFile(m_context, ptxPath("raygeneration.cu"), "raygeneration_adaptive");
+    m_mapOfPrograms["convergence"]            = sutil::createProgramFromPTXFile(m_context, ptxPath("convergence.cu"), "convergence");
+#endif
+
+#if USE_WAVEFRONT
+    m_mapOfPrograms["wavefront_generate"] = sutil::createProgramFromPTXFile(m_context, ptxPath("wavefront.cu"), "wavefront_generate");
+    m_mapOfPrograms["wavefront_extend"]   = sutil::createProgramFromPTXFile(m_context, ptxPath("wavefront.cu"), "wavefront_extend");
+    m_mapOfPrograms["wavefront_resolve"]  = sutil::createProgramFromPTXFile(m_context, ptxPath("wavefront.cu"), "wavefront_resolve");
+#if USE_WAVEFRONT_SORT
+    m_mapOfPrograms["wavefront_sort"]     = sutil::createProgramFromPTXFile(m_context, ptxPath("wavefront.cu"), "wavefront_sort");
+#endif
+#endif
 
     // There can be only one of the miss programs active.
     switch (m_missID)
     {
     case 0: // Default black environment. Does not appear in the light definitions, means it's not used in direct lighting.
-      m_mapOfPrograms["miss"] = m_context->createProgramFromPTXFile(ptxPath("miss.cu"), "miss_environment_null"); // ray type 0
+      m_mapOfPrograms["miss"] = sutil::createProgramFromPTXFile(m_context, ptxPath("miss.cu"), "miss_environment_null"); // ray type 0
       break;
     case 1:
     default:
-      m_mapOfPrograms["miss"] = m_context->createProgramFromPTXFile(ptxPath("miss.cu"), "miss_environment_constant"); // raytype 0
+      m_mapOfPrograms["miss"] = sutil::createProgramFromPTXFile(m_context, ptxPath("miss.cu"), "miss_environment_constant"); // raytype 0
       break;
     case 2:
-      m_mapOfPrograms["miss"] = m_context->createProgramFromPTXFile(ptxPath("miss.cu"), "miss_environment_mapping"); // raytype 0
+      m_mapOfPrograms["miss"] = sutil::createProgramFromPTXFile(m_context, ptxPath("miss.cu"), "miss_environment_mapping"); // raytype 0
       break;
     }
 
     // Geometry
-    m_mapOfPrograms["boundingbox_triangle_indexed"]  = m_context->createProgramFromPTXFile(ptxPath("boundingbox_triangle_indexed.cu"),  "boundingbox_triangle_indexed");
-    m_mapOfPrograms["intersection_triangle_indexed"] = m_context->createProgramFromPTXFile(ptxPath("intersection_triangle_indexed.cu"), "intersection_triangle_indexed");
+    m_mapOfPrograms["boundingbox_triangle_indexed"]  = sutil::createProgramFromPTXFile(m_context, ptxPath("boundingbox_triangle_indexed.cu"),  "boundingbox_triangle_indexed");
+    m_mapOfPrograms["intersection_triangle_indexed"] = sutil::createProgramFromPTXFile(m_context, ptxPath("intersection_triangle_indexed.cu"), "intersection_triangle_indexed");
+#if OPTIX_VERSION >= 60000
+    m_mapOfPrograms["attribute_triangle_indexed"]    = sutil::createProgramFromPTXFile(m_context, ptxPath("attribute_triangle_indexed.cu"),    "attribute_triangle_indexed");
+#endif
 
     // Material programs. There are only three Material nodes, opaque, cutout opacity and rectangle lights.
     // For the radiance ray type 0:
-    m_mapOfPrograms["closesthit"]       = m_context->createProgramFromPTXFile(ptxPath("closesthit.cu"), "closesthit");
-    m_mapOfPrograms["closesthit_light"] = m_context->createProgramFromPTXFile(ptxPath("closesthit_light.cu"), "closesthit_light");
-    m_mapOfPrograms["anyhit_cutout"]    = m_context->createProgramFromPTXFile(ptxPath("anyhit.cu"), "anyhit_cutout");
+    m_mapOfPrograms["closesthit"]       = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit.cu"), "closesthit");
+    m_mapOfPrograms["closesthit_light"] = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit_light.cu"), "closesthit_light");
+    m_mapOfPrograms["anyhit_cutout"]    = sutil::createProgramFromPTXFile(m_context, ptxPath("anyhit.cu"), "anyhit_cutout");
     // For the shadow ray type 1:
-    m_mapOfPrograms["anyhit_shadow"]        = m_context->createProgramFromPTXFile(ptxPath("anyhit.cu"), "anyhit_shadow");        // Opaque 
-    m_mapOfPrograms["anyhit_shadow_cutout"] = m_context->createProgramFromPTXFile(ptxPath("anyhit.cu"), "anyhit_shadow_cutout"); // Cutout opacity.
+    m_mapOfPrograms["anyhit_shadow"]        = sutil::createProgramFromPTXFile(m_context, ptxPath("anyhit.cu"), "anyhit_shadow");        // Opaque 
+    m_mapOfPrograms["anyhit_shadow_cutout"] = sutil::createProgramFromPTXFile(m_context, ptxPath("anyhit.cu"), "anyhit_shadow_cutout"); // Cutout opacity.
+#if USE_GEOMETRY_PAGING
+    // For both ray types on the bounding boxes of non-resident mesh pages:
+    m_mapOfPrograms["anyhit_page_proxy"]    = sutil::createProgramFromPTXFile(m_context, ptxPath("anyhit.cu"), "anyhit_page_proxy");
+#endif
+
+#if USE_SPECIALIZED_MATERIALS
+    // Closest hit programs with the BSDF inlined, indexed by FunctionIndex.
+    m_mapOfPrograms["closesthit_diffuse_reflection"]               = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit.cu"), "closesthit_diffuse_reflection");
+    m_mapOfPrograms["closesthit_specular_reflection"]              = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit.cu"), "closesthit_specular_reflection");
+    m_mapOfPrograms["closesthit_specular_reflection_transmission"] = sutil::createProgramFromPTXFile(m_context, ptxPath("closesthit.cu"), "closesthit_specular_reflection_transmission");
+#endif
 
     // Now setup all buffers of bindless callable program IDs.
     // These are device side function tables which can be indexed at runtime without recompilation.
 
     // Different lens shader implementations as bindless callable program IDs inside "sysLensShader".
-    m_bufferLensShader = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, 3);
+    m_bufferLensShader = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, 5);
     int* lensShader = (int*) m_bufferLensShader->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
 
     const std::string ptxPathLensShader = ptxPath("lens_shader.cu");
-    optix::Program prg = m_context->createProgramFromPTXFile(ptxPathLensShader, "lens_shader_pinhole");
+    optix::Program prg = sutil::createProgramFromPTXFile(m_context, ptxPathLensShader, "lens_shader_pinhole");
     m_mapOfPrograms["lens_shader_pinhole"] = prg;
     lensShader[LENS_SHADER_PINHOLE] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPathLensShader, "lens_shader_fisheye");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPathLensShader, "lens_shader_fisheye");
     m_mapOfPrograms["lens_shader_fisheye"] = prg;
     lensShader[LENS_SHADER_FISHEYE] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPathLensShader, "lens_shader_sphere");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPathLensShader, "lens_shader_sphere");
     m_mapOfPrograms["lens_shader_sphere"] = prg;
     lensShader[LENS_SHADER_SPHERE] = prg->getId();
+
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPathLensShader, "lens_shader_thin_lens");
+    m_mapOfPrograms["lens_shader_thin_lens"] = prg;
+    lensShader[LENS_SHADER_THIN_LENS] = prg->getId();
+
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPathLensShader, "lens_shader_cubemap");
+    m_mapOfPrograms["lens_shader_cubemap"] = prg;
+    lensShader[LENS_SHADER_CUBEMAP] = prg->getId();
     
     m_bufferLensShader->unmap();
 
     m_context["sysLensShader"]->setBuffer(m_bufferLensShader);
 
+    // The bokeh shape of the thin lens.
+    m_bufferApertureTable = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT2, APERTURE_TABLE_SIZE + 1, APERTURE_TABLE_SIZE + 1);
+    updateApertureTable();
+    m_context["sysApertureTable"]->setBuffer(m_bufferApertureTable);
+
+#if USE_FILTER_IMPORTANCE_SAMPLING
+    // The sub-pixel offsets of the primary rays.
+    m_bufferFilterTable = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, FILTER_TABLE_SIZE + 1);
+    updateFilterTable();
+    m_context["sysFilterTable"]->setBuffer(m_bufferFilterTable);
+#endif
+
     // PERF One possible optimization to reduce the OptiX kernel size even more 
     // is to only download the programs for materials actually present in the scene. Not done in this demo.
 
@@ -1343,15 +4190,15 @@ void Application::initPrograms()
     m_bufferSampleBSDF = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_BSDF_INDICES);
     int* sampleBsdf = (int*) m_bufferSampleBSDF->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_diffuse_reflection.cu"), "sample_bsdf_diffuse_reflection");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_diffuse_reflection.cu"), "sample_bsdf_diffuse_reflection");
     m_mapOfPrograms["sample_bsdf_diffuse_reflection"] = prg;
     sampleBsdf[INDEX_BSDF_DIFFUSE_REFLECTION] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_specular_reflection.cu"), "sample_bsdf_specular_reflection");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_specular_reflection.cu"), "sample_bsdf_specular_reflection");
     m_mapOfPrograms["sample_bsdf_specular_reflection"] = prg;
     sampleBsdf[INDEX_BSDF_SPECULAR_REFLECTION] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_specular_reflection_transmission.cu"), "sample_bsdf_specular_reflection_transmission");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_specular_reflection_transmission.cu"), "sample_bsdf_specular_reflection_transmission");
     m_mapOfPrograms["sample_bsdf_specular_reflection_transmission"] = prg;
     sampleBsdf[INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION] = prg->getId();
 
@@ -1363,11 +4210,11 @@ void Application::initPrograms()
     m_bufferEvalBSDF = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_BSDF_INDICES);
     int* evalBsdf = (int*) m_bufferEvalBSDF->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_diffuse_reflection.cu"), "eval_bsdf_diffuse_reflection");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_diffuse_reflection.cu"), "eval_bsdf_diffuse_reflection");
     m_mapOfPrograms["eval_bsdf_diffuse_reflection"] = prg;
     evalBsdf[INDEX_BSDF_DIFFUSE_REFLECTION] = prg->getId();
 
-    prg = m_context->createProgramFromPTXFile(ptxPath("bsdf_specular_reflection.cu"), "eval_bsdf_specular_reflection");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("bsdf_specular_reflection.cu"), "eval_bsdf_specular_reflection");
     m_mapOfPrograms["eval_bsdf_specular_reflection"] = prg;
     evalBsdf[INDEX_BSDF_SPECULAR_REFLECTION]              = prg->getId(); // All specular evaluation functions just returns float4(0.0f).
     evalBsdf[INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION] = prg->getId(); // Reuse the same program for all specular materials to keep the kernel small.
@@ -1377,12 +4224,13 @@ void Application::initPrograms()
     m_context["sysEvalBSDF"]->setBuffer(m_bufferEvalBSDF);
 
     // Light sampling functions. 
-    // There are only two light types implemented in this renderer: environment lights and parallelogram area lights.
-    m_bufferSampleLight = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, 2);
+    // The light types implemented in this renderer are environment lights, parallelogram area lights and (optionally) emissive triangle meshes.
+    m_bufferSampleLight = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, 3);
     int* sampleLight = (int*) m_bufferSampleLight->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
 
     sampleLight[LIGHT_ENVIRONMENT]   = RT_PROGRAM_ID_NULL;
     sampleLight[LIGHT_PARALLELOGRAM] = RT_PROGRAM_ID_NULL;
+    sampleLight[LIGHT_MESH]          = RT_PROGRAM_ID_NULL;
 
     switch (m_missID)
     {
@@ -1390,22 +4238,28 @@ void Application::initPrograms()
     default:
       break;
     case 1:
-      prg = m_context->createProgramFromPTXFile(ptxPath("light_sample.cu"), "sample_light_constant");
+      prg = sutil::createProgramFromPTXFile(m_context, ptxPath("light_sample.cu"), "sample_light_constant");
       m_mapOfPrograms["sample_light_constant"] = prg;
       sampleLight[LIGHT_ENVIRONMENT] = prg->getId();
       break;
     case 2:
-      prg = m_context->createProgramFromPTXFile(ptxPath("light_sample.cu"), "sample_light_environment");
+      prg = sutil::createProgramFromPTXFile(m_context, ptxPath("light_sample.cu"), "sample_light_environment");
       m_mapOfPrograms["sample_light_environment"] = prg;
       sampleLight[LIGHT_ENVIRONMENT] = prg->getId();
       break;
     }
     
     // PERF Again, to optimize the kernel size this program would only be needed if there are parallelogram lights in the scene.
-    prg = m_context->createProgramFromPTXFile(ptxPath("light_sample.cu"), "sample_light_parallelogram");
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("light_sample.cu"), "sample_light_parallelogram");
     m_mapOfPrograms["sample_light_parallelogram"] = prg;
     sampleLight[LIGHT_PARALLELOGRAM] = prg->getId();
 
+#if USE_MESH_LIGHTS
+    prg = sutil::createProgramFromPTXFile(m_context, ptxPath("light_sample.cu"), "sample_light_mesh");
+    m_mapOfPrograms["sample_light_mesh"] = prg;
+    sampleLight[LIGHT_MESH] = prg->getId();
+#endif
+
     m_bufferSampleLight->unmap();
 
     m_context["sysSampleLight"]->setBuffer(m_bufferSampleLight);
@@ -1416,47 +4270,215 @@ void Application::initPrograms()
   }
 }
 
+void Application::convertMaterialParameter(MaterialParameterGUI const& src, MaterialParameter& dst) const
+{
+  dst.indexBSDF = src.indexBSDF;
+  dst.albedo     = src.albedo;
+  dst.albedoID   = (src.useAlbedoTexture) ? m_textureAlbedo.getId() : RT_TEXTURE_ID_NULL;
+#if USE_VIRTUAL_TEXTURES
+  dst.albedoVirtualID = (src.useAlbedoTexture && m_virtualAlbedo.isValid()) ? 0 : -1;
+#else
+  dst.albedoVirtualID = -1;
+#endif
+  dst.cutoutID   = (src.useCutoutTexture) ? m_textureCutout.getId() : RT_TEXTURE_ID_NULL;
+  dst.albedoLod  = (dst.albedoID != RT_TEXTURE_ID_NULL) ? 0.5f * log2f(float(m_textureAlbedo.getWidth()) * float(m_textureAlbedo.getHeight())) : 0.0f;
+#if USE_STRESS_SCENE
+  if (src.useAlbedoTexture && 0 <= src.albedoTexture)
+  {
+    dst.albedoID        = m_stressTextures[src.albedoTexture]->getId();
+    dst.albedoVirtualID = -1;
+    dst.albedoLod       = log2f(float(STRESS_TEXTURE_SIZE));
+  }
+#endif
+  dst.cutoutLod  = (dst.cutoutID != RT_TEXTURE_ID_NULL) ? 0.5f * log2f(float(m_textureCutout.getWidth()) * float(m_textureCutout.getHeight())) : 0.0f;
+  dst.flags      = (src.thinwalled) ? FLAG_THINWALLED : 0;
+  // Calculate the effective absorption coefficient from the GUI parameters. This is one reason why there are two structures.
+  // Prevent logf(0.0f) which results in infinity.
+  const float x = (0.0f < src.absorptionColor.x) ? -logf(src.absorptionColor.x) : RT_DEFAULT_MAX;
+  const float y = (0.0f < src.absorptionColor.y) ? -logf(src.absorptionColor.y) : RT_DEFAULT_MAX;
+  const float z = (0.0f < src.absorptionColor.z) ? -logf(src.absorptionColor.z) : RT_DEFAULT_MAX;
+  dst.absorption = optix::make_float3(x, y, z) * src.volumeDistanceScale;
+  dst.ior = src.ior;
+  dst.abbe = src.abbe;
+#if USE_HETEROGENEOUS_MEDIA
+  dst.medium = src.medium;
+#else
+  dst.medium = -1;
+#endif
+}
+
 void Application::updateMaterialParameters()
 {
   MY_ASSERT((sizeof(MaterialParameter) & 15) == 0); // Verify float4 alignment.
 
   // Convert the GUI material parameters to the device side structure and upload them into the context global buffer.
-  MaterialParameter* dst = static_cast<MaterialParameter*>(m_bufferMaterialParameters->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  MaterialParameter* dst = static_cast<MaterialParameter*>(m_uploader->stage(m_bufferMaterialParameters, sizeof(MaterialParameter) * m_guiMaterialParameters.size()));
 
+#if USE_INCREMENTAL_MATERIALS
+  m_materialParameters.resize(m_guiMaterialParameters.size());
+  m_materialDirtyFlags.assign(m_guiMaterialParameters.size(), 0);
+  m_materialsDirty.clear();
+
+  for (size_t i = 0; i < m_guiMaterialParameters.size(); ++i)
+  {
+    convertMaterialParameter(m_guiMaterialParameters[i], m_materialParameters[i]);
+  }
+  if (!m_materialParameters.empty())
+  {
+    memcpy(dst, m_materialParameters.data(), sizeof(MaterialParameter) * m_materialParameters.size());
+  }
+#else
   for (size_t i = 0; i < m_guiMaterialParameters.size(); ++i, ++dst)
   {
-    MaterialParameterGUI& src = m_guiMaterialParameters[i];
-        
-    dst->indexBSDF = src.indexBSDF;
-    dst->albedo     = src.albedo;
-    dst->albedoID   = (src.useAlbedoTexture) ? m_textureAlbedo.getId() : RT_TEXTURE_ID_NULL;
-    dst->cutoutID   = (src.useCutoutTexture) ? m_textureCutout.getId() : RT_TEXTURE_ID_NULL;
-    dst->flags      = (src.thinwalled) ? FLAG_THINWALLED : 0;
-    // Calculate the effective absorption coefficient from the GUI parameters. This is one reason why there are two structures.
-    // Prevent logf(0.0f) which results in infinity.
-    const float x = (0.0f < src.absorptionColor.x) ? -logf(src.absorptionColor.x) : RT_DEFAULT_MAX;
-    const float y = (0.0f < src.absorptionColor.y) ? -logf(src.absorptionColor.y) : RT_DEFAULT_MAX;
-    const float z = (0.0f < src.absorptionColor.z) ? -logf(src.absorptionColor.z) : RT_DEFAULT_MAX;
-    dst->absorption = optix::make_float3(x, y, z) * src.volumeDistanceScale;
-    dst->ior = src.ior;
+    convertMaterialParameter(m_guiMaterialParameters[i], *dst);
+  }
+#endif
+
+  m_uploader->flush(); // The next launch reads them.
+#if USE_WEDGE
+  m_wedgeDirty = true;
+#endif
+}
+
+#if USE_INCREMENTAL_MATERIALS
+void Application::markMaterialDirty(const int index)
+{
+  if (!m_materialDirtyFlags[index])
+  {
+    m_materialDirtyFlags[index] = 1;
+    m_materialsDirty.push_back(index);
+  }
+}
+
+// Called once per render(). Converts only the changed materials. On a single device they are scattered into
+// sysMaterialParameters by a launch over the staging buffer. Otherwise, or when most of the materials changed,
+// the host copy is uploaded as a whole, which is still cheaper than converting all materials again.
+void Application::flushMaterialParameters()
+{
+  if (m_materialsDirty.empty())
+  {
+    return;
+  }
+
+  for (size_t i = 0; i < m_materialsDirty.size(); ++i)
+  {
+    const int index = m_materialsDirty[i];
+    convertMaterialParameter(m_guiMaterialParameters[index], m_materialParameters[index]);
+    m_materialDirtyFlags[index] = 0;
+  }
+
+  if (m_materialUpdateKernel && m_materialsDirty.size() * 4 < m_materialParameters.size())
+  {
+    RTsize capacity = 0;
+    m_bufferMaterialUpdates->getSize(capacity);
+    if (capacity < m_materialsDirty.size())
+    {
+      // Grow in powers of two to not resize the staging buffer on every slightly bigger batch.
+      while (capacity < m_materialsDirty.size())
+      {
+        capacity *= 2;
+      }
+      m_bufferMaterialUpdates->setSize(capacity);
+    }
+
+    // Only the used part is mapped for reading on the device, the rest is never written.
+    MaterialUpdate* dst = static_cast<MaterialUpdate*>(m_bufferMaterialUpdates->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    for (size_t i = 0; i < m_materialsDirty.size(); ++i)
+    {
+      dst[i].parameter = m_materialParameters[m_materialsDirty[i]];
+      dst[i].index     = m_materialsDirty[i];
+    }
+    m_bufferMaterialUpdates->unmap();
+
+    m_context->launch(ENTRY_MATERIAL_UPDATE, m_materialsDirty.size());
+  }
+  else
+  {
+    void* dst = m_bufferMaterialParameters->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    memcpy(dst, m_materialParameters.data(), sizeof(MaterialParameter) * m_materialParameters.size());
+    m_bufferMaterialParameters->unmap();
   }
 
-  m_bufferMaterialParameters->unmap();
+  m_materialsDirty.clear();
+#if USE_WEDGE
+  m_wedgeDirty = true; // The variants are rebuilt from the changed GUI materials.
+#endif
 }
+#endif
 
 void Application::initMaterials()
 {
-  Picture* picture = new Picture;
+#if USE_CUTOUT_CLASSIFICATION
+  m_textureCutoutFilename = std::string(sutil::samplesDir()) + "/data/slots_alpha.png";
+#endif
+
+  // The built-in textures don't depend on the scene. They are kept when reloadScene() calls this again.
+  const bool createTextures = !m_textureCutout.getSampler();
+
+#if USE_VIRTUAL_TEXTURES
+  // Builds the tile file next to the image on first use. Only the single tile of the coarsest level is uploaded here.
+  if (createTextures)
+  {
+    m_virtualAlbedo.create(m_context, std::string(sutil::samplesDir()) + "/data/NVIDIA_logo.jpg");
+    try
+    {
+      m_bufferVirtualTextures = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+      m_bufferVirtualTextures->setElementSize(sizeof(VirtualTextureDescription));
+      m_bufferVirtualTextures->setSize(1);
+      memcpy(m_bufferVirtualTextures->map(0, RT_BUFFER_MAP_WRITE_DISCARD), &m_virtualAlbedo.getDescription(), sizeof(VirtualTextureDescription));
+      m_bufferVirtualTextures->unmap();
+      m_context["sysVirtualTextures"]->setBuffer(m_bufferVirtualTextures);
+    }
+    catch(optix::Exception& e)
+    {
+      std::cerr << e.getErrorString() << std::endl;
+    }
+  }
+#endif
+
+  // All images the scene needs are decoded concurrently. The environment is created later by createLights(),
+  // its PictureCache::acquire() returns the Picture decoded here.
+  std::vector<PictureRequest> requests;
+
+#if USE_ASYNC_TEXTURES
+  // The image files are decoded in the background while the scene and its accelerations are built.
+  if (createTextures)
+  {
+#if !USE_VIRTUAL_TEXTURES
+    m_textureAlbedo.createSamplerAsync(m_context, std::string(sutil::samplesDir()) + "/data/NVIDIA_logo.jpg", false, (USE_RAY_CONES == 1), (USE_COMPRESSED_TEXTURES == 1));
+#endif
+    m_textureCutout.createSamplerAsync(m_context, std::string(sutil::samplesDir()) + "/data/slots_alpha.png");
+  }
+#else
+  if (createTextures)
+  {
+#if !USE_VIRTUAL_TEXTURES
+    requests.push_back(PictureRequest(std::string(sutil::samplesDir()) + "/data/NVIDIA_logo.jpg", (USE_COMPRESSED_TEXTURES == 1), (USE_COMPRESSED_TEXTURES == 1)));
+#endif
+    // The cutout texture stays uncompressed, the opacity threshold is sensitive to block artifacts.
+    requests.push_back(PictureRequest(std::string(sutil::samplesDir()) + "/data/slots_alpha.png"));
+  }
+#endif
 
-  std::string textureFilename = std::string(sutil::samplesDir()) + "/data/NVIDIA_logo.jpg";
-  picture->load(textureFilename);
-  m_textureAlbedo.createSampler(m_context, picture);
+  if (m_missID == 2)
+  {
+    requests.push_back(PictureRequest(m_environmentFilename));
+  }
 
-  textureFilename = std::string(sutil::samplesDir()) + "/data/slots_alpha.png";
-  picture->load(textureFilename);
-  m_textureCutout.createSampler(m_context, picture);
+  std::vector< std::shared_ptr<const Picture> > pictures;
+  PictureCache::acquireBatch(requests, pictures);
 
-  delete picture;
+#if !USE_ASYNC_TEXTURES
+  // The textures are created from the results in request order.
+  if (createTextures)
+  {
+    size_t indexPicture = 0;
+#if !USE_VIRTUAL_TEXTURES
+    m_textureAlbedo.createSampler(m_context, pictures[indexPicture++].get(), false, (USE_RAY_CONES == 1)); // The ray cones select the mipmap level.
+#endif
+    m_textureCutout.createSampler(m_context, pictures[indexPicture++].get());
+  }
+#endif
 
   // Setup GUI material parameters, one for each of the implemented BSDFs.
   // Cutout opacity is not an option which can be switched dynamically in this demo.
@@ -1477,6 +4499,13 @@ void Application::initMaterials()
   parameters.absorptionColor     = optix::make_float3(1.0f);
   parameters.volumeDistanceScale = 1.0f;
   parameters.ior                 = 1.5f;
+  parameters.abbe                = 0.0f;
+#if USE_STRESS_SCENE
+  parameters.albedoTexture       = -1; // All built-in materials use the m_textureAlbedo.
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+  parameters.medium              = -1; // initMedia() assigns the media after the scene is built.
+#endif
   m_guiMaterialParameters.push_back(parameters); // 0
 
   // Lambert material with cutout opacity.
@@ -1488,6 +4517,7 @@ void Application::initMaterials()
   parameters.absorptionColor     = optix::make_float3(0.25f);
   parameters.volumeDistanceScale = 1.0f;
   parameters.ior                 = 1.5f;
+  parameters.abbe                = 0.0f;
   m_guiMaterialParameters.push_back(parameters); // 1
 
   // Water material.
@@ -1499,6 +4529,7 @@ void Application::initMaterials()
   parameters.absorptionColor     = optix::make_float3(0.980392f, 0.729412f, 0.470588f); // My favorite test color.
   parameters.volumeDistanceScale = 1.0f;
   parameters.ior                 = 1.33f; // Water
+  parameters.abbe                = 55.7f; // Water disperses only weakly. Only visible with --spectral.
   m_guiMaterialParameters.push_back(parameters); // 2
 
   // Tinted mirror material.
@@ -1510,11 +4541,27 @@ void Application::initMaterials()
   parameters.absorptionColor     = optix::make_float3(0.6f, 0.6f, 0.8f);
   parameters.volumeDistanceScale = 1.0f;
   parameters.ior                 = 1.33f;
+  parameters.abbe                = 0.0f;
   m_guiMaterialParameters.push_back(parameters); // 3
+
+#if USE_STRESS_SCENE
+  if (0 < m_stress.instances)
+  {
+    createStressMaterials(); // Appended behind the built-in ones.
+  }
+#endif
     
   try
   {
+#if USE_INCREMENTAL_MATERIALS
+    // Device side writes into an RT_BUFFER_INPUT_OUTPUT buffer only stay in device memory on a single device.
+    // With multiple devices such buffers reside in host memory, which would slow down every material lookup.
+    m_materialUpdateKernel = (m_context->getEnabledDeviceCount() == 1);
+
+    m_bufferMaterialParameters = m_context->createBuffer((m_materialUpdateKernel) ? RT_BUFFER_INPUT_OUTPUT : RT_BUFFER_INPUT, RT_FORMAT_USER);
+#else
     m_bufferMaterialParameters = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+#endif
     m_bufferMaterialParameters->setElementSize(sizeof(MaterialParameter));
     m_bufferMaterialParameters->setSize(m_guiMaterialParameters.size()); // As many as there are in the GUI.
 
@@ -1522,6 +4569,22 @@ void Application::initMaterials()
 
     m_context["sysMaterialParameters"]->setBuffer(m_bufferMaterialParameters);
 
+#if USE_INCREMENTAL_MATERIALS
+    MY_ASSERT((sizeof(MaterialUpdate) & 15) == 0);
+
+    m_bufferMaterialUpdates = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+    m_bufferMaterialUpdates->setElementSize(sizeof(MaterialUpdate));
+    m_bufferMaterialUpdates->setSize(16); // Grows with the number of materials changed in one frame.
+    m_context["sysMaterialUpdates"]->setBuffer(m_bufferMaterialUpdates);
+
+    std::map<std::string, optix::Program>::const_iterator itUpdate = m_mapOfPrograms.find("material_update");
+    MY_ASSERT(itUpdate != m_mapOfPrograms.end()); 
+    m_context->setRayGenerationProgram(ENTRY_MATERIAL_UPDATE, itUpdate->second);
+#if USE_WEDGE
+    itUpdate->second["sysMaterialParameters"]->setBuffer(m_bufferMaterialParameters); // The context variable can point to the wedge variants.
+#endif
+#endif
+
     // Create the three main Material nodes to have the matching closest hit and any hit programs.
 
     std::map<std::string, optix::Program>::const_iterator it;
@@ -1549,6 +4612,9 @@ void Application::initMaterials()
     it = m_mapOfPrograms.find("anyhit_shadow_cutout");
     MY_ASSERT(it != m_mapOfPrograms.end());
     m_cutoutMaterial->setAnyHitProgram(1, it->second); // raytype shadow
+#if USE_CUTOUT_CLASSIFICATION
+    m_cutoutMaterial["parCutoutStates"]->setInt(RT_BUFFER_ID_NULL); // Default for GeometryInstances without classification.
+#endif
 
     // Used for all geometric lights.
     m_lightMaterial = m_context->createMaterial();
@@ -1559,6 +4625,37 @@ void Application::initMaterials()
     it = m_mapOfPrograms.find("anyhit_shadow"); // Paralellogram area lights are opaque and throw shadows from other lights.
     MY_ASSERT(it != m_mapOfPrograms.end()); 
     m_lightMaterial->setAnyHitProgram(1, it->second); // raytype shadow
+
+#if USE_SPECIALIZED_MATERIALS
+    // One Material per material parameter index with the any hit programs of the opaque or cutout Material above.
+    // Changing the BSDF only exchanges the closest hit program, the GeometryInstances keep their Material.
+    m_materials.resize(m_guiMaterialParameters.size());
+
+    for (size_t i = 0; i < m_guiMaterialParameters.size(); ++i)
+    {
+      m_materials[i] = m_context->createMaterial();
+
+      if (m_guiMaterialParameters[i].useCutoutTexture)
+      {
+        it = m_mapOfPrograms.find("anyhit_cutout");
+        MY_ASSERT(it != m_mapOfPrograms.end());
+        m_materials[i]->setAnyHitProgram(0, it->second); // raytype radiance
+#if USE_CUTOUT_CLASSIFICATION
+        m_materials[i]["parCutoutStates"]->setInt(RT_BUFFER_ID_NULL);
+#endif
+
+        it = m_mapOfPrograms.find("anyhit_shadow_cutout");
+      }
+      else
+      {
+        it = m_mapOfPrograms.find("anyhit_shadow");
+      }
+      MY_ASSERT(it != m_mapOfPrograms.end());
+      m_materials[i]->setAnyHitProgram(1, it->second); // raytype shadow
+
+      updateMaterialBSDF(int(i));
+    }
+#endif
   }
   catch(optix::Exception& e)
   {
@@ -1567,15 +4664,48 @@ void Application::initMaterials()
 }
 
 
+// Returns the Material for the GeometryInstances using the material parameters at that index.
+optix::Material Application::getMaterial(const int index) const
+{
+#if USE_SPECIALIZED_MATERIALS
+  return m_materials[index];
+#else
+  return (m_guiMaterialParameters[index].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial;
+#endif
+}
+
+#if USE_SPECIALIZED_MATERIALS
+// Sets the closest hit program matching the current BSDF of the material parameters at that index.
+void Application::updateMaterialBSDF(const int index)
+{
+  static const char* names[NUMBER_OF_BSDF_INDICES] =
+  {
+    "closesthit_diffuse_reflection",              // INDEX_BSDF_DIFFUSE_REFLECTION
+    "closesthit_specular_reflection",             // INDEX_BSDF_SPECULAR_REFLECTION
+    "closesthit_specular_reflection_transmission" // INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION
+  };
+
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find(names[m_guiMaterialParameters[index].indexBSDF]);
+  MY_ASSERT(it != m_mapOfPrograms.end());
+  m_materials[index]->setClosestHitProgram(0, it->second); // raytype radiance
+}
+#endif
+
+
 // Scene testing all materials on a single geometry instanced via transforms and sharing one acceleration structure.
 void Application::createScene()
 {
+  SUTIL_NVTX_RANGE("createScene");
+
+#if USE_STRESS_SCENE
+  parseStressConfig(m_stressScene); // The materials depend on it.
+#endif
   initMaterials();
 
   try
   {
     // OptiX Scene Graph construction.
-    m_rootAcceleration = m_context->createAcceleration(m_builder); // No need to set acceleration properties on the top level Acceleration.
+    m_rootAcceleration = createAcceleration(0, ACCELERATION_TOP_LEVEL); // The builder is selected when the number of children is known.
 
     m_rootGroup = m_context->createGroup(); // The scene's root group nodes becomes the sysTopObject.
     m_rootGroup->setAcceleration(m_rootAcceleration);
@@ -1584,6 +4714,42 @@ void Application::createScene()
 
     unsigned int count;
 
+#if USE_STRESS_SCENE
+    if (0 < m_stress.instances)
+    {
+      createStressScene();
+      if (m_flatten)
+      {
+        flattenStaticInstances();
+      }
+      createLights();
+      return;
+    }
+#endif
+
+    if (!m_sceneFilename.empty())
+    {
+      // Replace the demo objects with the mesh instances from the scene description.
+      if (loadSceneDescription(m_sceneFilename))
+      {
+        bool flatten = m_flatten;
+#if USE_GEOMETRY_PAGING
+        flatten = flatten && m_geometryPages.empty(); // The paged GeometryGroups exchange their children.
+#endif
+#if USE_MESH_LOD
+        flatten = flatten && m_lodInstances.empty(); // The level of detail Transforms exchange their children.
+#endif
+        if (flatten)
+        {
+          flattenStaticInstances();
+        }
+        createLights();
+        return;
+      }
+      std::cerr << "Falling back to the demo scene." << std::endl;
+      m_rootGroup->setChildCount(0); // Drop the instances from before the error.
+    }
+
     // Demo code only!
     // Mind that these local OptiX objects will leak when not cleaning up the scene properly on changes.
     // Destroying the OptiX context will clean them up at program exit though.
@@ -1592,13 +4758,12 @@ void Application::createScene()
     optix::Geometry geoPlane = createPlane(1, 1, 1);
 
     optix::GeometryInstance giPlane = m_context->createGeometryInstance(); // This connects Geometries with Materials.
-    giPlane->setGeometry(geoPlane);
+    setInstanceGeometry(giPlane, geoPlane);
     giPlane->setMaterialCount(1);
-    giPlane->setMaterial(0, (m_guiMaterialParameters[0].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
+    giPlane->setMaterial(0, getMaterial(0));
     giPlane["parMaterialIndex"]->setInt(0); // This is all! This defines which material parameters in sysMaterialParameters to use.
 
-    optix::Acceleration accPlane = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accPlane);
+    optix::Acceleration accPlane = createAcceleration(geoPlane->getPrimitiveCount(), ACCELERATION_STATIC);
     
     optix::GeometryGroup ggPlane = m_context->createGeometryGroup(); // This connects GeometryInstances with Acceleration structures. (All OptiX nodes with "Group" in the name hold an Acceleration.)
     ggPlane->setAcceleration(accPlane);
@@ -1627,13 +4792,12 @@ void Application::createScene()
     optix::Geometry geoBox = createBox();
 
     optix::GeometryInstance giBox = m_context->createGeometryInstance();
-    giBox->setGeometry(geoBox);
+    setInstanceGeometry(giBox, geoBox);
     giBox->setMaterialCount(1);
-    giBox->setMaterial(0, (m_guiMaterialParameters[1].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
+    giBox->setMaterial(0, getMaterial(1));
     giBox["parMaterialIndex"]->setInt(1); // This one has cutout opacity.
 
-    optix::Acceleration accBox = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accBox);
+    optix::Acceleration accBox = createAcceleration(geoBox->getPrimitiveCount(), ACCELERATION_STATIC);
     
     optix::GeometryGroup ggBox = m_context->createGeometryGroup();
     ggBox->setAcceleration(accBox);
@@ -1661,13 +4825,12 @@ void Application::createScene()
     optix::Geometry geoSphere = createSphere(180, 90, 1.0f, M_PIf);
 
     optix::GeometryInstance giSphere = m_context->createGeometryInstance();
-    giSphere->setGeometry(geoSphere);
+    setInstanceGeometry(giSphere, geoSphere);
     giSphere->setMaterialCount(1);
-    giSphere->setMaterial(0, (m_guiMaterialParameters[2].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
+    giSphere->setMaterial(0, getMaterial(2));
     giSphere["parMaterialIndex"]->setInt(2); // Water material.
 
-    optix::Acceleration accSphere = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accSphere);
+    optix::Acceleration accSphere = createAcceleration(geoSphere->getPrimitiveCount(), ACCELERATION_STATIC);
     
     optix::GeometryGroup ggSphere = m_context->createGeometryGroup();
     ggSphere->setAcceleration(accSphere);
@@ -1713,13 +4876,12 @@ void Application::createScene()
     optix::Geometry geoTorus = createTorus(180, 180, 0.75f, 0.25f);
 
     optix::GeometryInstance giTorus = m_context->createGeometryInstance();
-    giTorus->setGeometry(geoTorus);
+    setInstanceGeometry(giTorus, geoTorus);
     giTorus->setMaterialCount(1);
-    giTorus->setMaterial(0, (m_guiMaterialParameters[3].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
+    giTorus->setMaterial(0, getMaterial(3));
     giTorus["parMaterialIndex"]->setInt(3); // Using parameters in sysMaterialParameters[4].
 
-    optix::Acceleration accTorus = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accTorus);
+    optix::Acceleration accTorus = createAcceleration(geoTorus->getPrimitiveCount(), ACCELERATION_STATIC);
     
     optix::GeometryGroup ggTorus = m_context->createGeometryGroup();
     ggTorus->setAcceleration(accTorus);
@@ -1768,6 +4930,11 @@ void Application::createScene()
     m_rootGroup->setChildCount(count + 1);
     m_rootGroup->setChild(count, trTorus);
 
+    if (m_flatten)
+    {
+      flattenStaticInstances(); // Before createLights(), the area light is in world space already.
+    }
+
     createLights(); // Put lights into the scene.
   }
   catch(optix::Exception& e)
@@ -1777,17 +4944,46 @@ void Application::createScene()
 }
 
 
+// The builder argument overrides the selectBuilder() policy, empty == select by the number of primitives and the usage.
+optix::Acceleration Application::createAcceleration(const unsigned int numPrimitives, const AccelerationUsage usage, std::string const& builder)
+{
+#if USE_ACCELERATION_POLICY
+  optix::Acceleration acceleration = m_context->createAcceleration((builder.empty()) ? selectBuilder(numPrimitives, usage) : builder);
+  if (!builder.empty())
+  {
+    m_fixedBuilders.insert(acceleration->get());
+  }
+#else
+  optix::Acceleration acceleration = m_context->createAcceleration((builder.empty()) ? m_builder : builder);
+#endif
+
+  if (usage != ACCELERATION_TOP_LEVEL) // No need to set acceleration properties on the top level Acceleration.
+  {
+    setAccelerationProperties(acceleration);
+  }
+  return acceleration;
+}
+
+
 void Application::setAccelerationProperties(optix::Acceleration acceleration)
 {
   // To speed up the acceleration structure build for triangles, skip calls to the bounding box program and
   // invoke the special splitting BVH builder for indexed triangles by setting the necessary acceleration properties.
   // Using the fast Trbvh builder which does splitting has a positive effect on the rendering performanc as well!
-  if (m_builder == std::string("Trbvh") || m_builder == std::string("Sbvh"))
+  const std::string builder = acceleration->getBuilder();
+  if (builder == std::string("Trbvh") || builder == std::string("Sbvh"))
   {
+#if USE_COMPACT_ATTRIBUTES
+    // Tightly packed float x,y,z positions.
+    acceleration->setProperty("vertex_buffer_name", "positionsBuffer");
+    MY_ASSERT(sizeof(optix::float3) == 12) ;
+    acceleration->setProperty("vertex_buffer_stride", "12");
+#else
     // This requires that the position is the first element and it must be float x,y,z.
     acceleration->setProperty("vertex_buffer_name", "attributesBuffer");
     MY_ASSERT(sizeof(VertexAttributes) == 48) ;
     acceleration->setProperty("vertex_buffer_stride", "48");
+#endif
 
     acceleration->setProperty("index_buffer_name", "indicesBuffer");
     MY_ASSERT(sizeof(optix::uint3) == 12) ;
@@ -1796,6 +4992,53 @@ void Application::setAccelerationProperties(optix::Acceleration acceleration)
 }
 
 
+void Application::setInstanceGeometry(optix::GeometryInstance instance, optix::Geometry geometry)
+{
+#if OPTIX_VERSION >= 60000
+  if (m_geometryTriangles)
+  {
+    std::map<RTgeometry, optix::GeometryTriangles>::const_iterator itTriangles = m_mapOfGeometryTriangles.find(geometry->get());
+    if (itTriangles != m_mapOfGeometryTriangles.end())
+    {
+      instance->setGeometryTriangles(itTriangles->second);
+      return;
+    }
+
+    // Reuse the buffers of the custom primitive geometry. Only the attribute program is different.
+    optix::Buffer indicesBuffer    = geometry["indicesBuffer"]->getBuffer();
+    optix::Buffer attributesBuffer = geometry["attributesBuffer"]->getBuffer();
+
+    RTsize numVertices = 0;
+    attributesBuffer->getSize(numVertices);
+
+    optix::GeometryTriangles triangles = m_context->createGeometryTriangles();
+
+    triangles->setPrimitiveCount(geometry->getPrimitiveCount());
+    triangles->setTriangleIndices(indicesBuffer, RT_FORMAT_UNSIGNED_INT3);
+#if USE_COMPACT_ATTRIBUTES
+    optix::Buffer positionsBuffer = geometry["positionsBuffer"]->getBuffer();
+    triangles->setVertices((unsigned int) numVertices, positionsBuffer, RT_FORMAT_FLOAT3);
+    triangles["positionsBuffer"]->setBuffer(positionsBuffer);
+#else
+    triangles->setVertices((unsigned int) numVertices, attributesBuffer, 0, sizeof(VertexAttributes), RT_FORMAT_FLOAT3); // The vertex is the first element.
+#endif
+    triangles["attributesBuffer"]->setBuffer(attributesBuffer);
+    triangles["indicesBuffer"]->setBuffer(indicesBuffer);
+
+    std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("attribute_triangle_indexed");
+    MY_ASSERT(it != m_mapOfPrograms.end()); 
+    triangles->setAttributeProgram(it->second);
+
+    m_mapOfGeometryTriangles[geometry->get()] = triangles;
+
+    instance->setGeometryTriangles(triangles);
+    return;
+  }
+#endif
+  instance->setGeometry(geometry);
+}
+
+
 void Application::createLights()
 {
   LightDefinition light;
@@ -1812,6 +5055,15 @@ void Application::createLights()
   light.environmentIntegral  = 1.0f;
   light.idEnvironmentCDF_U   = RT_BUFFER_ID_NULL;
   light.idEnvironmentCDF_V   = RT_BUFFER_ID_NULL;
+  light.idEnvironmentAlias   = RT_BUFFER_ID_NULL;
+  light.pdfSelection         = 1.0f; // Set in buildLightAliasTable().
+#if USE_CUBEMAP_ENVIRONMENT
+  light.environmentSize      = 0;
+#endif
+#if USE_MESH_LIGHTS
+  light.idMeshTriangles      = RT_BUFFER_ID_NULL;
+  light.idMeshAlias          = RT_BUFFER_ID_NULL;
+#endif
 
   // The environment light is expected in sysLightDefinitions[0]!
   // All other lights are indexed by their position inside the array.
@@ -1830,12 +5082,10 @@ void Application::createLights()
 
   case 2: // HDR Environment mapping with loaded texture.
     {
-      Picture* picture = new Picture; // Separating image file handling from OptiX texture handling.
-      picture->load(m_environmentFilename);
-
-      m_environmentTexture.createEnvironment(picture);
+      // Separating image file handling from OptiX texture handling.
+      std::shared_ptr<const Picture> picture = PictureCache::acquire(m_environmentFilename);
 
-      delete picture;
+      m_environmentTexture.createEnvironment(picture.get());
   
       // Generate the CDFs for direct environment lighting and the environment texture sampler itself.
       m_environmentTexture.calculateCDF(m_context);
@@ -1846,8 +5096,13 @@ void Application::createLights()
 
     // Set the bindless texture and buffer IDs inside the LightDefinition.
     light.idEnvironmentTexture = m_environmentTexture.getId();
+#if USE_CUBEMAP_ENVIRONMENT
+    light.environmentSize      = m_environmentTexture.getWidth(); // The cubemap face size. There are no CDFs.
+#else
     light.idEnvironmentCDF_U   = m_environmentTexture.getBufferCDF_U()->getId();
     light.idEnvironmentCDF_V   = m_environmentTexture.getBufferCDF_V()->getId();
+#endif
+    light.idEnvironmentAlias   = m_environmentTexture.getBufferAlias()->getId();
     light.environmentIntegral  = m_environmentTexture.getIntegral(); // DAR PERF Could bake the factor 2.0f * M_PIf * M_PIf into the sysEnvironmentIntegral here.
 
     m_lightDefinitions.push_back(light);
@@ -1868,29 +5123,21 @@ void Application::createLights()
     int lightIndex = int(m_lightDefinitions.size()); // This becomes this light's parLightIndex value.
     m_lightDefinitions.push_back(light);
 
-    // Create the actual area light geometry in the scene. This creates just two triangles, because I do not want to have another intersection routine for code size and performance reasons.
-    optix::Geometry geoLight = createParallelogram(light.position, light.vecU, light.vecV, light.normal);
-
-    optix::GeometryInstance giLight = m_context->createGeometryInstance(); // This connects Geometries with Materials.
-    giLight->setGeometry(geoLight);
-    giLight->setMaterialCount(1);
-    giLight->setMaterial(0, m_lightMaterial);
-    giLight["parLightIndex"]->setInt(lightIndex);
+    createLightGeometry(light, lightIndex);
+  }
 
-    optix::Acceleration accLight = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accLight);
-    
-    optix::GeometryGroup ggLight = m_context->createGeometryGroup(); // This connects GeometryInstances with Acceleration structures. (All OptiX nodes with "Group" in the name hold an Acceleration.)
-    ggLight->setAcceleration(accLight);
-    ggLight->setChildCount(1);
-    ggLight->setChild(0, giLight);
-
-    // Area lights are defined in world space just to make sampling simpler in this demo. 
-    // Attach it directly to the scene's root node directly.
-    unsigned int count = m_rootGroup->getChildCount();
-    m_rootGroup->setChildCount(count + 1);
-    m_rootGroup->setChild(count, ggLight);
+#if USE_STRESS_SCENE
+  if (0 < m_stress.instances)
+  {
+    createStressLights();
   }
+#endif
+
+#if USE_MESH_LIGHTS
+  createMeshLights();
+#endif
+
+  buildLightAliasTable(); // Sets the pdfSelection fields.
 
   // Put the light definitions into the sysLightDefinitions buffer.
   MY_ASSERT((sizeof(LightDefinition) & 15) == 0); // Check alignment to float4
@@ -1911,3 +5158,158 @@ void Application::createLights()
   m_context["sysNumLights"]->setInt(int(m_lightDefinitions.size())); // PERF Used often and faster to read than sysLightDefinitions.size().
 }
 
+void Application::createLightGeometry(LightDefinition const& light, const int lightIndex)
+{
+  // Create the actual area light geometry in the scene. This creates just two triangles, because I do not want to have another intersection routine for code size and performance reasons.
+  optix::Geometry geoLight = createParallelogram(light.position, light.vecU, light.vecV, light.normal);
+
+  optix::GeometryInstance giLight = m_context->createGeometryInstance(); // This connects Geometries with Materials.
+  setInstanceGeometry(giLight, geoLight);
+  giLight->setMaterialCount(1);
+  giLight->setMaterial(0, m_lightMaterial);
+  giLight["parLightIndex"]->setInt(lightIndex);
+
+  optix::Acceleration accLight = createAcceleration(geoLight->getPrimitiveCount(), ACCELERATION_STATIC);
+  
+  optix::GeometryGroup ggLight = m_context->createGeometryGroup(); // This connects GeometryInstances with Acceleration structures. (All OptiX nodes with "Group" in the name hold an Acceleration.)
+  ggLight->setAcceleration(accLight);
+  ggLight->setChildCount(1);
+  ggLight->setChild(0, giLight);
+
+  // Area lights are defined in world space just to make sampling simpler in this demo. 
+  // Attach it directly to the scene's root node directly.
+  unsigned int count = m_rootGroup->getChildCount();
+  m_rootGroup->setChildCount(count + 1);
+  m_rootGroup->setChild(count, ggLight);
+}
+
+
+// The environment is rotated around the world up-axis. m_environmentRotation in the range [0, 1] is one full turn.
+// The miss program transforms world directions into environment space, the light sample transforms back with the transpose.
+void Application::updateEnvironmentMatrix()
+{
+  const float angle    = m_environmentRotation * 2.0f * M_PIf;
+  const float cosAngle = cosf(angle);
+  const float sinAngle = sinf(angle);
+
+  // Row-major. Adds the angle to the azimuth atan2f(x, -z) of the lat-long mapping.
+  const float matrix[9] =
+  {
+    cosAngle, 0.0f, -sinAngle,
+    0.0f,     1.0f,  0.0f,
+    sinAngle, 0.0f,  cosAngle
+  };
+
+  m_context["sysEnvironmentMatrix"]->setMatrix3x3fv(false, matrix);
+}
+
+#if USE_GPU_ENVIRONMENT_CDF
+// The environment light sampling distribution is calculated with launches, which need the complete scene.
+// Update the environment integral in the LightDefinition afterwards.
+void Application::initEnvironmentDistribution()
+{
+  try
+  {
+    if (!m_environmentTexture.calculateCDFDevice(m_context) || m_lightDefinitions.empty())
+    {
+      return;
+    }
+
+    m_lightDefinitions[0].environmentIntegral = m_environmentTexture.getIntegral(); // The environment light is always the first entry.
+
+    buildLightAliasTable(); // The environment's selection probability depends on the integral.
+
+    void* dst = m_bufferLightDefinitions->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    memcpy(dst, m_lightDefinitions.data(), sizeof(LightDefinition) * m_lightDefinitions.size());
+    m_bufferLightDefinitions->unmap();
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+#endif
+
+
+// Light-type-aware selection for the next event estimation with an alias table, O(1) per sample.
+// Each light is weighted by the radiance it delivers integrated over the solid angle it covers, as seen from the camera's
+// center of interest without occlusion. For the environment light that is its integral over the sphere, for a
+// parallelogram its radiance times its projected solid angle. Both are comparable estimates of the irradiance there.
+// A mesh light faces all directions, its average projected area is a quarter of its surface area (Cauchy).
+// Call again whenever the emission of a light changes. Only the pdfSelection fields change, the caller uploads them.
+void Application::buildLightAliasTable()
+{
+  const int numLights = int(m_lightDefinitions.size());
+
+  std::vector<float> weights(numLights, 0.0f);
+
+  const optix::float3 center = m_pinholeCamera.m_center;
+
+  float sum = 0.0f;
+  for (int i = 0; i < numLights; ++i)
+  {
+    LightDefinition const& light = m_lightDefinitions[i];
+    if (light.type == LIGHT_ENVIRONMENT)
+    {
+      // The constant environment emits white without an integral of its own.
+      weights[i] = (light.idEnvironmentTexture != RT_TEXTURE_ID_NULL) ? light.environmentIntegral : 4.0f * M_PIf;
+    }
+#if USE_MESH_LIGHTS
+    else if (light.type == LIGHT_MESH)
+    {
+      const optix::float3 toLight    = light.position - center; // The area weighted centroid.
+      const float         distance   = std::max(optix::length(toLight), 1.0e-6f);
+      const float         solidAngle = std::min(0.25f * light.area / (distance * distance), 4.0f * M_PIf);
+
+      weights[i] = (light.emission.x + light.emission.y + light.emission.z) / 3.0f * solidAngle;
+    }
+#endif
+    else // LIGHT_PARALLELOGRAM
+    {
+      const optix::float3 toLight  = light.position + 0.5f * (light.vecU + light.vecV) - center;
+      const float         distance = std::max(optix::length(toLight), 1.0e-6f);
+      const float         cosLight = std::max(0.0f, -optix::dot(light.normal, toLight) / distance); // One-sided emission.
+      const float         solidAngle = std::min(light.area * cosLight / (distance * distance), 2.0f * M_PIf);
+
+      weights[i] = (light.emission.x + light.emission.y + light.emission.z) / 3.0f * solidAngle; // intensity() in the shaders.
+    }
+    sum += weights[i];
+  }
+
+  for (int i = 0; i < numLights; ++i)
+  {
+    const float uniform = 1.0f / float(numLights);
+
+    weights[i] = (0.0f < sum) ? (1.0f - LIGHT_SELECTION_UNIFORM) * weights[i] / sum + LIGHT_SELECTION_UNIFORM * uniform : uniform;
+
+    m_lightDefinitions[i].pdfSelection = weights[i];
+  }
+
+  std::vector<float>        threshold;
+  std::vector<unsigned int> alias;
+  buildAliasTable(weights, threshold, alias);
+
+  std::vector<LightAlias> table(numLights);
+  for (int i = 0; i < numLights; ++i)
+  {
+    table[i].threshold = threshold[i];
+    table[i].alias     = int(alias[i]);
+  }
+
+  if (!m_bufferLightAliasTable) // Rebuilt when the GUI changes the light emissions.
+  {
+    m_bufferLightAliasTable = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+    m_bufferLightAliasTable->setElementSize(sizeof(LightAlias));
+  }
+  m_bufferLightAliasTable->setSize(table.size()); // This can be zero.
+
+  if (!table.empty())
+  {
+    void* dst = m_bufferLightAliasTable->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    memcpy(dst, table.data(), sizeof(LightAlias) * table.size());
+    m_bufferLightAliasTable->unmap();
+  }
+
+  m_context["sysLightAliasTable"]->setBuffer(m_bufferLightAliasTable);
+}
+
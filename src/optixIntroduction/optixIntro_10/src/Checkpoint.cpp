@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_CHECKPOINTS
+
+#include <NvtxRange.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// A checkpoint file is a CheckpointHeader followed by the layers of getCheckpointLayers(),
+// each one as its unsigned int element size in bytes and the width * height elements.
+//
+// The random numbers of a pixel only depend on its launch index and the iteration index,
+// so continuing the running mean at the stored iteration index renders the same samples an uninterrupted run would have.
+// The hash covers everything which changes the image, so a checkpoint of other settings is never continued.
+
+#define CHECKPOINT_VERSION 1
+
+namespace
+{
+  struct CheckpointHeader
+  {
+    char               magic[4]; // "OCKP"
+    unsigned int       version;
+    unsigned long long hash;
+    int                width;
+    int                height;
+    int                iterationIndex;
+    unsigned int       layers;
+  };
+
+  // 64-bit FNV-1a over the raw bytes of the values.
+  class CheckpointHash
+  {
+  public:
+    CheckpointHash()
+    : m_hash(14695981039346656037ull)
+    {
+    }
+
+    void add(const void* data, const size_t size)
+    {
+      const unsigned char* bytes = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < size; ++i)
+      {
+        m_hash = (m_hash ^ bytes[i]) * 1099511628211ull;
+      }
+    }
+
+    template<typename T>
+    void add(T const& value)
+    {
+      add(&value, sizeof(T));
+    }
+
+    void add(std::string const& value)
+    {
+      add(value.c_str(), value.size() + 1); // Including the terminator to separate consecutive strings.
+    }
+
+    unsigned long long get() const
+    {
+      return m_hash;
+    }
+
+  private:
+    unsigned long long m_hash;
+  };
+}
+
+
+void Application::setCheckpoint(std::string const& filename, const double interval, const bool resume)
+{
+  m_checkpointFilename = filename;
+  m_checkpointInterval = interval;
+  m_checkpointResume   = resume && !filename.empty();
+}
+
+// The buffers which hold the accumulation state. All have the launch dimension.
+void Application::getCheckpointLayers(std::vector<optix::Buffer>& layers) const
+{
+  layers.clear();
+  layers.push_back(m_bufferOutput);
+#if USE_DENOISER && USE_DENOISER_ALBEDO
+  if (m_useDenoiserAlbedo)
+  {
+    layers.push_back(m_bufferAlbedo);
+  }
+#if USE_DENOISER_NORMAL
+  if (m_useDenoiserNormal)
+  {
+    layers.push_back(m_bufferNormals);
+  }
+#endif
+#endif
+#if USE_ADAPTIVE_SAMPLING
+  layers.push_back(m_bufferMoment); // The convergence is recalculated from it after resuming.
+#endif
+}
+
+unsigned long long Application::getCheckpointHash() const
+{
+  CheckpointHash hash;
+
+  hash.add(m_width);
+  hash.add(m_height);
+
+  hash.add(m_sceneFilename);
+#if USE_STRESS_SCENE
+  hash.add(m_stressScene);
+#endif
+  hash.add(m_environmentFilename);
+  hash.add(m_light);
+  hash.add(m_missID);
+  hash.add(m_environmentRotation);
+  hash.add(m_flatten);
+#if USE_MESH_LOD
+  hash.add(m_lodError);
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+  for (size_t i = 0; i < m_mediumConfigs.size(); ++i)
+  {
+    hash.add(m_mediumConfigs[i].material);
+    hash.add(m_mediumConfigs[i].filename);
+  }
+  for (size_t i = 0; i < m_mediumDefinitions.size(); ++i) // The GUI edits these.
+  {
+    hash.add(m_mediumDefinitions[i].albedo);
+    hash.add(m_mediumDefinitions[i].density);
+    hash.add(m_mediumDefinitions[i].anisotropy);
+  }
+#endif
+
+  hash.add(m_pinholeCamera.m_center);
+  hash.add(m_pinholeCamera.m_distance);
+  hash.add(m_pinholeCamera.m_phi);
+  hash.add(m_pinholeCamera.m_theta);
+  hash.add(m_pinholeCamera.m_fov);
+  hash.add(m_cameraType);
+  hash.add(m_lensRadius);
+  hash.add(m_apertureBlades);
+  hash.add(m_apertureRotation);
+#if USE_FILTER_IMPORTANCE_SAMPLING
+  hash.add(m_pixelFilter);
+  hash.add(m_filterRadius);
+#endif
+  hash.add(m_shutterType);
+  hash.add(m_timeSlices);
+
+  hash.add(m_wavefront);
+  hash.add(m_sampler);
+  hash.add(m_minPathLength);
+  hash.add(m_maxPathLength);
+  hash.add(m_lightSamples);
+  hash.add(m_rouletteType);
+  hash.add(m_rouletteWindow);
+  hash.add(m_sceneEpsilonFactor);
+#if USE_RESTIR
+  hash.add(m_restir);
+  hash.add(m_restirCandidates);
+#endif
+#if USE_VISIBILITY_CACHE
+  hash.add(m_visibilityCache);
+#endif
+#if USE_SPECTRAL
+  hash.add(m_spectral);
+#endif
+#if USE_RADIANCE_CACHE
+  hash.add(m_cacheBounces);
+  hash.add(m_cacheCellSize);
+#endif
+#if USE_MULTI_VIEW
+  hash.add(isMultiViewSupported() ? m_multiView : int(MULTI_VIEW_OFF));
+  hash.add(m_stereoSeparation);
+#endif
+
+  for (std::map<std::string, int>::const_iterator it = m_shaderDefines.begin(); it != m_shaderDefines.end(); ++it)
+  {
+    hash.add(it->first);
+    hash.add(it->second);
+  }
+
+  return hash.get();
+}
+
+// Copies the accumulation into host memory and writes it to disk on a background thread.
+// The rendering only waits for the previous checkpoint to finish, which is never the case with sensible intervals.
+void Application::writeCheckpoint()
+{
+  SUTIL_NVTX_RANGE("writeCheckpoint");
+
+  if (m_checkpointWriter.joinable())
+  {
+    m_checkpointWriter.join();
+  }
+
+  resolveAccumulation();
+
+  std::vector<optix::Buffer> layers;
+  getCheckpointLayers(layers);
+
+  CheckpointHeader header;
+  memcpy(header.magic, "OCKP", 4);
+  header.version        = CHECKPOINT_VERSION;
+  header.hash           = getCheckpointHash();
+  header.width          = m_width;
+  header.height         = m_height;
+  header.iterationIndex = m_iterationIndex;
+  header.layers         = static_cast<unsigned int>(layers.size());
+
+  size_t size = sizeof(CheckpointHeader);
+  for (size_t i = 0; i < layers.size(); ++i)
+  {
+    size += sizeof(unsigned int) + layers[i]->getElementSize() * size_t(m_width) * size_t(m_height);
+  }
+
+  std::vector<char> data(size);
+  char* dst = data.data();
+
+  memcpy(dst, &header, sizeof(CheckpointHeader));
+  dst += sizeof(CheckpointHeader);
+
+  try
+  {
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+      const unsigned int elementSize = static_cast<unsigned int>(layers[i]->getElementSize());
+      const size_t       layerSize   = elementSize * size_t(m_width) * size_t(m_height);
+
+      memcpy(dst, &elementSize, sizeof(unsigned int));
+      dst += sizeof(unsigned int);
+
+      memcpy(dst, layers[i]->map(0, RT_BUFFER_MAP_READ), layerSize);
+      layers[i]->unmap();
+      dst += layerSize;
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+    return;
+  }
+
+  const std::string filename  = m_checkpointFilename;
+  const int         iteration = m_iterationIndex;
+
+  // Written under a temporary name first, so that an interruption while writing keeps the previous checkpoint intact.
+  m_checkpointWriter = std::thread([filename, iteration](std::vector<char> const& data)
+  {
+    const std::string filenameTemp = filename + ".tmp";
+    {
+      std::ofstream file(filenameTemp.c_str(), std::ios::binary | std::ios::trunc);
+      file.write(data.data(), data.size());
+      if (!file)
+      {
+        std::cerr << "ERROR: writeCheckpoint() failed to write " << filenameTemp << std::endl;
+        return;
+      }
+    }
+#if defined(_WIN32)
+    std::remove(filename.c_str()); // rename() doesn't replace existing files on Windows.
+#endif
+    if (std::rename(filenameTemp.c_str(), filename.c_str()) != 0)
+    {
+      std::cerr << "ERROR: writeCheckpoint() failed to rename " << filenameTemp << " to " << filename << std::endl;
+      return;
+    }
+    std::cout << "writeCheckpoint(): " << iteration << " samples per pixel in " << filename << std::endl;
+  }, std::move(data));
+}
+
+// Called by render() after the restarts of the first frame. Keeps the restarted accumulation when the checkpoint
+// doesn't exist or was written with different settings.
+bool Application::loadCheckpoint()
+{
+  SUTIL_NVTX_RANGE("loadCheckpoint");
+
+#if USE_WEDGE
+  if (m_wedgeActive) // The layers only hold the displayed variant.
+  {
+    std::cerr << "WARNING: loadCheckpoint() cannot continue the wedge variants, starting from scratch." << std::endl;
+    return false;
+  }
+#endif
+
+  std::ifstream file(m_checkpointFilename.c_str(), std::ios::binary);
+  if (!file)
+  {
+    std::cerr << "WARNING: loadCheckpoint() could not open " << m_checkpointFilename << ", starting from scratch." << std::endl;
+    return false;
+  }
+
+  std::vector<optix::Buffer> layers;
+  getCheckpointLayers(layers);
+
+  CheckpointHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(CheckpointHeader));
+  if (!file || memcmp(header.magic, "OCKP", 4) != 0 || header.version != CHECKPOINT_VERSION)
+  {
+    std::cerr << "WARNING: loadCheckpoint() " << m_checkpointFilename << " is no checkpoint of this version, starting from scratch." << std::endl;
+    return false;
+  }
+  if (header.hash != getCheckpointHash() || header.width != m_width || header.height != m_height || header.layers != layers.size())
+  {
+    std::cerr << "WARNING: loadCheckpoint() " << m_checkpointFilename << " was rendered with different settings, starting from scratch." << std::endl;
+    return false;
+  }
+
+  // Read everything before touching the buffers, so that a truncated file leaves the restarted accumulation intact.
+  std::vector< std::vector<char> > data(layers.size());
+  for (size_t i = 0; i < layers.size(); ++i)
+  {
+    unsigned int elementSize = 0;
+    file.read(reinterpret_cast<char*>(&elementSize), sizeof(unsigned int));
+    if (!file || elementSize != layers[i]->getElementSize())
+    {
+      std::cerr << "WARNING: loadCheckpoint() " << m_checkpointFilename << " has mismatching layers, starting from scratch." << std::endl;
+      return false;
+    }
+
+    data[i].resize(elementSize * size_t(m_width) * size_t(m_height));
+    file.read(data[i].data(), data[i].size());
+    if (!file)
+    {
+      std::cerr << "WARNING: loadCheckpoint() " << m_checkpointFilename << " is truncated, starting from scratch." << std::endl;
+      return false;
+    }
+  }
+
+  try
+  {
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+      memcpy(layers[i]->map(0, RT_BUFFER_MAP_WRITE_DISCARD), data[i].data(), data[i].size());
+      layers[i]->unmap();
+    }
+
+#if USE_GPU_LOCAL_ACCUMULATION
+    if (m_localAccumulation)
+    {
+      m_context->launch(ENTRY_RESTORE, m_width, m_height); // Each device continues accumulating inside its own buffers.
+    }
+#endif
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+    return false;
+  }
+
+  m_iterationIndex = header.iterationIndex;
+#if USE_AOVS
+  if (m_aovMask)
+  {
+    m_context["sysAovIteration"]->setInt(m_iterationIndex); // The AOVs aren't part of the checkpoint and start empty.
+  }
+#endif
+
+  std::cout << "loadCheckpoint(): resuming at " << m_iterationIndex << " samples per pixel from " << m_checkpointFilename << std::endl;
+  return true;
+}
+
+#endif // USE_CHECKPOINTS
@@ -0,0 +1,169 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_CHUNKED_BUILD
+
+#include <algorithm>
+#include <iostream>
+
+// Memory capped Acceleration builds.
+//
+// The builders allocate temporary memory proportional to the number of primitives on top of the final BVH, and the first
+// launch fails when that peak doesn't fit, even though the built scene would. With --buildbudget the scene loader estimates
+// the build footprint of each mesh and splits the ones above the budget into spatially coherent chunks by recursive median
+// splits of the triangle centroids along the longest axis. Each chunk becomes its own Geometry and bottom level Acceleration,
+// and each build only needs the temporary memory of its chunk. One Group per material index holds a GeometryGroup per chunk, all instances
+// of the mesh share these Groups, and the chunk Accelerations are shared among the material indices.
+// The chunked meshes are below a Group, not a GeometryGroup, so they are neither flattened nor animated.
+
+#define BUILD_BYTES_PER_TRIANGLE 192 // Temporary and final BVH memory of the Trbvh and Sbvh builds per triangle, a rough upper bound.
+
+size_t Application::estimateBuildBytes(const size_t numVertices, const size_t numTriangles) const
+{
+#if USE_COMPACT_ATTRIBUTES
+  const size_t bytesPerVertex = sizeof(optix::float3) + sizeof(VertexAttributesCompact);
+#else
+  const size_t bytesPerVertex = sizeof(VertexAttributes);
+#endif
+  return numVertices * bytesPerVertex + numTriangles * (sizeof(optix::uint3) + BUILD_BYTES_PER_TRIANGLE);
+}
+
+
+void Application::splitMeshChunks(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices, std::vector<optix::Geometry>& chunks)
+{
+  const size_t numTriangles = indices.size() / 3;
+  const size_t budget       = size_t(double(m_buildBudget) * 1024.0 * 1024.0);
+  const size_t estimate     = estimateBuildBytes(attributes.size(), numTriangles);
+
+  // The vertices scale with the triangles of a chunk, apart from the duplicated ones on the chunk borders.
+  const size_t maxTriangles = std::max(size_t(1), size_t(double(numTriangles) * double(budget) / double(estimate)));
+
+  std::vector<optix::float3> centroids(numTriangles);
+  std::vector<unsigned int>  triangles(numTriangles);
+  for (size_t i = 0; i < numTriangles; ++i)
+  {
+    centroids[i] = (attributes[indices[i * 3]].vertex + attributes[indices[i * 3 + 1]].vertex + attributes[indices[i * 3 + 2]].vertex) / 3.0f;
+    triangles[i] = static_cast<unsigned int>(i);
+  }
+
+  std::vector<int>              remap(attributes.size(), -1);
+  std::vector<VertexAttributes> chunkAttributes;
+  std::vector<unsigned int>     chunkIndices;
+
+  std::vector< std::pair<size_t, size_t> > ranges; // [begin, end) into triangles.
+  ranges.push_back(std::make_pair(size_t(0), numTriangles));
+
+  while (!ranges.empty())
+  {
+    const size_t begin = ranges.back().first;
+    const size_t end   = ranges.back().second;
+    ranges.pop_back();
+
+    if (maxTriangles < end - begin)
+    {
+      optix::float3 lo = centroids[triangles[begin]];
+      optix::float3 hi = lo;
+      for (size_t i = begin + 1; i < end; ++i)
+      {
+        lo = optix::fminf(lo, centroids[triangles[i]]);
+        hi = optix::fmaxf(hi, centroids[triangles[i]]);
+      }
+      const optix::float3 extent = hi - lo;
+      const int axis = (extent.y < extent.x) ? ((extent.z < extent.x) ? 0 : 2) : ((extent.z < extent.y) ? 1 : 2);
+
+      const size_t middle = begin + (end - begin) / 2;
+      std::nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end,
+        [&](const unsigned int a, const unsigned int b)
+        {
+          return (&centroids[a].x)[axis] < (&centroids[b].x)[axis];
+        });
+
+      ranges.push_back(std::make_pair(begin, middle));
+      ranges.push_back(std::make_pair(middle, end));
+      continue;
+    }
+
+    chunkAttributes.clear();
+    chunkIndices.clear();
+    for (size_t i = begin; i < end; ++i)
+    {
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        const unsigned int index = indices[triangles[i] * 3 + k];
+        if (remap[index] < 0)
+        {
+          remap[index] = int(chunkAttributes.size());
+          chunkAttributes.push_back(attributes[index]);
+        }
+        chunkIndices.push_back(static_cast<unsigned int>(remap[index]));
+      }
+    }
+    for (size_t i = begin; i < end; ++i)
+    {
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        remap[indices[triangles[i] * 3 + k]] = -1;
+      }
+    }
+
+    chunks.push_back(createGeometry(chunkAttributes, chunkIndices));
+  }
+
+  std::cout << "splitMeshChunks(): Build MiB = " << double(estimate) / (1024.0 * 1024.0) << ", Chunks = " << chunks.size() << std::endl;
+}
+
+
+// Material variant of a chunked mesh. The GeometryGroups of all material indices share the chunk Accelerations.
+optix::Group Application::createChunkGroup(std::vector<optix::Geometry> const& chunks, std::vector<optix::Acceleration> const& accelerations, const int materialIndex)
+{
+  optix::Group group = m_context->createGroup();
+  group->setAcceleration(createAcceleration(static_cast<unsigned int>(chunks.size()), ACCELERATION_TOP_LEVEL));
+  group->setChildCount(static_cast<unsigned int>(chunks.size()));
+
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    optix::GeometryInstance gi = m_context->createGeometryInstance();
+    setInstanceGeometry(gi, chunks[i]);
+    gi->setMaterialCount(1);
+    gi->setMaterial(0, getMaterial(materialIndex));
+    gi["parMaterialIndex"]->setInt(materialIndex);
+
+    optix::GeometryGroup gg = m_context->createGeometryGroup();
+    gg->setAcceleration(accelerations[i]);
+    gg->setChildCount(1);
+    gg->setChild(0, gi);
+
+    group->setChild(static_cast<unsigned int>(i), gg);
+  }
+  return group;
+}
+
+#endif // USE_CHUNKED_BUILD
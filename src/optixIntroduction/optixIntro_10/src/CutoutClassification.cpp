@@ -0,0 +1,234 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Application.h"
+
+#include <IL/il.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "inc/MyAssert.h"
+
+#if USE_CUTOUT_CLASSIFICATION
+
+// Host copy of the cutout opacity as the anyhit programs see it: RGB intensity of the normalized 8-bit texels.
+// Returns false for image formats which are not handled, then no triangle gets classified.
+static bool getOpacity(const Image* image, std::vector<float>& opacity)
+{
+  if (image == nullptr || image->m_block != IMAGE_BLOCK_NONE || image->m_type != IL_UNSIGNED_BYTE || image->m_depth != 1)
+  {
+    return false;
+  }
+
+  unsigned int numChannels = 0;
+  switch (image->m_format)
+  {
+    case IL_LUMINANCE:
+      numChannels = 1;
+      break;
+    case IL_LUMINANCE_ALPHA:
+      numChannels = 2;
+      break;
+    case IL_RGB:
+    case IL_BGR:
+      numChannels = 3;
+      break;
+    case IL_RGBA:
+    case IL_BGRA:
+      numChannels = 4;
+      break;
+    default:
+      return false;
+  }
+
+  const size_t numTexels = size_t(image->m_width) * image->m_height;
+  opacity.resize(numTexels);
+
+  for (size_t i = 0; i < numTexels; ++i)
+  {
+    const unsigned char* p = image->m_pixels + i * numChannels;
+    // Luminance maps to RGB. Channel order doesn't matter for the intensity.
+    opacity[i] = (numChannels < 3) ? float(p[0]) / 255.0f : (float(p[0]) + float(p[1]) + float(p[2])) / (3.0f * 255.0f);
+  }
+  return true;
+}
+
+
+// Stores a 2-bit CUTOUT_* state per triangle of all GeometryInstances with a cutout material.
+// The minimum and maximum opacity are taken over all texels the bilinear texture lookups inside the triangle's
+// texture coordinate bounding box can touch, with repeat wrap mode. That is conservative, any triangle which
+// cannot be proven fully opaque or fully transparent stays CUTOUT_PARTIAL and samples the texture as before.
+void Application::classifyCutoutOpacity()
+{
+  try
+  {
+    // The classification needs the texels on the host, the Texture only holds the device copy.
+    // The cache returns the Picture decoded for the cutout Texture, waiting for it when it's still loading asynchronously.
+    std::shared_ptr<const Picture> picture = PictureCache::acquire(m_textureCutoutFilename);
+
+    std::vector<float> opacity;
+    if (!getOpacity(picture->getImageFace(0, 0), opacity))
+    {
+      std::cerr << "WARNING: classifyCutoutOpacity() unsupported cutout image, skipped" << std::endl;
+      return;
+    }
+
+    const Image* image = picture->getImageFace(0, 0);
+    const int width  = int(image->m_width);
+    const int height = int(image->m_height);
+
+    std::vector<optix::GeometryGroup> geometryGroups;
+    gatherGeometryGroups(m_rootGroup, geometryGroups);
+
+    std::map<RTbuffer, optix::Buffer> mapOfStates; // Keyed by the indices buffer, shared geometry is only classified once.
+
+    unsigned int numTriangles = 0;
+    unsigned int numResolved  = 0;
+
+    for (size_t i = 0; i < geometryGroups.size(); ++i)
+    {
+      optix::GeometryGroup gg = geometryGroups[i];
+
+      for (unsigned int j = 0; j < gg->getChildCount(); ++j)
+      {
+        optix::GeometryInstance gi = gg->getChild(j);
+
+        const int materialIndex = gi["parMaterialIndex"]->getInt();
+        if (!m_guiMaterialParameters[materialIndex].useCutoutTexture)
+        {
+          continue;
+        }
+
+        optix::Buffer indicesBuffer = getInstanceBuffer(gi, "indicesBuffer");
+
+        std::map<RTbuffer, optix::Buffer>::const_iterator it = mapOfStates.find(indicesBuffer->get());
+        if (it != mapOfStates.end())
+        {
+          gi["parCutoutStates"]->setInt(it->second->getId());
+          continue;
+        }
+
+        optix::Buffer attributesBuffer = getInstanceBuffer(gi, "attributesBuffer");
+
+        RTsize numIndices = 0;
+        indicesBuffer->getSize(numIndices);
+        RTsize numVertices = 0;
+        attributesBuffer->getSize(numVertices);
+
+        // The texture coordinates of all vertices.
+        std::vector<optix::float2> texcoords(numVertices);
+#if USE_COMPACT_ATTRIBUTES
+        const VertexAttributesCompact* compact = static_cast<const VertexAttributesCompact*>(attributesBuffer->map(0, RT_BUFFER_MAP_READ));
+        for (size_t k = 0; k < texcoords.size(); ++k)
+        {
+          texcoords[k] = optix::make_float2(halfToFloat(compact[k].texcoord & 0xFFFF), halfToFloat(compact[k].texcoord >> 16));
+        }
+#else
+        const VertexAttributes* attributes = static_cast<const VertexAttributes*>(attributesBuffer->map(0, RT_BUFFER_MAP_READ));
+        for (size_t k = 0; k < texcoords.size(); ++k)
+        {
+          texcoords[k] = optix::make_float2(attributes[k].texcoord);
+        }
+#endif
+        attributesBuffer->unmap();
+
+        const optix::uint3* indices = static_cast<const optix::uint3*>(indicesBuffer->map(0, RT_BUFFER_MAP_READ));
+
+        std::vector<unsigned int> states((numIndices + 15) / 16, 0u); // Sixteen 2-bit states per word, CUTOUT_PARTIAL == 0.
+
+        for (RTsize k = 0; k < numIndices; ++k)
+        {
+          const optix::float2 t0 = texcoords[indices[k].x];
+          const optix::float2 t1 = texcoords[indices[k].y];
+          const optix::float2 t2 = texcoords[indices[k].z];
+
+          const optix::float2 lo = optix::fminf(t0, optix::fminf(t1, t2));
+          const optix::float2 hi = optix::fmaxf(t0, optix::fmaxf(t1, t2));
+
+          // Texel ranges touched by the bilinear filter footprint of the bounding box. Clamped to one full wrap.
+          const int x0 = int(floorf(lo.x * width  - 0.5f));
+          const int y0 = int(floorf(lo.y * height - 0.5f));
+          const int x1 = std::min(int(floorf(hi.x * width  - 0.5f)) + 1, x0 + width  - 1);
+          const int y1 = std::min(int(floorf(hi.y * height - 0.5f)) + 1, y0 + height - 1);
+
+          float opacityMin = 1.0f;
+          float opacityMax = 0.0f;
+
+          for (int y = y0; y <= y1 && (opacityMin == 1.0f || opacityMax == 0.0f); ++y) // Stop as soon as it's partial.
+          {
+            const int row = ((y % height) + height) % height;
+            for (int x = x0; x <= x1; ++x)
+            {
+              const float o = opacity[row * width + ((x % width) + width) % width];
+              opacityMin = std::min(opacityMin, o);
+              opacityMax = std::max(opacityMax, o);
+            }
+          }
+
+          unsigned int state = CUTOUT_PARTIAL;
+          if (1.0f <= opacityMin)
+          {
+            state = CUTOUT_OPAQUE;
+          }
+          else if (opacityMax <= 0.0f)
+          {
+            state = CUTOUT_TRANSPARENT;
+          }
+
+          if (state != CUTOUT_PARTIAL)
+          {
+            states[k >> 4] |= state << ((k & 15) << 1);
+            ++numResolved;
+          }
+        }
+        numTriangles += (unsigned int) numIndices;
+
+        indicesBuffer->unmap();
+
+        optix::Buffer statesBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, states.size());
+        memcpy(statesBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD), states.data(), sizeof(unsigned int) * states.size());
+        statesBuffer->unmap();
+
+        mapOfStates[indicesBuffer->get()] = statesBuffer;
+
+        gi["parCutoutStates"]->setInt(statesBuffer->getId());
+      }
+    }
+
+    std::cout << "classifyCutoutOpacity(): " << numResolved << " of " << numTriangles << " triangles resolved without texture lookup" << std::endl;
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+#endif // USE_CUTOUT_CLASSIFICATION
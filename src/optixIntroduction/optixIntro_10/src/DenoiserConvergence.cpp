@@ -0,0 +1,131 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+
+#include <NvtxRange.h>
+
+#include <algorithm>
+#include <iostream>
+
+// Number of consecutive comparisons below the threshold before the accumulation stops.
+// A single small change can happen when the denoiser runs twice shortly after each other.
+#define DENOISER_STABLE_CHECKS 2
+
+void Application::setStableThreshold(const float threshold)
+{
+  m_stableThreshold = threshold;
+}
+
+void Application::resetDenoiserConvergence()
+{
+  m_denoisedChange    = -1.0f;
+  m_stableChecks      = 0;
+  m_stableIteration   = 0;
+  m_denoisedStable    = false;
+  m_denoisedReference = false;
+}
+
+// Headless rendering never presents, so the denoiser only runs for the comparison, every m_denoiseCadence iterations.
+void Application::checkDenoiserConvergence()
+{
+  if (m_stableThreshold <= 0.0f || !m_useDenoiser || m_denoisedStable ||
+      m_iterationIndex - m_stableIteration < m_denoiseCadence)
+  {
+    return;
+  }
+
+  m_stableIteration = m_iterationIndex;
+
+  if (m_denoisedIteration != m_iterationIndex)
+  {
+    resolveAccumulation();
+
+    m_profiler.begin(PROFILER_DENOISER);
+    denoise();
+    m_profiler.end(PROFILER_DENOISER);
+
+    m_denoisedIteration = m_iterationIndex;
+  }
+
+  updateDenoiserConvergence();
+}
+
+// Compares the current m_bufferDenoised against the one of the previous call on the device.
+// Only the mean relative change per tile is read back.
+void Application::updateDenoiserConvergence()
+{
+  if (m_stableThreshold <= 0.0f || m_denoisedStable)
+  {
+    return;
+  }
+#if USE_RESIZE_CAPACITY
+  if (!isCapacityExact()) // The denoiser didn't run on the current sub-rectangle.
+  {
+    return;
+  }
+#endif
+
+  SUTIL_NVTX_RANGE("denoiserConvergence");
+
+  const int tilesX = (m_width  + DENOISER_CHANGE_TILE_SIZE - 1) / DENOISER_CHANGE_TILE_SIZE;
+  const int tilesY = (m_height + DENOISER_CHANGE_TILE_SIZE - 1) / DENOISER_CHANGE_TILE_SIZE;
+
+  m_context->launch(ENTRY_DENOISER_CHANGE, tilesX, tilesY); // Also copies the denoised image into m_bufferDenoisedPrevious.
+
+  if (!m_denoisedReference) // The first denoised image after a restart has nothing to be compared with.
+  {
+    m_denoisedReference = true;
+    return;
+  }
+
+  float maxChange = 0.0f;
+
+  const float* change = static_cast<const float*>(m_bufferDenoisedChange->map(0, RT_BUFFER_MAP_READ));
+  for (int i = 0; i < tilesX * tilesY; ++i)
+  {
+    maxChange = std::max(maxChange, change[i]);
+  }
+  m_bufferDenoisedChange->unmap();
+
+  m_denoisedChange = maxChange;
+
+  m_stableChecks = (maxChange < m_stableThreshold) ? m_stableChecks + 1 : 0;
+  if (DENOISER_STABLE_CHECKS <= m_stableChecks)
+  {
+    m_denoisedStable = true;
+    m_presentNext    = true; // Make sure the final result gets displayed.
+    std::cout << "Denoised image stable below " << m_stableThreshold << " after " << m_iterationIndex << " iterations" << std::endl;
+  }
+}
+
+#endif // USE_DENOISER && USE_DENOISER_CONVERGENCE
@@ -0,0 +1,258 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#if USE_DENOISER && USE_DENOISER_DEVICE
+
+#include "inc/DenoiserDevice.h"
+
+#include <GL/glew.h>
+
+#include <cstring>
+#include <iostream>
+
+DenoiserDevice::DenoiserDevice()
+: m_width(0)
+, m_height(0)
+, m_albedo(false)
+, m_normal(false)
+, m_pending(false)
+, m_quit(false)
+, m_denoisedIteration(-1)
+{
+}
+
+DenoiserDevice::~DenoiserDevice()
+{
+  if (m_thread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+  }
+  if (m_context)
+  {
+    m_context->destroy();
+  }
+}
+
+bool DenoiserDevice::init(const int device, const bool albedo, const bool normal, const float blend, const float maxMem)
+{
+  try
+  {
+    m_context = optix::Context::create();
+
+    const int devices[1] = { device };
+    m_context->setDevices(devices, devices + 1);
+
+    m_albedo = albedo;
+    m_normal = albedo && normal;
+
+    // Sized by the first submit().
+    m_bufferInput  = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+    m_bufferAlbedo = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+    m_bufferNormal = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+    m_bufferOutput = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT4, 1, 1);
+
+    // Same settings as Application::createDenoiserStage().
+    m_stage = m_context->createBuiltinPostProcessingStage("DLDenoiser");
+    m_stage->declareVariable("input_buffer");
+    m_stage->declareVariable("output_buffer");
+    if (m_albedo)
+    {
+      m_stage->declareVariable("input_albedo_buffer");
+      if (m_normal)
+      {
+        m_stage->declareVariable("input_normal_buffer");
+      }
+    }
+    m_stage->declareVariable("blend");
+    m_stage->declareVariable("hdr");
+    m_stage->declareVariable("maxmem");
+
+    m_stage->queryVariable("input_buffer")->setBuffer(m_bufferInput);
+    m_stage->queryVariable("output_buffer")->setBuffer(m_bufferOutput);
+    if (m_albedo)
+    {
+      m_stage->queryVariable("input_albedo_buffer")->setBuffer(m_bufferAlbedo);
+      if (m_normal)
+      {
+        m_stage->queryVariable("input_normal_buffer")->setBuffer(m_bufferNormal);
+      }
+    }
+    m_stage->queryVariable("blend")->setFloat(blend);
+    m_stage->queryVariable("hdr")->setUint(1);
+    m_stage->queryVariable("maxmem")->setFloat(1024.0f * 1024.0f * maxMem);
+
+    std::cout << "DenoiserDevice::init(): Denoising on device " << device << ": " << m_context->getDeviceName(device) << std::endl;
+  }
+  catch (optix::Exception& e)
+  {
+    std::cerr << "ERROR: DenoiserDevice::init() " << e.getErrorString() << std::endl;
+    if (m_context)
+    {
+      m_context->destroy();
+      m_context = nullptr;
+    }
+    return false;
+  }
+
+  m_thread = std::thread(&DenoiserDevice::worker, this);
+  return true;
+}
+
+void DenoiserDevice::submit(const float* beauty, const float* albedo, const float* normal, const int width, const int height, const int pitch, const int iteration)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  const size_t rowFloats = size_t(width) * 4;
+
+  m_snapshot.beauty.resize(rowFloats * height);
+  m_snapshot.albedo.resize((m_albedo) ? rowFloats * height : 0);
+  m_snapshot.normal.resize((m_normal) ? rowFloats * height : 0);
+
+  for (int y = 0; y < height; ++y)
+  {
+    const size_t src = size_t(y) * pitch * 4;
+    const size_t dst = size_t(y) * rowFloats;
+
+    memcpy(&m_snapshot.beauty[dst], beauty + src, rowFloats * sizeof(float));
+    if (m_albedo)
+    {
+      memcpy(&m_snapshot.albedo[dst], albedo + src, rowFloats * sizeof(float));
+    }
+    if (m_normal)
+    {
+      memcpy(&m_snapshot.normal[dst], normal + src, rowFloats * sizeof(float));
+    }
+  }
+  m_snapshot.width     = width;
+  m_snapshot.height    = height;
+  m_snapshot.iteration = iteration;
+  m_pending = true;
+
+  m_wake.notify_one();
+}
+
+RenderFrame const* DenoiserDevice::acquire()
+{
+  return m_frames.acquire();
+}
+
+int DenoiserDevice::getDenoisedIteration() const
+{
+  return m_denoisedIteration;
+}
+
+// The post-processing command list has a fixed size, it's recreated when the submitted images changed their size.
+void DenoiserDevice::resize(const int width, const int height)
+{
+  if (width == m_width && height == m_height)
+  {
+    return;
+  }
+
+  m_bufferInput->setSize(width, height);
+  m_bufferAlbedo->setSize(width, height);
+  m_bufferNormal->setSize(width, height);
+  m_bufferOutput->setSize(width, height);
+
+  if (m_commandList)
+  {
+    m_commandList->destroy();
+  }
+  m_commandList = m_context->createCommandList();
+  m_commandList->appendPostprocessingStage(m_stage, width, height);
+  m_commandList->finalize();
+
+  m_width  = width;
+  m_height = height;
+}
+
+void DenoiserDevice::worker()
+{
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this] { return m_pending || m_quit; });
+      if (m_quit)
+      {
+        return;
+      }
+      std::swap(m_working, m_snapshot); // The render thread fills the other one meanwhile.
+      m_pending = false;
+    }
+
+    try
+    {
+      resize(m_working.width, m_working.height);
+
+      const size_t bytes = m_working.beauty.size() * sizeof(float);
+
+      memcpy(m_bufferInput->map(0, RT_BUFFER_MAP_WRITE_DISCARD), m_working.beauty.data(), bytes);
+      m_bufferInput->unmap();
+      if (m_albedo)
+      {
+        memcpy(m_bufferAlbedo->map(0, RT_BUFFER_MAP_WRITE_DISCARD), m_working.albedo.data(), bytes);
+        m_bufferAlbedo->unmap();
+      }
+      if (m_normal)
+      {
+        memcpy(m_bufferNormal->map(0, RT_BUFFER_MAP_WRITE_DISCARD), m_working.normal.data(), bytes);
+        m_bufferNormal->unmap();
+      }
+
+      m_commandList->execute();
+
+      RenderFrame& frame = m_frames.back();
+      frame.data.resize(bytes);
+      memcpy(frame.data.data(), m_bufferOutput->map(0, RT_BUFFER_MAP_READ), bytes);
+      m_bufferOutput->unmap();
+
+      frame.width          = m_working.width;
+      frame.height         = m_working.height;
+      frame.internalFormat = GL_RGBA32F;
+      frame.format         = GL_RGBA;
+      frame.type           = GL_FLOAT;
+      frame.tonemapped     = false;
+
+      m_frames.publish();
+      m_denoisedIteration = m_working.iteration;
+    }
+    catch (optix::Exception& e)
+    {
+      std::cerr << "ERROR: DenoiserDevice::worker() " << e.getErrorString() << std::endl;
+    }
+  }
+}
+
+#endif // USE_DENOISER && USE_DENOISER_DEVICE
@@ -0,0 +1,122 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_DENOISER && USE_DENOISER_TILES
+
+#include <NvtxRange.h>
+
+#include <algorithm>
+#include <iostream>
+
+// Tiled denoising for frames whose full frame denoiser would need too much memory next to the scene.
+// Each tile is copied with DENOISER_TILE_OVERLAP pixels of its surroundings into fixed size tile buffers, denoised by
+// a second DLDenoiser stage of that size and cross-faded into m_bufferDenoised over the overlap. The tiles run one
+// after the other, so the denoiser memory is the one of a single tile, which the "maxmem" limit caps further.
+
+void Application::setDenoiserTileSize(const int tileSize)
+{
+  m_denoiseTileSize = (0 < tileSize) ? std::max(tileSize, 2 * DENOISER_TILE_OVERLAP) : 0; // Smaller tiles would overlap more than one neighbour.
+}
+
+bool Application::isDenoiserTiled() const
+{
+  return 0 < m_denoiseTileSize && (m_denoiseTileSize < m_width || m_denoiseTileSize < m_height);
+}
+
+// (Re-)creates the tile sized denoiser stage when the tile size changed.
+void Application::initDenoiserTiles()
+{
+  const int extent = m_denoiseTileSize + 2 * DENOISER_TILE_OVERLAP;
+  if (extent == m_denoiseTileExtent)
+  {
+    return;
+  }
+
+  m_bufferDenoiserTileInput->setSize(extent, extent);
+  optix::Buffer albedo;
+  optix::Buffer normals;
+#if USE_DENOISER_ALBEDO
+  m_bufferDenoiserTileAlbedo->setSize(extent, extent);
+  albedo = m_bufferDenoiserTileAlbedo;
+#if USE_DENOISER_NORMAL
+  m_bufferDenoiserTileNormal->setSize(extent, extent);
+  normals = m_bufferDenoiserTileNormal;
+#endif
+#endif
+  m_bufferDenoiserTileOutput->setSize(extent, extent);
+
+  if (m_commandListDenoiserTile)
+  {
+    m_commandListDenoiserTile->destroy();
+  }
+  if (m_stageDenoiserTile)
+  {
+    m_stageDenoiserTile->destroy();
+  }
+
+  m_stageDenoiserTile = createDenoiserStage(m_bufferDenoiserTileInput, albedo, normals, m_bufferDenoiserTileOutput);
+
+  m_commandListDenoiserTile = m_context->createCommandList();
+  m_commandListDenoiserTile->appendPostprocessingStage(m_stageDenoiserTile, extent, extent);
+  m_commandListDenoiserTile->finalize();
+
+  m_context["sysDenoiserTileSize"]->setInt(m_denoiseTileSize);
+
+  m_denoiseTileExtent = extent;
+
+  std::cout << "initDenoiserTiles(): Tile = " << m_denoiseTileSize << ", Overlap = " << DENOISER_TILE_OVERLAP << std::endl;
+}
+
+// The tiles must run in rows from the first to the last, see denoiser_tile_scatter().
+void Application::denoiseTiles()
+{
+  SUTIL_NVTX_RANGE("denoiseTiles");
+
+  initDenoiserTiles();
+
+  const int tilesX = (m_width  + m_denoiseTileSize - 1) / m_denoiseTileSize;
+  const int tilesY = (m_height + m_denoiseTileSize - 1) / m_denoiseTileSize;
+
+  for (int y = 0; y < tilesY; ++y)
+  {
+    for (int x = 0; x < tilesX; ++x)
+    {
+      m_context["sysDenoiserTileIndex"]->setInt(x, y);
+
+      m_context->launch(ENTRY_DENOISER_TILE_GATHER, m_denoiseTileExtent, m_denoiseTileExtent);
+      m_commandListDenoiserTile->execute();
+      m_context->launch(ENTRY_DENOISER_TILE_SCATTER, m_denoiseTileExtent, m_denoiseTileExtent);
+    }
+  }
+}
+
+#endif // USE_DENOISER && USE_DENOISER_TILES
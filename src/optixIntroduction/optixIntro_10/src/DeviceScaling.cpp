@@ -0,0 +1,196 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#if USE_DEVICE_SCALING
+
+#include "inc/Application.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Multi-GPU scaling study inside one context. The -d encoding is decoded into its distinct installed devices,
+// then the benchmark workload renders on each device alone and on the first 1..N devices together.
+// OptiX distributes the pixels of a launch itself and exposes no per-device timings, so the utilization of a set
+// is estimated against the devices it contains: efficiency = measured iterations per second / sum of the standalone
+// iterations per second of its devices. With identical devices that is the usual speedup / N.
+// The launches are timed apart from the resolve of the GPU local accumulation (the compositing) and the map of the
+// output buffer (the transfer to the host), which happen once per presented frame and not per iteration.
+// Every change of the device set migrates the buffers and compiles the kernel again, an empty launch keeps that out of the timings.
+
+namespace
+{
+  struct DeviceScalingResult
+  {
+    double ips;         // Iterations per second of the launches.
+    double traceMs;     // Per iteration.
+    double resolveMs;   // Per presented frame.
+    double transferMs;  // Per presented frame.
+  };
+}
+
+void Application::deviceScaling(std::string const& name, const int iterations)
+{
+  try
+  {
+    finishTextures(); // Measure and render with the final textures only.
+
+    const std::vector<int> enabled = m_context->getEnabledDevices(); // Restored at the end.
+
+    unsigned int numberOfDevices = 0;
+    RT_CHECK_ERROR_NO_CONTEXT(rtDeviceGetDeviceCount(&numberOfDevices));
+
+    std::vector<int> devices;
+    unsigned int encoding = m_devicesEncoding;
+    do
+    {
+      const int device = int(encoding % 10);
+      if (device < int(numberOfDevices) && std::find(devices.begin(), devices.end(), device) == devices.end())
+      {
+        devices.push_back(device);
+      }
+      encoding /= 10;
+    } while (encoding);
+
+#if USE_WAVEFRONT
+    if (m_wavefront && 1 < devices.size())
+    {
+      std::cerr << "WARNING: deviceScaling() The wavefront path tracer requires a single device. Only the standalone devices are measured." << std::endl;
+    }
+#endif
+
+    int samplesPerLaunch = 1;
+#if USE_SAMPLES_PER_LAUNCH
+    samplesPerLaunch = (m_wavefront) ? 1 : m_samplesPerLaunch;
+    m_context["sysSamplesPerLaunch"]->setInt(samplesPerLaunch);
+#endif
+
+    optix::float3 cameraPosition;
+    optix::float3 cameraU;
+    optix::float3 cameraV;
+    optix::float3 cameraW;
+
+    m_pinholeCamera.getFrustum(cameraPosition, cameraU, cameraV, cameraW);
+
+    m_context["sysCameraPosition"]->setFloat(cameraPosition);
+    m_context["sysCameraU"]->setFloat(cameraU);
+    m_context["sysCameraV"]->setFloat(cameraV);
+    m_context["sysCameraW"]->setFloat(cameraW);
+    m_context["sysFocusDistance"]->setFloat(m_pinholeCamera.m_distance);
+
+    // Sets are the standalone devices first, then the prefixes of two and more devices.
+    std::vector< std::vector<int> > sets;
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+      sets.push_back(std::vector<int>(1, devices[i]));
+    }
+    for (size_t n = 2; n <= devices.size() && !m_wavefront; ++n)
+    {
+      sets.push_back(std::vector<int>(devices.begin(), devices.begin() + n));
+    }
+
+    std::vector<DeviceScalingResult> results;
+    for (size_t s = 0; s < sets.size(); ++s)
+    {
+      std::vector<int> const& set = sets[s];
+
+      m_context->setDevices(set.begin(), set.end());
+      m_context->launch(ENTRY_RENDER, 0, 0); // Compiles and uploads for the new device set.
+
+      m_context["sysIterationIndex"]->setInt(0);
+      launchBenchmarkIteration(); // Warm up.
+
+      DeviceScalingResult result;
+
+      Timer timer;
+      timer.start();
+      for (int i = 0; i < iterations; ++i)
+      {
+        m_context["sysIterationIndex"]->setInt(i * samplesPerLaunch);
+        launchBenchmarkIteration();
+      }
+      const double seconds = timer.getTime();
+
+      result.ips     = double(iterations) / seconds;
+      result.traceMs = seconds * 1000.0 / double(iterations);
+
+      timer.restart();
+      resolveAccumulation();
+      result.resolveMs = timer.getTime() * 1000.0;
+
+      timer.restart();
+      m_bufferOutput->map(0, RT_BUFFER_MAP_READ);
+      m_bufferOutput->unmap();
+      result.transferMs = timer.getTime() * 1000.0;
+
+      results.push_back(result);
+
+      // The standalone rates are the reference of the utilization estimate.
+      double ideal = 0.0;
+      for (size_t i = 0; i < set.size(); ++i)
+      {
+        ideal += results[std::find(devices.begin(), devices.end(), set[i]) - devices.begin()].ips;
+      }
+
+      std::ostringstream list;
+      for (size_t i = 0; i < set.size(); ++i)
+      {
+        list << ((i) ? "," : "") << set[i];
+      }
+
+      std::ostringstream stream;
+      stream << std::fixed << std::setprecision(3) << "DEVICESCALING " << name << " " << m_width << "x" << m_height
+             << " iterations=" << iterations << " samples_per_launch=" << samplesPerLaunch
+             << " devices=" << list.str()
+             << " iterations_per_second=" << result.ips
+             << " trace_ms=" << result.traceMs
+             << " resolve_ms=" << result.resolveMs
+             << " transfer_ms=" << result.transferMs
+             << " speedup=" << result.ips / results[0].ips
+             << " efficiency=" << result.ips / ideal;
+      if (set.size() == 1)
+      {
+        stream << " name=\"" << m_context->getDeviceName(set[0]) << "\"";
+      }
+      std::cout << stream.str() << std::endl;
+    }
+
+    m_context->setDevices(enabled.begin(), enabled.end());
+    m_context->launch(ENTRY_RENDER, 0, 0);
+    restartAccumulation();
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+#endif // USE_DEVICE_SCALING
@@ -0,0 +1,229 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_RENDER_SERVER && USE_TILED_LAUNCH
+
+#include <NvtxRange.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Tile edge length when the command line did not set one with --tile.
+#define DISTRIBUTED_TILE_SIZE 128
+
+namespace
+{
+  // The tiles not yet rendered and the host images they are merged into. The tiles never overlap,
+  // so the workers copy their results without holding the lock.
+  struct DistributedFrame
+  {
+    std::mutex                mutex;
+    std::deque<optix::uint2>  pending;
+    std::vector<float*>       layers; // RGBA32F images of the full resolution, same order as getTileLayers().
+    int                       width;
+    int                       height;
+    int                       tileSize;
+    int                       spp;
+    size_t                    rendered;
+  };
+
+  bool parseWorker(std::string const& worker, std::string& host, int& port)
+  {
+    const std::string::size_type colon = worker.rfind(':');
+    if (colon == std::string::npos || colon == 0)
+    {
+      return false;
+    }
+    host = worker.substr(0, colon);
+    port = atoi(worker.substr(colon + 1).c_str());
+    return (0 < port);
+  }
+
+  bool expectOK(RenderClient& client, std::string const& command)
+  {
+    std::string reply;
+    return client.send(command) && client.receiveLine(reply) && reply == "OK";
+  }
+
+  // Worker thread loop. Takes tiles until none are left. A failing worker puts its tile back for the others.
+  void renderTiles(std::string const& worker, DistributedFrame* frame)
+  {
+    std::string host;
+    int         port = 0;
+    RenderClient client;
+
+    std::ostringstream resize;
+    resize << "resize " << frame->width << " " << frame->height;
+
+    if (!parseWorker(worker, host, port) || !client.connect(host, port) ||
+        !expectOK(client, resize.str()) || !expectOK(client, "set accumulate 0"))
+    {
+      std::cerr << "ERROR: renderDistributed() worker " << worker << " is not available" << std::endl;
+      return;
+    }
+
+    const size_t layers = frame->layers.size();
+    std::vector<float> data;
+
+    for (;;)
+    {
+      optix::uint2 tile;
+      {
+        std::lock_guard<std::mutex> lock(frame->mutex);
+        if (frame->pending.empty())
+        {
+          break;
+        }
+        tile = frame->pending.front();
+        frame->pending.pop_front();
+      }
+
+      const int width  = std::min(frame->tileSize, frame->width  - int(tile.x));
+      const int height = std::min(frame->tileSize, frame->height - int(tile.y));
+
+      std::ostringstream command;
+      command << "tile " << tile.x << " " << tile.y << " " << width << " " << height << " " << frame->spp;
+
+      std::ostringstream expected;
+      expected << "TILE " << tile.x << " " << tile.y << " " << width << " " << height << " " << layers << " " << layers * width * height * 4 * sizeof(float);
+
+      std::string reply;
+      data.resize(layers * width * height * 4);
+
+      if (!client.send(command.str()) || !client.receiveLine(reply) || reply != expected.str() ||
+          !client.receive(data.data(), data.size() * sizeof(float)))
+      {
+        std::cerr << "ERROR: renderDistributed() worker " << worker << " failed: " << reply << std::endl;
+
+        std::lock_guard<std::mutex> lock(frame->mutex);
+        frame->pending.push_back(tile);
+        return;
+      }
+
+      const size_t rowFloats = size_t(width) * 4;
+      for (size_t layer = 0; layer < layers; ++layer)
+      {
+        for (int row = 0; row < height; ++row)
+        {
+          memcpy(frame->layers[layer] + (size_t(tile.y + row) * frame->width + tile.x) * 4,
+                 &data[(layer * height + row) * rowFloats], rowFloats * sizeof(float));
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(frame->mutex);
+      frame->rendered++;
+    }
+
+    expectOK(client, "set accumulate 1");
+  }
+} // namespace
+
+
+// The coordinator only needs the same scene and resolution as the workers for the denoiser and the image output.
+// Each worker gets one tile at a time, so faster nodes simply render more tiles.
+void Application::renderDistributed(std::vector<std::string> const& workers, const int spp, std::string const& filename)
+{
+  SUTIL_NVTX_RANGE("renderDistributed");
+
+  try
+  {
+    // Reuse the tile scheduler for the order, centre tiles first.
+    const int tileSize = m_tileSize;
+    m_tileSize = (0 < tileSize) ? tileSize : DISTRIBUTED_TILE_SIZE;
+    scheduleTiles();
+
+    DistributedFrame frame;
+    frame.pending.assign(m_tileQueue.begin(), m_tileQueue.end());
+    frame.width    = m_width;
+    frame.height   = m_height;
+    frame.tileSize = m_tileSize;
+    frame.spp      = spp;
+    frame.rendered = 0;
+
+    m_tileQueue.clear();
+    m_tileNext = 0;
+    m_tileSize = tileSize;
+
+    const size_t numberOfTiles = frame.pending.size();
+
+    std::vector<optix::Buffer> buffers;
+    getTileLayers(buffers);
+
+    // The workers write straight into the mapped buffers.
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+      frame.layers.push_back(static_cast<float*>(buffers[i]->map(0, RT_BUFFER_MAP_WRITE_DISCARD)));
+    }
+
+    Timer timer;
+    timer.start();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+      threads.push_back(std::thread(renderTiles, workers[i], &frame));
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+      threads[i].join();
+    }
+
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+      buffers[i]->unmap();
+    }
+
+    std::cout << "renderDistributed(): " << frame.rendered << " of " << numberOfTiles << " tiles with " << frame.spp
+              << " samples per pixel on " << workers.size() << " workers in " << timer.getTime() << " seconds" << std::endl;
+
+    if (frame.rendered != numberOfTiles)
+    {
+      std::cerr << "ERROR: renderDistributed() no worker left for the remaining tiles, " << filename << " not written" << std::endl;
+      return;
+    }
+
+    // The merged image is in the shared output buffers, a resolve would overwrite it with the unused local ones.
+    m_iterationIndex = frame.spp;
+    writeImage(filename); // Runs the denoiser once.
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+#endif // USE_RENDER_SERVER && USE_TILED_LAUNCH
@@ -0,0 +1,353 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_DYNAMIC_SCENE
+
+#include <NvtxRange.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "inc/MyAssert.h"
+#include "inc/ParallelFor.h"
+
+// Animation interface for the scene built by createScene().
+//
+// The dynamic instances are the Transforms without motion keys directly under the root Group, in their order there.
+// setInstanceMatrix() only changes the Transform, which needs nothing but a rebuild of the small top level Acceleration.
+// setInstanceAttributes() overwrites the vertex data of the instance's Geometry in place and marks its bottom level
+// Acceleration dirty. A refit only adjusts the node bounds of the existing BVH, which is much faster than a rebuild,
+// but the tree quality degrades with the distance the vertices moved since the last rebuild. So the positions of the last
+// rebuild are kept per Acceleration, and a rebuild is chosen when any vertex moved further than m_refitThreshold times
+// their bounding box diagonal.
+// Instanced meshes share their Acceleration, deforming one instance deforms all instances of that mesh.
+// updateDynamicScene() applies the "refit" property and marks only the changed Accelerations dirty once per frame,
+// the next launch builds them.
+
+// Diagonal of the axis aligned bounding box of the positions.
+static float getExtent(std::vector<optix::float3> const& positions)
+{
+  if (positions.empty())
+  {
+    return 0.0f;
+  }
+
+  optix::float3 lo = positions[0];
+  optix::float3 hi = positions[0];
+  for (size_t i = 1; i < positions.size(); ++i)
+  {
+    lo = optix::fminf(lo, positions[i]);
+    hi = optix::fmaxf(hi, positions[i]);
+  }
+  return optix::length(hi - lo);
+}
+
+void Application::initDynamicScene()
+{
+  m_dynamicInstances.clear();
+  m_dynamicMeshes.clear();
+
+  try
+  {
+    std::map<RTacceleration, size_t> mapOfMeshes; // Instanced meshes share one Acceleration among many GeometryGroups.
+
+    const unsigned int count = m_rootGroup->getChildCount();
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      if (m_rootGroup->getChildType(i) != RT_OBJECTTYPE_TRANSFORM)
+      {
+        continue; // The flattened GeometryGroup and the lights.
+      }
+
+      optix::Transform tr = m_rootGroup->getChild<optix::Transform>(i);
+      if (1 < tr->getMotionKeyCount() || tr->getChildType() != RT_OBJECTTYPE_GEOMETRY_GROUP)
+      {
+        continue; // The motion keys define the animation inside the shutter interval.
+      }
+
+      optix::GeometryGroup gg = tr->getChild<optix::GeometryGroup>();
+      if (gg->getChildCount() == 0)
+      {
+        continue;
+      }
+#if USE_GEOMETRY_PAGING
+      if (gg->getChild(0)->queryVariable("parPageIndex"))
+      {
+        continue; // Paged meshes exchange their Geometry and Acceleration, see updateGeometryPaging().
+      }
+#endif
+
+      optix::Acceleration acceleration = gg->getAcceleration();
+
+      std::map<RTacceleration, size_t>::const_iterator it = mapOfMeshes.find(acceleration->get());
+      if (it == mapOfMeshes.end())
+      {
+        DynamicMesh mesh;
+
+        mesh.acceleration = acceleration;
+        mesh.extent       = 0.0f;
+        mesh.dirty        = false;
+        mesh.rebuild      = false;
+
+        it = mapOfMeshes.insert(std::make_pair(acceleration->get(), m_dynamicMeshes.size())).first;
+        m_dynamicMeshes.push_back(mesh);
+      }
+
+      float m[16];
+      float inv[16];
+      tr->getMatrix(false, m, inv);
+
+      DynamicInstance instance;
+
+      instance.transform  = tr;
+      instance.instance   = gg->getChild(0);
+      instance.mesh       = it->second;
+      instance.matrixRest = optix::Matrix4x4(m);
+
+      m_dynamicInstances.push_back(instance);
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+
+  m_dynamicChanged = false;
+  m_dynamicRefits   = 0;
+  m_dynamicRebuilds = 0;
+
+  m_animationTimer.restart();
+
+  std::cout << "initDynamicScene(): Instances = " << m_dynamicInstances.size() << ", Meshes = " << m_dynamicMeshes.size() << std::endl;
+}
+
+void Application::setAnimation(const bool enable, const float refitThreshold)
+{
+  m_animation      = enable;
+  m_refitThreshold = std::max(0.0f, refitThreshold);
+}
+
+unsigned int Application::getInstanceCount() const
+{
+  return static_cast<unsigned int>(m_dynamicInstances.size());
+}
+
+bool Application::setInstanceMatrix(const unsigned int index, optix::Matrix4x4 const& matrix)
+{
+  if (m_dynamicInstances.size() <= index)
+  {
+    std::cerr << "ERROR: setInstanceMatrix() invalid instance " << index << std::endl;
+    return false;
+  }
+
+  m_dynamicInstances[index].transform->setMatrix(false, matrix.getData(), matrix.inverse().getData());
+
+  m_dynamicChanged = true;
+  return true;
+}
+
+bool Application::getInstanceAttributes(const unsigned int index, std::vector<VertexAttributes>& attributes)
+{
+  if (m_dynamicInstances.size() <= index)
+  {
+    std::cerr << "ERROR: getInstanceAttributes() invalid instance " << index << std::endl;
+    return false;
+  }
+
+  readInstanceAttributes(m_dynamicInstances[index].instance, attributes);
+  return true;
+}
+
+// The attributes must hold as many vertices as the Geometry, the topology stays the same.
+bool Application::setInstanceAttributes(const unsigned int index, std::vector<VertexAttributes> const& attributes)
+{
+  if (m_dynamicInstances.size() <= index)
+  {
+    std::cerr << "ERROR: setInstanceAttributes() invalid instance " << index << std::endl;
+    return false;
+  }
+
+  optix::GeometryInstance instance = m_dynamicInstances[index].instance;
+  DynamicMesh& mesh = m_dynamicMeshes[m_dynamicInstances[index].mesh];
+
+  optix::Buffer attributesBuffer = getInstanceBuffer(instance, "attributesBuffer");
+
+  RTsize numVertices = 0;
+  attributesBuffer->getSize(numVertices);
+  if (attributes.size() != numVertices)
+  {
+    std::cerr << "ERROR: setInstanceAttributes() " << attributes.size() << " vertices for a Geometry with " << numVertices << std::endl;
+    return false;
+  }
+
+  if (mesh.reference.empty())
+  {
+    // The scene creation built the Acceleration from the current vertices.
+    std::vector<VertexAttributes> current;
+    readInstanceAttributes(instance, current);
+
+    mesh.reference.resize(current.size());
+    for (size_t i = 0; i < current.size(); ++i)
+    {
+      mesh.reference[i] = current[i].vertex;
+    }
+    mesh.extent = getExtent(mesh.reference);
+#if USE_ACCELERATION_POLICY
+    if (selectAnimatedBuilder(mesh.acceleration))
+    {
+      mesh.rebuild = true; // The refit needs a BVH of the same builder.
+    }
+#endif
+  }
+
+  // Deformation magnitude against the positions of the last rebuild, not the last refit, because the refits accumulate.
+  float displacement = 0.0f;
+  for (size_t i = 0; i < attributes.size(); ++i)
+  {
+    displacement = std::max(displacement, optix::length(attributes[i].vertex - mesh.reference[i]));
+  }
+
+  if (mesh.extent * m_refitThreshold < displacement)
+  {
+    for (size_t i = 0; i < attributes.size(); ++i)
+    {
+      mesh.reference[i] = attributes[i].vertex;
+    }
+    mesh.extent  = getExtent(mesh.reference);
+    mesh.rebuild = true; // Sticks until the next updateDynamicScene(), even when a later deformation of this frame is small.
+  }
+
+#if USE_COMPACT_ATTRIBUTES
+  optix::Buffer positionsBuffer = getInstanceBuffer(instance, "positionsBuffer");
+
+  optix::float3*           positions = static_cast<optix::float3*>(positionsBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  VertexAttributesCompact* compact   = static_cast<VertexAttributesCompact*>(attributesBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+
+  parallelFor(0, int(attributes.size()), [&](const int i)
+  {
+    positions[i] = attributes[i].vertex;
+    compact[i]   = encodeVertexAttributes(attributes[i].tangent, attributes[i].normal, attributes[i].texcoord);
+  }, 16384);
+
+  attributesBuffer->unmap();
+  positionsBuffer->unmap();
+#else
+  memcpy(attributesBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD), attributes.data(), sizeof(VertexAttributes) * attributes.size());
+  attributesBuffer->unmap();
+#endif
+
+  mesh.dirty       = true;
+  m_dynamicChanged = true;
+  return true;
+}
+
+// Spins the box and waves the surface of the sphere of the demo scene. The wave keeps the original normals.
+void Application::animateDemoScene(const float seconds)
+{
+  bool demo = m_sceneFilename.empty();
+#if USE_STRESS_SCENE
+  demo = demo && m_stress.instances == 0;
+#endif
+  if (!demo || m_dynamicInstances.size() < 3)
+  {
+    return; // Scene files, generated scenes and the flattened demo scene are animated through the interface only.
+  }
+
+  const optix::Matrix4x4 spin = optix::Matrix4x4::rotate(seconds * 0.5f * M_PIf, optix::make_float3(0.0f, 1.0f, 0.0f));
+  setInstanceMatrix(1, m_dynamicInstances[1].matrixRest * spin);
+
+  if (m_animationRest.empty())
+  {
+    getInstanceAttributes(2, m_animationRest);
+  }
+
+  std::vector<VertexAttributes> attributes(m_animationRest);
+  for (size_t i = 0; i < attributes.size(); ++i)
+  {
+    VertexAttributes& attrib = attributes[i];
+    attrib.vertex += attrib.normal * (0.05f * sinf(8.0f * attrib.vertex.y + 4.0f * seconds));
+  }
+  setInstanceAttributes(2, attributes);
+}
+
+// Called by render() once per frame before the launches. Returns true when the scene changed.
+bool Application::updateDynamicScene()
+{
+  if (m_animation && !m_headless) // Batch rendering would restart forever.
+  {
+    animateDemoScene(float(m_animationTimer.getTime()));
+  }
+
+  if (!m_dynamicChanged)
+  {
+    return false;
+  }
+
+  SUTIL_NVTX_RANGE("updateDynamicScene");
+
+  for (size_t i = 0; i < m_dynamicMeshes.size(); ++i)
+  {
+    DynamicMesh& mesh = m_dynamicMeshes[i];
+    if (mesh.dirty)
+    {
+      mesh.acceleration->setProperty("refit", (mesh.rebuild) ? "0" : "1");
+      mesh.acceleration->markDirty();
+
+      if (mesh.rebuild)
+      {
+        ++m_dynamicRebuilds;
+      }
+      else
+      {
+        ++m_dynamicRefits;
+      }
+
+      mesh.dirty   = false;
+      mesh.rebuild = false;
+    }
+  }
+
+  // The instance bounds changed with the matrices or the deformed bottom level Accelerations.
+  m_rootAcceleration->markDirty();
+
+#if USE_RASTER_PRIMARY
+  m_rasterStatic = false; // The rasterized meshes and matrices were captured once.
+#endif
+
+  m_dynamicChanged = false;
+  return true;
+}
+
+#endif // USE_DYNAMIC_SCENE
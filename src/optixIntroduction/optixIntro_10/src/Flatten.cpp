@@ -0,0 +1,184 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Application.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "inc/MyAssert.h"
+
+// Reads the vertex data of the triangle Geometry of the instance back into the uncompressed VertexAttributes layout.
+void Application::readInstanceAttributes(optix::GeometryInstance instance, std::vector<VertexAttributes>& attributes)
+{
+  optix::Buffer attributesBuffer = getInstanceBuffer(instance, "attributesBuffer");
+
+  RTsize numVertices = 0;
+  attributesBuffer->getSize(numVertices);
+
+  attributes.resize(numVertices);
+
+#if USE_COMPACT_ATTRIBUTES
+  optix::Buffer positionsBuffer = getInstanceBuffer(instance, "positionsBuffer");
+
+  const optix::float3*           positions = static_cast<const optix::float3*>(positionsBuffer->map(0, RT_BUFFER_MAP_READ));
+  const VertexAttributesCompact* compact   = static_cast<const VertexAttributesCompact*>(attributesBuffer->map(0, RT_BUFFER_MAP_READ));
+
+  for (size_t i = 0; i < attributes.size(); ++i)
+  {
+    attributes[i].vertex = positions[i];
+    decodeVertexAttributes(compact[i], attributes[i].tangent, attributes[i].normal, attributes[i].texcoord);
+  }
+
+  attributesBuffer->unmap();
+  positionsBuffer->unmap();
+#else
+  memcpy(attributes.data(), attributesBuffer->map(0, RT_BUFFER_MAP_READ), sizeof(VertexAttributes) * numVertices);
+  attributesBuffer->unmap();
+#endif
+}
+
+
+// Builds a new world space Geometry from the triangle Geometry of the instance and the Transform's object to world matrix.
+optix::Geometry Application::createBakedGeometry(optix::GeometryInstance instance, optix::Matrix4x4 const& matrix)
+{
+  optix::Buffer indicesBuffer = getInstanceBuffer(instance, "indicesBuffer");
+
+  RTsize numIndices = 0;
+  indicesBuffer->getSize(numIndices);
+
+  std::vector<unsigned int> indices(numIndices * 3);
+  memcpy(indices.data(), indicesBuffer->map(0, RT_BUFFER_MAP_READ), sizeof(optix::uint3) * numIndices);
+  indicesBuffer->unmap();
+
+  std::vector<VertexAttributes> attributes;
+  readInstanceAttributes(instance, attributes);
+
+  // Normals transform with the inverse transpose.
+  const optix::Matrix4x4 matrixNormal = matrix.inverse().transpose();
+
+  for (size_t i = 0; i < attributes.size(); ++i)
+  {
+    VertexAttributes& attrib = attributes[i];
+
+    attrib.vertex  = optix::make_float3(matrix * optix::make_float4(attrib.vertex, 1.0f));
+    attrib.tangent = optix::normalize(optix::make_float3(matrix * optix::make_float4(attrib.tangent, 0.0f)));
+    attrib.normal  = optix::normalize(optix::make_float3(matrixNormal * optix::make_float4(attrib.normal, 0.0f)));
+  }
+
+  return createGeometry(attributes, indices);
+}
+
+
+// Replaces all static Transforms directly under the root Group by baking their matrix into copies of the vertex data.
+// All these GeometryInstances end up in a single GeometryGroup with one Acceleration, which removes the Transform and the
+// second level BVH traversal for them. Transforms with motion keys and all other root children are kept as they are.
+// Mind that this duplicates the vertex data of instanced meshes.
+void Application::flattenStaticInstances()
+{
+  try
+  {
+    optix::GeometryGroup ggFlat = m_context->createGeometryGroup();
+
+    unsigned int numFlat = 0;
+    unsigned int numKept = 0;
+    unsigned int numFlatPrimitives = 0;
+
+    const unsigned int count = m_rootGroup->getChildCount();
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      const RTobjecttype type = m_rootGroup->getChildType(i);
+
+      if (type == RT_OBJECTTYPE_TRANSFORM)
+      {
+        optix::Transform tr = m_rootGroup->getChild<optix::Transform>(i);
+
+        if (tr->getMotionKeyCount() <= 1 && tr->getChildType() == RT_OBJECTTYPE_GEOMETRY_GROUP)
+        {
+          float m[16];
+          float inv[16];
+          tr->getMatrix(false, m, inv);
+          const optix::Matrix4x4 matrix(m);
+
+          optix::GeometryGroup gg = tr->getChild<optix::GeometryGroup>();
+
+          for (unsigned int j = 0; j < gg->getChildCount(); ++j)
+          {
+            optix::GeometryInstance gi = gg->getChild(j);
+
+            optix::Geometry geoFlat = createBakedGeometry(gi, matrix);
+            numFlatPrimitives += geoFlat->getPrimitiveCount();
+
+            optix::GeometryInstance giFlat = m_context->createGeometryInstance();
+            setInstanceGeometry(giFlat, geoFlat);
+            giFlat->setMaterialCount(1);
+            giFlat->setMaterial(0, gi->getMaterial(0));
+            giFlat["parMaterialIndex"]->setInt(gi["parMaterialIndex"]->getInt());
+
+            ggFlat->setChildCount(numFlat + 1);
+            ggFlat->setChild(numFlat++, giFlat);
+          }
+          continue;
+        }
+        m_rootGroup->setChild(numKept++, tr);
+      }
+      else if (type == RT_OBJECTTYPE_GEOMETRY_GROUP)
+      {
+        m_rootGroup->setChild(numKept++, m_rootGroup->getChild<optix::GeometryGroup>(i));
+      }
+      else if (type == RT_OBJECTTYPE_GROUP)
+      {
+        m_rootGroup->setChild(numKept++, m_rootGroup->getChild<optix::Group>(i));
+      }
+      else
+      {
+        MY_ASSERT(!"flattenStaticInstances() unexpected root child type");
+      }
+    }
+
+    if (numFlat)
+    {
+      optix::Acceleration accFlat = createAcceleration(numFlatPrimitives, ACCELERATION_STATIC);
+      ggFlat->setAcceleration(accFlat);
+
+      m_rootGroup->setChildCount(numKept + 1);
+      m_rootGroup->setChild(numKept, ggFlat);
+    }
+    else
+    {
+      ggFlat->destroy();
+    }
+
+    std::cout << "flattenStaticInstances(): Flattened GeometryInstances = " << numFlat << ", Kept root children = " << numKept << std::endl;
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
@@ -0,0 +1,344 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Application.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "inc/MyAssert.h"
+
+#if USE_GEOMETRY_PAGING
+
+// Iterations between two read backs of the page counters.
+static const int PAGE_UPDATE_INTERVAL = 4;
+
+// Device memory assumed for the bottom level Acceleration of a resident page.
+static const size_t PAGE_BVH_BYTES_PER_TRIANGLE = 64;
+
+
+// Out-of-core scene description meshes.
+// Every mesh is a page which keeps its vertex attributes and indices in host memory. While a page is not resident, its
+// GeometryGroups hold a bounding box proxy whose anyhit program counts the rays which reached it and lets them continue.
+// updateGeometryPaging() creates the Geometry and Acceleration of the requested pages and destroys the ones of the pages
+// which rays did not hit for the longest time when the budget is exceeded.
+void Application::initGeometryPaging()
+{
+  m_pagingEpoch = 0;
+  m_pagedBytes  = 0;
+
+  m_context["parPageIndex"]->setInt(-1); // Default for all GeometryInstances which are not part of a page.
+
+  const size_t count = std::max(size_t(1), m_geometryPages.size()); // Must not be zero sized.
+
+  m_bufferPageCounters = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT2, count);
+  memset(m_bufferPageCounters->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 0, sizeof(optix::uint2) * count);
+  m_bufferPageCounters->unmap();
+  m_context["sysPageCounters"]->setBuffer(m_bufferPageCounters);
+
+  if (!m_geometryPages.empty())
+  {
+    size_t bytes = 0;
+    for (size_t i = 0; i < m_geometryPages.size(); ++i)
+    {
+      bytes += m_geometryPages[i].bytes;
+    }
+    std::cout << "initGeometryPaging(): Pages = " << m_geometryPages.size() << ", MiB = " << double(bytes) / (1024.0 * 1024.0)
+              << ", Budget MiB = " << m_geometryBudget << std::endl;
+  }
+}
+
+
+optix::Material Application::getPageProxyMaterial()
+{
+  if (!m_pageProxyMaterial)
+  {
+    std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("anyhit_page_proxy");
+    MY_ASSERT(it != m_mapOfPrograms.end());
+
+    // No closest hit programs, the proxies never report an intersection.
+    m_pageProxyMaterial = m_context->createMaterial();
+    m_pageProxyMaterial->setAnyHitProgram(0, it->second); // Radiance ray type.
+    m_pageProxyMaterial->setAnyHitProgram(1, it->second); // Shadow ray type.
+  }
+  return m_pageProxyMaterial;
+}
+
+
+// Takes over the host arrays of the mesh and builds its bounding box proxy. The page starts out non-resident.
+size_t Application::createGeometryPage(std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices)
+{
+  const size_t index = m_geometryPages.size();
+
+  m_geometryPages.push_back(GeometryPage());
+
+  GeometryPage& page = m_geometryPages.back();
+
+  page.attributes.swap(attributes);
+  page.indices.swap(indices);
+
+  optix::float3 lo = optix::make_float3( RT_DEFAULT_MAX);
+  optix::float3 hi = optix::make_float3(-RT_DEFAULT_MAX);
+  for (size_t i = 0; i < page.attributes.size(); ++i)
+  {
+    lo = optix::fminf(lo, page.attributes[i].vertex);
+    hi = optix::fmaxf(hi, page.attributes[i].vertex);
+  }
+
+  // Eight corners and twelve triangles. Only the positions matter, the proxy is never shaded.
+  std::vector<VertexAttributes> boxAttributes(8);
+  for (int i = 0; i < 8; ++i)
+  {
+    VertexAttributes& attrib = boxAttributes[i];
+
+    attrib.vertex   = optix::make_float3((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+    attrib.tangent  = optix::make_float3(1.0f, 0.0f, 0.0f);
+    attrib.normal   = optix::make_float3(0.0f, 1.0f, 0.0f);
+    attrib.texcoord = optix::make_float3(0.0f);
+  }
+
+  static const unsigned int boxIndices[36] =
+  {
+    0, 2, 1,  1, 2, 3, // -z
+    4, 5, 6,  5, 7, 6, // +z
+    0, 1, 4,  1, 5, 4, // -y
+    2, 6, 3,  3, 6, 7, // +y
+    0, 4, 2,  2, 4, 6, // -x
+    1, 3, 5,  3, 7, 5  // +x
+  };
+
+  page.proxy = m_context->createGeometryInstance();
+  setInstanceGeometry(page.proxy, createGeometry(boxAttributes, std::vector<unsigned int>(boxIndices, boxIndices + 36)));
+  page.proxy->setMaterialCount(1);
+  page.proxy->setMaterial(0, getPageProxyMaterial());
+  page.proxy["parPageIndex"]->setInt(int(index));
+
+  page.proxyAcceleration = createAcceleration(12, ACCELERATION_STATIC);
+
+#if USE_COMPACT_ATTRIBUTES
+  const size_t bytesPerVertex = sizeof(optix::float3) + sizeof(VertexAttributesCompact);
+#else
+  const size_t bytesPerVertex = sizeof(VertexAttributes);
+#endif
+  page.bytes = page.attributes.size() * bytesPerVertex +
+               page.indices.size() * sizeof(unsigned int) + (page.indices.size() / 3) * PAGE_BVH_BYTES_PER_TRIANGLE;
+
+  page.requests = 0;
+  page.lastUsed = 0;
+  page.resident = false;
+
+  return index;
+}
+
+
+// One GeometryGroup per material index of the page, below the instance Transforms of the scene description.
+optix::GeometryGroup Application::createPageGroup(const size_t index, const int materialIndex)
+{
+  GeometryPage& page = m_geometryPages[index];
+
+  optix::GeometryGroup gg = m_context->createGeometryGroup();
+  gg->setAcceleration(page.proxyAcceleration);
+  gg->setChildCount(1);
+  gg->setChild(0, page.proxy);
+
+  page.groups.push_back(gg);
+  page.materials.push_back(materialIndex);
+
+  return gg;
+}
+
+
+void Application::pageIn(const size_t index)
+{
+  GeometryPage& page = m_geometryPages[index];
+  MY_ASSERT(!page.resident);
+
+  page.geometry = createGeometry(page.attributes, page.indices);
+  m_uploader->flush(); // Rays can hit the page in the next launch.
+
+  page.acceleration = createAcceleration(page.geometry->getPrimitiveCount(), ACCELERATION_STATIC, page.builder);
+
+  for (size_t i = 0; i < page.groups.size(); ++i)
+  {
+    optix::GeometryInstance gi = m_context->createGeometryInstance();
+    setInstanceGeometry(gi, page.geometry);
+    gi->setMaterialCount(1);
+    gi->setMaterial(0, getMaterial(page.materials[i]));
+    gi["parMaterialIndex"]->setInt(page.materials[i]);
+    gi["parPageIndex"]->setInt(int(index));
+
+    page.groups[i]->setChild(0, gi);
+    page.groups[i]->setAcceleration(page.acceleration);
+  }
+
+  page.lastUsed = m_pagingEpoch; // Not evicted before rays had the chance to hit it.
+  page.resident = true;
+
+  m_pagedBytes += page.bytes;
+}
+
+
+// Destroys all device objects of the page. The GeometryGroups return to the proxy.
+void Application::pageOut(const size_t index)
+{
+  GeometryPage& page = m_geometryPages[index];
+  MY_ASSERT(page.resident);
+
+  for (size_t i = 0; i < page.groups.size(); ++i)
+  {
+    optix::GeometryInstance gi = page.groups[i]->getChild(0);
+
+    page.groups[i]->setChild(0, page.proxy);
+    page.groups[i]->setAcceleration(page.proxyAcceleration);
+
+    gi->destroy();
+  }
+
+  optix::Buffer indicesBuffer    = page.geometry["indicesBuffer"]->getBuffer();
+  optix::Buffer attributesBuffer = page.geometry["attributesBuffer"]->getBuffer();
+#if USE_COMPACT_ATTRIBUTES
+  optix::Buffer positionsBuffer  = page.geometry["positionsBuffer"]->getBuffer();
+#endif
+
+#if OPTIX_VERSION >= 60000
+  std::map<RTgeometry, optix::GeometryTriangles>::iterator itTriangles = m_mapOfGeometryTriangles.find(page.geometry->get());
+  if (itTriangles != m_mapOfGeometryTriangles.end())
+  {
+    itTriangles->second->destroy();
+    m_mapOfGeometryTriangles.erase(itTriangles);
+  }
+#endif
+
+  page.geometry->destroy();
+  page.geometry = optix::Geometry();
+
+  indicesBuffer->destroy();
+  attributesBuffer->destroy();
+#if USE_COMPACT_ATTRIBUTES
+  positionsBuffer->destroy();
+#endif
+
+  page.acceleration->destroy();
+  page.acceleration = optix::Acceleration();
+
+  page.resident = false;
+
+  m_pagedBytes -= page.bytes;
+}
+
+
+// Reads back which non-resident pages were requested and which resident pages were hit since the last call.
+// The most requested pages are paged in, evicting the least recently hit resident pages while the budget is exceeded.
+// Pages which were hit since the last read back are never evicted, so the paging cannot thrash inside one view.
+void Application::updateGeometryPaging()
+{
+  if (m_geometryPages.empty() || (m_iterationIndex % PAGE_UPDATE_INTERVAL) != 0)
+  {
+    return;
+  }
+
+  ++m_pagingEpoch;
+
+  std::vector<size_t> requested;
+
+  optix::uint2* counters = static_cast<optix::uint2*>(m_bufferPageCounters->map(0, RT_BUFFER_MAP_READ_WRITE));
+  for (size_t i = 0; i < m_geometryPages.size(); ++i)
+  {
+    GeometryPage& page = m_geometryPages[i];
+
+    page.requests = counters[i].x;
+    if (counters[i].y != 0)
+    {
+      page.lastUsed = m_pagingEpoch;
+    }
+    if (!page.resident && page.requests != 0)
+    {
+      requested.push_back(i);
+    }
+    counters[i] = optix::make_uint2(0, 0);
+  }
+  m_bufferPageCounters->unmap();
+
+  if (requested.empty())
+  {
+    return;
+  }
+
+  std::sort(requested.begin(), requested.end(), [this](const size_t a, const size_t b)
+  {
+    return m_geometryPages[b].requests < m_geometryPages[a].requests;
+  });
+
+  const size_t budget = size_t(double(m_geometryBudget) * 1024.0 * 1024.0);
+
+  unsigned int numIn  = 0;
+  unsigned int numOut = 0;
+
+  for (size_t i = 0; i < requested.size(); ++i)
+  {
+    const size_t bytes = m_geometryPages[requested[i]].bytes;
+
+    while (budget < m_pagedBytes + bytes)
+    {
+      size_t victim = m_geometryPages.size();
+      for (size_t j = 0; j < m_geometryPages.size(); ++j)
+      {
+        GeometryPage const& page = m_geometryPages[j];
+        if (page.resident && page.lastUsed < m_pagingEpoch &&
+            (victim == m_geometryPages.size() || page.lastUsed < m_geometryPages[victim].lastUsed))
+        {
+          victim = j;
+        }
+      }
+      if (victim == m_geometryPages.size())
+      {
+        break; // All resident pages are in use.
+      }
+      pageOut(victim);
+      ++numOut;
+    }
+
+    if (m_pagedBytes + bytes <= budget) // Otherwise a smaller requested page might still fit.
+    {
+      pageIn(requested[i]);
+      ++numIn;
+    }
+  }
+
+  if (numIn != 0 || numOut != 0)
+  {
+    m_rootAcceleration->markDirty();
+    restartAccumulation();
+
+    std::cout << "updateGeometryPaging(): In = " << numIn << ", Out = " << numOut
+              << ", Resident MiB = " << double(m_pagedBytes) / (1024.0 * 1024.0) << std::endl;
+  }
+}
+
+#endif // USE_GEOMETRY_PAGING
@@ -0,0 +1,356 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_LIGHT_BAKE
+
+#include <NvtxRange.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "inc/MyAssert.h"
+
+// Texture space light baking.
+//
+// The texels of the lightmap take the place of the screen pixels. The triangles of the selected root children are
+// rasterized on the host into their texture coordinates, or into one cell per triangle of an automatic unwrap, which
+// stores the world space surface point and shading normal per covered texel. raygeneration_bake() starts the paths there
+// into the cosine weighted hemisphere, runs the unchanged integrator() and accumulates the irradiance into sysOutputBuffer
+// like the screen pixels. The rasterization only covers texel centers, so the charts are dilated by LIGHT_BAKE_DILATION
+// texels afterwards to keep the bilinear lookups of the real-time clients from fetching the black background.
+
+namespace
+{
+  float edgeFunction(const optix::float2& a, const optix::float2& b, const optix::float2& p)
+  {
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+  }
+} // namespace
+
+
+void Application::initLightBake()
+{
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("raygeneration_bake");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_RENDER_BAKE, it->second);
+
+  // Placeholders until renderBake() sizes them to the lightmap.
+  m_bufferBakePositions = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, 1, 1);
+  m_bufferBakeNormals   = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, 1, 1);
+  m_context["sysBakePositions"]->setBuffer(m_bufferBakePositions);
+  m_context["sysBakeNormals"]->setBuffer(m_bufferBakeNormals);
+}
+
+
+// Collects the world space triangles of the GeometryInstances below the root child.
+void Application::getBakeTriangles(const unsigned int root, std::vector<BakeTriangle>& triangles)
+{
+  if (m_rootGroup->getChildCount() <= root)
+  {
+    std::cerr << "WARNING: getBakeTriangles() invalid root child " << root << std::endl;
+    return;
+  }
+
+  optix::Matrix4x4     matrix = optix::Matrix4x4::identity();
+  optix::GeometryGroup gg;
+
+  const RTobjecttype type = m_rootGroup->getChildType(root);
+  if (type == RT_OBJECTTYPE_TRANSFORM)
+  {
+    optix::Transform tr = m_rootGroup->getChild<optix::Transform>(root);
+    if (tr->getChildType() == RT_OBJECTTYPE_GEOMETRY_GROUP)
+    {
+      float m[16];
+      float inv[16];
+      tr->getMatrix(false, m, inv); // The first motion key of animated Transforms.
+      matrix = optix::Matrix4x4(m);
+      gg = tr->getChild<optix::GeometryGroup>();
+    }
+  }
+  else if (type == RT_OBJECTTYPE_GEOMETRY_GROUP)
+  {
+    gg = m_rootGroup->getChild<optix::GeometryGroup>(root);
+  }
+
+  if (!gg)
+  {
+    std::cerr << "WARNING: getBakeTriangles() root child " << root << " is no Transform over a GeometryGroup or a GeometryGroup" << std::endl;
+    return;
+  }
+
+  // Normals transform with the inverse transpose.
+  const optix::Matrix4x4 matrixNormal = matrix.inverse().transpose();
+
+  for (unsigned int j = 0; j < gg->getChildCount(); ++j)
+  {
+    optix::GeometryInstance instance = gg->getChild(j);
+
+    optix::Buffer indicesBuffer = getInstanceBuffer(instance, "indicesBuffer");
+
+    RTsize numIndices = 0;
+    indicesBuffer->getSize(numIndices);
+
+    std::vector<optix::uint3> indices(numIndices);
+    memcpy(indices.data(), indicesBuffer->map(0, RT_BUFFER_MAP_READ), sizeof(optix::uint3) * numIndices);
+    indicesBuffer->unmap();
+
+    std::vector<VertexAttributes> attributes;
+    readInstanceAttributes(instance, attributes);
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+      const unsigned int index[3] = { indices[i].x, indices[i].y, indices[i].z };
+
+      BakeTriangle tri;
+      for (int k = 0; k < 3; ++k)
+      {
+        const VertexAttributes& attrib = attributes[index[k]];
+
+        tri.position[k] = optix::make_float3(matrix * optix::make_float4(attrib.vertex, 1.0f));
+        tri.normal[k]   = optix::normalize(optix::make_float3(matrixNormal * optix::make_float4(attrib.normal, 0.0f)));
+        tri.texel[k]    = optix::make_float2(attrib.texcoord.x * float(m_width), attrib.texcoord.y * float(m_height));
+      }
+      triangles.push_back(tri);
+    }
+  }
+}
+
+
+void Application::renderBake(std::vector<unsigned int> const& roots, const bool unwrap, const int spp, const double seconds, std::string const& filename)
+{
+  std::vector<BakeTriangle> triangles;
+  for (size_t i = 0; i < roots.size(); ++i)
+  {
+    getBakeTriangles(roots[i], triangles);
+  }
+  if (triangles.empty())
+  {
+    std::cerr << "ERROR: renderBake() No triangles to bake." << std::endl;
+    return;
+  }
+
+  if (unwrap)
+  {
+    // Every triangle gets its own square cell with one texel of gutter, as the lower left half of that cell.
+    const int cells = int(ceilf(sqrtf(float(triangles.size()))));
+    const int cellWidth  = m_width  / cells;
+    const int cellHeight = m_height / cells;
+    if (cellWidth < 4 || cellHeight < 4)
+    {
+      std::cerr << "ERROR: renderBake() The " << m_width << "x" << m_height << " lightmap is too small to unwrap " << triangles.size() << " triangles." << std::endl;
+      return;
+    }
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+      const optix::float2 origin = optix::make_float2(float(int(i) % cells * cellWidth + 1), float(int(i) / cells * cellHeight + 1));
+
+      triangles[i].texel[0] = origin;
+      triangles[i].texel[1] = origin + optix::make_float2(float(cellWidth - 2), 0.0f);
+      triangles[i].texel[2] = origin + optix::make_float2(0.0f, float(cellHeight - 2));
+    }
+  }
+
+#if USE_RESTIR
+  if (m_restir)
+  {
+    // The reservoirs are indexed by the projection of the primary hits onto the screen, which doesn't exist here.
+    std::cerr << "WARNING: renderBake() ReSTIR is not supported for light baking. Disabled." << std::endl;
+    setRestir(false);
+  }
+#endif
+
+  finishTextures(); // Offline results must not contain placeholder texels.
+
+  // Rasterize the texel centers. Overlapping texture coordinates keep the last triangle.
+  std::vector<optix::float4> positions(m_width * m_height, optix::make_float4(0.0f));
+  std::vector<optix::float4> normals(m_width * m_height, optix::make_float4(0.0f));
+
+  for (size_t i = 0; i < triangles.size(); ++i)
+  {
+    const BakeTriangle& tri = triangles[i];
+
+    const float area = edgeFunction(tri.texel[0], tri.texel[1], tri.texel[2]);
+    if (fabsf(area) < 1.0e-6f)
+    {
+      continue; // Degenerate in texture space.
+    }
+
+    // World size of one texel for the ray cone width.
+    const float worldArea = optix::length(optix::cross(tri.position[1] - tri.position[0], tri.position[2] - tri.position[0]));
+    const float texelSize = sqrtf(worldArea / fabsf(area));
+
+    const int x0 = std::max(0,            int(floorf(std::min(tri.texel[0].x, std::min(tri.texel[1].x, tri.texel[2].x)))));
+    const int x1 = std::min(m_width  - 1, int(ceilf( std::max(tri.texel[0].x, std::max(tri.texel[1].x, tri.texel[2].x)))));
+    const int y0 = std::max(0,            int(floorf(std::min(tri.texel[0].y, std::min(tri.texel[1].y, tri.texel[2].y)))));
+    const int y1 = std::min(m_height - 1, int(ceilf( std::max(tri.texel[0].y, std::max(tri.texel[1].y, tri.texel[2].y)))));
+
+    for (int y = y0; y <= y1; ++y)
+    {
+      for (int x = x0; x <= x1; ++x)
+      {
+        const optix::float2 p = optix::make_float2(float(x) + 0.5f, float(y) + 0.5f);
+
+        const float b0 = edgeFunction(tri.texel[1], tri.texel[2], p) / area;
+        const float b1 = edgeFunction(tri.texel[2], tri.texel[0], p) / area;
+        const float b2 = 1.0f - b0 - b1;
+        if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+        {
+          continue;
+        }
+
+        const optix::float3 position = b0 * tri.position[0] + b1 * tri.position[1] + b2 * tri.position[2];
+        const optix::float3 normal   = optix::normalize(b0 * tri.normal[0] + b1 * tri.normal[1] + b2 * tri.normal[2]);
+
+        positions[y * m_width + x] = optix::make_float4(position, 1.0f);
+        normals[y * m_width + x]   = optix::make_float4(normal, texelSize);
+      }
+    }
+  }
+
+  m_bufferBakePositions->setSize(m_width, m_height);
+  m_bufferBakeNormals->setSize(m_width, m_height);
+  memcpy(m_bufferBakePositions->map(0, RT_BUFFER_MAP_WRITE_DISCARD), positions.data(), sizeof(optix::float4) * positions.size());
+  m_bufferBakePositions->unmap();
+  memcpy(m_bufferBakeNormals->map(0, RT_BUFFER_MAP_WRITE_DISCARD), normals.data(), sizeof(optix::float4) * normals.size());
+  m_bufferBakeNormals->unmap();
+
+#if USE_GPU_LOCAL_ACCUMULATION
+  if (m_localAccumulation)
+  {
+    // Accumulate into the same per-device buffers as the screen, resolveAccumulation() merges them.
+    optix::Program programBake = m_mapOfPrograms["raygeneration_bake"];
+    programBake["sysOutputBuffer"]->setBuffer(m_bufferLocalOutput);
+#if USE_DENOISER && !USE_DENOISER_GBUFFER
+#if USE_DENOISER_ALBEDO
+    programBake["sysAlbedoBuffer"]->setBuffer(m_bufferLocalAlbedo);
+#if USE_DENOISER_NORMAL
+    programBake["sysNormalBuffer"]->setBuffer(m_bufferLocalNormal);
+#endif
+#endif
+#endif
+  }
+#endif
+
+  restartAccumulation();
+
+  Timer timer;
+  timer.start();
+
+  bool finished = false;
+  while (!finished)
+  {
+    SUTIL_NVTX_RANGE("bake");
+
+    m_context["sysIterationIndex"]->setInt(m_iterationIndex); // 0 fills the buffer, accumulation starts at 1.
+    m_context->launch(ENTRY_RENDER_BAKE, m_width, m_height);
+    ++m_iterationIndex;
+
+    finished = (0 < spp && spp <= m_iterationIndex) || (0.0 < seconds && seconds <= timer.getTime());
+  }
+
+  resolveAccumulation();
+
+  std::cout << "renderBake(): " << triangles.size() << " triangles, " << m_iterationIndex << " samples per texel in " << timer.getTime() << " seconds" << std::endl;
+
+  // Dilation: each pass fills the empty texels next to covered ones with the mean of their covered neighbours.
+  RTsize pitch;
+  RTsize rows;
+  m_bufferOutput->getSize(pitch, rows);
+
+  std::vector<optix::float4> image(m_width * m_height);
+  std::vector<unsigned char> covered(m_width * m_height);
+
+  optix::float4* data = static_cast<optix::float4*>(m_bufferOutput->map());
+  for (int y = 0; y < m_height; ++y)
+  {
+    for (int x = 0; x < m_width; ++x)
+    {
+      image[y * m_width + x]   = data[y * pitch + x];
+      covered[y * m_width + x] = (positions[y * m_width + x].w != 0.0f) ? 1 : 0;
+    }
+  }
+
+  for (int pass = 0; pass < LIGHT_BAKE_DILATION; ++pass)
+  {
+    std::vector<optix::float4>  dilated(image);
+    std::vector<unsigned char>  grown(covered);
+
+    for (int y = 0; y < m_height; ++y)
+    {
+      for (int x = 0; x < m_width; ++x)
+      {
+        if (covered[y * m_width + x])
+        {
+          continue;
+        }
+        optix::float4 sum   = optix::make_float4(0.0f);
+        float         count = 0.0f;
+        for (int j = std::max(0, y - 1); j <= std::min(m_height - 1, y + 1); ++j)
+        {
+          for (int i = std::max(0, x - 1); i <= std::min(m_width - 1, x + 1); ++i)
+          {
+            if (covered[j * m_width + i])
+            {
+              sum   += image[j * m_width + i];
+              count += 1.0f;
+            }
+          }
+        }
+        if (0.0f < count)
+        {
+          dilated[y * m_width + x] = sum / count;
+          grown[y * m_width + x]   = 1;
+        }
+      }
+    }
+    image.swap(dilated);
+    covered.swap(grown);
+  }
+
+  for (int y = 0; y < m_height; ++y)
+  {
+    for (int x = 0; x < m_width; ++x)
+    {
+      data[y * pitch + x] = image[y * m_width + x];
+    }
+  }
+  m_bufferOutput->unmap();
+
+  // Texel (0, 0) is texture coordinate (0, 0), the bottom row first order of the image files matches the OpenGL textures.
+  sutil::writeBuffersToFile(filename.c_str(), m_bufferOutput, optix::Buffer(), optix::Buffer());
+  std::cerr << "Wrote lightmap " << filename << std::endl;
+
+  m_bufferBakePositions->setSize(1, 1); // Release the texel data.
+  m_bufferBakeNormals->setSize(1, 1);
+}
+
+#endif // USE_LIGHT_BAKE
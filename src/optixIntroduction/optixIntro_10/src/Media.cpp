@@ -0,0 +1,486 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#if USE_HETEROGENEOUS_MEDIA
+
+#include "inc/Application.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Heterogeneous participating media inside the closed geometry of materials.
+// Each --medium stretches a density grid over the world space bounding box of all GeometryInstances using its material.
+// The megakernel samples the collisions inside with delta tracking against a coarse grid of majorants, see shaders/medium.h.
+// The grid either comes from a Mitsuba .vol file with float32 encoding (the first channel is used, its own bounding box
+// is ignored) or is a procedural smoke puff. The grid values are normalized to [0, 1], the density scales them.
+
+namespace
+{
+  // The object to world matrix of a Transform. Motion blurred Transforms contribute their first matrix key.
+  optix::Matrix4x4 transformMatrix(optix::Transform tr)
+  {
+    if (1 < tr->getMotionKeyCount())
+    {
+      optix::Matrix4x4 m = optix::Matrix4x4::identity(); // SRT keys would need the composition, they keep the identity.
+      if (tr->getMotionKeyType() == RT_MOTIONKEYTYPE_MATRIX_FLOAT12)
+      {
+        std::vector<float> keys(tr->getMotionKeyCount() * 12);
+        tr->getMotionKeys(keys.data());
+        memcpy(m.getData(), keys.data(), sizeof(float) * 12);
+      }
+      return m;
+    }
+    float data[16];
+    float inverse[16];
+    tr->getMatrix(false, data, inverse);
+    return optix::Matrix4x4(data);
+  }
+
+  // Collects all GeometryInstances below the Group with their object to world matrices.
+  void gatherMediaInstances(optix::Group group, optix::Matrix4x4 const& matrix,
+                            std::vector< std::pair<optix::GeometryInstance, optix::Matrix4x4> >& instances)
+  {
+    for (unsigned int i = 0; i < group->getChildCount(); ++i)
+    {
+      RTobjecttype     type = group->getChildType(i);
+      optix::Matrix4x4 m    = matrix;
+
+      optix::Transform tr;
+      if (type == RT_OBJECTTYPE_TRANSFORM)
+      {
+        tr = group->getChild<optix::Transform>(i);
+        while (tr)
+        {
+          m = m * transformMatrix(tr);
+          type = tr->getChildType();
+          if (type != RT_OBJECTTYPE_TRANSFORM)
+          {
+            break;
+          }
+          tr = tr->getChild<optix::Transform>();
+        }
+      }
+
+      if (type == RT_OBJECTTYPE_GEOMETRY_GROUP)
+      {
+        optix::GeometryGroup gg = (tr) ? tr->getChild<optix::GeometryGroup>() : group->getChild<optix::GeometryGroup>(i);
+        for (unsigned int j = 0; j < gg->getChildCount(); ++j)
+        {
+          instances.push_back(std::make_pair(gg->getChild(j), m));
+        }
+      }
+      else if (type == RT_OBJECTTYPE_GROUP)
+      {
+        gatherMediaInstances((tr) ? tr->getChild<optix::Group>() : group->getChild<optix::Group>(i), m, instances);
+      }
+    }
+  }
+
+
+  float hashLattice(const int x, const int y, const int z)
+  {
+    unsigned int h = unsigned(x) * 73856093u ^ unsigned(y) * 19349663u ^ unsigned(z) * 83492791u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return float(h ^ (h >> 16)) * (1.0f / 4294967296.0f);
+  }
+
+  // Trilinear value noise with a smoothstep fade.
+  float valueNoise(const float x, const float y, const float z)
+  {
+    const int   ix = int(floorf(x));
+    const int   iy = int(floorf(y));
+    const int   iz = int(floorf(z));
+    const float fx = x - float(ix);
+    const float fy = y - float(iy);
+    const float fz = z - float(iz);
+    const float u  = fx * fx * (3.0f - 2.0f * fx);
+    const float v  = fy * fy * (3.0f - 2.0f * fy);
+    const float w  = fz * fz * (3.0f - 2.0f * fz);
+
+    float c[2][2];
+    for (int j = 0; j < 2; ++j)
+    {
+      for (int k = 0; k < 2; ++k)
+      {
+        c[j][k] = optix::lerp(hashLattice(ix, iy + j, iz + k), hashLattice(ix + 1, iy + j, iz + k), u);
+      }
+    }
+    return optix::lerp(optix::lerp(c[0][0], c[1][0], v), optix::lerp(c[0][1], c[1][1], v), w);
+  }
+
+  // Four octaves of noise carved into a sphere with a soft edge, sparse enough that the majorants skip the empty corners.
+  void createSmoke(const int size, std::vector<float>& grid)
+  {
+    grid.resize(size_t(size) * size * size);
+
+    for (int z = 0; z < size; ++z)
+    {
+      for (int y = 0; y < size; ++y)
+      {
+        for (int x = 0; x < size; ++x)
+        {
+          const float px = (float(x) + 0.5f) / float(size);
+          const float py = (float(y) + 0.5f) / float(size);
+          const float pz = (float(z) + 0.5f) / float(size);
+
+          float noise     = 0.0f;
+          float amplitude = 0.5f;
+          float frequency = 4.0f;
+          for (int octave = 0; octave < 4; ++octave)
+          {
+            noise     += amplitude * valueNoise(px * frequency, py * frequency, pz * frequency);
+            amplitude *= 0.5f;
+            frequency *= 2.0f;
+          }
+
+          const float r       = 2.0f * sqrtf((px - 0.5f) * (px - 0.5f) + (py - 0.5f) * (py - 0.5f) + (pz - 0.5f) * (pz - 0.5f));
+          const float falloff = optix::clamp((1.0f - r) * 3.0f, 0.0f, 1.0f);
+
+          grid[(size_t(z) * size + y) * size + x] = std::max(0.0f, noise * 2.0f - 0.6f) * falloff;
+        }
+      }
+    }
+  }
+
+  // Mitsuba 0.6 grid volume: "VOL", version 3, int32 encoding (1 == float32), int32 xres, yres, zres, channels,
+  // six float bounding box values, then the data with x fastest and the channels interleaved.
+  bool loadVol(std::string const& filename, int& xres, int& yres, int& zres, std::vector<float>& grid)
+  {
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file)
+    {
+      std::cerr << "ERROR: loadVol() can't open " << filename << std::endl;
+      return false;
+    }
+
+    char magic[4];
+    int  header[5]; // encoding, xres, yres, zres, channels
+    float bbox[6];
+    file.read(magic, 4);
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    file.read(reinterpret_cast<char*>(bbox), sizeof(bbox));
+
+    if (!file || strncmp(magic, "VOL", 3) != 0 || magic[3] != 3 || header[0] != 1 ||
+        header[1] <= 0 || header[2] <= 0 || header[3] <= 0 || header[4] <= 0)
+    {
+      std::cerr << "ERROR: loadVol() " << filename << " is not a float32 grid volume" << std::endl;
+      return false;
+    }
+
+    xres = header[1];
+    yres = header[2];
+    zres = header[3];
+
+    const size_t voxels   = size_t(xres) * yres * zres;
+    const int    channels = header[4];
+
+    std::vector<float> data(voxels * channels);
+    file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float));
+    if (!file)
+    {
+      std::cerr << "ERROR: loadVol() " << filename << " is truncated" << std::endl;
+      return false;
+    }
+
+    grid.resize(voxels);
+    for (size_t i = 0; i < voxels; ++i)
+    {
+      grid[i] = std::max(0.0f, data[i * channels]);
+    }
+    return true;
+  }
+}
+
+
+bool Application::setMedia(std::vector<std::string> const& configs)
+{
+  m_mediumConfigs.clear();
+
+  for (size_t i = 0; i < configs.size(); ++i)
+  {
+    std::vector<std::string> tokens;
+
+    std::istringstream stream(configs[i]);
+    std::string token;
+    while (std::getline(stream, token, ','))
+    {
+      tokens.push_back(token);
+    }
+
+    // material,density,albedo,anisotropy or material,density,r,g,b,anisotropy, each with an optional filename.
+    const bool rgb = (6 <= tokens.size());
+
+    const size_t count = (rgb) ? 6 : 4;
+    if (tokens.size() < count || count + 1 < tokens.size())
+    {
+      std::cerr << "ERROR: setMedia() invalid --medium " << configs[i] << std::endl;
+      return false;
+    }
+
+    MediumConfig config;
+
+    config.material   = atoi(tokens[0].c_str());
+    config.density    = std::max(0.0f, float(atof(tokens[1].c_str())));
+    config.albedo     = (rgb) ? optix::make_float3(float(atof(tokens[2].c_str())), float(atof(tokens[3].c_str())), float(atof(tokens[4].c_str())))
+                              : optix::make_float3(float(atof(tokens[2].c_str())));
+    config.albedo     = optix::clamp(config.albedo, 0.0f, 1.0f);
+    config.anisotropy = optix::clamp(float(atof(tokens[count - 1].c_str())), -0.99f, 0.99f);
+    if (count < tokens.size())
+    {
+      config.filename = tokens[count];
+    }
+
+    if (config.material < 0 || int(m_guiMaterialParameters.size()) <= config.material)
+    {
+      std::cerr << "ERROR: setMedia() material " << config.material << " doesn't exist" << std::endl;
+      return false;
+    }
+
+    m_mediumConfigs.push_back(config);
+  }
+
+  initMedia();
+  restartAccumulation();
+  return true;
+}
+
+
+void Application::destroyMedia()
+{
+  for (size_t i = 0; i < m_mediumDensities.size(); ++i)
+  {
+    optix::Buffer buffer = m_mediumDensities[i]->getBuffer();
+    m_mediumDensities[i]->destroy();
+    buffer->destroy();
+  }
+  m_mediumDensities.clear();
+
+  for (size_t i = 0; i < m_mediumMajorants.size(); ++i)
+  {
+    m_mediumMajorants[i]->destroy();
+  }
+  m_mediumMajorants.clear();
+
+  m_mediumDefinitions.clear();
+
+  for (size_t i = 0; i < m_guiMaterialParameters.size(); ++i)
+  {
+    m_guiMaterialParameters[i].medium = -1;
+  }
+}
+
+
+void Application::initMedia()
+{
+  destroyMedia();
+
+  try
+  {
+    if (!m_bufferMedia)
+    {
+      m_bufferMedia = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+      m_bufferMedia->setElementSize(sizeof(MediumDefinition));
+      m_bufferMedia->setSize(1); // The dummy element is never read.
+      m_context["sysMedia"]->setBuffer(m_bufferMedia);
+    }
+
+    if (!m_mediumConfigs.empty())
+    {
+      // The world space bounds of the volume of each material.
+      std::vector<optix::float3> boundsMin(m_guiMaterialParameters.size(), optix::make_float3( RT_DEFAULT_MAX));
+      std::vector<optix::float3> boundsMax(m_guiMaterialParameters.size(), optix::make_float3(-RT_DEFAULT_MAX));
+
+      std::vector< std::pair<optix::GeometryInstance, optix::Matrix4x4> > instances;
+      gatherMediaInstances(m_rootGroup, optix::Matrix4x4::identity(), instances);
+
+      for (size_t i = 0; i < instances.size(); ++i)
+      {
+        optix::GeometryInstance instance = instances[i].first;
+
+        const int material = instance["parMaterialIndex"]->getInt();
+        if (material < 0 || int(boundsMin.size()) <= material)
+        {
+          continue;
+        }
+
+#if USE_COMPACT_ATTRIBUTES
+        optix::Buffer vertexBuffer = getInstanceBuffer(instance, "positionsBuffer"); // float3
+#else
+        optix::Buffer vertexBuffer = getInstanceBuffer(instance, "attributesBuffer"); // VertexAttributes with the position first.
+#endif
+        RTsize numVertices = 0;
+        vertexBuffer->getSize(numVertices);
+        const size_t stride = vertexBuffer->getElementSize();
+
+        const unsigned char* data = static_cast<const unsigned char*>(vertexBuffer->map(0, RT_BUFFER_MAP_READ));
+        for (RTsize v = 0; v < numVertices; ++v)
+        {
+          optix::float3 p;
+          memcpy(&p, data + v * stride, sizeof(optix::float3));
+
+          const optix::float3 w = optix::make_float3(instances[i].second * optix::make_float4(p, 1.0f));
+
+          boundsMin[material] = optix::fminf(boundsMin[material], w);
+          boundsMax[material] = optix::fmaxf(boundsMax[material], w);
+        }
+        vertexBuffer->unmap();
+      }
+
+      for (size_t i = 0; i < m_mediumConfigs.size(); ++i)
+      {
+        MediumConfig const& config = m_mediumConfigs[i];
+
+        if (int(m_guiMaterialParameters.size()) <= config.material || boundsMax[config.material].x < boundsMin[config.material].x)
+        {
+          std::cerr << "WARNING: initMedia() material " << config.material << " is not used by any geometry, medium ignored" << std::endl;
+          continue;
+        }
+        if (0 <= m_guiMaterialParameters[config.material].medium)
+        {
+          std::cerr << "WARNING: initMedia() material " << config.material << " has more than one medium, the first is used" << std::endl;
+          continue;
+        }
+
+        int xres = MEDIUM_DENSITY_SIZE;
+        int yres = MEDIUM_DENSITY_SIZE;
+        int zres = MEDIUM_DENSITY_SIZE;
+
+        std::vector<float> grid;
+        if (config.filename.empty() || !loadVol(config.filename, xres, yres, zres, grid))
+        {
+          xres = yres = zres = MEDIUM_DENSITY_SIZE;
+          createSmoke(MEDIUM_DENSITY_SIZE, grid);
+        }
+
+        const float maxValue = *std::max_element(grid.begin(), grid.end());
+        if (0.0f < maxValue)
+        {
+          for (size_t j = 0; j < grid.size(); ++j)
+          {
+            grid[j] /= maxValue;
+          }
+        }
+
+        optix::Buffer buffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, xres, yres, zres);
+        memcpy(buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD), grid.data(), grid.size() * sizeof(float));
+        buffer->unmap();
+
+        optix::TextureSampler sampler = m_context->createTextureSampler();
+        sampler->setWrapMode(0, RT_WRAP_CLAMP_TO_EDGE);
+        sampler->setWrapMode(1, RT_WRAP_CLAMP_TO_EDGE);
+        sampler->setWrapMode(2, RT_WRAP_CLAMP_TO_EDGE);
+        sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+        sampler->setIndexingMode(RT_TEXTURE_INDEX_NORMALIZED_COORDINATES);
+        sampler->setReadMode(RT_TEXTURE_READ_ELEMENT_TYPE);
+        sampler->setMaxAnisotropy(1.0f);
+        sampler->setBuffer(buffer);
+
+        // The maximum of the voxels each majorant cell touches, widened by one voxel for the trilinear filter footprint.
+        optix::Buffer majorants = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, MEDIUM_MAJORANT_GRID * MEDIUM_MAJORANT_GRID * MEDIUM_MAJORANT_GRID);
+
+        float* dst = static_cast<float*>(majorants->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+        for (int cz = 0; cz < MEDIUM_MAJORANT_GRID; ++cz)
+        {
+          const int z0 = std::max(0,        cz      * zres / MEDIUM_MAJORANT_GRID - 1);
+          const int z1 = std::min(zres - 1, (cz + 1) * zres / MEDIUM_MAJORANT_GRID + 1);
+          for (int cy = 0; cy < MEDIUM_MAJORANT_GRID; ++cy)
+          {
+            const int y0 = std::max(0,        cy      * yres / MEDIUM_MAJORANT_GRID - 1);
+            const int y1 = std::min(yres - 1, (cy + 1) * yres / MEDIUM_MAJORANT_GRID + 1);
+            for (int cx = 0; cx < MEDIUM_MAJORANT_GRID; ++cx)
+            {
+              const int x0 = std::max(0,        cx      * xres / MEDIUM_MAJORANT_GRID - 1);
+              const int x1 = std::min(xres - 1, (cx + 1) * xres / MEDIUM_MAJORANT_GRID + 1);
+
+              float majorant = 0.0f;
+              for (int z = z0; z <= z1; ++z)
+              {
+                for (int y = y0; y <= y1; ++y)
+                {
+                  for (int x = x0; x <= x1; ++x)
+                  {
+                    majorant = std::max(majorant, grid[(size_t(z) * yres + y) * xres + x]);
+                  }
+                }
+              }
+              *dst++ = majorant;
+            }
+          }
+        }
+        majorants->unmap();
+
+        MediumDefinition definition;
+
+        memset(&definition, 0, sizeof(MediumDefinition));
+        definition.boundsMin  = boundsMin[config.material];
+        definition.boundsMax  = boundsMax[config.material];
+        definition.densityID  = sampler->getId();
+        definition.majorantID = majorants->getId();
+        definition.albedo     = config.albedo;
+        definition.density    = config.density;
+        definition.anisotropy = config.anisotropy;
+
+        m_guiMaterialParameters[config.material].medium = int(m_mediumDefinitions.size());
+
+        m_mediumDefinitions.push_back(definition);
+        m_mediumDensities.push_back(sampler);
+        m_mediumMajorants.push_back(majorants);
+
+        std::cout << "initMedia(): material " << config.material << " grid " << xres << " x " << yres << " x " << zres << std::endl;
+      }
+    }
+
+    updateMedia();
+    updateMaterialParameters();
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+
+void Application::updateMedia()
+{
+  MY_ASSERT((sizeof(MediumDefinition) & 15) == 0); // Verify float4 alignment.
+
+  m_bufferMedia->setSize(std::max(size_t(1), m_mediumDefinitions.size()));
+  if (!m_mediumDefinitions.empty())
+  {
+    memcpy(m_bufferMedia->map(0, RT_BUFFER_MAP_WRITE_DISCARD), m_mediumDefinitions.data(), sizeof(MediumDefinition) * m_mediumDefinitions.size());
+    m_bufferMedia->unmap();
+  }
+}
+
+#endif // USE_HETEROGENEOUS_MEDIA
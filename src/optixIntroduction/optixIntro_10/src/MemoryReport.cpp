@@ -0,0 +1,259 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Application.h"
+
+#include <iostream>
+#include <sstream>
+
+
+// Collects the sizes of all OptiX objects the Application owns. The scene geometry and its Accelerations
+// are found by walking the scene graph, so nothing needs to be registered when the objects are created.
+void Application::updateMemoryTracker()
+{
+  m_memoryTracker.clear();
+
+  try
+  {
+    std::vector<optix::GeometryGroup> geometryGroups;
+    gatherGeometryGroups(m_rootGroup, geometryGroups);
+
+    m_memoryTracker.addAcceleration(m_rootAcceleration, "root");
+
+    for (size_t i = 0; i < geometryGroups.size(); ++i)
+    {
+      std::ostringstream name;
+      name << "group" << i;
+
+      optix::GeometryGroup geometryGroup = geometryGroups[i];
+      m_memoryTracker.addAcceleration(geometryGroup->getAcceleration(), name.str());
+
+      for (unsigned int j = 0; j < geometryGroup->getChildCount(); ++j)
+      {
+        optix::GeometryInstance instance = geometryGroup->getChild(j);
+#if OPTIX_VERSION >= 60000
+        if (m_geometryTriangles)
+        {
+          m_memoryTracker.addVariables(MEMORY_GEOMETRY, instance->getGeometryTriangles(), name.str());
+        }
+        else
+#endif
+        {
+          m_memoryTracker.addVariables(MEMORY_GEOMETRY, instance->getGeometry(), name.str());
+        }
+        m_memoryTracker.addVariables(MEMORY_OTHER, instance, name.str());
+      }
+    }
+
+    m_memoryTracker.addTextureSampler(MEMORY_TEXTURE, m_environmentTexture.getSampler(), "environment");
+    m_memoryTracker.addBuffer(MEMORY_TEXTURE, m_environmentTexture.getBufferCDF_U(), "environmentCDF_U");
+    m_memoryTracker.addBuffer(MEMORY_TEXTURE, m_environmentTexture.getBufferCDF_V(), "environmentCDF_V");
+    m_memoryTracker.addBuffer(MEMORY_TEXTURE, m_environmentTexture.getBufferAlias(), "environmentAlias");
+    m_memoryTracker.addTextureSampler(MEMORY_TEXTURE, m_textureAlbedo.getSampler(), "albedo");
+    m_memoryTracker.addTextureSampler(MEMORY_TEXTURE, m_textureCutout.getSampler(), "cutout");
+#if USE_VIRTUAL_TEXTURES
+    std::vector<optix::Buffer> virtualBuffers;
+    m_virtualAlbedo.getBuffers(virtualBuffers);
+    for (size_t i = 0; i < virtualBuffers.size(); ++i)
+    {
+      std::ostringstream name;
+      name << "virtualAlbedo" << i;
+      m_memoryTracker.addBuffer(MEMORY_TEXTURE, virtualBuffers[i], name.str());
+    }
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferVirtualTextures, "virtualTextures");
+#endif
+#if USE_STRESS_SCENE
+    for (size_t i = 0; i < m_stressTextures.size(); ++i)
+    {
+      std::ostringstream name;
+      name << "stress" << i;
+      m_memoryTracker.addTextureSampler(MEMORY_TEXTURE, m_stressTextures[i], name.str());
+    }
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+    for (size_t i = 0; i < m_mediumDensities.size(); ++i)
+    {
+      std::ostringstream name;
+      name << "medium" << i;
+      m_memoryTracker.addTextureSampler(MEMORY_TEXTURE, m_mediumDensities[i], name.str());
+      m_memoryTracker.addBuffer(MEMORY_OTHER, m_mediumMajorants[i], name.str() + "Majorants");
+    }
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferMedia, "media");
+#endif
+
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferOutput, "output");
+#if USE_HALF_DISPLAY
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferDisplayHalf, "displayHalf");
+#endif
+#if USE_RENDER_SERVER
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferEncode, "encode");
+#endif
+#if USE_DEVICE_TONEMAP
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferTonemap, "tonemap");
+#endif
+#if USE_GPU_LOCAL_ACCUMULATION
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferLocalOutput, "localOutput");
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferLocalAlbedo, "localAlbedo");
+#if USE_DENOISER_NORMAL
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferLocalNormal, "localNormal");
+#endif
+#endif
+#endif
+#if USE_PREVIEW_RESOLUTION
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferPreview, "preview");
+#endif
+#if USE_ADAPTIVE_SAMPLING
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferMoment, "moment");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferTileError, "tileError");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferActiveTiles, "activeTiles");
+#endif
+#if USE_REPROJECTION
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferPosition, "position");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferSampleCount, "sampleCount");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferHistoryOutput, "historyOutput");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferHistoryPosition, "historyPosition");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferHistoryCount, "historyCount");
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferHistoryAlbedo, "historyAlbedo");
+#endif
+#endif
+#if USE_RASTER_PRIMARY
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferRasterDistance, "rasterDistance");
+#endif
+#if USE_RESTIR
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferReservoirs[0], "reservoirs0");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferReservoirs[1], "reservoirs1");
+#endif
+#if USE_VISIBILITY_CACHE
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferVisibilityCounts, "visibilityCounts");
+#endif
+#if USE_WEDGE
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferWedge, "wedge");
+#endif
+#if USE_RADIANCE_CACHE
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferCacheKeys, "cacheKeys");
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferCacheAccum, "cacheAccum");
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferCacheValue, "cacheValue");
+#endif
+#if USE_MULTI_VIEW
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferViews, "views");
+#endif
+#if USE_PATH_STATISTICS
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferPathStatistics, "pathStatistics");
+#endif
+#if USE_RAY_COUNTERS
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferRayCounters, "rayCounters");
+#endif
+#if USE_AOVS
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferAovIds, "aovIds");
+    for (size_t i = 0; i < m_bufferAovs.size(); ++i)
+    {
+      m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferAovs[i], std::string("aov.") + getAovName(int(i))); // Null for the disabled AOVs.
+    }
+#endif
+#if USE_COST_HEATMAP
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferCost, "cost");
+#endif
+#if USE_WAVEFRONT
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferWavefrontPaths, "wavefrontPaths");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferWavefrontCounter, "wavefrontCounter");
+    m_memoryTracker.addBuffer(MEMORY_FRAMEBUFFER, m_bufferWavefrontRadiance, "wavefrontRadiance");
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferWavefrontAlbedo, "wavefrontAlbedo");
+#if USE_DENOISER_NORMAL
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferWavefrontNormal, "wavefrontNormal");
+#endif
+#endif
+#endif
+
+#if USE_DENOISER
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferDenoised, "denoised");
+#if USE_DENOISER_CONVERGENCE
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferDenoisedPrevious, "denoisedPrevious");
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferDenoisedChange, "denoisedChange");
+#endif
+#if USE_DENOISER_TILES
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferDenoiserTileInput, "denoiserTileInput");
+#if USE_DENOISER_ALBEDO
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferDenoiserTileAlbedo, "denoiserTileAlbedo");
+#if USE_DENOISER_NORMAL
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferDenoiserTileNormal, "denoiserTileNormal");
+#endif
+#endif
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferDenoiserTileOutput, "denoiserTileOutput");
+#endif
+#if USE_DENOISER_ALBEDO
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferAlbedo, "albedo");
+#if USE_DENOISER_NORMAL
+    m_memoryTracker.addBuffer(MEMORY_DENOISER, m_bufferNormals, "normals");
+#endif
+#endif
+#endif
+
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferMaterialParameters, "materialParameters");
+#if USE_WEDGE
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferWedgeMaterials, "wedgeMaterials");
+#endif
+#if USE_INCREMENTAL_MATERIALS
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferMaterialUpdates, "materialUpdates");
+#endif
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferLensShader, "lensShader");
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferApertureTable, "apertureTable");
+#if USE_FILTER_IMPORTANCE_SAMPLING
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferFilterTable, "filterTable");
+#endif
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferSampleBSDF, "sampleBSDF");
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferEvalBSDF, "evalBSDF");
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferSampleLight, "sampleLight");
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferLightDefinitions, "lightDefinitions");
+    m_memoryTracker.addBuffer(MEMORY_OTHER, m_bufferLightAliasTable, "lightAliasTable");
+#if USE_MESH_LIGHTS
+    for (size_t i = 0; i < m_meshLightBuffers.size(); ++i)
+    {
+      m_memoryTracker.addBuffer(MEMORY_GEOMETRY, m_meshLightBuffers[i], "meshLight");
+    }
+#endif
+
+    m_memoryTracker.queryDevices(m_context);
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+void Application::setMemoryReportFilename(std::string const& filename)
+{
+  m_memoryReportFilename = filename;
+  if (!m_memoryReportFilename.empty())
+  {
+    updateMemoryTracker();
+    m_memoryTracker.write(m_memoryReportFilename);
+  }
+}
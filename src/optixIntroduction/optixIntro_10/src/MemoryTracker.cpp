@@ -0,0 +1,262 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/MemoryTracker.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+static const char* categoryNames[NUMBER_OF_MEMORY_CATEGORIES] =
+{
+  "geometry",
+  "acceleration",
+  "texture",
+  "framebuffer",
+  "denoiser",
+  "other"
+};
+
+
+MemoryTracker::MemoryTracker()
+{
+  clear();
+}
+
+void MemoryTracker::clear()
+{
+  m_handles.clear();
+  m_entries.clear();
+  m_devices.clear();
+  for (int i = 0; i < NUMBER_OF_MEMORY_CATEGORIES; ++i)
+  {
+    m_bytes[i] = 0;
+  }
+}
+
+void MemoryTracker::add(const MemoryCategory category, const void* handle, std::string const& name, const size_t bytes)
+{
+  if (!m_handles.insert(handle).second)
+  {
+    return; // Shared buffers, like the vertex attributes of instanced Geometry, are only counted once.
+  }
+
+  Entry entry;
+
+  entry.category = category;
+  entry.name     = name;
+  entry.bytes    = bytes;
+
+  m_entries.push_back(entry);
+  m_bytes[category] += bytes;
+}
+
+// Sums all mipmap levels. The extents of block-compressed buffers are in blocks, the element size is the one of a block.
+size_t MemoryTracker::getBufferBytes(optix::Buffer buffer)
+{
+  const size_t       elementSize    = buffer->getElementSize();
+  const unsigned int dimensionality = buffer->getDimensionality();
+  const unsigned int levels         = std::max(1u, buffer->getMipLevelCount());
+
+  size_t bytes = 0;
+  for (unsigned int level = 0; level < levels; ++level)
+  {
+    RTsize width  = 1;
+    RTsize height = 1;
+    RTsize depth  = 1;
+    switch (dimensionality)
+    {
+    case 1:
+      buffer->getMipLevelSize(level, width);
+      break;
+    case 2:
+      buffer->getMipLevelSize(level, width, height);
+      break;
+    case 3:
+      buffer->getMipLevelSize(level, width, height, depth);
+      break;
+    }
+    bytes += size_t(width) * size_t(height) * size_t(depth) * elementSize;
+  }
+  return bytes;
+}
+
+void MemoryTracker::addBuffer(const MemoryCategory category, optix::Buffer buffer, std::string const& name)
+{
+  if (!buffer)
+  {
+    return;
+  }
+  try
+  {
+    add(category, buffer->get(), name, getBufferBytes(buffer));
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << "MemoryTracker::addBuffer() " << name << ": " << e.getErrorString() << std::endl;
+  }
+}
+
+void MemoryTracker::addTextureSampler(const MemoryCategory category, optix::TextureSampler sampler, std::string const& name)
+{
+  if (!sampler)
+  {
+    return;
+  }
+  addBuffer(category, sampler->getBuffer(), name);
+}
+
+// OptiX doesn't report the device size of an Acceleration. The serialized data of a built one is the closest measure.
+void MemoryTracker::addAcceleration(optix::Acceleration acceleration, std::string const& name)
+{
+  if (!acceleration)
+  {
+    return;
+  }
+  size_t bytes = 0;
+  try
+  {
+    if (!acceleration->isDirty())
+    {
+      bytes = acceleration->getDataSize();
+    }
+  }
+  catch(optix::Exception&)
+  {
+    bytes = 0; // Not all builders support the serialization.
+  }
+  add(MEMORY_ACCELERATION, acceleration->get(), name, bytes);
+}
+
+void MemoryTracker::queryDevices(optix::Context context)
+{
+  m_devices.clear();
+  try
+  {
+    const std::vector<int> devices = context->getEnabledDevices();
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+      Device device;
+
+      device.name      = context->getDeviceName(devices[i]);
+      device.available = context->getAvailableDeviceMemory(devices[i]);
+
+      RTsize total = 0;
+      if (rtDeviceGetAttribute(devices[i], RT_DEVICE_ATTRIBUTE_TOTAL_MEMORY, sizeof(RTsize), &total) != RT_SUCCESS)
+      {
+        total = 0;
+      }
+      device.total = total;
+
+      m_devices.push_back(device);
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << "MemoryTracker::queryDevices() " << e.getErrorString() << std::endl;
+  }
+}
+
+size_t MemoryTracker::getBytes(const MemoryCategory category) const
+{
+  return m_bytes[category];
+}
+
+size_t MemoryTracker::getTotalBytes() const
+{
+  size_t bytes = 0;
+  for (int i = 0; i < NUMBER_OF_MEMORY_CATEGORIES; ++i)
+  {
+    bytes += m_bytes[i];
+  }
+  return bytes;
+}
+
+unsigned int MemoryTracker::getNumberOfDevices() const
+{
+  return static_cast<unsigned int>(m_devices.size());
+}
+
+std::string const& MemoryTracker::getDeviceName(const unsigned int index) const
+{
+  return m_devices[index].name;
+}
+
+size_t MemoryTracker::getDeviceTotalBytes(const unsigned int index) const
+{
+  return m_devices[index].total;
+}
+
+size_t MemoryTracker::getDeviceAvailableBytes(const unsigned int index) const
+{
+  return m_devices[index].available;
+}
+
+const char* MemoryTracker::getCategoryName(const MemoryCategory category)
+{
+  return categoryNames[category];
+}
+
+bool MemoryTracker::write(std::string const& filename) const
+{
+  std::ofstream stream(filename.c_str());
+  if (!stream)
+  {
+    std::cerr << "ERROR: MemoryTracker::write() failed to open " << filename << std::endl;
+    return false;
+  }
+
+  const double mebibyte = 1.0 / (1024.0 * 1024.0);
+
+  stream << std::fixed << std::setprecision(3);
+
+  for (size_t i = 0; i < m_devices.size(); ++i)
+  {
+    stream << "# device" << i << ": " << m_devices[i].name << ", " 
+           << double(m_devices[i].available) * mebibyte << " of " << double(m_devices[i].total) * mebibyte << " MiB available\n";
+  }
+  for (int i = 0; i < NUMBER_OF_MEMORY_CATEGORIES; ++i)
+  {
+    stream << "# " << categoryNames[i] << ": " << double(m_bytes[i]) * mebibyte << " MiB\n";
+  }
+  stream << "# total: " << double(getTotalBytes()) * mebibyte << " MiB\n";
+
+  std::vector<Entry> entries(m_entries);
+  std::stable_sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) { return b.bytes < a.bytes; });
+
+  stream << "category,name,bytes\n";
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    stream << categoryNames[entries[i].category] << "," << entries[i].name << "," << entries[i].bytes << "\n";
+  }
+
+  std::cout << "MemoryTracker wrote " << entries.size() << " objects to " << filename << std::endl;
+  return true;
+}
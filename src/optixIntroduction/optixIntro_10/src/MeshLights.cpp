@@ -0,0 +1,155 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#if USE_MESH_LIGHTS
+
+#include "inc/Application.h"
+
+#include "inc/AliasTable.h"
+
+#include <cstring>
+#include <iostream>
+
+// Emissive triangle meshes placed with the light statement of the scene description.
+// The emission is constant over a mesh light, so the power of each triangle is proportional to its area.
+// The next event estimation selects the mesh light with the light alias table first, then one of its triangles
+// with a per light alias table over the triangle areas and a uniform point on it, which is a uniform sample of the mesh area.
+// Hits on the mesh are handled by the light material like the parallelogram lights, with the geometric normal as emitting side.
+void Application::createMeshLights()
+{
+  for (size_t i = 0; i < m_meshLights.size(); ++i)
+  {
+    MeshLight const& meshLight = m_meshLights[i];
+
+    const size_t numTriangles = meshLight.indices.size() / 3;
+    if (numTriangles == 0)
+    {
+      continue;
+    }
+
+    std::vector<optix::float3> triangles(numTriangles * 3);
+    std::vector<float>         areas(numTriangles);
+
+    optix::float3 centroid = optix::make_float3(0.0f);
+    float         area     = 0.0f;
+
+    for (size_t t = 0; t < numTriangles; ++t)
+    {
+      const optix::float3 v0 = meshLight.attributes[meshLight.indices[t * 3    ]].vertex;
+      const optix::float3 v1 = meshLight.attributes[meshLight.indices[t * 3 + 1]].vertex;
+      const optix::float3 v2 = meshLight.attributes[meshLight.indices[t * 3 + 2]].vertex;
+
+      triangles[t * 3    ] = v0;
+      triangles[t * 3 + 1] = v1;
+      triangles[t * 3 + 2] = v2;
+
+      areas[t] = 0.5f * optix::length(optix::cross(v1 - v0, v2 - v0));
+
+      centroid += areas[t] * (v0 + v1 + v2) / 3.0f;
+      area     += areas[t];
+    }
+
+    if (area <= 0.0f)
+    {
+      std::cerr << "WARNING: createMeshLights() mesh light " << i << " has no area, ignored" << std::endl;
+      continue;
+    }
+
+    std::vector<float>        threshold;
+    std::vector<unsigned int> alias;
+    buildAliasTable(areas, threshold, alias);
+
+    optix::Buffer bufferTriangles = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, triangles.size());
+    memcpy(bufferTriangles->map(0, RT_BUFFER_MAP_WRITE_DISCARD), triangles.data(), sizeof(optix::float3) * triangles.size());
+    bufferTriangles->unmap();
+
+    optix::Buffer bufferAlias = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+    bufferAlias->setElementSize(sizeof(LightAlias));
+    bufferAlias->setSize(numTriangles);
+
+    LightAlias* table = static_cast<LightAlias*>(bufferAlias->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    for (size_t t = 0; t < numTriangles; ++t)
+    {
+      table[t].threshold = threshold[t];
+      table[t].alias     = int(alias[t]);
+    }
+    bufferAlias->unmap();
+
+    m_meshLightBuffers.push_back(bufferTriangles);
+    m_meshLightBuffers.push_back(bufferAlias);
+
+    LightDefinition light;
+    memset(&light, 0, sizeof(LightDefinition));
+
+    light.type      = LIGHT_MESH;
+    light.position  = centroid / area; // Only used for the light selection weight.
+    light.vecU      = optix::make_float3(1.0f, 0.0f, 0.0f);
+    light.vecV      = optix::make_float3(0.0f, 1.0f, 0.0f);
+    light.normal    = optix::make_float3(0.0f, 0.0f, 1.0f);
+    light.area      = area;
+    light.emission  = meshLight.emission;
+    light.idEnvironmentTexture = RT_TEXTURE_ID_NULL;
+    light.idEnvironmentCDF_U   = RT_BUFFER_ID_NULL;
+    light.idEnvironmentCDF_V   = RT_BUFFER_ID_NULL;
+    light.idEnvironmentAlias   = RT_BUFFER_ID_NULL;
+    light.environmentIntegral  = 1.0f;
+    light.pdfSelection         = 1.0f; // Set in buildLightAliasTable().
+#if USE_CUBEMAP_ENVIRONMENT
+    light.environmentSize      = 0;
+#endif
+    light.idMeshTriangles      = bufferTriangles->getId();
+    light.idMeshAlias          = bufferAlias->getId();
+
+    const int lightIndex = int(m_lightDefinitions.size()); // This becomes the mesh's parLightIndex value.
+    m_lightDefinitions.push_back(light);
+
+    // The mesh itself, in world space below the root like the parallelogram lights.
+    optix::Geometry geometry = createGeometry(meshLight.attributes, meshLight.indices);
+
+    optix::GeometryInstance gi = m_context->createGeometryInstance();
+    setInstanceGeometry(gi, geometry);
+    gi->setMaterialCount(1);
+    gi->setMaterial(0, m_lightMaterial);
+    gi["parLightIndex"]->setInt(lightIndex);
+
+    optix::GeometryGroup gg = m_context->createGeometryGroup();
+    gg->setAcceleration(createAcceleration(geometry->getPrimitiveCount(), ACCELERATION_STATIC));
+    gg->setChildCount(1);
+    gg->setChild(0, gi);
+
+    const unsigned int count = m_rootGroup->getChildCount();
+    m_rootGroup->setChildCount(count + 1);
+    m_rootGroup->setChild(count, gg);
+
+    std::cout << "createMeshLights(): Light " << lightIndex << ", Triangles = " << numTriangles << ", Area = " << area << std::endl;
+  }
+}
+
+#endif // USE_MESH_LIGHTS
@@ -0,0 +1,184 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#if USE_MESH_LOD
+
+#include "inc/Application.h"
+
+#include <Mesh.h>
+
+#include <algorithm>
+#include <iostream>
+
+// Mesh levels of detail for the scene description instances.
+// The coarser levels are made by sutil vertex clustering with halving grid resolutions, a level is only kept when it
+// at least halves the triangles of the previous one. The kept vertices are original ones, so the attributes carry over.
+// The selection runs on the host on camera changes, never per ray: each instance attaches the GeometryGroup of the
+// coarsest level whose clustering cells, scaled into world space, project to at most m_lodError pixels at the distance
+// of its bounding sphere. All instances of a mesh and material share the GeometryGroups of every level.
+
+void Application::createMeshLods(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices, std::string const& builder, MeshLodChain& chain)
+{
+  chain.levels.clear();
+
+  const int numVertices  = int(attributes.size());
+  const int numTriangles = int(indices.size() / 3);
+  if (numTriangles < 2 * MESH_LOD_MIN_TRIANGLES)
+  {
+    return;
+  }
+
+  std::vector<float> positions(size_t(numVertices) * 3);
+  optix::float3 bboxLo = attributes[0].vertex;
+  optix::float3 bboxHi = attributes[0].vertex;
+  for (int i = 0; i < numVertices; ++i)
+  {
+    const optix::float3 v = attributes[i].vertex;
+    positions[i * 3    ] = v.x;
+    positions[i * 3 + 1] = v.y;
+    positions[i * 3 + 2] = v.z;
+    bboxLo = optix::fminf(bboxLo, v);
+    bboxHi = optix::fmaxf(bboxHi, v);
+  }
+  chain.center = 0.5f * (bboxLo + bboxHi);
+  chain.radius = 0.5f * optix::length(bboxHi - bboxLo);
+
+  const optix::float3 extents = bboxHi - bboxLo;
+  const float         extent  = std::max(extents.x, std::max(extents.y, extents.z));
+
+  std::vector<int> source(indices.begin(), indices.end());
+  std::vector<int> simplified(indices.size());
+
+  int previous = numTriangles;
+  for (int resolution = 1024; 2 <= resolution && int(chain.levels.size()) < MESH_LOD_LEVELS - 1; resolution /= 2)
+  {
+    const int count = simplifyMesh(positions.data(), numVertices, source.data(), numTriangles, resolution, simplified.data());
+    if (count < MESH_LOD_MIN_TRIANGLES)
+    {
+      break;
+    }
+    if (previous / 2 < count)
+    {
+      continue; // Too close to the previous level to be worth another Acceleration.
+    }
+
+    // Compact the vertices the level still references.
+    std::vector<int>              remap(numVertices, -1);
+    std::vector<VertexAttributes> levelAttributes;
+    std::vector<unsigned int>     levelIndices(size_t(count) * 3);
+    for (int i = 0; i < count * 3; ++i)
+    {
+      int& index = remap[simplified[i]];
+      if (index < 0)
+      {
+        index = int(levelAttributes.size());
+        levelAttributes.push_back(attributes[simplified[i]]);
+      }
+      levelIndices[i] = static_cast<unsigned int>(index);
+    }
+
+    MeshLodLevel level;
+
+    level.geometry     = createGeometry(levelAttributes, levelIndices);
+    level.acceleration = createAcceleration(level.geometry->getPrimitiveCount(), ACCELERATION_STATIC, builder);
+    level.cellSize     = extent / float(resolution);
+
+    chain.levels.push_back(level);
+    previous = count;
+
+    std::cout << "createMeshLods(): Level " << chain.levels.size() << ": Vertices = " << levelAttributes.size() << ", Triangles = " << count << std::endl;
+  }
+}
+
+void Application::addLodInstance(optix::Transform transform, optix::Matrix4x4 const& matrix, MeshLodChain const& chain, std::vector<optix::GeometryGroup> const& groups)
+{
+  // The largest axis scale is conservative for the non-uniformly scaled instances.
+  const float scale = std::max(optix::length(optix::make_float3(matrix[0], matrix[4], matrix[8])),
+                      std::max(optix::length(optix::make_float3(matrix[1], matrix[5], matrix[9])),
+                               optix::length(optix::make_float3(matrix[2], matrix[6], matrix[10]))));
+
+  LodInstance instance;
+
+  instance.transform = transform;
+  instance.groups    = groups;
+  instance.cellSizes.push_back(0.0f);
+  for (size_t i = 0; i < chain.levels.size(); ++i)
+  {
+    instance.cellSizes.push_back(chain.levels[i].cellSize * scale);
+  }
+  instance.center = optix::make_float3(matrix * optix::make_float4(chain.center, 1.0f));
+  instance.radius = chain.radius * scale;
+  instance.level  = 0; // The loader attached the full resolution mesh.
+
+  m_lodInstances.push_back(instance);
+}
+
+void Application::updateMeshLod(optix::float3 const& cameraPosition, optix::float3 const& cameraV)
+{
+  if (m_lodInstances.empty() || m_lodError <= 0.0f)
+  {
+    return;
+  }
+
+  // Pixels per world unit at unit distance. The length of cameraV is the tangent of half the vertical field of view.
+  const float pixelsPerUnit = 0.5f * float(m_height) / optix::length(cameraV);
+
+  unsigned int switched = 0;
+  for (size_t i = 0; i < m_lodInstances.size(); ++i)
+  {
+    LodInstance& instance = m_lodInstances[i];
+
+    // Distance to the nearest point of the bounding sphere. Inside it the full resolution is used.
+    const float distance = optix::length(instance.center - cameraPosition) - instance.radius;
+
+    int level = 0;
+    if (0.0f < distance)
+    {
+      const float maxCellSize = m_lodError * distance / pixelsPerUnit;
+      while (level + 1 < int(instance.cellSizes.size()) && instance.cellSizes[level + 1] <= maxCellSize)
+      {
+        ++level;
+      }
+    }
+
+    if (level != instance.level)
+    {
+      instance.transform->setChild(instance.groups[level]);
+      instance.level = level;
+      ++switched;
+    }
+  }
+
+  if (switched != 0)
+  {
+    m_rootAcceleration->markDirty(); // The coarser levels can have slightly smaller bounds.
+  }
+}
+
+#endif // USE_MESH_LOD
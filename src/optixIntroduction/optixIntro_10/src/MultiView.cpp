@@ -0,0 +1,162 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_MULTI_VIEW
+
+#include <algorithm>
+
+// Batched rendering of several pinhole views in one launch.
+//
+// ENTRY_RENDER_VIEWS is a 3D launch over (view width, view height, number of views). Each view reads its camera from
+// sysViews and accumulates into its own sub-rectangle of the regular output buffers, so the display, denoiser, screenshots
+// and checkpoints see one image holding all views. One launch instead of one per view shares the fixed launch overhead,
+// and the views' rays traverse the same scene data in the same kernel.
+//
+// MULTI_VIEW_STEREO renders the left and right eye side by side. The eyes are offset by m_stereoSeparation along the
+// camera's U axis and look parallel, which converges at infinity like most VR displays expect.
+// MULTI_VIEW_CUBEMAP renders the six 90 degree faces in the layout of the cubemap lens shader, see lens_shader_type.h.
+
+void Application::initMultiView()
+{
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("raygeneration_views");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_RENDER_VIEWS, it->second);
+
+  m_bufferViews = m_context->createBuffer(RT_BUFFER_INPUT);
+  m_bufferViews->setFormat(RT_FORMAT_USER);
+  m_bufferViews->setElementSize(sizeof(ViewDefinition));
+  m_bufferViews->setSize(MULTI_VIEW_MAX_VIEWS);
+  m_context["sysViews"]->setBuffer(m_bufferViews);
+
+  m_viewsDirty = true;
+}
+
+void Application::setMultiView(const int mode, const float separation)
+{
+  m_multiView        = std::max(MULTI_VIEW_OFF, std::min(MULTI_VIEW_CUBEMAP, mode));
+  m_stereoSeparation = std::max(0.0f, separation);
+  m_viewsDirty       = true;
+}
+
+// The GPU local accumulation buffers are only bound to the ENTRY_RENDER program.
+bool Application::isMultiViewSupported() const
+{
+  return m_multiView != MULTI_VIEW_OFF && !m_localAccumulation;
+}
+
+// Called by render() before the launches of an iteration. Rebuilds the views after camera, resolution or mode changes.
+// Returns false when the iteration is rendered by the single view launches.
+bool Application::updateViews()
+{
+  if (!isMultiViewSupported())
+  {
+    return false;
+  }
+  if (!m_viewsDirty)
+  {
+    return true;
+  }
+
+  optix::float3 P;
+  optix::float3 U;
+  optix::float3 V;
+  optix::float3 W;
+
+  m_pinholeCamera.getFrustum(P, U, V, W);
+
+  ViewDefinition* views = static_cast<ViewDefinition*>(m_bufferViews->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+
+  if (m_multiView == MULTI_VIEW_STEREO)
+  {
+    // Each eye gets half the width, so its U covers half the horizontal field of view of the single view.
+    m_viewSize  = optix::make_uint2((m_width + 1) / 2, m_height);
+    m_viewCount = 2;
+
+    const optix::float3 offset = optix::normalize(U) * (m_stereoSeparation * 0.5f);
+
+    for (unsigned int i = 0; i < m_viewCount; ++i)
+    {
+      views[i].origin   = optix::make_uint2(i * m_viewSize.x, 0);
+      views[i].position = (i == 0) ? P - offset : P + offset;
+      views[i].U        = U * 0.5f;
+      views[i].V        = V;
+      views[i].W        = W;
+    }
+  }
+  else // MULTI_VIEW_CUBEMAP
+  {
+    // The faces cover the screen even when its aspect ratio isn't 3:2, like the cubemap lens shader.
+    m_viewSize  = optix::make_uint2((m_width  + CUBEMAP_FACE_COLUMNS - 1) / CUBEMAP_FACE_COLUMNS,
+                                    (m_height + CUBEMAP_FACE_ROWS    - 1) / CUBEMAP_FACE_ROWS);
+    m_viewCount = CUBEMAP_FACE_COLUMNS * CUBEMAP_FACE_ROWS;
+
+    const optix::float3 u = optix::normalize(U);
+    const optix::float3 v = optix::normalize(V);
+    const optix::float3 w = optix::normalize(W);
+
+    // Forward, right and up axis per face in reading order. Must match lens_shader_cubemap().
+    const optix::float3 faces[MULTI_VIEW_MAX_VIEWS][3] =
+    {
+      {  u, -w,  v }, // right
+      { -u,  w,  v }, // left
+      {  v,  u, -w }, // up
+      { -v,  u,  w }, // down
+      {  w,  u,  v }, // front
+      { -w, -u,  v }  // back
+    };
+
+    for (unsigned int i = 0; i < m_viewCount; ++i)
+    {
+      const unsigned int column = i % CUBEMAP_FACE_COLUMNS;
+      const unsigned int row    = CUBEMAP_FACE_ROWS - 1 - i / CUBEMAP_FACE_COLUMNS; // 0 is the bottom row.
+
+      views[i].origin   = optix::make_uint2(column * m_viewSize.x, row * m_viewSize.y);
+      views[i].position = P;
+      views[i].W        = faces[i][0];
+      views[i].U        = faces[i][1]; // 90 degrees: unit length U and V at unit distance W.
+      views[i].V        = faces[i][2];
+    }
+  }
+
+  m_bufferViews->unmap();
+
+  m_viewsDirty = false;
+  return true;
+}
+
+void Application::renderViews()
+{
+  m_context->launch(ENTRY_RENDER_VIEWS, m_viewSize.x, m_viewSize.y, m_viewCount);
+}
+
+#endif // USE_MULTI_VIEW
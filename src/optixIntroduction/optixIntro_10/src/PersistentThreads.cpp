@@ -0,0 +1,103 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_PERSISTENT_THREADS
+
+#include <algorithm>
+#include <iostream>
+
+#include "inc/MyAssert.h"
+
+// Persistent threads for the megakernel path tracer.
+//
+// With one thread per pixel a warp stays resident until its longest path ended, and the lanes of the paths which missed or
+// were terminated by Russian Roulette early idle meanwhile. raygeneration_persistent() instead launches only
+// m_persistentThreads per streaming multiprocessor, which is about what fits resident, and each thread takes the next pixel
+// from the global sysPersistentCounter as soon as the previous one was accumulated. Other than the wavefront path tracer
+// no path state leaves the registers between the path segments.
+// The pixels and their random sequences are the same as with ENTRY_RENDER, only the order in which they are rendered changes.
+//
+// The counter is never reset. Each launch hands out the items [sysPersistentBase, sysPersistentBase + pixels) and each thread
+// increments it once more to find out that it's done, so the host knows the base of the next launch without a read back.
+
+void Application::initPersistentThreads()
+{
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("raygeneration_persistent");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_RENDER_PERSISTENT, it->second);
+
+  // Only meaningful on a single device, see isPersistentSupported(). Lives in that device's memory then.
+  m_bufferPersistentCounter = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+  unsigned int* counter = static_cast<unsigned int*>(m_bufferPersistentCounter->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  counter[0] = 0;
+  m_bufferPersistentCounter->unmap();
+  m_context["sysPersistentCounter"]->setBuffer(m_bufferPersistentCounter);
+
+  m_persistentBase = 0;
+  m_context["sysPersistentBase"]->setUint(m_persistentBase);
+
+  const std::vector<int> devices = m_context->getEnabledDevices();
+
+  m_persistentMultiprocessors = 0;
+  if (!devices.empty())
+  {
+    RT_CHECK_ERROR_NO_CONTEXT(rtDeviceGetAttribute(devices[0], RT_DEVICE_ATTRIBUTE_MULTIPROCESSOR_COUNT, sizeof(m_persistentMultiprocessors), &m_persistentMultiprocessors));
+  }
+}
+
+void Application::setPersistentThreads(const int threadsPerMultiprocessor)
+{
+  m_persistentThreads = std::max(0, threadsPerMultiprocessor);
+
+  if (0 < m_persistentThreads && m_context->getEnabledDeviceCount() != 1)
+  {
+    std::cerr << "WARNING: Persistent threads require a single device. Using one thread per pixel instead." << std::endl;
+  }
+}
+
+bool Application::isPersistentSupported() const
+{
+  return 0 < m_persistentThreads && 0 < m_persistentMultiprocessors && m_context->getEnabledDeviceCount() == 1;
+}
+
+// Called by render() and benchmark() instead of the ENTRY_RENDER launch.
+void Application::renderPersistent()
+{
+  const unsigned int pixels  = m_width * m_height;
+  const unsigned int threads = std::min(pixels, (unsigned int) (m_persistentMultiprocessors * m_persistentThreads)); // Not more threads than pixels.
+
+  m_context["sysPersistentBase"]->setUint(m_persistentBase);
+  m_context->launch(ENTRY_RENDER_PERSISTENT, threads);
+
+  m_persistentBase += pixels + threads; // Unsigned wrap around is intended, the device subtracts the base the same way.
+}
+
+#endif // USE_PERSISTENT_THREADS
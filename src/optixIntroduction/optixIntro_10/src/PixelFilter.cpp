@@ -0,0 +1,169 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#if USE_FILTER_IMPORTANCE_SAMPLING
+
+#include "inc/Application.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Filter importance sampling: Instead of splatting each sample with its filter weight into the neighbouring pixels,
+// the sub-pixel offsets of the primary rays are drawn from the normalized pixel filter. The running average of the
+// samples is then an unbiased estimate of the filtered image for the non-negative filters here, at no extra cost per ray.
+// The 1D filter is inverted at FILTER_TABLE_SIZE + 1 points, the device interpolates linearly between them per axis.
+
+// Resolution of the filter integration from which the table is derived.
+#define FILTER_CELLS (16 * FILTER_TABLE_SIZE)
+
+// Default radius in pixels per filter when the --filter argument has none.
+static const float defaultFilterRadius[NUMBER_OF_PIXEL_FILTERS] = { 0.5f, 1.0f, 1.5f, 2.0f };
+
+// 1D filter value at offset x in [-radius, radius] from the pixel center, unnormalized.
+static float evaluateFilter(const int filter, const float x, const float radius)
+{
+  switch (filter)
+  {
+    case PIXEL_FILTER_TENT:
+      return std::max(0.0f, radius - fabsf(x));
+
+    case PIXEL_FILTER_GAUSSIAN:
+    {
+      const float sigma = radius / 3.0f; // Shifted down to reach zero at the radius.
+      return std::max(0.0f, expf(-x * x / (2.0f * sigma * sigma)) - expf(-4.5f));
+    }
+
+    case PIXEL_FILTER_BLACKMAN_HARRIS:
+    {
+      const float t = (x + radius) / (2.0f * radius) * 2.0f * M_PIf; // [0, 2 * pi] across the window.
+      return std::max(0.0f, 0.35875f - 0.48829f * cosf(t) + 0.14128f * cosf(2.0f * t) - 0.01168f * cosf(3.0f * t));
+    }
+  }
+  return 1.0f; // PIXEL_FILTER_BOX
+}
+
+
+bool Application::setPixelFilter(std::string const& config)
+{
+  const size_t comma = config.find(',');
+  const std::string name = config.substr(0, comma);
+
+  int filter = NUMBER_OF_PIXEL_FILTERS;
+  if (name == "box")
+  {
+    filter = PIXEL_FILTER_BOX;
+  }
+  else if (name == "tent")
+  {
+    filter = PIXEL_FILTER_TENT;
+  }
+  else if (name == "gaussian")
+  {
+    filter = PIXEL_FILTER_GAUSSIAN;
+  }
+  else if (name == "blackmanharris")
+  {
+    filter = PIXEL_FILTER_BLACKMAN_HARRIS;
+  }
+  else
+  {
+    std::cerr << "ERROR: setPixelFilter() unknown filter '" << name << "'" << std::endl;
+    return false;
+  }
+
+  m_pixelFilter  = filter;
+  m_filterRadius = (comma != std::string::npos) ? float(atof(config.c_str() + comma + 1)) : defaultFilterRadius[filter];
+
+  updateFilterTable();
+  restartAccumulation();
+  return true;
+}
+
+
+void Application::updateFilterTable()
+{
+  m_filterRadius = std::max(0.05f, m_filterRadius);
+
+  // Piecewise linear CDF over the cells of the filter support, evaluated at the cell centers.
+  std::vector<float> cdf(FILTER_CELLS + 1);
+  cdf[0] = 0.0f;
+  for (int i = 0; i < FILTER_CELLS; ++i)
+  {
+    const float x = ((float(i) + 0.5f) / float(FILTER_CELLS) * 2.0f - 1.0f) * m_filterRadius;
+    cdf[i + 1] = cdf[i] + evaluateFilter(m_pixelFilter, x, m_filterRadius);
+  }
+  const float sum = cdf[FILTER_CELLS];
+  for (int i = 1; i <= FILTER_CELLS; ++i)
+  {
+    cdf[i] = (0.0f < sum) ? cdf[i] / sum : float(i) / float(FILTER_CELLS);
+  }
+  cdf[FILTER_CELLS] = 1.0f; // Exact end for the inversion.
+
+  m_filterTable.resize(FILTER_TABLE_SIZE + 1);
+  for (int i = 0; i <= FILTER_TABLE_SIZE; ++i)
+  {
+    const float u = float(i) / float(FILTER_TABLE_SIZE);
+
+    float position = float(FILTER_CELLS); // u == 1.0f
+    if (u < 1.0f)
+    {
+      const size_t cell = std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin() - 1; // cdf[cell] <= u < cdf[cell + 1]
+      position = float(cell) + (u - cdf[cell]) / (cdf[cell + 1] - cdf[cell]);
+    }
+    m_filterTable[i] = (position / float(FILTER_CELLS) * 2.0f - 1.0f) * m_filterRadius;
+  }
+
+  try
+  {
+    float* table = static_cast<float*>(m_bufferFilterTable->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    memcpy(table, m_filterTable.data(), sizeof(float) * m_filterTable.size());
+    m_bufferFilterTable->unmap();
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
+// Host side filterPixelSample() in shaders/pixel_filter.h for the rasterized primary jitter.
+optix::float2 Application::filterPixelSample(const optix::float2 sample) const
+{
+  const float s = sample.x * float(FILTER_TABLE_SIZE);
+  const float t = sample.y * float(FILTER_TABLE_SIZE);
+  const int   x = std::min(int(s), FILTER_TABLE_SIZE - 1);
+  const int   y = std::min(int(t), FILTER_TABLE_SIZE - 1);
+
+  return optix::make_float2(0.5f + optix::lerp(m_filterTable[x], m_filterTable[x + 1], s - float(x)),
+                            0.5f + optix::lerp(m_filterTable[y], m_filterTable[y + 1], t - float(y)));
+}
+
+#endif // USE_FILTER_IMPORTANCE_SAMPLING
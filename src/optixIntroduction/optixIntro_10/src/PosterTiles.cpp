@@ -0,0 +1,240 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_POSTER_TILES
+
+#include <NvtxRange.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// Poster resolution rendering.
+//
+// The Application was constructed at the tile size plus POSTER_TILE_OVERLAP on each side, so all per pixel buffers, the
+// denoiser and its guide buffers only ever hold one tile. The camera keeps the aspect ratio of the whole poster and
+// sysPosterOffset selects the tile's sub-rectangle, see getPosterPixel() in raygeneration.cu. Each tile is accumulated
+// and denoised on its own, the overlap gives the denoiser the surrounding context and is cropped before the inner tile
+// is written into its rows of the *.pfm file. Nothing but one row of the image is ever held on the host.
+
+namespace
+{
+  // A *.pfm file whose rows are written in any order. The header has a known length, so every pixel has a fixed file
+  // offset before the image is complete. Rows go bottom up like the OptiX buffers.
+  class PosterFile
+  {
+  public:
+    PosterFile()
+    : m_file(nullptr)
+    , m_width(0)
+    , m_header(0)
+    {
+    }
+
+    ~PosterFile()
+    {
+      close();
+    }
+
+    bool open(std::string const& filename, const int width, const int height)
+    {
+      m_file = fopen(filename.c_str(), "wb");
+      if (!m_file)
+      {
+        return false;
+      }
+      const unsigned int one = 1;
+      const bool littleEndian = (*reinterpret_cast<const unsigned char*>(&one) == 1);
+      fprintf(m_file, "PF\n%d %d\n%s\n", width, height, (littleEndian) ? "-1.0" : "1.0"); // Negative scale == little endian.
+      m_header = ftell(m_file);
+      m_width  = width;
+      return (0 < m_header);
+    }
+
+    // Writes count RGB pixels starting at pixel x of row y.
+    bool writeRow(const int x, const int y, const float* rgb, const int count)
+    {
+      const unsigned long long offset = (unsigned long long) m_header + ((unsigned long long) y * m_width + x) * 3 * sizeof(float);
+#ifdef _WIN32
+      const int sought = _fseeki64(m_file, static_cast<__int64>(offset), SEEK_SET); // Posters easily exceed 2 GB.
+#else
+      const int sought = fseeko(m_file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+      return sought == 0 && fwrite(rgb, 3 * sizeof(float), count, m_file) == size_t(count);
+    }
+
+    bool close()
+    {
+      const bool closed = (m_file && fclose(m_file) == 0);
+      m_file = nullptr;
+      return closed;
+    }
+
+  private:
+    FILE*     m_file;
+    long long m_width;
+    long      m_header;
+  };
+} // namespace
+
+
+void Application::renderPoster(const int width, const int height, const int spp, const double seconds, std::string const& filename)
+{
+  // The rendered tile is the full output size minus the overlap, unless the poster isn't larger than that in one direction.
+  const int tileWidth  = (m_width  < width)  ? m_width  - 2 * POSTER_TILE_OVERLAP : width;
+  const int tileHeight = (m_height < height) ? m_height - 2 * POSTER_TILE_OVERLAP : height;
+  if (tileWidth <= 0 || tileHeight <= 0 || width < m_width || height < m_height)
+  {
+    std::cerr << "ERROR: renderPoster() The " << m_width << "x" << m_height << " launch doesn't fit a " << width << "x" << height << " poster." << std::endl;
+    return;
+  }
+
+  if (filename.size() < 4 || filename.compare(filename.size() - 4, 4, ".pfm") != 0)
+  {
+    std::cerr << "ERROR: renderPoster() Only writes *.pfm files, which allow to store the rows of each tile in place." << std::endl;
+    return;
+  }
+
+  PosterFile file;
+  if (!file.open(filename, width, height))
+  {
+    std::cerr << "ERROR: renderPoster() Cannot write " << filename << std::endl;
+    return;
+  }
+
+#if USE_RESTIR
+  if (m_restir)
+  {
+    // The temporal reuse projects the primary hits with sysResolution, which is the tile and not the poster.
+    std::cerr << "WARNING: renderPoster() ReSTIR is not supported with poster tiles. Disabled." << std::endl;
+    setRestir(false);
+  }
+#endif
+
+  finishTextures(); // Offline results must not contain placeholder texels.
+
+  m_pinholeCamera.setViewport(width, height); // The tiles are sub-rectangles of this frustum. Picked up by the next render().
+  m_context["sysPosterResolution"]->setUint(width, height);
+
+  const int tilesX = (width  + tileWidth  - 1) / tileWidth;
+  const int tilesY = (height + tileHeight - 1) / tileHeight;
+  const double tileSeconds = seconds / double(tilesX * tilesY); // The time budget is shared evenly.
+
+  std::vector<float> row(3 * tileWidth);
+
+  Timer timer;
+  timer.start();
+
+  bool written = true;
+  for (int ty = 0; ty < tilesY && written; ++ty)
+  {
+    const int y     = ty * tileHeight;
+    const int inner = std::min(tileHeight, height - y);
+    const int top   = std::min(std::max(y - POSTER_TILE_OVERLAP, 0), height - m_height); // Shifted inside the poster at the borders.
+
+    for (int tx = 0; tx < tilesX && written; ++tx)
+    {
+      SUTIL_NVTX_RANGE("posterTile");
+
+      const int x     = tx * tileWidth;
+      const int count = std::min(tileWidth, width - x);
+      const int left  = std::min(std::max(x - POSTER_TILE_OVERLAP, 0), width - m_width);
+
+      m_context["sysPosterOffset"]->setUint(left, top);
+      restartAccumulation();
+
+      m_frames = spp; // 0 == Only the time budget ends the tile.
+      const double start = timer.getTime();
+
+      bool finished = false;
+      while (!finished)
+      {
+        render();
+
+        finished = (0 < m_frames && m_frames <= m_iterationIndex) || (0.0 < tileSeconds && tileSeconds <= timer.getTime() - start);
+#if USE_ADAPTIVE_SAMPLING
+        finished = finished || m_converged;
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+        finished = finished || m_denoisedStable;
+#endif
+      }
+
+      resolveAccumulation();
+
+      optix::Buffer buffer = m_bufferOutput;
+#if USE_DENOISER
+      if (m_useDenoiser)
+      {
+        denoise();
+        buffer = m_bufferDenoised;
+      }
+#endif
+
+      RTsize pitch;
+      RTsize rows;
+      buffer->getSize(pitch, rows);
+
+      const float* data = static_cast<const float*>(buffer->map(0, RT_BUFFER_MAP_READ));
+      for (int j = 0; j < inner && written; ++j)
+      {
+        const float* src = data + ((size_t(y + j - top) * pitch) + size_t(x - left)) * 4; // RGBA32F
+        for (int i = 0; i < count; ++i)
+        {
+          row[i * 3    ] = src[i * 4    ];
+          row[i * 3 + 1] = src[i * 4 + 1];
+          row[i * 3 + 2] = src[i * 4 + 2];
+        }
+        written = file.writeRow(x, y + j, row.data(), count);
+      }
+      buffer->unmap();
+
+      std::cout << "renderPoster(): Tile " << ty * tilesX + tx + 1 << " of " << tilesX * tilesY << ", "
+                << m_iterationIndex << " samples per pixel, " << timer.getTime() << " seconds" << std::endl;
+    }
+  }
+
+  m_context["sysPosterOffset"]->setUint(0, 0);
+  m_context["sysPosterResolution"]->setUint(0, 0);
+  m_pinholeCamera.setViewport(m_width, m_height);
+
+  if (file.close() && written)
+  {
+    std::cerr << "Wrote " << width << "x" << height << " poster " << filename << std::endl;
+  }
+  else
+  {
+    std::cerr << "ERROR: renderPoster() Failed writing " << filename << std::endl;
+  }
+}
+
+#endif // USE_POSTER_TILES
@@ -0,0 +1,222 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Profiler.h"
+
+#include <NvtxRange.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+static const char* stageNames[NUMBER_OF_PROFILER_STAGES] =
+{
+  "launch",
+  "denoiser",
+  "upload",
+  "display"
+};
+
+
+Profiler::Profiler()
+: m_hasFrame(false)
+{
+  m_clock.start();
+}
+
+Profiler::~Profiler()
+{
+  if (isEnabled())
+  {
+    finish(); // The last frame has no following nextFrame() call.
+    write();
+  }
+}
+
+void Profiler::setFilename(std::string const& filename)
+{
+  m_filename = filename;
+}
+
+void Profiler::setInfo(std::string const& key, std::string const& value)
+{
+  m_info.push_back(std::make_pair(key, value));
+}
+
+void Profiler::nextFrame(const int iteration)
+{
+  if (!isEnabled())
+  {
+    return;
+  }
+
+  if (m_hasFrame)
+  {
+    m_frames.push_back(m_frame);
+  }
+
+  m_frame.iteration = iteration;
+  m_frame.time      = m_clock.getTime();
+  for (int i = 0; i < NUMBER_OF_PROFILER_STAGES; ++i)
+  {
+    m_frame.seconds[i] = 0.0;
+  }
+  m_frame.rays = 0;
+  m_hasFrame = true;
+}
+
+void Profiler::finish()
+{
+  if (m_hasFrame)
+  {
+    m_frames.push_back(m_frame);
+    m_hasFrame = false;
+  }
+}
+
+// The stages are also the NVTX ranges of the per frame work, independent of the recording.
+void Profiler::begin(const ProfilerStage stage)
+{
+  SUTIL_NVTX_PUSH(stageNames[stage]);
+
+  if (isEnabled())
+  {
+    m_timers[stage].restart();
+  }
+}
+
+void Profiler::end(const ProfilerStage stage)
+{
+  if (isEnabled() && m_hasFrame)
+  {
+    m_timers[stage].stop();
+    m_frame.seconds[stage] += m_timers[stage].getTime(); // Stages can be entered multiple times per frame.
+  }
+
+  SUTIL_NVTX_POP();
+}
+
+void Profiler::addRays(const unsigned long long rays)
+{
+  if (isEnabled() && m_hasFrame)
+  {
+    m_frame.rays += rays;
+  }
+}
+
+bool Profiler::write() const
+{
+  std::ofstream stream(m_filename.c_str());
+  if (!stream)
+  {
+    std::cerr << "ERROR: Profiler::write() failed to open " << m_filename << std::endl;
+    return false;
+  }
+
+  const std::string::size_type dot = m_filename.find_last_of('.');
+  if (dot != std::string::npos && m_filename.substr(dot) == ".json")
+  {
+    writeJSON(stream);
+  }
+  else
+  {
+    writeCSV(stream);
+  }
+
+  std::cout << "Profiler wrote " << m_frames.size() << " frames to " << m_filename << std::endl;
+  return true;
+}
+
+void Profiler::writeCSV(std::ostream& stream) const
+{
+  // The header information goes into comment lines.
+  for (size_t i = 0; i < m_info.size(); ++i)
+  {
+    stream << "# " << m_info[i].first << ": " << m_info[i].second << "\n";
+  }
+
+  stream << "frame,iteration,time";
+  for (int i = 0; i < NUMBER_OF_PROFILER_STAGES; ++i)
+  {
+    stream << "," << stageNames[i] << "_ms";
+  }
+  stream << ",rays\n";
+
+  stream << std::fixed << std::setprecision(4);
+  for (size_t f = 0; f < m_frames.size(); ++f)
+  {
+    Frame const& frame = m_frames[f];
+
+    stream << f << "," << frame.iteration << "," << frame.time;
+    for (int i = 0; i < NUMBER_OF_PROFILER_STAGES; ++i)
+    {
+      stream << "," << frame.seconds[i] * 1000.0;
+    }
+    stream << "," << frame.rays << "\n";
+  }
+}
+
+// Minimal escaping, the info strings are device names and version numbers.
+static std::string escapeJSON(std::string const& s)
+{
+  std::string result;
+  for (size_t i = 0; i < s.size(); ++i)
+  {
+    if (s[i] == '"' || s[i] == '\\')
+    {
+      result += '\\';
+    }
+    result += s[i];
+  }
+  return result;
+}
+
+void Profiler::writeJSON(std::ostream& stream) const
+{
+  stream << "{\n  \"info\": {";
+  for (size_t i = 0; i < m_info.size(); ++i)
+  {
+    stream << ((i) ? ",\n" : "\n") << "    \"" << escapeJSON(m_info[i].first) << "\": \"" << escapeJSON(m_info[i].second) << "\"";
+  }
+  stream << "\n  },\n  \"frames\": [";
+
+  stream << std::fixed << std::setprecision(4);
+  for (size_t f = 0; f < m_frames.size(); ++f)
+  {
+    Frame const& frame = m_frames[f];
+
+    stream << ((f) ? ",\n" : "\n") << "    { \"frame\": " << f << ", \"iteration\": " << frame.iteration << ", \"time\": " << frame.time;
+    for (int i = 0; i < NUMBER_OF_PROFILER_STAGES; ++i)
+    {
+      stream << ", \"" << stageNames[i] << "_ms\": " << frame.seconds[i] * 1000.0;
+    }
+    stream << ", \"rays\": " << frame.rays << " }";
+  }
+  stream << "\n  ]\n}\n";
+}
@@ -0,0 +1,123 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_RADIANCE_CACHE
+
+#include <NvtxRange.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "shaders/radiance_cache.h"
+
+// World space radiance cache for the diffuse interreflection.
+//
+// The table maps voxels of m_cacheCellSize and one of six normal directions to cells with a running mean of the outgoing radiance.
+// The megakernel paths add the radiance they gathered after each of their first RADIANCE_CACHE_VERTICES diffuse vertices.
+// radiance_cache_update() blends the samples of each iteration into the cells, limited to m_cacheHistory iterations,
+// so the cache follows material and light changes without restarting it. The voxels are never evicted.
+// Only the cell size changes the mapping and clears the table.
+// The table lives per device with RT_BUFFER_GPU_LOCAL, each device caches the paths it renders.
+
+void Application::initRadianceCache()
+{
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("radiance_cache_update");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_RADIANCE_CACHE, it->second);
+
+  m_bufferCacheKeys  = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, RADIANCE_CACHE_CELLS);
+  m_bufferCacheAccum = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4,       RADIANCE_CACHE_CELLS);
+  m_bufferCacheValue = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4,       RADIANCE_CACHE_CELLS);
+  m_context["sysCacheKeys"]->setBuffer(m_bufferCacheKeys);
+  m_context["sysCacheAccum"]->setBuffer(m_bufferCacheAccum);
+  m_context["sysCacheValue"]->setBuffer(m_bufferCacheValue);
+
+  m_context["sysRadianceCache"]->setInt(0);
+  m_context["sysCacheReset"]->setInt(0);
+  m_context["sysCacheCellSize"]->setFloat(m_cacheCellSize);
+  m_context["sysCacheHistory"]->setFloat(float(m_cacheHistory));
+
+  m_cacheReset = true; // The buffers are uninitialized.
+}
+
+void Application::setRadianceCache(const int bounces, const float cellSize)
+{
+  m_cacheBounces  = std::max(0, bounces);
+  m_cacheCellSize = std::max(1.0e-4f, cellSize);
+  m_cacheReset    = true;
+}
+
+// The wavefront path segments don't know their earlier vertices.
+bool Application::isRadianceCacheSupported() const
+{
+  bool supported = (0 < m_cacheBounces);
+#if USE_WAVEFRONT
+  supported = supported && !m_wavefront;
+#endif
+#if USE_WEDGE
+  supported = supported && !isWedgeSupported(); // The cells would blend the radiance of all variants.
+#endif
+  return supported;
+}
+
+// Called by render() before the launches of an iteration. Clears the table first when its mapping changed.
+bool Application::updateRadianceCache()
+{
+  const bool cache = isRadianceCacheSupported();
+
+  if (cache && m_cacheReset)
+  {
+    SUTIL_NVTX_RANGE("resetRadianceCache");
+
+    m_context["sysCacheCellSize"]->setFloat(m_cacheCellSize);
+    m_context["sysCacheReset"]->setInt(1);
+    m_context->launch(ENTRY_RADIANCE_CACHE, RADIANCE_CACHE_CELLS);
+    m_context["sysCacheReset"]->setInt(0);
+
+    m_cacheReset = false;
+  }
+
+  m_context["sysRadianceCache"]->setInt((cache) ? m_cacheBounces : 0);
+
+  return cache;
+}
+
+// Called by render() when an iteration is complete.
+void Application::resolveRadianceCache()
+{
+  SUTIL_NVTX_RANGE("resolveRadianceCache");
+
+  m_context->launch(ENTRY_RADIANCE_CACHE, RADIANCE_CACHE_CELLS);
+}
+
+#endif // USE_RADIANCE_CACHE
@@ -0,0 +1,437 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_RASTER_PRIMARY
+
+#include <NvtxRange.h>
+
+#include <iostream>
+#include <map>
+
+#include "inc/MyAssert.h"
+
+// Hybrid primary visibility.
+//
+// Before each launch OpenGL rasterizes all triangles of the scene into a GL_R32F target, writing the distance from the camera
+// to the fragment's world position, with GL_MIN blending instead of a depth test. So the result is the exact distance of the
+// nearest rasterized surface, independent of any depth buffer precision. All pixels use the same sub-pixel jitter per iteration.
+// The megakernel traces its primary rays through that jittered location and starts them just in front of that distance.
+// Nothing can be hit before it, so the traversal only visits the few BVH nodes around the hit, and background pixels none.
+// The closest hit and anyhit programs run as usual, cutouts included, because the rasterizer treats them as opaque,
+// which only ever makes the distance shorter.
+
+namespace
+{
+  const std::string rasterVS =
+    "#version 330\n"
+    "uniform mat4 objectToClip;\n"
+    "uniform mat4 objectToWorld;\n"
+    "layout(location = 0) in vec3 attrPosition;\n"
+    "out vec3 varWorld;\n"
+    "void main()\n"
+    "{\n"
+    "  varWorld    = (objectToWorld * vec4(attrPosition, 1.0)).xyz;\n"
+    "  gl_Position = objectToClip * vec4(attrPosition, 1.0);\n"
+    "}\n";
+
+  const std::string rasterFS =
+    "#version 330\n"
+    "uniform vec3 cameraPosition;\n"
+    "in vec3 varWorld;\n"
+    "layout(location = 0, index = 0) out float outDistance;\n"
+    "void main()\n"
+    "{\n"
+    "  outDistance = length(varWorld - cameraPosition);\n"
+    "}\n";
+
+  // Collects all GeometryInstances below the Group with their object to world matrices.
+  // Clears isStatic when a Transform has motion keys. Its instances are still collected with an identity matrix.
+  void gatherRasterInstances(optix::Group group, optix::Matrix4x4 const& matrix,
+                             std::vector< std::pair<optix::GeometryInstance, optix::Matrix4x4> >& instances, bool& isStatic)
+  {
+    for (unsigned int i = 0; i < group->getChildCount(); ++i)
+    {
+      RTobjecttype     type = group->getChildType(i);
+      optix::Matrix4x4 m    = matrix;
+
+      optix::Transform tr;
+      if (type == RT_OBJECTTYPE_TRANSFORM)
+      {
+        tr = group->getChild<optix::Transform>(i);
+        while (tr)
+        {
+          if (1 < tr->getMotionKeyCount())
+          {
+            isStatic = false;
+          }
+          else
+          {
+            float data[16];
+            float inverse[16];
+            tr->getMatrix(false, data, inverse);
+            m = m * optix::Matrix4x4(data);
+          }
+          type = tr->getChildType();
+          if (type != RT_OBJECTTYPE_TRANSFORM)
+          {
+            break;
+          }
+          tr = tr->getChild<optix::Transform>();
+        }
+      }
+
+      if (type == RT_OBJECTTYPE_GEOMETRY_GROUP)
+      {
+        optix::GeometryGroup gg = (tr) ? tr->getChild<optix::GeometryGroup>() : group->getChild<optix::GeometryGroup>(i);
+        for (unsigned int j = 0; j < gg->getChildCount(); ++j)
+        {
+          instances.push_back(std::make_pair(gg->getChild(j), m));
+        }
+      }
+      else if (type == RT_OBJECTTYPE_GROUP)
+      {
+        gatherRasterInstances((tr) ? tr->getChild<optix::Group>() : group->getChild<optix::Group>(i), m, instances, isStatic);
+      }
+    }
+  }
+}
+
+
+void Application::setRasterPrimary(const bool enable)
+{
+  m_rasterPrimary = enable;
+  if (enable && (m_headless || !m_interop))
+  {
+    std::cerr << "WARNING: setRasterPrimary() needs OpenGL interop, primary rays are traced as usual." << std::endl;
+  }
+}
+
+// Only the megakernel pinhole camera at full resolution. The wavefront path tracer generates its primary rays itself.
+bool Application::isRasterPrimarySupported() const
+{
+  bool supported = m_rasterPrimary && !m_headless && m_interop && m_cameraType == LENS_SHADER_PINHOLE &&
+                   (!m_rasterInitialized || m_rasterStatic);
+#if USE_WAVEFRONT
+  supported = supported && !m_wavefront;
+#endif
+#if USE_MULTI_VIEW
+  supported = supported && !isMultiViewSupported(); // The views don't use the single camera.
+#endif
+#if USE_GEOMETRY_PAGING
+  supported = supported && m_geometryPages.empty(); // The rasterized meshes would be the page proxies.
+#endif
+  return supported;
+}
+
+// Creates the OpenGL objects and uploads the vertex positions of all triangle Geometries once.
+// The scene is not changed after initScene(), so the meshes stay valid until a reloadScene().
+void Application::initRasterPrimary()
+{
+  m_rasterInitialized = true;
+
+  GLint compiled = 0;
+
+  m_rasterVS = glCreateShader(GL_VERTEX_SHADER);
+  const GLchar* vs = rasterVS.c_str();
+  glShaderSource(m_rasterVS, 1, &vs, nullptr);
+  glCompileShader(m_rasterVS);
+  checkInfoLog(vs, m_rasterVS);
+  glGetShaderiv(m_rasterVS, GL_COMPILE_STATUS, &compiled);
+  MY_ASSERT(compiled);
+
+  m_rasterFS = glCreateShader(GL_FRAGMENT_SHADER);
+  const GLchar* fs = rasterFS.c_str();
+  glShaderSource(m_rasterFS, 1, &fs, nullptr);
+  glCompileShader(m_rasterFS);
+  checkInfoLog(fs, m_rasterFS);
+  glGetShaderiv(m_rasterFS, GL_COMPILE_STATUS, &compiled);
+  MY_ASSERT(compiled);
+
+  GLint linked = 0;
+
+  m_rasterProgram = glCreateProgram();
+  glAttachShader(m_rasterProgram, m_rasterVS);
+  glAttachShader(m_rasterProgram, m_rasterFS);
+  glLinkProgram(m_rasterProgram);
+  checkInfoLog("m_rasterProgram", m_rasterProgram);
+  glGetProgramiv(m_rasterProgram, GL_LINK_STATUS, &linked);
+  MY_ASSERT(linked);
+
+  glGenTextures(1, &m_rasterTexture);
+  MY_ASSERT(m_rasterTexture != 0);
+  glBindTexture(GL_TEXTURE_2D, m_rasterTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &m_rasterFramebuffer);
+  MY_ASSERT(m_rasterFramebuffer != 0);
+
+  glGenBuffers(1, &m_pboRasterDistance);
+  MY_ASSERT(m_pboRasterDistance != 0);
+
+  // The sizes follow the other per pixel buffers. The OptiX buffer needs a GL buffer of size > 0 to be created from.
+  RTsize width  = 0;
+  RTsize height = 0;
+  m_bufferOutput->getSize(width, height);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pboRasterDistance);
+  glBufferData(GL_PIXEL_PACK_BUFFER, width * height * sizeof(float), nullptr, GL_STREAM_COPY);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  m_bufferRasterDistance = m_context->createBufferFromGLBO(RT_BUFFER_INPUT, m_pboRasterDistance);
+  m_bufferRasterDistance->setFormat(RT_FORMAT_FLOAT);
+  m_bufferRasterDistance->setSize(width, height);
+  m_context["sysRasterDistance"]->setBuffer(m_bufferRasterDistance);
+
+  resizeRasterPrimary(int(width), int(height));
+
+  initRasterMeshes();
+}
+
+// Uploads the vertex positions and indices of all triangle Geometries under the root Group.
+void Application::initRasterMeshes()
+{
+  // Meshes are shared by the instances referencing the same index buffer.
+  std::vector< std::pair<optix::GeometryInstance, optix::Matrix4x4> > instances;
+  m_rasterStatic = true;
+  gatherRasterInstances(m_rootGroup, optix::Matrix4x4::identity(), instances, m_rasterStatic);
+
+  if (!m_rasterStatic)
+  {
+    std::cerr << "WARNING: initRasterMeshes() motion blurred Transforms in the scene, primary rays are traced as usual." << std::endl;
+    return;
+  }
+
+  std::map<int, size_t> meshes;
+
+  for (size_t i = 0; i < instances.size(); ++i)
+  {
+    optix::GeometryInstance instance = instances[i].first;
+
+    optix::Buffer indicesBuffer = getInstanceBuffer(instance, "indicesBuffer");
+
+    std::map<int, size_t>::const_iterator it = meshes.find(indicesBuffer->getId());
+    if (it == meshes.end())
+    {
+#if USE_COMPACT_ATTRIBUTES
+      optix::Buffer vertexBuffer = getInstanceBuffer(instance, "positionsBuffer"); // float3
+#else
+      optix::Buffer vertexBuffer = getInstanceBuffer(instance, "attributesBuffer"); // VertexAttributes with the position first.
+#endif
+      RTsize numVertices = 0;
+      vertexBuffer->getSize(numVertices);
+      RTsize numTriangles = 0;
+      indicesBuffer->getSize(numTriangles);
+
+      RasterMesh mesh;
+
+      mesh.stride = GLsizei(vertexBuffer->getElementSize());
+      mesh.count  = GLsizei(numTriangles * 3);
+
+      glGenBuffers(1, &mesh.vbo);
+      glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+      glBufferData(GL_ARRAY_BUFFER, numVertices * vertexBuffer->getElementSize(), vertexBuffer->map(0, RT_BUFFER_MAP_READ), GL_STATIC_DRAW);
+      vertexBuffer->unmap();
+
+      glGenBuffers(1, &mesh.ibo);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, numTriangles * sizeof(optix::uint3), indicesBuffer->map(0, RT_BUFFER_MAP_READ), GL_STATIC_DRAW);
+      indicesBuffer->unmap();
+
+      it = meshes.insert(std::make_pair(indicesBuffer->getId(), m_rasterMeshes.size())).first;
+      m_rasterMeshes.push_back(mesh);
+    }
+
+    RasterDraw draw;
+
+    draw.mesh   = it->second;
+    draw.matrix = instances[i].second;
+
+    m_rasterDraws.push_back(draw);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  std::cout << "initRasterMeshes(): Meshes = " << m_rasterMeshes.size() << ", Instances = " << m_rasterDraws.size() << std::endl;
+}
+
+// The OpenGL buffers of a scene which is about to be destroyed.
+void Application::destroyRasterMeshes()
+{
+  for (size_t i = 0; i < m_rasterMeshes.size(); ++i)
+  {
+    glDeleteBuffers(1, &m_rasterMeshes[i].vbo);
+    glDeleteBuffers(1, &m_rasterMeshes[i].ibo);
+  }
+  m_rasterMeshes.clear();
+  m_rasterDraws.clear();
+}
+
+// Called by resizeBuffers() with the capacity of the per pixel buffers.
+void Application::resizeRasterPrimary(const int width, const int height)
+{
+  if (!m_rasterInitialized)
+  {
+    return; // The placeholder is never read.
+  }
+
+  glBindTexture(GL_TEXTURE_2D, m_rasterTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, nullptr);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_rasterFramebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_rasterTexture, 0);
+  MY_ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  m_bufferRasterDistance->setSize(width, height);
+
+  m_bufferRasterDistance->unregisterGLBuffer(); // Must unregister or CUDA won't notice the size change and crash.
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_bufferRasterDistance->getGLBOId());
+  glBufferData(GL_PIXEL_PACK_BUFFER, m_bufferRasterDistance->getElementSize() * width * height, nullptr, GL_STREAM_COPY);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_bufferRasterDistance->registerGLBuffer();
+}
+
+// Called by render() before the launches of each iteration. Rasterizes the distances with the jitter of the current iteration
+// and copies them into the pixel pack buffer, which OptiX reads through m_bufferRasterDistance without a host round trip.
+void Application::rasterizePrimary()
+{
+  SUTIL_NVTX_RANGE("rasterizePrimary");
+
+  if (!m_rasterInitialized)
+  {
+    initRasterPrimary();
+  }
+  if (!m_rasterStatic)
+  {
+    return;
+  }
+
+  // R2 sequence over the iterations, the same for all pixels.
+  const float         index  = float(m_iterationIndex);
+  const optix::float2 jitter = optix::make_float2(0.5f + index * 0.7548776662f, 0.5f + index * 0.5698402910f);
+#if USE_FILTER_IMPORTANCE_SAMPLING
+  const optix::float2 sample = filterPixelSample(jitter - optix::make_float2(floorf(jitter.x), floorf(jitter.y)));
+#else
+  const optix::float2 sample = jitter - optix::make_float2(floorf(jitter.x), floorf(jitter.y));
+#endif
+
+  m_context["sysRasterJitter"]->setFloat(sample);
+
+  const optix::float3 P = m_context["sysCameraPosition"]->getFloat3();
+  const optix::float3 U = m_context["sysCameraU"]->getFloat3();
+  const optix::float3 V = m_context["sysCameraV"]->getFloat3();
+  const optix::float3 W = m_context["sysCameraW"]->getFloat3();
+
+  // The inverse of pinholeDirection(): A world position P + a * U + b * V + c * W lands on ndc (a / c, b / c).
+  // The sub-pixel jitter is an ndc offset. Depth is only needed for the near plane clipping, the far plane is at infinity.
+  const optix::float3 u = U / optix::dot(U, U);
+  const optix::float3 v = V / optix::dot(V, V);
+  const optix::float3 w = W / optix::dot(W, W);
+
+  const optix::float2 offset = (sample * 2.0f - 1.0f) / optix::make_float2(float(m_width), float(m_height));
+  const optix::float3 x      = u + offset.x * w;
+  const optix::float3 y      = v + offset.y * w;
+  const float         nearPlane = m_sceneEpsilonFactor * 1e-7f / optix::length(W);
+
+  const float data[16] =
+  {
+    x.x, x.y, x.z, -optix::dot(x, P),
+    y.x, y.y, y.z, -optix::dot(y, P),
+    w.x, w.y, w.z, -optix::dot(w, P) - 2.0f * nearPlane,
+    w.x, w.y, w.z, -optix::dot(w, P)
+  };
+  const optix::Matrix4x4 worldToClip(data);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_rasterFramebuffer);
+  glViewport(0, 0, m_width, m_height);
+
+  const GLfloat background[4] = { RT_DEFAULT_MAX, 0.0f, 0.0f, 0.0f };
+  glClearBufferfv(GL_COLOR, 0, background);
+
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  glEnable(GL_BLEND);
+  glBlendEquation(GL_MIN);
+
+  glUseProgram(m_rasterProgram);
+  glUniform3f(glGetUniformLocation(m_rasterProgram, "cameraPosition"), P.x, P.y, P.z);
+
+  const GLint locationClip  = glGetUniformLocation(m_rasterProgram, "objectToClip");
+  const GLint locationWorld = glGetUniformLocation(m_rasterProgram, "objectToWorld");
+
+  glEnableVertexAttribArray(0);
+
+  for (size_t i = 0; i < m_rasterDraws.size(); ++i)
+  {
+    RasterDraw const& draw = m_rasterDraws[i];
+    RasterMesh const& mesh = m_rasterMeshes[draw.mesh];
+
+    const optix::Matrix4x4 objectToClip = worldToClip * draw.matrix;
+
+    glUniformMatrix4fv(locationClip,  1, GL_TRUE, objectToClip.getData()); // Row-major.
+    glUniformMatrix4fv(locationWorld, 1, GL_TRUE, draw.matrix.getData());
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, mesh.stride, (void*) 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+    glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*) 0);
+  }
+
+  glDisableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glUseProgram(0);
+
+  glBlendEquation(GL_FUNC_ADD);
+  glDisable(GL_BLEND);
+
+  // The distances are the lower left sub-rectangle of the capacity sized buffer, like the other per pixel data.
+  RTsize capacityWidth  = 0;
+  RTsize capacityHeight = 0;
+  m_bufferRasterDistance->getSize(capacityWidth, capacityHeight);
+
+  glPixelStorei(GL_PACK_ROW_LENGTH, GLint(capacityWidth));
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_bufferRasterDistance->getGLBOId());
+  glReadPixels(0, 0, m_width, m_height, GL_RED, GL_FLOAT, (void*) 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, m_width, m_height);
+}
+
+#endif // USE_RASTER_PRIMARY
@@ -0,0 +1,423 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/RenderServer.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+
+#if defined(_WIN32)
+static const ServerSocket invalidSocket = ServerSocket(INVALID_SOCKET);
+
+static void closeSocket(const ServerSocket s)
+{
+  closesocket(SOCKET(s));
+}
+#else
+static const ServerSocket invalidSocket = -1;
+
+static void closeSocket(const ServerSocket s)
+{
+  close(s);
+}
+#endif
+
+
+// Clients which send more than this without a line ending are dropped.
+static const size_t maxLineLength = 4096;
+
+static bool sendAllTo(const ServerSocket s, const char* data, size_t size)
+{
+#if defined(MSG_NOSIGNAL)
+  const int flags = MSG_NOSIGNAL; // A peer which went away must not raise SIGPIPE.
+#else
+  const int flags = 0;
+#endif
+  while (0 < size)
+  {
+    const int sent = int(::send(s, data, int(size), flags));
+    if (sent <= 0)
+    {
+      return false;
+    }
+    data += sent;
+    size -= size_t(sent);
+  }
+  return true;
+}
+
+
+RenderServer::RenderServer()
+: m_listenSocket(invalidSocket)
+, m_clientSocket(invalidSocket)
+, m_initialized(false)
+{
+#if defined(_WIN32)
+  WSADATA data;
+  m_initialized = (WSAStartup(MAKEWORD(2, 2), &data) == 0);
+#else
+  m_initialized = true;
+#endif
+}
+
+RenderServer::~RenderServer()
+{
+  disconnect();
+  if (m_listenSocket != invalidSocket)
+  {
+    closeSocket(m_listenSocket);
+  }
+#if defined(_WIN32)
+  if (m_initialized)
+  {
+    WSACleanup();
+  }
+#endif
+}
+
+bool RenderServer::listen(const int port)
+{
+  if (!m_initialized)
+  {
+    std::cerr << "ERROR: RenderServer::listen() socket library not initialized" << std::endl;
+    return false;
+  }
+
+  m_listenSocket = ServerSocket(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+  if (m_listenSocket == invalidSocket)
+  {
+    std::cerr << "ERROR: RenderServer::listen() socket() failed" << std::endl;
+    return false;
+  }
+
+  // Allow restarting the server right away while the old connection is in TIME_WAIT.
+  int reuse = 1;
+  setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*) &reuse, sizeof(reuse));
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family      = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port        = htons((unsigned short) port);
+
+  if (bind(m_listenSocket, (const sockaddr*) &address, sizeof(address)) != 0 ||
+      ::listen(m_listenSocket, 1) != 0)
+  {
+    std::cerr << "ERROR: RenderServer::listen() could not listen on port " << port << std::endl;
+    closeSocket(m_listenSocket);
+    m_listenSocket = invalidSocket;
+    return false;
+  }
+
+  std::cout << "RenderServer listening on port " << port << std::endl;
+  return true;
+}
+
+void RenderServer::poll(std::vector<std::string>& commands, const int timeoutMilliseconds)
+{
+  if (m_listenSocket == invalidSocket)
+  {
+    return;
+  }
+
+  // Only one client is served. More clients wait in the listen backlog until it disconnects.
+  const ServerSocket active = (m_clientSocket != invalidSocket) ? m_clientSocket : m_listenSocket;
+
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(active, &readable);
+
+  timeval timeout;
+  timeout.tv_sec  = timeoutMilliseconds / 1000;
+  timeout.tv_usec = (timeoutMilliseconds % 1000) * 1000;
+
+  if (select(int(active) + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+  {
+    return;
+  }
+
+  if (active == m_listenSocket)
+  {
+    sockaddr_in address;
+    socklen_t   length = sizeof(address);
+
+    m_clientSocket = ServerSocket(accept(m_listenSocket, (sockaddr*) &address, &length));
+    if (m_clientSocket != invalidSocket)
+    {
+      // The frames are sent in one piece after their header, Nagle's algorithm would only delay the replies.
+      int noDelay = 1;
+      setsockopt(m_clientSocket, IPPROTO_TCP, TCP_NODELAY, (const char*) &noDelay, sizeof(noDelay));
+
+      std::cout << "RenderServer client connected from " << inet_ntoa(address.sin_addr) << std::endl;
+      m_input.clear();
+    }
+    return;
+  }
+
+  char buffer[4096];
+  const int received = int(recv(m_clientSocket, buffer, sizeof(buffer), 0));
+  if (received <= 0)
+  {
+    disconnect(); // Closed by the client or a connection error.
+    return;
+  }
+  m_input.append(buffer, received);
+
+  std::string::size_type begin = 0;
+  std::string::size_type end;
+  while ((end = m_input.find('\n', begin)) != std::string::npos)
+  {
+    std::string line = m_input.substr(begin, end - begin);
+    if (!line.empty() && line[line.size() - 1] == '\r')
+    {
+      line.erase(line.size() - 1);
+    }
+    if (!line.empty())
+    {
+      commands.push_back(line);
+    }
+    begin = end + 1;
+  }
+  m_input.erase(0, begin);
+
+  if (maxLineLength < m_input.size())
+  {
+    std::cerr << "ERROR: RenderServer::poll() line too long, dropping the client" << std::endl;
+    disconnect();
+  }
+}
+
+bool RenderServer::isConnected() const
+{
+  return (m_clientSocket != invalidSocket);
+}
+
+bool RenderServer::send(std::string const& header, const void* data, const size_t size)
+{
+  if (!isConnected())
+  {
+    return false;
+  }
+
+  const std::string line = header + "\n";
+  if (!sendAll(line.c_str(), line.size()) ||
+      (size && !sendAll(static_cast<const char*>(data), size)))
+  {
+    std::cerr << "ERROR: RenderServer::send() failed, dropping the client" << std::endl;
+    disconnect();
+    return false;
+  }
+  return true;
+}
+
+void RenderServer::disconnect()
+{
+  if (m_clientSocket != invalidSocket)
+  {
+    closeSocket(m_clientSocket);
+    m_clientSocket = invalidSocket;
+    m_input.clear();
+
+    std::cout << "RenderServer client disconnected" << std::endl;
+  }
+}
+
+bool RenderServer::sendAll(const char* data, size_t size)
+{
+  return sendAllTo(m_clientSocket, data, size);
+}
+
+
+RenderClient::RenderClient()
+: m_socket(invalidSocket)
+, m_initialized(false)
+{
+#if defined(_WIN32)
+  WSADATA data;
+  m_initialized = (WSAStartup(MAKEWORD(2, 2), &data) == 0);
+#else
+  m_initialized = true;
+#endif
+}
+
+RenderClient::~RenderClient()
+{
+  disconnect();
+#if defined(_WIN32)
+  if (m_initialized)
+  {
+    WSACleanup();
+  }
+#endif
+}
+
+bool RenderClient::connect(std::string const& host, const int port)
+{
+  if (!m_initialized)
+  {
+    return false;
+  }
+  disconnect();
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+
+  std::ostringstream service;
+  service << port;
+
+  addrinfo* addresses = nullptr;
+  if (getaddrinfo(host.c_str(), service.str().c_str(), &hints, &addresses) != 0)
+  {
+    std::cerr << "ERROR: RenderClient::connect() cannot resolve " << host << std::endl;
+    return false;
+  }
+
+  for (addrinfo* address = addresses; address != nullptr && m_socket == invalidSocket; address = address->ai_next)
+  {
+    m_socket = ServerSocket(socket(address->ai_family, address->ai_socktype, address->ai_protocol));
+    if (m_socket != invalidSocket && ::connect(m_socket, address->ai_addr, int(address->ai_addrlen)) != 0)
+    {
+      closeSocket(m_socket);
+      m_socket = invalidSocket;
+    }
+  }
+  freeaddrinfo(addresses);
+
+  if (m_socket == invalidSocket)
+  {
+    std::cerr << "ERROR: RenderClient::connect() cannot connect to " << host << ":" << port << std::endl;
+    return false;
+  }
+
+  int noDelay = 1;
+  setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*) &noDelay, sizeof(noDelay));
+  return true;
+}
+
+bool RenderClient::isConnected() const
+{
+  return (m_socket != invalidSocket);
+}
+
+bool RenderClient::send(std::string const& line)
+{
+  if (!isConnected())
+  {
+    return false;
+  }
+
+  const std::string data = line + "\n";
+  if (!sendAllTo(m_socket, data.c_str(), data.size()))
+  {
+    disconnect();
+    return false;
+  }
+  return true;
+}
+
+bool RenderClient::receiveLine(std::string& line)
+{
+  std::string::size_type end;
+  while ((end = m_input.find('\n')) == std::string::npos)
+  {
+    char buffer[4096];
+    const int received = (isConnected()) ? int(recv(m_socket, buffer, sizeof(buffer), 0)) : 0;
+    if (received <= 0 || maxLineLength < m_input.size())
+    {
+      disconnect();
+      return false;
+    }
+    m_input.append(buffer, received);
+  }
+
+  line = m_input.substr(0, end);
+  if (!line.empty() && line[line.size() - 1] == '\r')
+  {
+    line.erase(line.size() - 1);
+  }
+  m_input.erase(0, end + 1);
+  return true;
+}
+
+bool RenderClient::receive(void* data, size_t size)
+{
+  char* dst = static_cast<char*>(data);
+
+  // The bytes received together with the reply line come first.
+  const size_t buffered = std::min(size, m_input.size());
+  memcpy(dst, m_input.data(), buffered);
+  m_input.erase(0, buffered);
+  dst  += buffered;
+  size -= buffered;
+
+  while (0 < size)
+  {
+    const int received = (isConnected()) ? int(recv(m_socket, dst, int(std::min(size, size_t(1 << 20))), 0)) : 0;
+    if (received <= 0)
+    {
+      disconnect();
+      return false;
+    }
+    dst  += received;
+    size -= size_t(received);
+  }
+  return true;
+}
+
+void RenderClient::disconnect()
+{
+  if (m_socket != invalidSocket)
+  {
+    closeSocket(m_socket);
+    m_socket = invalidSocket;
+  }
+  m_input.clear();
+}
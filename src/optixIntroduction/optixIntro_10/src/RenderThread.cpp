@@ -0,0 +1,286 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+#include "inc/MyAssert.h"
+
+#if USE_RENDER_THREAD
+
+#include <chrono>
+#include <cstring>
+
+// Threading model of runRenderThread():
+//
+// The render thread loops over: apply all queued RenderCommands, render() one iteration, park when the GUI asked for it.
+// It never touches OpenGL. uploadImage() copies the finished image into the back frame of the FrameExchange instead.
+//
+// The GUI thread polls the window events, turns the mouse into RenderCommands (pollCamera()) and displays the newest frame
+// on every iteration of its loop, so neither a long launch nor the GUI stall the other side. The ImGui window itself reads
+// and changes the Application members and the OptiX context directly, so it is only built while the render thread is parked
+// between two iterations. When the render thread doesn't reach that point within GUI_PARK_TIMEOUT the GUI thread redraws the
+// previous ImGui draw data and tries again with its next frame.
+
+static const std::chrono::milliseconds GUI_PARK_TIMEOUT(8);
+
+
+void Application::runRenderThread()
+{
+  MY_ASSERT(!m_headless && !m_interop); // The OpenGL interop buffers would be mapped by both threads.
+
+  glfwSwapInterval(1); // The GUI thread only needs to keep up with the display. All other time goes to the render thread.
+
+  m_uiWidth  = m_width;
+  m_uiHeight = m_height;
+#if USE_DEVICE_TONEMAP
+  m_presentTonemapped = m_displayTonemapped; // The current state of the GLSL uniform.
+#endif
+
+  m_guiRequest   = false;
+  m_renderParked = false;
+  m_renderExit   = false;
+
+  m_renderThreadActive = true; // Set before the thread starts and only cleared after it joined.
+  m_renderThread = std::thread(&Application::renderLoop, this);
+
+  bool captured = false; // The ImGui window had the mouse during the last GUI frame.
+
+  while (!glfwWindowShouldClose(m_window))
+  {
+    glfwPollEvents();
+
+    int width;
+    int height;
+    glfwGetFramebufferSize(m_window, &width, &height);
+
+    if ((width != 0 && height != 0) && (width != m_uiWidth || height != m_uiHeight))
+    {
+      m_uiWidth  = width;
+      m_uiHeight = height;
+
+      glViewport(0, 0, m_uiWidth, m_uiHeight);
+      cameraCommand(RENDER_COMMAND_RESHAPE, m_uiWidth, m_uiHeight, 0.0f);
+    }
+
+    float wheel = 0.0f;
+
+    if (guiFrameBegin())
+    {
+      guiNewFrame();
+      guiWindow();
+      guiEventHandler(); // Only the keyboard, see pollCamera().
+      ImGui::Render();
+
+      ImGuiIO const& io = ImGui::GetIO();
+
+      captured = io.WantCaptureMouse;
+      wheel    = io.MouseWheel; // The ImGui GLFW binding only hands the scroll events over in ImGui_ImplGlfwGL2_NewFrame().
+
+      guiFrameEnd();
+    }
+
+    pollCamera(captured, wheel);
+
+    presentFrame();
+    drawImage();
+
+    if (ImGui::GetDrawData())
+    {
+      ImGui_ImplGlfwGL2_RenderDrawData(ImGui::GetDrawData()); // The last built GUI frame.
+    }
+
+    glfwSwapBuffers(m_window);
+  }
+
+  stopRenderThread();
+}
+
+void Application::stopRenderThread()
+{
+  if (!m_renderThread.joinable())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_renderMutex);
+    m_renderExit = true;
+  }
+  m_renderCondition.notify_all();
+
+  m_renderThread.join();
+
+  m_renderThreadActive = false;
+
+#if USE_DEVICE_TONEMAP
+  m_displayTonemapped = m_presentTonemapped; // Back to describing the m_hdrTexture contents.
+#endif
+
+  // The GUI thread owns everything again.
+  RenderCommand command;
+  while (m_renderCommands.pop(command))
+  {
+    applyCommand(command);
+  }
+  m_guiState = GUI_STATE_NONE;
+}
+
+void Application::renderLoop()
+{
+  for (;;)
+  {
+    RenderCommand command;
+    while (m_renderCommands.pop(command))
+    {
+      applyCommand(command);
+    }
+
+    const bool repaint = render();
+
+    std::unique_lock<std::mutex> lock(m_renderMutex);
+
+    if (m_renderExit)
+    {
+      break;
+    }
+
+    if (m_guiRequest)
+    {
+      m_renderParked = true;
+      m_renderCondition.notify_all();
+      m_renderCondition.wait(lock, [this] { return !m_guiRequest || m_renderExit; });
+      m_renderParked = false;
+    }
+    else if (!repaint) // Nothing to accumulate anymore. Don't spin until the next command arrives.
+    {
+      m_renderCondition.wait_for(lock, std::chrono::milliseconds(1));
+    }
+  }
+}
+
+// Returns true when the render thread is parked and the GUI thread may access the Application until guiFrameEnd().
+// Otherwise the request stays set, and the render thread parks after its current iteration for the next GUI frame.
+bool Application::guiFrameBegin()
+{
+  std::unique_lock<std::mutex> lock(m_renderMutex);
+
+  m_guiRequest = true;
+
+  return m_renderCondition.wait_for(lock, GUI_PARK_TIMEOUT, [this] { return m_renderParked; });
+}
+
+void Application::guiFrameEnd()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_renderMutex);
+    m_guiRequest = false;
+  }
+  m_renderCondition.notify_all();
+}
+
+// The camera state machine on every GUI thread frame, from the GLFW mouse state, which is current also without an ImGui frame.
+void Application::pollCamera(const bool captured, const float wheel)
+{
+  double cursorX;
+  double cursorY;
+  glfwGetCursorPos(m_window, &cursorX, &cursorY); // Same window client coordinates as ImGui::GetMousePos().
+
+  const bool down[3] =
+  {
+    glfwGetMouseButton(m_window, GLFW_MOUSE_BUTTON_LEFT)   == GLFW_PRESS,
+    glfwGetMouseButton(m_window, GLFW_MOUSE_BUTTON_RIGHT)  == GLFW_PRESS,
+    glfwGetMouseButton(m_window, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS
+  };
+
+  guiCamera(captured, down, int(cursorX), int(cursorY), wheel, m_uiWidth, m_uiHeight);
+}
+
+// Render thread side of uploadImage(). Stores the rows tightly packed, without the resize capacity pitch.
+void Application::publishFrame(const GLint internalFormat, const GLenum format, const GLenum type, const int bytesPerPixel, const void* data)
+{
+  RenderFrame& frame = m_renderFrames.back();
+
+  const size_t rowBytes = size_t(m_width) * bytesPerPixel;
+#if USE_RESIZE_CAPACITY
+  const size_t pitch = size_t(m_capacityWidth) * bytesPerPixel;
+#else
+  const size_t pitch = rowBytes;
+#endif
+
+  frame.data.resize(rowBytes * m_height);
+
+  const unsigned char* src = static_cast<const unsigned char*>(data);
+  unsigned char*       dst = frame.data.data();
+  for (int y = 0; y < m_height; ++y)
+  {
+    memcpy(dst, src, rowBytes);
+    src += pitch;
+    dst += rowBytes;
+  }
+
+  frame.width          = m_width;
+  frame.height         = m_height;
+  frame.internalFormat = internalFormat;
+  frame.format         = format;
+  frame.type           = type;
+#if USE_DEVICE_TONEMAP
+  frame.tonemapped     = m_displayTonemapped;
+#else
+  frame.tonemapped     = false;
+#endif
+
+  m_renderFrames.publish();
+}
+
+// GUI thread side. Uploads the newest published frame into the m_hdrTexture, if there is one.
+void Application::presentFrame()
+{
+  RenderFrame const* frame = m_renderFrames.acquire();
+  if (!frame)
+  {
+    return;
+  }
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, m_hdrTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, frame->internalFormat, (GLsizei) frame->width, (GLsizei) frame->height, 0, frame->format, frame->type, frame->data.data());
+
+#if USE_DEVICE_TONEMAP
+  if (m_presentTonemapped != frame->tonemapped)
+  {
+    m_presentTonemapped = frame->tonemapped;
+
+    glUseProgram(m_glslProgram);
+    glUniform1i(glGetUniformLocation(m_glslProgram, "tonemapped"), (m_presentTonemapped) ? 1 : 0);
+    glUseProgram(0);
+  }
+#endif
+}
+
+#endif // USE_RENDER_THREAD
@@ -0,0 +1,148 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_REPROJECTION
+
+#include <NvtxRange.h>
+
+#include <iostream>
+
+#include "shaders/lens_shader_type.h"
+
+// Temporal reprojection of the accumulation across camera changes.
+//
+// The megakernel path tracer keeps a sample count and the primary hit of the first sample per pixel next to the running mean.
+// On a camera change the accumulation is copied into the history buffers and each pixel of the new view traces its center.
+// Where the history pixel this hit projects to saw the same position (or both saw the environment), the pixel continues
+// with the history mean and up to m_reprojectionHistory of its samples. Disoccluded pixels and pixels which left the screen
+// start from zero samples. The global m_iterationIndex restarts as usual, it only selects the sample sequence then.
+
+void Application::initReprojection()
+{
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("reproject_store");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_REPROJECT_STORE, it->second);
+
+  it = m_mapOfPrograms.find("reproject");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_REPROJECT, it->second);
+
+  // Only the device side reads and writes these. Reprojection is limited to a single device, see isReprojectionSupported().
+  m_bufferPosition    = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+  m_bufferSampleCount = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT,  m_width, m_height);
+  m_context["sysPositionBuffer"]->setBuffer(m_bufferPosition);
+  m_context["sysSampleCountBuffer"]->setBuffer(m_bufferSampleCount);
+
+  m_bufferHistoryOutput   = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+  m_bufferHistoryPosition = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+  m_bufferHistoryCount    = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT,  m_width, m_height);
+  m_context["sysHistoryOutput"]->setBuffer(m_bufferHistoryOutput);
+  m_context["sysHistoryPosition"]->setBuffer(m_bufferHistoryPosition);
+  m_context["sysHistoryCount"]->setBuffer(m_bufferHistoryCount);
+#if USE_DENOISER && USE_DENOISER_ALBEDO && !USE_DENOISER_GBUFFER
+  m_bufferHistoryAlbedo   = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, m_width, m_height);
+  m_context["sysHistoryAlbedo"]->setBuffer(m_bufferHistoryAlbedo);
+#endif
+
+  m_context["sysReprojection"]->setInt(0);
+  m_context["sysReprojectionHistory"]->setFloat(float(m_reprojectionHistory));
+  m_context["sysReprojectionTolerance"]->setFloat(m_reprojectionTolerance);
+
+#if USE_PREVIEW_RESOLUTION
+  // The preview renders into its own reduced resolution buffer. It must not touch the per pixel data of the full resolution.
+  it = m_mapOfPrograms.find("raygeneration_preview");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  it->second["sysReprojection"]->setInt(0);
+#endif
+}
+
+// The history is only meaningful for the pinhole camera and the accumulation of the megakernel path tracer on one device.
+// The adaptive sampling second moment and the wavefront resolve only know the global iteration index.
+bool Application::isReprojectionSupported() const
+{
+  bool supported = m_reprojection && m_cameraType == LENS_SHADER_PINHOLE && !m_localAccumulation &&
+                   m_context->getEnabledDeviceCount() == 1;
+#if USE_WAVEFRONT
+  supported = supported && !m_wavefront;
+#endif
+#if USE_ADAPTIVE_SAMPLING
+  supported = supported && m_targetError <= 0.0f;
+#endif
+#if USE_MULTI_VIEW
+  supported = supported && !isMultiViewSupported(); // The views don't use the single camera.
+#endif
+#if USE_WEDGE
+  supported = supported && !isWedgeSupported(); // The history holds a single image.
+#endif
+  return supported;
+}
+
+// Called by render() with the new camera already set. Returns false when the accumulation needs to restart from scratch.
+bool Application::reproject()
+{
+  // Nothing rendered since the last restart means the per pixel data isn't from the current scene state.
+  if (!isReprojectionSupported() || (m_iterationIndex == 0 && !m_reprojected))
+  {
+    return false;
+  }
+
+  SUTIL_NVTX_RANGE("reproject");
+
+  try
+  {
+    m_context->launch(ENTRY_REPROJECT_STORE, m_width, m_height);
+
+    m_context["sysHistoryCameraPosition"]->setFloat(m_historyCameraPosition);
+    m_context["sysHistoryCameraU"]->setFloat(m_historyCameraU);
+    m_context["sysHistoryCameraV"]->setFloat(m_historyCameraV);
+    m_context["sysHistoryCameraW"]->setFloat(m_historyCameraW);
+
+    m_context->launch(ENTRY_REPROJECT, m_width, m_height);
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// The camera the current accumulation is rendered with. The next reproject() warps from it.
+void Application::setHistoryCamera(optix::float3 const& position, optix::float3 const& u, optix::float3 const& v, optix::float3 const& w)
+{
+  m_historyCameraPosition = position;
+  m_historyCameraU        = u;
+  m_historyCameraV        = v;
+  m_historyCameraW        = w;
+}
+
+#endif // USE_REPROJECTION
@@ -0,0 +1,136 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_RESTIR
+
+#include <iostream>
+
+#include "shaders/lens_shader_type.h"
+#include "shaders/reservoir.h"
+
+// Resampled direct lighting of the primary hits (ReSTIR DI).
+//
+// The closest hit program of a diffuse primary hit resamples m_restirCandidates light samples into one reservoir,
+// combines it with the reservoirs the previous iteration stored at the pixel its hit projects to with the previous camera
+// and at a few random pixels around that, and shades with the single selected sample.
+// The host keeps two reservoir buffers and swaps their roles after each iteration. The previous camera is tracked here as well,
+// so the temporal reuse follows camera changes without the USE_REPROJECTION history.
+
+void Application::initRestir()
+{
+  for (int i = 0; i < 2; ++i)
+  {
+    // Only the device side reads and writes these. Limited to a single device, see isRestirSupported().
+    m_bufferReservoirs[i] = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL);
+    m_bufferReservoirs[i]->setFormat(RT_FORMAT_USER);
+    m_bufferReservoirs[i]->setElementSize(sizeof(Reservoir));
+    m_bufferReservoirs[i]->setSize(m_width, m_height);
+  }
+
+  m_restirCurrent = 0;
+  m_restirValid   = false;
+
+  m_context["sysReservoirs"]->setBuffer(m_bufferReservoirs[0]);
+  m_context["sysReservoirsPrevious"]->setBuffer(m_bufferReservoirs[1]);
+
+  m_context["sysRestir"]->setInt(0);
+  m_context["sysRestirReuse"]->setInt(0);
+  m_context["sysRestirCandidates"]->setInt(m_restirCandidates);
+
+  m_context["sysRestirCameraPosition"]->setFloat(0.0f, 0.0f, 0.0f);
+  m_context["sysRestirCameraU"]->setFloat(0.0f, 0.0f, 0.0f);
+  m_context["sysRestirCameraV"]->setFloat(0.0f, 0.0f, 0.0f);
+  m_context["sysRestirCameraW"]->setFloat(0.0f, 0.0f, 0.0f);
+
+#if USE_PREVIEW_RESOLUTION
+  // The preview resolution doesn't match the reservoirs.
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("raygeneration_preview");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  it->second["sysRestir"]->setInt(0);
+#endif
+}
+
+void Application::setRestir(const bool enable)
+{
+  m_restir = enable;
+}
+
+// The reservoirs are found by projecting the hits with the pinhole camera. The neighbours must be in the same device's memory.
+bool Application::isRestirSupported() const
+{
+  bool supported = m_restir && m_cameraType == LENS_SHADER_PINHOLE && !m_localAccumulation &&
+                   m_context->getEnabledDeviceCount() == 1;
+#if USE_WAVEFRONT
+  supported = supported && !m_wavefront;
+#endif
+#if USE_MULTI_VIEW
+  supported = supported && !isMultiViewSupported(); // The views don't use the single camera.
+#endif
+#if USE_WEDGE
+  supported = supported && !isWedgeSupported(); // The reservoirs hold the lights of a single material set.
+#endif
+  return supported;
+}
+
+// Called by render() before the launches of an iteration.
+bool Application::updateRestir()
+{
+  const bool restir = isRestirSupported();
+
+  m_context["sysRestir"]->setInt((restir) ? 1 : 0);
+  m_context["sysRestirReuse"]->setInt((restir && m_restirValid) ? 1 : 0);
+
+  return restir;
+}
+
+// Called by render() when an iteration is complete. Its reservoirs become the previous ones of the next iteration.
+void Application::advanceRestir(const bool restir)
+{
+  m_restirValid = restir;
+  if (!restir)
+  {
+    return;
+  }
+
+  m_restirCurrent ^= 1;
+
+  m_context["sysReservoirs"]->setBuffer(m_bufferReservoirs[m_restirCurrent]);
+  m_context["sysReservoirsPrevious"]->setBuffer(m_bufferReservoirs[m_restirCurrent ^ 1]);
+
+  m_context["sysRestirCameraPosition"]->setFloat(m_context["sysCameraPosition"]->getFloat3());
+  m_context["sysRestirCameraU"]->setFloat(m_context["sysCameraU"]->getFloat3());
+  m_context["sysRestirCameraV"]->setFloat(m_context["sysCameraV"]->getFloat3());
+  m_context["sysRestirCameraW"]->setFloat(m_context["sysCameraW"]->getFloat3());
+}
+
+#endif // USE_RESTIR
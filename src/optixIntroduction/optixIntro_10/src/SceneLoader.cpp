@@ -0,0 +1,446 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Application.h"
+
+#include <sutil.h>
+#include <Mesh.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "inc/ParallelFor.h"
+
+// Scene description file format. One statement per line, '#' starts a comment:
+//
+// mesh <name> <filename>
+//   Loads an OBJ or PLY file with the sutil MeshLoader. Relative filenames are relative to the scene file.
+// instance <name> <materialIndex> <m00 m01 m02 m03 m10 m11 m12 m13 m20 m21 m22 m23>
+//   Places the mesh <name> with the given row-major 3x4 object to world matrix and material parameters index.
+// builder <name> <NoAccel|Bvh|Sbvh|Trbvh>
+//   Forces the Acceleration builder of the mesh <name> instead of the selection by its size. Must precede its first instance.
+// light <name> <r g b> <m00 m01 m02 m03 m10 m11 m12 m13 m20 m21 m22 m23>
+//   Places the mesh <name> as emissive triangle mesh light with the radiant exitance <r g b> on the front faces.
+//
+// Each mesh is loaded and built only once. All its instances are Transforms above one GeometryGroup per material index
+// and these GeometryGroups share the same Acceleration, so the mesh data and its BVH exist once in GPU memory.
+// With a geometry budget each mesh becomes a page instead, which starts out as its bounding box proxy.
+// With a build budget the meshes exceeding it are split into chunks below one Group per material index.
+// With a level of detail error the resident meshes get coarser levels and their instances switch between them.
+
+struct MeshInstancing
+{
+  MeshInstancing()
+  : page(-1)
+  {
+  }
+
+  optix::Geometry                     geometry;
+  optix::Acceleration                 acceleration;
+  int                                 page;   // Index into m_geometryPages. -1 == the mesh is always resident.
+  std::string                         builder; // Empty == selectBuilder().
+  std::map<int, optix::GeometryGroup> groups; // Key is the material parameters index.
+#if USE_CHUNKED_BUILD
+  std::vector<optix::Geometry>        chunks; // Non-empty when the mesh exceeded the build budget, replaces geometry and acceleration.
+  std::vector<optix::Acceleration>    chunkAccelerations;
+  std::map<int, optix::Group>         chunkGroups; // Key is the material parameters index.
+#endif
+#if USE_MESH_LOD
+  MeshLodChain                                     lods;
+  std::map<int, std::vector<optix::GeometryGroup>> lodGroups; // Key is the material parameters index, [0] is groups[key].
+#endif
+};
+
+
+// Convert the sutil Mesh into the VertexAttributes layout used by all other geometries in this example.
+// The host arrays live in the arena only until they are converted, so all meshes of a scene reuse its blocks.
+void Application::convertMesh(std::string const& filename, MeshArena& arena, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices)
+{
+  Mesh mesh;
+  loadMesh(filename, mesh, arena);
+
+  attributes.resize(mesh.num_vertices);
+  indices.resize(mesh.num_triangles * 3);
+
+  for (int i = 0; i < mesh.num_triangles * 3; ++i)
+  {
+    indices[i] = static_cast<unsigned int>(mesh.tri_indices[i]);
+  }
+
+  for (int i = 0; i < mesh.num_vertices; ++i)
+  {
+    VertexAttributes& attrib = attributes[i];
+
+    attrib.vertex   = optix::make_float3(mesh.positions[i * 3], mesh.positions[i * 3 + 1], mesh.positions[i * 3 + 2]);
+    attrib.normal   = (mesh.has_normals) ? optix::make_float3(mesh.normals[i * 3], mesh.normals[i * 3 + 1], mesh.normals[i * 3 + 2])
+                                         : optix::make_float3(0.0f);
+    attrib.texcoord = (mesh.has_texcoords) ? optix::make_float3(mesh.texcoords[i * 2], mesh.texcoords[i * 2 + 1], 0.0f)
+                                           : optix::make_float3(0.0f);
+  }
+
+  if (!mesh.has_normals)
+  {
+    // Area weighted vertex normals from the face normals.
+    std::vector<float> normals(size_t(mesh.num_vertices) * 3);
+    computeSmoothNormals(mesh.positions, mesh.num_vertices, mesh.tri_indices, mesh.num_triangles, normals.data());
+
+    for (int i = 0; i < mesh.num_vertices; ++i)
+    {
+      attributes[i].normal = optix::make_float3(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+    }
+  }
+
+  parallelFor(0, mesh.num_vertices, [&](const int i)
+  {
+    VertexAttributes& attrib = attributes[i];
+
+    const float len = optix::length(attrib.normal);
+    attrib.normal = (0.0f < len) ? attrib.normal / len : optix::make_float3(0.0f, 1.0f, 0.0f);
+
+    // Meshes carry no tangents. Build any tangent orthogonal to the normal.
+    const optix::float3 axis = (fabsf(attrib.normal.y) < 0.999f) ? optix::make_float3(0.0f, 1.0f, 0.0f) : optix::make_float3(1.0f, 0.0f, 0.0f);
+    attrib.tangent = optix::normalize(optix::cross(axis, attrib.normal));
+  }, 16384);
+
+  std::cout << "convertMesh(" << filename << "): Vertices = " << attributes.size() <<  ", Triangles = " << indices.size() / 3 << std::endl;
+
+  arena.reset();
+}
+
+
+bool Application::loadSceneDescription(std::string const& filename)
+{
+  std::ifstream input(filename.c_str());
+  if (!input)
+  {
+    std::cerr << "ERROR: loadSceneDescription() cannot open " << filename << std::endl;
+    return false;
+  }
+
+  // Mesh filenames are relative to the scene description.
+  std::string path;
+  const std::string::size_type slash = filename.find_last_of("/\\");
+  if (slash != std::string::npos)
+  {
+    path = filename.substr(0, slash + 1);
+  }
+
+  std::map<std::string, std::string>    meshFiles;   // Mesh name to filename.
+  std::map<std::string, MeshInstancing> meshObjects; // Filename to the shared OptiX objects. Different names for the same file share the data too.
+
+  MeshArena arena; // Host arrays of the mesh files, released after the last one is converted.
+
+  unsigned int numInstances = 0;
+  unsigned int lineNumber   = 0;
+  std::string  line;
+
+  while (std::getline(input, line))
+  {
+    ++lineNumber;
+
+    const std::string::size_type comment = line.find('#');
+    if (comment != std::string::npos)
+    {
+      line.erase(comment);
+    }
+
+    std::istringstream tokens(line);
+    std::string keyword;
+    if (!(tokens >> keyword))
+    {
+      continue; // Empty line.
+    }
+
+    if (keyword == "mesh")
+    {
+      std::string name;
+      std::string file;
+      if (!(tokens >> name >> file))
+      {
+        std::cerr << "ERROR: loadSceneDescription() " << filename << "(" << lineNumber << "): mesh <name> <filename> expected" << std::endl;
+        return false;
+      }
+      if (file[0] != '/' && file[0] != '\\' && file.find(':') == std::string::npos)
+      {
+        file = path + file;
+      }
+      meshFiles[name] = file;
+    }
+#if USE_ACCELERATION_POLICY
+    else if (keyword == "builder")
+    {
+      std::string name;
+      std::string builder;
+      if (!(tokens >> name >> builder))
+      {
+        std::cerr << "ERROR: loadSceneDescription() " << filename << "(" << lineNumber << "): builder <name> <builder> expected" << std::endl;
+        return false;
+      }
+
+      std::map<std::string, std::string>::const_iterator itFile = meshFiles.find(name);
+      if (itFile == meshFiles.end())
+      {
+        std::cerr << "ERROR: loadSceneDescription() " << filename << "(" << lineNumber << "): unknown mesh " << name << std::endl;
+        return false;
+      }
+      if (!isBuilderSupported(builder))
+      {
+        std::cerr << "WARNING: loadSceneDescription() " << filename << "(" << lineNumber << "): unknown builder " << builder << " ignored" << std::endl;
+        continue;
+      }
+
+      MeshInstancing& instancing = meshObjects[itFile->second];
+      if (instancing.geometry || 0 <= instancing.page
+#if USE_CHUNKED_BUILD
+          || !instancing.chunks.empty()
+#endif
+         )
+      {
+        std::cerr << "WARNING: loadSceneDescription() " << filename << "(" << lineNumber << "): builder after the first instance of " << name << " ignored" << std::endl;
+        continue;
+      }
+      instancing.builder = builder;
+    }
+#endif
+#if USE_MESH_LIGHTS
+    else if (keyword == "light")
+    {
+      std::string name;
+      MeshLight   meshLight;
+      float       trafo[16];
+
+      tokens >> name >> meshLight.emission.x >> meshLight.emission.y >> meshLight.emission.z;
+      for (int i = 0; i < 12; ++i)
+      {
+        tokens >> trafo[i];
+      }
+      trafo[12] = 0.0f;
+      trafo[13] = 0.0f;
+      trafo[14] = 0.0f;
+      trafo[15] = 1.0f;
+
+      if (!tokens)
+      {
+        std::cerr << "ERROR: loadSceneDescription() " << filename << "(" << lineNumber << "): light <name> <r g b> <12 floats> expected" << std::endl;
+        return false;
+      }
+
+      std::map<std::string, std::string>::const_iterator itFile = meshFiles.find(name);
+      if (itFile == meshFiles.end())
+      {
+        std::cerr << "ERROR: loadSceneDescription() " << filename << "(" << lineNumber << "): unknown mesh " << name << std::endl;
+        return false;
+      }
+
+      convertMesh(itFile->second, arena, meshLight.attributes, meshLight.indices);
+
+      // Mesh lights are sampled in world space like the parallelogram lights. Bake the transform into the vertices.
+      const optix::Matrix4x4 matrix(trafo);
+      const optix::Matrix4x4 inverseTranspose = matrix.inverse().transpose();
+
+      parallelFor(0, int(meshLight.attributes.size()), [&](const int i)
+      {
+        VertexAttributes& attrib = meshLight.attributes[i];
+
+        attrib.vertex  = optix::make_float3(matrix * optix::make_float4(attrib.vertex, 1.0f));
+        attrib.tangent = optix::normalize(optix::make_float3(matrix * optix::make_float4(attrib.tangent, 0.0f)));
+        attrib.normal  = optix::normalize(optix::make_float3(inverseTranspose * optix::make_float4(attrib.normal, 0.0f)));
+      }, 16384);
+
+      m_meshLights.push_back(meshLight);
+    }
+#endif
+    else if (keyword == "instance")
+    {
+      std::string name;
+      int materialIndex;
+      float trafo[16];
+      
+      tokens >> name >> materialIndex;
+      for (int i = 0; i < 12; ++i)
+      {
+        tokens >> trafo[i];
+      }
+      trafo[12] = 0.0f;
+      trafo[13] = 0.0f;
+      trafo[14] = 0.0f;
+      trafo[15] = 1.0f;
+
+      if (!tokens)
+      {
+        std::cerr << "ERROR: loadSceneDescription() " << filename << "(" << lineNumber << "): instance <name> <materialIndex> <12 floats> expected" << std::endl;
+        return false;
+      }
+
+      std::map<std::string, std::string>::const_iterator itFile = meshFiles.find(name);
+      if (itFile == meshFiles.end())
+      {
+        std::cerr << "ERROR: loadSceneDescription() " << filename << "(" << lineNumber << "): unknown mesh " << name << std::endl;
+        return false;
+      }
+
+      if (materialIndex < 0 || int(m_guiMaterialParameters.size()) <= materialIndex)
+      {
+        std::cerr << "WARNING: loadSceneDescription() " << filename << "(" << lineNumber << "): material index " << materialIndex << " clamped" << std::endl;
+        materialIndex = std::max(0, std::min(materialIndex, int(m_guiMaterialParameters.size()) - 1));
+      }
+
+      MeshInstancing& instancing = meshObjects[itFile->second];
+      bool created = instancing.geometry || 0 <= instancing.page;
+#if USE_CHUNKED_BUILD
+      created = created || !instancing.chunks.empty();
+#endif
+      if (!created)
+      {
+        std::vector<VertexAttributes> attributes;
+        std::vector<unsigned int>     indices;
+
+        convertMesh(itFile->second, arena, attributes, indices);
+
+#if USE_GEOMETRY_PAGING
+        if (0.0f < m_geometryBudget)
+        {
+          instancing.page = int(createGeometryPage(attributes, indices)); // Takes over the host arrays.
+#if USE_ACCELERATION_POLICY
+          m_geometryPages[instancing.page].builder = instancing.builder;
+#endif
+        }
+        else
+#endif
+#if USE_CHUNKED_BUILD
+        if (0.0f < m_buildBudget && size_t(double(m_buildBudget) * 1024.0 * 1024.0) < estimateBuildBytes(attributes.size(), indices.size() / 3))
+        {
+          splitMeshChunks(attributes, indices, instancing.chunks);
+          for (size_t i = 0; i < instancing.chunks.size(); ++i)
+          {
+            instancing.chunkAccelerations.push_back(createAcceleration(instancing.chunks[i]->getPrimitiveCount(), ACCELERATION_STATIC, instancing.builder));
+          }
+        }
+        else
+#endif
+        {
+          instancing.geometry = createGeometry(attributes, indices);
+
+          instancing.acceleration = createAcceleration(instancing.geometry->getPrimitiveCount(), ACCELERATION_STATIC, instancing.builder);
+#if USE_MESH_LOD
+          if (0.0f < m_lodError)
+          {
+            createMeshLods(attributes, indices, instancing.builder, instancing.lods);
+          }
+#endif
+        }
+      }
+
+      optix::Transform tr = m_context->createTransform();
+
+#if USE_CHUNKED_BUILD
+      if (!instancing.chunks.empty())
+      {
+        optix::Group& group = instancing.chunkGroups[materialIndex];
+        if (!group)
+        {
+          group = createChunkGroup(instancing.chunks, instancing.chunkAccelerations, materialIndex);
+        }
+        tr->setChild(group);
+      }
+      else
+#endif
+      {
+        optix::GeometryGroup& gg = instancing.groups[materialIndex];
+#if USE_GEOMETRY_PAGING
+        if (!gg && 0 <= instancing.page)
+        {
+          gg = createPageGroup(size_t(instancing.page), materialIndex);
+        }
+#endif
+        if (!gg)
+        {
+          optix::GeometryInstance gi = m_context->createGeometryInstance();
+          setInstanceGeometry(gi, instancing.geometry);
+          gi->setMaterialCount(1);
+          gi->setMaterial(0, getMaterial(materialIndex));
+          gi["parMaterialIndex"]->setInt(materialIndex);
+
+          gg = m_context->createGeometryGroup();
+          gg->setAcceleration(instancing.acceleration); // Shared, the GeometryGroups only differ in the material.
+          gg->setChildCount(1);
+          gg->setChild(0, gi);
+        }
+        tr->setChild(gg);
+      }
+
+      optix::Matrix4x4 matrix(trafo);
+
+      tr->setMatrix(false, matrix.getData(), matrix.inverse().getData());
+
+#if USE_MESH_LOD
+      if (!instancing.lods.levels.empty())
+      {
+        std::vector<optix::GeometryGroup>& groups = instancing.lodGroups[materialIndex];
+        if (groups.empty())
+        {
+          groups.push_back(instancing.groups[materialIndex]);
+          for (size_t i = 0; i < instancing.lods.levels.size(); ++i)
+          {
+            optix::GeometryInstance gi = m_context->createGeometryInstance();
+            setInstanceGeometry(gi, instancing.lods.levels[i].geometry);
+            gi->setMaterialCount(1);
+            gi->setMaterial(0, getMaterial(materialIndex));
+            gi["parMaterialIndex"]->setInt(materialIndex);
+
+            optix::GeometryGroup gg = m_context->createGeometryGroup();
+            gg->setAcceleration(instancing.lods.levels[i].acceleration);
+            gg->setChildCount(1);
+            gg->setChild(0, gi);
+
+            groups.push_back(gg);
+          }
+        }
+        addLodInstance(tr, matrix, instancing.lods, groups);
+      }
+#endif
+
+      const unsigned int count = m_rootGroup->getChildCount();
+      m_rootGroup->setChildCount(count + 1);
+      m_rootGroup->setChild(count, tr);
+
+      ++numInstances;
+    }
+    else
+    {
+      std::cerr << "WARNING: loadSceneDescription() " << filename << "(" << lineNumber << "): unknown keyword " << keyword << " ignored" << std::endl;
+    }
+  }
+
+  std::cout << "loadSceneDescription(" << filename << "): Meshes = " << meshObjects.size() << ", Instances = " << numInstances << std::endl;
+
+  return true;
+}
@@ -0,0 +1,472 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#if USE_SCENE_RELOAD
+
+#include "inc/Application.h"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+
+// Scene exchange inside the running OptiX context.
+// The Programs in m_mapOfPrograms, the kernels compiled from them, the per pixel buffers, the denoiser stage and the
+// built-in material textures don't depend on the scene and are kept. unloadScene() destroys every OptiX object which
+// createScene() and initScene() made for the current scene, then initScene() runs again for the new one.
+// A reload only pays for the new geometry uploads and Acceleration builds, plus a kernel compile when the new scene
+// needs a different set of programs than the last launch.
+// The miss program is selected by initRenderer(), so a reload can exchange the HDR environment, not the environment type.
+
+namespace
+{
+  // The unique OptiX objects of a scene graph by their API handles. Instanced meshes share Geometries, Buffers and Accelerations.
+  class SceneObjects
+  {
+  public:
+    SceneObjects(optix::Context context, const bool geometryTriangles)
+    : m_context(context)
+    , m_geometryTriangles(geometryTriangles)
+    {
+    }
+
+    void addGroup(optix::Group group)
+    {
+      if (!m_groups.insert(std::make_pair(group->get(), group)).second)
+      {
+        return;
+      }
+      addAcceleration(group->getAcceleration());
+
+      for (unsigned int i = 0; i < group->getChildCount(); ++i)
+      {
+        switch (group->getChildType(i))
+        {
+        case RT_OBJECTTYPE_TRANSFORM:
+          addTransform(group->getChild<optix::Transform>(i));
+          break;
+        case RT_OBJECTTYPE_GROUP:
+          addGroup(group->getChild<optix::Group>(i));
+          break;
+        case RT_OBJECTTYPE_GEOMETRY_GROUP:
+          addGeometryGroup(group->getChild<optix::GeometryGroup>(i));
+          break;
+        default:
+          break;
+        }
+      }
+    }
+
+    void addTransform(optix::Transform transform)
+    {
+      if (!m_transforms.insert(std::make_pair(transform->get(), transform)).second)
+      {
+        return;
+      }
+
+      switch (transform->getChildType())
+      {
+      case RT_OBJECTTYPE_TRANSFORM:
+        addTransform(transform->getChild<optix::Transform>());
+        break;
+      case RT_OBJECTTYPE_GROUP:
+        addGroup(transform->getChild<optix::Group>());
+        break;
+      case RT_OBJECTTYPE_GEOMETRY_GROUP:
+        addGeometryGroup(transform->getChild<optix::GeometryGroup>());
+        break;
+      default:
+        break;
+      }
+    }
+
+    void addGeometryGroup(optix::GeometryGroup group)
+    {
+      if (!m_geometryGroups.insert(std::make_pair(group->get(), group)).second)
+      {
+        return;
+      }
+      addAcceleration(group->getAcceleration());
+
+      for (unsigned int i = 0; i < group->getChildCount(); ++i)
+      {
+        addInstance(group->getChild(i));
+      }
+    }
+
+    void addInstance(optix::GeometryInstance instance)
+    {
+      if (!m_instances.insert(std::make_pair(instance->get(), instance)).second)
+      {
+        return;
+      }
+
+#if OPTIX_VERSION >= 60000
+      if (m_geometryTriangles)
+      {
+        addTriangles(instance->getGeometryTriangles());
+      }
+      else
+#endif
+      {
+        addGeometry(instance->getGeometry());
+      }
+
+#if USE_CUTOUT_CLASSIFICATION
+      // The classification states are referenced by their bindless ID.
+      optix::Variable states = instance->queryVariable("parCutoutStates");
+      if (states && states->getInt() != RT_BUFFER_ID_NULL)
+      {
+        addBuffer(m_context->getBufferFromId(states->getInt()));
+      }
+#endif
+    }
+
+    void addGeometry(optix::Geometry geometry)
+    {
+      if (geometry && m_geometries.insert(std::make_pair(geometry->get(), geometry)).second)
+      {
+        addVariableBuffers(geometry);
+      }
+    }
+
+#if OPTIX_VERSION >= 60000
+    void addTriangles(optix::GeometryTriangles triangles)
+    {
+      if (triangles && m_triangles.insert(std::make_pair(triangles->get(), triangles)).second)
+      {
+        addVariableBuffers(triangles);
+      }
+    }
+#endif
+
+    void addAcceleration(optix::Acceleration acceleration)
+    {
+      if (acceleration)
+      {
+        m_accelerations[acceleration->get()] = acceleration;
+      }
+    }
+
+    void addBuffer(optix::Buffer buffer)
+    {
+      if (buffer)
+      {
+        m_buffers[buffer->get()] = buffer;
+      }
+    }
+
+    // Top down, so no destroyed object is referenced by a living one.
+    void destroy()
+    {
+      destroyAll(m_transforms);
+      destroyAll(m_groups);
+      destroyAll(m_geometryGroups);
+      destroyAll(m_instances);
+#if OPTIX_VERSION >= 60000
+      destroyAll(m_triangles);
+#endif
+      destroyAll(m_geometries);
+      destroyAll(m_accelerations);
+      destroyAll(m_buffers);
+    }
+
+    size_t getInstanceCount() const
+    {
+      return m_instances.size();
+    }
+
+    size_t getBufferCount() const
+    {
+      return m_buffers.size();
+    }
+
+  private:
+    // The vertex attributes, indices and positions of the meshes are variables of their Geometry or GeometryTriangles.
+    template <typename T>
+    void addVariableBuffers(T object)
+    {
+      for (unsigned int i = 0; i < object->getVariableCount(); ++i)
+      {
+        optix::Variable variable = object->getVariable(i);
+        if (variable->getType() == RT_OBJECTTYPE_BUFFER)
+        {
+          addBuffer(variable->getBuffer());
+        }
+      }
+    }
+
+    template <typename K, typename T>
+    static void destroyAll(std::map<K, T>& objects)
+    {
+      for (typename std::map<K, T>::iterator it = objects.begin(); it != objects.end(); ++it)
+      {
+        it->second->destroy();
+      }
+      objects.clear();
+    }
+
+    optix::Context m_context;
+    bool           m_geometryTriangles;
+
+    std::map<RTtransform,         optix::Transform>         m_transforms;
+    std::map<RTgroup,             optix::Group>             m_groups;
+    std::map<RTgeometrygroup,     optix::GeometryGroup>     m_geometryGroups;
+    std::map<RTgeometryinstance,  optix::GeometryInstance>  m_instances;
+#if OPTIX_VERSION >= 60000
+    std::map<RTgeometrytriangles, optix::GeometryTriangles> m_triangles;
+#endif
+    std::map<RTgeometry,          optix::Geometry>          m_geometries;
+    std::map<RTacceleration,      optix::Acceleration>      m_accelerations;
+    std::map<RTbuffer,            optix::Buffer>            m_buffers;
+  };
+}
+
+
+bool Application::reloadScene(std::string const& sceneFilename, std::string const& environmentFilename)
+{
+  if (!sceneFilename.empty() && !std::ifstream(sceneFilename).good())
+  {
+    std::cerr << "ERROR: reloadScene() can't open " << sceneFilename << std::endl;
+    return false; // Keep the current scene instead of falling back to the demo scene.
+  }
+
+  Timer timer;
+
+  std::cout << "unloadScene()" << std::endl;
+  unloadScene();
+  std::cout << "  unloadScene() = " << timer.getTime() << " seconds" << std::endl;
+
+  m_sceneFilename = sceneFilename;
+#if USE_STRESS_SCENE
+  m_stressScene.clear(); // A scene description or the demo scene replaces the generated scene.
+#endif
+
+  if (!environmentFilename.empty())
+  {
+    if (m_missID == 2)
+    {
+      m_environmentFilename = environmentFilename;
+    }
+    else
+    {
+      std::cerr << "WARNING: reloadScene() environment " << environmentFilename << " ignored, the miss program has no environment map" << std::endl;
+    }
+  }
+
+  initScene(); // Prints the timings of the new scene.
+
+#if USE_RASTER_PRIMARY
+  if (m_rasterInitialized)
+  {
+    initRasterMeshes();
+  }
+#endif
+
+  restartAccumulation(); // The camera is kept.
+  return true;
+}
+
+
+void Application::unloadScene()
+{
+  m_uploader->flush(); // No staged copy may target a destroyed buffer.
+
+#if USE_RASTER_PRIMARY
+  destroyRasterMeshes();
+#endif
+
+  try
+  {
+    SceneObjects objects(m_context, m_geometryTriangles);
+
+    if (m_rootGroup)
+    {
+      objects.addGroup(m_rootGroup); // Also the root Acceleration.
+    }
+
+#if USE_MESH_LOD
+    // Only the current level of each instance is attached to the scene graph.
+    for (size_t i = 0; i < m_lodInstances.size(); ++i)
+    {
+      for (size_t j = 0; j < m_lodInstances[i].groups.size(); ++j)
+      {
+        objects.addGeometryGroup(m_lodInstances[i].groups[j]);
+      }
+    }
+#endif
+
+#if USE_GEOMETRY_PAGING
+    // Non-resident pages have the proxy attached instead of their mesh, the resident ones the other way round.
+    for (size_t i = 0; i < m_geometryPages.size(); ++i)
+    {
+      GeometryPage const& page = m_geometryPages[i];
+
+      for (size_t j = 0; j < page.groups.size(); ++j)
+      {
+        objects.addGeometryGroup(page.groups[j]);
+      }
+      if (page.proxy)
+      {
+        objects.addInstance(page.proxy);
+      }
+      objects.addAcceleration(page.proxyAcceleration);
+      objects.addAcceleration(page.acceleration);
+      objects.addGeometry(page.geometry);
+    }
+    objects.addBuffer(m_bufferPageCounters);
+#endif
+
+#if OPTIX_VERSION >= 60000
+    // With GeometryTriangles the GeometryInstances don't reference the custom primitive Geometry they were created from.
+    for (std::map<RTgeometry, optix::GeometryTriangles>::const_iterator it = m_mapOfGeometryTriangles.begin(); it != m_mapOfGeometryTriangles.end(); ++it)
+    {
+      objects.addGeometry(optix::Geometry::take(it->first));
+      objects.addTriangles(it->second);
+    }
+#endif
+
+    std::cout << "  Instances = " << objects.getInstanceCount() << ", Buffers = " << objects.getBufferCount() << std::endl;
+
+    objects.destroy();
+
+    // Materials, recreated by initMaterials().
+    m_opaqueMaterial->destroy();
+    m_cutoutMaterial->destroy();
+    m_lightMaterial->destroy();
+#if USE_SPECIALIZED_MATERIALS
+    for (size_t i = 0; i < m_materials.size(); ++i)
+    {
+      m_materials[i]->destroy();
+    }
+#endif
+    m_bufferMaterialParameters->destroy();
+#if USE_INCREMENTAL_MATERIALS
+    m_bufferMaterialUpdates->destroy();
+#endif
+
+#if USE_STRESS_SCENE
+    for (size_t i = 0; i < m_stressTextures.size(); ++i)
+    {
+      optix::Buffer buffer = m_stressTextures[i]->getBuffer();
+      m_stressTextures[i]->destroy();
+      buffer->destroy();
+    }
+#endif
+
+#if USE_HETEROGENEOUS_MEDIA
+    destroyMedia(); // The m_mediumConfigs are applied to the new scene by initMedia(), sysMedia is reused.
+#endif
+
+    // Lights, recreated by createLights(). The light alias table is resized by buildLightAliasTable().
+    m_bufferLightDefinitions->destroy();
+#if USE_MESH_LIGHTS
+    for (size_t i = 0; i < m_meshLightBuffers.size(); ++i)
+    {
+      m_meshLightBuffers[i]->destroy();
+    }
+#endif
+    if (m_missID == 2)
+    {
+      m_environmentTexture.destroy();
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+
+  m_rootGroup        = nullptr;
+  m_rootAcceleration = nullptr;
+
+#if OPTIX_VERSION >= 60000
+  m_mapOfGeometryTriangles.clear();
+#endif
+
+  m_opaqueMaterial = nullptr;
+  m_cutoutMaterial = nullptr;
+  m_lightMaterial  = nullptr;
+#if USE_SPECIALIZED_MATERIALS
+  m_materials.clear();
+#endif
+  m_guiMaterialParameters.clear();
+  m_bufferMaterialParameters = nullptr;
+#if USE_INCREMENTAL_MATERIALS
+  m_bufferMaterialUpdates = nullptr;
+  m_materialParameters.clear();
+  m_materialsDirty.clear();
+  m_materialDirtyFlags.clear();
+#endif
+
+  m_lightDefinitions.clear();
+#if USE_MESH_LIGHTS
+  m_meshLights.clear(); // The scene description of the next scene has its own light statements.
+  m_meshLightBuffers.clear();
+#endif
+  m_bufferLightDefinitions = nullptr;
+
+  m_accelerationCacheEntries.clear();
+#if USE_ACCELERATION_POLICY
+  m_fixedBuilders.clear();
+#endif
+
+#if USE_DYNAMIC_SCENE
+  m_dynamicInstances.clear();
+  m_dynamicMeshes.clear();
+  m_animationRest.clear();
+  m_dynamicChanged = false;
+#endif
+
+#if USE_GEOMETRY_PAGING
+  m_geometryPages.clear(); // m_pageProxyMaterial only holds programs and is kept.
+  m_bufferPageCounters = nullptr;
+#endif
+
+#if USE_MESH_LOD
+  m_lodInstances.clear();
+#endif
+
+#if USE_STRESS_SCENE
+  m_stressTextures.clear();
+#endif
+
+#if USE_WEDGE
+  m_wedgeDirty  = true;  // The variants are converted from the new materials.
+  m_wedgeActive = false; // initMaterials() binds sysMaterialParameters to the GUI materials.
+#endif
+
+#if USE_RESTIR
+  m_restirValid = false; // The reservoirs reference the old lights.
+#endif
+
+#if USE_RADIANCE_CACHE
+  m_cacheReset = true;
+#endif
+}
+
+#endif // USE_SCENE_RELOAD
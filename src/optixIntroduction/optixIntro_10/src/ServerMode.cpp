@@ -0,0 +1,415 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_RENDER_SERVER
+
+#include <sutil.h>
+#include <NvtxRange.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// Render server protocol. One command per line, every command gets exactly one reply line:
+//
+//   camera <cx> <cy> <cz> <distance> <phi> <theta> <fov>  Place the camera, see PinholeCamera::setOrbit().
+//   orbit <dx> <dy> | pan <dx> <dy> | dolly <dx> <dy>     Move the camera like a mouse drag of dx, dy pixels.
+//   zoom <degrees>                                         Change the field of view.
+//   resize <width> <height>                                Change the resolution.
+//   set <name> <value>                                     Tonemapper (gamma, whitePoint, brightness, burnHighlights,
+//                                                          crushBlacks, saturation) or renderer (frames, minPath, maxPath,
+//                                                          accumulate 0|1 to stop the accumulation between commands).
+//   matrix <instance> <m00 m01 m02 m03 ... m23>            Set the row-major 3x4 object to world matrix of a dynamic instance.
+//   scene <filename> [<environment>]                       Replace the scene description ("-" == demo scene) and optionally
+//                                                          the HDR environment in the same OptiX context, see src/SceneReload.cpp.
+//   frame                                                  Reply "FRAME <width> <height> <iteration> <bytes>", followed by
+//                                                          the bytes of the current image as PNG, denoised when enabled.
+//   tile <x> <y> <width> <height> <spp>                    Render sample indices [0, spp) of this rectangle. Reply
+//                                                          "TILE <x> <y> <width> <height> <layers> <bytes>", followed by
+//                                                          the RGBA32F rows of the beauty and the denoiser guide layers.
+//   quit                                                   Stop the server.
+//
+// The other replies are "OK" or "ERROR <reason>". Changes of the camera, resolution and renderer parameters restart
+// the accumulation, which continues between the commands until the frames limit or the convergence is reached.
+//
+// The frames are tonemapped and quantized on the device, so only a quarter of the RGBA32F data is read back,
+// and PNG compressed on the host. A hardware video encoder would take the sysEncodeBuffer contents instead.
+
+void Application::serve(const int port)
+{
+  RenderServer server;
+  if (!server.listen(port))
+  {
+    return;
+  }
+
+  bool running = true;
+  while (running)
+  {
+    const bool done = !isAccumulating();
+    const bool accumulating = server.isConnected() && m_serverAccumulate && !done;
+
+    // Do not spin while there is nothing to render.
+    std::vector<std::string> commands;
+    server.poll(commands, (accumulating) ? 0 : 10);
+
+    for (size_t i = 0; i < commands.size() && running; ++i)
+    {
+      running = serverCommand(server, commands[i]);
+    }
+
+    if (running && accumulating)
+    {
+      render();
+    }
+  }
+}
+
+bool Application::serverCommand(RenderServer& server, std::string const& command)
+{
+  std::istringstream stream(command);
+
+  std::string name;
+  stream >> name;
+
+  bool valid = true;
+  try
+  {
+    if (name == "camera")
+    {
+      optix::float3 center;
+      float distance;
+      float phi;
+      float theta;
+      float fov;
+      valid = !!(stream >> center.x >> center.y >> center.z >> distance >> phi >> theta >> fov);
+      if (valid)
+      {
+        m_pinholeCamera.setOrbit(center, distance, phi, theta, fov); // Picked up with the next getFrustum() in render().
+      }
+    }
+    else if (name == "orbit" || name == "pan" || name == "dolly")
+    {
+      int dx;
+      int dy;
+      valid = !!(stream >> dx >> dy);
+      if (valid)
+      {
+        m_pinholeCamera.setBaseCoordinates(0, 0);
+        if (name == "orbit")
+        {
+          m_pinholeCamera.orbit(dx, dy);
+        }
+        else if (name == "pan")
+        {
+          m_pinholeCamera.pan(dx, dy);
+        }
+        else
+        {
+          m_pinholeCamera.dolly(dx, dy);
+        }
+      }
+    }
+    else if (name == "zoom")
+    {
+      float degrees;
+      valid = !!(stream >> degrees);
+      if (valid)
+      {
+        m_pinholeCamera.zoom(degrees);
+      }
+    }
+    else if (name == "resize")
+    {
+      int width;
+      int height;
+      valid = !!(stream >> width >> height) && 0 < width && 0 < height;
+      if (valid)
+      {
+        reshape(width, height);
+      }
+    }
+    else if (name == "set")
+    {
+      std::string parameter;
+      float value;
+      valid = !!(stream >> parameter >> value) && serverParameter(parameter, value);
+    }
+#if USE_DYNAMIC_SCENE
+    else if (name == "matrix")
+    {
+      unsigned int instance;
+      float m[16] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+      valid = !!(stream >> instance);
+      for (int i = 0; i < 12 && valid; ++i)
+      {
+        valid = !!(stream >> m[i]);
+      }
+      valid = valid && setInstanceMatrix(instance, optix::Matrix4x4(m)); // Picked up with the next updateDynamicScene() in render().
+      if (valid)
+      {
+        restartAccumulation(); // Also continues rendering after the frames limit was reached.
+      }
+    }
+#endif
+#if USE_SCENE_RELOAD
+    else if (name == "scene")
+    {
+      std::string scene;
+      std::string environment;
+      valid = !!(stream >> scene);
+      stream >> environment; // Optional.
+      valid = valid && reloadScene((scene == "-") ? std::string() : scene, environment);
+    }
+#endif
+#if USE_TILED_LAUNCH
+    else if (name == "tile")
+    {
+      int x;
+      int y;
+      int width;
+      int height;
+      int spp;
+      valid = !!(stream >> x >> y >> width >> height >> spp) &&
+              0 <= x && 0 < width && x + width <= m_width && 0 <= y && 0 < height && y + height <= m_height && 0 < spp;
+      if (valid)
+      {
+        serverTile(server, x, y, width, height, spp);
+        return true; // The tile header is the reply.
+      }
+    }
+#endif
+    else if (name == "frame")
+    {
+      serverFrame(server);
+      return true; // The frame header is the reply.
+    }
+    else if (name == "quit")
+    {
+      server.send("OK");
+      return false;
+    }
+    else
+    {
+      server.send("ERROR unknown command " + name);
+      return true;
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+    server.send("ERROR " + e.getErrorString());
+    return true;
+  }
+
+  server.send((valid) ? "OK" : "ERROR invalid arguments: " + command);
+  return true;
+}
+
+bool Application::serverParameter(std::string const& name, const float value)
+{
+  // Tonemapper parameters only affect the encoding of the next frame.
+  if (name == "gamma" && 0.01f <= value) // Must not get 0.0f
+  {
+    m_gamma = value;
+  }
+  else if (name == "whitePoint" && 0.01f <= value) // Must not get 0.0f
+  {
+    m_whitePoint = value;
+  }
+  else if (name == "brightness")
+  {
+    m_brightness = value;
+  }
+  else if (name == "burnHighlights")
+  {
+    m_burnHighlights = value;
+  }
+  else if (name == "crushBlacks")
+  {
+    m_crushBlacks = value;
+  }
+  else if (name == "saturation")
+  {
+    m_saturation = value;
+  }
+  // Renderer parameters.
+  else if (name == "accumulate")
+  {
+    m_serverAccumulate = (value != 0.0f);
+  }
+  else if (name == "frames" && 0.0f <= value)
+  {
+    m_frames = int(value); // 0 == accumulate without limit.
+    restartAccumulation();
+  }
+  else if ((name == "minPath" || name == "maxPath") && 0.0f <= value)
+  {
+    ((name == "minPath") ? m_minPathLength : m_maxPathLength) = int(value);
+    m_context["sysPathLengths"]->setInt(m_minPathLength, m_maxPathLength);
+    restartAccumulation();
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+void Application::serverFrame(RenderServer& server)
+{
+  SUTIL_NVTX_RANGE("serverFrame");
+
+  resolveAccumulation();
+
+  optix::Buffer source = m_bufferOutput;
+#if USE_DENOISER
+  if (m_useDenoiser)
+  {
+    if (m_denoisedIteration != m_iterationIndex) // Clients asking faster than the accumulation get the same image again.
+    {
+      m_profiler.begin(PROFILER_DENOISER);
+      denoise();
+      m_profiler.end(PROFILER_DENOISER);
+
+      m_denoisedIteration = m_iterationIndex;
+    }
+    source = m_bufferDenoised;
+  }
+#endif
+
+  m_profiler.begin(PROFILER_UPLOAD);
+
+  m_context["sysEncodeSource"]->setBuffer(source);
+  setTonemapVariables();
+
+  m_context->launch(ENTRY_ENCODE_RGBA8, m_width, m_height);
+
+  std::vector<unsigned char> png;
+
+  const unsigned char* pixels = static_cast<const unsigned char*>(m_bufferEncode->map(0, RT_BUFFER_MAP_READ));
+  const bool encoded = sutil::encodePNG(pixels, m_width, m_height, 4, png);
+  m_bufferEncode->unmap();
+
+  m_profiler.end(PROFILER_UPLOAD);
+
+  if (!encoded)
+  {
+    server.send("ERROR PNG encoding failed");
+    return;
+  }
+
+  std::ostringstream header;
+  header << "FRAME " << m_width << " " << m_height << " " << m_iterationIndex << " " << png.size();
+  server.send(header.str(), png.data(), png.size());
+}
+
+#if USE_TILED_LAUNCH
+// The RGBA32F buffers a distributed rendering worker returns per tile, in this order.
+void Application::getTileLayers(std::vector<optix::Buffer>& layers) const
+{
+  layers.clear();
+  layers.push_back(m_bufferOutput);
+#if USE_DENOISER && USE_DENOISER_ALBEDO
+  if (m_useDenoiserAlbedo)
+  {
+    layers.push_back(m_bufferAlbedo);
+  }
+#if USE_DENOISER_NORMAL
+  if (m_useDenoiserNormal)
+  {
+    layers.push_back(m_bufferNormals);
+  }
+#endif
+#endif
+}
+
+// Renders the tile with the same sample indices as the full resolution launches of a local render,
+// so the tiles of all workers merge into the same image. The interactive accumulation is lost.
+void Application::serverTile(RenderServer& server, const int x, const int y, const int width, const int height, const int spp)
+{
+  SUTIL_NVTX_RANGE("serverTile");
+
+#if USE_GPU_LOCAL_ACCUMULATION
+  if (m_localAccumulation)
+  {
+    // The tile launches would distribute the pixels differently among the devices than the resolve launch.
+    server.send("ERROR tiles need a single device per worker, start one worker per device with --devices");
+    return;
+  }
+#endif
+
+  finishTextures(); // Offline results must not contain placeholder texels.
+
+  m_context["sysTileOffset"]->setUint(x, y);
+  int samples = 1;
+  for (int i = 0; i < spp; i += samples)
+  {
+#if USE_SAMPLES_PER_LAUNCH
+    samples = std::max(1, std::min(m_samplesPerLaunch, spp - i)); // The same samples as one launch per sample.
+    m_context["sysSamplesPerLaunch"]->setInt(samples);
+#endif
+    m_context["sysIterationIndex"]->setInt(i);
+    m_context->launch(ENTRY_RENDER_TILE, width, height);
+#if USE_DENOISER && USE_DENOISER_ALBEDO && USE_DENOISER_GBUFFER
+    renderGuideBuffers(i, samples); // Full resolution, it's cheap and only runs for the first samples.
+#endif
+  }
+  m_context["sysTileOffset"]->setUint(0, 0);
+
+  std::vector<optix::Buffer> layers;
+  getTileLayers(layers);
+
+  const size_t rowFloats   = size_t(width) * 4;
+  const size_t layerFloats = rowFloats * height;
+
+  std::vector<float> data(layers.size() * layerFloats);
+  for (size_t layer = 0; layer < layers.size(); ++layer)
+  {
+    const float* src = static_cast<const float*>(layers[layer]->map(0, RT_BUFFER_MAP_READ));
+    for (int row = 0; row < height; ++row)
+    {
+      memcpy(&data[layer * layerFloats + row * rowFloats], src + (size_t(y + row) * m_width + x) * 4, rowFloats * sizeof(float));
+    }
+    layers[layer]->unmap();
+  }
+
+  restartAccumulation(); // The tile launches overwrote the interactive accumulation.
+
+  std::ostringstream header;
+  header << "TILE " << x << " " << y << " " << width << " " << height << " " << layers.size() << " " << data.size() * sizeof(float);
+  server.send(header.str(), data.data(), data.size() * sizeof(float));
+}
+#endif // USE_TILED_LAUNCH
+
+#endif // USE_RENDER_SERVER
@@ -0,0 +1,328 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/Application.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include <sutil.h>
+#include <sampleConfig.h>
+
+#include "shaders/per_ray_data.h"
+
+#if USE_RUNTIME_COMPILATION
+#include <nvrtc.h>
+#endif
+
+static const char* const SAMPLE_NAME = "optixIntro_10";
+
+// The app_config.h switches which can be changed with --define.
+// The host code only contains the denoiser buffers and stages which were compiled in, so these can only be disabled.
+struct ShaderSwitch
+{
+  const char* name;
+  int         compiledValue;
+  int         minValue;
+  int         maxValue;
+};
+
+static const ShaderSwitch shaderSwitches[] =
+{
+  { "USE_NEXT_EVENT_ESTIMATION", USE_NEXT_EVENT_ESTIMATION, 0, 1 },
+  { "USE_DENOISER",              USE_DENOISER,              0, USE_DENOISER },
+  { "USE_DENOISER_ALBEDO",       USE_DENOISER_ALBEDO,       0, USE_DENOISER_ALBEDO },
+  { "USE_DENOISER_NORMAL",       USE_DENOISER_NORMAL,       0, USE_DENOISER_NORMAL },
+  { "USE_DEBUG_EXCEPTIONS",      USE_DEBUG_EXCEPTIONS,      0, 1 },
+  { "MATERIAL_STACK_SIZE",       MATERIAL_STACK_SIZE,       1, 64 }
+};
+
+
+// Each define is "NAME=VALUE". Only values which differ from the compiled ones are kept.
+void Application::setShaderDefines(std::vector<std::string> const& shaderDefines)
+{
+  m_shaderDefines.clear();
+
+  for (size_t i = 0; i < shaderDefines.size(); ++i)
+  {
+    std::string const& define = shaderDefines[i];
+
+    const std::string::size_type equal = define.find('=');
+    const std::string name = define.substr(0, equal);
+
+    const ShaderSwitch* sw = nullptr;
+    for (size_t j = 0; j < sizeof(shaderSwitches) / sizeof(shaderSwitches[0]); ++j)
+    {
+      if (name == shaderSwitches[j].name)
+      {
+        sw = &shaderSwitches[j];
+      }
+    }
+    if (!sw || equal == std::string::npos)
+    {
+      throw optix::Exception("setShaderDefines(): Unknown shader switch '" + define + "'");
+    }
+
+    const std::string valueString = define.substr(equal + 1);
+    char* end = nullptr;
+    const long value = strtol(valueString.c_str(), &end, 10);
+    if (valueString.empty() || *end != '\0' || value < sw->minValue || sw->maxValue < value)
+    {
+      std::ostringstream message;
+      message << "setShaderDefines(): " << name << " must be in the range [" << sw->minValue << ", " << sw->maxValue << "]";
+      throw optix::Exception(message.str());
+    }
+
+    if (value != sw->compiledValue)
+    {
+      m_shaderDefines[name] = int(value);
+    }
+    else
+    {
+      m_shaderDefines.erase(name);
+    }
+  }
+
+#if !USE_RUNTIME_COMPILATION
+  if (!m_shaderDefines.empty())
+  {
+    throw optix::Exception("setShaderDefines(): Changing shader switches needs USE_RUNTIME_COMPILATION");
+  }
+#endif
+}
+
+
+int Application::getShaderDefine(std::string const& name, const int compiledValue) const
+{
+  std::map<std::string, int>::const_iterator it = m_shaderDefines.find(name);
+  return (it != m_shaderDefines.end()) ? it->second : compiledValue;
+}
+
+
+#if USE_RUNTIME_COMPILATION
+// 64-bit FNV-1a.
+static unsigned long long hashBytes(unsigned long long hash, const void* data, const size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static unsigned long long hashString(unsigned long long hash, std::string const& s)
+{
+  return hashBytes(hash, s.c_str(), s.size() + 1); // Including the terminator to separate consecutive strings.
+}
+
+static bool readFile(std::string const& filename, std::string& contents)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+  std::stringstream data;
+  data << file.rdbuf();
+  contents = data.str();
+  return true;
+}
+
+// Hashes the source file and all local headers it includes, directly or indirectly.
+// The headers of OptiX and CUDA are covered by their versions in the cache key.
+static unsigned long long hashSource(unsigned long long hash, std::string const& directory, std::string const& filename, std::set<std::string>& visited)
+{
+  std::string source;
+  if (!visited.insert(filename).second || !readFile(directory + "/" + filename, source))
+  {
+    return hash;
+  }
+  hash = hashString(hash, filename);
+  hash = hashString(hash, source);
+
+  std::istringstream lines(source);
+  std::string line;
+  while (std::getline(lines, line))
+  {
+    const std::string::size_type include = line.find("#include \"");
+    if (include != std::string::npos)
+    {
+      const std::string::size_type begin = include + 10;
+      const std::string::size_type end   = line.find('"', begin);
+      if (end != std::string::npos)
+      {
+        hash = hashSource(hash, directory, line.substr(begin, end - begin), visited);
+      }
+    }
+  }
+  return hash;
+}
+
+static void checkNVRTC(const nvrtcResult result, std::string const& cudaFile)
+{
+  if (result != NVRTC_SUCCESS)
+  {
+    throw optix::Exception("NVRTC error for " + cudaFile + ": " + nvrtcGetErrorString(result));
+  }
+}
+#endif // USE_RUNTIME_COMPILATION
+
+
+// This only runs inside the OptiX Advanced Samples location,
+// unless the environment variable OPTIX_SAMPLES_SDK_PTX_DIR is set.
+// A standalone application which should run anywhere would place the *.ptx files 
+// into a subdirectory next to the executable and use a relative file path here!
+std::string Application::ptxPath(std::string const& cudaFile)
+{
+#if USE_RUNTIME_COMPILATION
+  if (!m_shaderDefines.empty())
+  {
+    return compileShader(cudaFile);
+  }
+#endif
+  return std::string(sutil::samplesPTXDir()) + std::string("/") + 
+         std::string(SAMPLE_NAME) + std::string("_generated_") + cudaFile + std::string(".ptx");
+}
+
+
+#if USE_RUNTIME_COMPILATION
+// Compiles the shader with the shader defines and returns the PTX file name for sutil::createProgramFromPTXFile().
+// The PTX is cached inside the PTX directory by a hash of the sources, the NVRTC and OptiX versions and the options,
+// which include the defines.
+std::string Application::compileShader(std::string const& cudaFile)
+{
+  const std::string ptxDirectory(sutil::samplesPTXDir());
+  const std::string shaderDirectory = std::string(sutil::samplesDir()) + std::string("/optixIntroduction/") + std::string(SAMPLE_NAME) + std::string("/shaders");
+
+  // Same as the nvcc flags in the top level CMakeLists.txt. The OptiX headers need the host architecture define.
+  std::vector<std::string> options;
+  options.push_back("-arch=compute_30");
+  options.push_back("-use_fast_math");
+  options.push_back("-lineinfo");
+  options.push_back("-default-device");
+  options.push_back("-rdc=true");
+  options.push_back("-D__x86_64");
+  options.push_back(std::string("-I") + shaderDirectory);
+  options.push_back(std::string("-I") + SAMPLES_OPTIX_INCLUDE_DIR);
+  options.push_back(std::string("-I") + SAMPLES_OPTIX_INCLUDE_DIR + std::string("/optixu"));
+  options.push_back(std::string("-I") + SAMPLES_CUDA_INCLUDE_DIR);
+  for (std::map<std::string, int>::const_iterator it = m_shaderDefines.begin(); it != m_shaderDefines.end(); ++it)
+  {
+    std::ostringstream define;
+    define << "-D" << it->first << "=" << it->second;
+    options.push_back(define.str());
+  }
+
+  int versionMajor = 0;
+  int versionMinor = 0;
+  checkNVRTC(nvrtcVersion(&versionMajor, &versionMinor), cudaFile);
+  const unsigned int versionOptiX = OPTIX_VERSION;
+
+  std::set<std::string> visited;
+  unsigned long long hash = 14695981039346656037ull;
+  hash = hashSource(hash, shaderDirectory, cudaFile, visited);
+  hash = hashBytes(hash, &versionMajor, sizeof(int));
+  hash = hashBytes(hash, &versionMinor, sizeof(int));
+  hash = hashBytes(hash, &versionOptiX, sizeof(unsigned int));
+  for (size_t i = 0; i < options.size(); ++i)
+  {
+    hash = hashString(hash, options[i]);
+  }
+
+  char key[17];
+  snprintf(key, sizeof(key), "%016llx", hash);
+  const std::string ptxName     = std::string(SAMPLE_NAME) + std::string("_nvrtc_") + cudaFile + std::string("_") + std::string(key) + std::string(".ptx");
+  const std::string ptxFilename = ptxDirectory + std::string("/") + ptxName;
+
+  if (m_shaderPtx.find(ptxName) != m_shaderPtx.end())
+  {
+    return ptxName; // Compiled earlier in this run for another program inside the same file.
+  }
+  if (std::ifstream(ptxFilename.c_str()).good())
+  {
+    return ptxFilename; // Compiled by an earlier run.
+  }
+
+  std::string source;
+  if (!readFile(shaderDirectory + std::string("/") + cudaFile, source))
+  {
+    throw optix::Exception("compileShader(): Cannot read " + shaderDirectory + "/" + cudaFile);
+  }
+
+  std::cout << "compileShader(): Compiling " << cudaFile << " with NVRTC" << std::endl;
+
+  nvrtcProgram program;
+  checkNVRTC(nvrtcCreateProgram(&program, source.c_str(), cudaFile.c_str(), 0, nullptr, nullptr), cudaFile);
+
+  std::vector<const char*> optionPointers;
+  for (size_t i = 0; i < options.size(); ++i)
+  {
+    optionPointers.push_back(options[i].c_str());
+  }
+  const nvrtcResult result = nvrtcCompileProgram(program, int(optionPointers.size()), &optionPointers[0]);
+
+  size_t logSize = 0;
+  nvrtcGetProgramLogSize(program, &logSize);
+  if (1 < logSize)
+  {
+    std::string log(logSize, '\0');
+    nvrtcGetProgramLog(program, &log[0]);
+    std::cerr << cudaFile << ":\n" << log.c_str() << std::endl;
+  }
+  if (result != NVRTC_SUCCESS)
+  {
+    nvrtcDestroyProgram(&program);
+    checkNVRTC(result, cudaFile);
+  }
+
+  size_t ptxSize = 0;
+  checkNVRTC(nvrtcGetPTXSize(program, &ptxSize), cudaFile);
+  std::string ptx(ptxSize, '\0');
+  checkNVRTC(nvrtcGetPTX(program, &ptx[0]), cudaFile);
+  nvrtcDestroyProgram(&program);
+  ptx.resize(ptxSize - 1); // Without the terminator.
+
+  std::ofstream file(ptxFilename.c_str(), std::ios::binary);
+  file << ptx;
+  if (!file)
+  {
+    std::cerr << "WARNING: compileShader() cannot write " << ptxFilename << std::endl;
+  }
+
+  // The program creation finds the PTX by its file name without reading it back.
+  m_shaderPtx.insert(ptxName);
+  sutil::registerEmbeddedPTX(ptxName.c_str(), ptx.c_str());
+  return ptxName;
+}
+#endif // USE_RUNTIME_COMPILATION
@@ -33,23 +33,25 @@
 #include <sstream>
 
 #include "inc/MyAssert.h"
+#include "inc/ParallelFor.h"
 
 optix::Geometry Application::createSphere(const int tessU, const int tessV, const float radius, const float maxTheta)
 {
   MY_ASSERT(3 <= tessU && 3 <= tessV);
 
-  std::vector<VertexAttributes> attributes;
-  attributes.reserve((tessU + 1) * tessV);
+  // We generate tessU + 1 vertices per latitude.
+  const unsigned int columns = tessU + 1;
 
-  std::vector<unsigned int> indices;
-  indices.reserve(6 * tessU * (tessV - 1));
+  // Sized upfront so that the latitudes can be generated in parallel.
+  std::vector<VertexAttributes> attributes(columns * tessV);
+  std::vector<unsigned int> indices(6 * tessU * (tessV - 1));
 
-  float phi_step   = 2.0f * M_PIf / (float) tessU;
-  float theta_step = maxTheta / (float) (tessV - 1);
+  const float phi_step   = 2.0f * M_PIf / (float) tessU;
+  const float theta_step = maxTheta / (float) (tessV - 1);
 
   // Latitudinal rings.
   // Starting at the south pole going upwards on the y-axis.
-  for (int latitude = 0; latitude < tessV; latitude++) // theta angle
+  parallelFor(0, tessV, [&](const int latitude) // theta angle
   {
     float theta    = (float) latitude * theta_step;
     float sinTheta = sinf(theta);
@@ -73,34 +75,31 @@ optix::Geometry Application::createSphere(const int tessU, const int tessV, cons
       optix::float3 normal = optix::make_float3( cosPhi * sinTheta, 
                                                 -cosTheta,                 // -y to start at the south pole.
                                                 -sinPhi * sinTheta);
-      VertexAttributes attrib;
+      VertexAttributes& attrib = attributes[latitude * columns + longitude];
 
       attrib.vertex   = normal * radius;
       attrib.tangent  = optix::make_float3(-sinPhi, 0.0f, -cosPhi);
       attrib.normal   = normal;
       attrib.texcoord = optix::make_float3(texu, texv, 0.0f);
-
-      attributes.push_back(attrib);
     }
-  }
+  });
     
-  // We have generated tessU + 1 vertices per latitude.
-  const unsigned int columns = tessU + 1;
-
   // Calculate indices.
-  for (int latitude = 0 ; latitude < tessV - 1 ; latitude++)
+  parallelFor(0, tessV - 1, [&](const int latitude)
   {                                           
+    unsigned int* dst = &indices[6 * tessU * latitude];
+
     for (int longitude = 0 ; longitude < tessU ; longitude++)
     {
-      indices.push_back( latitude      * columns + longitude    );  // lower left
-      indices.push_back( latitude      * columns + longitude + 1);  // lower right
-      indices.push_back((latitude + 1) * columns + longitude + 1);  // upper right 
+      *dst++ =  latitude      * columns + longitude    ;  // lower left
+      *dst++ =  latitude      * columns + longitude + 1;  // lower right
+      *dst++ = (latitude + 1) * columns + longitude + 1;  // upper right 
 
-      indices.push_back((latitude + 1) * columns + longitude + 1);  // upper right 
-      indices.push_back((latitude + 1) * columns + longitude    );  // upper left
-      indices.push_back( latitude      * columns + longitude    );  // lower left
+      *dst++ = (latitude + 1) * columns + longitude + 1;  // upper right 
+      *dst++ = (latitude + 1) * columns + longitude    ;  // upper left
+      *dst++ =  latitude      * columns + longitude    ;  // lower left
     }
-  }
+  });
   
   std::cout << "createSphere(): Vertices = " << attributes.size() <<  ", Triangles = " << indices.size() / 3 << std::endl;
 
@@ -0,0 +1,251 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_STACK_CALIBRATION
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <sutil.h>
+
+// OptiX stack size calibration.
+//
+// The stack size is reserved for every concurrent thread on every device. Too small crashes, too large costs device memory
+// and occupancy. calibrateStackSize() renders STACK_PROBE_ITERATIONS iterations of the current scene per candidate size with
+// RT_EXCEPTION_STACK_OVERFLOW enabled, counts the overflows in the exception program, and bisects to the smallest size without any.
+// The result is stored per configuration key in the stack size file. initRenderer() applies it with STACK_SIZE_MARGIN
+// when no --stack was given.
+
+#define STACK_SIZE_DEFAULT     1024  // Bytes. Used before the first calibration of a configuration.
+#define STACK_SIZE_MIN         256
+#define STACK_SIZE_MAX         65536
+#define STACK_SIZE_STEP        64    // Granularity of the bisection.
+#define STACK_SIZE_MARGIN      1.25f // The probes can't reach every program path.
+#define STACK_PROBE_ITERATIONS 4
+
+// 64-bit FNV-1a.
+static unsigned long long hashBytes(unsigned long long hash, const void* data, const size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static unsigned long long hashString(unsigned long long hash, std::string const& s)
+{
+  return hashBytes(hash, s.c_str(), s.size() + 1); // Including the terminator to separate consecutive strings.
+}
+
+static std::string getStackSizeFilename()
+{
+  return std::string(sutil::samplesPTXDir()) + std::string("/optixIntro_10_stack_sizes.txt");
+}
+
+static unsigned int addStackSizeMargin(const unsigned int stackSize)
+{
+  const unsigned int size = (unsigned int)(float(stackSize) * STACK_SIZE_MARGIN);
+  return (size + STACK_SIZE_STEP - 1) / STACK_SIZE_STEP * STACK_SIZE_STEP;
+}
+
+// Everything which selects different programs or compiles them differently.
+std::string Application::getStackConfigurationKey() const
+{
+  unsigned long long hash = 14695981039346656037ull;
+
+  const unsigned int versionOptiX = OPTIX_VERSION;
+  hash = hashBytes(hash, &versionOptiX, sizeof(unsigned int));
+
+  const std::vector<int> devices = m_context->getEnabledDevices();
+  for (size_t i = 0; i < devices.size(); ++i)
+  {
+    hash = hashString(hash, m_context->getDeviceName(devices[i]));
+  }
+
+  for (std::map<std::string, int>::const_iterator it = m_shaderDefines.begin(); it != m_shaderDefines.end(); ++it)
+  {
+    hash = hashString(hash, it->first);
+    hash = hashBytes(hash, &it->second, sizeof(int));
+  }
+
+  hash = hashString(hash, m_sceneFilename);
+  hash = hashBytes(hash, &m_light, sizeof(bool));
+  hash = hashBytes(hash, &m_missID, sizeof(unsigned int));
+  hash = hashBytes(hash, &m_wavefront, sizeof(bool));
+  hash = hashBytes(hash, &m_geometryTriangles, sizeof(bool));
+
+  char key[17];
+  snprintf(key, sizeof(key), "%016llx", hash);
+  return std::string(key);
+}
+
+// Returns the stored size of this configuration plus the margin, or STACK_SIZE_DEFAULT.
+unsigned int Application::loadStackSize() const
+{
+  const std::string key = getStackConfigurationKey();
+
+  std::ifstream input(getStackSizeFilename().c_str());
+
+  std::string  entry;
+  unsigned int stackSize = 0;
+  while (input >> entry >> stackSize)
+  {
+    if (entry == key)
+    {
+      std::cout << "loadStackSize(): calibrated " << stackSize << " bytes for configuration " << key << std::endl;
+      return addStackSizeMargin(stackSize);
+    }
+  }
+  return STACK_SIZE_DEFAULT;
+}
+
+// Replaces the entry of this configuration in the stack size file.
+void Application::storeStackSize(const unsigned int stackSize) const
+{
+  const std::string key      = getStackConfigurationKey();
+  const std::string filename = getStackSizeFilename();
+
+  std::ostringstream lines;
+  {
+    std::ifstream input(filename.c_str());
+
+    std::string  entry;
+    unsigned int size = 0;
+    while (input >> entry >> size)
+    {
+      if (entry != key)
+      {
+        lines << entry << " " << size << "\n";
+      }
+    }
+  }
+  lines << key << " " << stackSize << "\n";
+
+  std::ofstream output(filename.c_str());
+  if (!(output << lines.str()))
+  {
+    std::cerr << "ERROR: storeStackSize() cannot write " << filename << std::endl;
+  }
+}
+
+void Application::initStackCalibration()
+{
+  m_bufferStackOverflows = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+  m_context["sysStackOverflows"]->setBuffer(m_bufferStackOverflows);
+}
+
+// Renders a few iterations with this stack size and returns true when not a single thread overflowed.
+bool Application::probeStackSize(const unsigned int stackSize)
+{
+  m_context->setStackSize(stackSize);
+
+  unsigned int* overflows = static_cast<unsigned int*>(m_bufferStackOverflows->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  overflows[0] = 0;
+  m_bufferStackOverflows->unmap();
+
+  restartAccumulation();
+  for (int i = 0; i < STACK_PROBE_ITERATIONS; ++i)
+  {
+    render();
+  }
+
+  overflows = static_cast<unsigned int*>(m_bufferStackOverflows->map(0, RT_BUFFER_MAP_READ));
+  const unsigned int count = overflows[0];
+  m_bufferStackOverflows->unmap();
+
+  std::cout << "probeStackSize(): " << stackSize << " bytes, " << count << " overflows" << std::endl;
+  return (count == 0);
+}
+
+// Must be called after the scene has been created. Applies and stores the calibrated size.
+bool Application::calibrateStackSize()
+{
+  bool calibrated = false;
+
+  try
+  {
+    m_context->setExceptionEnabled(RT_EXCEPTION_STACK_OVERFLOW, true);
+
+    // Double from the minimum until a size works, then bisect between the last failing and the working size.
+    unsigned int failing = 0;
+    unsigned int working = STACK_SIZE_MIN;
+    while (working <= STACK_SIZE_MAX && !probeStackSize(working))
+    {
+      failing = working;
+      working *= 2;
+    }
+
+    if (working <= STACK_SIZE_MAX)
+    {
+      while (STACK_SIZE_STEP < working - failing)
+      {
+        const unsigned int size = (failing + working) / 2 / STACK_SIZE_STEP * STACK_SIZE_STEP;
+        if (probeStackSize(size))
+        {
+          working = size;
+        }
+        else
+        {
+          failing = size;
+        }
+      }
+
+      storeStackSize(working);
+
+      m_stackSize = addStackSizeMargin(working);
+      calibrated  = true;
+
+      std::cout << "calibrateStackSize(): " << working << " bytes without overflows, using " << m_stackSize << std::endl;
+    }
+    else
+    {
+      std::cerr << "ERROR: calibrateStackSize() found no stack size up to " << STACK_SIZE_MAX << " bytes without overflows" << std::endl;
+    }
+
+    m_context->setStackSize(m_stackSize);
+    // Keep the overflow checks when the debug exceptions enabled all of them.
+    m_context->setExceptionEnabled(RT_EXCEPTION_STACK_OVERFLOW, getShaderDefine("USE_DEBUG_EXCEPTIONS", USE_DEBUG_EXCEPTIONS) != 0);
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+
+  restartAccumulation(); // The probe iterations must not be part of the image.
+  return calibrated;
+}
+
+#endif // USE_STACK_CALIBRATION
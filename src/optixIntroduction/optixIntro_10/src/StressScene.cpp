@@ -0,0 +1,303 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#if USE_STRESS_SCENE
+
+#include "inc/Application.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// Generated scenes for scaling measurements.
+// Everything is derived from the seed, so the same --stress argument always produces the same scene on any machine.
+// The instances scatter over a ground plane whose area grows with their number, which keeps the density and with it
+// the depth complexity roughly constant while the instance count is varied. The total emission of the parallelogram
+// lights stays that of the single demo area light, so the images keep their brightness for any number of lights.
+// The build times and the Mrays/s come from the existing initScene() and --benchmark output, the memory from --memoryreport.
+
+// "instances,lights,materials,textures,seed", missing trailing values keep their defaults.
+bool Application::parseStressConfig(std::string const& config)
+{
+  m_stress.instances = 0;
+  m_stress.lights    = 1;
+  m_stress.materials = 8;
+  m_stress.textures  = 1;
+  m_stress.seed      = 1;
+
+  if (config.empty())
+  {
+    return false;
+  }
+
+  int          values[4] = { 0, m_stress.lights, m_stress.materials, m_stress.textures };
+  unsigned int seed      = m_stress.seed;
+
+  const int count = sscanf(config.c_str(), "%d,%d,%d,%d,%u", &values[0], &values[1], &values[2], &values[3], &seed);
+  if (count < 1 || values[0] <= 0)
+  {
+    std::cerr << "WARNING: parseStressConfig() invalid --stress " << config << " ignored" << std::endl;
+    return false;
+  }
+
+  m_stress.instances = values[0];
+  m_stress.lights    = std::max(0, values[1]);
+  m_stress.materials = std::max(0, values[2]);
+  m_stress.textures  = std::max(0, values[3]);
+  m_stress.seed      = seed;
+  return true;
+}
+
+// Procedural two color checkerboards with random cell counts as RGBA8 TextureSamplers, one generated material per
+// parameter set cycling through them.
+void Application::createStressMaterials()
+{
+  std::mt19937 rng(m_stress.seed);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+  try
+  {
+    for (int i = 0; i < m_stress.textures; ++i)
+    {
+      const unsigned char a[4] = { (unsigned char) (uniform(rng) * 255.0f), (unsigned char) (uniform(rng) * 255.0f), (unsigned char) (uniform(rng) * 255.0f), 255 };
+      const unsigned char b[4] = { (unsigned char) (uniform(rng) * 255.0f), (unsigned char) (uniform(rng) * 255.0f), (unsigned char) (uniform(rng) * 255.0f), 255 };
+      const int           cellSize = STRESS_TEXTURE_SIZE >> (1 + int(uniform(rng) * 5.0f)); // 2 to 32 cells per row.
+
+      optix::Buffer buffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4, STRESS_TEXTURE_SIZE, STRESS_TEXTURE_SIZE);
+
+      unsigned char* texels = static_cast<unsigned char*>(buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+      for (int y = 0; y < STRESS_TEXTURE_SIZE; ++y)
+      {
+        for (int x = 0; x < STRESS_TEXTURE_SIZE; ++x)
+        {
+          const unsigned char* color = (((x / cellSize) ^ (y / cellSize)) & 1) ? a : b;
+          memcpy(texels + (size_t(y) * STRESS_TEXTURE_SIZE + x) * 4, color, 4);
+        }
+      }
+      buffer->unmap();
+
+      optix::TextureSampler sampler = m_context->createTextureSampler();
+      sampler->setWrapMode(0, RT_WRAP_REPEAT);
+      sampler->setWrapMode(1, RT_WRAP_REPEAT);
+      sampler->setWrapMode(2, RT_WRAP_REPEAT);
+      sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+      sampler->setIndexingMode(RT_TEXTURE_INDEX_NORMALIZED_COORDINATES);
+      sampler->setReadMode(RT_TEXTURE_READ_NORMALIZED_FLOAT_SRGB);
+      sampler->setMaxAnisotropy(1.0f);
+      sampler->setBuffer(buffer);
+
+      m_stressTextures.push_back(sampler);
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+
+  MaterialParameterGUI parameters;
+
+  parameters.useCutoutTexture    = false;
+  parameters.thinwalled          = false;
+  parameters.volumeDistanceScale = 1.0f;
+  parameters.abbe                = 0.0f;
+#if USE_HETEROGENEOUS_MEDIA
+  parameters.medium              = -1; // initMedia() assigns the media after the scene is built.
+#endif
+
+  for (int i = 0; i < m_stress.materials; ++i)
+  {
+    // Mostly diffuse, like real scenes, with some mirrors and glass for the longer paths.
+    const float pick = uniform(rng);
+
+    parameters.indexBSDF        = (pick < 0.6f) ? INDEX_BSDF_DIFFUSE_REFLECTION : (pick < 0.8f) ? INDEX_BSDF_SPECULAR_REFLECTION : INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION;
+    parameters.albedo           = optix::make_float3(0.2f + 0.8f * uniform(rng), 0.2f + 0.8f * uniform(rng), 0.2f + 0.8f * uniform(rng));
+    parameters.useAlbedoTexture = (parameters.indexBSDF == INDEX_BSDF_DIFFUSE_REFLECTION && !m_stressTextures.empty());
+    parameters.albedoTexture    = (parameters.useAlbedoTexture) ? i % int(m_stressTextures.size()) : -1;
+    parameters.absorptionColor  = optix::make_float3(0.5f + 0.5f * uniform(rng), 0.5f + 0.5f * uniform(rng), 0.5f + 0.5f * uniform(rng));
+    parameters.ior              = 1.3f + 0.3f * uniform(rng);
+
+    m_guiMaterialParameters.push_back(parameters);
+  }
+}
+
+void Application::createStressScene()
+{
+  std::mt19937 rng(m_stress.seed + 1); // Independent of the number of materials drawn before.
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+  // The built-in materials without the cutout one when nothing was generated.
+  const int firstMaterial = (0 < m_stress.materials) ? 4 : 2;
+  const int numMaterials  = (0 < m_stress.materials) ? m_stress.materials : 2;
+
+  // Prototype shapes. All instances of a shape with the same material share one GeometryGroup.
+  optix::Geometry shapes[3] =
+  {
+    createBox(),
+    createSphere(180, 90, 1.0f, M_PIf),
+    createTorus(180, 180, 0.75f, 0.25f)
+  };
+
+  std::vector<optix::Acceleration>  accelerations(3);
+  std::vector<optix::GeometryGroup> groups(3 * numMaterials);
+  for (int s = 0; s < 3; ++s)
+  {
+    accelerations[s] = createAcceleration(shapes[s]->getPrimitiveCount(), ACCELERATION_STATIC);
+  }
+
+  // About 25 square units of ground per instance.
+  const float halfExtent = 2.5f * sqrtf(float(m_stress.instances));
+
+  // Ground plane with the Lambert material 0.
+  optix::Geometry         geoPlane = createPlane(1, 1, 1);
+  optix::GeometryInstance giPlane  = m_context->createGeometryInstance();
+  setInstanceGeometry(giPlane, geoPlane);
+  giPlane->setMaterialCount(1);
+  giPlane->setMaterial(0, getMaterial(0));
+  giPlane["parMaterialIndex"]->setInt(0);
+
+  optix::GeometryGroup ggPlane = m_context->createGeometryGroup();
+  ggPlane->setAcceleration(createAcceleration(geoPlane->getPrimitiveCount(), ACCELERATION_STATIC));
+  ggPlane->setChildCount(1);
+  ggPlane->setChild(0, giPlane);
+
+  const optix::Matrix4x4 matrixPlane = optix::Matrix4x4::scale(optix::make_float3(halfExtent + 2.0f));
+
+  optix::Transform trPlane = m_context->createTransform();
+  trPlane->setChild(ggPlane);
+  trPlane->setMatrix(false, matrixPlane.getData(), matrixPlane.inverse().getData());
+
+  std::vector<optix::Transform> transforms;
+  transforms.reserve(m_stress.instances + 1);
+  transforms.push_back(trPlane);
+
+  unsigned long long triangles = geoPlane->getPrimitiveCount();
+
+  for (int i = 0; i < m_stress.instances; ++i)
+  {
+    const int shape    = std::min(int(uniform(rng) * 3.0f), 2);
+    const int material = std::min(int(uniform(rng) * float(numMaterials)), numMaterials - 1);
+
+    optix::GeometryGroup& gg = groups[material * 3 + shape];
+    if (!gg)
+    {
+      optix::GeometryInstance gi = m_context->createGeometryInstance();
+      setInstanceGeometry(gi, shapes[shape]);
+      gi->setMaterialCount(1);
+      gi->setMaterial(0, getMaterial(firstMaterial + material));
+      gi["parMaterialIndex"]->setInt(firstMaterial + material);
+
+      gg = m_context->createGeometryGroup();
+      gg->setAcceleration(accelerations[shape]); // Shared, the GeometryGroups only differ in the material.
+      gg->setChildCount(1);
+      gg->setChild(0, gi);
+    }
+
+    // Random position on the ground, spin around the up-axis and size. All shapes have a unit bounding radius.
+    const float scale = 0.4f + 0.6f * uniform(rng);
+    const float angle = 2.0f * M_PIf * uniform(rng);
+    const float x     = halfExtent * (2.0f * uniform(rng) - 1.0f);
+    const float z     = halfExtent * (2.0f * uniform(rng) - 1.0f);
+
+    const optix::Matrix4x4 matrix = optix::Matrix4x4::translate(optix::make_float3(x, scale, z)) *
+                                    optix::Matrix4x4::rotate(angle, optix::make_float3(0.0f, 1.0f, 0.0f)) *
+                                    optix::Matrix4x4::scale(optix::make_float3(scale));
+
+    optix::Transform tr = m_context->createTransform();
+    tr->setChild(gg);
+    tr->setMatrix(false, matrix.getData(), matrix.inverse().getData());
+
+    transforms.push_back(tr);
+
+    triangles += shapes[shape]->getPrimitiveCount();
+  }
+
+  const unsigned int count = m_rootGroup->getChildCount();
+  m_rootGroup->setChildCount(count + unsigned(transforms.size()));
+  for (size_t i = 0; i < transforms.size(); ++i)
+  {
+    m_rootGroup->setChild(count + unsigned(i), transforms[i]);
+  }
+
+  std::cout << "createStressScene(): Instances = " << m_stress.instances
+            << ", Triangles = " << triangles
+            << ", Lights = " << m_stress.lights
+            << ", Materials = " << m_stress.materials
+            << ", Textures = " << m_stress.textures
+            << " (" << double(m_stress.textures) * STRESS_TEXTURE_SIZE * STRESS_TEXTURE_SIZE * 4.0 / (1024.0 * 1024.0) << " MiB)"
+            << ", Seed = " << m_stress.seed << std::endl;
+}
+
+// Squares in a horizontal layer above the instances, facing down.
+void Application::createStressLights()
+{
+  std::mt19937 rng(m_stress.seed + 2);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+  const float halfExtent = 2.5f * sqrtf(float(m_stress.instances));
+
+  for (int i = 0; i < m_stress.lights; ++i)
+  {
+    const float size = 0.5f + 0.5f * uniform(rng);
+
+    LightDefinition light;
+    memset(&light, 0, sizeof(LightDefinition));
+
+    light.type      = LIGHT_PARALLELOGRAM;
+    light.position  = optix::make_float3(halfExtent * (2.0f * uniform(rng) - 1.0f), 4.0f + uniform(rng), halfExtent * (2.0f * uniform(rng) - 1.0f));
+    light.vecU      = optix::make_float3(size, 0.0f, 0.0f);
+    light.vecV      = optix::make_float3(0.0f, 0.0f, size);
+    optix::float3 n = optix::cross(light.vecU, light.vecV);
+    light.area      = optix::length(n);
+    light.normal    = n / light.area;
+    light.emission  = optix::make_float3(100.0f / (float(m_stress.lights) * light.area)); // 100 Watt total like the demo light.
+    light.idEnvironmentTexture = RT_TEXTURE_ID_NULL;
+    light.idEnvironmentCDF_U   = RT_BUFFER_ID_NULL;
+    light.idEnvironmentCDF_V   = RT_BUFFER_ID_NULL;
+    light.idEnvironmentAlias   = RT_BUFFER_ID_NULL;
+    light.environmentIntegral  = 1.0f;
+    light.pdfSelection         = 1.0f; // Set in buildLightAliasTable().
+#if USE_CUBEMAP_ENVIRONMENT
+    light.environmentSize      = 0;
+#endif
+#if USE_MESH_LIGHTS
+    light.idMeshTriangles      = RT_BUFFER_ID_NULL;
+    light.idMeshAlias          = RT_BUFFER_ID_NULL;
+#endif
+
+    const int lightIndex = int(m_lightDefinitions.size());
+    m_lightDefinitions.push_back(light);
+
+    createLightGeometry(light, lightIndex);
+  }
+}
+
+#endif // USE_STRESS_SCENE
@@ -30,6 +30,8 @@
 
 #include <IL/il.h>
 
+#include <NvtxRange.h>
+
 #include <optix.h>
 #include <optixu/optixpp_namespace.h>
 #include <optixu/optixu_math_namespace.h>
@@ -38,7 +40,15 @@
 #include <cstring>
 #include <iostream>
 
+#include "inc/AliasTable.h"
 #include "inc/MyAssert.h"
+#include "inc/ParallelFor.h"
+
+#include "shaders/entry_points.h"
+#include "shaders/light_definition.h"
+#if USE_CUBEMAP_ENVIRONMENT
+#include "shaders/cubemap_environment.h"
+#endif
 
 
 #ifndef M_PI
@@ -57,8 +67,12 @@ Texture::Texture()
 , m_integral(0.0f)
 , m_bufferCDF_U(nullptr)
 , m_bufferCDF_V(nullptr)
+, m_bufferAlias(nullptr)
 , m_buffer(nullptr)
 , m_sampler(nullptr)
+#if USE_GPU_MIPMAPS
+, m_mipmapsPending(false)
+#endif
 {
 }
 
@@ -81,6 +95,13 @@ Texture::Texture(const Texture &rhs)
 , m_integral(rhs.m_integral)
 , m_bufferCDF_U(rhs.m_bufferCDF_U)
 , m_bufferCDF_V(rhs.m_bufferCDF_V)
+, m_bufferAlias(rhs.m_bufferAlias)
+#if USE_ASYNC_TEXTURES
+, m_loader(rhs.m_loader)
+#endif
+#if USE_GPU_MIPMAPS
+, m_mipmapsPending(rhs.m_mipmapsPending)
+#endif
 {
 }
  
@@ -101,16 +122,69 @@ Texture& Texture::operator=(const Texture & rhs)
     m_integral    = rhs.m_integral;
     m_bufferCDF_U = rhs.m_bufferCDF_U;
     m_bufferCDF_V = rhs.m_bufferCDF_V;
+    m_bufferAlias = rhs.m_bufferAlias;
+#if USE_ASYNC_TEXTURES
+    m_loader      = rhs.m_loader;
+#endif
+#if USE_GPU_MIPMAPS
+    m_mipmapsPending = rhs.m_mipmapsPending;
+#endif
   }
   return *this;
 }
 
+void Texture::destroy()
+{
+#if USE_ASYNC_TEXTURES
+  m_loader.reset(); // Joins the worker thread when this was the last copy.
+#endif
+  // The sampler first, it references the buffer.
+  if (m_sampler)
+  {
+    m_sampler->destroy();
+    m_sampler = nullptr;
+  }
+  if (m_buffer)
+  {
+    m_buffer->destroy();
+    m_buffer = nullptr;
+  }
+  if (m_bufferCDF_U)
+  {
+    m_bufferCDF_U->destroy();
+    m_bufferCDF_U = nullptr;
+  }
+  if (m_bufferCDF_V)
+  {
+    m_bufferCDF_V->destroy();
+    m_bufferCDF_V = nullptr;
+  }
+  if (m_bufferAlias)
+  {
+    m_bufferAlias->destroy();
+    m_bufferAlias = nullptr;
+  }
+  m_texels.clear();
+#if USE_GPU_MIPMAPS
+  m_mipmapsPending = false;
+#endif
+}
+
 bool Texture::createSampler(optix::Context context,
                             const Picture* picture,
                             bool useSrgb,         // = false // Affects the read mode. Only applied to unsigned byte formats.
                             bool useMipmaps,      // = false // Affects the download of mipmaps. Default is to not download mipmaps.
                             bool useUnnormalized) // = false // Affects the texture indexing. Default is normalized 2D coordinates.
 {
+  return fillSampler(context, picture, useSrgb, useMipmaps, useUnnormalized, 0);
+}
+
+// Creates the TextureSampler on first use. Later calls keep it and only replace its buffer, so the bindless ID stays valid.
+// With firstLevel > 0 only the mipmap levels from firstLevel on are uploaded, as a smaller but complete mipmap chain.
+bool Texture::fillSampler(optix::Context context, const Picture* picture, bool useSrgb, bool useMipmaps, bool useUnnormalized, unsigned int firstLevel)
+{
+  SUTIL_NVTX_RANGE("Texture::fillSampler");
+
   bool success = false;
 
   if (picture == nullptr)
@@ -119,9 +193,16 @@ bool Texture::createSampler(optix::Context context,
     return success;
   }
 
-  // The LOD 0 image of the first face defines the basic settings.
+  unsigned int numFaces = picture->getNumberOfFaces(0); // This is the number of mipmap levels including LOD 0.
+
+  if (!useMipmaps || numFaces <= firstLevel)
+  {
+    firstLevel = 0;
+  }
+
+  // The LOD firstLevel image of the first face defines the basic settings.
   // This returns nullptr when this image doesn't exist. Everything else in this function relies on it.
-  const Image* image = picture->getImageFace(0, 0);
+  const Image* image = picture->getImageFace(0, firstLevel);
 
   if (image == nullptr)
   {
@@ -129,10 +210,31 @@ bool Texture::createSampler(optix::Context context,
     return success;
   }
 
-  unsigned int numFaces = picture->getNumberOfFaces(0); // This is the number of mipmap levels including LOD 0.
+#if USE_COMPRESSED_TEXTURES
+  if (image->m_block != IMAGE_BLOCK_NONE)
+  {
+    return fillSamplerBlocks(context, picture, useSrgb, useMipmaps, firstLevel);
+  }
+#endif
+
+  numFaces -= firstLevel; // The number of uploaded levels.
   
   const bool isCubemap = picture->isCubemap();
 
+  unsigned int numLevels = numFaces; // The number of mipmap levels inside the buffer.
+
+#if USE_GPU_MIPMAPS
+  // 2D images without a mipmap chain get the full chain allocated here and filled by generateMipmaps().
+  m_mipmapsPending = (useMipmaps && numFaces == 1 && !isCubemap && !useUnnormalized && image->m_depth == 1 && 1 < image->m_height);
+  if (m_mipmapsPending)
+  {
+    for (unsigned int extent = std::max(image->m_width, image->m_height); 1 < extent; extent >>= 1)
+    {
+      ++numLevels;
+    }
+  }
+#endif
+
   const unsigned int hostEncoding = determineHostEncoding(image->m_format, image->m_type);
 
   bool isCreated = false; // Tracks if the TextureSampler and Buffer could be created before filling the buffer.
@@ -145,7 +247,12 @@ bool Texture::createSampler(optix::Context context,
       m_height = image->m_height;
       m_depth  = image->m_depth;
 
-      m_sampler = context->createTextureSampler();
+      if (!m_sampler)
+      {
+        m_sampler = context->createTextureSampler();
+      }
+
+      optix::Buffer previous = m_buffer; // The placeholder or coarser mipmap chain, replaced below.
 
       // Set working wrap mode defaults.
       // Cubemaps need RT_WRAP_CLAMP_TO_EDGE to not generate seams at image borders with linear filering.
@@ -163,7 +270,7 @@ bool Texture::createSampler(optix::Context context,
         m_sampler->setWrapMode(2, RT_WRAP_REPEAT);
       }
 
-      const RTfiltermode mipmapFilter = (useMipmaps && 1 < numFaces) ? RT_FILTER_LINEAR : RT_FILTER_NONE; // Trilinear or bilinear filtering.
+      const RTfiltermode mipmapFilter = (useMipmaps && 1 < numLevels) ? RT_FILTER_LINEAR : RT_FILTER_NONE; // Trilinear or bilinear filtering.
       m_sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, mipmapFilter);
 
       // Do not use unnormalized coordinates for cubemaps. // DAR DEBUG Is that even possible?
@@ -207,9 +314,9 @@ bool Texture::createSampler(optix::Context context,
           m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, m_width);
         }
 
-        if (useMipmaps && 1 < numFaces)
+        if (useMipmaps && 1 < numLevels)
         {
-          m_buffer->setMipLevelCount(numFaces); // Default is 1.
+          m_buffer->setMipLevelCount(numLevels); // Default is 1.
         }
 
         m_sampler->setBuffer(m_buffer);
@@ -233,6 +340,11 @@ bool Texture::createSampler(optix::Context context,
           isCreated = true;
         }
       }
+
+      if (isCreated && previous && previous != m_buffer)
+      {
+        previous->destroy();
+      }
     }
 
     if (!isCreated)
@@ -245,11 +357,9 @@ bool Texture::createSampler(optix::Context context,
 
     if (!isCubemap) // 1D, 2D 3D with optional mipmaps. No layered texture support in this routine!
     {
-      unsigned int numFaces = picture->getNumberOfFaces(0); // This is the number of mipmap levels including LOD 0.
-
       for (unsigned int indexFace = 0; indexFace < numFaces && (indexFace == 0 || useMipmaps); ++indexFace)
       {
-        const Image* image = picture->getImageFace(0, indexFace);
+        const Image* image = picture->getImageFace(0, firstLevel + indexFace);
 
         if (image != nullptr)
         {
@@ -266,11 +376,11 @@ bool Texture::createSampler(optix::Context context,
 
       for (unsigned int indexImage = 0; indexImage < numImages; ++indexImage)
       {
-        unsigned int numFaces = picture->getNumberOfFaces(indexImage); // This is the number of mipmap levels including LOD 0 of this cubemap image (6).
+        unsigned int numFaces = picture->getNumberOfFaces(indexImage) - firstLevel; // This is the number of uploaded mipmap levels of this cubemap image.
 
         for (unsigned int indexFace = 0; indexFace < numFaces && (indexFace == 0 || useMipmaps); ++indexFace)
         {
-          const Image* image = picture->getImageFace(indexImage, indexFace);
+          const Image* image = picture->getImageFace(indexImage, firstLevel + indexFace);
 
           if (image != nullptr )
           {
@@ -295,6 +405,278 @@ bool Texture::createSampler(optix::Context context,
 }
 
 
+#if USE_COMPRESSED_TEXTURES
+// Block-compressed Pictures are uploaded as is. Only 2D textures, the buffer extents and the mipmap level sizes are in 4x4 blocks.
+bool Texture::fillSamplerBlocks(optix::Context context, const Picture* picture, bool useSrgb, bool useMipmaps, unsigned int firstLevel)
+{
+  bool success = false;
+
+  const Image* image = picture->getImageFace(0, firstLevel);
+
+  if (picture->isCubemap() || image->m_depth != 1)
+  {
+    std::cerr << "ERROR: createSampler() Block-compressed images are only supported for 2D textures." << std::endl;
+    return success;
+  }
+
+  const unsigned int numFaces = (useMipmaps) ? picture->getNumberOfFaces(0) - firstLevel : 1;
+
+  try
+  {
+    switch (image->m_block)
+    {
+      case IMAGE_BLOCK_BC1:
+        m_format = RT_FORMAT_UNSIGNED_BC1;
+        break;
+      case IMAGE_BLOCK_BC3:
+        m_format = RT_FORMAT_UNSIGNED_BC3;
+        break;
+      case IMAGE_BLOCK_BC5:
+        m_format = RT_FORMAT_UNSIGNED_BC5;
+        break;
+      case IMAGE_BLOCK_BC6H:
+        m_format = RT_FORMAT_UNSIGNED_BC6H;
+        break;
+      default:
+        MY_ASSERT(!"Unsupported block format.");
+        return success;
+    }
+
+    // BC6H decodes to half floats, the others to normalized 8-bit values which can use the sRGB conversion.
+    m_readMode = (image->m_block == IMAGE_BLOCK_BC6H) ? RT_TEXTURE_READ_ELEMENT_TYPE : RT_TEXTURE_READ_NORMALIZED_FLOAT;
+    if (useSrgb && (image->m_block == IMAGE_BLOCK_BC1 || image->m_block == IMAGE_BLOCK_BC3))
+    {
+      m_readMode = RT_TEXTURE_READ_NORMALIZED_FLOAT_SRGB;
+    }
+
+    m_encoding = ENC_RED_NONE | ENC_GREEN_NONE | ENC_BLUE_NONE | ENC_ALPHA_NONE | ENC_LUM_NONE; // No host conversion.
+
+    m_width  = image->m_width;
+    m_height = image->m_height;
+    m_depth  = 1;
+
+    if (!m_sampler)
+    {
+      m_sampler = context->createTextureSampler();
+    }
+
+    optix::Buffer previous = m_buffer;
+
+    m_sampler->setWrapMode(0, RT_WRAP_REPEAT);
+    m_sampler->setWrapMode(1, RT_WRAP_REPEAT);
+    m_sampler->setWrapMode(2, RT_WRAP_REPEAT);
+
+    m_sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, (1 < numFaces) ? RT_FILTER_LINEAR : RT_FILTER_NONE);
+
+    m_indexMode = RT_TEXTURE_INDEX_NORMALIZED_COORDINATES;
+    m_sampler->setIndexingMode(m_indexMode);
+    m_sampler->setReadMode(m_readMode);
+    m_sampler->setMaxAnisotropy(1.0f);
+
+    m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, (m_width + 3) / 4, (m_height + 3) / 4);
+    if (1 < numFaces)
+    {
+      m_buffer->setMipLevelCount(numFaces);
+    }
+    m_sampler->setBuffer(m_buffer);
+
+    if (previous && previous != m_buffer)
+    {
+      previous->destroy();
+    }
+
+    const size_t blockSize = getElementSize();
+
+    for (unsigned int indexFace = 0; indexFace < numFaces; ++indexFace)
+    {
+      const Image* level = picture->getImageFace(0, firstLevel + indexFace);
+
+      // OptiX halves the extents in blocks, the image halves them in texels. They differ for extents which are not powers of two.
+      RTsize blocksX = 0;
+      RTsize blocksY = 0;
+      m_buffer->getMipLevelSize(indexFace, blocksX, blocksY);
+
+      const size_t bytesDst = blocksX * blockSize;
+      const size_t bytesRow = std::min(bytesDst, size_t(level->m_bpl));
+      const size_t rows     = std::min(size_t(blocksY), size_t(level->m_bps / level->m_bpl));
+
+      unsigned char* dst = static_cast<unsigned char*>(m_buffer->map(indexFace, RT_BUFFER_MAP_WRITE_DISCARD));
+      memset(dst, 0, bytesDst * blocksY);
+      for (size_t y = 0; y < rows; ++y)
+      {
+        memcpy(dst + y * bytesDst, level->m_pixels + y * level->m_bpl, bytesRow);
+      }
+      m_buffer->unmap(indexFace);
+    }
+    success = true;
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+  return success;
+}
+#endif
+
+
+#if USE_ASYNC_TEXTURES
+TextureLoader::TextureLoader()
+: ready(false)
+, success(false)
+, useSrgb(false)
+, useMipmaps(false)
+, level(~0u)
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+  if (thread.joinable())
+  {
+    thread.join();
+  }
+}
+
+void Texture::createSamplerAsync(optix::Context context,
+                                 std::string const& filename,
+                                 bool useSrgb,        // = false
+                                 bool useMipmaps,     // = false
+                                 bool useCompression) // = false
+{
+  try
+  {
+    // The placeholder is a 1x1 white RGBA8 texture. The TextureSampler stays the same when the image arrives,
+    // so the bindless texture ID written into the material parameters never changes.
+    m_width    = 1;
+    m_height   = 1;
+    m_depth    = 1;
+    m_format   = RT_FORMAT_UNSIGNED_BYTE4;
+    m_readMode = RT_TEXTURE_READ_NORMALIZED_FLOAT;
+
+    m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, 1, 1);
+    unsigned char* dst = static_cast<unsigned char*>(m_buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    dst[0] = dst[1] = dst[2] = dst[3] = 255;
+    m_buffer->unmap();
+
+    m_sampler = context->createTextureSampler();
+    m_sampler->setWrapMode(0, RT_WRAP_REPEAT);
+    m_sampler->setWrapMode(1, RT_WRAP_REPEAT);
+    m_sampler->setWrapMode(2, RT_WRAP_REPEAT);
+    m_sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+    m_sampler->setIndexingMode(m_indexMode);
+    m_sampler->setReadMode(m_readMode);
+    m_sampler->setMaxAnisotropy(1.0f);
+    m_sampler->setBuffer(m_buffer);
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+    return;
+  }
+
+  m_loader = std::make_shared<TextureLoader>();
+
+  m_loader->useSrgb    = useSrgb;
+  m_loader->useMipmaps = useMipmaps;
+
+  TextureLoader* loader = m_loader.get(); // The destructor joins the thread, so this pointer outlives it.
+  loader->thread = std::thread([loader, filename, useCompression]()
+  {
+    // The block encoding runs on the worker thread as well.
+    const bool compress = (USE_COMPRESSED_TEXTURES == 1) && useCompression;
+
+    loader->picture = PictureCache::acquire(filename, compress, compress);
+    loader->success = (loader->picture->getNumberOfImages() != 0);
+    loader->ready   = true;
+  });
+}
+
+// Called once per frame on the thread owning the OptiX context.
+// Images with mipmaps first get the chain starting at the first level of at most 256 texels extent,
+// then every call makes two more levels resident, which grows the uploaded data by 16x per step.
+// Images without mipmaps switch from the placeholder to the full resolution directly.
+bool Texture::update(optix::Context context)
+{
+  if (!m_loader || !m_loader->ready)
+  {
+    return false;
+  }
+
+  if (m_loader->thread.joinable())
+  {
+    m_loader->thread.join();
+  }
+
+  if (!m_loader->success)
+  {
+    std::cerr << "ERROR: Texture::update() image could not be loaded, keeping the placeholder" << std::endl;
+    m_loader.reset();
+    return false;
+  }
+
+  const Picture* picture = m_loader->picture.get();
+
+  unsigned int level = 0;
+
+  if (m_loader->useMipmaps)
+  {
+    if (m_loader->level == ~0u)
+    {
+      const unsigned int numLevels = picture->getNumberOfFaces(0);
+
+      level = numLevels - 1;
+      for (unsigned int i = 0; i < numLevels; ++i)
+      {
+        const Image* image = picture->getImageFace(0, i);
+        if (image != nullptr && image->m_width <= 256 && image->m_height <= 256)
+        {
+          level = i;
+          break;
+        }
+      }
+    }
+    else
+    {
+      level = (2 < m_loader->level) ? m_loader->level - 2 : 0;
+    }
+  }
+
+  if (!fillSampler(context, picture, m_loader->useSrgb, m_loader->useMipmaps, false, level))
+  {
+    m_loader.reset();
+    return false;
+  }
+
+  m_loader->level = level;
+  if (level == 0)
+  {
+#if USE_GPU_MIPMAPS
+    generateMipmaps(context); // This runs between frames, the context is complete.
+#endif
+    m_loader.reset(); // Full resolution is resident, release this texture's reference to the decoded Picture.
+  }
+  return true;
+}
+
+bool Texture::isLoading() const
+{
+  return (m_loader != nullptr);
+}
+
+void Texture::finish(optix::Context context)
+{
+  while (m_loader)
+  {
+    if (m_loader->thread.joinable())
+    {
+      m_loader->thread.join(); // Sets ready.
+    }
+    update(context);
+  }
+}
+#endif
+
+
 // Use with standard texture sampler declarations.
 optix::TextureSampler Texture::getSampler() const
 {
@@ -541,6 +923,12 @@ size_t Texture::getElementSize() const
     return sizeof(unsigned int) * 3;
   case RT_FORMAT_UNSIGNED_INT4:
     return sizeof(unsigned int) * 4;
+  case RT_FORMAT_UNSIGNED_BC1:
+    return 8; // Bytes per 4x4 block.
+  case RT_FORMAT_UNSIGNED_BC3:
+  case RT_FORMAT_UNSIGNED_BC5:
+  case RT_FORMAT_UNSIGNED_BC6H:
+    return 16;
   case RT_FORMAT_UNKNOWN:
   case RT_FORMAT_USER:
   default:
@@ -837,6 +1225,69 @@ void remapToFloat(void *dst, const void *src, size_t count, unsigned int dstEnco
 }
 
 
+// Per texel conversions of the fast RGBA paths. Same type is a copy, 16 to 8 bit unsigned fixed point keeps the most significant bits,
+// which is what adjust<unsigned char, unsigned short>() does.
+template<typename D, typename S>
+struct TexelConvert;
+
+template<typename T>
+struct TexelConvert<T, T>
+{
+  static T apply(const T value)
+  {
+    return value;
+  }
+};
+
+template<>
+struct TexelConvert<unsigned char, unsigned short>
+{
+  static unsigned char apply(const unsigned short value)
+  {
+    return (unsigned char) (value >> 8);
+  }
+};
+
+// Fixed RGBA destination layout from any RGB or RGBA source channel order (RGB, BGR, RGBA, BGRA).
+// The channel routing is decoded once per call, the inner loops are branch free and have constant strides,
+// so the compiler can unroll and pipeline them.
+template<typename D, typename S>
+void remapToRgba(void *dst, const void *src, size_t count, unsigned int dstEncoding, unsigned int srcEncoding)
+{
+  const S *psrc = reinterpret_cast<const S *>(src);
+  D *pdst = reinterpret_cast<D *>(dst);
+  const unsigned int srcChannels = (srcEncoding >> ENC_CHANNELS_SHIFT) & ENC_MASK;
+  const unsigned int r = (srcEncoding >> ENC_RED_SHIFT)   & ENC_MASK;
+  const unsigned int g = (srcEncoding >> ENC_GREEN_SHIFT) & ENC_MASK;
+  const unsigned int b = (srcEncoding >> ENC_BLUE_SHIFT)  & ENC_MASK;
+  const unsigned int a = (srcEncoding >> ENC_ALPHA_SHIFT) & ENC_MASK;
+
+  if (a < 4 && !(dstEncoding & ENC_ALPHA_ONE))
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      const S *texel = psrc + i * srcChannels;
+      pdst[i * 4    ] = TexelConvert<D, S>::apply(texel[r]);
+      pdst[i * 4 + 1] = TexelConvert<D, S>::apply(texel[g]);
+      pdst[i * 4 + 2] = TexelConvert<D, S>::apply(texel[b]);
+      pdst[i * 4 + 3] = TexelConvert<D, S>::apply(texel[a]);
+    }
+  }
+  else
+  {
+    const D one = getAlphaOne<D>();
+    for (size_t i = 0; i < count; ++i)
+    {
+      const S *texel = psrc + i * srcChannels;
+      pdst[i * 4    ] = TexelConvert<D, S>::apply(texel[r]);
+      pdst[i * 4 + 1] = TexelConvert<D, S>::apply(texel[g]);
+      pdst[i * 4 + 2] = TexelConvert<D, S>::apply(texel[b]);
+      pdst[i * 4 + 3] = one;
+    }
+  }
+}
+
+
 typedef void (*PFNREMAP)(void *dst, const void *src, size_t count, unsigned int dstEncoding, unsigned int srcEncoding);
 
 // Function table with 49 texture format conversion routines from loaded image data to supported CUDA texture formats.
@@ -909,7 +1360,54 @@ PFNREMAP remappers[7][7] =
 };
 
 
+// Bytes per channel of the ENC_TYPE_* index.
+static const size_t encodingTypeSizes[7] = { 1, 1, 2, 2, 4, 4, 4 };
+
+// Texels per conversion task.
+#define CONVERT_BLOCK_ELEMENTS 16384
+
+// The RGB8 to RGBA8, RGB32F to RGBA32F and RGBA16 to RGBA8 conversions of the common image files get the fixed RGBA layout routines,
+// all others the generic per channel remappers. nullptr == no fast path.
+static PFNREMAP getFastRemapper(unsigned int dstEncoding, unsigned int srcEncoding)
+{
+  const unsigned int rgba = ENC_RED_0 | ENC_GREEN_1 | ENC_BLUE_2 | ENC_ALPHA_3 | ENC_LUM_NONE | ENC_CHANNELS_4;
+  const unsigned int layout = ENC_MASK << ENC_RED_SHIFT | ENC_MASK << ENC_GREEN_SHIFT | ENC_MASK << ENC_BLUE_SHIFT |
+                              ENC_MASK << ENC_ALPHA_SHIFT | ENC_MASK << ENC_LUM_SHIFT | ENC_MASK << ENC_CHANNELS_SHIFT;
+  if ((dstEncoding & layout) != rgba)
+  {
+    return nullptr;
+  }
+
+  // Any source channel order with red, green and blue present and no luminance.
+  const unsigned int r = (srcEncoding >> ENC_RED_SHIFT)   & ENC_MASK;
+  const unsigned int g = (srcEncoding >> ENC_GREEN_SHIFT) & ENC_MASK;
+  const unsigned int b = (srcEncoding >> ENC_BLUE_SHIFT)  & ENC_MASK;
+  const unsigned int l = (srcEncoding >> ENC_LUM_SHIFT)   & ENC_MASK;
+  if (4 <= r || 4 <= g || 4 <= b || l < 4)
+  {
+    return nullptr;
+  }
+
+  const unsigned int dstType = dstEncoding & (ENC_MASK << ENC_TYPE_SHIFT);
+  const unsigned int srcType = srcEncoding & (ENC_MASK << ENC_TYPE_SHIFT);
+
+  if (dstType == ENC_TYPE_UNSIGNED_CHAR && srcType == ENC_TYPE_UNSIGNED_CHAR)
+  {
+    return remapToRgba<unsigned char, unsigned char>;
+  }
+  if (dstType == ENC_TYPE_FLOAT && srcType == ENC_TYPE_FLOAT)
+  {
+    return remapToRgba<float, float>;
+  }
+  if (dstType == ENC_TYPE_UNSIGNED_CHAR && srcType == ENC_TYPE_UNSIGNED_SHORT && (dstEncoding & ENC_FIXED_POINT))
+  {
+    return remapToRgba<unsigned char, unsigned short>;
+  }
+  return nullptr;
+}
+
 // Finally the function which converts any loaded image into a texture format supported by CUDA (1, 2, 4 channels only).
+// The texels are converted in blocks on the shared task pool, the blocks are independent.
 void Texture::convert(void *dst, const void *src, size_t elements, unsigned int hostEncoding) const
 {
   // Only destination encoding knows about the fixed-point encoding. For straight data memcpy() cases that is irrelevant.
@@ -923,9 +1421,23 @@ void Texture::convert(void *dst, const void *src, size_t elements, unsigned int
     unsigned int srcType = (hostEncoding >> ENC_TYPE_SHIFT) & ENC_MASK;
     MY_ASSERT(dstType < 7 && srcType < 7); 
           
-    PFNREMAP pfn = remappers[dstType][srcType];
+    PFNREMAP pfn = getFastRemapper(m_encoding, hostEncoding);
+    if (pfn == nullptr)
+    {
+      pfn = remappers[dstType][srcType];
+    }
+
+    const size_t dstElementSize = getElementSize();
+    const size_t srcElementSize = ((hostEncoding >> ENC_CHANNELS_SHIFT) & ENC_MASK) * encodingTypeSizes[srcType];
+    const int    numBlocks      = int((elements + CONVERT_BLOCK_ELEMENTS - 1) / CONVERT_BLOCK_ELEMENTS);
 
-    (*pfn)(dst, src, elements, m_encoding, hostEncoding);
+    parallelFor(0, numBlocks, [&](const int block)
+    {
+      const size_t first = size_t(block) * CONVERT_BLOCK_ELEMENTS;
+      const size_t count = std::min(size_t(CONVERT_BLOCK_ELEMENTS), elements - first);
+
+      (*pfn)(static_cast<char*>(dst) + first * dstElementSize, static_cast<const char*>(src) + first * srcElementSize, count, m_encoding, hostEncoding);
+    }, 2);
   }
 }
 
@@ -951,6 +1463,45 @@ bool Texture::createEnvironment(const Picture* picture)
     return false;
   }
 
+  if (image->m_block != IMAGE_BLOCK_NONE)
+  {
+    std::cerr << "ERROR: The environment CDFs need uncompressed texels! Creating white dummy environment." << std::endl;
+    createEnvironment();
+    return false;
+  }
+
+#if USE_CUBEMAP_ENVIRONMENT
+  // Cubemap Pictures are used directly. The six faces must be square and of the same size.
+  if (picture->isCubemap() && picture->getNumberOfImages() == 6)
+  {
+    const unsigned int size = image->m_width;
+
+    m_encoding  = ENC_RED_0 | ENC_GREEN_1 | ENC_BLUE_2 | ENC_ALPHA_3 | ENC_LUM_NONE | ENC_CHANNELS_4 | ENC_ALPHA_ONE | ENC_TYPE_FLOAT;
+    m_format    = RT_FORMAT_FLOAT4;
+    m_readMode  = RT_TEXTURE_READ_ELEMENT_TYPE;
+    m_indexMode = RT_TEXTURE_INDEX_NORMALIZED_COORDINATES;
+
+    m_texels.resize(size_t(size) * size * 6 * 4);
+
+    for (unsigned int face = 0; face < 6; ++face)
+    {
+      const Image* side = picture->getImageFace(face, 0);
+      if (side == nullptr || side->m_width != size || side->m_height != size || side->m_block != IMAGE_BLOCK_NONE)
+      {
+        std::cerr << "ERROR: The cubemap environment faces must be uncompressed squares of the same size! Creating white dummy environment." << std::endl;
+        createEnvironment();
+        return false;
+      }
+      convert(m_texels.data() + size_t(face) * size * size * 4, side->m_pixels, size * size, determineHostEncoding(side->m_format, side->m_type));
+    }
+
+    m_width  = size;
+    m_height = size;
+    m_depth  = 6;
+    return true;
+  }
+#endif
+
   // If there is any data in that 2D image create the texture.
   if (0 < image->m_nob && image->m_depth == 1)
   {
@@ -973,6 +1524,10 @@ bool Texture::createEnvironment(const Picture* picture)
     // Converting into a local memory for the CDF generation routines to use the expected RGBA32F data.
     m_texels.resize(image->m_width * image->m_height * 4);
     convert(m_texels.data(), image->m_pixels, image->m_width * image->m_height, hostEncoding); // After this m_texels contains RGBA32F data.
+
+#if USE_CUBEMAP_ENVIRONMENT
+    resampleToCubemap();
+#endif
   }
   return true;
 }
@@ -982,17 +1537,23 @@ bool Texture::createEnvironment(const Picture* picture)
 // That allows to switch miss shader implementations without recompilation of the application.
 void Texture::createEnvironment()
 {
+#if USE_CUBEMAP_ENVIRONMENT
+  m_width  = 4;
+  m_height = 4;
+  m_depth  = 6; // Six faces.
+#else
   m_width  = 8;
   m_height = 4;
   m_depth  = 1;
+#endif
  
-  m_texels.resize(m_width * m_height * 4);
+  m_texels.resize(m_width * m_height * m_depth * 4);
   
   float* rgba = m_texels.data();
 
   // Debug diffuse scattering with a uniform environment. 
   // (White sphere in white room must be white!)
-  for (unsigned int y = 0; y < m_height; ++y)
+  for (unsigned int y = 0; y < m_height * m_depth; ++y)
   {
     for (unsigned int x = 0; x < m_width; ++x)
     {
@@ -1049,25 +1610,52 @@ static float gaussianFilter(const float* rgba, unsigned int width, unsigned int
 // See "Physically Based Rendering" v2, chapter 14.6.5 on Infinite Area Lights.
 bool Texture::calculateCDF(optix::Context context)
 {
+#if USE_CUBEMAP_ENVIRONMENT
+  return calculateCubemapDistribution(context);
+#endif
+
   if (m_texels.empty() || (m_texels.size() != m_width * m_height * 4))
   {
     return false;
   }
 
+#if USE_GPU_ENVIRONMENT_CDF
+  createEnvironmentSampler(context);
+
+  // Only allocate the distribution here. calculateCDFDevice() fills it once the scene is complete and can be launched.
+  m_bufferCDF_U = context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, m_width + 1, m_height); 
+  m_bufferCDF_V = context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, m_height + 1);
+
+  m_bufferAlias = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+  m_bufferAlias->setElementSize(sizeof(EnvironmentAlias));
+  m_bufferAlias->setSize(m_width * m_height);
+
+  m_integral = 1.0f; // Set by calculateCDFDevice().
+
+  m_texels.clear(); // The texels are on the device already.
+
+  return true;
+#endif
+
   const float *rgba = m_texels.data();
 
   // The original data needs to be retained to calculate the PDF.
   float *funcU = new float[m_width * m_height];
   float *funcV = new float[m_height + 1];
 
-  float sum = 0.0f;
-  // First generate the function data.
-  for (unsigned int y = 0; y < m_height; ++y)
+  // Per row sums, added up in row order afterwards, so that the integral doesn't depend on the thread count.
+  std::vector<float> rowSums(m_height);
+
+  // First generate the function data. The rows are independent.
+  parallelFor(0, int(m_height), [&](const int row)
   {
+    const unsigned int y = (unsigned int) row;
+
     // Scale distibution by the sine to get the sampling uniform. (Avoid sampling more values near the poles.)
     // See Physically Based Rendering v2, chapter 14.6.5 on Infinite Area Lights, page 728.
     float sinTheta = float(sin(M_PI * (double(y) + 0.5) / double(m_height))); // Make this as accurate as possible.
 
+    float rowSum = 0.0f;
     for (unsigned int x = 0; x < m_width; ++x)
     {
       // Filter to keep the piecewise linear function intact for samples with zero value next to non-zero values.
@@ -1077,8 +1665,15 @@ bool Texture::calculateCDF(optix::Context context)
       // Compute integral over the actual function.
       const float *p = rgba + (y * m_width + x) * 4;
       const float intensity = (p[0] + p[1] + p[2]) / 3.0f;
-      sum += intensity * sinTheta;
+      rowSum += intensity * sinTheta;
     }
+    rowSums[y] = rowSum;
+  }, 8);
+
+  float sum = 0.0f;
+  for (unsigned int y = 0; y < m_height; ++y)
+  {
+    sum += rowSums[y];
   }
 
   // This integral is used inside the light sampling function (see sysEnvironmentIntegral).
@@ -1090,8 +1685,10 @@ bool Texture::calculateCDF(optix::Context context)
   float *cdfU = new float[(m_width + 1) * m_height];
   float *cdfV = new float[m_height + 1];
 
-  for (unsigned int y = 0; y < m_height; ++y)
+  parallelFor(0, int(m_height), [&](const int rowIndex)
   {
+    const unsigned int y = (unsigned int) rowIndex;
+
     unsigned int row = y * (m_width + 1); // Watch the stride!
     cdfU[row + 0] = 0.0f; // CDF starts at 0.0f.
 
@@ -1118,7 +1715,7 @@ bool Texture::calculateCDF(optix::Context context)
         cdfU[row + x] = float(x) / float(m_width);
       }
     }
-  }
+  }, 8);
 
   // Now do the same thing with the marginal CDF.
   cdfV[0] = 0.0f; // CDF starts at 0.0f.
@@ -1145,6 +1742,36 @@ bool Texture::calculateCDF(optix::Context context)
     }
   }
 
+  createEnvironmentSampler(context);
+
+  // Upload the CDFs into OptiX buffers.
+  m_bufferCDF_U = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, m_width + 1, m_height); 
+
+  void* buf = m_bufferCDF_U->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+  memcpy(buf, cdfU, (m_width + 1) * m_height * sizeof(float));
+  m_bufferCDF_U->unmap();
+
+  m_bufferCDF_V = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, m_height + 1);
+
+  buf = m_bufferCDF_V->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+  memcpy(buf, cdfV, (m_height + 1) * sizeof(float));
+  m_bufferCDF_V->unmap();
+
+  createAliasTable(context, funcU);
+
+  delete [] cdfV;
+  delete [] cdfU;
+        
+  delete [] funcV;
+  delete [] funcU;
+
+  m_texels.clear(); // The original float data is not needed anymore.
+
+  return true;
+}
+
+void Texture::createEnvironmentSampler(optix::Context context)
+{
   // Upload that RGBA32F environment texture data.
   // Doing this here no not duplicate the code in the createEnvironment routines.
   m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, m_width, m_height);
@@ -1164,30 +1791,380 @@ bool Texture::calculateCDF(optix::Context context)
   m_sampler->setReadMode(m_readMode);
   m_sampler->setMaxAnisotropy(1.0f);
   m_sampler->setBuffer(0, 0, m_buffer);
+}
 
-  // Upload the CDFs into OptiX buffers.
-  m_bufferCDF_U = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, m_width + 1, m_height); 
+// Alias table over the piecewise constant function of all texels, which is what the CDFs sample as well.
+void Texture::createAliasTable(optix::Context context, const float* function)
+{
+  const size_t numTexels = size_t(m_width) * size_t(m_height);
 
-  void* buf = m_bufferCDF_U->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-  memcpy(buf, cdfU, (m_width + 1) * m_height * sizeof(float));
-  m_bufferCDF_U->unmap();
+  std::vector<float> weights(function, function + numTexels);
+  std::vector<float>        threshold;
+  std::vector<unsigned int> alias;
+  buildAliasTable(weights, threshold, alias);
 
-  m_bufferCDF_V = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, m_height + 1);
+  double sumTexels = 0.0;
+  for (size_t i = 0; i < numTexels; ++i)
+  {
+    sumTexels += weights[i];
+  }
 
-  buf = m_bufferCDF_V->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-  memcpy(buf, cdfV, (m_height + 1) * sizeof(float));
-  m_bufferCDF_V->unmap();
+  if (!m_bufferAlias)
+  {
+    m_bufferAlias = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+    m_bufferAlias->setElementSize(sizeof(EnvironmentAlias));
+    m_bufferAlias->setSize(numTexels);
+  }
 
-  delete [] cdfV;
-  delete [] cdfU;
-        
-  delete [] funcV;
-  delete [] funcU;
+  EnvironmentAlias* entries = static_cast<EnvironmentAlias*>(m_bufferAlias->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  for (size_t i = 0; i < numTexels; ++i)
+  {
+    // Discrete probability times the number of texels is the pdf in uv-space. Uniform when the whole image is black.
+    entries[i].threshold = threshold[i];
+    entries[i].alias     = alias[i];
+    entries[i].pdf       = (0.0 < sumTexels) ? float(double(weights[i])        * double(numTexels) / sumTexels) : 1.0f;
+    entries[i].pdfAlias  = (0.0 < sumTexels) ? float(double(weights[alias[i]]) * double(numTexels) / sumTexels) : 1.0f;
+  }
+  m_bufferAlias->unmap();
+}
+
+#if USE_CUBEMAP_ENVIRONMENT
+// Bilinear lookup into RGBA32F lat-long texels, repeated in u and clamped in v like the spherical environment sampler.
+static void lookupLatLong(const float* rgba, const unsigned int width, const unsigned int height, const float u, const float v, float* result)
+{
+  const float x = u * float(width)  - 0.5f;
+  const float y = v * float(height) - 0.5f;
+
+  const float fx = floorf(x);
+  const float fy = floorf(y);
+  const float tx = x - fx;
+  const float ty = y - fy;
+
+  const int x0 = (int(fx) % int(width) + int(width)) % int(width);
+  const int x1 = (x0 + 1) % int(width);
+  const int y0 = std::min(std::max(int(fy),     0), int(height) - 1);
+  const int y1 = std::min(std::max(int(fy) + 1, 0), int(height) - 1);
+
+  const float* p00 = rgba + (y0 * width + x0) * 4;
+  const float* p10 = rgba + (y0 * width + x1) * 4;
+  const float* p01 = rgba + (y1 * width + x0) * 4;
+  const float* p11 = rgba + (y1 * width + x1) * 4;
+
+  for (unsigned int c = 0; c < 4; ++c)
+  {
+    result[c] = (p00[c] * (1.0f - tx) + p10[c] * tx) * (1.0f - ty) +
+                (p01[c] * (1.0f - tx) + p11[c] * tx) * ty;
+  }
+}
+
+// Faces with a quarter of the lat-long width match its texel density at the equator.
+// The mapping from directions to u, v is the one of the lat-long miss program without rotation.
+void Texture::resampleToCubemap()
+{
+  const unsigned int size = std::max(1u, m_width / 4);
+
+  std::vector<float> faces(size_t(size) * size * 6 * 4);
+
+  float* dst = faces.data();
+  for (unsigned int face = 0; face < 6; ++face)
+  {
+    for (unsigned int y = 0; y < size; ++y)
+    {
+      const float b = 2.0f * (float(y) + 0.5f) / float(size) - 1.0f;
+
+      for (unsigned int x = 0; x < size; ++x)
+      {
+        const float a = 2.0f * (float(x) + 0.5f) / float(size) - 1.0f;
+
+        const optix::float3 R = optix::normalize(cubemapDirection(face, a, b));
+
+        const float u = (atan2f(R.x, -R.z) + M_PIf) * 0.5f * M_1_PIf;
+        const float v = acosf(std::min(std::max(-R.y, -1.0f), 1.0f)) * M_1_PIf;
+
+        lookupLatLong(m_texels.data(), m_width, m_height, u, v, dst);
+        dst += 4;
+      }
+    }
+  }
+
+  m_texels.swap(faces);
+
+  m_width  = size;
+  m_height = size;
+  m_depth  = 6;
+}
+
+// Solid angle of the rectangle from the face center to (a, b) on the face plane at distance 1.
+static double faceCornerSolidAngle(const double a, const double b)
+{
+  return atan2(a * b, sqrt(a * a + b * b + 1.0));
+}
+
+// Solid angle of the rectangle [a0, a1] x [b0, b1] on the face plane.
+static double faceSolidAngle(const double a0, const double b0, const double a1, const double b1)
+{
+  return faceCornerSolidAngle(a1, b1) - faceCornerSolidAngle(a0, b1) - faceCornerSolidAngle(a1, b0) + faceCornerSolidAngle(a0, b0);
+}
+
+// Same 3x3 Gaussian with sigma = 0.5 as gaussianFilter(), clamped at the face edges.
+static float gaussianFilterFace(const float* rgba, const unsigned int size, const unsigned int x, const unsigned int y)
+{
+  static const float kernel[3][3] =
+  {
+    { 0.0113437f, 0.0838195f, 0.0113437f },
+    { 0.0838195f, 0.619347f,  0.0838195f },
+    { 0.0113437f, 0.0838195f, 0.0113437f }
+  };
+
+  float intensity = 0.0f;
+  for (int j = -1; j <= 1; ++j)
+  {
+    const int yy = std::min(std::max(int(y) + j, 0), int(size) - 1);
+    for (int i = -1; i <= 1; ++i)
+    {
+      const int xx = std::min(std::max(int(x) + i, 0), int(size) - 1);
+
+      const float* p = rgba + (yy * size + xx) * 4;
+      intensity += (p[0] + p[1] + p[2]) * kernel[j + 1][i + 1];
+    }
+  }
+  return intensity / 3.0f;
+}
+
+// Alias table over the texels of all six faces, which amounts to picking a face and then a texel inside its 2D distribution.
+// The weights are the filtered intensities times the exact solid angles of the texels, so the corners of the faces,
+// which cover less solid angle, are sampled less often. The pdf is stored with respect to the area on the face plane.
+bool Texture::calculateCubemapDistribution(optix::Context context)
+{
+  const unsigned int size       = m_width;
+  const size_t       texelsFace = size_t(size) * size;
+  const size_t       numTexels  = texelsFace * 6;
+
+  if (m_depth != 6 || m_texels.size() != numTexels * 4)
+  {
+    return false;
+  }
+
+  // The texels are always RGBA32F here, also for the white dummy environment.
+  m_format    = RT_FORMAT_FLOAT4;
+  m_readMode  = RT_TEXTURE_READ_ELEMENT_TYPE;
+  m_indexMode = RT_TEXTURE_INDEX_NORMALIZED_COORDINATES;
+
+  m_buffer = context->createBuffer(RT_BUFFER_INPUT | RT_BUFFER_CUBEMAP, m_format, size, size, 6);
+  m_buffer->setMipLevelCount(1);
+
+  void *dst = m_buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+  memcpy(dst, m_texels.data(), numTexels * sizeof(float) * 4);
+  m_buffer->unmap();
+
+  m_sampler = context->createTextureSampler();
+
+  // Cubemaps need RT_WRAP_CLAMP_TO_EDGE to not generate seams at image borders with linear filering.
+  m_sampler->setWrapMode(0, RT_WRAP_CLAMP_TO_EDGE);
+  m_sampler->setWrapMode(1, RT_WRAP_CLAMP_TO_EDGE);
+  m_sampler->setWrapMode(2, RT_WRAP_CLAMP_TO_EDGE);
+  m_sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+  m_sampler->setIndexingMode(m_indexMode);
+  m_sampler->setReadMode(m_readMode);
+  m_sampler->setMaxAnisotropy(1.0f);
+  m_sampler->setBuffer(0, 0, m_buffer);
+
+  // The solid angles are the same on all faces.
+  std::vector<float> solidAngles(texelsFace);
+  for (unsigned int y = 0; y < size; ++y)
+  {
+    const double b0 = 2.0 * double(y)     / double(size) - 1.0;
+    const double b1 = 2.0 * double(y + 1) / double(size) - 1.0;
+    for (unsigned int x = 0; x < size; ++x)
+    {
+      const double a0 = 2.0 * double(x)     / double(size) - 1.0;
+      const double a1 = 2.0 * double(x + 1) / double(size) - 1.0;
+
+      solidAngles[y * size + x] = float(faceSolidAngle(a0, b0, a1, b1));
+    }
+  }
+
+  std::vector<float> weights(numTexels);
+
+  double sumWeights = 0.0;
+  double integral   = 0.0;
+  for (unsigned int face = 0; face < 6; ++face)
+  {
+    const float* rgba = m_texels.data() + texelsFace * face * 4;
+
+    for (unsigned int y = 0; y < size; ++y)
+    {
+      for (unsigned int x = 0; x < size; ++x)
+      {
+        const size_t i = texelsFace * face + y * size + x;
+        const float* p = rgba + (y * size + x) * 4;
+
+        const float solidAngle = solidAngles[y * size + x];
+
+        weights[i]  = gaussianFilterFace(rgba, size, x, y) * solidAngle;
+        sumWeights += weights[i];
+        integral   += double((p[0] + p[1] + p[2]) / 3.0f) * double(solidAngle); // The integral over the actual function.
+      }
+    }
+  }
+
+  // An all black environment is sampled uniformly over the sphere.
+  if (sumWeights <= 0.0)
+  {
+    sumWeights = 0.0;
+    for (size_t i = 0; i < numTexels; ++i)
+    {
+      weights[i]  = solidAngles[i % texelsFace];
+      sumWeights += weights[i];
+    }
+  }
+
+  // This integral is used for the light selection, the same value the lat-long CDFs deliver.
+  m_integral = float(integral);
+
+  std::vector<float>        threshold;
+  std::vector<unsigned int> alias;
+  buildAliasTable(weights, threshold, alias);
+
+  const double texelArea = 4.0 / double(texelsFace); // Area of one texel on the face plane.
+
+  m_bufferAlias = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+  m_bufferAlias->setElementSize(sizeof(EnvironmentAlias));
+  m_bufferAlias->setSize(numTexels);
+
+  EnvironmentAlias* entries = static_cast<EnvironmentAlias*>(m_bufferAlias->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  for (size_t i = 0; i < numTexels; ++i)
+  {
+    entries[i].threshold = threshold[i];
+    entries[i].alias     = alias[i];
+    entries[i].pdf       = float(double(weights[i])        / sumWeights / texelArea);
+    entries[i].pdfAlias  = float(double(weights[alias[i]]) / sumWeights / texelArea);
+  }
+  m_bufferAlias->unmap();
 
   m_texels.clear(); // The original float data is not needed anymore.
 
   return true;
 }
+#endif
+
+#if USE_GPU_ENVIRONMENT_CDF
+// Runs the environment_cdf.cu entry points on the buffers allocated by calculateCDF().
+// This is a launch, so it must be called when the whole scene is valid.
+bool Texture::calculateCDFDevice(optix::Context context)
+{
+  if (!m_buffer || !m_bufferCDF_U || !m_bufferCDF_V)
+  {
+    return false;
+  }
+
+  optix::Buffer bufferFunction = context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, m_width, m_height);
+  optix::Buffer bufferSums     = context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, m_height + 1);
+
+  context["sysEnvironmentTexels"]->setBuffer(m_buffer);
+  context["sysEnvironmentFunction"]->setBuffer(bufferFunction);
+  context["sysEnvironmentCDF_U"]->setBuffer(m_bufferCDF_U);
+  context["sysEnvironmentCDF_V"]->setBuffer(m_bufferCDF_V);
+  context["sysEnvironmentSums"]->setBuffer(bufferSums);
+
+  context->launch(ENTRY_ENVIRONMENT_FUNCTION, m_width, m_height);
+  context->launch(ENTRY_ENVIRONMENT_ROWS,     1,       m_height);
+  context->launch(ENTRY_ENVIRONMENT_MARGINAL, 1,       1);
+
+  const float* sums = static_cast<const float*>(bufferSums->map(0, RT_BUFFER_MAP_READ));
+  m_integral = sums[m_height];
+  bufferSums->unmap();
+
+  // The alias table construction is sequential and stays on the host.
+  const float* function = static_cast<const float*>(bufferFunction->map(0, RT_BUFFER_MAP_READ));
+  createAliasTable(context, function);
+  bufferFunction->unmap();
+
+  // Release the temporary buffers. The variables must stay valid for the following launches.
+  context["sysEnvironmentFunction"]->setBuffer(context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, 1, 1));
+  context["sysEnvironmentSums"]->setBuffer(context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, 1));
+  bufferFunction->destroy();
+  bufferSums->destroy();
+
+  return true;
+}
+#endif
+
+#if USE_GPU_MIPMAPS
+// Runs the mipmap.cu entry points over the levels allocated by fillSampler().
+// This is a launch, so it must be called when the whole scene is valid.
+// Each level is box filtered from the previous one in linear space. The host only converts the results to the texture format.
+bool Texture::generateMipmaps(optix::Context context)
+{
+  if (!m_mipmapsPending || !m_buffer)
+  {
+    return false;
+  }
+  m_mipmapsPending = false;
+
+  SUTIL_NVTX_RANGE("Texture::generateMipmaps");
+
+  const unsigned int numLevels = m_buffer->getMipLevelCount();
+
+  std::vector<RTsize> widths(numLevels);
+  std::vector<RTsize> heights(numLevels);
+  std::vector<RTsize> offsets(numLevels, 0); // Level 0 is the uploaded image, not part of the generated texels.
+
+  RTsize numTexels = 0;
+  for (unsigned int level = 0; level < numLevels; ++level)
+  {
+    m_buffer->getMipLevelSize(level, widths[level], heights[level]);
+    if (0 < level)
+    {
+      offsets[level] = numTexels;
+      numTexels += widths[level] * heights[level];
+    }
+  }
+
+  if (numTexels == 0)
+  {
+    return false;
+  }
+
+  optix::Buffer bufferTexels = context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, numTexels);
+
+  context["sysMipmapTexels"]->setBuffer(bufferTexels);
+  context["sysMipmapTexture"]->setInt(m_sampler->getId());
+
+  for (unsigned int level = 1; level < numLevels; ++level)
+  {
+    context["sysMipmapFromTexture"]->setInt((level == 1) ? 1 : 0);
+    context["sysMipmapSourceSize"]->setUint(static_cast<unsigned int>(widths[level - 1]), static_cast<unsigned int>(heights[level - 1]));
+    context["sysMipmapSourceOffset"]->setUint(static_cast<unsigned int>(offsets[level - 1]));
+    context["sysMipmapTargetOffset"]->setUint(static_cast<unsigned int>(offsets[level]));
+
+    context->launch(ENTRY_MIPMAP_LEVEL, widths[level], heights[level]);
+  }
+
+  // The texture hardware decodes sRGB on reads, the stored levels need to be encoded the same way as LOD 0.
+  if (m_readMode == RT_TEXTURE_READ_ELEMENT_TYPE_SRGB || m_readMode == RT_TEXTURE_READ_NORMALIZED_FLOAT_SRGB)
+  {
+    context->launch(ENTRY_MIPMAP_ENCODE, numTexels, 1);
+  }
+
+  const unsigned int hostEncoding = determineHostEncoding(IL_RGBA, IL_FLOAT);
+
+  const float4* texels = static_cast<const float4*>(bufferTexels->map(0, RT_BUFFER_MAP_READ));
+  for (unsigned int level = 1; level < numLevels; ++level)
+  {
+    void* dst = m_buffer->map(level, RT_BUFFER_MAP_WRITE_DISCARD);
+    convert(dst, texels + offsets[level], widths[level] * heights[level], hostEncoding);
+    m_buffer->unmap(level);
+  }
+  bufferTexels->unmap();
+
+  // Release the temporary buffer. The variable must stay valid for the following launches.
+  context["sysMipmapTexels"]->setBuffer(context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1));
+  bufferTexels->destroy();
+
+  return true;
+}
+#endif
 
 float Texture::getIntegral() const
 {
@@ -1195,6 +2172,11 @@ float Texture::getIntegral() const
   return m_integral;
 }
 
+optix::Buffer Texture::getBufferAlias() const
+{
+  return m_bufferAlias;
+}
+
 optix::Buffer Texture::getBufferCDF_U() const
 {
   return m_bufferCDF_U;
@@ -33,6 +33,7 @@
 #include <sstream>
 
 #include "inc/MyAssert.h"
+#include "inc/ParallelFor.h"
 
 optix::Geometry Application::createTorus(const int tessU, const int tessV, const float innerRadius, const float outerRadius)
 {
@@ -51,11 +52,12 @@ optix::Geometry Application::createTorus(const int tessU, const int tessV, const
                 innerRadius
   */
 
-  std::vector<VertexAttributes> attributes;
-  attributes.reserve((tessU + 1) * (tessV + 1));
+  // We generate tessU + 1 vertices per latitude.
+  const unsigned int columns = tessU + 1;
 
-  std::vector<unsigned int> indices;
-  indices.reserve(8 * tessU * tessV);
+  // Sized upfront so that the latitudes can be generated in parallel.
+  std::vector<VertexAttributes> attributes(columns * (tessV + 1));
+  std::vector<unsigned int> indices(6 * tessU * tessV);
 
   const float u = (float) tessU;
   const float v = (float) tessV;
@@ -65,7 +67,7 @@ optix::Geometry Application::createTorus(const int tessU, const int tessV, const
 
   // Setup vertices and normals.
   // Generate the torus exactly like the sphere with rings around the origin along the latitudes.
-  for (int latitude = 0; latitude <= tessV; ++latitude) // theta angle
+  parallelFor(0, tessV + 1, [&](const int latitude) // theta angle
   {
     const float theta    = (float) latitude * theta_step;
     const float sinTheta = sinf(theta);
@@ -79,34 +81,31 @@ optix::Geometry Application::createTorus(const int tessU, const int tessV, const
       const float sinPhi = sinf(phi);
       const float cosPhi = cosf(phi);
 
-      VertexAttributes attrib;
+      VertexAttributes& attrib = attributes[latitude * columns + longitude];
 
       attrib.vertex   = optix::make_float3(radius * cosPhi, outerRadius * sinTheta, radius * -sinPhi);
       attrib.tangent  = optix::make_float3(-sinPhi, 0.0f, -cosPhi);
       attrib.normal   = optix::make_float3(cosPhi * cosTheta, sinTheta, -sinPhi * cosTheta);
       attrib.texcoord = optix::make_float3((float) longitude / u, (float) latitude / v, 0.0f);
-
-      attributes.push_back(attrib);
     }
-  }
-
-  // We have generated tessU + 1 vertices per latitude.
-  const unsigned int columns = tessU + 1;
+  });
 
   // Setup indices
-  for (int latitude = 0; latitude < tessV; ++latitude ) 
+  parallelFor(0, tessV, [&](const int latitude)
   {
+    unsigned int* dst = &indices[6 * tessU * latitude];
+
     for (int longitude = 0; longitude < tessU; ++longitude)
     {
-      indices.push_back( latitude      * columns + longitude    );  // lower left
-      indices.push_back( latitude      * columns + longitude + 1);  // lower right
-      indices.push_back((latitude + 1) * columns + longitude + 1);  // upper right
+      *dst++ =  latitude      * columns + longitude    ;  // lower left
+      *dst++ =  latitude      * columns + longitude + 1;  // lower right
+      *dst++ = (latitude + 1) * columns + longitude + 1;  // upper right
 
-      indices.push_back((latitude + 1) * columns + longitude + 1);  // upper right
-      indices.push_back((latitude + 1) * columns + longitude    );  // upper left
-      indices.push_back( latitude      * columns + longitude    );  // lower left
+      *dst++ = (latitude + 1) * columns + longitude + 1;  // upper right
+      *dst++ = (latitude + 1) * columns + longitude    ;  // upper left
+      *dst++ =  latitude      * columns + longitude    ;  // lower left
     }
-  }
+  });
 
   std::cout << "createTorus(): Vertices = " << attributes.size() <<  ", Triangles = " << indices.size() / 3 << std::endl;
 
@@ -0,0 +1,416 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/VirtualTexture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "inc/MyAssert.h"
+#include "inc/Picture.h"
+
+#if USE_VIRTUAL_TEXTURES
+
+static const size_t tileBytes = VT_SLOT_SIZE * VT_SLOT_SIZE * 4;
+
+static unsigned int tilesPerSide(const unsigned int extent)
+{
+  return (extent + VT_TILE_SIZE - 1) / VT_TILE_SIZE;
+}
+
+
+VirtualTexture::VirtualTexture()
+: m_numTiles(0)
+, m_frame(0)
+{
+  memset(&m_description, 0, sizeof(VirtualTextureDescription));
+  m_description.physicalID    = RT_TEXTURE_ID_NULL;
+  m_description.indirectionID = RT_BUFFER_ID_NULL;
+  m_description.feedbackID    = RT_BUFFER_ID_NULL;
+}
+
+VirtualTexture::~VirtualTexture()
+{
+  // DAR FIXME OptiX objects cannot be destroyed without the context here. Same as in the Texture class.
+}
+
+bool VirtualTexture::isValid() const
+{
+  return (m_numTiles != 0);
+}
+
+VirtualTextureDescription const& VirtualTexture::getDescription() const
+{
+  return m_description;
+}
+
+void VirtualTexture::getBuffers(std::vector<optix::Buffer>& buffers) const
+{
+  buffers.push_back(m_bufferPhysical);
+  buffers.push_back(m_bufferIndirection);
+  buffers.push_back(m_bufferFeedback);
+}
+
+bool VirtualTexture::create(optix::Context context, std::string const& filename, unsigned int slotsPerSide)
+{
+  std::string tileFilename = filename;
+
+  const std::string::size_type last = filename.find_last_of('.');
+  if (last == std::string::npos || filename.substr(last) != std::string(".vtex"))
+  {
+    tileFilename += ".vtex";
+
+    std::ifstream existing(tileFilename, std::ios::binary);
+    if (!existing && !buildTileFile(filename, tileFilename))
+    {
+      return false;
+    }
+  }
+
+  m_file.open(tileFilename, std::ios::binary);
+
+  VirtualTextureHeader header;
+  if (!m_file.read(reinterpret_cast<char*>(&header), sizeof(VirtualTextureHeader)) ||
+      memcmp(header.magic, "VTEX", 4) != 0 || header.version != 1 ||
+      header.tileSize != VT_TILE_SIZE || header.tileBorder != VT_TILE_BORDER ||
+      header.numLevels == 0 || VT_MAX_LEVELS < header.numLevels)
+  {
+    std::cerr << "ERROR: VirtualTexture::create() " << tileFilename << " is not a compatible tile file" << std::endl;
+    m_file.close();
+    return false;
+  }
+
+  m_description.width     = header.width;
+  m_description.height    = header.height;
+  m_description.numLevels = header.numLevels;
+  m_description.slotsX    = std::max(2u, slotsPerSide);
+  m_description.slotsY    = std::max(2u, slotsPerSide);
+
+  unsigned int offset = 0;
+  for (unsigned int level = 0; level < header.numLevels; ++level)
+  {
+    m_description.levelOffset[level] = offset;
+    offset += tilesPerSide(std::max(1u, header.width >> level)) * tilesPerSide(std::max(1u, header.height >> level));
+  }
+  MY_ASSERT(offset == header.numTiles);
+  m_numTiles = offset;
+
+  const unsigned int numSlots = m_description.slotsX * m_description.slotsY;
+
+  m_indirection.assign(m_numTiles, 0);
+  m_slotTile.assign(numSlots, ~0u);
+  m_slotFrame.assign(numSlots, 0);
+  m_texels.resize(tileBytes);
+
+  try
+  {
+    m_bufferPhysical = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4,
+                                             m_description.slotsX * VT_SLOT_SIZE, m_description.slotsY * VT_SLOT_SIZE);
+
+    m_samplerPhysical = context->createTextureSampler();
+    // The borders inside the tiles implement the repeat wrap mode, the physical texture itself never wraps.
+    m_samplerPhysical->setWrapMode(0, RT_WRAP_CLAMP_TO_EDGE);
+    m_samplerPhysical->setWrapMode(1, RT_WRAP_CLAMP_TO_EDGE);
+    m_samplerPhysical->setWrapMode(2, RT_WRAP_CLAMP_TO_EDGE);
+    m_samplerPhysical->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+    m_samplerPhysical->setIndexingMode(RT_TEXTURE_INDEX_NORMALIZED_COORDINATES);
+    m_samplerPhysical->setReadMode(RT_TEXTURE_READ_NORMALIZED_FLOAT);
+    m_samplerPhysical->setMaxAnisotropy(1.0f);
+    m_samplerPhysical->setBuffer(m_bufferPhysical);
+
+    m_bufferIndirection = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, m_numTiles);
+
+    m_bufferFeedback = context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_BYTE, m_numTiles);
+    memset(m_bufferFeedback->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 0, m_numTiles);
+    m_bufferFeedback->unmap();
+
+    // The single tile of the last level is resident all the time and ends every fallback chain.
+    unsigned char* physical = static_cast<unsigned char*>(m_bufferPhysical->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    memset(physical, 0, m_description.slotsX * m_description.slotsY * tileBytes);
+    const bool pinned = uploadTile(m_numTiles - 1, 0, physical);
+    m_bufferPhysical->unmap();
+
+    memcpy(m_bufferIndirection->map(0, RT_BUFFER_MAP_WRITE_DISCARD), m_indirection.data(), sizeof(unsigned int) * m_numTiles);
+    m_bufferIndirection->unmap();
+
+    if (!pinned)
+    {
+      m_numTiles = 0;
+      return false;
+    }
+
+    m_description.physicalID    = m_samplerPhysical->getId();
+    m_description.indirectionID = m_bufferIndirection->getId();
+    m_description.feedbackID    = m_bufferFeedback->getId();
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+    m_numTiles = 0;
+    return false;
+  }
+
+  std::cout << "VirtualTexture::create() " << tileFilename << ": " << m_description.width << " x " << m_description.height
+            << ", " << m_description.numLevels << " levels, " << m_numTiles << " tiles, " << numSlots << " slots" << std::endl;
+  return true;
+}
+
+bool VirtualTexture::update(unsigned int maxTiles)
+{
+  if (!isValid())
+  {
+    return false;
+  }
+
+  ++m_frame;
+
+  std::vector<unsigned int> requests;
+
+  try
+  {
+    unsigned char* feedback = static_cast<unsigned char*>(m_bufferFeedback->map(0, RT_BUFFER_MAP_READ_WRITE));
+    for (unsigned int i = 0; i < m_numTiles; ++i)
+    {
+      if (feedback[i])
+      {
+        feedback[i] = 0;
+
+        if (m_indirection[i] != 0)
+        {
+          m_slotFrame[m_indirection[i] - 1] = m_frame;
+        }
+        else
+        {
+          requests.push_back(i);
+        }
+      }
+    }
+    m_bufferFeedback->unmap();
+
+    if (requests.empty())
+    {
+      return false;
+    }
+
+    // Coarser levels have higher tile indices. Streaming them first gives the fastest overall improvement.
+    std::sort(requests.begin(), requests.end(), [](unsigned int a, unsigned int b) { return b < a; });
+    if (maxTiles < requests.size())
+    {
+      requests.resize(maxTiles);
+    }
+
+    unsigned int uploaded = 0;
+
+    unsigned char* physical = static_cast<unsigned char*>(m_bufferPhysical->map(0, RT_BUFFER_MAP_READ_WRITE));
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+      // Free slot or the least recently requested one. Tiles requested in this frame are never evicted.
+      unsigned int slot = ~0u;
+      for (unsigned int s = 1; s < (unsigned int) m_slotTile.size(); ++s)
+      {
+        if (m_slotTile[s] == ~0u)
+        {
+          slot = s;
+          break;
+        }
+        if (m_slotFrame[s] < m_frame && (slot == ~0u || m_slotFrame[s] < m_slotFrame[slot]))
+        {
+          slot = s;
+        }
+      }
+      if (slot == ~0u)
+      {
+        break; // The physical texture is too small for the working set.
+      }
+
+      if (m_slotTile[slot] != ~0u)
+      {
+        m_indirection[m_slotTile[slot]] = 0;
+        m_slotTile[slot] = ~0u;
+      }
+
+      if (uploadTile(requests[i], slot, physical))
+      {
+        ++uploaded;
+      }
+    }
+    m_bufferPhysical->unmap();
+
+    memcpy(m_bufferIndirection->map(0, RT_BUFFER_MAP_WRITE_DISCARD), m_indirection.data(), sizeof(unsigned int) * m_numTiles);
+    m_bufferIndirection->unmap();
+
+    return (uploaded != 0);
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+  return false;
+}
+
+
+// Private functions
+
+bool VirtualTexture::readTile(unsigned int index, unsigned char* dst)
+{
+  m_file.clear();
+  m_file.seekg(std::streamoff(sizeof(VirtualTextureHeader)) + std::streamoff(index) * std::streamoff(tileBytes));
+  return bool(m_file.read(reinterpret_cast<char*>(dst), tileBytes));
+}
+
+bool VirtualTexture::uploadTile(unsigned int index, unsigned int slot, unsigned char* physical)
+{
+  if (!readTile(index, m_texels.data()))
+  {
+    std::cerr << "ERROR: VirtualTexture::uploadTile() could not read tile " << index << std::endl;
+    return false;
+  }
+
+  const unsigned int sx = slot % m_description.slotsX;
+  const unsigned int sy = slot / m_description.slotsX;
+
+  const size_t rowBytes = m_description.slotsX * VT_SLOT_SIZE * 4;
+
+  for (unsigned int y = 0; y < VT_SLOT_SIZE; ++y)
+  {
+    memcpy(physical + (sy * VT_SLOT_SIZE + y) * rowBytes + sx * VT_SLOT_SIZE * 4, &m_texels[y * VT_SLOT_SIZE * 4], VT_SLOT_SIZE * 4);
+  }
+
+  m_indirection[index] = slot + 1;
+  m_slotTile[slot]     = index;
+  m_slotFrame[slot]    = m_frame;
+  return true;
+}
+
+// Box filtered mipmap levels down to the first level which fits into a single tile, each tile with a border of repeated texels.
+bool VirtualTexture::buildTileFile(std::string const& source, std::string const& destination) const
+{
+  Picture picture;
+
+  std::vector<unsigned char> texels;
+  if (!picture.load(source) || !picture.getRGBA8(0, 0, texels))
+  {
+    std::cerr << "ERROR: VirtualTexture::buildTileFile() " << source << " is not an 8-bit image" << std::endl;
+    return false;
+  }
+
+  const Image* image = picture.getImageFace(0, 0);
+
+  std::vector< std::vector<unsigned char> > levels;
+  levels.push_back(texels);
+
+  unsigned int w = image->m_width;
+  unsigned int h = image->m_height;
+  while (VT_TILE_SIZE < w || VT_TILE_SIZE < h)
+  {
+    const unsigned int wn = std::max(1u, w >> 1);
+    const unsigned int hn = std::max(1u, h >> 1);
+
+    std::vector<unsigned char> const& src = levels.back();
+    std::vector<unsigned char> dst(wn * hn * 4);
+    for (unsigned int y = 0; y < hn; ++y)
+    {
+      const unsigned int y0 = std::min(y * 2,     h - 1);
+      const unsigned int y1 = std::min(y * 2 + 1, h - 1);
+      for (unsigned int x = 0; x < wn; ++x)
+      {
+        const unsigned int x0 = std::min(x * 2,     w - 1);
+        const unsigned int x1 = std::min(x * 2 + 1, w - 1);
+        for (unsigned int c = 0; c < 4; ++c)
+        {
+          const unsigned int sum = src[(y0 * w + x0) * 4 + c] + src[(y0 * w + x1) * 4 + c] +
+                                   src[(y1 * w + x0) * 4 + c] + src[(y1 * w + x1) * 4 + c];
+          dst[(y * wn + x) * 4 + c] = (unsigned char)((sum + 2) >> 2);
+        }
+      }
+    }
+    levels.push_back(dst);
+    w = wn;
+    h = hn;
+  }
+
+  if (VT_MAX_LEVELS < levels.size())
+  {
+    std::cerr << "ERROR: VirtualTexture::buildTileFile() " << source << " needs more than VT_MAX_LEVELS levels" << std::endl;
+    return false;
+  }
+
+  std::ofstream file(destination, std::ios::binary);
+  if (!file)
+  {
+    std::cerr << "ERROR: VirtualTexture::buildTileFile() cannot write " << destination << std::endl;
+    return false;
+  }
+
+  VirtualTextureHeader header;
+  memcpy(header.magic, "VTEX", 4);
+  header.version    = 1;
+  header.width      = image->m_width;
+  header.height     = image->m_height;
+  header.tileSize   = VT_TILE_SIZE;
+  header.tileBorder = VT_TILE_BORDER;
+  header.numLevels  = (unsigned int) levels.size();
+  header.numTiles   = 0;
+  for (unsigned int level = 0; level < header.numLevels; ++level)
+  {
+    header.numTiles += tilesPerSide(std::max(1u, header.width >> level)) * tilesPerSide(std::max(1u, header.height >> level));
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(VirtualTextureHeader));
+
+  std::vector<unsigned char> tile(tileBytes);
+
+  for (unsigned int level = 0; level < header.numLevels; ++level)
+  {
+    const int lw = int(std::max(1u, header.width  >> level));
+    const int lh = int(std::max(1u, header.height >> level));
+
+    std::vector<unsigned char> const& src = levels[level];
+
+    for (unsigned int ty = 0; ty < tilesPerSide(lh); ++ty)
+    {
+      for (unsigned int tx = 0; tx < tilesPerSide(lw); ++tx)
+      {
+        for (int y = 0; y < VT_SLOT_SIZE; ++y)
+        {
+          const int sy = ((int(ty * VT_TILE_SIZE) + y - VT_TILE_BORDER) % lh + lh) % lh; // Repeat wrap mode.
+          for (int x = 0; x < VT_SLOT_SIZE; ++x)
+          {
+            const int sx = ((int(tx * VT_TILE_SIZE) + x - VT_TILE_BORDER) % lw + lw) % lw;
+            memcpy(&tile[(y * VT_SLOT_SIZE + x) * 4], &src[(sy * lw + sx) * 4], 4);
+          }
+        }
+        file.write(reinterpret_cast<const char*>(tile.data()), tileBytes);
+      }
+    }
+  }
+
+  return bool(file);
+}
+
+#endif // USE_VIRTUAL_TEXTURES
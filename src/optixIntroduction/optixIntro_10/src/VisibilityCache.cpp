@@ -0,0 +1,91 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_VISIBILITY_CACHE
+
+// Shadow ray visibility of the primary hits, cached per pixel across the iterations of one accumulation.
+//
+// The camera rays of a pixel only jitter inside its footprint, so its diffuse primary hits see the lights from nearly the same
+// places every iteration. The closest hit program counts the visible and the traced shadow rays of these hits and the ray
+// generation program keeps the counts per pixel. Once a pixel traced VISIBILITY_CACHE_WARMUP shadow rays which were all visible
+// or all occluded, its later hits skip them. The counts are tagged with an epoch which restartAccumulation() increments,
+// so any change of the camera or the scene falls back to tracing every shadow ray without touching the buffer.
+
+void Application::initVisibilityCache()
+{
+  // Only the device side reads and writes this. With several devices each keeps the counts of the pixels it renders.
+  m_bufferVisibilityCounts = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT2, m_width, m_height);
+
+  m_context["sysVisibilityCounts"]->setBuffer(m_bufferVisibilityCounts);
+  m_context["sysVisibilityCache"]->setInt(0);
+  m_context["sysVisibilityEpoch"]->setUint(m_visibilityEpoch);
+
+#if USE_PREVIEW_RESOLUTION
+  // The preview resolution doesn't match the counts.
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("raygeneration_preview");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  it->second["sysVisibilityCache"]->setInt(0);
+#endif
+}
+
+void Application::setVisibilityCache(const bool enable)
+{
+  m_visibilityCache = enable;
+}
+
+// The counts are indexed by the pixel of the single camera. The reservoirs of ReSTIR already decide the primary shadow rays.
+bool Application::isVisibilityCacheSupported() const
+{
+  bool supported = m_visibilityCache;
+#if USE_WAVEFRONT
+  supported = supported && !m_wavefront;
+#endif
+#if USE_MULTI_VIEW
+  supported = supported && !isMultiViewSupported(); // The views share the pixel coordinates.
+#endif
+#if USE_WEDGE
+  supported = supported && !isWedgeSupported(); // The variants share the pixel coordinates.
+#endif
+#if USE_RESTIR
+  supported = supported && !isRestirSupported();
+#endif
+  return supported;
+}
+
+// Called by render() before the launches of an iteration.
+void Application::updateVisibilityCache()
+{
+  m_context["sysVisibilityCache"]->setInt((isVisibilityCacheSupported()) ? 1 : 0);
+  m_context["sysVisibilityEpoch"]->setUint(m_visibilityEpoch);
+}
+
+#endif // USE_VISIBILITY_CACHE
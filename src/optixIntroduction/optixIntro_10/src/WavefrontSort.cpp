@@ -0,0 +1,101 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_WAVEFRONT && USE_WAVEFRONT_SORT
+
+#include <cstring>
+
+#include "inc/MyAssert.h"
+
+#include "shaders/wavefront_path.h"
+
+// Coherent path order between the wavefront extend launches.
+//
+// After the compaction the surviving paths are in the order their threads finished, which scatters rays with unrelated
+// origins and directions and paths leaving different materials over each warp. With sorting enabled each extend launch
+// also writes a key per queued path and counts the paths per key in m_bufferWavefrontBins, see wavefrontSortKey().
+// The host reads the counts back together with the queue length, turns them into the first slot of each key, and
+// the sort launch scatters the paths key by key into the queue half the extend launch just consumed.
+// Every path still owns its pixel and its random numbers, so the image is the same with and without sorting.
+
+void Application::initWavefrontSort()
+{
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("wavefront_sort");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_WAVEFRONT_SORT, it->second);
+
+  m_bufferWavefrontKeys = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, m_width * m_height);
+  m_context["sysWavefrontKeys"]->setBuffer(m_bufferWavefrontKeys);
+
+  // Read back and written by the host between the extend and sort launches, like m_bufferWavefrontCounter.
+  m_bufferWavefrontBins = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 2 * WAVEFRONT_SORT_BINS);
+  unsigned int* bins = static_cast<unsigned int*>(m_bufferWavefrontBins->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  memset(bins, 0, 2 * WAVEFRONT_SORT_BINS * sizeof(unsigned int));
+  m_bufferWavefrontBins->unmap();
+  m_context["sysWavefrontBins"]->setBuffer(m_bufferWavefrontBins);
+
+  m_context["sysWavefrontSort"]->setInt(0);
+  m_context["sysWavefrontSortCell"]->setFloat(m_wavefrontSortCell);
+}
+
+void Application::setWavefrontSort(const float cellSize)
+{
+  m_wavefrontSort = (0.0f < cellSize);
+  if (m_wavefrontSort)
+  {
+    m_wavefrontSortCell = cellSize;
+  }
+
+  m_context["sysWavefrontSort"]->setInt((m_wavefrontSort) ? 1 : 0);
+  m_context["sysWavefrontSortCell"]->setFloat(m_wavefrontSortCell);
+}
+
+// Called by renderWavefront() after an extend launch which queued count paths. Leaves them sorted in the input queue half.
+void Application::sortWavefront(const unsigned int count)
+{
+  unsigned int* bins = static_cast<unsigned int*>(m_bufferWavefrontBins->map(0, RT_BUFFER_MAP_READ_WRITE));
+
+  // Exclusive prefix sum of the counts into the scatter offsets. The counts restart at zero for the next extend launch.
+  unsigned int offset = 0;
+  for (int key = 0; key < WAVEFRONT_SORT_BINS; ++key)
+  {
+    bins[WAVEFRONT_SORT_BINS + key] = offset;
+    offset += bins[key];
+    bins[key] = 0;
+  }
+  MY_ASSERT(offset == count);
+
+  m_bufferWavefrontBins->unmap();
+
+  m_context->launch(ENTRY_WAVEFRONT_SORT, count);
+}
+
+#endif // USE_WAVEFRONT && USE_WAVEFRONT_SORT
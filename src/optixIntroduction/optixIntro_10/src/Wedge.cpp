@@ -0,0 +1,315 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "shaders/app_config.h"
+
+#include "inc/Application.h"
+
+#if USE_WEDGE
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Wedge rendering: material parameter sweeps which share one scene.
+//
+// ENTRY_RENDER_WEDGE is a 3D launch over (width, height, number of variants). The variants are concatenated copies of
+// all materials inside m_bufferWedgeMaterials, and sysMaterialParameters points to it while the wedge is active.
+// The closest hit and any hit programs offset parMaterialIndex by the launch index z times sysMaterialStride, see wedge.h.
+// One node graph, one BVH and one launch per iteration serve all variants, and all variants of a pixel use the same
+// random numbers, which makes side by side comparisons free of noise differences.
+//
+// Each variant accumulates into its slice of sysWedgeBuffer. After every iteration ENTRY_WEDGE_SELECT copies the displayed
+// variant into sysOutputBuffer, so the display, the denoiser and the screenshots work unchanged.
+// screenshot() writes one image per variant.
+//
+// Wedge file format. One statement per line, '#' starts a comment:
+//
+// variant
+//   Starts the next variant. All following overrides belong to it. A variant without overrides renders the GUI materials.
+// albedo <material> <r> <g> <b>
+// absorption <material> <r> <g> <b>
+// ior <material> <value>
+// volumescale <material> <value>
+//   Replaces the GUI material parameter with index <material> in the current variant.
+
+void Application::initWedge()
+{
+  std::map<std::string, optix::Program>::const_iterator it = m_mapOfPrograms.find("raygeneration_wedge");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_RENDER_WEDGE, it->second);
+
+  it = m_mapOfPrograms.find("wedge_select");
+  MY_ASSERT(it != m_mapOfPrograms.end()); 
+  m_context->setRayGenerationProgram(ENTRY_WEDGE_SELECT, it->second);
+
+  m_bufferWedgeMaterials = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+  m_bufferWedgeMaterials->setElementSize(sizeof(MaterialParameter));
+  m_bufferWedgeMaterials->setSize(1);
+
+  m_bufferWedge = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, 1, 1, 1);
+  m_context["sysWedgeBuffer"]->setBuffer(m_bufferWedge);
+
+  m_context["sysMaterialStride"]->setInt(0);
+  m_context["sysWedgeVariant"]->setInt(0);
+}
+
+bool Application::setWedge(std::string const& filename)
+{
+  std::ifstream input(filename.c_str());
+  if (!input)
+  {
+    std::cerr << "ERROR: setWedge() cannot open " << filename << std::endl;
+    return false;
+  }
+
+  std::vector< std::vector<WedgeOverride> > variants;
+
+  unsigned int lineNumber = 0;
+  std::string  line;
+
+  while (std::getline(input, line))
+  {
+    ++lineNumber;
+
+    const std::string::size_type comment = line.find('#');
+    if (comment != std::string::npos)
+    {
+      line.erase(comment);
+    }
+
+    std::istringstream tokens(line);
+    std::string keyword;
+    if (!(tokens >> keyword))
+    {
+      continue; // Empty line.
+    }
+
+    if (keyword == "variant")
+    {
+      if (WEDGE_MAX_VARIANTS <= variants.size())
+      {
+        std::cerr << "ERROR: setWedge() " << filename << "(" << lineNumber << "): more than " << WEDGE_MAX_VARIANTS << " variants" << std::endl;
+        return false;
+      }
+      variants.push_back(std::vector<WedgeOverride>());
+      continue;
+    }
+
+    WedgeOverride entry;
+
+    entry.value = optix::make_float3(0.0f);
+
+    bool valid = true;
+    if (keyword == "albedo" || keyword == "absorption")
+    {
+      entry.parameter = (keyword == "albedo") ? WEDGE_PARAMETER_ALBEDO : WEDGE_PARAMETER_ABSORPTION;
+      valid = !!(tokens >> entry.material >> entry.value.x >> entry.value.y >> entry.value.z);
+    }
+    else if (keyword == "ior" || keyword == "volumescale")
+    {
+      entry.parameter = (keyword == "ior") ? WEDGE_PARAMETER_IOR : WEDGE_PARAMETER_VOLUME_SCALE;
+      valid = !!(tokens >> entry.material >> entry.value.x);
+    }
+    else
+    {
+      std::cerr << "WARNING: setWedge() " << filename << "(" << lineNumber << "): unknown keyword " << keyword << " ignored" << std::endl;
+      continue;
+    }
+
+    if (!valid || entry.material < 0)
+    {
+      std::cerr << "ERROR: setWedge() " << filename << "(" << lineNumber << "): " << keyword << " <material> <values> expected" << std::endl;
+      return false;
+    }
+    if (variants.empty())
+    {
+      std::cerr << "ERROR: setWedge() " << filename << "(" << lineNumber << "): " << keyword << " before the first variant" << std::endl;
+      return false;
+    }
+    variants.back().push_back(entry);
+  }
+
+  std::cout << "setWedge(" << filename << "): Variants = " << variants.size() << std::endl;
+
+  m_wedgeFilename = filename;
+  m_wedgeVariants.swap(variants);
+  m_wedgeDisplay  = 0;
+  m_wedgeDirty    = true;
+  return true;
+}
+
+// The GPU local accumulation buffers are only bound to the ENTRY_RENDER program, and the views use the launch index z themselves.
+bool Application::isWedgeSupported() const
+{
+  bool supported = (1 < m_wedgeVariants.size() && !m_localAccumulation);
+#if USE_MULTI_VIEW
+  supported = supported && m_multiView == MULTI_VIEW_OFF;
+#endif
+  return supported;
+}
+
+// Called once per render() before the launches. Uploads the variants after material or wedge file changes and switches
+// sysMaterialParameters between the GUI materials and the variants. Returns true when the accumulation must restart.
+bool Application::updateWedge()
+{
+  const bool active  = isWedgeSupported();
+  bool       restart = (active != m_wedgeActive);
+
+  const size_t count = m_guiMaterialParameters.size();
+
+  if (active && (m_wedgeDirty || restart))
+  {
+    const size_t variants = m_wedgeVariants.size();
+
+    m_bufferWedgeMaterials->setSize(count * variants);
+
+    MaterialParameter* dst = static_cast<MaterialParameter*>(m_bufferWedgeMaterials->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+
+    for (size_t v = 0; v < variants; ++v)
+    {
+      std::vector<MaterialParameterGUI> materials = m_guiMaterialParameters;
+
+      for (size_t i = 0; i < m_wedgeVariants[v].size(); ++i)
+      {
+        WedgeOverride const& entry = m_wedgeVariants[v][i];
+        if (count <= size_t(entry.material))
+        {
+          continue; // The scene has fewer materials than the wedge file expected.
+        }
+
+        MaterialParameterGUI& material = materials[entry.material];
+        switch (entry.parameter)
+        {
+          case WEDGE_PARAMETER_ALBEDO:
+            material.albedo = entry.value;
+            break;
+          case WEDGE_PARAMETER_ABSORPTION:
+            material.absorptionColor = entry.value;
+            break;
+          case WEDGE_PARAMETER_IOR:
+            material.ior = entry.value.x;
+            break;
+          case WEDGE_PARAMETER_VOLUME_SCALE:
+            material.volumeDistanceScale = entry.value.x;
+            break;
+        }
+      }
+
+      for (size_t i = 0; i < count; ++i)
+      {
+        convertMaterialParameter(materials[i], dst[v * count + i]);
+      }
+    }
+
+    m_bufferWedgeMaterials->unmap();
+
+    m_wedgeDirty = false;
+    restart      = true;
+  }
+
+  if (active)
+  {
+    RTsize width;
+    RTsize height;
+    RTsize depth;
+
+    m_bufferWedge->getSize(width, height, depth);
+    if (width != RTsize(m_width) || height != RTsize(m_height) || depth != m_wedgeVariants.size())
+    {
+      m_bufferWedge->setSize(m_width, m_height, m_wedgeVariants.size());
+      restart = true;
+    }
+    m_wedgeDisplay = std::min(m_wedgeDisplay, int(m_wedgeVariants.size()) - 1);
+  }
+
+  if (restart)
+  {
+    m_context["sysMaterialParameters"]->setBuffer((active) ? m_bufferWedgeMaterials : m_bufferMaterialParameters);
+    m_context["sysMaterialStride"]->setInt((active) ? int(count) : 0);
+    m_context["sysWedgeVariant"]->setInt(m_wedgeDisplay);
+  }
+
+  m_wedgeActive = active;
+  return restart;
+}
+
+void Application::renderWedge()
+{
+  m_context->launch(ENTRY_RENDER_WEDGE, m_width, m_height, m_wedgeVariants.size());
+}
+
+// Shows a different variant without restarting the accumulation, all of them converge together.
+void Application::selectWedgeVariant(const int variant)
+{
+  m_wedgeDisplay = std::max(0, std::min(int(m_wedgeVariants.size()) - 1, variant));
+  m_context["sysWedgeVariant"]->setInt(m_wedgeDisplay);
+  if (m_wedgeActive && 0 < m_iterationIndex)
+  {
+    m_context->launch(ENTRY_WEDGE_SELECT, m_width, m_height);
+  }
+}
+
+// Writes <name>_v<variant>.<extension> per variant and restores the displayed one.
+bool Application::writeWedgeImages(std::string const& filename)
+{
+  if (!m_wedgeActive)
+  {
+    return false;
+  }
+
+  std::string name      = filename;
+  std::string extension;
+
+  const std::string::size_type dot   = filename.find_last_of('.');
+  const std::string::size_type slash = filename.find_last_of("/\\");
+  if (dot != std::string::npos && (slash == std::string::npos || slash < dot))
+  {
+    name      = filename.substr(0, dot);
+    extension = filename.substr(dot);
+  }
+
+  const int display = m_wedgeDisplay;
+
+  for (int v = 0; v < int(m_wedgeVariants.size()); ++v)
+  {
+    char suffix[16];
+    sprintf(suffix, "_v%02d", v);
+
+    selectWedgeVariant(v);
+    writeImage(name + std::string(suffix) + extension);
+  }
+
+  selectWedgeVariant(display);
+  return true;
+}
+
+#endif // USE_WEDGE
@@ -60,10 +60,13 @@
 
 #include <IL/il.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 static Application* g_app = nullptr;
 
@@ -84,11 +87,132 @@ void printUsage(const std::string& argv0)
     "  -h | --height <int>    Window client height (512).\n"
     "  -d | --devices <int>   OptiX device selection, each decimal digit selects one device (3210).\n"
     "  -n | --nopbo           Disable OpenGL interop for the image display.\n"
+    "  -S | --sampler <0|1>   Select the sampler (0 = LCG, 1 = Sobol).\n"
+#if USE_FILTER_IMPORTANCE_SAMPLING
+    "       --filter <box|tent|gaussian|blackmanharris>[,radius] Importance sample this pixel filter with the primary rays (box).\n"
+#endif
+    "  -H | --half            Transfer the displayed image as RGBA16F when not using OpenGL interop.\n"
+#if USE_DEVICE_TONEMAP
+    "  -O | --tonemap         Tonemap on the device, transfer the displayed image as RGBA8 when not using OpenGL interop, tonemap LDR screenshots.\n"
+#endif
+#if USE_RADIANCE_CACHE
+    "  -Y | --cache <int>     Terminate the paths into a world space radiance cache after this many diffuse bounces (0 = off).\n"
+    "  -Z | --cachecell <float> Edge length of the radiance cache voxels in scene units (0.1).\n"
+#endif
+#if USE_DYNAMIC_SCENE
+    "  -N | --animate         Spin the box and wave the sphere of the demo scene each frame (interactive mode only).\n"
+    "  -X | --refit <float>   Refit deformed meshes unless a vertex moved further than this fraction of their size since the last rebuild (0.1).\n"
+#endif
+#if USE_MULTI_VIEW
+    "  -V | --views <int>     Render multiple views in one launch: 0 = single view, 1 = stereo side by side, 2 = 3x2 cubemap.\n"
+    "  -v | --separation <float> Distance between the stereo eyes in scene units (0.065).\n"
+#endif
+#if USE_WEDGE
+    "  -k | --wedge <filename> Render all material variants of the wedge file in one launch. Screenshots write one image per variant.\n"
+#endif
+#if USE_AOVS
+    "  -a | --aov <name,...>  Also render these AOVs and save them as <image>_<name>.exr: depth, position, normal, material, direct, indirect, lights.\n"
+#endif
+#if USE_RESTIR
+    "  -E | --restir          Resample the direct lighting of the primary hits with reservoirs reused across pixels and iterations (pinhole camera, single device).\n"
+#endif
+#if USE_VISIBILITY_CACHE
+    "       --visibilitycache Skip the primary hit shadow rays of pixels which were fully lit or fully shadowed so far.\n"
+#endif
+#if USE_SPECTRAL
+    "  -z | --spectral        Trace a hero wavelength per path to disperse the light in materials with an Abbe number.\n"
+#endif
+#if USE_RASTER_PRIMARY
+    "  -G | --raster          Rasterize the primary visibility with OpenGL to shorten the primary rays (pinhole camera, OpenGL interop, static scenes).\n"
+#endif
     "  -l | --light           Add an area light to the scene.\n"
     "  -m | --miss  <0|1|2>   Select the miss shader (0 = black, 1 = white, 2 = HDR texture.\n"
     "  -e | --env <filename>  Filename of a spherical HDR texture. Use with --miss 2.\n"
+    "  -g | --triangles       Use the built-in GeometryTriangles (hardware triangle intersection, needs OptiX 6.0.0 or newer).\n"
+    "  -F | --flatten         Bake all static transforms into the vertex data and put these objects under one acceleration.\n"
+    "  -c | --scene <filename> Load OBJ/PLY mesh instances from this scene description instead of the demo objects.\n"
+    "  -A | --accelcache <directory> Restore the bottom level Accelerations from this existing directory, write the ones built.\n"
+#if USE_GEOMETRY_PAGING
+    "  -y | --geometrybudget <MiB> Keep the --scene meshes on the host and page the recently hit ones onto the device (0 = all resident).\n"
+#endif
+#if USE_CHUNKED_BUILD
+    "  -o | --buildbudget <MiB> Split --scene meshes whose estimated Acceleration build memory exceeds this into chunks (0 = off).\n"
+#endif
+#if USE_STRESS_SCENE
+    "       --stress <instances,lights,materials,textures,seed> Generate a scaling benchmark scene instead of --scene or the demo.\n"
+#endif
+#if USE_MESH_LOD
+    "       --lod <pixels>    Switch --scene instances to coarser mesh levels whose detail projects below this (0 = off).\n"
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+    "       --medium <material,density,albedo,anisotropy[,file.vol]> Fill the volume of this material with smoke or a Mitsuba grid (repeatable).\n"
+#endif
+    "  -K | --kernelcache <directory> Location of the OptiX disk cache for compiled kernels (needs OptiX 6.0.0 or newer).\n"
+    "  -M | --kernelcachesize <int> Size limit of the OptiX disk cache in MiB (0 = OptiX default).\n"
+#if USE_RUNTIME_COMPILATION
+    "  -D | --define <NAME=VALUE>   Compile the shaders with NVRTC using this app_config.h switch value (repeatable).\n"
+#endif
+#if USE_STACK_CALIBRATION
+    "  -s | --stack <int>     Set the OptiX stack size (0 = the calibrated size of this configuration, or 1024).\n"
+    "  -Q | --calibratestack  Find the smallest stack size without overflows for this configuration, store and use it.\n"
+#else
     "  -s | --stack <int>     Set the OptiX stack size (1024) (debug feature).\n"
+#endif
     "  -f | --file <filename> Save image to file and exit.\n"
+    "  -B | --benchmark <int> Render this many iterations at each of 8 fixed camera positions, print the timings and exit.\n"
+#if USE_DEVICE_SCALING
+    "       --devicescaling <int> Render this many iterations on each -d device alone and on 1..N of them, print the scaling and exit.\n"
+#endif
+    "  -b | --batch <filename> Render headless without window and OpenGL, save the image to file and exit.\n"
+    "  -i | --spp <int>       Samples per pixel for --batch (64 when no --seconds set, 0 = unlimited).\n"
+    "  -x | --seconds <float> Time budget in seconds for --batch (0 = unlimited).\n"
+#if USE_LIGHT_BAKE
+    "       --bake <index,...> Bake the irradiance of these root children into the --width x --height --batch lightmap.\n"
+    "       --bakeunwrap      Place each --bake triangle into its own lightmap cell instead of using the texture coordinates.\n"
+#endif
+#if USE_POSTER_TILES
+    "       --poster <int>    Render the --width x --height --batch image in tiles of this size streamed into a .pfm file (0 = off).\n"
+#endif
+#if USE_RENDER_SERVER
+    "  -L | --listen <port>   Render headless as server, controlled by one TCP client, which receives the frames as PNG.\n"
+#if USE_TILED_LAUNCH
+    "  -W | --workers <host:port,...> Render the --batch image in tiles on these --listen servers, which load the same scene.\n"
+#endif
+#endif
+#if USE_RENDER_THREAD
+    "  -u | --renderthread    Launch OptiX continuously on a separate render thread, decoupled from the GUI (implies --nopbo).\n"
+#endif
+#if USE_CHECKPOINTS
+    "  -C | --checkpoint <filename> Store the --batch accumulation in this file periodically and at the end.\n"
+    "  -I | --interval <float> Seconds between the --checkpoint writes (600, 0 = only at the end).\n"
+    "  -r | --resume          Continue the --batch accumulation from the --checkpoint file when it matches the settings.\n"
+#endif
+#if USE_DENOISER && USE_DENOISER_TILES
+    "  -J | --denoisetile <int> Denoise frames larger than this many pixels in tiles of that size with blended overlaps (0 = full frame).\n"
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+    "  -T | --stable <float>  Stop accumulating when the denoised image changes less than this per tile (0 = off).\n"
+#endif
+    "  -P | --profile <filename> Write per frame stage timings on exit. CSV, or JSON when the filename ends with .json.\n"
+    "  -R | --memory <filename> Write the device memory use per category and OptiX object after startup and on exit.\n"
+    "  -U | --usage <filename> Log the OptiX usage reports with per launch statistics. CSV, or JSON when the filename ends with .json.\n"
+    "  -p | --wavefront       Use the wavefront path tracer with one launch per path segment (single device only).\n"
+#if USE_MORTON_LAUNCH
+    "       --morton          Launch the megakernel over the pixels in Morton order per tile for coherent warps.\n"
+#endif
+#if USE_DENOISER && USE_DENOISER_DEVICE
+    "       --denoisedevice <int> Denoise asynchronously on this device ordinal while the -d devices render (-1 = off).\n"
+#endif
+#if USE_PERSISTENT_THREADS
+    "       --persistent <int> Render the megakernel with this many persistent threads per multiprocessor pulling pixels (0 = off, single device).\n"
+#endif
+#if USE_WAVEFRONT && USE_WAVEFRONT_SORT
+    "  -q | --sortpaths <float> Sort the wavefront paths between segments by material, origin cells of this size and direction (0 = off).\n"
+#endif
+    "  -t | --tile <int>      Split each iteration into tile launches of this size under a frame time budget (0 = off).\n"
+#if USE_SAMPLES_PER_LAUNCH
+    "  -j | --launchsamples <int> Samples per pixel rendered by each megakernel launch (1).\n"
+#endif
   "App Keystrokes:\n"
   "  SPACE  Toggles ImGui display.\n"
   "\n"
@@ -102,13 +226,82 @@ int main(int argc, char *argv[])
   int  windowHeight = 512;
   int  devices      = 3210;  // Decimal digits encode OptiX device ordinals. Default 3210 means to use all four first installed devices, when available.
   bool interop      = true;  // Use OpenGL interop Pixel-Bufferobject to display the resulting image. Disable this when running on multi-GPU or TCC driver mode.
+#if USE_STACK_CALIBRATION
+  int  stackSize    = 0;     // 0 == the stored --calibratestack result of this configuration, 1024 before the first calibration.
+  bool calibrateStack = false;
+#else
   int  stackSize    = 1024;  // Command line parameter just to be able to find the smallest working size.
+#endif
   bool light        = false; // Add a geometric are light. Best used with miss 0 and 1.
   int  miss         = 2;     // Select the environment light (0 = black, no light; 1 = constant white environment; 3 = spherical environment texture.
   std::string environment = std::string(sutil::samplesDir()) + "/data/NV_Default_HDR_3000x1500.hdr";
+  bool wavefront    = false; // Use the megakernel integrator by default.
+  float sortCell    = 0.0f;  // Wavefront paths stay in compaction order by default.
+  int  persistent   = 0;     // One megakernel thread per pixel by default.
+  bool morton       = false; // The megakernel launch index is the pixel by default.
+  int  denoiseDevice = -1;   // The denoiser runs in the render context by default.
+  int  tileSize     = 0;     // One launch over the full resolution per iteration by default.
+  int  posterTile   = 0;     // The --batch image is rendered in one piece by default.
+  std::vector<unsigned int> bakeRoots; // Not empty == --batch bakes a lightmap of these root children.
+  bool bakeUnwrap   = false; // The lightmaps use the texture coordinates by default.
+  int  launchSamples = 1;    // One sample per pixel per launch by default.
+  int  sampler      = 0;     // The LCG sampler by default.
+  std::string pixelFilter;   // Empty == box filter.
+  bool halfDisplay  = false; // Upload the RGBA32F image directly by default.
+  bool tonemap      = false; // The GLSL display shader tonemaps by default.
+  bool raster       = false; // Trace the primary rays from the camera by default.
+  bool restir       = false; // Independent light samples per diffuse hit by default.
+#if USE_VISIBILITY_CACHE
+  bool visibilityCache = false;
+#endif
+  bool spectral     = false; // RGB only by default.
+  int   cacheBounces  = 0;     // No radiance cache by default.
+  float cacheCellSize = 0.1f;  // Meters.
+  int   multiView     = 0;     // Single view by default.
+  bool  animate       = false; // Static scene by default.
+  float refit         = 0.1f;  // Fraction of the mesh bounding box diagonal.
+  float separation    = 0.065f; // Meters.
+  std::string wedge;           // Empty == render the GUI materials only.
+  std::vector<std::string> media; // Empty == only homogeneous absorption inside the volumes.
+  std::string aovs;            // Empty == only the beauty image.
+  std::string scene;         // Empty == the hard-coded demo scene.
+  bool triangles    = false; // Custom triangle intersection programs by default.
+  bool flatten      = false; // Keep the two level scene hierarchy with one Transform per object by default.
+  std::string accelerationCache; // Empty == build all Accelerations on every start.
+  float geometryBudget = 0.0f;   // MiB. 0 == all scene meshes stay on the device.
+  float buildBudget    = 0.0f;   // MiB. 0 == one Acceleration per scene mesh.
+  float lodError       = 0.0f;   // Pixels. 0 == the scene meshes are always traversed at full resolution.
+  std::string stress;            // Empty == no generated scene.
+  std::vector<std::string> shaderDefines; // Empty == use the PTX files built with the app_config.h values.
+  std::string kernelCache;       // Empty == OptiX default disk cache location.
+  int  kernelCacheSize = 0;      // MiB. 0 == OptiX default disk cache limits.
 
   std::string filenameScreenshot;
   bool hasGUI = true;
+
+  int benchmarkIterations = 0; // 0 == interactive.
+#if USE_DEVICE_SCALING
+  int deviceScalingIterations = 0; // 0 == no scaling study.
+#endif
+
+  std::string filenameProfile; // Not empty == record the per frame stage timings.
+  std::string filenameMemory;  // Not empty == write the device memory report.
+  std::string filenameUsage;   // Not empty == log the OptiX usage reports.
+
+  std::string filenameBatch; // Not empty == headless offline rendering.
+  int    batchSpp     = -1;   // -1 == not set on the command line.
+  double batchSeconds = 0.0;
+
+  int serverPort = 0; // Not 0 == headless render server mode.
+  bool renderThread = false; // Render on the GUI thread by default.
+  std::vector<std::string> workers; // Not empty == distribute the --batch tiles to these render servers.
+
+  std::string filenameCheckpoint;         // Not empty == --batch writes checkpoints.
+  double      checkpointInterval = 600.0; // Seconds.
+  bool        resume             = false;
+
+  float stableThreshold = 0.0f; // 0.0f == accumulate until the samples per pixel or the time budget are reached.
+  int   denoiseTileSize = 0;    // 0 == denoise the full frame at once.
   
   // Parse the command line parameters.
   for (int i = 1; i < argc; ++i)
@@ -160,6 +353,12 @@ int main(int argc, char *argv[])
       }
       stackSize = atoi(argv[++i]);
     }
+#if USE_STACK_CALIBRATION
+    else if (arg == "-Q" || arg == "--calibratestack")
+    {
+      calibrateStack = true;
+    }
+#endif
     else if (arg == "-n" || arg == "--nopbo")
     {
       interop = false;
@@ -182,6 +381,334 @@ int main(int argc, char *argv[])
     {
       light = true;
     }
+    else if (arg == "-p" || arg == "--wavefront")
+    {
+      wavefront = true;
+    }
+#if USE_MORTON_LAUNCH
+    else if (arg == "--morton")
+    {
+      morton = true;
+    }
+#endif
+#if USE_DENOISER && USE_DENOISER_DEVICE
+    else if (arg == "--denoisedevice")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      denoiseDevice = atoi(argv[++i]);
+    }
+#endif
+#if USE_PERSISTENT_THREADS
+    else if (arg == "--persistent")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      persistent = atoi(argv[++i]);
+    }
+#endif
+#if USE_WAVEFRONT && USE_WAVEFRONT_SORT
+    else if (arg == "-q" || arg == "--sortpaths")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      sortCell = float(atof(argv[++i]));
+    }
+#endif
+    else if (arg == "-S" || arg == "--sampler")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      sampler = atoi(argv[++i]);
+    }
+#if USE_FILTER_IMPORTANCE_SAMPLING
+    else if (arg == "--filter")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      pixelFilter = argv[++i];
+    }
+#endif
+    else if (arg == "-g" || arg == "--triangles")
+    {
+      triangles = true;
+    }
+    else if (arg == "-F" || arg == "--flatten")
+    {
+      flatten = true;
+    }
+    else if (arg == "-c" || arg == "--scene")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      scene = std::string(argv[++i]);
+    }
+    else if (arg == "-A" || arg == "--accelcache")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      accelerationCache = std::string(argv[++i]);
+    }
+#if USE_GEOMETRY_PAGING
+    else if (arg == "-y" || arg == "--geometrybudget")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      geometryBudget = float(atof(argv[++i])); // Zero or negative disables the paging.
+    }
+#endif
+#if USE_CHUNKED_BUILD
+    else if (arg == "-o" || arg == "--buildbudget")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      buildBudget = float(atof(argv[++i])); // Zero or negative disables the chunking.
+    }
+#endif
+#if USE_MESH_LOD
+    else if (arg == "--lod")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      lodError = float(atof(argv[++i])); // Zero or negative keeps the full resolution meshes.
+    }
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+    else if (arg == "--medium")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      media.push_back(std::string(argv[++i]));
+    }
+#endif
+#if USE_STRESS_SCENE
+    else if (arg == "--stress")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      stress = std::string(argv[++i]);
+    }
+#endif
+    else if (arg == "-K" || arg == "--kernelcache")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      kernelCache = std::string(argv[++i]);
+    }
+    else if (arg == "-M" || arg == "--kernelcachesize")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      kernelCacheSize = atoi(argv[++i]);
+    }
+#if USE_RUNTIME_COMPILATION
+    else if (arg == "-D" || arg == "--define")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      shaderDefines.push_back(std::string(argv[++i]));
+    }
+#endif
+    else if (arg == "-H" || arg == "--half")
+    {
+      halfDisplay = true;
+    }
+#if USE_DEVICE_TONEMAP
+    else if (arg == "-O" || arg == "--tonemap")
+    {
+      tonemap = true;
+    }
+#endif
+#if USE_RESTIR
+    else if (arg == "-E" || arg == "--restir")
+    {
+      restir = true;
+    }
+#endif
+#if USE_VISIBILITY_CACHE
+    else if (arg == "--visibilitycache")
+    {
+      visibilityCache = true;
+    }
+#endif
+#if USE_SPECTRAL
+    else if (arg == "-z" || arg == "--spectral")
+    {
+      spectral = true;
+    }
+#endif
+#if USE_RASTER_PRIMARY
+    else if (arg == "-G" || arg == "--raster")
+    {
+      raster = true;
+    }
+#endif
+#if USE_RADIANCE_CACHE
+    else if (arg == "-Y" || arg == "--cache")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      cacheBounces = atoi(argv[++i]);
+    }
+    else if (arg == "-Z" || arg == "--cachecell")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      cacheCellSize = float(atof(argv[++i]));
+    }
+#endif
+#if USE_DYNAMIC_SCENE
+    else if (arg == "-N" || arg == "--animate")
+    {
+      animate = true;
+    }
+    else if (arg == "-X" || arg == "--refit")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      refit = float(atof(argv[++i]));
+    }
+#endif
+#if USE_MULTI_VIEW
+    else if (arg == "-V" || arg == "--views")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      multiView = atoi(argv[++i]);
+    }
+    else if (arg == "-v" || arg == "--separation")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      separation = float(atof(argv[++i]));
+    }
+#endif
+#if USE_WEDGE
+    else if (arg == "-k" || arg == "--wedge")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      wedge = argv[++i];
+    }
+#endif
+#if USE_AOVS
+    else if (arg == "-a" || arg == "--aov")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      aovs = argv[++i];
+    }
+#endif
+    else if (arg == "-t" || arg == "--tile")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      tileSize = atoi(argv[++i]);
+    }
+#if USE_SAMPLES_PER_LAUNCH
+    else if (arg == "-j" || arg == "--launchsamples")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      launchSamples = atoi(argv[++i]);
+    }
+#endif
     else if (arg == "-e" || arg == "--env")
     {
       if (i == argc - 1)
@@ -203,6 +730,213 @@ int main(int argc, char *argv[])
       filenameScreenshot = argv[++i];
       hasGUI = false; // Do not render the GUI when just taking a screenshot. (Automated QA feature.)
     }
+    else if (arg == "-P" || arg == "--profile")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      filenameProfile = argv[++i];
+    }
+    else if (arg == "-R" || arg == "--memory")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      filenameMemory = argv[++i];
+    }
+    else if (arg == "-U" || arg == "--usage")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      filenameUsage = argv[++i];
+    }
+    else if (arg == "-b" || arg == "--batch")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      filenameBatch = argv[++i];
+    }
+    else if (arg == "-i" || arg == "--spp")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      batchSpp = atoi(argv[++i]);
+    }
+    else if (arg == "-x" || arg == "--seconds")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      batchSeconds = atof(argv[++i]);
+    }
+#if USE_LIGHT_BAKE
+    else if (arg == "--bake")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      std::istringstream list(argv[++i]);
+      std::string root;
+      while (std::getline(list, root, ','))
+      {
+        if (!root.empty())
+        {
+          bakeRoots.push_back(static_cast<unsigned int>(atoi(root.c_str())));
+        }
+      }
+    }
+    else if (arg == "--bakeunwrap")
+    {
+      bakeUnwrap = true;
+    }
+#endif
+#if USE_POSTER_TILES
+    else if (arg == "--poster")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      posterTile = atoi(argv[++i]);
+    }
+#endif
+#if USE_CHECKPOINTS
+    else if (arg == "-C" || arg == "--checkpoint")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      filenameCheckpoint = argv[++i];
+    }
+    else if (arg == "-I" || arg == "--interval")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      checkpointInterval = atof(argv[++i]);
+    }
+    else if (arg == "-r" || arg == "--resume")
+    {
+      resume = true;
+    }
+#endif
+#if USE_RENDER_SERVER
+    else if (arg == "-L" || arg == "--listen")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      serverPort = atoi(argv[++i]);
+    }
+#if USE_TILED_LAUNCH
+    else if (arg == "-W" || arg == "--workers")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      std::istringstream list(argv[++i]);
+      std::string worker;
+      while (std::getline(list, worker, ','))
+      {
+        if (!worker.empty())
+        {
+          workers.push_back(worker);
+        }
+      }
+    }
+#endif
+#endif
+#if USE_DENOISER && USE_DENOISER_TILES
+    else if (arg == "-J" || arg == "--denoisetile")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      denoiseTileSize = atoi(argv[++i]);
+    }
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+    else if (arg == "-T" || arg == "--stable")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      stableThreshold = float(atof(argv[++i]));
+    }
+#endif
+    else if (arg == "-B" || arg == "--benchmark")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      benchmarkIterations = atoi(argv[++i]);
+    }
+#if USE_DEVICE_SCALING
+    else if (arg == "--devicescaling")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      deviceScalingIterations = atoi(argv[++i]);
+    }
+#endif
+#if USE_RENDER_THREAD
+    else if (arg == "-u" || arg == "--renderthread")
+    {
+      renderThread = true;
+      interop      = false; // The render thread has no OpenGL context to map the interop buffers with.
+    }
+#endif
     else
     {
       std::cerr << "Unknown option '" << arg << "'\n";
@@ -211,6 +945,160 @@ int main(int argc, char *argv[])
     }
   }
 
+  if (!filenameBatch.empty() || serverPort != 0)
+  {
+    // Headless offline rendering or render server. No GLFW window and no OpenGL context.
+    if (batchSpp < 0)
+    {
+      batchSpp = (0.0 < batchSeconds) ? 0 : 64;
+    }
+    if (batchSpp == 0 && !workers.empty())
+    {
+      std::cerr << "WARNING: --workers needs a fixed number of samples per pixel, using 64." << std::endl;
+      batchSpp = 64;
+    }
+
+    ilInit(); // Still needed for the environment texture.
+
+    // Poster tiles: the buffers only hold one tile with its overlap, the --width x --height only exists in the file.
+    int launchWidth  = windowWidth;
+    int launchHeight = windowHeight;
+#if USE_POSTER_TILES
+    if (0 < posterTile && !filenameBatch.empty())
+    {
+      launchWidth  = std::min(windowWidth,  posterTile + 2 * POSTER_TILE_OVERLAP);
+      launchHeight = std::min(windowHeight, posterTile + 2 * POSTER_TILE_OVERLAP);
+    }
+#endif
+
+    g_app = new Application(nullptr, launchWidth, launchHeight,
+                            devices, stackSize, false, light, miss, environment, wavefront, tileSize, halfDisplay, sampler, scene, triangles, flatten, accelerationCache, geometryBudget, buildBudget, lodError, stress, shaderDefines, kernelCache, kernelCacheSize, filenameUsage);
+
+    int result = 0;
+    if (g_app->isValid())
+    {
+      g_app->setProfileFilename(filenameProfile);
+      g_app->setMemoryReportFilename(filenameMemory);
+#if USE_CHECKPOINTS
+      g_app->setCheckpoint(filenameCheckpoint, checkpointInterval, resume);
+#endif
+#if USE_DENOISER && USE_DENOISER_TILES
+      g_app->setDenoiserTileSize(denoiseTileSize);
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+      g_app->setStableThreshold(stableThreshold);
+#endif
+#if USE_DEVICE_TONEMAP
+      g_app->setDeviceTonemap(tonemap);
+#endif
+#if USE_RESTIR
+      g_app->setRestir(restir);
+#endif
+#if USE_VISIBILITY_CACHE
+      g_app->setVisibilityCache(visibilityCache);
+#endif
+#if USE_SPECTRAL
+      g_app->setSpectral(spectral);
+#endif
+#if USE_FILTER_IMPORTANCE_SAMPLING
+      if (!pixelFilter.empty())
+      {
+        g_app->setPixelFilter(pixelFilter);
+      }
+#endif
+#if USE_WAVEFRONT && USE_WAVEFRONT_SORT
+      g_app->setWavefrontSort(sortCell);
+#endif
+#if USE_PERSISTENT_THREADS
+      g_app->setPersistentThreads(persistent);
+#endif
+#if USE_MORTON_LAUNCH
+      g_app->setMortonLaunch(morton);
+#endif
+#if USE_DENOISER && USE_DENOISER_DEVICE
+      g_app->setDenoiserDevice(denoiseDevice);
+#endif
+#if USE_RADIANCE_CACHE
+      g_app->setRadianceCache(cacheBounces, cacheCellSize);
+#endif
+#if USE_MULTI_VIEW
+      g_app->setMultiView(multiView, separation);
+#endif
+#if USE_DYNAMIC_SCENE
+      g_app->setAnimation(animate, refit);
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+      if (!media.empty())
+      {
+        g_app->setMedia(media);
+      }
+#endif
+#if USE_WEDGE
+      if (!wedge.empty())
+      {
+        g_app->setWedge(wedge);
+      }
+#endif
+#if USE_AOVS
+      if (!aovs.empty())
+      {
+        g_app->setAovs(aovs);
+      }
+#endif
+#if USE_STACK_CALIBRATION
+      if (calibrateStack)
+      {
+        g_app->calibrateStackSize();
+      }
+#endif
+#if USE_SAMPLES_PER_LAUNCH
+      g_app->setSamplesPerLaunch(launchSamples);
+#endif
+#if USE_RENDER_SERVER
+      if (serverPort != 0)
+      {
+        g_app->serve(serverPort);
+      }
+      else
+#if USE_TILED_LAUNCH
+      if (!workers.empty())
+      {
+        g_app->renderDistributed(workers, batchSpp, filenameBatch);
+      }
+      else
+#endif
+#endif
+#if USE_LIGHT_BAKE
+      if (!bakeRoots.empty())
+      {
+        g_app->renderBake(bakeRoots, bakeUnwrap, batchSpp, batchSeconds, filenameBatch);
+      }
+      else
+#endif
+#if USE_POSTER_TILES
+      if (0 < posterTile)
+      {
+        g_app->renderPoster(windowWidth, windowHeight, batchSpp, batchSeconds, filenameBatch);
+      }
+      else
+#endif
+      {
+        g_app->renderBatch(batchSpp, batchSeconds, filenameBatch);
+      }
+    }
+    else
+    {
+      error_callback(4, "Application initialization failed.");
+      result = 4;
+    }
+
+    delete g_app;
+
+    ilShutDown();
+
+    return result;
+  }
+
   glfwSetErrorCallback(error_callback);
 
   if (!glfwInit())
@@ -239,7 +1127,7 @@ int main(int argc, char *argv[])
   ilInit(); // Initialize DevIL once.
 
   g_app = new Application(window, windowWidth, windowHeight,
-                          devices, stackSize, interop, light, miss, environment);
+                          devices, stackSize, interop, light, miss, environment, wavefront, tileSize, halfDisplay, sampler, scene, triangles, flatten, accelerationCache, geometryBudget, buildBudget, lodError, stress, shaderDefines, kernelCache, kernelCacheSize, filenameUsage);
 
   if (!g_app->isValid())
   {
@@ -249,6 +1137,106 @@ int main(int argc, char *argv[])
     return 4;
   }
 
+  g_app->setProfileFilename(filenameProfile);
+  g_app->setMemoryReportFilename(filenameMemory);
+#if USE_DENOISER && USE_DENOISER_TILES
+  g_app->setDenoiserTileSize(denoiseTileSize);
+#endif
+#if USE_DENOISER && USE_DENOISER_CONVERGENCE
+  g_app->setStableThreshold(stableThreshold);
+#endif
+#if USE_DEVICE_TONEMAP
+  g_app->setDeviceTonemap(tonemap);
+#endif
+#if USE_RASTER_PRIMARY
+  g_app->setRasterPrimary(raster);
+#endif
+#if USE_RESTIR
+  g_app->setRestir(restir);
+#endif
+#if USE_VISIBILITY_CACHE
+  g_app->setVisibilityCache(visibilityCache);
+#endif
+#if USE_SPECTRAL
+  g_app->setSpectral(spectral);
+#endif
+#if USE_FILTER_IMPORTANCE_SAMPLING
+  if (!pixelFilter.empty())
+  {
+    g_app->setPixelFilter(pixelFilter);
+  }
+#endif
+#if USE_WAVEFRONT && USE_WAVEFRONT_SORT
+  g_app->setWavefrontSort(sortCell);
+#endif
+#if USE_PERSISTENT_THREADS
+  g_app->setPersistentThreads(persistent);
+#endif
+#if USE_MORTON_LAUNCH
+  g_app->setMortonLaunch(morton);
+#endif
+#if USE_DENOISER && USE_DENOISER_DEVICE
+  g_app->setDenoiserDevice(denoiseDevice);
+#endif
+#if USE_RADIANCE_CACHE
+  g_app->setRadianceCache(cacheBounces, cacheCellSize);
+#endif
+#if USE_MULTI_VIEW
+  g_app->setMultiView(multiView, separation);
+#endif
+#if USE_DYNAMIC_SCENE
+  g_app->setAnimation(animate, refit);
+#endif
+#if USE_HETEROGENEOUS_MEDIA
+  if (!media.empty())
+  {
+    g_app->setMedia(media);
+  }
+#endif
+#if USE_WEDGE
+  if (!wedge.empty())
+  {
+    g_app->setWedge(wedge);
+  }
+#endif
+#if USE_AOVS
+  if (!aovs.empty())
+  {
+    g_app->setAovs(aovs);
+  }
+#endif
+#if USE_STACK_CALIBRATION
+  if (calibrateStack)
+  {
+    g_app->calibrateStackSize();
+  }
+#endif
+#if USE_SAMPLES_PER_LAUNCH
+  g_app->setSamplesPerLaunch(launchSamples);
+#endif
+
+  if (0 < benchmarkIterations)
+  {
+    g_app->benchmark("optixIntro_10", benchmarkIterations, 8);
+
+    glfwSetWindowShouldClose(window, 1); // Skip the main loop.
+  }
+#if USE_DEVICE_SCALING
+  if (0 < deviceScalingIterations)
+  {
+    g_app->deviceScaling("optixIntro_10", deviceScalingIterations);
+
+    glfwSetWindowShouldClose(window, 1); // Skip the main loop.
+  }
+#endif
+
+#if USE_RENDER_THREAD
+  if (renderThread && hasGUI && !glfwWindowShouldClose(window))
+  {
+    g_app->runRenderThread(); // Returns when the window was closed, which skips the main loop below.
+  }
+#endif
+
   // Main loop
   while (!glfwWindowShouldClose(window))
   {
@@ -277,6 +1265,8 @@ int main(int argc, char *argv[])
     }
     else
     {
+      g_app->finishTextures();
+
       for (int i = 0; i < 64; ++i) // Accumulate 64 samples per pixel.
       {
         g_app->render();  // OptiX rendering and OpenGL texture update.
@@ -0,0 +1,48 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include "inc/Picture.h"
+
+// Bytes per 4x4 block of the ImageBlockFormat. 0 for IMAGE_BLOCK_NONE.
+unsigned int getBlockSize(ImageBlockFormat block);
+
+// Encodes an 8-bit RGBA image into BC1 or BC3 blocks, row of blocks by row of blocks.
+// The texels at the right and top border are replicated when the extents are not multiples of four.
+// dst must hold ((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(block) bytes.
+void encodeBlocks(const unsigned char* rgba, unsigned int width, unsigned int height, ImageBlockFormat block, unsigned char* dst);
+
+// Mirrors the block-compressed image upside down in place.
+// BC6H blocks and heights above four which are not multiples of four are not supported and return false.
+bool flipBlocksY(unsigned char* blocks, unsigned int width, unsigned int height, ImageBlockFormat block);
+
+#endif // BLOCK_COMPRESSION_H
@@ -37,11 +37,23 @@
 #include <string>
 #include <vector>
 
+// Block-compressed image data as stored in DDS and KTX files or generated by Picture::compress().
+// Blocks are 4x4 texels, 8 bytes for BC1 and 16 bytes for the others.
+enum ImageBlockFormat
+{
+  IMAGE_BLOCK_NONE, // Uncompressed, m_format and m_type describe the texels.
+  IMAGE_BLOCK_BC1,  // RGB with 1-bit alpha.
+  IMAGE_BLOCK_BC3,  // RGBA.
+  IMAGE_BLOCK_BC5,  // Two channels, red and green.
+  IMAGE_BLOCK_BC6H  // Unsigned half float RGB.
+};
+
 struct Image
 {
   Image();
   Image(const Image& image);
   Image(unsigned int width, unsigned int height, unsigned int depth, int format, int type);
+  Image(unsigned int width, unsigned int height, ImageBlockFormat block); // Block-compressed 2D image.
   ~Image();
   
   unsigned int m_width;
@@ -51,9 +63,11 @@ struct Image
   int          m_format; // DevIL image format.
   int          m_type;   // DevIL image component type.
 
+  ImageBlockFormat m_block; // When not IMAGE_BLOCK_NONE, m_format and m_type only describe what the decoded texels look like.
+
   // Derived values.
-  unsigned int m_bpp; // bytes per pixel
-  unsigned int m_bpl; // bytes per scanline
+  unsigned int m_bpp; // bytes per pixel, 0 for block-compressed images
+  unsigned int m_bpl; // bytes per scanline, a row of 4x4 blocks for block-compressed images
   unsigned int m_bps; // bytes per slice (plane)
   unsigned int m_nob; // number of bytes (complete image)
 
@@ -67,7 +81,7 @@ public:
   Picture();
   ~Picture();
 
-  bool load(const std::string& filename);
+  bool load(const std::string& filename, bool keepBlocks = false); // keepBlocks: Only samples which upload block-compressed textures understand these images.
   void clear();
 
   unsigned int getNumberOfImages() const;
@@ -75,7 +89,15 @@ public:
   const Image* getImageFace(unsigned int indexImage, unsigned int indexFace) const;
   bool isCubemap() const;
 
+  // Copies the 8-bit unsigned 2D image expanded to RGBA8. Returns false for other data types and block-compressed images.
+  bool getRGBA8(unsigned int indexImage, unsigned int indexFace, std::vector<unsigned char>& rgba) const;
+
+  // Replaces all 8-bit unsigned 2D images with BC1 (opaque) or BC3 (with alpha) compressed data. Returns false when nothing could be compressed.
+  bool compress();
+
 private:
+  bool loadBlocks(const std::string& filename, bool isDDS); // Keeps the blocks of DDS and KTX files. False means fall back to DevIL.
+  bool loadRadiance(const std::string& filename);            // Radiance RGBE *.hdr through the sutil HDRLoader. False means fall back to DevIL.
   unsigned int addImage(unsigned int width, unsigned int height, unsigned int depth, int format, int type);
   bool copyMipmaps(unsigned int index, std::vector<const void*> const& mipmaps);
   void setImageData(unsigned int index, const void* pixels, std::vector<const void*> const& mipmaps);
@@ -0,0 +1,71 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef PICTURE_CACHE_H
+#define PICTURE_CACHE_H
+
+#include "inc/Picture.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+//! One image of PictureCache::acquireBatch() with the load options of PictureCache::acquire().
+struct PictureRequest
+{
+  PictureRequest(std::string const& filename, bool keepBlocks = false, bool compress = false);
+
+  std::string filename;
+  bool        keepBlocks;
+  bool        compress;
+};
+
+
+/*! \brief Process-wide cache of decoded Pictures keyed by the file path and the load options.
+  * Images requested by several scene objects, textures or OptiX contexts are only decoded once.
+  * Concurrent requests of the same image wait for the first one, different images load in parallel.
+  * The cache keeps its Pictures alive until clear() is called. */
+class PictureCache
+{
+public:
+  //! Returns the shared Picture of this file. compress encodes it with Picture::compress() after loading.
+  //! Failed loads return an empty Picture and are not cached, so a later request tries again.
+  static std::shared_ptr<const Picture> acquire(std::string const& filename, bool keepBlocks = false, bool compress = false);
+
+  //! Loads all requested images concurrently on up to threads worker threads (0 == one per hardware thread) and returns them
+  //! in request order. Each element is what acquire() returns, so duplicates and cached images are decoded only once.
+  static void acquireBatch(std::vector<PictureRequest> const& requests, std::vector< std::shared_ptr<const Picture> >& pictures, unsigned int threads = 0);
+
+  //! Drops the cache's references. Pictures still in use stay valid.
+  static void clear();
+};
+
+#endif // PICTURE_CACHE_H
@@ -53,6 +53,9 @@ public:
   void focus(int x, int y);
   void zoom(float x);
 
+  // Places the camera directly, e.g. from a remote client. The values are wrapped and clamped like the interactive changes.
+  void setOrbit(optix::float3 const& center, float distance, float phi, float theta, float fov);
+
   bool  getFrustum(optix::float3& pos, optix::float3& u, optix::float3& v, optix::float3& w);
   float getAspectRatio() const;
   
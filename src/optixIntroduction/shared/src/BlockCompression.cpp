@@ -0,0 +1,326 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/BlockCompression.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "inc/MyAssert.h"
+
+
+unsigned int getBlockSize(ImageBlockFormat block)
+{
+  switch (block)
+  {
+    case IMAGE_BLOCK_BC1:
+      return 8;
+    case IMAGE_BLOCK_BC3:
+    case IMAGE_BLOCK_BC5:
+    case IMAGE_BLOCK_BC6H:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+
+static unsigned int toRGB565(const int* c)
+{
+  return ((unsigned int)(c[0] * 31 + 127) / 255 << 11) | ((unsigned int)(c[1] * 63 + 127) / 255 << 5) | ((unsigned int)(c[2] * 31 + 127) / 255);
+}
+
+static void fromRGB565(unsigned int v, int* c)
+{
+  const int r = (v >> 11) & 31;
+  const int g = (v >>  5) & 63;
+  const int b =  v        & 31;
+  c[0] = (r << 3) | (r >> 2);
+  c[1] = (g << 2) | (g >> 4);
+  c[2] = (b << 3) | (b >> 2);
+}
+
+// Range fit: The endpoints are the inset corners of the RGB bounding box on the diagonal which follows the texel colors,
+// each texel picks the nearest of the four palette colors.
+static void encodeColorBlock(const unsigned char texels[16][4], unsigned char* dst)
+{
+  int lo[3]  = { 255, 255, 255 };
+  int hi[3]  = {   0,   0,   0 };
+  int sum[3] = {   0,   0,   0 };
+  for (int i = 0; i < 16; ++i)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      lo[c] = std::min(lo[c], int(texels[i][c]));
+      hi[c] = std::max(hi[c], int(texels[i][c]));
+      sum[c] += texels[i][c];
+    }
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    const int inset = (hi[c] - lo[c]) >> 4;
+    lo[c] += inset;
+    hi[c] -= inset;
+  }
+
+  // Channels which fall while the channel with the largest range rises use the other diagonal.
+  int major = 0;
+  for (int c = 1; c < 3; ++c)
+  {
+    if (hi[major] - lo[major] < hi[c] - lo[c])
+    {
+      major = c;
+    }
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    int covariance = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+      covariance += (16 * texels[i][major] - sum[major]) * (16 * texels[i][c] - sum[c]) / 256;
+    }
+    if (covariance < 0)
+    {
+      std::swap(lo[c], hi[c]);
+    }
+  }
+
+  unsigned int c0 = toRGB565(hi);
+  unsigned int c1 = toRGB565(lo);
+
+  unsigned int indices = 0;
+
+  if (c0 != c1)
+  {
+    if (c0 < c1) // c0 > c1 selects the four color mode.
+    {
+      std::swap(c0, c1);
+    }
+
+    int palette[4][3];
+    fromRGB565(c0, palette[0]);
+    fromRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (int i = 0; i < 16; ++i)
+    {
+      int best     = 0;
+      int bestDist = 0x7FFFFFFF;
+      for (int p = 0; p < 4; ++p)
+      {
+        const int dr = int(texels[i][0]) - palette[p][0];
+        const int dg = int(texels[i][1]) - palette[p][1];
+        const int db = int(texels[i][2]) - palette[p][2];
+        const int dist = dr * dr + dg * dg + db * db;
+        if (dist < bestDist)
+        {
+          bestDist = dist;
+          best     = p;
+        }
+      }
+      indices |= best << (i * 2);
+    }
+  }
+
+  dst[0] = (unsigned char)(c0 & 0xFF);
+  dst[1] = (unsigned char)(c0 >> 8);
+  dst[2] = (unsigned char)(c1 & 0xFF);
+  dst[3] = (unsigned char)(c1 >> 8);
+  memcpy(dst + 4, &indices, 4); // Little endian.
+}
+
+// BC4 style block of the alpha channel with the eight value mode.
+static void encodeAlphaBlock(const unsigned char texels[16][4], unsigned char* dst)
+{
+  int a0 = 0;
+  int a1 = 255;
+  for (int i = 0; i < 16; ++i)
+  {
+    a0 = std::max(a0, int(texels[i][3]));
+    a1 = std::min(a1, int(texels[i][3]));
+  }
+
+  unsigned long long indices = 0;
+
+  if (a0 != a1)
+  {
+    int palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    for (int p = 1; p < 7; ++p)
+    {
+      palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+    }
+
+    for (int i = 0; i < 16; ++i)
+    {
+      int best     = 0;
+      int bestDist = 256;
+      for (int p = 0; p < 8; ++p)
+      {
+        const int dist = std::abs(int(texels[i][3]) - palette[p]);
+        if (dist < bestDist)
+        {
+          bestDist = dist;
+          best     = p;
+        }
+      }
+      indices |= (unsigned long long) best << (i * 3);
+    }
+  }
+
+  dst[0] = (unsigned char) a0;
+  dst[1] = (unsigned char) a1;
+  for (int i = 0; i < 6; ++i)
+  {
+    dst[2 + i] = (unsigned char)(indices >> (i * 8));
+  }
+}
+
+void encodeBlocks(const unsigned char* rgba, unsigned int width, unsigned int height, ImageBlockFormat block, unsigned char* dst)
+{
+  MY_ASSERT(block == IMAGE_BLOCK_BC1 || block == IMAGE_BLOCK_BC3);
+
+  const unsigned int blockSize = getBlockSize(block);
+
+  unsigned char texels[16][4];
+
+  for (unsigned int by = 0; by < height; by += 4)
+  {
+    for (unsigned int bx = 0; bx < width; bx += 4)
+    {
+      for (unsigned int i = 0; i < 16; ++i)
+      {
+        const unsigned int x = std::min(bx + (i & 3),  width  - 1);
+        const unsigned int y = std::min(by + (i >> 2), height - 1);
+        memcpy(texels[i], rgba + (y * width + x) * 4, 4);
+      }
+
+      if (block == IMAGE_BLOCK_BC3)
+      {
+        encodeAlphaBlock(texels, dst);
+        encodeColorBlock(texels, dst + 8);
+      }
+      else
+      {
+        encodeColorBlock(texels, dst);
+      }
+      dst += blockSize;
+    }
+  }
+}
+
+
+// Reverses the first rows (< 4 for the smallest mipmaps) of 3-bit indices inside a BC4 style block.
+static void flipAlphaBlock(unsigned char* block, unsigned int rows)
+{
+  unsigned long long indices = 0;
+  for (int i = 0; i < 6; ++i)
+  {
+    indices |= (unsigned long long) block[2 + i] << (i * 8);
+  }
+  unsigned long long flipped = indices;
+  for (unsigned int r = 0; r < rows; ++r)
+  {
+    const unsigned long long row = (indices >> (r * 12)) & 0xFFF;
+    flipped &= ~(0xFFFull << ((rows - 1 - r) * 12));
+    flipped |= row << ((rows - 1 - r) * 12);
+  }
+  for (int i = 0; i < 6; ++i)
+  {
+    block[2 + i] = (unsigned char)(flipped >> (i * 8));
+  }
+}
+
+// The color block stores one byte of 2-bit indices per row.
+static void flipColorBlock(unsigned char* block, unsigned int rows)
+{
+  unsigned char indices[4];
+  memcpy(indices, block + 4, 4);
+  for (unsigned int r = 0; r < rows; ++r)
+  {
+    block[4 + rows - 1 - r] = indices[r];
+  }
+}
+
+bool flipBlocksY(unsigned char* blocks, unsigned int width, unsigned int height, ImageBlockFormat block)
+{
+  if (block != IMAGE_BLOCK_BC1 && block != IMAGE_BLOCK_BC3 && block != IMAGE_BLOCK_BC5)
+  {
+    return false; // BC6H partitions and endpoints depend on the texel positions.
+  }
+  if (4 < height && (height & 3) != 0)
+  {
+    return false; // The partial last row of blocks would end up at the wrong place.
+  }
+
+  const unsigned int blockSize = getBlockSize(block);
+  const unsigned int blocksX   = (width  + 3) / 4;
+  const unsigned int blocksY   = (height + 3) / 4;
+  const unsigned int rowBytes  = blocksX * blockSize;
+  const unsigned int rows      = std::min(height, 4u); // Only images smaller than a block have fewer rows.
+
+  std::vector<unsigned char> row(rowBytes);
+
+  for (unsigned int y = 0; y < blocksY / 2; ++y)
+  {
+    unsigned char* a = blocks + y * rowBytes;
+    unsigned char* b = blocks + (blocksY - 1 - y) * rowBytes;
+    memcpy(row.data(), a, rowBytes);
+    memcpy(a, b, rowBytes);
+    memcpy(b, row.data(), rowBytes);
+  }
+
+  for (unsigned int i = 0; i < blocksX * blocksY; ++i)
+  {
+    unsigned char* p = blocks + i * blockSize;
+    switch (block)
+    {
+      case IMAGE_BLOCK_BC1:
+        flipColorBlock(p, rows);
+        break;
+      case IMAGE_BLOCK_BC3:
+        flipAlphaBlock(p, rows);
+        flipColorBlock(p + 8, rows);
+        break;
+      case IMAGE_BLOCK_BC5:
+        flipAlphaBlock(p, rows);
+        flipAlphaBlock(p + 8, rows);
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
@@ -34,11 +34,18 @@
 
 #include <IL/il.h>
 
+#include <HDRLoader.h>
+#include <NvtxRange.h>
+
 #include <algorithm>
 #include <cctype>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <mutex>
 
+#include "inc/BlockCompression.h"
 #include "inc/MyAssert.h"
 
 
@@ -96,6 +103,7 @@ Image::Image()
 , m_depth(0)
 , m_format(IL_RGBA)
 , m_type(IL_UNSIGNED_BYTE)
+, m_block(IMAGE_BLOCK_NONE)
 , m_pixels(nullptr)
 , m_bpp(0)
 , m_bpl(0)
@@ -115,6 +123,7 @@ Image::Image(unsigned int width,
 , m_depth(depth)
 , m_format(format)
 , m_type(type)
+, m_block(IMAGE_BLOCK_NONE)
 , m_pixels(nullptr)
 {
   m_bpp = numberOfComponents(m_format) * sizeOfComponents(m_type);
@@ -123,6 +132,23 @@ Image::Image(unsigned int width,
   m_nob = m_depth  * m_bps;
 }
 
+Image::Image(unsigned int     width,
+             unsigned int     height,
+             ImageBlockFormat block)
+: m_width(width)
+, m_height(height)
+, m_depth(1)
+, m_format((block == IMAGE_BLOCK_BC5) ? IL_LUMINANCE_ALPHA : (block == IMAGE_BLOCK_BC6H) ? IL_RGB : IL_RGBA)
+, m_type((block == IMAGE_BLOCK_BC6H) ? IL_FLOAT : IL_UNSIGNED_BYTE)
+, m_block(block)
+, m_pixels(nullptr)
+{
+  m_bpp = 0;
+  m_bpl = ((m_width  + 3) / 4) * getBlockSize(m_block);
+  m_bps = ((m_height + 3) / 4) * m_bpl;
+  m_nob = m_bps;
+}
+
 Image::~Image()
 {
   if (m_pixels != nullptr)
@@ -138,6 +164,7 @@ Image::Image(const Image& image)
 , m_depth(image.m_depth)
 , m_format(image.m_format)
 , m_type(image.m_type)
+, m_block(image.m_block)
 , m_bpp(image.m_bpp)
 , m_bpl(image.m_bpl)
 , m_bps(image.m_bps)
@@ -215,8 +242,10 @@ bool Picture::isCubemap() const
   return m_isCube;
 }
 
-bool Picture::load(const std::string& filename)
+bool Picture::load(const std::string& filename, bool keepBlocks)
 {
+  SUTIL_NVTX_RANGE("Picture::load");
+
   bool success = false;
 
   m_images.clear(); // Each load() wipes previously loaded image data.
@@ -239,6 +268,23 @@ bool Picture::load(const std::string& filename)
 
   bool isDDS = (ext == std::string(".dds")); // .dds images need special handling
   m_isCube = false;
+
+  // DevIL decompresses DDS files and doesn't read KTX files at all. Keep the blocks of the formats the texture units support.
+  if (keepBlocks && (isDDS || ext == std::string(".ktx")) && loadBlocks(foundFile, isDDS))
+  {
+    return true;
+  }
+
+  // The own decoder runs without the DevIL lock.
+  if (ext == std::string(".hdr") && loadRadiance(foundFile))
+  {
+    return true;
+  }
+
+  // DevIL keeps the bound image in global state. Asynchronous texture loads happen on multiple threads.
+  // Only the formats above decode concurrently.
+  static std::mutex mutexDevIL;
+  std::lock_guard<std::mutex> lock(mutexDevIL);
   
   unsigned int imageID;
 
@@ -443,9 +489,319 @@ void Picture::clear()
   m_images.clear();
 }
 
+// Expands an 8-bit unsigned 2D image to RGBA8 with red in the first byte, like the texture units expect it.
+bool Picture::getRGBA8(unsigned int indexImage, unsigned int indexFace, std::vector<unsigned char>& rgba) const
+{
+  const Image* image = getImageFace(indexImage, indexFace);
+
+  if (image == nullptr || image->m_block != IMAGE_BLOCK_NONE || image->m_type != IL_UNSIGNED_BYTE || image->m_depth != 1)
+  {
+    return false;
+  }
+
+  const unsigned int numComponents = numberOfComponents(image->m_format);
+  const unsigned int numTexels     = image->m_width * image->m_height;
+
+  rgba.resize(numTexels * 4);
+
+  for (unsigned int k = 0; k < numTexels; ++k)
+  {
+    const unsigned char* src = image->m_pixels + k * numComponents;
+    unsigned char*       dst = &rgba[k * 4];
+    switch (image->m_format)
+    {
+      case IL_RGB:
+        dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255;
+        break;
+      case IL_BGR:
+        dst[0] = src[2]; dst[1] = src[1]; dst[2] = src[0]; dst[3] = 255;
+        break;
+      case IL_RGBA:
+        dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = src[3];
+        break;
+      case IL_BGRA:
+        dst[0] = src[2]; dst[1] = src[1]; dst[2] = src[0]; dst[3] = src[3];
+        break;
+      case IL_LUMINANCE:
+        dst[0] = src[0]; dst[1] = src[0]; dst[2] = src[0]; dst[3] = 255;
+        break;
+      case IL_ALPHA:
+        dst[0] = 0; dst[1] = 0; dst[2] = 0; dst[3] = src[0];
+        break;
+      case IL_LUMINANCE_ALPHA:
+        dst[0] = src[0]; dst[1] = src[0]; dst[2] = src[0]; dst[3] = src[1];
+        break;
+    }
+  }
+  return true;
+}
+
+// Only 8-bit unsigned 2D images can be encoded. Alpha channels with any texel below 255 select BC3, otherwise BC1.
+bool Picture::compress()
+{
+  bool compressed = false;
+
+  std::vector<unsigned char> rgba;
+
+  for (size_t i = 0; i < m_images.size(); ++i)
+  {
+    for (size_t j = 0; j < m_images[i].size(); ++j)
+    {
+      if (!getRGBA8((unsigned int) i, (unsigned int) j, rgba))
+      {
+        continue;
+      }
+
+      Image& image = m_images[i][j];
+
+      bool hasAlpha = false;
+      for (size_t k = 3; k < rgba.size() && !hasAlpha; k += 4)
+      {
+        hasAlpha = (rgba[k] != 255);
+      }
+
+      // All mipmap levels of one image need the same format, decide on the LOD 0 image.
+      const ImageBlockFormat block = (j == 0) ? (hasAlpha ? IMAGE_BLOCK_BC3 : IMAGE_BLOCK_BC1) : m_images[i][0].m_block;
+      if (block == IMAGE_BLOCK_NONE)
+      {
+        continue;
+      }
+
+      Image blocks(image.m_width, image.m_height, block);
+      blocks.m_pixels = new unsigned char[blocks.m_nob];
+      encodeBlocks(rgba.data(), image.m_width, image.m_height, block, blocks.m_pixels);
+
+      std::swap(image.m_pixels, blocks.m_pixels); // The destructor of blocks releases the uncompressed texels.
+      image.m_format = blocks.m_format;
+      image.m_block  = blocks.m_block;
+      image.m_bpp    = blocks.m_bpp;
+      image.m_bpl    = blocks.m_bpl;
+      image.m_bps    = blocks.m_bps;
+      image.m_nob    = blocks.m_nob;
+
+      compressed = true;
+    }
+  }
+  return compressed;
+}
+
 
 // Private functions 
 
+static unsigned int readUint(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static ImageBlockFormat blockFromFourCC(unsigned int fourCC)
+{
+  switch (fourCC)
+  {
+    case 0x31545844: // "DXT1"
+      return IMAGE_BLOCK_BC1;
+    case 0x35545844: // "DXT5"
+      return IMAGE_BLOCK_BC3;
+    case 0x32495441: // "ATI2"
+    case 0x55354342: // "BC5U"
+      return IMAGE_BLOCK_BC5;
+    default:
+      return IMAGE_BLOCK_NONE;
+  }
+}
+
+static ImageBlockFormat blockFromDXGI(unsigned int format)
+{
+  // The _SRGB variants are read like the UNORM ones. The sRGB conversion is an argument of Texture::createSampler().
+  switch (format)
+  {
+    case 71: // DXGI_FORMAT_BC1_UNORM
+    case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+      return IMAGE_BLOCK_BC1;
+    case 77: // DXGI_FORMAT_BC3_UNORM
+    case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+      return IMAGE_BLOCK_BC3;
+    case 83: // DXGI_FORMAT_BC5_UNORM
+      return IMAGE_BLOCK_BC5;
+    case 95: // DXGI_FORMAT_BC6H_UF16
+      return IMAGE_BLOCK_BC6H;
+    default:
+      return IMAGE_BLOCK_NONE;
+  }
+}
+
+static ImageBlockFormat blockFromGL(unsigned int internalFormat)
+{
+  switch (internalFormat)
+  {
+    case 0x83F0: // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    case 0x83F1: // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+    case 0x8C4C: // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+    case 0x8C4D: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+      return IMAGE_BLOCK_BC1;
+    case 0x83F3: // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    case 0x8C4F: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+      return IMAGE_BLOCK_BC3;
+    case 0x8DBD: // GL_COMPRESSED_RG_RGTC2
+      return IMAGE_BLOCK_BC5;
+    case 0x8E8F: // GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT
+      return IMAGE_BLOCK_BC6H;
+    default:
+      return IMAGE_BLOCK_NONE;
+  }
+}
+
+// Handles single 2D images with an optional mipmap chain. Cubemaps, volumes, arrays and other formats return false
+// before touching m_images and take the DevIL path which decompresses what it can.
+bool Picture::loadBlocks(const std::string& filename, bool isDDS)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  ImageBlockFormat block = IMAGE_BLOCK_NONE;
+
+  unsigned int width     = 0;
+  unsigned int height    = 0;
+  unsigned int numLevels = 0;
+  size_t       offset    = 0;
+
+  if (isDDS)
+  {
+    if (data.size() < 128 || memcmp(data.data(), "DDS ", 4) != 0)
+    {
+      return false;
+    }
+    const unsigned char* header = data.data() + 4;
+
+    height    = readUint(header + 8);
+    width     = readUint(header + 12);
+    numLevels = readUint(header + 24);
+
+    const unsigned int pixelFlags = readUint(header + 76);
+    const unsigned int fourCC     = readUint(header + 80);
+    const unsigned int caps2      = readUint(header + 108);
+
+    if (!(pixelFlags & 0x4) || (caps2 & (0x200 | 0x200000))) // DDPF_FOURCC, DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME
+    {
+      return false;
+    }
+
+    offset = 128;
+    if (fourCC == 0x30315844) // "DX10" extended header.
+    {
+      if (data.size() < 148 || readUint(data.data() + 128 + 12) > 1) // arraySize
+      {
+        return false;
+      }
+      block  = blockFromDXGI(readUint(data.data() + 128));
+      offset = 148;
+    }
+    else
+    {
+      block = blockFromFourCC(fourCC);
+    }
+  }
+  else
+  {
+    static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    if (data.size() < 64 || memcmp(data.data(), identifier, 12) != 0 || readUint(data.data() + 12) != 0x04030201)
+    {
+      return false;
+    }
+    if (1 < readUint(data.data() + 44) || readUint(data.data() + 48) != 0 || readUint(data.data() + 52) != 1) // Depth, array elements, faces.
+    {
+      return false;
+    }
+
+    block     = blockFromGL(readUint(data.data() + 28));
+    width     = readUint(data.data() + 36);
+    height    = readUint(data.data() + 40);
+    numLevels = readUint(data.data() + 56);
+    offset    = 64 + readUint(data.data() + 60); // Skip the key/value data.
+  }
+
+  if (block == IMAGE_BLOCK_NONE || width == 0)
+  {
+    return false;
+  }
+  height    += (height    == 0);
+  numLevels += (numLevels == 0);
+
+  std::vector<Image> levels;
+  levels.reserve(numLevels); // This needs the deep copy constructor!
+
+  for (unsigned int i = 0; i < numLevels; ++i)
+  {
+    levels.push_back(Image(std::max(1u, width >> i), std::max(1u, height >> i), block));
+    Image& image = levels.back();
+
+    if (!isDDS)
+    {
+      offset += 4; // imageSize. The levels of non-array 2D images are tightly packed blocks, padding is not needed.
+    }
+    if (data.size() < offset + image.m_nob)
+    {
+      std::cerr << "ERROR: Picture::loadBlocks() " << filename << " is truncated" << std::endl;
+      return false;
+    }
+
+    image.m_pixels = new unsigned char[image.m_nob];
+    memcpy(image.m_pixels, data.data() + offset, image.m_nob);
+    offset += image.m_nob;
+
+    // DDS images are stored top-down, KTX follows the OpenGL convention with the origin at the lower left.
+    if (isDDS && !flipBlocksY(image.m_pixels, image.m_width, image.m_height, block))
+    {
+      std::cerr << "ERROR: Picture::loadBlocks() " << filename << " cannot be flipped, use KTX for BC6H or heights which are not multiples of four" << std::endl;
+      return false;
+    }
+  }
+
+  m_images.push_back(levels);
+  m_isCube = false;
+
+  return true;
+}
+
+// Radiance RGBE files go through the sutil HDRLoader, which decodes without DevIL. So multiple threads load these images concurrently.
+// Files the HDRLoader rejects, like XYZE or other orientations, return false before touching m_images and take the DevIL path.
+bool Picture::loadRadiance(const std::string& filename)
+{
+  HDRLoader hdr(filename);
+  if (hdr.failed())
+  {
+    return false;
+  }
+
+  const unsigned int width  = hdr.width();
+  const unsigned int height = hdr.height();
+
+  m_images.push_back(std::vector<Image>());
+  m_images.back().push_back(Image(width, height, 1, IL_RGB, IL_FLOAT));
+  Image& image = m_images.back().back();
+  image.m_pixels = new unsigned char[image.m_nob];
+
+  // The raster starts with the top scanline as RGBA. The origin is at the lower left like in the DevIL path.
+  const float* src = hdr.raster();
+  for (unsigned int y = 0; y < height; ++y)
+  {
+    float* dst = reinterpret_cast<float*>(image.m_pixels + size_t(height - 1 - y) * image.m_bpl);
+    for (unsigned int x = 0; x < width; ++x, src += 4, dst += 3)
+    {
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+    }
+  }
+  m_isCube = false;
+
+  return true;
+}
+
 unsigned int Picture::addImage(unsigned int width,
                                unsigned int height,
                                unsigned int depth,
@@ -0,0 +1,143 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/PictureCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+PictureRequest::PictureRequest(std::string const& filename, bool keepBlocks, bool compress)
+: filename(filename)
+, keepBlocks(keepBlocks)
+, compress(compress)
+{
+}
+
+
+namespace
+{
+  struct PictureCacheEntry
+  {
+    std::once_flag                 once;
+    std::shared_ptr<const Picture> picture;
+  };
+
+  std::mutex mutexCache;
+  std::map<std::string, std::shared_ptr<PictureCacheEntry> > cache;
+}
+
+
+std::shared_ptr<const Picture> PictureCache::acquire(std::string const& filename, bool keepBlocks, bool compress)
+{
+  const std::string key = filename + ((keepBlocks) ? "|blocks" : "") + ((compress) ? "|compress" : "");
+
+  std::shared_ptr<PictureCacheEntry> entry;
+  {
+    std::lock_guard<std::mutex> lock(mutexCache);
+
+    std::shared_ptr<PictureCacheEntry>& slot = cache[key];
+    if (!slot)
+    {
+      slot = std::make_shared<PictureCacheEntry>();
+    }
+    entry = slot;
+  }
+
+  // Decoding happens outside the cache lock. Picture::load() serializes the DevIL part itself.
+  std::call_once(entry->once, [&entry, &filename, keepBlocks, compress]()
+  {
+    std::shared_ptr<Picture> picture = std::make_shared<Picture>();
+    if (picture->load(filename, keepBlocks) && compress)
+    {
+      picture->compress();
+    }
+    entry->picture = picture;
+  });
+
+  std::shared_ptr<const Picture> picture = entry->picture;
+  if (picture->getNumberOfImages() == 0)
+  {
+    std::lock_guard<std::mutex> lock(mutexCache);
+
+    std::map<std::string, std::shared_ptr<PictureCacheEntry> >::iterator it = cache.find(key);
+    if (it != cache.end() && it->second == entry)
+    {
+      cache.erase(it);
+    }
+  }
+  return picture;
+}
+
+void PictureCache::acquireBatch(std::vector<PictureRequest> const& requests, std::vector< std::shared_ptr<const Picture> >& pictures, unsigned int threads)
+{
+  pictures.assign(requests.size(), std::shared_ptr<const Picture>());
+  if (requests.empty())
+  {
+    return;
+  }
+
+  if (threads == 0)
+  {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = static_cast<unsigned int>(std::min(size_t(threads), requests.size()));
+
+  // Each worker takes the next unclaimed request. The results land in their own slots, so the order is kept.
+  std::atomic<size_t> next(0);
+
+  auto worker = [&requests, &pictures, &next]()
+  {
+    for (size_t i = next++; i < requests.size(); i = next++)
+    {
+      pictures[i] = acquire(requests[i].filename, requests[i].keepBlocks, requests[i].compress);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (unsigned int i = 1; i < threads; ++i)
+  {
+    pool.push_back(std::thread(worker));
+  }
+  worker(); // The calling thread works as well.
+
+  for (size_t i = 0; i < pool.size(); ++i)
+  {
+    pool[i].join();
+  }
+}
+
+void PictureCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutexCache);
+  cache.clear();
+}
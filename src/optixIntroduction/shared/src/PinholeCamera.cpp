@@ -170,6 +170,16 @@ void PinholeCamera::zoom(float x)
   m_changed = true;
 }
 
+void PinholeCamera::setOrbit(optix::float3 const& center, float distance, float phi, float theta, float fov)
+{
+  m_center   = center;
+  m_distance = fmaxf(0.001f, distance); // Avoid swapping sides.
+  m_phi      = phi - floorf(phi);       // Wrap phi into [0.0f, 1.0f).
+  m_theta    = optix::clamp(theta, 0.0f, 1.0f);
+  m_fov      = optix::clamp(fov, 1.0f, 179.0f);
+  m_changed  = true;
+}
+
 float PinholeCamera::getAspectRatio() const
 {
   return m_aspect;
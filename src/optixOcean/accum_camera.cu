@@ -30,6 +30,8 @@
 #include <optixu/optixu_math_namespace.h>
 #include "helpers.h"
 #include "random.h"
+#include "tonemap.cuh"
+#include "cost_heatmap.h"
 
 using namespace optix;
 
@@ -59,9 +61,8 @@ rtDeclareVariable(unsigned int,  frame, , );
 rtDeclareVariable(uint2,         launch_index, rtLaunchIndex, );
 
 
-RT_PROGRAM void pinhole_camera()
+static __device__ __inline__ float3 trace_camera_ray()
 {
-
   size_t2 screen = output_buffer.size();
   unsigned int seed = tea<16>(screen.x*launch_index.y+launch_index.x, frame);
 
@@ -80,15 +81,35 @@ RT_PROGRAM void pinhole_camera()
   prd.seed = seed;
 
   rtTrace(top_object, ray, prd);
+  return prd.result;
+}
+
+RT_PROGRAM void pinhole_camera()
+{
+  const long long start = clock64();
+  float3 result = trace_camera_ray();
 
   float4 acc_val = accum_buffer[launch_index];
   if( frame > 0 ) {
-    acc_val = lerp( acc_val, make_float4( prd.result, 0.f), 1.0f / static_cast<float>( frame+1 ) );
+    acc_val = lerp( acc_val, make_float4( result, 0.f), 1.0f / static_cast<float>( frame+1 ) );
   } else {
-    acc_val = make_float4(prd.result, 0.f);
+    acc_val = make_float4(result, 0.f);
   }
-  output_buffer[launch_index] = make_color( make_float3( acc_val ) );
   accum_buffer[launch_index] = acc_val;
+
+  // The host skips the tonemap launch while the heatmap is shown
+  if( use_cost_heatmap )
+    output_buffer[launch_index] = make_color( record_cost( launch_index, start, frame ) );
+  else
+    output_buffer[launch_index] = make_color( make_float3( acc_val ) );
+}
+
+// Single frame without accumulation, tonemapped straight into the output buffer
+RT_PROGRAM void pinhole_camera_tonemapped()
+{
+  const long long start = clock64();
+  const float3 result = trace_camera_ray();
+  output_buffer[launch_index] = make_color( use_cost_heatmap ? record_cost( launch_index, start, frame ) : tonemap_color( result ) );
 }
 
 RT_PROGRAM void exception()
@@ -32,7 +32,7 @@
 #include <optixu/optixu_aabb.h>
 #include "helpers.h"
 #include "sunsky.cuh"
-#include "intersection_refinement.h"
+#include "packed_surface.cuh"
 
 /******************************************************************************\
  * 
@@ -63,21 +63,41 @@ rtDeclareVariable(int2,    ncells, , );
 
 rtBuffer<float,  2>  heights;
 rtBuffer<float4, 2>  normals;
+rtBuffer<float2, 1>        minmax;          // Height range pyramid, finest (one per cell) first.
+rtBuffer<unsigned int, 1>  minmax_offsets;  // First element of each level.
+rtDeclareVariable(int,     minmax_top, , ); // Coarsest level, a single node.
+rtDeclareVariable(int,     wrap, , );       // 1 if the patch is periodic, the last cell joins the first nodes.
+rtDeclareVariable(int,     lod, , );        // Instance level of detail, cells of 2^lod x 2^lod nodes.
+rtBuffer<ushort4, 2> surface;               // Packed heights and normals, see packed_surface.cuh.
+rtDeclareVariable(int,     packed, , );     // 1 if surface replaces heights and normals for rendering.
 rtDeclareVariable(float3, texcoord, attribute texcoord, ); 
-rtDeclareVariable(float3, back_hit_point, attribute back_hit_point, );
-rtDeclareVariable(float3, front_hit_point, attribute front_hit_point, );
 
 
-__device__ float3 computeNormal( int Lu, int Lv, float3 hitpos )
+__device__ uint2 nodeIndex( int u, int v )
+{
+  return make_uint2(u % static_cast<int>(heights.size().x), v % static_cast<int>(heights.size().y));
+}
+
+__device__ float heightAt( uint2 node )
+{
+  return packed ? unpack_height( surface[node] ) : heights[node];
+}
+
+__device__ float3 normalAt( uint2 node )
+{
+  return packed ? unpack_normal( surface[node] ) : make_float3( normals[node] );
+}
+
+__device__ float3 computeNormal( int u0, int v0, int u1, int v1, float3 hitpos )
 {
   float2 C = make_float2((hitpos.x - boxmin.x) * inv_cellsize.x,
                          (hitpos.z - boxmin.z) * inv_cellsize.z);
-  float2 uv = C - make_float2(Lu, Lv);
+  float2 uv = (C - make_float2(u0, v0)) / make_float2(u1 - u0, v1 - v0);
 
-  float3 n00 = make_float3( normals[make_uint2(Lu,   Lv)  ] );
-  float3 n01 = make_float3( normals[make_uint2(Lu,   Lv+1)] );
-  float3 n10 = make_float3( normals[make_uint2(Lu+1, Lv)  ] );
-  float3 n11 = make_float3( normals[make_uint2(Lu+1, Lv+1)] );
+  float3 n00 = normalAt( nodeIndex(u0, v0) );
+  float3 n01 = normalAt( nodeIndex(u0, v1) );
+  float3 n10 = normalAt( nodeIndex(u1, v0) );
+  float3 n11 = normalAt( nodeIndex(u1, v1) );
 
   return optix::bilerp( n00, n10, n01, n11, uv.x, uv.y ); 
 }
@@ -102,52 +122,52 @@ RT_PROGRAM void intersect(int primIdx)
   tfar  = min(tfar,  ray.tmax);
 
   // Step 3
-  uint2 nnodes;
-  nnodes.x = heights.size().x;
-  nnodes.y = heights.size().y;
+  int2 ncells_uv = make_int2( heights.size().x - 1 + wrap, heights.size().y - 1 + wrap );
   float3 L = (ray.origin + tnear * ray.direction - boxmin) * inv_cellsize;
-  int Lu = min(__float2int_rz(L.x), nnodes.x-2);
-  int Lv = min(__float2int_rz(L.z), nnodes.y-2);
+  int Lu = max(min(__float2int_rz(L.x), ncells_uv.x-1), 0);
+  int Lv = max(min(__float2int_rz(L.z), ncells_uv.y-1), 0);
 
-  // Step 4
+  // Step 4 - walk the min/max pyramid from the top. Nodes whose height range the ray clears are
+  // skipped whole, the others are refined down to cells of the instance level of detail, which are
+  // tested for a hit.
   float3 D = ray.direction * inv_cellsize;
-  int diu = D.x>0?1:-1;
-  int div = D.z>0?1:-1;
-  int stopu = D.x>0?(int)(nnodes.x)-1:-1;
-  int stopv = D.z>0?(int)(nnodes.y)-1:-1;
-
-  // Step 5
-  float dtdu = abs(cellsize.x/ray.direction.x);
-  float dtdv = abs(cellsize.z/ray.direction.z);
-
-  // Step 6
-  float far_u = (D.x>0.0f?Lu+1:Lu) * cellsize.x + boxmin.x;
-  float far_v = (D.z>0.0f?Lv+1:Lv) * cellsize.z + boxmin.z;
+  int level = minmax_top;
+  while(tnear < tfar){
+    int nu = Lu >> level;
+    int nv = Lv >> level;
 
-  // Step 7
-  float tnext_u = (far_u - ray.origin.x)/ray.direction.x;
-  float tnext_v = (far_v - ray.origin.z)/ray.direction.z;
+    // Step 5 - exit of the node
+    float far_u = ((D.x>0.0f?nu+1:nu) << level) * cellsize.x + boxmin.x;
+    float far_v = ((D.z>0.0f?nv+1:nv) << level) * cellsize.z + boxmin.z;
+    float tnext_u = ray.direction.x != 0.0f ? (far_u - ray.origin.x)/ray.direction.x : 1.e30f;
+    float tnext_v = ray.direction.z != 0.0f ? (far_v - ray.origin.z)/ray.direction.z : 1.e30f;
+    float texit = min(min(tnext_u, tnext_v), tfar);
 
-  // Step 8
-  float yenter = ray.origin.y + tnear * ray.direction.y;
-  while(tnear < tfar){
-    float texit = min(tnext_u, tnext_v);
+    float yenter = ray.origin.y + tnear * ray.direction.y;
     float yexit = ray.origin.y + texit * ray.direction.y;
 
-    // Step 9
-    float d00 = heights[make_uint2(Lu,   Lv)  ];
-    float d01 = heights[make_uint2(Lu,   Lv+1)];
-    float d10 = heights[make_uint2(Lu+1, Lv)  ];
-    float d11 = heights[make_uint2(Lu+1, Lv+1)];
-    float datamin = min(min(d00, d01), min(d10, d11));
-    float datamax = max(max(d00, d01), max(d10, d11));
+    // Step 6
+    float2 range = minmax[minmax_offsets[level] + nv*(((ncells_uv.x-1) >> level) + 1) + nu];
     float ymin = min(yenter, yexit);
     float ymax = max(yenter, yexit);
 
-    if(ymin <= datamax && ymax >= datamin) {
+    if(ymin <= range.y && ymax >= range.x) {
+      if(level > lod) {
+        --level;
+        continue;
+      }
 
-      float3 p00 = make_float3( boxmin.x + Lu*cellsize.x, d00, boxmin.z + Lv*cellsize.z );
-      float3 p11 = make_float3( p00.x + cellsize.x,       d11, p00.z + cellsize.z ); 
+      int u0 = nu << level;
+      int v0 = nv << level;
+      int u1 = min((nu+1) << level, ncells_uv.x);
+      int v1 = min((nv+1) << level, ncells_uv.y);
+      float d00 = heightAt(nodeIndex(u0, v0));
+      float d01 = heightAt(nodeIndex(u0, v1));
+      float d10 = heightAt(nodeIndex(u1, v0));
+      float d11 = heightAt(nodeIndex(u1, v1));
+
+      float3 p00 = make_float3( boxmin.x + u0*cellsize.x, d00, boxmin.z + v0*cellsize.z );
+      float3 p11 = make_float3( boxmin.x + u1*cellsize.x, d11, boxmin.z + v1*cellsize.z ); 
       float3 p01 = make_float3( p00.x,                    d01, p11.z ); 
       float3 p10 = make_float3( p11.x,                    d10, p00.z ); 
       
@@ -158,10 +178,7 @@ RT_PROGRAM void intersect(int primIdx)
       if( intersect_triangle( ray, p00, p11, p10, n, t, beta, gamma ) ) {
         if(rtPotentialIntersection(t)) {
           geometric_normal = normalize( n );
-          shading_normal   = computeNormal( Lu, Lv, ray.origin+t*ray.direction );
-          refine_and_offset_hitpoint( ray.origin + t*ray.direction, ray.direction,
-                                      geometric_normal, p00,
-                                      back_hit_point, front_hit_point );
+          shading_normal   = computeNormal( u0, v0, u1, v1, ray.origin+t*ray.direction );
           if(rtReportIntersection(0)) {
             done = true;
           }
@@ -171,10 +188,7 @@ RT_PROGRAM void intersect(int primIdx)
       if( intersect_triangle( ray, p00, p01, p11, n, t, beta, gamma ) ) {
         if(rtPotentialIntersection(t)) {
           geometric_normal =  normalize( n );
-          shading_normal   = computeNormal( Lu, Lv, ray.origin+t*ray.direction );
-          refine_and_offset_hitpoint( ray.origin + t*ray.direction, ray.direction,
-                                      geometric_normal, p00,
-                                      back_hit_point, front_hit_point );
+          shading_normal   = computeNormal( u0, v0, u1, v1, ray.origin+t*ray.direction );
 
           if( rtReportIntersection( 0 ) ) {
             done = true;
@@ -184,21 +198,23 @@ RT_PROGRAM void intersect(int primIdx)
       if( done ) return;
     }
 
-    // Step 11
-    yenter = yexit;
+    // Step 7 - step into the neighbour of the node and continue one level up
     if(tnext_u < tnext_v){
-      Lu += diu;
-      if(Lu == stopu)
+      Lu = D.x>0.0f ? (nu+1) << level : (nu << level) - 1;
+      if(Lu < 0 || Lu >= ncells_uv.x)
         break;
+      float Cv = (ray.origin.z + tnext_u * ray.direction.z - boxmin.z) * inv_cellsize.z;
+      Lv = max(min(__float2int_rz(Cv), min(((nv+1) << level) - 1, ncells_uv.y-1)), nv << level);
       tnear = tnext_u;
-      tnext_u += dtdu;
     } else {
-      Lv += div;
-      if(Lv == stopv)
+      Lv = D.z>0.0f ? (nv+1) << level : (nv << level) - 1;
+      if(Lv < 0 || Lv >= ncells_uv.y)
         break;
+      float Cu = (ray.origin.x + tnext_v * ray.direction.x - boxmin.x) * inv_cellsize.x;
+      Lu = max(min(__float2int_rz(Cu), min(((nu+1) << level) - 1, ncells_uv.x-1)), nu << level);
       tnear = tnext_v;
-      tnext_v += dtdv;
     }
+    level = min(level+1, minmax_top);
   }
 }
 
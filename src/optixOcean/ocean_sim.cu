@@ -30,6 +30,8 @@
 #include <optix_math.h>
 #include <cufft.h>
 #include <math_constants.h>
+#include "random.h"
+#include "packed_surface.cuh"
 
 
 rtDeclareVariable(uint2, launch_index, rtLaunchIndex, );
@@ -37,8 +39,53 @@ rtDeclareVariable(uint2, launch_dim,   rtLaunchDim, );
 rtDeclareVariable(float, patch_size,, );
 rtDeclareVariable(float, t,, );
 rtBuffer<float2, 2>                    h0;
-rtBuffer<float2, 2>                    ht;
-rtBuffer<float2, 2>                    ik_ht;
+rtBuffer<float2, 2>                    ht;      // Height spectrum, in choppy mode followed by the x and z displacement spectra.
+rtDeclareVariable(int,   choppy, , );
+
+
+/******************************************************************************\
+ * 
+ * Initial spectrum generation
+ * 
+\******************************************************************************/
+rtDeclareVariable(float,        wind_speed, , );
+rtDeclareVariable(float,        wind_dir, , );     // Radians
+rtDeclareVariable(float,        wave_scale, , );
+rtDeclareVariable(unsigned int, h0_seed, , );
+
+// Phillips spectrum
+__device__
+float phillips(float Kx, float Ky, float Vdir, float V, float A)
+{
+  const float g = 9.81f;            // gravitational constant
+
+  float k_squared = Kx * Kx + Ky * Ky;
+  if (k_squared == 0.0f ) return 0.0f;
+  float k_x = Kx / sqrtf(k_squared);
+  float k_y = Ky / sqrtf(k_squared);
+  float L = V * V / g;
+  float w_dot_k = k_x * cosf(Vdir) + k_y * sinf(Vdir);
+
+  return A * expf( -1.0f / (k_squared * L * L) ) / (k_squared * k_squared) * w_dot_k * w_dot_k;
+}
+
+RT_PROGRAM void generate_h0()
+{
+    unsigned int x = launch_index.x;
+    unsigned int y = launch_index.y;
+
+    float kx = CUDART_PI_F * x / patch_size;
+    float ky = 2.0f * CUDART_PI_F * y / patch_size;
+
+    // Seeded by the wave number, not the launch size, so the long waves survive a resolution change
+    unsigned int seed = tea<4>( ( y << 16 ) | x, h0_seed );
+    float Er = 2.0f * rnd( seed ) - 1.0f;
+    float Ei = 2.0f * rnd( seed ) - 1.0f;
+
+    float P = sqrtf( phillips( kx, ky, wind_dir, wind_speed, wave_scale ) );
+
+    h0[ launch_index ] = x == 0u ? make_float2( 0.0f, 0.0f ) : make_float2( Er, Ei ) * ( P / sqrtf( 2.0f ) );
+}
 
 
 /******************************************************************************\
@@ -82,22 +129,68 @@ RT_PROGRAM void generate_spectrum()
 
     float2 h_tilda = complex_add( complex_mult(h0_k, complex_exp(w * t)),
                                   complex_mult(conjugate(h0_mk), complex_exp(-w * t)) );
-    float2 ik_h_tilda = k*h_tilda;
-
     ht[ launch_index ] = h_tilda;
-    ik_ht[ launch_index ] = ik_h_tilda;
+
+    // horizontal displacement -i k/|k| h
+    if ( choppy ) {
+      float2 d_tilda = k_len > 0.0f ? make_float2( h_tilda.y, -h_tilda.x ) / k_len : make_float2( 0.0f, 0.0f );
+      ht[ make_uint2( x, y + launch_dim.y ) ]   = d_tilda * k.x;
+      ht[ make_uint2( x, y + 2*launch_dim.y ) ] = d_tilda * k.y;
+    }
 }
 
 
 /******************************************************************************\
  * 
- * Normal calculation 
+ * Choppy waves
  * 
 \******************************************************************************/
 rtBuffer<float,  2>                    heights;
+rtBuffer<float,  2>                    choppy_fft;          // Heights, x and z displacements stacked in y.
+rtDeclareVariable(float, choppiness, , );
+rtDeclareVariable(float, displacement_scale, , );           // Nodes per unit of displacement.
+
+__device__ float fft_height( int x, int y, int width, int height )
+{
+  x = ( x % width  + width  ) % width;
+  y = ( y % height + height ) % height;
+  return choppy_fft[ make_uint2( x, y ) ];
+}
+
+// The displaced surface is resampled on the grid: the height at a node is approximately the height
+// of the point displaced onto it, found by stepping back by the displacement at the node.
+RT_PROGRAM void resolve_choppy()
+{
+    int width  = launch_dim.x;
+    int height = launch_dim.y;
+
+    float dx = choppy_fft[ make_uint2( launch_index.x, launch_index.y + height ) ];
+    float dz = choppy_fft[ make_uint2( launch_index.x, launch_index.y + 2*height ) ];
+    float2 p = make_float2( launch_index ) - choppiness * displacement_scale * make_float2( dx, dz );
+
+    float2 f = make_float2( floorf( p.x ), floorf( p.y ) );
+    float2 w = p - f;
+    int x0 = static_cast<int>( f.x );
+    int y0 = static_cast<int>( f.y );
+    float h00 = fft_height( x0,   y0,   width, height );
+    float h10 = fft_height( x0+1, y0,   width, height );
+    float h01 = fft_height( x0,   y0+1, width, height );
+    float h11 = fft_height( x0+1, y0+1, width, height );
+    heights[ launch_index ] = lerp( lerp( h00, h10, w.x ), lerp( h01, h11, w.x ), w.y );
+}
+
+
+/******************************************************************************\
+ * 
+ * Normal calculation 
+ * 
+\******************************************************************************/
 rtBuffer<float4, 2>                    normals;
 
 rtDeclareVariable(float, height_scale, , );
+rtBuffer<ushort4, 2>                   surface;
+rtDeclareVariable(int,   packed, , );   // 1 to write height and normal packed into surface instead of normals.
+rtDeclareVariable(int,   wrap, , );   // 1 if the patch is periodic, the borders take the opposite side as neighbours.
 
 RT_PROGRAM void calculate_normals()
 {
@@ -107,7 +200,10 @@ RT_PROGRAM void calculate_normals()
     unsigned int height = launch_dim.y;
 
     float2 slope;
-    if ( (x > 0u) && ( y > 0u ) && ( x < width-1u ) && ( y < height-1u ) ) {
+    if ( wrap ) {
+      slope.x = heights[ make_uint2( (x+1u) % width, y ) ]- heights[ make_uint2( (x+width-1u) % width, y ) ];
+      slope.y = heights[ make_uint2( x, (y+1u) % height ) ]- heights[ make_uint2( x, (y+height-1u) % height ) ];
+    } else if ( (x > 0u) && ( y > 0u ) && ( x < width-1u ) && ( y < height-1u ) ) {
       slope.x = heights[ make_uint2( x+1, y   ) ]- heights[ make_uint2( x-1, y   ) ];
       slope.y = heights[ make_uint2( x,   y+1 ) ]- heights[ make_uint2( x,   y-1 ) ];
     } else {
@@ -115,6 +211,60 @@ RT_PROGRAM void calculate_normals()
     }
     float3 normal = normalize( cross( make_float3( 0.0f,          slope.y*height_scale, 2.0f / width ),
                                       make_float3( 2.0f / height, slope.x*height_scale, 0.0f         ) ) );
-    normals[launch_index] = make_float4( normal, 0.0f );
+    if ( packed )
+      surface[launch_index] = pack_surface( heights[launch_index], normal );
+    else
+      normals[launch_index] = make_float4( normal, 0.0f );
+}
+
+
+
+/******************************************************************************\
+ * 
+ * Min/max pyramid over the heightfield cells
+ * 
+\******************************************************************************/
+rtBuffer<float2, 1>                    minmax;          // All levels, finest first.
+rtBuffer<unsigned int, 1>              minmax_offsets;  // First element of each level.
+rtDeclareVariable(unsigned int, minmax_level, , );
+
+// Heights as the renderer sees them, so the ranges stay conservative after packing.
+__device__ float node_height( uint2 node )
+{
+  return packed ? unpack_height( surface[ node ] ) : heights[ node ];
 }
 
+// Level 0 holds the height range of each cell, every further level the range of 2x2 cells below it.
+RT_PROGRAM void build_minmax()
+{
+    unsigned int x = launch_index.x;
+    unsigned int y = launch_index.y;
+
+    float2 range;
+    if ( minmax_level == 0u ) {
+      unsigned int x1 = ( x+1u ) % heights.size().x;
+      unsigned int y1 = ( y+1u ) % heights.size().y;
+      float d00 = node_height( make_uint2( x,  y  ) );
+      float d01 = node_height( make_uint2( x,  y1 ) );
+      float d10 = node_height( make_uint2( x1, y  ) );
+      float d11 = node_height( make_uint2( x1, y1 ) );
+      range = make_float2( fminf( fminf( d00, d01 ), fminf( d10, d11 ) ),
+                           fmaxf( fmaxf( d00, d01 ), fmaxf( d10, d11 ) ) );
+    } else {
+      unsigned int cells_x = heights.size().x - 1u + wrap;
+      unsigned int cells_y = heights.size().y - 1u + wrap;
+      unsigned int width   = ( ( cells_x - 1u ) >> ( minmax_level - 1u ) ) + 1u;
+      unsigned int height  = ( ( cells_y - 1u ) >> ( minmax_level - 1u ) ) + 1u;
+      unsigned int offset  = minmax_offsets[ minmax_level - 1u ];
+      unsigned int x0 = 2u*x, x1 = min( 2u*x+1u, width-1u );
+      unsigned int y0 = 2u*y, y1 = min( 2u*y+1u, height-1u );
+
+      float2 r00 = minmax[ offset + y0*width + x0 ];
+      float2 r01 = minmax[ offset + y1*width + x0 ];
+      float2 r10 = minmax[ offset + y0*width + x1 ];
+      float2 r11 = minmax[ offset + y1*width + x1 ];
+      range = make_float2( fminf( fminf( r00.x, r01.x ), fminf( r10.x, r11.x ) ),
+                           fmaxf( fmaxf( r00.y, r01.y ), fmaxf( r10.y, r11.y ) ) );
+    }
+    minmax[ minmax_offsets[ minmax_level ] + y*launch_dim.x + x ] = range;
+}
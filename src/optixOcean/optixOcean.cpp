@@ -43,11 +43,13 @@
 #include <GLFW/glfw3.h>
 
 #include <optixu/optixpp.h>
+#include <optixu/optixu_matrix.h>
 
 #include <sutil.h>
+#include <NvtxRange.h>
 #include <Camera.h>
 #include <SunSky.h>
-#include <random.h>
+#include "cost_heatmap.h"
 
 #include <cufft.h>
 #include <cuda_runtime.h>
@@ -55,8 +57,11 @@
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw_gl2.h>
 
+#include <algorithm>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <vector>
 #include <cfloat>
 #include <cstdlib>
 #include <cstring>
@@ -67,11 +72,15 @@ using namespace optixu;
 const char* const SAMPLE_NAME = "optixOcean";
 const unsigned int WIDTH  = 1024u;
 const unsigned int HEIGHT = 768u;
-const unsigned int HEIGHTFIELD_WIDTH  = 1024;
-const unsigned int HEIGHTFIELD_HEIGHT = 1024;
-const unsigned int FFT_WIDTH          = HEIGHTFIELD_WIDTH/2 + 1;
-const unsigned int FFT_HEIGHT         = HEIGHTFIELD_HEIGHT;
+const unsigned int HEIGHTFIELD_SIZE     = 1024;  // Initial nodes along each side of the square heightfield
+const unsigned int HEIGHTFIELD_SIZE_MIN = 128;   // Range of the frame budget controller
+const unsigned int HEIGHTFIELD_SIZE_MAX = 2048;
+const int          CONTROLLER_SETTLE_FRAMES = 30;  // Frames ignored after a resolution change
 const float PATCH_SIZE  = 100.0f;
+const float WIND_SPEED  = 10.0f;
+const float WIND_DIR    = M_PIf/3.0f;
+const float WAVE_SCALE  = .00000000775f;
+const int OCEAN_LOD_LEVELS = 5;   // Levels of detail of the tiled ocean, level l has cells of 2^l nodes
 
 //------------------------------------------------------------------------------
 //
@@ -81,6 +90,26 @@ const float PATCH_SIZE  = 100.0f;
 
 Context      context = 0;
 
+// While animating, trace and tonemap in one launch (entry 7) straight into the output buffer
+bool         fused_tonemap = false;
+
+// Bake the sky into a lat-long texture instead of evaluating it per escaping ray
+bool         bake_sky = false;
+
+// COST_HEATMAP_* mode of the camera cycles per pixel, and the cycles shown in red
+int          cost_heatmap = COST_HEATMAP_OFF;
+float        cost_scale = 1.0e6f;
+
+// Tiled ocean: ocean_tiles x ocean_tiles instances of the periodic patch under a Trbvh. Each tile uses
+// one of the per level geometry groups, chosen by its distance to the eye.
+int                         ocean_tiles = 1;
+Group                       ocean_group;
+float                       ocean_tile_size = 0.0f;
+std::vector<Transform>      ocean_tile_transforms;
+std::vector<float3>         ocean_tile_centers;
+std::vector<GeometryGroup>  ocean_lod_groups;
+std::vector<int>            ocean_tile_lods;
+
 
 
 //------------------------------------------------------------------------------
@@ -178,20 +207,162 @@ void destroyContext()
 // State for animating buffers
 struct RenderBuffers
 {
+    unsigned int size;   // Heightfield nodes along each side, the spectra are size/2+1 x size
+    Buffer h0;       // Initial spectrum
     Buffer ht;       // Frequency domain heights
     Buffer heights;
     Buffer normals;
+    Buffer surface;  // Packed half height and oct-encoded normal, replaces normals when packed is set
+    Buffer minmax;   // Height range pyramid over the heightfield cells
+    Buffer choppy_fft;   // FFT output in choppy mode: heights, x and z displacements stacked in y
     int optix_device_ordinal;
+    bool packed;
+    bool choppy;
+
+    Program            minmax_program;
+    Program            resolve_program;
+    std::vector<uint2> minmax_dims;  // Nodes of each pyramid level
+    Buffer             minmax_offsets;
+    Geometry           geometry;
+
+    // The C2R plan is kept across frames, creating it allocates the work area every time.
+    cufftHandle  fft_plan;
+    cudaStream_t fft_stream;
+    RTsize       fft_width;   // Heightfield size the plan was created for, 0 if there is no plan.
+    RTsize       fft_height;
+
+    // Overlapped mode: the next frame is simulated into heights/normals while the camera renders the
+    // second pair, the pairs are swapped between frames.
+    bool             overlap;
+    bool             fft_pending;   // The FFT into heights is still running on fft_stream.
+    Buffer           render_heights;
+    Buffer           render_normals;
+    Buffer           render_surface;
+    Buffer           render_minmax;
+    Program          normals_program;
+    std::vector<GeometryInstance> heightfields;   // One per level of detail
+
+    RenderBuffers() : size( 0 ), optix_device_ordinal( -1 ), packed( false ), choppy( false ), fft_plan( 0 ), fft_stream( 0 ), fft_width( 0 ), fft_height( 0 ),
+                      overlap( false ), fft_pending( false ) {}
 };
 
 
+// Creates the FFT plan and its stream, or recreates the plan if the heightfield size changed.
+void updateFftPlan( RenderBuffers& buffers )
+{
+    RTsize width, height;
+    buffers.heights->getSize( width, height );
+    if ( width == buffers.fft_width && height == buffers.fft_height )
+        return;
+
+    if ( !buffers.fft_stream )
+        cutilSafeCall( cudaStreamCreateWithFlags( &buffers.fft_stream, cudaStreamNonBlocking ) );
+    if ( buffers.fft_width != 0 )
+        cufftSafeCall( cufftDestroy( buffers.fft_plan ) );
+
+    // Choppy mode transforms the height and both displacement spectra as one batch
+    int n[2] = { static_cast<int>( width ), static_cast<int>( height ) };
+    cufftSafeCall( cufftPlanMany( &buffers.fft_plan, 2, n, NULL, 1, 0, NULL, 1, 0, CUFFT_C2R, buffers.choppy ? 3 : 1 ) );
+    cufftSafeCall( cufftSetStream( buffers.fft_plan, buffers.fft_stream ) );
+    buffers.fft_width  = width;
+    buffers.fft_height = height;
+}
+
+
+void destroyFftPlan( RenderBuffers& buffers )
+{
+    if ( buffers.fft_width != 0 ) {
+        cufftSafeCall( cufftDestroy( buffers.fft_plan ) );
+        buffers.fft_width = buffers.fft_height = 0;
+    }
+    if ( buffers.fft_stream ) {
+        cutilSafeCall( cudaStreamSynchronize( buffers.fft_stream ) );
+        cutilSafeCall( cudaStreamDestroy( buffers.fft_stream ) );
+        buffers.fft_stream = 0;
+    }
+}
+
+
+// The cells span the fixed patch, their size follows the resolution
+void updateCellSize( RenderBuffers& buffers )
+{
+    const float3 min = buffers.geometry["boxmin"]->getFloat3();
+    const float3 max = buffers.geometry["boxmax"]->getFloat3();
+    const unsigned int wrap = ocean_tiles > 1 ? 1u : 0u;
+
+    // If buffer is nx by nz, we have nx-1 by nz-1 cells, or nx by nz if the patch wraps around
+    const float cells = static_cast<float>( buffers.size - 1u + wrap );
+    float3 cellsize = ( max - min ) / make_float3( cells, 1.0f, cells );
+    cellsize.y = 1;
+    float3 inv_cellsize = make_float3(1)/cellsize;
+    buffers.geometry["cellsize"]->setFloat(cellsize);
+    buffers.geometry["inv_cellsize"]->setFloat(inv_cellsize);
+    context["displacement_scale"]->setFloat(inv_cellsize.x);
+}
+
+
+// Sizes everything that depends on the heightfield resolution: the spectra, the FFT output, both
+// heightfield pairs, the min/max pyramid and the FFT plan.  The contents are undefined afterwards,
+// the caller regenerates the initial spectrum.
+void setHeightfieldSize( RenderBuffers& buffers, unsigned int size )
+{
+    if ( buffers.fft_pending ) {
+        cutilSafeCall( cudaStreamSynchronize( buffers.fft_stream ) );
+        buffers.fft_pending = false;
+    }
+    buffers.size = size;
+
+    const unsigned int spectra = buffers.choppy ? 3u : 1u;
+    buffers.h0->setSize( size/2 + 1, size );
+    buffers.ht->setSize( size/2 + 1, size*spectra );
+    if ( buffers.choppy )
+        buffers.choppy_fft->setSize( size, size*spectra );
+
+    const RTsize normals_size = buffers.packed ? 1u : size;
+    const RTsize surface_size = buffers.packed ? size : 1u;
+    buffers.heights->setSize( size, size );
+    buffers.normals->setSize( normals_size, normals_size );
+    buffers.surface->setSize( surface_size, surface_size );
+
+    const unsigned int wrap = ocean_tiles > 1 ? 1u : 0u;
+    std::vector<unsigned int> minmax_offsets;
+    unsigned int minmax_size = 0;
+    buffers.minmax_dims.clear();
+    for ( unsigned int level = 0; ; ++level ) {
+        const uint2 dims = make_uint2( ( ( size - 2u + wrap ) >> level ) + 1u,
+                                       ( ( size - 2u + wrap ) >> level ) + 1u );
+        buffers.minmax_dims.push_back( dims );
+        minmax_offsets.push_back( minmax_size );
+        minmax_size += dims.x * dims.y;
+        if ( dims.x == 1u && dims.y == 1u )
+            break;
+    }
+    buffers.minmax_offsets->setSize( minmax_offsets.size() );
+    memcpy( buffers.minmax_offsets->map(), &minmax_offsets[0], minmax_offsets.size() * sizeof( unsigned int ) );
+    buffers.minmax_offsets->unmap();
+    buffers.minmax->setSize( minmax_size );
+    context["minmax_top"]->setInt( static_cast<int>( buffers.minmax_dims.size() ) - 1 );
+
+    if ( buffers.overlap ) {
+        buffers.render_heights->setSize( size, size );
+        buffers.render_normals->setSize( normals_size, normals_size );
+        buffers.render_surface->setSize( surface_size, surface_size );
+        buffers.render_minmax->setSize( minmax_size );
+    }
+
+    if ( buffers.geometry )
+        updateCellSize( buffers );
+    updateFftPlan( buffers );
+}
+
+
 void createContext( bool use_pbo, RenderBuffers& buffers )
 {
     // Set up context
     context = Context::create();
     
     context->setRayTypeCount( 1 );
-    context->setEntryPointCount( 4 );
+    context->setEntryPointCount( 8 );
     context->setStackSize( 600 );
 
     context["scene_epsilon"       ]->setFloat( 1.e-3f );
@@ -199,86 +370,132 @@ void createContext( bool use_pbo, RenderBuffers& buffers )
         
     // Exception program
     std::string ptx_path = ptxPath( "accum_camera.cu" );
-    Program exception_program = context->createProgramFromPTXFile( ptx_path, "exception" );
+    Program exception_program = sutil::createProgramFromPTXFile( context, ptx_path, "exception" );
     context->setExceptionProgram( 0, exception_program );
     context["bad_color"]->setFloat( 1.0f, 0.0f, 1.0f );
 
     // Ray gen program for raytracing camera
-    Program ray_gen_program = context->createProgramFromPTXFile( ptx_path, "pinhole_camera" );
+    Program ray_gen_program = sutil::createProgramFromPTXFile( context, ptx_path, "pinhole_camera" );
     context->setRayGenerationProgram( 0, ray_gen_program );
+    context->setRayGenerationProgram( 7, sutil::createProgramFromPTXFile( context, ptx_path, "pinhole_camera_tonemapped" ) );
+    context->setExceptionProgram( 7, exception_program );
     Buffer output_buffer = sutil::createOutputBuffer( context, RT_FORMAT_UNSIGNED_BYTE4, WIDTH, HEIGHT, use_pbo );
     context["output_buffer"]->set( output_buffer ); 
     Buffer accum_buffer = context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT4, WIDTH, HEIGHT );
     context["accum_buffer"]->set( accum_buffer ); 
     context["pre_image"]->set( accum_buffer ); 
     context["frame"]->setUint( 0u ); 
+    context["cost_buffer"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT, WIDTH, HEIGHT ) );
+    context["use_cost_heatmap"]->setInt( cost_heatmap );
+    context["cost_scale"]->setFloat( cost_scale );
 
     // Preetham sky model
     ptx_path = ptxPath( "ocean_render.cu" );
-    context->setMissProgram( 0, context->createProgramFromPTXFile( ptx_path, "miss" ) );
+    context->setMissProgram( 0, sutil::createProgramFromPTXFile( context, ptx_path, "miss" ) );
     context["cutoff_color" ]->setFloat( 0.07f, 0.18f, 0.3f );
 
     // Ray gen program for heightfield update
     ptx_path = ptxPath( "ocean_sim.cu" );
-    Program data_gen_program = context->createProgramFromPTXFile( ptx_path, "generate_spectrum" );
+    Program data_gen_program = sutil::createProgramFromPTXFile( context, ptx_path, "generate_spectrum" );
     context->setRayGenerationProgram( 1, data_gen_program );
     context["patch_size"]->setFloat( PATCH_SIZE );
     context["t"]->setFloat( 0.0f );
-    Buffer h0_buffer = context->createBuffer( RT_BUFFER_INPUT,  RT_FORMAT_FLOAT2, FFT_WIDTH, FFT_HEIGHT );
-    buffers.ht = context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT2, FFT_WIDTH, FFT_HEIGHT ); 
-    Buffer ik_ht_buffer = context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT2, FFT_WIDTH, FFT_HEIGHT ); 
-    context["h0"]->set( h0_buffer ); 
+    context["choppy"]->setInt( buffers.choppy ? 1 : 0 );
+    // All buffers depending on the resolution are sized by setHeightfieldSize()
+    buffers.h0 = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT2, 1u, 1u );
+    buffers.ht = context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT2, 1u, 1u ); 
+    context["h0"]->set( buffers.h0 ); 
     context["ht"]->set( buffers.ht ); 
-    context["ik_ht"]->set( ik_ht_buffer ); 
+
+    // Ray gen program for the initial spectrum, rerun when the wind changes
+    Program h0_program = sutil::createProgramFromPTXFile( context, ptx_path, "generate_h0" );
+    context->setRayGenerationProgram( 6, h0_program );
+    context["wave_scale"]->setFloat( WAVE_SCALE );
+    context["h0_seed"   ]->setUint( 0xDEADBEEFu );
+
+    // Ray gen program resampling the heights at the displaced positions
+    Program resolve_program = sutil::createProgramFromPTXFile( context, ptx_path, "resolve_choppy" );
+    context->setRayGenerationProgram( 5, resolve_program );
+    buffers.resolve_program = resolve_program;
+    buffers.choppy_fft = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT, 1u, 1u );
+    context["choppy_fft"]->set( buffers.choppy_fft );
+    context["choppiness"]->setFloat( 1.0f );
     
     //Ray gen program for normal calculation
-    Program normal_program = context->createProgramFromPTXFile( ptx_path, "calculate_normals" );
+    Program normal_program = sutil::createProgramFromPTXFile( context, ptx_path, "calculate_normals" );
     context->setRayGenerationProgram( 2, normal_program );
     context["height_scale"]->setFloat( 0.5f );
-    // Could pack heights and normals together, but that would preclude using fft_output directly as height_buffer.
-    buffers.heights   = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT,
-                                             HEIGHTFIELD_WIDTH,
-                                             HEIGHTFIELD_HEIGHT );
-    buffers.normals = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4,
-                                             HEIGHTFIELD_WIDTH,
-                                             HEIGHTFIELD_HEIGHT );
+    // The FFT writes heights directly. In packed mode calculate_normals also copies them, at half precision
+    // next to the oct-encoded normal, into surface, which is all the renderer fetches.
+    buffers.heights = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT, 1u, 1u );
+    buffers.normals = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1u, 1u );
+    buffers.surface = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_SHORT4, 1u, 1u );
 
     context["heights"]->set(buffers.heights);
     context["normals"]->set(buffers.normals );
+    context["surface"]->set(buffers.surface );
+    context["packed" ]->setInt( buffers.packed ? 1 : 0 );
+    buffers.normals_program = normal_program;
+
+    // A tiled patch is periodic, its last cells wrap around to the first nodes
+    const unsigned int wrap = ocean_tiles > 1 ? 1u : 0u;
+    context["wrap"]->setInt( static_cast<int>( wrap ) );
+    context["lod" ]->setInt( 0 );
+
+    // Ray gen program for the min/max pyramid, level 0 has one node per cell
+    Program minmax_program = sutil::createProgramFromPTXFile( context, ptx_path, "build_minmax" );
+    context->setRayGenerationProgram( 4, minmax_program );
+    buffers.minmax_program = minmax_program;
+    buffers.minmax_offsets = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, 1u );
+    buffers.minmax = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT2, 1u );
+
+    context["minmax"        ]->set( buffers.minmax );
+    context["minmax_offsets"]->set( buffers.minmax_offsets );
+    context["minmax_level"  ]->setUint( 0u );
+
+    if ( buffers.overlap ) {
+        buffers.render_heights = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT, 1u, 1u );
+        buffers.render_normals = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1u, 1u );
+        buffers.render_surface = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_SHORT4, 1u, 1u );
+        buffers.render_minmax = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT2, 1u );
+        normal_program["heights"]->set( buffers.heights );
+        normal_program["normals"]->set( buffers.normals );
+        normal_program["surface"]->set( buffers.surface );
+        minmax_program["heights"]->set( buffers.heights );
+        minmax_program["surface"]->set( buffers.surface );
+        minmax_program["minmax" ]->set( buffers.minmax );
+        resolve_program["heights"]->set( buffers.heights );
+    }
 
     // Ray gen program for tonemap
     ptx_path = ptxPath( "tonemap.cu" );
-    Program tonemap_program = context->createProgramFromPTXFile( ptx_path, "tonemap" );
+    Program tonemap_program = sutil::createProgramFromPTXFile( context, ptx_path, "tonemap" );
     context->setRayGenerationProgram( 3, tonemap_program );
     context["f_exposure"]->setFloat( 0.0f );
-    
+
+    // The CUDA device has to be selected before the FFT plan is created on it
+    buffers.optix_device_ordinal = initSingleDevice();
+    setHeightfieldSize( buffers, HEIGHTFIELD_SIZE );
 }
 
-void createGeometry()
+void createGeometry( RenderBuffers& buffers )
 {
   Geometry heightfield = context->createGeometry();
   heightfield->setPrimitiveCount( 1u );
 
   const std::string ptx_path = ptxPath( "ocean_render.cu" );
-  heightfield->setBoundingBoxProgram(  context->createProgramFromPTXFile( ptx_path, "bounds" ) );
-  heightfield->setIntersectionProgram( context->createProgramFromPTXFile( ptx_path, "intersect" ) );
+  heightfield->setBoundingBoxProgram(  sutil::createProgramFromPTXFile( context, ptx_path, "bounds" ) );
+  heightfield->setIntersectionProgram( sutil::createProgramFromPTXFile( context, ptx_path, "intersect" ) );
   float3 min = make_float3( -2.0f, -0.2f, -2.0f );
   float3 max = make_float3(  2.0f,  0.2f,  2.0f );
-  const RTsize nx = HEIGHTFIELD_WIDTH;
-  const RTsize nz = HEIGHTFIELD_HEIGHT;
-  
-  // If buffer is nx by nz, we have nx-1 by nz-1 cells;
-  float3 cellsize = (max - min) / (make_float3(static_cast<float>(nx-1), 1.0f, static_cast<float>(nz-1)));
-  cellsize.y = 1;
-  float3 inv_cellsize = make_float3(1)/cellsize;
   heightfield["boxmin"]->setFloat(min);
   heightfield["boxmax"]->setFloat(max);
-  heightfield["cellsize"]->setFloat(cellsize);
-  heightfield["inv_cellsize"]->setFloat(inv_cellsize);
+  buffers.geometry = heightfield;
+  updateCellSize( buffers );
 
   // Create material
   Material heightfield_matl = context->createMaterial();
-  Program water_ch = context->createProgramFromPTXFile( ptx_path, "closest_hit_radiance" );
+  Program water_ch = sutil::createProgramFromPTXFile( context, ptx_path, "closest_hit_radiance" );
 
   heightfield_matl["fresnel_exponent"   ]->setFloat( 4.0f );
   heightfield_matl["fresnel_minimum"    ]->setFloat( 0.05f );
@@ -291,15 +508,74 @@ void createGeometry()
   heightfield_matl->setClosestHitProgram( 0, water_ch);
 
 
-  GeometryInstance gi = context->createGeometryInstance( heightfield, &heightfield_matl, &heightfield_matl+1 );
-  
-  GeometryGroup geometrygroup = context->createGeometryGroup();
-  geometrygroup->setChildCount( 1 );
-  geometrygroup->setChild( 0, gi );
+  // One instance per level of detail, they share the geometry and the buffers. HEIGHTFIELD_SIZE_MIN
+  // still has OCEAN_LOD_LEVELS pyramid levels, so the count holds when the resolution changes.
+  const int lod_levels = ocean_tiles > 1 ? std::min( OCEAN_LOD_LEVELS, static_cast<int>( buffers.minmax_dims.size() ) ) : 1;
+  for ( int level = 0; level < lod_levels; ++level ) {
+    GeometryInstance gi = context->createGeometryInstance( heightfield, &heightfield_matl, &heightfield_matl+1 );
+    gi["lod"]->setInt( level );
+    if ( buffers.overlap ) {
+      gi["heights"]->set( buffers.render_heights );
+      gi["normals"]->set( buffers.render_normals );
+      gi["surface"]->set( buffers.render_surface );
+      gi["minmax" ]->set( buffers.render_minmax );
+    }
+    buffers.heightfields.push_back( gi );
+
+    GeometryGroup geometrygroup = context->createGeometryGroup();
+    geometrygroup->setChildCount( 1 );
+    geometrygroup->setChild( 0, gi );
+    geometrygroup->setAcceleration( context->createAcceleration("NoAccel","NoAccel") );
+    ocean_lod_groups.push_back( geometrygroup );
+  }
+
+  if ( ocean_tiles <= 1 ) {
+    context["top_object"]->set( ocean_lod_groups[0] );
+    return;
+  }
 
-  geometrygroup->setAcceleration( context->createAcceleration("NoAccel","NoAccel") );
-  
-  context["top_object"]->set( geometrygroup );
+  // Tiles of the periodic patch centered on the origin, the levels are assigned by updateOceanLod()
+  ocean_tile_size = max.x - min.x;
+  ocean_group = context->createGroup();
+  ocean_group->setAcceleration( context->createAcceleration("Trbvh","Bvh") );
+  for ( int j = 0; j < ocean_tiles; ++j ) {
+    for ( int i = 0; i < ocean_tiles; ++i ) {
+      const float3 offset = make_float3( ( i - 0.5f*(ocean_tiles-1) ) * ocean_tile_size, 0.0f,
+                                         ( j - 0.5f*(ocean_tiles-1) ) * ocean_tile_size );
+      Transform tile = context->createTransform();
+      tile->setMatrix( false, Matrix4x4::translate( offset ).getData(), 0 );
+      tile->setChild( ocean_lod_groups[0] );
+      ocean_group->addChild( tile );
+      ocean_tile_transforms.push_back( tile );
+      ocean_tile_centers.push_back( offset + 0.5f*(min+max) );
+      ocean_tile_lods.push_back( 0 );
+    }
+  }
+  context["top_object"]->set( ocean_group );
+}
+
+
+// Picks the level of detail of each ocean tile, one level coarser per doubling of the distance
+// beyond one tile.
+void updateOceanLod()
+{
+  if ( ocean_tiles <= 1 )
+    return;
+
+  const float3 eye = context["eye"]->getFloat3();
+  bool changed = false;
+  for ( size_t i = 0; i < ocean_tile_transforms.size(); ++i ) {
+    const float distance = length( ocean_tile_centers[i] - eye ) / ocean_tile_size;
+    int level = distance > 1.0f ? static_cast<int>( floorf( log2f( distance ) ) ) : 0;
+    level = std::min( level, static_cast<int>( ocean_lod_groups.size() ) - 1 );
+    if ( level != ocean_tile_lods[i] ) {
+      ocean_tile_transforms[i]->setChild( ocean_lod_groups[level] );
+      ocean_tile_lods[i] = level;
+      changed = true;
+    }
+  }
+  if ( changed )
+    ocean_group->getAcceleration()->markDirty();
 }
 
 
@@ -312,85 +588,195 @@ void createLights()
     sun_sky.setSunTheta( 1.2f );
     sun_sky.setSunPhi( 0.0f );
     sun_sky.setTurbidity( 2.2f );
+    if( bake_sky )
+        sun_sky.setSkyTexture( 512u, 256u );
     sun_sky.setVariables( context );
 
 }
 
-// Phillips spectrum
-// Vdir - wind angle in radians
-// V - wind speed
-float phillips(float Kx, float Ky, float Vdir, float V, float A)
+// Generates the initial heightfield in frequency space for the given wind (speed, angle in radians)
+void generateH0( RenderBuffers& buffers, float wind_speed, float wind_dir )
 {
-  const float g = 9.81f;            // gravitational constant
-
-  float k_squared = Kx * Kx + Ky * Ky;
-  float k_x = Kx / sqrtf(k_squared);
-  float k_y = Ky / sqrtf(k_squared);
-  float L = V * V / g;
-  float w_dot_k = k_x * cosf(Vdir) + k_y * sinf(Vdir);
-
-  if (k_squared == 0.0f ) return 0.0f;
-  return A * expf( -1.0f / (k_squared * L * L) ) / (k_squared * k_squared) * w_dot_k * w_dot_k;
+  context["wind_speed"]->setFloat( wind_speed );
+  context["wind_dir"  ]->setFloat( wind_dir );
+  context->launch( 6, buffers.size/2 + 1, buffers.size );
 }
 
-// Generate initial heightfield in frequency space
-void generateH0( float2* h_h0 )
+
+// Computes the normals of new heights and rebuilds the min/max pyramid over them. In choppy mode the
+// heights are first resampled from the FFT output at the displaced positions.
+void launchNormals( RenderBuffers& buffers )
 {
-  unsigned int seed = 0xDEADBEEF;
-  for (unsigned int y = 0u; y < FFT_HEIGHT; y++) {
-    for (unsigned int x = 0u; x < FFT_WIDTH; x++) {
-      float kx = M_PIf * x / PATCH_SIZE;
-      float ky = 2.0f * M_PIf * y / PATCH_SIZE;
-
-      float Er = 2.0f * rnd( seed ) - 1.0f;
-      float Ei = 2.0f * rnd( seed ) - 1.0f;
-
-      // These can be made user-adjustable
-      const float wave_scale = .00000000775f;
-      const float wind_speed = 10.0f;     
-      const float wind_dir   = M_PIf/3.0f;   
-
-      float P = sqrtf( phillips( kx, ky, wind_dir, wind_speed, wave_scale ) );
-
-
-      float h0_re = 1.0f / sqrtf(2.0f) * Er * P;
-      float h0_im = 1.0f / sqrtf(2.0f) * Ei * P;
-
-      int i = y*FFT_WIDTH+x;
-      h_h0[i].x = h0_re;
-      h_h0[i].y = h0_im;
-      
-      if(x == 0) {
-        h_h0[i].x = h_h0[i].y = 0.0f;
-      }
-      
+    if ( buffers.choppy )
+        context->launch( 5, buffers.size, buffers.size );
+    context->launch( 2, buffers.size, buffers.size );
+
+    for ( unsigned int level = 0; level < buffers.minmax_dims.size(); ++level ) {
+        context["minmax_level"]->setUint( level );
+        context->launch( 4, buffers.minmax_dims[level].x, buffers.minmax_dims[level].y );
     }
-  }
 }
 
 
-void updateHeightfield( float anim_time, RenderBuffers buffers )
+// Runs the spectrum, the FFT into heights and, if wait is set, the normals.  Otherwise the FFT is left
+// running on fft_stream.
+void simulateHeightfield( float anim_time, RenderBuffers& buffers, bool wait )
 {
 
     static const float ANIM_SCALE = 0.25f;
     context["t"]->setFloat( static_cast<float>(anim_time) * (-0.5f) * ANIM_SCALE );
 
     // Generate_spectrum
-    context->launch( 1, FFT_WIDTH, FFT_HEIGHT );
+    context->launch( 1, buffers.size/2 + 1, buffers.size );
 
     // Transform results directly into OptiX buffer using CUFFT
 
     cufftComplex* ht_buffer_device_ptr = static_cast<cufftComplex*>( buffers.ht->getDevicePointer( buffers.optix_device_ordinal ) );
-    cufftReal* height_buffer_device_ptr = static_cast<cufftReal*>( buffers.heights->getDevicePointer( buffers.optix_device_ordinal ) );
+    Buffer fft_output = buffers.choppy ? buffers.choppy_fft : buffers.heights;
+    cufftReal* height_buffer_device_ptr = static_cast<cufftReal*>( fft_output->getDevicePointer( buffers.optix_device_ordinal ) );
 
-    cufftHandle fft_plan;
-    cufftSafeCall( cufftPlan2d( &fft_plan, HEIGHTFIELD_WIDTH, HEIGHTFIELD_HEIGHT, CUFFT_C2R) );
-    cufftSafeCall( cufftExecC2R( fft_plan, ht_buffer_device_ptr, height_buffer_device_ptr ) );
-
-    cufftSafeCall( cufftDestroy( fft_plan ) );
+    updateFftPlan( buffers );
+    cufftSafeCall( cufftExecC2R( buffers.fft_plan, ht_buffer_device_ptr, height_buffer_device_ptr ) );
+    buffers.fft_pending = !wait;
+    if ( !wait )
+        return;
+    cutilSafeCall( cudaStreamSynchronize( buffers.fft_stream ) );
 
     // Calculate normals for new heights
-    context->launch( 2, HEIGHTFIELD_WIDTH, HEIGHTFIELD_HEIGHT );
+    launchNormals( buffers );
+}
+
+
+void updateHeightfield( float anim_time, RenderBuffers& buffers )
+{
+    SUTIL_NVTX_RANGE( "updateHeightfield" );
+
+    if ( !buffers.overlap ) {
+        simulateHeightfield( anim_time, buffers, true );
+        return;
+    }
+
+    // Finish the frame simulated during the previous render, the first one is simulated right away
+    if ( buffers.fft_pending ) {
+        cutilSafeCall( cudaStreamSynchronize( buffers.fft_stream ) );
+        buffers.fft_pending = false;
+        launchNormals( buffers );
+    } else {
+        simulateHeightfield( anim_time, buffers, true );
+    }
+
+    std::swap( buffers.heights, buffers.render_heights );
+    std::swap( buffers.normals, buffers.render_normals );
+    std::swap( buffers.surface, buffers.render_surface );
+    std::swap( buffers.minmax,  buffers.render_minmax );
+    for ( size_t i = 0; i < buffers.heightfields.size(); ++i ) {
+        buffers.heightfields[i]["heights"]->set( buffers.render_heights );
+        buffers.heightfields[i]["normals"]->set( buffers.render_normals );
+        buffers.heightfields[i]["surface"]->set( buffers.render_surface );
+        buffers.heightfields[i]["minmax" ]->set( buffers.render_minmax );
+    }
+    buffers.normals_program["heights"]->set( buffers.heights );
+    buffers.normals_program["normals"]->set( buffers.normals );
+    buffers.normals_program["surface"]->set( buffers.surface );
+    buffers.minmax_program["heights"]->set( buffers.heights );
+    buffers.minmax_program["surface"]->set( buffers.surface );
+    buffers.minmax_program["minmax" ]->set( buffers.minmax );
+    buffers.resolve_program["heights"]->set( buffers.heights );
+
+    // The FFT of the next frame overlaps with the camera launches of this one
+    simulateHeightfield( anim_time, buffers, false );
+}
+
+
+// Picks the heightfield resolution from the measured frame time. The resolution is halved when the
+// smoothed frame time exceeds the budget and doubled when the frame would still fit with four times
+// the simulation cost.
+struct SimulationController
+{
+    double budget;       // Seconds per frame, 0 keeps the resolution fixed
+    double frame_time;   // Smoothed simulation and rendering time, without waiting for the swap
+    double sim_time;     // Smoothed simulation time
+    int    settle;       // Frames left to ignore, the first ones after a change include the reallocation
+
+    SimulationController() : budget( 0.0 ), frame_time( 0.0 ), sim_time( 0.0 ), settle( CONTROLLER_SETTLE_FRAMES ) {}
+
+    // Returns the resolution for the next frame
+    unsigned int update( unsigned int size, double frame, double sim )
+    {
+        if ( budget <= 0.0 )
+            return size;
+        if ( settle > 0 ) {
+            --settle;
+            frame_time = frame;
+            sim_time   = sim;
+            return size;
+        }
+        frame_time += 0.1 * ( frame - frame_time );
+        sim_time   += 0.1 * ( sim - sim_time );
+
+        unsigned int next = size;
+        if ( frame_time > budget && size > HEIGHTFIELD_SIZE_MIN )
+            next = size / 2u;
+        else if ( frame_time + 3.0 * sim_time < 0.8 * budget && size < HEIGHTFIELD_SIZE_MAX )
+            next = size * 2u;
+        if ( next != size )
+            settle = CONTROLLER_SETTLE_FRAMES;
+        return next;
+    }
+};
+
+SimulationController simulation_controller;
+
+
+// Flies the camera around the patch with fixed animation steps and reports the simulation ( spectrum,
+// FFT, normals ) and render ( camera, tonemap ) times separately. The launches are synchronous, so the
+// host timer measures the GPU work. In overlap mode the FFT left running during the render is counted
+// by the wait of the next simulation.
+void runBenchmark( RenderBuffers& buffers, unsigned int frames )
+{
+    static const unsigned int WARMUP_FRAMES = 10;
+    static const float        ANIM_STEP     = 1.0f / 60.0f;
+
+    double sim_seconds    = 0.0;
+    double render_seconds = 0.0;
+    for ( unsigned int frame = 0; frame < WARMUP_FRAMES + frames; ++frame ) {
+        // One orbit at the height and distance of the default view
+        const float angle = 2.0f * M_PIf * frame / static_cast<float>( WARMUP_FRAMES + frames );
+        const float3 eye    = make_float3( 1.7f * cosf( angle ), 0.284192f, 1.7f * sinf( angle ) );
+        const float3 lookat = make_float3( 0.0f, 0.0f, 0.0f );
+        const float3 up     = make_float3( 0.0f, 1.0f, 0.0f );
+        float3 U, V, W;
+        sutil::calculateCameraVariables( eye, lookat, up, 45.0f, static_cast<float>( WIDTH ) / HEIGHT, U, V, W, true );
+        context["eye"]->setFloat( eye );
+        context["U"  ]->setFloat( U );
+        context["V"  ]->setFloat( V );
+        context["W"  ]->setFloat( W );
+
+        const double start = sutil::currentTime();
+        updateHeightfield( -ANIM_STEP * frame, buffers );
+        const double simulated = sutil::currentTime();
+
+        updateOceanLod();
+        context["frame"]->setUint( 0u );
+        if ( fused_tonemap ) {
+            context->launch( 7, WIDTH, HEIGHT );
+        } else {
+            context->launch( 0, WIDTH, HEIGHT );
+            context->launch( 3, WIDTH, HEIGHT );
+        }
+        const double rendered = sutil::currentTime();
+
+        if ( frame >= WARMUP_FRAMES ) {
+            sim_seconds    += simulated - start;
+            render_seconds += rendered - simulated;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision( 3 ) << "BENCHMARK " << SAMPLE_NAME << " " << WIDTH << "x" << HEIGHT
+              << " heightfield=" << buffers.size << " frames=" << frames
+              << " sim_ms_per_frame=" << sim_seconds * 1000.0 / frames
+              << " render_ms_per_frame=" << render_seconds * 1000.0 / frames
+              << " total_ms_per_frame=" << ( sim_seconds + render_seconds ) * 1000.0 / frames << std::endl;
 }
 
 
@@ -463,6 +849,7 @@ void windowSizeCallback( GLFWwindow* window, int w, int h )
 
     sutil::resizeBuffer( getOutputBuffer(), width, height );
     sutil::resizeBuffer( context[ "accum_buffer" ]->getBuffer(), width, height );
+    sutil::resizeBuffer( context[ "cost_buffer" ]->getBuffer(), width, height );
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -504,6 +891,9 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, RenderBuffers& buffers
     unsigned int frame_count = 0;
     unsigned int accumulation_frame = 0;
     bool do_animate = true;
+    float wind_speed = WIND_SPEED;
+    float wind_dir   = WIND_DIR;
+    float choppiness = 1.0f;
 
     double previous_time = sutil::currentTime();
     double anim_time = 0.0f;
@@ -551,14 +941,44 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, RenderBuffers& buffers
 
             if ( ImGui::Checkbox( "animate", &do_animate ) ) {
                 previous_time = sutil::currentTime();
+                // the fused path leaves accum_buffer untouched
+                accumulation_frame = 0;
             }
 
+            bool sea_state_changed = false;
+            bool wind_changed = ImGui::SliderFloat( "wind speed", &wind_speed, 1.0f, 30.0f );
+            wind_changed |= ImGui::SliderFloat( "wind direction", &wind_dir, 0.0f, 2.0f*M_PIf );
+            if ( wind_changed ) {
+                generateH0( buffers, wind_speed, wind_dir );
+                sea_state_changed = true;
+            }
+            if ( buffers.choppy && ImGui::SliderFloat( "choppiness", &choppiness, 0.0f, 2.0f ) ) {
+                context["choppiness"]->setFloat( choppiness );
+                sea_state_changed = true;
+            }
+            if ( sea_state_changed && !do_animate ) {
+                updateHeightfield( static_cast<float>( anim_time ), buffers );
+                accumulation_frame = 0;
+            }
+            if ( ImGui::Combo( "cost heatmap", &cost_heatmap, "off\0frame\0average\0\0" ) ) {
+                context["use_cost_heatmap"]->setInt( cost_heatmap );
+                accumulation_frame = 0;
+            }
+            if ( cost_heatmap != COST_HEATMAP_OFF &&
+                 ImGui::SliderFloat( "cost scale", &cost_scale, 1.0e4f, 1.0e8f, "%.0f cycles", 4.0f ) ) {
+                context["cost_scale"]->setFloat( cost_scale );
+            }
+            if ( simulation_controller.budget > 0.0 )
+                ImGui::Text( "simulation %u x %u", buffers.size, buffers.size );
+
             ImGui::End();
         }
 
         // imgui pops
         ImGui::PopStyleVar( 3 );
 
+        const double frame_start = sutil::currentTime();
+        double sim_seconds = 0.0;
         if ( do_animate ) {
             // update animation time
             const double current_time = sutil::currentTime();
@@ -566,17 +986,35 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, RenderBuffers& buffers
             previous_time = current_time;
 
             updateHeightfield( static_cast<float>( anim_time ), buffers );
+            sim_seconds = sutil::currentTime() - current_time;
             accumulation_frame = 0;
         }
 
         // Render main window
+        updateOceanLod();
         context["frame"]->setUint( accumulation_frame++ );
-        context->launch( 0, camera.width(), camera.height() );
-
-        // Tonemap
-        context->launch( 3, camera.width(), camera.height() );
+        SUTIL_NVTX_PUSH( "launch" );
+        if ( fused_tonemap && do_animate ) {
+            context->launch( 7, camera.width(), camera.height() );
+        } else {
+            context->launch( 0, camera.width(), camera.height() );
+
+            // Tonemap, unless the camera launch already wrote the heatmap
+            if ( cost_heatmap == COST_HEATMAP_OFF )
+                context->launch( 3, camera.width(), camera.height() );
+        }
+        SUTIL_NVTX_POP();
         sutil::displayBufferGL( getOutputBuffer() );
 
+        // The launches are synchronous, so this is the GPU time of the frame
+        if ( do_animate ) {
+            const unsigned int size = simulation_controller.update( buffers.size, sutil::currentTime() - frame_start, sim_seconds );
+            if ( size != buffers.size ) {
+                setHeightfieldSize( buffers, size );
+                generateH0( buffers, wind_speed, wind_dir );
+            }
+        }
+
         // Render gui over it
         ImGui::Render();
         ImGui_ImplGlfwGL2_RenderDrawData(ImGui::GetDrawData());
@@ -584,6 +1022,7 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, RenderBuffers& buffers
         glfwSwapBuffers( window );
     }
     
+    destroyFftPlan( buffers );
     destroyContext();
     glfwDestroyWindow( window );
     glfwTerminate();
@@ -603,6 +1042,15 @@ void printUsageAndExit( const std::string& argv0 )
         "  -h | --help                  Print this usage message and exit.\n"
         "  -f | --file <output_file>    Save image to file and exit.\n"
         "  -n | --nopbo                 Disable GL interop for display buffer.\n"
+        "  --overlap                    Simulate the next heightfield while the current one renders.\n"
+        "  --fused-tonemap              Tonemap in the camera launch while animating, no accumulation.\n"
+        "  --choppy                     Add horizontal wave displacement from two more batched FFTs.\n"
+        "  --packed                     Render from half precision heights packed with oct-encoded normals.\n"
+        "  --tiles <n>                  Instance the periodic patch n x n times with distance based detail.\n"
+        "  --sky-texture                Look up the sky in a baked lat-long texture.\n"
+        "  --frame-budget <ms>          Adapt the simulation resolution to hold the given frame time.\n"
+        "  --cost-heatmap               Show the mean camera cycles per pixel as a heatmap instead of the image.\n"
+        "  --benchmark <frames>         Time simulation and rendering along a fixed flythrough and exit.\n"
         "App Keystrokes:\n"
         "  q  Quit\n"
         "  s  Save image to '" << SAMPLE_NAME << ".png'\n"
@@ -616,6 +1064,10 @@ void printUsageAndExit( const std::string& argv0 )
 int main( int argc, char** argv )
 {
     bool use_pbo  = true;
+    bool overlap  = false;
+    bool packed   = false;
+    bool choppy   = false;
+    unsigned int benchmark_frames = 0;
     std::string out_file;
     for( int i=1; i<argc; ++i )
     {
@@ -638,6 +1090,57 @@ int main( int argc, char** argv )
         {
             use_pbo = false;
         }
+        else if( arg == "--overlap" )
+        {
+            overlap = true;
+        }
+        else if( arg == "--fused-tonemap" )
+        {
+            fused_tonemap = true;
+        }
+        else if( arg == "--sky-texture" )
+        {
+            bake_sky = true;
+        }
+        else if( arg == "--choppy" )
+        {
+            choppy = true;
+        }
+        else if( arg == "--packed" )
+        {
+            packed = true;
+        }
+        else if( arg == "--cost-heatmap" )
+        {
+            cost_heatmap = COST_HEATMAP_AVERAGE;
+        }
+        else if( arg == "--tiles" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            ocean_tiles = std::max( atoi( argv[++i] ), 1 );
+        }
+        else if( arg == "--frame-budget" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            simulation_controller.budget = std::max( atof( argv[++i] ), 0.0 ) * 1.0e-3;
+        }
+        else if( arg == "--benchmark" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            benchmark_frames = static_cast<unsigned int>( std::max( atoi( argv[++i] ), 1 ) );
+        }
         else {
             std::cerr << "Unknown option '" << arg << "'\n";
             printUsageAndExit( argv[0] );
@@ -658,21 +1161,19 @@ int main( int argc, char** argv )
 #endif
 
         RenderBuffers render_buffers;
+        render_buffers.overlap = overlap;
+        render_buffers.packed  = packed;
+        render_buffers.choppy  = choppy;
         createContext( use_pbo, render_buffers );
 
-        render_buffers.optix_device_ordinal = initSingleDevice();
-
-        createGeometry();
+        createGeometry( render_buffers );
         createLights();
 
         //
         // Initialize frequency-domain heights in OptiX buffer
         //
 
-        Buffer h0_buffer = context["h0"]->getBuffer();
-        float2* height0 = static_cast<float2*>( h0_buffer->map() );
-        generateH0( height0 );
-        h0_buffer->unmap();
+        generateH0( render_buffers, WIND_SPEED, WIND_DIR );
 
         const float3 camera_eye( make_float3( 1.47502f, 0.284192f, 0.8623f ) );
         const float3 camera_lookat( make_float3( 0.0f, 0.0f, 0.0f ) );
@@ -684,7 +1185,13 @@ int main( int argc, char** argv )
         // Finalize
         context->validate();
 
-        if ( out_file.empty() )
+        if ( benchmark_frames > 0 )
+        {
+            runBenchmark( render_buffers, benchmark_frames );
+            destroyFftPlan( render_buffers );
+            destroyContext();
+        }
+        else if ( out_file.empty() )
         {
             glfwRun( window, camera, render_buffers );
         }
@@ -692,6 +1199,7 @@ int main( int argc, char** argv )
         {
             // Accumulate frames for anti-aliasing
             updateHeightfield( 0.0f, render_buffers );
+            updateOceanLod();
             const unsigned int numframes = 64;
             std::cerr << "Accumulating " << numframes << " frames ..." << std::endl;
             for ( unsigned int frame = 0; frame < numframes; ++frame ) {
@@ -700,10 +1208,12 @@ int main( int argc, char** argv )
             }
 
             // tonemap
-            context->launch( 3, WIDTH, HEIGHT );
+            if ( cost_heatmap == COST_HEATMAP_OFF )
+                context->launch( 3, WIDTH, HEIGHT );
 
             sutil::writeBufferToFile( out_file.c_str(), getOutputBuffer() );
             std::cerr << "Wrote " << out_file << std::endl;
+            destroyFftPlan( render_buffers );
             destroyContext();
         }
 
@@ -0,0 +1,83 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include <cuda_fp16.h>
+
+// Packed heightfield texel: half precision height in x, y unused, the oct-encoded normal as two
+// 16 bit signed normalized values in z and w. One 8 byte fetch per node instead of 4 + 16 bytes.
+
+static __device__ __inline__ unsigned short pack_snorm16( float v )
+{
+  return static_cast<unsigned short>( static_cast<short>( rintf( fminf( fmaxf( v, -1.0f ), 1.0f ) * 32767.0f ) ) );
+}
+
+static __device__ __inline__ float unpack_snorm16( unsigned short v )
+{
+  return fmaxf( static_cast<float>( static_cast<short>( v ) ) / 32767.0f, -1.0f );
+}
+
+static __device__ __inline__ float sign_not_zero( float v )
+{
+  return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Octahedral mapping around +y, the up axis of the heightfield.
+static __device__ __inline__ ushort4 pack_surface( float height, optix::float3 n )
+{
+  const float l1 = fabsf( n.x ) + fabsf( n.y ) + fabsf( n.z );
+  float px = n.x / l1;
+  float pz = n.z / l1;
+  if ( n.y < 0.0f ) {
+    const float fx = ( 1.0f - fabsf( pz ) ) * sign_not_zero( px );
+    const float fz = ( 1.0f - fabsf( px ) ) * sign_not_zero( pz );
+    px = fx;
+    pz = fz;
+  }
+  return make_ushort4( __half_as_ushort( __float2half_rn( height ) ), 0, pack_snorm16( px ), pack_snorm16( pz ) );
+}
+
+static __device__ __inline__ float unpack_height( ushort4 texel )
+{
+  return __half2float( __ushort_as_half( texel.x ) );
+}
+
+static __device__ __inline__ optix::float3 unpack_normal( ushort4 texel )
+{
+  const float px = unpack_snorm16( texel.z );
+  const float pz = unpack_snorm16( texel.w );
+  optix::float3 n = optix::make_float3( px, 1.0f - fabsf( px ) - fabsf( pz ), pz );
+  if ( n.y < 0.0f ) {
+    n.x = ( 1.0f - fabsf( pz ) ) * sign_not_zero( px );
+    n.z = ( 1.0f - fabsf( px ) ) * sign_not_zero( pz );
+  }
+  return optix::normalize( n );
+}
@@ -31,6 +31,7 @@
 #include "helpers.h"
 #include <optix.h>
 #include <optix_math.h>
+#include "tonemap.cuh"
 
 
 rtDeclareVariable( uint2, launch_index, rtLaunchIndex, );
@@ -45,15 +46,7 @@ rtBuffer<uchar4, 2> output_buffer;
 
 RT_PROGRAM void tonemap()
 {
-  float3 val_Yxy = rgb2Yxy( make_float3( pre_image[ launch_index ] ) );
-  
-  float Y        = val_Yxy.x; // Y channel is luminance
-  float mapped_Y = Y / ( Y + 1.0f );
-  
-  float3 mapped_Yxy = make_float3( mapped_Y, val_Yxy.y, val_Yxy.z ); 
-  float3 mapped_rgb = Yxy2rgb( mapped_Yxy ); 
-
-  output_buffer[ launch_index ] = make_color( mapped_rgb );  
+  output_buffer[ launch_index ] = make_color( tonemap_color( make_float3( pre_image[ launch_index ] ) ) );
 }
 
 
@@ -1,5 +1,5 @@
 /* 
- * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -28,21 +28,18 @@
 
 #pragma once
 
-#ifndef MY_ASSERT_H
-#define MY_ASSERT_H
+#include "helpers.h"
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
 
-#undef MY_ASSERT
-
-#if !defined(NDEBUG)
-  #if defined(_WIN32) // Windows 32/64-bit
-    #include <windows.h>
-    #define DBGBREAK() DebugBreak();
-  #else
-    #define DBGBREAK() __builtin_trap();
-  #endif
-  #define MY_ASSERT(expr) if (!(expr)) DBGBREAK()
-#else
-  #define MY_ASSERT(expr)
-#endif
-
-#endif // MY_ASSERT_H
+// Reinhard operator on the luminance, shared by the tonemap pass and the fused camera.
+static __device__ __inline__ optix::float3 tonemap_color( const optix::float3& rgb )
+{
+  optix::float3 val_Yxy = rgb2Yxy( rgb );
+  
+  float Y        = val_Yxy.x; // Y channel is luminance
+  float mapped_Y = Y / ( Y + 1.0f );
+  
+  optix::float3 mapped_Yxy = optix::make_float3( mapped_Y, val_Yxy.y, val_Yxy.z ); 
+  return Yxy2rgb( mapped_Yxy ); 
+}
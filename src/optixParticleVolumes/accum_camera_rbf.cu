@@ -31,15 +31,17 @@
 #include "helpers.h"
 #include "random.h"
 #include "commonStructs_rbf.h"
+#include "lod_rbf.h"
+#include "quantized_rbf.h"
+#include "transfer_function_rbf.h"
+#include "cost_heatmap.h"
 
 using namespace optix;
 
-rtBuffer<float4>    positions_buffer;
+rtBuffer<unsigned char, 3>  occupancy_grid;
 
 rtDeclareVariable(float3,        eye, , );
 rtDeclareVariable(float3,        U, , );
-rtDeclareVariable(float3,        V, , );
-rtDeclareVariable(float3,        W, , );
 rtDeclareVariable(float3,        bad_color, , );
 rtDeclareVariable(float,         scene_epsilon, , );
 rtBuffer<uchar4, 2>              output_buffer;
@@ -58,41 +60,117 @@ rtDeclareVariable(float,         opacity, , );
 rtDeclareVariable(float,         segment_size, , );
 rtDeclareVariable(float,         wScale, , );
 
+//premultiplied color and opacity of the composite between a front and a back sample value
+rtTextureSampler<float4, 2>      preintegrated_tf;
+rtDeclareVariable(int,           use_preintegration, , );
+
+rtBuffer<float4, 2>              brick_composite;
+rtDeclareVariable(int,           brick_count, , );
+rtDeclareVariable(int,           brick_index, , );
+rtDeclareVariable(float3,        brick_min, , );
+rtDeclareVariable(float3,        brick_max, , );
+
+//cycles of the nearer bricks of the current frame, so the heatmap shows the cost of the whole ray
+rtBuffer<float, 2>               brick_cost;
+
 
 __device__ float4 tf(float v)
 {
-  if (tf_type == 1)
-  {
-    if (v < .5f)
-      return lerp( make_float4(1,1,0,0), make_float4(1,1,1,0.5f), v * 2.f);
-    else
-      return lerp( make_float4(1,1,1,0.5f), make_float4(1,0,0,1), v * 2.f - 1.f);
-  }
-  else if (tf_type == 2)
+  return transfer_function(tf_type, v);
+}
+
+//t at which the ray enters the first occupied cell of the occupancy grid at or after t, texit if there is none
+static __device__ __inline__ float next_occupied(const float3& origin, const float3& direction, float t, const float texit)
+{
+  const size_t3 size = occupancy_grid.size();
+  const int3 res = make_int3(static_cast<int>(size.x), static_cast<int>(size.y), static_cast<int>(size.z));
+  const float3 cell_size = (bbox_max - bbox_min) / make_float3(res);
+
+  const float3 p = (origin + direction * t - bbox_min) / cell_size;
+  int3 cell = make_int3(min(max(static_cast<int>(floorf(p.x)), 0), res.x - 1),
+                        min(max(static_cast<int>(floorf(p.y)), 0), res.y - 1),
+                        min(max(static_cast<int>(floorf(p.z)), 0), res.z - 1));
+
+  //3D DDA over the cells
+  const int3 step = make_int3(direction.x >= 0.f ? 1 : -1, direction.y >= 0.f ? 1 : -1, direction.z >= 0.f ? 1 : -1);
+  const float3 boundary = bbox_min + make_float3(cell.x + (step.x > 0), cell.y + (step.y > 0), cell.z + (step.z > 0)) * cell_size;
+  float3 tnext = make_float3(direction.x != 0.f ? (boundary.x - origin.x) / direction.x : 1e30f,
+                             direction.y != 0.f ? (boundary.y - origin.y) / direction.y : 1e30f,
+                             direction.z != 0.f ? (boundary.z - origin.z) / direction.z : 1e30f);
+  const float3 tdelta = make_float3(direction.x != 0.f ? cell_size.x / fabsf(direction.x) : 1e30f,
+                                    direction.y != 0.f ? cell_size.y / fabsf(direction.y) : 1e30f,
+                                    direction.z != 0.f ? cell_size.z / fabsf(direction.z) : 1e30f);
+
+  while (t < texit)
   {
-    if (v < .5f)
-      return lerp( make_float4(0,0,1,0), make_float4(1,1,1,0.5f), v * 2.f);
-    else
-      return lerp( make_float4(1,1,1,0.5f), make_float4(1,0,0,1), v * 2.f - 1.f);
+    if (occupancy_grid[make_uint3(cell.x, cell.y, cell.z)])
+      return t;
+
+    if (tnext.x < tnext.y && tnext.x < tnext.z) {
+      t = tnext.x;
+      cell.x += step.x;
+      tnext.x += tdelta.x;
+      if (cell.x < 0 || cell.x >= res.x) break;
+    } else if (tnext.y < tnext.z) {
+      t = tnext.y;
+      cell.y += step.y;
+      tnext.y += tdelta.y;
+      if (cell.y < 0 || cell.y >= res.y) break;
+    } else {
+      t = tnext.z;
+      cell.z += step.z;
+      tnext.z += tdelta.z;
+      if (cell.z < 0 || cell.z >= res.z) break;
+    }
   }
-  else
-  {
-    if (v < .33f)
-      return lerp( make_float4(1,0,1,0), make_float4(0,0,1,0.33f), (v-0.f) * 3.f);
-    else if (v < .66f)
-      return lerp( make_float4(0,0,1,.33f), make_float4(0,1,1,0.66f), (v-0.33f) * 3.f);
-    else
-      return lerp( make_float4(0,1,0,0.5f), make_float4(1,1,1,1), (v-0.66f) * 3.f);
+  return texit;
+}
+
+//imperative bitonic sort, modified to support non-powers-of-2
+static __device__ __inline__ void sort_samples(PerRayData_radiance_rbf& prd)
+{
+  int N = prd.rbfi;
+  int Nup2 = 1;
+  while (Nup2 < N)
+    Nup2 = Nup2 << 1;
+  Nup2 = min(Nup2, RBF_SAMPLES);
+
+  //power of two clamp
+  for(int i=N; i<Nup2; i++)
+    prd.rbfs[i].x = 1e20f;
+  N = Nup2;
+
+  for (int k=2; k<=N; k=k<<1) {
+    for (int j=k>>1; j>0; j=j>>1) {
+      for (int i=0; i<N; i++) {
+        const int ij=i^j;
+        if (ij>i) {
+          const int ik = i&k;
+          const float2 tmp = prd.rbfs[i];
+          if (ik==0 && tmp.x > prd.rbfs[ij].x) {   //sort ascending
+            prd.rbfs[i] = prd.rbfs[ij];
+            prd.rbfs[ij] = tmp;
+          }
+          if (ik!=0 && tmp.x < prd.rbfs[ij].x) {   //sort descending
+            prd.rbfs[i] = prd.rbfs[ij];
+            prd.rbfs[ij] = tmp;
+          }
+        }
+      }
+    }
   }
 }
 
-RT_PROGRAM void pinhole_camera()
+//presorted: the any-hit program kept the samples sorted in a k-buffer (any_hit_kbuffer)
+static __device__ __inline__ void trace_rbfs(const bool presorted)
 {
+  const long long start = clock64();
 
   size_t2 screen = output_buffer.size();
   unsigned int seed = tea<16>(screen.x*launch_index.y+launch_index.x, frame);
 
-  float2 subpixel_jitter = make_float2(0.0f, 0.0f);
+  //jitter only while accumulating, so the first frame after a change is the same as without accumulation
+  float2 subpixel_jitter = frame > 0 ? make_float2(rnd(seed) - 0.5f, rnd(seed) - 0.5f) : make_float2(0.0f, 0.0f);
 
   float2 d = (make_float2(launch_index) + subpixel_jitter) / make_float2(screen) * 2.f - 1.f;
   float3 ray_origin = eye;
@@ -112,22 +190,50 @@ RT_PROGRAM void pinhole_camera()
   float tenter = fmaxf(0.f, fmaxf(tmin.x, fmaxf(tmin.y, tmin.z)));
   float texit = fminf(tmax.x, fminf(tmax.y, tmax.z));
 
+  //in brick mode only the part of the ray inside the current brick is integrated
+  if (brick_count > 0) {
+    t0 = (brick_max - ray_origin) / ray_direction;
+    t1 = (brick_min - ray_origin) / ray_direction;
+    tmax = fmaxf(t0, t1);
+    tmin = fminf(t0, t1);
+    tenter = fmaxf(tenter, fmaxf(tmin.x, fmaxf(tmin.y, tmin.z)));
+    texit = fminf(texit, fminf(tmax.x, fminf(tmax.y, tmax.z)));
+  }
+
   float spacing = (RBF_SAMPLES * segment_size) * fixed_radius;
 
   float3 result = make_float3(0);
   float result_alpha = 0.f;
+
+  //later bricks continue the front to back composite of the nearer ones
+  if (brick_index > 0) {
+    const float4 composite = brick_composite[launch_index];
+    result = make_float3(composite);
+    result_alpha = composite.w;
+  }
   
   if (tenter < texit)
   {
-    float tbuffer = 0.f;
+    //jittered segment boundaries average out the banding at the segment ends
+    float tbuffer = frame > 0 ? -rnd(seed) * spacing : 0.f;
+
+    //value of the previous sample along the ray, negative before the first one
+    float previous_drbf = -1.f;
 
     //for each segment, 
     //  traverse the BVH (collect deep samples in prd.rbfs), 
-    //  sort,
+    //  sort (unless presorted),
     //  integrate.
     
     while(tbuffer < texit && result_alpha < 0.97f)
     {
+      //jump over empty space to the next occupied cell
+      const float toccupied = next_occupied(ray_origin, ray_direction, fmaxf(tenter, tbuffer), texit);
+      if (toccupied >= texit)
+        break;
+      if (toccupied > tbuffer + spacing)
+        tbuffer = toccupied;
+
       prd.rbfi = 0;
       ray.tmin = fmaxf(tenter, tbuffer);
       ray.tmax = fminf(texit, tbuffer + spacing);
@@ -136,39 +242,8 @@ RT_PROGRAM void pinhole_camera()
       {
         rtTrace(top_object, ray, prd);
 
-        //imperative bitonic sort, modified to support non-powers-of-2
-        int N = prd.rbfi;
-        int Nup2 = 1;
-        while (Nup2 < N)
-          Nup2 = Nup2 << 1;
-        Nup2 = min(Nup2, RBF_SAMPLES);
-
-        //power of two clamp
-        for(int i=N; i<Nup2; i++)
-          prd.rbfs[i].x = 1e20f;
-        N = Nup2;
-
-        for (int k=2; k<=N; k=k<<1) {
-          for (int j=k>>1; j>0; j=j>>1) {
-            for (int i=0; i<N; i++) {
-              const int ij=i^j;
-              if (ij>i) {
-                const int ik = i&k;
-                const float2 tmp = prd.rbfs[i];
-                if (ik==0 && tmp.x > prd.rbfs[ij].x) {   //sort ascending
-                  prd.rbfs[i] = prd.rbfs[ij];
-                  prd.rbfs[ij] = tmp;
-                }
-                if (ik!=0 && tmp.x < prd.rbfs[ij].x) {   //sort descending
-                  prd.rbfs[i] = prd.rbfs[ij];
-                  prd.rbfs[ij] = tmp;
-                }
-              }
-            }
-          }
-        }
-
-        const float inv_fixed_radius_scale = 2.f / fixed_radius;
+        if (!presorted)
+          sort_samples(prd);
 
         //integrate depth-sorted list of RBFs
         for(int i=0; i<prd.rbfi; i++) {
@@ -177,10 +252,25 @@ RT_PROGRAM void pinhole_camera()
           int idx = __float_as_int(prd.rbfs[i].y);
           float3 hit_sample = ray.origin + ray.direction * trbf;
 
-          float4 pos = positions_buffer[idx];
+          float4 pos = particle_position(idx);
           float3 hit_normal = make_float3(pos.x, pos.y, pos.z) - hit_sample;
-          float drbf = length(hit_normal) * inv_fixed_radius_scale;
+          float drbf = length(hit_normal) * 2.f / particle_radius(fixed_radius, idx);
           drbf = fmaxf(0.f, fminf(1.f, wScale * pos.w * exp(-drbf*drbf)));
+
+          if (use_preintegration) {
+            //each sample composites the transfer function over all values between the previous
+            //sample and itself, so narrow features of the transfer function are not stepped over
+            const float front = previous_drbf < 0.f ? drbf : previous_drbf;
+            const float texel = (PREINTEGRATED_TF_SIZE - 1.f) / PREINTEGRATED_TF_SIZE;
+            const float offset = 0.5f / PREINTEGRATED_TF_SIZE;
+            const float4 segment = tex2D(preintegrated_tf, front * texel + offset, drbf * texel + offset);
+            previous_drbf = drbf;
+
+            result += make_float3(segment) * (1.0f - result_alpha);
+            result_alpha += segment.w * (1.0f - result_alpha);
+            continue;
+          }
+
           float4 color_sample = tf(drbf);
 
           float alpha = color_sample.w * opacity;
@@ -195,10 +285,38 @@ RT_PROGRAM void pinhole_camera()
 
   }
 
-  //write to frame buffer
+  //all but the farthest brick only hand the composite on
+  if (brick_count > 0 && brick_index < brick_count - 1) {
+    brick_composite[launch_index] = make_float4(result, result_alpha);
+    if (use_cost_heatmap)
+      brick_cost[launch_index] = (brick_index > 0 ? brick_cost[launch_index] : 0.f) + static_cast<float>(clock64() - start);
+    return;
+  }
+
+  //accumulate into the frame buffer
   float4 acc_val =  make_float4(result, 0.f);
-  output_buffer[launch_index] = make_color( make_float3( acc_val ) );
+  if (frame > 0)
+    acc_val = lerp(accum_buffer[launch_index], acc_val, 1.0f / static_cast<float>(frame + 1));
   accum_buffer[launch_index] = acc_val;
+
+  if (use_cost_heatmap) {
+    float cycles = static_cast<float>(clock64() - start);
+    if (brick_index > 0)
+      cycles += brick_cost[launch_index];
+    output_buffer[launch_index] = make_color( record_cycles(launch_index, cycles, frame) );
+  }
+  else
+    output_buffer[launch_index] = make_color( make_float3( acc_val ) );
+}
+
+RT_PROGRAM void pinhole_camera()
+{
+  trace_rbfs(false);
+}
+
+RT_PROGRAM void pinhole_camera_kbuffer()
+{
+  trace_rbfs(true);
 }
 
 RT_PROGRAM void exception()
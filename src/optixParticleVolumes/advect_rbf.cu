@@ -0,0 +1,47 @@
+/* 
+* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*  * Neither the name of NVIDIA CORPORATION nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+* PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+* CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+* OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+using namespace optix;
+
+// Keyframe interpolation: the positions between two stored frames are advected here on the device.
+
+rtBuffer<float4>    positions_buffer;
+rtBuffer<float3>    velocities_buffer;
+rtDeclareVariable(float,        advect_dt, , );
+rtDeclareVariable(unsigned int, launch_index, rtLaunchIndex, );
+
+// Moves each particle by one interpolation step along its velocity, the attribute in w is kept.
+RT_PROGRAM void advect_particles()
+{
+  const float4 p = positions_buffer[launch_index];
+  const float3 v = velocities_buffer[launch_index];
+  positions_buffer[launch_index] = make_float4(make_float3(p) + v * advect_dt, p.w);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+// Level of detail: the positions buffer holds the particles followed by the aggregates of all levels.
+// An aggregate of level l has 2^l times the fixed radius and is only hit at the distances where
+// lod_pixel_scale * height pixels cover about its diameter.
+
+rtBuffer<unsigned char>  lod_levels;        // Level of each aggregate.
+rtDeclareVariable(unsigned int, lod_first, , );       // Index of the first aggregate, all before are level 0.
+rtDeclareVariable(int,          lod_max_level, , );   // 0 disables the level of detail.
+rtDeclareVariable(float,        lod_pixel_scale, , ); // Footprint in pixels divided by the image height.
+rtDeclareVariable(float3,       V, , );
+rtDeclareVariable(float3,       W, , );
+
+static __device__ __inline__ int particle_level(const int idx)
+{
+  return (lod_max_level > 0 && static_cast<unsigned int>(idx) >= lod_first) ? lod_levels[idx - lod_first] : 0;
+}
+
+static __device__ __inline__ float particle_radius(const float fixed_radius, const int idx)
+{
+  return ldexpf(fixed_radius, particle_level(idx));
+}
+
+//level whose particle diameter matches the footprint at distance t
+static __device__ __inline__ int footprint_level(const float fixed_radius, const float t)
+{
+  const float footprint = t * 2.f * length(V) / length(W) * lod_pixel_scale;
+  const int level = static_cast<int>(floorf(log2f(footprint / (2.f * fixed_radius)))) + 1;
+  return min(max(level, 0), lod_max_level);
+}
@@ -50,8 +50,13 @@
 #include <optixu/optixu_math_stream_namespace.h>
 
 #include <sutil.h>
+#include <UsageReportLogger.h>
+#include <NvtxRange.h>
 #include <Camera.h>
+#include <TaskPool.h>
 #include "commonStructs_rbf.h"
+#include "transfer_function_rbf.h"
+#include "cost_heatmap.h"
 #include <Arcball.h>
 
 #include <cstring>
@@ -61,7 +66,28 @@
 #include <sstream>
 #include <algorithm>
 #include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <thread>
+
+#if defined( _WIN32 )
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
 
 using namespace optix;
 
@@ -71,9 +97,55 @@ struct ParticleFrameData {
   std::vector<float3> colors;
   std::vector<float>  radii;
   float3 bbox_min, bbox_max;
+  float2 attribute_range;   // Range of positions.w before the normalization
+  std::vector<unsigned char> occupancy;   // Empty space skipping grid, see buildOccupancyGrid()
+  std::vector<float4>        lod_positions;  // Aggregates of all levels, see buildLod()
+  std::vector<unsigned char> lod_levels;
+  bool preprocessed;   // False for raw positions, reduced and normalized on the device at upload
+  float fixed_radius;  // Radius the bounds are padded with, derived from them when the setting was 0
+  int   tf_type;       // Transfer function, 3 once a raw frame holds a signed attribute
+};
+
+// Binary particle files (.ppv): A 64 byte header followed by the arrays in the layout of the OptiX buffers,
+// so they can be memory-mapped and copied straight into the mapped buffers.
+// The positions come first, their w is the attribute already normalized for the transfer function.
+// The optional velocities, colors and radii follow in this order if flagged in the header.
+const char     PARTICLE_FILE_MAGIC[4]     = { 'O', 'P', 'V', 'B' };
+const uint32_t PARTICLE_FILE_VERSION      = 1u;
+const uint32_t PARTICLE_FILE_VELOCITIES   = 1u << 0;
+const uint32_t PARTICLE_FILE_COLORS       = 1u << 1;
+const uint32_t PARTICLE_FILE_RADII        = 1u << 2;
+const uint32_t PARTICLE_FILE_SIGNED       = 1u << 3;  // Signed attribute, use transfer function 3.
+
+struct ParticleFileHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t count;
+    uint32_t flags;
+    float    radius;           // Fixed radius the bounds are padded with.
+    float    bbox_min[3];
+    float    bbox_max[3];
+    float    attribute_min;    // Range of the attribute before the normalization.
+    float    attribute_max;
+    uint32_t reserved[2];
 };
 
-std::map<int, ParticleFrameData> dataCache;
+// Frame cache: The frames of a particle sequence, bounded by frame_cache_bytes with least recently used
+// eviction. A background thread prefetches the next frames in playback direction.
+typedef std::shared_ptr<const ParticleFrameData> ParticleFramePtr;
+
+std::map<int, ParticleFramePtr> dataCache;
+std::list<int>                  dataCacheLru;        // Most recently used first.
+size_t                          dataCacheBytes = 0;
+std::set<int>                   dataCacheLoading;    // Frames the prefetch thread is reading.
+std::mutex                      dataCacheMutex;
+std::condition_variable         dataCacheCondition;
+std::deque<int>                 prefetchQueue;
+std::thread                     prefetchThread;
+bool                            prefetchQuit = false;
+float                           prefetchRadius = 0.f;  // Settings the queued frames are read with,
+int                             prefetchTfType = 0;    // copied from the main thread's globals.
 
 const char* const SAMPLE_NAME = "optixParticleVolumes";
 const unsigned int WIDTH  = 1024u;
@@ -85,8 +157,15 @@ struct ParticlesBuffer
     Buffer      velocities;
     Buffer      colors;
     Buffer      radii;
+    Buffer      occupancy;
+    Buffer      lod_levels;
+    Buffer      quantized_positions;
 };
 
+// The occupancy grid is marked with this multiple of the radius, so it stays conservative over the
+// range of the radius slider.
+const float OCCUPANCY_RADIUS_SCALE = 2.f;
+
 //------------------------------------------------------------------------------
 //
 // Globals
@@ -98,6 +177,7 @@ uint32_t        width  = 1024u;
 uint32_t        height = 768u;
 bool            use_pbo = true;
 bool            rbfs = true;
+bool            kbuffer = false;
 bool            particles_file_colors = false;
 bool            particles_file_radius = false;
 bool            particles_file_velocities = false;
@@ -108,6 +188,9 @@ float           segment_size = 16.f;
 float           wScale = 3.5f;
 float           opacity = .5f;
 int             tf_type = 2;
+bool            preintegrated = false;
+int             cost_heatmap = COST_HEATMAP_OFF;
+float           cost_scale = 1.e6f;
 bool            play = false;
 unsigned int    iterations_per_animation_frame = 1;
 optix::Aabb     aabb;
@@ -129,6 +212,97 @@ std::string     particles_file_extension;
 std::string     particles_file_base;
 int             current_particle_frame = 1;
 int             max_particle_frames = 25;
+int             play_direction = 1;
+int             prefetch_frames = 4;
+size_t          frame_cache_bytes = size_t( 2048 ) << 20;
+
+// Keyframe interpolation: with interpolate_steps > 1 the playback shows that many steps per stored frame.
+// The steps in between advect the positions on the device with the velocities of the stored frame and
+// refit the BVH. velocity_scale is the time between two stored frames in the units of the velocities.
+const unsigned int ADVECT_ENTRY = 1u;
+int             interpolate_steps = 1;
+int             interpolate_step = 0;
+float           velocity_scale = 1.f;
+
+// Device preprocessing: frames are uploaded as read, the bounds, the attribute normalization and the
+// automatic fixed_radius are computed by launches of these entries. The reduction keeps one partial
+// bound per launch index, PREPROCESS_THREADS of them are read back.
+const unsigned int PREPROCESS_BOUNDS_ENTRY = 2u;
+const unsigned int PREPROCESS_NORMALIZE_ENTRY = 3u;
+const unsigned int PREPROCESS_THREADS = 8192u;
+bool            gpu_preprocess = false;
+
+// Spatial bricks: with brick_res > 0 the particles are split into brick_res^3 bricks kept in host memory.
+// Every launch streams the non-empty bricks through the device nearest first and composites them front
+// to back, so only the largest brick has to fit in device memory.
+int                                 brick_res = 0;
+std::vector< std::vector<float4> >  brick_particles;
+std::vector<optix::Aabb>            brick_bounds;
+int                                 brick_resident = -1;
+
+// Sorts the particles into the bricks whose box overlaps their sphere. A particle on a boundary goes to
+// every brick it reaches, the ray generation program clips the ray to the brick so no sample is counted twice.
+static void buildBricks( const float4* positions, size_t count, const float3& bbox_min, const float3& bbox_max )
+{
+    const int    res       = brick_res;
+    const float3 cell_size = ( bbox_max - bbox_min ) / make_float3( static_cast<float>( res ) );
+    const float  radius    = OCCUPANCY_RADIUS_SCALE * fixed_radius;
+
+    brick_particles.assign( res * res * res, std::vector<float4>() );
+    brick_bounds.resize( res * res * res );
+    for ( int z = 0; z < res; ++z )
+        for ( int y = 0; y < res; ++y )
+            for ( int x = 0; x < res; ++x )
+                brick_bounds[ ( z * res + y ) * res + x ].set(
+                    bbox_min + make_float3( (float) x, (float) y, (float) z ) * cell_size,
+                    bbox_min + make_float3( (float) ( x + 1 ), (float) ( y + 1 ), (float) ( z + 1 ) ) * cell_size );
+
+    for ( size_t i = 0; i < count; ++i ) {
+        const float3 p  = make_float3( positions[i] );
+        const float3 lo = ( p - make_float3( radius ) - bbox_min ) / cell_size;
+        const float3 hi = ( p + make_float3( radius ) - bbox_min ) / cell_size;
+        const int x0 = std::max( static_cast<int>( floorf( lo.x ) ), 0 ), x1 = std::min( static_cast<int>( floorf( hi.x ) ), res - 1 );
+        const int y0 = std::max( static_cast<int>( floorf( lo.y ) ), 0 ), y1 = std::min( static_cast<int>( floorf( hi.y ) ), res - 1 );
+        const int z0 = std::max( static_cast<int>( floorf( lo.z ) ), 0 ), z1 = std::min( static_cast<int>( floorf( hi.z ) ), res - 1 );
+        for ( int z = z0; z <= z1; ++z )
+            for ( int y = y0; y <= y1; ++y )
+                for ( int x = x0; x <= x1; ++x )
+                    brick_particles[ ( z * res + y ) * res + x ].push_back( positions[i] );
+    }
+
+    size_t largest = 0;
+    for ( size_t b = 0; b < brick_particles.size(); ++b )
+        largest = std::max( largest, brick_particles[b].size() );
+    std::cout << "Split " << count << " particles into " << brick_particles.size() << " bricks, largest "
+              << largest << std::endl;
+
+    brick_resident = -1;
+}
+
+
+// BVH refit: frames with the particle count of the previous one only refit the bounds, every
+// refit_interval frames a full rebuild restores the quality. 0 always rebuilds.
+int             refit_interval = 0;
+int             refit_count = 0;
+size_t          bvh_particle_count = 0;
+
+// Cells per axis of the occupancy grid the ray generation program skips empty space with, 0 disables it.
+int             occupancy_res = 64;
+
+// Level of detail: number of aggregate levels built at load time (0 disables it), and how many pixels
+// the diameter of the particles of the selected level covers.
+int             lod_max_level = 0;
+float           lod_pixels = 2.f;
+
+// Quantized storage: 16 bit fixed point positions and attributes. The velocities, colors and radii aren't
+// read by the device programs and are dropped.
+bool            quantized = false;
+
+// Scaling benchmark: the loaded frame is replicated to each of the scaling_sizes particle counts, which are
+// timed at fixed camera views with scaling_frames launches each. The rows also go to scaling_file if set.
+std::vector<size_t>                 scaling_sizes;
+int                                 scaling_frames = 16;
+std::string                         scaling_file;
 
 // Accumulation frame
 unsigned int    accumulation_frame = 0;
@@ -145,12 +319,11 @@ GeometryGroup   geometry_group;
 //
 //------------------------------------------------------------------------------
 
-struct UsageReportLogger;
 
 Buffer getOutputBuffer();
 void destroyContext();
 void registerExitHandler();
-void createContext( int usage_report_level, UsageReportLogger* logger );
+void createContext( int usage_report_level, sutil::UsageReportLogger* logger );
 void loadMesh( const std::string& filename );
 void setupCamera();
 void setupLights();
@@ -179,8 +352,11 @@ Buffer getOutputBuffer()
 }
 
 
+void stopFramePrefetch();
+
 void destroyContext()
 {
+    stopFramePrefetch();
     if( context )
     {
         context->destroy();
@@ -198,26 +374,6 @@ struct RenderBuffers
 };
 
 
-struct UsageReportLogger
-{
-  void log( int lvl, const char* tag, const char* msg )
-  {
-    std::cout << "[" << lvl << "][" << std::left << std::setw( 12 ) << tag << "] " << msg;
-  }
-};
-
-
-// Static callback
-void usageReportCallback( int lvl, const char* tag, const char* msg, void* cbdata )
-{
-    // Route messages to a C++ object (the "logger"), as a real app might do.
-    // We could have printed them directly in this simple case.
-
-    UsageReportLogger* logger = reinterpret_cast<UsageReportLogger*>( cbdata );
-    logger->log( lvl, tag, msg );
-}
-
-
 void setParticlesBaseName( const std::string &particles_file )
 {
     // gets the base name by stripping the suffix and the number, if there is no number
@@ -241,15 +397,16 @@ void setParticlesBaseName( const std::string &particles_file )
 }
 
 
-void createContext( int usage_report_level, UsageReportLogger* logger )
+void createContext( int usage_report_level, sutil::UsageReportLogger* logger )
 {
     // Set up context
     context = Context::create();
     context->setRayTypeCount( 2 );
-    context->setEntryPointCount( 1 );
+    context->setEntryPointCount( 4 );
     if( usage_report_level > 0 )
     {
-        context->setUsageReportCallback( usageReportCallback, usage_report_level, logger );
+        // The logger prints the messages and, with --report_file, also keeps them as records.
+        logger->attach( context, usage_report_level );
     }
     context["radiance_ray_type"]->setUint( 0u );
     context["shadow_ray_type"  ]->setUint( 1u );
@@ -262,23 +419,74 @@ void createContext( int usage_report_level, UsageReportLogger* logger )
         RT_FORMAT_FLOAT4, width, height );
     context["accum_buffer"]->set( accum_buffer );
 
+    // front to back composite of the bricks rendered so far in the current launch
+    Buffer brick_composite = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL,
+        RT_FORMAT_FLOAT4, brick_res > 0 ? width : 1, brick_res > 0 ? height : 1 );
+    context["brick_composite"]->set( brick_composite );
+    context["brick_count"    ]->setInt( 0 );
+    context["brick_index"    ]->setInt( 0 );
+    context["brick_min"      ]->setFloat( 0.f, 0.f, 0.f );
+
+    // cycles per pixel of the heatmap, and of the nearer bricks of the current launch
+    context["cost_buffer"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL,
+        RT_FORMAT_FLOAT, width, height ) );
+    context["brick_cost"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL,
+        RT_FORMAT_FLOAT, brick_res > 0 ? width : 1, brick_res > 0 ? height : 1 ) );
+    context["use_cost_heatmap"]->setInt( cost_heatmap );
+    context["cost_scale"      ]->setFloat( cost_scale );
+    context["brick_max"      ]->setFloat( 0.f, 0.f, 0.f );
+
     // Ray generation program
     std::string ptx;
     ptx = ptxPath( "accum_camera_rbf.cu" );
-    Program ray_gen_program = context->createProgramFromPTXFile( ptxPath("accum_camera_rbf.cu"), "pinhole_camera" );
+    Program ray_gen_program = sutil::createProgramFromPTXFile( context, ptxPath("accum_camera_rbf.cu"), kbuffer ? "pinhole_camera_kbuffer" : "pinhole_camera" );
 
     context->setRayGenerationProgram( 0, ray_gen_program );
 
     // Exception program
-    Program exception_program = context->createProgramFromPTXFile( ptxPath("accum_camera_rbf.cu"), "exception" );
+    Program exception_program = sutil::createProgramFromPTXFile( context, ptxPath("accum_camera_rbf.cu"), "exception" );
     context->setExceptionProgram( 0, exception_program );
     context["bad_color"]->setFloat( 1.0f, 0.0f, 1.0f );
 
     // Miss program
-    context->setMissProgram( 0, context->createProgramFromPTXFile( ptxPath("constantbg.cu"), "miss" ) );
+    context->setMissProgram( 0, sutil::createProgramFromPTXFile( context, ptxPath("constantbg.cu"), "miss" ) );
 
     context["bg_color"]->setFloat( 0.07f, 0.11f, 0.17f );
 
+    context->setRayGenerationProgram( ADVECT_ENTRY, sutil::createProgramFromPTXFile( context, ptxPath("advect_rbf.cu"), "advect_particles" ) );
+    context["advect_dt"]->setFloat( 0.f );
+
+    context->setRayGenerationProgram( PREPROCESS_BOUNDS_ENTRY, sutil::createProgramFromPTXFile( context, ptxPath("preprocess_rbf.cu"), "reduce_bounds" ) );
+    context->setRayGenerationProgram( PREPROCESS_NORMALIZE_ENTRY, sutil::createProgramFromPTXFile( context, ptxPath("preprocess_rbf.cu"), "normalize_attributes" ) );
+    const RTsize preprocess_size = gpu_preprocess ? PREPROCESS_THREADS : 1;
+    context["preprocess_min"     ]->set( context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT4, preprocess_size ) );
+    context["preprocess_max"     ]->set( context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT4, preprocess_size ) );
+    context["preprocess_count"   ]->setUint( 0u );
+    context["attribute_transform"]->setFloat( 1.f, 0.f );
+
+    // the preprocessing launches before setupCamera(), the ray generation program needs its variables then
+    context["frame"]->setUint( 0u );
+    context["eye"  ]->setFloat( 0.f, 0.f, 0.f );
+    context["U"    ]->setFloat( 0.f, 0.f, 0.f );
+    context["V"    ]->setFloat( 0.f, 0.f, 0.f );
+    context["W"    ]->setFloat( 0.f, 0.f, 0.f );
+
+    // Pre-integrated transfer function over (front, back) sample values, filled by updatePreintegratedTf
+    const RTsize tf_size = preintegrated ? PREINTEGRATED_TF_SIZE : 1;
+    Buffer preintegrated_tf_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, tf_size, tf_size );
+    TextureSampler preintegrated_tf = context->createTextureSampler();
+    preintegrated_tf->setWrapMode( 0, RT_WRAP_CLAMP_TO_EDGE );
+    preintegrated_tf->setWrapMode( 1, RT_WRAP_CLAMP_TO_EDGE );
+    preintegrated_tf->setIndexingMode( RT_TEXTURE_INDEX_NORMALIZED_COORDINATES );
+    preintegrated_tf->setReadMode( RT_TEXTURE_READ_ELEMENT_TYPE );
+    preintegrated_tf->setMaxAnisotropy( 1.0f );
+    preintegrated_tf->setMipLevelCount( 1u );
+    preintegrated_tf->setArraySize( 1u );
+    preintegrated_tf->setFilteringModes( RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE );
+    preintegrated_tf->setBuffer( 0u, 0u, preintegrated_tf_buffer );
+    context["preintegrated_tf"  ]->setTextureSampler( preintegrated_tf );
+    context["use_preintegration"]->setInt( preintegrated ? 1 : 0 );
+
 }
 
 
@@ -315,23 +523,330 @@ static inline float3 get_max(
 }
 
 
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    MappedFile() : m_data( 0 ), m_size( 0 )
+#if defined( _WIN32 )
+        , m_file( INVALID_HANDLE_VALUE ), m_mapping( 0 )
+#endif
+    {}
+
+    ~MappedFile() { close(); }
+
+    bool open( const std::string& filename )
+    {
+#if defined( _WIN32 )
+        m_file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+        if( m_file == INVALID_HANDLE_VALUE )
+            return false;
+        LARGE_INTEGER size;
+        if( !GetFileSizeEx( m_file, &size ) || size.QuadPart == 0 )
+            return false;
+        m_size = static_cast<size_t>( size.QuadPart );
+        m_mapping = CreateFileMappingA( m_file, 0, PAGE_READONLY, 0, 0, 0 );
+        if( !m_mapping )
+            return false;
+        m_data = static_cast<const char*>( MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+#else
+        const int fd = ::open( filename.c_str(), O_RDONLY );
+        if( fd < 0 )
+            return false;
+        struct stat st;
+        if( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+            ::close( fd );
+            return false;
+        }
+        m_size = static_cast<size_t>( st.st_size );
+        void* data = mmap( 0, m_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        ::close( fd );
+        if( data == MAP_FAILED )
+            return false;
+        madvise( data, m_size, MADV_SEQUENTIAL );
+        m_data = static_cast<const char*>( data );
+#endif
+        return m_data != 0;
+    }
+
+    void close()
+    {
+#if defined( _WIN32 )
+        if( m_data )    UnmapViewOfFile( m_data );
+        if( m_mapping ) CloseHandle( m_mapping );
+        if( m_file != INVALID_HANDLE_VALUE ) CloseHandle( m_file );
+        m_mapping = 0;
+        m_file    = INVALID_HANDLE_VALUE;
+#else
+        if( m_data ) munmap( const_cast<char*>( m_data ), m_size );
+#endif
+        m_data = 0;
+        m_size = 0;
+    }
+
+    const char* data() const { return m_data; }
+    size_t      size() const { return m_size; }
+
+private:
+    const char* m_data;
+    size_t      m_size;
+#if defined( _WIN32 )
+    HANDLE      m_file;
+    HANDLE      m_mapping;
+#endif
+};
+
+
+// Builds the name of the current frame of a particle sequence.
+static std::string particleFrameFileName( int frame, const std::string& extension )
+{
+    if ( frame <= 0 )
+        return particles_file_base;
+
+    std::ostringstream s;
+    s << std::setw( 4 ) << std::setfill( '0' ) << frame;
+    return particles_file_base + "." + s.str() + "." + extension;
+}
+
+
+// Fills the pre-integrated transfer function table when the preset or the opacity changed. Entry (f, b)
+// composites the transfer function front to back over the values from f to b, one sub-step per texel
+// in between. All sub-steps together have the opacity of one sample, so f == b gives the plain
+// tf(f) * opacity and the total opacity along a ray does not depend on the pre-integration.
+void updatePreintegratedTf()
+{
+    static int   table_tf_type = -1;
+    static float table_opacity = -1.f;
+    if ( !preintegrated || ( tf_type == table_tf_type && opacity == table_opacity ) )
+        return;
+    table_tf_type = tf_type;
+    table_opacity = opacity;
+
+    const int n = PREINTEGRATED_TF_SIZE;
+    Buffer buffer = context["preintegrated_tf"]->getTextureSampler()->getBuffer( 0u, 0u );
+    float4* table = static_cast<float4*>( buffer->map( 0, RT_BUFFER_MAP_WRITE_DISCARD ) );
+    for ( int back = 0; back < n; ++back )
+    {
+        for ( int front = 0; front < n; ++front )
+        {
+            const float vf = front / float( n - 1 );
+            const float vb = back  / float( n - 1 );
+            const int steps = 1 + std::abs( back - front );
+
+            float3 color = make_float3( 0.f );
+            float  alpha = 0.f;
+            for ( int s = 0; s < steps; ++s )
+            {
+                const float v = steps == 1 ? vf : optix::lerp( vf, vb, ( s + 0.5f ) / steps );
+                const float4 c = transfer_function( tf_type, v );
+                const float sample_alpha = fminf( c.w * opacity, 0.9999f );
+                const float step_alpha = 1.f - powf( 1.f - sample_alpha, 1.f / steps );
+                color += make_float3( c ) * ( step_alpha * ( 1.f - alpha ) );
+                alpha += step_alpha * ( 1.f - alpha );
+            }
+            table[back * n + front] = make_float4( color, alpha );
+        }
+    }
+    buffer->unmap();
+}
+
+static void copyToBuffer( Buffer buffer, const char* data, size_t count, size_t element_size )
+{
+    buffer->setSize( count );
+    if ( count > 0 ) {
+        memcpy( buffer->map(), data, count * element_size );
+        buffer->unmap();
+    }
+}
+
+
+// Marks the cells of the occupancy grid over the bounds which the particles and the level of detail
+// aggregates overlap. A disabled grid is a single occupied cell.
+static void buildOccupancyGrid(
+    const float4* positions,
+    size_t count,
+    const std::vector<float4>& lod_positions,
+    const std::vector<unsigned char>& lod_levels,
+    const float3& bbox_min,
+    const float3& bbox_max,
+    float fixed_radius,
+    std::vector<unsigned char>& occupancy )
+{
+    if ( occupancy_res <= 0 ) {
+        occupancy.assign( 1, 1 );
+        return;
+    }
+
+    const int res = occupancy_res;
+    occupancy.assign( size_t( res ) * res * res, 0 );
+
+    const float3 scale  = make_float3( static_cast<float>( res ) ) / ( bbox_max - bbox_min );
+    for ( size_t i = 0; i < count + lod_positions.size(); ++i ) {
+        const float4& q = i < count ? positions[i] : lod_positions[i - count];
+        const int level = i < count ? 0 : lod_levels[i - count];
+        const float  radius = OCCUPANCY_RADIUS_SCALE * fixed_radius * static_cast<float>( 1 << level );
+        const float3 p  = make_float3( q.x, q.y, q.z );
+        const float3 lo = ( p - radius - bbox_min ) * scale;
+        const float3 hi = ( p + radius - bbox_min ) * scale;
+        const int x0 = std::max( static_cast<int>( lo.x ), 0 ), x1 = std::min( static_cast<int>( hi.x ), res - 1 );
+        const int y0 = std::max( static_cast<int>( lo.y ), 0 ), y1 = std::min( static_cast<int>( hi.y ), res - 1 );
+        const int z0 = std::max( static_cast<int>( lo.z ), 0 ), z1 = std::min( static_cast<int>( hi.z ), res - 1 );
+        for ( int z = z0; z <= z1; ++z )
+            for ( int y = y0; y <= y1; ++y )
+                for ( int x = x0; x <= x1; ++x )
+                    occupancy[( size_t( z ) * res + y ) * res + x] = 1;
+    }
+}
+
+
+static void uploadOccupancyGrid( const std::vector<unsigned char>& occupancy )
+{
+    const RTsize res = occupancy_res > 0 ? static_cast<RTsize>( occupancy_res ) : 1;
+    buffers.occupancy->setSize( res, res, res );
+    memcpy( buffers.occupancy->map(), &occupancy[0], occupancy.size() );
+    buffers.occupancy->unmap();
+}
+
+
+// Merges the particles in cells of 2^l particle diameters into one aggregate per cell and level l, each
+// level is built from the one below. An aggregate sits at the centroid of its particles and carries their
+// mean attribute.
+static void buildLod(
+    const float4* positions,
+    size_t count,
+    const float3& bbox_min,
+    float fixed_radius,
+    std::vector<float4>& lod_positions,
+    std::vector<unsigned char>& lod_levels )
+{
+    lod_positions.clear();
+    lod_levels.clear();
+
+    std::vector<float4> level_positions;
+    std::vector<float>  level_weights;
+    const float4* source = positions;
+    size_t source_count  = count;
+    for ( int level = 1; level <= lod_max_level && source_count > 1; ++level ) {
+        const float inv_cell = 1.f / ( 2.f * fixed_radius * static_cast<float>( 1 << level ) );
+
+        std::unordered_map<uint64_t, uint32_t> cells;
+        std::vector<float4> sums;
+        std::vector<float>  weights;
+        for ( size_t i = 0; i < source_count; ++i ) {
+            const float4& p = source[i];
+            const uint64_t x = static_cast<uint64_t>( std::max( ( p.x - bbox_min.x ) * inv_cell, 0.f ) ) & 0x1FFFFF;
+            const uint64_t y = static_cast<uint64_t>( std::max( ( p.y - bbox_min.y ) * inv_cell, 0.f ) ) & 0x1FFFFF;
+            const uint64_t z = static_cast<uint64_t>( std::max( ( p.z - bbox_min.z ) * inv_cell, 0.f ) ) & 0x1FFFFF;
+            const uint64_t key = ( z << 42 ) | ( y << 21 ) | x;
+
+            std::unordered_map<uint64_t, uint32_t>::iterator it = cells.find( key );
+            if ( it == cells.end() ) {
+                it = cells.insert( std::make_pair( key, static_cast<uint32_t>( sums.size() ) ) ).first;
+                sums.push_back( make_float4( 0.f ) );
+                weights.push_back( 0.f );
+            }
+            const float weight = level_weights.empty() ? 1.f : level_weights[i];
+            sums[it->second]    += p * weight;
+            weights[it->second] += weight;
+        }
+
+        for ( size_t i = 0; i < sums.size(); ++i ) {
+            sums[i] /= weights[i];
+            lod_positions.push_back( sums[i] );
+            lod_levels.push_back( static_cast<unsigned char>( level ) );
+        }
+        std::cout << "LOD level " << level << ": " << sums.size() << " aggregates" << std::endl;
+
+        level_positions.swap( sums );
+        level_weights.swap( weights );
+        source       = &level_positions[0];
+        source_count = level_positions.size();
+    }
+}
+
+
+// Quantizes the positions relative to the bounds and the attribute relative to its range.
+static void uploadQuantizedPositions(
+    const float4* positions,
+    size_t count,
+    const std::vector<float4>& lod_positions,
+    const float3& bbox_min,
+    const float3& bbox_max )
+{
+    float wmin = 1e16f;
+    float wmax = -1e16f;
+    for ( size_t i = 0; i < count + lod_positions.size(); ++i ) {
+        const float w = i < count ? positions[i].w : lod_positions[i - count].w;
+        wmin = fminf( wmin, w );
+        wmax = fmaxf( wmax, w );
+    }
+    const float  wrange = wmax > wmin ? wmax - wmin : 1.f;
+    const float3 extent = bbox_max - bbox_min;
+    const float3 scale  = make_float3( 65535.f ) / extent;
+    const float  wscale = 65535.f / wrange;
+
+    buffers.positions->setSize( 0 );
+    buffers.quantized_positions->setSize( count + lod_positions.size() );
+    ushort4* q = reinterpret_cast<ushort4*>( buffers.quantized_positions->map() );
+    for ( size_t i = 0; i < count + lod_positions.size(); ++i ) {
+        const float4& p = i < count ? positions[i] : lod_positions[i - count];
+        const float3 u = ( make_float3( p.x, p.y, p.z ) - bbox_min ) * scale + make_float3( 0.5f );
+        const float  v = ( p.w - wmin ) * wscale + 0.5f;
+        q[i] = make_ushort4( static_cast<unsigned short>( std::min( std::max( u.x, 0.f ), 65535.f ) ),
+                             static_cast<unsigned short>( std::min( std::max( u.y, 0.f ), 65535.f ) ),
+                             static_cast<unsigned short>( std::min( std::max( u.z, 0.f ), 65535.f ) ),
+                             static_cast<unsigned short>( std::min( std::max( v,   0.f ), 65535.f ) ) );
+    }
+    buffers.quantized_positions->unmap();
+
+    context[ "quantized_origin"    ]->setFloat( bbox_min );
+    context[ "quantized_extent"    ]->setFloat( extent );
+    context[ "quantized_attribute" ]->setFloat( wmin, wrange );
+}
+
+
+// Uploads the particle positions followed by the aggregates.
+static void uploadPositions(
+    const float4* positions,
+    size_t count,
+    const std::vector<float4>& lod_positions,
+    const std::vector<unsigned char>& lod_levels,
+    const float3& bbox_min,
+    const float3& bbox_max )
+{
+    if ( quantized ) {
+        uploadQuantizedPositions( positions, count, lod_positions, bbox_min, bbox_max );
+    } else {
+        buffers.positions->setSize( count + lod_positions.size() );
+        float4* pos = reinterpret_cast<float4*>( buffers.positions->map( 0, RT_BUFFER_MAP_WRITE_DISCARD ) );
+        if ( count > 0 )
+            memcpy( pos, positions, count * sizeof( float4 ) );
+        if ( !lod_positions.empty() )
+            memcpy( pos + count, &lod_positions[0], lod_positions.size() * sizeof( float4 ) );
+        buffers.positions->unmap();
+    }
+
+    buffers.lod_levels->setSize( std::max<size_t>( lod_levels.size(), 1 ) );
+    if ( !lod_levels.empty() ) {
+        memcpy( buffers.lod_levels->map(), &lod_levels[0], lod_levels.size() );
+        buffers.lod_levels->unmap();
+    }
+    context[ "lod_first" ]->setUint( static_cast<unsigned int>( count ) );
+}
+
+
 static void fillBuffers(
-    const std::vector<float4> &positions,
     const std::vector<float3> &velocities,
     const std::vector<float3> &colors,
     const std::vector<float>  &radii)
 {
-    buffers.positions->setSize( positions.size() );
-    float *pos = reinterpret_cast<float*> ( buffers.positions->map() );
-    for ( int i=0, index = 0; i<static_cast<int>(positions.size()); ++i ) {
-        float4 p = positions[i];
-
-        pos[index++] = p.x;
-        pos[index++] = p.y;
-        pos[index++] = p.z;
-        pos[index++] = p.w;
+    if ( quantized ) {
+        buffers.velocities->setSize( 0 );
+        buffers.colors->setSize( 0 );
+        buffers.radii->setSize( 0 );
+        return;
     }
-    buffers.positions->unmap();
 
     buffers.velocities->setSize( velocities.size() );
     float *vel = reinterpret_cast<float*> ( buffers.velocities->map() );
@@ -370,7 +885,7 @@ void createMaterialPrograms(
     Program &any_hit)
 {
     if( !any_hit )
-      any_hit     = context->createProgramFromPTXFile( ptxPath("particles_material_rbf.cu"), "any_hit" );
+      any_hit     = sutil::createProgramFromPTXFile( context, ptxPath("particles_material_rbf.cu"), kbuffer ? "any_hit_kbuffer" : "any_hit" );
 }
 
 
@@ -388,70 +903,152 @@ Material createOptiXMaterial(
 
 Program createBoundingBoxProgram( Context context )
 {
-  return context->createProgramFromPTXFile( ptxPath("particles_geometry_rbf.cu"), "particle_bounds" );
+  return sutil::createProgramFromPTXFile( context, ptxPath("particles_geometry_rbf.cu"), "particle_bounds" );
 }
 
 
 Program createIntersectionProgram( Context context )
 {
-  return context->createProgramFromPTXFile( ptxPath("particles_geometry_rbf.cu"), "particle_intersect" );
+  return sutil::createProgramFromPTXFile( context, ptxPath("particles_geometry_rbf.cu"), "particle_intersect" );
 }
 
-void readFile( std::vector<float4>& positions, 
-               std::vector<float3>& velocities, 
-               std::vector<float3>& colors, 
-               std::vector<float>& radii, 
-               float3& bbox_min, 
-               float3& bbox_max )
+static unsigned int loaderThreadCount()
 {
-	//read raw data file.
-    if (particles_file_extension == "raw")
-    {
-        std::cout << "Reading raw file" << particles_file << std::endl;
+    return sutil::TaskPool::instance().numThreads();
+}
 
-        FILE* fp = fopen(particles_file.c_str(), "r");
-        fseek(fp, 0L, SEEK_END);
-        size_t sz = ftell(fp);
-        rewind(fp);
 
-        size_t numParticles = sz / 16;
-        std::cout << "# particles = " << numParticles << std::endl;
+// Runs fn( begin, end, chunk ) over num_chunks contiguous ranges of [0, n) as tasks of the shared sutil::TaskPool.
+template <typename Fn>
+static void parallelChunks( size_t n, unsigned int num_chunks, Fn fn )
+{
+    sutil::parallelFor( 0u, num_chunks, [&]( unsigned int c ) {
+        fn( n * c / num_chunks, n * ( c + 1 ) / num_chunks, c );
+    } );
+}
 
-        if (max_particles > 0 && numParticles > max_particles)
-        {
-          std::cout << "only reading " << max_particles << " particles." << std::endl;
-          numParticles = max_particles;
+
+// Component wise bounds of the positions including w, reduced from per thread partial bounds.
+static void parallelBounds( const std::vector<float4>& positions, float4& pmin, float4& pmax )
+{
+    const unsigned int num_chunks = loaderThreadCount();
+    std::vector<float4> mins( num_chunks, make_float4(  1e16f ) );
+    std::vector<float4> maxs( num_chunks, make_float4( -1e16f ) );
+
+    parallelChunks( positions.size(), num_chunks, [&]( size_t begin, size_t end, unsigned int c ) {
+        float4 lo = mins[c];
+        float4 hi = maxs[c];
+        for ( size_t i = begin; i < end; ++i ) {
+            const float4& p = positions[i];
+            lo = make_float4( fminf( lo.x, p.x ), fminf( lo.y, p.y ), fminf( lo.z, p.z ), fminf( lo.w, p.w ) );
+            hi = make_float4( fmaxf( hi.x, p.x ), fmaxf( hi.y, p.y ), fmaxf( hi.z, p.z ), fmaxf( hi.w, p.w ) );
         }
+        mins[c] = lo;
+        maxs[c] = hi;
+    } );
+
+    pmin = make_float4(  1e16f );
+    pmax = make_float4( -1e16f );
+    for ( unsigned int c = 0; c < num_chunks; ++c ) {
+        pmin = make_float4( fminf( pmin.x, mins[c].x ), fminf( pmin.y, mins[c].y ), fminf( pmin.z, mins[c].z ), fminf( pmin.w, mins[c].w ) );
+        pmax = make_float4( fmaxf( pmax.x, maxs[c].x ), fmaxf( pmax.y, maxs[c].y ), fmaxf( pmax.z, maxs[c].z ), fmaxf( pmax.w, maxs[c].w ) );
+    }
+}
 
-        positions.resize(numParticles);
-        size_t b = fread(&positions[0], sizeof(float), numParticles, fp);
-        fclose(fp);
 
-        float4 pmin, pmax;
+// Particles parsed from one chunk of a text file.
+struct ParticleTextChunk
+{
+    std::vector<float4> positions;
+    std::vector<float3> velocities;
+    std::vector<float3> colors;
+    std::vector<float>  radii;
+};
 
-        pmin.x = pmin.y = pmin.z = pmin.w = 1e16f;
-        pmax.x = pmax.y = pmax.z = pmax.w = -1e16f;
 
-        const float rd = fixed_radius;
+// Parses the lines in [begin, end). The expected format is: position, velocity, color and radius.
+static void parseParticleText( const char* begin, const char* end, float fixed_radius, ParticleTextChunk& chunk )
+{
+    const size_t maxchars = 8192;
+    char buf[maxchars];
 
-        #pragma omp parallel for
-        for(size_t i=0; i<numParticles; i++)
-        {
-            const float4& p = positions[i];
+    while ( begin < end ) {
+        const char* eol = static_cast<const char*>( memchr( begin, '\n', end - begin ) );
+        if ( !eol )
+            eol = end;
+
+        size_t len = std::min<size_t>( eol - begin, maxchars - 1 );
+        memcpy( buf, begin, len );
+        begin = eol + 1;
+
+        // Trim '\r' of '\r\n'
+        if ( len > 0 && buf[len - 1] == '\r' )
+            --len;
+        buf[len] = '\0';
+
+        // Skip leading space.
+        const char *token = buf;
+        token += strspn( token, " \t" );
+
+        if ( token[0] == '\0' )
+            continue; // empty line
+
+        if ( token[0] == '#' )
+            continue; // comment line
+
+        // position
+        float x  = parseFloat( token );
+        float y  = parseFloat( token );
+        float z  = parseFloat( token );
+
+        // velocity
+        float vx = parseFloat( token );
+        float vy = parseFloat( token );
+        float vz = parseFloat( token );
+
+        float3 vel = make_float3(vx,vy,vz);
+        float vel_magnitude = length(vel);
 
-            pmin.x = fminf(pmin.x, p.x);
-            pmin.y = fminf(pmin.y, p.y);
-            pmin.z = fminf(pmin.z, p.z);
-            pmin.w = fminf(pmin.w, p.w);
+        float r,g,b;
+        r=g=b=.9f;
 
-            pmax.x = fmaxf(pmax.x, p.x);
-            pmax.y = fmaxf(pmax.y, p.y);
-            pmax.z = fmaxf(pmax.z, p.z);
-            pmax.w = fmaxf(pmax.w, p.w);
+        if (particles_file_colors)
+        {
+          // color
+          r  = parseFloat( token );
+          g  = parseFloat( token );
+          b  = parseFloat( token );
+        }
+        
+        float rd = fixed_radius;
+        if (particles_file_radius)
+        {
+          // radius
+          rd = parseFloat( token );
         }
 
-        std::cout << "Particle pmin = " << pmin << std::endl;
-        std::cout << "Particle pmax = " << pmax << std::endl;
+        chunk.positions.push_back( make_float4( x, y, z, vel_magnitude ) );
+        chunk.velocities.push_back( vel );
+        chunk.colors.push_back( make_float3( r, g, b ) );
+        chunk.radii.push_back( rd );
+    }
+}
+
+
+// Derives the padded bounds, the automatic fixed_radius and the normalization of the attribute in w
+// from the bounds of the raw positions, returns the scale and offset of w. Raw files keep the sign of
+// the attribute (tf_type 3 if negative), text files hold velocity magnitudes. fixed_radius and tf_type
+// are the settings of the frame, the caller applies them.
+static float2 preprocessBounds( const float4& pmin, const float4& pmax, size_t numParticles,
+                                float& fixed_radius, int& tf_type,
+                                float3& bbox_min, float3& bbox_max, float2& attribute_range )
+{
+    std::cout << "Particle pmin = " << pmin << std::endl;
+    std::cout << "Particle pmax = " << pmax << std::endl;
+
+    if (particles_file_extension == "raw")
+    {
+        const float rd = fixed_radius;
 
         bbox_min = make_float3(pmin.x - rd, pmin.y - rd, pmin.z - rd);
         bbox_max = make_float3(pmax.x + rd, pmax.y + rd, pmax.z + rd);
@@ -479,18 +1076,94 @@ void readFile( std::vector<float4>& positions,
         }
 
         std::cout << "Transfer function tf_type = " << tf_type << std::endl;
+        attribute_range = make_float2( pmin.w, pmax.w );
+
+        // The normalization is monotonic, so the normalized range follows from the bounds.
+        const float wmin = pmin.w * wRange + wOff;
+        const float wmax = pmax.w * wRange + wOff;
+        std::cout << "Attribute range wmin = " << wmin << ", wmax = " << wmax << std::endl;
+        return make_float2( wRange, wOff );
+    }
+
+    // w holds the velocity magnitude, its bounds are the attribute range
+    const float wmin = pmin.w;
+    const float wmax = pmax.w;
+
+    bbox_min = make_float3(pmin.x, pmin.y, pmin.z);
+    bbox_max = make_float3(pmax.x, pmax.y, pmax.z);
+
+    if (fixed_radius == 0.f)
+      fixed_radius = length(bbox_max - bbox_min) / powf(float(numParticles), 0.333333f);  
+
+    std::cout << "Using fixed_radius = " << fixed_radius << std::endl;
+
+    bbox_min -= make_float3(fixed_radius);
+    bbox_max += make_float3(fixed_radius);
+
+    std::cout << "Attribute range wmin = " << wmin << ", wmax = " << wmax << std::endl;
+    attribute_range = make_float2( wmin, wmax );
+
+    return make_float2( float( 1.0 / double(wmax - wmin) ), 0.f );
+}
+
+
+// Reduces the bounds of the raw positions and normalizes their attributes on the host.
+static void preprocessOnHost( std::vector<float4>& positions, float& fixed_radius, int& tf_type,
+                              float3& bbox_min, float3& bbox_max, float2& attribute_range )
+{
+    float4 pmin, pmax;
+    parallelBounds( positions, pmin, pmax );
+
+    const float2 transform = preprocessBounds( pmin, pmax, positions.size(), fixed_radius, tf_type,
+                                               bbox_min, bbox_max, attribute_range );
+
+    parallelChunks( positions.size(), loaderThreadCount(), [&]( size_t begin, size_t end, unsigned int ) {
+        for ( size_t i = begin; i < end; ++i )
+            positions[i].w = positions[i].w * transform.x + transform.y;
+    } );
+}
+
+
+void readFile( int frame,
+               std::vector<float4>& positions, 
+               std::vector<float3>& velocities, 
+               std::vector<float3>& colors, 
+               std::vector<float>& radii, 
+               float& fixed_radius,
+               int& tf_type,
+               float3& bbox_min, 
+               float3& bbox_max,
+               float2& attribute_range )
+{
+	//read raw data file.
+    if (particles_file_extension == "raw")
+    {
+        std::cout << "Reading raw file" << particles_file << std::endl;
+
+        FILE* fp = fopen(particles_file.c_str(), "rb");
+        if (!fp)
+            throw Exception( "Could not open particle file " + particles_file );
+        fseek(fp, 0L, SEEK_END);
+        size_t sz = ftell(fp);
+        rewind(fp);
 
-        #pragma omp parallel for
-        for(size_t i=0; i<numParticles; i++)
-            positions[i].w = positions[i].w * wRange + wOff;
+        size_t numParticles = sz / 16;
+        std::cout << "# particles = " << numParticles << std::endl;
 
-        float wmin = 1e16f;
-        float wmax = -1e16f;
-        for(size_t i=0; i<numParticles; i++){
-            wmin = fminf(wmin, positions[i].w);
-            wmax = fmaxf(wmax, positions[i].w);
+        if (max_particles > 0 && numParticles > max_particles)
+        {
+          std::cout << "only reading " << max_particles << " particles." << std::endl;
+          numParticles = max_particles;
         }
-        std::cout << "Attribute range wmin = " << wmin << ", wmax = " << wmax << std::endl;
+
+        positions.resize(numParticles);
+        if (numParticles > 0)
+            numParticles = fread(&positions[0], sizeof(float4), numParticles, fp);
+        positions.resize(numParticles);
+        fclose(fp);
+
+        if (!gpu_preprocess)
+            preprocessOnHost( positions, fixed_radius, tf_type, bbox_min, bbox_max, attribute_range );
     }
      
     //read txt data file
@@ -498,211 +1171,565 @@ void readFile( std::vector<float4>& positions,
     {
         std::cout << "Reading txt file" << particles_file << std::endl;
 
-        std::string filename = particles_file_base;
+        const std::string filename = particleFrameFileName( frame, "txt" );
 
-        if ( current_particle_frame > 0 ) {
-            std::ostringstream s;
-            s << current_particle_frame;
+        // A missing frame of a sequence loads as empty, it may be read by the prefetch thread
+        MappedFile file;
+        if ( !file.open( filename ) ) {
+            std::cout << "Could not read " << filename << std::endl;
+            return;
+        }
 
-            if ( current_particle_frame < 10 )
-                filename += ".000" + s.str() + ".txt";
-            else
-                filename += ".00" + s.str() + ".txt";
+        // Split the file into one chunk per thread at line boundaries
+        const unsigned int num_chunks = loaderThreadCount();
+        const char* text_begin = file.data();
+        const char* text_end   = file.data() + file.size();
+        std::vector<const char*> splits( num_chunks + 1, text_end );
+        splits[0] = text_begin;
+        for ( unsigned int c = 1; c < num_chunks; ++c ) {
+            const char* split = std::max( text_begin + file.size() * c / num_chunks, splits[c - 1] );
+            const char* eol   = static_cast<const char*>( memchr( split, '\n', text_end - split ) );
+            splits[c] = eol ? eol + 1 : text_end;
         }
-        else
-            filename = particles_file_base;
 
+        std::vector<ParticleTextChunk> chunks( num_chunks );
+        parallelChunks( num_chunks, num_chunks, [&]( size_t, size_t, unsigned int c ) {
+            parseParticleText( splits[c], splits[c + 1], fixed_radius, chunks[c] );
+        } );
+
+        // Merge the chunks in file order
+        size_t numParticles = 0;
+        for ( unsigned int c = 0; c < num_chunks; ++c )
+            numParticles += chunks[c].positions.size();
+        positions.reserve( numParticles );
+        velocities.reserve( numParticles );
+        colors.reserve( numParticles );
+        radii.reserve( numParticles );
+        for ( unsigned int c = 0; c < num_chunks; ++c ) {
+            positions.insert( positions.end(), chunks[c].positions.begin(), chunks[c].positions.end() );
+            velocities.insert( velocities.end(), chunks[c].velocities.begin(), chunks[c].velocities.end() );
+            colors.insert( colors.end(), chunks[c].colors.begin(), chunks[c].colors.end() );
+            radii.insert( radii.end(), chunks[c].radii.begin(), chunks[c].radii.end() );
+            chunks[c] = ParticleTextChunk();
+        }
+        chunks.clear();
 
-        std::ifstream ifs( filename.c_str() );
+        std::cout << "# particles = " << numParticles << std::endl;
 
-        bbox_min.x = bbox_min.y = bbox_min.z = 1e16f;
-        bbox_max.x = bbox_max.y = bbox_max.z = -1e16f;
+        if (!gpu_preprocess)
+            preprocessOnHost( positions, fixed_radius, tf_type, bbox_min, bbox_max, attribute_range );
+    }
 
-        int maxchars = 8192;
-        std::vector<char> buf(static_cast<size_t>(maxchars)); // Alloc enough size
+}
 
-        float wmin = 1e16f;
-        float wmax = -1e16f;
 
-        while ( ifs.peek() != -1 ) {
-            ifs.getline( &buf[0], maxchars );
+// Marks the particle BVH dirty, refitting it when the topology is unchanged. Changing only the radius
+// or advecting the same particles always refits.
+void markParticlesDirty( size_t num_particles, bool same_particles = false )
+{
+    const bool refit = same_particles ||
+        ( refit_interval > 0 && num_particles == bvh_particle_count && refit_count < refit_interval );
+    refit_count = refit ? refit_count + 1 : 0;
+    bvh_particle_count = num_particles;
 
-            std::string linebuf(&buf[0]);
+    Acceleration accel = geometry_group->getAcceleration();
+    accel->setProperty( "refit", refit ? "1" : "0" );
+    accel->markDirty();
+}
 
-            // Trim newline '\r\n' or '\n'
-            if ( linebuf.size() > 0 ) {
-                if ( linebuf[linebuf.size() - 1] == '\n' )
-                    linebuf.erase(linebuf.size() - 1);
-            }
 
-            if ( linebuf.size() > 0 ) {
-                if ( linebuf[linebuf.size() - 1] == '\r' )
-                    linebuf.erase( linebuf.size() - 1 );
-            }
+// Launches the ray generation program, once per non-empty brick in brick mode.
+static void launchFrame( unsigned int launch_width, unsigned int launch_height )
+{
+    SUTIL_NVTX_RANGE( "launchFrame" );
 
-            // Skip if empty line.
-            if ( linebuf.empty() ) {
-                continue;
-            }
+    if ( brick_res <= 0 ) {
+        context->launch( 0, launch_width, launch_height );
+        return;
+    }
 
-            // Skip leading space.
-            const char *token = linebuf.c_str();
-            token += strspn( token, " \t" );
+    // The cells of a uniform grid are the Voronoi cells of their centres, so the distance of the centres
+    // to the eye is a valid front to back order of the bricks.
+    const float3 eye = context[ "eye" ]->getFloat3();
+    std::vector< std::pair<float, int> > order;
+    for ( size_t b = 0; b < brick_particles.size(); ++b )
+        if ( !brick_particles[b].empty() )
+            order.push_back( std::make_pair( length( brick_bounds[b].center() - eye ), static_cast<int>( b ) ) );
+    std::sort( order.begin(), order.end() );
+    if ( order.empty() ) {
+        // no particles, the launch still clears the frame
+        geometry->setPrimitiveCount( 0 );
+        markParticlesDirty( 0 );
+        brick_resident = -1;
+        context[ "brick_count" ]->setInt( 0 );
+        context->launch( 0, launch_width, launch_height );
+        return;
+    }
 
-            assert( token );
-            if ( token[0] == '\0' )
-                continue; // empty line
+    const float3 bbox_min = context[ "bbox_min" ]->getFloat3();
+    const float3 bbox_max = context[ "bbox_max" ]->getFloat3();
+    context[ "brick_count" ]->setInt( static_cast<int>( order.size() ) );
+
+    for ( size_t i = 0; i < order.size(); ++i ) {
+        const int brick = order[i].second;
+        if ( brick != brick_resident ) {
+            const std::vector<float4>& particles = brick_particles[brick];
+            uploadPositions( &particles[0], particles.size(), std::vector<float4>(), std::vector<unsigned char>(),
+                             bbox_min, bbox_max );
+            geometry->setPrimitiveCount( static_cast<int>( particles.size() ) );
+            // the BVH of another brick is never refitted
+            bvh_particle_count = 0;
+            markParticlesDirty( particles.size() );
+            brick_resident = brick;
+        }
+        context[ "brick_min"   ]->setFloat( brick_bounds[brick].m_min );
+        context[ "brick_max"   ]->setFloat( brick_bounds[brick].m_max );
+        context[ "brick_index" ]->setInt( static_cast<int>( i ) );
+        context->launch( 0, launch_width, launch_height );
+    }
+}
 
-            if ( token[0] == '#' )
-                continue; // comment line
 
-            // meaningful line here. The expected format is: position, velocity, color and radius
+// Maps a binary particle file and copies its arrays straight into the OptiX buffers. These files are not
+// kept in the frame cache, the page cache already serves repeated loads without a second host copy.
+void loadBinaryParticles()
+{
+    const std::string filename = particleFrameFileName( current_particle_frame, "ppv" );
+    std::cout << "Reading binary file " << filename << std::endl;
+
+    MappedFile file;
+    if ( !file.open( filename ) )
+        throw Exception( "Could not map particle file " + filename );
+
+    ParticleFileHeader header;
+    if ( file.size() < sizeof( header ) )
+        throw Exception( "Truncated particle file " + filename );
+    memcpy( &header, file.data(), sizeof( header ) );
+    if ( memcmp( header.magic, PARTICLE_FILE_MAGIC, sizeof( header.magic ) ) != 0 )
+        throw Exception( "Not a binary particle file: " + filename );
+    if ( header.version != PARTICLE_FILE_VERSION )
+        throw Exception( "Unsupported binary particle file version in " + filename );
+
+    const size_t stored = static_cast<size_t>( header.count );
+    size_t expected = sizeof( header ) + stored * sizeof( float4 );
+    if ( header.flags & PARTICLE_FILE_VELOCITIES ) expected += stored * sizeof( float3 );
+    if ( header.flags & PARTICLE_FILE_COLORS )     expected += stored * sizeof( float3 );
+    if ( header.flags & PARTICLE_FILE_RADII )      expected += stored * sizeof( float );
+    if ( file.size() < expected )
+        throw Exception( "Truncated particle file " + filename );
+
+    size_t numParticles = stored;
+    std::cout << "# particles = " << numParticles << std::endl;
+    if ( max_particles > 0 && numParticles > max_particles )
+    {
+        std::cout << "only reading " << max_particles << " particles." << std::endl;
+        numParticles = max_particles;
+    }
 
-            // position
-            float x  = parseFloat( token );
-            float y  = parseFloat( token );
-            float z  = parseFloat( token );
+    const char* data = file.data() + sizeof( header );
+    const float4* positions = reinterpret_cast<const float4*>( data );
+    data += stored * sizeof( float4 );
+
+    const bool velocities = ( header.flags & PARTICLE_FILE_VELOCITIES ) != 0;
+    copyToBuffer( buffers.velocities, data, velocities && !quantized ? numParticles : 0, sizeof( float3 ) );
+    if ( velocities ) data += stored * sizeof( float3 );
+
+    const bool colors = ( header.flags & PARTICLE_FILE_COLORS ) != 0;
+    copyToBuffer( buffers.colors, data, colors && !quantized ? numParticles : 0, sizeof( float3 ) );
+    if ( colors ) data += stored * sizeof( float3 );
+
+    const bool radii = ( header.flags & PARTICLE_FILE_RADII ) != 0;
+    copyToBuffer( buffers.radii, data, radii && !quantized ? numParticles : 0, sizeof( float ) );
+
+    // The bounds were padded with this radius when the file was written
+    fixed_radius = header.radius;
+    if ( header.flags & PARTICLE_FILE_SIGNED )
+        tf_type = 3;
+    std::cout << "Particle fixed_radius = " << fixed_radius << std::endl;
+    std::cout << "Attribute range wmin = " << header.attribute_min << ", wmax = " << header.attribute_max << std::endl;
+
+    const float3 bbox_min = make_float3( header.bbox_min[0], header.bbox_min[1], header.bbox_min[2] );
+    const float3 bbox_max = make_float3( header.bbox_max[0], header.bbox_max[1], header.bbox_max[2] );
+
+    context[ "fixed_radius"     ]->setFloat(fixed_radius);
+    context[ "segment_size"     ]->setFloat(segment_size);
+    context[ "wScale" ] ->setFloat(wScale);
+    context[ "opacity" ] ->setFloat(opacity);
+    context[ "tf_type" ]->setInt(tf_type);
+    updatePreintegratedTf();
+
+    context[ "bbox_min"     ]->setFloat(bbox_min);
+    context[ "bbox_max"     ]->setFloat(bbox_max);
+
+    std::vector<float4>        lod_positions;
+    std::vector<unsigned char> lod_levels;
+    buildLod( positions, numParticles, bbox_min, fixed_radius, lod_positions, lod_levels );
+    if ( brick_res > 0 )
+        buildBricks( positions, numParticles, bbox_min, bbox_max );
+    else
+        uploadPositions( positions, numParticles, lod_positions, lod_levels, bbox_min, bbox_max );
 
-            // velocity
-            float vx = parseFloat( token );
-            float vy = parseFloat( token );
-            float vz = parseFloat( token );
+    std::vector<unsigned char> occupancy;
+    buildOccupancyGrid( positions, numParticles, lod_positions, lod_levels, bbox_min, bbox_max, fixed_radius, occupancy );
+    uploadOccupancyGrid( occupancy );
 
-            float3 vel = make_float3(vx,vy,vz);
-            float vel_magnitude = length(vel);
+    geometry->setPrimitiveCount( (int) ( numParticles + lod_positions.size() ) );
 
-            wmin = fminf(wmin, vel_magnitude);
-            wmax = fmaxf(wmax, vel_magnitude);
+    // the bounding box will actually be used only for the first frame
+    aabb.set( bbox_min, bbox_max );
 
-            float r,g,b;
-            r=g=b=.9f;
+    markParticlesDirty( numParticles + lod_positions.size() );
+}
 
-            if (particles_file_colors)
-            {
-              // color
-              r  = parseFloat( token );
-              g  = parseFloat( token );
-              b  = parseFloat( token );
-            }
-            
-            float rd = fixed_radius;
-            if (particles_file_radius)
-            {
-              // radius
-              rd = parseFloat( token );
-            }
 
-            positions.push_back( make_float4( x, y, z, vel_magnitude ) );
-            velocities.push_back( make_float3( vx, vy, vz ) );
-            colors.push_back( make_float3( r, g, b ) );
-            radii.push_back( rd );
-        }
+// Writes the particles of the current frame as a binary particle file.
+void writeBinaryParticles( const std::string& filename )
+{
+    ParticleFramePtr data;
+    {
+        std::lock_guard<std::mutex> lock( dataCacheMutex );
+        std::map<int, ParticleFramePtr>::const_iterator cacheIt = dataCache.find( current_particle_frame );
+        if ( cacheIt != dataCache.end() )
+            data = cacheIt->second;
+    }
+    if ( !data )
+        throw Exception( "No particles loaded to write to " + filename );
+    const ParticleFrameData& frame = *data;
+
+    ParticleFileHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, PARTICLE_FILE_MAGIC, sizeof( header.magic ) );
+    header.version = PARTICLE_FILE_VERSION;
+    header.count   = frame.positions.size();
+    header.flags   = ( frame.velocities.empty() ? 0u : PARTICLE_FILE_VELOCITIES ) |
+                     ( frame.colors.empty()     ? 0u : PARTICLE_FILE_COLORS ) |
+                     ( frame.radii.empty()      ? 0u : PARTICLE_FILE_RADII ) |
+                     ( tf_type == 3             ? PARTICLE_FILE_SIGNED : 0u );
+    header.radius  = fixed_radius;
+    header.bbox_min[0] = frame.bbox_min.x; header.bbox_min[1] = frame.bbox_min.y; header.bbox_min[2] = frame.bbox_min.z;
+    header.bbox_max[0] = frame.bbox_max.x; header.bbox_max[1] = frame.bbox_max.y; header.bbox_max[2] = frame.bbox_max.z;
+    header.attribute_min = frame.attribute_range.x;
+    header.attribute_max = frame.attribute_range.y;
+
+    std::ofstream out( filename.c_str(), std::ios::binary );
+    out.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+    if ( !frame.positions.empty() )
+        out.write( reinterpret_cast<const char*>( &frame.positions[0] ), frame.positions.size() * sizeof( float4 ) );
+    if ( !frame.velocities.empty() )
+        out.write( reinterpret_cast<const char*>( &frame.velocities[0] ), frame.velocities.size() * sizeof( float3 ) );
+    if ( !frame.colors.empty() )
+        out.write( reinterpret_cast<const char*>( &frame.colors[0] ), frame.colors.size() * sizeof( float3 ) );
+    if ( !frame.radii.empty() )
+        out.write( reinterpret_cast<const char*>( &frame.radii[0] ), frame.radii.size() * sizeof( float ) );
+    if ( !out )
+        throw Exception( "Failed to write particle file " + filename );
+
+    std::cout << "Wrote " << header.count << " particles to " << filename << std::endl;
+}
 
-        const size_t numParticles = positions.size();
-        std::cout << "# particles = " << numParticles << std::endl;
 
-        float4 pmin, pmax;
-        pmin.x = pmin.y = pmin.z = pmin.w = 1e16f;
-        pmax.x = pmax.y = pmax.z = pmax.w = -1e16f;
+// Frame number step frames away from frame, wrapping around the sequence.
+int nextParticleFrame( int frame, int step )
+{
+    const int n = std::max( max_particle_frames, 1 );
+    return ( ( frame - 1 + step ) % n + n ) % n + 1;
+}
 
-        for(size_t i=0; i<numParticles; i++)
-        {
-            const float4& p = positions[i];
 
-            pmin.x = fminf(pmin.x, p.x);
-            pmin.y = fminf(pmin.y, p.y);
-            pmin.z = fminf(pmin.z, p.z);
-            pmin.w = fminf(pmin.w, p.w);
+static size_t frameBytes( const ParticleFrameData& frame )
+{
+    return frame.positions.size()  * sizeof( float4 ) +
+           frame.velocities.size() * sizeof( float3 ) +
+           frame.colors.size()     * sizeof( float3 ) +
+           frame.radii.size()      * sizeof( float ) +
+           frame.occupancy.size() +
+           frame.lod_positions.size() * sizeof( float4 ) +
+           frame.lod_levels.size();
+}
+
+
+// Reads a frame with the given settings. The prefetch thread calls this too, so it must not touch the globals.
+static ParticleFramePtr readFrame( int frame, float fixed_radius, int tf_type )
+{
+    std::shared_ptr<ParticleFrameData> data( new ParticleFrameData() );
+    data->fixed_radius = fixed_radius;
+    data->tf_type      = tf_type;
+    readFile( frame, data->positions, data->velocities, data->colors, data->radii,
+              data->fixed_radius, data->tf_type, data->bbox_min, data->bbox_max, data->attribute_range );
+    data->preprocessed = !gpu_preprocess;
+    const float4* positions = data->positions.empty() ? 0 : &data->positions[0];
+    buildLod( positions, data->positions.size(), data->bbox_min, data->fixed_radius, data->lod_positions, data->lod_levels );
+    buildOccupancyGrid( positions, data->positions.size(), data->lod_positions, data->lod_levels,
+                        data->bbox_min, data->bbox_max, data->fixed_radius, data->occupancy );
+    return data;
+}
+
+
+// Marks a cached frame as the most recently used. Expects dataCacheMutex to be held.
+static void touchFrame( int frame )
+{
+    dataCacheLru.remove( frame );
+    dataCacheLru.push_front( frame );
+}
+
 
-            pmax.x = fmaxf(pmax.x, p.x);
-            pmax.y = fmaxf(pmax.y, p.y);
-            pmax.z = fmaxf(pmax.z, p.z);
-            pmax.w = fmaxf(pmax.w, p.w);
+// Caches a frame and evicts the least recently used ones above the budget, the newest frame always stays.
+// Expects dataCacheMutex to be held.
+static void cacheFrame( int frame, const ParticleFramePtr& data )
+{
+    if ( dataCache.count( frame ) )
+        return;
+
+    dataCache[frame] = data;
+    dataCacheLru.push_front( frame );
+    dataCacheBytes += frameBytes( *data );
+    while ( dataCacheBytes > frame_cache_bytes && dataCacheLru.size() > 1 ) {
+        const int victim = dataCacheLru.back();
+        dataCacheLru.pop_back();
+        dataCacheBytes -= frameBytes( *dataCache[victim] );
+        dataCache.erase( victim );
+    }
+}
+
+
+static void prefetchLoop()
+{
+    std::unique_lock<std::mutex> lock( dataCacheMutex );
+    for ( ;; ) {
+        dataCacheCondition.wait( lock, []{ return prefetchQuit || !prefetchQueue.empty(); } );
+        if ( prefetchQuit )
+            return;
+
+        const int frame = prefetchQueue.front();
+        prefetchQueue.pop_front();
+        if ( dataCache.count( frame ) ) {
+            touchFrame( frame );
+            continue;
         }
 
-        std::cout << "Particle pmin = " << pmin << std::endl;
-        std::cout << "Particle pmax = " << pmax << std::endl;
+        const float radius = prefetchRadius;
+        const int   tf     = prefetchTfType;
+        dataCacheLoading.insert( frame );
+        lock.unlock();
+        ParticleFramePtr data = readFrame( frame, radius, tf );
+        lock.lock();
+        dataCacheLoading.erase( frame );
+        cacheFrame( frame, data );
+        dataCacheCondition.notify_all();
+    }
+}
 
-        bbox_min = make_float3(pmin.x, pmin.y, pmin.z);
-        bbox_max = make_float3(pmax.x, pmax.y, pmax.z);
 
-        if (fixed_radius == 0.f)
-          fixed_radius = length(bbox_max - bbox_min) / powf(float(numParticles), 0.333333f);  
+// Queues the frames following the current one in playback direction, as many as fit into the cache budget.
+static void requestPrefetch( size_t current_bytes )
+{
+    if ( current_particle_frame <= 0 || prefetch_frames <= 0 )
+        return;
 
-        std::cout << "Using fixed_radius = " << fixed_radius << std::endl;
+    {
+        std::lock_guard<std::mutex> lock( dataCacheMutex );
+        if ( !prefetchThread.joinable() )
+            prefetchThread = std::thread( prefetchLoop );
+
+        prefetchRadius = fixed_radius;
+        prefetchTfType = tf_type;
+        prefetchQueue.clear();
+        for ( int i = 1; i <= prefetch_frames && ( i + 1 ) * current_bytes <= frame_cache_bytes; ++i )
+            prefetchQueue.push_back( nextParticleFrame( current_particle_frame, i * play_direction ) );
+    }
+    dataCacheCondition.notify_all();
+}
 
-        bbox_min -= make_float3(fixed_radius);
-        bbox_max += make_float3(fixed_radius);
 
-        std::cout << "Attribute range wmin = " << wmin << ", wmax = " << wmax << std::endl;
+void stopFramePrefetch()
+{
+    {
+        std::lock_guard<std::mutex> lock( dataCacheMutex );
+        prefetchQuit = true;
+        prefetchQueue.clear();
+    }
+    dataCacheCondition.notify_all();
+    if ( prefetchThread.joinable() )
+        prefetchThread.join();
+}
 
-        float wRange = float( 1.0 / double(wmax - wmin) );
 
-        //#pragma omp parallel for
-        for(size_t i=0; i<positions.size(); i++)
-            positions[i].w = positions[i].w * wRange;
+// Preprocesses the raw positions just uploaded, only the partial bounds and the scalar results pass
+// between the host and the device.
+static void preprocessOnDevice( size_t count, float& fixed_radius, int& tf_type, float3& bbox_min, float3& bbox_max )
+{
+    SUTIL_NVTX_RANGE( "preprocessOnDevice" );
+
+    float4 pmin = make_float4(  1e16f );
+    float4 pmax = make_float4( -1e16f );
+    if ( count > 0 ) {
+        const unsigned int threads = static_cast<unsigned int>( std::min<size_t>( count, PREPROCESS_THREADS ) );
+        context[ "preprocess_count" ]->setUint( static_cast<unsigned int>( count ) );
+        context->launch( PREPROCESS_BOUNDS_ENTRY, threads );
+
+        Buffer mins = context[ "preprocess_min" ]->getBuffer();
+        Buffer maxs = context[ "preprocess_max" ]->getBuffer();
+        const float4* lo = static_cast<const float4*>( mins->map( 0, RT_BUFFER_MAP_READ ) );
+        const float4* hi = static_cast<const float4*>( maxs->map( 0, RT_BUFFER_MAP_READ ) );
+        for ( unsigned int t = 0; t < threads; ++t ) {
+            pmin = make_float4( fminf( pmin.x, lo[t].x ), fminf( pmin.y, lo[t].y ), fminf( pmin.z, lo[t].z ), fminf( pmin.w, lo[t].w ) );
+            pmax = make_float4( fmaxf( pmax.x, hi[t].x ), fmaxf( pmax.y, hi[t].y ), fmaxf( pmax.z, hi[t].z ), fmaxf( pmax.w, hi[t].w ) );
+        }
+        maxs->unmap();
+        mins->unmap();
     }
 
+    float2 attribute_range;
+    const float2 transform = preprocessBounds( pmin, pmax, count, fixed_radius, tf_type, bbox_min, bbox_max, attribute_range );
+
+    if ( count > 0 ) {
+        context[ "attribute_transform" ]->setFloat( transform );
+        context->launch( PREPROCESS_NORMALIZE_ENTRY, count );
+    }
+}
+
+
+// Uploads a frame of the cache into the buffers and marks the BVH dirty.
+static void uploadFrame( const ParticleFrameData& frame )
+{
+    // raw frames are uploaded as read and reduced and normalized on the device, the cache keeps them raw
+    float3 bbox_min = frame.bbox_min;
+    float3 bbox_max = frame.bbox_max;
+    float  radius   = frame.fixed_radius;
+    int    tf       = frame.tf_type;
+    if ( !frame.preprocessed ) {
+        uploadPositions( frame.positions.empty() ? 0 : &frame.positions[0], frame.positions.size(),
+                         frame.lod_positions, frame.lod_levels, bbox_min, bbox_max );
+        preprocessOnDevice( frame.positions.size(), radius, tf, bbox_min, bbox_max );
+    }
+
+    // The readers only derive the settings of a frame, they are applied here on the main thread.
+    // A radius or transfer function picked in the GUI after the frame was read stays.
+    if ( fixed_radius == 0.f )
+        fixed_radius = radius;
+    if ( tf == 3 )
+        tf_type = 3;
+
+    context[ "fixed_radius"     ]->setFloat(fixed_radius);
+    context[ "segment_size"     ]->setFloat(segment_size);
+    context[ "wScale" ] ->setFloat(wScale);
+    context[ "opacity" ] ->setFloat(opacity);
+    context[ "tf_type" ]->setInt(tf_type);
+    updatePreintegratedTf();
+
+    context[ "bbox_min"     ]->setFloat(bbox_min);
+    context[ "bbox_max"     ]->setFloat(bbox_max);
+
+    // all vectors have the same size, the aggregates follow the particles
+    const size_t num_primitives = frame.positions.size() + frame.lod_positions.size();
+    geometry->setPrimitiveCount( (int) num_primitives );
+
+    // fills up the buffers, in brick mode launchFrame() streams the positions brick by brick
+    if ( brick_res > 0 )
+        buildBricks( frame.positions.empty() ? 0 : &frame.positions[0], frame.positions.size(),
+                     frame.bbox_min, frame.bbox_max );
+    else if ( frame.preprocessed )
+        uploadPositions( frame.positions.empty() ? 0 : &frame.positions[0], frame.positions.size(),
+                         frame.lod_positions, frame.lod_levels, frame.bbox_min, frame.bbox_max );
+    fillBuffers( frame.velocities, frame.colors, frame.radii );
+    uploadOccupancyGrid( frame.occupancy );
+
+    // the bounding box will actually be used only for the first frame
+    aabb.set( bbox_min, bbox_max );
+
+    // builds the BVH (or re-builds or refits it if already existing)
+    markParticlesDirty( num_primitives );
 }
 
 
 // loads up the particles file corresponding to the current frame (if it is a sequence)
 void loadParticles()
 {
-    float3 bbox_min, bbox_max;
+    SUTIL_NVTX_RANGE( "loadParticles" );
 
-    std::map<int, ParticleFrameData>::iterator cacheIt = dataCache.find(current_particle_frame);
-    if(cacheIt == dataCache.end())
+    if ( particles_file_extension == "ppv" )
     {
-        ParticleFrameData newCacheEntry;
-
-        std::vector<float4>& positions = newCacheEntry.positions;
-        std::vector<float3>& velocities = newCacheEntry.velocities;
-        std::vector<float3>& colors = newCacheEntry.colors;
-        std::vector<float>&  radii = newCacheEntry.radii;
+        loadBinaryParticles();
+        return;
+    }
 
-	    readFile(positions, velocities, colors, radii, bbox_min, bbox_max);
+    ParticleFramePtr data;
+    {
+        // A frame the prefetch thread is reading is waited for instead of being read twice
+        std::unique_lock<std::mutex> lock( dataCacheMutex );
+        dataCacheCondition.wait( lock, []{ return dataCacheLoading.count( current_particle_frame ) == 0; } );
+
+        std::map<int, ParticleFramePtr>::iterator cacheIt = dataCache.find( current_particle_frame );
+        if ( cacheIt != dataCache.end() ) {
+            data = cacheIt->second;
+            touchFrame( current_particle_frame );
+        }
+    }
+    if ( !data ) {
+        data = readFrame( current_particle_frame, fixed_radius, tf_type );
+        std::lock_guard<std::mutex> lock( dataCacheMutex );
+        cacheFrame( current_particle_frame, data );
+    }
 
-        context[ "fixed_radius"     ]->setFloat(fixed_radius);
-        context[ "segment_size"     ]->setFloat(segment_size);
-        context[ "wScale" ] ->setFloat(wScale);
-        context[ "opacity" ] ->setFloat(opacity);
-        context[ "tf_type" ]->setInt(tf_type);
+    uploadFrame( *data );
 
-        context[ "bbox_min"     ]->setFloat(bbox_min);
-        context[ "bbox_max"     ]->setFloat(bbox_max);
+    requestPrefetch( frameBytes( *data ) );
+}
 
-        newCacheEntry.bbox_min = bbox_min;
-        newCacheEntry.bbox_max = bbox_max;
-        cacheIt = dataCache.insert(std::make_pair(current_particle_frame, newCacheEntry)).first;
-    }
 
-    ParticleFrameData& cacheEntry = cacheIt->second;
+// Moves the particles by one interpolation step of dt. Frames without velocities stay where they are.
+static void advectParticles( float dt )
+{
+    SUTIL_NVTX_RANGE( "advectParticles" );
 
-    // all vectors have the same size
-    geometry->setPrimitiveCount( (int) cacheEntry.positions.size() );
+    RTsize count;
+    buffers.velocities->getSize( count );
+    if ( count == 0 || count != bvh_particle_count )
+        return;
 
-    // fills up the buffers
-    fillBuffers( cacheEntry.positions, cacheEntry.velocities, cacheEntry.colors, cacheEntry.radii );
+    context[ "advect_dt" ]->setFloat( dt );
+    context->launch( ADVECT_ENTRY, count );
+    markParticlesDirty( bvh_particle_count, true );
+}
 
-    // the bounding box will actually be used only for the first frame
-    aabb.set( cacheEntry.bbox_min, cacheEntry.bbox_max );
 
-    // builds the BVH (or re-builds it if already existing)
-    Acceleration accel = geometry_group->getAcceleration();
-    accel->markDirty();
+// Steps the playback. Playing backwards advects against the velocities of the frame it left.
+void advanceParticleFrame()
+{
+    interpolate_step = ( interpolate_step + 1 ) % interpolate_steps;
+    if ( interpolate_step == 0 ) {
+        current_particle_frame = nextParticleFrame( current_particle_frame, play_direction );
+        loadParticles();
+    } else {
+        advectParticles( static_cast<float>( play_direction ) * velocity_scale / static_cast<float>( interpolate_steps ) );
+    }
 }
 
 
 void setupParticles()
 {
-    // the buffers will be set to the right size at a later stage
-    buffers.positions  = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, 0 );
+    // the buffers will be set to the right size at a later stage, the advection and the preprocessing write the positions
+    buffers.positions  = context->createBuffer( interpolate_steps > 1 || gpu_preprocess ? RT_BUFFER_INPUT_OUTPUT : RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, 0 );
     buffers.velocities = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, 0 );
+    context[ "velocities_buffer" ]->setBuffer( buffers.velocities );
     buffers.colors     = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, 0 );
     buffers.radii      = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT,  0 );
+    buffers.occupancy  = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE, 1, 1, 1 );
+    context[ "occupancy_grid"    ]->setBuffer( buffers.occupancy );
+    buffers.lod_levels = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE, 1 );
+    context[ "lod_levels"        ]->setBuffer( buffers.lod_levels );
+    context[ "lod_first"         ]->setUint( 0u );
+    context[ "lod_max_level"     ]->setInt( lod_max_level );
+    context[ "lod_pixel_scale"   ]->setFloat( lod_pixels / static_cast<float>( height ) );
+
+    buffers.quantized_positions = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_SHORT4, 0 );
 
     context[ "positions_buffer"  ]->setBuffer( buffers.positions );
+    context[ "quantized_positions_buffer" ]->setBuffer( buffers.quantized_positions );
+    context[ "use_quantized"     ]->setInt( quantized ? 1 : 0 );
+    context[ "quantized_origin"    ]->setFloat( 0.f, 0.f, 0.f );
+    context[ "quantized_extent"    ]->setFloat( 1.f, 1.f, 1.f );
+    context[ "quantized_attribute" ]->setFloat( 0.f, 1.f );
 
     geometry = context->createGeometry();
     geometry[ "positions_buffer"  ]->setBuffer( buffers.positions );
@@ -731,8 +1758,7 @@ void setupParticles()
     
     Acceleration accel = context->createAcceleration( "Bvh8" );
 
-    //We only need to refit the BVH when the radius changes. However, in some versions of OptiX a full rebuild may be required.
-    //accel->setProperty( "refit", "1" );
+    //The refit property is switched per update by markParticlesDirty(). In some versions of OptiX a full rebuild may be required.
     geometry_group->setAcceleration( accel );
 
     context[ "top_object"   ]->set( geometry_group );
@@ -813,6 +1839,167 @@ void updateCamera()
 }
 
 
+// Synthesizes count particles from the frame: Copies translated by the extent of its bounds tile a grid
+// around the original, so the density and the depth complexity of the views stay those of the dataset.
+// Each copy is jittered by up to half a radius per particle so no two copies produce the same BVH nodes.
+static ParticleFramePtr replicateFrame( const ParticleFrameData& source, size_t count )
+{
+    std::shared_ptr<ParticleFrameData> data( new ParticleFrameData() );
+    const size_t source_count = source.positions.size();
+    const size_t copies       = ( count + source_count - 1 ) / source_count;
+    const size_t tiles        = std::max<size_t>( static_cast<size_t>( ceilf( cbrtf( static_cast<float>( copies ) ) - 1e-4f ) ), 1 );
+    const float3 extent       = source.bbox_max - source.bbox_min;
+    const float  jitter       = 0.5f * fixed_radius;
+
+    data->positions.resize( count );
+    if ( !source.velocities.empty() ) data->velocities.resize( count );
+    if ( !source.colors.empty() )     data->colors.resize( count );
+    if ( !source.radii.empty() )      data->radii.resize( count );
+
+    parallelChunks( count, loaderThreadCount(), [&]( size_t begin, size_t end, unsigned int c ) {
+        std::mt19937 rng( 1234u + c );
+        std::uniform_real_distribution<float> uniform( -jitter, jitter );
+        for ( size_t i = begin; i < end; ++i ) {
+            const size_t copy = i / source_count;
+            const size_t j    = i % source_count;
+            const float3 offset = extent * make_float3( static_cast<float>( copy % tiles ),
+                                                        static_cast<float>( copy / tiles % tiles ),
+                                                        static_cast<float>( copy / ( tiles * tiles ) ) );
+            const float4& p = source.positions[j];
+            data->positions[i] = make_float4( p.x + offset.x + uniform( rng ),
+                                              p.y + offset.y + uniform( rng ),
+                                              p.z + offset.z + uniform( rng ), p.w );
+            if ( !source.velocities.empty() ) data->velocities[i] = source.velocities[j];
+            if ( !source.colors.empty() )     data->colors[i]     = source.colors[j];
+            if ( !source.radii.empty() )      data->radii[i]      = source.radii[j];
+        }
+    } );
+
+    const float3 used = make_float3( static_cast<float>( std::min( copies, tiles ) ),
+                                     static_cast<float>( std::min( ( copies + tiles - 1 ) / tiles, tiles ) ),
+                                     static_cast<float>( ( copies + tiles * tiles - 1 ) / ( tiles * tiles ) ) );
+    data->bbox_min        = source.bbox_min - make_float3( jitter );
+    data->bbox_max        = source.bbox_min + extent * used + make_float3( jitter );
+    data->attribute_range = source.attribute_range;
+    data->preprocessed    = true;
+    data->fixed_radius    = fixed_radius;
+    data->tf_type         = tf_type;
+
+    const float4* positions = &data->positions[0];
+    buildLod( positions, count, data->bbox_min, fixed_radius, data->lod_positions, data->lod_levels );
+    buildOccupancyGrid( positions, count, data->lod_positions, data->lod_levels,
+                        data->bbox_min, data->bbox_max, fixed_radius, data->occupancy );
+    return data;
+}
+
+
+static size_t bufferBytes( Buffer buffer )
+{
+    RTsize w = 0, h = 0, d = 0;
+    buffer->getSize( w, h, d );
+    return static_cast<size_t>( w ) * std::max<RTsize>( h, 1 ) * std::max<RTsize>( d, 1 ) * buffer->getElementSize();
+}
+
+
+static size_t availableDeviceMemory()
+{
+    size_t available = 0;
+    const std::vector<int> devices = context->getEnabledDevices();
+    for ( size_t i = 0; i < devices.size(); ++i )
+        available += static_cast<size_t>( context->getAvailableDeviceMemory( devices[i] ) );
+    return available;
+}
+
+
+// Replicates the loaded frame to each of the scaling_sizes and prints one row per size: the time to
+// synthesize the particles with their aggregates and occupancy grid, to upload them, to build the BVH,
+// the particle buffer bytes, the drop of the free device memory against the loaded frame, and the mean
+// milliseconds per launch of each fixed view. The views orbit the bounds of each size at the distance
+// setupCamera() picks, plus one view from half that distance.
+void runScalingBenchmark()
+{
+    SUTIL_NVTX_RANGE( "runScalingBenchmark" );
+
+    const double read_start = sutil::currentTime();
+    const ParticleFramePtr source = readFrame( current_particle_frame, fixed_radius, tf_type );
+    const double read_ms = ( sutil::currentTime() - read_start ) * 1000.0;
+    if ( source->positions.empty() )
+        throw Exception( "No particles to replicate in " + particles_file );
+
+    // the first launch compiles the kernel, keep that out of the first row
+    uploadFrame( *source );
+    context->launch( 0, 0, 0 );
+    const size_t available_base = availableDeviceMemory();
+
+    std::cout << "Scaling benchmark of " << particles_file << ": " << source->positions.size()
+              << " particles read in " << read_ms << " ms" << std::endl;
+
+    std::ofstream csv;
+    if ( !scaling_file.empty() ) {
+        csv.open( scaling_file.c_str() );
+        if ( !csv )
+            std::cerr << "Could not open " << scaling_file << std::endl;
+    }
+    const int num_views = 5;
+    std::ostringstream header;
+    header << "particles,synthesize_ms,upload_ms,build_ms,buffer_mb,device_mb";
+    for ( int v = 0; v < num_views; ++v )
+        header << ",view" << v << "_ms";
+    std::cout << header.str() << std::endl;
+    if ( csv )
+        csv << header.str() << "\n";
+
+    for ( size_t s = 0; s < scaling_sizes.size(); ++s ) {
+        const size_t count = scaling_sizes[s];
+
+        double t0 = sutil::currentTime();
+        ParticleFramePtr data = replicateFrame( *source, count );
+        double t1 = sutil::currentTime();
+        uploadFrame( *data );
+        double t2 = sutil::currentTime();
+        context->launch( 0, 0, 0 ); // builds the BVH
+        double t3 = sutil::currentTime();
+
+        const size_t buffer_bytes = bufferBytes( buffers.positions ) + bufferBytes( buffers.quantized_positions ) +
+                                    bufferBytes( buffers.velocities ) + bufferBytes( buffers.colors ) +
+                                    bufferBytes( buffers.radii ) + bufferBytes( buffers.lod_levels ) +
+                                    bufferBytes( buffers.occupancy );
+        const size_t available  = availableDeviceMemory();
+        const double device_mb  = ( static_cast<double>( available_base ) - static_cast<double>( available ) ) / ( 1024.0 * 1024.0 );
+
+        std::ostringstream row;
+        row << count << "," << ( t1 - t0 ) * 1000.0 << "," << ( t2 - t1 ) * 1000.0 << "," << ( t3 - t2 ) * 1000.0 << ","
+            << static_cast<double>( buffer_bytes ) / ( 1024.0 * 1024.0 ) << "," << device_mb;
+
+        setupCamera();
+        const float3 center   = camera_lookat;
+        const float3 offset   = camera_eye - center;
+        for ( int v = 0; v < num_views; ++v ) {
+            const float angle = 2.f * M_PIf * static_cast<float>( v ) / static_cast<float>( num_views - 1 );
+            const float scale = v == num_views - 1 ? 0.5f : 1.f;
+            camera_eye    = center + scale * make_float3( offset.z * sinf( angle ), offset.y, offset.z * cosf( angle ) );
+            camera_lookat = center;
+            camera_up     = make_float3( 0.0f, 1.0f, 0.0f );
+            camera_rotate = Matrix4x4::identity();
+            updateCamera();
+
+            context[ "frame" ]->setUint( 0u );
+            launchFrame( width, height ); // warm up
+            const double start = sutil::currentTime();
+            for ( int frame = 0; frame < scaling_frames; ++frame ) {
+                context[ "frame" ]->setUint( static_cast<unsigned int>( frame ) );
+                launchFrame( width, height );
+            }
+            row << "," << ( sutil::currentTime() - start ) * 1000.0 / static_cast<double>( std::max( scaling_frames, 1 ) );
+        }
+
+        std::cout << row.str() << std::endl;
+        if ( csv )
+            csv << row.str() << "\n";
+    }
+}
+
+
 //------------------------------------------------------------------------------
 //
 //  GLFW callbacks
@@ -836,6 +2023,7 @@ void keyCallback( GLFWwindow* window, int key, int scancode, int action, int mod
         {
             case GLFW_KEY_Q:
             case GLFW_KEY_ESCAPE:
+                stopFramePrefetch();
                 if( context )
                     context->destroy();
                 if( window )
@@ -889,6 +2077,12 @@ void windowSizeCallback( GLFWwindow* window, int w, int h )
 
     sutil::resizeBuffer( getOutputBuffer(), width, height );
     sutil::resizeBuffer( context[ "accum_buffer" ]->getBuffer(), width, height );
+    sutil::resizeBuffer( context[ "cost_buffer" ]->getBuffer(), width, height );
+    if ( brick_res > 0 ) {
+        sutil::resizeBuffer( context[ "brick_composite" ]->getBuffer(), width, height );
+        sutil::resizeBuffer( context[ "brick_cost" ]->getBuffer(), width, height );
+    }
+    context[ "lod_pixel_scale" ]->setFloat( lod_pixels / static_cast<float>( height ) );
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -965,8 +2159,10 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, RenderBuffers& buffers
             }
         }
 
-        if (camera_slow_rotate )
+        if (camera_slow_rotate ) {
             camera.rotate(1.f, 0.f);
+            accumulation_frame = 0;
+        }
 
         // imgui pushes
         ImGui::PushStyleVar(ImGuiStyleVar_FramePadding,   ImVec2(0,0) );
@@ -987,26 +2183,55 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, RenderBuffers& buffers
             if (ImGui::SliderFloat( "radius", &fixed_radius, fixed_radius_min, fixed_radius_max ) ) {
               context[ "fixed_radius"     ]->setFloat(fixed_radius);
               geometry[ "fixed_radius"      ]->setFloat(fixed_radius);
-              Acceleration accel = geometry_group->getAcceleration();
-              accel->setProperty( "refit", "1" );
-              accel->markDirty();
+              markParticlesDirty( bvh_particle_count, true );
+              accumulation_frame = 0;
             }
         
             if (ImGui::SliderFloat( "attribute scale", &wScale, .1f, 10.f ) ) {
               context[ "wScale" ] ->setFloat(wScale);
+              accumulation_frame = 0;
             }
 
             if (ImGui::SliderFloat( "sample opacity", &opacity, 0.f, 1.f ) ) {
               context[ "opacity"     ]->setFloat(opacity);
+              updatePreintegratedTf();
+              accumulation_frame = 0;
             }
 
             if (ImGui::SliderInt( "transfer function preset", &tf_type, 1, 3 ) ) {
               context[ "tf_type" ] ->setInt(tf_type);
+              updatePreintegratedTf();
+              accumulation_frame = 0;
+            }
+
+            if ( ImGui::Combo( "cost heatmap", &cost_heatmap, "off\0frame\0average\0\0" ) ) {
+              context[ "use_cost_heatmap" ]->setInt(cost_heatmap);
+              accumulation_frame = 0;
+            }
+
+            if ( cost_heatmap != COST_HEATMAP_OFF &&
+                 ImGui::SliderFloat( "cost scale", &cost_scale, 1.e4f, 1.e8f, "%.0f cycles", 4.f ) ) {
+              context[ "cost_scale" ]->setFloat(cost_scale);
             }
 
             if ( ImGui::Checkbox( "camera rotate", &camera_slow_rotate ) ) {
             }
 
+            if ( current_particle_frame > 0 ) {
+                ImGui::Checkbox( "play", &play );
+
+                int particle_frame = current_particle_frame;
+                if ( ImGui::SliderInt( "particle frame", &particle_frame, 1, max_particle_frames ) &&
+                     particle_frame != current_particle_frame ) {
+                    // Stepping backwards turns the prefetch around
+                    play_direction = particle_frame > current_particle_frame ? 1 : -1;
+                    current_particle_frame = particle_frame;
+                    interpolate_step = 0;
+                    loadParticles();
+                    accumulation_frame = 0;
+                }
+            }
+
 
             ImGui::End();
         }
@@ -1022,12 +2247,17 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, RenderBuffers& buffers
             previous_time = current_time;
 
             //updateHeightfield( static_cast<float>( anim_time ), buffers );
+            // Accumulation restarts on camera, parameter and particle frame changes only
+        }
+
+        if ( play && current_particle_frame > 0 && frame_count % iterations_per_animation_frame == 0 ) {
+            advanceParticleFrame();
             accumulation_frame = 0;
         }
 
         // Render main window
         context["frame"]->setUint( accumulation_frame++ );
-        context->launch( 0, camera.width(), camera.height() );
+        launchFrame( camera.width(), camera.height() );
 
         // Tonemap
         //context->launch( 3, camera.width(), camera.height() );
@@ -1064,12 +2294,32 @@ void printUsageAndExit( const std::string& argv0 )
         "  -n | --nopbo                        Disable GL interop for display buffer.\n"
         "  -p | --particles <particles_file>   Specify path to particles file to be loaded.\n"
         "  -r | --report <LEVEL>               Enable usage reporting and report level [1-3].\n"
+        "       --report_file <FILENAME>       Also write the usage reports to a CSV, or JSON file for *.json.\n"
         "  --no-rotate                         Disable camera rotation (default on).\n"
         "  --wScale <float>                    Rescale particle attribute range by a fixed multiple.\n"
         "  --opacity <float>                   Opacity scale (alpha) for each particle.\n"
         "  --fixed_radius <float>              Specify default (world space) radius of a particle.\n"
         "  --max_particles <int M>             Only read the first M particles of the dataset.\n"
         "  --tf_type <int>                     Use preset transfer function (0,1,2 = unsigned data, 3 = signed data).\n"
+        "  --preintegrated                     Composite the transfer function over the values between successive samples.\n"
+        "  --cost_heatmap                      Show the mean cycles per pixel as a heatmap instead of the image.\n"
+        "  --frames <int N>                    Number of frames of a particle sequence.\n"
+        "  --cache_mb <int>                    Host memory budget of the particle frame cache (default 2048).\n"
+        "  --prefetch <int N>                  Frames loaded ahead in playback direction (default 4).\n"
+        "  --kbuffer                           Keep the samples sorted in the any-hit program instead of sorting per segment.\n"
+        "  --occupancy_grid <int N>            Cells per axis of the empty space skipping grid, 0 disables it (default 64).\n"
+        "  --lod <int N>                       Build N levels of aggregate particles for distant views (default 0).\n"
+        "  --lod_pixels <float>                Footprint in pixels at which the next level takes over (default 2).\n"
+        "  --quantized                         Store positions and attributes as 16 bit fixed point, drop unused attributes.\n"
+        "  --bricks <int N>                    Stream N^3 spatial bricks from host memory and composite them (default 0).\n"
+        "  --interpolate <int N>               Play N steps per stored frame, advecting the particles by their velocities.\n"
+        "  --velocity_scale <float>            Time between two stored frames in the units of the velocities (default 1).\n"
+        "  --gpu_preprocess                    Reduce the bounds and normalize the attributes of text and raw frames on the device.\n"
+        "  --refit <int N>                     Refit the BVH of frames with unchanged particle count, rebuild every N frames.\n"
+        "  --write_binary <file>               Write the loaded particles as a memory-mappable .ppv file.\n"
+        "  --scaling <int M,...>               Replicate the particles to M million each, print timings and memory and exit.\n"
+        "  --scaling_frames <int N>            Launches timed per view of the scaling benchmark (default 16).\n"
+        "  --scaling_file <file>               Also write the scaling benchmark rows to a CSV file.\n"
         "App Keystrokes:\n"
         "  q  Quit\n"
         << std::endl;
@@ -1080,8 +2330,10 @@ void printUsageAndExit( const std::string& argv0 )
 int main( int argc, char** argv )
  {
     std::string out_file;
+    std::string binary_file;
     particles_file = std::string( sutil::samplesDir() ) + "/data/darksky_1M.xyz";
     int usage_report_level = 0;
+    std::string usage_report_file;
     for( int i=1; i<argc; ++i )
     {
         const std::string arg( argv[i] );
@@ -1168,6 +2420,158 @@ int main( int argc, char** argv )
             }
             opacity = (float) atof( argv[++i] );
         }
+        else if( arg == "--frames"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            max_particle_frames = atoi(argv[++i]);
+        }
+        else if( arg == "--cache_mb"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            frame_cache_bytes = size_t( std::max( atoi(argv[++i]), 0 ) ) << 20;
+        }
+        else if( arg == "--prefetch"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            prefetch_frames = atoi(argv[++i]);
+        }
+        else if( arg == "--kbuffer"  )
+        {
+            kbuffer = true;
+        }
+        else if( arg == "--preintegrated"  )
+        {
+            preintegrated = true;
+        }
+        else if( arg == "--cost_heatmap"  )
+        {
+            cost_heatmap = COST_HEATMAP_AVERAGE;
+        }
+        else if( arg == "--occupancy_grid"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            occupancy_res = atoi(argv[++i]);
+        }
+        else if( arg == "--lod"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            lod_max_level = std::min( std::max( atoi(argv[++i]), 0 ), 15 );
+        }
+        else if( arg == "--lod_pixels"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            lod_pixels = (float) atof( argv[++i] );
+        }
+        else if( arg == "--quantized"  )
+        {
+            quantized = true;
+        }
+        else if( arg == "--gpu_preprocess"  )
+        {
+            gpu_preprocess = true;
+        }
+        else if( arg == "--bricks"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            brick_res = std::max( atoi(argv[++i]), 0 );
+        }
+        else if( arg == "--interpolate"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            interpolate_steps = std::max( atoi( argv[++i] ), 1 );
+        }
+        else if( arg == "--velocity_scale"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            velocity_scale = (float) atof( argv[++i] );
+        }
+        else if( arg == "--refit"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            refit_interval = atoi(argv[++i]);
+        }
+        else if( arg == "--write_binary"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            binary_file = argv[++i];
+        }
+        else if( arg == "--scaling"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            std::istringstream sizes( argv[++i] );
+            std::string size;
+            while ( std::getline( sizes, size, ',' ) ) {
+                const double millions = atof( size.c_str() );
+                if ( millions > 0.0 )
+                    scaling_sizes.push_back( static_cast<size_t>( millions * 1000000.0 ) );
+            }
+        }
+        else if( arg == "--scaling_frames"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            scaling_frames = std::max( atoi(argv[++i]), 1 );
+        }
+        else if( arg == "--scaling_file"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            scaling_file = argv[++i];
+        }
         else if( arg == "-n" || arg == "--nopbo"  )
         {
             use_pbo = false;
@@ -1190,6 +2594,15 @@ int main( int argc, char** argv )
             }
             usage_report_level = atoi( argv[++i] );
         }
+        else if( arg == "--report_file" )
+        {
+            if( i == argc-1 )
+            {
+                std::cout << "Option '" << argv[i] << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            usage_report_file = argv[++i];
+        }
         else
         {
             std::cout << "Unknown option '" << arg << "'\n";
@@ -1197,6 +2610,28 @@ int main( int argc, char** argv )
         }
     }
 
+    // the aggregates would need their own bricks, the bricks already bound the device memory
+    if ( brick_res > 0 )
+        lod_max_level = 0;
+
+    // the advection moves the float positions on the device, where neither the host side bricks nor the
+    // quantized positions are, and the aggregates and the occupancy grid of the stored frame would go stale
+    if ( brick_res > 0 || quantized )
+        interpolate_steps = 1;
+    if ( interpolate_steps > 1 ) {
+        lod_max_level = 0;
+        occupancy_res = 0;
+    }
+
+    // the bricks, the quantization and the written binary file take the normalized positions on the host,
+    // the aggregates and the occupancy grid are built there from them
+    if ( brick_res > 0 || quantized || !binary_file.empty() || !scaling_sizes.empty() )
+        gpu_preprocess = false;
+    if ( gpu_preprocess ) {
+        lod_max_level = 0;
+        occupancy_res = 0;
+    }
+
     try
     {
 
@@ -1211,13 +2646,17 @@ int main( int argc, char** argv )
         }
 #endif
 
-        UsageReportLogger logger;
+        sutil::UsageReportLogger logger;
+        logger.setEcho( true );
+        logger.setFilename( usage_report_file );
         RenderBuffers render_buffers;
 
         createContext( usage_report_level, &logger );
         setupParticles();
         setParticlesBaseName( particles_file );
         loadParticles();
+        if ( !binary_file.empty() )
+            writeBinaryParticles( binary_file );
         setupCamera();
         setupLights();
 
@@ -1227,14 +2666,25 @@ int main( int argc, char** argv )
 
         context->validate();
 
-        if ( out_file.empty() )
+        if ( !scaling_sizes.empty() )
+        {
+            if ( particles_file_extension == "ppv" )
+                throw Exception( "The scaling benchmark replicates text or raw particle files" );
+            runScalingBenchmark();
+            destroyContext();
+        }
+        else if ( out_file.empty() )
         {
             glfwRun( window, camera, render_buffers );
         }
         else
         {
             updateCamera();
-            context->launch( 0, width, height );
+            const unsigned int numframes = 16;
+            for ( unsigned int frame = 0; frame < numframes; ++frame ) {
+                context["frame"]->setUint( frame );
+                launchFrame( width, height );
+            }
             sutil::writeBufferToFile( out_file.c_str(), getOutputBuffer() );
             std::cout << "Wrote " << out_file << std::endl;
             destroyContext();
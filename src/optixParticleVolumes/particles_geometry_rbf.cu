@@ -29,10 +29,11 @@
 #include <optix.h>
 #include <optixu/optixu_math_namespace.h>
 #include <optixu/optixu_aabb_namespace.h>
+#include "lod_rbf.h"
+#include "quantized_rbf.h"
 
 using namespace optix;
 
-rtBuffer<float4>    positions_buffer;
 
 rtDeclareVariable(float2,       particle_rbf,    attribute particle_rbf, );
 rtDeclareVariable(optix::Ray,   ray,                rtCurrentRay, );
@@ -41,12 +42,17 @@ rtDeclareVariable(float,        fixed_radius, ,  );
 
 RT_PROGRAM void particle_intersect( int primIdx )
 {
-    const float4 pos = positions_buffer[primIdx];
+    const float4 pos = particle_position(primIdx);
     const float3 pos3 = make_float3(pos.x, pos.y, pos.z);
     const float t = length(pos3 - ray.origin);
     const float3 samplePos = ray.origin + ray.direction * t;
 
-    if( (length(pos3 - samplePos) < fixed_radius) && rtPotentialIntersection(t) )
+    //only the level matching the footprint at this distance is hit
+    const int level = particle_level(primIdx);
+    if( lod_max_level > 0 && level != footprint_level(fixed_radius, t) )
+      return;
+
+    if( (length(pos3 - samplePos) < ldexpf(fixed_radius, level)) && rtPotentialIntersection(t) )
     {
       particle_rbf.x = t;
       particle_rbf.y = __int_as_float(primIdx);
@@ -57,8 +63,8 @@ RT_PROGRAM void particle_intersect( int primIdx )
 //for accel build
 RT_PROGRAM void particle_bounds( int primIdx, float result[6] )
 {
-    const float4 position = positions_buffer[ primIdx ];
-    const float radius = fixed_radius;
+    const float4 position = particle_position( primIdx );
+    const float radius = particle_radius(fixed_radius, primIdx);
 
     optix::Aabb *aabb = (optix::Aabb *) result;
 
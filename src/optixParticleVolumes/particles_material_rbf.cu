@@ -45,6 +45,31 @@ RT_PROGRAM void any_hit()
   }
 }
 
+//keeps the RBF_SAMPLES closest samples sorted by insertion, the ray generation program integrates them
+//without a sort (pinhole_camera_kbuffer)
+RT_PROGRAM void any_hit_kbuffer()
+{
+  const float t = particle_rbf.x;
+  int i = prd.rbfi;
+  if (i == RBF_SAMPLES)
+  {
+    //full: samples behind the furthest kept one are dropped, accepting them culls the rest of the BVH beyond
+    if (t >= prd.rbfs[RBF_SAMPLES-1].x)
+      return;
+    i--;
+  }
+  else
+    prd.rbfi++;
+
+  while (i > 0 && prd.rbfs[i-1].x > t)
+  {
+    prd.rbfs[i] = prd.rbfs[i-1];
+    i--;
+  }
+  prd.rbfs[i] = particle_rbf;
+  rtIgnoreIntersection();
+}
+
 RT_PROGRAM void closest_hit()
 {
 }
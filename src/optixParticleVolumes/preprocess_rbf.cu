@@ -0,0 +1,65 @@
+/* 
+* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*  * Neither the name of NVIDIA CORPORATION nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+* PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+* CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+* OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+using namespace optix;
+
+// Preprocessing of raw particle frames on the device: the bounds including the attribute in w are
+// reduced to one partial bound per launch index, the host only reduces these and derives the
+// normalization of the attribute, which is then applied in place.
+
+rtBuffer<float4>    positions_buffer;
+rtBuffer<float4>    preprocess_min;
+rtBuffer<float4>    preprocess_max;
+rtDeclareVariable(unsigned int, preprocess_count, , );
+rtDeclareVariable(float2,       attribute_transform, , );   // Scale and offset of w.
+rtDeclareVariable(unsigned int, launch_index, rtLaunchIndex, );
+rtDeclareVariable(unsigned int, launch_dim, rtLaunchDim, );
+
+// Bounds of the particles launch_index, launch_index + launch_dim, ... so the reads of a warp coalesce.
+RT_PROGRAM void reduce_bounds()
+{
+  float4 lo = make_float4( 1e16f);
+  float4 hi = make_float4(-1e16f);
+  for (unsigned int i = launch_index; i < preprocess_count; i += launch_dim) {
+    const float4 p = positions_buffer[i];
+    lo = fminf(lo, p);
+    hi = fmaxf(hi, p);
+  }
+  preprocess_min[launch_index] = lo;
+  preprocess_max[launch_index] = hi;
+}
+
+RT_PROGRAM void normalize_attributes()
+{
+  float4 p = positions_buffer[launch_index];
+  p.w = p.w * attribute_transform.x + attribute_transform.y;
+  positions_buffer[launch_index] = p;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+// Particle positions, either as float4 or quantized to 16 bit fixed point: xyz relative to the
+// quantization bounds and the attribute w relative to its range.
+
+rtBuffer<float4>    positions_buffer;
+rtBuffer<ushort4>   quantized_positions_buffer;
+rtDeclareVariable(int,     use_quantized, , );
+rtDeclareVariable(float3,  quantized_origin, , );
+rtDeclareVariable(float3,  quantized_extent, , );
+rtDeclareVariable(float2,  quantized_attribute, , );   // Attribute minimum and range.
+
+static __device__ __inline__ float4 particle_position(const int idx)
+{
+  if (!use_quantized)
+    return positions_buffer[idx];
+
+  const ushort4 q = quantized_positions_buffer[idx];
+  const float s = 1.f / 65535.f;
+  const float3 p = quantized_origin + make_float3(q.x, q.y, q.z) * s * quantized_extent;
+  return make_float4(p, quantized_attribute.x + static_cast<float>(q.w) * s * quantized_attribute.y);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixu_math_namespace.h>
+
+// Preset transfer functions, shared by the integration on the device and the pre-integration table
+// the host builds from them.
+
+// Resolution of the pre-integrated transfer function table over (front, back) sample values.
+#define PREINTEGRATED_TF_SIZE 256
+
+static __host__ __device__ __inline__ optix::float4 transfer_function(const int type, const float v)
+{
+  using optix::lerp;
+  using optix::make_float4;
+
+  if (type == 1)
+  {
+    if (v < .5f)
+      return lerp( make_float4(1,1,0,0), make_float4(1,1,1,0.5f), v * 2.f);
+    else
+      return lerp( make_float4(1,1,1,0.5f), make_float4(1,0,0,1), v * 2.f - 1.f);
+  }
+  else if (type == 2)
+  {
+    if (v < .5f)
+      return lerp( make_float4(0,0,1,0), make_float4(1,1,1,0.5f), v * 2.f);
+    else
+      return lerp( make_float4(1,1,1,0.5f), make_float4(1,0,0,1), v * 2.f - 1.f);
+  }
+  else
+  {
+    if (v < .33f)
+      return lerp( make_float4(1,0,1,0), make_float4(0,0,1,0.33f), (v-0.f) * 3.f);
+    else if (v < .66f)
+      return lerp( make_float4(0,0,1,.33f), make_float4(0,1,1,0.66f), (v-0.33f) * 3.f);
+    else
+      return lerp( make_float4(0,1,0,0.5f), make_float4(1,1,1,1), (v-0.66f) * 3.f);
+  }
+}
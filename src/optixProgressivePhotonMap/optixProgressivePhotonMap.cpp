@@ -45,14 +45,20 @@
 #include <optixu/optixu_aabb_namespace.h>
 #include <optixu/optixu_math_stream_namespace.h>
 
+#include <cuda_runtime.h>
+
 // from sutil
 #include <sutil.h>
+#include <NvtxRange.h>
 #include <Camera.h>
+#include <TaskPool.h>
 
 #include "Mesh.h"
 #include "ppm.h"
+#include "ppm_grid.h"
 #include "random.h"
 #include "select.h"
+#include "cost_heatmap.h"
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw_gl2.h>
@@ -60,9 +66,14 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <stdint.h>
+#include <thread>
+#include <vector>
 
 using namespace optix;
 
@@ -90,6 +101,73 @@ Context      context = 0;
 
 bool s_display_debug_buffer = false;
 bool s_print_timings = false;
+bool s_host_kd_tree = false;
+bool s_photon_grid = false;
+bool s_pipelined = false;
+bool s_sppm = false;
+bool s_tiled_gather = false;
+bool s_visual_importance = false;
+bool s_qmc_emission = false;
+
+// Cost visualization: COST_HEATMAP_* mode of the gather cycles per pixel and the cycles shown in red.
+int   s_cost_heatmap = COST_HEATMAP_OFF;
+float s_cost_scale   = 1.0e6f;
+
+// Monotonic across accumulation restarts so the photon passes never repeat their seeds.
+unsigned int s_photon_pass = 0u;
+
+// Profiling: per frame pass timings and photon statistics in a ring buffer, shown on screen and dumped as CSV.
+struct FrameProfile
+{
+  unsigned int accumulation_frame;
+  double       rtpass;          // Seconds, zero when the hit points were reused.
+  double       ppass;           // Includes the photon compaction.
+  double       build;           // kd-tree or grid build. The pipelined build includes the overlapped photon pass.
+  double       gather;
+  unsigned int photon_slots;
+  unsigned int valid_photons;
+  float        average_visited; // Photons or kd-tree nodes visited per gathered hit point.
+};
+
+const unsigned int PROFILE_RING_SIZE = 1024u;
+
+bool s_profile = false;
+std::string s_profile_file;
+std::vector<FrameProfile> s_profile_ring;
+unsigned int s_profile_frames = 0u;
+FrameProfile s_frame_profile;
+
+// Pipelined mode: host copies of the last photon pass and of the kd-tree built from it.
+std::vector<PhotonRecord> s_pipeline_photons;
+std::vector<PhotonRecord> s_pipeline_photon_map;
+
+// Photon map reuse: the last kd-trees stay on the device and are gathered again against the new hit
+// points after a camera move. The photon maps don't depend on the view, only a light change invalidates them.
+unsigned int        s_reuse_photon_maps = 0u;   // Number of maps kept, 0 disables the reuse.
+std::vector<Buffer> s_photon_maps;
+unsigned int        s_photon_map_next   = 0u;   // Ring slot the next photon pass builds into.
+unsigned int        s_photon_map_count  = 0u;   // Maps in the ring traced with the current light.
+unsigned int        s_reused_passes     = 0u;   // Passes replayed since the accumulation restarted.
+
+// Multi-GPU photon tracing: every additional device has its own context with a copy of the scene, which traces
+// its own photon pass and builds the kd-tree of it on that device. The trees are copied device to device into
+// the main context and gathered there one after another, each one as a progressive pass of its own.
+struct PhotonDevice
+{
+    int                device_id;     // OptiX device ordinal.
+    int                cuda_device;   // CUDA device ordinal for the peer copy.
+    Context            context;
+    Buffer             photon_map;    // kd-tree built on this device.
+    Buffer             target;        // Its copy in the main context, the reuse ring slots take its place if enabled.
+    unsigned int       valid_photons;
+    std::thread        worker;
+    std::exception_ptr error;
+};
+
+unsigned int              s_num_devices      = 1u;  // Devices requested on the command line.
+int                       s_main_device      = 0;
+int                       s_main_cuda_device = 0;
+std::vector<PhotonDevice> s_photon_devices;
 
 
 //------------------------------------------------------------------------------
@@ -159,6 +237,14 @@ static Buffer getOutputBuffer()
 
 void destroyContext()
 {
+    for( size_t i = 0; i < s_photon_devices.size(); ++i )
+    {
+        if( s_photon_devices[i].worker.joinable() )
+            s_photon_devices[i].worker.join();
+        s_photon_devices[i].context->destroy();
+    }
+    s_photon_devices.clear();
+
     if( context )
     {
         context->destroy();
@@ -170,18 +256,38 @@ enum ProgramEnum {
     rtpass,
     ppass,
     gather,
+    compact_scan_blocks,
+    compact_scan_totals,
+    compact_scatter,
+    kdtree_clear,
+    kdtree_init,
+    kdtree_level,
+    kdtree_bounds,
+    kdtree_histogram,
+    kdtree_select,
+    kdtree_partition,
+    kdtree_subtree,
+    grid_clear,
+    grid_radius,
+    grid_count,
+    grid_scan_blocks,
+    grid_scan_totals,
+    grid_scan_add,
+    grid_scatter,
+    gather_tiles,
+    importance_clear,
+    importance_reset,
+    importance_mark,
+    importance_update,
     NUM_PROGRAMS
 };
 
-void createContext( bool use_pbo, unsigned int photon_launch_dim, Buffer& photons_buffer, Buffer& photon_map_buffer )
+// Picks up to count devices with the same compute capability as the first one.
+// There's a performance advantage to using a device that isn't being used as a display.
+// We'll take a guess and skip the first GPU if there are more matching ones than needed.
+std::vector<int> selectDevices( unsigned int count )
 {
-    // Set up context
-    context = Context::create();
-
-    // There's a performance advantage to using a device that isn't being used as a display.
-    // We'll take a guess and pick the second GPU if the second one has the same compute
-    // capability as the first.
-    int deviceId = 0;
+    std::vector<int> matching( 1, 0 );
     int computeCaps[2];
     if (RTresult code = rtDeviceGetAttribute(0, RT_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY, sizeof(computeCaps), &computeCaps))
         throw Exception::makeException(code, 0);
@@ -190,10 +296,26 @@ void createContext( bool use_pbo, unsigned int photon_launch_dim, Buffer& photon
         if (RTresult code = rtDeviceGetAttribute(index, RT_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY, sizeof(computeCaps), &computeCapsB))
             throw Exception::makeException(code, 0);
         if (computeCaps[0] == computeCapsB[0] && computeCaps[1] == computeCapsB[1]) {
-            deviceId = index;
-            break;
+            matching.push_back( static_cast<int>( index ) );
         }
     }
+    const size_t first = matching.size() > count ? 1 : 0;
+    const size_t last  = std::min( matching.size(), first + count );
+    return std::vector<int>( matching.begin() + first, matching.begin() + last );
+}
+
+static int cudaDeviceOrdinal( int deviceId )
+{
+    int ordinal = 0;
+    if (RTresult code = rtDeviceGetAttribute(deviceId, RT_DEVICE_ATTRIBUTE_CUDA_DEVICE_ORDINAL, sizeof(ordinal), &ordinal))
+        throw Exception::makeException(code, 0);
+    return ordinal;
+}
+
+void createContext( bool use_pbo, unsigned int photon_launch_dim, int deviceId, Buffer& photons_buffer, Buffer& photon_map_buffer )
+{
+    // Set up context
+    context = Context::create();
     context->setDevices(&deviceId, &deviceId+1);
 
     context->setRayTypeCount( 3 );
@@ -208,10 +330,22 @@ void createContext( bool use_pbo, unsigned int photon_launch_dim, Buffer& photon
     context["total_emitted"]->setFloat( 0.0f );
     context["frame_number"]->setFloat( 0.0f );
     context["use_debug_buffer"]->setUint( s_display_debug_buffer );
+    context["use_sppm"]->setUint( s_sppm );
+    context["use_profiling"]->setUint( s_profile );
+    context["use_visual_importance"]->setUint( s_visual_importance );
+    context["use_qmc_emission"]->setUint( s_qmc_emission );
+
+    // Gather profiling counters: visited count low and high word, number of gathered hit points
+    context["gather_statistics"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 3 ) );
 
     Buffer buffer = sutil::createOutputBuffer( context, RT_FORMAT_FLOAT4, WIDTH, HEIGHT, use_pbo );
     context["output_buffer"]->set( buffer );
 
+    // Gather cycles per pixel, allocated at full size so the heatmap can be switched on at any time
+    context["cost_buffer"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT, WIDTH, HEIGHT ) );
+    context["use_cost_heatmap"]->setInt( s_cost_heatmap );
+    context["cost_scale"]->setFloat( s_cost_scale );
+
     // Debug output buffer
     Buffer debug_buffer = context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT4, WIDTH, HEIGHT );
     context["debug_buffer"]->set( debug_buffer );
@@ -221,64 +355,164 @@ void createContext( bool use_pbo, unsigned int photon_launch_dim, Buffer& photon
     rtpass_buffer->setElementSize( sizeof( HitRecord ) );
     context["rtpass_output_buffer"]->set( rtpass_buffer );
 
-    // RTPass pixel sample buffers
-    Buffer image_rnd_seeds = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT2, WIDTH, HEIGHT );
-    context["image_rnd_seeds"]->set( image_rnd_seeds );
-    uint2* seeds = reinterpret_cast<uint2*>( image_rnd_seeds->map() );
-    for ( unsigned int i = 0; i < WIDTH*HEIGHT; ++i ) {
-        seeds[i] = random2u();
-    }
-    image_rnd_seeds->unmap();
+    // Progressive statistics of the hit points, the gather pass reads the hit records above but only writes these.
+    Buffer hit_statistics = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_USER, WIDTH, HEIGHT );
+    hit_statistics->setElementSize( sizeof( HitStatistics ) );
+    context["hit_statistics"]->set( hit_statistics );
+
+    // SPPM per pixel progressive statistics
+    Buffer sppm_statistics = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_USER, WIDTH, HEIGHT );
+    sppm_statistics->setElementSize( sizeof( PixelStatistics ) );
+    context["sppm_statistics"]->set( sppm_statistics );
+
+    // The photon and gather passes hash their random seeds from the launch index and this frame counter.
+    context["rnd_frame"]->setUint( 0u );
 
     // RTPass ray gen program
     {
         const std::string ptx_path = ptxPath( "ppm_rtpass.cu" );
-        Program ray_gen_program = context->createProgramFromPTXFile( ptx_path, "rtpass_camera" );
+        Program ray_gen_program = sutil::createProgramFromPTXFile( context, ptx_path, "rtpass_camera" );
         context->setRayGenerationProgram( rtpass, ray_gen_program );
 
         // RTPass exception/miss programs
-        Program exception_program = context->createProgramFromPTXFile( ptx_path, "rtpass_exception" );
+        Program exception_program = sutil::createProgramFromPTXFile( context, ptx_path, "rtpass_exception" );
         context->setExceptionProgram( rtpass, exception_program );
         context["rtpass_bad_color"]->setFloat( 0.0f, 1.0f, 0.0f );
-        context->setMissProgram( rtpass, context->createProgramFromPTXFile( ptx_path, "rtpass_miss" ) );
+        context->setMissProgram( rtpass, sutil::createProgramFromPTXFile( context, ptx_path, "rtpass_miss" ) );
         context["rtpass_bg_color"]->setFloat( make_float3( 0.34f, 0.55f, 0.85f ) );
     }
 
     // Photon pass
     const unsigned int num_photons = photon_launch_dim * photon_launch_dim * MAX_PHOTON_COUNT;
-    photons_buffer = context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_USER, num_photons );
-    photons_buffer->setElementSize( sizeof( PhotonRecord ) );
-    context["ppass_output_buffer"]->set( photons_buffer );
+    Buffer ppass_output_buffer = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_USER, num_photons );
+    ppass_output_buffer->setElementSize( sizeof( PhotonRecord ) );
+    context["ppass_output_buffer"]->set( ppass_output_buffer );
 
     {
         const std::string ptx_path = ptxPath( "ppm_ppass.cu");
-        Program ray_gen_program = context->createProgramFromPTXFile( ptx_path, "ppass_camera" );
+        Program ray_gen_program = sutil::createProgramFromPTXFile( context, ptx_path, "ppass_camera" );
         context->setRayGenerationProgram( ppass, ray_gen_program );
+    }
 
-        Buffer photon_rnd_seeds = context->createBuffer( RT_BUFFER_INPUT,
-                RT_FORMAT_UNSIGNED_INT2,
-                photon_launch_dim,
-                photon_launch_dim );
-        uint2* seeds = reinterpret_cast<uint2*>( photon_rnd_seeds->map() );
-        for ( unsigned int i = 0; i < photon_launch_dim*photon_launch_dim; ++i ) {
-            seeds[i] = random2u();
-        }
-        photon_rnd_seeds->unmap();
-        context["photon_rnd_seeds"]->set( photon_rnd_seeds );
+    // Photon compaction. The dense photons_buffer is what the kd-tree and grid builders consume.
+    {
+        const std::string ptx_path = ptxPath( "ppm_compact.cu" );
+        context->setRayGenerationProgram( compact_scan_blocks, sutil::createProgramFromPTXFile( context, ptx_path, "compact_scan_blocks" ) );
+        context->setRayGenerationProgram( compact_scan_totals, sutil::createProgramFromPTXFile( context, ptx_path, "compact_scan_totals" ) );
+        context->setRayGenerationProgram( compact_scatter,     sutil::createProgramFromPTXFile( context, ptx_path, "compact_scatter" ) );
+
+        const unsigned int num_launches = photon_launch_dim * photon_launch_dim;
+        const unsigned int num_blocks   = ( num_launches + COMPACT_SCAN_BLOCK - 1 ) / COMPACT_SCAN_BLOCK;
+        context["photon_counts"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, num_launches ) );
+        context["compact_offsets"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, num_launches ) );
+        context["compact_block_sums"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, num_blocks ) );
+        context["compact_count"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1 ) );
+
+        photons_buffer = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_USER, num_photons );
+        photons_buffer->setElementSize( sizeof( PhotonRecord ) );
+        context["compact_photons"]->set( photons_buffer );
     }
 
     // Gather phase
     {
         const std::string ptx_path = ptxPath( "ppm_gather.cu" );
-        Program gather_program = context->createProgramFromPTXFile( ptx_path, "gather" );
+        const char* gather_name = s_photon_grid ? "gather_grid" : ( s_tiled_gather ? "gather_tiled" : "gather" );
+        Program gather_program = sutil::createProgramFromPTXFile( context, ptx_path, gather_name );
         context->setRayGenerationProgram( gather, gather_program );
-        Program exception_program = context->createProgramFromPTXFile( ptx_path, "gather_exception" );
+        context->setRayGenerationProgram( gather_tiles, sutil::createProgramFromPTXFile( context, ptx_path, "gather_tile_candidates" ) );
+        context->setExceptionProgram( gather_tiles, sutil::createProgramFromPTXFile( context, ptx_path, "gather_exception" ) );
+
+        // The candidate lists are only needed by the tiled gather.
+        const bool tiled = s_tiled_gather && !s_photon_grid;
+        const unsigned int tiles_x = tiled ? ( WIDTH  + GATHER_TILE_SIZE - 1 ) / GATHER_TILE_SIZE : 1u;
+        const unsigned int tiles_y = tiled ? ( HEIGHT + GATHER_TILE_SIZE - 1 ) / GATHER_TILE_SIZE : 1u;
+        context["tile_candidate_counts"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, tiles_x, tiles_y ) );
+        context["tile_candidates"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, tiles_x * tiles_y * GATHER_TILE_CANDIDATES ) );
+        Program exception_program = sutil::createProgramFromPTXFile( context, ptx_path, "gather_exception" );
         context->setExceptionProgram( gather, exception_program );
 
         unsigned int photon_map_size = pow2roundup( num_photons ) - 1;
-        photon_map_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_USER, photon_map_size );
+        photon_map_buffer = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_USER, photon_map_size );
         photon_map_buffer->setElementSize( sizeof( PhotonRecord ) );
         context["photon_map"]->set( photon_map_buffer );
+
+        // The grid is sorted for the current hit points, only the kd-trees can be reused.
+        // The ring lives in the main context, which is created first.
+        if ( s_reuse_photon_maps > 0 && !s_photon_grid && s_photon_maps.empty() ) {
+            s_photon_maps.push_back( photon_map_buffer );
+            while ( s_photon_maps.size() < s_reuse_photon_maps ) {
+                Buffer buffer = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_USER, photon_map_size );
+                buffer->setElementSize( sizeof( PhotonRecord ) );
+                s_photon_maps.push_back( buffer );
+            }
+        }
+    }
+
+    // KD tree build
+    {
+        const std::string ptx_path = ptxPath( "ppm_kdtree.cu" );
+        context->setRayGenerationProgram( kdtree_clear,     sutil::createProgramFromPTXFile( context, ptx_path, "kdtree_clear" ) );
+        context->setRayGenerationProgram( kdtree_init,      sutil::createProgramFromPTXFile( context, ptx_path, "kdtree_init" ) );
+        context->setRayGenerationProgram( kdtree_level,     sutil::createProgramFromPTXFile( context, ptx_path, "kdtree_level" ) );
+        context->setRayGenerationProgram( kdtree_bounds,    sutil::createProgramFromPTXFile( context, ptx_path, "kdtree_bounds" ) );
+        context->setRayGenerationProgram( kdtree_histogram, sutil::createProgramFromPTXFile( context, ptx_path, "kdtree_histogram" ) );
+        context->setRayGenerationProgram( kdtree_select,    sutil::createProgramFromPTXFile( context, ptx_path, "kdtree_select" ) );
+        context->setRayGenerationProgram( kdtree_partition, sutil::createProgramFromPTXFile( context, ptx_path, "kdtree_partition" ) );
+        context->setRayGenerationProgram( kdtree_subtree,   sutil::createProgramFromPTXFile( context, ptx_path, "kdtree_subtree" ) );
+
+        context["kd_photon_indices"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, num_photons ) );
+        context["kd_photon_nodes"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, num_photons ) );
+
+        // Nodes of the breadth first levels plus the roots of the serially built subtrees.
+        Buffer kd_nodes = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_USER, ( 2u << KD_MAX_PARALLEL_LEVELS ) - 1 );
+        kd_nodes->setElementSize( sizeof( KdTreeNode ) );
+        context["kd_nodes"]->set( kd_nodes );
+
+        // The select launch clears the histogram after each digit, so it only needs to start out zeroed.
+        const unsigned int histogram_size = ( 1u << ( KD_MAX_PARALLEL_LEVELS - 1 ) ) * KD_HISTOGRAM_BINS;
+        Buffer kd_histogram = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, histogram_size );
+        memset( kd_histogram->map(), 0, histogram_size * sizeof( unsigned int ) );
+        kd_histogram->unmap();
+        context["kd_histogram"]->set( kd_histogram );
+
+        context["kd_valid_photons"]->setUint( 0u );
+        context["kd_level"]->setUint( 0u );
+        context["kd_shift"]->setUint( 0u );
+    }
+
+    // Hash grid build
+    {
+        const std::string ptx_path = ptxPath( "ppm_grid.cu" );
+        context->setRayGenerationProgram( grid_clear,       sutil::createProgramFromPTXFile( context, ptx_path, "grid_clear" ) );
+        context->setRayGenerationProgram( grid_radius,      sutil::createProgramFromPTXFile( context, ptx_path, "grid_radius" ) );
+        context->setRayGenerationProgram( grid_count,       sutil::createProgramFromPTXFile( context, ptx_path, "grid_count" ) );
+        context->setRayGenerationProgram( grid_scan_blocks, sutil::createProgramFromPTXFile( context, ptx_path, "grid_scan_blocks" ) );
+        context->setRayGenerationProgram( grid_scan_totals, sutil::createProgramFromPTXFile( context, ptx_path, "grid_scan_totals" ) );
+        context->setRayGenerationProgram( grid_scan_add,    sutil::createProgramFromPTXFile( context, ptx_path, "grid_scan_add" ) );
+        context->setRayGenerationProgram( grid_scatter,     sutil::createProgramFromPTXFile( context, ptx_path, "grid_scatter" ) );
+
+        // The sorted photons are only needed when the grid is used for the gather.
+        Buffer grid_photons = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_USER, s_photon_grid ? num_photons : 1u );
+        grid_photons->setElementSize( sizeof( PhotonRecord ) );
+        context["grid_photons"]->set( grid_photons );
+
+        context["grid_cells"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, GRID_TABLE_SIZE ) );
+        context["grid_photon_slots"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, s_photon_grid ? num_photons : 1u ) );
+        context["grid_block_sums"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, GRID_TABLE_SIZE / GRID_SCAN_BLOCK ) );
+        context["grid_info"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, GRID_INFO_SIZE ) );
+    }
+
+    // Visual importance driven emission
+    {
+        const std::string ptx_path = ptxPath( "ppm_importance.cu" );
+        context->setRayGenerationProgram( importance_clear,  sutil::createProgramFromPTXFile( context, ptx_path, "importance_clear" ) );
+        context->setRayGenerationProgram( importance_reset,  sutil::createProgramFromPTXFile( context, ptx_path, "importance_reset" ) );
+        context->setRayGenerationProgram( importance_mark,   sutil::createProgramFromPTXFile( context, ptx_path, "importance_mark" ) );
+        context->setRayGenerationProgram( importance_update, sutil::createProgramFromPTXFile( context, ptx_path, "importance_update" ) );
+
+        context["visible_cells"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT, s_visual_importance ? GRID_TABLE_SIZE : 1u ) );
+        context["emission_importance"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT, s_visual_importance ? IMPORTANCE_CELLS : 1u ) );
+        context["emission_cdf"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT2, s_visual_importance ? IMPORTANCE_CELLS : 1u ) );
     }
 
 }
@@ -362,8 +596,8 @@ void createGeometry( )
 
     // Translate to OptiX geometry
     const std::string path = ptxPath( "triangle_mesh.cu" );
-    optix::Program bounds_program = context->createProgramFromPTXFile( path, "mesh_bounds" );
-    optix::Program intersection_program = context->createProgramFromPTXFile( path, "mesh_intersect" );
+    optix::Program bounds_program = sutil::createProgramFromPTXFile( context, path, "mesh_bounds" );
+    optix::Program intersection_program = sutil::createProgramFromPTXFile( context, path, "mesh_intersect" );
 
     optix::Geometry geometry = context->createGeometry();  
     geometry[ "vertex_buffer"   ]->setBuffer( buffers.positions ); 
@@ -376,9 +610,9 @@ void createGeometry( )
     geometry->setIntersectionProgram( intersection_program );
 
     // Materials have different hit programs depending on pass.
-    Program closest_hit1 = context->createProgramFromPTXFile( ptxPath( "ppm_rtpass.cu" ), "rtpass_closest_hit" );
-    Program closest_hit2 = context->createProgramFromPTXFile( ptxPath( "ppm_ppass.cu" ), "ppass_closest_hit" );
-    Program any_hit      = context->createProgramFromPTXFile( ptxPath( "ppm_gather.cu" ), "gather_any_hit" );
+    Program closest_hit1 = sutil::createProgramFromPTXFile( context, ptxPath( "ppm_rtpass.cu" ), "rtpass_closest_hit" );
+    Program closest_hit2 = sutil::createProgramFromPTXFile( context, ptxPath( "ppm_ppass.cu" ), "ppass_closest_hit" );
+    Program any_hit      = sutil::createProgramFromPTXFile( context, ptxPath( "ppm_gather.cu" ), "gather_any_hit" );
 
     std::vector< optix::Material > optix_materials;
     for (int i = 0; i < mesh.num_materials; ++i) {
@@ -438,19 +672,24 @@ bool photonCmpY( PhotonRecord* r1, PhotonRecord* r2 ) { return r1->position.y <
 bool photonCmpZ( PhotonRecord* r1, PhotonRecord* r2 ) { return r1->position.z < r2->position.z; }
 
 
+// Subtrees with at least this many photons build their left half as a task of the sutil::TaskPool.
+// The halves write disjoint photon ranges and tree nodes, so the tree is identical to the serial build.
+const int KD_TREE_TASK_MIN = 16384;
+
+
 void buildKDTree( PhotonRecord** photons, int start, int end, int depth, PhotonRecord* kd_tree, int current_root,
                   SplitChoice split_choice, float3 bbmin, float3 bbmax)
 {
   // If we have zero photons, this is a NULL node
   if( end - start == 0 ) {
-    kd_tree[current_root].axis = PPM_NULL;
-    kd_tree[current_root].energy = make_float3( 0.0f );
+    kd_tree[current_root].normal_axis = PPM_NULL;
+    kd_tree[current_root].energy = 0u;
     return;
   }
 
   // If we have a single photon
   if( end - start == 1 ) {
-    photons[start]->axis = PPM_LEAF;
+    setPhotonAxis( *photons[start], PPM_LEAF );
     kd_tree[current_root] = *(photons[start]);
     return;
   }
@@ -498,15 +737,15 @@ void buildKDTree( PhotonRecord** photons, int start, int end, int depth, PhotonR
   switch( axis ) {
   case 0:
     select<PhotonRecord*, 0>( start_addr, 0, end-start-1, median-start );
-    photons[median]->axis = PPM_X;
+    setPhotonAxis( *photons[median], PPM_X );
     break;
   case 1:
     select<PhotonRecord*, 1>( start_addr, 0, end-start-1, median-start );
-    photons[median]->axis = PPM_Y;
+    setPhotonAxis( *photons[median], PPM_Y );
     break;
   case 2:
     select<PhotonRecord*, 2>( start_addr, 0, end-start-1, median-start );
-    photons[median]->axis = PPM_Z;
+    setPhotonAxis( *photons[median], PPM_Z );
     break;
   }
 
@@ -531,37 +770,33 @@ void buildKDTree( PhotonRecord** photons, int start, int end, int depth, PhotonR
   }
 
   kd_tree[current_root] = *(photons[median]);
+  if( end - start >= KD_TREE_TASK_MIN ) {
+    sutil::TaskGroup group;
+    group.run( [=]() {
+      buildKDTree( photons, start, median, depth+1, kd_tree, 2*current_root+1, split_choice, bbmin,  leftMax );
+    } );
+    buildKDTree( photons, median+1, end, depth+1, kd_tree, 2*current_root+2, split_choice, rightMin, bbmax );
+    group.wait();
+    return;
+  }
   buildKDTree( photons, start, median, depth+1, kd_tree, 2*current_root+1, split_choice, bbmin,  leftMax );
   buildKDTree( photons, median+1, end, depth+1, kd_tree, 2*current_root+2, split_choice, rightMin, bbmax );
 }
 
-void createPhotonMap( Buffer photons_buffer, Buffer photon_map_buffer )
+// Host only, does not call into OptiX so it can run on a worker thread.
+void buildPhotonMap( PhotonRecord* photons_data, RTsize num_photons, PhotonRecord* photon_map_data, RTsize photon_map_size )
 {
   const SplitChoice split_choice = LongestDim;
 
-  PhotonRecord* photons_data    = reinterpret_cast<PhotonRecord*>( photons_buffer->map() );
-  PhotonRecord* photon_map_data = reinterpret_cast<PhotonRecord*>( photon_map_buffer->map() );
-
-  RTsize photon_map_size;
-  photon_map_buffer->getSize( photon_map_size );
   for( unsigned int i = 0; i < (unsigned int)photon_map_size; ++i ) {
-    photon_map_data[i].energy = make_float3( 0.0f );
+    photon_map_data[i].energy = 0u;
   }
 
-  // Push all valid photons to front of list
-  RTsize num_photons;
-  photons_buffer->getSize( num_photons );
-  unsigned int valid_photons = 0;
+  // The photons are already compacted on the device
+  unsigned int valid_photons = (unsigned int)num_photons;
   PhotonRecord** temp_photons = new PhotonRecord*[num_photons];
-  for( unsigned int i = 0; i < (unsigned int)num_photons; ++i ) {
-    if( fmaxf( photons_data[i].energy ) > 0.0f ) {
-      temp_photons[valid_photons++] = &photons_data[i];
-    }
-  }
-  if ( s_display_debug_buffer ) {
-    std::cerr << " ** valid_photon/m_num_photons =  " 
-              << valid_photons<<"/"<<num_photons
-              <<" ("<<valid_photons/static_cast<float>(num_photons)<<")\n";
+  for( unsigned int i = 0; i < valid_photons; ++i ) {
+    temp_photons[i] = &photons_data[i];
   }
 
   // Make sure we aren't at most 1 less than power of 2
@@ -584,11 +819,137 @@ void createPhotonMap( Buffer photons_buffer, Buffer photon_map_buffer )
   buildKDTree( temp_photons, 0, valid_photons, 0, photon_map_data, 0, split_choice, bbmin, bbmax );
 
   delete[] temp_photons;
+}
+
+void createPhotonMap( Buffer photons_buffer, unsigned int valid_photons, Buffer photon_map_buffer )
+{
+  SUTIL_NVTX_RANGE( "createPhotonMap" );
+
+  RTsize photon_map_size;
+  photon_map_buffer->getSize( photon_map_size );
+
+  PhotonRecord* photons_data    = reinterpret_cast<PhotonRecord*>( photons_buffer->map() );
+  PhotonRecord* photon_map_data = reinterpret_cast<PhotonRecord*>( photon_map_buffer->map() );
+
+  buildPhotonMap( photons_data, valid_photons, photon_map_data, photon_map_size );
+
   photon_map_buffer->unmap();
   photons_buffer->unmap();
 }
 
 
+// Same tree as createPhotonMap(), built with the launches in ppm_kdtree.cu.
+// The photons never leave the device of ctx.
+void createPhotonMapOnDevice( Context ctx, unsigned int valid_photons, Buffer photon_map_buffer )
+{
+  SUTIL_NVTX_RANGE( "createPhotonMapOnDevice" );
+
+  RTsize photon_map_size;
+  photon_map_buffer->getSize( photon_map_size );
+
+  ctx->launch( kdtree_clear, photon_map_size );
+
+  // Make sure we aren't at most 1 less than power of 2
+  valid_photons = (valid_photons >= (unsigned int) photon_map_size) ? (unsigned int) photon_map_size : valid_photons;
+  if( valid_photons == 0 ) {
+    return;
+  }
+  ctx["kd_valid_photons"]->setUint( valid_photons );
+  ctx->launch( kdtree_init, valid_photons );
+
+  // Split breadth first until the segments are small enough for one thread each.
+  unsigned int levels = 0;
+  while( levels < KD_MAX_PARALLEL_LEVELS && ( valid_photons >> levels ) > KD_SUBTREE_PHOTONS ) {
+    ++levels;
+  }
+
+  for( unsigned int level = 0; level < levels; ++level ) {
+    const unsigned int num_nodes = 1u << level;
+    ctx["kd_level"]->setUint( level );
+
+    ctx->launch( kdtree_level,  num_nodes );
+    ctx->launch( kdtree_bounds, valid_photons );
+    for( int shift = 24; shift >= 0; shift -= 8 ) {
+      ctx["kd_shift"]->setUint( static_cast<unsigned int>( shift ) );
+      ctx->launch( kdtree_histogram, valid_photons );
+      ctx->launch( kdtree_select,    num_nodes );
+    }
+    ctx->launch( kdtree_partition, valid_photons );
+  }
+
+  ctx["kd_level"]->setUint( levels );
+  ctx->launch( kdtree_level,   1u << levels );
+  ctx->launch( kdtree_subtree, 1u << levels );
+}
+
+
+// Sorts the photons into the hashed grid used by gather_grid.
+// The cell size is derived on the device from the hit point radii, so nothing is read back.
+void createPhotonGrid( const sutil::Camera& camera, unsigned int valid_photons )
+{
+  SUTIL_NVTX_RANGE( "createPhotonGrid" );
+
+  context->launch( grid_clear,       GRID_TABLE_SIZE );
+  context->launch( grid_radius,      camera.width() * camera.height() );
+  if( valid_photons > 0 ) {
+    context->launch( grid_count,     valid_photons );
+  }
+  context->launch( grid_scan_blocks, GRID_TABLE_SIZE / GRID_SCAN_BLOCK );
+  context->launch( grid_scan_totals, 1 );
+  context->launch( grid_scan_add,    GRID_TABLE_SIZE );
+  if( valid_photons > 0 ) {
+    context->launch( grid_scatter,   valid_photons );
+  }
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  Profiling
+//
+//------------------------------------------------------------------------------
+
+void recordProfile()
+{
+  if( !s_profile ) {
+    return;
+  }
+  if( s_profile_ring.empty() ) {
+    s_profile_ring.resize( PROFILE_RING_SIZE );
+  }
+  s_profile_ring[s_profile_frames++ % PROFILE_RING_SIZE] = s_frame_profile;
+}
+
+const FrameProfile* lastProfile()
+{
+  return ( s_profile_frames > 0 ) ? &s_profile_ring[( s_profile_frames - 1 ) % PROFILE_RING_SIZE] : 0;
+}
+
+// Writes the frames still held in the ring buffer, oldest first.
+void dumpProfile()
+{
+  if( s_profile_file.empty() || s_profile_frames == 0 ) {
+    return;
+  }
+  std::ofstream csv( s_profile_file.c_str() );
+  if( !csv ) {
+    std::cerr << "Could not write profile '" << s_profile_file << "'\n";
+    return;
+  }
+  csv << "frame,accumulation_frame,rtpass_ms,ppass_ms,build_ms,gather_ms,photon_slots,valid_photons,valid_ratio,average_visited\n";
+  const unsigned int first = ( s_profile_frames > PROFILE_RING_SIZE ) ? s_profile_frames - PROFILE_RING_SIZE : 0u;
+  for( unsigned int frame = first; frame < s_profile_frames; ++frame ) {
+    const FrameProfile& p = s_profile_ring[frame % PROFILE_RING_SIZE];
+    csv << frame << ',' << p.accumulation_frame << ','
+        << p.rtpass * 1000.0 << ',' << p.ppass * 1000.0 << ',' << p.build * 1000.0 << ',' << p.gather * 1000.0 << ','
+        << p.photon_slots << ',' << p.valid_photons << ','
+        << ( p.photon_slots ? p.valid_photons / static_cast<float>( p.photon_slots ) : 0.0f ) << ','
+        << p.average_visited << '\n';
+  }
+  std::cerr << "Wrote profile of " << s_profile_frames - first << " frames to '" << s_profile_file << "'\n";
+}
+
+
 //------------------------------------------------------------------------------
 //
 //  GLFW callbacks
@@ -611,6 +972,7 @@ void keyCallback( GLFWwindow* window, int key, int scancode, int action, int mod
         {
             case GLFW_KEY_Q:
             case GLFW_KEY_ESCAPE:
+                dumpProfile();
                 if( context )
                     context->destroy();
                 if( window )
@@ -658,8 +1020,16 @@ void windowSizeCallback( GLFWwindow* window, int w, int h )
     sutil::resizeBuffer( getOutputBuffer(), width, height );
 
     sutil::resizeBuffer( context[ "debug_buffer" ]->getBuffer(), width, height );
+    sutil::resizeBuffer( context[ "cost_buffer" ]->getBuffer(), width, height );
     sutil::resizeBuffer( context[ "rtpass_output_buffer" ]->getBuffer(), width, height );
-    sutil::resizeBuffer( context[ "image_rnd_seeds" ]->getBuffer(), width, height );
+    sutil::resizeBuffer( context[ "hit_statistics" ]->getBuffer(), width, height );
+    sutil::resizeBuffer( context[ "sppm_statistics" ]->getBuffer(), width, height );
+    if ( s_tiled_gather && !s_photon_grid ) {
+        const unsigned int tiles_x = ( width  + GATHER_TILE_SIZE - 1 ) / GATHER_TILE_SIZE;
+        const unsigned int tiles_y = ( height + GATHER_TILE_SIZE - 1 ) / GATHER_TILE_SIZE;
+        sutil::resizeBuffer( context[ "tile_candidate_counts" ]->getBuffer(), tiles_x, tiles_y );
+        context[ "tile_candidates" ]->getBuffer()->setSize( tiles_x * tiles_y * GATHER_TILE_CANDIDATES );
+    }
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -688,70 +1058,349 @@ GLFWwindow* glfwInitialize( )
 }
 
 
+// Launches the photon pass with the given seed on ctx and compacts its photons. Returns the number of valid photons.
+static unsigned int launchPhotonPass( Context ctx, unsigned int photon_launch_dim, unsigned int rnd_frame )
+{
+    ctx["rnd_frame"]->setUint( rnd_frame );
+
+    const unsigned int num_launches = photon_launch_dim * photon_launch_dim;
+    ctx->launch( ppass, photon_launch_dim, photon_launch_dim );
+    ctx->launch( compact_scan_blocks, ( num_launches + COMPACT_SCAN_BLOCK - 1 ) / COMPACT_SCAN_BLOCK );
+    ctx->launch( compact_scan_totals, 1 );
+    ctx->launch( compact_scatter,     num_launches );
+
+    Buffer compact_count = ctx["compact_count"]->getBuffer();
+    const unsigned int valid_photons = *reinterpret_cast<unsigned int*>( compact_count->map() );
+    compact_count->unmap();
+    return valid_photons;
+}
+
+// Traces a photon pass and compacts its photons into photons_buffer. Returns the number of valid photons.
+unsigned int tracePhotons( unsigned int photon_launch_dim )
+{
+    SUTIL_NVTX_RANGE( "tracePhotons" );
+
+    if (s_print_timings) std::cerr << "Starting photon pass   ... ";
+
+    double t0 = sutil::currentTime();
+
+    if ( s_visual_importance ) {
+        context->launch( importance_update, 1 );
+    }
+    const unsigned int num_launches = photon_launch_dim * photon_launch_dim;
+    const unsigned int valid_photons = launchPhotonPass( context, photon_launch_dim, s_photon_pass++ );
+
+    double t1 = sutil::currentTime();
+    if (s_print_timings) std::cerr << "finished. " << t1 - t0 << std::endl;
+    s_frame_profile.ppass        += t1 - t0;
+    s_frame_profile.photon_slots  = num_launches * MAX_PHOTON_COUNT;
+    s_frame_profile.valid_photons = valid_photons;
+
+    if ( s_display_debug_buffer ) {
+        const unsigned int num_photons = num_launches * MAX_PHOTON_COUNT;
+        std::cerr << " ** valid_photon/m_num_photons =  " 
+                  << valid_photons<<"/"<<num_photons
+                  <<" ("<<valid_photons/static_cast<float>(num_photons)<<")\n";
+    }
+    return valid_photons;
+}
+
+// Note that mapping transfers the whole buffer, only the valid photons are kept.
+static void downloadPhotons( Buffer photons_buffer, unsigned int valid_photons )
+{
+    s_pipeline_photons.resize( valid_photons );
+    memcpy( s_pipeline_photons.data(), photons_buffer->map(), valid_photons * sizeof( PhotonRecord ) );
+    photons_buffer->unmap();
+}
+
+// Builds the host kd-tree of the previous photon pass on a worker thread while the GPU traces the next one.
+// The gather of this frame then uses the previous pass, which is independent of the hit points,
+// so the progressive radius and flux updates see one complete photon pass per frame as before.
+void createPhotonMapPipelined( unsigned int photon_launch_dim, Buffer photons_buffer, Buffer photon_map_buffer )
+{
+    SUTIL_NVTX_RANGE( "createPhotonMapPipelined" );
+
+    RTsize photon_map_size;
+    photon_map_buffer->getSize( photon_map_size );
+
+    // The first frame has no previous pass to build from.
+    if ( s_pipeline_photon_map.empty() ) {
+        s_pipeline_photon_map.resize( photon_map_size );
+        downloadPhotons( photons_buffer, tracePhotons( photon_launch_dim ) );
+    }
+
+    std::thread builder( buildPhotonMap, s_pipeline_photons.data(), s_pipeline_photons.size(),
+                         s_pipeline_photon_map.data(), photon_map_size );
+    const unsigned int valid_photons = tracePhotons( photon_launch_dim );
+    builder.join();
+
+    memcpy( photon_map_buffer->map(), s_pipeline_photon_map.data(), photon_map_size * sizeof( PhotonRecord ) );
+    photon_map_buffer->unmap();
+
+    // The builder is done with the previous pass, keep the one just traced for the next frame.
+    downloadPhotons( photons_buffer, valid_photons );
+}
+
+// Gathers the bound photon map at the hit points of the camera.
+void launchGather( const sutil::Camera& camera )
+{
+    SUTIL_NVTX_RANGE( "launchGather" );
+
+    if ( s_tiled_gather && !s_photon_grid ) {
+        context->launch( gather_tiles,
+                         ( camera.width()  + GATHER_TILE_SIZE - 1 ) / GATHER_TILE_SIZE,
+                         ( camera.height() + GATHER_TILE_SIZE - 1 ) / GATHER_TILE_SIZE );
+    }
+    context->launch( gather, camera.width(), camera.height() );
+}
+
+// Replays the kept photon maps against freshly traced hit points, oldest first, as if their passes
+// had been accumulated with the current camera. Returns the number of replayed passes.
+unsigned int reusePhotonMaps( const sutil::Camera& camera, unsigned int photon_launch_dim )
+{
+    const unsigned int size   = static_cast<unsigned int>( s_photon_maps.size() );
+    const unsigned int oldest = ( s_photon_map_next + size - s_photon_map_count ) % size;
+    for ( unsigned int i = 0; i < s_photon_map_count; ++i ) {
+        context["photon_map"]->set( s_photon_maps[( oldest + i ) % size] );
+        context["frame_number"]->setFloat( static_cast<float>( i ) );
+        context["total_emitted"]->setFloat( static_cast<float>((unsigned long long)( i + 1 )*photon_launch_dim*photon_launch_dim) );
+        launchGather( camera );
+    }
+    return s_photon_map_count;
+}
+
+// Builds a complete copy of the scene for each additional device. The setup functions work on the
+// global context, so it points at the new one while they run.
+void createPhotonDevices( unsigned int photon_launch_dim, const std::vector<int>& devices, const PPMLight& light )
+{
+    Context main_context = context;
+    s_main_device      = devices[0];
+    s_main_cuda_device = cudaDeviceOrdinal( devices[0] );
+
+    RTsize photon_map_size;
+    main_context["photon_map"]->getBuffer()->getSize( photon_map_size );
+
+    for ( size_t i = 1; i < devices.size(); ++i ) {
+        PhotonDevice device;
+        device.device_id     = devices[i];
+        device.cuda_device   = cudaDeviceOrdinal( devices[i] );
+        device.valid_photons = 0u;
+
+        Buffer photons_buffer;
+        createContext( false, photon_launch_dim, devices[i], photons_buffer, device.photon_map );
+        createGeometry();
+        PPMLight device_light;
+        createLight( device_light );
+        context["light"]->setUserData( sizeof(PPMLight), &light );
+        // There are no hit points to learn the visual importance from on the other devices.
+        context["use_visual_importance"]->setUint( 0u );
+        context->validate();
+        device.context = context;
+
+        if ( s_photon_maps.empty() ) {
+            device.target = main_context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_USER, photon_map_size );
+            device.target->setElementSize( sizeof( PhotonRecord ) );
+        }
+        s_photon_devices.push_back( std::move( device ) );
+    }
+    context = main_context;
+}
+
+// Runs on a worker thread per additional device, touching only the context of that device.
+static void tracePhotonDevice( PhotonDevice& device, unsigned int photon_launch_dim, unsigned int rnd_frame )
+{
+    try {
+        device.valid_photons = launchPhotonPass( device.context, photon_launch_dim, rnd_frame );
+        createPhotonMapOnDevice( device.context, device.valid_photons, device.photon_map );
+    } catch ( ... ) {
+        device.error = std::current_exception();
+    }
+}
+
+// Starts the photon passes of the additional devices, they overlap with the passes of the main context.
+void startDevicePhotonPasses( unsigned int photon_launch_dim )
+{
+    for ( size_t i = 0; i < s_photon_devices.size(); ++i ) {
+        PhotonDevice& device = s_photon_devices[i];
+        device.error  = std::exception_ptr();
+        device.worker = std::thread( tracePhotonDevice, std::ref( device ), photon_launch_dim, s_photon_pass++ );
+    }
+}
+
+// Copies the kd-tree of a device into a photon map buffer of the main context without a round trip
+// through the host. cudaMemcpyPeer stages through host memory itself if the devices can't access each other.
+static void copyPhotonMap( PhotonDevice& device, Buffer target )
+{
+    RTsize photon_map_size;
+    device.photon_map->getSize( photon_map_size );
+    const cudaError_t err = cudaMemcpyPeer( target->getDevicePointer( s_main_device ), s_main_cuda_device,
+                                            device.photon_map->getDevicePointer( device.device_id ), device.cuda_device,
+                                            photon_map_size * sizeof( PhotonRecord ) );
+    if ( err != cudaSuccess ) {
+        throw Exception( std::string( "cudaMemcpyPeer failed: " ) + cudaGetErrorString( err ) );
+    }
+}
+
+// Waits for the photon passes of the additional devices and gathers their kd-trees as the progressive
+// passes following the given one of the main context. Returns the number of gathered passes.
+unsigned int gatherDevicePhotonMaps( const sutil::Camera& camera, unsigned int photon_launch_dim, unsigned int pass,
+                                     Buffer photon_map_buffer )
+{
+    for ( size_t i = 0; i < s_photon_devices.size(); ++i ) {
+        s_photon_devices[i].worker.join();
+    }
+    for ( size_t i = 0; i < s_photon_devices.size(); ++i ) {
+        if ( s_photon_devices[i].error ) {
+            std::rethrow_exception( s_photon_devices[i].error );
+        }
+    }
+
+    for ( size_t i = 0; i < s_photon_devices.size(); ++i ) {
+        PhotonDevice& device = s_photon_devices[i];
+
+        Buffer target = device.target;
+        if ( !s_photon_maps.empty() ) {
+            target = s_photon_maps[s_photon_map_next];
+            s_photon_map_next  = ( s_photon_map_next + 1 ) % s_photon_maps.size();
+            s_photon_map_count = std::min( s_photon_map_count + 1, static_cast<unsigned int>( s_photon_maps.size() ) );
+        }
+        copyPhotonMap( device, target );
+
+        s_frame_profile.photon_slots  += photon_launch_dim * photon_launch_dim * MAX_PHOTON_COUNT;
+        s_frame_profile.valid_photons += device.valid_photons;
+
+        ++pass;
+        context["photon_map"]->set( target );
+        context["frame_number"]->setFloat( static_cast<float>( pass - 1 ) );
+        context["total_emitted"]->setFloat( static_cast<float>((unsigned long long)pass*photon_launch_dim*photon_launch_dim) );
+        launchGather( camera );
+    }
+    context["photon_map"]->set( photon_map_buffer );
+    return static_cast<unsigned int>( s_photon_devices.size() );
+}
+
 void launch_all( const sutil::Camera& camera, unsigned int photon_launch_dim, unsigned int accumulation_frame, 
     Buffer photons_buffer, Buffer photon_map_buffer )
 {
-    if ( accumulation_frame == 1 ) {
+    s_frame_profile = FrameProfile();
+    s_frame_profile.accumulation_frame = accumulation_frame;
+
+    // SPPM traces new jittered hit points every pass
+    if ( accumulation_frame == 1 || s_sppm ) {
 
         if (s_print_timings) std::cerr << "Starting RT pass ... ";
         double t0 = sutil::currentTime();
 
         // Trace viewing rays
+        SUTIL_NVTX_PUSH( "rtpass" );
         context->launch( rtpass, camera.width(), camera.height() );
+        SUTIL_NVTX_POP();
+
+        // Flag the grid cells near the new hit points, the learned emission only restarts with the accumulation.
+        if ( s_visual_importance ) {
+            if ( accumulation_frame == 1 ) context->launch( importance_reset, IMPORTANCE_CELLS );
+            context->launch( importance_clear, GRID_TABLE_SIZE );
+            context->launch( importance_mark,  camera.width() * camera.height() );
+        }
 
         double t1 = sutil::currentTime();
         if (s_print_timings) std::cerr << "finished. " << t1 - t0 << std::endl;
+        s_frame_profile.rtpass = t1 - t0;
 
-        context["total_emitted"]->setFloat(  0.0f );
+        if ( accumulation_frame == 1 ) context["total_emitted"]->setFloat(  0.0f );
     }
 
-    // Trace photons
-    {
-        if (s_print_timings) std::cerr << "Starting photon pass   ... ";
+    // Restarts continue from the kept photon maps
+    if ( accumulation_frame == 1 ) {
+        s_reused_passes = 0u;
+        if ( s_photon_map_count > 0 ) {
+            if (s_print_timings) std::cerr << "Starting map reuse     ... ";
+            double t0 = sutil::currentTime();
+
+            s_reused_passes = reusePhotonMaps( camera, photon_launch_dim );
 
-        Buffer photon_rnd_seeds = context["photon_rnd_seeds"]->getBuffer();
-        uint2* seeds = reinterpret_cast<uint2*>( photon_rnd_seeds->map() );
-        for ( unsigned int i = 0; i < photon_launch_dim*photon_launch_dim; ++i ) {
-            seeds[i] = random2u();
+            double t1 = sutil::currentTime();
+            if (s_print_timings) std::cerr << "finished. " << t1 - t0 << std::endl;
+            s_frame_profile.gather = t1 - t0;
         }
-        photon_rnd_seeds->unmap();
-        double t0 = sutil::currentTime();
+    }
+    // Every frame gathers one pass per device.
+    const unsigned int num_devices = static_cast<unsigned int>( s_photon_devices.size() ) + 1u;
+    const unsigned int pass = ( accumulation_frame - 1 ) * num_devices + 1 + s_reused_passes;
+    context["frame_number"]->setFloat( static_cast<float>( pass - 1 ) );
+    if ( !s_photon_maps.empty() ) {
+        photon_map_buffer = s_photon_maps[s_photon_map_next];
+        context["photon_map"]->set( photon_map_buffer );
+    }
 
-        context->launch( ppass, photon_launch_dim, photon_launch_dim );
+    startDevicePhotonPasses( photon_launch_dim );
 
-        double t1 = sutil::currentTime();
-        if (s_print_timings) std::cerr << "finished. " << t1 - t0 << std::endl;
+    // Trace photons, the pipelined build traces the next pass itself
+    unsigned int valid_photons = 0;
+    if ( !s_pipelined || s_photon_grid ) {
+        valid_photons = tracePhotons( photon_launch_dim );
     }
 
     // By computing the total number of photons as an unsigned long long we avoid 32 bit
     // floating point addition errors when the number of photons gets sufficiently large
     // (the error of adding two floating point numbers when the mantissa bits no longer
     // overlap).
-    context["total_emitted"]->setFloat( static_cast<float>((unsigned long long)accumulation_frame*photon_launch_dim*photon_launch_dim) );
+    context["total_emitted"]->setFloat( static_cast<float>((unsigned long long)pass*photon_launch_dim*photon_launch_dim) );
 
-    // Build KD tree
+    // Build KD tree or photon grid
     {
-        if (s_print_timings) std::cerr << "Starting kd_tree build ... ";
+        if (s_print_timings) std::cerr << ( s_photon_grid ? "Starting grid build    ... " : "Starting kd_tree build ... " );
         double t0 = sutil::currentTime();
 
-        createPhotonMap( photons_buffer, photon_map_buffer );
+        if ( s_photon_grid ) {
+            createPhotonGrid( camera, valid_photons );
+        } else if ( s_pipelined ) {
+            createPhotonMapPipelined( photon_launch_dim, photons_buffer, photon_map_buffer );
+        } else if ( s_host_kd_tree ) {
+            createPhotonMap( photons_buffer, valid_photons, photon_map_buffer );
+        } else {
+            createPhotonMapOnDevice( context, valid_photons, photon_map_buffer );
+        }
 
         double t1 = sutil::currentTime();
         if (s_print_timings) std::cerr << "finished. " << t1 - t0 << std::endl;
+        s_frame_profile.build = t1 - t0;
+
+        if ( !s_photon_maps.empty() ) {
+            s_photon_map_next  = ( s_photon_map_next + 1 ) % s_photon_maps.size();
+            s_photon_map_count = std::min( s_photon_map_count + 1, static_cast<unsigned int>( s_photon_maps.size() ) );
+        }
     }
 
 
     // Shade view rays by gathering photons
     {
         if (s_print_timings) std::cerr << "Starting gather pass   ... ";
+
+        Buffer gather_statistics = context["gather_statistics"]->getBuffer();
+        if ( s_profile ) {
+            memset( gather_statistics->map(), 0, 3 * sizeof( unsigned int ) );
+            gather_statistics->unmap();
+        }
         double t0 = sutil::currentTime();
 
-        context->launch( gather, camera.width(), camera.height() );
+        launchGather( camera );
+        gatherDevicePhotonMaps( camera, photon_launch_dim, pass, photon_map_buffer );
 
         double t1 = sutil::currentTime();
         if (s_print_timings) std::cerr << "finished. " << t1 - t0 << std::endl;
+        s_frame_profile.gather += t1 - t0;
+
+        if ( s_profile ) {
+            const unsigned int* counters = reinterpret_cast<const unsigned int*>( gather_statistics->map() );
+            const double visited = static_cast<double>( counters[0] ) + 4294967296.0 * static_cast<double>( counters[1] );
+            s_frame_profile.average_visited = counters[2] ? static_cast<float>( visited / counters[2] ) : 0.0f;
+            gather_statistics->unmap();
+        }
     }
 
+    recordProfile();
+
 }
 
 void glfwRun( GLFWwindow* window, sutil::Camera& camera, PPMLight& light, unsigned int photon_launch_dim, Buffer photons_buffer, Buffer photon_map_buffer )
@@ -822,8 +1471,32 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, PPMLight& light, unsign
                 light.position  = 1000.0f * sphericalToCartesian( 0.5f*M_PIf-light_theta, light_phi );
                 light.direction = normalize( make_float3( 0.0f, 0.0f, 0.0f )  - light.position );
                 context["light"]->setUserData( sizeof(PPMLight), &light );
+                for ( size_t i = 0; i < s_photon_devices.size(); ++i ) {
+                    s_photon_devices[i].context["light"]->setUserData( sizeof(PPMLight), &light );
+                }
+                accumulation_frame = 0;
+                s_photon_map_count = 0u;
+            }
+
+            if ( ImGui::Combo( "cost heatmap", &s_cost_heatmap, "off\0frame\0average\0\0" ) ) {
+                context["use_cost_heatmap"]->setInt( s_cost_heatmap );
                 accumulation_frame = 0;
             }
+            if ( s_cost_heatmap != COST_HEATMAP_OFF &&
+                 ImGui::SliderFloat( "cost scale", &s_cost_scale, 1.0e4f, 1.0e8f, "%.0f cycles", 4.0f ) ) {
+                context["cost_scale"]->setFloat( s_cost_scale );
+            }
+
+            if ( const FrameProfile* p = lastProfile() ) {
+                ImGui::Separator();
+                ImGui::Text( "rtpass  %7.2f ms", p->rtpass * 1000.0 );
+                ImGui::Text( "ppass   %7.2f ms", p->ppass  * 1000.0 );
+                ImGui::Text( "build   %7.2f ms", p->build  * 1000.0 );
+                ImGui::Text( "gather  %7.2f ms", p->gather * 1000.0 );
+                ImGui::Text( "photons %u / %u (%.1f%%)", p->valid_photons, p->photon_slots,
+                             p->photon_slots ? 100.0f * p->valid_photons / p->photon_slots : 0.0f );
+                ImGui::Text( "visited %.1f per hit point", p->average_visited );
+            }
 
             ImGui::End();
         }
@@ -854,7 +1527,7 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, PPMLight& light, unsign
           for( unsigned int j = 0; j < buffer_height; ++j ) {
             for( unsigned int i = 0; i < buffer_width; ++i ) {
 
-              if( hit_record_data[j*buffer_width+i].flags & PPM_HIT ) {
+              if( hit_record_data[j*buffer_width+i].normal_flags & PPM_HIT ) {
                 float4 val = debug_data[j*buffer_width+i];
                 avg += val;
                 minv = fminf(minv, val);
@@ -897,6 +1570,7 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, PPMLight& light, unsign
         glfwSwapBuffers( window );
     }
     
+    dumpProfile();
     destroyContext();
     glfwDestroyWindow( window );
     glfwTerminate();
@@ -920,6 +1594,18 @@ void printUsageAndExit( const std::string& argv0 )
         "         --photon-dim <n>        Width and height of photon launch grid. Default = " << PHOTON_LAUNCH_DIM << ".\n"
         "  -ddb | --display-debug-buffer  Display debug buffer information to the shell.\n"
         "  -pt  | --print-timings         Print timing information.\n"
+        "         --host-kd-tree          Build the photon map on the host instead of the device.\n"
+        "         --photon-grid           Gather photons from a hashed uniform grid instead of the kd-tree.\n"
+        "         --pipelined             Build the host kd-tree of one photon pass while the next one traces.\n"
+        "         --tiled-gather          Traverse the kd-tree once per 8x8 pixel tile and gather from the shared photon list.\n"
+        "         --reuse-photon-maps <k> Keep the last k kd-trees and gather them again after a camera move.\n"
+        "         --sppm                  Stochastic progressive photon mapping, re-traces jittered hit points every pass.\n"
+        "         --devices <n>           Trace and build photon maps on up to n GPUs, gathered on the first. Device kd-tree only.\n"
+        "         --visual-importance     Emit more photons into the directions whose paths reach visible hit points.\n"
+        "         --qmc-emission          Drive the photon emission and first bounces by a Halton sequence over all passes.\n"
+        "         --cost-heatmap          Show the mean gather cycles per pixel as a heatmap instead of the image.\n"
+        "         --profile               Show per pass timings and photon statistics on screen.\n"
+        "         --profile-csv <file>    Like --profile, also write the last " << PROFILE_RING_SIZE << " frames to a CSV file on exit.\n"
         "App Keystrokes:\n"
         "  q  Quit\n"
         "  s  Save image to '" << SAMPLE_NAME << ".png'\n"
@@ -965,6 +1651,52 @@ int main( int argc, char** argv )
         {
             s_print_timings = true;
         }
+        else if( arg == "--host-kd-tree" )
+        {
+            s_host_kd_tree = true;
+        }
+        else if( arg == "--photon-grid" )
+        {
+            s_photon_grid = true;
+        }
+        else if( arg == "--pipelined" )
+        {
+            s_pipelined = true;
+        }
+        else if( arg == "--sppm" )
+        {
+            s_sppm = true;
+        }
+        else if( arg == "--tiled-gather" )
+        {
+            s_tiled_gather = true;
+        }
+        else if( arg == "--visual-importance" )
+        {
+            s_visual_importance = true;
+        }
+        else if( arg == "--qmc-emission" )
+        {
+            s_qmc_emission = true;
+        }
+        else if( arg == "--cost-heatmap" )
+        {
+            s_cost_heatmap = COST_HEATMAP_AVERAGE;
+        }
+        else if( arg == "--profile" )
+        {
+            s_profile = true;
+        }
+        else if( arg == "--profile-csv" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            s_profile = true;
+            s_profile_file = argv[++i];
+        }
         else if( arg == "--photon-dim" )
         {
             if( i == argc-1 )
@@ -975,6 +1707,26 @@ int main( int argc, char** argv )
             int tmp = atoi( argv[++i] );
             if (tmp > 0) photon_launch_dim = static_cast<unsigned int>(tmp);
         }
+        else if( arg == "--devices" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            int tmp = atoi( argv[++i] );
+            if (tmp > 0) s_num_devices = static_cast<unsigned int>(tmp);
+        }
+        else if( arg == "--reuse-photon-maps" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            int tmp = atoi( argv[++i] );
+            if (tmp > 0) s_reuse_photon_maps = static_cast<unsigned int>(tmp);
+        }
         else
         {
             std::cerr << "Unknown option '" << arg << "'\n";
@@ -996,9 +1748,16 @@ int main( int argc, char** argv )
         }
 #endif
 
+        // The other builders work on the host or on the hit points of the main context.
+        if ( s_num_devices > 1 && ( s_host_kd_tree || s_photon_grid || s_pipelined ) ) {
+            std::cerr << "--devices needs the device kd-tree build, tracing photons on one device." << std::endl;
+            s_num_devices = 1u;
+        }
+        const std::vector<int> devices = selectDevices( s_num_devices );
+
         Buffer photons_buffer;
         Buffer photon_map_buffer;
-        createContext( use_pbo, photon_launch_dim, photons_buffer, photon_map_buffer );
+        createContext( use_pbo, photon_launch_dim, devices[0], photons_buffer, photon_map_buffer );
 
         // initial camera data
         const optix::float3 camera_eye( optix::make_float3( -188.0f, 176.0f, 0.0f ) );
@@ -1013,6 +1772,7 @@ int main( int argc, char** argv )
         createLight( light );
 
         context->validate();
+        createPhotonDevices( photon_launch_dim, devices, light );
         
         if ( out_file.empty() )
         {
@@ -1030,6 +1790,7 @@ int main( int argc, char** argv )
             // so it won't match the interactive display.  Apply gamma in an image viewer.
             sutil::writeBufferToFile( out_file.c_str(), getOutputBuffer() );
             std::cerr << "Wrote " << out_file << std::endl;
+            dumpProfile();
             destroyContext();
         }
         return 0;
@@ -33,10 +33,12 @@
 #define  PPM_Z         ( 1 << 2 )
 #define  PPM_LEAF      ( 1 << 3 )
 #define  PPM_NULL      ( 1 << 4 )
+#define  PPM_AXIS_MASK 0xFFu     // The axis flags share PhotonRecord::normal_axis with the normal.
 
 #define  PPM_IN_SHADOW ( 1 << 5 )
 #define  PPM_OVERFLOW  ( 1 << 6 )
 #define  PPM_HIT       ( 1 << 7 )
+#define  PPM_HIT_MASK  0xFFu     // The hit flags share HitRecord::normal_flags with the normal.
 
 enum RayTypes
 {
@@ -61,28 +63,38 @@ struct PPMLight
   optix::float3 v2;
 };
 
+// The hit point written by the rtpass. The gather passes only read it, the progressive
+// statistics which change every pass live in HitStatistics.
 struct HitRecord
 {
- // float3 ray_dir;          // rgp
-
-  optix::float3 position;         //
-  optix::float3 normal;           // Material shader
+  optix::float3 position;
+  optix::uint   normal_flags;     // Octahedral normal in the upper 2x12 bits, PPM_HIT and PPM_OVERFLOW in PPM_HIT_MASK.
   optix::float3 attenuated_Kd;
-  optix::uint   flags;
-
-  float         radius2;          //
-  float         photon_count;     // Client TODO: should be moved clientside?
-  optix::float3 flux;             //
-  float         accum_atten;
+  float         pad;
 };
 
 
 struct PackedHitRecord
 {
-  optix::float4 a;   // position.x, position.y, position.z, normal.x
-  optix::float4 b;   // normal.y,   normal.z,   atten_Kd.x, atten_Kd.y
-  optix::float4 c;   // atten_Kd.z, flags,      radius2,    photon_count
-  optix::float4 d;   // flux.x,     flux.y,     flux.z,     accum_atten 
+  optix::float4 a;   // position.x, position.y, position.z, normal_flags
+  optix::float4 b;   // atten_Kd.x, atten_Kd.y, atten_Kd.z, padding
+};
+
+
+// Progressive statistics of a hit point, reset by the rtpass and updated by every gather pass.
+struct HitStatistics
+{
+  optix::float4 a;   // flux.x,       flux.y,      flux.z,        radius2
+  optix::float4 b;   // photon_count, accum_atten, PPM_IN_SHADOW, padding
+};
+
+
+// Stochastic progressive photon mapping keeps the progressive statistics per pixel,
+// because the hit records are traced anew with jittered samples every pass.
+struct PixelStatistics
+{
+  optix::float4 a;   // flux.x,     flux.y,     flux.z,     radius2
+  optix::float4 b;   // radiance.x, radiance.y, radiance.z, photon_count
 };
 
 
@@ -96,20 +108,133 @@ struct HitPRD
 struct PhotonRecord
 {
   optix::float3 position;
-  optix::float3 normal;      // Pack this into 4 bytes
-  optix::float3 ray_dir;
-  optix::float3 energy;
-  optix::uint   axis;
-  optix::float3 pad;
+  optix::uint   normal_axis; // Octahedral normal in the upper 2x12 bits, kd-tree axis flags in PPM_AXIS_MASK.
+  optix::uint   energy;      // Shared exponent RGB 9:9:9:5.
+  optix::uint   pad[3];
 };
 
 
 struct PackedPhotonRecord
 {
-  optix::float4 a;   // position.x, position.y, position.z, normal.x
-  optix::float4 b;   // normal.y,   normal.z,   ray_dir.x,  ray_dir.y
-  optix::float4 c;   // ray_dir.z,  energy.x,   energy.y,   energy.z
-  optix::float4 d;   // axis,       padding,    padding,    padding
+  optix::float4 a;   // position.x, position.y, position.z, normal_axis
+  optix::float4 b;   // energy,     padding,    padding,    padding
+};
+
+
+static __host__ __device__ __inline__ optix::uint encodePhotonNormal( const optix::float3& n )
+{
+  const float  l1 = fabsf( n.x ) + fabsf( n.y ) + fabsf( n.z );
+  optix::float2 p = optix::make_float2( n.x / l1, n.y / l1 );
+  if( n.z < 0.0f ) {
+    p = optix::make_float2( ( 1.0f - fabsf( p.y ) ) * ( ( p.x < 0.0f ) ? -1.0f : 1.0f ),
+                            ( 1.0f - fabsf( p.x ) ) * ( ( p.y < 0.0f ) ? -1.0f : 1.0f ) );
+  }
+  const optix::uint u = static_cast<optix::uint>( floorf( ( p.x * 0.5f + 0.5f ) * 4095.0f + 0.5f ) );
+  const optix::uint v = static_cast<optix::uint>( floorf( ( p.y * 0.5f + 0.5f ) * 4095.0f + 0.5f ) );
+  return ( u << 20 ) | ( v << 8 );
+}
+
+static __host__ __device__ __inline__ optix::float3 decodePhotonNormal( const optix::uint bits )
+{
+  const float x = static_cast<float>( bits >> 20 ) / 4095.0f * 2.0f - 1.0f;
+  const float y = static_cast<float>( ( bits >> 8 ) & 0xFFFu ) / 4095.0f * 2.0f - 1.0f;
+  optix::float3 n = optix::make_float3( x, y, 1.0f - fabsf( x ) - fabsf( y ) );
+  if( n.z < 0.0f ) {
+    n = optix::make_float3( ( 1.0f - fabsf( y ) ) * ( ( x < 0.0f ) ? -1.0f : 1.0f ),
+                            ( 1.0f - fabsf( x ) ) * ( ( y < 0.0f ) ? -1.0f : 1.0f ),
+                            n.z );
+  }
+  return optix::normalize( n );
+}
+
+// The largest representable energy component is 65408, anything above is clamped.
+static __host__ __device__ __inline__ optix::uint encodePhotonEnergy( const optix::float3& e )
+{
+  const float r = ( e.x > 0.0f ) ? ( ( e.x < 65408.0f ) ? e.x : 65408.0f ) : 0.0f;
+  const float g = ( e.y > 0.0f ) ? ( ( e.y < 65408.0f ) ? e.y : 65408.0f ) : 0.0f;
+  const float b = ( e.z > 0.0f ) ? ( ( e.z < 65408.0f ) ? e.z : 65408.0f ) : 0.0f;
+  const float max_component = ( r > g ) ? ( ( r > b ) ? r : b ) : ( ( g > b ) ? g : b );
+  if( max_component == 0.0f ) {
+    return 0u;
+  }
+
+  int exponent;
+  frexpf( max_component, &exponent );
+  int shared = ( exponent + 15 < 0 ) ? 0 : exponent + 15;  // Bias 15, mantissa of max_component in [256, 512).
+  float scale = ldexpf( 1.0f, shared - 24 );
+  if( floorf( max_component / scale + 0.5f ) >= 512.0f ) {
+    ++shared;
+    scale *= 2.0f;
+  }
+  const optix::uint mr = static_cast<optix::uint>( floorf( r / scale + 0.5f ) );
+  const optix::uint mg = static_cast<optix::uint>( floorf( g / scale + 0.5f ) );
+  const optix::uint mb = static_cast<optix::uint>( floorf( b / scale + 0.5f ) );
+  return mr | ( mg << 9 ) | ( mb << 18 ) | ( static_cast<optix::uint>( shared ) << 27 );
+}
+
+static __host__ __device__ __inline__ optix::float3 decodePhotonEnergy( const optix::uint bits )
+{
+  const float scale = ldexpf( 1.0f, static_cast<int>( bits >> 27 ) - 24 );
+  return optix::make_float3( static_cast<float>( bits & 0x1FFu ),
+                             static_cast<float>( ( bits >> 9 ) & 0x1FFu ),
+                             static_cast<float>( ( bits >> 18 ) & 0x1FFu ) ) * scale;
+}
+
+static __host__ __device__ __inline__ bool photonHasEnergy( const PhotonRecord& photon )
+{
+  return ( photon.energy & 0x07FFFFFFu ) != 0u;
+}
+
+static __host__ __device__ __inline__ void setPhotonAxis( PhotonRecord& photon, const optix::uint axis )
+{
+  photon.normal_axis = ( photon.normal_axis & ~PPM_AXIS_MASK ) | axis;
+}
+
+
+// Photon pass compaction (ppm_compact.cu).
+#define  COMPACT_SCAN_BLOCK      256u  // Photon launch indices per thread in the prefix sum.
+
+// Visual importance driven photon emission (ppm_importance.cu, ppm_ppass.cu).
+// The [0,1]^2 emission sample domain of the light is split into cells, photons are emitted in proportion
+// to how often the paths from a cell deposited near visible hit points and weighted by the inverse of
+// their density relative to the uniform emission.
+#define  IMPORTANCE_RESOLUTION   64u    // Cells per side of the emission sample domain.
+#define  IMPORTANCE_CELLS        ( IMPORTANCE_RESOLUTION * IMPORTANCE_RESOLUTION )
+#define  IMPORTANCE_UNIFORM      0.25f  // Share of the emission probability spread uniformly over all cells.
+
+// Quasi-random photon emission (ppm_ppass.cu).
+#define  QMC_BOUNCE_DIMENSIONS   2u     // Path depths whose diffuse bounces use the Halton sequence, two dimensions each.
+
+// Tiled gather (ppm_gather.cu).
+// One thread per tile of pixels traverses the kd-tree once and stores the photons near any of the tile's
+// hit points, the pixels of the tile then all walk the same list. Tiles with longer lists fall back to
+// the per pixel traversal.
+#define  GATHER_TILE_SIZE        8u
+#define  GATHER_TILE_CANDIDATES  1024u
+#define  GATHER_STACK_SIZE       64    // Both children are pushed, one more than twice the deepest tree.
+
+// Device kd-tree build (ppm_kdtree.cu).
+// The upper levels of the photon map are split breadth first, one launch per step over all photons.
+// Once the node segments are small enough, one thread per node builds the remaining subtree serially.
+#define  KD_MAX_PARALLEL_LEVELS  14u   // Caps the node and histogram storage of the breadth first levels.
+#define  KD_SUBTREE_PHOTONS      64u   // Segment size at which the serial subtree build takes over.
+#define  KD_SUBTREE_STACK_SIZE   32
+#define  KD_HISTOGRAM_BINS       256u  // Radix select digit of 8 bits.
+#define  KD_PHOTON_DONE          0xFFFFFFFFu
+
+struct KdTreeNode
+{
+  optix::uint   start;       // First position of the node's photons in kd_photon_indices.
+  optix::uint   end;         // One past the last position.
+  optix::uint   prefix;      // Radix select: Key bits of the median found so far.
+  optix::uint   rank;        // Radix select: Rank of the median among the keys matching the prefix.
+  optix::uint   less;        // Radix select: Number of keys smaller than the prefix.
+  optix::uint   left;        // Partition counters.
+  optix::uint   right;
+  optix::uint   tie;
+  optix::uint   bbmin[3];    // Photon bounds as order preserving unsigned keys.
+  optix::uint   bbmax[3];
+  optix::uint   pad[2];
 };
 
 
@@ -119,6 +244,8 @@ struct PhotonPRD
   optix::uint2  sample;
   optix::uint   pm_index;
   optix::uint   num_deposits;
+  optix::uint   num_useful;    // Deposits near a visible hit point, for the visual importance.
+  optix::uint   qmc_index;     // Halton sequence index of the photon path.
   optix::uint   ray_depth;
 };
 
@@ -0,0 +1,85 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Compacts the photon pass output into a dense array.
+// Each photon launch index owns max_photon_count slots but usually deposits fewer photons,
+// so a prefix sum over the per launch index deposit counts gives every photon its dense position.
+//
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include "ppm.h"
+
+using namespace optix;
+
+rtBuffer<PhotonRecord, 1>        ppass_output_buffer;
+rtBuffer<uint, 1>                photon_counts;       // Deposits per photon launch index, written by ppass_camera.
+rtBuffer<PhotonRecord, 1>        compact_photons;
+rtBuffer<uint, 1>                compact_offsets;     // Dense position per photon launch index inside its scan block.
+rtBuffer<uint, 1>                compact_block_sums;  // Prefix sum per COMPACT_SCAN_BLOCK launch indices.
+rtBuffer<uint, 1>                compact_count;
+rtDeclareVariable(uint,          max_photon_count, , );
+rtDeclareVariable(uint,          launch_index, rtLaunchIndex, );
+
+
+// Launched over the scan blocks. Exclusive prefix sum of the deposit counts inside each block.
+RT_PROGRAM void compact_scan_blocks()
+{
+  const uint first = launch_index * COMPACT_SCAN_BLOCK;
+  const uint last  = min( first + COMPACT_SCAN_BLOCK, static_cast<uint>( photon_counts.size() ) );
+  uint sum = 0;
+  for( uint i = first; i < last; ++i ) {
+    compact_offsets[i] = sum;
+    sum += photon_counts[i];
+  }
+  compact_block_sums[launch_index] = sum;
+}
+
+// Launched with a single thread. Exclusive prefix sum of the block totals.
+RT_PROGRAM void compact_scan_totals()
+{
+  const uint num_blocks = static_cast<uint>( compact_block_sums.size() );
+  uint sum = 0;
+  for( uint i = 0; i < num_blocks; ++i ) {
+    const uint count = compact_block_sums[i];
+    compact_block_sums[i] = sum;
+    sum += count;
+  }
+  compact_count[0] = sum;
+}
+
+// Launched over the photon launch indices.
+RT_PROGRAM void compact_scatter()
+{
+  const uint offset = compact_offsets[launch_index] + compact_block_sums[launch_index / COMPACT_SCAN_BLOCK];
+  const uint count  = photon_counts[launch_index];
+  for( uint i = 0; i < count; ++i ) {
+    compact_photons[offset + i] = ppass_output_buffer[launch_index * max_photon_count + i];
+  }
+}
@@ -29,8 +29,10 @@
 #include <optix.h>
 #include <optixu/optixu_math_namespace.h>
 #include "ppm.h"
+#include "ppm_grid.h"
 #include "helpers.h"
 #include "random.h"
+#include "cost_heatmap.h"
 
 using namespace optix;
 
@@ -42,12 +44,23 @@ rtDeclareVariable(rtObject,      top_object, , );
 rtBuffer<float4, 2>              output_buffer;
 rtBuffer<float4, 2>              debug_buffer;
 rtBuffer<PackedPhotonRecord, 1>  photon_map;
+rtBuffer<PackedPhotonRecord, 1>  grid_photons;
+rtBuffer<uint, 1>                grid_cells;
+rtBuffer<uint, 1>                grid_info;
+rtBuffer<uint, 2>                tile_candidate_counts;
+rtBuffer<uint, 1>                tile_candidates;
 rtBuffer<PackedHitRecord, 2>     rtpass_output_buffer;
-rtBuffer<uint2, 2>               image_rnd_seeds;
+rtBuffer<HitStatistics, 2>       hit_statistics;
 rtDeclareVariable(float,         scene_epsilon, , );
 rtDeclareVariable(float,         alpha, , );
 rtDeclareVariable(float,         total_emitted, , );
 rtDeclareVariable(float,         frame_number , , );
+rtDeclareVariable(uint,          rnd_frame, , );
+rtDeclareVariable(uint,          use_sppm, , );
+rtDeclareVariable(uint,          use_profiling, , );
+rtBuffer<uint, 1>                gather_statistics;
+rtDeclareVariable(float,         rtpass_default_radius2, , );
+rtBuffer<PixelStatistics, 2>     sppm_statistics;
 rtDeclareVariable(float3,        ambient_light , , );
 rtDeclareVariable(uint,          use_debug_buffer, , );
 rtDeclareVariable(PPMLight,      light , , );
@@ -61,12 +74,11 @@ void accumulatePhoton( const PackedPhotonRecord& photon,
                        const float3& rec_atten_Kd,
                        uint& num_new_photons, float3& flux_M )
 {
-  float3 photon_energy = make_float3( photon.c.y, photon.c.z, photon.c.w );
-  float3 photon_normal = make_float3( photon.a.w, photon.b.x, photon.b.y );
+  float3 photon_normal = decodePhotonNormal( __float_as_uint( photon.a.w ) );
   float p_dot_hit = dot(photon_normal, rec_normal);
   if (p_dot_hit > 0.01f) { // Fudge factor for imperfect cornell box geom
-    float3 photon_ray_dir = make_float3( photon.b.z, photon.b.w, photon.c.x );
-    float3 flux = photon_energy * rec_atten_Kd; // * -dot(photon_ray_dir, rec_normal);
+    float3 photon_energy = decodePhotonEnergy( __float_as_uint( photon.b.x ) );
+    float3 flux = photon_energy * rec_atten_Kd;
     num_new_photons++;
     flux_M += flux;
   }
@@ -86,26 +98,14 @@ void accumulatePhoton( const PackedPhotonRecord& photon,
 #endif
 
 
-#define MAX_DEPTH 20 // one MILLION photons
-RT_PROGRAM void gather()
+#define MAX_DEPTH 32 // One far child per level, enough for any tree which uint node indices can address
+static __device__ __inline__
+void gatherKDTree( const float3& rec_position,
+                   const float3& rec_normal,
+                   const float3& rec_atten_Kd,
+                   const float rec_radius2,
+                   uint& num_new_photons, float3& flux_M, uint& loop_iter )
 {
-  clock_t start = clock();
-  PackedHitRecord rec = rtpass_output_buffer[launch_index];
-  float3 rec_position = make_float3( rec.a.x, rec.a.y, rec.a.z );
-  float3 rec_normal   = make_float3( rec.a.w, rec.b.x, rec.b.y );
-  float3 rec_atten_Kd = make_float3( rec.b.z, rec.b.w, rec.c.x );
-  uint   rec_flags    = __float_as_int( rec.c.y );
-  float  rec_radius2  = rec.c.z;
-  float  rec_photon_count = rec.c.w;
-  float3 rec_flux     = make_float3( rec.d.x, rec.d.y, rec.d.z );
-  float  rec_accum_atten = rec.d.w;
-
-  // Check if this is hit point lies on an emitter or hit background 
-  if( !(rec_flags & PPM_HIT) || rec_flags & PPM_OVERFLOW ) {
-    output_buffer[launch_index] = make_float4(rec_atten_Kd);
-    return;
-  }
-
   unsigned int stack[MAX_DEPTH];
   unsigned int stack_current = 0;
   unsigned int node = 0; // 0 is the start
@@ -117,15 +117,12 @@ RT_PROGRAM void gather()
 
   int photon_map_size = photon_map.size(); // for debugging
 
-  uint num_new_photons = 0u;
-  float3 flux_M = make_float3( 0.0f, 0.0f, 0.0f );
-  uint loop_iter = 0;
   do {
 
     check( node < photon_map_size, make_float3( 1,0,0 ) );
     PackedPhotonRecord& photon = photon_map[ node ];
 
-    uint axis = __float_as_int( photon.d.x );
+    uint axis = __float_as_uint( photon.a.w ) & PPM_AXIS_MASK;
     if( !( axis & PPM_NULL ) ) {
 
       float3 photon_position = make_float3( photon.a );
@@ -160,34 +157,170 @@ RT_PROGRAM void gather()
     }
     loop_iter++;
   } while ( node );
+}
+
+// Walks the candidate list of the pixel's tile, or traverses the kd-tree itself if the list overflowed.
+static __device__ __inline__
+void gatherTile( const float3& rec_position,
+                 const float3& rec_normal,
+                 const float3& rec_atten_Kd,
+                 const float rec_radius2,
+                 uint& num_new_photons, float3& flux_M, uint& loop_iter )
+{
+  const uint2 tile  = make_uint2( launch_index.x / GATHER_TILE_SIZE, launch_index.y / GATHER_TILE_SIZE );
+  const uint  count = tile_candidate_counts[tile];
+  if( count > GATHER_TILE_CANDIDATES ) {
+    gatherKDTree( rec_position, rec_normal, rec_atten_Kd, rec_radius2, num_new_photons, flux_M, loop_iter );
+    return;
+  }
+
+  const uint first = ( tile.y * tile_candidate_counts.size().x + tile.x ) * GATHER_TILE_CANDIDATES;
+  for( uint i = 0; i < count; ++i ) {
+    const PackedPhotonRecord& photon = photon_map[ tile_candidates[ first + i ] ];
+    const float3 diff = rec_position - make_float3( photon.a );
+    if( dot( diff, diff ) <= rec_radius2 ) {
+      accumulatePhoton( photon, rec_normal, rec_atten_Kd, num_new_photons, flux_M );
+    }
+    loop_iter++;
+  }
+}
+
+// Visits the 2x2x2 grid cells which contain the sphere of radius rec_radius2 around the hit point.
+static __device__ __inline__
+void gatherGrid( const float3& rec_position,
+                 const float3& rec_normal,
+                 const float3& rec_atten_Kd,
+                 const float rec_radius2,
+                 uint& num_new_photons, float3& flux_M, uint& loop_iter )
+{
+  const float inv_cell_size = 1.0f / gridCellSize( grid_info[GRID_INFO_RADIUS2] );
+  const int3  base = gridCell( rec_position - make_float3( 0.5f / inv_cell_size ), inv_cell_size );
+  const uint  num_photons = grid_info[GRID_INFO_COUNT];
+
+  uint buckets[8];
+  for( int i = 0; i < 8; ++i ) {
+    const uint bucket = gridHash( base + make_int3( i & 1, ( i >> 1 ) & 1, i >> 2 ) );
+
+    // Neighboring cells which hash to the same bucket must only be visited once.
+    bool visited = false;
+    for( int j = 0; j < i; ++j ) {
+      visited |= ( buckets[j] == bucket );
+    }
+    buckets[i] = bucket;
+    if( visited ) {
+      continue;
+    }
+
+    const uint first = grid_cells[bucket];
+    const uint last  = ( bucket + 1u < GRID_TABLE_SIZE ) ? grid_cells[bucket + 1u] : num_photons;
+    for( uint index = first; index < last; ++index ) {
+      const PackedPhotonRecord& photon = grid_photons[index];
+      const float3 diff = rec_position - make_float3( photon.a );
+      if( dot( diff, diff ) <= rec_radius2 ) {
+        accumulatePhoton( photon, rec_normal, rec_atten_Kd, num_new_photons, flux_M );
+      }
+      loop_iter++;
+    }
+  }
+}
+
+enum GatherMode
+{
+  GATHER_KD_TREE,
+  GATHER_GRID,
+  GATHER_TILED
+};
+
+static __device__ __inline__ void gatherPhotons( const GatherMode mode )
+{
+  const PackedHitRecord rec = rtpass_output_buffer[launch_index];
+  float3 rec_position = make_float3( rec.a );
+  uint   rec_normal_flags = __float_as_uint( rec.a.w );
+  float3 rec_atten_Kd = make_float3( rec.b );
+  uint   rec_flags    = rec_normal_flags & PPM_HIT_MASK;
+
+  float  rec_radius2;
+  float  rec_photon_count;
+  float3 rec_flux;
+  float  rec_accum_atten = 0.0f;
+
+  // SPPM: The hit record only holds this pass' hit point, the progressive statistics live per pixel.
+  PixelStatistics stats;
+  if( use_sppm ) {
+    if( frame_number == 0.0f ) {
+      stats.a = make_float4( 0.0f, 0.0f, 0.0f, rtpass_default_radius2 );
+      stats.b = make_float4( 0.0f );
+    } else {
+      stats = sppm_statistics[launch_index];
+    }
+    rec_radius2      = stats.a.w;
+    rec_photon_count = stats.b.w;
+    rec_flux         = make_float3( stats.a );
+  }
+
+  // Check if this is hit point lies on an emitter or hit background 
+  if( !(rec_flags & PPM_HIT) || rec_flags & PPM_OVERFLOW ) {
+    if( use_sppm ) {
+      // Passes which miss the diffuse surfaces deposit no flux but still count towards the pixel average.
+      stats.b = make_float4( make_float3( stats.b ) + rec_atten_Kd, stats.b.w );
+      sppm_statistics[launch_index] = stats;
+      // total_emitted is 0.0f until the first photon pass finished.
+      float3 indirect_flux = total_emitted > 0.0f ? 1.0f / ( M_PIf * rec_radius2 ) * rec_flux / total_emitted : make_float3( 0.0f );
+      output_buffer[launch_index] = make_float4( make_float3( stats.b ) / ( frame_number + 1.0f ) + indirect_flux );
+      return;
+    }
+    output_buffer[launch_index] = make_float4(rec_atten_Kd);
+    return;
+  }
+
+  // Only hit points on the diffuse surfaces carry statistics.
+  HitStatistics hit_stats;
+  if( !use_sppm ) {
+    hit_stats        = hit_statistics[launch_index];
+    rec_flux         = make_float3( hit_stats.a );
+    rec_radius2      = hit_stats.a.w;
+    rec_photon_count = hit_stats.b.x;
+    rec_accum_atten  = hit_stats.b.y;
+    rec_flags       |= __float_as_uint( hit_stats.b.z );
+  }
+  const float3 rec_normal = decodePhotonNormal( rec_normal_flags );
+
+  uint num_new_photons = 0u;
+  float3 flux_M = make_float3( 0.0f, 0.0f, 0.0f );
+  uint loop_iter = 0;
+  if( mode == GATHER_GRID ) {
+    gatherGrid( rec_position, rec_normal, rec_atten_Kd, rec_radius2, num_new_photons, flux_M, loop_iter );
+  } else if( mode == GATHER_TILED ) {
+    gatherTile( rec_position, rec_normal, rec_atten_Kd, rec_radius2, num_new_photons, flux_M, loop_iter );
+  } else {
+    gatherKDTree( rec_position, rec_normal, rec_atten_Kd, rec_radius2, num_new_photons, flux_M, loop_iter );
+  }
 
   // Compute new N,R
   float R2 = rec_radius2;
   float N = rec_photon_count;
   float M = static_cast<float>( num_new_photons ) ;
   float new_N = N + alpha*M;
-  rec.c.w = new_N;  // set rec.photon_count
 
   float reduction_factor2 = 1.0f;
   float new_R2 = R2;
   if( M != 0 ) {
     reduction_factor2 = ( N + alpha*M ) / ( N + M );
     new_R2 = R2*( reduction_factor2 ); 
-    rec.c.z = new_R2; // set rec.radius2
   }
 
   // Compute indirectflux
   float3 new_flux = ( rec_flux + flux_M ) * reduction_factor2;
-  rec.d = make_float4( new_flux ); // set rec.flux
-  float3 indirect_flux = 1.0f / ( M_PIf * new_R2 ) * new_flux / total_emitted;
+  float3 indirect_flux = total_emitted > 0.0f ? 1.0f / ( M_PIf * new_R2 ) * new_flux / total_emitted : make_float3( 0.0f );
 
   // Compute direct
   float3 point_on_light;
   float dist_scale;
   if( light.is_area_light ) {
-    uint2  seed   = image_rnd_seeds[launch_index];
+    // Salted so the light samples don't correlate with the photon pass seeds of the same index.
+    uint   index  = launch_index.y * output_buffer.size().x + launch_index.x;
+    uint2  seed   = make_uint2( tea<16>( index, rnd_frame ^ 0x5bd1e995u ), tea<16>( rnd_frame ^ 0x5bd1e995u, index ) );
     float2 sample = make_float2( rnd( seed.x ), rnd( seed.y ) ); 
-    image_rnd_seeds[launch_index] = seed;
     point_on_light = light.anchor + sample.x*light.v1 + sample.y*light.v2; 
     dist_scale = 1.0f;
   } else {
@@ -215,19 +348,146 @@ RT_PROGRAM void gather()
     optix::Ray shadow_ray( rec_position, to_light, shadow_ray_type, scene_epsilon, light_dist - scene_epsilon );
     rtTrace( top_object, shadow_ray, prd );
     light_atten *= prd.attenuation * dot( -to_light, light.direction );
-    rec.c.y = __int_as_float(  prd.attenuation == 0.0f && !light.is_area_light ? rec_flags|PPM_IN_SHADOW : rec_flags ); 
+    if( prd.attenuation == 0.0f && !light.is_area_light ) {
+      rec_flags |= PPM_IN_SHADOW;
+    }
   } 
   light_atten /= dist_scale*light_dist*light_dist;
   if( light_atten < 0.0f ) light_atten = 0.0f;   // TODO Shouldnt be needed but we get acne near light w/out it
-  rec.d.w = rec_accum_atten + light_atten;
-  float avg_atten = rec.d.w / (frame_number+1.0f);
+  const float accum_atten = rec_accum_atten + light_atten;
+  float avg_atten = accum_atten / (frame_number+1.0f);
   float3 direct_flux = light.power * avg_atten *rec_atten_Kd;
   
-  rtpass_output_buffer[launch_index] = rec;
+  if( !use_sppm ) {
+    hit_stats.a = make_float4( new_flux, new_R2 );
+    hit_stats.b = make_float4( new_N, accum_atten, __uint_as_float( rec_flags & PPM_IN_SHADOW ), 0.0f );
+    hit_statistics[launch_index] = hit_stats;
+  }
   float3 final_color = direct_flux + indirect_flux + ambient_light*rec_atten_Kd; 
+  if( use_sppm ) {
+    // The attenuation changes with every hit point, so the direct and ambient radiance is averaged instead.
+    const float3 radiance = make_float3( stats.b ) + ( light.power * light_atten + ambient_light ) * rec_atten_Kd;
+    stats.a = make_float4( new_flux, new_R2 );
+    stats.b = make_float4( radiance, new_N );
+    sppm_statistics[launch_index] = stats;
+    final_color = radiance / ( frame_number + 1.0f ) + indirect_flux;
+  }
   output_buffer[launch_index] = make_float4(final_color);
   if(use_debug_buffer == 1)
     debug_buffer[launch_index] = make_float4( loop_iter, new_R2, new_N, M );
+  if( use_profiling ) {
+    // 64 bit sum of the visited counts from two 32 bit words
+    const uint previous = atomicAdd( &gather_statistics[0], loop_iter );
+    if( previous + loop_iter < previous ) {
+      atomicAdd( &gather_statistics[1], 1u );
+    }
+    atomicAdd( &gather_statistics[2], 1u );
+  }
+}
+
+// Shows the cycles of the gather instead of the radiance when visualizing the cost.
+static __device__ __inline__ void showCost( const long long start )
+{
+  if( use_cost_heatmap )
+    output_buffer[launch_index] = make_float4( record_cost( launch_index, start, static_cast<uint>( frame_number ) ), 1.0f );
+}
+
+RT_PROGRAM void gather()
+{
+  const long long start = clock64();
+  gatherPhotons( GATHER_KD_TREE );
+  showCost( start );
+}
+
+RT_PROGRAM void gather_grid()
+{
+  const long long start = clock64();
+  gatherPhotons( GATHER_GRID );
+  showCost( start );
+}
+
+RT_PROGRAM void gather_tiled()
+{
+  const long long start = clock64();
+  gatherPhotons( GATHER_TILED );
+  showCost( start );
+}
+
+// Launched over the tiles: collects the photons within the largest radius of the box around the tile's hit points.
+RT_PROGRAM void gather_tile_candidates()
+{
+  const uint2 size  = rtpass_output_buffer.size();
+  const uint  first = ( launch_index.y * tile_candidate_counts.size().x + launch_index.x ) * GATHER_TILE_CANDIDATES;
+
+  float3 bbmin = make_float3(  1e37f );
+  float3 bbmax = make_float3( -1e37f );
+  float  max_radius2 = 0.0f;
+  for( uint y = 0; y < GATHER_TILE_SIZE; ++y ) {
+    for( uint x = 0; x < GATHER_TILE_SIZE; ++x ) {
+      const uint2 pixel = make_uint2( launch_index.x * GATHER_TILE_SIZE + x, launch_index.y * GATHER_TILE_SIZE + y );
+      if( pixel.x >= size.x || pixel.y >= size.y )
+        continue;
+
+      const PackedHitRecord& rec = rtpass_output_buffer[pixel];
+      const uint rec_flags = __float_as_uint( rec.a.w ) & PPM_HIT_MASK;
+      if( !(rec_flags & PPM_HIT) || rec_flags & PPM_OVERFLOW )
+        continue;
+
+      float rec_radius2;
+      if( use_sppm ) {
+        rec_radius2 = frame_number == 0.0f ? rtpass_default_radius2 : sppm_statistics[pixel].a.w;
+      } else {
+        rec_radius2 = hit_statistics[pixel].a.w;
+      }
+      const float3 rec_position = make_float3( rec.a );
+      bbmin = fminf( bbmin, rec_position );
+      bbmax = fmaxf( bbmax, rec_position );
+      max_radius2 = fmaxf( max_radius2, rec_radius2 );
+    }
+  }
+
+  uint count = 0u;
+  if( bbmin.x <= bbmax.x ) {
+    const float radius = sqrtf( max_radius2 );
+    bbmin -= make_float3( radius );
+    bbmax += make_float3( radius );
+
+    uint stack[GATHER_STACK_SIZE];
+    uint stack_current = 0;
+    stack[stack_current++] = 0;
+
+    const uint photon_map_size = photon_map.size();
+    while( stack_current > 0 && count <= GATHER_TILE_CANDIDATES ) {
+      const uint node = stack[--stack_current];
+      if( node >= photon_map_size )
+        continue;
+
+      const PackedPhotonRecord& photon = photon_map[ node ];
+      const uint axis = __float_as_uint( photon.a.w ) & PPM_AXIS_MASK;
+      if( axis & PPM_NULL )
+        continue;
+
+      const float3 photon_position = make_float3( photon.a );
+      if( photon_position.x >= bbmin.x && photon_position.y >= bbmin.y && photon_position.z >= bbmin.z &&
+          photon_position.x <= bbmax.x && photon_position.y <= bbmax.y && photon_position.z <= bbmax.z ) {
+        if( count < GATHER_TILE_CANDIDATES ) {
+          tile_candidates[ first + count ] = node;
+        }
+        count++;
+      }
+
+      if( !( axis & PPM_LEAF ) ) {
+        float split, lo, hi;
+        if      ( axis & PPM_X ) { split = photon_position.x; lo = bbmin.x; hi = bbmax.x; }
+        else if ( axis & PPM_Y ) { split = photon_position.y; lo = bbmin.y; hi = bbmax.y; }
+        else                     { split = photon_position.z; lo = bbmin.z; hi = bbmax.z; }
+
+        if( hi >= split ) stack[stack_current++] = (node<<1) + 2;
+        if( lo <= split ) stack[stack_current++] = (node<<1) + 1;
+      }
+    }
+  }
+  tile_candidate_counts[launch_index] = count;
 }
 
 RT_PROGRAM void gather_any_hit()
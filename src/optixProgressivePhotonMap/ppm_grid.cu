@@ -0,0 +1,134 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Builds the hashed uniform photon grid on the device with a counting sort by bucket.
+// The cell size follows the largest hit point radius, which shrinks every pass.
+//
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include "ppm.h"
+#include "ppm_grid.h"
+
+using namespace optix;
+
+rtBuffer<PhotonRecord, 1>        compact_photons;
+rtBuffer<PackedHitRecord, 2>     rtpass_output_buffer;
+rtBuffer<HitStatistics, 2>       hit_statistics;
+rtBuffer<PixelStatistics, 2>     sppm_statistics;
+rtDeclareVariable(uint,          use_sppm, , );
+rtDeclareVariable(float,         frame_number, , );
+rtDeclareVariable(float,         rtpass_default_radius2, , );
+rtBuffer<PhotonRecord, 1>        grid_photons;       // Photons sorted by bucket.
+rtBuffer<uint, 1>                grid_cells;         // First photon of each bucket.
+rtBuffer<uint, 1>                grid_photon_slots;  // Rank of each photon inside its bucket.
+rtBuffer<uint, 1>                grid_block_sums;    // Prefix sum per GRID_SCAN_BLOCK buckets.
+rtBuffer<uint, 1>                grid_info;
+rtDeclareVariable(uint,          launch_index, rtLaunchIndex, );
+
+
+static __device__ __inline__ uint photonBucket( const PhotonRecord& photon )
+{
+  const float inv_cell_size = 1.0f / gridCellSize( grid_info[GRID_INFO_RADIUS2] );
+  return gridHash( gridCell( photon.position, inv_cell_size ) );
+}
+
+
+// Launched over the buckets.
+RT_PROGRAM void grid_clear()
+{
+  grid_cells[launch_index] = 0;
+  if( launch_index < GRID_INFO_SIZE ) {
+    grid_info[launch_index] = 0;
+  }
+}
+
+// Launched over the hit points. Positive floats order like their bit patterns.
+RT_PROGRAM void grid_radius()
+{
+  const uint  width = static_cast<uint>( rtpass_output_buffer.size().x );
+  const uint2 pixel = make_uint2( launch_index % width, launch_index / width );
+  const PackedHitRecord& rec = rtpass_output_buffer[pixel];
+  const uint rec_flags = __float_as_uint( rec.a.w ) & PPM_HIT_MASK;
+  if( ( rec_flags & PPM_HIT ) && !( rec_flags & PPM_OVERFLOW ) ) {
+    // SPPM keeps the radius per pixel, the gather initializes it on the first frame.
+    float radius2;
+    if( use_sppm ) {
+      radius2 = ( frame_number == 0.0f ) ? rtpass_default_radius2 : sppm_statistics[pixel].a.w;
+    } else {
+      radius2 = hit_statistics[pixel].a.w;
+    }
+    atomicMax( &grid_info[GRID_INFO_RADIUS2], __float_as_uint( radius2 ) );
+  }
+}
+
+// Launched over the compacted photons.
+RT_PROGRAM void grid_count()
+{
+  const PhotonRecord& photon = compact_photons[launch_index];
+  grid_photon_slots[launch_index] = atomicAdd( &grid_cells[photonBucket( photon )], 1u );
+}
+
+// Launched over the scan blocks. Exclusive prefix sum of the bucket counts inside each block.
+RT_PROGRAM void grid_scan_blocks()
+{
+  const uint first = launch_index * GRID_SCAN_BLOCK;
+  uint sum = 0;
+  for( uint i = first; i < first + GRID_SCAN_BLOCK; ++i ) {
+    const uint count = grid_cells[i];
+    grid_cells[i] = sum;
+    sum += count;
+  }
+  grid_block_sums[launch_index] = sum;
+}
+
+// Launched with a single thread. Exclusive prefix sum of the block totals.
+RT_PROGRAM void grid_scan_totals()
+{
+  uint sum = 0;
+  for( uint i = 0; i < GRID_TABLE_SIZE / GRID_SCAN_BLOCK; ++i ) {
+    const uint count = grid_block_sums[i];
+    grid_block_sums[i] = sum;
+    sum += count;
+  }
+  grid_info[GRID_INFO_COUNT] = sum;
+}
+
+// Launched over the buckets.
+RT_PROGRAM void grid_scan_add()
+{
+  grid_cells[launch_index] += grid_block_sums[launch_index / GRID_SCAN_BLOCK];
+}
+
+// Launched over the compacted photons.
+RT_PROGRAM void grid_scatter()
+{
+  const PhotonRecord& photon = compact_photons[launch_index];
+  grid_photons[grid_cells[photonBucket( photon )] + grid_photon_slots[launch_index]] = photon;
+}
@@ -0,0 +1,63 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixu_math_namespace.h>
+
+// Hashed uniform grid photon lookup (ppm_grid.cu, gather_grid in ppm_gather.cu).
+// The cell size is twice the largest hit point radius of the current pass,
+// so a gather only needs to visit the 2x2x2 cells around its hit point.
+#define  GRID_TABLE_SIZE   ( 1u << 18 )  // Number of hash buckets, power of two.
+#define  GRID_SCAN_BLOCK   256u          // Buckets per thread in the prefix sum.
+#define  GRID_INFO_RADIUS2 0             // grid_info slots: Maximum radius2 as float bits.
+#define  GRID_INFO_COUNT   1             // Number of photons in the grid.
+#define  GRID_INFO_SIZE    2
+
+#ifdef __CUDACC__
+
+static __device__ __inline__ float gridCellSize( const optix::uint radius2_bits )
+{
+  return fmaxf( 2.0f * sqrtf( __uint_as_float( radius2_bits ) ), 1.0e-6f );
+}
+
+static __device__ __inline__ optix::int3 gridCell( const optix::float3& position, const float inv_cell_size )
+{
+  return optix::make_int3( static_cast<int>( floorf( position.x * inv_cell_size ) ),
+                           static_cast<int>( floorf( position.y * inv_cell_size ) ),
+                           static_cast<int>( floorf( position.z * inv_cell_size ) ) );
+}
+
+static __device__ __inline__ optix::uint gridHash( const optix::int3& cell )
+{
+  return ( static_cast<optix::uint>( cell.x ) * 73856093u ^
+           static_cast<optix::uint>( cell.y ) * 19349663u ^
+           static_cast<optix::uint>( cell.z ) * 83492791u ) & ( GRID_TABLE_SIZE - 1u );
+}
+
+#endif // __CUDACC__
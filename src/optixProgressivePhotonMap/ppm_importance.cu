@@ -0,0 +1,100 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Visual importance for the photon emission.
+// The grid cells around the visible hit points are flagged, photon paths which deposit into a flagged
+// cell credit the cell of the emission sample domain they started from (ppm_ppass.cu), and the emission
+// distribution of the next pass follows the credited usefulness mixed with a uniform share.
+//
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include "ppm.h"
+#include "ppm_grid.h"
+
+using namespace optix;
+
+rtBuffer<PackedHitRecord, 2>     rtpass_output_buffer;
+rtDeclareVariable(float,         rtpass_default_radius2, , );
+rtBuffer<uint, 1>                visible_cells;        // Non-zero for the grid buckets near a visible hit point.
+rtBuffer<float, 1>               emission_importance;  // Useful deposits per emission cell, weighted as if emitted uniformly.
+rtBuffer<float2, 1>              emission_cdf;         // Inclusive CDF and probability per emission cell.
+rtDeclareVariable(uint,          launch_index, rtLaunchIndex, );
+
+
+// Launched over the buckets.
+RT_PROGRAM void importance_clear()
+{
+  visible_cells[launch_index] = 0u;
+}
+
+// Launched over the emission cells, when the accumulation restarts.
+RT_PROGRAM void importance_reset()
+{
+  emission_importance[launch_index] = 0.0f;
+}
+
+// Launched over the hit points. The radii only shrink from rtpass_default_radius2, so cells of the
+// photon grid's size for that radius cover every photon a gather can find in the 2x2x2 cells around it.
+RT_PROGRAM void importance_mark()
+{
+  const uint  width = static_cast<uint>( rtpass_output_buffer.size().x );
+  const uint2 pixel = make_uint2( launch_index % width, launch_index / width );
+  const PackedHitRecord& rec = rtpass_output_buffer[pixel];
+  const uint rec_flags = __float_as_uint( rec.a.w ) & PPM_HIT_MASK;
+  if( !( rec_flags & PPM_HIT ) || ( rec_flags & PPM_OVERFLOW ) ) {
+    return;
+  }
+
+  const float inv_cell_size = 1.0f / gridCellSize( __float_as_uint( rtpass_default_radius2 ) );
+  const int3  base = gridCell( make_float3( rec.a ) - make_float3( 0.5f / inv_cell_size ), inv_cell_size );
+  for( int i = 0; i < 8; ++i ) {
+    visible_cells[gridHash( base + make_int3( i & 1, ( i >> 1 ) & 1, i >> 2 ) )] = 1u;
+  }
+}
+
+// Launched with a single thread before each photon pass. Every cell keeps at least the uniform share
+// of the probability, so no emission direction is ever excluded and the weighting stays unbiased.
+RT_PROGRAM void importance_update()
+{
+  float total = 0.0f;
+  for( uint i = 0; i < IMPORTANCE_CELLS; ++i ) {
+    total += emission_importance[i];
+  }
+  const float learned = ( total > 0.0f ) ? ( 1.0f - IMPORTANCE_UNIFORM ) / total : 0.0f;
+  const float uniform = ( ( total > 0.0f ) ? IMPORTANCE_UNIFORM : 1.0f ) / static_cast<float>( IMPORTANCE_CELLS );
+
+  float cdf = 0.0f;
+  for( uint i = 0; i < IMPORTANCE_CELLS; ++i ) {
+    const float p = uniform + learned * emission_importance[i];
+    cdf += p;
+    emission_cdf[i] = make_float2( cdf, p );
+  }
+  emission_cdf[IMPORTANCE_CELLS - 1].x = 1.0f;
+}
@@ -0,0 +1,339 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Builds the balanced photon map kd-tree on the device.
+// The layout is identical to the host builder in optixProgressivePhotonMap.cpp:
+// node i has its children at 2*i+1 and 2*i+2, the split axis is stored in PhotonRecord::normal_axis,
+// and empty nodes are PPM_NULL with zero energy.
+//
+// The upper levels are split breadth first. Each split finds the exact median of the node's photons
+// along the longest dimension of their bounds with a radix select (four 8 bit digit passes), then
+// scatters the photons into the left and right halves of the node segment.
+// Once the segments are small, one thread per node builds its subtree with an in-place quickselect.
+//
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include "ppm.h"
+
+using namespace optix;
+
+rtBuffer<PhotonRecord, 1>        compact_photons;
+rtBuffer<PhotonRecord, 1>        photon_map;
+rtBuffer<uint, 1>                kd_photon_indices;  // Photon indices ordered by node segments.
+rtBuffer<uint, 1>                kd_photon_nodes;    // Current tree node per photon.
+rtBuffer<KdTreeNode, 1>          kd_nodes;           // Nodes of the breadth first levels.
+rtBuffer<uint, 1>                kd_histogram;       // KD_HISTOGRAM_BINS per node of the current level.
+rtDeclareVariable(uint,          kd_valid_photons, , );
+rtDeclareVariable(uint,          kd_level, , );
+rtDeclareVariable(uint,          kd_shift, , );
+rtDeclareVariable(uint,          launch_index, rtLaunchIndex, );
+
+
+// Maps a float to an unsigned int with the same ordering.
+static __device__ __inline__ uint floatToKey( const float f )
+{
+  const uint u = __float_as_uint( f );
+  return ( u & 0x80000000u ) ? ~u : ( u | 0x80000000u );
+}
+
+static __device__ __inline__ float keyToFloat( const uint key )
+{
+  return __uint_as_float( ( key & 0x80000000u ) ? ( key & 0x7FFFFFFFu ) : ~key );
+}
+
+static __device__ __inline__ float photonCoordinate( const uint photon, const uint axis )
+{
+  const float3 position = compact_photons[photon].position;
+  return ( axis == 0 ) ? position.x : ( ( axis == 1 ) ? position.y : position.z );
+}
+
+static __device__ __inline__ uint longestDimension( const float3& bbmin, const float3& bbmax )
+{
+  const float3 diag = bbmax - bbmin;
+  if( diag.x > diag.y ) {
+    return ( diag.x > diag.z ) ? 0 : 2;
+  }
+  return ( diag.y > diag.z ) ? 1 : 2;
+}
+
+static __device__ __inline__ uint nodeAxis( const KdTreeNode& node )
+{
+  const float3 bbmin = make_float3( keyToFloat( node.bbmin[0] ), keyToFloat( node.bbmin[1] ), keyToFloat( node.bbmin[2] ) );
+  const float3 bbmax = make_float3( keyToFloat( node.bbmax[0] ), keyToFloat( node.bbmax[1] ), keyToFloat( node.bbmax[2] ) );
+  return longestDimension( bbmin, bbmax );
+}
+
+static __device__ __inline__ void writeNode( const uint node, const uint photon, const uint axis )
+{
+  PhotonRecord record = compact_photons[photon];
+  setPhotonAxis( record, axis );
+  photon_map[node] = record;
+}
+
+static __device__ __inline__ uint axisFlag( const uint axis )
+{
+  return ( axis == 0 ) ? PPM_X : ( ( axis == 1 ) ? PPM_Y : PPM_Z );
+}
+
+
+// Launched over the photon map. Resets all nodes to PPM_NULL.
+RT_PROGRAM void kdtree_clear()
+{
+  photon_map[launch_index].normal_axis = PPM_NULL;
+  photon_map[launch_index].energy      = 0u;
+}
+
+// Launched over the valid photons. Puts them all into the root segment.
+RT_PROGRAM void kdtree_init()
+{
+  kd_photon_indices[launch_index] = launch_index;
+  kd_photon_nodes[launch_index]   = 0;
+}
+
+// Launched over the nodes of kd_level. Derives the node segment from its parent and resets the counters.
+RT_PROGRAM void kdtree_level()
+{
+  const uint node = ( 1u << kd_level ) - 1u + launch_index;
+
+  uint start = 0;
+  uint end   = kd_valid_photons;
+  if( node > 0 ) {
+    const KdTreeNode& parent = kd_nodes[( node - 1 ) / 2];
+    const uint half = ( parent.end - parent.start ) / 2;
+    if( parent.end <= parent.start ) {
+      start = end = parent.start;
+    } else if( node & 1 ) { // Left child
+      start = parent.start;
+      end   = parent.start + half;
+    } else {
+      start = parent.start + half + 1;
+      end   = parent.end;
+    }
+  }
+
+  KdTreeNode& current = kd_nodes[node];
+  current.start  = start;
+  current.end    = end;
+  current.prefix = 0;
+  current.rank   = ( end - start ) / 2;
+  current.less   = 0;
+  current.left   = 0;
+  current.right  = 0;
+  current.tie    = 0;
+  for( int i = 0; i < 3; ++i ) {
+    current.bbmin[i] = 0xFFFFFFFFu;
+    current.bbmax[i] = 0u;
+  }
+}
+
+// Launched over the valid photons. Reduces the bounds of each node of kd_level.
+RT_PROGRAM void kdtree_bounds()
+{
+  const uint photon = launch_index;
+  const uint node   = kd_photon_nodes[photon];
+  if( node == KD_PHOTON_DONE ) {
+    return;
+  }
+
+  const float3 position = compact_photons[photon].position;
+  KdTreeNode& current = kd_nodes[node];
+  atomicMin( &current.bbmin[0], floatToKey( position.x ) );
+  atomicMin( &current.bbmin[1], floatToKey( position.y ) );
+  atomicMin( &current.bbmin[2], floatToKey( position.z ) );
+  atomicMax( &current.bbmax[0], floatToKey( position.x ) );
+  atomicMax( &current.bbmax[1], floatToKey( position.y ) );
+  atomicMax( &current.bbmax[2], floatToKey( position.z ) );
+}
+
+// Launched over the valid photons. Counts the kd_shift digit of the keys which match the node prefix.
+RT_PROGRAM void kdtree_histogram()
+{
+  const uint photon = launch_index;
+  const uint node   = kd_photon_nodes[photon];
+  if( node == KD_PHOTON_DONE ) {
+    return;
+  }
+
+  const KdTreeNode& current = kd_nodes[node];
+  const uint key  = floatToKey( photonCoordinate( photon, nodeAxis( current ) ) );
+  const uint mask = ( kd_shift == 24 ) ? 0u : ( 0xFFFFFFFFu << ( kd_shift + 8 ) );
+  if( ( ( key ^ current.prefix ) & mask ) == 0 ) {
+    const uint bin = ( node - ( ( 1u << kd_level ) - 1u ) ) * KD_HISTOGRAM_BINS + ( ( key >> kd_shift ) & 0xFFu );
+    atomicAdd( &kd_histogram[bin], 1u );
+  }
+}
+
+// Launched over the nodes of kd_level. Picks the digit containing the median and clears the histogram.
+RT_PROGRAM void kdtree_select()
+{
+  const uint node = ( 1u << kd_level ) - 1u + launch_index;
+  KdTreeNode& current = kd_nodes[node];
+  const uint first = launch_index * KD_HISTOGRAM_BINS;
+
+  if( current.start < current.end ) {
+    uint rank = current.rank;
+    uint less = current.less;
+    uint bin  = 0;
+    for( ; bin < KD_HISTOGRAM_BINS - 1; ++bin ) {
+      const uint count = kd_histogram[first + bin];
+      if( rank < count ) {
+        break;
+      }
+      rank -= count;
+      less += count;
+    }
+    current.prefix |= bin << kd_shift;
+    current.rank    = rank;
+    current.less    = less;
+  }
+
+  for( uint bin = 0; bin < KD_HISTOGRAM_BINS; ++bin ) {
+    kd_histogram[first + bin] = 0;
+  }
+}
+
+// Launched over the valid photons. Scatters the photons of each node around its median.
+// Keys equal to the median are distributed so that exactly half of the segment ends up on the left.
+RT_PROGRAM void kdtree_partition()
+{
+  const uint photon = launch_index;
+  const uint node   = kd_photon_nodes[photon];
+  if( node == KD_PHOTON_DONE ) {
+    return;
+  }
+
+  KdTreeNode& current = kd_nodes[node];
+  const uint axis   = nodeAxis( current );
+  const uint key    = floatToKey( photonCoordinate( photon, axis ) );
+  const uint half   = ( current.end - current.start ) / 2;
+  const uint median = current.start + half;
+
+  int side = 0; // -1 == left, 0 == median, 1 == right
+  if( key < current.prefix ) {
+    side = -1;
+  } else if( current.prefix < key ) {
+    side = 1;
+  } else {
+    const uint tie = atomicAdd( &current.tie, 1u );
+    side = ( tie < current.rank ) ? -1 : ( ( tie == current.rank ) ? 0 : 1 );
+  }
+
+  if( side < 0 ) {
+    kd_photon_indices[current.start + atomicAdd( &current.left, 1u )] = photon;
+    kd_photon_nodes[photon] = 2 * node + 1;
+  } else if( 0 < side ) {
+    kd_photon_indices[median + 1 + atomicAdd( &current.right, 1u )] = photon;
+    kd_photon_nodes[photon] = 2 * node + 2;
+  } else {
+    kd_photon_indices[median] = photon;
+    kd_photon_nodes[photon] = KD_PHOTON_DONE;
+    writeNode( node, photon, ( current.end - current.start == 1 ) ? PPM_LEAF : axisFlag( axis ) );
+  }
+}
+
+
+static __device__ __inline__ void swapPhotons( const int a, const int b )
+{
+  const uint temp = kd_photon_indices[a];
+  kd_photon_indices[a] = kd_photon_indices[b];
+  kd_photon_indices[b] = temp;
+}
+
+// Moves the k-th photon along axis of the inclusive range [left, right] to position k,
+// with smaller or equal photons before and greater or equal photons after it. Same as select() in select.h.
+static __device__ void selectPhoton( int left, int right, const int k, const uint axis )
+{
+  while( left < right ) {
+    swapPhotons( ( left + right ) / 2, right );
+    const float pivot = photonCoordinate( kd_photon_indices[right], axis );
+
+    int i = left - 1;
+    int j = right;
+    for( ;; ) {
+      do {
+        ++i;
+      } while( i < j && photonCoordinate( kd_photon_indices[i], axis ) < pivot );
+      do {
+        --j;
+      } while( i < j && pivot < photonCoordinate( kd_photon_indices[j], axis ) );
+      if( i < j ) {
+        swapPhotons( i, j );
+      } else {
+        break;
+      }
+    }
+    swapPhotons( i, right );
+
+    if( k == i ) {
+      return;
+    } else if( k < i ) {
+      right = i - 1;
+    } else {
+      left = i + 1;
+    }
+  }
+}
+
+// Launched over the nodes of kd_level. Builds the whole subtree below each node.
+RT_PROGRAM void kdtree_subtree()
+{
+  const uint root = ( 1u << kd_level ) - 1u + launch_index;
+
+  uint3 stack[KD_SUBTREE_STACK_SIZE]; // start, end, node
+  int   stack_current = 0;
+  stack[stack_current++] = make_uint3( kd_nodes[root].start, kd_nodes[root].end, root );
+
+  while( 0 < stack_current ) {
+    const uint3 task = stack[--stack_current];
+    if( task.y <= task.x ) {
+      continue; // Stays PPM_NULL.
+    }
+    if( task.y - task.x == 1 ) {
+      writeNode( task.z, kd_photon_indices[task.x], PPM_LEAF );
+      continue;
+    }
+
+    float3 bbmin = make_float3(  1.0e38f );
+    float3 bbmax = make_float3( -1.0e38f );
+    for( uint i = task.x; i < task.y; ++i ) {
+      const float3 position = compact_photons[kd_photon_indices[i]].position;
+      bbmin = fminf( bbmin, position );
+      bbmax = fmaxf( bbmax, position );
+    }
+    const uint axis   = longestDimension( bbmin, bbmax );
+    const uint median = ( task.x + task.y ) / 2;
+
+    selectPhoton( task.x, task.y - 1, median, axis );
+    writeNode( task.z, kd_photon_indices[median], axisFlag( axis ) );
+
+    stack[stack_current++] = make_uint3( median + 1, task.y, 2 * task.z + 2 );
+    stack[stack_current++] = make_uint3( task.x, median, 2 * task.z + 1 );
+  }
+}
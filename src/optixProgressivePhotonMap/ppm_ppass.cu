@@ -30,6 +30,7 @@
 #include <optixu/optixu_math_namespace.h>
 #include "helpers.h"
 #include "ppm.h"
+#include "ppm_grid.h"
 #include "random.h"
 
 using namespace optix;
@@ -45,12 +46,20 @@ rtDeclareVariable(rtObject,      top_object, , );
 // Ray generation program
 //
 rtBuffer<PhotonRecord, 1>        ppass_output_buffer;
-rtBuffer<uint2, 2>               photon_rnd_seeds;
+rtBuffer<uint, 1>                photon_counts;
+rtDeclareVariable(uint,          rnd_frame, , );
 rtDeclareVariable(uint,          max_depth, , );
 rtDeclareVariable(uint,          max_photon_count, , );
 rtDeclareVariable(PPMLight,      light , , );
+rtDeclareVariable(uint,          use_visual_importance, , );
+rtDeclareVariable(uint,          use_qmc_emission, , );
+rtDeclareVariable(float,         rtpass_default_radius2, , );
+rtBuffer<uint, 1>                visible_cells;
+rtBuffer<float, 1>               emission_importance;
+rtBuffer<float2, 1>              emission_cdf;
 
 rtDeclareVariable(uint2, launch_index, rtLaunchIndex, );
+rtDeclareVariable(uint2, launch_dim,   rtLaunchDim, );
 
 
 static __device__ __inline__ float2 rnd_from_uint2( uint2& prev )
@@ -105,10 +114,10 @@ static __device__ __inline__ void sampleUnitHemisphere( const optix::float2& sam
     point = x*U + y*V + z*W;
 }
 
-static __device__ __inline__ void generateAreaLightPhoton( const PPMLight& light, const float2& d_sample, float3& o, float3& d)
+static __device__ __inline__ void generateAreaLightPhoton( const PPMLight& light, const float2& p_sample, const float2& d_sample, float3& o, float3& d)
 {
   // Choose a random position on light
-  o = light.anchor + 0.5f * ( light.v1 + light.v2);
+  o = light.anchor + p_sample.x * light.v1 + p_sample.y * light.v2;
   
   // Choose a random direction from light
   float3 U, V, W;
@@ -135,18 +144,100 @@ static __device__ __inline__ void generateSpotLightPhoton( const PPMLight& light
 }
 
 
+// Halton sequence over all photons of all passes, so the emission stays stratified across the passes
+// and not only over the launch indices of one. Dimensions 0 and 1 drive the direction, 2 and 3 the
+// position on an area light and the QMC_BOUNCE_DIMENSIONS pairs after them the first diffuse bounces.
+static __device__ __inline__ float halton( const uint dimension, uint index )
+{
+  const uint primes[] = { 2u, 3u, 5u, 7u, 11u, 13u, 17u, 19u };
+  if( dimension == 0u ) {
+    return static_cast<float>( __brev( index ) >> 8 ) * ( 1.0f / 16777216.0f );
+  }
+  const uint  base     = primes[dimension];
+  const float inv_base = 1.0f / static_cast<float>( base );
+  float scale  = inv_base;
+  float result = 0.0f;
+  while( index > 0u ) {
+    result += static_cast<float>( index % base ) * scale;
+    index  /= base;
+    scale  *= inv_base;
+  }
+  return fminf( result, 0.99999994f );
+}
+
+static __device__ __inline__ float2 halton2( const uint dimension, const uint index )
+{
+  return make_float2( halton( dimension, index ), halton( dimension + 1u, index ) );
+}
+
+// Binary search for the first cell whose inclusive CDF exceeds u.
+static __device__ __inline__ uint sampleEmissionCell( const float u )
+{
+  uint lo = 0u;
+  uint hi = IMPORTANCE_CELLS - 1u;
+  while( lo < hi ) {
+    const uint mid = ( lo + hi ) >> 1;
+    if( emission_cdf[mid].x > u ) {
+      hi = mid;
+    } else {
+      lo = mid + 1u;
+    }
+  }
+  return lo;
+}
+
+static __device__ __inline__ bool isNearVisibleHitPoint( const float3& position )
+{
+  const float inv_cell_size = 1.0f / gridCellSize( __float_as_uint( rtpass_default_radius2 ) );
+  return visible_cells[gridHash( gridCell( position, inv_cell_size ) )] != 0u;
+}
+
+
 RT_PROGRAM void ppass_camera()
 {
-  size_t2 size     = photon_rnd_seeds.size();
-  uint    pm_index = (launch_index.y * size.x + launch_index.x) * max_photon_count;
-  uint2   seed     = photon_rnd_seeds[launch_index]; // No need to reset since we dont reuse this seed
+  uint2   size     = launch_dim;
+  uint    index    = launch_index.y * size.x + launch_index.x;
+  uint    pm_index = index * max_photon_count;
+  uint2   seed     = make_uint2( tea<16>( index, rnd_frame ), tea<16>( rnd_frame, index ) ); // Fresh per frame, no need to store it
+
+  // The QMC index wraps after 2^32 photons, far beyond any accumulation.
+  const uint qmc_index = rnd_frame * ( size.x * size.y ) + index;
+
+  float2 direction_sample;
+  float2 position_sample;
+  float  weight = 1.0f;
+  uint   cell   = 0u;
+  if( use_visual_importance ) {
+    // Stratified in CDF order, the photon's energy is scaled by uniform / actual density.
+    // With QMC the offset inside the chosen cell's CDF interval places the photon along x.
+    float2 cell_sample;
+    float  u;
+    if( use_qmc_emission ) {
+      u = halton( 0u, qmc_index );
+      cell = sampleEmissionCell( u );
+      const float cdf_lo = ( cell > 0u ) ? emission_cdf[cell - 1u].x : 0.0f;
+      cell_sample = make_float2( fminf( fmaxf( ( u - cdf_lo ) / emission_cdf[cell].y, 0.0f ), 0.99999994f ), halton( 1u, qmc_index ) );
+    } else {
+      u = ( static_cast<float>( index ) + rnd( seed.x ) ) / static_cast<float>( size.x * size.y );
+      cell = sampleEmissionCell( u );
+      cell_sample = make_float2( rnd( seed.x ), rnd( seed.y ) );
+    }
+    weight = 1.0f / ( emission_cdf[cell].y * static_cast<float>( IMPORTANCE_CELLS ) );
+    direction_sample = make_float2(
+        ( static_cast<float>( cell % IMPORTANCE_RESOLUTION ) + cell_sample.x ) / static_cast<float>( IMPORTANCE_RESOLUTION ),
+        ( static_cast<float>( cell / IMPORTANCE_RESOLUTION ) + cell_sample.y ) / static_cast<float>( IMPORTANCE_RESOLUTION ) );
+  } else if( use_qmc_emission ) {
+    direction_sample = halton2( 0u, qmc_index );
+  } else {
+    direction_sample = make_float2(
+        ( static_cast<float>( launch_index.x ) + rnd( seed.x ) ) / static_cast<float>( size.x ),
+        ( static_cast<float>( launch_index.y ) + rnd( seed.y ) ) / static_cast<float>( size.y ) );
+  }
+  position_sample = use_qmc_emission ? halton2( 2u, qmc_index ) : rnd_from_uint2( seed );
 
-  float2 direction_sample = make_float2(
-      ( static_cast<float>( launch_index.x ) + rnd( seed.x ) ) / static_cast<float>( size.x ),
-      ( static_cast<float>( launch_index.y ) + rnd( seed.y ) ) / static_cast<float>( size.y ) );
   float3 ray_origin, ray_direction;
   if( light.is_area_light ) {
-    generateAreaLightPhoton( light, direction_sample, ray_origin, ray_direction );
+    generateAreaLightPhoton( light, position_sample, direction_sample, ray_origin, ray_direction );
   } else {
     generateSpotLightPhoton( light, direction_sample, ray_origin, ray_direction );
   }
@@ -155,17 +246,26 @@ RT_PROGRAM void ppass_camera()
 
   // Initialize our photons
   for(unsigned int i = 0; i < max_photon_count; ++i) {
-    ppass_output_buffer[i+pm_index].energy = make_float3(0.0f);
+    ppass_output_buffer[i+pm_index].energy = 0u;
   }
 
   PhotonPRD prd;
   //  rec.ray_dir = ray_direction; // set in ppass_closest_hit
-  prd.energy = light.power;
+  prd.energy = light.power * weight;
   prd.sample = seed;
   prd.pm_index = pm_index;
   prd.num_deposits = 0;
+  prd.num_useful = 0;
+  prd.qmc_index = qmc_index;
   prd.ray_depth = 0;
   rtTrace( top_object, ray, prd );
+
+  photon_counts[index] = prd.num_deposits;
+
+  // Credited with the uniform emission's weight, so the estimate doesn't feed back on its own distribution.
+  if( use_visual_importance && prd.num_useful > 0 ) {
+    atomicAdd( &emission_importance[cell], static_cast<float>( prd.num_useful ) * weight );
+  }
 }
 
 //
@@ -195,16 +295,21 @@ RT_PROGRAM void ppass_closest_hit()
     if( hit_record.ray_depth > 0 ) {
       PhotonRecord& rec = ppass_output_buffer[hit_record.pm_index + hit_record.num_deposits];
       rec.position = hit_point;
-      rec.normal = ffnormal;
-      rec.ray_dir = ray.direction;
-      rec.energy = hit_record.energy;
+      rec.normal_axis = encodePhotonNormal( ffnormal );
+      rec.energy = encodePhotonEnergy( hit_record.energy );
       hit_record.num_deposits++;
+      if( use_visual_importance && isNearVisibleHitPoint( hit_point ) ) {
+        hit_record.num_useful++;
+      }
     }
 
     hit_record.energy = Kd * hit_record.energy; 
     float3 U, V, W;
     create_onb(ffnormal, U, V, W);
-    sampleUnitHemisphere(rnd_from_uint2(hit_record.sample), U, V, W, new_ray_dir);
+    const float2 bounce_sample = ( use_qmc_emission && hit_record.ray_depth < QMC_BOUNCE_DIMENSIONS )
+                               ? halton2( 4u + 2u * hit_record.ray_depth, hit_record.qmc_index )
+                               : rnd_from_uint2( hit_record.sample );
+    sampleUnitHemisphere(bounce_sample, U, V, W, new_ray_dir);
 
   } else {
     hit_record.energy = Ks * hit_record.energy;
@@ -29,6 +29,7 @@
 #include <optix.h>
 #include <optixu/optixu_math_namespace.h>
 #include "ppm.h"
+#include "random.h"
 
 
 using namespace optix;
@@ -44,24 +45,27 @@ rtDeclareVariable(rtObject,      top_object, , );
 // Ray generation program
 //
 rtBuffer<HitRecord, 2>           rtpass_output_buffer;
-rtBuffer<uint2, 2>               image_rnd_seeds;
+rtBuffer<HitStatistics, 2>       hit_statistics;
 rtDeclareVariable(float,         rtpass_default_radius2, , );
 rtDeclareVariable(float3,        rtpass_eye, , );
 rtDeclareVariable(float3,        rtpass_U, , );
 rtDeclareVariable(float3,        rtpass_V, , );
 rtDeclareVariable(float3,        rtpass_W, , );
+rtDeclareVariable(uint,          rnd_frame, , );
+rtDeclareVariable(uint,          use_sppm, , );
 rtDeclareVariable(uint2,      launch_index, rtLaunchIndex, );
 
 
 RT_PROGRAM void rtpass_camera()
 {
   float2 screen = make_float2( rtpass_output_buffer.size() );
-  /*
-  uint   seed   = image_rnd_seeds[index];                       // If we start writing into this buffer here we will
-  float2 sample = make_float2( rnd(seed.x), rnd(seed.y) );      // need to make it an INPUT_OUTPUT buffer.  For now it
-  image_rnd_seeds[index] = seed;                                // is just INPUT
-  */
   float2 sample = make_float2( 0.5f, 0.5f ); 
+  if( use_sppm ) {
+    // Salted so the jitter doesn't correlate with the photon pass seeds of the same index.
+    uint   index = launch_index.y * static_cast<uint>( screen.x ) + launch_index.x;
+    uint2  seed  = make_uint2( tea<16>( index, rnd_frame ^ 0x2545f491u ), tea<16>( rnd_frame ^ 0x2545f491u, index ) );
+    sample = make_float2( rnd( seed.x ), rnd( seed.y ) );
+  }
 
   float2 d = ( make_float2(launch_index) + sample ) / screen * 2.0f - 1.0f;
   float3 ray_origin = rtpass_eye;
@@ -99,7 +103,7 @@ RT_PROGRAM void rtpass_closest_hit()
   if( fmaxf( emitted ) > 0.0f ) {
     HitRecord& rec = rtpass_output_buffer[ launch_index ];
     rec.attenuated_Kd = emitted*hit_prd.attenuation; 
-    rec.flags = 0u;
+    rec.normal_flags = 0u;
     return;
   }
 
@@ -114,7 +118,6 @@ RT_PROGRAM void rtpass_closest_hit()
     // We hit a diffuse surface; record hit and return
     HitRecord rec;
     rec.position = hit_point; 
-    rec.normal = ffnormal;
     if( !use_grid ) {
       rec.attenuated_Kd = Kd * hit_prd.attenuation;
     } else {
@@ -129,14 +132,18 @@ RT_PROGRAM void rtpass_closest_hit()
       else
         rec.attenuated_Kd = Kd * hit_prd.attenuation;
     }
-    rec.flags = PPM_HIT;
-
-    rec.radius2 = rtpass_default_radius2;
-    rec.photon_count = 0;
-    rec.accum_atten = 0.0f;
-    rec.flux = make_float3(0.0f, 0.0f, 0.0f);
+    rec.normal_flags = encodePhotonNormal( ffnormal ) | PPM_HIT;
+    rec.pad = 0.0f;
     
     rtpass_output_buffer[launch_index] = rec;
+
+    // SPPM keeps its statistics per pixel instead.
+    if( !use_sppm ) {
+      HitStatistics stats;
+      stats.a = make_float4( 0.0f, 0.0f, 0.0f, rtpass_default_radius2 );
+      stats.b = make_float4( 0.0f );
+      hit_statistics[launch_index] = stats;
+    }
   } else {
     // Make reflection ray
     hit_prd.attenuation = hit_prd.attenuation * Ks;
@@ -160,7 +167,7 @@ RT_PROGRAM void rtpass_miss()
   float3 result = make_float3(tex2D(envmap, u, v));
 
   HitRecord& rec = rtpass_output_buffer[launch_index];
-  rec.flags = 0u;
+  rec.normal_flags = 0u;
   rec.attenuated_Kd = hit_prd.attenuation * result;
 }
 
@@ -185,7 +192,7 @@ RT_PROGRAM void rtpass_exception()
 {
   HitRecord& rec = rtpass_output_buffer[launch_index];
 
-  rec.flags = PPM_OVERFLOW;
+  rec.normal_flags = PPM_OVERFLOW;
   rec.attenuated_Kd = rtpass_bad_color;
 }
 
@@ -38,7 +38,16 @@
 // reduce the size of the BVH.  The compromise solution seems fine for a single
 // VOX file (max 256**3 boxes) or a handful of files.  The custom 3d grid
 // intersector could be interesting for very large scenes, e.g., Minecraft
-// files, that might have far more than 256**3 boxes.
+// files, that might have far more than 256**3 boxes; bricks.cu implements one
+// over a sparse brick map.
+//
+// The *_merged programs intersect boxes merged from runs of voxels with the same color, which
+// cuts the primitive count of dense models severalfold.  They store 8 bytes per box.
+//
+// The *_compact intersection programs report only the palette entry and hit face, taken from the slab
+// test itself, and leave the normal and color to closest_hit_radiance_compact() in diffuse.cu.
+// This keeps the palette read and the normal out of hits that are later discarded and uses two
+// attributes instead of three.  The hit points of all programs are offset in the closest hit.
 
 
 #include <optix.h>
@@ -46,25 +55,29 @@
 #include <optixu/optixu_matrix_namespace.h>
 #include <optixu/optixu_aabb_namespace.h>
 
-#include "intersection_refinement.h"
-
 using namespace optix;
 
 // 8-bit indices as in VOX format.  We expand these into floating point coords during intersection.
 rtBuffer< optix::uchar4 > box_buffer;
 
+// Merged boxes ( see merge_voxels() ): inclusive min and max voxel of each box, min.w is the palette index.
+rtBuffer< optix::uchar4 > merged_box_buffer;
+
+// The palettes of all files, palette_offset selects the one of this geometry
 rtBuffer< optix::uchar4 > palette_buffer;
+rtDeclareVariable( unsigned int, palette_offset, , ) = 0u;
 
 rtDeclareVariable( float3, anchor, , ) = {0.0f, 0.0f, 0.0f};
 
 rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
 
-rtDeclareVariable( float3, back_hit_point, attribute back_hit_point, );
-rtDeclareVariable( float3, front_hit_point, attribute front_hit_point, );
 rtDeclareVariable( float3, geometric_normal, attribute geometric_normal, ); 
 rtDeclareVariable( float3, shading_normal, attribute shading_normal, ); 
 rtDeclareVariable( float4, geometry_color, attribute geometry_color, ); 
 
+rtDeclareVariable( unsigned int, voxel_hit, attribute voxel_hit, );   // Palette entry << 3 | axis << 1 | positive face
+rtDeclareVariable( float, voxel_plane, attribute voxel_plane, );      // Coordinate of the face plane along its axis
+
 static __device__ float3 boxnormal(float3 boxmin, float3 boxmax, float t)
 {
     float3 t0 = (boxmin - ray.origin)/ray.direction;
@@ -74,27 +87,13 @@ static __device__ float3 boxnormal(float3 boxmin, float3 boxmax, float t)
     return pos-neg;
 }
 
-// Note: might be more efficient to combine with intersection
-static __device__ float3 boxanchor(float3 boxmin, float3 boxmax, float t)
-{
-    float3 t0 = (boxmin - ray.origin) / ray.direction;
-    if ( t == t0.x || t == t0.y || t == t0.z ) return boxmin;
-    return boxmax;
-}
-
 static __device__ __inline__ float4 make_float4( uchar4 c )
 {
     return make_float4( c.x, c.y, c.z, c.w );
 }
 
-RT_PROGRAM void intersect( int primId )
+static __device__ __inline__ void intersect_box( const float3& boxmin, const float3& boxmax, unsigned char color_index )
 {
-    // Expand cell in unit box
-    const uchar4 b = box_buffer[primId];
-    const float3 inv_box_dims = make_float3( 1.0f / 255.0f );
-    const float3 boxmin = anchor + make_float3( b.x, b.y, b.z ) * inv_box_dims;
-    const float3 boxmax = boxmin + inv_box_dims;
-
     float3 t0 = (boxmin - ray.origin)/ray.direction;
     float3 t1 = (boxmax - ray.origin)/ray.direction;
     float3 near = fminf(t0, t1);
@@ -105,35 +104,84 @@ RT_PROGRAM void intersect( int primId )
     if(tmin <= tmax) {
         bool check_second = true;
         if( rtPotentialIntersection( tmin ) ) {
-            unsigned char color_index = box_buffer[primId].w;
-            geometry_color = make_float4( palette_buffer[ color_index ] ) * ( 1.0f / 255.0f );
+            geometry_color = make_float4( palette_buffer[ palette_offset + color_index ] ) * ( 1.0f / 255.0f );
             shading_normal = geometric_normal = boxnormal( boxmin, boxmax, tmin );
 
-            const float3 anchor = boxanchor( boxmin, boxmax, tmin );
-            refine_and_offset_hitpoint( ray.origin + tmin*ray.direction, ray.direction,
-                    shading_normal, anchor,
-                    back_hit_point, front_hit_point );
-
             if(rtReportIntersection(0))
                 check_second = false;
         } 
         if(check_second) {
             if( rtPotentialIntersection( tmax ) ) {
-                unsigned char color_index = box_buffer[primId].w;
-                geometry_color = make_float4( palette_buffer[ color_index ] ) * ( 1.0f / 255.0f );
+                geometry_color = make_float4( palette_buffer[ palette_offset + color_index ] ) * ( 1.0f / 255.0f );
                 shading_normal = geometric_normal = boxnormal( boxmin, boxmax, tmax );
 
-                const float3 anchor = boxanchor( boxmin, boxmax, tmax );
-                refine_and_offset_hitpoint( ray.origin + tmax*ray.direction, ray.direction,
-                        shading_normal, anchor,
-                        back_hit_point, front_hit_point );
-
                 rtReportIntersection(0);
             }
         }
     }
 }
 
+static __device__ __inline__ int max_axis( const float3& v, float m )
+{
+    return v.x == m ? 0 : ( v.y == m ? 1 : 2 );
+}
+
+static __device__ __inline__ float axis_component( const float3& v, int axis )
+{
+    return axis == 0 ? v.x : ( axis == 1 ? v.y : v.z );
+}
+
+// Reports the face of the slab test result on axis, lower is true for the boxmin face
+static __device__ __inline__ bool report_face( float t, int axis, bool lower, const float3& boxmin, const float3& boxmax, unsigned int entry )
+{
+    if( !rtPotentialIntersection( t ) )
+        return false;
+    voxel_hit = ( entry << 3 ) | ( static_cast< unsigned int >( axis ) << 1 ) | ( lower ? 0u : 1u );
+    voxel_plane = axis_component( lower ? boxmin : boxmax, axis );
+    return rtReportIntersection( 0 );
+}
+
+static __device__ __inline__ void intersect_box_compact( const float3& boxmin, const float3& boxmax, unsigned char color_index )
+{
+    const float3 t0 = (boxmin - ray.origin)/ray.direction;
+    const float3 t1 = (boxmax - ray.origin)/ray.direction;
+    const float3 near = fminf(t0, t1);
+    const float3 far = fmaxf(t0, t1);
+    const float tmin = fmaxf( near );
+    const float tmax = fminf( far );
+    if( tmin > tmax )
+        return;
+
+    // The ray enters through the boxmin face along axes where it moves in the positive direction
+    const unsigned int entry = palette_offset + color_index;
+    const int near_axis = max_axis( near, tmin );
+    if( report_face( tmin, near_axis, axis_component( ray.direction, near_axis ) >= 0.0f, boxmin, boxmax, entry ) )
+        return;
+    const int far_axis = max_axis( far, tmax );
+    report_face( tmax, far_axis, axis_component( ray.direction, far_axis ) < 0.0f, boxmin, boxmax, entry );
+}
+
+RT_PROGRAM void intersect( int primId )
+{
+    // Expand cell in unit box
+    const uchar4 b = box_buffer[primId];
+    const float3 inv_box_dims = make_float3( 1.0f / 255.0f );
+    const float3 boxmin = anchor + make_float3( b.x, b.y, b.z ) * inv_box_dims;
+    const float3 boxmax = boxmin + inv_box_dims;
+
+    intersect_box( boxmin, boxmax, b.w );
+}
+
+RT_PROGRAM void intersect_compact( int primId )
+{
+    const uchar4 b = box_buffer[primId];
+    const float3 inv_box_dims = make_float3( 1.0f / 255.0f );
+    const float3 boxmin = anchor + make_float3( b.x, b.y, b.z ) * inv_box_dims;
+    const float3 boxmax = boxmin + inv_box_dims;
+
+    intersect_box_compact( boxmin, boxmax, b.w );
+}
+
 RT_PROGRAM void bounds (int primId, float result[6])
 {
     const uchar4 b = box_buffer[primId];
@@ -145,3 +193,36 @@ RT_PROGRAM void bounds (int primId, float result[6])
     aabb->set( boxmin, boxmax );
 }
 
+RT_PROGRAM void intersect_merged( int primId )
+{
+    const uchar4 bmin = merged_box_buffer[2*primId];
+    const uchar4 bmax = merged_box_buffer[2*primId+1];
+    const float3 inv_box_dims = make_float3( 1.0f / 255.0f );
+    const float3 boxmin = anchor + make_float3( bmin.x, bmin.y, bmin.z ) * inv_box_dims;
+    const float3 boxmax = anchor + ( make_float3( bmax.x, bmax.y, bmax.z ) + make_float3( 1.0f ) ) * inv_box_dims;
+
+    intersect_box( boxmin, boxmax, bmin.w );
+}
+
+RT_PROGRAM void intersect_merged_compact( int primId )
+{
+    const uchar4 bmin = merged_box_buffer[2*primId];
+    const uchar4 bmax = merged_box_buffer[2*primId+1];
+    const float3 inv_box_dims = make_float3( 1.0f / 255.0f );
+    const float3 boxmin = anchor + make_float3( bmin.x, bmin.y, bmin.z ) * inv_box_dims;
+    const float3 boxmax = anchor + ( make_float3( bmax.x, bmax.y, bmax.z ) + make_float3( 1.0f ) ) * inv_box_dims;
+
+    intersect_box_compact( boxmin, boxmax, bmin.w );
+}
+
+RT_PROGRAM void bounds_merged (int primId, float result[6])
+{
+    const uchar4 bmin = merged_box_buffer[2*primId];
+    const uchar4 bmax = merged_box_buffer[2*primId+1];
+    const float3 inv_box_dims = make_float3( 1.0f / 255.0f );
+    const float3 boxmin = anchor + make_float3( bmin.x, bmin.y, bmin.z ) * inv_box_dims;
+    const float3 boxmax = anchor + ( make_float3( bmax.x, bmax.y, bmax.z ) + make_float3( 1.0f ) ) * inv_box_dims;
+
+    optix::Aabb* aabb = (optix::Aabb*)result;
+    aabb->set( boxmin, boxmax );
+}
@@ -0,0 +1,169 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "brick_stream.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+static const char BRICK_STREAM_MAGIC[4] = { 'V', 'X', 'B', '1' };
+
+static void checkedWrite( const void* data, size_t size, FILE* file, const char* filename )
+{
+    if ( size > 0 && fwrite( data, size, 1, file ) != 1 )
+        throw std::runtime_error( std::string( "Failed to write brick stream: " ) + filename );
+}
+
+// Brick streams can be larger than a long can address on some platforms
+static int seekTo( FILE* file, uint64_t offset )
+{
+#ifdef _WIN32
+    return _fseeki64( file, static_cast< __int64 >( offset ), SEEK_SET );
+#else
+    return fseeko( file, static_cast< off_t >( offset ), SEEK_SET );
+#endif
+}
+
+static void checkedRead( void* data, size_t size, FILE* file )
+{
+    if ( size > 0 && fread( data, size, 1, file ) != 1 )
+        throw std::runtime_error( "Truncated brick stream" );
+}
+
+void write_brick_stream( const char* filename, const std::vector< BrickStreamSource >& sources,
+                         const std::vector< optix::uchar4 >& palettes )
+{
+    FILE* file = fopen( filename, "wb" );
+    if ( !file )
+        throw std::runtime_error( std::string( "Failed to open brick stream for writing: " ) + filename );
+
+    try {
+        const uint32_t num_palettes = static_cast< uint32_t >( palettes.size() / 256 );
+        const uint32_t num_models = static_cast< uint32_t >( sources.size() );
+        checkedWrite( BRICK_STREAM_MAGIC, sizeof( BRICK_STREAM_MAGIC ), file, filename );
+        checkedWrite( &num_palettes, sizeof( num_palettes ), file, filename );
+        checkedWrite( &num_models, sizeof( num_models ), file, filename );
+        checkedWrite( palettes.empty() ? 0 : &palettes[0], 256 * num_palettes * sizeof( optix::uchar4 ), file, filename );
+
+        // The table is written again once the offsets of all levels are known
+        const long table_offset = ftell( file );
+        std::vector< BrickStreamModel > table( sources.size() );
+        checkedWrite( table.empty() ? 0 : &table[0], table.size() * sizeof( BrickStreamModel ), file, filename );
+
+        uint64_t offset = static_cast< uint64_t >( ftell( file ) );
+        for ( size_t i = 0; i < sources.size(); ++i ) {
+            const VoxelModel& model = *sources[i].model;
+            BrickStreamModel& entry = table[i];
+            memset( &entry, 0, sizeof( entry ) );
+            entry.anchor[0] = sources[i].anchor.x;
+            entry.anchor[1] = sources[i].anchor.y;
+            entry.anchor[2] = sources[i].anchor.z;
+            entry.palette = sources[i].palette;
+            entry.boxmin = model.boxmin;
+            entry.boxmax = model.boxmax;
+
+            // Halve the model until it fits in one brick
+            VoxelModel coarse;
+            for ( int level = 0; level < BRICK_STREAM_MAX_LEVELS; ++level ) {
+                VoxelBrickMap map;
+                if ( level == 0 ) {
+                    build_brick_map( model, map );
+                } else {
+                    downsample_voxels( model, level, coarse );
+                    build_brick_map( coarse, map );
+                }
+                BrickStreamLevel& stream_level = entry.levels[level];
+                memcpy( stream_level.dims, map.dims, sizeof( map.dims ) );
+                stream_level.num_bricks = static_cast< int >( map.voxels.size() / ( VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE ) );
+                stream_level.offset = offset;
+                checkedWrite( &map.grid[0], map.grid.size() * sizeof( int ), file, filename );
+                checkedWrite( map.voxels.empty() ? 0 : &map.voxels[0], map.voxels.size(), file, filename );
+                offset += map.grid.size() * sizeof( int ) + map.voxels.size();
+                entry.num_levels = level + 1;
+
+                if ( map.dims[0] == 1 && map.dims[1] == 1 && map.dims[2] == 1 )
+                    break;
+            }
+        }
+
+        seekTo( file, static_cast< uint64_t >( table_offset ) );
+        checkedWrite( table.empty() ? 0 : &table[0], table.size() * sizeof( BrickStreamModel ), file, filename );
+    } catch ( ... ) {
+        fclose( file );
+        throw;
+    }
+    fclose( file );
+}
+
+size_t brick_stream_level_bytes( const BrickStreamLevel& level )
+{
+    return size_t( level.dims[0] ) * level.dims[1] * level.dims[2] * sizeof( int ) +
+           size_t( level.num_bricks ) * VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE;
+}
+
+BrickStreamReader::~BrickStreamReader()
+{
+    if ( m_file )
+        fclose( m_file );
+}
+
+void BrickStreamReader::open( const char* filename )
+{
+    m_file = fopen( filename, "rb" );
+    if ( !m_file )
+        throw std::runtime_error( std::string( "Failed to open brick stream: " ) + filename );
+
+    char magic[4];
+    uint32_t num_palettes = 0;
+    uint32_t num_models = 0;
+    checkedRead( magic, sizeof( magic ), m_file );
+    if ( memcmp( magic, BRICK_STREAM_MAGIC, sizeof( magic ) ) != 0 )
+        throw std::runtime_error( std::string( "Not a brick stream: " ) + filename );
+    checkedRead( &num_palettes, sizeof( num_palettes ), m_file );
+    checkedRead( &num_models, sizeof( num_models ), m_file );
+
+    m_palettes.resize( 256 * size_t( num_palettes ) );
+    checkedRead( m_palettes.empty() ? 0 : &m_palettes[0], m_palettes.size() * sizeof( optix::uchar4 ), m_file );
+    m_models.resize( num_models );
+    checkedRead( m_models.empty() ? 0 : &m_models[0], m_models.size() * sizeof( BrickStreamModel ), m_file );
+}
+
+void BrickStreamReader::read_level( size_t model, int level, VoxelBrickMap& map )
+{
+    const BrickStreamLevel& stream_level = m_models.at( model ).levels[level];
+    memcpy( map.dims, stream_level.dims, sizeof( map.dims ) );
+    map.grid.resize( size_t( map.dims[0] ) * map.dims[1] * map.dims[2] );
+    map.voxels.resize( size_t( stream_level.num_bricks ) * VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE );
+
+    if ( seekTo( m_file, stream_level.offset ) != 0 )
+        throw std::runtime_error( "Failed to seek in brick stream" );
+    checkedRead( &map.grid[0], map.grid.size() * sizeof( int ), m_file );
+    checkedRead( map.voxels.empty() ? 0 : &map.voxels[0], map.voxels.size(), m_file );
+}
@@ -0,0 +1,98 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "read_vox.h"
+
+#include <optixu/optixu_math_namespace.h>
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+// Brick stream files hold a pyramid of brick maps for every model of a scene, written once from the
+// loaded VOX files.  Only the small model table is kept in memory, the brick maps of each level are
+// read back individually when a model comes into range or changes level of detail.
+//
+// The file is a cache for the machine that wrote it: the structs below are stored as they are laid
+// out in memory.
+
+const int BRICK_STREAM_MAX_LEVELS = 8;
+
+struct BrickStreamLevel {
+    int      dims[3];       // Bricks along each axis
+    int      num_bricks;
+    uint64_t offset;        // File offset of the grid ( ints ) followed by the brick voxels
+};
+
+struct BrickStreamModel {
+    float            anchor[3];     // World position of voxel ( 0, 0, 0 )
+    unsigned int     palette;       // Index of the model's palette
+    optix::uchar4    boxmin;        // Voxel bounds at level 0, inclusive
+    optix::uchar4    boxmax;
+    int              num_levels;    // Level k has voxels 2^k times the size of level 0
+    BrickStreamLevel levels[BRICK_STREAM_MAX_LEVELS];
+};
+
+// A model to write, placed at anchor with one of the palettes
+struct BrickStreamSource {
+    const VoxelModel* model;
+    optix::float3     anchor;
+    unsigned int      palette;
+};
+
+// Builds the level pyramid of each model, down to a single brick, and writes it to filename
+void write_brick_stream( const char* filename, const std::vector< BrickStreamSource >& sources,
+                         const std::vector< optix::uchar4 >& palettes );
+
+// Size in bytes of one level once resident
+size_t brick_stream_level_bytes( const BrickStreamLevel& level );
+
+class BrickStreamReader
+{
+public:
+    BrickStreamReader() : m_file( 0 ) {}
+    ~BrickStreamReader();
+
+    // Reads the palettes and the model table
+    void open( const char* filename );
+
+    const std::vector< BrickStreamModel >& models() const   { return m_models; }
+    const std::vector< optix::uchar4 >&    palettes() const { return m_palettes; }
+
+    // Reads one level of a model.  Not thread safe, use from one thread at a time.
+    void read_level( size_t model, int level, VoxelBrickMap& map );
+
+private:
+    BrickStreamReader( const BrickStreamReader& );
+    BrickStreamReader& operator=( const BrickStreamReader& );
+
+    FILE*                           m_file;
+    std::vector< BrickStreamModel > m_models;
+    std::vector< optix::uchar4 >    m_palettes;
+};
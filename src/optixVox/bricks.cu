@@ -0,0 +1,175 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Intersection and bounds programs for a model stored as a sparse brick map ( see build_brick_map() ):
+// a single primitive per model, traversed with a 3D DDA over the top level grid that descends into an
+// inner DDA over the voxels of each non-empty brick.  This trades some intersection speed for
+// memory: one byte per voxel of the occupied bricks, instead of one BVH leaf per voxel.
+
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_aabb_namespace.h>
+
+using namespace optix;
+
+#define BRICK_SIZE 8   // VOXEL_BRICK_SIZE in read_vox.h
+
+rtBuffer< int, 3 >           brick_grid;     // Brick index per top level cell, -1 if empty
+rtBuffer< unsigned char, 1 > brick_voxels;   // BRICK_SIZE^3 palette indices per brick, 0 is empty
+
+rtBuffer< optix::uchar4 > palette_buffer;                  // All palettes, see boxes.cu
+rtDeclareVariable( unsigned int, palette_offset, , ) = 0u;
+
+rtDeclareVariable( float3, anchor, , ) = {0.0f, 0.0f, 0.0f};
+rtDeclareVariable( float,  voxel_scale, , ) = 1.0f;   // Voxel size relative to boxes.cu, 2^level for streamed LODs
+
+rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
+
+rtDeclareVariable( float3, geometric_normal, attribute geometric_normal, ); 
+rtDeclareVariable( float3, shading_normal, attribute shading_normal, ); 
+rtDeclareVariable( float4, geometry_color, attribute geometry_color, ); 
+
+// Voxels are voxel_scale/255 units wide, as in boxes.cu for voxel_scale 1
+static __device__ __inline__ float3 voxel_to_world( const float3& p ) { return anchor + p * ( voxel_scale / 255.0f ); }
+
+static __device__ __inline__ int component( const int3& v, int axis ) { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; }
+
+static __device__ __inline__ int3 floor_clamped( const float3& p, const int3& lo, const int3& hi )
+{
+    return make_int3( min( max( static_cast< int >( floorf( p.x ) ), lo.x ), hi.x ),
+                      min( max( static_cast< int >( floorf( p.y ) ), lo.y ), hi.y ),
+                      min( max( static_cast< int >( floorf( p.z ) ), lo.z ), hi.z ) );
+}
+
+// Ray parameter of the next cell boundary along each axis, for cells of the given size
+static __device__ __inline__ float3 dda_next( const int3& cell, const int3& step, float size, const float3& o, const float3& d )
+{
+    return make_float3(
+        d.x != 0.0f ? ( ( cell.x + ( step.x > 0 ) ) * size - o.x ) / d.x : 1e30f,
+        d.y != 0.0f ? ( ( cell.y + ( step.y > 0 ) ) * size - o.y ) / d.y : 1e30f,
+        d.z != 0.0f ? ( ( cell.z + ( step.z > 0 ) ) * size - o.z ) / d.z : 1e30f );
+}
+
+// Axis of the nearest boundary
+static __device__ __inline__ int dda_axis( const float3& next )
+{
+    return next.x <= next.y && next.x <= next.z ? 0 : ( next.y <= next.z ? 1 : 2 );
+}
+
+// Reports the face of the voxel entered across axis at t.  Returns true if the traversal can stop.
+static __device__ __inline__ bool report_voxel( float t, int axis, const int3& voxel, const int3& step, unsigned char color_index )
+{
+    // Voxels are visited front to back, later ones cannot be closer
+    if( !rtPotentialIntersection( t ) )
+        return true;
+
+    const float s = static_cast< float >( -component( step, axis ) );
+    const float3 normal = make_float3( axis == 0 ? s : 0.0f, axis == 1 ? s : 0.0f, axis == 2 ? s : 0.0f );
+    const uchar4 color = palette_buffer[ palette_offset + color_index ];
+    geometry_color = make_float4( color.x, color.y, color.z, color.w ) * ( 1.0f / 255.0f );
+    shading_normal = geometric_normal = normal;
+
+    return rtReportIntersection( 0 );
+}
+
+// Inner DDA over the voxels of one brick between t and t_exit.  Returns true if the traversal can stop.
+static __device__ bool traverse_brick( int brick, const int3& cell, const float3& o, const float3& d, const int3& step,
+                                       float t, float t_exit, int axis )
+{
+    const int3 lo = make_int3( cell.x * BRICK_SIZE, cell.y * BRICK_SIZE, cell.z * BRICK_SIZE );
+    const int3 hi = make_int3( lo.x + BRICK_SIZE - 1, lo.y + BRICK_SIZE - 1, lo.z + BRICK_SIZE - 1 );
+    int3 voxel = floor_clamped( o + t * d, lo, hi );
+
+    const float3 delta = make_float3( 1.0f / fabsf( d.x ), 1.0f / fabsf( d.y ), 1.0f / fabsf( d.z ) );
+    float3 next = dda_next( voxel, step, 1.0f, o, d );
+    const unsigned int base = static_cast< unsigned int >( brick ) * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+    for( ;; ) {
+        const unsigned int local = ( ( voxel.z - lo.z ) * BRICK_SIZE + voxel.y - lo.y ) * BRICK_SIZE + voxel.x - lo.x;
+        const unsigned char color_index = brick_voxels[ base + local ];
+        if( color_index != 0 && report_voxel( t, axis, voxel, step, color_index ) )
+            return true;
+
+        axis = dda_axis( next );
+        if( axis == 0 )      { t = next.x; next.x += delta.x; voxel.x += step.x; if( voxel.x < lo.x || voxel.x > hi.x ) return false; }
+        else if( axis == 1 ) { t = next.y; next.y += delta.y; voxel.y += step.y; if( voxel.y < lo.y || voxel.y > hi.y ) return false; }
+        else                 { t = next.z; next.z += delta.z; voxel.z += step.z; if( voxel.z < lo.z || voxel.z > hi.z ) return false; }
+        if( t > t_exit )
+            return false;
+    }
+}
+
+RT_PROGRAM void intersect( int )
+{
+    const int3 dims = make_int3( brick_grid.size().x, brick_grid.size().y, brick_grid.size().z );
+    const float3 extent = make_float3( dims.x * BRICK_SIZE, dims.y * BRICK_SIZE, dims.z * BRICK_SIZE );
+
+    // Traverse in voxel units, t stays the world space ray parameter
+    const float3 o = ( ray.origin - anchor ) * ( 255.0f / voxel_scale );
+    const float3 d = ray.direction * ( 255.0f / voxel_scale );
+
+    // Clip the ray to the grid
+    const float3 t0 = ( make_float3( 0.0f ) - o ) / d;
+    const float3 t1 = ( extent - o ) / d;
+    const float3 near = fminf( t0, t1 );
+    const float3 far  = fmaxf( t0, t1 );
+    float t = fmaxf( fmaxf( near ), ray.tmin );
+    const float tmax = fminf( fminf( far ), ray.tmax );
+    if( t > tmax )
+        return;
+    int axis = near.x >= near.y && near.x >= near.z ? 0 : ( near.y >= near.z ? 1 : 2 );
+
+    const int3 step = make_int3( d.x >= 0.0f ? 1 : -1, d.y >= 0.0f ? 1 : -1, d.z >= 0.0f ? 1 : -1 );
+    int3 cell = floor_clamped( ( o + t * d ) * ( 1.0f / BRICK_SIZE ), make_int3( 0 ), make_int3( dims.x - 1, dims.y - 1, dims.z - 1 ) );
+
+    // Top level DDA over the bricks
+    const float3 delta = make_float3( BRICK_SIZE / fabsf( d.x ), BRICK_SIZE / fabsf( d.y ), BRICK_SIZE / fabsf( d.z ) );
+    float3 next = dda_next( cell, step, static_cast< float >( BRICK_SIZE ), o, d );
+    for( ;; ) {
+        const int brick = brick_grid[ make_uint3( cell.x, cell.y, cell.z ) ];
+        const float t_exit = fminf( fminf( next ), tmax );
+        if( brick >= 0 && traverse_brick( brick, cell, o, d, step, t, t_exit, axis ) )
+            return;
+
+        axis = dda_axis( next );
+        if( axis == 0 )      { t = next.x; next.x += delta.x; cell.x += step.x; if( cell.x < 0 || cell.x >= dims.x ) return; }
+        else if( axis == 1 ) { t = next.y; next.y += delta.y; cell.y += step.y; if( cell.y < 0 || cell.y >= dims.y ) return; }
+        else                 { t = next.z; next.z += delta.z; cell.z += step.z; if( cell.z < 0 || cell.z >= dims.z ) return; }
+        if( t > tmax )
+            return;
+    }
+}
+
+RT_PROGRAM void bounds( int, float result[6] )
+{
+    const float3 extent = make_float3( brick_grid.size().x * BRICK_SIZE, brick_grid.size().y * BRICK_SIZE, brick_grid.size().z * BRICK_SIZE );
+
+    optix::Aabb* aabb = (optix::Aabb*)result;
+    aabb->set( voxel_to_world( make_float3( 0.0f ) ), voxel_to_world( extent ) );
+}
@@ -32,14 +32,21 @@
 #include "prd.h"
 #include "random.h"
 #include "commonStructs.h"
+#include "intersection_refinement.h"
+#include "sun_cache.h"
 
 using namespace optix;
 
 rtDeclareVariable( float3, shading_normal, attribute shading_normal, ); 
 rtDeclareVariable( float3, geometric_normal, attribute geometric_normal, );
-rtDeclareVariable( float3, front_hit_point, attribute front_hit_point, );
 rtDeclareVariable( float4, geometry_color, attribute geometry_color, );
 
+// Compact attributes of boxes.cu *_compact programs: palette entry << 3 | face, and the object space
+// coordinate of the face plane
+rtDeclareVariable( unsigned int, voxel_hit, attribute voxel_hit, );
+rtDeclareVariable( float, voxel_plane, attribute voxel_plane, );
+rtDeclareVariable( float, t_hit, rtIntersectionDistance, );
+
 rtDeclareVariable(optix::Ray, ray,   rtCurrentRay, );
 rtDeclareVariable(PerRayData_radiance, prd_radiance, rtPayload, );
 rtDeclareVariable(PerRayData_shadow,   prd_shadow, rtPayload, );
@@ -48,6 +55,7 @@ rtDeclareVariable( float3, Kd, , );
 rtDeclareVariable(rtObject,      top_object, , );
 
 rtBuffer<DirectionalLight> light_buffer;
+rtBuffer< optix::uchar4 > palette_buffer;
 
 RT_PROGRAM void any_hit_shadow()
 {
@@ -58,13 +66,10 @@ RT_PROGRAM void any_hit_shadow()
 // Note: both the hemisphere and direct light sampling below use pure random numbers to avoid any patent issues.
 // Stratified sampling or QMC would improve convergence.  Please keep this in mind when judging noise levels.
 
-RT_PROGRAM void closest_hit_radiance()
+// Diffuse bounce and direct sun sample from the world space hit point fhp, offset to the side of the
+// incoming ray
+static __device__ __inline__ void shade( const float3& ffnormal, const float3& fhp, const float3& color )
 {
-
-    const float3 world_shading_normal   = normalize( rtTransformNormal( RT_OBJECT_TO_WORLD, shading_normal ) );
-    const float3 world_geometric_normal = normalize( rtTransformNormal( RT_OBJECT_TO_WORLD, geometric_normal ) );
-    const float3 ffnormal = faceforward( world_shading_normal, -ray.direction, world_geometric_normal );
-
     const float z1 = rnd( prd_radiance.seed );
     const float z2 = rnd( prd_radiance.seed );
     
@@ -72,12 +77,11 @@ RT_PROGRAM void closest_hit_radiance()
     optix::cosine_sample_hemisphere( z1, z2, w_in );
     const optix::Onb onb( ffnormal );
     onb.inverse_transform( w_in );
-    const float3 fhp = rtTransformPoint( RT_OBJECT_TO_WORLD, front_hit_point );
 
-    prd_radiance.origin = front_hit_point;
+    prd_radiance.origin = fhp;
     prd_radiance.direction = w_in;
     
-    prd_radiance.attenuation *= Kd * make_float3( geometry_color );
+    prd_radiance.attenuation *= Kd * color;
 
     // Add direct light sample weighted by shadow term and 1/probability.
     // The pdf for a directional area light is 1/solid_angle.
@@ -92,15 +96,63 @@ RT_PROGRAM void closest_hit_radiance()
 
     const float NdotL = dot( ffnormal, L);
     if(NdotL > 0.0f) {
-        PerRayData_shadow shadow_prd;
-        shadow_prd.attenuation = make_float3( 1.0f );
-        optix::Ray shadow_ray ( fhp, L, /*shadow ray type*/ 1, 0.0f );
-        rtTrace(top_object, shadow_ray, shadow_prd);
+        // Faces that have collected their sun cache samples skip the shadow ray
+        SunCacheSlot slot;
+        float visibility = -1.0f;
+        if( sun_cache_samples > 0u ) {
+            slot = sun_cache_slot( fhp, ffnormal );
+            sun_cache_lookup( slot, visibility );
+        }
+
+        if( visibility < 0.0f ) {
+            PerRayData_shadow shadow_prd;
+            shadow_prd.attenuation = make_float3( 1.0f );
+            optix::Ray shadow_ray ( fhp, L, /*shadow ray type*/ 1, 0.0f );
+            rtTrace(top_object, shadow_ray, shadow_prd);
+
+            // Shadow rays are blocked or not, see any_hit_shadow()
+            visibility = shadow_prd.attenuation.x;
+            if( sun_cache_samples > 0u )
+                sun_cache_record( slot, visibility > 0.0f );
+        }
 
         const float solid_angle = light.radius*light.radius*M_PIf;
-        prd_radiance.radiance += NdotL * light.color * solid_angle * shadow_prd.attenuation;
+        prd_radiance.radiance += NdotL * light.color * solid_angle * visibility;
     }
-    
+}
 
+RT_PROGRAM void closest_hit_radiance()
+{
+    const float3 world_shading_normal   = normalize( rtTransformNormal( RT_OBJECT_TO_WORLD, shading_normal ) );
+    const float3 world_geometric_normal = normalize( rtTransformNormal( RT_OBJECT_TO_WORLD, geometric_normal ) );
+    const float3 ffnormal = faceforward( world_shading_normal, -ray.direction, world_geometric_normal );
+
+    const float3 fhp = offset_ray( ray.origin + t_hit * ray.direction,
+                                   faceforward( world_geometric_normal, -ray.direction, world_geometric_normal ) );
+
+    shade( ffnormal, fhp, make_float3( geometry_color ) );
+}
+
+// For boxes.cu *_compact programs: the normal, hit point and color are rebuilt here once per path
+// segment instead of for every potential intersection.
+RT_PROGRAM void closest_hit_radiance_compact()
+{
+    const unsigned int axis = ( voxel_hit & 7u ) >> 1;
+    const float3 normal = make_float3( axis == 0 ? 1.0f : 0.0f, axis == 1 ? 1.0f : 0.0f, axis == 2 ? 1.0f : 0.0f ) *
+                          ( voxel_hit & 1u ? 1.0f : -1.0f );
+
+    // Snapping the hit point onto the face plane removes the error of the reconstruction from t_hit
+    float3 hit_point = rtTransformPoint( RT_WORLD_TO_OBJECT, ray.origin + t_hit * ray.direction );
+    if( axis == 0 )      hit_point.x = voxel_plane;
+    else if( axis == 1 ) hit_point.y = voxel_plane;
+    else                 hit_point.z = voxel_plane;
+    const float3 object_direction = rtTransformVector( RT_WORLD_TO_OBJECT, ray.direction );
+    const float3 object_fhp = offset_ray( hit_point, dot( object_direction, normal ) > 0.0f ? -normal : normal );
+
+    const float3 world_normal = normalize( rtTransformNormal( RT_OBJECT_TO_WORLD, normal ) );
+    const float3 ffnormal = faceforward( world_normal, -ray.direction, world_normal );
+
+    const uchar4 c = palette_buffer[ voxel_hit >> 3 ];
+    shade( ffnormal, rtTransformPoint( RT_OBJECT_TO_WORLD, object_fhp ), make_float3( c.x, c.y, c.z ) * ( 1.0f / 255.0f ) );
 }
 
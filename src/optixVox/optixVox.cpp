@@ -45,22 +45,33 @@
 #include <optixu/optixpp_namespace.h>
 #include <optixu/optixu_aabb_namespace.h>
 #include <optixu/optixu_math_stream_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
 
 #include <sutil.h>
 #include "commonStructs.h"
 #include "read_vox.h"
+#include "brick_stream.h"
+#include "cost_heatmap.h"
+#include <BufferUploader.h>
 #include <Camera.h>
 #include <SunSky.h>
+#include <TaskPool.h>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw_gl2.h>
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <stdexcept>
 #include <stdint.h>
+#include <thread>
 
 using namespace optix;
 
@@ -71,6 +82,11 @@ const float PHYSICAL_SUN_RADIUS = 0.004675f;  // from Wikipedia
 const float DEFAULT_SUN_RADIUS = 0.05f;  // Softer default to show off soft shadows
 const float DEFAULT_SUN_THETA = 1.1f;
 const float DEFAULT_SUN_PHI = 300.0f * M_PIf / 180.0f;
+const float STREAM_LOD_DISTANCE = 1.0f;  // Streamed models farther than this drop a level, then every doubling
+const int STREAM_UPLOADS_PER_FRAME = 8;
+const unsigned int SUN_CACHE_ENTRIES = 1u << 22;  // 32 MB, power of two  // Streamed levels uploaded per frame, bounds the hitch when flying
+const double DISPLAY_INTERVAL = 1.0 / 60.0;  // Seconds of accumulation per displayed frame with --display-tonemap
+const double IDLE_WAIT = 0.1;  // Seconds to block for input once converged
 
 //------------------------------------------------------------------------------
 //
@@ -80,6 +96,48 @@ const float DEFAULT_SUN_PHI = 300.0f * M_PIf / 180.0f;
 
 Context      context = 0;
 
+// Stages the voxel, brick and palette buffers through pinned memory, flushed before the acceleration builds
+sutil::BufferUploader* uploader = 0;
+
+// Bake the sky into a lat-long texture instead of evaluating it in the miss program
+bool         bake_sky = false;
+
+// Merge runs of same colored voxels into larger boxes before building the BVH
+bool         merge_boxes = false;
+
+// Share the geometry of repeated models between Transform instances
+bool         use_instancing = false;
+
+// Models with at least this many voxels are stored as a sparse brick map traversed by a DDA instead
+// of one BVH leaf per box, -1 never uses the brick map
+int          brick_map_voxels = -1;
+
+// Shadow rays per voxel face collected by the sun visibility cache before hits reuse it, 0 disables it
+unsigned int sun_cache_samples = 0;
+unsigned int sun_cache_epoch   = 1;
+
+// Report only the palette entry and face from box intersections and rebuild the rest in the closest hit
+bool         compact_hits = false;
+
+// Write the loaded models with their levels of detail to this brick stream file
+std::string  brick_stream_out;
+
+// GPU memory in bytes kept for the brick maps of a streamed scene
+size_t       stream_budget = size_t( 512 ) << 20;
+
+// Stop launching once this many samples per pixel have accumulated, 0 accumulates forever
+unsigned int max_spp = 0;
+
+// Stop launching after this many seconds of accumulation, 0 accumulates forever
+double       time_budget = 0.0;
+
+// Tonemap the accumulation buffer once per displayed frame instead of on every launch
+bool         display_tonemap = false;
+
+// COST_HEATMAP_* mode of the path tracing cycles per pixel, and the cycles shown in red
+int          cost_heatmap = COST_HEATMAP_OFF;
+float        cost_scale = 1.0e6f;
+
 //------------------------------------------------------------------------------
 //
 //  Helper functions
@@ -107,6 +165,8 @@ void destroyContext()
 {
     if( context )
     {
+        delete uploader;
+        uploader = 0;
         context->destroy();
         context = 0;
     }
@@ -118,12 +178,16 @@ void createContext( bool use_pbo )
     // Set up context
     context = Context::create();
     context->setRayTypeCount( 2 );
-    context->setEntryPointCount( 1 );
+    context->setEntryPointCount( 2 );
     context->setStackSize( 600 );
+    uploader = new sutil::BufferUploader( context );
 
     context["max_depth"]->setInt( 2 );
     context["cutoff_color"]->setFloat( 0.2f, 0.2f, 0.2f );
     context["frame"]->setUint( 0u );
+    context["tonemap_output"]->setInt( display_tonemap ? 0 : 1 );
+    context["use_cost_heatmap"]->setInt( cost_heatmap );
+    context["cost_scale"]->setFloat( cost_scale );
     context["scene_epsilon"]->setFloat( 1.e-3f );
 
     Buffer buffer = sutil::createOutputBuffer( context, RT_FORMAT_UNSIGNED_BYTE4, WIDTH, HEIGHT, use_pbo );
@@ -134,13 +198,21 @@ void createContext( bool use_pbo )
             RT_FORMAT_FLOAT4, WIDTH, HEIGHT );
     context["accum_buffer"]->set( accum_buffer );
 
+    // Path tracing cycles per pixel for the cost heatmap
+    context["cost_buffer"]->set( context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL,
+            RT_FORMAT_FLOAT, WIDTH, HEIGHT ) );
+
     // Ray generation program
     std::string ptx_path( ptxPath( "path_trace_camera.cu" ) );
-    Program ray_gen_program = context->createProgramFromPTXFile( ptx_path, "pinhole_camera" );
+    Program ray_gen_program = sutil::createProgramFromPTXFile( context, ptx_path, "pinhole_camera" );
     context->setRayGenerationProgram( 0, ray_gen_program );
 
+    // Tonemap pass, launched once per displayed frame with --display-tonemap
+    Program tonemap_program = sutil::createProgramFromPTXFile( context, ptx_path, "tonemap_accum" );
+    context->setRayGenerationProgram( 1, tonemap_program );
+
     // Exception program
-    Program exception_program = context->createProgramFromPTXFile( ptx_path, "exception" );
+    Program exception_program = sutil::createProgramFromPTXFile( context, ptx_path, "exception" );
     context->setExceptionProgram( 0, exception_program );
     context["bad_color"]->setFloat( 1.0f, 0.0f, 1.0f );
     
@@ -153,11 +225,13 @@ void createLights( sutil::PreethamSunSky& sky, DirectionalLight& sun, Buffer& li
     //
     
     const std::string ptx_path = ptxPath( "sunsky.cu" );
-    context->setMissProgram( 0, context->createProgramFromPTXFile( ptx_path, "miss" ) );
+    context->setMissProgram( 0, sutil::createProgramFromPTXFile( context, ptx_path, "miss" ) );
 
     sky.setSunTheta( DEFAULT_SUN_THETA );  // 0: noon, pi/2: sunset
     sky.setSunPhi( DEFAULT_SUN_PHI );
     sky.setTurbidity( 2.2f );
+    if( bake_sky )
+        sky.setSkyTexture( 512u, 256u );
     sky.setVariables( context );
 
     // Split out sun for direct sampling
@@ -176,14 +250,28 @@ void createLights( sutil::PreethamSunSky& sky, DirectionalLight& sun, Buffer& li
     light_buffer->unmap();
 
     context["light_buffer"]->set( light_buffer );
+
+    // Sun visibility cache, see sun_cache.h.  Zeroed once, the epoch invalidates it afterwards.
+    Buffer sun_cache = context->createBuffer( RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT2, sun_cache_samples > 0 ? SUN_CACHE_ENTRIES : 1u );
+    memset( sun_cache->map(), 0, ( sun_cache_samples > 0 ? SUN_CACHE_ENTRIES : 1u ) * sizeof( optix::uint2 ) );
+    sun_cache->unmap();
+    context["sun_cache_buffer" ]->set( sun_cache );
+    context["sun_cache_samples"]->setUint( sun_cache_samples );
+    context["sun_cache_epoch"  ]->setUint( sun_cache_epoch );
 }
 
+// Called when the sun or the geometry changes
+void invalidateSunCache()
+{
+    context["sun_cache_epoch"]->setUint( ++sun_cache_epoch );
+}
 
-Material createDiffuseMaterial()
+
+Material createDiffuseMaterial( const std::string& closest_hit = "closest_hit_radiance" )
 {
     const std::string ptx_path = ptxPath( "diffuse.cu" );
-    Program ch_program = context->createProgramFromPTXFile( ptx_path, "closest_hit_radiance" );
-    Program ah_program = context->createProgramFromPTXFile( ptx_path, "any_hit_shadow" );
+    Program ch_program = sutil::createProgramFromPTXFile( context, ptx_path, closest_hit );
+    Program ah_program = sutil::createProgramFromPTXFile( context, ptx_path, "any_hit_shadow" );
 
     Material material = context->createMaterial();
     material->setClosestHitProgram( 0, ch_program );
@@ -200,17 +288,165 @@ inline int idivCeil( int x, int y )
     return (x + y-1)/y;                                                            
 }
 
+
+// Programs shared by all box geometries, created on first use.  Creating them per model re-reads and
+// re-parses the PTX, and every program object adds to the OptiX compile.  The per model data is bound
+// on the Geometry.
+struct ProgramCache
+{
+    std::map<std::string, Program> programs;
+
+    Program get( const std::string& cuda_file, const std::string& name )
+    {
+        Program& program = programs[cuda_file + "::" + name];
+        if ( !program )
+            program = sutil::createProgramFromPTXFile( context, ptxPath( cuda_file ), name );
+        return program;
+    }
+};
+
+
+// One parsed VOX file
+struct VoxFile
+{
+    std::vector< VoxelModel > models;
+    optix::uchar4             palette[256];
+    std::string               error;   // Non-empty if the file could not be read
+};
+
+// Parses the files as one task each on the shared sutil::TaskPool, so large files are balanced by stealing.
+// Host only, the OptiX objects are created afterwards on the main thread.
+static void readVoxFiles( const std::vector<std::string>& filenames, std::vector< VoxFile >& files )
+{
+    files.resize( filenames.size() );
+    sutil::parallelFor( size_t( 0 ), filenames.size(), [&]( size_t i ) {
+        try {
+            read_vox( filenames[i].c_str(), files[i].models, files[i].palette );
+        } catch ( const std::exception& e ) {
+            files[i].error = e.what();
+        }
+    } );
+}
+
+// Binds new grid and voxel buffers for a brick map to a bricks.cu geometry
+static void setBrickMapBuffers( Geometry geometry, const VoxelBrickMap& map )
+{
+    Buffer grid_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_INT, map.dims[0], map.dims[1], map.dims[2] );
+    uploader->upload( grid_buffer, &map.grid[0], map.grid.size() * sizeof( int ) );
+    const size_t num_brick_voxels = std::max( map.voxels.size(), size_t( 1 ) );
+    Buffer voxel_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE, num_brick_voxels );
+    if ( !map.voxels.empty() )
+        uploader->upload( voxel_buffer, &map.voxels[0], map.voxels.size() );
+    else
+        memset( uploader->stage( voxel_buffer, 1 ), 0, 1 );
+    geometry["brick_grid"  ]->set( grid_buffer );
+    geometry["brick_voxels"]->set( voxel_buffer );
+}
+
+static bool useBrickMap( const VoxelModel& model )
+{
+    return brick_map_voxels >= 0 && model.voxels.size() >= size_t( brick_map_voxels );
+}
+
+// Creates the geometry of one model as per voxel boxes, merged boxes or a brick map
+static Geometry createModelGeometry( const VoxelModel& model, const std::string& filename, ProgramCache& box_programs )
+{
+    Geometry box_geometry = context->createGeometry();
+    if ( useBrickMap( model ) ) {
+        VoxelBrickMap map;
+        build_brick_map( model, map );
+        box_geometry->setPrimitiveCount( 1u );
+        box_geometry->setBoundingBoxProgram( box_programs.get( "bricks.cu", "bounds" ) );
+        box_geometry->setIntersectionProgram( box_programs.get( "bricks.cu", "intersect" ) );
+        setBrickMapBuffers( box_geometry, map );
+        std::cerr << filename << ": " << model.voxels.size() << " voxels in "
+                  << map.voxels.size() / ( VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE ) << " bricks" << std::endl;
+    } else if ( merge_boxes ) {
+        std::vector< VoxelBox > boxes;
+        merge_voxels( model, boxes );
+        const unsigned int num_boxes = (unsigned int)( boxes.size() );
+        box_geometry->setPrimitiveCount( num_boxes );
+        box_geometry->setBoundingBoxProgram( box_programs.get( "boxes.cu", "bounds_merged" ) );
+        box_geometry->setIntersectionProgram( box_programs.get( "boxes.cu", compact_hits ? "intersect_merged_compact" : "intersect_merged" ) );
+
+        Buffer box_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4, 2*num_boxes );
+        if ( num_boxes > 0 ) {
+            optix::uchar4* box_data = static_cast<optix::uchar4*>( uploader->stage( box_buffer, 2 * num_boxes * sizeof( optix::uchar4 ) ) );
+            for ( unsigned int k = 0; k < num_boxes; ++k ) {
+                box_data[2*k]   = boxes[k].min;
+                box_data[2*k+1] = boxes[k].max;
+            }
+        }
+        box_geometry["merged_box_buffer"]->set( box_buffer );
+        std::cerr << filename << ": merged " << model.voxels.size() << " voxels into " << num_boxes << " boxes" << std::endl;
+    } else {
+        const unsigned int num_boxes = (unsigned int)( model.voxels.size() );
+        box_geometry->setPrimitiveCount( num_boxes );
+        box_geometry->setBoundingBoxProgram( box_programs.get( "boxes.cu", "bounds" ) );
+        box_geometry->setIntersectionProgram( box_programs.get( "boxes.cu", compact_hits ? "intersect_compact" : "intersect" ) );
+
+        Buffer box_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4, num_boxes );
+        if ( num_boxes > 0 )
+            uploader->upload( box_buffer, &model.voxels[0], num_boxes * sizeof( optix::uchar4 ) );
+        box_geometry["box_buffer"]->set( box_buffer );
+    }
+
+    return box_geometry;
+}
+
+
+// A model shared by all of its repeats in the scene
+struct SharedModel
+{
+    const VoxelModel*    model;
+    const optix::uchar4* palette;
+    GeometryGroup        group;
+};
+
+// FNV-1a over the dimensions and voxels of a model
+static uint64_t hashVoxelModel( const VoxelModel& model )
+{
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = reinterpret_cast< const unsigned char* >( model.dims );
+    for ( size_t i = 0; i < sizeof( model.dims ); ++i )
+        hash = ( hash ^ bytes[i] ) * 1099511628211ull;
+    bytes = model.voxels.empty() ? 0 : reinterpret_cast< const unsigned char* >( &model.voxels[0] );
+    for ( size_t i = 0; i < model.voxels.size() * sizeof( optix::uchar4 ); ++i )
+        hash = ( hash ^ bytes[i] ) * 1099511628211ull;
+    return hash;
+}
+
+static bool sameVoxels( const VoxelModel& a, const VoxelModel& b )
+{
+    return memcmp( a.dims, b.dims, sizeof( a.dims ) ) == 0 && a.voxels.size() == b.voxels.size() &&
+           ( a.voxels.empty() || memcmp( &a.voxels[0], &b.voxels[0], a.voxels.size() * sizeof( optix::uchar4 ) ) == 0 );
+}
+
+
 optix::Aabb createGeometry(
         const std::vector<std::string>& filenames,
         const Material diffuse_material
         )
 {
     
-    const std::string ptx_path = ptxPath( "boxes.cu" );
+    ProgramCache box_programs;
+
+    // Boxes with compact hits need the matching closest hit, brick maps and the ground plane do not
+    const Material compact_material = compact_hits ? createDiffuseMaterial( "closest_hit_radiance_compact" ) : diffuse_material;
 
     GeometryGroup geometry_group = context->createGeometryGroup();
     geometry_group->setAcceleration( context->createAcceleration( "Trbvh" ) );
 
+    // Instancing: one GeometryGroup per unique model, placed by the Transforms under instance_group.
+    // The ground plane and any non-instanced geometry stay in geometry_group.
+    Group instance_group;
+    std::map< uint64_t, std::vector< SharedModel > > shared_models;
+    size_t num_instances = 0;
+    if ( use_instancing ) {
+        instance_group = context->createGroup();
+        instance_group->setAcceleration( context->createAcceleration( "Trbvh" ) );
+    }
+
     optix::Aabb aabb;  // for entire scene
 
     // If there are multiple files, arrange them in a grid
@@ -220,67 +456,86 @@ optix::Aabb createGeometry(
     float3 anchor = make_float3( 0.0f );
     optix::Aabb row_aabb;
 
+    std::vector< VoxFile > files;
+    readVoxFiles( filenames, files );
+    std::vector< BrickStreamSource > stream_sources;
+
+    // The palettes of all files in one buffer, each geometry selects its own with palette_offset
+    {
+        Buffer palette_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4, 256 * std::max( files.size(), size_t( 1 ) ) );
+        for ( size_t i = 0; i < files.size(); ++i )
+            uploader->upload( palette_buffer, files[i].palette, 256 * sizeof( optix::uchar4 ), 256 * i * sizeof( optix::uchar4 ) );
+        context["palette_buffer"]->set( palette_buffer );
+    }
+
     for (size_t fileindex = 0; fileindex < filenames.size(); ++fileindex ) {
         const std::string& filename = filenames[fileindex];
-        std::vector< VoxelModel > models;
-        optix::uchar4 palette[256];
-        try {
-            read_vox( filename.c_str(), models, palette );
-        } catch ( const std::exception& e ) {
+        const std::vector< VoxelModel >& models = files[fileindex].models;
+        if ( !files[fileindex].error.empty() ) {
             std::cerr << "Caught exception while reading voxel model: " << filename << std::endl;
-            std::cerr << e.what() << std::endl;
+            std::cerr << files[fileindex].error << std::endl;
             exit(1);
         }
 
-        // Set palette buffer on global context, since it is the same for all models
-        {
-            Buffer palette_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4, 256 );
-            optix::uchar4* data = static_cast<optix::uchar4*>( palette_buffer->map() );
-            for (int i = 0; i < 256; ++i) {
-                data[i] = palette[i];    
-            }
-            palette_buffer->unmap();
-            context["palette_buffer"]->set( palette_buffer );
-        }
-        
+        const unsigned int palette_offset = static_cast<unsigned int>( fileindex ) * 256u;
+        const optix::uchar4* palette = files[fileindex].palette;
+
         Aabb geometry_aabb;
         for ( size_t i = 0; i < models.size(); ++i ) {
             const VoxelModel& model = models[i];
 
-            Geometry box_geometry = context->createGeometry();
-            const unsigned int num_boxes = (unsigned int)( model.voxels.size() );
-            box_geometry->setPrimitiveCount( num_boxes );
-            box_geometry->setBoundingBoxProgram( context->createProgramFromPTXFile( ptx_path, "bounds" ) );
-            box_geometry->setIntersectionProgram( context->createProgramFromPTXFile( ptx_path, "intersect" ) );
-
-            Buffer box_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4, num_boxes );
-            optix::uchar4* box_data = static_cast<optix::uchar4*>( box_buffer->map());
-            for ( unsigned int k = 0; k < num_boxes; ++k ) {
-                box_data[k] = model.voxels[k];
+            Geometry box_geometry;
+            GeometryGroup* shared_group = 0;
+            const Material& model_material = compact_hits && !useBrickMap( model ) ? compact_material : diffuse_material;
+            if ( use_instancing ) {
+                // Repeats of a model share its geometry and acceleration, only the transform differs
+                std::vector< SharedModel >& candidates = shared_models[hashVoxelModel( model )];
+                for ( size_t k = 0; k < candidates.size() && !shared_group; ++k )
+                    if ( sameVoxels( *candidates[k].model, model ) &&
+                         memcmp( candidates[k].palette, palette, 256 * sizeof( optix::uchar4 ) ) == 0 )
+                        shared_group = &candidates[k].group;
+                if ( !shared_group ) {
+                    SharedModel shared;
+                    shared.model = &model;
+                    shared.palette = palette;
+                    shared.group = context->createGeometryGroup();
+                    shared.group->setAcceleration( context->createAcceleration( "Trbvh" ) );
+                    box_geometry = createModelGeometry( model, filename, box_programs );
+                    box_geometry["anchor"]->setFloat( make_float3( 0.0f ) );
+                    box_geometry["palette_offset"]->setUint( palette_offset );
+                    shared.group->addChild( context->createGeometryInstance( box_geometry, &model_material, &model_material + 1 ) );
+                    candidates.push_back( shared );
+                    shared_group = &candidates.back().group;
+                }
+
+                Transform transform = context->createTransform();
+                transform->setMatrix( false, Matrix4x4::translate( anchor ).getData(), 0 );
+                transform->setChild( *shared_group );
+                instance_group->addChild( transform );
+                ++num_instances;
+            } else {
+                box_geometry = createModelGeometry( model, filename, box_programs );
+                box_geometry["anchor"]->setFloat( anchor );
+                box_geometry["palette_offset"]->setUint( palette_offset );
             }
-            box_buffer->unmap();
-            box_geometry["box_buffer"]->set( box_buffer );
-            
-            box_geometry["anchor"]->setFloat( anchor );
-
-            // Compute tight bounds
-            optix::uchar4 boxmin = make_uchar4( 255, 255, 255, 255 );
-            optix::uchar4 boxmax = make_uchar4( 0, 0, 0, 0 );
-            for ( unsigned int k = 0; k < num_boxes; ++k ) {
-                boxmin.x = std::min(boxmin.x, model.voxels[k].x);
-                boxmin.y = std::min(boxmin.y, model.voxels[k].y);
-                boxmin.z = std::min(boxmin.z, model.voxels[k].z);
-                boxmax.x = std::max(boxmax.x, model.voxels[k].x);
-                boxmax.y = std::max(boxmax.y, model.voxels[k].y);
-                boxmax.z = std::max(boxmax.z, model.voxels[k].z);
+
+            if ( !brick_stream_out.empty() ) {
+                BrickStreamSource source = { &model, anchor, static_cast<unsigned int>( fileindex ) };
+                stream_sources.push_back( source );
             }
+
+            // Tight bounds, computed while reading
+            const optix::uchar4 boxmin = model.boxmin;
+            const optix::uchar4 boxmax = model.boxmax;
             geometry_aabb.include( 
                 anchor + make_float3( boxmin.x, boxmin.y, boxmin.z ) / make_float3( 255.0f, 255.0f, 255.0f ),
                 anchor + make_float3( boxmax.x, boxmax.y, boxmax.z ) / make_float3( 255.0f, 255.0f, 255.0f )
                 );
 
-            GeometryInstance instance = context->createGeometryInstance( box_geometry, &diffuse_material, &diffuse_material + 1 );
-            geometry_group->addChild( instance );
+            if ( !use_instancing ) {
+                GeometryInstance instance = context->createGeometryInstance( box_geometry, &model_material, &model_material + 1 );
+                geometry_group->addChild( instance );
+            }
         }
 
         row_aabb.include( geometry_aabb );
@@ -294,6 +549,14 @@ optix::Aabb createGeometry(
         }
     }
 
+    if ( !brick_stream_out.empty() ) {
+        std::vector< optix::uchar4 > palettes( 256 * files.size() );
+        for ( size_t i = 0; i < files.size(); ++i )
+            memcpy( &palettes[256 * i], files[i].palette, 256 * sizeof( optix::uchar4 ) );
+        write_brick_stream( brick_stream_out.c_str(), stream_sources, palettes );
+        std::cerr << "Wrote " << stream_sources.size() << " models to brick stream " << brick_stream_out << std::endl;
+    }
+
     {
         // Ground plane
         const std::string ground_ptx = ptxPath( "parallelogram_iterative.cu" );
@@ -301,13 +564,377 @@ optix::Aabb createGeometry(
         geometry_group->addChild( instance );
     }
 
-    context[ "top_object"   ]->set( geometry_group ); 
+    if ( use_instancing ) {
+        size_t num_unique = 0;
+        for ( std::map< uint64_t, std::vector< SharedModel > >::const_iterator it = shared_models.begin(); it != shared_models.end(); ++it )
+            num_unique += it->second.size();
+        std::cerr << "Instanced " << num_instances << " models from " << num_unique << " unique ones" << std::endl;
 
+        instance_group->addChild( geometry_group );
+        context[ "top_object"   ]->set( instance_group ); 
+    } else {
+        context[ "top_object"   ]->set( geometry_group ); 
+    }
+
+    uploader->flush();
     return aabb;
 }
 
 
 
+//------------------------------------------------------------------------------
+//
+//  Brick streaming
+//
+//------------------------------------------------------------------------------
+
+// Keeps the models of a brick stream resident around the camera.  Every model is one bricks.cu
+// geometry whose level of detail follows its distance to the eye, within stream_budget bytes.  A
+// loader thread reads levels from disk, the main thread uploads them and detaches models that no
+// longer fit.
+class BrickStreamer
+{
+public:
+    explicit BrickStreamer( const char* filename );
+    ~BrickStreamer();
+
+    // Creates the top level GeometryGroup with one detached instance per model and the ground plane
+    optix::Aabb createGeometry( const Material diffuse_material );
+
+    // Uploads finished levels and requests the ones wanted for eye.  Returns true if the scene changed.
+    bool update( const float3& eye );
+
+    // Blocks until every level wanted for eye is resident
+    void loadAll( const float3& eye );
+
+    size_t residentBytes() const { return m_resident_bytes; }
+
+private:
+    struct Entry {
+        Geometry         geometry;
+        GeometryInstance instance;
+        optix::Aabb      aabb;
+        int              level;     // Resident level, -1 if detached
+    };
+
+    struct Loaded {
+        size_t        model;
+        int           level;
+        VoxelBrickMap map;
+    };
+
+    void chooseLevels( const float3& eye );
+    void setLevel( size_t model, int level, const VoxelBrickMap* map );
+    void loaderThread();
+
+    BrickStreamReader       m_reader;
+    std::vector< Entry >    m_entries;
+    std::vector< int >      m_wanted;          // Level per model for the last eye, -1 to detach
+    std::vector< size_t >   m_order;           // Models sorted by distance to the last eye
+    GeometryGroup           m_group;
+    Buffer                  m_empty_grid;      // Bound to detached models
+    Buffer                  m_empty_voxels;
+    size_t                  m_resident_bytes;
+
+    // Shared with the loader thread
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::deque< std::pair< size_t, int > > m_requests;
+    std::deque< Loaded >    m_loaded;
+    bool                    m_quit;
+    std::thread             m_loader;
+};
+
+BrickStreamer::BrickStreamer( const char* filename )
+    : m_resident_bytes( 0 ),
+      m_quit( false )
+{
+    m_reader.open( filename );
+    m_loader = std::thread( &BrickStreamer::loaderThread, this );
+}
+
+BrickStreamer::~BrickStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_quit = true;
+    }
+    m_wake.notify_one();
+    m_loader.join();
+}
+
+optix::Aabb BrickStreamer::createGeometry( const Material diffuse_material )
+{
+    const std::vector< BrickStreamModel >& models = m_reader.models();
+    const std::vector< optix::uchar4 >& palettes = m_reader.palettes();
+
+    Buffer palette_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4, std::max( palettes.size(), size_t( 256 ) ) );
+    optix::uchar4* palette_data = static_cast<optix::uchar4*>( palette_buffer->map() );
+    memset( palette_data, 0, 256 * sizeof( optix::uchar4 ) );
+    if ( !palettes.empty() )
+        memcpy( palette_data, &palettes[0], palettes.size() * sizeof( optix::uchar4 ) );
+    palette_buffer->unmap();
+    context["palette_buffer"]->set( palette_buffer );
+
+    m_empty_grid = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_INT, 1, 1, 1 );
+    *static_cast<int*>( m_empty_grid->map() ) = -1;
+    m_empty_grid->unmap();
+    m_empty_voxels = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE, 1 );
+    memset( m_empty_voxels->map(), 0, 1 );
+    m_empty_voxels->unmap();
+
+    m_group = context->createGeometryGroup();
+    m_group->setAcceleration( context->createAcceleration( "Trbvh" ) );
+
+    ProgramCache box_programs;
+    optix::Aabb aabb;
+    m_entries.resize( models.size() );
+    m_wanted.assign( models.size(), -1 );
+    for ( size_t i = 0; i < models.size(); ++i ) {
+        const BrickStreamModel& model = models[i];
+        const float3 anchor = make_float3( model.anchor[0], model.anchor[1], model.anchor[2] );
+
+        Entry& entry = m_entries[i];
+        entry.geometry = context->createGeometry();
+        entry.geometry->setPrimitiveCount( 1u );
+        entry.geometry->setBoundingBoxProgram( box_programs.get( "bricks.cu", "bounds" ) );
+        entry.geometry->setIntersectionProgram( box_programs.get( "bricks.cu", "intersect" ) );
+        entry.geometry["brick_grid"    ]->set( m_empty_grid );
+        entry.geometry["brick_voxels"  ]->set( m_empty_voxels );
+        entry.geometry["anchor"        ]->setFloat( anchor );
+        entry.geometry["voxel_scale"   ]->setFloat( 1.0f );
+        entry.geometry["palette_offset"]->setUint( 256u * model.palette );
+        entry.instance = context->createGeometryInstance( entry.geometry, &diffuse_material, &diffuse_material + 1 );
+        entry.level = -1;
+
+        entry.aabb.set(
+            anchor + make_float3( model.boxmin.x, model.boxmin.y, model.boxmin.z ) / make_float3( 255.0f, 255.0f, 255.0f ),
+            anchor + make_float3( model.boxmax.x, model.boxmax.y, model.boxmax.z ) / make_float3( 255.0f, 255.0f, 255.0f )
+            );
+        aabb.include( entry.aabb );
+    }
+    std::cerr << "Streaming " << models.size() << " models within " << ( stream_budget >> 20 ) << " MB" << std::endl;
+
+    {
+        // Ground plane, always resident
+        const std::string ground_ptx = ptxPath( "parallelogram_iterative.cu" );
+        GeometryInstance instance = sutil::createOptiXGroundPlane( context, ground_ptx, aabb, diffuse_material, 2.0f );
+        m_group->addChild( instance );
+    }
+
+    context[ "top_object" ]->set( m_group );
+
+    return aabb;
+}
+
+// Levels for eye: every model first gets its coarsest level, nearest first, while the budget lasts.
+// The rest of the budget then refines the nearest models towards the level their distance asks for.
+void BrickStreamer::chooseLevels( const float3& eye )
+{
+    const std::vector< BrickStreamModel >& models = m_reader.models();
+
+    std::vector< std::pair< float, size_t > > by_distance( models.size() );
+    for ( size_t i = 0; i < models.size(); ++i ) {
+        const optix::Aabb& aabb = m_entries[i].aabb;
+        const float3 nearest = fminf( fmaxf( eye, aabb.m_min ), aabb.m_max );
+        by_distance[i] = std::make_pair( length( nearest - eye ), i );
+    }
+    std::sort( by_distance.begin(), by_distance.end() );
+    m_order.resize( models.size() );
+    for ( size_t k = 0; k < by_distance.size(); ++k )
+        m_order[k] = by_distance[k].second;
+
+    size_t budget = stream_budget;
+    for ( size_t k = 0; k < by_distance.size(); ++k ) {
+        const size_t i = by_distance[k].second;
+        const BrickStreamModel& model = models[i];
+        const size_t bytes = model.num_levels > 0 ? brick_stream_level_bytes( model.levels[model.num_levels - 1] ) : 0;
+        if ( model.num_levels > 0 && bytes <= budget ) {
+            m_wanted[i] = model.num_levels - 1;
+            budget -= bytes;
+        } else {
+            m_wanted[i] = -1;
+        }
+    }
+
+    for ( size_t k = 0; k < by_distance.size(); ++k ) {
+        const size_t i = by_distance[k].second;
+        if ( m_wanted[i] < 0 )
+            continue;
+
+        const BrickStreamModel& model = models[i];
+        int target = 0;
+        while ( target < model.num_levels - 1 && by_distance[k].first > STREAM_LOD_DISTANCE * float( 1 << target ) )
+            ++target;
+        while ( m_wanted[i] > target ) {
+            const size_t extra = brick_stream_level_bytes( model.levels[m_wanted[i] - 1] ) - brick_stream_level_bytes( model.levels[m_wanted[i]] );
+            if ( extra > budget )
+                break;
+            budget -= extra;
+            --m_wanted[i];
+        }
+    }
+}
+
+// Replaces the resident level of a model, map is null to detach it
+void BrickStreamer::setLevel( size_t model, int level, const VoxelBrickMap* map )
+{
+    Entry& entry = m_entries[model];
+    if ( entry.level >= 0 ) {
+        m_resident_bytes -= brick_stream_level_bytes( m_reader.models()[model].levels[entry.level] );
+        entry.geometry["brick_grid"  ]->getBuffer()->destroy();
+        entry.geometry["brick_voxels"]->getBuffer()->destroy();
+    }
+
+    if ( map ) {
+        setBrickMapBuffers( entry.geometry, *map );
+        entry.geometry["voxel_scale"]->setFloat( float( 1 << level ) );
+        m_resident_bytes += brick_stream_level_bytes( m_reader.models()[model].levels[level] );
+        if ( entry.level < 0 )
+            m_group->addChild( entry.instance );
+        entry.level = level;
+    } else {
+        entry.geometry["brick_grid"  ]->set( m_empty_grid );
+        entry.geometry["brick_voxels"]->set( m_empty_voxels );
+        if ( entry.level >= 0 )
+            m_group->removeChild( entry.instance );
+        entry.level = -1;
+    }
+}
+
+bool BrickStreamer::update( const float3& eye )
+{
+    chooseLevels( eye );
+    bool changed = false;
+
+    // Detach first, which frees budget for the uploads below
+    for ( size_t i = 0; i < m_entries.size(); ++i ) {
+        if ( m_wanted[i] < 0 && m_entries[i].level >= 0 ) {
+            setLevel( i, -1, 0 );
+            changed = true;
+        }
+    }
+
+    std::deque< Loaded > loaded;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        for ( int k = 0; k < STREAM_UPLOADS_PER_FRAME && !m_loaded.empty(); ++k ) {
+            loaded.push_back( Loaded() );
+            std::swap( loaded.back(), m_loaded.front() );
+            m_loaded.pop_front();
+        }
+
+        // Replaces the requests of the previous eye, nearest models first
+        m_requests.clear();
+        for ( size_t k = 0; k < m_order.size(); ++k ) {
+            const size_t i = m_order[k];
+            if ( m_wanted[i] >= 0 && m_wanted[i] != m_entries[i].level )
+                m_requests.push_back( std::make_pair( i, m_wanted[i] ) );
+        }
+    }
+    m_wake.notify_one();
+
+    for ( size_t k = 0; k < loaded.size(); ++k ) {
+        // Levels the camera moved away from while they were loading are dropped
+        if ( loaded[k].level != m_wanted[loaded[k].model] || loaded[k].level == m_entries[loaded[k].model].level )
+            continue;
+        setLevel( loaded[k].model, loaded[k].level, &loaded[k].map );
+        changed = true;
+    }
+
+    if ( changed ) {
+        uploader->flush();
+        m_group->getAcceleration()->markDirty();
+    }
+    return changed;
+}
+
+void BrickStreamer::loadAll( const float3& eye )
+{
+    for ( ;; ) {
+        update( eye );
+        bool done = true;
+        for ( size_t i = 0; i < m_entries.size() && done; ++i )
+            done = m_wanted[i] == m_entries[i].level;
+        if ( done )
+            return;
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+}
+
+void BrickStreamer::loaderThread()
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    for ( ;; ) {
+        m_wake.wait( lock, [this]() { return m_quit || !m_requests.empty(); } );
+        if ( m_quit )
+            return;
+
+        const std::pair< size_t, int > request = m_requests.front();
+        m_requests.pop_front();
+        lock.unlock();
+
+        Loaded loaded;
+        loaded.model = request.first;
+        loaded.level = request.second;
+        bool ok = true;
+        try {
+            m_reader.read_level( loaded.model, loaded.level, loaded.map );
+        } catch ( const std::exception& e ) {
+            std::cerr << "Failed to stream level " << loaded.level << " of model " << loaded.model << ": " << e.what() << std::endl;
+            ok = false;
+        }
+
+        lock.lock();
+        if ( ok ) {
+            m_loaded.push_back( Loaded() );
+            std::swap( m_loaded.back(), loaded );
+        }
+    }
+}
+
+// Set in main() to stream the scene from a brick stream file instead of VOX files
+BrickStreamer* brick_streamer = 0;
+
+
+//------------------------------------------------------------------------------
+//
+//  Progressive accumulation
+//
+//------------------------------------------------------------------------------
+
+bool accumulationConverged( unsigned int accumulation_frame, double accumulation_start )
+{
+    if( max_spp > 0 && accumulation_frame >= max_spp )
+        return true;
+    if( time_budget > 0.0 && accumulation_frame > 0 && sutil::currentTime() - accumulation_start >= time_budget )
+        return true;
+    return false;
+}
+
+
+void launchAccumulation( unsigned int width, unsigned int height, unsigned int& accumulation_frame, double accumulation_start )
+{
+    if( !display_tonemap )
+    {
+        context["frame"]->setUint( accumulation_frame++ );
+        context->launch( 0, width, height );
+        return;
+    }
+
+    // Fill the display interval with accumulation launches and tonemap only the last result
+    const double t0 = sutil::currentTime();
+    do
+    {
+        context["frame"]->setUint( accumulation_frame++ );
+        context->launch( 0, width, height );
+    }
+    while( sutil::currentTime() - t0 < DISPLAY_INTERVAL && !accumulationConverged( accumulation_frame, accumulation_start ) );
+
+    context->launch( 1, width, height );
+}
+
+
 //------------------------------------------------------------------------------
 //
 //  GLFW callbacks
@@ -376,6 +1003,7 @@ void windowSizeCallback( GLFWwindow* window, int w, int h )
 
     sutil::resizeBuffer( getOutputBuffer(), width, height );
     sutil::resizeBuffer( context[ "accum_buffer" ]->getBuffer(), width, height );
+    sutil::resizeBuffer( context[ "cost_buffer" ]->getBuffer(), width, height );
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -416,6 +1044,8 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, sutil::PreethamSunSky&
 
     unsigned int frame_count = 0;
     unsigned int accumulation_frame = 0;
+    double accumulation_start = 0.0;
+    bool converged = false;
     float sun_phi = sky.getSunPhi();
     float sun_theta = 0.5f*M_PIf - sky.getSunTheta();
     float sun_radius = DEFAULT_SUN_RADIUS;
@@ -428,7 +1058,11 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, sutil::PreethamSunSky&
     while( !glfwWindowShouldClose( window ) )
     {
 
-        glfwPollEvents();                                                        
+        // Once converged there is nothing left to launch, so block for input instead of spinning
+        if( converged )
+            glfwWaitEventsTimeout( IDLE_WAIT );
+        else
+            glfwPollEvents();
 
         ImGui_ImplGlfwGL2_NewFrame();
 
@@ -461,6 +1095,9 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, sutil::PreethamSunSky&
 
             ImGui::SetNextWindowPos( ImVec2( 2.0f, 40.0f ) );
             ImGui::Begin("controls", 0, window_flags );
+            ImGui::Text( "%u spp%s", accumulation_frame, converged ? " (converged)" : "" );
+            if( brick_streamer )
+                ImGui::Text( "%.1f MB of bricks resident", brick_streamer->residentBytes() / ( 1024.0 * 1024.0 ) );
 
             bool sun_changed = false;
             if (ImGui::SliderAngle( "sun rotation", &sun_phi, 0.0f, 360.0f ) ) {
@@ -489,18 +1126,37 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, sutil::PreethamSunSky&
                 sun.color = sky.sunColor() * sqrt_sun_scale * sqrt_sun_scale;
                 memcpy( light_buffer->map(), &sun, sizeof( DirectionalLight ) );
                 light_buffer->unmap();
+                invalidateSunCache();
                 accumulation_frame = 0; 
             }
 
+            if ( ImGui::Combo( "cost heatmap", &cost_heatmap, "off\0frame\0average\0\0" ) ) {
+                context["use_cost_heatmap"]->setInt( cost_heatmap );
+                accumulation_frame = 0;
+            }
+            if ( cost_heatmap != COST_HEATMAP_OFF &&
+                 ImGui::SliderFloat( "cost scale", &cost_scale, 1.0e4f, 1.0e8f, "%.0f cycles", 4.0f ) ) {
+                context["cost_scale"]->setFloat( cost_scale );
+            }
+
             ImGui::End();
         }
 
         // imgui pops
         ImGui::PopStyleVar( 3 );
 
+        // Stream bricks around the new eye before rendering from it
+        if( brick_streamer && brick_streamer->update( context["eye"]->getFloat3() ) ) {
+            invalidateSunCache();
+            accumulation_frame = 0;
+        }
+
         // Render main window
-        context["frame"]->setUint( accumulation_frame++ );
-        context->launch( 0, camera.width(), camera.height() );
+        if( accumulation_frame == 0 )
+            accumulation_start = sutil::currentTime();
+        if( !accumulationConverged( accumulation_frame, accumulation_start ) )
+            launchAccumulation( camera.width(), camera.height(), accumulation_frame, accumulation_start );
+        converged = accumulationConverged( accumulation_frame, accumulation_start );
         sutil::displayBufferGL( getOutputBuffer() );
 
         // Render gui over it
@@ -510,6 +1166,8 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, sutil::PreethamSunSky&
         glfwSwapBuffers( window );
     }
     
+    delete brick_streamer;
+    brick_streamer = 0;
     destroyContext();
     glfwDestroyWindow( window );
     glfwTerminate();
@@ -530,6 +1188,19 @@ void printUsageAndExit( const std::string& argv0 )
         "  -h | --help                  Print this usage message and exit.\n"
         "  -f | --file <output_file>    Save image to file and exit.\n"
         "  -n | --nopbo                 Disable GL interop for display buffer.\n"
+        "  --max-spp <n>                Stop rendering after n samples per pixel.\n"
+        "  --time-budget <seconds>      Stop rendering after this many seconds of accumulation.\n"
+        "  --display-tonemap            Tonemap once per displayed frame instead of every launch.\n"
+        "  --cost-heatmap               Show the mean path tracing cycles per pixel as a heatmap instead of the image.\n"
+        "  --sky-texture                Bake the sky into a lat-long texture when the sun moves.\n"
+        "  --merge-boxes                Merge same colored voxels into larger boxes to shrink the BVH.\n"
+        "  --instancing                 Instance repeated models from one shared geometry.\n"
+        "  --bricks <min_voxels>        Store models with at least this many voxels as DDA traversed brick maps.\n"
+        "  --sun-cache <samples>        Cache sun visibility per voxel face after this many shadow rays.\n"
+        "  --compact-hits               Defer box normals and colors to the closest hit program.\n"
+        "  --write-bricks <file>        Write the loaded models with their levels of detail to a brick stream.\n"
+        "  --stream-bricks <file>       Stream the scene from a brick stream instead of VOX files.\n"
+        "  --stream-budget <MB>         GPU memory for streamed bricks, default 512.\n"
         "App Keystrokes:\n"
         "  q  Quit\n"
         "  s  Save image to '" << SAMPLE_NAME << ".png'\n"
@@ -546,6 +1217,7 @@ int main( int argc, char** argv )
     bool use_pbo  = true;
     std::string out_file;
     std::vector<std::string> vox_files;
+    std::string stream_file;
     for( int i=1; i<argc; ++i )
     {
         const std::string arg( argv[i] );
@@ -567,6 +1239,93 @@ int main( int argc, char** argv )
         {
             use_pbo = false;
         }
+        else if( arg == "--max-spp" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            max_spp = static_cast<unsigned int>( std::max( atoi( argv[++i] ), 0 ) );
+        }
+        else if( arg == "--time-budget" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            time_budget = std::max( atof( argv[++i] ), 0.0 );
+        }
+        else if( arg == "--display-tonemap" )
+        {
+            display_tonemap = true;
+        }
+        else if( arg == "--cost-heatmap" )
+        {
+            cost_heatmap = COST_HEATMAP_AVERAGE;
+        }
+        else if( arg == "--sky-texture" )
+        {
+            bake_sky = true;
+        }
+        else if( arg == "--merge-boxes" )
+        {
+            merge_boxes = true;
+        }
+        else if( arg == "--instancing" )
+        {
+            use_instancing = true;
+        }
+        else if( arg == "--bricks" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            brick_map_voxels = std::max( atoi( argv[++i] ), 0 );
+        }
+        else if( arg == "--sun-cache" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            sun_cache_samples = static_cast<unsigned int>( std::min( std::max( atoi( argv[++i] ), 0 ), 255 ) );
+        }
+        else if( arg == "--compact-hits" )
+        {
+            compact_hits = true;
+        }
+        else if( arg == "--write-bricks" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            brick_stream_out = argv[++i];
+        }
+        else if( arg == "--stream-bricks" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            stream_file = argv[++i];
+        }
+        else if( arg == "--stream-budget" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            stream_budget = size_t( std::max( atoi( argv[++i] ), 1 ) ) << 20;
+        }
         else if( arg[0] == '-' )
         {
             std::cerr << "Unknown option '" << arg << "'\n";
@@ -605,7 +1364,13 @@ int main( int argc, char** argv )
         createLights( sky, sun, light_buffer );
 
         Material material = createDiffuseMaterial();
-        const optix::Aabb aabb = createGeometry( vox_files, material );
+        optix::Aabb aabb;
+        if ( !stream_file.empty() ) {
+            brick_streamer = new BrickStreamer( stream_file.c_str() );
+            aabb = brick_streamer->createGeometry( material );
+        } else {
+            aabb = createGeometry( vox_files, material );
+        }
 
         // Note: lighting comes from miss program
 
@@ -624,6 +1389,9 @@ int main( int argc, char** argv )
         }
         else
         {
+            if ( brick_streamer )
+                brick_streamer->loadAll( context["eye"]->getFloat3() );
+
             // Accumulate frames for anti-aliasing
             const unsigned int numframes = 800;
             std::cerr << "Accumulating " << numframes << " frames ..." << std::endl;
@@ -631,8 +1399,12 @@ int main( int argc, char** argv )
                 context["frame"]->setUint( frame );
                 context->launch( 0, WIDTH, HEIGHT );
             }
+            if( display_tonemap )
+                context->launch( 1, WIDTH, HEIGHT );
             sutil::writeBufferToFile( out_file.c_str(), getOutputBuffer() );
             std::cerr << "Wrote " << out_file << std::endl;
+            delete brick_streamer;
+            brick_streamer = 0;
             destroyContext();
         }
         return 0;
@@ -31,6 +31,7 @@
 #include "helpers.h"
 #include "prd.h"
 #include "random.h"
+#include "cost_heatmap.h"
 
 using namespace optix;
 
@@ -47,6 +48,7 @@ rtBuffer<uchar4, 2>              output_buffer;
 rtBuffer<float4, 2>              accum_buffer;
 rtDeclareVariable(rtObject,      top_object, , );
 rtDeclareVariable(unsigned int,  frame, , );
+rtDeclareVariable(int,           tonemap_output, , );
 rtDeclareVariable(uint2,         launch_index, rtLaunchIndex, );
 
 
@@ -65,6 +67,7 @@ __inline__ __device__ float3 tonemap( const float3 in )
 
 RT_PROGRAM void pinhole_camera()
 {
+  const long long start = clock64();
 
   size_t2 screen = output_buffer.size();
   unsigned int seed = tea<16>(screen.x*launch_index.y+launch_index.x, frame);
@@ -96,11 +99,15 @@ RT_PROGRAM void pinhole_camera()
 
   float3 result = make_float3( 0.0f );
 
+  // The closest hit programs offset the continuation ray origins with offset_ray(),
+  // so only the primary ray needs the scene_epsilon.
+  float tmin = scene_epsilon;
+
   // Main render loop. This is not recursive, and for high ray depths
   // will generally perform better than tracing radiance rays recursively
   // in closest hit programs.
   for(;;) {
-      optix::Ray ray(ray_origin, ray_direction, /*ray type*/ 0, scene_epsilon );
+      optix::Ray ray(ray_origin, ray_direction, /*ray type*/ 0, tmin );
       rtTrace(top_object, ray, prd);
 
       result += prd.attenuation * prd.radiance;
@@ -117,6 +124,7 @@ RT_PROGRAM void pinhole_camera()
       // Update ray data for the next path segment
       ray_origin = prd.origin;
       ray_direction = prd.direction;
+      tmin = 0.0f;
   }
 
   float4 acc_val = accum_buffer[launch_index];
@@ -125,10 +133,24 @@ RT_PROGRAM void pinhole_camera()
   } else {
     acc_val = make_float4( result, 0.f );
   }
-  output_buffer[launch_index] = make_color( tonemap( make_float3( acc_val ) ) );
+  // Display rate tonemapping leaves the output buffer to the tonemap_accum pass
+  if( use_cost_heatmap )
+    output_buffer[launch_index] = make_color( record_cost( launch_index, start, frame ) );
+  else if( tonemap_output )
+    output_buffer[launch_index] = make_color( tonemap( make_float3( acc_val ) ) );
   accum_buffer[launch_index] = acc_val;
 }
 
+RT_PROGRAM void tonemap_accum()
+{
+  // The last accumulation launch already wrote the heatmap
+  if( use_cost_heatmap )
+    return;
+
+  const float4 acc_val = accum_buffer[launch_index];
+  output_buffer[launch_index] = make_color( tonemap( make_float3( acc_val ) ) );
+}
+
 RT_PROGRAM void exception()
 {
   const unsigned int code = rtGetExceptionCode();
@@ -34,6 +34,7 @@
 
 #include <optixu/optixu_math_namespace.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -88,6 +89,26 @@ static const unsigned int default_palette[256] = {
 };
 
 
+// The whole file is read with one fread and parsed from memory, which is much faster than many small
+// reads and lets several files be parsed on different threads.
+struct VoxStream
+{
+    const char* data;
+    size_t      size;
+    size_t      pos;
+};
+
+// fread() on a VoxStream: copies up to count whole elements and returns how many were copied
+size_t vread( void* dst, size_t element_size, size_t count, VoxStream& s )
+{
+    const size_t available = ( s.size - s.pos ) / element_size;
+    if ( count > available ) count = available;
+    memcpy( dst, s.data + s.pos, element_size * count );
+    s.pos += element_size * count;
+    return count;
+}
+
+
 struct ChunkHeader
 {
     char id[5];
@@ -102,13 +123,13 @@ void debugChunkHeader( const ChunkHeader& header )
     std::cerr << "chunk num_child_bytes: " << header.num_child_bytes << std::endl;
 }
 
-bool readChunkHeader( FILE* f, ChunkHeader& h )
+bool readChunkHeader( VoxStream& f, ChunkHeader& h )
 {
     ChunkHeader header;
-    if( fread( header.id, sizeof(char), 4, f ) != 4 ) return false;
+    if( vread( header.id, sizeof(char), 4, f ) != 4 ) return false;
     header.id[4] = '\0';
-    if ( fread( &header.num_bytes, sizeof(int), 1, f ) != 1 ) return false;
-    if ( fread( &header.num_child_bytes, sizeof(int), 1, f ) != 1 ) return false;
+    if ( vread( &header.num_bytes, sizeof(int), 1, f ) != 1 ) return false;
+    if ( vread( &header.num_child_bytes, sizeof(int), 1, f ) != 1 ) return false;
 
     h = header;
 
@@ -121,10 +142,10 @@ bool readChunkHeader( FILE* f, ChunkHeader& h )
 
 
 // Given a SIZE chunk header, read the SIZE and XYZI data into a voxel model
-void readVoxelModel( FILE* f, ChunkHeader child_header, VoxelModel& model )
+void readVoxelModel( VoxStream& f, ChunkHeader child_header, VoxelModel& model )
 {
     ASSERT( strcmp( child_header.id, "SIZE" ) == 0 );
-    if ( fread( model.dims, sizeof(int), 3, f ) != 3 ) return;
+    if ( vread( model.dims, sizeof(int), 3, f ) != 3 ) return;
 
     // Switch from z-up to y-up to match other OptiX samples
     std::swap( model.dims[1], model.dims[2] );
@@ -135,20 +156,29 @@ void readVoxelModel( FILE* f, ChunkHeader child_header, VoxelModel& model )
     readChunkHeader( f, voxel_header );
 
     int num_voxels = -1;
-    if ( fread( &num_voxels, sizeof(int), 1, f ) != 1 ) return;
+    if ( vread( &num_voxels, sizeof(int), 1, f ) != 1 ) return;
     ASSERT( num_voxels <= model.dims[0] * model.dims[1] * model.dims[2] );
 
     DEBUG_PRINT( "num_voxels: " << num_voxels << std::endl );
 
     model.voxels.reserve( num_voxels );
+    model.boxmin = optix::make_uchar4( 255, 255, 255, 255 );
+    model.boxmax = optix::make_uchar4( 0, 0, 0, 0 );
     for (int i = 0; i < num_voxels; ++i) {
         optix::uchar4 voxel;
-        if ( fread( &voxel.x, sizeof(char), 4, f ) != 4 ) return;
+        if ( vread( &voxel.x, sizeof(char), 4, f ) != 4 ) return;
 
         // Switch from z-up to y-up to match other OptiX samples
         std::swap( voxel.y, voxel.z );
         voxel.z = model.dims[2] - voxel.z;
         model.voxels.push_back( voxel );
+
+        model.boxmin.x = std::min( model.boxmin.x, voxel.x );
+        model.boxmin.y = std::min( model.boxmin.y, voxel.y );
+        model.boxmin.z = std::min( model.boxmin.z, voxel.z );
+        model.boxmax.x = std::max( model.boxmax.x, voxel.x );
+        model.boxmax.y = std::max( model.boxmax.y, voxel.y );
+        model.boxmax.z = std::max( model.boxmax.z, voxel.z );
         
         // Note:
         // Have seen models with voxel index == dim, which should be illegal.  
@@ -172,18 +202,29 @@ void debugPalette( const optix::uchar4* pal )
 
 void read_vox( const char* filename, std::vector< VoxelModel >& models, optix::uchar4 palette[256] )
 {
-    FILE* f = fopen( filename, "rb" );
-    if ( !f ) {
-        std::cerr << "Could not open file: " << filename << std::endl;
-        ASSERT( f );
+    std::vector< char > contents;
+    {
+        FILE* file = fopen( filename, "rb" );
+        if ( !file ) {
+            std::cerr << "Could not open file: " << filename << std::endl;
+            ASSERT( file );
+        }
+        fseek( file, 0, SEEK_END );
+        const long file_size = ftell( file );
+        fseek( file, 0, SEEK_SET );
+        contents.resize( file_size > 0 ? size_t( file_size ) : 0 );
+        const size_t num_read = contents.empty() ? 0 : fread( &contents[0], 1, contents.size(), file );
+        fclose( file );
+        ASSERT( num_read == contents.size() );
     }
+    VoxStream f = { contents.empty() ? 0 : &contents[0], contents.size(), 0 };
     char magic[5];
     magic[4] = '\0';
-    ASSERT ( fread( magic, sizeof(char), 4, f ) == 4 );
+    ASSERT ( vread( magic, sizeof(char), 4, f ) == 4 );
     ASSERT( (strcmp( magic, "VOX " ) == 0) && "File is a VOX file" );
     
     int version = 0;
-    ASSERT ( fread( &version, sizeof(int), 1, f ) == 1 );
+    ASSERT ( vread( &version, sizeof(int), 1, f ) == 1 );
 
     ChunkHeader main_header;
     readChunkHeader( f, main_header );
@@ -193,7 +234,7 @@ void read_vox( const char* filename, std::vector< VoxelModel >& models, optix::u
 
     int num_models = 1;
     if ( strcmp( child_header.id, "PACK" ) == 0 ) {
-        ASSERT ( fread( &num_models, sizeof(int), 1, f ) == 1 );
+        ASSERT ( vread( &num_models, sizeof(int), 1, f ) == 1 );
         DEBUG_PRINT( "found pack, num_models = " << num_models << std::endl );
 
         // Read first SIZE block to match single-model case
@@ -222,7 +263,7 @@ void read_vox( const char* filename, std::vector< VoxelModel >& models, optix::u
     bool found_palette = false;
     if ( readChunkHeader( f, child_header ) ) {
         if ( strcmp( child_header.id, "RGBA" ) == 0 ) {
-            ASSERT ( fread( palette, sizeof(optix::uchar4), 256, f ) == 256 );
+            ASSERT ( vread( palette, sizeof(optix::uchar4), 256, f ) == 256 );
             found_palette = true;
         } else {
             std::cerr << "********************* " << filename << std::endl;
@@ -241,9 +282,135 @@ void read_vox( const char* filename, std::vector< VoxelModel >& models, optix::u
         std::cerr << "********************* " << filename << std::endl;
         std::cerr << "********************* Ignoring chunk " << child_header.id << std::endl;
     }
-    
+}
+
+void merge_voxels( const VoxelModel& model, std::vector< VoxelBox >& boxes )
+{
+    // One extra layer, the reader flips z to 1..dims and some files have indices equal to the dims
+    const int nx = model.dims[0] + 1;
+    const int ny = model.dims[1] + 1;
+    const int nz = model.dims[2] + 1;
+
+    // Palette index + 1 per cell, 0 for empty or already merged cells
+    std::vector< unsigned short > grid( size_t( nx ) * ny * nz, 0 );
+    for ( size_t i = 0; i < model.voxels.size(); ++i ) {
+        const optix::uchar4& v = model.voxels[i];
+        ASSERT( v.x < nx && v.y < ny && v.z < nz );
+        grid[ ( size_t( v.z ) * ny + v.y ) * nx + v.x ] = static_cast< unsigned short >( v.w + 1 );
+    }
+    #define CELL( x, y, z ) grid[ ( size_t( z ) * ny + ( y ) ) * nx + ( x ) ]
+
+    boxes.clear();
+    for ( int z = 0; z < nz; ++z ) {
+        for ( int y = 0; y < ny; ++y ) {
+            for ( int x = 0; x < nx; ++x ) {
+                const unsigned short c = CELL( x, y, z );
+                if ( c == 0 ) continue;
+
+                // Grow a run along x, then whole runs along y, then whole slabs along z
+                int x1 = x;
+                while ( x1 + 1 < nx && CELL( x1 + 1, y, z ) == c ) ++x1;
+
+                int y1 = y;
+                for ( bool grow = true; grow && y1 + 1 < ny; ) {
+                    for ( int i = x; i <= x1 && grow; ++i )
+                        grow = CELL( i, y1 + 1, z ) == c;
+                    if ( grow ) ++y1;
+                }
+
+                int z1 = z;
+                for ( bool grow = true; grow && z1 + 1 < nz; ) {
+                    for ( int j = y; j <= y1 && grow; ++j )
+                        for ( int i = x; i <= x1 && grow; ++i )
+                            grow = CELL( i, j, z1 + 1 ) == c;
+                    if ( grow ) ++z1;
+                }
+
+                for ( int k = z; k <= z1; ++k )
+                    for ( int j = y; j <= y1; ++j )
+                        for ( int i = x; i <= x1; ++i )
+                            CELL( i, j, k ) = 0;
+
+                VoxelBox box;
+                box.min = optix::make_uchar4( x, y, z, c - 1 );
+                box.max = optix::make_uchar4( x1, y1, z1, 0 );
+                boxes.push_back( box );
+            }
+        }
+    }
+    #undef CELL
+}
+
+void build_brick_map( const VoxelModel& model, VoxelBrickMap& map )
+{
+    const int brick_voxels = VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE;
+
+    // Same extra layer as merge_voxels()
+    for ( int k = 0; k < 3; ++k )
+        map.dims[k] = model.dims[k] / VOXEL_BRICK_SIZE + 1;
+    map.grid.assign( size_t( map.dims[0] ) * map.dims[1] * map.dims[2], -1 );
+    map.voxels.clear();
+
+    for ( size_t i = 0; i < model.voxels.size(); ++i ) {
+        const optix::uchar4& v = model.voxels[i];
+        const int bx = v.x / VOXEL_BRICK_SIZE;
+        const int by = v.y / VOXEL_BRICK_SIZE;
+        const int bz = v.z / VOXEL_BRICK_SIZE;
+        ASSERT( bx < map.dims[0] && by < map.dims[1] && bz < map.dims[2] );
+
+        int& brick = map.grid[ ( size_t( bz ) * map.dims[1] + by ) * map.dims[0] + bx ];
+        if ( brick < 0 ) {
+            brick = static_cast< int >( map.voxels.size() / brick_voxels );
+            map.voxels.resize( map.voxels.size() + brick_voxels, 0 );
+        }
+        const int lx = v.x % VOXEL_BRICK_SIZE;
+        const int ly = v.y % VOXEL_BRICK_SIZE;
+        const int lz = v.z % VOXEL_BRICK_SIZE;
+        map.voxels[ size_t( brick ) * brick_voxels + ( lz * VOXEL_BRICK_SIZE + ly ) * VOXEL_BRICK_SIZE + lx ] = v.w;
+    }
+}
 
-    fclose( f );
+void downsample_voxels( const VoxelModel& model, int level, VoxelModel& coarse )
+{
+    ASSERT( level >= 0 && level < 8 );
+    for ( int k = 0; k < 3; ++k )
+        coarse.dims[k] = std::max( model.dims[k] >> level, 1 );
+
+    // Sort by coarse cell, then palette index, so that each cell is one run of keys
+    std::vector< unsigned int > keys( model.voxels.size() );
+    for ( size_t i = 0; i < model.voxels.size(); ++i ) {
+        const optix::uchar4& v = model.voxels[i];
+        keys[i] = ( unsigned( v.z >> level ) << 24 ) | ( unsigned( v.y >> level ) << 16 ) | ( unsigned( v.x >> level ) << 8 ) | v.w;
+    }
+    std::sort( keys.begin(), keys.end() );
+
+    coarse.voxels.clear();
+    coarse.boxmin = optix::make_uchar4( 255, 255, 255, 255 );
+    coarse.boxmax = optix::make_uchar4( 0, 0, 0, 0 );
+    for ( size_t i = 0; i < keys.size(); ) {
+        const unsigned int cell = keys[i] >> 8;
+        unsigned int best_color = 0;
+        size_t best_count = 0;
+        while ( i < keys.size() && ( keys[i] >> 8 ) == cell ) {
+            const unsigned int color = keys[i] & 0xffu;
+            const size_t start = i;
+            while ( i < keys.size() && keys[i] == keys[start] )
+                ++i;
+            if ( i - start > best_count ) {
+                best_count = i - start;
+                best_color = color;
+            }
+        }
+
+        const optix::uchar4 v = optix::make_uchar4( cell & 0xffu, ( cell >> 8 ) & 0xffu, cell >> 16, best_color );
+        coarse.voxels.push_back( v );
+        coarse.boxmin.x = std::min( coarse.boxmin.x, v.x );
+        coarse.boxmin.y = std::min( coarse.boxmin.y, v.y );
+        coarse.boxmin.z = std::min( coarse.boxmin.z, v.z );
+        coarse.boxmax.x = std::max( coarse.boxmax.x, v.x );
+        coarse.boxmax.y = std::max( coarse.boxmax.y, v.y );
+        coarse.boxmax.z = std::max( coarse.boxmax.z, v.z );
+    }
 }
 
 #if 0
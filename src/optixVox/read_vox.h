@@ -34,8 +34,37 @@
 struct VoxelModel {
     int dims[3];
     std::vector< optix::uchar4 > voxels;
+    optix::uchar4 boxmin;   // Voxel bounds, inclusive, computed while reading
+    optix::uchar4 boxmax;
 };
 
 void read_vox( const char* filename, std::vector< VoxelModel >& models, optix::uchar4 palette[256] );
 
+// Voxels with the same palette index merged into one box.  Coordinates are inclusive, min.w is the
+// palette index.
+struct VoxelBox {
+    optix::uchar4 min;
+    optix::uchar4 max;
+};
+
+// Greedily merges the voxels of a model into maximal boxes of one palette index, growing each box
+// along x, then y, then z.
+void merge_voxels( const VoxelModel& model, std::vector< VoxelBox >& boxes );
+
+const int VOXEL_BRICK_SIZE = 8;
+
+// Sparse two level grid: a top level grid of VOXEL_BRICK_SIZE^3 bricks, which store the palette index
+// of each of their voxels ( 0 is empty, VOX indices start at 1 ).  Only non-empty bricks are stored.
+struct VoxelBrickMap {
+    int dims[3];                          // Bricks along each axis
+    std::vector< int > grid;              // Brick index per top level cell, x fastest, -1 if empty
+    std::vector< unsigned char > voxels;  // VOXEL_BRICK_SIZE^3 palette indices per brick, x fastest
+};
+
+void build_brick_map( const VoxelModel& model, VoxelBrickMap& map );
+
+// Level of detail: each voxel of the coarse model covers 2^level voxels per axis of the source model.
+// A coarse voxel is set if any of its source voxels is, with the most frequent palette index.
+void downsample_voxels( const VoxelModel& model, int level, VoxelModel& coarse );
+
 
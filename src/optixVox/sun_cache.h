@@ -0,0 +1,114 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Sun visibility cache for diffuse hits: a direct mapped hash table from voxel faces to the fraction of
+// shadow rays that reached the sun.  The faces are cells of a world space grid of voxel size, so
+// instances of a model keep separate entries.  Each entry collects sun_cache_samples shadow rays,
+// after which hits read the cached fraction instead of tracing.  The host bumps sun_cache_epoch when
+// the sun or the scene changes, which invalidates every entry without clearing the buffer.
+//
+// Entry layout, 64 bits: tag ( 32 ) | epoch ( 16 ) | samples ( 8 ) | visible samples ( 8 ).
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+// Uses tea() from random.h, which has no include guard and must be included first
+
+rtBuffer< optix::uint2 >       sun_cache_buffer;   // Power of two entries
+rtDeclareVariable( unsigned int, sun_cache_samples, , ) = 0u;   // 0 disables the cache
+rtDeclareVariable( unsigned int, sun_cache_epoch, , ) = 0u;
+
+struct SunCacheSlot
+{
+    unsigned long long* entry;
+    unsigned int        tag;
+};
+
+// The face of the voxel cell just below the hit point
+static __device__ __inline__ SunCacheSlot sun_cache_slot( const optix::float3& world_hit_point, const optix::float3& normal )
+{
+    using namespace optix;
+
+    const float3 inside = ( world_hit_point - normal * ( 0.5f / 255.0f ) ) * 255.0f;
+    const int3 cell = make_int3( static_cast< int >( floorf( inside.x ) ), static_cast< int >( floorf( inside.y ) ),
+                                 static_cast< int >( floorf( inside.z ) ) );
+    const float3 a = fabs( normal );
+    const unsigned int axis = a.x >= a.y && a.x >= a.z ? 0u : ( a.y >= a.z ? 1u : 2u );
+    const float n = axis == 0 ? normal.x : ( axis == 1 ? normal.y : normal.z );
+    const unsigned int face = axis * 2u + ( n > 0.0f ? 1u : 0u );
+
+    const unsigned int h = tea<4>( static_cast< unsigned int >( cell.x ) * 73856093u ^ static_cast< unsigned int >( cell.y ) * 19349663u,
+                                   static_cast< unsigned int >( cell.z ) * 6u + face );
+    SunCacheSlot slot;
+    const unsigned int size = static_cast< unsigned int >( sun_cache_buffer.size() );
+    slot.entry = reinterpret_cast< unsigned long long* >( &sun_cache_buffer[ h & ( size - 1u ) ] );
+    slot.tag = tea<4>( h, 0x5bd1e995u ) | 1u;   // Never 0, the tag of a cleared entry
+    return slot;
+}
+
+static __device__ __inline__ unsigned long long sun_cache_entry( unsigned int tag, unsigned int samples, unsigned int visible )
+{
+    return ( static_cast< unsigned long long >( tag ) << 32 ) | ( ( sun_cache_epoch & 0xffffu ) << 16 ) | ( samples << 8 ) | visible;
+}
+
+// Returns true with the cached visibility once the face has collected all of its samples
+static __device__ __inline__ bool sun_cache_lookup( const SunCacheSlot& slot, float& visibility )
+{
+    const unsigned long long e = *slot.entry;
+    const unsigned int low = static_cast< unsigned int >( e );
+    const unsigned int samples = ( low >> 8 ) & 0xffu;
+    if( static_cast< unsigned int >( e >> 32 ) != slot.tag || ( low >> 16 ) != ( sun_cache_epoch & 0xffffu ) ||
+        samples < sun_cache_samples )
+        return false;
+    visibility = static_cast< float >( low & 0xffu ) / static_cast< float >( samples );
+    return true;
+}
+
+// Adds one shadow ray result.  Entries of other faces or epochs are replaced.
+static __device__ __inline__ void sun_cache_record( const SunCacheSlot& slot, bool visible )
+{
+    unsigned long long old = *slot.entry;
+    for( ;; ) {
+        const unsigned int low = static_cast< unsigned int >( old );
+        unsigned int samples = 0u;
+        unsigned int count = 0u;
+        if( static_cast< unsigned int >( old >> 32 ) == slot.tag && ( low >> 16 ) == ( sun_cache_epoch & 0xffffu ) ) {
+            samples = ( low >> 8 ) & 0xffu;
+            count = low & 0xffu;
+            if( samples >= sun_cache_samples )
+                return;
+        }
+        const unsigned long long desired = sun_cache_entry( slot.tag, samples + 1u, count + ( visible ? 1u : 0u ) );
+        const unsigned long long seen = atomicCAS( slot.entry, old, desired );
+        if( seen == old )
+            return;
+        old = seen;
+    }
+}
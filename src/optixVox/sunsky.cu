@@ -28,6 +28,7 @@
 
 #include "helpers.h"
 #include "prd.h"
+#include "sky_texture.h"
 #include <optix.h>
 #include <optixu/optixu_math_namespace.h>
 
@@ -48,6 +49,12 @@ static __host__ __device__ __inline__ optix::float3 querySkyModel( bool CEL, con
 {
   using namespace optix;
 
+#ifdef __CUDA_ARCH__
+  // Baked sky, the sun disc stays analytic
+  if( use_sky_texture && !( CEL && dot( direction, sun_direction ) > 94.0f / sqrtf( 94.0f*94.0f + 0.45f*0.45f ) ) )
+    return skyTextureLookup( direction );
+#endif
+
   float3 overcast_sky_color = make_float3( 0.0f );
   float3 sunlit_sky_color   = make_float3( 0.0f );
 
@@ -0,0 +1,325 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/BufferUploader.h>
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace sutil
+{
+
+namespace
+{
+
+// The ring is recycled chunk by chunk.  Each chunk has an event recorded after its last copy.
+const int    UPLOAD_CHUNKS    = 4;
+// Staging allocations keep 16 byte alignment for the float4 and user format buffers
+const size_t UPLOAD_ALIGNMENT = 16;
+
+void checkCuda( cudaError_t error, const char* call )
+{
+    if( error != cudaSuccess )
+        throw std::runtime_error( std::string( "BufferUploader: " ) + call + " failed: " + cudaGetErrorString( error ) );
+}
+
+size_t bufferBytes( optix::Buffer buffer )
+{
+    RTsize width = 0, height = 0, depth = 0;
+    buffer->getSize( width, height, depth );
+    return size_t( buffer->getElementSize() ) * size_t( width ) * size_t( height ? height : 1 ) * size_t( depth ? depth : 1 );
+}
+
+// Whole buffer writes don't need the previous contents
+unsigned int mapFlags( optix::Buffer buffer, size_t bytes, size_t offset )
+{
+    return ( offset == 0 && bytes == bufferBytes( buffer ) ) ? RT_BUFFER_MAP_WRITE_DISCARD : RT_BUFFER_MAP_READ_WRITE;
+}
+
+} // end anonymous namespace
+
+
+class BufferUploader::Impl
+{
+public:
+    Impl( optix::Context context, size_t ring_bytes )
+        : context( context )
+        , async( false )
+        , optix_device( 0 )
+        , cuda_device( 0 )
+        , stream( 0 )
+        , ring( nullptr )
+        , chunk_bytes( 0 )
+        , chunk( 0 )
+        , used( 0 )
+        , bytes_uploaded( 0 )
+    {
+        for( int i = 0; i < UPLOAD_CHUNKS; ++i )
+            events[i] = 0;
+        pending.data = nullptr;
+
+        const std::vector<int> devices = context->getEnabledDevices();
+        if( devices.size() != 1 || ring_bytes < UPLOAD_CHUNKS * UPLOAD_ALIGNMENT )
+            return;
+
+        optix_device = devices[0];
+        context->getDeviceAttribute( optix_device, RT_DEVICE_ATTRIBUTE_CUDA_DEVICE_ORDINAL, sizeof( cuda_device ), &cuda_device );
+
+        const DeviceScope scope( cuda_device );
+
+        chunk_bytes = ( ring_bytes / UPLOAD_CHUNKS ) & ~( UPLOAD_ALIGNMENT - 1 );
+        bool ok     = cudaHostAlloc( reinterpret_cast<void**>( &ring ), chunk_bytes * UPLOAD_CHUNKS, cudaHostAllocDefault ) == cudaSuccess;
+        ok          = ok && cudaStreamCreateWithFlags( &stream, cudaStreamNonBlocking ) == cudaSuccess;
+        for( int i = 0; ok && i < UPLOAD_CHUNKS; ++i )
+            ok = cudaEventCreateWithFlags( &events[i], cudaEventDisableTiming ) == cudaSuccess;
+
+        if( ok )
+            async = true;
+        else
+        {
+            std::cerr << "BufferUploader: No pinned staging memory, using map() for all uploads" << std::endl;
+            release();
+        }
+    }
+
+    ~Impl()
+    {
+        try
+        {
+            flush();
+        }
+        catch( const std::exception& e )
+        {
+            std::cerr << e.what() << std::endl;
+        }
+        release();
+    }
+
+    void upload( optix::Buffer buffer, const void* data, size_t bytes, size_t offset )
+    {
+        commit();
+        if( bytes == 0 )
+            return;
+        bytes_uploaded += bytes;
+
+        char* device = async ? devicePointer( buffer ) : nullptr;
+        if( !device )
+        {
+            void* dst = static_cast<char*>( buffer->map( 0, mapFlags( buffer, bytes, offset ) ) ) + offset;
+            memcpy( dst, data, bytes );
+            buffer->unmap();
+            return;
+        }
+
+        // Larger uploads go through the ring in chunk sized pieces
+        const char* src = static_cast<const char*>( data );
+        for( size_t done = 0; done < bytes; )
+        {
+            const size_t piece   = std::min( bytes - done, chunk_bytes );
+            char*        staging = allocate( piece );
+            memcpy( staging, src + done, piece );
+            copy( device + offset + done, staging, piece );
+            done += piece;
+        }
+    }
+
+    void* stage( optix::Buffer buffer, size_t bytes, size_t offset )
+    {
+        commit();
+        if( bytes == 0 )
+            return nullptr;
+        bytes_uploaded += bytes;
+
+        pending.buffer = buffer;
+        pending.bytes  = bytes;
+        pending.device = ( async && bytes <= chunk_bytes ) ? devicePointer( buffer ) : nullptr;
+        if( pending.device )
+        {
+            pending.device += offset;
+            pending.data = allocate( bytes );
+        }
+        else
+        {
+            pending.data = static_cast<char*>( buffer->map( 0, mapFlags( buffer, bytes, offset ) ) ) + offset;
+        }
+        return pending.data;
+    }
+
+    void flush()
+    {
+        commit();
+        if( async )
+        {
+            const DeviceScope scope( cuda_device );
+            checkCuda( cudaStreamSynchronize( stream ), "cudaStreamSynchronize" );
+        }
+    }
+
+    optix::Context context;
+    bool           async;
+    int            optix_device;
+    int            cuda_device;
+    cudaStream_t   stream;
+    cudaEvent_t    events[UPLOAD_CHUNKS];
+    char*          ring;
+    size_t         chunk_bytes;
+    int            chunk;  // Chunk the next allocation comes from
+    size_t         used;   // Bytes of that chunk handed out since it was recycled
+    size_t         bytes_uploaded;
+
+    // The memory returned by the last stage() call.  device is null when the buffer was mapped instead.
+    struct Pending
+    {
+        optix::Buffer buffer;
+        char*         data;
+        char*         device;
+        size_t        bytes;
+    } pending;
+
+private:
+    // The stream and events belong to the CUDA device of the context.  Restores the caller's current device.
+    struct DeviceScope
+    {
+        explicit DeviceScope( int device )
+        {
+            cudaGetDevice( &previous );
+            cudaSetDevice( device );
+        }
+        ~DeviceScope() { cudaSetDevice( previous ); }
+        int previous;
+    };
+
+    // The interop pointer of the single device, null for buffers which don't have one
+    char* devicePointer( optix::Buffer buffer )
+    {
+        try
+        {
+            return static_cast<char*>( buffer->getDevicePointer( optix_device ) );
+        }
+        catch( const optix::Exception& )
+        {
+            return nullptr;
+        }
+    }
+
+    // Staging memory from the current chunk, or from the next one after its previous copies finished
+    char* allocate( size_t bytes )
+    {
+        if( used + bytes > chunk_bytes )
+        {
+            const DeviceScope scope( cuda_device );
+            checkCuda( cudaEventRecord( events[chunk], stream ), "cudaEventRecord" );
+            chunk = ( chunk + 1 ) % UPLOAD_CHUNKS;
+            checkCuda( cudaEventSynchronize( events[chunk] ), "cudaEventSynchronize" );
+            used = 0;
+        }
+        char* data = ring + size_t( chunk ) * chunk_bytes + used;
+        used += ( bytes + UPLOAD_ALIGNMENT - 1 ) & ~( UPLOAD_ALIGNMENT - 1 );
+        return data;
+    }
+
+    void copy( char* device, const char* staging, size_t bytes )
+    {
+        const DeviceScope scope( cuda_device );
+        checkCuda( cudaMemcpyAsync( device, staging, bytes, cudaMemcpyHostToDevice, stream ), "cudaMemcpyAsync" );
+    }
+
+    // Issue the copy of the last stage() call
+    void commit()
+    {
+        if( !pending.data )
+            return;
+        if( pending.device )
+            copy( pending.device, pending.data, pending.bytes );
+        else
+            pending.buffer->unmap();
+        pending.buffer = optix::Buffer();
+        pending.data   = nullptr;
+    }
+
+    void release()
+    {
+        for( int i = 0; i < UPLOAD_CHUNKS; ++i )
+        {
+            if( events[i] )
+                cudaEventDestroy( events[i] );
+            events[i] = 0;
+        }
+        if( stream )
+            cudaStreamDestroy( stream );
+        if( ring )
+            cudaFreeHost( ring );
+        stream = 0;
+        ring   = nullptr;
+        async  = false;
+    }
+};
+
+
+BufferUploader::BufferUploader( optix::Context context, size_t ring_bytes )
+    : m_impl( new Impl( context, ring_bytes ) )
+{
+}
+
+BufferUploader::~BufferUploader()
+{
+    delete m_impl;
+}
+
+void BufferUploader::upload( optix::Buffer buffer, const void* data, size_t bytes, size_t offset )
+{
+    m_impl->upload( buffer, data, bytes, offset );
+}
+
+void* BufferUploader::stage( optix::Buffer buffer, size_t bytes, size_t offset )
+{
+    return m_impl->stage( buffer, bytes, offset );
+}
+
+void BufferUploader::flush()
+{
+    m_impl->flush();
+}
+
+bool BufferUploader::isAsync() const
+{
+    return m_impl->async;
+}
+
+size_t BufferUploader::bytesUploaded() const
+{
+    return m_impl->bytes_uploaded;
+}
+
+} // end namespace sutil
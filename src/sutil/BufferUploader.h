@@ -0,0 +1,80 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixpp_namespace.h>
+
+#include <cstddef>
+
+#include "sutilapi.h"
+
+namespace sutil
+{
+
+// Host to device buffer fills through a ring of pinned staging memory and asynchronous copies on one CUDA stream.
+// Many small uploads are packed into the same staging chunk, and the calling thread only waits when the ring wraps
+// around to a chunk whose copies are still in flight.  The copies target the CUDA interop device pointers of the
+// buffers, so this path is only taken for contexts with exactly one enabled device.  Other contexts, and buffers
+// without a device pointer like OpenGL interop buffers, fall back to map(), memcpy and unmap().
+//
+// OptiX doesn't know about the stream: flush() before the next launch, acceleration build or map() of an uploaded buffer.
+class BufferUploader
+{
+public:
+    // ring_bytes of pinned host memory, split into a few chunks which are recycled in order
+    SUTILAPI explicit BufferUploader( optix::Context context, size_t ring_bytes = size_t( 32 ) << 20 );
+
+    // Flushes
+    SUTILAPI ~BufferUploader();
+
+    // Copy bytes from data into the buffer at the byte offset.  The data can be reused as soon as the call returns.
+    SUTILAPI void upload( optix::Buffer buffer, const void* data, size_t bytes, size_t offset = 0 );
+
+    // Host memory for the caller to write bytes for the buffer at the byte offset into, e.g. when converting the data anyway.
+    // Only valid until the next call of the uploader, which issues the copy.
+    SUTILAPI void* stage( optix::Buffer buffer, size_t bytes, size_t offset = 0 );
+
+    // Block until all copies arrived in device memory
+    SUTILAPI void flush();
+
+    // False when every upload maps the buffer
+    SUTILAPI bool isAsync() const;
+
+    // Sum of all uploads since creation
+    SUTILAPI size_t bytesUploaded() const;
+
+private:
+    BufferUploader( const BufferUploader& );
+    BufferUploader& operator=( const BufferUploader& );
+
+    class Impl;
+    Impl* m_impl;
+};
+
+} // end namespace sutil
@@ -27,12 +27,18 @@
  */
 
 #include "HDRLoader.h"
+#include "HDRWriter.h"
+#include "TaskPool.h"
 
 #include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <cstdlib>
+#include <vector>
 
 //-----------------------------------------------------------------------------
 //  
@@ -60,74 +66,86 @@ namespace {
     HDRError(const std::string &st = "HDRLoader error") : Er(st) {}
   };
 
-  union RGBe {
-    struct {
-      unsigned char r, g, b, e;
-    };
-    unsigned char v[4];
-  };
-
-  inline void RGBEtoFloats(const RGBe &RV, float *FV, float inv_img_exposure)
+  // Multiplier for each shared exponent, the mantissas are offset by half a step
+  void buildExponentTable(float *table, float inv_img_exposure)
   {
-    if(RV.e == 0)
-      FV[0] = FV[1] = FV[2] = 0.0f;
-    else {
-      const int HDR_EXPON_BIAS = 128;
-      float s = (float)ldexp(1.0, (int(RV.e)-(HDR_EXPON_BIAS+8)));
-      s *= inv_img_exposure;
-      FV[0] = (RV.r + 0.5f)*s;
-      FV[1] = (RV.g + 0.5f)*s;
-      FV[2] = (RV.b + 0.5f)*s;
-    }
+    const int HDR_EXPON_BIAS = 128;
+    table[0] = 0.0f;
+    for(int e=1; e<256; e++)
+      table[e] = (float)ldexp(1.0, (e-(HDR_EXPON_BIAS+8))) * inv_img_exposure;
   }
 
-
-  void ReadScanlineNoRLE(std::ifstream &inf, RGBe *RGBEline, const size_t wid)
+  // Old-format scanlines are stored as flat RGBe quadruples
+  bool isRLEScanline(const unsigned char *p, const unsigned char *end, const size_t wid)
   {
-    inf.read(reinterpret_cast<char *>(RGBEline), wid * sizeof(RGBe));
-    if(inf.eof()) throw HDRError("Premature file end in ReadScanlineNoRLE");
+    const size_t MinLen = 8, MaxLen = 0x7fff;
+    if(wid<MinLen || wid>MaxLen) return false;
+    if(end - p < 4) throw HDRError("Premature file end in ReadScanline 1");
+    if(p[0] != 2 || p[1] != 2 || (p[2]&0x80)) return false; // Found an old-format scanline
+    if((size_t(p[2])<<8 | size_t(p[3])) != wid) throw HDRError("Scanline width inconsistent");
+    return true;
   }
 
-  void ReadScanline(std::ifstream &inf, RGBe *RGBEline, const size_t wid)
+  // Returns the start of the next scanline.  All runs are validated here so that the
+  // scanlines can be decoded independently without further checks.
+  const unsigned char *SkipScanline(const unsigned char *p, const unsigned char *end, const size_t wid)
   {
-    const size_t MinLen = 8, MaxLen = 0x7fff;
-    if(wid<MinLen || wid>MaxLen) return ReadScanlineNoRLE(inf, RGBEline, wid);
-    char c0, c1, c2, c3;
-    inf.get(c0);
-    inf.get(c1);
-    inf.get(c2);
-    inf.get(c3);
-    if(inf.eof()) throw HDRError("Premature file end in ReadScanline 1");
-    if(c0 != 2 || c1 != 2 || (c2&0x80)) {
-      inf.putback(c3);
-      inf.putback(c2);
-      inf.putback(c1);
-      inf.putback(c0);
-      return ReadScanlineNoRLE(inf, RGBEline, wid); // Found an old-format scanline
+    if(!isRLEScanline(p, end, wid)) {
+      if(size_t(end - p) < wid*4) throw HDRError("Premature file end in ReadScanlineNoRLE");
+      return p + wid*4;
     }
 
-    if(size_t(size_t(c2)<<8 | size_t(c3)) != wid) throw HDRError("Scanline width inconsistent");
-
-    // This scanline is RLE.
+    p += 4;
     for(unsigned int ch=0; ch<4; ch++) {
-      for(unsigned int x=0; x<wid; ) {
-        unsigned char code;
-        inf.get(reinterpret_cast<char &>(code));
-        if(inf.eof()) throw HDRError("Premature file end in ReadScanline 2");
+      for(size_t x=0; x<wid; ) {
+        if(p == end) throw HDRError("Premature file end in ReadScanline 2");
+        size_t code = *p++;
         if(code > 0x80) { // RLE span
-          char pix;
-          inf.get(pix);
-          if(inf.eof()) throw HDRError("Premature file end in ReadScanline 3");
-          code = code & 0x7f;
-          while(code--)
-            RGBEline[x++].v[ch] = pix;
+          if(p == end) throw HDRError("Premature file end in ReadScanline 3");
+          code &= 0x7f;
+          p++;
         } else { // Arbitrary span
-          while(code--) {
-            inf.get(reinterpret_cast<char &>(RGBEline[x++].v[ch]));
-            if(inf.eof()) throw HDRError("Premature file end in ReadScanline 4");
+          if(size_t(end - p) < code) throw HDRError("Premature file end in ReadScanline 4");
+          p += code;
+        }
+        if(code == 0 || code > wid - x) throw HDRError("Invalid span length in scanline");
+        x += code;
+      }
+    }
+    return p;
+  }
+
+  // Decodes one scanline validated by SkipScanline() into RGBA floats, rgbe holds wid*4 bytes.
+  void DecodeScanline(const unsigned char *p, const size_t wid, const float *exponents,
+                      unsigned char *rgbe, float *FV)
+  {
+    const unsigned char *line = p;
+    if(isRLEScanline(p, p + 4, wid)) {
+      p += 4;
+      for(unsigned int ch=0; ch<4; ch++) {
+        unsigned char *dst = rgbe + ch;
+        unsigned char *const dst_end = dst + wid*4;
+        while(dst != dst_end) {
+          unsigned int code = *p++;
+          if(code > 0x80) { // RLE span
+            const unsigned char pix = *p++;
+            for(code &= 0x7f; code--; dst += 4)
+              *dst = pix;
+          } else { // Arbitrary span
+            for(; code--; dst += 4)
+              *dst = *p++;
           }
         }
       }
+      line = rgbe;
+    }
+
+    for(size_t x=0; x<wid; x++, line += 4, FV += 4) {
+      const float s = exponents[line[3]];
+      FV[0] = (line[0] + 0.5f)*s;
+      FV[1] = (line[1] + 0.5f)*s;
+      FV[2] = (line[2] + 0.5f)*s;
+      FV[3] = 1.0f;
     }
   }
 };
@@ -169,23 +187,39 @@ HDRLoader::HDRLoader( const std::string& filename )
     
     std::string major, minor;
     inf >> minor >> m_ny >> major >> m_nx;
-    if(minor != "-Y" || major != "+X") throw "Can only handle -Y +X ordering";
-    if(m_nx <= 0 || m_ny <= 0) throw "Invalid image dimensions";
+    if(minor != "-Y" || major != "+X") throw HDRError("Can only handle -Y +X ordering");
+    if(m_nx <= 0 || m_ny <= 0) throw HDRError("Invalid image dimensions");
     getLine(inf, comment); // Read the last newline of the header
 
-    RGBe *RGBERaster = new RGBe[m_nx * m_ny];
-
+    // Decode from memory: one pass finds where each scanline starts, then the
+    // scanlines are expanded in parallel bands of rows.
+    const std::streamoff data_begin = inf.tellg();
+    inf.seekg(0, std::ios::end);
+    const std::streamoff data_end = inf.tellg();
+    if(data_begin < 0 || data_end < data_begin) throw HDRError("Couldn't read file " + filename);
+    std::vector<unsigned char> data(size_t(data_end - data_begin));
+    inf.seekg(data_begin);
+    if(!data.empty()) inf.read(reinterpret_cast<char *>(&data[0]), data.size());
+    if(!inf) throw HDRError("Couldn't read file " + filename);
+
+    const unsigned char *p = data.empty() ? 0 : &data[0];
+    const unsigned char *const end = p + data.size();
+    std::vector<const unsigned char *> scanlines(m_ny);
     for(unsigned int y=0; y<m_ny; y++) {
-      ReadScanline(inf, RGBERaster + m_nx*y, m_nx);
+      scanlines[y] = p;
+      p = SkipScanline(p, end, m_nx);
     }
 
-    m_raster = new float[m_nx * m_ny * 4];
+    float exponents[256];
+    buildExponentTable(exponents, 1.0f / exposure);
 
-    float inv_img_exposure = 1.0f / exposure;
-    for(unsigned int i=0; i<m_nx*m_ny; i++) {
-      RGBEtoFloats(RGBERaster[i], m_raster + i*4, inv_img_exposure);
-    }
-    delete[] RGBERaster;
+    m_raster = new float[size_t(m_nx) * m_ny * 4];
+
+    sutil::parallelForRange(0u, m_ny, [&](unsigned int y_begin, unsigned int y_end) {
+      std::vector<unsigned char> rgbe(size_t(m_nx) * 4);
+      for(unsigned int y = y_begin; y<y_end; y++)
+        DecodeScanline(scanlines[y], m_nx, exponents, &rgbe[0], m_raster + size_t(m_nx)*y*4);
+    }, 16);
   } catch ( const HDRError& err  ) {
     std::cerr << "HDRLoader( '" << filename << "' ) failed to load file: " << err.Er << '\n';
     delete [] m_raster;
@@ -269,21 +303,31 @@ optix::TextureSampler loadHDRTexture( optix::Context context,
 
   const unsigned int nx = hdr.width();
   const unsigned int ny = hdr.height();
-
-  // Create buffer and populate with HDR data
-  optix::Buffer buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, nx, ny );
-  float* buffer_data = static_cast<float*>( buffer->map() );
-
-  for ( unsigned int i = 0; i < nx; ++i ) {
+  const float* raster = hdr.raster();
+  const size_t row_size = size_t( nx )*4;
+
+  // Half floats hold the 8-bit RGBE mantissas exactly in half the memory of
+  // floats, as long as the image stays within the half range.
+  const float HALF_MAX = 65504.0f;
+  const bool use_half = *std::max_element( raster, raster + row_size*ny ) <= HALF_MAX;
+
+  // Create buffer and populate with HDR data, the HDR file stores the top row first.
+  optix::Buffer buffer;
+  if ( use_half ) {
+    buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_HALF4, nx, ny );
+    uint16_t* buffer_data = static_cast<uint16_t*>( buffer->map() );
     for ( unsigned int j = 0; j < ny; ++j ) {
-
-      unsigned int hdr_index = ( (ny-j-1)*nx + i )*4;
-      unsigned int buf_index = ( (j     )*nx + i )*4;
-
-      buffer_data[ buf_index + 0 ] = hdr.raster()[ hdr_index + 0 ];
-      buffer_data[ buf_index + 1 ] = hdr.raster()[ hdr_index + 1 ];
-      buffer_data[ buf_index + 2 ] = hdr.raster()[ hdr_index + 2 ];
-      buffer_data[ buf_index + 3 ] = hdr.raster()[ hdr_index + 3 ];
+      const float* src = raster + size_t( ny-j-1 )*row_size;
+      uint16_t*    dst = buffer_data + size_t( j )*row_size;
+      for ( size_t i = 0; i < row_size; ++i )
+        dst[i] = floatToHalf( src[i] );
+    }
+    sampler->setReadMode( RT_TEXTURE_READ_ELEMENT_TYPE );
+  } else {
+    buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, nx, ny );
+    float* buffer_data = static_cast<float*>( buffer->map() );
+    for ( unsigned int j = 0; j < ny; ++j ) {
+      memcpy( buffer_data + size_t( j )*row_size, raster + size_t( ny-j-1 )*row_size, row_size*sizeof(float) );
     }
   }
 
@@ -0,0 +1,300 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "HDRWriter.h"
+#include "TaskPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdint.h>
+
+// Defined in stb/stb_image_write.cpp, where the PNG writer uses it.  Returns a
+// zlib stream to be released with free().
+unsigned char* stbi_zlib_compress( unsigned char* data, int data_len, int* out_len, int quality );
+
+namespace
+{
+
+const int EXR_ZIP_LINES = 16;  // Scanlines per chunk of ZIP compression
+
+struct EXRChannel
+{
+  std::string  name;
+  const float* pixels;
+  unsigned int stride;
+
+  bool operator<( const EXRChannel& other ) const { return name < other.name; }
+};
+
+
+bool isLittleEndianHost()
+{
+  const uint32_t one = 1;
+  return *reinterpret_cast<const unsigned char*>( &one ) == 1;
+}
+
+
+void put32( std::vector<unsigned char>& out, uint32_t v )
+{
+  for( int i = 0; i < 4; ++i )
+    out.push_back( static_cast<unsigned char>( v >> ( 8*i ) ) );
+}
+
+
+void put64( std::vector<unsigned char>& out, uint64_t v )
+{
+  for( int i = 0; i < 8; ++i )
+    out.push_back( static_cast<unsigned char>( v >> ( 8*i ) ) );
+}
+
+
+void putFloat( std::vector<unsigned char>& out, float f )
+{
+  uint32_t v;
+  memcpy( &v, &f, sizeof( v ) );
+  put32( out, v );
+}
+
+
+void putString( std::vector<unsigned char>& out, const std::string& s )
+{
+  out.insert( out.end(), s.begin(), s.end() );
+  out.push_back( 0 );
+}
+
+
+void beginAttribute( std::vector<unsigned char>& out, const char* name, const char* type, uint32_t size )
+{
+  putString( out, name );
+  putString( out, type );
+  put32( out, size );
+}
+
+
+// Raw half float lines of one chunk, compressed the way OpenEXR's ZIP
+// compression expects.  Falls back to the raw data if that is not smaller.
+void buildChunk( const std::vector<EXRChannel>& channels, unsigned int width, unsigned int height,
+                 unsigned int first_line, std::vector<unsigned char>& chunk )
+{
+  const unsigned int num_lines = std::min<unsigned int>( EXR_ZIP_LINES, height - first_line );
+
+  std::vector<unsigned char> raw;
+  raw.reserve( static_cast<size_t>( num_lines ) * width * channels.size() * 2 );
+  for( unsigned int line = first_line; line < first_line + num_lines; ++line )
+  {
+    // EXR lines go top down
+    const size_t row = height - 1 - line;
+    for( size_t c = 0; c < channels.size(); ++c )
+    {
+      const float* src = channels[c].pixels + row * width * channels[c].stride;
+      for( unsigned int x = 0; x < width; ++x, src += channels[c].stride )
+      {
+        const uint16_t h = floatToHalf( *src );
+        raw.push_back( static_cast<unsigned char>( h ) );
+        raw.push_back( static_cast<unsigned char>( h >> 8 ) );
+      }
+    }
+  }
+
+  // Split even and odd bytes into two halves, then delta encode
+  const size_t n = raw.size();
+  std::vector<unsigned char> filtered( n );
+  for( size_t i = 0; i < n; ++i )
+    filtered[ ( i & 1 ) ? ( n + 1 ) / 2 + i / 2 : i / 2 ] = raw[i];
+  for( size_t i = n; i-- > 1; )
+    filtered[i] = static_cast<unsigned char>( filtered[i] - filtered[i-1] + 128 );
+
+  int compressed_size = 0;
+  unsigned char* compressed = n ? stbi_zlib_compress( &filtered[0], static_cast<int>( n ), &compressed_size, 8 ) : 0;
+  chunk.clear();
+  put32( chunk, first_line );
+  if( compressed && static_cast<size_t>( compressed_size ) < n )
+  {
+    put32( chunk, compressed_size );
+    chunk.insert( chunk.end(), compressed, compressed + compressed_size );
+  }
+  else
+  {
+    put32( chunk, static_cast<uint32_t>( n ) );
+    chunk.insert( chunk.end(), raw.begin(), raw.end() );
+  }
+  free( compressed );
+}
+
+} // namespace
+
+
+uint16_t floatToHalf( float f )
+{
+  uint32_t x;
+  memcpy( &x, &f, sizeof( x ) );
+  const uint32_t sign     = ( x >> 16 ) & 0x8000u;
+  const uint32_t exponent = x & 0x7f800000u;
+  uint32_t       mantissa = x & 0x007fffffu;
+
+  if( exponent == 0x7f800000u )
+    return static_cast<uint16_t>( sign | 0x7c00u | ( mantissa ? 0x200u : 0u ) );
+
+  const int e = static_cast<int>( exponent >> 23 ) - 127 + 15;
+  if( e >= 31 )
+    return static_cast<uint16_t>( sign | 0x7c00u );
+
+  if( e <= 0 )
+  {
+    if( e < -10 )
+      return static_cast<uint16_t>( sign );
+    mantissa |= 0x00800000u;
+    const int      shift     = 14 - e;
+    const uint32_t remainder = mantissa & ( ( 1u << shift ) - 1u );
+    const uint32_t halfway   = 1u << ( shift - 1 );
+    uint32_t       h         = mantissa >> shift;
+    if( remainder > halfway || ( remainder == halfway && ( h & 1u ) ) )
+      ++h;
+    return static_cast<uint16_t>( sign | h );
+  }
+
+  uint32_t h = sign | ( static_cast<uint32_t>( e ) << 10 ) | ( mantissa >> 13 );
+  const uint32_t remainder = mantissa & 0x1fffu;
+  if( remainder > 0x1000u || ( remainder == 0x1000u && ( h & 1u ) ) )
+    ++h;  // A carry into the exponent is still the correctly rounded value
+  return static_cast<uint16_t>( h );
+}
+
+
+bool writeEXR( const std::string& filename, unsigned int width, unsigned int height,
+               const std::vector<EXRLayer>& layers, unsigned int num_threads )
+{
+  if( width == 0 || height == 0 )
+    return false;
+
+  // Channels are stored in alphabetical order of their full names
+  std::vector<EXRChannel> channels;
+  for( size_t l = 0; l < layers.size(); ++l )
+  {
+    for( size_t c = 0; c < layers[l].channels.size(); ++c )
+    {
+      EXRChannel channel;
+      channel.name   = ( layers[l].name.empty() ? std::string() : layers[l].name + "." ) + layers[l].channels[c];
+      channel.pixels = layers[l].pixels + c;
+      channel.stride = layers[l].stride;
+      channels.push_back( channel );
+    }
+  }
+  std::sort( channels.begin(), channels.end() );
+
+  std::vector<unsigned char> header;
+  put32( header, 20000630 );  // Magic number
+  put32( header, 2 );         // Version 2, single part scanline file
+
+  std::vector<unsigned char> channel_list;
+  for( size_t c = 0; c < channels.size(); ++c )
+  {
+    putString( channel_list, channels[c].name );
+    put32( channel_list, 1 );  // HALF
+    put32( channel_list, 0 );  // pLinear and reserved
+    put32( channel_list, 1 );  // x sampling
+    put32( channel_list, 1 );  // y sampling
+  }
+  channel_list.push_back( 0 );
+  beginAttribute( header, "channels", "chlist", static_cast<uint32_t>( channel_list.size() ) );
+  header.insert( header.end(), channel_list.begin(), channel_list.end() );
+
+  beginAttribute( header, "compression", "compression", 1 );
+  header.push_back( 3 );  // ZIP_COMPRESSION
+  for( int window = 0; window < 2; ++window )
+  {
+    beginAttribute( header, window ? "displayWindow" : "dataWindow", "box2i", 16 );
+    put32( header, 0 );
+    put32( header, 0 );
+    put32( header, width - 1 );
+    put32( header, height - 1 );
+  }
+  beginAttribute( header, "lineOrder", "lineOrder", 1 );
+  header.push_back( 0 );  // INCREASING_Y
+  beginAttribute( header, "pixelAspectRatio", "float", 4 );
+  putFloat( header, 1.0f );
+  beginAttribute( header, "screenWindowCenter", "v2f", 8 );
+  putFloat( header, 0.0f );
+  putFloat( header, 0.0f );
+  beginAttribute( header, "screenWindowWidth", "float", 4 );
+  putFloat( header, 1.0f );
+  header.push_back( 0 );
+
+  // Compress the chunks in parallel
+  const unsigned int num_chunks = ( height + EXR_ZIP_LINES - 1 ) / EXR_ZIP_LINES;
+  std::vector<std::vector<unsigned char> > chunks( num_chunks );
+  std::unique_ptr<sutil::TaskPool> own_pool;
+  if( num_threads != 0 )
+    own_pool.reset( new sutil::TaskPool( std::min( num_threads, num_chunks ) ) );
+  sutil::TaskPool& pool = own_pool ? *own_pool : sutil::TaskPool::instance();
+
+  sutil::parallelFor( 0u, num_chunks, [&]( unsigned int i ) {
+    buildChunk( channels, width, height, i * EXR_ZIP_LINES, chunks[i] );
+  }, 1, pool );
+
+  uint64_t offset = header.size() + 8ull * num_chunks;
+  for( unsigned int i = 0; i < num_chunks; ++i )
+  {
+    put64( header, offset );
+    offset += chunks[i].size();
+  }
+
+  FILE* file = fopen( filename.c_str(), "wb" );
+  if( !file )
+    return false;
+  bool ok = fwrite( &header[0], 1, header.size(), file ) == header.size();
+  for( unsigned int i = 0; ok && i < num_chunks; ++i )
+    ok = fwrite( &chunks[i][0], 1, chunks[i].size(), file ) == chunks[i].size();
+  return fclose( file ) == 0 && ok;
+}
+
+
+bool writePFM( const std::string& filename, unsigned int width, unsigned int height, const float* rgb,
+               unsigned int stride )
+{
+  FILE* file = fopen( filename.c_str(), "wb" );
+  if( !file )
+    return false;
+
+  // A negative scale marks little endian data.  Rows go bottom up, as given.
+  fprintf( file, "PF\n%u %u\n%s\n", width, height, isLittleEndianHost() ? "-1.0" : "1.0" );
+
+  bool ok = true;
+  std::vector<float> row( 3 * width );
+  for( unsigned int y = 0; ok && y < height; ++y )
+  {
+    for( unsigned int x = 0; x < width; ++x )
+      for( int c = 0; c < 3; ++c )
+        row[3*x+c] = rgb[ ( static_cast<size_t>( y ) * width + x ) * stride + c ];
+    ok = fwrite( &row[0], sizeof( float ), row.size(), file ) == row.size();
+  }
+  return fclose( file ) == 0 && ok;
+}
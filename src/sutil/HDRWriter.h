@@ -0,0 +1,71 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+//
+// Float image writers.  Pixels are given bottom row first, as in OptiX
+// buffers.
+//
+//-----------------------------------------------------------------------------
+
+// Converts to the nearest half float, rounding to even.  Values beyond the
+// half range become infinity, tiny ones become subnormals or zero.
+SUTILAPI uint16_t floatToHalf( float f );
+
+// One group of channels of an EXR image
+struct EXRLayer
+{
+  std::string   name;       // Channel name prefix, empty for the main image
+  std::string   channels;   // One letter per channel, e.g. "RGBA" or "XYZ"
+  const float*  pixels;     // First channel of the first pixel
+  unsigned int  stride;     // Floats per pixel, at least channels.size()
+};
+
+// Writes the layers as a scanline OpenEXR file with half float channels,
+// ZIP compressed in blocks of 16 lines on num_threads threads (0 uses the
+// shared sutil::TaskPool).  Returns false if the file cannot be written.
+SUTILAPI bool writeEXR( const std::string& filename,
+                        unsigned int width,
+                        unsigned int height,
+                        const std::vector<EXRLayer>& layers,
+                        unsigned int num_threads = 0 );
+
+// Writes RGB floats with the given stride as a PFM file.  Returns false if
+// the file cannot be written.
+SUTILAPI bool writePFM( const std::string& filename,
+                        unsigned int width,
+                        unsigned int height,
+                        const float* rgb,
+                        unsigned int stride = 3 );
@@ -0,0 +1,297 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/ImageWriter.h>
+#include <sutil/sutil.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+
+enum { IMAGE_LAYERS = 3 };  // Image, albedo and normal
+
+struct ImageJob
+{
+    std::string                filename;
+    unsigned                   width;
+    unsigned                   height;
+    unsigned                   num_layers;
+    RTformat                   formats[IMAGE_LAYERS];
+    std::vector<unsigned char> data[IMAGE_LAYERS];   // Raw buffer contents, capacity reused across jobs
+};
+
+
+bool isImageFormat( RTformat format )
+{
+    return format == RT_FORMAT_UNSIGNED_BYTE4 || format == RT_FORMAT_FLOAT ||
+           format == RT_FORMAT_FLOAT3 || format == RT_FORMAT_FLOAT4;
+}
+
+} // end anonymous namespace
+
+
+class sutil::ImageWriter::Impl
+{
+public:
+    Impl( unsigned int num_threads, unsigned int max_pending );
+    ~Impl();
+
+    void write( const std::string& filename, optix::Buffer buffer, optix::Buffer albedo, optix::Buffer normal );
+    void finish();
+
+    unsigned int failures() const;
+
+private:
+    void work();
+
+    const unsigned int       m_max_pending;
+    unsigned int             m_pending;      // Jobs queued or being written
+    unsigned int             m_failures;
+    bool                     m_stop;
+
+    std::deque<ImageJob*>    m_queue;
+    std::vector<ImageJob*>   m_pool;         // Staging allocations of finished jobs
+
+    mutable std::mutex       m_mutex;
+    std::condition_variable  m_work_ready;
+    std::condition_variable  m_job_done;
+    std::vector<std::thread> m_threads;
+};
+
+
+sutil::ImageWriter::Impl::Impl( unsigned int num_threads, unsigned int max_pending )
+    : m_max_pending( std::max( max_pending, 1u ) ),
+      m_pending( 0 ),
+      m_failures( 0 ),
+      m_stop( false )
+{
+    for( unsigned int i = 0; i < std::max( num_threads, 1u ); ++i )
+        m_threads.push_back( std::thread( &Impl::work, this ) );
+}
+
+
+sutil::ImageWriter::Impl::~Impl()
+{
+    finish();
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_stop = true;
+    }
+    m_work_ready.notify_all();
+    for( size_t i = 0; i < m_threads.size(); ++i )
+        m_threads[i].join();
+    for( size_t i = 0; i < m_pool.size(); ++i )
+        delete m_pool[i];
+}
+
+
+void sutil::ImageWriter::Impl::write( const std::string& filename, optix::Buffer buffer, optix::Buffer albedo,
+                                      optix::Buffer normal )
+{
+    // Layers only exist in EXR files, the albedo and normal slots stay empty otherwise
+    optix::Buffer buffers[IMAGE_LAYERS] = { buffer, albedo, normal };
+    const unsigned num_layers = isFloatImageFile( filename.c_str() ) ? IMAGE_LAYERS : 1;
+
+    RTsize width, height;
+    buffer->getSize( width, height );
+    for( unsigned i = 0; i < num_layers; ++i )
+    {
+        if( !buffers[i] )
+            continue;
+        RTsize w, h;
+        buffers[i]->getSize( w, h );
+        if( !isImageFormat( buffers[i]->getFormat() ) )
+            throw optix::Exception( "ImageWriter: Unrecognized buffer data type or format." );
+        if( w != width || h != height )
+            throw optix::Exception( "ImageWriter: Layer buffers differ in size from the image buffer." );
+    }
+
+    ImageJob* job = 0;
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        while( m_pending >= m_max_pending )
+            m_job_done.wait( lock );
+        ++m_pending;
+        if( !m_pool.empty() )
+        {
+            job = m_pool.back();
+            m_pool.pop_back();
+        }
+    }
+    if( !job )
+        job = new ImageJob;
+
+    // The render thread only pays for this copy, conversion and encoding happen on the workers
+    job->filename   = filename;
+    job->width      = static_cast<unsigned>( width );
+    job->height     = static_cast<unsigned>( height );
+    job->num_layers = num_layers;
+    try
+    {
+        for( unsigned i = 0; i < num_layers; ++i )
+        {
+            job->data[i].resize( buffers[i] ? buffers[i]->getElementSize() * width * height : 0 );
+            if( !job->data[i].empty() )
+            {
+                job->formats[i] = buffers[i]->getFormat();
+                memcpy( &job->data[i][0], buffers[i]->map( 0, RT_BUFFER_MAP_READ ), job->data[i].size() );
+                buffers[i]->unmap();
+            }
+        }
+    }
+    catch( ... )
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_pool.push_back( job );
+            --m_pending;
+        }
+        m_job_done.notify_all();
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_queue.push_back( job );
+    }
+    m_work_ready.notify_one();
+}
+
+
+void sutil::ImageWriter::Impl::finish()
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    while( m_pending > 0 )
+        m_job_done.wait( lock );
+}
+
+
+unsigned int sutil::ImageWriter::Impl::failures() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_failures;
+}
+
+
+void sutil::ImageWriter::Impl::work()
+{
+    std::vector<unsigned char> rgb;
+    std::vector<float>         rgba[IMAGE_LAYERS];
+    for( ;; )
+    {
+        ImageJob* job;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            while( m_queue.empty() && !m_stop )
+                m_work_ready.wait( lock );
+            if( m_queue.empty() )
+                return;
+            job = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        bool ok = true;
+        try
+        {
+            const size_t num_pixels = static_cast<size_t>( job->width ) * job->height;
+            if( num_pixels != 0 && isFloatImageFile( job->filename.c_str() ) )
+            {
+                const float* layers[IMAGE_LAYERS] = { 0, 0, 0 };
+                for( unsigned i = 0; i < job->num_layers; ++i )
+                {
+                    if( job->data[i].empty() )
+                        continue;
+                    rgba[i].resize( 4 * num_pixels );
+                    convertBufferToRGBA32F( &job->data[i][0], job->formats[i], job->width, job->height, &rgba[i][0] );
+                    layers[i] = &rgba[i][0];
+                }
+                writeRGBA32FToFile( job->filename.c_str(), layers[0], job->width, job->height, layers[1], layers[2] );
+            }
+            else if( num_pixels != 0 )
+            {
+                rgb.resize( 3 * num_pixels );
+                convertBufferToRGB8( &job->data[0][0], job->formats[0], job->width, job->height, &rgb[0] );
+                writeRGB8ToFile( job->filename.c_str(), &rgb[0], job->width, job->height );
+            }
+        }
+        catch( std::exception& e )
+        {
+            std::cerr << "ImageWriter: " << e.what() << std::endl;
+            ok = false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            if( !ok )
+                ++m_failures;
+            m_pool.push_back( job );
+            --m_pending;
+        }
+        m_job_done.notify_all();
+    }
+}
+
+
+sutil::ImageWriter::ImageWriter( unsigned int num_threads, unsigned int max_pending )
+    : m_impl( new Impl( num_threads, max_pending ) )
+{
+}
+
+
+sutil::ImageWriter::~ImageWriter()
+{
+    delete m_impl;
+}
+
+
+void sutil::ImageWriter::write( const std::string& filename, optix::Buffer buffer, optix::Buffer albedo,
+                                optix::Buffer normal )
+{
+    m_impl->write( filename, buffer, albedo, normal );
+}
+
+
+void sutil::ImageWriter::finish()
+{
+    m_impl->finish();
+}
+
+
+unsigned int sutil::ImageWriter::failures() const
+{
+    return m_impl->failures();
+}
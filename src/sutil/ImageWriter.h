@@ -0,0 +1,69 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixpp_namespace.h>
+#include <string>
+
+#include "sutilapi.h"
+
+namespace sutil
+{
+
+// Writes images of OptiX buffers on worker threads.  write() copies the mapped buffer into a pooled
+// staging allocation and returns, the workers convert and encode it as writeBufferToFile() would.
+// At most max_pending images are copied but not yet written; write() blocks while that many wait.
+class ImageWriter
+{
+public:
+    SUTILAPI ImageWriter( unsigned int num_threads = 2, unsigned int max_pending = 4 );
+
+    // Writes all pending images first
+    SUTILAPI ~ImageWriter();
+
+    // Queue the current contents of the buffer to be written to filename, with type based on extension.
+    // The optional denoiser albedo and normal buffers become layers of .exr files, see writeBuffersToFile().
+    SUTILAPI void write( const std::string& filename, optix::Buffer buffer,
+                         optix::Buffer albedo = optix::Buffer(), optix::Buffer normal = optix::Buffer() );
+
+    // Block until all queued images are written
+    SUTILAPI void finish();
+
+    // Number of images that failed to encode or write so far
+    SUTILAPI unsigned int failures() const;
+
+private:
+    ImageWriter( const ImageWriter& );
+    ImageWriter& operator=( const ImageWriter& );
+
+    class Impl;
+    Impl* m_impl;
+};
+
+} // end namespace sutil
@@ -31,13 +31,22 @@
 #include <optixu/optixu_math_stream_namespace.h>
 
 #include "Mesh.h" 
+#include "ObjLoader.h"
+#include "TaskPool.h"
 #include "rply-1.01/rply.h"
 #include "tinyobjloader/tiny_obj_loader.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <locale>
+#include <new>
+#include <sstream>
 #include <stdexcept>
 #include <stdint.h>
+#include <sys/stat.h>
 #include <vector>
 
 //------------------------------------------------------------------------------
@@ -161,6 +170,7 @@ struct PlyData
   Mesh* mesh;
   int32_t cur_vertex;
   int32_t cur_index;
+  int     last_coord;  // Vertex property read last, completes the vertex
 };
 
 
@@ -189,8 +199,6 @@ int plyLoadVertex( p_ply_argument argument )
       data->mesh->positions[3*data->cur_vertex+2] = value;
       data->mesh->bbox_min[2] = std::min( data->mesh->bbox_min[2], value );
       data->mesh->bbox_max[2] = std::max( data->mesh->bbox_max[2], value );
-      if( !data->mesh->has_normals )
-        ++data->cur_vertex;
       break;
 
     // Normal property
@@ -202,11 +210,21 @@ int plyLoadVertex( p_ply_argument argument )
       break;
     case 5: 
       data->mesh->normals[3*data->cur_vertex+2] = value;
-      ++data->cur_vertex;
+      break;
+
+    // Texture coordinate property
+    case 6:
+      data->mesh->texcoords[2*data->cur_vertex+0] = value;
+      break;
+    case 7:
+      data->mesh->texcoords[2*data->cur_vertex+1] = value;
       break;
 
       // Silently ignore other coord_index values
   }
+
+  if( coord_index == data->last_coord )
+    ++data->cur_vertex;
   return 1;
 }
   
@@ -241,6 +259,223 @@ int plyLoadFace( p_ply_argument argument )
   return 1;
 }
 
+
+//------------------------------------------------------------------------------
+//
+// Binary PLY fast path.  Little endian files whose vertices only have float properties and whose
+// faces are a single uchar counted list of int vertex_indices are read in large blocks instead of
+// through one rply callback per scalar.  Any other layout is read by rply.
+//
+//------------------------------------------------------------------------------
+
+// Vertex properties, in the order of the coord_index values of plyLoadVertex()
+enum PlyVertexProperty
+{
+  PLY_X = 0,
+  PLY_Y,
+  PLY_Z,
+  PLY_NX,
+  PLY_NY,
+  PLY_NZ,
+  PLY_U,
+  PLY_V,
+  PLY_NUM_PROPERTIES
+};
+
+const char* const PLY_PROPERTY_NAMES[PLY_NUM_PROPERTIES] = { "x", "y", "z", "nx", "ny", "nz", "u", "v" };
+
+const size_t PLY_BLOCK_SIZE     = 1u << 20;
+const size_t PLY_MAX_FACE_BYTES = 1 + 255*sizeof( int32_t );
+
+
+struct PlyLayout
+{
+  int64_t num_vertices;
+  int64_t num_faces;
+  int32_t vertex_stride;                 // Bytes per vertex
+  int32_t offsets[PLY_NUM_PROPERTIES];   // Byte offset within a vertex, -1 if absent
+};
+
+
+bool isLittleEndianHost()
+{
+  const uint32_t one = 1;
+  return *reinterpret_cast<const unsigned char*>( &one ) == 1;
+}
+
+
+// Parses the header and leaves the file at the start of the data.  Returns false unless the layout
+// is one the fast path reads.
+bool readPlyLayout( FILE* file, PlyLayout& layout )
+{
+  layout.num_vertices  = -1;
+  layout.num_faces     = -1;
+  layout.vertex_stride = 0;
+  for( int i = 0; i < PLY_NUM_PROPERTIES; ++i )
+    layout.offsets[i] = -1;
+
+  enum { NONE, VERTEX, FACE, OTHER } element = NONE;
+  bool binary_little_endian = false;
+  bool face_list            = false;
+
+  char line[1024];
+  if( !fgets( line, sizeof( line ), file ) || strncmp( line, "ply", 3 ) != 0 )
+    return false;
+
+  while( fgets( line, sizeof( line ), file ) )
+  {
+    std::istringstream in( line );
+    std::string keyword;
+    in >> keyword;
+
+    if( keyword == "format" )
+    {
+      std::string format;
+      in >> format;
+      binary_little_endian = format == "binary_little_endian";
+    }
+    else if( keyword == "element" )
+    {
+      std::string name;
+      int64_t count = -1;
+      in >> name >> count;
+      if( name == "vertex" && element == NONE )
+      {
+        element = VERTEX;
+        layout.num_vertices = count;
+      }
+      else if( name == "face" && element == VERTEX )
+      {
+        element = FACE;
+        layout.num_faces = count;
+      }
+      else if( element == FACE || element == OTHER )
+        element = OTHER;  // Elements after the faces are never read
+      else
+        return false;
+    }
+    else if( keyword == "property" )
+    {
+      std::string type;
+      in >> type;
+      if( element == VERTEX )
+      {
+        std::string name;
+        in >> name;
+        if( type != "float" && type != "float32" )
+          return false;
+        for( int i = 0; i < PLY_NUM_PROPERTIES; ++i )
+          if( name == PLY_PROPERTY_NAMES[i] )
+            layout.offsets[i] = layout.vertex_stride;
+        layout.vertex_stride += sizeof( float );
+      }
+      else if( element == FACE )
+      {
+        std::string count_type, index_type, name;
+        in >> count_type >> index_type >> name;
+        if( face_list || type != "list" || ( count_type != "uchar" && count_type != "uint8" ) ||
+            ( index_type != "int" && index_type != "int32" && index_type != "uint" && index_type != "uint32" ) ||
+            name != "vertex_indices" )
+          return false;
+        face_list = true;
+      }
+      else if( element == NONE )
+        return false;
+    }
+    else if( keyword == "end_header" )
+    {
+      return binary_little_endian && face_list && layout.num_vertices >= 0 && layout.num_faces >= 0 &&
+             layout.offsets[PLY_X] >= 0 && layout.offsets[PLY_Y] >= 0 && layout.offsets[PLY_Z] >= 0;
+    }
+    // comment and obj_info lines are skipped
+  }
+  return false;
+}
+
+
+// Loads the vertices and triangles of a binary PLY file, returns false if the layout needs rply
+bool loadBinaryPLY( const std::string& filename, Mesh& mesh )
+{
+  if( !isLittleEndianHost() )
+    return false;
+
+  FILE* file = fopen( filename.c_str(), "rb" );
+  if( !file )
+    return false;
+
+  PlyLayout layout;
+  bool ok = readPlyLayout( file, layout ) &&
+            layout.num_vertices == mesh.num_vertices && layout.num_faces == mesh.num_triangles &&
+            ( !mesh.has_normals   || ( layout.offsets[PLY_NY] >= 0 && layout.offsets[PLY_NZ] >= 0 ) ) &&
+            ( !mesh.has_texcoords || ( layout.offsets[PLY_U]  >= 0 && layout.offsets[PLY_V]  >= 0 ) );
+
+  // Vertices.  Plain x y z positions go straight into the mesh, anything else through a staging block.
+  const size_t num_vertices = static_cast<size_t>( mesh.num_vertices );
+  if( ok && layout.vertex_stride == 3*sizeof( float ) && layout.offsets[PLY_X] == 0 &&
+      layout.offsets[PLY_Y] == sizeof( float ) && layout.offsets[PLY_Z] == 2*sizeof( float ) )
+  {
+    ok = fread( mesh.positions, 3*sizeof( float ), num_vertices, file ) == num_vertices;
+  }
+  else if( ok )
+  {
+    const size_t stride = layout.vertex_stride;
+    std::vector<char> block( std::max<size_t>( PLY_BLOCK_SIZE / stride, 1 ) * stride );
+    for( size_t first = 0; ok && first < num_vertices; )
+    {
+      const size_t count = std::min( num_vertices - first, block.size() / stride );
+      ok = fread( &block[0], stride, count, file ) == count;
+      for( size_t i = 0; ok && i < count; ++i )
+      {
+        const char*  vertex = &block[i*stride];
+        const size_t v      = first + i;
+        for( int c = 0; c < 3; ++c )
+          memcpy( &mesh.positions[3*v+c], vertex + layout.offsets[PLY_X+c], sizeof( float ) );
+        if( mesh.has_normals )
+          for( int c = 0; c < 3; ++c )
+            memcpy( &mesh.normals[3*v+c], vertex + layout.offsets[PLY_NX+c], sizeof( float ) );
+        if( mesh.has_texcoords )
+          for( int c = 0; c < 2; ++c )
+            memcpy( &mesh.texcoords[2*v+c], vertex + layout.offsets[PLY_U+c], sizeof( float ) );
+      }
+      first += count;
+    }
+  }
+
+  // Faces.  As with rply, the first three indices of a face make its triangle.
+  if( ok && mesh.num_triangles > 0 )
+  {
+    std::vector<unsigned char> block( PLY_BLOCK_SIZE );
+    size_t begin  = 0;
+    size_t end    = 0;
+    bool   at_eof = false;
+    for( int32_t face = 0; ok && face < mesh.num_triangles; ++face )
+    {
+      if( end - begin < PLY_MAX_FACE_BYTES && !at_eof )
+      {
+        memmove( &block[0], &block[begin], end - begin );
+        end  -= begin;
+        begin = 0;
+        const size_t num_read = fread( &block[end], 1, block.size() - end, file );
+        at_eof = num_read < block.size() - end;
+        end   += num_read;
+      }
+
+      const size_t num_indices = begin < end ? block[begin] : 0;
+      ok = num_indices >= 3 && begin + 1 + num_indices*sizeof( int32_t ) <= end;
+      if( ok )
+        memcpy( &mesh.tri_indices[3*face], &block[begin+1], 3*sizeof( int32_t ) );
+      begin += 1 + num_indices*sizeof( int32_t );
+    }
+  }
+  fclose( file );
+
+  if( !ok )
+    return false;
+
+  computeMeshBounds( mesh );
+  return true;
+}
+
   
 void applyLoadXForm( Mesh& mesh, const float* load_xform )
 {
@@ -253,33 +488,390 @@ void applyLoadXForm( Mesh& mesh, const float* load_xform )
       have_matrix = true;
 
   if( have_matrix )
+    transformMesh( mesh, load_xform );
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Parallel geometry passes.  The arrays are cut into blocks of MESH_KERNEL_BLOCK elements which
+// run on the sutil::TaskPool threads.  Bounds are reduced per block and then over the blocks in
+// order, so the results don't depend on the thread count.  The inner loops work on the plain float
+// arrays without branches, so the compiler can vectorize them.
+//
+//------------------------------------------------------------------------------
+
+const int32_t MESH_KERNEL_BLOCK = 16384;
+
+
+int32_t numKernelBlocks( int32_t count )
+{
+  return ( count + MESH_KERNEL_BLOCK - 1 ) / MESH_KERNEL_BLOCK;
+}
+
+
+struct BlockBounds
+{
+  float lo[3];
+  float hi[3];
+};
+
+
+void boundsOfRange( const float* positions, int32_t first, int32_t last, BlockBounds& bounds )
+{
+  float lx =  1e16f, ly =  1e16f, lz =  1e16f;
+  float hx = -1e16f, hy = -1e16f, hz = -1e16f;
+  for( int32_t i = first; i < last; ++i )
   {
-    mesh.bbox_min[0] = mesh.bbox_min[1] = mesh.bbox_min[2] =  1e16f;
-    mesh.bbox_max[0] = mesh.bbox_max[1] = mesh.bbox_max[2] = -1e16f;
+    const float x = positions[3*i+0];
+    const float y = positions[3*i+1];
+    const float z = positions[3*i+2];
+    lx = std::min( lx, x );  hx = std::max( hx, x );
+    ly = std::min( ly, y );  hy = std::max( hy, y );
+    lz = std::min( lz, z );  hz = std::max( hz, z );
+  }
+  bounds.lo[0] = lx;  bounds.lo[1] = ly;  bounds.lo[2] = lz;
+  bounds.hi[0] = hx;  bounds.hi[1] = hy;  bounds.hi[2] = hz;
+}
 
-    optix::Matrix4x4 mat( load_xform );
 
-    float3* positions = reinterpret_cast<float3*>( mesh.positions );
-    for( int32_t i = 0; i < mesh.num_vertices; ++i )
+void reduceBounds( const std::vector<BlockBounds>& blocks, Mesh& mesh )
+{
+  mesh.bbox_min[0] = mesh.bbox_min[1] = mesh.bbox_min[2] =  1e16f;
+  mesh.bbox_max[0] = mesh.bbox_max[1] = mesh.bbox_max[2] = -1e16f;
+  for( size_t b = 0; b < blocks.size(); ++b )
+  {
+    for( int c = 0; c < 3; ++c )
     {
-      const float3 v = make_float3( mat*make_float4( positions[i], 1.0f ) );
-      positions[i] = v; 
-      mesh.bbox_min[0] = std::min<float>( mesh.bbox_min[0], v.x );
-      mesh.bbox_min[1] = std::min<float>( mesh.bbox_min[1], v.y );
-      mesh.bbox_min[2] = std::min<float>( mesh.bbox_min[2], v.z );
-      mesh.bbox_max[0] = std::max<float>( mesh.bbox_max[0], v.x );
-      mesh.bbox_max[1] = std::max<float>( mesh.bbox_max[1], v.y );
-      mesh.bbox_max[2] = std::max<float>( mesh.bbox_max[2], v.z );
+      mesh.bbox_min[c] = std::min( mesh.bbox_min[c], blocks[b].lo[c] );
+      mesh.bbox_max[c] = std::max( mesh.bbox_max[c], blocks[b].hi[c] );
     }
+  }
+}
 
-    if( mesh.has_normals )
+
+//------------------------------------------------------------------------------
+//
+// Binary mesh cache.  The first load of a mesh writes the parsed, untransformed mesh next to the
+// source as <filename>.meshcache, later loads read the arrays back in bulk instead of parsing.  The
+// cache is used only if the size, modification time and a hash of the start, middle and end of the
+// source still match.  Set SUTIL_MESH_CACHE=0 to disable it.
+//
+// The header and arrays are stored as laid out in memory, so a cache is only meant for the machine
+// that wrote it.
+//
+//------------------------------------------------------------------------------
+
+const char     MESH_CACHE_MAGIC[8]   = { 'S', 'U', 'T', 'I', 'L', 'M', 'S', 'H' };
+const uint32_t MESH_CACHE_VERSION    = 2;
+const size_t   MESH_CACHE_HASH_CHUNK = 64*1024;
+
+struct MeshCacheHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint64_t source_size;
+  int64_t  source_mtime;
+  uint64_t source_hash;
+
+  int32_t  num_vertices;
+  int32_t  has_normals;
+  int32_t  has_texcoords;
+  int32_t  num_triangles;
+  int32_t  num_materials;
+  float    bbox_min[3];
+  float    bbox_max[3];
+};
+
+
+bool meshCacheEnabled()
+{
+  const char* env = getenv( "SUTIL_MESH_CACHE" );
+  return !env || strcmp( env, "0" ) != 0;
+}
+
+
+// Fills in the source fields of the header, returns false if the source cannot be read
+bool describeSource( const std::string& filename, MeshCacheHeader& header )
+{
+#ifdef _WIN32
+  struct _stat64 st;
+  if( _stat64( filename.c_str(), &st ) != 0 )
+    return false;
+#else
+  struct stat st;
+  if( stat( filename.c_str(), &st ) != 0 )
+    return false;
+#endif
+  header.source_size  = static_cast<uint64_t>( st.st_size );
+  header.source_mtime = static_cast<int64_t>( st.st_mtime );
+
+  FILE* file = fopen( filename.c_str(), "rb" );
+  if( !file )
+    return false;
+
+  // FNV-1a over three chunks, which catches edits that keep the size and time stamp without reading
+  // the whole file
+  uint64_t hash = 14695981039346656037ull;
+  std::vector<unsigned char> chunk( MESH_CACHE_HASH_CHUNK );
+  const uint64_t offsets[3] = { 0, header.source_size / 2, header.source_size > MESH_CACHE_HASH_CHUNK ? header.source_size - MESH_CACHE_HASH_CHUNK : 0 };
+  for( int i = 0; i < 3; ++i )
+  {
+#ifdef _WIN32
+    _fseeki64( file, static_cast<__int64>( offsets[i] ), SEEK_SET );
+#else
+    fseeko( file, static_cast<off_t>( offsets[i] ), SEEK_SET );
+#endif
+    const size_t n = fread( &chunk[0], 1, chunk.size(), file );
+    for( size_t k = 0; k < n; ++k )
+      hash = ( hash ^ chunk[k] ) * 1099511628211ull;
+  }
+  fclose( file );
+
+  header.source_hash = hash;
+  return true;
+}
+
+
+bool writeBlock( FILE* file, const void* data, size_t size )
+{
+  return size == 0 || fwrite( data, size, 1, file ) == 1;
+}
+
+
+bool readBlock( FILE* file, void* data, size_t size )
+{
+  return size == 0 || fread( data, size, 1, file ) == 1;
+}
+
+
+bool writeString( FILE* file, const std::string& s )
+{
+  const uint32_t length = static_cast<uint32_t>( s.size() );
+  return writeBlock( file, &length, sizeof( length ) ) && writeBlock( file, s.data(), length );
+}
+
+
+bool readString( FILE* file, std::string& s )
+{
+  uint32_t length = 0;
+  if( !readBlock( file, &length, sizeof( length ) ) )
+    return false;
+  s.resize( length );
+  return length == 0 || readBlock( file, &s[0], length );
+}
+
+
+// Opens the cache and reads its header if it matches the source
+FILE* openMeshCache( const std::string& filename, MeshCacheHeader& header )
+{
+  MeshCacheHeader source;
+  if( !meshCacheEnabled() || !describeSource( filename, source ) )
+    return 0;
+
+  FILE* file = fopen( ( filename + ".meshcache" ).c_str(), "rb" );
+  if( !file )
+    return 0;
+
+  if( !readBlock( file, &header, sizeof( header ) ) ||
+      memcmp( header.magic, MESH_CACHE_MAGIC, sizeof( header.magic ) ) != 0 ||
+      header.version      != MESH_CACHE_VERSION ||
+      header.source_size  != source.source_size ||
+      header.source_mtime != source.source_mtime ||
+      header.source_hash  != source.source_hash )
+  {
+    fclose( file );
+    return 0;
+  }
+  return file;
+}
+
+
+// Writes a freshly parsed mesh.  Failures, e.g. read-only data directories, only cost the speedup.
+void writeMeshCache( const std::string& filename, const Mesh& mesh )
+{
+  MeshCacheHeader header;
+  memset( &header, 0, sizeof( header ) );
+  if( !meshCacheEnabled() || !describeSource( filename, header ) )
+    return;
+
+  memcpy( header.magic, MESH_CACHE_MAGIC, sizeof( header.magic ) );
+  header.version       = MESH_CACHE_VERSION;
+  header.num_vertices  = mesh.num_vertices;
+  header.has_normals   = mesh.has_normals;
+  header.has_texcoords = mesh.has_texcoords;
+  header.num_triangles = mesh.num_triangles;
+  header.num_materials = mesh.num_materials;
+  memcpy( header.bbox_min, mesh.bbox_min, sizeof( header.bbox_min ) );
+  memcpy( header.bbox_max, mesh.bbox_max, sizeof( header.bbox_max ) );
+
+  const std::string cache_filename = filename + ".meshcache";
+  FILE* file = fopen( cache_filename.c_str(), "wb" );
+  if( !file )
+    return;
+
+  bool ok = writeBlock( file, &header, sizeof( header ) ) &&
+            writeBlock( file, mesh.positions, 3*sizeof( float )*mesh.num_vertices ) &&
+            ( !mesh.has_normals   || writeBlock( file, mesh.normals,   3*sizeof( float )*mesh.num_vertices ) ) &&
+            ( !mesh.has_texcoords || writeBlock( file, mesh.texcoords, 2*sizeof( float )*mesh.num_vertices ) ) &&
+            writeBlock( file, mesh.tri_indices, 3*sizeof( int32_t )*mesh.num_triangles ) &&
+            writeBlock( file, mesh.mat_indices, 1*sizeof( int32_t )*mesh.num_triangles );
+
+  // Texture paths are stored relative to the mesh, so the cache still works from another directory
+  const std::string directory = directoryOfFilePath( filename );
+  for( int32_t i = 0; ok && i < mesh.num_materials; ++i )
+  {
+    const MaterialParams& mat = mesh.mat_params[i];
+    const std::string Kd_map = !directory.empty() && mat.Kd_map.compare( 0, directory.size(), directory ) == 0 ?
+                               mat.Kd_map.substr( directory.size() ) : mat.Kd_map;
+    ok = writeString( file, mat.name ) && writeString( file, Kd_map ) &&
+         writeBlock( file, mat.Kd, sizeof( mat.Kd ) ) && writeBlock( file, mat.Ks, sizeof( mat.Ks ) ) &&
+         writeBlock( file, mat.Kr, sizeof( mat.Kr ) ) && writeBlock( file, mat.Ka, sizeof( mat.Ka ) ) &&
+         writeBlock( file, &mat.exp, sizeof( mat.exp ) );
+  }
+
+  fclose( file );
+  if( !ok )
+    remove( cache_filename.c_str() );
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Parallel OBJ parsing.  OBJ files of at least OBJ_PARALLEL_MIN_SIZE bytes are parsed with
+// loadObjParallel() on the sutil::TaskPool threads, smaller files with tinyobj::LoadObj().  Set
+// SUTIL_OBJ_THREADS to override the thread count, SUTIL_OBJ_THREADS=1 always uses tinyobjloader.
+//
+//------------------------------------------------------------------------------
+
+const uint64_t OBJ_PARALLEL_MIN_SIZE = 4u << 20;
+
+
+unsigned int objParseThreads( const std::string& filename )
+{
+  const char* env = getenv( "SUTIL_OBJ_THREADS" );
+  if( env )
+    return static_cast<unsigned int>( std::max( atoi( env ), 1 ) );
+
+#ifdef _WIN32
+  struct _stat64 st;
+  if( _stat64( filename.c_str(), &st ) != 0 )
+    return 1;
+#else
+  struct stat st;
+  if( stat( filename.c_str(), &st ) != 0 )
+    return 1;
+#endif
+  if( static_cast<uint64_t>( st.st_size ) < OBJ_PARALLEL_MIN_SIZE )
+    return 1;
+  return sutil::TaskPool::instance().numThreads();
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Spatial sort.  Optionally reorders triangles along a Morton curve through their centroids, then
+// renumbers vertices in order of first use, so that triangles close in space are close in memory
+// for both BVH builds and attribute fetches.  Enabled with MeshLoader::setSpatialSort() or
+// SUTIL_MESH_SORT=1.
+//
+//------------------------------------------------------------------------------
+
+bool spatialSortEnabled()
+{
+  const char* env = getenv( "SUTIL_MESH_SORT" );
+  return env && strcmp( env, "0" ) != 0;
+}
+
+
+const float MORTON_CELLS = static_cast<float>( ( 1 << 21 ) - 1 );  // Per axis, for a 63 bit code
+
+
+// Spreads the low 21 bits of v to every third bit
+uint64_t expandBits( uint64_t v )
+{
+  v &= 0x1FFFFFull;
+  v = ( v | v << 32 ) & 0x001F00000000FFFFull;
+  v = ( v | v << 16 ) & 0x001F0000FF0000FFull;
+  v = ( v | v <<  8 ) & 0x100F00F00F00F00Full;
+  v = ( v | v <<  4 ) & 0x10C30C30C30C30C3ull;
+  v = ( v | v <<  2 ) & 0x1249249249249249ull;
+  return v;
+}
+
+
+// Moves element i of each array to slot order[i]
+template <typename T>
+void permute( T* data, int32_t width, const std::vector<int32_t>& order )
+{
+  std::vector<T> copy( data, data + order.size()*width );
+  for( size_t i = 0; i < order.size(); ++i )
+    std::copy( &copy[i*width], &copy[i*width] + width, data + static_cast<size_t>( order[i] )*width );
+}
+
+
+void sortMeshSpatially( Mesh& mesh )
+{
+  const size_t num_triangles = static_cast<size_t>( mesh.num_triangles );
+  const size_t num_vertices  = static_cast<size_t>( mesh.num_vertices );
+  for( size_t i = 0; i < 3*num_triangles; ++i )
+  {
+    if( mesh.tri_indices[i] < 0 || mesh.tri_indices[i] >= mesh.num_vertices )
+    {
+      std::cerr << "MeshLoader - WARNING: vertex index out of range, skipping spatial sort" << std::endl;
+      return;
+    }
+  }
+
+  float scale[3];
+  for( int c = 0; c < 3; ++c )
+  {
+    const float extent = mesh.bbox_max[c] - mesh.bbox_min[c];
+    scale[c] = extent > 0.0f ? MORTON_CELLS / extent : 0.0f;
+  }
+
+  // Morton code of the centroid, ties keep file order
+  std::vector<std::pair<uint64_t, int32_t> > keys( num_triangles );
+  for( size_t t = 0; t < num_triangles; ++t )
+  {
+    uint64_t code = 0;
+    for( int c = 0; c < 3; ++c )
     {
-      mat = mat.inverse().transpose();
-      float3* normals = reinterpret_cast<float3*>( mesh.normals );
-      for( int32_t i = 0; i < mesh.num_vertices; ++i )
-        normals[i] = make_float3( mat*make_float4( normals[i], 1.0f ) );
+      float centroid = 0.0f;
+      for( int k = 0; k < 3; ++k )
+        centroid += mesh.positions[3*mesh.tri_indices[3*t+k]+c];
+      const float cell = ( centroid / 3.0f - mesh.bbox_min[c] ) * scale[c];
+      code |= expandBits( static_cast<uint64_t>( std::min( std::max( cell, 0.0f ), MORTON_CELLS ) ) ) << ( 2 - c );
     }
+    keys[t] = std::make_pair( code, static_cast<int32_t>( t ) );
+  }
+  std::sort( keys.begin(), keys.end() );
+
+  std::vector<int32_t> triangle_order( num_triangles );
+  for( size_t i = 0; i < num_triangles; ++i )
+    triangle_order[ keys[i].second ] = static_cast<int32_t>( i );
+  permute( mesh.tri_indices, 3, triangle_order );
+  permute( mesh.mat_indices, 1, triangle_order );
+
+  // Vertices in order of first use, unreferenced vertices go last
+  std::vector<int32_t> vertex_order( num_vertices, -1 );
+  int32_t next = 0;
+  for( size_t i = 0; i < 3*num_triangles; ++i )
+  {
+    int32_t& slot = vertex_order[ mesh.tri_indices[i] ];
+    if( slot < 0 )
+      slot = next++;
+    mesh.tri_indices[i] = slot;
   }
+  for( size_t v = 0; v < num_vertices; ++v )
+    if( vertex_order[v] < 0 )
+      vertex_order[v] = next++;
+
+  permute( mesh.positions, 3, vertex_order );
+  if( mesh.has_normals )
+    permute( mesh.normals, 3, vertex_order );
+  if( mesh.has_texcoords )
+    permute( mesh.texcoords, 2, vertex_order );
 }
 
 } 
@@ -294,6 +886,7 @@ class MeshLoader::Impl
 {
 public:
   Impl( const std::string& filename );
+  ~Impl();
   
   void scanMesh( Mesh& mesh );
   void loadMesh( Mesh& mesh, const float* load_xform );
@@ -303,6 +896,9 @@ public:
 
   void loadMeshOBJ( Mesh& mesh );
   void loadMeshPLY( Mesh& mesh );
+  bool loadMeshCache( Mesh& mesh );
+
+  void setSpatialSort( bool sort ) { m_spatial_sort = sort; }
 private:
   enum FileType
   {
@@ -312,6 +908,11 @@ private:
   };
   std::string                         m_filename;
   FileType                            m_filetype;
+
+  FILE*                               m_cache;          // Valid binary cache, open between scan and load
+  MeshCacheHeader                     m_cache_header;
+
+  bool                                m_spatial_sort;
   
   std::vector<tinyobj::shape_t>       m_shapes;
   std::vector<tinyobj::material_t>    m_materials;
@@ -319,7 +920,9 @@ private:
 
 
 MeshLoader::Impl::Impl( const std::string& filename )
-  : m_filename( filename )
+  : m_filename( filename ),
+    m_cache( 0 ),
+    m_spatial_sort( spatialSortEnabled() )
 {
    if( fileIsOBJ( m_filename ) )
      m_filetype = OBJ;
@@ -330,11 +933,29 @@ MeshLoader::Impl::Impl( const std::string& filename )
 }
 
 
+MeshLoader::Impl::~Impl()
+{
+  if( m_cache )
+    fclose( m_cache );
+}
+
+
 void MeshLoader::Impl::scanMesh( Mesh& mesh )
 {
   clearMesh( mesh );
 
-  if( m_filetype == OBJ )
+  if( m_filetype != UNKNOWN && !m_cache )
+    m_cache = openMeshCache( m_filename, m_cache_header );
+
+  if( m_cache )
+  {
+    mesh.num_vertices  = m_cache_header.num_vertices;
+    mesh.has_normals   = m_cache_header.has_normals != 0;
+    mesh.has_texcoords = m_cache_header.has_texcoords != 0;
+    mesh.num_triangles = m_cache_header.num_triangles;
+    mesh.num_materials = m_cache_header.num_materials;
+  }
+  else if( m_filetype == OBJ )
     scanMeshOBJ( mesh );
   else if( m_filetype == PLY )
     scanMeshPLY( mesh );
@@ -353,20 +974,77 @@ void MeshLoader::Impl::loadMesh( Mesh& mesh, const float* load_xform )
     return;
   }
   
-  mesh.bbox_min[0] = mesh.bbox_min[1] = mesh.bbox_min[2] =  1e16f;
-  mesh.bbox_max[0] = mesh.bbox_max[1] = mesh.bbox_max[2] = -1e16f;
+  if( !m_cache || !loadMeshCache( mesh ) )
+  {
+    // A cache that fails to read after its header matched falls back to parsing
+    if( m_filetype == OBJ && m_shapes.empty() )
+    {
+      Mesh scanned;
+      clearMesh( scanned );
+      scanMeshOBJ( scanned );
+    }
+    mesh.bbox_min[0] = mesh.bbox_min[1] = mesh.bbox_min[2] =  1e16f;
+    mesh.bbox_max[0] = mesh.bbox_max[1] = mesh.bbox_max[2] = -1e16f;
 
-  if( m_filetype == OBJ )
-    loadMeshOBJ( mesh );
-  else if( m_filetype == PLY )
-    loadMeshPLY( mesh );
-  else
-    throw std::runtime_error( "MeshLoader: Unsupported file type for '" + m_filename + "'" );
+    if( m_filetype == OBJ )
+      loadMeshOBJ( mesh );
+    else if( m_filetype == PLY )
+      loadMeshPLY( mesh );
+    else
+      throw std::runtime_error( "MeshLoader: Unsupported file type for '" + m_filename + "'" );
+
+    writeMeshCache( m_filename, mesh );
+  }
+
+  if( m_spatial_sort )
+    sortMeshSpatially( mesh );
 
   applyLoadXForm( mesh, load_xform );
 }
 
 
+bool MeshLoader::Impl::loadMeshCache( Mesh& mesh )
+{
+  // scanMesh() took the counts from the same header, so the arrays have the cached sizes
+  memcpy( mesh.bbox_min, m_cache_header.bbox_min, sizeof( mesh.bbox_min ) );
+  memcpy( mesh.bbox_max, m_cache_header.bbox_max, sizeof( mesh.bbox_max ) );
+
+  // Arrays from allocMesh( mesh, arena ) are laid out like the cache and are read in one go
+  const size_t vertex_floats = ( 3 + ( mesh.has_normals ? 3 : 0 ) + ( mesh.has_texcoords ? 2 : 0 ) )*sizeof( float );
+  const size_t array_bytes   = vertex_floats*mesh.num_vertices + 4*sizeof( int32_t )*mesh.num_triangles;
+  const bool   contiguous    = reinterpret_cast<char*>( mesh.mat_indices ) + sizeof( int32_t )*mesh.num_triangles ==
+                               reinterpret_cast<char*>( mesh.positions ) + array_bytes &&
+                               reinterpret_cast<char*>( mesh.tri_indices ) ==
+                               reinterpret_cast<char*>( mesh.positions ) + vertex_floats*mesh.num_vertices;
+
+  bool ok = contiguous ? readBlock( m_cache, mesh.positions, array_bytes ) :
+            readBlock( m_cache, mesh.positions, 3*sizeof( float )*mesh.num_vertices ) &&
+            ( !mesh.has_normals   || readBlock( m_cache, mesh.normals,   3*sizeof( float )*mesh.num_vertices ) ) &&
+            ( !mesh.has_texcoords || readBlock( m_cache, mesh.texcoords, 2*sizeof( float )*mesh.num_vertices ) ) &&
+            readBlock( m_cache, mesh.tri_indices, 3*sizeof( int32_t )*mesh.num_triangles ) &&
+            readBlock( m_cache, mesh.mat_indices, 1*sizeof( int32_t )*mesh.num_triangles );
+
+  const std::string directory = directoryOfFilePath( m_filename );
+  for( int32_t i = 0; ok && i < mesh.num_materials; ++i )
+  {
+    MaterialParams& mat = mesh.mat_params[i];
+    ok = readString( m_cache, mat.name ) && readString( m_cache, mat.Kd_map ) &&
+         readBlock( m_cache, mat.Kd, sizeof( mat.Kd ) ) && readBlock( m_cache, mat.Ks, sizeof( mat.Ks ) ) &&
+         readBlock( m_cache, mat.Kr, sizeof( mat.Kr ) ) && readBlock( m_cache, mat.Ka, sizeof( mat.Ka ) ) &&
+         readBlock( m_cache, &mat.exp, sizeof( mat.exp ) );
+    if( ok && !mat.Kd_map.empty() )
+      mat.Kd_map = directory + mat.Kd_map;
+  }
+
+  fclose( m_cache );
+  m_cache = 0;
+
+  if( !ok )
+    std::cerr << "MeshLoader - WARNING: truncated mesh cache for '" << m_filename << "', reparsing" << std::endl;
+  return ok;
+}
+
+
 void MeshLoader::Impl::scanMeshPLY( Mesh& mesh )
 {
   p_ply ply = ply_open( m_filename.c_str(), 0 );                       
@@ -381,8 +1059,8 @@ void MeshLoader::Impl::scanMeshPLY( Mesh& mesh )
   mesh.num_vertices  = ply_set_read_cb( ply, "vertex", "x",              NULL, NULL, 0 );
   mesh.has_normals   = ply_set_read_cb( ply, "vertex", "nx",             NULL, NULL, 3 ) != 0;
   mesh.num_triangles = ply_set_read_cb( ply, "face",   "vertex_indices", NULL, NULL, 0 );
-  
-  mesh.has_texcoords = false;
+  mesh.has_texcoords = ply_set_read_cb( ply, "vertex", "u",              NULL, NULL, 6 ) != 0 &&
+                       ply_set_read_cb( ply, "vertex", "v",              NULL, NULL, 7 ) != 0;
   
   mesh.num_materials = 1; // default material
 
@@ -392,28 +1070,55 @@ void MeshLoader::Impl::scanMeshPLY( Mesh& mesh )
 
 void MeshLoader::Impl::loadMeshPLY( Mesh& mesh )
 {
-  p_ply ply = ply_open( m_filename.c_str(), 0 );                       
+  if( !loadBinaryPLY( m_filename, mesh ) )
+  {
+    p_ply ply = ply_open( m_filename.c_str(), 0 );                       
 
-  if( !ply )
-    throw std::runtime_error( "MeshLoader: Unable to open '" + m_filename + "'" );
+    if( !ply )
+      throw std::runtime_error( "MeshLoader: Unable to open '" + m_filename + "'" );
 
-  if( !ply_read_header( ply ) )
-    throw std::runtime_error( "MeshLoader: Unable to read PLY header '" + m_filename + "'" );
-  
-  PlyData ply_data = {0};
-  ply_data.mesh = &mesh;
-
-  ply_set_read_cb( ply, "vertex", "x",  plyLoadVertex, &ply_data, 0 );
-  ply_set_read_cb( ply, "vertex", "y",  plyLoadVertex, &ply_data, 1 );
-  ply_set_read_cb( ply, "vertex", "z",  plyLoadVertex, &ply_data, 2 );
-  ply_set_read_cb( ply, "vertex", "nx", plyLoadVertex, &ply_data, 3 );
-  ply_set_read_cb( ply, "vertex", "ny", plyLoadVertex, &ply_data, 4 );
-  ply_set_read_cb( ply, "vertex", "nz", plyLoadVertex, &ply_data, 5 );
-  ply_set_read_cb( ply, "face", "vertex_indices", plyLoadFace, &ply_data, 0);
-
-  if( !ply_read( ply ) ) 
-    throw std::runtime_error( "MeshLoader: Error parsing ply file (" + m_filename + ")" );
-  ply_close( ply );
+    if( !ply_read_header( ply ) )
+      throw std::runtime_error( "MeshLoader: Unable to read PLY header '" + m_filename + "'" );
+    
+    PlyData ply_data = {0};
+    ply_data.mesh = &mesh;
+
+    // Callbacks come in file order, so a vertex is complete after the last property that is read
+    ply_data.last_coord = PLY_Z;
+    for( p_ply_element element = ply_get_next_element( ply, NULL ); element; element = ply_get_next_element( ply, element ) )
+    {
+      const char* element_name;
+      ply_get_element_info( element, &element_name, NULL );
+      if( strcmp( element_name, "vertex" ) != 0 )
+        continue;
+      for( p_ply_property property = ply_get_next_property( element, NULL ); property;
+           property = ply_get_next_property( element, property ) )
+      {
+        const char* property_name;
+        ply_get_property_info( property, &property_name, NULL, NULL, NULL );
+        for( int i = 0; i < PLY_NUM_PROPERTIES; ++i )
+          if( strcmp( property_name, PLY_PROPERTY_NAMES[i] ) == 0 && ( i < PLY_U || mesh.has_texcoords ) )
+            ply_data.last_coord = i;
+      }
+    }
+
+    ply_set_read_cb( ply, "vertex", "x",  plyLoadVertex, &ply_data, 0 );
+    ply_set_read_cb( ply, "vertex", "y",  plyLoadVertex, &ply_data, 1 );
+    ply_set_read_cb( ply, "vertex", "z",  plyLoadVertex, &ply_data, 2 );
+    ply_set_read_cb( ply, "vertex", "nx", plyLoadVertex, &ply_data, 3 );
+    ply_set_read_cb( ply, "vertex", "ny", plyLoadVertex, &ply_data, 4 );
+    ply_set_read_cb( ply, "vertex", "nz", plyLoadVertex, &ply_data, 5 );
+    if( mesh.has_texcoords )
+    {
+      ply_set_read_cb( ply, "vertex", "u", plyLoadVertex, &ply_data, 6 );
+      ply_set_read_cb( ply, "vertex", "v", plyLoadVertex, &ply_data, 7 );
+    }
+    ply_set_read_cb( ply, "face", "vertex_indices", plyLoadFace, &ply_data, 0);
+
+    if( !ply_read( ply ) ) 
+      throw std::runtime_error( "MeshLoader: Error parsing ply file (" + m_filename + ")" );
+    ply_close( ply );
+  }
 
 
   // Fill in default white matte material
@@ -437,13 +1142,23 @@ void MeshLoader::Impl::scanMeshOBJ( Mesh& mesh )
   if( m_shapes.empty() )
   {
     std::string err;
-    bool ret = tinyobj::LoadObj( 
-        m_shapes,
-        m_materials,
-        err, 
-        m_filename.c_str(),
-        directoryOfFilePath( m_filename ).c_str()
-        );
+    const unsigned int num_threads = objParseThreads( m_filename );
+    bool ret = num_threads > 1 ?
+        loadObjParallel(
+            m_shapes,
+            m_materials,
+            err,
+            m_filename.c_str(),
+            directoryOfFilePath( m_filename ).c_str(),
+            num_threads
+            ) :
+        tinyobj::LoadObj( 
+            m_shapes,
+            m_materials,
+            err, 
+            m_filename.c_str(),
+            directoryOfFilePath( m_filename ).c_str()
+            );
 
     if( !err.empty() )
       std::cerr << err << std::endl;
@@ -590,6 +1305,230 @@ void MeshLoader::Impl::loadMeshOBJ( Mesh& mesh )
 //
 //------------------------------------------------------------------------------
 
+void computeMeshBounds( Mesh& mesh )
+{
+  std::vector<BlockBounds> blocks( numKernelBlocks( mesh.num_vertices ) );
+  sutil::parallelFor( 0, int32_t( blocks.size() ), [&]( int32_t b )
+  {
+    boundsOfRange( mesh.positions, b*MESH_KERNEL_BLOCK, std::min( ( b + 1 )*MESH_KERNEL_BLOCK, mesh.num_vertices ), blocks[b] );
+  } );
+  reduceBounds( blocks, mesh );
+}
+
+
+void transformMesh( Mesh& mesh, const float* xform )
+{
+  const optix::Matrix4x4 mat( xform );
+  const optix::Matrix4x4 mat_normal = mat.inverse().transpose();
+
+  const float* m = mat.getData();        // Row-major.
+  const float* n = mat_normal.getData();
+
+  float*       positions = mesh.positions;
+  float*       normals   = mesh.has_normals ? mesh.normals : 0;
+
+  std::vector<BlockBounds> blocks( numKernelBlocks( mesh.num_vertices ) );
+  sutil::parallelFor( 0, int32_t( blocks.size() ), [&]( int32_t b )
+  {
+    const int32_t first = b*MESH_KERNEL_BLOCK;
+    const int32_t last  = std::min( first + MESH_KERNEL_BLOCK, mesh.num_vertices );
+
+    for( int32_t i = first; i < last; ++i )
+    {
+      const float x = positions[3*i+0];
+      const float y = positions[3*i+1];
+      const float z = positions[3*i+2];
+      positions[3*i+0] = m[0]*x + m[1]*y + m[ 2]*z + m[ 3];
+      positions[3*i+1] = m[4]*x + m[5]*y + m[ 6]*z + m[ 7];
+      positions[3*i+2] = m[8]*x + m[9]*y + m[10]*z + m[11];
+    }
+
+    if( normals )
+    {
+      // Directions ignore the translation. Renormalized because the matrix may scale.
+      for( int32_t i = first; i < last; ++i )
+      {
+        const float x  = normals[3*i+0];
+        const float y  = normals[3*i+1];
+        const float z  = normals[3*i+2];
+        const float nx = n[0]*x + n[1]*y + n[ 2]*z;
+        const float ny = n[4]*x + n[5]*y + n[ 6]*z;
+        const float nz = n[8]*x + n[9]*y + n[10]*z;
+        const float s  = 1.0f / sqrtf( std::max( nx*nx + ny*ny + nz*nz, 1e-30f ) );
+        normals[3*i+0] = nx*s;
+        normals[3*i+1] = ny*s;
+        normals[3*i+2] = nz*s;
+      }
+    }
+
+    boundsOfRange( positions, first, last, blocks[b] );
+  } );
+  reduceBounds( blocks, mesh );
+}
+
+
+void computeSmoothNormals( const float* positions, int32_t num_vertices, const int32_t* tri_indices, int32_t num_triangles, float* normals )
+{
+  // Area weighted face normals, the unnormalized cross products.
+  std::vector<float> face_normals( 3*size_t( num_triangles ) );
+  sutil::parallelFor( 0, numKernelBlocks( num_triangles ), [&]( int32_t b )
+  {
+    const int32_t last = std::min( ( b + 1 )*MESH_KERNEL_BLOCK, num_triangles );
+    for( int32_t t = b*MESH_KERNEL_BLOCK; t < last; ++t )
+    {
+      const float* p0 = positions + 3*tri_indices[3*t+0];
+      const float* p1 = positions + 3*tri_indices[3*t+1];
+      const float* p2 = positions + 3*tri_indices[3*t+2];
+      const float ax = p1[0] - p0[0], ay = p1[1] - p0[1], az = p1[2] - p0[2];
+      const float bx = p2[0] - p0[0], by = p2[1] - p0[1], bz = p2[2] - p0[2];
+      face_normals[3*t+0] = ay*bz - az*by;
+      face_normals[3*t+1] = az*bx - ax*bz;
+      face_normals[3*t+2] = ax*by - ay*bx;
+    }
+  } );
+
+  // Triangles per vertex in compressed rows, so the vertices gather their normal without atomics
+  // and in the same order on every run.
+  std::vector<int32_t> offsets( size_t( num_vertices ) + 1, 0 );
+  for( int32_t i = 0; i < 3*num_triangles; ++i )
+    ++offsets[tri_indices[i] + 1];
+  for( int32_t v = 0; v < num_vertices; ++v )
+    offsets[v + 1] += offsets[v];
+
+  std::vector<int32_t> cursor( offsets.begin(), offsets.end() - 1 );
+  std::vector<int32_t> faces( 3*size_t( num_triangles ) );
+  for( int32_t i = 0; i < 3*num_triangles; ++i )
+    faces[cursor[tri_indices[i]]++] = i / 3;
+
+  sutil::parallelFor( 0, numKernelBlocks( num_vertices ), [&]( int32_t b )
+  {
+    const int32_t last = std::min( ( b + 1 )*MESH_KERNEL_BLOCK, num_vertices );
+    for( int32_t v = b*MESH_KERNEL_BLOCK; v < last; ++v )
+    {
+      float x = 0.0f, y = 0.0f, z = 0.0f;
+      for( int32_t k = offsets[v]; k < offsets[v + 1]; ++k )
+      {
+        const float* f = &face_normals[3*faces[k]];
+        x += f[0];
+        y += f[1];
+        z += f[2];
+      }
+      const float len2 = x*x + y*y + z*z;
+      const float s    = len2 > 0.0f ? 1.0f / sqrtf( len2 ) : 0.0f;
+      normals[3*v+0] = x*s;
+      normals[3*v+1] = y*s;
+      normals[3*v+2] = z*s;
+    }
+  } );
+}
+
+
+int32_t simplifyMesh( const float* positions, int32_t num_vertices, const int32_t* tri_indices, int32_t num_triangles, int32_t grid_resolution, int32_t* out_tri_indices )
+{
+  std::vector<BlockBounds> blocks( numKernelBlocks( num_vertices ) );
+  sutil::parallelFor( 0, int32_t( blocks.size() ), [&]( int32_t b )
+  {
+    boundsOfRange( positions, b*MESH_KERNEL_BLOCK, std::min( ( b + 1 )*MESH_KERNEL_BLOCK, num_vertices ), blocks[b] );
+  } );
+  Mesh bounds;
+  reduceBounds( blocks, bounds );
+
+  const float   extent = std::max( bounds.bbox_max[0] - bounds.bbox_min[0],
+                         std::max( bounds.bbox_max[1] - bounds.bbox_min[1],
+                                   bounds.bbox_max[2] - bounds.bbox_min[2] ) );
+  const int64_t res    = std::max( grid_resolution, 1 );
+  const float   scale  = extent > 0.0f ? float( res ) / extent : 0.0f;
+
+  // Cell of each vertex as one sortable key.
+  std::vector<int64_t> keys( num_vertices );
+  sutil::parallelFor( 0, numKernelBlocks( num_vertices ), [&]( int32_t b )
+  {
+    const int32_t last = std::min( ( b + 1 )*MESH_KERNEL_BLOCK, num_vertices );
+    for( int32_t v = b*MESH_KERNEL_BLOCK; v < last; ++v )
+    {
+      int64_t c[3];
+      for( int k = 0; k < 3; ++k )
+        c[k] = std::min( int64_t( ( positions[3*v+k] - bounds.bbox_min[k] )*scale ), res - 1 );
+      keys[v] = ( c[0]*res + c[1] )*res + c[2];
+    }
+  } );
+
+  std::vector<int32_t> order( num_vertices );
+  for( int32_t v = 0; v < num_vertices; ++v )
+    order[v] = v;
+  std::sort( order.begin(), order.end(), [&]( int32_t a, int32_t b ) { return keys[a] < keys[b] || ( keys[a] == keys[b] && a < b ); } );
+
+  // Each run of equal keys is one cluster, represented by its vertex closest to the mean.
+  std::vector<int32_t> remap( num_vertices );
+  for( int32_t first = 0; first < num_vertices; )
+  {
+    int32_t last = first + 1;
+    while( last < num_vertices && keys[order[last]] == keys[order[first]] )
+      ++last;
+
+    double mean[3] = { 0.0, 0.0, 0.0 };
+    for( int32_t i = first; i < last; ++i )
+      for( int k = 0; k < 3; ++k )
+        mean[k] += positions[3*order[i]+k];
+
+    const double inv  = 1.0 / double( last - first );
+    int32_t      best = order[first];
+    double       dist = 1e300;
+    for( int32_t i = first; i < last; ++i )
+    {
+      const float* p = positions + 3*order[i];
+      const double dx = p[0] - mean[0]*inv, dy = p[1] - mean[1]*inv, dz = p[2] - mean[2]*inv;
+      const double d  = dx*dx + dy*dy + dz*dz;
+      if( d < dist )
+      {
+        dist = d;
+        best = order[i];
+      }
+    }
+    for( int32_t i = first; i < last; ++i )
+      remap[order[i]] = best;
+
+    first = last;
+  }
+
+  // Rotated so the smallest index comes first, which keeps the winding and makes duplicates equal.
+  struct Triangle
+  {
+    int32_t v[3];
+    bool operator<( const Triangle& t ) const
+    {
+      return v[0] < t.v[0] || ( v[0] == t.v[0] && ( v[1] < t.v[1] || ( v[1] == t.v[1] && v[2] < t.v[2] ) ) );
+    }
+    bool operator==( const Triangle& t ) const { return v[0] == t.v[0] && v[1] == t.v[1] && v[2] == t.v[2]; }
+  };
+
+  std::vector<Triangle> triangles;
+  triangles.reserve( num_triangles );
+  for( int32_t t = 0; t < num_triangles; ++t )
+  {
+    const int32_t a = remap[tri_indices[3*t+0]];
+    const int32_t b = remap[tri_indices[3*t+1]];
+    const int32_t c = remap[tri_indices[3*t+2]];
+    if( a == b || b == c || c == a )
+      continue;
+
+    Triangle tri;
+    if( a < b && a < c )      { tri.v[0] = a; tri.v[1] = b; tri.v[2] = c; }
+    else if( b < c )          { tri.v[0] = b; tri.v[1] = c; tri.v[2] = a; }
+    else                      { tri.v[0] = c; tri.v[1] = a; tri.v[2] = b; }
+    triangles.push_back( tri );
+  }
+  std::sort( triangles.begin(), triangles.end() );
+  triangles.erase( std::unique( triangles.begin(), triangles.end() ), triangles.end() );
+
+  for( size_t t = 0; t < triangles.size(); ++t )
+    for( int k = 0; k < 3; ++k )
+      out_tri_indices[3*t+k] = triangles[t].v[k];
+
+  return int32_t( triangles.size() );
+}
+
+
 void printMaterialInfo( const MaterialParams& mat, std::ostream& out )
 {
   out << "MaterialParams[ " << mat.name << " ]:" << std::endl
@@ -679,6 +1618,184 @@ SUTILAPI void freeMesh( Mesh& mesh )
 }
 
 
+//------------------------------------------------------------------------------
+//
+//  MeshArena
+//
+//------------------------------------------------------------------------------
+
+class MeshArena::Impl
+{
+public:
+  struct Block
+  {
+    char*  data;
+    size_t size;
+  };
+
+  explicit Impl( size_t block_size )
+    : m_block_size( block_size ),
+      m_current( 0 ),
+      m_used( 0 )
+  {}
+
+  ~Impl()
+  {
+    release();
+  }
+
+  void* allocate( size_t size, size_t alignment )
+  {
+    // Find room in the current block or the next kept one, else append a block
+    for( ; m_current < m_blocks.size(); ++m_current, m_used = 0 )
+    {
+      const Block& block  = m_blocks[m_current];
+      const size_t offset = alignUp( reinterpret_cast<size_t>( block.data ) + m_used, alignment ) -
+                            reinterpret_cast<size_t>( block.data );
+      if( offset + size <= block.size )
+      {
+        m_used = offset + size;
+        return block.data + offset;
+      }
+    }
+
+    Block block;
+    block.size = std::max( m_block_size, size + alignment );
+    block.data = new char[block.size];
+    m_blocks.push_back( block );
+
+    const size_t offset = alignUp( reinterpret_cast<size_t>( block.data ), alignment ) -
+                          reinterpret_cast<size_t>( block.data );
+    m_current = m_blocks.size() - 1;
+    m_used    = offset + size;
+    return block.data + offset;
+  }
+
+  MaterialParams* allocateMaterials( int32_t count )
+  {
+    if( count <= 0 )
+      return 0;
+
+    // MaterialParams holds strings, which have to be constructed and destroyed in place
+    MaterialParams* materials = static_cast<MaterialParams*>( allocate( count*sizeof( MaterialParams ), alignof( MaterialParams ) ) );
+    for( int32_t i = 0; i < count; ++i )
+      new( materials + i ) MaterialParams();
+    m_materials.push_back( std::make_pair( materials, count ) );
+    return materials;
+  }
+
+  void reset()
+  {
+    for( size_t i = 0; i < m_materials.size(); ++i )
+      for( int32_t j = 0; j < m_materials[i].second; ++j )
+        m_materials[i].first[j].~MaterialParams();
+    m_materials.clear();
+
+    m_current = 0;
+    m_used    = 0;
+  }
+
+  void release()
+  {
+    reset();
+    for( size_t i = 0; i < m_blocks.size(); ++i )
+      delete [] m_blocks[i].data;
+    m_blocks.clear();
+  }
+
+  size_t bytesReserved() const
+  {
+    size_t bytes = 0;
+    for( size_t i = 0; i < m_blocks.size(); ++i )
+      bytes += m_blocks[i].size;
+    return bytes;
+  }
+
+private:
+  static size_t alignUp( size_t value, size_t alignment )
+  {
+    return ( value + alignment - 1 ) / alignment * alignment;
+  }
+
+  size_t                                          m_block_size;
+  std::vector<Block>                              m_blocks;
+  size_t                                          m_current;   // Block the next allocation is tried in first
+  size_t                                          m_used;      // Bytes used in the current block
+  std::vector< std::pair<MaterialParams*, int32_t> > m_materials; // Constructed in place, destroyed by reset()
+};
+
+
+MeshArena::MeshArena( size_t block_size )
+  : p_impl( new Impl( block_size ) )
+{
+}
+
+
+MeshArena::~MeshArena()
+{
+  delete p_impl;
+}
+
+
+void* MeshArena::allocate( size_t size, size_t alignment )
+{
+  return p_impl->allocate( size, alignment );
+}
+
+
+MaterialParams* MeshArena::allocateMaterials( int32_t count )
+{
+  return p_impl->allocateMaterials( count );
+}
+
+
+void MeshArena::reset()
+{
+  p_impl->reset();
+}
+
+
+void MeshArena::release()
+{
+  p_impl->release();
+}
+
+
+size_t MeshArena::bytesReserved() const
+{
+  return p_impl->bytesReserved();
+}
+
+
+SUTILAPI void allocMesh( Mesh& mesh, MeshArena& arena )
+{
+  if( mesh.num_vertices == 0 || mesh.num_triangles == 0 )
+  {
+    clearMesh( mesh );
+    return;
+  }
+
+  // One allocation in the order of the binary mesh cache. All arrays hold 4 byte elements,
+  // so they follow each other without padding.
+  const size_t num_vertices  = static_cast<size_t>( mesh.num_vertices );
+  const size_t num_triangles = static_cast<size_t>( mesh.num_triangles );
+  const size_t vertex_floats = 3 + ( mesh.has_normals ? 3 : 0 ) + ( mesh.has_texcoords ? 2 : 0 );
+
+  float* data = static_cast<float*>( arena.allocate( ( vertex_floats*num_vertices + 4*num_triangles )*sizeof( float ) ) );
+
+  mesh.positions   = data;
+  data += 3*num_vertices;
+  mesh.normals     = mesh.has_normals   ? data : 0;
+  data += mesh.has_normals ? 3*num_vertices : 0;
+  mesh.texcoords   = mesh.has_texcoords ? data : 0;
+  data += mesh.has_texcoords ? 2*num_vertices : 0;
+  mesh.tri_indices = reinterpret_cast<int32_t*>( data );
+  mesh.mat_indices = mesh.tri_indices + 3*num_triangles;
+
+  mesh.mat_params  = arena.allocateMaterials( mesh.num_materials );
+}
+
+
 //------------------------------------------------------------------------------
 //
 //  Mesh API MeshLoader class 
@@ -708,6 +1825,12 @@ void MeshLoader::loadMesh( Mesh& mesh, const float* load_xform )
   p_impl->loadMesh( mesh, load_xform );
 }
 
+
+void MeshLoader::setSpatialSort( bool sort )
+{
+  p_impl->setSpatialSort( sort );
+}
+
 //------------------------------------------------------------------------------
 //
 // Mesh Loader convenience  functions
@@ -722,3 +1845,12 @@ void loadMesh( const std::string& filename, Mesh& mesh, const float* xform )
     allocMesh( mesh );
     loader.loadMesh( mesh, xform );
 }
+
+
+void loadMesh( const std::string& filename, Mesh& mesh, MeshArena& arena, const float* xform )
+{
+    MeshLoader loader( filename );
+    loader.scanMesh( mesh );
+    allocMesh( mesh, arena );
+    loader.loadMesh( mesh, xform );
+}
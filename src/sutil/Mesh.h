@@ -97,6 +97,62 @@ SUTILAPI void allocMesh( Mesh& mesh );
 // Calls std lib delete on non-null arrays in mesh
 SUTILAPI void freeMesh( Mesh& mesh );
 
+
+//------------------------------------------------------------------------------
+//
+// Arena for the arrays of many meshes
+//
+//------------------------------------------------------------------------------
+
+// Places mesh arrays in a few large blocks instead of one heap allocation per array.
+// All allocations are released together by reset(), which keeps the blocks for the
+// next meshes, by release() or by the destructor.
+class MeshArena
+{
+public:
+  SUTILAPI explicit MeshArena( size_t block_size = 16u << 20 );
+  SUTILAPI ~MeshArena();
+
+  // Allocations larger than the block size get a block of their own
+  SUTILAPI void*           allocate( size_t size, size_t alignment = 16 );
+  SUTILAPI MaterialParams* allocateMaterials( int32_t count );
+
+  SUTILAPI void   reset();
+  SUTILAPI void   release();
+  SUTILAPI size_t bytesReserved() const;
+
+private:
+  MeshArena( const MeshArena& );
+  MeshArena& operator=( const MeshArena& );
+
+  class Impl;
+  Impl* p_impl;
+};
+
+// Allocates the arrays of the mesh from the arena, back to back in the order of the
+// binary mesh cache so the loader reads a cached mesh with a single read.
+// Assumes the same counts initialized as allocMesh(). Do not freeMesh() such a mesh,
+// its memory belongs to the arena.
+SUTILAPI void allocMesh( Mesh& mesh, MeshArena& arena );
+
+// Parallel geometry passes on the sutil::TaskPool threads.
+// Recomputes bbox_min and bbox_max from the positions.
+SUTILAPI void computeMeshBounds( Mesh& mesh );
+
+// Transforms the positions by the row-major 4x4 matrix and the normals by its inverse transpose,
+// renormalized, and recomputes the bounds.
+SUTILAPI void transformMesh( Mesh& mesh, const float* xform );
+
+// Area weighted vertex normals of an indexed triangle mesh, 3 floats per vertex.
+// Vertices without any non-degenerate triangle get a zero normal.
+SUTILAPI void computeSmoothNormals( const float* positions, int32_t num_vertices, const int32_t* tri_indices, int32_t num_triangles, float* normals );
+
+// Vertex clustering for coarser levels of detail. The bounds are cut into cubic cells, grid_resolution along the
+// longest axis, and the vertices of each cell collapse onto the one closest to their mean, so the attributes of the
+// kept vertices stay valid. Writes the remaining non-degenerate, unique triangles as indices of the original vertices
+// to out_tri_indices (room for num_triangles) and returns their number.
+SUTILAPI int32_t simplifyMesh( const float* positions, int32_t num_vertices, const int32_t* tri_indices, int32_t num_triangles, int32_t grid_resolution, int32_t* out_tri_indices );
+
 SUTILAPI void printMaterialInfo( const MaterialParams& mat, std::ostream& out = std::cout );
 SUTILAPI void printMeshInfo    ( const Mesh& mesh,          std::ostream& out = std::cout );
 
@@ -114,6 +170,10 @@ public:
   SUTILAPI void scanMesh( Mesh& mesh );
   SUTILAPI void loadMesh( Mesh& mesh, const float* load_xform=0 );
 
+  // Reorders triangles along a Morton curve and vertices by first use after loading.
+  // Off unless SUTIL_MESH_SORT=1 is set.
+  SUTILAPI void setSpatialSort( bool sort );
+
 private:
   class Impl;
   Impl* p_impl;
@@ -130,6 +190,9 @@ private:
 // Load mesh using std lib new for allocations
 SUTILAPI void loadMesh( const std::string& filename, Mesh& mesh, const float* load_xform=0 );
 
+// Load mesh with its arrays allocated from the arena
+SUTILAPI void loadMesh( const std::string& filename, Mesh& mesh, MeshArena& arena, const float* load_xform=0 );
+
 
 
 //------------------------------------------------------------------------------
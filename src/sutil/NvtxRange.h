@@ -0,0 +1,77 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Optional NVTX annotations, so that Nsight Systems shows named ranges for the host phases and launches of the samples.
+// Configure with SAMPLES_USE_NVTX=ON to compile them in, otherwise the macros expand to nothing.
+//
+//   SUTIL_NVTX_RANGE( "createScene" );   // Range from here to the end of the enclosing scope.
+//   SUTIL_NVTX_PUSH( "launch" ); ... SUTIL_NVTX_POP();
+
+#ifdef SUTIL_USE_NVTX
+
+#include <nvToolsExt.h>
+
+namespace sutil
+{
+
+class NvtxRange
+{
+public:
+    explicit NvtxRange( const char* name )
+    {
+        nvtxRangePushA( name );
+    }
+
+    ~NvtxRange()
+    {
+        nvtxRangePop();
+    }
+
+private:
+    NvtxRange( const NvtxRange& );            // Not copyable.
+    NvtxRange& operator=( const NvtxRange& );
+};
+
+} // end namespace sutil
+
+#define SUTIL_NVTX_CONCAT_IMPL( a, b ) a##b
+#define SUTIL_NVTX_CONCAT( a, b ) SUTIL_NVTX_CONCAT_IMPL( a, b )
+
+#define SUTIL_NVTX_RANGE( name ) sutil::NvtxRange SUTIL_NVTX_CONCAT( nvtxRange, __LINE__ )( name )
+#define SUTIL_NVTX_PUSH( name )  nvtxRangePushA( name )
+#define SUTIL_NVTX_POP()         nvtxRangePop()
+
+#else
+
+#define SUTIL_NVTX_RANGE( name )
+#define SUTIL_NVTX_PUSH( name )
+#define SUTIL_NVTX_POP()
+
+#endif
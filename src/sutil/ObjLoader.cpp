@@ -0,0 +1,444 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ObjLoader.h"
+#include "TaskPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+#include <unordered_map>
+
+
+namespace
+{
+
+struct VertexIndex
+{
+  int v, vt, vn;
+
+  bool operator==( const VertexIndex& other ) const
+  {
+    return v == other.v && vt == other.vt && vn == other.vn;
+  }
+};
+
+struct VertexIndexHash
+{
+  size_t operator()( const VertexIndex& i ) const
+  {
+    return ( static_cast<size_t>( i.v ) * 73856093u ) ^ ( static_cast<size_t>( i.vt ) * 19349663u ) ^
+           ( static_cast<size_t>( i.vn ) * 83492791u );
+  }
+};
+
+const int INHERIT_MATERIAL = -2;  // Material of the previous chunk's last group
+
+// Faces between two usemtl, g or o lines of one chunk
+struct FaceGroup
+{
+  std::vector<VertexIndex> vertices;    // Face corners, in face order
+  std::vector<int>         face_sizes;  // Corners per face
+  int                      material;
+  bool                     inherit_name;
+  std::string              name;
+};
+
+struct Chunk
+{
+  const char*              begin;
+  const char*              end;
+
+  // First pass
+  size_t                   num_v;
+  size_t                   num_vn;
+  size_t                   num_vt;
+  std::vector<std::string> mtllibs;
+
+  // Second pass
+  size_t                   v_base;
+  size_t                   vn_base;
+  size_t                   vt_base;
+  std::vector<FaceGroup>   groups;
+  std::string              error;
+
+  // Third pass, one shape per non-empty group
+  std::vector<tinyobj::shape_t> shapes;
+};
+
+
+inline bool isSpace( char c )
+{
+  return c == ' ' || c == '\t';
+}
+
+
+inline const char* skipSpace( const char* p )
+{
+  while( isSpace( *p ) )
+    ++p;
+  return p;
+}
+
+
+inline const char* nextLine( const char* p, const char* end )
+{
+  while( p < end && *p != '\n' )
+    ++p;
+  return p < end ? p + 1 : end;
+}
+
+
+// Same convention as tinyobjloader: 1 based, negative relative to the current count
+inline int fixIndex( int idx, size_t n )
+{
+  if( idx > 0 )
+    return idx - 1;
+  if( idx == 0 )
+    return 0;
+  return static_cast<int>( n ) + idx;
+}
+
+
+// Reads the first whitespace delimited word, as sscanf( "%s" ) in tinyobjloader
+std::string parseWord( const char* p )
+{
+  p = skipSpace( p );
+  const char* q = p;
+  while( *q && !isSpace( *q ) && *q != '\r' && *q != '\n' )
+    ++q;
+  return std::string( p, q );
+}
+
+
+// Reads up to count floats, missing values are 0
+const char* parseFloats( const char* p, float* out, int count )
+{
+  for( int i = 0; i < count; ++i )
+  {
+    char* q;
+    out[i] = strtof( p, &q );
+    p = q;
+  }
+  return p;
+}
+
+
+void countChunk( Chunk& chunk )
+{
+  chunk.num_v = chunk.num_vn = chunk.num_vt = 0;
+  for( const char* line = chunk.begin; line < chunk.end; line = nextLine( line, chunk.end ) )
+  {
+    const char* p = skipSpace( line );
+    if( p[0] == 'v' )
+    {
+      if( isSpace( p[1] ) )
+        ++chunk.num_v;
+      else if( p[1] == 'n' && isSpace( p[2] ) )
+        ++chunk.num_vn;
+      else if( p[1] == 't' && isSpace( p[2] ) )
+        ++chunk.num_vt;
+    }
+    else if( strncmp( p, "mtllib", 6 ) == 0 && isSpace( p[6] ) )
+    {
+      chunk.mtllibs.push_back( parseWord( p + 7 ) );
+    }
+  }
+}
+
+
+void parseChunk( Chunk& chunk, const std::map<std::string, int>& material_map,
+                 std::vector<float>& v, std::vector<float>& vn, std::vector<float>& vt )
+{
+  size_t num_v  = chunk.v_base;
+  size_t num_vn = chunk.vn_base;
+  size_t num_vt = chunk.vt_base;
+
+  chunk.groups.push_back( FaceGroup() );
+  chunk.groups.back().material = INHERIT_MATERIAL;
+  chunk.groups.back().inherit_name = true;
+
+  for( const char* line = chunk.begin; line < chunk.end; line = nextLine( line, chunk.end ) )
+  {
+    const char* p = skipSpace( line );
+
+    if( p[0] == 'v' && isSpace( p[1] ) )
+    {
+      parseFloats( p + 2, &v[3*num_v++], 3 );
+    }
+    else if( p[0] == 'v' && p[1] == 'n' && isSpace( p[2] ) )
+    {
+      parseFloats( p + 3, &vn[3*num_vn++], 3 );
+    }
+    else if( p[0] == 'v' && p[1] == 't' && isSpace( p[2] ) )
+    {
+      parseFloats( p + 3, &vt[2*num_vt++], 2 );
+    }
+    else if( p[0] == 'f' && isSpace( p[1] ) )
+    {
+      FaceGroup& group = chunk.groups.back();
+      int corners = 0;
+      p = skipSpace( p + 2 );
+      while( *p && *p != '\r' && *p != '\n' )
+      {
+        // v, v/vt, v//vn or v/vt/vn
+        VertexIndex vi = { -1, -1, -1 };
+        vi.v = fixIndex( atoi( p ), num_v );
+        p += strcspn( p, "/ \t\r\n" );
+        if( *p == '/' )
+        {
+          ++p;
+          if( *p != '/' )
+          {
+            vi.vt = fixIndex( atoi( p ), num_vt );
+            p += strcspn( p, "/ \t\r\n" );
+          }
+          if( *p == '/' )
+          {
+            ++p;
+            vi.vn = fixIndex( atoi( p ), num_vn );
+            p += strcspn( p, "/ \t\r\n" );
+          }
+        }
+        group.vertices.push_back( vi );
+        ++corners;
+        p = skipSpace( p );
+      }
+      group.face_sizes.push_back( corners );
+    }
+    else if( ( strncmp( p, "usemtl", 6 ) == 0 && isSpace( p[6] ) ) ||
+             ( p[0] == 'g' && isSpace( p[1] ) ) ||
+             ( p[0] == 'o' && isSpace( p[1] ) ) )
+    {
+      const FaceGroup& previous = chunk.groups.back();
+      FaceGroup group;
+      group.material     = previous.material;
+      group.inherit_name = previous.inherit_name;
+      group.name         = previous.name;
+
+      if( p[0] == 'u' )
+      {
+        std::map<std::string, int>::const_iterator it = material_map.find( parseWord( p + 7 ) );
+        group.material = it != material_map.end() ? it->second : -1;
+      }
+      else
+      {
+        // tinyobjloader keeps the first name after 'g' and the word after 'o'
+        group.inherit_name = false;
+        group.name = parseWord( p + 1 );
+      }
+      chunk.groups.push_back( group );
+    }
+  }
+}
+
+
+// Triangulates and deduplicates the faces of each group, as exportFaceGroupToShape() in tinyobjloader
+void buildShapes( Chunk& chunk, const std::vector<float>& v, const std::vector<float>& vn,
+                  const std::vector<float>& vt )
+{
+  std::unordered_map<VertexIndex, unsigned int, VertexIndexHash> cache;
+  for( size_t g = 0; g < chunk.groups.size(); ++g )
+  {
+    const FaceGroup& group = chunk.groups[g];
+    if( group.face_sizes.empty() )
+      continue;
+
+    chunk.shapes.push_back( tinyobj::shape_t() );
+    tinyobj::shape_t& shape = chunk.shapes.back();
+    shape.name = group.name;
+    tinyobj::mesh_t& mesh = shape.mesh;
+    cache.clear();
+
+    size_t corner = 0;
+    for( size_t f = 0; f < group.face_sizes.size(); ++f )
+    {
+      const VertexIndex* face = &group.vertices[corner];
+      const int n = group.face_sizes[f];
+      corner += n;
+
+      for( int k = 0; k < n; ++k )
+      {
+        const VertexIndex& vi = face[k];
+        if( vi.v < 0 || size_t( vi.v ) >= v.size() / 3 ||
+            ( vi.vn >= 0 && size_t( vi.vn ) >= vn.size() / 3 ) ||
+            ( vi.vt >= 0 && size_t( vi.vt ) >= vt.size() / 2 ) )
+        {
+          chunk.error = "Face index out of range";
+          return;
+        }
+      }
+
+      // Polygon -> triangle fan conversion
+      for( int k = 2; k < n; ++k )
+      {
+        const VertexIndex corners[3] = { face[0], face[k-1], face[k] };
+        for( int c = 0; c < 3; ++c )
+        {
+          const VertexIndex& vi = corners[c];
+          std::pair<std::unordered_map<VertexIndex, unsigned int, VertexIndexHash>::iterator, bool> inserted =
+              cache.insert( std::make_pair( vi, static_cast<unsigned int>( mesh.positions.size() / 3 ) ) );
+          if( inserted.second )
+          {
+            mesh.positions.insert( mesh.positions.end(), &v[3*vi.v], &v[3*vi.v] + 3 );
+            if( vi.vn >= 0 )
+              mesh.normals.insert( mesh.normals.end(), &vn[3*vi.vn], &vn[3*vi.vn] + 3 );
+            if( vi.vt >= 0 )
+              mesh.texcoords.insert( mesh.texcoords.end(), &vt[2*vi.vt], &vt[2*vi.vt] + 2 );
+          }
+          mesh.indices.push_back( inserted.first->second );
+        }
+        mesh.material_ids.push_back( group.material );
+      }
+    }
+  }
+}
+
+
+// One task per chunk on the shared sutil::TaskPool
+template <typename F>
+void runChunks( std::vector<Chunk>& chunks, F f )
+{
+  sutil::parallelFor( size_t( 0 ), chunks.size(), [&]( size_t c ) { f( chunks[c] ); } );
+}
+
+} // namespace
+
+
+bool loadObjParallel( std::vector<tinyobj::shape_t>&    shapes,
+                      std::vector<tinyobj::material_t>& materials,
+                      std::string&                      err,
+                      const char*                       filename,
+                      const char*                       mtl_basepath,
+                      unsigned int                      num_threads )
+{
+  shapes.clear();
+  num_threads = std::max( num_threads, 1u );
+
+  // Read the whole file, terminated so that line parsing can stop at '\0'
+  std::vector<char> data;
+  {
+    FILE* file = fopen( filename, "rb" );
+    if( !file )
+    {
+      err = std::string( "Cannot open file [" ) + filename + "]\n";
+      return false;
+    }
+    fseek( file, 0, SEEK_END );
+    const long size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    data.resize( static_cast<size_t>( std::max( size, 0l ) ) + 2 );
+    const size_t num_read = fread( &data[0], 1, data.size() - 2, file );
+    fclose( file );
+    data.resize( num_read + 2 );
+    data[num_read]   = '\n';
+    data[num_read+1] = '\0';
+  }
+  const char* end = &data[0] + data.size() - 1;
+
+  // Chunks start after a newline
+  std::vector<Chunk> chunks( num_threads );
+  const char* begin = &data[0];
+  for( unsigned int c = 0; c < num_threads; ++c )
+  {
+    const char* split = &data[0] + ( data.size() - 1 ) * ( c + 1 ) / num_threads;
+    chunks[c].begin = begin;
+    chunks[c].end   = c + 1 == num_threads ? end : nextLine( std::max( begin, split ), end );
+    begin = chunks[c].end;
+  }
+
+  runChunks( chunks, countChunk );
+
+  size_t num_v = 0, num_vn = 0, num_vt = 0;
+  for( size_t c = 0; c < chunks.size(); ++c )
+  {
+    chunks[c].v_base  = num_v;
+    chunks[c].vn_base = num_vn;
+    chunks[c].vt_base = num_vt;
+    num_v  += chunks[c].num_v;
+    num_vn += chunks[c].num_vn;
+    num_vt += chunks[c].num_vt;
+  }
+
+  // Materials are loaded up front, so usemtl also finds materials of a later mtllib
+  std::map<std::string, int> material_map;
+  tinyobj::MaterialFileReader read_material( mtl_basepath ? mtl_basepath : "" );
+  for( size_t c = 0; c < chunks.size(); ++c )
+    for( size_t i = 0; i < chunks[c].mtllibs.size(); ++i )
+    {
+      std::string err_mtl;
+      read_material( chunks[c].mtllibs[i], materials, material_map, err_mtl );
+      err += err_mtl;
+    }
+
+  std::vector<float> v( 3*num_v ), vn( 3*num_vn ), vt( 2*num_vt );
+  runChunks( chunks, [&]( Chunk& chunk ) { parseChunk( chunk, material_map, v, vn, vt ); } );
+
+  // Groups at the start of a chunk continue the material and name of the previous chunk
+  int material = -1;
+  std::string name;
+  for( size_t c = 0; c < chunks.size(); ++c )
+  {
+    for( size_t g = 0; g < chunks[c].groups.size(); ++g )
+    {
+      FaceGroup& group = chunks[c].groups[g];
+      if( group.material == INHERIT_MATERIAL )
+        group.material = material;
+      if( group.inherit_name )
+        group.name = name;
+      material = group.material;
+      name = group.name;
+    }
+  }
+
+  runChunks( chunks, [&]( Chunk& chunk ) { buildShapes( chunk, v, vn, vt ); } );
+
+  for( size_t c = 0; c < chunks.size(); ++c )
+  {
+    if( !chunks[c].error.empty() )
+    {
+      err += chunks[c].error + " in [" + filename + "]\n";
+      return false;
+    }
+    shapes.insert( shapes.end(), chunks[c].shapes.begin(), chunks[c].shapes.end() );
+  }
+
+  if( materials.empty() )
+  {
+    // Same default as tinyobj::LoadObj()
+    tinyobj::material_t mat;
+    std::map<std::string, int> default_map;
+    std::istringstream empty;
+    tinyobj::LoadMtl( default_map, materials, empty );
+  }
+  return true;
+}
@@ -0,0 +1,49 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "tinyobjloader/tiny_obj_loader.h"
+
+#include <string>
+#include <vector>
+
+
+// Multi-threaded alternative to tinyobj::LoadObj() for large OBJ files, used by MeshLoader.
+//
+// The file is read in one piece and split into chunks at line boundaries.  A first pass counts the
+// vertex attributes of each chunk so that every chunk knows the absolute index of its first vertex,
+// then all chunks parse their attributes and faces concurrently, and a final pass builds the shapes
+// once every referenced vertex is known.  Shapes, vertex deduplication, triangulation and materials
+// follow tinyobjloader, except that a shape crossing a chunk boundary is split in two.
+bool loadObjParallel( std::vector<tinyobj::shape_t>&    shapes,     // [output]
+                      std::vector<tinyobj::material_t>& materials,  // [output]
+                      std::string&                      err,        // [output]
+                      const char*                       filename,
+                      const char*                       mtl_basepath,
+                      unsigned int                      num_threads );
@@ -33,6 +33,7 @@
 #include "sutil.h"
 #include <algorithm>
 #include <cstring>
+#include <map>
 #include <stdexcept>
 
 namespace optix {
@@ -56,6 +57,62 @@ struct MeshBuffers
 };
 
 
+// Identifies materials that createOptiXMaterial() would set up identically
+struct MaterialKey
+{
+  RTprogram   closest_hit;
+  RTprogram   any_hit;
+  bool        use_textures;
+  std::string Kd_map;
+  float       params[13];   // Kd, Ks, Kr, Ka, exp
+
+  MaterialKey( optix::Program closest_hit_program, optix::Program any_hit_program, const MaterialParams& mat_params,
+               bool textured )
+    : closest_hit( closest_hit_program->get() ),
+      any_hit( any_hit_program->get() ),
+      use_textures( textured ),
+      Kd_map( textured ? mat_params.Kd_map : std::string() )
+  {
+    memcpy( params + 0, mat_params.Kd, sizeof( mat_params.Kd ) );
+    memcpy( params + 3, mat_params.Ks, sizeof( mat_params.Ks ) );
+    memcpy( params + 6, mat_params.Kr, sizeof( mat_params.Kr ) );
+    memcpy( params + 9, mat_params.Ka, sizeof( mat_params.Ka ) );
+    params[12] = mat_params.exp;
+  }
+
+  bool operator<( const MaterialKey& other ) const
+  {
+    if( closest_hit != other.closest_hit )
+      return closest_hit < other.closest_hit;
+    if( any_hit != other.any_hit )
+      return any_hit < other.any_hit;
+    if( use_textures != other.use_textures )
+      return use_textures < other.use_textures;
+    if( Kd_map != other.Kd_map )
+      return Kd_map < other.Kd_map;
+    return memcmp( params, other.params, sizeof( params ) ) < 0;
+  }
+};
+
+
+} // namespace end
+
+
+// Programs and materials shared by the meshes which hold the cache
+struct OptiXMeshCache
+{
+  RTcontext                              context;         // The programs and materials belong to this context
+  optix::Program                         bounds;
+  optix::Program                         intersection;
+  optix::Program                         closest_hit[2];  // Indexed by use_textures
+  optix::Program                         any_hit;
+  std::map<MaterialKey, optix::Material> materials;
+};
+
+
+namespace
+{
+
 void setupMeshLoaderInputs(
     optix::Context            context, 
     MeshBuffers&              buffers,
@@ -103,6 +160,7 @@ void unmap( MeshBuffers& buffers, Mesh& mesh )
 
 void createMaterialPrograms(
     optix::Context         context,
+    OptiXMeshCache&        cache,
     bool                   use_textures,
     optix::Program&        closest_hit,
     optix::Program&        any_hit
@@ -115,20 +173,36 @@ void createMaterialPrograms(
                                    "closest_hit_radiance";
 
   if( !closest_hit )
-      closest_hit = context->createProgramFromPTXFile( path, closest_name );
+  {
+    if( !cache.closest_hit[use_textures] )
+      cache.closest_hit[use_textures] = sutil::createProgramFromPTXFile( context, path, closest_name );
+    closest_hit = cache.closest_hit[use_textures];
+  }
   if( !any_hit )
-      any_hit     = context->createProgramFromPTXFile( path, "any_hit_shadow" );
+  {
+    if( !cache.any_hit )
+      cache.any_hit = sutil::createProgramFromPTXFile( context, path, "any_hit_shadow" );
+    any_hit = cache.any_hit;
+  }
 }
 
 
 optix::Material createOptiXMaterial(
     optix::Context         context,
+    OptiXMeshCache&        cache,
     optix::Program         closest_hit,
     optix::Program         any_hit,
     const MaterialParams&  mat_params,
     bool                   use_textures
     )
 {
+  // Meshes with the same material parameters share one Material and its texture
+  const MaterialKey key( closest_hit, any_hit, mat_params, use_textures );
+  std::map<MaterialKey, optix::Material>& materials = cache.materials;
+  std::map<MaterialKey, optix::Material>::const_iterator cached = materials.find( key );
+  if( cached != materials.end() )
+    return cached->second;
+
   optix::Material mat = context->createMaterial();
   mat->setClosestHitProgram( 0u, closest_hit );             
   mat->setAnyHitProgram( 1u, any_hit ) ;    
@@ -145,23 +219,32 @@ optix::Material createOptiXMaterial(
   mat[ "Ka"        ]->set3fv( mat_params.Ka );
   mat[ "phong_exp" ]->setFloat( mat_params.exp );
 
+  materials[ key ] = mat;
   return mat;
 }
 
 
-optix::Program createBoundingBoxProgram( optix::Context context )
+optix::Program createBoundingBoxProgram( optix::Context context, OptiXMeshCache& cache )
 {
-  std::string path = std::string( sutil::samplesPTXDir() ) +
-                     "/cuda_compile_ptx_generated_triangle_mesh.cu.ptx";
-  return context->createProgramFromPTXFile( path, "mesh_bounds" );
+  if( !cache.bounds )
+  {
+    std::string path = std::string( sutil::samplesPTXDir() ) +
+                       "/cuda_compile_ptx_generated_triangle_mesh.cu.ptx";
+    cache.bounds = sutil::createProgramFromPTXFile( context, path, "mesh_bounds" );
+  }
+  return cache.bounds;
 }
 
 
-optix::Program createIntersectionProgram( optix::Context context )
+optix::Program createIntersectionProgram( optix::Context context, OptiXMeshCache& cache )
 {
-  std::string path = std::string( sutil::samplesPTXDir() ) +
-                     "/cuda_compile_ptx_generated_triangle_mesh.cu.ptx";
-  return context->createProgramFromPTXFile( path, "mesh_intersect" );
+  if( !cache.intersection )
+  {
+    std::string path = std::string( sutil::samplesPTXDir() ) +
+                       "/cuda_compile_ptx_generated_triangle_mesh.cu.ptx";
+    cache.intersection = sutil::createProgramFromPTXFile( context, path, "mesh_intersect" );
+  }
+  return cache.intersection;
 }
 
 
@@ -171,7 +254,8 @@ void translateMeshToOptiX(
     OptiXMesh&         optix_mesh
     )
 {
-  optix::Context ctx       = optix_mesh.context;
+  optix::Context  ctx      = optix_mesh.context;
+  OptiXMeshCache& cache    = *optix_mesh.cache;
   optix_mesh.bbox_min      = optix::make_float3( mesh.bbox_min );
   optix_mesh.bbox_max      = optix::make_float3( mesh.bbox_max );
   optix_mesh.num_triangles = mesh.num_triangles;
@@ -193,11 +277,12 @@ void translateMeshToOptiX(
 
     optix::Program closest_hit = optix_mesh.closest_hit;
     optix::Program any_hit     = optix_mesh.any_hit;
-    createMaterialPrograms( ctx, have_textures, closest_hit, any_hit );
+    createMaterialPrograms( ctx, cache, have_textures, closest_hit, any_hit );
 
     for( int32_t i = 0; i < mesh.num_materials; ++i )
       optix_materials.push_back( createOptiXMaterial(
             ctx,
+            cache,
             closest_hit,
             any_hit,
             mesh.mat_params[i],
@@ -213,10 +298,10 @@ void translateMeshToOptiX(
   geometry->setPrimitiveCount     ( mesh.num_triangles );
   geometry->setBoundingBoxProgram ( optix_mesh.bounds ?
                                     optix_mesh.bounds :
-                                    createBoundingBoxProgram( ctx ) );
+                                    createBoundingBoxProgram( ctx, cache ) );
   geometry->setIntersectionProgram( optix_mesh.intersection ?
                                     optix_mesh.intersection :
-                                    createIntersectionProgram( ctx ) );
+                                    createIntersectionProgram( ctx, cache ) );
 
   optix_mesh.geom_instance = ctx->createGeometryInstance(
                                  geometry,
@@ -242,6 +327,16 @@ void loadMesh(
 
   optix::Context context = optix_mesh.context;
 
+  if( !optix_mesh.cache )
+  {
+    optix_mesh.cache = std::make_shared<OptiXMeshCache>();
+    optix_mesh.cache->context = context->get();
+  }
+  else if( optix_mesh.cache->context != context->get() )
+  {
+    throw std::runtime_error( "OptiXMesh: loadMesh() cache belongs to another OptiX context" );
+  }
+
   Mesh mesh;
   MeshLoader loader( filename );
   loader.scanMesh( mesh );
@@ -33,6 +33,7 @@
 #include <Mesh.h>
 #include <optixu/optixpp_namespace.h>
 #include <optixu/optixu_matrix_namespace.h>
+#include <memory>
 
 
 //------------------------------------------------------------------------------
@@ -48,6 +49,8 @@
 //   material_buffer: int indices into material list
 //
 //------------------------------------------------------------------------------
+struct OptiXMeshCache;
+
 struct OptiXMesh
 {
   // Input
@@ -60,6 +63,11 @@ struct OptiXMesh
   optix::Program               closest_hit;   // optional multi matl override
   optix::Program               any_hit;       // optional
 
+  // Programs and materials shared by the meshes of one context.  loadMesh()
+  // creates a cache if none is set, pass it on to the next mesh of the scene.
+  // It is released with the last mesh holding it.
+  std::shared_ptr<OptiXMeshCache> cache;      // optional in, output
+
   // Output
   optix::GeometryInstance      geom_instance;
   optix::float3                bbox_min;
@@ -74,3 +82,4 @@ SUTILAPI void loadMesh(
     OptiXMesh&                mesh, 
     const optix::Matrix4x4&   load_xform = optix::Matrix4x4::identity()
     );
+
@@ -229,8 +229,8 @@ optix::TextureSampler PPMLoader::loadTexture( optix::Context context,
   optix::Buffer buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_BYTE4, nx, ny );
   unsigned char* buffer_data = static_cast<unsigned char*>( buffer->map() );
 
-  for ( unsigned int i = 0; i < nx; ++i ) {
-    for ( unsigned int j = 0; j < ny; ++j ) {
+  for ( unsigned int j = 0; j < ny; ++j ) {
+    for ( unsigned int i = 0; i < nx; ++i ) {
 
       unsigned int ppm_index = ( (ny-j-1)*nx + i )*3;
       unsigned int buf_index = ( (j     )*nx + i )*4;
@@ -132,7 +132,10 @@ sutil::PreethamSunSky::PreethamSunSky()
     m_sun_phi(   0.0f ),
     m_turbidity( 2.0f ),
     m_overcast(  0.0f ),
-    m_dirty( true )
+    m_dirty( true ),
+    m_texture_width( 0u ),
+    m_texture_height( 0u ),
+    m_texture_dirty( true )
 {
   m_up = make_float3( 0.0f, 1.0f, 0.0f );
 }
@@ -220,6 +223,143 @@ void sutil::PreethamSunSky::setVariables(optix::Context context )
 
   context["sun_direction"]->setFloat( m_sun_dir );
   context["sun_color"    ]->setFloat( m_sun_color );
+
+  bakeSkyTexture( context );
+}
+
+
+void sutil::PreethamSunSky::setSkyTexture( unsigned int width, unsigned int height )
+{
+  m_texture_width  = width;
+  m_texture_height = height ? height : width / 2u;
+  if( m_texture_height == 0u )
+    m_texture_width = 0u;
+  m_texture_dirty  = true;
+}
+
+
+// Same as the querySkyModel() of the samples without the sun disc, including their chromaticity boost
+float3 sutil::PreethamSunSky::bakedSkyColor( const float3& direction )
+{
+  float3 sunlit_sky_color = make_float3( 0.0f );
+
+  if( m_overcast < 1.0f ) {
+    float3 ray_direction = direction;
+    float inv_dir_dot_up = 1.f / dot( ray_direction, m_up );
+    if( inv_dir_dot_up < 0.f ) {
+      ray_direction = reflect( ray_direction, m_up );
+      inv_dir_dot_up = -inv_dir_dot_up;
+    }
+
+    float gamma = dot( m_sun_dir, ray_direction );
+    float acos_gamma = acosf( fminf( fmaxf( gamma, -1.0f ), 1.0f ) );
+    float3 A =  m_c1 * inv_dir_dot_up;
+    float3 B =  m_c3 * acos_gamma;
+    float3 color_Yxy = ( make_float3(1.0f) + m_c0*make_float3( expf(A.x), expf(A.y), expf(A.z) ) ) *
+                       ( make_float3(1.0f) + m_c2*make_float3( expf(B.x), expf(B.y), expf(B.z) ) + m_c4*gamma*gamma );
+    color_Yxy *= m_inv_divisor_Yxy;
+
+    color_Yxy.y = 0.33f + 1.2f * ( color_Yxy.y - 0.33f );
+    color_Yxy.z = 0.33f + 1.2f * ( color_Yxy.z - 0.33f );
+    sunlit_sky_color = XYZ2rgb( Yxy2XYZ( color_Yxy ) ) / 1000.0f;
+  }
+
+  float Y =  15.0f;
+  float3 overcast_sky_color = make_float3( ( 1.0f + 2.0f * fabsf( direction.y ) ) / 3.0f * Y );
+
+  return lerp( sunlit_sky_color, overcast_sky_color, m_overcast );
+}
+
+
+void sutil::PreethamSunSky::bakeSkyTexture( optix::Context context )
+{
+  // The programs reference the texture even when it is disabled, so always bind something
+  if( !m_sky_sampler ) {
+    m_sky_buffer      = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, 1u, 1u );
+    m_marginal_cdf    = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT, 2u );
+    m_conditional_cdf = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT, 2u, 1u );
+
+    float4* texel = static_cast<float4*>( m_sky_buffer->map() );
+    *texel = make_float4( 0.0f );
+    m_sky_buffer->unmap();
+    float* cdf = static_cast<float*>( m_marginal_cdf->map() );
+    cdf[0] = 0.0f; cdf[1] = 1.0f;
+    m_marginal_cdf->unmap();
+    cdf = static_cast<float*>( m_conditional_cdf->map() );
+    cdf[0] = 0.0f; cdf[1] = 1.0f;
+    m_conditional_cdf->unmap();
+
+    m_sky_sampler = context->createTextureSampler();
+    m_sky_sampler->setWrapMode( 0, RT_WRAP_REPEAT );
+    m_sky_sampler->setWrapMode( 1, RT_WRAP_CLAMP_TO_EDGE );
+    m_sky_sampler->setWrapMode( 2, RT_WRAP_CLAMP_TO_EDGE );
+    m_sky_sampler->setIndexingMode( RT_TEXTURE_INDEX_NORMALIZED_COORDINATES );
+    m_sky_sampler->setReadMode( RT_TEXTURE_READ_ELEMENT_TYPE );
+    m_sky_sampler->setMaxAnisotropy( 1.0f );
+    m_sky_sampler->setMipLevelCount( 1u );
+    m_sky_sampler->setArraySize( 1u );
+    m_sky_sampler->setFilteringModes( RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE );
+    m_sky_sampler->setBuffer( 0u, 0u, m_sky_buffer );
+  }
+
+  optix::Onb onb( m_up );
+  context["sky_texture"        ]->setTextureSampler( m_sky_sampler );
+  context["sky_marginal_cdf"   ]->setBuffer( m_marginal_cdf );
+  context["sky_conditional_cdf"]->setBuffer( m_conditional_cdf );
+  context["sky_frame_u"        ]->setFloat( onb.m_tangent );
+  context["sky_frame_v"        ]->setFloat( onb.m_binormal );
+  context["sky_frame_w"        ]->setFloat( onb.m_normal );
+  context["use_sky_texture"    ]->setInt( m_texture_width ? 1 : 0 );
+
+  if( !m_texture_width || !m_texture_dirty ) return;
+  m_texture_dirty = false;
+
+  const unsigned int width  = m_texture_width;
+  const unsigned int height = m_texture_height;
+  m_sky_buffer->setSize( width, height );
+  m_marginal_cdf->setSize( height + 1u );
+  m_conditional_cdf->setSize( width + 1u, height );
+
+  // Texel ( i, j ) is centered at phi = 2pi * ( ( i + 0.5 ) / width - 0.5 ) around the up direction and
+  // theta = pi * ( j + 0.5 ) / height from it.  Each texel is sampled proportional to its luminance
+  // times the solid angle it covers.
+  float4* texels      = static_cast<float4*>( m_sky_buffer->map() );
+  float*  marginal    = static_cast<float*>( m_marginal_cdf->map() );
+  float*  conditional = static_cast<float*>( m_conditional_cdf->map() );
+
+  marginal[0] = 0.0f;
+  for( unsigned int j = 0; j < height; ++j ) {
+    const float theta     = static_cast<float>( M_PI ) * ( j + 0.5f ) / height;
+    const float sin_theta = sinf( theta );
+    const float cos_theta = cosf( theta );
+
+    float* row = conditional + j * ( width + 1u );
+    row[0] = 0.0f;
+    for( unsigned int i = 0; i < width; ++i ) {
+      const float phi = 2.0f * static_cast<float>( M_PI ) * ( ( i + 0.5f ) / width - 0.5f );
+      const float3 direction = ( cosf( phi ) * onb.m_tangent + sinf( phi ) * onb.m_binormal ) * sin_theta +
+                               cos_theta * onb.m_normal;
+
+      const float3 color = bakedSkyColor( direction );
+      texels[j * width + i] = make_float4( color, 1.0f );
+
+      const float luminance = dot( color, make_float3( 0.2126f, 0.7152f, 0.0722f ) );
+      row[i + 1] = row[i] + fmaxf( luminance, 0.0f ) * sin_theta;
+    }
+
+    const float row_sum = row[width];
+    marginal[j + 1] = marginal[j] + row_sum;
+    for( unsigned int i = 1; i <= width; ++i )
+      row[i] = row_sum > 0.0f ? row[i] / row_sum : static_cast<float>( i ) / width;
+  }
+
+  const float sum = marginal[height];
+  for( unsigned int j = 1; j <= height; ++j )
+    marginal[j] = sum > 0.0f ? marginal[j] / sum : static_cast<float>( j ) / height;
+
+  m_conditional_cdf->unmap();
+  m_marginal_cdf->unmap();
+  m_sky_buffer->unmap();
 }
 
 
@@ -49,12 +49,16 @@ protected:
 public:
   SUTILAPI PreethamSunSky();
 
-  SUTILAPI void setSunTheta( float sun_theta )            { m_sun_theta = sun_theta; m_dirty = true; }
-  SUTILAPI void setSunPhi( float sun_phi)                 { m_sun_phi = sun_phi;     m_dirty = true; }
-  SUTILAPI void setTurbidity( float turbidity )           { m_turbidity = turbidity; m_dirty = true; }
+  SUTILAPI void setSunTheta( float sun_theta )            { m_sun_theta = sun_theta; m_dirty = true; m_texture_dirty = true; }
+  SUTILAPI void setSunPhi( float sun_phi)                 { m_sun_phi = sun_phi;     m_dirty = true; m_texture_dirty = true; }
+  SUTILAPI void setTurbidity( float turbidity )           { m_turbidity = turbidity; m_dirty = true; m_texture_dirty = true; }
 
-  SUTILAPI void setUpDir( const float3& up )       { m_up = up; m_dirty = true; }
-  SUTILAPI void setOvercast( float overcast )             { m_overcast = overcast;    }
+  SUTILAPI void setUpDir( const float3& up )       { m_up = up; m_dirty = true; m_texture_dirty = true; }
+  SUTILAPI void setOvercast( float overcast )             { m_overcast = overcast;    m_texture_dirty = true; }
+
+  // Bake the sky ( without the sun disc ) into a width x height lat-long texture in setVariables(),
+  // together with the tables to importance sample it.  A width of 0 evaluates the model analytically.
+  SUTILAPI void setSkyTexture( unsigned int width, unsigned int height = 0u );
   
   SUTILAPI float  getSunTheta()                           { return m_sun_theta; }
   SUTILAPI float  getSunPhi()                             { return m_sun_phi;   }
@@ -81,12 +85,20 @@ public:
   //   sun_color       :
   //   overcast        :
   //   up              :
+  // and the baked sky ( see sky_texture.h ), which is only rebuilt after the sky changed:
+  //   sky_texture         : lat-long radiance around the up direction
+  //   sky_frame_u/v/w     : lat-long frame, w is the up direction
+  //   sky_marginal_cdf    : CDF over the texture rows
+  //   sky_conditional_cdf : CDF over the texels of each row
+  //   use_sky_texture     : 0 if no texture was requested
   SUTILAPI void setVariables( optix::Context context );
 
 
 private:
   void          preprocess();
   float3 calculateSunColor();
+  float3 bakedSkyColor( const float3& direction );
+  void   bakeSkyTexture( optix::Context context );
 
 
   // Represents one entry from table 2 in the paper
@@ -132,6 +144,15 @@ private:
   float3 m_c3;
   float3 m_c4;
   float3 m_inv_divisor_Yxy;
+
+  // Baked sky texture
+  unsigned int          m_texture_width;
+  unsigned int          m_texture_height;
+  bool                  m_texture_dirty;
+  optix::TextureSampler m_sky_sampler;
+  optix::Buffer         m_sky_buffer;
+  optix::Buffer         m_marginal_cdf;
+  optix::Buffer         m_conditional_cdf;
 };
 
 
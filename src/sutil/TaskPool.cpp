@@ -0,0 +1,430 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/TaskPool.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+
+typedef std::function<void()> Task;
+
+struct WorkQueue
+{
+    std::mutex       mutex;
+    std::deque<Task> tasks;
+};
+
+
+unsigned int defaultThreadCount()
+{
+    const char* env = getenv( "SUTIL_THREADS" );
+    if( env && atoi( env ) > 0 )
+        return static_cast<unsigned int>( atoi( env ) );
+    return std::max( std::thread::hardware_concurrency(), 1u );
+}
+
+} // end anonymous namespace
+
+
+//------------------------------------------------------------------------------
+//
+// TaskPool
+//
+//------------------------------------------------------------------------------
+
+class sutil::TaskPool::Impl
+{
+public:
+    explicit Impl( unsigned int num_threads );
+    ~Impl();
+
+    unsigned int numThreads() const { return m_num_threads; }
+
+    void submit( Task task );
+    bool runPending();
+
+private:
+    void work( size_t queue );
+    bool pop( size_t home, Task& task );
+    size_t homeQueue() const;
+
+    const unsigned int       m_num_threads;
+
+    // Queue 0 takes the tasks submitted from outside the pool, queue i the ones of worker i.
+    std::vector<std::unique_ptr<WorkQueue> > m_queues;
+    std::atomic<size_t>      m_queued;       // Tasks in all queues, the idle workers sleep while 0
+
+    std::mutex               m_sleep_mutex;
+    std::condition_variable  m_wake;
+    bool                     m_stop;
+
+    std::vector<std::thread> m_threads;
+};
+
+
+namespace
+{
+
+// The pool and queue index of the worker running on this thread
+thread_local const void* t_pool  = 0;
+thread_local size_t      t_queue = 0;
+
+} // end anonymous namespace
+
+
+sutil::TaskPool::Impl::Impl( unsigned int num_threads )
+    : m_num_threads( num_threads ? num_threads : defaultThreadCount() ),
+      m_queued( 0 ),
+      m_stop( false )
+{
+    for( unsigned int i = 0; i < m_num_threads; ++i )
+        m_queues.push_back( std::unique_ptr<WorkQueue>( new WorkQueue ) );
+    for( unsigned int i = 1; i < m_num_threads; ++i )
+        m_threads.push_back( std::thread( &Impl::work, this, size_t( i ) ) );
+}
+
+
+sutil::TaskPool::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_sleep_mutex );
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for( size_t i = 0; i < m_threads.size(); ++i )
+        m_threads[i].join();
+}
+
+
+size_t sutil::TaskPool::Impl::homeQueue() const
+{
+    return ( t_pool == this ) ? t_queue : 0;
+}
+
+
+void sutil::TaskPool::Impl::submit( Task task )
+{
+    if( m_threads.empty() )
+    {
+        task();
+        return;
+    }
+
+    WorkQueue& queue = *m_queues[homeQueue()];
+    {
+        std::lock_guard<std::mutex> lock( queue.mutex );
+        queue.tasks.push_back( std::move( task ) );
+    }
+    m_queued.fetch_add( 1 );
+
+    // Taking the lock orders the wake-up after a worker's check of m_queued
+    {
+        std::lock_guard<std::mutex> lock( m_sleep_mutex );
+    }
+    m_wake.notify_one();
+}
+
+
+// The newest task of the own queue, which is likely still in the cache, else the oldest task of
+// the external queue, else steal the oldest task of another worker, which tends to be the largest.
+bool sutil::TaskPool::Impl::pop( size_t home, Task& task )
+{
+    const size_t n = m_queues.size();
+    for( size_t i = 0; i < n; ++i )
+    {
+        WorkQueue& queue = *m_queues[( home + i ) % n];
+        std::lock_guard<std::mutex> lock( queue.mutex );
+        if( queue.tasks.empty() )
+            continue;
+        if( i == 0 && home != 0 )
+        {
+            task = std::move( queue.tasks.back() );
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move( queue.tasks.front() );
+            queue.tasks.pop_front();
+        }
+        m_queued.fetch_sub( 1 );
+        return true;
+    }
+    return false;
+}
+
+
+bool sutil::TaskPool::Impl::runPending()
+{
+    Task task;
+    if( !pop( homeQueue(), task ) )
+        return false;
+    task();
+    return true;
+}
+
+
+void sutil::TaskPool::Impl::work( size_t queue )
+{
+    t_pool  = this;
+    t_queue = queue;
+
+    for( ;; )
+    {
+        Task task;
+        if( pop( queue, task ) )
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock( m_sleep_mutex );
+        m_wake.wait( lock, [this]() { return m_stop || m_queued.load() != 0; } );
+        if( m_stop && m_queued.load() == 0 )
+            return;
+    }
+}
+
+
+sutil::TaskPool::TaskPool( unsigned int num_threads )
+    : m_impl( new Impl( num_threads ) )
+{
+}
+
+
+sutil::TaskPool::~TaskPool()
+{
+    delete m_impl;
+}
+
+
+sutil::TaskPool& sutil::TaskPool::instance()
+{
+    static TaskPool* pool = new TaskPool();
+    return *pool;
+}
+
+
+unsigned int sutil::TaskPool::numThreads() const
+{
+    return m_impl->numThreads();
+}
+
+
+void sutil::TaskPool::submit( std::function<void()> task )
+{
+    m_impl->submit( std::move( task ) );
+}
+
+
+bool sutil::TaskPool::runPending()
+{
+    return m_impl->runPending();
+}
+
+
+//------------------------------------------------------------------------------
+//
+// TaskGroup
+//
+//------------------------------------------------------------------------------
+
+class sutil::TaskGroup::Impl
+{
+public:
+    std::mutex              mutex;
+    std::condition_variable done;
+    size_t                  pending = 0;  // Tasks submitted but not finished
+    std::exception_ptr      error;        // First exception thrown by a task
+};
+
+
+sutil::TaskGroup::TaskGroup( TaskPool& pool )
+    : m_pool( pool ),
+      m_impl( new Impl )
+{
+}
+
+
+sutil::TaskGroup::~TaskGroup()
+{
+    try
+    {
+        wait();
+    }
+    catch( ... )
+    {
+    }
+    delete m_impl;
+}
+
+
+void sutil::TaskGroup::run( std::function<void()> task )
+{
+    {
+        std::lock_guard<std::mutex> lock( m_impl->mutex );
+        ++m_impl->pending;
+    }
+
+    Impl* impl = m_impl;
+    m_pool.submit( [impl, task]() {
+        std::exception_ptr error;
+        try
+        {
+            task();
+        }
+        catch( ... )
+        {
+            error = std::current_exception();
+        }
+
+        // The waiter can only return and destroy the group after this lock is released
+        std::lock_guard<std::mutex> lock( impl->mutex );
+        if( error && !impl->error )
+            impl->error = error;
+        if( --impl->pending == 0 )
+            impl->done.notify_all();
+    } );
+}
+
+
+void sutil::TaskGroup::wait()
+{
+    for( ;; )
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_impl->mutex );
+            if( m_impl->pending == 0 )
+                break;
+        }
+
+        // Help instead of blocking.  Only sleep when the group's last tasks run on other threads.
+        if( !m_pool.runPending() )
+        {
+            std::unique_lock<std::mutex> lock( m_impl->mutex );
+            m_impl->done.wait_for( lock, std::chrono::milliseconds( 1 ),
+                                   [this]() { return m_impl->pending == 0; } );
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock( m_impl->mutex );
+        std::swap( error, m_impl->error );
+    }
+    if( error )
+        std::rethrow_exception( error );
+}
+
+
+//------------------------------------------------------------------------------
+//
+// TaskGraph
+//
+//------------------------------------------------------------------------------
+
+class sutil::TaskGraph::Impl
+{
+public:
+    struct Node
+    {
+        Task                task;
+        std::vector<size_t> successors;
+        int                 predecessors;
+    };
+
+    std::vector<Node> nodes;
+};
+
+
+sutil::TaskGraph::TaskGraph( TaskPool& pool )
+    : m_pool( pool ),
+      m_impl( new Impl )
+{
+}
+
+
+sutil::TaskGraph::~TaskGraph()
+{
+    delete m_impl;
+}
+
+
+size_t sutil::TaskGraph::add( std::function<void()> task )
+{
+    Impl::Node node;
+    node.task         = std::move( task );
+    node.predecessors = 0;
+    m_impl->nodes.push_back( std::move( node ) );
+    return m_impl->nodes.size() - 1;
+}
+
+
+void sutil::TaskGraph::precede( size_t before, size_t after )
+{
+    m_impl->nodes[before].successors.push_back( after );
+    ++m_impl->nodes[after].predecessors;
+}
+
+
+void sutil::TaskGraph::run()
+{
+    std::vector<Impl::Node>&       nodes = m_impl->nodes;
+    std::vector<std::atomic<int> > remaining( nodes.size() );
+    for( size_t i = 0; i < nodes.size(); ++i )
+        remaining[i].store( nodes[i].predecessors );
+
+    TaskGroup group( m_pool );
+
+    // A finished task starts the successors it was the last predecessor of
+    std::function<void( size_t )> start = [&]( size_t i ) {
+        group.run( [&, i]() {
+            nodes[i].task();
+            for( size_t s : nodes[i].successors )
+                if( remaining[s].fetch_sub( 1 ) == 1 )
+                    start( s );
+        } );
+    };
+
+    for( size_t i = 0; i < nodes.size(); ++i )
+        if( nodes[i].predecessors == 0 )
+            start( i );
+
+    group.wait();
+}
@@ -0,0 +1,168 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+#include "sutilapi.h"
+
+namespace sutil
+{
+
+// Process wide work-stealing pool for the host side loaders and preprocessors.  Each worker
+// runs its own tasks last in, first out and steals the oldest tasks of the others when idle.
+// The shared instance() counts the calling thread as one of its threads, so a thread waiting
+// in TaskGroup::wait() works on the pending tasks and the cores are never oversubscribed.
+// SUTIL_THREADS=<n> limits the instance to n threads, SUTIL_THREADS=1 runs everything serially.
+class TaskPool
+{
+public:
+    // num_threads == 0 uses SUTIL_THREADS or the hardware concurrency
+    SUTILAPI explicit TaskPool( unsigned int num_threads = 0 );
+
+    // Runs all submitted tasks first
+    SUTILAPI ~TaskPool();
+
+    // The pool shared by all of sutil and the samples.  Never destroyed, tasks may still run at exit.
+    SUTILAPI static TaskPool& instance();
+
+    // Worker threads plus the calling thread
+    SUTILAPI unsigned int numThreads() const;
+
+    // Queue a task which must not throw.  With a single thread the task runs immediately.
+    SUTILAPI void submit( std::function<void()> task );
+
+    // Run one queued task on the calling thread.  Returns false when there was none.
+    SUTILAPI bool runPending();
+
+private:
+    TaskPool( const TaskPool& );
+    TaskPool& operator=( const TaskPool& );
+
+    class Impl;
+    Impl* m_impl;
+};
+
+
+// A set of tasks to wait for.  Tasks may throw, wait() rethrows the first exception.
+class TaskGroup
+{
+public:
+    SUTILAPI explicit TaskGroup( TaskPool& pool = TaskPool::instance() );
+
+    // Waits for the remaining tasks, discarding their exceptions
+    SUTILAPI ~TaskGroup();
+
+    SUTILAPI void run( std::function<void()> task );
+
+    // Block until all tasks of the group finished, running pending tasks of the pool meanwhile
+    SUTILAPI void wait();
+
+    TaskPool& pool() const { return m_pool; }
+
+private:
+    TaskGroup( const TaskGroup& );
+    TaskGroup& operator=( const TaskGroup& );
+
+    class Impl;
+    TaskPool& m_pool;
+    Impl*     m_impl;
+};
+
+
+// Tasks with dependencies.  run() starts every task as soon as all tasks before it finished.
+class TaskGraph
+{
+public:
+    SUTILAPI explicit TaskGraph( TaskPool& pool = TaskPool::instance() );
+    SUTILAPI ~TaskGraph();
+
+    // Returns the id of the new task for precede()
+    SUTILAPI size_t add( std::function<void()> task );
+
+    // Task after starts only once task before finished
+    SUTILAPI void precede( size_t before, size_t after );
+
+    // Block until all tasks ran.  The tasks after a task which threw are skipped, run() rethrows.
+    SUTILAPI void run();
+
+private:
+    TaskGraph( const TaskGraph& );
+    TaskGraph& operator=( const TaskGraph& );
+
+    class Impl;
+    TaskPool& m_pool;
+    Impl*     m_impl;
+};
+
+
+// Calls body( first, last ) on disjoint sub-ranges covering [begin, end), with at least grain
+// indices each except the last.  A few ranges per thread balance uneven costs via stealing.
+template <typename Index, typename Body>
+void parallelForRange( Index begin, Index end, const Body& body, size_t grain = 1,
+                       TaskPool& pool = TaskPool::instance() )
+{
+    if( end <= begin )
+        return;
+
+    const size_t range      = static_cast<size_t>( end - begin );
+    const size_t max_ranges = std::max<size_t>( range / std::max<size_t>( grain, 1 ), 1 );
+    const size_t num_ranges = std::min<size_t>( max_ranges, size_t( pool.numThreads() ) * 4 );
+    if( num_ranges <= 1 )
+    {
+        body( begin, end );
+        return;
+    }
+
+    TaskGroup group( pool );
+    for( size_t r = 1; r < num_ranges; ++r )
+    {
+        const Index first = begin + static_cast<Index>( range * r / num_ranges );
+        const Index last  = begin + static_cast<Index>( range * ( r + 1 ) / num_ranges );
+        group.run( [first, last, &body]() { body( first, last ); } );
+    }
+    body( begin, begin + static_cast<Index>( range / num_ranges ) );
+    group.wait();
+}
+
+
+// Calls body( i ) for all i in [begin, end).  The body must only write disjoint memory per index.
+template <typename Index, typename Body>
+void parallelFor( Index begin, Index end, const Body& body, size_t grain = 1,
+                  TaskPool& pool = TaskPool::instance() )
+{
+    parallelForRange( begin, end, [&body]( Index first, Index last ) {
+        for( Index i = first; i < last; ++i )
+            body( i );
+    }, grain, pool );
+}
+
+} // end namespace sutil
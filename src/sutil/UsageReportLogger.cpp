@@ -0,0 +1,362 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/UsageReportLogger.h>
+
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace sutil
+{
+
+namespace
+{
+
+std::string trim( const std::string& s )
+{
+    const std::string::size_type first = s.find_first_not_of( " \t\r\n" );
+    if( first == std::string::npos )
+        return std::string();
+    const std::string::size_type last = s.find_last_not_of( " \t\r\n" );
+    return s.substr( first, last - first + 1 );
+}
+
+// A number starts at a digit, or a sign or dot followed by one, which doesn't continue a word like "sm_75" or "RTbuffer3D".
+bool isNumberStart( const std::string& s, std::string::size_type i )
+{
+    if( i > 0 && ( isalnum( static_cast<unsigned char>( s[i - 1] ) ) || s[i - 1] == '_' ) )
+        return false;
+    if( isdigit( static_cast<unsigned char>( s[i] ) ) )
+        return true;
+    return ( s[i] == '-' || s[i] == '.' ) && i + 1 < s.size() && isdigit( static_cast<unsigned char>( s[i + 1] ) );
+}
+
+// Microseconds resolution without exponents for the seconds since the logger creation
+std::string formatTime( double seconds )
+{
+    char text[32];
+    snprintf( text, sizeof( text ), "%.6f", seconds );
+    return std::string( text );
+}
+
+void writeCSVField( std::ostream& stream, const std::string& s )
+{
+    if( s.find_first_of( ",\"\n" ) == std::string::npos )
+    {
+        stream << s;
+        return;
+    }
+    stream << '"';
+    for( size_t i = 0; i < s.size(); ++i )
+    {
+        if( s[i] == '"' )
+            stream << '"';
+        stream << s[i];
+    }
+    stream << '"';
+}
+
+void writeJSONString( std::ostream& stream, const std::string& s )
+{
+    stream << '"';
+    for( size_t i = 0; i < s.size(); ++i )
+    {
+        const unsigned char c = static_cast<unsigned char>( s[i] );
+        if( c == '"' || c == '\\' )
+            stream << '\\' << s[i];
+        else if( c < 0x20 )
+        {
+            char escape[8];
+            snprintf( escape, sizeof( escape ), "\\u%04x", c );
+            stream << escape;
+        }
+        else
+            stream << s[i];
+    }
+    stream << '"';
+}
+
+} // end anonymous namespace
+
+
+class UsageReportLogger::Impl
+{
+public:
+    Impl()
+        : start( std::chrono::steady_clock::now() )
+        , echo( false )
+        , listener( 0 )
+        , listener_data( 0 )
+    {
+    }
+
+    void log( int level, const char* tag, const char* msg );
+    void addLine( int level, const std::string& tag, const std::string& line );
+
+    void writeCSV( std::ostream& stream ) const;
+    void writeJSON( std::ostream& stream ) const;
+
+    std::chrono::steady_clock::time_point start;
+
+    mutable std::mutex mutex;
+    std::string        filename;
+    bool               echo;
+    void             (*listener)( const UsageReportRecord& record, void* data );
+    void*              listener_data;
+
+    std::vector<UsageReportRecord>     records;
+    std::map<std::string, std::string> pending;  // Partial line per tag, OptiX doesn't always end a message with a newline
+    std::map<std::string, std::string> sections; // Current section per tag
+};
+
+
+// Messages can hold several lines or only the start of one.  Only complete lines become records.
+void UsageReportLogger::Impl::log( int level, const char* tag, const char* msg )
+{
+    if( echo )
+        std::cout << "[" << level << "][" << std::left << std::setw( 12 ) << tag << "] " << msg;
+
+    const std::string name = trim( tag ? tag : "" );
+
+    std::lock_guard<std::mutex> lock( mutex );
+
+    std::string& text = pending[name];
+    text += ( msg ? msg : "" );
+
+    std::string::size_type begin = 0;
+    std::string::size_type end;
+    while( ( end = text.find( '\n', begin ) ) != std::string::npos )
+    {
+        addLine( level, name, text.substr( begin, end - begin ) );
+        begin = end + 1;
+    }
+    text.erase( 0, begin );
+}
+
+void UsageReportLogger::Impl::addLine( int level, const std::string& tag, const std::string& line )
+{
+    const std::string trimmed = trim( line );
+    if( trimmed.empty() )
+        return;
+
+    UsageReportRecord record;
+    record.time = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    parse( level, tag, line, record );
+
+    const bool indented = ( line[0] == ' ' || line[0] == '\t' );
+    if( !indented )
+        sections[tag] = ( trimmed[trimmed.size() - 1] == ':' ) ? trimmed.substr( 0, trimmed.size() - 1 ) : std::string();
+    else
+        record.section = sections[tag];
+
+    if( listener )
+        listener( record, listener_data );
+    if( !filename.empty() )
+        records.push_back( record );
+}
+
+void UsageReportLogger::Impl::writeCSV( std::ostream& stream ) const
+{
+    stream << "time,level,tag,section,key,value,unit,message\n";
+    stream << std::setprecision( 9 );
+    for( size_t i = 0; i < records.size(); ++i )
+    {
+        const UsageReportRecord& r = records[i];
+        stream << formatTime( r.time ) << "," << r.level << ",";
+        writeCSVField( stream, r.tag );
+        stream << ",";
+        writeCSVField( stream, r.section );
+        stream << ",";
+        writeCSVField( stream, r.key );
+        stream << ",";
+        if( !std::isnan( r.value ) )
+            stream << r.value;
+        stream << ",";
+        writeCSVField( stream, r.unit );
+        stream << ",";
+        writeCSVField( stream, r.message );
+        stream << "\n";
+    }
+}
+
+void UsageReportLogger::Impl::writeJSON( std::ostream& stream ) const
+{
+    stream << std::setprecision( 9 );
+    stream << "{\n  \"records\": [\n";
+    for( size_t i = 0; i < records.size(); ++i )
+    {
+        const UsageReportRecord& r = records[i];
+        stream << "    { \"time\": " << formatTime( r.time ) << ", \"level\": " << r.level << ", \"tag\": ";
+        writeJSONString( stream, r.tag );
+        stream << ", \"section\": ";
+        writeJSONString( stream, r.section );
+        stream << ", \"key\": ";
+        writeJSONString( stream, r.key );
+        stream << ", \"value\": ";
+        if( std::isnan( r.value ) )
+            stream << "null";
+        else
+            stream << r.value;
+        stream << ", \"unit\": ";
+        writeJSONString( stream, r.unit );
+        stream << ", \"message\": ";
+        writeJSONString( stream, r.message );
+        stream << " }" << ( ( i + 1 < records.size() ) ? ",\n" : "\n" );
+    }
+    stream << "  ]\n}\n";
+}
+
+
+UsageReportLogger::UsageReportLogger()
+    : m_impl( new Impl )
+{
+}
+
+UsageReportLogger::~UsageReportLogger()
+{
+    if( !m_impl->filename.empty() )
+        write();
+    delete m_impl;
+}
+
+void UsageReportLogger::attach( optix::Context context, int level )
+{
+    if( level > 0 )
+        context->setUsageReportCallback( callback, level, this );
+}
+
+void UsageReportLogger::setFilename( const std::string& filename )
+{
+    std::lock_guard<std::mutex> lock( m_impl->mutex );
+    m_impl->filename = filename;
+    if( filename.empty() )
+        m_impl->records.clear();
+}
+
+void UsageReportLogger::setEcho( bool echo )
+{
+    m_impl->echo = echo;
+}
+
+void UsageReportLogger::setListener( void (*listener)( const UsageReportRecord& record, void* data ), void* data )
+{
+    std::lock_guard<std::mutex> lock( m_impl->mutex );
+    m_impl->listener      = listener;
+    m_impl->listener_data = data;
+}
+
+size_t UsageReportLogger::recordCount() const
+{
+    std::lock_guard<std::mutex> lock( m_impl->mutex );
+    return m_impl->records.size();
+}
+
+bool UsageReportLogger::write() const
+{
+    std::lock_guard<std::mutex> lock( m_impl->mutex );
+
+    const std::string& filename = m_impl->filename;
+    std::ofstream stream( filename.c_str() );
+    if( !stream )
+    {
+        std::cerr << "ERROR: UsageReportLogger::write() failed to open " << filename << std::endl;
+        return false;
+    }
+
+    const std::string::size_type dot = filename.find_last_of( '.' );
+    if( dot != std::string::npos && filename.substr( dot ) == ".json" )
+        m_impl->writeJSON( stream );
+    else
+        m_impl->writeCSV( stream );
+
+    std::cout << "UsageReportLogger wrote " << m_impl->records.size() << " records to " << filename << std::endl;
+    return true;
+}
+
+void UsageReportLogger::callback( int level, const char* tag, const char* msg, void* cbdata )
+{
+    static_cast<UsageReportLogger*>( cbdata )->m_impl->log( level, tag, msg );
+}
+
+void UsageReportLogger::parse( int level, const std::string& tag, const std::string& line, UsageReportRecord& record )
+{
+    record.level   = level;
+    record.tag     = tag;
+    record.message = trim( line );
+    record.key.clear();
+    record.value   = std::numeric_limits<double>::quiet_NaN();
+    record.unit.clear();
+
+    const std::string& s = record.message;
+
+    std::string::size_type number = std::string::npos;
+    for( std::string::size_type i = 0; i < s.size(); ++i )
+    {
+        if( isNumberStart( s, i ) )
+        {
+            number = i;
+            break;
+        }
+    }
+
+    const std::string::size_type colon = s.find( ':' );
+    if( colon != std::string::npos && colon < number )
+        record.key = trim( s.substr( 0, colon ) );
+    else if( number != std::string::npos )
+        record.key = trim( s.substr( 0, number ) );
+
+    if( number == std::string::npos )
+        return;
+
+    const char* begin = s.c_str() + number;
+    char*       end   = 0;
+    record.value = strtod( begin, &end );
+
+    std::string::size_type u = number + ( end - begin );
+    while( u < s.size() && s[u] == ' ' )
+        ++u;
+    const std::string::size_type unit = u;
+    while( u < s.size() && ( isalpha( static_cast<unsigned char>( s[u] ) ) || s[u] == '%' || s[u] == '/' ) )
+        ++u;
+    if( u < s.size() && ( isalnum( static_cast<unsigned char>( s[u] ) ) || s[u] == '_' ) )
+        return; // Part of an identifier like "sm_75", not a unit
+    record.unit = s.substr( unit, u - unit );
+}
+
+} // end namespace sutil
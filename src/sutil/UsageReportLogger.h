@@ -0,0 +1,99 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixpp_namespace.h>
+#include <string>
+
+#include "sutilapi.h"
+
+namespace sutil
+{
+
+// One line of an OptiX usage report, split into the parts the reports commonly use,
+// e.g. "[2][TIMING      ] Acceleration builds took 36.1 ms" or "[2][SCENE STAT  ]     RTbuffer : 17".
+struct UsageReportRecord
+{
+    double      time;     // Seconds since the UsageReportLogger was created
+    int         level;    // Verbosity level of the message, 1 to 3
+    std::string tag;      // Message category like "SCENE STAT", "TIMING", "MEM USAGE" or "DISK CACHE", without padding
+    std::string section;  // Last unindented line of this tag that ended in ':', for the indented lines below it
+    std::string key;      // Text in front of the ':' or in front of the value
+    double      value;    // First number of the message, NaN when there is none
+    std::string unit;     // Word right after the value like "ms", "s" or "MB", empty when there is none
+    std::string message;  // The complete line without indentation
+};
+
+// Usage report sink for OptiX contexts.  attach() makes it the usage report callback, afterwards every line
+// of the report becomes a UsageReportRecord.  Records are kept and written as CSV, or as JSON when the
+// filename ends with ".json", when a filename is set.  The file is written again on destruction.
+class UsageReportLogger
+{
+public:
+    SUTILAPI UsageReportLogger();
+
+    // Writes the file when a filename is set
+    SUTILAPI ~UsageReportLogger();
+
+    // Register as the context's usage report callback.  Level 1 reports errors and important warnings,
+    // level 2 adds scene statistics and compile events, level 3 adds per launch statistics.  0 disables it.
+    SUTILAPI void attach( optix::Context context, int level );
+
+    // Keep the records for write().  An empty filename discards them.
+    SUTILAPI void setFilename( const std::string& filename );
+
+    // Also print each line to std::cout in the usual "[level][tag] message" form
+    SUTILAPI void setEcho( bool echo );
+
+    // Called for every record on the thread reporting it, e.g. to count events.  The record is only valid during the call,
+    // the listener must not call back into the logger.
+    SUTILAPI void setListener( void (*listener)( const UsageReportRecord& record, void* data ), void* data );
+
+    // Number of records kept so far
+    SUTILAPI size_t recordCount() const;
+
+    // Returns false when the file could not be written
+    SUTILAPI bool write() const;
+
+    // The OptiX usage report callback, cbdata is the UsageReportLogger
+    SUTILAPI static void callback( int level, const char* tag, const char* msg, void* cbdata );
+
+    // Splits one line of a report into key, value and unit, the section is tracked by the logger.
+    // Exposed for reports which were captured in another way.
+    SUTILAPI static void parse( int level, const std::string& tag, const std::string& line, UsageReportRecord& record );
+
+private:
+    UsageReportLogger( const UsageReportLogger& );
+    UsageReportLogger& operator=( const UsageReportLogger& );
+
+    class Impl;
+    Impl* m_impl;
+};
+
+} // end namespace sutil
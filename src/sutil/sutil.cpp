@@ -40,6 +40,8 @@
 #include <sutil/sutil.h>
 #include <sutil/HDRLoader.h>
 #include <sutil/PPMLoader.h>
+#include <sutil/HDRWriter.h>
+#include <sutil/NvtxRange.h>
 #include <sampleConfig.h>
 #include <sutil/stb/stb_image_write.h>
 
@@ -52,6 +54,10 @@
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <stdint.h>
 
 #if defined(_WIN32)
@@ -285,6 +291,72 @@ const char* sutil::samplesPTXDir()
 }
 
 
+namespace
+{
+    // The PTX handed out by getPtxString(). Programs are created from worker threads as well, and
+    // applications register runtime compiled PTX, so all of it is accessed under the one mutex.
+    // The strings are never erased, the returned pointers stay valid after the lock is released.
+    struct PtxRegistry
+    {
+        std::mutex                                 mutex;
+        std::map<std::string, const std::string*>  embedded;   // By file name, the latest registration wins.
+        std::list<std::string>                     registered; // Copies of all registered PTX.
+        std::map<std::string, std::string>         loaded;     // Read from disk by path.
+    };
+
+    // Filled during static initialization by the embedded PTX sources as well.
+    PtxRegistry& ptxRegistry()
+    {
+        static PtxRegistry registry;
+        return registry;
+    }
+} // namespace
+
+
+bool sutil::registerEmbeddedPTX( const char* ptx_filename, const char* ptx )
+{
+    PtxRegistry& registry = ptxRegistry();
+    std::lock_guard<std::mutex> lock( registry.mutex );
+    registry.registered.push_back( ptx );
+    registry.embedded[ptx_filename] = &registry.registered.back();
+    return true;
+}
+
+
+const char* sutil::getPtxString( const std::string& ptx_path )
+{
+    const std::string::size_type slash = ptx_path.find_last_of( "/\\" );
+    const std::string name = ( slash == std::string::npos ) ? ptx_path : ptx_path.substr( slash + 1 );
+
+    PtxRegistry& registry = ptxRegistry();
+    std::lock_guard<std::mutex> lock( registry.mutex );
+    std::map<std::string, const std::string*>::const_iterator embedded = registry.embedded.find( name );
+    if( embedded != registry.embedded.end() )
+        return embedded->second->c_str();
+
+    std::map<std::string, std::string>::const_iterator it = registry.loaded.find( ptx_path );
+    if( it == registry.loaded.end() )
+    {
+        std::ifstream file( ptx_path.c_str(), std::ios::binary );
+        if( !file )
+            throw Exception( "Couldn't open PTX file " + ptx_path );
+        std::stringstream ptx;
+        ptx << file.rdbuf();
+        it = registry.loaded.insert( std::make_pair( ptx_path, ptx.str() ) ).first;
+    }
+    return it->second.c_str();
+}
+
+
+optix::Program sutil::createProgramFromPTXFile(
+        optix::Context context,
+        const std::string& ptx_path,
+        const std::string& program_name )
+{
+    return context->createProgramFromPTXString( getPtxString( ptx_path ), program_name );
+}
+
+
 optix::Buffer sutil::createOutputBuffer(
         optix::Context context,
         RTformat format,
@@ -345,8 +417,8 @@ optix::GeometryInstance sutil::createOptiXGroundPlane( optix::Context context,
 {
     optix::Geometry parallelogram = context->createGeometry();
     parallelogram->setPrimitiveCount( 1u );
-    parallelogram->setBoundingBoxProgram( context->createProgramFromPTXFile( parallelogram_ptx, "bounds" ) );
-    parallelogram->setIntersectionProgram( context->createProgramFromPTXFile( parallelogram_ptx, "intersect" ) );
+    parallelogram->setBoundingBoxProgram( sutil::createProgramFromPTXFile( context, parallelogram_ptx, "bounds" ) );
+    parallelogram->setIntersectionProgram( sutil::createProgramFromPTXFile( context, parallelogram_ptx, "intersect" ) );
     const float extent = scale*fmaxf( aabb.extent( 0 ), aabb.extent( 2 ) );
     const float3 anchor = make_float3( aabb.center(0) - 0.5f*extent, aabb.m_min.y - 0.001f*aabb.extent( 1 ), aabb.center(2) - 0.5f*extent );
     float3 v1 = make_float3( 0.0f, 0.0f, extent );
@@ -448,28 +520,55 @@ void sutil::writeBufferToFile( const char* filename, Buffer buffer)
 
 void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
 {
-    GLsizei width, height;
     RTsize buffer_width, buffer_height;
 
     GLvoid* imageData;
     RT_CHECK_ERROR( rtBufferMap( buffer, &imageData) );
 
     RT_CHECK_ERROR( rtBufferGetSize2D(buffer, &buffer_width, &buffer_height) );
-    width  = static_cast<GLsizei>(buffer_width);
-    height = static_cast<GLsizei>(buffer_height);
-
-    std::vector<unsigned char> pix(width * height * 3);
+    const unsigned width  = static_cast<unsigned>(buffer_width);
+    const unsigned height = static_cast<unsigned>(buffer_height);
 
     RTformat buffer_format;
     RT_CHECK_ERROR( rtBufferGetFormat(buffer, &buffer_format) );
 
-    switch(buffer_format) {
+    if( isFloatImageFile( filename ) ) {
+        std::vector<float> rgba(width * height * 4);
+        if( !convertBufferToRGBA32F( imageData, buffer_format, width, height, &rgba[0] ) ) {
+            fprintf(stderr, "Unrecognized buffer data type or format.\n");
+            exit(2);
+        }
+        RT_CHECK_ERROR( rtBufferUnmap(buffer) );
+        writeRGBA32FToFile( filename, &rgba[0], width, height );
+        return;
+    }
+
+    std::vector<unsigned char> pix(width * height * 3);
+
+    if( !convertBufferToRGB8( imageData, buffer_format, width, height, &pix[0] ) ) {
+        fprintf(stderr, "Unrecognized buffer data type or format.\n");
+        exit(2);
+    }
+
+    writeRGB8ToFile( filename, &pix[0], width, height );
+
+    // Now unmap the buffer
+    RT_CHECK_ERROR( rtBufferUnmap(buffer) );
+}
+
+
+bool sutil::convertBufferToRGB8( const void* data, RTformat format, unsigned width, unsigned height, unsigned char* rgb )
+{
+    const int w = static_cast<int>(width);
+    const int h = static_cast<int>(height);
+
+    switch(format) {
         case RT_FORMAT_UNSIGNED_BYTE4:
             // Data is BGRA and upside down, so we need to swizzle to RGB
-            for(int j = height-1; j >= 0; --j) {
-                unsigned char *dst = &pix[0] + (3*width*(height-1-j));
-                unsigned char *src = ((unsigned char*)imageData) + (4*width*j);
-                for(int i = 0; i < width; i++) {
+            for(int j = h-1; j >= 0; --j) {
+                unsigned char *dst = rgb + (3*w*(h-1-j));
+                const unsigned char *src = ((const unsigned char*)data) + (4*w*j);
+                for(int i = 0; i < w; i++) {
                     *dst++ = *(src + 2);
                     *dst++ = *(src + 1);
                     *dst++ = *(src + 0);
@@ -480,10 +579,10 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
 
         case RT_FORMAT_FLOAT:
             // This buffer is upside down
-            for(int j = height-1; j >= 0; --j) {
-                unsigned char *dst = &pix[0] + width*(height-1-j);
-                float* src = ((float*)imageData) + (3*width*j);
-                for(int i = 0; i < width; i++) {
+            for(int j = h-1; j >= 0; --j) {
+                unsigned char *dst = rgb + (3*w*(h-1-j));
+                const float* src = ((const float*)data) + (w*j);
+                for(int i = 0; i < w; i++) {
                     int P = static_cast<int>((*src++) * 255.0f);
                     unsigned int Clamped = P < 0 ? 0 : P > 0xff ? 0xff : P;
 
@@ -497,10 +596,10 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
 
         case RT_FORMAT_FLOAT3:
             // This buffer is upside down
-            for(int j = height-1; j >= 0; --j) {
-                unsigned char *dst = &pix[0] + (3*width*(height-1-j));
-                float* src = ((float*)imageData) + (3*width*j);
-                for(int i = 0; i < width; i++) {
+            for(int j = h-1; j >= 0; --j) {
+                unsigned char *dst = rgb + (3*w*(h-1-j));
+                const float* src = ((const float*)data) + (3*w*j);
+                for(int i = 0; i < w; i++) {
                     for(int elem = 0; elem < 3; ++elem) {
                         int P = static_cast<int>((*src++) * 255.0f);
                         unsigned int Clamped = P < 0 ? 0 : P > 0xff ? 0xff : P;
@@ -512,10 +611,10 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
 
         case RT_FORMAT_FLOAT4:
             // This buffer is upside down
-            for(int j = height-1; j >= 0; --j) {
-                unsigned char *dst = &pix[0] + (3*width*(height-1-j));
-                float* src = ((float*)imageData) + (4*width*j);
-                for(int i = 0; i < width; i++) {
+            for(int j = h-1; j >= 0; --j) {
+                unsigned char *dst = rgb + (3*w*(h-1-j));
+                const float* src = ((const float*)data) + (4*w*j);
+                for(int i = 0; i < w; i++) {
                     for(int elem = 0; elem < 3; ++elem) {
                         int P = static_cast<int>((*src++) * 255.0f);
                         unsigned int Clamped = P < 0 ? 0 : P > 0xff ? 0xff : P;
@@ -529,11 +628,14 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
             break;
 
         default:
-            fprintf(stderr, "Unrecognized buffer data type or format.\n");
-            exit(2);
-            break;
+            return false;
     }
+    return true;
+}
+
 
+void sutil::writeRGB8ToFile( const char* filename, const unsigned char* rgb, unsigned width, unsigned height )
+{
     std::string suffix;
     std::string fn( filename );
     if ( fn.length() > 4 ) {
@@ -541,46 +643,238 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
     }
 
     if ( suffix == ".ppm" ) {
-        SavePPM(&pix[0], filename, width, height, 3);
+        SavePPM(rgb, filename, width, height, 3);
     } else if ( suffix == ".png" ) {
-        if ( !stbi_write_png( filename, (int)width, (int)height, 3, &pix[0], /*row stride in bytes*/ width*3*sizeof(unsigned char)) ) {
+        if ( !stbi_write_png( filename, (int)width, (int)height, 3, rgb, /*row stride in bytes*/ width*3*sizeof(unsigned char)) ) {
             throw Exception( std::string("Failed to write image: ") + filename );
         }
     } else {
         throw Exception( std::string("Unrecognized output image file extension: ") + filename );
     }
+}
 
-    // Now unmap the buffer
-    RT_CHECK_ERROR( rtBufferUnmap(buffer) );
+
+namespace
+{
+    void appendPNG( void* context, void* data, int size )
+    {
+        std::vector<unsigned char>* png = static_cast<std::vector<unsigned char>*>( context );
+        png->insert( png->end(), static_cast<unsigned char*>( data ), static_cast<unsigned char*>( data ) + size );
+    }
+} // namespace
+
+
+bool sutil::encodePNG( const unsigned char* pixels, unsigned width, unsigned height, unsigned components, std::vector<unsigned char>& png )
+{
+    png.clear();
+    return stbi_write_png_to_func( appendPNG, &png, (int)width, (int)height, (int)components, pixels,
+                                   /*row stride in bytes*/ width*components*sizeof(unsigned char) ) != 0;
 }
 
 
-void sutil::displayBufferGL( optix::Buffer buffer )
+bool sutil::isFloatImageFile( const char* filename )
 {
-    // Query buffer information
-    RTsize buffer_width_rts, buffer_height_rts;
-    buffer->getSize( buffer_width_rts, buffer_height_rts );
-    uint32_t width  = static_cast<int>(buffer_width_rts);
-    uint32_t height = static_cast<int>(buffer_height_rts);
-    RTformat buffer_format = buffer->getFormat();
-    
-    GLboolean use_SRGB = GL_FALSE;
-    if( buffer_format == RT_FORMAT_FLOAT4 || buffer_format == RT_FORMAT_FLOAT3 )
+    std::string suffix;
+    std::string fn( filename );
+    if ( fn.length() > 4 ) {
+        suffix = fn.substr( fn.length() - 4 );
+    }
+    return suffix == ".exr" || suffix == ".pfm";
+}
+
+
+bool sutil::convertBufferToRGBA32F( const void* data, RTformat format, unsigned width, unsigned height, float* rgba )
+{
+    const size_t n = static_cast<size_t>(width) * height;
+    switch(format) {
+        case RT_FORMAT_UNSIGNED_BYTE4:
+            // Data is BGRA
+            for(size_t i = 0; i < n; ++i) {
+                const unsigned char* src = ((const unsigned char*)data) + 4*i;
+                rgba[4*i+0] = src[2] / 255.0f;
+                rgba[4*i+1] = src[1] / 255.0f;
+                rgba[4*i+2] = src[0] / 255.0f;
+                rgba[4*i+3] = src[3] / 255.0f;
+            }
+            break;
+
+        case RT_FORMAT_FLOAT:
+            for(size_t i = 0; i < n; ++i) {
+                const float v = ((const float*)data)[i];
+                rgba[4*i+0] = rgba[4*i+1] = rgba[4*i+2] = v;
+                rgba[4*i+3] = 1.0f;
+            }
+            break;
+
+        case RT_FORMAT_FLOAT3:
+            for(size_t i = 0; i < n; ++i) {
+                memcpy( rgba + 4*i, ((const float*)data) + 3*i, 3*sizeof(float) );
+                rgba[4*i+3] = 1.0f;
+            }
+            break;
+
+        case RT_FORMAT_FLOAT4:
+            memcpy( rgba, data, 4*n*sizeof(float) );
+            break;
+
+        default:
+            return false;
+    }
+    return true;
+}
+
+
+void sutil::writeRGBA32FToFile( const char* filename, const float* rgba, unsigned width, unsigned height,
+                                const float* albedo, const float* normal )
+{
+    std::string suffix;
+    std::string fn( filename );
+    if ( fn.length() > 4 ) {
+        suffix = fn.substr( fn.length() - 4 );
+    }
+
+    bool ok;
+    if ( suffix == ".exr" ) {
+        std::vector<EXRLayer> layers;
+        const EXRLayer beauty = { "", "RGBA", rgba, 4 };
+        layers.push_back( beauty );
+        if ( albedo ) {
+            const EXRLayer layer = { "albedo", "RGB", albedo, 4 };
+            layers.push_back( layer );
+        }
+        if ( normal ) {
+            const EXRLayer layer = { "normal", "XYZ", normal, 4 };
+            layers.push_back( layer );
+        }
+        ok = writeEXR( fn, width, height, layers );
+    } else if ( suffix == ".pfm" ) {
+        ok = writePFM( fn, width, height, rgba, 4 );
+    } else {
+        throw Exception( std::string("Unrecognized float image file extension: ") + filename );
+    }
+
+    if ( !ok ) {
+        throw Exception( std::string("Failed to write image: ") + filename );
+    }
+}
+
+
+void sutil::writeBuffersToFile( const char* filename, Buffer buffer, Buffer albedo, Buffer normal )
+{
+    if( !isFloatImageFile( filename ) || ( !albedo && !normal ) ) {
+        writeBufferToFile( filename, buffer );
+        return;
+    }
+
+    RTsize width, height;
+    buffer->getSize( width, height );
+    const size_t n = 4 * width * height;
+
+    // Each buffer is mapped only while it is converted
+    std::vector<float> images[3];
+    Buffer buffers[3] = { buffer, albedo, normal };
+    for( int i = 0; i < 3; ++i ) {
+        if( !buffers[i] )
+            continue;
+        RTsize w, h;
+        buffers[i]->getSize( w, h );
+        if( w != width || h != height )
+            throw Exception( std::string("Layer buffers differ in size from the image buffer: ") + filename );
+        images[i].resize( n );
+        const bool converted = convertBufferToRGBA32F( buffers[i]->map( 0, RT_BUFFER_MAP_READ ), buffers[i]->getFormat(),
+                                                       static_cast<unsigned>(width), static_cast<unsigned>(height), &images[i][0] );
+        buffers[i]->unmap();
+        if( !converted )
+            throw Exception( std::string("Unrecognized buffer data type or format: ") + filename );
+    }
+
+    writeRGBA32FToFile( filename, &images[0][0], static_cast<unsigned>(width), static_cast<unsigned>(height),
+                        albedo ? &images[1][0] : 0, normal ? &images[2][0] : 0 );
+}
+
+
+namespace
+{
+    // GL objects reused by displayBufferGL() across frames.  The texture storage is only
+    // reallocated when the buffer size or format changes, and the non-interop path streams
+    // through two pixel unpack buffers so that the copy of one frame never waits for the
+    // texture upload of the previous frame.
+    struct DisplayState
     {
-        glGetBooleanv( GL_FRAMEBUFFER_SRGB_CAPABLE_EXT, &use_SRGB );
-        if( use_SRGB )
-            glEnable(GL_FRAMEBUFFER_SRGB_EXT);
+        GLuint   tex;
+        uint32_t width;
+        uint32_t height;
+        RTformat format;
+        GLuint   pbos[2];
+        GLsync   fences[2];
+        size_t   pbo_size;
+        unsigned next_pbo;
+    };
+
+    DisplayState g_display = { 0, 0, 0, RT_FORMAT_UNKNOWN, { 0, 0 }, { 0, 0 }, 0, 0 };
+
+    bool getDisplayFormat( RTformat buffer_format, GLint& internal_format, GLenum& format, GLenum& type )
+    {
+        switch( buffer_format )
+        {
+            case RT_FORMAT_UNSIGNED_BYTE4:
+                internal_format = GL_RGBA8;
+                format          = GL_BGRA;
+                type            = GL_UNSIGNED_BYTE;
+                return true;
+
+            case RT_FORMAT_FLOAT4:
+                internal_format = GL_RGBA32F_ARB;
+                format          = GL_RGBA;
+                type            = GL_FLOAT;
+                return true;
+
+            case RT_FORMAT_FLOAT3:
+                internal_format = GL_RGB32F_ARB;
+                format          = GL_RGB;
+                type            = GL_FLOAT;
+                return true;
+
+            case RT_FORMAT_FLOAT:
+                internal_format = GL_LUMINANCE32F_ARB;
+                format          = GL_LUMINANCE;
+                type            = GL_FLOAT;
+                return true;
+
+            default:
+                return false;
+        }
     }
 
-    // Check if we have a GL interop display buffer
-    const unsigned pboId = buffer->getGLBOId();
-    if( pboId )
+    // Fences let the staging buffers be mapped unsynchronized, otherwise each map orphans the storage.
+    bool useDisplayFences()
+    {
+#if defined(__APPLE__)
+        return false;
+#else
+        return GLEW_ARB_sync && GLEW_ARB_map_buffer_range;
+#endif
+    }
+
+    void waitDisplayFence( GLsync& fence )
     {
-        static unsigned int gl_tex_id = 0;
-        if( !gl_tex_id )
+#if !defined(__APPLE__)
+        if( fence )
         {
-            glGenTextures( 1, &gl_tex_id );
-            glBindTexture( GL_TEXTURE_2D, gl_tex_id );
+            glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000) );
+            glDeleteSync( fence );
+            fence = 0;
+        }
+#endif
+    }
+
+    void setDisplayTexture( uint32_t width, uint32_t height, RTformat buffer_format, GLint internal_format,
+                            GLenum format, GLenum type )
+    {
+        if( !g_display.tex )
+        {
+            glGenTextures( 1, &g_display.tex );
+            glBindTexture( GL_TEXTURE_2D, g_display.tex );
 
             // Change these to GL_LINEAR for super- or sub-sampling
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -591,103 +885,151 @@ void sutil::displayBufferGL( optix::Buffer buffer )
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         }
 
-        glBindTexture( GL_TEXTURE_2D, gl_tex_id );
+        glBindTexture( GL_TEXTURE_2D, g_display.tex );
 
-        // send PBO to texture
-        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pboId );
+        if( width != g_display.width || height != g_display.height || buffer_format != g_display.format )
+        {
+            // No pixel unpack buffer may be bound while allocating the storage.
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+            glTexImage2D( GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, 0 );
+            g_display.width  = width;
+            g_display.height = height;
+            g_display.format = buffer_format;
+        }
+    }
 
-        RTsize elmt_size = buffer->getElementSize();
-        if      ( elmt_size % 8 == 0) glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
-        else if ( elmt_size % 4 == 0) glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-        else if ( elmt_size % 2 == 0) glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
-        else                          glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-        if( buffer_format == RT_FORMAT_UNSIGNED_BYTE4)
-            glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, 0);
-        else if(buffer_format == RT_FORMAT_FLOAT4)
-            glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA32F_ARB, width, height, 0, GL_RGBA, GL_FLOAT, 0);
-        else if(buffer_format == RT_FORMAT_FLOAT3)
-            glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB32F_ARB, width, height, 0, GL_RGB, GL_FLOAT, 0);
-        else if(buffer_format == RT_FORMAT_FLOAT)
-            glTexImage2D( GL_TEXTURE_2D, 0, GL_LUMINANCE32F_ARB, width, height, 0, GL_LUMINANCE, GL_FLOAT, 0);
-        else
-          throw Exception( "Unknown buffer format" );
+    // Copy the mapped OptiX buffer into the next staging buffer, which is left bound.
+    void stageDisplayBuffer( optix::Buffer buffer, size_t size )
+    {
+        const bool use_fences = useDisplayFences();
 
-        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+        if( !g_display.pbos[0] )
+            glGenBuffers( 2, g_display.pbos );
 
-        // 1:1 texel to pixel mapping with glOrtho(0, 1, 0, 1, -1, 1) setup:
-        // The quad coordinates go from lower left corner of the lower left pixel 
-        // to the upper right corner of the upper right pixel. 
-        // Same for the texel coordinates.
+        const unsigned i = g_display.next_pbo;
+        g_display.next_pbo ^= 1;
 
-        glEnable(GL_TEXTURE_2D);
+        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, g_display.pbos[i] );
+        if( size != g_display.pbo_size )
+        {
+            for( int j = 0; j < 2; ++j )
+            {
+                waitDisplayFence( g_display.fences[j] );
+                glBindBuffer( GL_PIXEL_UNPACK_BUFFER, g_display.pbos[j] );
+                glBufferData( GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW );
+            }
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, g_display.pbos[i] );
+            g_display.pbo_size = size;
+        }
+
+        void* dst = 0;
+#if !defined(__APPLE__)
+        if( use_fences )
+        {
+            // The fence was set after the upload from this buffer two frames ago.
+            waitDisplayFence( g_display.fences[i] );
+            dst = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+        }
+#endif
+        if( !use_fences )
+        {
+            glBufferData( GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW );
+            dst = glMapBuffer( GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY );
+        }
 
-        glBegin(GL_QUADS);
-        glTexCoord2f( 0.0f, 0.0f );
-        glVertex2f( 0.0f, 0.0f );
+        const void* src = buffer->map( 0, RT_BUFFER_MAP_READ );
+        if( dst )
+        {
+            memcpy( dst, src, size );
+            glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+        }
+        buffer->unmap();
+    }
+
+    void fenceDisplayBuffer()
+    {
+#if !defined(__APPLE__)
+        if( useDisplayFences() )
+        {
+            const unsigned i = g_display.next_pbo ^ 1;
+            g_display.fences[i] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+        }
+#endif
+    }
+} // namespace
 
-        glTexCoord2f( 1.0f, 0.0f );
-        glVertex2f( 1.0f, 0.0f);
 
-        glTexCoord2f( 1.0f, 1.0f );
-        glVertex2f( 1.0f, 1.0f );
+void sutil::displayBufferGL( optix::Buffer buffer )
+{
+    SUTIL_NVTX_RANGE( "displayBufferGL" );
 
-        glTexCoord2f(0.0f, 1.0f );
-        glVertex2f( 0.0f, 1.0f );
-        glEnd();
+    // Query buffer information
+    RTsize buffer_width_rts, buffer_height_rts;
+    buffer->getSize( buffer_width_rts, buffer_height_rts );
+    uint32_t width  = static_cast<int>(buffer_width_rts);
+    uint32_t height = static_cast<int>(buffer_height_rts);
+    RTformat buffer_format = buffer->getFormat();
 
-        glDisable(GL_TEXTURE_2D);
+    GLint  gl_internal_format;
+    GLenum gl_format;
+    GLenum gl_data_type;
+    if( !getDisplayFormat( buffer_format, gl_internal_format, gl_format, gl_data_type ) )
+        throw Exception( "Unknown buffer format" );
+    
+    GLboolean use_SRGB = GL_FALSE;
+    if( buffer_format == RT_FORMAT_FLOAT4 || buffer_format == RT_FORMAT_FLOAT3 )
+    {
+        glGetBooleanv( GL_FRAMEBUFFER_SRGB_CAPABLE_EXT, &use_SRGB );
+        if( use_SRGB )
+            glEnable(GL_FRAMEBUFFER_SRGB_EXT);
     }
+
+    setDisplayTexture( width, height, buffer_format, gl_internal_format, gl_format, gl_data_type );
+
+    RTsize elmt_size = buffer->getElementSize();
+    if      ( elmt_size % 8 == 0) glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
+    else if ( elmt_size % 4 == 0) glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    else if ( elmt_size % 2 == 0) glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    else                          glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Check if we have a GL interop display buffer, otherwise stage the data in our own PBOs.
+    const unsigned pboId = buffer->getGLBOId();
+    if( pboId )
+        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pboId );
     else
-    {
-        GLvoid* imageData = buffer->map( 0, RT_BUFFER_MAP_READ );
-        GLenum gl_data_type = GL_FALSE;
-        GLenum gl_format = GL_FALSE;
+        stageDisplayBuffer( buffer, elmt_size * width * height );
 
-        switch (buffer_format)
-        {
-            case RT_FORMAT_UNSIGNED_BYTE4:
-                gl_data_type = GL_UNSIGNED_BYTE;
-                gl_format    = GL_BGRA;
-                break;
+    // send PBO to texture, the upload runs asynchronously to the next launch
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, width, height, gl_format, gl_data_type, 0 );
 
-            case RT_FORMAT_FLOAT:
-                gl_data_type = GL_FLOAT;
-                gl_format    = GL_LUMINANCE;
-                break;
+    if( !pboId )
+        fenceDisplayBuffer();
 
-            case RT_FORMAT_FLOAT3:
-                gl_data_type = GL_FLOAT;
-                gl_format    = GL_RGB;
-                break;
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
 
-            case RT_FORMAT_FLOAT4:
-                gl_data_type = GL_FLOAT;
-                gl_format    = GL_RGBA;
-                break;
+    // 1:1 texel to pixel mapping with glOrtho(0, 1, 0, 1, -1, 1) setup:
+    // The quad coordinates go from lower left corner of the lower left pixel 
+    // to the upper right corner of the upper right pixel. 
+    // Same for the texel coordinates.
 
-            default:
-                fprintf(stderr, "Unrecognized buffer data type or format.\n");
-                exit(2);
-                break;
-        }
+    glEnable(GL_TEXTURE_2D);
 
-        RTsize elmt_size = buffer->getElementSize();
-        int align = 1;
-        if      ((elmt_size % 8) == 0) align = 8; 
-        else if ((elmt_size % 4) == 0) align = 4;
-        else if ((elmt_size % 2) == 0) align = 2;
-        glPixelStorei(GL_UNPACK_ALIGNMENT, align);
-
-        glDrawPixels(
-                static_cast<GLsizei>( width ),
-                static_cast<GLsizei>( height ),
-                gl_format,
-                gl_data_type,
-                imageData
-                );
-        buffer->unmap();
-    }
+    glBegin(GL_QUADS);
+    glTexCoord2f( 0.0f, 0.0f );
+    glVertex2f( 0.0f, 0.0f );
+
+    glTexCoord2f( 1.0f, 0.0f );
+    glVertex2f( 1.0f, 0.0f);
+
+    glTexCoord2f( 1.0f, 1.0f );
+    glVertex2f( 1.0f, 1.0f );
+
+    glTexCoord2f(0.0f, 1.0f );
+    glVertex2f( 0.0f, 1.0f );
+    glEnd();
+
+    glDisable(GL_TEXTURE_2D);
 
     if ( use_SRGB )
         glDisable(GL_FRAMEBUFFER_SRGB_EXT);
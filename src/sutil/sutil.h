@@ -88,6 +88,23 @@ SUTILAPI const char* samplesDir();
 // The pointer returned may point to a static array.
 SUTILAPI const char* samplesPTXDir();
 
+// Make PTX compiled into the executable available under the given PTX file name,
+// e.g. "optixGlass_generated_glass.cu.ptx".  Called from the sources generated
+// with SAMPLES_EMBED_PTX and for PTX compiled at runtime.  The ptx string is
+// copied, registering a name again replaces the PTX for later lookups.
+SUTILAPI bool registerEmbeddedPTX( const char* ptx_filename, const char* ptx );
+
+// Return the PTX for the given file path.  Embedded PTX is found by file name,
+// anything else is read from disk once and kept for later calls.  Safe to call
+// from multiple threads.  Throws an optix::Exception if the file cannot be read.
+SUTILAPI const char* getPtxString( const std::string& ptx_path );
+
+// Same as Context::createProgramFromPTXFile(), but with the PTX from getPtxString().
+optix::Program SUTILAPI createProgramFromPTXFile(
+        optix::Context context,             // optix context
+        const std::string& ptx_path,        // PTX file, only the name is used for embedded PTX
+        const std::string& program_name );  // Function in the PTX
+
 // Create an output buffer with given specifications
 optix::Buffer SUTILAPI createOutputBuffer(
         optix::Context context,             // optix context
@@ -133,6 +150,63 @@ void SUTILAPI writeBufferToFile(
         const char* filename,               // Image file to be created
         RTbuffer buffer);                   // Buffer to be displayed
 
+// Convert mapped UNSIGNED_BYTE4 (BGRA), FLOAT, FLOAT3 or FLOAT4 buffer contents, stored bottom row
+// first, to top down 8 bit RGB.  Returns false for other formats.
+bool SUTILAPI convertBufferToRGB8(
+        const void* data,                   // Mapped buffer contents
+        RTformat format,                    // Buffer format
+        unsigned width,                     // Buffer width
+        unsigned height,                    // Buffer height
+        unsigned char* rgb);                // 3*width*height bytes to be filled
+
+// Write top down 8 bit RGB pixels to an image file with type based on extension
+void SUTILAPI writeRGB8ToFile(
+        const char* filename,               // Image file to be created
+        const unsigned char* rgb,           // Pixels to be written
+        unsigned width,                     // Image width
+        unsigned height);                   // Image height
+
+// Compress top down 8 bit pixels with 1 to 4 components into the contents of a PNG file in
+// memory, e.g. to send them over a network.  Returns false on failure.
+bool SUTILAPI encodePNG(
+        const unsigned char* pixels,        // Pixels to be compressed
+        unsigned width,                     // Image width
+        unsigned height,                    // Image height
+        unsigned components,                // Bytes per pixel, 1 to 4
+        std::vector<unsigned char>& png);   // Replaced by the PNG data
+
+// True if the extension selects a float image format, .exr (half float OpenEXR) or .pfm.
+// writeBufferToFile() writes these without quantizing.
+bool SUTILAPI isFloatImageFile(
+        const char* filename);              // Image file name
+
+// Convert mapped UNSIGNED_BYTE4 (BGRA), FLOAT, FLOAT3 or FLOAT4 buffer contents to RGBA floats,
+// keeping the bottom row first order.  Returns false for other formats.
+bool SUTILAPI convertBufferToRGBA32F(
+        const void* data,                   // Mapped buffer contents
+        RTformat format,                    // Buffer format
+        unsigned width,                     // Buffer width
+        unsigned height,                    // Buffer height
+        float* rgba);                       // 4*width*height floats to be filled
+
+// Write bottom row first RGBA floats to an .exr or .pfm file.  The optional albedo and normal
+// images become the albedo.RGB and normal.XYZ layers of an EXR file.
+void SUTILAPI writeRGBA32FToFile(
+        const char* filename,               // Image file to be created
+        const float* rgba,                  // Pixels to be written
+        unsigned width,                     // Image width
+        unsigned height,                    // Image height
+        const float* albedo = 0,            // Optional RGBA albedo, as for the denoiser
+        const float* normal = 0);           // Optional XYZW normals, as for the denoiser
+
+// Write a buffer along with optional denoiser albedo and normal buffers of the same size.  The
+// extra buffers become layers of an .exr file and are ignored by the other formats.
+void SUTILAPI writeBuffersToFile(
+        const char* filename,               // Image file to be created
+        optix::Buffer buffer,               // Buffer to be written
+        optix::Buffer albedo,               // Optional albedo buffer, may be null
+        optix::Buffer normal);              // Optional normal buffer, may be null
+
 
 // Display contents of buffer, where the OpenGL context is managed by caller.
 void SUTILAPI displayBufferGL(